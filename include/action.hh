@@ -22,6 +22,7 @@
 
 #include <set>
 #include <string>
+#include <chrono>
 
 namespace GhidraDec {
 
@@ -30,19 +31,35 @@ namespace GhidraDec {
 /// Any Rule or \e leaf Action belongs to a \b group. This class
 /// is a \b grouplist defined by a collection of these \b group names.
 /// The set of Rule and Action objects belong to any of the groups in this list
-/// together form a \b root Action.
+/// together form a \b root Action.  Individual Rules can also be left out of the \b root Action
+/// by name, even though their group is in the list (see ActionDatabase::deriveProfile()).
+/// A grouplist can also ask that Rules without state of their own be shared with the Action
+/// being cloned, rather than copied (see ActionPool::clone()).
 class ActionGroupList {
   friend class ActionDatabase;
   std::set<std::string> list;		///< List of group names
+  std::set<std::string> skiprules;	///< Names of Rules left out, even if their group is listed
+  bool sharerules;			///< Set if clones share the Rules that have no state of their own
 public:
+  ActionGroupList(void) { sharerules = false; }	///< Construct an empty grouplist
+  bool isShareRules(void) const { return sharerules; }	///< Return \b true if clones share stateless Rules
+  void setShareRules(bool val) { sharerules = val; }	///< Toggle whether clones share stateless Rules
+
   /// \brief Check if \b this ActionGroupList contains a given group
   ///
   /// \param nm is the given group to check for
   /// \return true if \b this contains the group
   bool contains(const std::string &nm) const { return (list.find(nm)!=list.end()); }
+
+  /// \brief Check if a Rule is left out by \b this ActionGroupList
+  ///
+  /// \param nm is the name of the Rule
+  /// \return \b true if the Rule is not cloned into the \b root Action
+  bool skips(const std::string &nm) const { return (skiprules.find(nm)!=skiprules.end()); }
 };
 
 class Rule;
+struct RuleStatistics;
 
 /// \brief Large scale transformations applied to the varnode/op graph
 ///
@@ -51,6 +68,8 @@ class Rule;
 /// This base class keeps track of basic statistics about how the action is
 /// being applied.  Derived classes indicate that a change has been applied
 /// by incrementing the \b count field.
+/// If timing is enabled (see setTiming()), the wall-clock time spent in each Action and Rule is
+/// also accumulated.
 /// With OPACTION_DEBUG macro defined, actions support a break point debugging in console mode.
 class Action {
 public:
@@ -61,7 +80,8 @@ public:
     rule_oneactperfunc = 16,	///< Makes a change only once per function
     rule_debug = 32,		///< Print debug messages specifically for this action
     rule_warnings_on = 64,	///< If this action makes a change, issue a warning
-    rule_warnings_given = 128	///< A warning has been issued for this action
+    rule_warnings_given = 128,	///< A warning has been issued for this action
+    rule_expendable = 256	///< Action is skipped once the analysis budget of the function runs out
   };
   /// Boolean properties describing the \e status of an action
   enum statusflags {
@@ -87,6 +107,9 @@ protected:
   uint4 flags;			///< Behavior properties
   uint4 count_tests;		///< Number of times apply() has been called
   uint4 count_apply;		///< Number of times apply() made changes
+  uint8 count_time;		///< Nanoseconds spent in apply(), if timing is enabled
+  uint8 count_mempeak;		///< Largest memory usage (in bytes) measured after apply(), if memory tracking is enabled
+  int4 traceid;			///< Kind of trace span recorded by perform() (-1 if not registered yet)
   std::string name;			///< Name of the action
   std::string basegroup;		///< Base group this action belongs to
   void issueWarning(Architecture *glb);	///< Warn that this Action has applied
@@ -94,6 +117,9 @@ protected:
   bool checkActionBreak(void);	///< Check action breakpoint
   void turnOnWarnings(void) { flags |= rule_warnings_on; }	///< Enable warnings for this Action
   void turnOffWarnings(void) { flags &= ~rule_warnings_on; }	///< Disable warnings for this Action
+  static bool timing_on;	///< Set if Actions and Rules accumulate the time they spend
+  static bool memory_on;	///< Set if Actions measure the memory used by the function after they apply
+  static const char *expendable_groups[];	///< Groups whose Actions and Rules can be skipped to save time
 public:
   Action(uint4 f,const std::string &nm,const std::string &g);		///< Base constructor for an Action
   virtual ~Action(void) {}					///< Destructor
@@ -102,6 +128,16 @@ public:
   virtual bool turnOffDebug(const std::string &nm);			///< Turn off debugging
 #endif
   virtual void printStatistics(ostream &s) const;		///< Dump statistics to stream
+  virtual void printStatisticsCsv(ostream &s,const std::string &path) const;	///< Dump statistics as CSV records
+  static void printCsvHeader(ostream &s);			///< Print the header line for CSV statistics
+  static void setTiming(bool val) { timing_on = val; }		///< Toggle timing of all Actions and Rules
+  static bool isTiming(void) { return timing_on; }		///< Return \b true if Actions and Rules are being timed
+  static void setMemoryTracking(bool val) { memory_on = val; }	///< Toggle memory measurement by all Actions
+  static bool isMemoryTracking(void) { return memory_on; }	///< Return \b true if Actions measure memory usage
+  static bool isExpendableGroup(const std::string &g);		///< Can Actions and Rules in the given group be skipped
+  /// \brief Get nanoseconds elapsed since a given time
+  static uint8 elapsedNanos(const std::chrono::steady_clock::time_point &start) {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count(); }
   int4 perform(Funcdata &data); 				///< Perform this action (if necessary)
   bool setBreakPoint(uint4 tp,const std::string &specify);		///< Set a breakpoint on this action
   bool setWarning(bool val,const std::string &specify);		///< Set a warning on this action
@@ -112,6 +148,8 @@ public:
   uint4 getStatus(void) const { return status; }		///< Get the current status of \b this Action
   uint4 getNumTests(void) { return count_tests; }		///< Get the number of times apply() was invoked
   uint4 getNumApply(void) { return count_apply; }		///< Get the number of times apply() made changes
+  uint8 getTime(void) const { return count_time; }		///< Get the nanoseconds spent in apply()
+  uint8 getMemoryPeak(void) const { return count_mempeak; }	///< Get the largest memory usage measured after apply()
   /// \brief Clone the Action
   ///
   /// If \b this Action is a member of one of the groups in the grouplist,
@@ -121,6 +159,7 @@ public:
   virtual Action *clone(const ActionGroupList &grouplist) const=0;
   virtual void reset(Funcdata &data);				///< Reset the Action for a new function
   virtual void resetStats(void);				///< Reset the statistics
+  virtual void mergeStatistics(const Action &op2);		///< Add the statistics of a copy of \b this into \b this
   /// \brief Make a single attempt to apply \b this Action
   ///
   /// This is the main entry point for applying changes to a function that
@@ -136,6 +175,7 @@ public:
   virtual void restoreXml(const Element *el,Funcdata *fd) {}	///< Load specifics of action from XML
   virtual Action *getSubAction(const std::string &specify);		///< Retrieve a specific sub-action by name
   virtual Rule *getSubRule(const std::string &specify);		///< Retrieve a specific sub-rule by name
+  virtual void collectRuleUsage(set<std::string> &tested,set<std::string> &applied) const {}	///< Collect the names of Rules that were tried and that applied
 };
 
 /// \brief A group of actions (generally) applied in sequence
@@ -155,16 +195,19 @@ public:
   virtual Action *clone(const ActionGroupList &grouplist) const;
   virtual void reset(Funcdata &data);
   virtual void resetStats(void);
+  virtual void mergeStatistics(const Action &op2);
   virtual int4 apply(Funcdata &data);
   virtual int4 print(ostream &s,int4 num,int4 depth) const;
   virtual void printState(ostream &s) const;
   virtual Action *getSubAction(const std::string &specify);
   virtual Rule *getSubRule(const std::string &specify);
+  virtual void collectRuleUsage(set<std::string> &tested,set<std::string> &applied) const;
 #ifdef OPACTION_DEBUG
   virtual bool turnOnDebug(const std::string &nm);
   virtual bool turnOffDebug(const std::string &nm);
 #endif
   virtual void printStatistics(ostream &s) const;
+  virtual void printStatisticsCsv(ostream &s,const std::string &path) const;
 };
 
 /// \brief Action which checks if restart (sub)actions have been generated
@@ -194,6 +237,11 @@ public:
 /// A Rule supports the same breakpoint properties as an Action.
 /// A Rule is allowed to keep state that is specific to a given function (Funcdata).
 /// The reset() method is invoked to purge this state for each new function to be transformed.
+/// A Rule can also declare simple conditions that a PcodeOp must meet before it is worth calling
+/// applyOp() (see requireConstant(), requireWritten(), and requireMaxOutputSize()).  The ActionPool
+/// checks these with checkFilter(), without making a virtual call.
+/// A Rule may also declare how far its changes reach from the PcodeOp it is applied to (see
+/// setLocality()), which lets an ActionPool schedule it with the other Rules of a basic block.
 class Rule {
 public:
   /// Properties associated with a Rule
@@ -201,7 +249,15 @@ public:
     type_disable = 1,		///< Is this rule disabled
     rule_debug = 2,		///< Print debug info specific for this rule
     warnings_on = 4,		///< A warning is issued if this rule is applied
-    warnings_given = 8		///< Set if a warning for this rule has been given before
+    warnings_given = 8,		///< Set if a warning for this rule has been given before
+    expendable = 16,		///< Rule is skipped once the analysis budget of the function runs out
+    private_state = 32		///< Rule keeps state of its own while it applies, so it can't be shared
+  };
+  /// \brief How far the changes made by a Rule can reach from the PcodeOp it applies to
+  enum localityclass {
+    local_op = 0,		///< Only the PcodeOp itself is changed (new constants may be created)
+    local_block = 1,		///< Only PcodeOps in the same basic block are changed
+    local_function = 2		///< PcodeOps anywhere in the function may be changed
   };
 private:
   friend struct ActionPool;
@@ -209,25 +265,35 @@ private:
   uint4 breakpoint;		///< Breakpoint(s) enabled for \b this Rule
   std::string name;			///< Name of the Rule
   std::string basegroup;		///< Group to which \b this Rule belongs
-  uint4 count_tests;		///< Number of times \b this Rule has attempted to apply
-  uint4 count_apply;		///< Number of times \b this Rule has successfully been applied
+  uint4 constslots;		///< Input slots that must hold a constant for \b this Rule to apply
+  uint4 writtenslots;		///< Input slots that must be written by a PcodeOp for \b this Rule to apply
+  int4 maxoutsize;		///< Largest output size for which \b this Rule can apply (0 for any size)
+  localityclass locality;	///< How far the changes made by \b this Rule can reach
   void issueWarning(Architecture *glb);	///< If enabled, print a warning that this Rule has been applied
+protected:
+  void requireConstant(int4 slot) { constslots |= ((uint4)1)<<slot; }	///< Only apply if the given input slot holds a constant
+  void requireWritten(int4 slot) { writtenslots |= ((uint4)1)<<slot; }	///< Only apply if the given input slot is written
+  void requireMaxOutputSize(int4 sz) { maxoutsize = sz; }	///< Only apply if the output is no bigger than the given size
+  void setLocality(localityclass l) { locality = l; }	///< Declare how far the changes of \b this Rule reach
+  void setPrivateState(void) { flags |= private_state; }	///< Declare that \b this Rule keeps state while applying
 public:
   Rule(const std::string &g,uint4 fl,const std::string &nm);		///< Construct given group, properties name
   virtual ~Rule(void) {}					///< Destructor
   const std::string &getName(void) const { return name; }		///< Return the name of \b this Rule
   const std::string &getGroup(void) const { return basegroup; }	///< Return the group \b this Rule belongs to
-  uint4 getNumTests(void) { return count_tests; }		///< Get number of attempted applications
-  uint4 getNumApply(void) { return count_apply; }		///< Get number of successful applications
+  localityclass getLocality(void) const { return locality; }	///< Get how far the changes of \b this Rule reach
   void setBreak(uint4 tp) { breakpoint |= tp; }			///< Set a breakpoint on \b this Rule
   void clearBreak(uint4 tp) { breakpoint &= ~tp; }		///< Clear a breakpoint on \b this Rule
   void turnOnWarnings(void) { flags |= warnings_on; }		///< Enable warnings for \b this Rule
   void turnOffWarnings(void) { flags &= ~warnings_on; }		///< Disable warnings for \b this Rule
   bool isDisabled(void) const { return ((flags & type_disable)!=0); }	///< Return \b true if \b this Rule is disabled
+  bool isExpendable(void) const { return ((flags & expendable)!=0); }	///< Return \b true if \b this Rule can be skipped to save time
+  bool hasPrivateState(void) const { return ((flags & private_state)!=0); }	///< Return \b true if \b this Rule can't be shared
   void setDisable(void) { flags |= type_disable; }		///< Disable this Rule (within its pool)
   void clearDisable(void) { flags &= ~type_disable; }		///< Enable this Rule (within its pool)
   bool checkActionBreak(void);					///< Check if an action breakpoint is turned on
   uint4 getBreakPoint(void) const { return breakpoint; }	///< Return breakpoint toggles
+  bool checkFilter(const PcodeOp *op) const;			///< Check the declared conditions for applying to a PcodeOp
 
   /// \brief Clone the Rule
   ///
@@ -247,38 +313,123 @@ public:
   /// \param data is the function to which to apply
   virtual int4 applyOp(PcodeOp *op,Funcdata &data) { return 0; }
   virtual void reset(Funcdata &data);				///< Reset \b this Rule
-  virtual void resetStats(void);				///< Reset Rule statistics
-  virtual void printStatistics(ostream &s) const;		///< Print statistics for \b this Rule
+  virtual void printStatistics(ostream &s,const RuleStatistics &stats) const;	///< Print statistics for \b this Rule
+  void printStatisticsCsv(ostream &s,const std::string &path,const RuleStatistics &stats) const;	///< Print statistics as a CSV record
 #ifdef OPACTION_DEBUG
   virtual bool turnOnDebug(const std::string &nm);			///< Turn on debugging
   virtual bool turnOffDebug(const std::string &nm);			///< Turn off debugging
 #endif
 };
 
+/// A \b false return means the Rule certainly does not apply to the PcodeOp.
+/// A \b true return means applyOp() must be called to find out.
+/// \param op is the PcodeOp to check
+/// \return \b true if the PcodeOp meets all the declared conditions
+inline bool Rule::checkFilter(const PcodeOp *op) const
+
+{
+  if (maxoutsize != 0) {
+    const Varnode *outvn = op->getOut();
+    if (outvn != (const Varnode *)0 && outvn->getSize() > maxoutsize) return false;
+  }
+  uint4 slots = constslots | writtenslots;
+  for(int4 i=0;slots!=0;++i,slots>>=1) {
+    if ((slots&1)==0) continue;
+    if (i >= op->numInput()) return false;
+    const Varnode *vn = op->getIn(i);
+    if (((constslots>>i)&1)!=0 && !vn->isConstant()) return false;
+    if (((writtenslots>>i)&1)!=0 && !vn->isWritten()) return false;
+  }
+  return true;
+}
+
+/// \brief Counts kept for one Rule of an ActionPool
+///
+/// The counts belong to the pool rather than the Rule, so pools running on different threads
+/// can share a Rule (see ActionGroupList::setShareRules()) and still count separately.
+struct RuleStatistics {
+  uint4 count_tests;		///< Number of times the Rule has attempted to apply
+  uint4 count_apply;		///< Number of times the Rule has successfully been applied
+  uint8 count_time;		///< Nanoseconds spent in applyOp(), if timing is enabled
+  RuleStatistics(void) { count_tests = 0; count_apply = 0; count_time = 0; }	///< Construct zero counts
+  /// \brief Add counts from another pool into \b this
+  void merge(const RuleStatistics &op2) {
+    count_tests += op2.count_tests; count_apply += op2.count_apply; count_time += op2.count_time; }
+};
+
+/// \brief Rule classes compiled ahead of time from dynamic rule files
+///
+/// The \b rulecompile tool translates each rule in an \<experimental_rules> file into a C++
+/// class, with the constraints flattened into ordinary loops and tests.  The generated source
+/// declares a static NativeRuleRegistry for each class, registering a factory under the name of
+/// the rule.  When Architecture reads a dynamic rule with a registered name, the native class is
+/// used in place of the interpreted RuleGeneric, and CPUI_RULECOMPILE is not required.
+class NativeRuleRegistry {
+public:
+  typedef Rule *(*Factory)(const std::string &group);	///< Build a Rule in the given group
+private:
+  static std::map<std::string,Factory> &getMap(void);	///< Get the factories by Rule name
+public:
+  NativeRuleRegistry(const std::string &nm,Factory f) { getMap()[nm] = f; }	///< Register a factory
+  static Rule *build(const std::string &nm,const std::string &group);	///< Build the named native Rule, if any
+};
+
 /// \brief A pool of Rules that apply simultaneously
 ///
 /// This class groups together a set of Rules as a formal Action.
 /// Rules are given an opportunity to apply to every PcodeOp in a function.
+/// For very large functions, a full pass can be split into two phases (see Architecture::pool_partition).
+/// The \e local phase visits the PcodeOps block by block, applying only the Rules whose changes
+/// stay within a basic block, and the \e global phase then visits every PcodeOp in sequence number
+/// order with the remaining Rules.  Each basic block is a disjoint partition of the PcodeOps
+/// for the local Rules, and the changes that can cross blocks are all made in the global phase.
 /// Usually rule_repeatapply is enabled for this action, which causes
 /// all Rules to apply repeatedly until no Rule can make an additional change.
+/// Only the first pass visits every PcodeOp.  A repeated pass visits just the PcodeOps
+/// modified by the previous pass (and those next to a modification), as collected by
+/// the Funcdata.  Once such a pass makes no change, a full pass confirms that no Rule applies.
+///
+/// The pool keeps the counts for each of its Rules itself, and it may share Rules that have no
+/// state of their own with the pool it was cloned from, so Actions for different threads can
+/// be cloned without copying every Rule.
 class ActionPool : public Action {
   vector<Rule *> allrules;				///< The set of Rules in this ActionPool
-  vector<Rule *> perop[CPUI_MAX];			///< Rules associated with each OpCode
+  vector<RuleStatistics> rulestats;			///< Counts for each Rule, in the same order
+  vector<bool> ownsrule;				///< \b true for each Rule that \b this pool deletes
+  vector<int4> perop[CPUI_MAX];				///< Indices of the Rules associated with each OpCode
   PcodeOpTree::const_iterator op_state; 		///< Current PcodeOp up for rule application
   int4 rule_index;					///< Iterator over Rules for one OpCode
+  bool fullpass;					///< Set if the current pass visits every PcodeOp
+  int4 passcount;					///< Value of \b count at the start of the current pass
+  vector<PcodeOp *> worklist;				///< PcodeOps to visit in the current (partial) pass
+  int4 work_index;					///< Position of the current PcodeOp within \b worklist
+  /// \brief The Rules applied by processOp() in the current phase of a pass
+  enum passphase {
+    phase_all = 0,					///< Every Rule
+    phase_local = 1,					///< Only Rules that stay within a basic block
+    phase_global = 2					///< Only Rules that can reach across basic blocks
+  };
+  passphase phase;					///< Current phase of the pass
   int4 processOp(PcodeOp *op,Funcdata &data);		///< Apply the next possible Rule to a PcodeOp
+  bool beginPartitions(Funcdata &data);			///< Collect the PcodeOps of a full pass block by block
+  void beginFullPass(Funcdata &data);			///< Start a pass over every PcodeOp
+  void beginPartialPass(Funcdata &data);		///< Start a pass over the PcodeOps modified by the last pass
+  void addRule(Rule *rl,bool owned);			///< Add a Rule to the pool, given whether the pool owns it
 public:
-  ActionPool(uint4 f,const std::string &nm) : Action(f,nm,"") {}	///< Construct providing properties and name
+  ActionPool(uint4 f,const std::string &nm) : Action(f,nm,"") { fullpass = true; passcount = 0; work_index = 0; phase = phase_all; }	///< Construct providing properties and name
   virtual ~ActionPool(void);				///< Destructor
-  void addRule(Rule *rl);				///< Add a Rule to the pool
+  void addRule(Rule *rl) { addRule(rl,true); }		///< Add a Rule to the pool
   virtual Action *clone(const ActionGroupList &grouplist) const;
   virtual void reset(Funcdata &data);
   virtual void resetStats(void);
+  virtual void mergeStatistics(const Action &op2);
   virtual int4 apply(Funcdata &data);
   virtual int4 print(ostream &s,int4 num,int4 depth) const;
   virtual void printState(ostream &s) const;
   virtual Rule *getSubRule(const std::string &specify);
+  virtual void collectRuleUsage(set<std::string> &tested,set<std::string> &applied) const;
   virtual void printStatistics(ostream &s) const;
+  virtual void printStatisticsCsv(ostream &s,const std::string &path) const;
 #ifdef OPACTION_DEBUG
   virtual bool turnOnDebug(const std::string &nm);
   virtual bool turnOffDebug(const std::string &nm);
@@ -313,12 +464,17 @@ public:
   const std::string &getCurrentName(void) const { return currentactname; }	///< Get the name of the current \e root Action
   const ActionGroupList &getGroup(const std::string &grp) const;	///< Get a specific grouplist by name
   Action *setCurrent(const std::string &actname);		///< Set the current \e root Action
+  Action *getRoot(const std::string &actname) { return deriveAction(universalname,actname); }	///< Get a \e root Action without making it current
+  Action *cloneCurrent(bool sharerules=false) const;		///< Make a private copy of the current \e root Action
+  Action *cloneAction(const std::string &actname,bool sharerules=false) const;	///< Make a private copy of a named \e root Action
   Action *toggleAction(const std::string &grp,const std::string &basegrp,bool val);	///< Toggle a group of Actions with a \e root Action
 
   void setGroup(const std::string &grp,const char **argv);			///< Establish a new \e root Action
   void cloneGroup(const std::string &oldname,const std::string &newname);		///< Clone a \e root Action
   bool addToGroup(const std::string &grp,const std::string &basegroup);		///< Add a group to a \e root Action
   bool removeFromGroup(const std::string &grp,const std::string &basegroup);	///< Remove a group from a \e root Action
+  bool skipRule(const std::string &grp,const std::string &rulename);	///< Leave a Rule out of a \e root Action
+  int4 deriveProfile(const std::string &basename,const std::string &newname,vector<std::string> &skipped);	///< Derive a \e root Action without the Rules that never applied
 };
 
 } // namespace GhidraDec
@@ -27,6 +27,7 @@
 #define __CPUI_ADDR__
 
 #include "space.hh"
+#include "flatindex.hh"
 
 namespace GhidraDec {
 
@@ -157,6 +158,33 @@ public:
   friend ostream &operator<<(ostream &s,const SeqNum &sq);
 };
 
+/// \brief A totally ordered stand-in for an Address, used as the key of hot containers
+///
+/// Ordering two Address objects reads the index of both address spaces through their
+/// pointers.  An AddressKey holds the space index and the offset as plain integers, so
+/// comparing keys never touches the AddrSpace objects, and keys sort in exactly the same
+/// order as the Address objects they were built from (including the \e minimal and
+/// \e maximal extremes).  The Address can be recovered from the AddrSpaceManager owning the space.
+class AddressKey {
+  uintb rank;			///< 0 for the \e minimal address, 1 + the space index, or all ones for the \e maximal address
+  uintb offset;			///< Offset within the space
+public:
+  AddressKey(void) { rank = 0; offset = 0; }	///< Construct the key of the \e minimal address
+  explicit AddressKey(const Address &addr);	///< Construct the key of an Address
+  uintb getOffset(void) const { return offset; }	///< Get the offset of the address
+  Address getAddress(const AddrSpaceManager *manage) const;	///< Recover the Address
+  bool operator==(const AddressKey &op2) const { return (rank == op2.rank && offset == op2.offset); }	///< Compare keys for equality
+  bool operator!=(const AddressKey &op2) const { return (rank != op2.rank || offset != op2.offset); }	///< Compare keys for inequality
+  /// Compare keys in the order of their addresses
+  bool operator<(const AddressKey &op2) const {
+    if (rank != op2.rank) return (rank < op2.rank);
+    return (offset < op2.offset);
+  }
+};
+
+/// The flatindex of a partmap or rangemap keyed by Address holds AddressKeys
+template<> struct flatkey<Address> { typedef AddressKey type; };
+
 /// \brief A contiguous range of bytes in some address space
 class Range {
   friend class RangeList;
@@ -453,6 +481,18 @@ inline AddrSpace *Address::getSpaceFromConst(const Address &addr) {
   return (AddrSpace *)(uintp)addr.offset;
 }
 
+/// \param addr is the Address to encode
+inline AddressKey::AddressKey(const Address &addr) {
+  AddrSpace *spc = addr.getSpace();
+  if (spc == (AddrSpace *)0)
+    rank = 0;
+  else if (spc == (AddrSpace *) ~((uintp)0))
+    rank = ~((uintb)0);
+  else
+    rank = spc->getIndex() + 1;
+  offset = addr.getOffset();
+}
+
 /// \param addr is the Address to test for containment
 /// \return \b true if addr is in \b this Range
 inline bool Range::contains(const Address &addr) const {
@@ -32,27 +32,54 @@
 #include "options.hh"
 #include "prefersplit.hh"
 
+#ifdef CPUI_STATISTICS
+#include <atomic>
+#endif
+
 namespace GhidraDec {
 
 #ifdef CPUI_STATISTICS
+/// \brief A counter that many threads can bump without contending
+///
+/// The count is split into shards, each on its own cache line, and every thread adds into
+/// the shard it was assigned when it first touched a counter.  Additions are relaxed atomic
+/// operations, so with one shard per thread they never bounce cache lines between cores.
+/// The total is summed over the shards when it is asked for.  Each shard also remembers the
+/// count at its last mark, so a thread can find the amount it added since then.
+class ShardedCounter {
+  /// \brief The part of the count that belongs to a group of threads
+  struct alignas(64) Shard {
+    std::atomic<uintb> count;	///< Amount added by threads using \b this shard
+    uintb mark;			///< Value of \b count at the last call to takeLocal()
+  };
+  static const int4 numshards = 16;	///< Number of shards
+  Shard shards[numshards];		///< The shards
+  static int4 threadShard(void);	///< Get the shard index of the current thread
+public:
+  ShardedCounter(void);			///< Construct a zero count
+  void add(uintb n) { shards[threadShard()].count.fetch_add(n,std::memory_order_relaxed); }	///< Add to the count
+  uintb total(void) const;		///< Get the sum over all shards
+  uintb takeLocal(void);		///< Get the amount the current thread's shard gained since its last call
+};
+
 /// \brief Class for collecting statistics while processing over multiple functions
 ///
 /// As Funcdata objects are transformed, they get fed to the process() method
 /// to accumulate statistics over the whole run.  Results are printed with printResults()
+/// The counts can be updated from multiple threads at once.
 class Statistics {
-  uintb numfunc;		///< Number of functions processed
+  std::atomic<uintb> numfunc;	///< Number of functions processed
   uintb numvar;			///< Number of Varnodes analyzed
   uintb coversum;		///< Number of Varnodes with non-empty covers
   uintb coversumsq;		///< Internal sum for variance of coversum
-  uintb lastcastcount;		///< Number of casts since processing last function
-  uintb castcount;		///< Total number of casts
-  uintb castcountsq;		///< Internal sum for variance of castcount
+  ShardedCounter castcount;	///< Total number of casts
+  std::atomic<uintb> castcountsq;	///< Internal sum for variance of castcount
   //void process_cover(const Funcdata &data);
   void process_cast(const Funcdata &data);	///< Count casts for function
 public:
   Statistics(void);		///< Construct initializing counts
   ~Statistics(void);		///< Destructor
-  void countCast(void) { castcount += 1; }	///< Count a single cast
+  void countCast(void) { castcount.add(1); }	///< Count a single cast
   void process(const Funcdata &fd);	///< Accumulate statistics for one function
   void printResults(ostream &s);	///< Display accumulated statistics
 };
@@ -60,6 +87,10 @@ public:
 #endif
 
 class Architecture;
+class JumpTableCache;
+class ResultCache;
+class FlowSummaryDb;
+class InstructionIndex;
 
 /// \brief Abstract extension point for building Architecture objects
 ///
@@ -109,6 +140,44 @@ public:
   static uint4 getMinorVersion(void) { return minorversion; }		///< Get \e minor decompiler version
 };
 
+/// \brief Thrown when the analysis of a function is stopped by an AnalysisInterrupt
+struct AnalysisCancelled : public LowlevelError {
+  AnalysisCancelled(const string &s) : LowlevelError(s) {}	///< Constructor
+};
+
+/// \brief A request, from outside the analysis, to stop or pause decompiling
+///
+/// While attached to an Architecture (see Architecture::interrupt), it is checked at the start of
+/// every Action::perform() and before each PcodeOp an ActionPool visits.  Once cancel() has been
+/// called, from any thread, the next check throws AnalysisCancelled, and whoever catches it should
+/// clear the partial analysis of the function.  Once requestYield() has been called, the next check
+/// calls yield(), which a derived class can override to give up its thread for a while, so that
+/// other work can be interleaved with a long analysis.
+class AnalysisInterrupt {
+  std::atomic<bool> cancelled;		///< Set if the analysis should stop
+  std::atomic<bool> yieldrequest;	///< Set if the analysis should call yield()
+protected:
+  /// \brief Let other work run before the analysis continues
+  ///
+  /// The default just drops the request.
+  virtual void yield(void) { clearYield(); }
+  void clearYield(void) { yieldrequest.store(false,std::memory_order_relaxed); }	///< Drop any request to yield
+public:
+  AnalysisInterrupt(void) : cancelled(false), yieldrequest(false) {}	///< Construct with no requests
+  virtual ~AnalysisInterrupt(void) {}				///< Destructor
+  void cancel(void) { cancelled.store(true,std::memory_order_relaxed); }	///< Ask the analysis to stop
+  void clearCancel(void) { cancelled.store(false,std::memory_order_relaxed); }	///< Drop any request to stop
+  bool isCancelled(void) const { return cancelled.load(std::memory_order_relaxed); }	///< Has the analysis been asked to stop
+  void requestYield(void) { yieldrequest.store(true,std::memory_order_relaxed); }	///< Ask the analysis to yield
+  /// \brief Act on any request: throw if cancelled, or yield if asked to
+  void check(void) {
+    if (cancelled.load(std::memory_order_relaxed))
+      throw AnalysisCancelled("Decompilation cancelled");
+    if (yieldrequest.load(std::memory_order_relaxed))
+      yield();
+  }
+};
+
 /// \brief Manager for all the major decompiler subsystems
 ///
 /// An instantiation is tailored to a specific LoadImage,
@@ -131,6 +200,12 @@ public:
   uintb pointer_lowerbound;	///< Zero or lowest value that can be inferred as an address
   int4 funcptr_align;		///< How many bits of alignment a function ptr has
   uint4 flowoptions;            ///< options passed to flow following engine
+  uint4 budget_millis;		///< Milliseconds of analysis allowed per function (0 for no limit)
+  uint4 budget_rules;		///< Rule applications allowed per function (0 for no limit)
+  uint4 pool_partition;		///< Smallest function (in PcodeOps) whose ActionPool passes are partitioned by block (0 for never)
+  uint4 flow_op_budget;		///< Raw p-code ops a function may generate before flow is cut into regions (0 for no limit)
+  uint4 heritage_threads;	///< Threads computing MULTIEQUAL placement for a heritage pass (1 for no extra threads)
+  bool release_analysis;	///< Free all storage of a function's analysis after a batch decompile
   vector<Rule *> extra_pool_rules; ///< Extra rules that go in the main pool (cpu specific, experimental)
 
   Database *symboltab;		///< Memory map of global variables and functions
@@ -154,6 +229,12 @@ public:
   UserOpManage userops;		///< Specifically registered user-defined p-code ops
   vector<PreferSplitRecord> splitrecords; ///< registers that we would prefer to see split for this processor
   ActionDatabase allacts;	///< Actions that can be applied in this architecture
+  JumpTableCache *jumpcache;	///< Jump-tables kept for incremental re-decompilation (null if disabled)
+  ResultCache *resultcache;	///< Cache of decompiler output (null if disabled)
+  FlowSummaryDb *flowsummary;	///< Prototypes of common functions, by their bytes (null if disabled)
+  ExtraPopMemo extrapopmemo;	///< Stack-pointer changes recovered for sub-functions
+  InstructionIndex *insnindex;	///< Instructions decoded while tracing flow in parallel (null until needed)
+  AnalysisInterrupt *interrupt;	///< Requests to stop or pause the analysis in progress (may be null)
   bool loadersymbols_parsed;	///< True if loader symbols have been read
 #ifdef CPUI_STATISTICS
   Statistics *stats;		///< Statistics collector
@@ -169,6 +250,12 @@ public:
   AddrSpace *getSpaceBySpacebase(const Address &loc,int4 size) const; ///< Get space associated with a \e spacebase register
   void setDefaultModel(const string &nm);		///< Set the default PrototypeModel
   void clearAnalysis(Funcdata *fd);			///< Clear analysis specific to a function
+  void checkInterrupt(void) { if (interrupt != (AnalysisInterrupt *)0) interrupt->check(); }	///< Act on any request to stop or pause
+  void releaseAnalysis(Funcdata *fd);			///< Clear analysis of a function and free its storage
+  void setIncremental(bool val,const string &file);	///< Toggle reuse of analysis across re-decompilation
+  void setResultCache(bool val,const string &dir);	///< Toggle caching of decompiler output
+  void setSharedResultCache(const string &file,uint8 size);	///< Cache decompiler output in a store shared between processes
+  void setFlowSummary(const string &file);		///< Use a database of function summaries
   void readLoaderSymbols(void);		 		///< Read any symbols from loader into database
   void collectBehaviors(vector<OpBehavior *> &behave) const;	///< Provide a list of OpBehavior objects
   bool hasNearPointers(AddrSpace *spc) const;		///< Does the given address space support \e near pointers
@@ -188,6 +275,13 @@ public:
   virtual void saveXml(ostream &s) const;		///< Serialize this architecture to XML
   virtual void restoreXml(DocumentStorage &store);	///< Restore the Architecture state from an XML stream
   virtual void nameFunction(const Address &addr,string &name) const;	///< Pick a default name for a function
+  /// \brief Anticipate the data needed to analyze a function whose control-flow is now known
+  ///
+  /// This is called once the raw p-code and basic blocks of a function have been generated.
+  /// An implementation that fetches data from a remote client can request what it knows will be
+  /// needed later in one batch.  The default does nothing.
+  /// \param fd is the function
+  virtual void prefetchFunction(const Funcdata &fd) {}
 #ifdef OPACTION_DEBUG
   void setDebugStream(ostream *s) { debugstream = s; }	///< Establish the debug console stream
   void printDebug(const string &message) const { *debugstream << message << endl; }	///< Print message to the debug stream
@@ -0,0 +1,296 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file batch.hh
+/// \brief Decompiling many functions on a pool of worker threads, scheduled over the call graph
+#ifndef __CPUI_BATCH__
+#define __CPUI_BATCH__
+
+#include "callgraph.hh"
+#include "funcdata.hh"
+#include "insnindex.hh"
+
+#include <queue>
+#include <deque>
+#include <thread>
+#include <fstream>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+
+namespace GhidraDec {
+
+/// \brief State owned by a single worker thread of a BatchDecompiler
+///
+/// Each worker gets a private clone of the current \e root Action, so Action and Rule
+/// iteration state is never shared between threads.  The clone shares the Rules that keep no
+/// state of their own with the \e universal Action, which makes it quick to build.  The worker
+/// also accumulates simple statistics about the functions it has processed.
+class BatchWorker {
+  friend class BatchDecompiler;
+  int4 index;			///< Index of \b this worker within the pool
+  Action *root;			///< Private clone of the root Action
+  int4 numdecompiled;		///< Number of functions successfully decompiled
+  int4 numfailed;		///< Number of functions that threw an error
+  double seconds;		///< Wall-clock time spent processing functions
+public:
+  BatchWorker(int4 i,Action *r);	///< Construct given an index and a cloned root Action
+  ~BatchWorker(void);			///< Destructor
+  int4 getIndex(void) const { return index; }		///< Get the index of \b this worker
+  Action *getRoot(void) const { return root; }		///< Get the worker's private root Action
+  int4 getNumDecompiled(void) const { return numdecompiled; }	///< Get number of functions decompiled
+  int4 getNumFailed(void) const { return numfailed; }	///< Get number of functions that failed
+  double getSeconds(void) const { return seconds; }	///< Get time spent processing (in seconds)
+};
+
+/// \brief Weights used to predict how long each function of a batch takes to process
+///
+/// The predicted cost of a function is a weighted sum of counts that are available before it
+/// is decompiled: the instructions and basic blocks reachable from its entry point and the
+/// indirect branches among them, taken from the Architecture's InstructionIndex, and the
+/// number of calls it makes in the CallGraph.  Indirect branches are weighted heavily, as
+/// each one may need jump-table recovery.  The unit is arbitrary; only the ratios of costs
+/// matter to the schedule.  BatchDecompiler::printStatistics() reports how well the
+/// predictions matched the measured times, so the weights can be tuned.
+struct BatchCostModel {
+  double insn;			///< Weight of each instruction
+  double block;			///< Weight of each basic block
+  double indirect;		///< Weight of each indirect branch
+  double call;			///< Weight of each call made by the function
+  BatchCostModel(void) { insn = 1.0; block = 4.0; indirect = 200.0; call = 8.0; }	///< Construct with the default weights
+};
+
+/// \brief Decompile every function in a CallGraph using a pool of worker threads
+///
+/// Functions are released to the workers \e leaves-first: a function becomes ready only
+/// after all of its callees have been processed, so callee prototypes are available before
+/// their callers are decompiled.  The dependencies are read from a CallGraphCsr of the graph:
+/// a call from one strongly connected component to another always counts, and within a
+/// component, only calls along edges that were not snipped to break a cycle count.
+/// If these dependencies don't matter, because prototypes are already locked for instance,
+/// setDependencies() can turn them off, and every function is ready from the start.
+///
+/// Among the ready functions, a worker takes the one heading the longest chain of predicted
+/// work: its own cost (see BatchCostModel) plus the most expensive chain of callers waiting
+/// on it.  This starts the large functions, and the callees holding them back, as early as
+/// possible, so a few large functions don't run alone at the end of the batch.
+///
+/// The Architecture (symbol table, translator, types, etc.) is shared by all workers. Any
+/// access to it from a worker must hold the reader-writer lock returned by getArchLock().
+/// Running an Action, or anything else that may modify the Architecture, needs exclusive
+/// ownership, and the default processFunction() holds the lock exclusively while running the
+/// worker's root Action.  Read-only queries may share the lock with other readers: the symbol
+/// queries of a Scope (queryByAddr(), queryContainer(), queryFunction(), findFunction(), etc.)
+/// and the data-type look-ups of TypeFactory (findById(), findByName(), findNoName()).
+/// Before the workers start, run() creates any Symbols whose restore from XML was put off, so
+/// these queries don't modify the Scope they search.
+/// Derived classes can override finishFunction() to consume the results of each decompile,
+/// which is also called with the Architecture lock held.
+///
+/// On machines with several sockets, setPinWorkers() binds worker \e i to the \e i-th CPU the
+/// process may run on (wrapping around), so each worker's memory, which it allocates and first
+/// touches itself, stays on its own NUMA node.  This pairs with the per-thread regions of
+/// SlabArena, which keep the workers' small objects apart and can be backed by huge pages.
+class BatchDecompiler {
+  /// \brief A single function scheduled for decompilation
+  struct BatchItem {
+    Funcdata *fd;		///< The function
+    int4 pending;		///< Number of callees still to be processed
+    vector<int4> callers;	///< Indices of items waiting on \b this
+    int4 layer;			///< Layer of the function in the CallGraphCsr of the call graph
+    FlowMeasure measure;	///< Sizes of the function's flow, as known before decompiling
+    int4 numcalls;		///< Number of calls made by the function
+    double cost;		///< Predicted cost of processing the function
+    double rank;		///< Predicted cost of the longest chain of items starting with \b this
+    double seconds;		///< Time taken to process the function
+  };
+  Architecture *glb;		///< The Architecture owning all the functions
+  CallGraph *graph;		///< The call graph driving the schedule
+  int4 numworkers;		///< Number of worker threads to launch
+  ostream *logstream;		///< Stream for progress messages (may be null)
+  BatchCostModel costmodel;	///< Weights used to predict the cost of each function
+  bool dependencies;		///< Set if callers wait for their callees to be processed
+  bool pinworkers;		///< Set if each worker thread is bound to a single CPU
+  vector<int4> cpus;		///< CPUs the calling thread could run on when the run started
+  vector<BatchItem> items;	///< All functions to process, by layer then address
+  vector<BatchWorker *> workers;	///< The worker pool
+  priority_queue<pair<double,int4> > ready;	///< Items whose callees have all been processed, by rank
+  int4 numremaining;		///< Number of items not yet completed
+  std::mutex queuelock;		///< Guards \b ready and the pending counts
+  std::condition_variable queuecond;	///< Signaled when new items become ready
+  std::shared_mutex archlock;	///< Guards the Architecture shared by all workers (shared by readers)
+  std::mutex loglock;		///< Serializes messages to \b logstream
+  void measureItem(BatchItem &item,CallGraphNode *node) const;	///< Predict the cost of processing a function
+  void rankItems(void);		///< Compute the rank of every item from the costs and dependencies
+  void buildSchedule(void);	///< Collect functions and their dependencies from the call graph
+  int4 nextItem(void);		///< Block until an item is ready, then claim it
+  void completeItem(int4 i);	///< Mark an item as processed, releasing its callers
+  void runWorker(BatchWorker *worker);	///< Main loop for a single worker thread
+  void clearWorkers(void);	///< Free the worker pool
+protected:
+  void log(const string &message);	///< Emit a progress message (thread-safe)
+  Architecture *getArch(void) const { return glb; }	///< Get the Architecture owning the functions
+  virtual Action *buildRoot(void) const;	///< Build the private root Action for a new worker
+  virtual void processFunction(Funcdata *fd,BatchWorker &worker);
+  /// \brief Consume the results of decompiling a single function
+  ///
+  /// This is called from the worker thread, with the Architecture lock held, after the root
+  /// Action has completed and before the analysis of the function is cleared.
+  /// \param fd is the decompiled function
+  /// \param worker is the worker that did the decompiling
+  virtual void finishFunction(Funcdata *fd,BatchWorker &worker) {}
+public:
+  BatchDecompiler(Architecture *g,CallGraph *cg,int4 num);	///< Constructor
+  virtual ~BatchDecompiler(void);		///< Destructor
+  void setLogStream(ostream *s) { logstream = s; }	///< Set the stream for progress messages
+  BatchCostModel &getCostModel(void) { return costmodel; }	///< Get the weights used to predict costs
+  void setDependencies(bool val) { dependencies = val; }	///< Toggle whether callers wait for their callees
+  void setPinWorkers(bool val) { pinworkers = val; }	///< Toggle whether each worker is bound to its own CPU
+  std::shared_mutex &getArchLock(void) { return archlock; }	///< Get the lock guarding the shared Architecture
+  int4 numFunctions(void) const { return items.size(); }	///< Get number of functions scheduled by the last run()
+  double totalSeconds(void) const;		///< Get the time all workers spent processing functions
+  void run(void);				///< Decompile all functions in the call graph
+  void printStatistics(ostream &s) const;	///< Print per-worker statistics for the last run()
+  void printCostReport(ostream &s) const;	///< Print the predicted and measured cost of each function
+  void mergeStatistics(Action *target) const;	///< Add the Action statistics of every worker into a root Action
+};
+
+/// \brief A writer thread copying printed functions to disk while decompiling continues
+///
+/// The text of each function is handed over with push(), which moves it into a bounded queue
+/// and only waits if the queue is full, so the decompiling threads don't stall on the disk.
+/// The writer thread either appends every function to a single file, coalescing them into
+/// large sequential writes, or writes each function to its own file in a directory.  Any
+/// failure writing is held until close(), which reports it.
+class OutputWriter {
+  /// \brief The printed text of one function waiting to be written
+  struct Chunk {
+    string name;		///< Name of the file, for per-function output
+    string text;		///< The text to write
+  };
+  static const int4 buffersize = 1 << 20;	///< Bytes collected before each write to a single file
+  int4 maxqueue;		///< Most chunks waiting to be written before push() blocks
+  bool splitfiles;		///< \b true if each function gets its own file
+  string target;		///< The single file, or the directory (ending in a separator) for split files
+  std::ofstream archive;	///< The single file being written
+  string buffer;		///< Text collected for the next write to the single file
+  std::deque<Chunk> queue;	///< Chunks waiting to be written
+  std::mutex lock;		///< Lock protecting the queue and the \b done flag
+  std::condition_variable ready;	///< Signaled when a chunk is queued, or when no more will be
+  std::condition_variable space;	///< Signaled when a chunk leaves the queue
+  bool done;			///< Set when no more chunks will be queued
+  bool running;			///< Set while the writer thread exists
+  std::thread writer;		///< The writer thread
+  int4 numwritten;		///< Number of chunks written
+  uint8 numbytes;		///< Number of bytes written
+  string error;			///< Description of the first failed write, if any
+  void writeLoop(void);		///< Main loop of the writer thread
+  void writeChunk(Chunk &chunk);	///< Write (or collect) one chunk
+  void flushBuffer(void);	///< Write the collected text to the single file
+  void stop(void);		///< Drain the queue and join the writer thread
+public:
+  OutputWriter(int4 maxq);	///< Construct a writer that is not open
+  ~OutputWriter(void) { stop(); }	///< Destructor
+  void open(const string &nm,bool split);	///< Start writing to a file or a directory
+  void push(const string &name,string &text);	///< Queue the text of one function
+  void close(void);		///< Write everything queued and report any failure
+  bool isSplit(void) const { return splitfiles; }	///< Return \b true if each function gets its own file
+  int4 numWritten(void) const { return numwritten; }	///< Get the number of functions written
+  uint8 numBytes(void) const { return numbytes; }	///< Get the number of bytes written
+  static string fileName(const Funcdata *fd);	///< Get a file name for the text of a function
+};
+
+/// \brief Decompile functions on a pool of worker threads and print them in address order
+///
+/// Each function is printed, as soon as it has been decompiled, with the PrintLanguage of the
+/// Architecture into a separate chunk of text.  After the run, write() emits the chunks ordered
+/// by the address of their function, so the output doesn't depend on which worker finished first.
+/// The printing is done in finishFunction(), with the Architecture lock held, as the emitter reads
+/// the symbol table and data-types that other workers are modifying.  Output to a file per
+/// function doesn't need ordering, so with a writer set (see setWriter()), each function goes
+/// straight to the writer instead of being held for write().
+class BatchPrinter : public BatchDecompiler {
+  map<Address,string> chunks;	///< Printed text of each function, by address
+  OutputWriter *writer;		///< Writer taking each function as soon as it is printed (if not null)
+  int4 numprinted;		///< Number of functions printed
+protected:
+  virtual void finishFunction(Funcdata *fd,BatchWorker &worker);
+public:
+  BatchPrinter(Architecture *g,CallGraph *cg,int4 num) : BatchDecompiler(g,cg,num) { writer = (OutputWriter *)0; numprinted = 0; }	///< Constructor
+  void setWriter(OutputWriter *w) { writer = w; }	///< Hand functions to a writer as they finish
+  int4 numPrinted(void) const { return numprinted; }	///< Get the number of functions printed
+  void write(ostream &s) const;		///< Write the printed functions in address order
+  void write(OutputWriter &out);	///< Hand the printed functions to a writer in address order
+  void clearChunks(void) { chunks.clear(); numprinted = 0; }	///< Release the printed text
+};
+
+/// \brief Recover and lock the prototype of every function, callees before callers
+///
+/// Each function is analyzed with a root Action that recovers parameters and the return value,
+/// by default \e protoonly, and the resulting prototype is locked.  Because
+/// the schedule releases a function only after its callees, every call site sees the locked
+/// prototype of its callee, and a later full decompilation of a caller doesn't restart to
+/// revise what it assumed about the callee.  Functions in a cycle are ordered by the edges
+/// CallGraph snipped to break the cycle.  Functions whose prototype is already locked are
+/// left alone.
+class BatchPrototypes : public BatchDecompiler {
+  string rootname;		///< Name of the root Action used to recover prototypes
+  int4 numlocked;		///< Number of prototypes locked by the last run()
+  int4 numskipped;		///< Number of functions that already had a locked prototype
+protected:
+  virtual Action *buildRoot(void) const;
+  virtual void processFunction(Funcdata *fd,BatchWorker &worker);
+  virtual void finishFunction(Funcdata *fd,BatchWorker &worker);
+public:
+  BatchPrototypes(Architecture *g,CallGraph *cg,int4 num);	///< Constructor
+  void setRootName(const string &nm) { rootname = nm; }	///< Set the root Action used to recover prototypes
+  int4 numLocked(void) const { return numlocked; }	///< Get the number of prototypes the last run() locked
+  int4 numSkipped(void) const { return numskipped; }	///< Get the number of functions that were already locked
+  void run(void);				///< Recover and lock the prototypes of all functions
+};
+
+/// \brief Recovered prototypes passed between processes that each analyze part of a CallGraph
+///
+/// A large program can be split with CallGraph::partition() and the partitions handed to
+/// separate decompiler processes, each with the same load image and specification.  A process
+/// analyzing a partition first applies the prototypes recovered for the callees in earlier
+/// rounds, runs BatchPrototypes over its partition, then collects the prototypes it locked.
+/// The coordinator restores the results of every partition of a round, in partition order,
+/// and saves the merged set for the next round.
+///
+/// Prototypes are held by the entry point of their function and saved in address order, and
+/// when two sets hold a prototype for the same function the one restored first is kept, so the
+/// merged set doesn't depend on the order in which the partitions finished.  Data-types are
+/// saved by reference, so any type a prototype uses beyond the core types must also be known
+/// to the receiving process.
+class PrototypeExchange {
+  Architecture *glb;			///< The Architecture owning the functions
+  map<Address,FuncProto *> protos;	///< Stand-alone copies of the prototypes, by function address
+  void insert(const Address &addr,FuncProto *proto);	///< Add a prototype unless one is already held
+public:
+  PrototypeExchange(Architecture *g) { glb = g; }	///< Construct an empty set
+  ~PrototypeExchange(void) { clear(); }		///< Destructor
+  int4 size(void) const { return protos.size(); }	///< Get the number of prototypes held
+  bool record(const Funcdata *fd);		///< Take a copy of the locked prototype of a function
+  int4 collect(CallGraph *graph);		///< Take a copy of every locked prototype in a call graph
+  int4 apply(void) const;			///< Lock each prototype onto its function
+  void saveXml(ostream &s) const;		///< Save the prototypes as a \<prototypes> tag
+  void restoreXml(const Element *el);		///< Add the prototypes of a \<prototypes> tag
+  void clear(void);				///< Release all the prototypes
+};
+
+} // namespace GhidraDec
+
+#endif
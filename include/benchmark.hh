@@ -0,0 +1,97 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file benchmark.hh
+/// \brief Timing the decompiler over a corpus of load images, with microbenchmarks of hot components
+#ifndef __CPUI_BENCHMARK__
+#define __CPUI_BENCHMARK__
+
+#include "funcdata.hh"
+#include "blockaction.hh"
+
+namespace GhidraDec {
+
+/// \brief Accumulated times of the microbenchmarks over the functions of one image
+struct MicroTimes {
+  uint8 liftnanos;		///< Nanoseconds spent in Translate::oneInstruction()
+  uint8 liftcount;		///< Number of instructions translated
+  uint8 lengthnanos;		///< Nanoseconds spent in Translate::instructionLength()
+  uint8 flownanos;		///< Nanoseconds spent in Translate::instructionFlow()
+  uint8 covernanos;		///< Nanoseconds spent in Cover::intersect()
+  uint8 covercount;		///< Number of Cover pairs intersected
+  uint8 printnanos;		///< Nanoseconds spent emitting C code
+  uint8 printcount;		///< Number of functions emitted
+  uint8 summarynanos;		///< Nanoseconds spent writing a FunctionSummary
+  uint8 summarycount;		///< Number of functions summarized
+  MicroTimes(void) { liftnanos = liftcount = lengthnanos = flownanos = covernanos = covercount = printnanos = printcount = summarynanos = summarycount = 0; }	///< Constructor
+};
+
+/// \brief Decompile every function of a set of load images and report how long it took
+///
+/// Each image is loaded through its ArchitectureCapability (typically an XML image of the
+/// kind saved by the console), and every function with code is decompiled with the chosen
+/// \e root Action.  Results are written as CSV records of the form
+///
+///     kind,image,name,value
+///
+/// where \e kind is one of:
+///   - \b decompile  totals for the image: functions, failures, p-code ops, seconds, ops per second
+///   - \b phase      milliseconds spent in each Action (from Action timing), by path from the root
+///   - \b micro      per-operation nanoseconds of the microbenchmarks
+///   - \b structure  seconds to structure a synthetic control-flow graph, through the XML of the
+///                   StructureGraph command and through the edge list of EdgeListStructure
+///   - \b prettyprint seconds to pretty print a generated pathological token stream, and the number
+///                   of tokens the EmitPrettyPrint queue grew to hold, with and without a lookahead limit
+///   - \b batch      seconds, functions per second and speedup over the first run, when each image is
+///                   also decompiled by a BatchDecompiler for each of a list of thread counts
+///   - \b process    process-wide numbers, such as the peak resident set size in kilobytes, the
+///                   sizes of Varnode and PcodeOp objects, and the regions mapped by SlabArena
+///
+/// The microbenchmarks repeat Translate::oneInstruction() over the instructions of each function,
+/// along with the length-only decodes Translate::instructionLength() and Translate::instructionFlow(),
+/// Cover::intersect() over pairs of its HighVariables, and the emission of its C code
+/// (through the EmitPrettyPrint of the Architecture), \b reps times each.  The FunctionSummary
+/// of the function is timed alongside the emission, as the cost of output without the printer.  Heritage and Merge
+/// are timed in place, as the total time of their Actions.
+class DecompilerBenchmark {
+  ostream &out;			///< Stream receiving the CSV records
+  string rootname;		///< Name of the root Action to decompile with
+  int4 reps;			///< Number of repetitions of each microbenchmark
+  bool micro;			///< Set if microbenchmarks are run
+  vector<int4> batchthreads;	///< Thread counts to run a BatchDecompiler with, for each image
+  bool pinworkers;		///< Set if batch workers are bound to their own CPUs
+  void record(const string &kind,const string &image,const string &name,double value);
+  void collectFunctions(Scope *scope,vector<Funcdata *> &res) const;
+  void benchLift(Funcdata *fd,MicroTimes &times) const;
+  void benchCover(Funcdata *fd,MicroTimes &times) const;
+  void benchPrint(Funcdata *fd,MicroTimes &times) const;
+  void benchSummary(Funcdata *fd,MicroTimes &times) const;
+  void benchBatch(Architecture *glb,const string &image);
+  void reportPhases(Action *root,const string &image);
+  static uint8 sumActionTime(Action *root,const char **names);
+public:
+  DecompilerBenchmark(ostream &s,const string &root,int4 r,bool m);	///< Constructor
+  static void printHeader(ostream &s);		///< Print the header line of the CSV records
+  void setBatch(const vector<int4> &threads,bool pin) { batchthreads = threads; pinworkers = pin; }	///< Set the batch runs made for each image
+  void runImage(const string &filename);	///< Load and decompile every function of one image
+  void runStructure(int4 numnodes);		///< Time the structuring of a synthetic control-flow graph
+  void runPrettyPrint(int4 depth);		///< Time the pretty printer on deeply nested groups
+  void runXmlParse(const string &filename);	///< Time the parsing of an XML file, such as a .sla
+  void finish(void);				///< Report process-wide results
+  static long peakResidentKb(void);		///< Get the peak resident set size of the process
+};
+
+}
+#endif
@@ -267,6 +267,14 @@ public:
 /// with its own input and output blocks.
 /// All the code structuring elements (BlockList, BlockIf, BlockWhileDo, etc.) derive from this.
 class BlockGraph : public FlowBlock {
+public:
+  /// \brief Algorithms for computing dominators
+  enum dominator_algorithm {
+    dom_iterative = 0,		///< Iterative data-flow algorithm of Cooper, Harvey, and Kennedy
+    dom_semi_nca = 1		///< Semi-NCA variant of Lengauer-Tarjan
+  };
+private:
+  static dominator_algorithm domalgorithm;	///< Algorithm used by calcForwardDominator()
   vector<FlowBlock *> list;     	///< List of FlowBlock components within \b this super-block
   void addBlock(FlowBlock *bl);		///< Add a component FlowBlock
   void forceOutputNum(int4 i);		///< Force number of outputs
@@ -276,12 +284,15 @@ class BlockGraph : public FlowBlock {
   static FlowBlock *createVirtualRoot(const vector<FlowBlock *> &rootlist);
   void findSpanningTree(vector<FlowBlock *> &preorder,vector<FlowBlock *> &rootlist);
   bool findIrreducible(const vector<FlowBlock *> &preorder,int4 &irreduciblecount);
+  static void calcDominatorIterative(const vector<FlowBlock *> &postorder,int4 numnodes);
+  static void calcDominatorSemiNCA(const vector<FlowBlock *> &postorder,int4 numnodes);
   void forceFalseEdge(const FlowBlock *out0);	///< Force the \e false out edge to go to the given FlowBlock
 protected:
   void swapBlocks(int4 i,int4 j);	///< Swap the positions two component FlowBlocks
   static void markCopyBlock(FlowBlock *bl,uint4 fl);	///< Set properties on the first leaf FlowBlock
 public:
   void clear(void);					///< Clear all component FlowBlock objects
+  uint8 memoryEstimate(void) const;			///< Estimate the bytes of heap used by \b this and its components
   virtual ~BlockGraph(void) { clear(); }		///< Destructor
   const vector<FlowBlock *> &getList(void) const { return list; }	///< Get the list of component FlowBlock objects
   int4 getSize(void) const { return list.size(); }	///< Get the number of components
@@ -312,6 +323,7 @@ public:
   FlowBlock *getStartBlock(void) const;		///< Get the entry point FlowBlock
 				// Factory functions
   FlowBlock *newBlock(void);							///< Build a new plain FlowBlock
+  FlowBlock *newBlock(int4 ind);						///< Build a new plain FlowBlock with the given index
   BlockBasic *newBlockBasic(Funcdata *fd);					///< Build a new BlockBasic
 
 				// Factory (identify) routines
@@ -333,6 +345,8 @@ public:
   void buildCopy(const BlockGraph &graph);					///< Build a copy of a BlockGraph
   void clearVisitCount(void);							///< Clear the visit count in all node FlowBlocks
   void calcForwardDominator(const vector<FlowBlock *> &rootlist);		///< Calculate forward dominators
+  static void setDominatorAlgorithm(dominator_algorithm alg) { domalgorithm = alg; }	///< Select the dominator algorithm
+  static dominator_algorithm getDominatorAlgorithm(void) { return domalgorithm; }	///< Get the dominator algorithm in use
   void buildDomTree(vector<vector<FlowBlock *> > &child) const;			///< Build the dominator tree
   int4 buildDomDepth(vector<int4> &depth) const;				///< Calculate dominator depths
   void buildDomSubTree(vector<FlowBlock *> &res,FlowBlock *root) const;		///< Collect nodes from a dominator sub-tree
@@ -361,10 +375,10 @@ public:
 /// PcodeOps my migrate away from this original range.
 class BlockBasic: public FlowBlock {
   friend class Funcdata;				// Only uses private functions
-  list<PcodeOp *> op;					///< The sequence of p-code operations
+  PcodeOpList op;					///< The sequence of p-code operations
   Funcdata *data;					///< The function of which this block is a part
   RangeList cover;					///< Original range of addresses covered by this basic block
-  void insert(list<PcodeOp *>::iterator iter,PcodeOp *inst);	///< Insert p-code operation at a given position
+  void insert(PcodeOpList::iterator iter,PcodeOp *inst);	///< Insert p-code operation at a given position
   void setInitialRange(const Address &beg,const Address &end);	///< Set the initial address range of the block
   void copyRange(const BlockBasic *bb) { cover = bb->cover; }	///< Copy address ranges from another basic block
   void mergeRange(const BlockBasic *bb) { cover.merge(bb->cover); }	///< Merge address ranges from another basic block
@@ -372,9 +386,12 @@ class BlockBasic: public FlowBlock {
   void removeOp(PcodeOp *inst);				///< Remove PcodeOp from \b this basic block
 public:
   BlockBasic(Funcdata *fd) { data = fd; }		///< Construct given the underlying function
+  static void *operator new(size_t size) { return ObjectPool<BlockBasic>::allocate(size); }	///< Allocate from the BlockBasic pool
+  static void operator delete(void *ptr,size_t size) { ObjectPool<BlockBasic>::release(ptr,size); }	///< Return storage to the BlockBasic pool
   Funcdata *getFuncdata(void) { return data; }		///< Return the underlying Funcdata object
   const Funcdata *getFuncdata(void) const { return (const Funcdata *)data; }	///< Return the underlying Funcdata object
   bool contains(const Address &addr) const { return cover.inRange(addr, 1); }	///< Determine if the given address is contained in the original range
+  const RangeList &getCover(void) const { return cover; }	///< Get the original range of addresses covered by \b this block
   Address getEntryAddr(void) const;			///< Get the address of the (original) first operation to execute
   virtual Address getStart(void) const;
   virtual Address getStop(void) const;
@@ -395,11 +412,12 @@ public:
   bool unblockedMulti(int4 outslot) const;		///< Check if \b this block can be removed without introducing inconsistencies
   bool hasOnlyMarkers(void) const;		///< Does \b this block contain only MULTIEQUAL and INDIRECT ops
   bool isDoNothing(void) const;			///< Should \b this block should be removed
-  list<PcodeOp *>::iterator beginOp(void) { return op.begin(); }	///< Return an iterator to the beginning of the PcodeOps
-  list<PcodeOp *>::iterator endOp(void) { return op.end(); }		///< Return an iterator to the end of the PcodeOps
-  list<PcodeOp *>::const_iterator beginOp(void) const { return op.begin(); }	///< Return an iterator to the beginning of the PcodeOps
-  list<PcodeOp *>::const_iterator endOp(void) const { return op.end(); }	///< Return an iterator to the end of the PcodeOps
+  PcodeOpList::iterator beginOp(void) { return op.begin(); }	///< Return an iterator to the beginning of the PcodeOps
+  PcodeOpList::iterator endOp(void) { return op.end(); }		///< Return an iterator to the end of the PcodeOps
+  PcodeOpList::const_iterator beginOp(void) const { return op.begin(); }	///< Return an iterator to the beginning of the PcodeOps
+  PcodeOpList::const_iterator endOp(void) const { return op.end(); }	///< Return an iterator to the end of the PcodeOps
   bool emptyOp(void) const { return op.empty(); }		///< Return \b true if \b block contains no operations
+  int4 sizeOp(void) const { return op.size(); }			///< Get the number of PcodeOps in \b this block
   static bool noInterveningStatement(PcodeOp *first,int4 path,PcodeOp *last);
 };
 
@@ -417,6 +435,8 @@ class BlockCopy : public FlowBlock {
   FlowBlock *copy;			///< The block being mirrored by \b this (usually a BlockBasic)
 public:
   BlockCopy(FlowBlock *bl) { copy = bl; }	///< Construct given the block to copy
+  static void *operator new(size_t size) { return ObjectPool<BlockCopy>::allocate(size); }	///< Allocate from the BlockCopy pool
+  static void operator delete(void *ptr,size_t size) { ObjectPool<BlockCopy>::release(ptr,size); }	///< Return storage to the BlockCopy pool
   virtual FlowBlock *subBlock(int4 i) const { return copy; }
   virtual block_type getType(void) const { return t_copy; }
   virtual void printHeader(ostream &s) const;
@@ -38,6 +38,8 @@ public:
   FlowBlock *getCurrentEdge(int4 &outedge,FlowBlock *graph);	///< Get the current form of the edge
 };
 
+class LoopForest;
+
 /// \brief A description of the body of a loop.
 ///
 /// Following Tarjan, assuming there are no \e irreducible edges, a loop body is defined
@@ -58,12 +60,14 @@ public:
   FlowBlock *getCurrentBounds(FlowBlock **top,FlowBlock *graph);	///< Return current loop bounds (\b head and \b bottom).
   void addTail(FlowBlock *bl) { tails.push_back(bl); }			///< Add a \e tail to the loop
   FlowBlock *getExitBlock(void) const { return exitblock; }		///< Get the exit FlowBlock or NULL
+  const vector<FlowBlock *> &getTails(void) const { return tails; }	///< Get the \e tails of the loop
   void findBase(vector<FlowBlock *> &body);				///< Mark the body FlowBlocks of \b this loop
   void extend(vector<FlowBlock *> &body) const;				///< Extend body (to blocks that never exit)
-  void findExit(const vector<FlowBlock *> &body);			///< Choose the exit block for \b this loop
+  void findExit(const vector<FlowBlock *> &body,const LoopForest &forest);	///< Choose the exit block for \b this loop
   void orderTails(void);						///< Find preferred \b tail
   void labelExitEdges(const vector<FlowBlock *> &body);			///< Label edges that exit the loop
   void labelContainments(const vector<FlowBlock *> &body,const vector<LoopBody *> &looporder);
+  void labelContainments(const LoopForest &forest);			///< Record the containing loop given by the nesting forest
   void emitLikelyEdges(list<FloatingEdge> &likely,FlowBlock *graph);	///< Collect likely \e unstructured edges
   void setExitMarks(FlowBlock *graph);					///< Mark all the exits to this loop
   void clearExitMarks(FlowBlock *graph);				///< Clear the mark on all the exits to this loop
@@ -75,6 +79,35 @@ public:
   static void clearMarks(vector<FlowBlock *> &body);			///< Clear the body marks
 };
 
+/// \brief The nesting of the loops of a control-flow graph
+///
+/// The forest is built in a single pass over the loop heads, innermost first, in the manner of Havlak.
+/// The body of each loop is traced back from its tails, and as nodes are added to the body they
+/// are collapsed into the head with a union-find structure, so the trace of an outer loop steps over
+/// an inner loop in one move.  Every node and edge is examined once, instead of once for every loop
+/// containing it.  All the records are indexed by the position of the FlowBlock in the graph, which
+/// must match FlowBlock::getIndex(), as it does after BlockGraph::structureLoops().
+///
+/// A loop body here agrees with LoopBody::findBase(): it is traced back from the tails through any
+/// edge that isn't \e unstructured and stops at the head.  The forest is valid only if the loops
+/// nest.  If they don't, build() fails, and the loop bodies must be traced individually.
+class LoopForest {
+  bool valid;				///< Set if the forest has been built successfully
+  vector<int4> innermost;		///< Head of the innermost loop containing each node, or -1
+  vector<int4> parent;			///< Head of the loop immediately containing each loop head, or -1
+  vector<int4> depth;			///< Number of loops containing each loop head
+  vector<LoopBody *> headloop;		///< The loop of each loop head, or NULL
+  static int4 findRoot(vector<int4> &rep,int4 i);	///< Find the node a given node has been collapsed into
+public:
+  LoopForest(void) { valid = false; }	///< Construct an empty forest
+  void clear(void);			///< Clear the forest
+  bool build(const BlockGraph &graph,list<LoopBody> &loopbody);	///< Build the forest from the loops of a graph
+  bool isValid(void) const { return valid; }	///< Return \b true if the forest has been built
+  LoopBody *getContainer(const FlowBlock *head) const;		///< Get the loop immediately containing the given loop
+  int4 getDepth(const FlowBlock *head) const { return depth[head->getIndex()]; }	///< Get the number of loops containing the given loop
+  bool contains(const LoopBody *loop,const FlowBlock *bl) const;	///< Is the given FlowBlock in the body of the given loop
+};
+
 /// \brief Algorithm for selecting unstructured edges based an Directed Acyclic Graphs (DAG)
 ///
 /// With the exception of the back edges in loops, structured code tends to form a DAG.
@@ -190,12 +223,16 @@ public:
 ///       - Note the structure element and collapse the component nodes to a single node.
 ///    - If the process gets stuck, remove appropriate edges, marking them as unstructured.
 class CollapseStructure {
+  static const int4 gotobatchstart = 32;	///< Gotos taken from one \e likely list before they are taken in batches
+  static const int4 gotobatchmax = 64;		///< Maximum number of gotos marked in one batch
   bool finaltrace;				///< Have we a made search for unstructured edges in the final DAG
   bool likelylistfull;				///< Have we generated a \e likely \e goto list for the current innermost loop
   list<FloatingEdge> likelygoto;		///< The current \e likely \e goto list
   list<FloatingEdge>::iterator likelyiter;	///< Iterator to the next most \e likely \e goto edge
+  int4 likelytaken;				///< Number of gotos marked from the current \e likely list
   list<LoopBody> loopbody;			///< The list of loop bodies for this control-flow graph
   list<LoopBody>::iterator loopbodyiter;	///< Current (innermost) loop being structured
+  LoopForest loopforest;			///< Nesting of the loop bodies, built when the loops are labeled
   BlockGraph &graph;				///< The control-flow graph
   int4 dataflow_changecount;			///< Number of data-flow changes made during structuring
   bool checkSwitchSkips(FlowBlock *switchbl,FlowBlock *exitblock);
@@ -205,7 +242,7 @@ class CollapseStructure {
   void labelLoops(vector<LoopBody *> &looporder);	///< Identify all the loops in this graph
   void orderLoopBodies(void);			///< Identify and label all loop structure for this graph
   bool updateLoopBody(void);			///< Find likely \e unstructured edges within the innermost loop body
-  FlowBlock *selectGoto(void);			///< Select an edge to mark as  \e unstructured
+  FlowBlock *selectGoto(void);			///< Select edges to mark as  \e unstructured
   bool ruleBlockGoto(FlowBlock *bl);		///< Attempt to apply the BlockGoto structure
   bool ruleBlockCat(FlowBlock *bl);		///< Attempt to apply a BlockList structure
   bool ruleBlockOr(FlowBlock *bl);		///< Attempt to apply a BlockCondition structure
@@ -225,6 +262,42 @@ public:
   void collapseAll(void);			///< Run the whole algorithm
 };
 
+/// \brief Structure a bare control-flow graph given as a list of edges
+///
+/// Clients that only want the structure of a graph (as for the graph views of Ghidra) describe
+/// it with node counts and edges, without any p-code, and get back the structured tree in a
+/// compact text encoding.  The graph is built directly from the edges, so it skips the XML
+/// document and the BlockMap needed to restore a \<block> tag, and the result is encoded without
+/// the \<bhead> and \<edge> tags of BlockGraph::saveXml().  The structuring itself is the same as
+/// for the StructureGraph command.
+///
+/// The edge list is a sequence of decimal integers separated by white space: the number of
+/// nodes, followed by a (source,destination) pair for each edge.  Nodes are numbered from 0,
+/// and node 0 is the entry.  The out edges of a node are in the order they are listed, so for
+/// a conditional branch the \e false edge comes first.
+///
+/// In the encoding, a leaf is the number of its node.  Any other block is
+///
+///     (type targets children)
+///
+/// where \e type is the name of the block type (with \e ifgoto, \e properif, and \e ifelse
+/// distinguishing the forms of BlockIf, and \e condition followed by \e and or \e or), and
+/// \e targets are the unstructured edges of a goto, ifgoto, or multigoto, each written as
+/// \@node:depth:type. Every top-level block of the structured graph is followed by a newline.
+class EdgeListStructure {
+  BlockGraph ingraph;			///< Plain blocks mirroring the nodes of the input graph
+  BlockGraph resultgraph;		///< The graph being structured
+  static void encodeTarget(ostream &s,const FlowBlock *target,uint4 gototype);
+  static void encodeBlock(ostream &s,const FlowBlock *bl);
+public:
+  void clear(void) { resultgraph.clear(); ingraph.clear(); }	///< Throw away the graphs
+  void build(int4 numnodes,const vector<int4> &edges);	///< Build the input graph from a list of edges
+  void restore(istream &s);				///< Build the input graph from an encoded list of edges
+  void structure(void);					///< Structure the input graph
+  void encode(ostream &s) const;			///< Encode the structured graph
+  const BlockGraph &getResult(void) const { return resultgraph; }	///< Get the structured graph
+};
+
 /// \brief Discover and eliminate \e split conditions
 ///
 /// A \b split condition is when a conditional expression, resulting in a CBRANCH,
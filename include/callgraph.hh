@@ -58,15 +58,17 @@ public:
   };
 private:
   friend class CallGraph;
+  friend class CallGraphCsr;
   Address entryaddr;		// Starting address of function
   string name;			// Name of the function if available
   Funcdata *fd;			// Pointer to funcdata if we have it
   vector<CallGraphEdge> inedge;
   vector<CallGraphEdge> outedge;
   int4 parentedge;		// Incoming edge for spanning tree
+  int4 csrindex;		// Index of the node in the last CallGraphCsr built from the graph
   mutable uint4 flags;
 public:
-  CallGraphNode(void) { fd = (Funcdata *)0; flags = 0; parentedge = -1; }
+  CallGraphNode(void) { fd = (Funcdata *)0; flags = 0; parentedge = -1; csrindex = -1; }
   void clearMark(void) const { flags &= ~((uint4)mark); }
   bool isMark(void) const { return ((flags&mark)!=0); }
   const Address getAddr(void) const { return entryaddr; }
@@ -89,6 +91,46 @@ struct LeafIterator {
   LeafIterator(CallGraphNode *n) { node=n; outslot = 0; }
 };
 
+// A set of functions decompiled together, apart from the rest of the graph.  Every callee of
+// its functions (along edges that were not snipped) is in the same partition or in one of an
+// earlier round, and partitions of the same round share no edges.
+struct CallGraphPartition {
+  int4 round;			// Partitions of a round only need results from earlier rounds
+  vector<CallGraphNode *> nodes;	// Nodes of the partition, in address order
+};
+
+// Compact snapshot of a CallGraph, built in bulk once the nodes and edges are known.  Nodes
+// are numbered in address order, and the callees of all nodes are packed into a single array
+// (compressed sparse rows).  The strongly connected components (sets of mutually recursive
+// functions) are found with an iterative Tarjan search, so deep call chains don't exhaust the
+// stack, and components are numbered callees-first.  The layer of a component is 0 if it calls
+// no other component, and one more than the highest layer it calls otherwise, so components in
+// the same layer never call each other.
+class CallGraphCsr {
+  vector<CallGraphNode *> nodes;	// Node of each index, in address order
+  vector<int4> offset;		// Callees of node i are targets[offset[i]] up to targets[offset[i+1]]
+  vector<int4> targets;		// Index of the callee of each edge
+  vector<int4> component;	// Component of each node
+  vector<int4> layer;		// Layer of each component
+  int4 numlayers;		// Number of distinct layers
+  void findComponents(void);
+  void findLayers(void);
+public:
+  CallGraphCsr(void) { numlayers = 0; }
+  void build(CallGraph &graph);
+  int4 numNodes(void) const { return nodes.size(); }
+  int4 numEdges(void) const { return targets.size(); }
+  CallGraphNode *getNode(int4 i) const { return nodes[i]; }
+  int4 getIndex(const CallGraphNode *node) const { return node->csrindex; }
+  int4 beginOut(int4 i) const { return offset[i]; }
+  int4 endOut(int4 i) const { return offset[i+1]; }
+  int4 getTarget(int4 e) const { return targets[e]; }
+  int4 numComponents(void) const { return layer.size(); }
+  int4 getComponent(int4 i) const { return component[i]; }
+  int4 getLayer(int4 i) const { return layer[component[i]]; }	// Layer of the component of node i
+  int4 numLayers(void) const { return numlayers; }
+};
+
 class Scope;		// forward declaration
 class CallGraph {
   Architecture *glb;
@@ -118,7 +160,10 @@ public:
   map<Address,CallGraphNode>::iterator end(void) { return graph.end(); }
   void buildAllNodes(void);
   void buildEdges(Funcdata *fd);
+  void buildEdgesIndexed(int4 numthreads);
+  void partition(int4 numrounds,int4 numparts,vector<CallGraphPartition> &res);
   void saveXml(ostream &s) const;
+  void saveXml(ostream &s,const vector<CallGraphNode *> &nodes) const;
   void restoreXml(const Element *el);
 };
 
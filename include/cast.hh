@@ -172,6 +172,40 @@ public:
   virtual bool isZextCast(Datatype *outtype,Datatype *intype) const;
 };
 
+/// \brief A CastStrategy that remembers the castStandard() decisions of another strategy
+///
+/// Every decision is forwarded to the underlying strategy, except that the results of
+/// castStandard() are kept in a small direct-mapped table keyed on the two data-type pointers
+/// and the two flags.  Data-types are unique, so a pointer pair identifies the decision.  The
+/// table must be cleared, with setStrategy(), whenever data-types may have been changed or
+/// freed, so a memo is only used for the duration of a single pass that assigns casts.
+class CastStrategyMemo : public CastStrategy {
+  /// \brief A remembered decision
+  struct Entry {
+    Datatype *reqtype;		///< The required data-type
+    Datatype *curtype;		///< The current data-type
+    uint4 flags;		///< The \e care flags of the decision, plus a bit marking a used entry
+    Datatype *result;		///< The data-type to cast to, or NULL
+  };
+  enum { numEntries = 256 };	///< Number of entries in the table (a power of 2)
+  CastStrategy *base;		///< The underlying strategy
+  mutable Entry table[numEntries];	///< The table of remembered decisions
+public:
+  CastStrategyMemo(void) { base = (CastStrategy *)0; }	///< Constructor
+  void setStrategy(CastStrategy *s,TypeFactory *t);	///< Set the underlying strategy and clear the table
+  virtual int4 localExtensionType(const Varnode *vn) const { return base->localExtensionType(vn); }
+  virtual int4 intPromotionType(const Varnode *vn) const { return base->intPromotionType(vn); }
+  virtual bool checkIntPromotionForCompare(const PcodeOp *op,int4 slot) const { return base->checkIntPromotionForCompare(op,slot); }
+  virtual bool checkIntPromotionForExtension(const PcodeOp *op) const { return base->checkIntPromotionForExtension(op); }
+  virtual Datatype *castStandard(Datatype *reqtype,Datatype *curtype,bool care_uint_int,bool care_ptr_uint) const;
+  virtual Datatype *arithmeticOutputStandard(const PcodeOp *op) { return base->arithmeticOutputStandard(op); }
+  virtual bool isSubpieceCast(Datatype *outtype,Datatype *intype,uint4 offset) const { return base->isSubpieceCast(outtype,intype,offset); }
+  virtual bool isSubpieceCastEndian(Datatype *outtype,Datatype *intype,uint4 offset,bool isbigend) const {
+    return base->isSubpieceCastEndian(outtype,intype,offset,isbigend); }
+  virtual bool isSextCast(Datatype *outtype,Datatype *intype) const { return base->isSextCast(outtype,intype); }
+  virtual bool isZextCast(Datatype *outtype,Datatype *intype) const { return base->isZextCast(outtype,intype); }
+};
+
 }
 
 #endif
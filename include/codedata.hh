@@ -18,6 +18,8 @@
 
 #include "ifacedecomp.hh"
 
+#include <atomic>
+
 namespace GhidraDec {
 
 class IfaceCodeDataCapability : public IfaceCapability {
@@ -98,7 +100,32 @@ struct AddrLink {
   }
 };
 
+struct SweptBlock {		// A block disassembled ahead of time, by a worker thread
+  uintb start;			// Offset of the first instruction
+  int4 firstunit;		// Index of the first code unit in the chunk
+  int4 numunits;		// Number of code units in the block
+  int4 firstref;		// Index of the first crossref in the chunk
+  int4 numrefs;			// Number of crossrefs coming out of the block
+};
+
+struct SweptChunk {		// Blocks found by sweeping linearly through part of a range
+  Address start;		// Where the sweep starts
+  Address end;			// No block starts at or after this
+  Address limit;		// First code unit or end of the range, blocks reaching this are left out
+  vector<SweptBlock> blocks;	// Blocks sorted by starting offset
+  vector<CodeUnit> units;	// Code units of all the blocks
+  vector<pair<AddrLink,uint4> > refs;	// Crossrefs of all the blocks
+  const SweptBlock *find(uintb off) const;
+};
+
 class CodeDataAnalysis : public IfaceData {
+  static const uintb sweepsize = 0x10000;	// Bytes per chunk in a parallel sweep
+  Address sweepBlock(DisassemblyEngine &engine,const Address &addr,SweptChunk &chunk);
+  void sweepWorker(vector<SweptChunk> &chunks,std::atomic<int4> &next);
+  Address commitSweptBlock(const Address &addr,const SweptChunk &chunk,const SweptBlock &block,
+			   vector<pair<AddrLink,uint4> > &pending);
+  void commitCrossRefs(vector<pair<AddrLink,uint4> > &refs,int4 numthreads);
+  void disassembleParallel(const RangeList &rangelist,int4 numthreads);
 public:
   int4 alignment;		// Alignment of instructions
   Architecture *glb;
@@ -123,7 +150,7 @@ public:
   int4 getNumTargets(void) const { return targets.size(); }
   Address disassembleBlock(const Address &addr,const Address &endaddr);
   void disassembleRange(const Range &range);
-  void disassembleRangeList(const RangeList &rangelist);
+  void disassembleRangeList(const RangeList &rangelist,int4 numthreads=1);
   void findNotCodeUnits(void);
   void markFallthruHits(void);
   void markCrossHits(void);
@@ -140,7 +167,7 @@ public:
   void dumpFunctionStarts(ostream &s) const;
   void dumpUnlinked(ostream &s) const;
   void dumpTargetHits(ostream &s) const;
-  void runModel(void);
+  void runModel(int4 numthreads=1);
 };
 
 class IfaceCodeDataCommand : public IfaceCommand {
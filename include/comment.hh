@@ -231,12 +231,17 @@ private:
       order = ord;
     }
   };
-  map<Subsort,Comment *> commmap;			///< Comments for the current function, sorted by block
-  mutable map<Subsort,Comment *>::const_iterator start;	///< Iterator to current comment being walked
-  map<Subsort,Comment *>::const_iterator stop;		///< Last comment in current set being walked
-  map<Subsort,Comment *>::const_iterator opstop;	///< Statement landmark within current set of comments
+  typedef vector<pair<Subsort,Comment *> > CommentList;	///< Comments paired with their sorting key
+  CommentList commlist;					///< Comments for the current function, sorted by block
+  mutable CommentList::const_iterator start;		///< Iterator to current comment being walked
+  CommentList::const_iterator stop;			///< Last comment in current set being walked
+  CommentList::const_iterator opstop;			///< Statement landmark within current set of comments
   bool displayUnplacedComments;				///< True if unplaced comments should be displayed (in the header)
   bool findPosition(Subsort &subsort,Comment *comm,const Funcdata *fd);	///< Establish sorting key for a Comment
+  CommentList::const_iterator lowerBound(const Subsort &subsort) const;	///< Find the first comment not before the given key
+  CommentList::const_iterator upperBound(const Subsort &subsort) const;	///< Find the first comment after the given key
+  /// \brief Compare two entries of the comment list by their sorting key
+  static bool compareEntry(const pair<Subsort,Comment *> &a,const pair<Subsort,Comment *> &b) { return (a.first < b.first); }
 public:
   CommentSorter(void) { displayUnplacedComments = false; }	///< Constructor
   void setupFunctionList(uint4 tp,const Funcdata *fd,const CommentDatabase &db,bool displayUnplaced);
@@ -36,6 +36,7 @@ class CommentDatabaseGhidra : public CommentDatabase {
   void fillCache(const Address &fad) const;	///< Fetch comments for the given function
 public:
   CommentDatabaseGhidra(ArchitectureGhidra *g);	///< Constructor
+  bool isCacheFilled(void) const { return cachefilled; }	///< Have comments for the current function been fetched
   virtual void clear(void) { cache.clear(); cachefilled=false; }
   virtual void clearType(const Address &fad,uint4 tp) {
     cache.clearType(fad,tp);
@@ -0,0 +1,126 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file constfold.hh
+/// \brief Non-virtual evaluation of integer p-code operations on constants
+#ifndef __CPUI_CONSTFOLD__
+#define __CPUI_CONSTFOLD__
+
+#include "opbehavior.hh"
+
+namespace GhidraDec {
+
+/// \brief A table of fixed-size kernels for folding integer and boolean operations
+///
+/// For every integer and boolean opcode (and PIECE and SUBPIECE) there is a kernel specialised
+/// for each input size of 1, 2, 4, and 8 bytes, so the sign bits, masks, and overflow behavior
+/// come from the native integer types instead of being computed from the size on every call.
+/// Kernels are looked up by opcode and input size in a flat table, without going through the
+/// virtual OpBehavior methods.  The results match OpBehavior::evaluateBinary() and
+/// OpBehavior::evaluateUnary() for inputs that fit in \e sizein bytes, with the following exceptions:
+///   - Shift amounts of at least 64 bits produce the saturated result, rather than being undefined
+///   - INT_SREM is the remainder of the signed inputs (the OpBehavior divides the unsigned ones)
+///
+/// Operations with no kernel (floating-point and special operations) and inputs of any other
+/// size are reported as unhandled, and the caller should fall back to the OpBehavior.
+/// Division and remainder by zero throw an EvaluationError, like the OpBehavior does.
+class ConstantFold {
+public:
+  /// \brief A kernel folding a single operation
+  ///
+  /// The first input must fit in the size the kernel was chosen for.
+  /// \param sizeout is the size of the output in bytes
+  /// \param in1 is the first input value
+  /// \param in2 is the second input value (ignored for unary operations)
+  /// \return the output value, masked to \e sizeout bytes
+  typedef uintb (*Kernel)(int4 sizeout,uintb in1,uintb in2);
+  /// \brief A kernel folding one operation across arrays of inputs
+  ///
+  /// \param sizeout is the size of each output in bytes
+  /// \param in1 is the array of first inputs
+  /// \param in2 is the array of second inputs (may be null for unary operations)
+  /// \param out is the array that receives the outputs
+  /// \param count is the number of elements in each array
+  typedef void (*BatchKernel)(int4 sizeout,const uintb *in1,const uintb *in2,uintb *out,int4 count);
+private:
+  /// \brief The kernels for a single opcode and input size
+  struct Entry {
+    Kernel single;		///< Kernel for one operation (null if the opcode is not handled)
+    BatchKernel batch;		///< Kernel for an array of operations
+  };
+  Entry table[CPUI_MAX][4];	///< Kernels by opcode and size class
+  ConstantFold(void);		///< Fill in the table
+  template<typename K> void registerKernel(OpCode opc);	///< Fill in the entries of one opcode
+  static const ConstantFold &get(void);	///< Get the table
+  /// \brief Get the size class for an input size (or -1 if no kernel handles the size)
+  static int4 sizeClass(int4 size) {
+    switch(size) {
+    case 1: return 0;
+    case 2: return 1;
+    case 4: return 2;
+    case 8: return (sizeof(uintb) >= 8) ? 3 : -1;
+    default: break;
+    }
+    return -1;
+  }
+public:
+  static Kernel getKernel(OpCode opc,int4 sizein);	///< Get the kernel for an operation, or null
+  static BatchKernel getBatchKernel(OpCode opc,int4 sizein);	///< Get the array kernel for an operation, or null
+  static bool evaluate(OpCode opc,int4 sizeout,int4 sizein,uintb in1,uintb in2,uintb &res);	///< Fold a single operation
+  static bool evaluateBatch(OpCode opc,int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,
+			    uintb *out,int4 count);	///< Fold an operation across arrays of inputs
+};
+
+/// \param opc is the opcode
+/// \param sizein is the size of the (first) input in bytes
+/// \return the kernel, or null if the operation or size isn't handled
+inline ConstantFold::Kernel ConstantFold::getKernel(OpCode opc,int4 sizein)
+
+{
+  int4 cl = sizeClass(sizein);
+  if (cl < 0 || (int4)opc >= CPUI_MAX) return (Kernel)0;
+  return get().table[opc][cl].single;
+}
+
+/// \param opc is the opcode
+/// \param sizein is the size of the (first) input in bytes
+/// \return the kernel, or null if the operation or size isn't handled
+inline ConstantFold::BatchKernel ConstantFold::getBatchKernel(OpCode opc,int4 sizein)
+
+{
+  int4 cl = sizeClass(sizein);
+  if (cl < 0 || (int4)opc >= CPUI_MAX) return (BatchKernel)0;
+  return get().table[opc][cl].batch;
+}
+
+/// \param opc is the opcode
+/// \param sizeout is the size of the output in bytes
+/// \param sizein is the size of the (first) input in bytes
+/// \param in1 is the first input value
+/// \param in2 is the second input value (ignored for unary operations)
+/// \param res will hold the output value
+/// \return \b true if the operation was folded, \b false if the OpBehavior must be used instead
+inline bool ConstantFold::evaluate(OpCode opc,int4 sizeout,int4 sizein,uintb in1,uintb in2,uintb &res)
+
+{
+  Kernel kernel = getKernel(opc,sizein);
+  if (kernel == (Kernel)0) return false;
+  res = (*kernel)(sizeout,in1,in2);
+  return true;
+}
+
+} // namespace GhidraDec
+
+#endif
@@ -78,8 +78,10 @@ private:
   int4 parsestate;
   AddrSpace *const_space;
   uint1 buf[16];		// Buffer of bytes in the instruction stream
-  uintm *context;		// Pointer to local context
+  const uintm *context;		// Pointer to context in use, either shared or the local copy
+  uintm *localcontext;		// Local copy of context, made when the instruction changes it
   int4 contextsize;		// Number of entries in context array
+  uint4 generation;		// Generation of the database when shared context was loaded
   ContextCache *contcache;   // Interface for getting/setting context
   vector<ContextSet> contextcommit;
   Address addr;		// Address of start of instruction
@@ -89,13 +91,17 @@ private:
   ConstructState *base_state;
   int4 alloc;			// Number of ConstructState's allocated
   int4 delayslot;		// delayslot depth
+  int4 flowflags;		// Flow properties of the instruction (see Translate::instructionFlow), -1 if not known
 public:
   ParserContext(ContextCache *ccache);
-  ~ParserContext(void) { if (context != (uintm *)0) delete [] context; }
+  ~ParserContext(void) { if (localcontext != (uintm *)0) delete [] localcontext; }
   uint1 *getBuffer(void) { return buf; }
   void initialize(int4 maxstate,int4 maxparam,AddrSpace *spc);
   int4 getParserState(void) const { return parsestate; }
   void setParserState(int4 st) { parsestate = st; }
+  int4 getFlowFlags(void) const { return flowflags; }
+  void setFlowFlags(int4 fl) { flowflags = fl; }
+  const ConstructState *getBaseState(void) const { return base_state; }
   void deallocateState(ParserWalkerChange &walker);
   void allocateOperand(int4 i,ParserWalkerChange &walker);
   void setAddr(const Address &ad) { addr = ad; }
@@ -103,6 +109,7 @@ public:
   void setCalladdr(const Address &ad) { calladdr = ad; }
   void addCommit(TripleSymbol *sym,int4 num,uintm mask,bool flow,ConstructState *point);
   void clearCommits(void) { contextcommit.clear(); }
+  bool hasCommits(void) const { return !contextcommit.empty(); }	///< Does the instruction change context
   void applyCommits(void);
   const Address &getAddr(void) const { return addr; }
   const Address &getNaddr(void) const { return naddr; }
@@ -114,8 +121,12 @@ public:
   uintm getContextBytes(int4 byteoff,int4 numbytes) const;
   uintm getInstructionBits(int4 startbit,int4 size,uint4 off) const;
   uintm getContextBits(int4 startbit,int4 size) const;
-  void setContextWord(int4 i,uintm val,uintm mask) { context[i] = (context[i]&(~mask))|(mask&val); }
-  void loadContext(void) { contcache->getContext(addr,context); }
+  void setContextWord(int4 i,uintm val,uintm mask) {
+    if (context != localcontext) copyContext();
+    localcontext[i] = (localcontext[i]&(~mask))|(mask&val); }
+  void loadContext(void);
+  void copyContext(void);
+  bool isContextStale(void) const;
   int4 getLength(void) const { return base_state->length; }
   void setDelaySlot(int4 val) { delayslot = val; }
   int4 getDelaySlot(void) const { return delayslot; }
@@ -139,7 +139,9 @@ public:
 /// \brief Perform Common Sub-expression Elimination on CPUI_MULTIEQUAL ops
 class ActionMultiCse : public Action {
   static bool preferredOutput(Varnode *out1,Varnode *out2);	///< Which of two outputs is preferred
-  static PcodeOp *findMatch(BlockBasic *bl,PcodeOp *target,Varnode *in);	///< Find match to CPUI_MULTIEQUAL
+  static uintm hashInputs(PcodeOp *op);				///< Hash the inputs of a CPUI_MULTIEQUAL
+  static bool isMatch(PcodeOp *op,PcodeOp *target);		///< Are two CPUI_MULTIEQUAL ops equivalent
+  static PcodeOp *findMatch(const vector<PcodeOp *> &candidates,PcodeOp *target);	///< Find match to CPUI_MULTIEQUAL
   bool processBlock(Funcdata &data,BlockBasic *bl);		///< Search a block for equivalent CPUI_MULTIEQUAL
 public:
   ActionMultiCse(const std::string &g) : Action(0,"multicse",g) {}	///< Constructor
@@ -286,6 +288,7 @@ public:
 /// input. In this case, it casts to the necessary pointer type
 /// immediately.
 class ActionSetCasts : public Action {
+  CastStrategyMemo memo;	///< Remembers cast decisions for the current pass
   static int4 castOutput(PcodeOp *op,Funcdata &data,CastStrategy *castStrategy);
   static int4 castInput(PcodeOp *op,int4 slot,Funcdata &data,CastStrategy *castStrategy);
 public:
@@ -401,7 +404,7 @@ class ActionMarkImplied : public Action {
   /// This class holds a single entry in a stack used to forward traverse Varnode expressions
   struct DescTreeElement {
     Varnode *vn;				///< The Varnode at this particular point in the path
-    list<PcodeOp *>::const_iterator desciter;	///< The current edge being traversed
+    DescendList::const_iterator desciter;		///< The current edge being traversed
     DescTreeElement(Varnode *v) {
       vn = v; desciter = v->beginDescend(); }	///< Constructor
   };
@@ -500,6 +503,12 @@ public:
 /// the particular op being passed through can transform the
 /// "bit usage" vector of the output to obtain the input.
 class ActionDeadCode : public Action {
+  /// \brief How dead code is handled in an address space
+  enum {
+    space_ignore = 0,		///< Space does not do dead code removal
+    space_prelive = 1,		///< Space has not been heritaged, everything is consumed
+    space_remove = 2		///< Dead code in the space can be removed
+  };
   static void pushConsumed(uintb val,Varnode *vn,vector<Varnode *> &worklist);
   static void propagateConsumed(vector<Varnode *> &worklist);
   static bool neverConsumed(Varnode *vn,Funcdata &data);
@@ -579,7 +588,8 @@ public:
 ///
 /// This loads prototype information, if it exists for each sub-function. If no explicit
 /// prototype exists, a default is selected.  If the prototype model specifies
-/// \e uponreturn injection, the p-code is injected at this time.
+/// \e uponreturn injection, the p-code is injected at this time.  Call sites to the same
+/// sub-function share the parameters of one copy of its prototype (see FuncProto::copyShared()).
 class ActionDefaultParams : public Action {
 public:
   ActionDefaultParams(const std::string &g) : Action(rule_onceperfunc,"defaultparams",g) {}	///< Constructor
@@ -596,7 +606,8 @@ public:
 /// makes sure there is p-code relationship between the Varnode coming into a sub-function
 /// and the Varnode coming out.  If the \e extrapop is known, the p-code will be
 /// a CPUI_COPY or CPUI_ADD. If it is unknown, a CPUI_INDIRECT will be inserted that gets
-/// filled in by ActionStackPtrFlow.
+/// filled in by ActionStackPtrFlow.  An \e extrapop that ActionStackPtrFlow already solved for
+/// at another call site to the same sub-function (see ExtraPopMemo) is treated as known.
 class ActionExtraPopSetup : public Action {
   AddrSpace *stackspace;		///< The stack space to analyze
 public:
@@ -877,12 +888,28 @@ public:
 /// Rather than hunt this down, I've put an arbitrary iteration limit on
 /// the data-type propagation algorithm, which reports a warning if the limit is
 /// reached and then aborts additional propagation so that decompiling can terminate.
+///
+/// The result of propagation depends only on the data-flow graph and the starting (local)
+/// data-types, so each pass records the starting data-types along with the propagated ones.
+/// If the function hasn't changed and every Varnode starts with the same data-type, the
+/// propagated data-types from the previous pass are reused instead of being recalculated.
 class ActionInferTypes : public Action {
+  /// \brief The state of a single Varnode during the previous pass
+  struct PassRecord {
+    Varnode *vn;		///< The Varnode
+    Datatype *localtype;	///< Starting data-type, based on local information
+    Datatype *temptype;		///< Data-type after propagation
+    uint4 flags;		///< Varnode properties that affect propagation
+    PassRecord(Varnode *v,Datatype *ct,uint4 fl) { vn = v; localtype = ct; temptype = ct; flags = fl; }	///< Constructor
+  };
 #ifdef TYPEPROP_DEBUG
   static void propagationDebug(Architecture *glb,Varnode *vn,const Datatype *newtype,PcodeOp *op,int4 slot,Varnode *ptralias);
 #endif
   int4 localcount;					///< Number of passes performed for this function
-  static void buildLocaltypes(Funcdata &data);		///< Assign initial data-type based on local info
+  uint4 lastmodcount;					///< Modification count of the function at the previous pass
+  vector<PassRecord> lastpass;				///< Varnodes (in location order) visited by the previous pass
+  bool buildLocaltypes(Funcdata &data);			///< Assign initial data-type based on local info
+  void recordPass(Funcdata &data);			///< Record the results of propagation for the next pass
   static bool writeBack(Funcdata &data);		///< Commit the final propagated data-types to Varnodes
   static int4 propagateAddPointer(PcodeOp *op,int4 slot);	///< Test if edge is pointer plus a constant
   static Datatype *propagateAddIn2Out(TypeFactory *typegrp,PcodeOp *op,int4 inslot);
@@ -892,8 +919,8 @@ class ActionInferTypes : public Action {
   static void propagateRef(Funcdata &data,Varnode *vn,const Address &addr);
   static void propagateSpacebaseRef(Funcdata &data,Varnode *spcvn);
 public:
-  ActionInferTypes(const std::string &g) : Action(0,"infertypes",g) {}	///< Constructor
-  virtual void reset(Funcdata &data) { localcount = 0; }
+  ActionInferTypes(const std::string &g) : Action(0,"infertypes",g) { localcount = 0; lastmodcount = 0; }	///< Constructor
+  virtual void reset(Funcdata &data) { localcount = 0; lastmodcount = data.getModificationCount() - 1; lastpass.clear(); }
   virtual Action *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Action *)0;
     return new ActionInferTypes(getGroup());
@@ -973,7 +1000,7 @@ extern void build_defaultactions(ActionDatabase &allacts);	///< Build the defaul
 class PropagationState {
 public:
   Varnode *vn;					///< The root Varnode
-  list<PcodeOp *>::const_iterator iter;		///< Iterator to current descendant being enumerated
+  DescendList::const_iterator iter;			///< Iterator to current descendant being enumerated
   PcodeOp *op;					///< The current descendant or the defining PcodeOp
   int4 inslot;					///< Slot holding Varnode for descendant PcodeOp
   int4 slot;					///< Current edge relative to current PcodeOp
@@ -1009,6 +1036,7 @@ class TermOrder {
 public:
   TermOrder(PcodeOp *rt) { root = rt; }	///< Construct given root PcodeOp
   int4 getSize(void) const { return terms.size(); }	///< Get the number of terms in the expression
+  const vector<PcodeOpEdge> &getTerms(void) const { return terms; }	///< Get the terms in the order they were collected
   void collect(void);			///< Collect all the terms in the expression
   void sortTerms(void);			///< Sort the terms using additiveCompare()
   const vector<PcodeOpEdge *> &getSort(void) { return sorter; }	///< Get the sorted list of references
@@ -65,13 +65,24 @@ public:
 /// scope of each Varnode must not intersect because that would mean the high-level variable
 /// holds different values at the same point in the function.
 ///
-/// Internally this is implemented as a map from basic block to their non-empty CoverBlock
+/// Internally this is implemented as a list of (block index, CoverBlock) pairs sorted by block
+/// index, together with a bitset marking which blocks have an entry.  Most intersection tests are
+/// between Covers that share no block, and these are rejected by comparing the bitsets alone.
 class Cover {
-  map<int4,CoverBlock> cover; 			///< block index -> CoverBlock
+public:
+  typedef vector<pair<int4,CoverBlock> >::const_iterator const_iterator;	///< Iterator over CoverBlocks
+private:
+  vector<pair<int4,CoverBlock> > cover;		///< (block index,CoverBlock) pairs, sorted by block index
+  vector<uintb> blockmask;			///< One bit per block index, set if \b cover has an entry for it
   CoverBlock emptyblock;			///< Template CoverBlock for blocks not covered by \b this
+  bool hasBlock(int4 i) const {
+    uint4 word = i >> 6; return (word < blockmask.size() && (blockmask[word] & (((uintb)1) << (i & 63))) != 0); }	///< Does \b this have an entry for the i-th block
+  bool shareBlock(const Cover &op2) const;	///< Do \b this and another Cover have an entry for the same block
+  const CoverBlock *findBlock(int4 i) const;	///< Find the CoverBlock for the i-th block, if it exists
+  CoverBlock &getBlock(int4 i);			///< Get the CoverBlock for the i-th block, creating it if necessary
   void addRefRecurse(const FlowBlock *bl);	///< Fill-in \b this recursively from the given block
 public:
-  void clear(void) { cover.clear(); }		///< Clear \b this to an empty Cover
+  void clear(void) { cover.clear(); blockmask.clear(); }	///< Clear \b this to an empty Cover
   int4 compareTo(const Cover &op2) const;	///< Give ordering of \b this and another Cover
   const CoverBlock &getCoverBlock(int4 i) const;	///< Get the CoverBlock corresponding to the i-th block
   int4 intersect(const Cover &op2) const;	///< Characterize the intersection between \b this and another Cover.
@@ -80,14 +91,18 @@ public:
   bool contain(const PcodeOp *op,int4 max) const;
   int4 containVarnodeDef(const Varnode *vn) const;
   void merge(const Cover &op2);			///< Merge \b this with another Cover block by block
+  void clearBlock(int4 i);			///< Remove any entry for the i-th block
+  void mergeBlock(int4 i,const Cover &op2);	///< Merge the i-th block of another Cover into \b this
+  void addBlocks(vector<int4> &res) const;	///< Append the index of every block with an entry
   void rebuild(const Varnode *vn);		///< Reset \b this based on def-use of a single Varnode
   void addDefPoint(const Varnode *vn);		///< Reset to the single point where the given Varnode is defined
   void addRefPoint(const PcodeOp *ref,const Varnode *vn);	///< Add a variable read to \b this Cover
   //  void remove_refpoint(const PcodeOp *ref,const Varnode *vn) {
   //    rebuild(vn); }		// Cheap but inefficient
   void print(ostream &s) const;			///< Dump a description of \b this cover to stream
-  map<int4,CoverBlock>::const_iterator begin(void) const { return cover.begin(); }	///< Get beginning of CoverBlocks
-  map<int4,CoverBlock>::const_iterator end(void) const { return cover.end(); }		///< Get end of CoverBlocks
+  uint8 memoryEstimate(void) const;		///< Estimate the bytes of heap used by \b this Cover
+  const_iterator begin(void) const { return cover.begin(); }	///< Get beginning of CoverBlocks
+  const_iterator end(void) const { return cover.end(); }	///< Get end of CoverBlocks
 };
 
 }
@@ -29,15 +29,25 @@ namespace GhidraDec {
 /// queries and response records are sent via XML.  The saveXml() and restoreXml()
 /// methods are disabled.  The clear() method only releases the local cache,
 /// no records on the Ghidra client are affected.
+///
+/// The cache lasts across functions, until the program is flushed or the client invalidates the
+/// constant pool. Responses to queries sent ahead of time, for every CPOOLREF in a function
+/// at once (see ArchitectureGhidra::prefetchFunction()), are held unparsed until the record is
+/// first asked for, so the record is built at the same point as if it had been queried then.
 class ConstantPoolGhidra : public ConstantPool {
   ArchitectureGhidra *ghidra;			///< The connection with the Ghidra client
   mutable ConstantPoolInternal cache;		///< The local cache of previouly queried CPoolRecord objects
+  mutable map<vector<uintb>,Document *> pending;	///< Prefetched responses not yet parsed, by reference
   virtual CPoolRecord *createRecord(const vector<uintb> &refs);
+  void clearPending(void) const;		///< Throw away any prefetched responses
 public:
   ConstantPoolGhidra(ArchitectureGhidra *g);	///< Constructor
+  virtual ~ConstantPoolGhidra(void) { clearPending(); }	///< Destructor
   virtual const CPoolRecord *getRecord(const vector<uintb> &refs) const;
+  bool isKnown(const vector<uintb> &refs) const;	///< Is a record cached (or prefetched) for the given reference
+  void addPending(const vector<uintb> &refs,Document *doc);	///< Hold a prefetched response
   virtual bool empty(void) const { return false; }
-  virtual void clear(void) { cache.clear(); }
+  virtual void clear(void) { cache.clear(); clearPending(); }
   virtual void saveXml(ostream &s) const;
   virtual void restoreXml(const Element *el,TypeFactory &typegrp);
 };
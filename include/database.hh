@@ -203,6 +203,8 @@ public:
   Scope *getScope(void) const { return scope; }			///< Get the scope owning \b this Symbol
   SymbolEntry *getFirstWholeMap(void) const;	 		///< Get the first entire mapping of the symbol
   SymbolEntry *getMapEntry(const Address &addr) const;	 	///< Get first mapping of the symbol that contains the given Address
+  int4 numEntries(void) const { return mapentry.size(); }	///< Return the number of SymbolEntrys
+  SymbolEntry *getMapEntry(int4 i) const { return &(*mapentry[i]); }	///< Return the i-th SymbolEntry for \b this Symbol
   void saveXmlHeader(ostream &s) const;				///< Save basic Symbol properties as XML attributes
   void restoreXmlHeader(const Element *el);			///< Restore basic Symbol properties from XML
   void saveXmlBody(ostream &s) const;				///< Save details of the Symbol to XML
@@ -307,6 +309,132 @@ public:
 };
 typedef set<Symbol *,SymbolCompareName> SymbolNameTree;		///< A set of Symbol objects sorted by name
 
+/// \brief A hash index of named objects, for exact-match look-ups by name
+///
+/// The objects (Symbol or Scope) are not owned by the index.  Each slot holds the hash of the
+/// name of its object, computed once on insertion, so a look-up only compares names that have
+/// the same hash.  The table uses open addressing with linear probing, and removes entries by
+/// shifting later ones back.  An object must be removed before its name changes.
+template<typename T>
+class NameHashIndex {
+  vector<pair<uint4,T *> > slot;	///< (hash,object) for each slot, with null object if empty
+  int4 count;				///< Number of objects in the index
+  void grow(void);			///< Double the number of slots
+public:
+  NameHashIndex(void) { count = 0; }	///< Construct an empty index
+  static uint4 hashName(const string &nm);	///< Compute the hash of a name
+  void insert(T *obj);			///< Add an object under its current name
+  void erase(T *obj);			///< Remove an object (if present)
+  void clear(void) { slot.clear(); count = 0; }	///< Remove all objects
+  T *findAny(const string &nm) const;	///< Find some object with the given name
+  void find(const string &nm,vector<T *> &res) const;	///< Find all objects with the given name
+};
+
+/// This is the 32-bit FNV-1a hash.
+/// \param nm is the name
+/// \return the hash value
+template<typename T>
+uint4 NameHashIndex<T>::hashName(const string &nm)
+
+{
+  uint4 res = 0x811c9dc5;
+  for(int4 i=0;i<nm.size();++i) {
+    res ^= (uint1)nm[i];
+    res *= 0x01000193;
+  }
+  return res;
+}
+
+template<typename T>
+void NameHashIndex<T>::grow(void)
+
+{
+  vector<pair<uint4,T *> > old;
+  old.swap(slot);
+  slot.resize(old.empty() ? 16 : old.size() * 2,pair<uint4,T *>(0,(T *)0));
+  uint4 mask = slot.size() - 1;
+  for(int4 i=0;i<old.size();++i) {
+    if (old[i].second == (T *)0) continue;
+    uint4 pos = old[i].first & mask;
+    while(slot[pos].second != (T *)0)
+      pos = (pos + 1) & mask;
+    slot[pos] = old[i];
+  }
+}
+
+/// \param obj is the object to add
+template<typename T>
+void NameHashIndex<T>::insert(T *obj)
+
+{
+  if (2 * (count + 1) > slot.size())
+    grow();
+  uint4 hash = hashName(obj->getName());
+  uint4 mask = slot.size() - 1;
+  uint4 pos = hash & mask;
+  while(slot[pos].second != (T *)0)
+    pos = (pos + 1) & mask;
+  slot[pos] = pair<uint4,T *>(hash,obj);
+  count += 1;
+}
+
+/// \param obj is the object to remove, which must have the name it was inserted with
+template<typename T>
+void NameHashIndex<T>::erase(T *obj)
+
+{
+  if (count == 0) return;
+  uint4 mask = slot.size() - 1;
+  uint4 pos = hashName(obj->getName()) & mask;
+  while(slot[pos].second != obj) {
+    if (slot[pos].second == (T *)0) return;	// Not present
+    pos = (pos + 1) & mask;
+  }
+  count -= 1;
+  // Shift back any later entries that can't be found across the hole
+  uint4 hole = pos;
+  for(pos=(pos+1)&mask;slot[pos].second!=(T *)0;pos=(pos+1)&mask) {
+    uint4 home = slot[pos].first & mask;
+    bool reachable = (hole <= pos) ? (home > hole && home <= pos) : (home > hole || home <= pos);
+    if (reachable) continue;	// Entry is still found from its home slot
+    slot[hole] = slot[pos];
+    hole = pos;
+  }
+  slot[hole] = pair<uint4,T *>(0,(T *)0);
+}
+
+/// \param nm is the name to search for
+/// \return an object with the name, or null if there is none
+template<typename T>
+T *NameHashIndex<T>::findAny(const string &nm) const
+
+{
+  if (count == 0) return (T *)0;
+  uint4 hash = hashName(nm);
+  uint4 mask = slot.size() - 1;
+  for(uint4 pos=hash&mask;slot[pos].second!=(T *)0;pos=(pos+1)&mask) {
+    if (slot[pos].first == hash && slot[pos].second->getName() == nm)
+      return slot[pos].second;
+  }
+  return (T *)0;
+}
+
+/// The objects are added to the list in no particular order.
+/// \param nm is the name to search for
+/// \param res is the list to add the matching objects to
+template<typename T>
+void NameHashIndex<T>::find(const string &nm,vector<T *> &res) const
+
+{
+  if (count == 0) return;
+  uint4 hash = hashName(nm);
+  uint4 mask = slot.size() - 1;
+  for(uint4 pos=hash&mask;slot[pos].second!=(T *)0;pos=(pos+1)&mask) {
+    if (slot[pos].first == hash && slot[pos].second->getName() == nm)
+      res.push_back(slot[pos].second);
+  }
+}
+
 /// \brief An iterator over SymbolEntry objects in multiple address spaces
 ///
 /// Given an EntryMap (a rangemap of SymbolEntry objects in a single address space)
@@ -400,8 +528,11 @@ class Scope {
   RangeList rangetree;				///< Range of data addresses \e owned by \b this scope
   Scope *parent;				///< The parent scope
   ScopeMap children;				///< Sorted list of child scopes
+  NameHashIndex<Scope> childindex;		///< Child scopes, indexed by name
   void attachScope(Scope *child);		///< Attach a new child Scope to \b this
   void detachScope(ScopeMap::iterator iter);	///< Detach a child Scope from \b this
+  Symbol *restoreSymbolTag(const Element *el);	///< Create a Symbol from the first child of a \<mapsym> tag
+  void addSymbolEntries(const vector<SymbolEntry> &entries);	///< Add new Symbols given one mapping of each
 
 protected:
   Architecture *glb;				///< Architecture of \b this scope
@@ -449,6 +580,12 @@ protected:
   /// \param sym is the preconstructed Symbol
   virtual void addSymbolInternal(Symbol *sym)=0;
 
+  /// \brief Put a batch of Symbols into the name map
+  ///
+  /// If any Symbol can't be added, every Symbol not yet added is deleted and the error is rethrown.
+  /// \param syms are the preconstructed Symbols
+  virtual void addSymbolsInternal(const vector<Symbol *> &syms);
+
   /// \brief Create a new SymbolEntry for a Symbol given a memory range
   ///
   /// The SymbolEntry is specified in terms of a memory range and \b usepoint
@@ -501,6 +638,7 @@ public:
   virtual void clearCategory(int4 cat)=0;			///< Clear all symbols of the given category from \b this scope
   virtual void clearUnlocked(void)=0;				///< Clear all unlocked symbols from \b this scope
   virtual void clearUnlockedCategory(int4 cat)=0;		///< Clear unlocked symbols of the given category from \b this scope
+  virtual void restoreDeferred(void) {}				///< Create any Symbols whose restore has been put off
 
   /// \brief Query if the given range is owned by \b this Scope
   ///
@@ -681,10 +819,13 @@ public:
   void getNameSegments(vector<string> &vec) const;		///< Get the fullname of \b this in segments
   Architecture *getArch(void) const { return glb; }		///< Get the Architecture associated with \b this
   Scope *getParent(void) const { return parent; }		///< Get the parent Scope (or NULL if \b this is the global Scope)
+  Funcdata *getFuncdata(void) const { return fd; }		///< Get the function \b this is the local Scope for (or NULL)
   Symbol *addSymbol(const string &name,Datatype *ct);		///< Add a new Symbol \e without mapping it to an address
   SymbolEntry *addMapPoint(Symbol *sym,const Address &addr,
 			   const Address &usepoint);		///< Map a Symbol to a specific address
   Symbol *addMapSym(const Element *el);				///< Add a mapped Symbol from a \<mapsym> XML tag
+  void addSymbolBatch(const vector<Symbol *> &syms,const vector<Address> &addrs);	///< Add new Symbols, each mapped to one address
+  void addMapSymBatch(const vector<const Element *> &els);	///< Add mapped Symbols from a list of \<mapsym> XML tags
   FunctionSymbol *addFunction(const Address &addr,const string &nm);
   ExternRefSymbol *addExternalRef(const Address &addr,const Address &refaddr,const string &nm);
   LabSymbol *addCodeLabel(const Address &addr,const string &nm);
@@ -699,16 +840,44 @@ public:
 /// another implementation.  This implements a \b nametree, which is a
 /// a set of Symbol objects (the set owns the Symbol objects). It also implements
 /// a \b maptable, which is a list of rangemaps that own the SymbolEntry objects.
+///
+/// When a global Scope is restored from XML, plain data symbols and code labels are not
+/// created right away.  Their \<mapsym> tags are copied into an index sorted by address
+/// (and by name), and each Symbol is created the first time a query could return it.
+/// Queries by address create the deferred symbols overlapping the range, queries by name
+/// create the symbols with that name, and anything that walks the whole Scope creates them all.
 class ScopeInternal : public Scope {
+  /// \brief A Symbol restored from XML whose creation has been put off until it is needed
+  struct LazySymbol {
+    Element *el;		///< Private copy of the \<mapsym> tag (null once the Symbol is created)
+    Address addr;		///< Start of the storage of the Symbol
+    int4 size;			///< Number of bytes of storage
+    /// \brief Compare deferred symbols by address
+    bool operator<(const LazySymbol &op2) const { return (addr < op2.addr); }
+  };
+  mutable vector<LazySymbol> lazylist;		///< Deferred symbols, sorted by address
+  mutable multimap<string,int4> lazynames;	///< Indices into \b lazylist, by Symbol name
+  mutable int4 lazyremain;			///< Number of deferred symbols not yet created
+  int4 lazymaxsize;				///< Largest storage size of any deferred symbol
   void processHole(const Element *el);
   void insertNameTree(Symbol *sym);
+  void addCategory(Symbol *sym);		///< Put a Symbol in its category list
   SymbolNameTree::const_iterator findFirstByName(const string &name) const;
+  bool deferMapSym(const Element *el);		///< Put off creating the Symbol of a \<mapsym> tag, if possible
+  void sortDeferred(void);			///< Index the deferred symbols after restoring
+  void createDeferred(int4 i) const;		///< Create a single deferred Symbol
+  void releaseDeferred(void) const;		///< Throw away the deferred symbol index
+  void createDeferredRange(const Address &addr,int4 size) const;	///< Create deferred symbols overlapping a range
+  void createDeferredNames(const string &lo,const string &hi) const;	///< Create deferred symbols in a range of names
+  void createAllDeferred(void) const;		///< Create every deferred Symbol
 protected:
   virtual void addSymbolInternal(Symbol *sym);
+  virtual void addSymbolsInternal(const vector<Symbol *> &syms);
   virtual SymbolEntry *addMapInternal(Symbol *sym,uint4 exfl,const Address &addr,int4 off,int4 sz,const RangeList &uselim);
   virtual SymbolEntry *addDynamicMapInternal(Symbol *sym,uint4 exfl,uint8 hash,int4 off,int4 sz,
 					     const RangeList &uselim);
   SymbolNameTree nametree;			///< The set of Symbol objects, sorted by name
+  NameHashIndex<Symbol> nameindex;		///< The Symbol objects, indexed by name for exact look-ups
   vector<EntryMap *> maptable;			///< Rangemaps of SymbolEntry, one map for each address space
   vector<vector<Symbol *> > category;		///< References to Symbol objects organized by category
   list<SymbolEntry> dynamicentry;		///< Dynamic symbol entries
@@ -719,6 +888,8 @@ public:
   virtual void clearCategory(int4 cat);
   virtual void clearUnlocked(void);
   virtual void clearUnlockedCategory(int4 cat);
+  virtual void restoreDeferred(void) { createAllDeferred(); }
+  uint8 memoryEstimate(void) const;			///< Estimate the bytes of heap used by \b this Scope
   virtual ~ScopeInternal(void);
   virtual MapIterator begin(void) const;
   virtual MapIterator end(void) const;
@@ -810,23 +981,32 @@ typedef rangemap<ScopeMapper> ScopeResolve;		///< A map from address to the owni
 /// entered in the map.  This class also maintains a set of boolean properties that label
 /// memory ranges.  This allows important properties like \e read-only and \e volatile to
 /// be put down even if the Symbols aren't yet known.
+///
+/// A coarse index of every memory page that any Symbol has been mapped to is also kept, so
+/// that most addresses with no Symbol can be rejected before any Scope is searched.  The index
+/// is only used if every Scope is a ScopeInternal, whose mappings all pass through it.
 class Database {
+  /// \brief Number of low bits of an offset dropped in the index of mapped pages
+  enum { mappedShift = 12 };
   Architecture *glb;			///< The Architecture to which this symbol table is attached
   Scope *globalscope;			///< A quick reference to the \e global Scope
   ScopeResolve resolvemap;		///< The Address to \e namespace map
   partmap<Address,uint4> flagbase;	///< Map of global properties
+  RangeList mappedpages;		///< Pages containing the storage of any Symbol ever mapped
+  bool mappedpagesok;			///< Set if every mapping is noted in \b mappedpages
   void clearResolve(Scope *scope);	///< Clear the \e ownership ranges associated with the given Scope
   void clearResolveRecursive(Scope *scope);	///< Clear the \e ownership ranges of a given Scope and its children
   void fillResolve(Scope *scope);	///< Add the \e ownership ranges of the given Scope to the map
   static void parseParentTag(const Element *el,string &name,vector<string> &parnames);
 public:
-  Database(Architecture *g) { glb=g; globalscope=(Scope *)0; flagbase.defaultValue() = 0; }	///< Constructor
+  Database(Architecture *g) { glb=g; globalscope=(Scope *)0; flagbase.defaultValue() = 0; mappedpagesok = true; }	///< Constructor
   ~Database(void);						///< Destructor
   Architecture *getArch(void) const { return glb; }		///< Get the Architecture associate with \b this
   void attachScope(Scope *newscope,Scope *parent);		///< Register a new Scope
   void deleteScope(Scope *scope);				///< Delete the given Scope and all its sub-scopes
   void deleteSubScopes(Scope *scope);				///< Delete all sub-scopes of the given Scope
   void clearUnlocked(Scope *scope);				///< Clear unlocked Symbols owned by the given Scope
+  void restoreDeferred(Scope *scope);				///< Create the deferred Symbols of a Scope and its sub-scopes
   void setRange(Scope *scope,const RangeList &rlist);		///< Set the \e ownership range for a Scope
   void addRange(Scope *scope,AddrSpace *spc,uintb first,uintb last);	///< Add an address range to the \e ownership of a Scope
   void removeRange(Scope *scope,AddrSpace *spc,uintb first,uintb last);	///< Remove an address range from \e ownership of a Scope
@@ -836,7 +1016,10 @@ public:
   const Scope *mapScope(const Scope *qpoint,const Address &addr,const Address &usepoint) const;
   Scope *mapScope(Scope *qpoint,const Address &addr,const Address &usepoint);
   uint4 getProperty(const Address &addr) const { return flagbase.getValue(addr); }	///< Get boolean properties at the given address
+  void noteMapped(const Address &addr,int4 size);		///< Note that a Symbol is mapped to the given memory range
+  bool isPossiblyMapped(const Address &addr) const;		///< Could any Symbol be mapped to the given address
   void setPropertyRange(uint4 flags,const Range &range);	///< Set boolean properties over a given memory range
+  void restorePropertyRange(const partmap<Address,uint4> &orig,const Range &range);	///< Restore boolean properties over a memory range
   void setProperties(const partmap<Address,uint4> &newflags) { flagbase = newflags; }	///< Replace the property map
   const partmap<Address,uint4> &getProperties(void) const { return flagbase; }	///< Get the entire property map
   void saveXml(ostream &s) const;				///< Save the whole Database to an XML stream
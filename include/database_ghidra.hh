@@ -38,14 +38,23 @@ class ScopeGhidra : public Scope {
   ArchitectureGhidra *ghidra;		///< Architecture and connection to the Ghidra client
   mutable ScopeInternal *cache;		///< An internal cache of previously fetched Symbol objects
   mutable RangeList holes;		///< List of (queried) memory ranges with no Symbol in them
+  mutable RangeList misses;		///< Queried addresses whose response was a Symbol not mapped there
+  mutable RangeList labelholes;		///< Queried addresses with no code label
+  mutable uint4 numqueries;		///< Number of queries sent to the Ghidra client
+  mutable uint4 numavoided;		///< Number of queries answered by a negative record instead
   vector<int4> spacerange;		///< List of address spaces that are in the global range
   partmap<Address,uint4> flagbaseDefault;	///< Default boolean properties on memory
   mutable bool cacheDirty;		///< Is flagbaseDefault different from cache
   Symbol *dump2Cache(Document *doc) const;			///< Parse a response into the cache
   Symbol *removeQuery(const Address &addr) const;		///< Process a query that missed the cache
+  bool isMiss(const Address &addr) const;			///< Is the address recorded as having no Symbol mapped to it
+  void recordMiss(const Address &addr) const;			///< Record that the address has no Symbol mapped to it
   void processHole(const Element *el) const;			///< Process a response describing a hole
   Scope *createNewScope(const string &nm,Scope *par) const;	///< Create a global \e namespace Scope
   Scope *reresolveScope(const vector<string> &path) const;	///< Find the Scope that will contain a result Symbol
+  void collectScopes(const Scope *scope,vector<Scope *> &res) const;	///< Gather the \e namespace Scopes below the given one
+  void removeOverlap(const Range &rng,vector<Range> &affected);	///< Remove cached Symbols overlapping a memory range
+  void forgetRange(const Range &rng);				///< Forget queries and properties in a memory range
   virtual void addRange(AddrSpace *spc,uintb first,uintb last);
   virtual void removeRange(AddrSpace *spc,uintb first,uintb last) {
     throw LowlevelError("remove_range should not be performed on ghidra scope");
@@ -66,6 +75,12 @@ public:
   /// can reset to it before decompiling a new function.
   void lockDefaultProperties(void) { flagbaseDefault = ghidra->symboltab->getProperties(); cacheDirty = false; }
   virtual ~ScopeGhidra(void);
+  uint4 getNumQueries(void) const { return numqueries; }	///< Get the number of queries sent to the client
+  uint4 getNumAvoided(void) const { return numavoided; }	///< Get the number of queries avoided by negative records
+  void resetCounters(void) { numqueries = 0; numavoided = 0; }	///< Reset the query counters
+  void invalidateRange(const Range &rng);	///< Drop everything cached about a range of memory
+  void invalidateSymbol(const string &nm);	///< Drop any cached Symbol with the given name
+  void resetFunctions(void);			///< Throw away the analysis of every cached function
   virtual void clear(void);
   virtual SymbolEntry *addSymbol(const string &name,Datatype *ct,
 				 const Address &addr,const Address &usepoint);
@@ -291,8 +291,11 @@ public:
 };
 
 class RuleDoubleIn : public Rule {
+  uint4 failmodcount;		// Modification count of the function when -failed- was filled in
+  set<pair<uint4,uint8> > failed;	// (whole,lo:hi) creation indices of splits no form applied to
+  static pair<uint4,uint8> failureKey(const SplitVarnode &in);
 public:
-  RuleDoubleIn(const string &g) : Rule(g, 0, "doublein") {}
+  RuleDoubleIn(const string &g) : Rule(g, 0, "doublein") { failmodcount = 0; setPrivateState(); }
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleDoubleIn(getGroup());
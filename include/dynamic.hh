@@ -40,6 +40,29 @@ public:
   uint4 hash(uint4 reg) const;					///< Hash \b this edge into an accumulator
 };
 
+/// \brief Dynamic hashes already calculated for the Varnodes of a single function
+///
+/// Finding or assigning a dynamic symbol hashes every Varnode attached to the PcodeOps at
+/// one address, and mapping many symbols in the same function hashes the same Varnodes
+/// over and over.  Each result is stored here, keyed by the Varnode's creation index and
+/// the hash method.  The results are only valid for the data-flow graph they were calculated
+/// on, so the cache records the modification count of the function (see
+/// Funcdata::getModificationCount()) and empties itself as soon as the count changes.
+class DynamicHashCache {
+  /// \brief A calculated hash and the address of the PcodeOp it is attached to
+  struct Entry {
+    uint8 hash;			///< The hash value
+    Address addr;		///< The address associated with the hash
+  };
+  uint4 modcount;				///< Modification count of the function when entries were calculated
+  map<pair<uint4,uint4>,Entry> entries;		///< Hash results indexed by (creation index, method)
+public:
+  DynamicHashCache(void) { modcount = 0; }	///< Constructor
+  bool find(uint4 mod,const Varnode *vn,uint4 method,uint8 &h,Address &addr);	///< Look up a previously calculated hash
+  void insert(const Varnode *vn,uint4 method,uint8 h,const Address &addr);	///< Store a calculated hash
+  void clear(void) { entries.clear(); }		///< Throw away all calculated hashes
+};
+
 /// \brief A hash utility to uniquely identify a temporary Varnode in data-flow
 ///
 /// Most Varnodes can be identified within the data-flow graph by their storage address
@@ -77,6 +100,7 @@ class DynamicHash {
   void buildOpDown(const PcodeOp *op);	///< Move the output Varnode for the given PcodeOp into staging
   void gatherUnmarkedVn(void);		///< Move staged Varnodes into the sub-graph and mark them
   void gatherUnmarkedOp(void);		///< Mark any new PcodeOps in the sub-graph
+  void calcHashCached(const Varnode *root,uint4 method,Funcdata *fd);	///< Calculate a hash, reusing earlier results for the function
 public:
   void clear(void);			///< Called for each additional hash (after the first)
   void calcHash(const Varnode *root,uint4 method);	///< Calculate the hash for given Varnode and method
@@ -25,6 +25,8 @@
 namespace GhidraDec {
 
 class Emulate;			// Forward declaration
+class EmulateTrace;
+class EdgeCoverage;
 
 /// \brief A collection of breakpoints for the emulator
 ///
@@ -134,13 +136,29 @@ inline void BreakCallBack::setEmulate(Emulate *emu)
 ///   - registerPcodeCallback()  or
 ///   = registerAddressCallback()
 ///
-/// Breakpoints are stored in map containers, and the core BreakTable methods
-/// are implemented to search in these containers
+/// Breakpoints are stored in map containers.  As the core BreakTable methods are called
+/// for every instruction and every user-defined op the emulator executes, they search
+/// lookup tables built alongside the maps instead.  Address breakpoints are kept in an
+/// open addressing hash table, behind a bitmap with one bit per hash bucket, so most
+/// addresses without a breakpoint are rejected by testing a single bit.  Pcode breakpoints
+/// are kept in an array indexed by user-defined op.
 class BreakTableCallBack : public BreakTable {
+  static const int4 filterwords = 32;	///< Number of 32-bit words in the address filter
   Emulate *emulate;		///< The emulator associated with this table
   Translate *trans;		///< The translator 
   map<Address,BreakCallBack *> addresscallback;	///< a container of pcode based breakpoints
   map<uintb,BreakCallBack *> pcodecallback; ///< a container of addressed based breakpoints
+  uint4 addressfilter[filterwords];	///< Bit for each hash bucket, set if any breakpoint address falls in it
+  vector<pair<Address,BreakCallBack *> > addressslot;	///< Hash table of address breakpoints, null callback if empty
+  vector<BreakCallBack *> pcodeslot;	///< Pcode breakpoints by user-defined op index, null if none
+  void rebuildAddressSlots(void);	///< Rebuild the hash table of address breakpoints from the map
+  /// rief Hash the offset of an address
+  static uint4 hashAddress(const Address &addr) {
+    uintb off = addr.getOffset();
+    uint4 h = (uint4)(off ^ (off >> 32)) * 0x9e3779b1;
+    return h ^ (h >> 15); }
+  /// rief Test the filter bit for the given hash of an address
+  bool testFilter(uint4 hash) const { return ((addressfilter[hash >> 27] >> ((hash >> 22) & 31)) & 1) != 0; }
 public:
   BreakTableCallBack(Translate *t); ///< Basic breaktable constructor
   void registerPcodeCallback(const string &nm,BreakCallBack *func); ///< Register a pcode based breakpoint
@@ -158,6 +176,8 @@ inline BreakTableCallBack::BreakTableCallBack(Translate *t)
 {
   emulate = (Emulate *)0;
   trans = t;
+  for(int4 i=0;i<filterwords;++i)
+    addressfilter[i] = 0;
 }
 
 /// \brief A pcode-based emulator interface.
@@ -241,11 +261,19 @@ inline bool Emulate::getHalt(void) const
 /// The following p-code operations are stubbed out and will throw an exception:
 /// CALLOTHER, MULTIEQUAL, INDIRECT, CPOOLREF, SEGMENTOP, and NEW.
 /// Of course the derived class can override these.
+///
+/// If an EmulateTrace is attached with setTrace(), every value written by the arithmetic, LOAD,
+/// and STORE operations is recorded along with the op that wrote it.  If an EdgeCoverage map
+/// is attached with setCoverage(), every transfer of control out of an instruction is counted in it.
 
 class EmulateMemory : public Emulate {
 protected:
   MemoryState *memstate;	///< The memory state of the emulator
   PcodeOpRaw *currentOp;	///< Current op to execute
+  EmulateTrace *trace;		///< Recorder of written values (or null)
+  EdgeCoverage *coverage;	///< Map of control-flow edges taken (or null)
+  bool condfall;		///< Set if a CBRANCH in the current instruction was not taken while covering edges
+  void traceWrite(AddrSpace *spc,uintb off,int4 size,uintb val);	///< Record a write by the current op
   virtual void executeUnary(void);
   virtual void executeBinary(void);
   virtual void executeLoad(void);
@@ -263,8 +291,12 @@ protected:
   virtual void executeNew(void);
 public:
   /// Construct given a memory state
-  EmulateMemory(MemoryState *mem) { memstate = mem; currentOp = (PcodeOpRaw *)0; }
+  EmulateMemory(MemoryState *mem) {
+    memstate = mem; currentOp = (PcodeOpRaw *)0; trace = (EmulateTrace *)0; coverage = (EdgeCoverage *)0; condfall = false; }
   MemoryState *getMemoryState(void) const; ///< Get the emulator's memory state
+  void setMemoryState(MemoryState *mem); ///< Switch the emulator to a different memory state
+  void setTrace(EmulateTrace *t) { trace = t; }	///< Attach a recorder of written values (null to detach)
+  void setCoverage(EdgeCoverage *c) { coverage = c; }	///< Attach an edge coverage map (null to detach)
 };
 
 /// \return the memory state object which this emulator uses
@@ -274,6 +306,15 @@ inline MemoryState *EmulateMemory::getMemoryState(void) const
   return memstate;
 }
 
+/// Together with MemoryState::snapshot(), this allows emulation to be forked: take a snapshot at
+/// the fork point, and switch to it to explore the other path.  The emulator does not own the state.
+/// \param mem is the new memory state
+inline void EmulateMemory::setMemoryState(MemoryState *mem)
+
+{
+  memstate = mem;
+}
+
 /// \brief P-code emitter that dumps its raw Varnodes and PcodeOps to an in memory cache
 ///
 /// This is used for emulation when full Varnode and PcodeOp objects aren't needed
@@ -433,7 +474,10 @@ inline Address EmulatePcodeCache::getExecuteAddress(void) const
 
   A MemoryPageOverlay overlays another memory bank as well.  But it implements writes to the bank
   by caching memory \e pages.  Any write creates an aligned page to hold the new data.  The class
-  takes care of loading and filling in pages as needed.
+  takes care of loading and filling in pages as needed.  Pages are found through a binary tree by
+  default, but a MemoryState constructed with MemoryPageOverlay::table_radix or table_direct
+  creates page overlays (via MemoryState::createPageOverlay) that find them through a radix table
+  or a flat array instead, which is much faster for emulation that does many LOADs and STOREs.
 
   Here is an example of instantiating a MemoryState and registering memory banks for a
   \e ram space which is initialized with the load image. The \e ram space is implemented
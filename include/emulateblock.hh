@@ -0,0 +1,188 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file emulateblock.hh
+/// \brief An emulator that pre-decodes whole basic blocks of p-code into threaded code
+
+#ifndef __CPUI_EMULATEBLOCK__
+#define __CPUI_EMULATEBLOCK__
+
+#include "emulate.hh"
+#include "constfold.hh"
+
+namespace GhidraDec {
+
+/// \brief A SLEIGH based emulator that executes pre-decoded basic blocks
+///
+/// The first time execution reaches an address, the machine instructions from there up to
+/// the next control-flow instruction are translated and compiled into a compact array of
+/// operations, which is cached and reused every time the block is executed again.  Compiling
+/// resolves everything the EmulatePcodeCache looks up per op:
+///   - Register operands become offsets into a flat register file, a byte image of the
+///     register space.  Overlapping registers share bytes, so partial accesses behave as usual.
+///   - Temporary operands (the \e unique space) become offsets into a separate scratch file.
+///   - Constants are stored inline, and only other spaces go through the MemoryState.
+///   - Integer operations are executed inline rather than through OpBehavior.
+///   - Branches within an instruction become jumps within the block, and the blocks reached by
+///     direct branches and fall-thru are linked so that no lookup is needed to reach them.
+///
+/// Operations are dispatched through a table of label addresses (computed \e goto) when compiled
+/// with GCC or Clang, and through a \b switch otherwise.
+///
+/// The register file holds the authoritative register values while run() executes.  They are
+/// read from the MemoryState when run() starts and written back when it returns, and around every
+/// breakpoint callback, so the MemoryState is up to date whenever user code can see it.  Temporary
+/// values are not copied back, except for the operands of a CALLOTHER handed to a breakpoint.
+/// Values wider than a \b uintb keep only their least significant bytes.
+///
+/// Address breakpoints are checked at the start of every instruction, as executeInstruction() does
+/// for EmulatePcodeCache.  If none are needed, setAddressBreaks() can turn the check off.  The halt
+/// state is only examined between blocks, so a breakpoint that halts the emulator takes effect at
+/// the end of the current block.  Use clearCache() if the code being emulated changes
+/// (but not from within a breakpoint).
+class EmulateBlockCache : public EmulateMemory {
+  /// \brief Codes for the operations in a compiled block
+  enum {
+    code_nop = 0,		///< No operation
+    code_copy,			///< COPY
+    code_load,			///< LOAD
+    code_store,			///< STORE
+    code_branch,		///< BRANCH or CALL to a fixed address, leaving the block
+    code_cbranch,		///< CBRANCH to a fixed address, leaving the block
+    code_relbranch,		///< BRANCH to another op within the block
+    code_relcbranch,		///< CBRANCH to another op within the block
+    code_branchind,		///< BRANCHIND, CALLIND, or RETURN
+    code_callother,		///< CALLOTHER, handed to a breakpoint
+    code_addrbreak,		///< Check for an address breakpoint at the start of an instruction
+    code_equal,			///< INT_EQUAL
+    code_notequal,		///< INT_NOTEQUAL
+    code_sless,			///< INT_SLESS
+    code_slessequal,		///< INT_SLESSEQUAL
+    code_less,			///< INT_LESS
+    code_lessequal,		///< INT_LESSEQUAL
+    code_zext,			///< INT_ZEXT
+    code_sext,			///< INT_SEXT
+    code_add,			///< INT_ADD
+    code_sub,			///< INT_SUB
+    code_carry,			///< INT_CARRY
+    code_scarry,		///< INT_SCARRY
+    code_sborrow,		///< INT_SBORROW
+    code_2comp,			///< INT_2COMP
+    code_negate,		///< INT_NEGATE
+    code_xor,			///< INT_XOR or BOOL_XOR
+    code_and,			///< INT_AND or BOOL_AND
+    code_or,			///< INT_OR or BOOL_OR
+    code_left,			///< INT_LEFT
+    code_right,			///< INT_RIGHT
+    code_sright,		///< INT_SRIGHT
+    code_mult,			///< INT_MULT
+    code_boolnegate,		///< BOOL_NEGATE
+    code_piece,			///< PIECE
+    code_subpiece,		///< SUBPIECE
+    code_fold,			///< Any other operation with a ConstantFold kernel
+    code_unary,			///< Any other unary operation, evaluated by its OpBehavior
+    code_binary,		///< Any other binary operation, evaluated by its OpBehavior
+    code_unsupported,		///< An operation the emulator can't execute
+    code_max			///< Number of codes
+  };
+  /// \brief Kinds of operand in a compiled block
+  enum {
+    operand_register = 0,	///< Bytes in the register file
+    operand_temp = 1,		///< Bytes in the scratch file for temporaries
+    operand_constant = 2,	///< A constant value
+    operand_memory = 3		///< Bytes accessed through the MemoryState
+  };
+  struct Block;
+  /// \brief A compiled operand
+  struct Operand {
+    int4 kind;			///< Kind of operand
+    int4 size;			///< Size of the operand in bytes
+    uintb offset;		///< Offset into the register or scratch file, the constant, or the memory offset
+    AddrSpace *space;		///< Space of a memory operand, or the space referred to by a LOAD or STORE
+  };
+  /// \brief A compiled p-code operation
+  struct Instr {
+    int4 code;			///< Code for the operation
+    int4 target;		///< Index of the destination op for a branch within the block
+    Operand out;		///< The output operand (if any)
+    Operand in[3];		///< The input operands
+    OpBehavior *behave;		///< Behavior for operations evaluated generically
+    ConstantFold::Kernel fold;	///< Kernel for a \e code_fold operation
+    PcodeOpRaw *raw;		///< The original p-code op
+    Block *link;		///< Block at the destination of a direct branch (if it has been resolved)
+    Address dest;		///< Destination of a direct branch, or the address of an instruction
+  };
+  /// \brief A basic block of machine instructions, compiled for execution
+  struct Block {
+    Address start;		///< Address of the first instruction
+    Address fallthru;		///< Address following the last instruction
+    Block *fallthrulink;	///< Block at the fall-thru address (if it has been resolved)
+    vector<Instr> code;		///< Compiled operations in execution order
+    vector<PcodeOpRaw *> ops;	///< Raw p-code for the block
+    vector<VarnodeData *> vars;	///< Raw varnodes for the block
+    ~Block(void);		///< Destructor
+  };
+  static const int4 maxblockinstr = 256;	///< Maximum number of instructions compiled into one block
+  Translate *trans;		///< The SLEIGH translator
+  vector<OpBehavior *> inst;	///< Map from OpCode to OpBehavior
+  BreakTable *breaktable;	///< The table of breakpoints
+  map<AddressKey,Block *> blocks;	///< Compiled blocks, by starting address
+  AddrSpace *regspace;		///< The space of the register file (null if there is no register file)
+  AddrSpace *uniqspace;		///< The space for temporaries
+  vector<uint1> regfile;	///< Byte image of the register space
+  vector<uint1> regvalid;	///< 1 for each byte of the register file that holds a value
+  vector<pair<int4,int4> > validruns;	///< Runs of held bytes in the register file
+  bool runsdirty;		///< \b true if \b validruns needs to be recomputed
+  vector<uint1> tempfile;	///< Scratch file for temporaries
+  bool regbigendian;		///< \b true if the register file is big endian
+  bool tempbigendian;		///< \b true if the scratch file is big endian
+  bool addressbreaks;		///< \b true if address breakpoints are checked
+  bool redirected;		///< Set when setExecuteAddress() is called during run()
+  Block **pendinglink;		///< Link to fill in with the next block executed (if any)
+  Address current_address;	///< Address of the next instruction to execute
+  void setupRegisterFile(void);	///< Size the register file from the registers of the Translate
+  void makeValid(uintb off,int4 size);	///< Make sure the register file holds the given bytes
+  void buildRuns(void);		///< Recompute the runs of held bytes in the register file
+  void loadRegisters(void);	///< Refresh the register file from the MemoryState
+  void storeRegisters(void);	///< Write the register file back to the MemoryState
+  void compileOperand(const VarnodeData *vn,Operand &res,const vector<pair<uintb,uintb> > &temps);
+  void compileOp(PcodeOpRaw *op,Instr &res,const vector<pair<uintb,uintb> > &temps);
+  Block *buildBlock(const Address &addr);	///< Decode and compile the block at the given address
+  Block *findBlock(const Address &addr);	///< Find or build the block at the given address
+  uintb getOperand(const Operand &op) const;	///< Read the value of an operand
+  void setOperand(const Operand &op,uintb val);	///< Write the value of an operand
+  uintb loadValue(AddrSpace *spc,uintb off,int4 size);	///< Read a value for a LOAD
+  void storeValue(AddrSpace *spc,uintb off,int4 size,uintb val);	///< Write a value for a STORE
+  bool callOther(const Instr &ins);	///< Hand a CALLOTHER to its breakpoint
+  bool addressBreak(const Address &addr);	///< Check for an address breakpoint
+  Block *executeBlock(Block *bl);	///< Execute a single compiled block
+  static uintb readBytes(const uint1 *ptr,int4 size,bool bigendian);	///< Read a value from a byte image
+  static void writeBytes(uint1 *ptr,int4 size,bool bigendian,uintb val);	///< Write a value into a byte image
+protected:
+  virtual void fallthruOp(void);
+public:
+  EmulateBlockCache(Translate *t,MemoryState *s,BreakTable *b);	///< Constructor
+  virtual ~EmulateBlockCache(void);
+  void clearCache(void);	///< Discard all compiled blocks
+  void setAddressBreaks(bool val);	///< Toggle checking for address breakpoints
+  int4 numBlocks(void) const { return blocks.size(); }	///< Get the number of compiled blocks
+  virtual void setExecuteAddress(const Address &addr);
+  virtual Address getExecuteAddress(void) const { return current_address; }
+  uint8 run(uint8 maxops);	///< Execute blocks until halted or a number of operations have executed
+};
+
+} // namespace GhidraDec
+
+#endif
@@ -0,0 +1,74 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file emulatecover.hh
+/// \brief An AFL style map of the control-flow edges taken during emulation
+#ifndef __CPUI_EMULATECOVER__
+#define __CPUI_EMULATECOVER__
+
+#include "types.h"
+#include "error.hh"
+
+
+namespace GhidraDec {
+
+/// \brief A bitmap of hit counts for the control-flow edges taken by an emulator
+///
+/// The map follows the layout used by AFL: each instruction reached by a transfer of control is
+/// hashed to a location, and the byte at (\e location XOR \e previous) is incremented, where
+/// \e previous is the location of the last transfer shifted right by one.  So every edge between
+/// two targets, in either direction, gets its own (hashed) counter.
+///
+/// An EmulateMemory with a map attached (EmulateMemory::setCoverage()) calls visit() on every
+/// BRANCH, CBRANCH, BRANCHIND, CALL, and CALLIND that leaves the instruction, and
+/// EmulatePcodeCache also calls it when an instruction falls through after a CBRANCH that was
+/// not taken.  Straight-line flow is not counted, so the cost is a hash and an increment per
+/// transfer.
+///
+/// The counters are normally held by \b this, but can instead be attached to a System V shared
+/// memory segment, such as the one a fuzzer names in the \e __AFL_SHM_ID environment variable.
+class EdgeCoverage {
+  uint1 *map;			///< The counters
+  uint4 mask;			///< Number of counters minus one
+  uint4 prevloc;		///< Location of the previous transfer, shifted right by one
+  vector<uint1> local;	///< Storage for the counters, if they are not shared
+  void *shared;			///< Attached shared memory segment (or null)
+  void detach(void);		///< Detach from any shared memory segment
+public:
+  EdgeCoverage(int4 bits=16);	///< Construct a map with 2^bits counters
+  ~EdgeCoverage(void) { detach(); }	///< Destructor
+  void attachShared(int4 shmid);	///< Use a shared memory segment for the counters
+  bool attachFromEnvironment(void);	///< Use the segment named by \e __AFL_SHM_ID, if present
+  void visit(uintb addr);		///< Note a transfer of control to the given address
+  void reset(void) { prevloc = 0; }	///< Start a new run, not connected to the previous transfer
+  void clear(void);			///< Zero every counter and start a new run
+  uint4 getSize(void) const { return mask + 1; }	///< Get the number of counters
+  const uint1 *getMap(void) const { return map; }	///< Get the array of counters
+  uint4 countEdges(void) const;		///< Count the counters that are non-zero
+};
+
+/// The target is hashed to a location, and the counter for the edge from the previous location
+/// is incremented, wrapping at 256 like AFL.
+/// \param addr is the offset of the address that control is transferred to
+inline void EdgeCoverage::visit(uintb addr)
+
+{
+  uint4 cur = (uint4)((addr * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+  map[cur ^ prevloc] += 1;
+  prevloc = cur >> 1;
+}
+
+}
+#endif
@@ -0,0 +1,151 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file emulatelanes.hh
+/// \brief An emulator running the same code over many independent machine states at once
+
+#ifndef __CPUI_EMULATELANES__
+#define __CPUI_EMULATELANES__
+
+#include "emulate.hh"
+#include "constfold.hh"
+
+namespace GhidraDec {
+
+/// \brief A SLEIGH based emulator executing a number of \e lanes of machine state in lock-step
+///
+/// Each lane is an independent machine, with its own MemoryState and execution address, but all
+/// lanes run the same code.  Lanes at the same address execute the instruction together: every
+/// p-code op is applied to all of them with one call, using the array kernels of ConstantFold
+/// where there is one.  This makes running a piece of code over thousands of different inputs
+/// much cheaper than running an EmulatePcodeCache for each.
+///
+/// Registers and temporaries are held in files laid out by byte and then by lane, so that the
+/// value of a byte for consecutive lanes is contiguous.  Like the EmulateBlockCache, the register
+/// file is read from the MemoryState of each lane when run() starts and written back when it returns.
+/// Other spaces are accessed through the MemoryState of the lane.
+///
+/// Lanes whose control flow diverges are separated: each step executes the instruction at the
+/// lowest address any running lane is at, for the lanes at that address only, so lanes that branch
+/// around code meet again where the paths join.  Branches within an instruction are handled
+/// the same way, by executing each p-code op for the lanes that have reached it.
+///
+/// A lane stops when it reaches one of the halt addresses, or with a fault when one of its
+/// operations fails (division by zero, an operation that can't be emulated, a CALLOTHER, or an
+/// address that can't be decoded).  The fault doesn't affect the other lanes.  There are no breakpoints.
+class EmulateLanes {
+public:
+  /// \brief The execution status of a lane
+  enum {
+    lane_running = 0,		///< The lane is still executing
+    lane_halted = 1,		///< The lane reached a halt address
+    lane_fault = 2		///< An operation of the lane failed
+  };
+private:
+  /// \brief Kinds of operand in a compiled instruction
+  enum {
+    operand_register = 0,	///< Bytes in the register file
+    operand_temp = 1,		///< Bytes in the scratch file for temporaries
+    operand_constant = 2,	///< A constant value
+    operand_memory = 3		///< Bytes accessed through the MemoryState of each lane
+  };
+  /// \brief A compiled operand
+  struct Operand {
+    int4 kind;			///< Kind of operand
+    int4 size;			///< Size of the operand in bytes
+    uintb offset;		///< Offset into the register or scratch file, the constant, or the memory offset
+    AddrSpace *space;		///< Space of a memory operand, or the space referred to by a LOAD or STORE
+  };
+  /// \brief A compiled p-code operation
+  struct Op {
+    OpCode opc;			///< The opcode
+    OpBehavior *behave;		///< Behavior of the operation
+    ConstantFold::BatchKernel batch;	///< Array kernel for the operation (if any)
+    int4 numin;			///< Number of inputs
+    int4 target;		///< Index of the destination op of a branch within the instruction (or -1)
+    Operand out;		///< The output operand (if any)
+    Operand in[3];		///< The input operands
+    Address dest;		///< Destination of a direct branch
+  };
+  /// \brief A machine instruction, compiled for execution
+  struct Instruction {
+    Address fallthru;		///< Address following the instruction
+    vector<Op> code;		///< Compiled operations
+    vector<PcodeOpRaw *> ops;	///< Raw p-code of the instruction
+    vector<VarnodeData *> vars;	///< Raw varnodes of the instruction
+    ~Instruction(void);		///< Destructor
+  };
+  Translate *trans;		///< The SLEIGH translator
+  vector<OpBehavior *> inst;	///< Map from OpCode to OpBehavior
+  int4 numlanes;		///< Number of lanes
+  vector<MemoryState *> memstate;	///< The MemoryState of each lane
+  vector<Address> pc;		///< The execution address of each lane
+  vector<int4> status;		///< The status of each lane
+  vector<string> faultmsg;	///< The reason each faulted lane stopped
+  vector<int4> opindex;		///< Index of the next op of each lane within the current instruction
+  set<Address> haltaddr;	///< Addresses at which lanes halt
+  map<AddressKey,Instruction *> cache;	///< Compiled instructions, by address
+  AddrSpace *regspace;		///< The space of the register file (null if there is no register file)
+  AddrSpace *uniqspace;		///< The space for temporaries
+  int4 regsize;			///< Number of bytes of the register space in the register file
+  vector<uint1> regfile;	///< Register file, by byte and then by lane
+  vector<uint1> regvalid;	///< 1 for each byte of the register space the register file holds
+  int4 tempsize;		///< Number of bytes of temporaries per lane in the scratch file
+  vector<uint1> tempfile;	///< Scratch file for temporaries, by byte and then by lane
+  bool regbigendian;		///< \b true if the register space is big endian
+  bool tempbigendian;		///< \b true if the space for temporaries is big endian
+  vector<uintb> column[3];	///< Values of the inputs of the current op, for each lane in the group
+  vector<uintb> result;		///< Values of the output of the current op, for each lane in the group
+  void setupRegisterFile(void);	///< Size the register file from the registers of the Translate
+  void transferRegisters(int4 lane,uintb off,int4 size,bool store);	///< Copy register bytes of a lane
+  void makeValid(uintb off,int4 size);	///< Make sure the register file holds the given bytes
+  void loadRegisters(void);	///< Refresh the register file from the MemoryState of every lane
+  void storeRegisters(void);	///< Write the register file back to the MemoryState of every lane
+  void compileOperand(const VarnodeData *vn,Operand &res,const vector<pair<uintb,uintb> > &temps);
+  void compileOp(PcodeOpRaw *op,Op &res,const vector<pair<uintb,uintb> > &temps);
+  Instruction *buildInstruction(const Address &addr);	///< Decode and compile the instruction at an address
+  Instruction *findInstruction(const Address &addr);	///< Find or build the instruction at an address
+  void readFile(const vector<uint1> &file,uintb off,int4 size,bool bigendian,
+		const int4 *lanes,int4 count,uintb *vals) const;
+  void writeFile(vector<uint1> &file,uintb off,int4 size,bool bigendian,
+		 const int4 *lanes,int4 count,const uintb *vals);
+  void readOperand(const Operand &op,const int4 *lanes,int4 count,uintb *vals);
+  void writeOperand(const Operand &op,const int4 *lanes,int4 count,const uintb *vals);
+  void fault(int4 lane,const string &msg);	///< Stop a lane with a fault
+  void executeLoad(const Op &op,const int4 *lanes,int4 count);
+  void executeStore(const Op &op,const int4 *lanes,int4 count);
+  void executeArithmetic(const Op &op,const int4 *lanes,int4 count);
+  void executeOp(const Op &op,int4 index,const vector<int4> &group,const Address &addr);
+  void executeInstruction(const Address &addr,const vector<int4> &group);
+public:
+  EmulateLanes(Translate *t,int4 n);	///< Constructor
+  ~EmulateLanes(void);		///< Destructor
+  int4 numLanes(void) const { return numlanes; }	///< Get the number of lanes
+  void setMemoryState(int4 lane,MemoryState *mem);	///< Set the MemoryState of a lane
+  MemoryState *getMemoryState(int4 lane) const { return memstate[lane]; }	///< Get the MemoryState of a lane
+  void setExecuteAddress(int4 lane,const Address &addr);	///< Set the execution address of a lane
+  void setExecuteAddress(const Address &addr);	///< Set the execution address of every lane
+  const Address &getExecuteAddress(int4 lane) const { return pc[lane]; }	///< Get the execution address of a lane
+  int4 getStatus(int4 lane) const { return status[lane]; }	///< Get the status of a lane
+  const string &getFault(int4 lane) const { return faultmsg[lane]; }	///< Get the reason a lane faulted
+  void addHaltAddress(const Address &addr) { haltaddr.insert(addr); }	///< Halt lanes reaching an address
+  void clearHaltAddresses(void) { haltaddr.clear(); }	///< Remove all halt addresses
+  void clearCache(void);	///< Discard all compiled instructions
+  uint8 run(uint8 maxinstr);	///< Execute until every lane stops or a number of instructions have executed
+};
+
+} // namespace GhidraDec
+
+#endif
@@ -0,0 +1,106 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file emulatetrace.hh
+/// \brief A compact binary trace of the values written during emulation, and its reader
+#ifndef __CPUI_EMULATETRACE__
+#define __CPUI_EMULATETRACE__
+
+#include "translate.hh"
+
+#include <atomic>
+#include <thread>
+#include <fstream>
+
+namespace GhidraDec {
+
+/// \brief A single write made by the emulator
+struct EmulateTraceRecord {
+  int4 codespace;		///< Index of the address space of the instruction making the write
+  uintb addr;			///< Offset of the instruction making the write
+  int4 opindex;			///< Index of the p-code op, within the instruction, making the write
+  int4 space;			///< Index of the address space written to
+  uintb offset;			///< Offset written to
+  int4 size;			///< Number of bytes written
+  uintb value;			///< The value written
+};
+
+/// \brief Recorder of the values written by an emulator, as a compact binary file
+///
+/// Every record is the (instruction address, p-code op index, written varnode, value) of one
+/// write.  Records are encoded against the previous record: a tag byte says which of the code
+/// space, instruction address, written space and size changed, and holds small op indices, while
+/// addresses and offsets are zig-zag varint deltas and the value is a varint.  A write within the
+/// same instruction to a nearby location typically takes 3 or 4 bytes.
+///
+/// Records are encoded directly into the current chunk of a ring of chunks.  When a chunk
+/// fills, it is handed to a writer thread that copies it to the file, so the emulating thread
+/// never waits on the disk unless the whole ring is full.  The ring is single-producer
+/// single-consumer, synchronized by two atomic chunk counts and no locks.
+///
+/// The file begins with a header listing the name of each address space by index, which
+/// EmulateTraceReader uses to decode the records.
+class EmulateTrace {
+  static const int4 numchunks = 16;		///< Number of chunks in the ring
+  static const int4 chunksize = 65536;		///< Number of bytes in a chunk
+  static const int4 maxrecord = 48;		///< Largest possible encoded record
+  vector<uint1> chunk[numchunks];		///< The ring of chunks
+  int4 chunkfill[numchunks];			///< Number of bytes used in each chunk handed to the writer
+  std::atomic<uint4> head;			///< Number of chunks filled by the emulating thread
+  std::atomic<uint4> tail;			///< Number of chunks written out by the writer thread
+  std::atomic<bool> done;			///< Set when no more chunks will be filled
+  std::ofstream file;				///< The trace file
+  std::thread writer;				///< The writer thread
+  uint1 *cur;					///< Next free byte in the current chunk
+  uint1 *curend;				///< Last byte at which a new record can start in the current chunk
+  uintb numrecords;				///< Number of records written
+  AddrSpace *lastcodespace;			///< Code space of the previous record
+  uintb lastaddr;				///< Instruction address of the previous record
+  AddrSpace *lastspace;				///< Written space of the previous record
+  uintb lastoffset;				///< Written offset of the previous record
+  int4 lastsize;				///< Written size of the previous record
+  void writeLoop(void);				///< Main loop of the writer thread
+  void pushChunk(void);				///< Hand the current chunk to the writer and start the next one
+  void startChunk(void);			///< Point at the start of the chunk at the head of the ring
+  static uint1 *writeVarint(uint1 *ptr,uintb val);	///< Encode an unsigned varint
+public:
+  EmulateTrace(void);				///< Construct a recorder that is not open
+  ~EmulateTrace(void) { close(); }		///< Destructor
+  void open(const string &filename,const AddrSpaceManager *manage);	///< Open a trace file and start the writer
+  void close(void);				///< Flush all records and close the file
+  bool isOpen(void) const { return file.is_open(); }	///< Return \b true if records are being written
+  uintb getNumRecords(void) const { return numrecords; }	///< Get the number of records written so far
+  void record(const Address &addr,int4 opindex,AddrSpace *spc,uintb off,int4 size,uintb val);	///< Record one write
+};
+
+/// \brief Reader of the trace files written by EmulateTrace
+///
+/// Address spaces in the records are given by index, and the names of the spaces are taken from
+/// the header of the trace, so a trace can be read without loading the processor specification.
+class EmulateTraceReader {
+  std::istream &s;				///< The trace being read
+  vector<string> spacename;			///< Name of the address space for each index in the trace
+  EmulateTraceRecord last;			///< The previous record read
+  uint1 readByte(void);				///< Read a byte, throwing at the end of the stream
+  uintb readVarint(void);			///< Decode an unsigned varint
+  int4 readSpace(void);				///< Read and check a space index
+public:
+  EmulateTraceReader(std::istream &st);		///< Read the header of a trace
+  const string &getSpaceName(int4 i) const { return spacename[i]; }	///< Get the name of a space by index
+  bool next(EmulateTraceRecord &rec);		///< Read the next record
+};
+
+}
+#endif
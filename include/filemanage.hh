@@ -23,6 +23,7 @@
 #include <iostream>
 #include <sstream>
 #include <fstream>
+#include <ctime>
 
 //using namespace std;
 namespace GhidraDec {
@@ -38,7 +39,9 @@ public:
   void addCurrentDir(void);
   void findFile(string &res,const string &name) const; // Resolve full pathname
   void matchList(vector<string> &res,const string &match,bool isSuffix) const; // List of files with suffix
+  const vector<string> &getPaths(void) const { return pathlist; } // Directories searched, each ending in a separator
   static bool isDirectory(const string &path);
+  static bool getModificationTime(const string &path,time_t &res); // Last-modified time of a file or directory
   static void matchListDir(vector<string> &res,const string &match,bool isSuffix,const string &dir,bool allowdot);
   static void directoryList(vector<string> &res,const string &dirname,bool allowdot=false);
   static void scanDirectoryRecursive(vector<string> &res,const string &matchname,const string &rootpath,int maxdepth);
@@ -0,0 +1,184 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file flatindex.hh
+/// \brief The flatindex<> template, a frozen search array over the keys of an ordered container
+#ifndef __FLATINDEX__
+#define __FLATINDEX__
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+
+namespace GhidraDec {
+
+/// \brief The type a flatindex stores in place of a key of the container
+///
+/// By default this is the key itself.  A key that is expensive to compare can
+/// specialize this with a cheaper type that orders the same way and can be
+/// constructed from the key.
+template<typename _keytype>
+struct flatkey {
+  typedef _keytype type;	///< The stored key type
+};
+
+/// \brief A read-only copy of the keys of an ordered container, laid out for fast binary search
+///
+/// The flatindex is a template class taking:
+///   -  _keytype which is the (ordered) key of the container
+///   -  _payloadtype which is what the container wants back for a key, usually an iterator
+///
+/// The keys are stored in a contiguous array in the \e Eytzinger (breadth-first) order of a
+/// complete binary tree, so the first levels of every search share the same cache lines, and
+/// each step of the search picks the next child without a branch.  A search returns the \e rank
+/// of the key found, its position in the sorted order, which selects the payload.
+///
+/// An ordered container (like partmap or rangemap) keeps one of these next to its tree.  It
+/// starts out \e thawed (empty), and the container keeps searching its tree.  Once the container
+/// has been searched as many times as it has keys (and at least \b minprobes times) without
+/// being modified, the index is built, and it answers all further searches.  Any modification
+/// of the container throws the index away again, so maps that are built once and then only
+/// read pay for the index once.  Copying an index produces a thawed one, as the payloads
+/// of the copy would still refer to the original container.
+///
+/// Threads that only search the container, as readers sharing a lock over it, may count searches
+/// and build the index at the same time: the count is atomic, only one thread builds the index,
+/// and the index is published to the others once it is complete.  Modifying the container, and
+/// so thawing the index, still requires that no other thread is searching it.
+template<typename _keytype,typename _payloadtype>
+class flatindex {
+  enum { minprobes = 16 };	///< Smallest number of searches before the index is built
+  typedef typename flatkey<_keytype>::type storetype;	///< The type of a stored key
+  std::vector<storetype> key;	///< Keys in Eytzinger order, starting at index 1
+  std::vector<int> rank;	///< Rank of each key, in the same order
+  std::vector<_payloadtype> payload;	///< Payload by rank, with an extra final entry for \e end
+  int count;			///< Number of keys in the index
+  std::atomic<int> probes;	///< Number of searches since the container was last modified
+  std::atomic<bool> frozen;	///< \b true if the index has been built
+  std::mutex freezelock;	///< Keeps threads searching the container from building the index twice
+  void fill(const std::vector<_keytype> &sorted,int &i,int k);	///< Lay out the keys of a subtree
+  /// \brief Convert the final position of a search into the rank of the key it found
+  static int finish(int k) {
+#if defined(__GNUC__)
+    return k >> __builtin_ffs(~k);
+#else
+    while((k & 1) != 0) k >>= 1;
+    return k >> 1;
+#endif
+  }
+public:
+  flatindex(void) : probes(0), frozen(false) { count = 0; }	///< Construct a thawed index
+  flatindex(const flatindex &op2) : probes(0), frozen(false) { count = 0; }	///< Copying produces a thawed index
+  flatindex &operator=(const flatindex &op2) { thaw(); return *this; }	///< Assignment thaws the index
+  bool isFrozen(void) const { return frozen.load(std::memory_order_acquire); }	///< Return \b true if the index answers searches
+
+  /// \brief Count a search of the container and decide if the index should be built
+  ///
+  /// \param size is the number of keys in the container
+  /// \return \b true if the container should build the index with freeze() now
+  bool probe(int size) {
+    int num = probes.fetch_add(1,std::memory_order_relaxed) + 1;
+    return (num >= size && num >= minprobes);
+  }
+  void freeze(const std::vector<_keytype> &sorted,const std::vector<_payloadtype> &pay);	///< Build the index
+  void thaw(void);		///< Throw away the index, after the container is modified
+  int lowerBound(const _keytype &x) const;	///< Rank of the first key not less than the given key
+  int upperBound(const _keytype &x) const;	///< Rank of the first key greater than the given key
+  const _payloadtype &getPayload(int r) const { return payload[r]; }	///< Get the payload of a rank
+};
+
+/// Keys are handed out in sorted order to an in-order walk of the implicit tree,
+/// whose node \e k has children 2k and 2k+1.
+/// \param sorted is the sorted list of keys
+/// \param i is the index of the next key to hand out
+/// \param k is the root of the subtree
+template<typename _keytype,typename _payloadtype>
+  void flatindex<_keytype,_payloadtype>::
+  fill(const std::vector<_keytype> &sorted,int &i,int k)
+
+  {
+    if (k > count) return;
+    fill(sorted,i,2*k);
+    key[k] = storetype(sorted[i]);
+    rank[k] = i;
+    i += 1;
+    fill(sorted,i,2*k+1);
+  }
+
+/// If another thread built the index while the keys were being collected, nothing is done.
+/// \param sorted is the keys of the container, in order
+/// \param pay is the payload of each key, plus a final payload returned for ranks past the last key
+template<typename _keytype,typename _payloadtype>
+  void flatindex<_keytype,_payloadtype>::
+  freeze(const std::vector<_keytype> &sorted,const std::vector<_payloadtype> &pay)
+
+  {
+    std::lock_guard<std::mutex> guard(freezelock);
+    if (frozen.load(std::memory_order_relaxed)) return;
+    count = sorted.size();
+    key.resize(count+1);
+    rank.resize(count+1);
+    rank[0] = count;		// A search that runs off the tree lands on 0, meaning the end
+    int i = 0;
+    fill(sorted,i,1);
+    payload = pay;
+    frozen.store(true,std::memory_order_release);	// Searches by other threads see the complete index
+  }
+
+template<typename _keytype,typename _payloadtype>
+  void flatindex<_keytype,_payloadtype>::
+  thaw(void)
+
+  {
+    probes.store(0,std::memory_order_relaxed);
+    if (!frozen.load(std::memory_order_relaxed)) return;
+    key.clear();
+    rank.clear();
+    payload.clear();
+    count = 0;
+    frozen.store(false,std::memory_order_relaxed);
+  }
+
+/// \param x is the key to search for
+/// \return the rank of the first key not less than \b x (or the number of keys, if there is none)
+template<typename _keytype,typename _payloadtype>
+  int flatindex<_keytype,_payloadtype>::
+  lowerBound(const _keytype &x) const
+
+  {
+    storetype sx(x);
+    int k = 1;
+    while(k <= count)
+      k = 2*k + (key[k] < sx ? 1 : 0);
+    return rank[finish(k)];
+  }
+
+/// \param x is the key to search for
+/// \return the rank of the first key greater than \b x (or the number of keys, if there is none)
+template<typename _keytype,typename _payloadtype>
+  int flatindex<_keytype,_payloadtype>::
+  upperBound(const _keytype &x) const
+
+  {
+    storetype sx(x);
+    int k = 1;
+    while(k <= count)
+      k = 2*k + (sx < key[k] ? 0 : 1);
+    return rank[finish(k)];
+  }
+
+} // namespace GhidraDec
+
+#endif
@@ -30,6 +30,10 @@ namespace GhidraDec {
 /// An encoding can be converted to and from the host format and
 /// convenience methods allow p-code floating-point operations to be
 /// performed on natively encoded operands.  This follows the IEEE754 standards.
+///
+/// If the encoding is IEEE 754 binary32 or binary64 and the host's \b float and \b double types
+/// are IEEE 754 as well, conversions work directly on the bits of the host value, instead of
+/// decomposing it with frexp() and ldexp().  The results are the same as for the general case.
 class FloatFormat {
 public:
   /// \brief The various classes of floating-point encodings
@@ -41,6 +45,12 @@ public:
     denormalized = 4		///< A denormalized encoding (for very small values)
   };
 private:
+  /// \brief Host encodings that a format can match
+  enum hostformat {
+    host_none = 0,		///< The format has no host equivalent
+    host_binary32 = 1,		///< The format is laid out the same as the host's \b float
+    host_binary64 = 2		///< The format is laid out the same as the host's \b double
+  };
   int4 size;			///< Size of float in bytes (this format)
   int4 signbit_pos;		///< Bit position of sign bit
   int4 frac_pos;		///< (lowest) bit position of fractional part
@@ -50,6 +60,7 @@ private:
   int4 bias;			///< What to add to real exponent to get encoding
   int4 maxexponent;		///< Maximum possible exponent
   bool jbitimplied;		///< Set to \b true if integer bit of 1 is assumed
+  hostformat hostmatch;		///< Host encoding with the same layout as \b this format
   static double createFloat(bool sign,uintb signif,int4 exp);	 ///< Create a double given sign, fractional, and exponent
   static floatclass extractExpSig(double x,bool *sgn,uintb *signif,int4 *exp);
   uintb setFractionalCode(uintb x,uintb code) const;		///< Set the fractional part of an encoded value
@@ -58,8 +69,11 @@ private:
   uintb getZeroEncoding(bool sgn) const;			///< Get an encoded zero value
   uintb getInfinityEncoding(bool sgn) const;			///< Get an encoded infinite value
   uintb getNaNEncoding(bool sgn) const;				///< Get an encoded NaN value
+  void setHostMatch(void);					///< Check if \b this has the layout of a host encoding
+  double getHostFloatNative(uintb encoding,floatclass *type) const;	///< Convert a host-compatible encoding into host's double
+  uintb getEncodingNative(double host) const;			///< Convert host's double into a host-compatible encoding
 public:
-  FloatFormat(void) {}	///< Construct for use with restoreXml()
+  FloatFormat(void) { hostmatch = host_none; }	///< Construct for use with restoreXml()
   FloatFormat(int4 sz);	///< Construct default IEEE 754 standard settings
   int4 getSize(void) const { return size; }			///< Get the size of the encoding in bytes
   double getHostFloat(uintb encoding,floatclass *type) const;	///< Convert an encoding into host's double
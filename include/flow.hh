@@ -84,20 +84,27 @@ private:
   BlockGraph &bblocks;			///< Container for the control-flow graph
   vector<FuncCallSpecs *> &qlst;	///< The list of discovered sub-function call sites
   PcodeEmitFd emitter;			///< PCodeOp factory (configured to allocate into \b data and \b obank)
+  PcodeRun run;				///< Instructions translated ahead of the current fall-thru address
+  int4 runnext;				///< Index of the next unconsumed instruction in \b run
+  vector<Varnode *> uniquewrites;	///< Temporaries written so far in the instruction being linked
+  Address runbound;			///< Bound on the current fall-thru sequence
   vector<Address> unprocessed;		///< Addresses which are permanently unprocessed
   vector<Address> addrlist;		///< Addresses to which there is flow
   vector<PcodeOp *> tablelist;		///< List of BRANCHIND ops (preparing for jump table recovery)
   vector<PcodeOp *> injectlist;		///< List of p-code ops that need injection
-  map<Address,VisitStat> visited;	///< Map of machine instructions that have been visited so far
-  list<PcodeOp *> block_edge1;		///< Source p-code op (Edges between basic blocks)
-  list<PcodeOp *> block_edge2;		///< Destination p-code op (Edges between basic blocks)
+  map<AddressKey,VisitStat> visited;	///< Map of machine instructions that have been visited so far
+  vector<PcodeOp *> block_edge1;	///< Source p-code op (Edges between basic blocks)
+  vector<PcodeOp *> block_edge2;	///< Destination p-code op (Edges between basic blocks)
   uint4 insn_count;			///< Number of instructions flowed through
   uint4 insn_max;			///< Maximum number of instructions
+  uint4 op_max;				///< Maximum number of raw p-code ops, before flow is cut into regions
+  vector<Address> regioncuts;		///< Instructions at which flow was cut because of \b op_max
   Address baddr;			///< Start of range in which we are allowed to flow
   Address eaddr;			///< End of range in which we are allowed to flow
   Address minaddr;			///< Start of actual function range
   Address maxaddr;			///< End of actual function range
   bool flowoverride_present;		///< Does the function have registered flow override instructions
+  vector<pair<Address,uint4> > flowoverlist;	///< Flow overrides within the flow bounds, sorted by address
   uint4 flags;				///< Boolean options for flow following
   Funcdata *inline_head;		///< First function in the in-lining chain
   set<Address> *inline_recursion;	///< Active list of addresses for function that are in-lined
@@ -105,19 +112,22 @@ private:
   bool hasPossibleUnreachable(void) const { return ((flags & possible_unreachable)!=0); }	///< Are there possible unreachable ops
   void setPossibleUnreachable(void) { flags |= possible_unreachable; }	///< Mark that there may be unreachable ops
   void clearProperties(void);		///< Clear any discovered flow properties
+  uint4 findFlowOverride(const Address &addr) const;	///< Look up the flow override for an instruction
   bool seenInstruction(const Address &addr) const {
-    return (visited.find(addr) != visited.end()); }	///< Has the given instruction (address) been seen in flow
+    return (visited.find(AddressKey(addr)) != visited.end()); }	///< Has the given instruction (address) been seen in flow
   PcodeOp *fallthruOp(PcodeOp *op) const;		///< Find fallthru pcode-op for given op
   void newAddress(PcodeOp *from,const Address &to);	///< Register a new (non fall-thru) flow target
   void deleteRemainingOps(list<PcodeOp *>::const_iterator oiter);
   PcodeOp *xrefControlFlow(list<PcodeOp *>::const_iterator oiter,bool &startbasic,bool &isfallthru,FuncCallSpecs *fc);
+  int4 translateInstruction(const Address &curaddr);	///< Generate p-code for the next fall-thru instruction
+  void linkUniques(list<PcodeOp *>::const_iterator oiter);	///< Link reads of temporaries to their writes within one instruction
   bool processInstruction(const Address &curaddr,bool &startbasic);
   void fallthru(void);					///< Process (the next) sequence of instructions in fall-thru order
   PcodeOp *findRelTarget(PcodeOp *op,Address &res) const;
   void findUnprocessed(void);				///< Add any remaining un-followed addresses to the \b unprocessed list
   void dedupUnprocessed(void);				///< Get rid of duplicates in the \b unprocessed list
   void fillinBranchStubs(void);				///< Fill-in artificial HALT p-code for \b unprocessed addresses
-  void collectEdges(void);				///< Collect edges between basic blocks as PcodeOp to PcodeOp pairs
+  void collectEdges(PcodeOp *op,bool nextstart);	///< Collect edges out of one op as PcodeOp to PcodeOp pairs
   void splitBasic(void);				///< Split raw p-code ops up into basic blocks
   void connectBasic(void);				///< Generate edges between basic blocks
   bool setFallthruBound(Address &bound);		///< Find end of the next unprocessed region
@@ -143,6 +153,7 @@ public:
   FlowInfo(Funcdata &d,PcodeOpBank &o,BlockGraph &b,vector<FuncCallSpecs *> &q,const FlowInfo *op2);	///< Cloning constructor
   void setRange(const Address &b,const Address &e) { baddr = b; eaddr = e; }	///< Establish the flow bounds
   void setMaximumInstructions(uint4 max) { insn_max = max; }	///< Set the maximum number of instructions
+  void setMaximumOps(uint4 max) { op_max = max; }	///< Set the maximum number of raw p-code ops
   void setFlags(uint4 val) { flags |= val; }	///< Enable a specific option
   void clearFlags(uint4 val) { flags &= ~val; }	///< Disable a specific option
   PcodeOp *target(const Address &addr) const;	///< Return first p-code op for instruction at given address
@@ -162,6 +173,7 @@ public:
   bool hasOutOfBounds(void) const { return ((flags & outofbounds_present)!=0); }	///< Does \b this flow out of bound
   bool hasReinterpreted(void) const { return ((flags & reinterpreted_present)!=0); }	///< Does \b this flow reinterpret bytes
   bool hasTooManyInstructions(void) const { return ((flags & toomanyinstructions_present)!=0); }	///< Does \b this flow have too many instructions
+  const vector<Address> &getRegionCuts(void) const { return regioncuts; }	///< Get the instructions where flow was cut into regions
   bool isFlowForInline(void) const { return ((flags & flow_forinline)!=0); }	///< Is \b this flow to be in-lined
   bool doesJumpRecord(void) const { return ((flags & record_jumploads)!=0); }	///< Should jump table structure be recorded
 };
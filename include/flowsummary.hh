@@ -0,0 +1,78 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file flowsummary.hh
+/// \brief A persistent database of prototypes for small, common functions, keyed by their bytes
+#ifndef __CPUI_FLOWSUMMARY__
+#define __CPUI_FLOWSUMMARY__
+
+#include "funcdata.hh"
+
+namespace GhidraDec {
+
+/// \brief A database of function summaries, looked up by the bytes at a function's entry point
+///
+/// Thunks, PLT stubs, and library functions linked into many programs have the same code each time,
+/// but their prototypes are recovered again at every call site of every program.  A summary holds the
+/// prototype of such a function, including its \e extrapop, its EffectRecords, and whether it returns
+/// or is inlined, and it is keyed by the first bytes of its code (up to \b maxsignature bytes, stopping
+/// at the end of the code that starts at the entry point).  When FlowInfo sets up a call whose target
+/// has no locked prototype, the bytes at the target are looked up, and a matching summary is copied
+/// to the call site as if it were a prototype override, so neither the callee's flow nor parameter
+/// recovery is needed for it.
+///
+/// Summaries are recorded from decompiled functions whose prototypes are locked, so only known
+/// prototypes get into the database.  They are read from and written to an XML file:
+/// \code
+///   <flowsummaries>
+///     <summary bytes="ff2522e00000">
+///       <prototype .../>
+///     </summary>
+///   </flowsummaries>
+/// \endcode
+/// Like any signature, a byte match can be wrong for code that embeds relative offsets, so the
+/// database should be built from, and used with, programs from the same toolchain.
+/// Lookups can happen on several threads at once.  Recording and saving must not overlap them.
+class FlowSummaryDb {
+  /// \brief A single function summary
+  struct Summary {
+    string bytes;			///< The bytes at the entry point of the function
+    FuncProto *proto;			///< The prototype of the function, with its own parameter storage
+  };
+  static const int4 prefixsize = 4;	///< Number of bytes used to index summaries
+  static const int4 maxsignature = 32;	///< Maximum number of bytes in a signature
+  Architecture *glb;			///< The Architecture using the database
+  string filename;			///< File the database is read from and saved to
+  map<string,vector<Summary *> > index;	///< Summaries by their first \b prefixsize bytes
+  vector<Summary *> shortsummaries;	///< Summaries with fewer than \b prefixsize bytes
+  int4 numsummaries;			///< Number of summaries
+  Summary *find(const string &bytes) const;	///< Find the summary with exactly the given bytes
+  Summary *match(const uint1 *buf,int4 size) const;	///< Find the longest summary matching the given bytes
+  void insert(Summary *sum);		///< Add a summary to the index
+  int4 signatureLength(const Funcdata *fd) const;	///< Get the number of bytes in the signature of a function
+  void restoreXml(const Element *el);	///< Read summaries from a \<flowsummaries> element
+public:
+  FlowSummaryDb(Architecture *g,const string &fname);	///< Construct, reading the file if it exists
+  ~FlowSummaryDb(void);			///< Destructor
+  const string &getFileName(void) const { return filename; }	///< Get the file backing the database
+  int4 numSummaries(void) const { return numsummaries; }	///< Get the number of summaries
+  const FuncProto *lookup(const Address &addr) const;	///< Look up the summary of the function at the given address
+  bool record(const Funcdata *fd);	///< Record the summary of a decompiled function
+  void save(void) const;		///< Write the database to its file
+};
+
+} // namespace GhidraDec
+
+#endif
@@ -21,6 +21,9 @@
 
 #include "op.hh"
 
+#include <mutex>
+#include <atomic>
+
 namespace GhidraDec {
 
 class JoinRecord;
@@ -71,12 +74,15 @@ private:
   int4 alignment;		///< How much alignment (0 means only 1 logical value is allowed)
   int4 numslots;		///< (Maximum) number of slots that can store separate parameters
   JoinRecord *joinrec;		///< Non-null if this is logical variable from joined pieces
+  mutable int4 floatextsize[2];	///< Logical sizes of the cached float extension records
+  mutable JoinRecord *floatextjoin[2];	///< Cached float extension records (null if not cached yet)
   void resolveJoin(void); 	///< If the ParamEntry is initialized with a \e join address, cache the join record
+  Address getFloatExtensionAddr(int4 sz) const;	///< Get the address of a float extension of \b this entry
 
   /// \brief Is the logical value left-justified within its container
   bool isLeftJustified(void) const { return (((flags&force_left_justify)!=0)||(!spaceid->isBigEndian())); }
 public:
-  ParamEntry(int4 grp) { group=grp; }			///< Constructor for use with restoreXml
+  ParamEntry(int4 grp) { group=grp; floatextjoin[0] = floatextjoin[1] = (JoinRecord *)0; }	///< Constructor for use with restoreXml
   ParamEntry(type_metatype t,int4 grp,int4 grpsize,const Address &loc,int4 sz,int4 mnsz,int4 align,bool normalstack);
   int4 getGroup(void) const { return group; }		///< Get the group id \b this belongs to
   int4 getGroupSize(void) const { return groupsize; }	///< Get the number of groups occupied by \b this
@@ -115,6 +121,7 @@ public:
 /// The \e slot ordering varies over the course of analysis and is unlikely to match
 /// the final parameter ordering.  The ParamTrial comparator sorts the trials in final parameter ordering.
 class ParamTrial {
+  friend class ParamMemo;
 public:
   enum {
     checked = 1,		///< Trial has been checked
@@ -181,6 +188,7 @@ public:
 /// they are in address order for input Varnodes to the active function.
 /// After, the trials are put into formal parameter order, as dictated by the PrototypeModel.
 class ParamActive {
+  friend class ParamMemo;
   vector<ParamTrial> trial;	///< The list of parameter trials
   int4 slotbase;		///< Slot where next parameter will go
   int4 stackplaceholder;	///< Which call input slot holds the stack placeholder
@@ -524,6 +532,53 @@ public:
   virtual ParamList *clone(void) const;
 };
 
+/// \brief Remembered answers of the parameter list algorithms of a ProtoModel
+///
+/// Assigning storage to a prototype and mapping a set of parameter trials depend only on
+/// their inputs and on the resource lists of the model, and call sites with the same callee
+/// prototype, or the same set of trials, ask the same question over and over.  This holds:
+///   - Storage from ProtoModel::assignParameterStorage(), keyed by the meta-type and size of
+///     each data-type in the prototype
+///   - Trials from ProtoModel::deriveInputMap() and ProtoModel::deriveOutputMap(), keyed by the
+///     storage, slot, properties, and model entry of every trial before mapping
+///
+/// A table is emptied once it holds \b maxentries answers, and all of them are emptied if the
+/// resource lists change.  Questions that end in an exception are not remembered.
+class ParamMemo {
+public:
+  typedef vector<uintb> Key;	///< Packed description of a question
+private:
+  enum {
+    source_void = -1,		///< The data-type is \e void
+    maxentries = 4096		///< Largest number of answers in one table
+  };
+  /// \brief The storage and data-type of one parameter, as assigned by a ProtoModel
+  struct Piece {
+    Address addr;		///< The storage address
+    uint4 flags;		///< Properties of the parameter
+    int4 source;		///< Index of the data-type in the prototype, or \b source_void
+    int4 ptrsize;		///< Size of the pointer to the \e source data-type, or 0 if it is not wrapped
+    uint4 ptrwordsize;		///< Word size of the pointer to the \e source data-type
+  };
+  /// \brief Parameter trials, after being mapped by a ParamList
+  struct TrialMap {
+    vector<ParamTrial> trial;	///< The trials in their final order and state
+    int4 numregistered;		///< Number of trials the mapping added
+  };
+  map<Key,vector<Piece> > storage;	///< Storage assignments, by prototype
+  map<Key,TrialMap> inputmap;		///< Input trial mappings, by trials
+  map<Key,TrialMap> outputmap;		///< Output trial mappings, by trials
+public:
+  static void buildStorageKey(const vector<Datatype *> &typelist,bool ignoreOutputError,Key &key);
+  static void buildTrialKey(const ParamActive *active,Key &key);
+  bool findStorage(const Key &key,const vector<Datatype *> &typelist,TypeFactory &typefactory,
+		   vector<ParameterPieces> &res) const;
+  void recordStorage(const Key &key,const vector<Datatype *> &typelist,const vector<ParameterPieces> &res);
+  bool findTrials(bool isinput,const Key &key,ParamActive *active) const;
+  void recordTrials(bool isinput,const Key &key,const ParamActive *active,int4 oldnum);
+  void clear(void) { storage.clear(); inputmap.clear(); outputmap.clear(); }	///< Forget all answers
+};
+
 /// \brief A \b prototype \b model: a model for passing parameters between functions
 ///
 /// This encompasses both input parameters and return values. It attempts to
@@ -562,6 +617,7 @@ class ProtoModel {
   bool stackgrowsnegative;	///< True if stack parameters have (normal) low address to high address ordering
   bool hasThis;			///< True if this model has a \b this parameter (auto-parameter)
   bool isConstruct;		///< True if this model is a constructor for a particular object
+  mutable ParamMemo memo;	///< Remembered storage assignments and trial mappings
   void defaultLocalRange(void);	///< Set the default stack range used for local variables
   void defaultParamRange(void);	///< Set the default stack range used for input parameters
   void buildParamList(const string &strategy);	 ///< Establish the main resource lists for input and output parameters.
@@ -575,24 +631,14 @@ public:
   const string &getName(void) const { return name; }	///< Get the name of the prototype model
   Architecture *getArch(void) const { return glb; }	///< Get the owning Architecture
   uint4 hasEffect(const Address &addr,int4 size) const;	///< Determine side-effect of \b this on the given memory range
+  uint4 hasEffect(const Address &addr,int4 size,int4 &hint) const { return lookupEffect(effectlist,addr,size,hint); }	///< Determine side-effect, starting from a previous position
   int4 getExtraPop(void) const { return extrapop; }	///< Get the stack-pointer \e extrapop for \b this model
   void setExtraPop(int4 ep) { extrapop = ep; }		///< Set the stack-pointer \e extrapop
   int4 getInjectUponEntry(void) const { return injectUponEntry; }	///< Get the inject \e uponentry id
   int4 getInjectUponReturn(void) const { return injectUponReturn; }	///< Get the inject \e uponreturn id
 
-  /// \brief Given a list of input \e trials, derive the most likely input prototype
-  ///
-  /// Trials are sorted and marked as \e used or not.
-  /// \param active is the collection of Varnode input trials
-  void deriveInputMap(ParamActive *active) const {
-    input->fillinMap(active); }
-
-  /// \brief Given a list of output \e trials, derive the most likely output prototype
-  ///
-  /// One trial (at most) is marked \e used and moved to the front of the list
-  /// \param active is the collection of output trials
-  void deriveOutputMap(ParamActive *active) const {
-    output->fillinMap(active); }
+  void deriveInputMap(ParamActive *active) const;	///< Given a list of input \e trials, derive the most likely input prototype
+  void deriveOutputMap(ParamActive *active) const;	///< Given a list of output \e trials, derive the most likely output prototype
 
   void assignParameterStorage(const vector<Datatype *> &typelist,vector<ParameterPieces> &res,bool ignoreOutputError);
 
@@ -742,6 +788,7 @@ public:
   virtual bool isMerged(void) const { return false; }	///< Is \b this a merged prototype model
   virtual void restoreXml(const Element *el);		///< Restore \b this model from an XML stream
   static uint4 lookupEffect(const vector<EffectRecord> &efflist,const Address &addr,int4 size);
+  static uint4 lookupEffect(const vector<EffectRecord> &efflist,const Address &addr,int4 size,int4 &hint);
 };
 
 /// \brief Class for calculating "goodness of fit" of parameter trials against a prototype model
@@ -901,10 +948,13 @@ public:
 ///
 /// A unified interface for accessing descriptions of individual
 /// parameters in a function prototype. Both input parameters and return values
-/// are described.
+/// are described.  A store can be shared, copy-on-write, by several FuncProto objects.
 class ProtoStore {
+  friend class FuncProto;
+  int4 refcount;			///< Number of FuncProto objects holding \b this
 public:
-  virtual ~ProtoStore(void) {}		///< Constructor
+  ProtoStore(void) { refcount = 1; }	///< Constructor
+  virtual ~ProtoStore(void) {}		///< Destructor
 
   /// \brief Establish name, data-type, storage of a specific input parameter
   ///
@@ -1077,6 +1127,8 @@ class FuncProto {
   vector<EffectRecord> effectlist;	///< Side-effects associated with non-parameter storage locations
   vector<VarnodeData> likelytrash;	///< Locations that may contain \e trash values
   int4 injectid;		///< (If non-negative) id of p-code snippet that should replace this function
+  void releaseStore(void);	///< Let go of the parameter storage
+  void uniqueStore(void);	///< Make sure the parameter storage is not shared before changing it
 protected:
   void paramShift(int4 paramshift);	///< Add parameters to the front of the input parameter list
   bool isParamshiftApplied(void) const { return ((flags&paramshift_applied)!=0); }	///< Has a parameter shift been applied
@@ -1087,6 +1139,7 @@ public:
   ~FuncProto(void);		///< Destructor
   Architecture *getArch(void) const { return model->getArch(); }	///< Get the Architecture owning \b this
   void copy(const FuncProto &op2);					///< Copy another function prototype
+  void copyShared(const FuncProto &op2);				///< Copy another function prototype, sharing its parameters
   void copyFlowEffects(const FuncProto &op2);	 			///< Copy properties that affect data-flow
   void getPieces(PrototypePieces &pieces) const;			///< Get the raw pieces of the prototype
   void setPieces(const PrototypePieces &pieces);			///< Set \b this prototype based on raw pieces
@@ -1137,6 +1190,11 @@ public:
   /// \param val is \b true to treat the function as never returning
   void setNoReturn(bool val) { flags = val ? (flags|no_return) : (flags & ~((uint4)no_return)); }
 
+  /// \brief Copy the EffectRecords and likely-trash locations of another prototype
+  ///
+  /// \param op2 is the other prototype
+  void copyEffects(const FuncProto &op2) { effectlist = op2.effectlist; likelytrash = op2.likelytrash; }
+
   /// \brief Is \b this a prototype for a class method, taking a \e this pointer.
   bool hasThisPointer(void) const { return ((flags & has_thisptr)!=0); }
 
@@ -1233,7 +1291,7 @@ public:
   void updateOutputNoTypes(const vector<Varnode *> &triallist,TypeFactory *factory);
   void updateAllTypes(const vector<string> &namelist,const vector<Datatype *> &typelist,bool dtdtdt);
   ProtoParameter *getParam(int4 i) const { return store->getInput(i); }	///< Get the i-th input parameter
-  void removeParam(int4 i) { store->clearInput(i); }		///< Remove the i-th input parameter
+  void removeParam(int4 i) { uniqueStore(); store->clearInput(i); }	///< Remove the i-th input parameter
   int4 numParams(void) const { return store->getNumInputs(); }	///< Get the number of input parameters
   ProtoParameter *getOutput(void) const { return store->getOutput(); }	///< Get the return value
   Datatype *getOutputType(void) const { return store->getOutput()->getType(); }	///< Get the return value data-type
@@ -1243,6 +1301,7 @@ public:
   bool isDotdotdot(void) const { return ((flags&dotdotdot)!=0); }	///< Return \b true if \b this takes a variable number of arguments
   void setDotdotdot(bool val) { flags = val ? (flags|dotdotdot) : (flags & ~((uint4)dotdotdot)); }	///< Toggle whether \b this takes variable arguments
   uint4 hasEffect(const Address &addr,int4 size) const;
+  uint4 hasEffect(const Address &addr,int4 size,int4 &hint) const;
   vector<EffectRecord>::const_iterator effectBegin(void) const;	///< Get iterator to front of EffectRecord list
   vector<EffectRecord>::const_iterator effectEnd(void) const;	///< Get iterator to end of EffectRecord list
   int4 numLikelyTrash(void) const;				///< Get the number of \e likely-trash locations
@@ -1395,13 +1454,14 @@ public:
   void resolveSpacebaseRelative(Funcdata &data,Varnode *phvn);
   void abortSpacebaseRelative(Funcdata &data);
   void finalInputCheck(void);
-  void checkInputTrialUse(Funcdata &data,AliasChecker &aliascheck);
+  void checkInputTrialUse(Funcdata &data,const AliasChecker &aliascheck);
   void checkOutputTrialUse(Funcdata &data,vector<Varnode *> &trialvn);
   void buildInputFromTrials(Funcdata &data);
   void buildOutputFromTrials(Funcdata &data,vector<Varnode *> &trialvn);
   void paramshiftModifyStart(void);
   bool paramshiftModifyStop(Funcdata &data);
   uint4 hasEffectTranslate(const Address &addr,int4 size) const;
+  uint4 hasEffectTranslate(const Address &addr,int4 size,int4 &hint) const;
   static Varnode *findPreexistingWhole(Varnode *vn1,Varnode *vn2);
 
   /// \brief Convert FspecSpace addresses to the underlying FuncCallSpecs object
@@ -1419,6 +1479,26 @@ public:
   static void countMatchingCalls(const vector<FuncCallSpecs *> &qlst);
 };
 
+/// \brief Stack-pointer changes recovered for sub-functions, shared across all their call sites
+///
+/// When the \e extrapop of a sub-function is unknown, ActionStackPtrFlow solves for it from the
+/// stack-pointer data-flow of the calling function.  The first good solution for a sub-function
+/// is recorded here, by entry address, and every later call site to the same sub-function, in
+/// any function of the Architecture, uses it directly instead of solving again.
+/// Lookups and records can happen on several threads at once.
+class ExtraPopMemo {
+  mutable std::mutex lock;		///< Guard for \b values
+  map<Address,int4> values;		///< Recovered \e extrapop by sub-function entry address
+  std::atomic<uint4> numreused;		///< Number of call sites that used a recorded value
+public:
+  ExtraPopMemo(void) : numreused(0) {}	///< Construct an empty memo
+  bool find(const Address &addr,int4 &extrapop);	///< Look up the \e extrapop recorded for a sub-function
+  void record(const Address &addr,int4 extrapop);	///< Record the \e extrapop of a sub-function
+  void clear(void);					///< Forget all recorded values
+  int4 size(void) const;				///< Get the number of recorded sub-functions
+  uint4 getNumReused(void) const { return numreused.load(); }	///< Get the number of call sites that reused a value
+};
+
 /// Return the trial associated with the input Varnode to the associated p-code CALL or CALLIND.
 /// We take into account the call address parameter (subtract 1) and if the index occurs \e after the
 /// index holding the stackpointer placeholder, we subtract an additional 1.
@@ -24,12 +24,95 @@
 #include "heritage.hh"
 #include "merge.hh"
 #include "dynamic.hh"
+#include "rangeutil.hh"
+#include "metrics.hh"
 
 #include <string>
 
 namespace GhidraDec {
 class FlowInfo;
 
+/// \brief Estimated heap usage of the analysis structures of a single function
+///
+/// Bytes are attributed to the object that owns them (see Funcdata::measureMemory()).  Counts are
+/// derived from container sizes and object sizes, so they are estimates that ignore allocator overhead.
+class MemoryUsage {
+public:
+  /// \brief The owners of memory that are tracked separately
+  enum owner {
+    pcodeops = 0,		///< PcodeOp objects (PcodeOpBank)
+    varnodes = 1,		///< Varnode objects (VarnodeBank)
+    highvariables = 2,		///< HighVariable objects and all Cover objects
+    blocks = 3,			///< Basic blocks and the structured block hierarchy
+    heritage = 4,		///< Heritage (SSA construction) state
+    localscope = 5,		///< Symbols in the local scope
+    jumptables = 6,		///< Recovered jump-tables
+    owner_count = 7		///< Number of different owners
+  };
+private:
+  uint8 bytes[owner_count];	///< Estimated bytes, indexed by owner
+public:
+  MemoryUsage(void) { clear(); }				///< Construct an empty usage record
+  void clear(void) { for(int4 i=0;i<owner_count;++i) bytes[i] = 0; }	///< Set all counts to zero
+  void add(owner o,uint8 val) { bytes[o] += val; }		///< Attribute bytes to the given owner
+  uint8 get(owner o) const { return bytes[o]; }			///< Get the bytes attributed to the given owner
+  uint8 total(void) const;					///< Get the total bytes across all owners
+  void print(ostream &s) const;					///< Print the usage, one owner per line
+  void saveXml(ostream &s) const;				///< Save the usage as a \<memoryusage> tag
+  static const char *getOwnerName(owner o);			///< Get the display name of the given owner
+};
+
+/// \brief Traces of logical sub-variables that are known to fail
+///
+/// Rules that split or truncate data-flow (see SubvariableFlow, SplitFlow, and SubfloatFlow)
+/// are tried on the same root Varnodes on every pass, and a trace that fails usually fails
+/// deep in the graph.  A failure is recorded by the kind of trace, the creation index of its
+/// root, and its mask or size parameter.  Failures are only remembered until the function
+/// next changes (see Funcdata::getModificationCount()).
+class TraceFailureCache {
+  uint4 modcount;			///< Modification count of the function when \b failed was filled in
+  set<pair<uint8,uintb> > failed;	///< (kind:creation index, mask) of traces that failed
+public:
+  /// \brief Kinds of trace
+  enum {
+    subvariable = 0,		///< SubvariableFlow trace
+    subvariable_aggressive = 1,	///< SubvariableFlow trace, aggressive mode
+    subvariable_sext = 2,	///< SubvariableFlow trace, sign-extension mode
+    split = 4,			///< SplitFlow trace
+    subfloat = 8		///< SubfloatFlow trace
+  };
+  TraceFailureCache(void) { modcount = 0; }	///< Constructor
+  bool hasFailed(uint4 mod,uint4 kind,const Varnode *vn,uintb mask);	///< Has the given trace failed since the last change
+  void insert(uint4 mod,uint4 kind,const Varnode *vn,uintb mask);	///< Record a failed trace
+  void clear(void) { failed.clear(); }		///< Forget all failures
+};
+
+/// \brief Verdicts of AncestorRealistic traversals that are known for the current data-flow
+///
+/// Parameter trials at different calls to the same register are often linked by INDIRECT ops, so the
+/// traversal for one trial walks through the same ancestors as the traversal for an earlier one.
+/// The outcome of a traversal from a Varnode, along with every Varnode it visited, is recorded
+/// under the creation index of the Varnode and the trial properties that influence it.  Verdicts are
+/// only remembered until the function next changes (see Funcdata::getModificationCount()).
+class AncestorVerdictCache {
+public:
+  /// \brief The outcome of a single traversal
+  struct Verdict {
+    int4 command;			///< The final traversal command (pop_success, pop_fail, etc.)
+    bool indcreateformed;		///< \b true if the traversal reached an indirect creation
+    bool condexeeffect;			///< \b true if a failing path was attributed to conditional execution
+    vector<const Varnode *> visited;	///< Every Varnode visited by the traversal
+  };
+private:
+  uint4 modcount;			///< Modification count of the function when \b verdicts was filled in
+  map<uint8,Verdict> verdicts;		///< Verdicts indexed by (properties:creation index)
+public:
+  AncestorVerdictCache(void) { modcount = 0; }	///< Constructor
+  const Verdict *find(uint4 mod,const Varnode *vn,uint4 props);	///< Look up the verdict for a traversal
+  Verdict &insert(uint4 mod,const Varnode *vn,uint4 props);	///< Create a record for a new verdict
+  void clear(void) { verdicts.clear(); }		///< Forget all verdicts
+};
+
 /// \brief Container for data structures associated with a single function
 ///
 /// This class holds the primary data structures for decompiling a function. In particular it holds
@@ -59,7 +142,11 @@ class Funcdata {
     restart_pending = 0x200,	///< Analysis must be restarted (because of new override info)
     unimplemented_present = 0x400,	///< Set if function contains unimplemented instructions
     baddata_present = 0x800,	///< Set if function flowed into bad data
-    double_precis_on = 0x1000	///< Set if we are performing double precision recovery
+    double_precis_on = 0x1000,	///< Set if we are performing double precision recovery
+    dirty_tracking = 0x2000,	///< Set if modified PcodeOps are being collected
+    budget_on = 0x4000,		///< Set if the analysis of \b this function has a budget
+    budget_exhausted = 0x8000,	///< Set if the analysis budget has run out
+    structure_pending = 0x10000	///< Set if a structureReset() was put off until the end of a block batch
   };
   uint4 flags;			///< Boolean properties associated with \b this function
   uint4 clean_up_index;		///< Creation index of first Varnode created after start of cleanup
@@ -74,15 +161,31 @@ class Funcdata {
 
   vector<FuncCallSpecs *> qlst;	///< List of calls this function makes
   vector<JumpTable *> jumpvec;	///< List of jump-tables for this function
+  vector<Address> regioncuts;	///< Entry points of regions left out of flow by the p-code budget
 
   VarnodeBank vbank;		///< Container of Varnode objects for \b this function
   PcodeOpBank obank;		///< Container of PcodeOp objects for \b this function
+  vector<PcodeOp *> dirtyops;	///< PcodeOps modified (or next to a modification) since collection started
+  uint4 modcount;		///< Number of modifications made to the data-flow graph
+  DynamicHashCache hashcache;	///< Dynamic hashes calculated for Varnodes of \b this function
+  TraceFailureCache tracefail;	///< Sub-variable traces known to fail
+  AncestorVerdictCache ancestorcache;	///< Known verdicts of AncestorRealistic traversals
+  ValueRangeCache rangecache;	///< Value ranges calculated for Varnodes of \b this function
+  AliasChecker aliascheck;	///< Pointer expressions into the stack, as of \b aliasmodcount
+  uint4 aliasmodcount;		///< Modification count of the function when \b aliascheck was gathered
+  bool aliasvalid;		///< \b true if \b aliascheck has been gathered
   BlockGraph bblocks;		///< Unstructured basic blocks
   BlockGraph sblocks;		///< Structured block hierarchy (on top of basic blocks)
   Heritage heritage;		///< Manager for maintaining SSA form
   Merge covermerge;		///< Variable range intersection algorithms
   ParamActive *activeoutput;	///< Data for assessing which parameters are passed to \b this function
   Override localoverride;	///< Overrides of data-flow, prototypes, etc. that are local to \b this function
+  std::chrono::steady_clock::time_point budget_deadline;	///< Time at which the analysis budget runs out
+  uint4 budget_used;		///< Rule applications charged against the analysis budget
+  int4 blockbatch;		///< Number of open block batches (see beginBlockBatch())
+  MemoryUsage mempeak;		///< Largest memory usage measured during the current decompilation
+  std::string mempeak_action;	///< Name of the Action after which \b mempeak was measured
+  AnalysisMetrics metrics;	///< Counts of inner tests made by the current decompilation
 
 				// Low level Varnode functions
   void setVarnodeProperties(Varnode *vn) const;	///< Look-up boolean properties and data-type information
@@ -95,13 +198,15 @@ class Funcdata {
   void destroyVarnode(Varnode *vn);		///< Delete the given Varnode from \b this function
 				// Low level op functions
   void opZeroMulti(PcodeOp *op);		///< Transform trivial CPUI_MULTIEQUAL to CPUI_COPY
+  void markDirty(PcodeOp *op) { modcount += 1; if ((flags&dirty_tracking)!=0) dirtyops.push_back(op); }	///< Record a modification to the given PcodeOp
+  void markDirtyDescend(Varnode *vn);		///< Collect the PcodeOps reading a modified Varnode
 				// Low level block functions
   void blockRemoveInternal(BlockBasic *bb,bool unreachable);
   void branchRemoveInternal(BlockBasic *bb,int4 num);
   void pushMultiequals(BlockBasic *bb);		///< Push MULTIEQUAL Varnodes of the given block into the output block
   void clearBlocks(void);			///< Clear all basic blocks
   void structureReset(void);			///< Calculate initial basic block structures (after a control-flow change)
-  int4 stageJumpTable(JumpTable *jt,PcodeOp *op,FlowInfo *flow);
+  void stageJumpTables(const vector<JumpTable *> &jt,const vector<PcodeOp *> &op,FlowInfo *flow,vector<int4> &failuremode);
   void switchOverJumpTables(const FlowInfo &flow);	///< Convert jump-table addresses to basic block indices
   void clearJumpTables(void);			///< Clear any jump-table information
 
@@ -149,10 +254,22 @@ public:
   bool isDoublePrecisOn(void) const { return ((flags & double_precis_on)!=0); }	///< Is double precision analysis enabled
   bool hasNoStructBlocks(void) const { return (sblocks.getSize() == 0); }	///< Return \b true if no block structuring was performed
   void clear(void);						///< Clear out old disassembly
+  void releaseStorage(void);					///< Free storage that clear() keeps for reuse
   void warning(const std::string &txt,const Address &ad) const;	///< Add a warning comment in the function body
   void warningHeader(const std::string &txt) const;			///< Add a warning comment as part of the function header
   void startProcessing(void);					///< Start processing for this function
   void stopProcessing(void);					///< Mark that processing has completed for this function
+  void startBudget(void);					///< Start the analysis budget for a new decompilation
+  bool checkBudget(void);					///< Check if the analysis budget has run out
+  bool isBudgetExhausted(void) const { return ((flags&budget_exhausted)!=0); }	///< Has the analysis budget run out
+  void consumeBudget(int4 num) { budget_used += num; }	///< Charge Rule applications against the analysis budget
+  void measureMemory(MemoryUsage &res) const;			///< Estimate the memory used by the analysis of \b this function
+  uint8 recordMemory(const std::string &actname);		///< Measure memory after an Action and update the peak
+  void resetMemoryPeak(void) { mempeak.clear(); mempeak_action.clear(); }	///< Forget the peak memory usage
+  const MemoryUsage &getMemoryPeak(void) const { return mempeak; }	///< Get the peak memory usage
+  const std::string &getMemoryPeakAction(void) const { return mempeak_action; }	///< Get the Action at peak memory usage
+  AnalysisMetrics &getMetrics(void) { return metrics; }		///< Get the counts of inner tests for \b this function
+  const AnalysisMetrics &getMetrics(void) const { return metrics; }	///< Get the counts of inner tests for \b this function
   bool startTypeRecovery(void);					///< Mark that data-type analysis has started
   void startCastPhase(void) { cast_phase_index = vbank.getCreateIndex(); }	///< Start the \b cast insertion phase
   uint4 getCastPhaseIndex(void) const { return cast_phase_index; }	///< Get creation index at the start of \b cast insertion
@@ -164,7 +281,7 @@ public:
   void truncatedFlow(const Funcdata *fd,const FlowInfo *flow);
   bool inlineFlow(Funcdata *inlinefd,FlowInfo &flow,PcodeOp *callop);
   void overrideFlow(const Address &addr,uint4 type);
-  void doLiveInject(InjectPayload *payload,const Address &addr,BlockBasic *bl,list<PcodeOp *>::iterator pos);
+  void doLiveInject(InjectPayload *payload,const Address &addr,BlockBasic *bl,PcodeOpList::iterator pos);
   
   void printRaw(ostream &s) const;			///< Print raw p-code op descriptions to a stream
   void printVarnodeTree(ostream &s) const;		///< Print a description of all Varnodes to a stream
@@ -193,6 +310,7 @@ public:
   ///
   /// \return \b true if the function's body contains at least one unimplemented instruction
   bool hasUnimplemented(void) const { return ((flags&unimplemented_present)!=0); }
+  const vector<Address> &getRegionCuts(void) const { return regioncuts; }	///< Get entry points of regions cut from the flow
 
   bool hasBadData(void) const { return ((flags&baddata_present)!=0); }	///< Does \b this function flow into bad data
   void spacebase(void);				///< Mark registers that map to a virtual address space
@@ -244,6 +362,7 @@ public:
 
   // Varnode routines
   int4 numVarnodes(void) const { return vbank.numVarnodes(); }	///< Get the total number of Varnodes
+  uint4 getVarnodeCreateIndex(void) const { return vbank.getCreateIndex(); }	///< Get the creation index the next Varnode will get
   Varnode *newVarnodeOut(int4 s,const Address &m,PcodeOp *op);	///< Create a new output Varnode
   Varnode *newUniqueOut(int4 s,PcodeOp *op);			///< Create a new \e temporary output Varnode
   Varnode *newVarnode(int4 s,const Address &m,Datatype *ct=(Datatype *)0);
@@ -372,6 +491,11 @@ public:
   void clearDeadVarnodes(void);					///< Delete any dead Varnodes
   void calcNZMask(void);					///< Calculate \e non-zero masks for all Varnodes
   void clearDeadOps(void) { obank.destroyDead(); }		///< Delete any dead PcodeOps
+  void reclaimRetiredOps(void);					///< Free retired PcodeOps once they outnumber the live ones
+  int4 numOpsAlive(void) const { return obank.numAlive(); }	///< Get the number of \e alive PcodeOps
+  int4 numOpsDead(void) const { return obank.numDead(); }	///< Get the number of \e dead PcodeOps
+  int4 numOpsRetired(void) const { return obank.numRetired(); }	///< Get the number of retired PcodeOps still held
+  uint4 numOpsReclaimed(void) const { return obank.numReclaimed(); }	///< Get the number of retired PcodeOps freed
   Symbol *linkSymbol(Varnode *vn);				///< Find or create Symbol associated with given Varnode
   void buildDynamicSymbol(Varnode *vn);				///< Build a \e dynamic Symbol associated with the given Varnode
   bool attemptDynamicMapping(SymbolEntry *entry,DynamicHash &dhash);
@@ -404,7 +528,7 @@ public:
   void opSetInput(PcodeOp *op,Varnode *vn,int4 slot);		///< Set a specific input operand for the given PcodeOp
   void opSwapInput(PcodeOp *op,int4 slot1,int4 slot2);		///< Swap two input operands in the given PcodeOp
   void opUnsetInput(PcodeOp *op,int4 slot);			///< Clear an input operand slot for the given PcodeOp
-  void opInsert(PcodeOp *op,BlockBasic *bl,list<PcodeOp *>::iterator iter);
+  void opInsert(PcodeOp *op,BlockBasic *bl,PcodeOpList::iterator iter);
   void opUninsert(PcodeOp *op);					///< Remove the given PcodeOp from its basic block
   void opUnlink(PcodeOp *op);					///< Unset inputs/output and remove given PcodeOP from its basic block
   void opDestroy(PcodeOp *op);					///< Remove given PcodeOp and destroy its Varnode operands
@@ -416,6 +540,21 @@ public:
   void opSetFlag(PcodeOp *op,uint4 fl) { op->setFlag(fl); }	///< Set a boolean property on the given PcodeOp
   void opClearFlag(PcodeOp *op,uint4 fl) { op->clearFlag(fl); }	///< Clear a boolean property on the given PcodeOp
   void opFlipFlag(PcodeOp *op,uint4 fl) { op->flipFlag(fl); }	///< Flip a boolean property on the given PcodeOp
+  void beginDirtyTracking(void) { dirtyops.clear(); flags |= dirty_tracking; }	///< Start collecting modified PcodeOps
+  void endDirtyTracking(void) { dirtyops.clear(); flags &= ~dirty_tracking; }	///< Stop collecting modified PcodeOps
+  bool isDirtyTracking(void) const { return ((flags&dirty_tracking)!=0); }	///< Are modified PcodeOps being collected
+  void takeDirtyOps(vector<PcodeOp *> &res);			///< Hand over the modified PcodeOps collected so far
+  uint4 getModificationCount(void) const { return modcount; }	///< Get a count that changes whenever the data-flow graph does
+  void markModified(void) { modcount += 1; }			///< Record a change not made through the \e op methods
+  /// \brief Has the given sub-variable trace failed since the function last changed
+  bool hasTraceFailed(uint4 kind,const Varnode *vn,uintb mask) { return tracefail.hasFailed(modcount,kind,vn,mask); }
+  /// \brief Record that the given sub-variable trace failed
+  void markTraceFailed(uint4 kind,const Varnode *vn,uintb mask) { tracefail.insert(modcount,kind,vn,mask); }
+  /// \brief Get the range of values a Varnode can hold, anywhere it is read
+  CircleRange getValueRange(const Varnode *vn) { return rangecache.getRange(*this,vn); }
+  const AliasChecker &getAliasChecker(AddrSpace *spc);	///< Get the pointer expressions into the given stack space
+  AncestorVerdictCache &getAncestorCache(void) { return ancestorcache; }	///< Get the known AncestorRealistic verdicts
+  DynamicHashCache &getHashCache(void) { return hashcache; }	///< Get the dynamic hashes calculated for \b this function
   PcodeOp *target(const Address &addr) const { return obank.target(addr); }	///< Look up a PcodeOp by an instruction Address
   Varnode *createStackRef(AddrSpace *spc,uintb off,PcodeOp *op,Varnode *stackptr,bool insertafter);
   Varnode *opStackLoad(AddrSpace *spc,uintb off,uint4 sz,PcodeOp *op,Varnode *stackptr,bool insertafter);
@@ -456,8 +595,10 @@ public:
   JumpTable *findJumpTable(const PcodeOp *op) const;	///< Find a jump-table associated with a given BRANCHIND
   JumpTable *installJumpTable(const Address &addr);	///< Install a new jump-table for the given Address
   JumpTable *recoverJumpTable(PcodeOp *op,FlowInfo *flow,int4 &failuremode);
+  void recoverJumpTables(const vector<PcodeOp *> &ops,FlowInfo *flow,vector<JumpTable *> &res,vector<int4> &failuremode);
   int4 numJumpTables(void) const { return jumpvec.size(); }	///< Get the number of jump-tables for \b this function
   JumpTable *getJumpTable(int4 i) { return jumpvec[i]; }	///< Get the i-th jump-table
+  const JumpTable *getJumpTable(int4 i) const { return jumpvec[i]; }	///< Get the i-th jump-table
   void removeJumpTable(JumpTable *jt);			///< Remove/delete the given jump-table
 
   // Block routines
@@ -483,6 +624,8 @@ public:
   void removeFromFlowSplit(BlockBasic *bl,bool swap);
   void switchEdge(FlowBlock *inblock,BlockBasic *outbefore,FlowBlock *outafter);
   void spliceBlockBasic(BlockBasic *bl);	///< Merge the given basic block with the block it flows into
+  void beginBlockBatch(void) { blockbatch += 1; }	///< Start collecting control-flow changes
+  void endBlockBatch(void);			///< Apply the structure recalculation for collected control-flow changes
   void installSwitchDefaults(void);		///< Make sure default switch cases are properly labeled
   static bool replaceLessequal(Funcdata &data,PcodeOp *op);	///< Replace INT_LESSEQUAL and INT_SLESSEQUAL expressions
   static bool compareCallspecs(const FuncCallSpecs *a,const FuncCallSpecs *b);
@@ -578,6 +721,11 @@ class AncestorRealistic {
     pop_failkill	///< Backtracking, from path with a bad ancestor, specifically killedbycall
   };
   ParamTrial *trial;			///< Current trial being analyzed for suitability
+  AncestorVerdictCache *cache;		///< Verdicts of earlier traversals
+  uint4 modcount;			///< Modification count of the function being analyzed
+  uint4 cacheprops;			///< Properties of the current trial that the verdict depends on
+  bool sawIndCreate;			///< Set if the traversal reaches an indirect creation
+  bool sawCondExe;			///< Set if the traversal attributes a failing path to conditional execution
   vector<State> stateStack;		///< Holds the depth-first traversal stack
   vector<const Varnode *> markedVn;	///< Holds visited Varnodes to properly trim cycles
   int4 multiDepth;			///< Number of MULTIEQUAL ops along current traversal path
@@ -591,6 +739,7 @@ class AncestorRealistic {
     vn->setMark();
   }
 
+  bool replayVerdict(const AncestorVerdictCache::Verdict &verdict);	///< Apply an earlier verdict to the current traversal
   int4 enterNode(State &state);			///< Traverse into a new Varnode
   int4 uponPop(State &state,int4 command);	///< Pop a Varnode from the traversal stack
   bool checkConditionalExe(State &state);	///< Check if current Varnode produced by conditional flow
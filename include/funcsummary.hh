@@ -0,0 +1,56 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file funcsummary.hh
+/// \brief A compact JSON summary of a decompiled function, produced without printing any C
+#ifndef __CPUI_FUNCSUMMARY__
+#define __CPUI_FUNCSUMMARY__
+
+#include "funcdata.hh"
+
+namespace GhidraDec {
+
+/// \brief Write the recovered facts about a function as a single JSON object
+///
+/// For tools that only need what the decompiler recovered, not the C text.  The summary is
+/// read straight from the Funcdata, so it skips the PrintLanguage and EmitPrettyPrint
+/// entirely.  The object has the fields:
+///   - \b name and \b entry of the function
+///   - \b prototype: the model, the return type, each parameter (name, type, storage), and \e varargs
+///   - \b locals: every symbol of the local scope that isn't a parameter (name, type, storage)
+///   - \b calls: each call site, with the callee address and name when they are known
+///   - \b jumptables: each recovered switch, with the address of the BRANCHIND and its targets
+///
+/// Addresses are objects holding the space name and the offset in hex, or \b null if unknown
+/// (as for the storage of a dynamic symbol).
+/// Data-types are given in C-like form, like "int4 *" or "char[16]".
+class FunctionSummary {
+  ostream &s;				///< The stream receiving the JSON
+  void writeString(const string &str);	///< Write a JSON string literal
+  void writeAddress(const Address &addr);	///< Write an address object (or null)
+  void writeType(const Datatype *ct);	///< Write a data-type as a string
+  void writePrototype(const FuncProto &proto);	///< Write the \e prototype field
+  void writeLocal(const SymbolEntry *entry,set<const Symbol *> &seen);	///< Write one element of \e locals
+  void writeLocals(const ScopeLocal *scope);	///< Write the \e locals field
+  void writeCalls(const Funcdata &fd);	///< Write the \e calls field
+  void writeJumpTables(const Funcdata &fd);	///< Write the \e jumptables field
+  static string typeName(const Datatype *ct);	///< Build the C-like name of a data-type
+public:
+  FunctionSummary(ostream &str) : s(str) {}	///< Construct given the output stream
+  void save(const Funcdata &fd);		///< Write the summary of the given function
+};
+
+}
+#endif
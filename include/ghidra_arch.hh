@@ -21,6 +21,7 @@
 
 #include "architecture.hh"
 
+#include <mutex>
 
 namespace GhidraDec {
 
@@ -39,6 +40,33 @@ struct JavaError : public LowlevelError {
     type = tp; }			///< Construct given a class and message
 };
 
+/// \brief Parsed .pspec, .cspec, .sla and core type documents shared across programs
+///
+/// A client registers each program with the text of its specification files, which is the same
+/// for every program of a given language and compiler.  Parsing is done once per distinct text,
+/// and the resulting Document is handed out to each ArchitectureGhidra that asks for it.
+/// The documents are never modified after parsing, so they are shared read-only by any number of
+/// architectures across threads.  Each holder counts as a reference; a document with no references
+/// is kept, up to a limit, in case a program with the same specification is registered again.
+class SpecDocumentCache {
+  /// \brief A parsed specification document and its holders
+  struct Entry {
+    Document *doc;		///< The parsed document
+    int4 refcount;		///< Number of architectures holding the document
+    uint8 lastuse;		///< Stamp of the last time the document was acquired or released
+  };
+  static std::mutex lock;	///< Guard for the cache
+  static map<std::string,Entry> docs;	///< Documents indexed by the text they were parsed from
+  static uint8 usecount;	///< Counter used to stamp acquisitions and releases
+  static int4 maxunused;	///< Maximum number of documents without any holder to keep
+  static void evictUnused(void);	///< Delete the least recently used unheld documents over the limit
+public:
+  static const Document *acquire(const std::string &xml);	///< Get the parsed document for the given text
+  static void release(const Document *doc);		///< Note that a holder no longer needs a document
+  static void setMaxUnused(int4 val);			///< Set the number of unheld documents to keep
+  static void clear(void);				///< Delete all documents without any holder
+};
+
 /// \brief An implementation of the Architecture interface and connection to a Ghidra client
 ///
 /// In addition to managing the major pieces of the architecture
@@ -68,9 +96,30 @@ class ArchitectureGhidra : public Architecture {
   std::string cspecxml;		///< XML cspec passed from Ghidra
   std::string tspecxml;              ///< Stripped down .sla file passed from Ghidra
   std::string corespecxml;		///< A specification of the core data-types
+  vector<const Document *> specdocs;	///< Parsed specification documents held from the SpecDocumentCache
   bool sendsyntaxtree;		///< True if the syntax tree should be sent with function output
   bool sendCcode;		///< True if C code should be sent with function output
   bool sendParamMeasures;       ///< True if measurements for argument and return parameters should be sent
+  bool sendsummary;		///< True if a JSON summary is sent instead of the function and C code
+  bool sendlinemarkup;		///< True if C code is marked up by line instead of by token
+  bool senddraft;		///< True if a quick first draft of a function is sent before the full results
+  bool binaryprotocol;		///< True if the client may answer queries with binary records
+  static const int4 bytepagesize = 4096;	///< Number of bytes in a page of the byte cache
+  static const int4 bytecachemax = 1024;	///< Maximum number of pages held by the byte cache
+  static bool exitonclose;		///< Exit the process if a client closes its stream (otherwise throw)
+  map<Address,vector<uint1> > bytecache;	///< Pages of program bytes already read from the client (empty = unavailable)
+  static const int4 prefetchmax = 16;	///< Maximum number of byte pages requested by one prefetch
+  bool prefetchbytes;			///< Set if the bytes of a function's code are prefetched
+  Document *prefetchcomments;		///< Comments fetched ahead of their query (or null)
+  Address prefetchcommentaddr;		///< Function the prefetched comments belong to
+  uint4 prefetchcommentflags;		///< Comment types the prefetched comments were queried with
+  void writeBytesQuery(int4 size,const Address &inaddr);	///< Send a query for bytes in the LoadImage
+  void readBytesResponse(uint1 *buf,int4 size,const Address &inaddr);	///< Receive the answer to a query for bytes
+  void writeCommentsQuery(const Address &fad,uint4 flags);	///< Send a query for the comments of a function
+  void writeCPoolRefQuery(const vector<uintb> &refs);		///< Send a query for a constant pool record
+  void writePcodeQuery(const Address &addr);			///< Send a query for the p-code of one instruction
+  void fetchBytes(uint1 *buf,int4 size,const Address &inaddr);	///< Query the client for bytes in the LoadImage
+  const vector<uint1> *obtainBytePage(const Address &pageaddr);	///< Get a cached page of bytes, reading it if necessary
   virtual Scope *buildGlobalScope(void);
   virtual Translate *buildTranslator(DocumentStorage &store);
   virtual void buildLoader(DocumentStorage &store);
@@ -85,6 +134,7 @@ class ArchitectureGhidra : public Architecture {
   virtual void resolveArchitecture(void);
 public:
   ArchitectureGhidra(const std::string &pspec,const std::string &cspec,const std::string &tspec,const std::string &corespec,istream &i,ostream &o);
+  virtual ~ArchitectureGhidra(void);				///< Destructor
   const std::string &getWarnings(void) const { return warnings; }	///< Get warnings produced by the last decompilation
   void clearWarnings(void) { warnings.clear(); }		///< Clear warnings
   Document *getRegister(const std::string &regname);			///< Retrieve a register description given a name
@@ -92,12 +142,19 @@ public:
   Document *getTrackedRegisters(const Address &addr);		///< Retrieve \e tracked register values at the given address
   std::string getUserOpName(int4 index);				///< Get the name of a user-defined p-code op
   uint1 *getPcodePacked(const Address &addr);			///< Get p-code for a single instruction
+  void getPcodePackedBatch(const vector<Address> &addrs,vector<uint1 *> &res);	///< Get p-code for a list of instructions
   Document *getMappedSymbolsXML(const Address &addr);		///< Get symbols associated with the given address
   Document *getExternalRefXML(const Address &addr);		///< Retrieve a description of an external function
   std::string getCodeLabel(const Address &addr);			///< Retrieve a label at the given address
   Document *getType(const std::string &name,uint8 id);		///< Retrieve a data-type description for the given name and id
+  Document *getTypeClosure(const std::string &name,uint8 id);	///< Retrieve a data-type and every data-type it refers to
   Document *getComments(const Address &fad,uint4 flags);	///< Retrieve comments for a particular function
   void getBytes(uint1 *buf,int4 size,const Address &inaddr);	///< Retrieve bytes in the LoadImage at the given address
+  void clearByteCache(void) { bytecache.clear(); clearPrefetch(); }	///< Forget any program bytes read so far
+  void clearPrefetch(void);					///< Forget any results fetched ahead of their query
+  void invalidateBytes(const Range &rng);			///< Forget any program bytes read from a memory range
+  virtual void prefetchFunction(const Funcdata &fd);
+  void setPrefetchBytes(bool val) { prefetchbytes = val; }	///< Toggle prefetching the bytes of a function's code
   Document *getPcodeInject(const std::string &name,int4 type,const InjectContext &con);
   Document *getCPoolRef(const vector<uintb> &refs);		///< Resolve a constant pool reference
   //  Document *getScopeProperties(Scope *newscope);
@@ -127,11 +184,54 @@ public:
 
   bool getSendParamMeasures(void) const { return sendParamMeasures; }	///< Get the current setting for emitting parameter info
 
+  /// \brief Toggle whether only a summary of the function is emitted by the main decompile action
+  ///
+  /// If the toggle is \b on, the decompiler sends the FunctionSummary of the function in a
+  /// \<summary> element, instead of the syntax tree and the source code, and never runs the printer.
+  /// \param val is \b true to enable the summary
+  void setSendSummary(bool val) { sendsummary = val; }
+
+  bool getSendSummary(void) const { return sendsummary; }	///< Get the current setting for emitting a summary
+
+  /// \brief Toggle whether the main decompile action sends a first draft before the full results
+  ///
+  /// If the toggle is \b on, the function is first decompiled with the \e draft root Action, which
+  /// leaves out the most expensive simplifications, and those results are sent and flushed as a
+  /// string of their own.  The function is then decompiled again with the current root Action, and
+  /// the full results follow as a second string in the same response.
+  /// \param val is \b true to enable the draft
+  void setSendDraft(bool val) { senddraft = val; }
+
+  bool getSendDraft(void) const { return senddraft; }		///< Get the current setting for sending a draft
+
+  /// \brief Toggle whether the C code sent by the main decompile action is only marked up by line
+  ///
+  /// If the toggle is \b on, the source code is sent with the text of each line in one element,
+  /// and without the references back to the syntax tree (see EmitLineXml).  This is enough for
+  /// clients that only display the code, and is much smaller.
+  /// \param val is \b true to mark up lines only
+  void setSendLineMarkup(bool val) { sendlinemarkup = val; print->setLineXml(val); }
+
+  bool getSendLineMarkup(void) const { return sendlinemarkup; }	///< Get the current setting for line markup
+
+  /// \brief Toggle whether the client may answer queries with binary records
+  ///
+  /// If the toggle is \b on, XML documents may be sent as binary (\e .slab form) element trees
+  /// and program bytes as raw bytes, instead of as XML text and hex-encoded strings.
+  /// This is negotiated when the program is registered.
+  /// \param val is \b true to enable binary records
+  void setBinaryProtocol(bool val) { binaryprotocol = val; }
+
+  bool isBinaryProtocol(void) const { return binaryprotocol; }	///< Get whether binary records were negotiated
+
   virtual void printMessage(const std::string &message) const;
 
   static void segvHandler(int4 sig);				///< Handler for a segment violation (SIGSEGV) signal
+  static void setExitOnClose(bool val) { exitonclose = val; }	///< Set whether a closed client stream ends the process
   static int4 readToAnyBurst(istream &s);			///< Read the next message protocol marker
   static void readStringStream(istream &s, std::string &res);		///< Receive a string from the client
+  static void readStringContents(istream &s,std::string &res);		///< Receive the rest of a string from the client
+  static void readBinaryContents(istream &s,vector<uint1> &res);	///< Receive the rest of a binary record from the client
   static void writeStringStream(ostream &s,const std::string &msg);	///< Send a string to the client
   static void readToResponse(istream &s);			///< Read the query response protocol marker
   static void readResponseEnd(istream &s);			///< Read the ending query response protocol marker
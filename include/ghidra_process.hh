@@ -24,6 +24,7 @@
 #include "typegrp_ghidra.hh"
 #include "grammar.hh"
 #include "paramid.hh"
+#include "blockaction.hh"
 #include <iostream>
 #include <csignal>
 
@@ -43,9 +44,32 @@ protected:
 public:
   const string &getName(void) const { return name; }	///< Get the capability name
   static int4 readCommand(istream &sin,ostream &out);	///< Dispatch a Ghidra command
+  static GhidraCommand *findCommand(const map<string,GhidraCommand *> &cmds,istream &sin,ostream &out);	///< Read the name of a command and look it up
+  static void cloneCommands(map<string,GhidraCommand *> &res,istream &sin,ostream &sout);	///< Copy every command, bound to new i/o streams
+  static void releasePrograms(istream &sin);		///< Free every program registered by a client
+  static void replay(istream &sin,ostream &report);	///< Run the commands of a captured session, timing each one
   static void shutDown(void);				///< Release all GhidraCommand resources
 };
 
+/// \brief A stream buffer reading from a file descriptor that copies everything it reads to a capture
+///
+/// Installed in place of the buffer of \b cin, it records every byte a client sends: each command,
+/// its parameters, and the client's replies to the decompiler's queries.  Since the decompiler asks
+/// the same queries in the same order when it is given the same commands, a capture can be fed back
+/// through GhidraCapability::replay() without a client.  What the decompiler sends is not recorded.
+/// The capture is flushed after each read, so it is complete even if the process exits when the
+/// client goes away.
+class CaptureBuffer : public std::streambuf {
+  static const int4 bufsize = 65536;	///< Size of the buffer
+  int fd;				///< The file descriptor being read
+  ostream &capture;			///< The stream receiving the copy
+  char inbuf[bufsize];			///< Bytes read but not yet consumed
+protected:
+  virtual int_type underflow(void);
+public:
+  CaptureBuffer(int f,ostream &c) : capture(c) { fd = f; setg(inbuf,inbuf,inbuf); }	///< Construct given the descriptor and capture stream
+};
+
 /// \brief The core decompiler commands capability
 ///
 /// This class is instantiated as a singleton and registers all the basic
@@ -75,13 +99,24 @@ protected:
   ostream &sout;			///< The output stream to the Ghidra client
   ArchitectureGhidra *ghidra;		///< The Architecture on which to perform the command
   int4 status;				///< Meta-command to system (0=wait for next command, 1=terminate process)
+  bool commandend;			///< Set if loadParameters() already consumed the end of command marker
+  AnalysisInterrupt *interrupt;		///< Requests to stop or pause an analysis run by \b this (may be null)
   virtual void loadParameters(void);	///< Read parameters directing command execution
   virtual void sendResult(void);	///< Send results of the command (if any) back to the Ghidra client
 public:
   GhidraCommand(void) : sin(cin),sout(cout) {
-    ghidra = (ArchitectureGhidra *)0; 
+    ghidra = (ArchitectureGhidra *)0; commandend = false; interrupt = (AnalysisInterrupt *)0;
+  }					///< Construct talking over the standard i/o streams
+  GhidraCommand(istream &i,ostream &o) : sin(i),sout(o) {
+    ghidra = (ArchitectureGhidra *)0; commandend = false; interrupt = (AnalysisInterrupt *)0;
   }					///< Construct given i/o streams
   virtual ~GhidraCommand(void) {}	///< Destructor
+  /// \brief Make a copy of \b this command that talks to a different client
+  ///
+  /// \param i is the input stream from the new client
+  /// \param o is the output stream to the new client
+  /// \return the new command object
+  virtual GhidraCommand *clone(istream &i,ostream &o) const=0;
 
   /// \brief Perform the action of the command
   ///
@@ -89,6 +124,8 @@ public:
   /// examining and manipulating data under the active Architecture object to perform the command.
   virtual void rawAction(void)=0;
   int4 doit(void);			///< Configure and execute the command, then send back results
+  void setInterrupt(AnalysisInterrupt *i) { interrupt = i; }	///< Set the requests the command's analysis acts on
+  virtual bool isBackground(void) const { return false; }	///< Is \b this work that no user is waiting on
 };
 
 /// \brief Command to \b register a new Program (executable) with the decompiler
@@ -100,14 +137,24 @@ public:
 ///   - The compiler specification
 ///   - The stripped down \<sleigh> tag describing address spaces for the program
 ///   - The \<coretypes> tag describing the built-in datatypes for the program
+///
+/// An optional fifth string lists protocol options requested by the client. Currently
+/// the only option is \b binary, which lets the client answer queries with binary records
+/// (see ArchitectureGhidra::setBinaryProtocol()). The options that are accepted are
+/// sent back after the program id.
 class RegisterProgram : public GhidraCommand {
   string pspec;				///< Processor specification to configure with
   string cspec;				///< Compiler specification to configure with
   string tspec;				///< Configuration (address-spaces) for the Translate object
   string corespec;			///< A description of core data-types for the TypeFactory object
+  string protocol;			///< Protocol options requested by the client (may be empty)
+  bool binary;				///< Set if binary records were negotiated
   virtual void loadParameters(void);
   virtual void sendResult(void);
 public:
+  RegisterProgram(void) {}					///< Construct talking over the standard i/o streams
+  RegisterProgram(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new RegisterProgram(i,o); }
   int4 archid;				///< Resulting id of the program to send back
   virtual void rawAction(void);
 };
@@ -122,6 +169,9 @@ class DeregisterProgram : public GhidraCommand {
   virtual void loadParameters(void);
   virtual void sendResult(void);
 public:
+  DeregisterProgram(void) {}					///< Construct talking over the standard i/o streams
+  DeregisterProgram(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new DeregisterProgram(i,o); }
   int4 res;				///< The meta-command being issued to send back
   virtual void rawAction(void);
 };
@@ -136,10 +186,43 @@ public:
 class FlushNative : public GhidraCommand {
   virtual void sendResult(void);
 public:
+  static void flush(ArchitectureGhidra *glb);		///< Clear every cache of the given program
+  FlushNative(void) {}					///< Construct talking over the standard i/o streams
+  FlushNative(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new FlushNative(i,o); }
   int4 res;				///< Success status returned to the client (0=success)
   virtual void rawAction(void);
 };
 
+/// \brief Command to \b invalidate the cached information about parts of a Program (executable)
+///
+/// Unlike FlushNative, only what the client reports as changed is dropped, and the rest of
+/// the cache stays warm.  The command expects 2 string parameters: the encoded integer id of the
+/// program, and an \<invalidate> tag, with a child for each change:
+///   - \<range> for memory whose bytes, symbols, properties, or comments changed
+///   - \<symbol> for a symbol, by (old) \e name attribute, that was renamed, retyped, or deleted
+///   - \<type> for a data-type, by \e id attribute, that changed
+///   - \<cpool> if any constant pool record changed
+///
+/// The storage of a changed symbol is treated like a changed \<range>. Data-types are referenced
+/// from all over the cache, so a change to a data-type that has been fetched already falls back to
+/// flushing everything.  Any function already decompiled is decompiled again when next requested.
+/// Injection payloads are not affected.
+class InvalidateNative : public GhidraCommand {
+  vector<Range> ranges;			///< Memory ranges that changed
+  vector<string> symbols;		///< Names of symbols that changed
+  vector<uint8> types;			///< Ids of data-types that changed
+  bool cpoolchanged;			///< Set if the constant pool changed
+  virtual void loadParameters(void);
+  virtual void sendResult(void);
+public:
+  InvalidateNative(void) {}					///< Construct talking over the standard i/o streams
+  InvalidateNative(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new InvalidateNative(i,o); }
+  int4 res;				///< Success status returned to the client (0=success, 1=flushed everything)
+  virtual void rawAction(void);
+};
+
 /// \brief Command to \b decompile a specific function.
 ///
 /// The command expects 2 string parameters: the encoded integer id of the program,
@@ -150,10 +233,71 @@ public:
 /// Symbols, data-types and p-code are fetched as needed from the client and cached in
 /// the Architecture object. XML Documents containing source code results, data-flow and
 /// control-flow structures, symbol information, etc., are sent back to the client.
+/// If the command has an AnalysisInterrupt (as it does in a GhidraServer), it is attached to the
+/// Architecture while the function is analyzed, so the analysis can be cancelled with
+/// CancelDecompile, or can yield its worker to other clients.  A cancelled function is cleared,
+/// and an error is sent back in place of the results.  If the client has asked for a \e draft
+/// (see SetAction), a quick first draft of a function not yet analyzed is sent as its own string
+/// ahead of the full results.
 class DecompileAt : public GhidraCommand {
+protected:
   Address addr;				///< The entry point address of the function to decompile
   virtual void loadParameters(void);
+  void decompile(Funcdata *fd,Action *root=(Action *)0);	///< Decompile the function, if it hasn't been already
+  void sendDraft(Funcdata *fd);		///< Send a first draft of the function, then clear its analysis
+  void saveResult(Funcdata *fd,ostream &s);	///< Write the results of decompiling a function
+  void saveCaptured(Funcdata *fd,ostream &s,string &copy);	///< Write the results, keeping a copy
+  string cacheConfig(void) const;	///< Options of the Architecture that change the results sent
+public:
+  DecompileAt(void) {}					///< Construct talking over the standard i/o streams
+  DecompileAt(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new DecompileAt(i,o); }
+  virtual void rawAction(void);
+};
+
+/// \brief Command to decompile the callees of a function ahead of time, into the result cache
+///
+/// The command expects the same parameters as DecompileAt, giving the function the user is looking at.
+/// A client sends it when it is otherwise idle, typically right after getting the results of the
+/// function.  Each function called by it that has no results in the Architecture's ResultCache is
+/// decompiled, with the results stored in the cache under the same key DecompileAt would look up,
+/// and its analysis is then cleared so that only the cached output takes up memory.  A later
+/// DecompileAt of a callee is then answered straight from the cache.  If the function itself has no
+/// analysis at hand (because its own results came from the cache), it is decompiled first to find its calls.
+///
+/// Nothing is done unless the Architecture has a cache.  An in-memory cache with a limit (see the
+/// \e resultcache option) is the prefetcher's memory budget: prefetching stops once the cache is full,
+/// so it never pushes out results the user has actually looked at.  The command is background work
+/// in a GhidraServer, and stops early if it is cancelled with CancelDecompile.  It sends back the
+/// number of functions whose results were stored.
+class PrefetchCallees : public DecompileAt {
+  bool prefetch(Funcdata *fd);		///< Decompile one callee into the cache
+public:
+  PrefetchCallees(void) {}					///< Construct talking over the standard i/o streams
+  PrefetchCallees(istream &i,ostream &o) : DecompileAt(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new PrefetchCallees(i,o); }
+  virtual bool isBackground(void) const { return true; }
+  int4 res;				///< Number of functions whose results were stored
+  virtual void rawAction(void);
+  virtual void sendResult(void);
+};
+
+/// \brief Command to \b cancel the decompilation in progress for a Program (executable)
+///
+/// It is only useful with a GhidraServer, where it is sent over a different connection from the one
+/// waiting on DecompileAt.  The command expects a single string parameter encoding the id of the
+/// program, which may have been registered by another client; nothing else of the program can be
+/// reached.  The analysis stops at the next Action or PcodeOp it reaches.  The command sends back
+/// 1 if a decompilation was in progress, or 0 otherwise.
+class CancelDecompile : public GhidraCommand {
+  int4 inid;				///< The id of the program whose decompilation is cancelled
+  virtual void loadParameters(void);
+  virtual void sendResult(void);
 public:
+  CancelDecompile(void) {}					///< Construct talking over the standard i/o streams
+  CancelDecompile(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new CancelDecompile(i,o); }
+  int4 res;				///< 1 if a decompilation was cancelled, 0 otherwise
   virtual void rawAction(void);
 };
 
@@ -172,6 +316,28 @@ class StructureGraph : public GhidraCommand {
   BlockGraph ingraph;				///< The control-flow graph to structure
   virtual void loadParameters(void);
 public:
+  StructureGraph(void) {}					///< Construct talking over the standard i/o streams
+  StructureGraph(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new StructureGraph(i,o); }
+  virtual void rawAction(void);
+};
+
+/// \brief Command to \b structure a control-flow graph given as a list of edges
+///
+/// The same structuring as StructureGraph, for a graph with no content, without the XML.
+/// The command expects 2 string parameters.  The first is the encoded integer id of a program,
+/// and the second is the node count and edges of the graph (see EdgeListStructure).  The
+/// command returns a single string holding the structured tree in the encoding produced by
+/// EdgeListStructure::encode().
+class StructureEdges : public GhidraCommand {
+  EdgeListStructure structurer;			///< The graph being structured
+  string result;				///< The encoded structure
+  virtual void loadParameters(void);
+  virtual void sendResult(void);
+public:
+  StructureEdges(void) {}					///< Construct talking over the standard i/o streams
+  StructureEdges(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new StructureEdges(i,o); }
   virtual void rawAction(void);
 };
 
@@ -198,6 +364,8 @@ public:
 ///   - noparammeasures    -- Do \e not send parameter measures
 ///   - jumpload           -- Send addresses of jump-table entries, when recovering switch destinations
 ///   - nojumpload         -- Do \e not send addresses of jump-table entries
+///   - draft              -- Send a quick draft of each function before its full results
+///   - nodraft            -- Do \e not send a draft
 ///
 /// The command returns a single character message, 't' or 'f', indicating whether the
 /// action succeeded.
@@ -207,6 +375,9 @@ class SetAction : public GhidraCommand {
   virtual void loadParameters(void);
   virtual void sendResult(void);
 public:
+  SetAction(void) {}					///< Construct talking over the standard i/o streams
+  SetAction(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new SetAction(i,o); }
   bool res;				///< Set to \b true if the configuration action was successful
   virtual void rawAction(void);
 };
@@ -225,12 +396,36 @@ class SetOptions : public GhidraCommand {
   virtual void loadParameters(void);
   virtual void sendResult(void);
 public:
-  SetOptions(void);
+  SetOptions(void);					///< Construct talking over the standard i/o streams
+  SetOptions(istream &i,ostream &o);			///< Construct given i/o streams
   virtual ~SetOptions(void);
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new SetOptions(i,o); }
   bool res;				///< Set to \b true if the option change succeeded
   virtual void rawAction(void);
 };
 
+/// \brief Command to \b retrieve the statistics collected by the current \e root Action
+///
+/// The command expects 2 string parameters: the encoded integer id of the program, and
+/// either an empty string or \b reset, which causes the statistics to be cleared after they
+/// are sent.  The command returns a single string containing one CSV record for each Action
+/// and Rule, with the number of times it was tested and applied and the time spent in it
+/// and the peak memory measured after it applied (see Action::printStatisticsCsv()).  Times are only
+/// collected if the \b actiontiming option is on, and memory only if the \b memorystats option is on.
+/// If the \b metrics option is on, a \e metric record follows for each kind of inner test, holding
+/// its count summed over the functions decompiled since the last reset (see AnalysisMetrics).
+class GetActionStats : public GhidraCommand {
+  string resetstring;			///< Set to \b reset to clear the statistics after reporting them
+  virtual void loadParameters(void);
+  virtual void sendResult(void);
+public:
+  GetActionStats(void) {}					///< Construct talking over the standard i/o streams
+  GetActionStats(istream &i,ostream &o) : GhidraCommand(i,o) {}	///< Construct given i/o streams
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new GetActionStats(i,o); }
+  string stats;				///< The CSV records to send back
+  virtual void rawAction(void);
+};
+
 #ifdef OPACTION_DEBUG
 extern void turn_on_debugging(Funcdata *fd);
 extern void turn_off_debugging(Funcdata *fd);
@@ -0,0 +1,196 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file ghidra_server.hh
+/// \brief Serving many Ghidra clients from one decompiler process, over sockets
+#ifndef __GHIDRA_SERVER__
+#define __GHIDRA_SERVER__
+
+#include "ghidra_process.hh"
+
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace GhidraDec {
+
+/// \brief A stream buffer reading from and writing to a connected socket
+///
+/// Input and output are buffered separately.  Output is sent when the buffer fills or the
+/// stream is flushed, which the message protocol does at the end of every command response
+/// and query.  A write to a client that has gone away fails instead of raising SIGPIPE.
+class SocketBuffer : public std::streambuf {
+  static const int4 bufsize = 65536;	///< Size of each buffer
+  int fd;				///< The connected socket
+  char inbuf[bufsize];			///< Bytes received but not yet read
+  char outbuf[bufsize];			///< Bytes written but not yet sent
+  bool sendAll(const char *ptr,size_t size);	///< Send bytes, retrying partial writes
+protected:
+  virtual int_type underflow(void);
+  virtual int_type overflow(int_type c);
+  virtual int sync(void);
+public:
+  SocketBuffer(int s);			///< Construct given a connected socket
+  virtual ~SocketBuffer(void);		///< Send anything pending and close the socket
+};
+
+class GhidraServer;
+
+/// \brief The requests to stop or pause the analysis run by one GhidraSession
+///
+/// The server asks a running command to yield when another command is waiting for a worker.
+/// If the command has held its worker for at least the server's time slice, yield() gives the
+/// worker back and waits its turn for another, so the waiting command runs in between.
+class SessionInterrupt : public AnalysisInterrupt {
+  friend class GhidraServer;
+  GhidraServer *server;			///< The server handing out workers
+  int4 requestclass;			///< Class of the session's commands (see GhidraServer::request_class)
+  int4 heldclass;			///< Class the session's current worker was handed out under
+  std::chrono::steady_clock::time_point slicestart;	///< When the session last got a worker
+protected:
+  virtual void yield(void);
+public:
+  SessionInterrupt(GhidraServer *s);	///< Construct given the server
+  int4 getRequestClass(void) const { return requestclass; }	///< Get the class of the session's commands
+  void setRequestClass(int4 cl) { requestclass = cl; }		///< Set the class of the session's commands
+};
+
+/// \brief Command to set the class of the commands a client sends after it
+///
+/// It is only offered by a GhidraServer.  The command expects a single string parameter, either
+/// \b interactive or \b background, and sends back 1 if the class was set, or 0 if the name was
+/// not recognized.  The new class applies starting with the next command of the session.
+class SetRequestClass : public GhidraCommand {
+  SessionInterrupt *session;		///< Scheduling state of the session the command belongs to
+  string classname;			///< Name of the class to set
+  virtual void loadParameters(void);
+  virtual void sendResult(void);
+public:
+  SetRequestClass(istream &i,ostream &o,SessionInterrupt *s) : GhidraCommand(i,o) { session = s; }	///< Constructor
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new SetRequestClass(i,o,session); }
+  int4 res;				///< 1 if the class was set, 0 otherwise
+  virtual void rawAction(void);
+};
+
+/// \brief Command to report the latency of the server's commands, by request class
+///
+/// It is only offered by a GhidraServer.  The command expects a single string parameter, which
+/// may be \b reset to clear the histograms after they are reported.  It sends back CSV records
+/// (see GhidraServer::printLatencyCsv()).
+class GetRequestStats : public GhidraCommand {
+  GhidraServer *server;			///< The server whose histograms are reported
+  string resetstring;			///< Set to \b reset to clear the histograms after reporting them
+  virtual void loadParameters(void);
+  virtual void sendResult(void);
+public:
+  GetRequestStats(istream &i,ostream &o,GhidraServer *s) : GhidraCommand(i,o) { server = s; }	///< Constructor
+  virtual GhidraCommand *clone(istream &i,ostream &o) const { return new GetRequestStats(i,o,server); }
+  string stats;				///< The CSV records to send back
+  virtual void rawAction(void);
+};
+
+/// \brief The connection to a single client of a GhidraServer
+///
+/// The session has its own copy of every GhidraCommand, bound to the streams of its
+/// socket, so the state of a command in progress is never shared with another client.
+/// The programs a client registers are bound to its session too (see RegisterProgram),
+/// and they are freed if the client goes away without deregistering them.
+class GhidraSession {
+  GhidraServer *server;			///< The server that accepted the connection
+  SocketBuffer buffer;			///< Buffering for the socket
+  istream sin;				///< Input stream from the client
+  ostream sout;				///< Output stream to the client
+  map<string,GhidraCommand *> commands;	///< The commands of \b this session, by name
+  SessionInterrupt interrupt;		///< Requests to stop or pause the analysis of the session's command
+public:
+  GhidraSession(GhidraServer *s,int fd);	///< Construct given the server and a connected socket
+  ~GhidraSession(void);			///< Destructor
+  void run(void);			///< Execute commands from the client until it is done
+};
+
+/// \brief A decompiler process serving many Ghidra clients over a Unix or TCP socket
+///
+/// Every accepted connection gets a GhidraSession on its own thread, which reads commands
+/// using the same message protocol as a client talking over stdin and stdout.  Each program
+/// stays in its own ArchitectureGhidra, owned by the session that registered it, but the
+/// process, and everything it has loaded, is shared by all sessions.  At most \b maxworkers
+/// commands run at any one time.  Extra commands wait for a worker, in the order they arrived.
+///
+/// If a time slice is set, a command that must wait asks the running command that has held its
+/// worker longest to yield.  A decompilation in progress then gives up its worker, once it has
+/// run for a slice, and queues behind the waiting command, so short requests are interleaved
+/// with long ones (see SessionInterrupt).
+///
+/// Each session sends its commands under a request class, set with SetRequestClass, though a
+/// command that is always background work (see GhidraCommand::isBackground()) runs as such.  Every class
+/// has its own queue of turns, and a waiting \e interactive command is always handed the next free
+/// worker before a \e background one.  A limit can be put on the number of workers a class holds
+/// at once, so background work such as prefetching or exporting can't fill the pool.  An interactive
+/// command that must wait may ask any command to yield, but a background one only asks another
+/// background command.  The time from a command's arrival to its completion is counted in a
+/// histogram for its class, reported by GetRequestStats.
+///
+/// Alternately, the server can act as a \e zygote, forking a new process for each connection.
+/// Whatever the server loaded before it started listening, such as specification documents placed
+/// in the SpecDocumentCache, is then shared by every child through copy-on-write, while a crash
+/// while serving one client leaves the others and the server running.
+class GhidraServer {
+public:
+  /// \brief Classes of request, most urgent first
+  enum request_class {
+    interactive = 0,			///< Requests a user is waiting on
+    background = 1,			///< Batch work that can wait
+    num_classes = 2			///< Number of classes
+  };
+  static const int4 num_buckets = 20;	///< Buckets of each latency histogram
+private:
+  int listenfd;				///< The listening socket (-1 if not listening)
+  int4 maxworkers;			///< Maximum number of commands running at once
+  int4 slicemillis;			///< Minimum milliseconds a command runs before yielding (0 to never yield)
+  int4 busy;				///< Number of commands running
+  bool forking;				///< Set if each connection is served by a forked process
+  int4 classlimit[num_classes];		///< Maximum number of commands of each class running at once
+  int4 classbusy[num_classes];		///< Number of commands of each class running
+  int4 waiting[num_classes];		///< Number of commands of each class waiting for a worker
+  uint8 nextticket[num_classes];	///< Turn given to the next command of each class to ask for a worker
+  uint8 serving[num_classes];		///< Turn of the next command of each class to get a worker
+  uint8 latency[num_classes][num_buckets];	///< Commands of each class, by log2 of milliseconds to complete
+  vector<SessionInterrupt *> running;	///< Interrupts of the commands holding a worker
+  std::mutex lock;			///< Guards the worker counts, turns, histograms and \b running
+  std::condition_variable idle;		///< Signaled when a worker or turn becomes available
+  void startListening(int fd,bool unixsocket);	///< Finish setting up a bound socket
+  bool canStart(int4 cl,uint8 ticket) const;	///< Can the given turn of a class take a worker now
+  void requestYield(int4 cl);		///< Ask a running command to make way for the given class
+  static void runSession(GhidraServer *srv,int fd);	///< Thread body serving one connection
+  void forkSession(int fd);		///< Serve a connection in a child process
+public:
+  GhidraServer(int4 workers,int4 slice=0);	///< Construct given the number of commands allowed to run at once
+  ~GhidraServer(void);			///< Close the listening socket
+  void listenUnix(const string &path);	///< Listen on a Unix domain socket
+  void listenTcp(int4 port);		///< Listen on a TCP port of the loopback interface
+  void run(void);			///< Accept connections, serving each on its own thread
+  int4 getSliceMillis(void) const { return slicemillis; }	///< Get the minimum milliseconds a command runs before yielding
+  void setForking(bool val) { forking = val; }	///< Toggle serving each connection in a forked process
+  void setClassLimit(int4 cl,int4 limit);	///< Limit the workers held by one request class
+  void acquireWorker(SessionInterrupt *intr,int4 cl);	///< Wait for a command slot for the given class
+  void releaseWorker(SessionInterrupt *intr);	///< Give back a command slot
+  void recordLatency(int4 cl,double millis);	///< Count a completed command of the given class
+  void printLatencyCsv(ostream &s,bool reset);	///< Print the latency histograms as CSV records
+  static const char *getClassName(int4 cl);	///< Get the name of a request class
+  static int4 findClass(const string &nm);	///< Get the request class with the given name
+};
+
+}
+#endif
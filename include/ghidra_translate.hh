@@ -31,15 +31,53 @@ namespace GhidraDec {
 ///
 /// by sending a request to a Ghidra client and decoding the response.
 /// Messages are generally based on an XML format, but p-code responses in particular
-/// have a tight internal encoding.
+/// have a tight internal encoding.  The decoded p-code of each instruction is cached, so an
+/// instruction is only requested once, until the client flushes or invalidates its bytes.
+/// Runs of instructions can be requested as a batch (see translateRun()).
 class GhidraTranslate : public Translate {
+  /// \brief A single p-code op of a cached instruction
+  struct CachedOp {
+    OpCode opc;				///< The opcode
+    int4 start;				///< Index of the first varnode of the op in CachedInstruction::vars
+    int4 numin;				///< Number of input varnodes
+    bool hasout;			///< \b true if the first varnode is an output
+  };
+
+  /// \brief The p-code of one instruction, as decoded from the client's reply
+  struct CachedInstruction {
+    Address pc;				///< Address the p-code is attributed to
+    int4 length;			///< Length of the instruction in bytes
+    bool unimpl;			///< \b true if the client reported the instruction as unimplemented
+    vector<CachedOp> ops;		///< The p-code ops
+    vector<VarnodeData> vars;		///< Outputs and inputs of all the ops
+  };
+
+  /// \brief Emitter recording the p-code of an instruction into a CachedInstruction
+  class CacheEmit : public PcodeEmit {
+    CachedInstruction &inst;		///< The instruction being recorded
+  public:
+    CacheEmit(CachedInstruction &i) : inst(i) {}	///< Constructor
+    virtual void dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize);
+  };
+
   ArchitectureGhidra *glb;			///< The Ghidra Architecture and connection to the client
   mutable map<string,VarnodeData> nm2addr;	///< Mapping from register name to Varnode
   mutable map<VarnodeData,string> addr2nm;	///< Mapping rom Varnode to register name
+  static const int4 maxbatch = 32;		///< Maximum number of instructions requested in one batch
+  mutable map<Address,CachedInstruction> pcodecache;	///< P-code of instructions already fetched, by address
+  mutable int4 maxcachedlength;			///< Length of the longest instruction in the cache
+  mutable uint4 contextgeneration;		///< Generation of the context database when the cache was filled
   const VarnodeData &cacheRegister(const string &nm,const VarnodeData &data) const;
+  void checkContext(void) const;		///< Drop the cache if the context has changed
+  const CachedInstruction &storeInstruction(const Address &baseaddr,uint1 *doc) const;
+  const CachedInstruction &fetchInstruction(const Address &baseaddr) const;	///< Get the p-code of an instruction
+  static int4 emitInstruction(PcodeEmit &emit,const Address &baseaddr,const CachedInstruction &inst);
   void restoreXml(const Element *el);		///< Initialize \b this Translate from XML
 public:
-  GhidraTranslate(ArchitectureGhidra *g) { glb = g; }	///< Constructor
+  GhidraTranslate(ArchitectureGhidra *g) { glb = g; maxcachedlength = 0; contextgeneration = 0; }	///< Constructor
+  void clearPcodeCache(void) const;		///< Forget the p-code of every instruction
+  void invalidatePcode(const Range &rng) const;	///< Forget the p-code of instructions overlapping a memory range
+  void prefetchInstructions(const vector<Address> &addrs) const;	///< Fetch the p-code of many instructions at once
 
   virtual void initialize(DocumentStorage &store);
   virtual void addRegister(const string &nm,AddrSpace *base,uintb offset,int4 size) {
@@ -50,6 +88,7 @@ public:
     throw LowlevelError("Cannot currently get all registers through this interface"); }
   virtual void getUserOpNames(vector<string> &res) const;
   virtual int4 oneInstruction(PcodeEmit &emit,const Address &baseaddr) const;
+  virtual int4 translateRun(PcodeRun &run,const Address &baseaddr,int4 maxbytes,int4 maxinsn) const;
   virtual int4 instructionLength(const Address &baseaddr) const {
     throw LowlevelError("Cannot currently get instruction length through this interface"); }
   virtual int4 printAssembly(AssemblyEmit &emit,const Address &baseaddr) const {
@@ -110,7 +110,9 @@ typedef std::vector<TrackedContext> TrackedSet;		///< A set of tracked registers
 /// Tracked variables are also queried as a group via getTrackedSet() and createSet().  These return
 /// a list of TrackedContext objects.
 class ContextDatabase {
+  uint4 generation;		///< Incremented whenever any context value may have changed
 protected:
+  void touch(void) { generation += 1; }	///< Note that context values may have changed
   static void saveTracked(std::ostream &s,const Address &addr,const TrackedSet &vec);
   static void restoreTracked(const Element *el,const AddrSpaceManager *manage,TrackedSet &vec);
 
@@ -168,8 +170,16 @@ protected:
   /// \return the memory region holding all the default context values
   virtual const uintm *getDefaultValue(void) const=0;
 public:
+  ContextDatabase(void) { generation = 0; }	///< Constructor
   virtual ~ContextDatabase() {}			///< Destructor
 
+  /// \brief Get the change generation of \b this database
+  ///
+  /// The generation changes every time a context value is set, or the database is restored,
+  /// so a context blob and valid range retrieved earlier are still good if it hasn't changed.
+  /// \return the current generation
+  uint4 getGeneration(void) const { return generation; }
+
   /// \brief Retrieve the number of words (uintm) in a context \e blob
   ///
   /// \return the number of words
@@ -307,20 +317,32 @@ public:
 
 /// \brief A helper class for caching the active context blob to minimize database lookups
 ///
-/// This merely caches the last retrieved context blob ("array of words") and the range of
-/// addresses over which the blob is valid.  It encapsulates the ContextDatabase itself and
-/// exposes a minimal interface (getContext() and setContext()).
+/// This caches the most recently retrieved context blobs ("array of words") and the range of
+/// addresses over which each blob is valid, so code that switches back and forth between a
+/// few regions with different context (ARM/Thumb interworking, for instance) doesn't go back
+/// to the database for every instruction.  The cache is dropped whenever the generation of
+/// the database changes. It encapsulates the ContextDatabase itself and exposes a minimal
+/// interface (getContext() and setContext()).
 class ContextCache {
+  /// \brief A context blob and the range of addresses over which it is valid
+  struct Entry {
+    AddrSpace *space;			///< Address space of the valid range (null if \b this is unused)
+    uintb first;			///< Starting offset of the valid range
+    uintb last;				///< Ending offset of the valid range
+    const uintm *context;		///< The context blob
+  };
+  static const int4 numentries = 4;	///< Number of blobs held
   ContextDatabase *database;		///< The encapsulated context database
   bool allowset;			///< If set to \b false, and setContext() call is dropped
-  mutable AddrSpace *curspace;		///< Address space of the current valid range
-  mutable uintb first;			///< Starting offset of the current valid range
-  mutable uintb last;			///< Ending offset of the current valid range
-  mutable const uintm *context;		///< The current cached context blob
+  mutable uint4 generation;		///< Generation of the database when the cached blobs were retrieved
+  mutable Entry entry[numentries];	///< Cached blobs, most recently used first
+  void invalidate(void) const;		///< Drop all the cached blobs
 public:
   ContextCache(ContextDatabase *db);	///< Construct given a context database
   ContextDatabase *getDatabase(void) const { return database; }		///< Retrieve the encapsulated database object
   void allowSet(bool val) { allowset = val; }		///< Toggle whether setContext() calls are ignored
+  bool isAllowSet(void) const { return allowset; }	///< Return \b true if setContext() calls are honored
+  const uintm *getContext(const Address &addr) const;	///< Get a reference to the context blob for the given address
   void getContext(const Address &addr,uintm *buf) const;	///< Retrieve the context blob for the given address
   void setContext(const Address &addr,int4 num,uintm mask,uintm value);
   void setContext(const Address &addr1,const Address &addr2,int4 num,uintm mask,uintm value);
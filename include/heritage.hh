@@ -23,13 +23,10 @@
 #include "block.hh"
 
 #include <map>
+#include <atomic>
 
 namespace GhidraDec {
 
-/// Container holding the stack system for the renaming algorithm.  Every disjoint address
-/// range (indexed by its initial address) maps to its own Varnode stack.
-typedef map<Address,vector<Varnode *> > VariableStack;
-
 /// \brief Label for describing extent of address range that has been heritaged
 struct SizePass {
   int4 size;			///< Size of the range (in bytes)
@@ -57,6 +54,7 @@ public:
   iterator begin(void) { return themap.begin(); }     ///< Get starting iterator over heritaged ranges
   iterator end(void) { return themap.end(); }	      ///< Get ending iterator over heritaged ranges
   void clear(void) { themap.clear(); }		      ///< Clear the map of heritaged ranges
+  int4 size(void) const { return themap.size(); }     ///< Get the number of heritaged ranges
 };
 
 /// \brief Priority queue for the phi-node (MULTIEQUAL) placement algorithm
@@ -74,10 +72,29 @@ public:
   void insert(FlowBlock *bl,int4 depth); ///< Insert a block into the queue given its priority
   FlowBlock *extract(void);		 ///< Retrieve the highest priority block
   bool empty(void) const { return (curdepth==-1); } ///< Return \b true if \b this queue is empty
+  void release(void) { vector<vector<FlowBlock *> >().swap(queue); curdepth = -2; }	///< Free all storage held by the queue
 };
 
 class Funcdata;
 
+/// \brief Container holding the stack system for the renaming algorithm
+///
+/// Every distinct address of a Varnode being heritaged has its own Varnode stack.  The stacks have
+/// dense indices, assigned up front by walking the Varnodes of each range being heritaged, and
+/// the index of each of those Varnodes is held in an array indexed by its creation index.  So
+/// finding the stack for a Varnode is two array lookups.  A Varnode that was not seen up front
+/// gets its stack through a map from address to index.
+class VariableStack {
+  vector<int4> varindex;		///< Index of the stack for each Varnode, by creation index (-1 if not known)
+  vector<vector<Varnode *> > stack;	///< The stack for each distinct address
+  map<AddressKey,int4> addrindex;	///< Index of the stack for each distinct address
+  int4 assignIndex(const Varnode *vn);	///< Find or create the stack for a Varnode not indexed up front
+public:
+  void build(const Funcdata *fd,LocationMap &disjoint);	///< Index the Varnodes of the ranges being heritaged
+  int4 getIndex(const Varnode *vn);	///< Get the index of the stack for the given Varnode
+  vector<Varnode *> &getStack(int4 i) { return stack[i]; }	///< Get a stack by index
+};
+
 /// \brief Information about heritage passes performed for a specific address space
 ///
 /// For a particular address space, this keeps track of:
@@ -134,19 +151,22 @@ class HeritageInfo {
 class Heritage {
   /// Extra boolean properties on basic blocks for the Augmented Dominator Tree
   enum heritage_flags {
-    boundary_node = 1,		///< Augmented Dominator Tree boundary node
-    mark_node = 2,		///< Node has already been in queue
-    merged_node = 4		///< Node has already been merged
+    boundary_node = 1		///< Augmented Dominator Tree boundary node
   };
   Funcdata *fd;		        ///< The function \b this is controlling SSA construction 
   LocationMap globaldisjoint;	///< Disjoint cover of every heritaged memory location
   LocationMap disjoint;		///< Disjoint cover of memory locations currently being heritaged
   vector<vector<FlowBlock *> > domchild; ///< Parent->child edges in dominator tree
   vector<vector<FlowBlock *> > augment; ///< Augmented edges
+  vector<vector<int4> > frontier; ///< Dominance frontier (by block index) of each block
   vector<uint4> flags;		///< Block properties for phi-node placement algorithm
+  vector<uint4> markstamp;	///< Last range (by \b rangestamp) for which each block was put in the queue
+  vector<uint4> mergestamp;	///< Last range (by \b rangestamp) for which each block was merged
+  uint4 rangestamp;		///< Stamp of the address range currently being processed by calcMultiequals
   vector<int4> depth;		///< Dominator depth of individual blocks
   int4 maxdepth;		///< Maximum depth of the dominator tree
   int4 pass;			///< Current pass being executed
+  vector<int4> effecthint;	///< Position in the EffectRecord list of each call, swept as ranges are guarded in order
 
   PriorityQueue pq;		///< Priority queue for phi-node placement
   vector<FlowBlock *> merge;	///< Calculate merge points (blocks containing phi-nodes)
@@ -166,6 +186,8 @@ class Heritage {
   void floatExtensionWrite(Varnode *vn,JoinRecord *joinrec);
   void processJoins(void);
   void buildADT(void);		///< Build the augmented dominator tree
+  void nextRangeStamp(void);	///< Start phi-node placement for a new address range
+  void buildFrontier(void);	///< Build the dominance frontier of every block
   int4 collect(Address addr,int4 size,vector<Varnode *> &read,vector<Varnode *> &write,vector<Varnode *> &input) const;
   bool callOpIndirectEffect(const Address &addr,int4 size,PcodeOp *op) const;
   Varnode *normalizeReadSize(Varnode *vn,const Address &addr,int4 size);
@@ -174,7 +196,7 @@ class Heritage {
   void splitPieces(const vector<Varnode *> &vnlist,PcodeOp *insertop,const Address &addr,int4 size,Varnode *startvn);
   void guard(const Address &addr,int4 size,vector<Varnode *> &read,vector<Varnode *> &write,vector<Varnode *> &inputvars);
   void guardInput(const Address &addr,int4 size,vector<Varnode *> &input);
-  void guardCalls(uint4 flags,const Address &addr,int4 size,vector<Varnode *> &write);
+  void guardCalls(uint4 flags,const Address &addr,int4 size,vector<Varnode *> &write,bool &unread);
   void guardStores(const Address &addr,int4 size,vector<Varnode *> &write);
   void guardReturns(uint4 flags,const Address &addr,int4 size,vector<Varnode *> &write);
   //  void guardLoads(uint4 flags,const Address &addr,int4 size,vector<Varnode *> &write);
@@ -186,8 +208,13 @@ class Heritage {
   void remove13Refinement(vector<int4> &refine);
   bool refinement(const Address &addr,int4 size,const vector<Varnode *> &readvars,const vector<Varnode *> &writevars,const vector<Varnode *> &inputvars);
   void visitIncr(FlowBlock *qnode,FlowBlock *vnode);
-  void calcMultiequals(const vector<Varnode *> &write);
-  void renameRecurse(BlockBasic *bl,VariableStack &varstack);
+  void calcMultiequals(const vector<int4> &writeblocks);
+  void calcMultiequalsBatch(const vector<vector<int4> > &writeblocks,int4 first,int4 count,
+			    vector<vector<FlowBlock *> > &mergesets) const;
+  void multiequalWorker(const vector<vector<int4> > &writeblocks,
+			vector<vector<vector<FlowBlock *> > > &batchsets,std::atomic<int4> &next) const;
+  void insertMultiequals(const Address &addr,int4 size,const vector<FlowBlock *> &blocks);
+  void renameBlock(BlockBasic *bl,VariableStack &varstack,vector<int4> &writelist);
   void bumpDeadcodeDelay(Varnode *vn);
 public:
   Heritage(Funcdata *data);	///< Constructor
@@ -206,6 +233,8 @@ public:
   void buildInfoList(void);	                    ///< Initialize information for each space
   void forceRestructure(void) { maxdepth = -1; }    ///< Force regeneration of basic block structures
   void clear(void);				    ///< Reset all analysis of heritage
+  void releaseStorage(void);			    ///< Reset all analysis and free the storage kept for reuse
+  uint8 memoryEstimate(void) const;		    ///< Estimate the bytes of heap used by the heritage analysis
   void placeMultiequals(void);
   void rename(void);
   void heritage(void);				    ///< Perform one pass of heritage
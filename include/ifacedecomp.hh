@@ -23,6 +23,7 @@
 #include "grammar.hh"
 #include "callgraph.hh"
 #include "paramid.hh"
+#include "batch.hh"
 #ifdef CPUI_RULECOMPILE
 #include "rulecompile.hh"
 #endif
@@ -43,6 +44,7 @@ public:
   Funcdata *fd;		// Current function data
   Architecture *conf;
   CallGraph *cgraph;
+  bool batchpin;		// Bind the worker threads of batch commands to their own CPUs
 
   map<Funcdata*,PrototypePieces> prototypePieces;
   void storePrototypePieces( Funcdata *fd_in, PrototypePieces pp_in ) { prototypePieces.insert(pair<Funcdata*,PrototypePieces>(fd_in,pp_in)); }
@@ -181,6 +183,16 @@ public:
   virtual void execute(istream &s);
 };
 
+class IfcDecompileBatch : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
+class IfcSetbatch : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcPrintLanguage : public IfaceDecompCommand {
 public:
   virtual void execute(istream &s);
@@ -201,6 +213,16 @@ public:
   virtual void execute(istream &s);
 };
 
+class IfcPrintSummary : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
+class IfcRecordSummary : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcPrintCGlobals : public IfaceDecompCommand {
 public:
   virtual void execute(istream &s);
@@ -212,7 +234,10 @@ public:
 };
 
 class IfcProduceC : public IfaceDecompCommand {
+  OutputWriter *writer;		///< Writer thread taking the printed functions
+  void produceParallel(int4 numthreads);	///< Decompile and print on a pool of threads
 public:
+  IfcProduceC(void) { writer = (OutputWriter *)0; }	///< Constructor
   virtual void execute(istream &s);
   virtual void iterationCallback(Funcdata *fd);
 };
@@ -278,6 +303,11 @@ public:
   virtual void execute(istream &s);
 };
 
+class IfcPrintInstructionCache : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcPrintHigh : public IfaceDecompCommand {
 public:
   virtual void execute(istream &s);
@@ -316,6 +346,11 @@ public:
   virtual void execute(istream &s);
 };
 
+class IfcPrintRange : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcPrintCover : public IfaceDecompCommand {
 public:
   virtual void execute(istream &s);
@@ -422,6 +457,21 @@ public:
   virtual void execute(istream &s);
 };
 
+class IfcPropagatePrototypes : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
+class IfcSavePrototypes : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
+class IfcLoadPrototypes : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcPrintLocalrange : public IfaceDecompCommand {
 public:
   virtual void execute(istream &s);
@@ -485,11 +535,21 @@ class IfcCallGraphBuildQuick : public IfcCallGraphBuild {
   virtual void execute(istream &s);
 };
 
+class IfcCallGraphBuildIndex : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcCallGraphLoad : public IfaceDecompCommand {
 public:
   virtual void execute(istream &s);
 };
 
+class IfcCallGraphPartition : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcCallGraphList : public IfaceDecompCommand {
 protected:
   bool quick;
@@ -523,6 +583,16 @@ public:
   virtual void execute(istream &s);
 };
 
+class IfcPrintMemory : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
+class IfcPrintMetrics : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 class IfcResetActionstats : public IfaceDecompCommand {
 public:
   virtual void execute(istream &s);
@@ -543,6 +613,11 @@ public:
   virtual void execute(istream &s);
 };
 
+class IfcStructureDominators : public IfaceDecompCommand {
+public:
+  virtual void execute(istream &s);
+};
+
 #ifdef CPUI_RULECOMPILE
 class IfcParseRule : public IfaceDecompCommand {
 public:
@@ -38,12 +38,15 @@ public:
 /// This acts as a placeholder for the actual details of the payload.
 /// When the inject() method is invoked, the context is wrapped as XML and
 /// sent to the Ghidra client, which returns the actual p-code to inject.
+/// The p-code is cached by context, so the client is only asked once for each distinct context.
 class InjectPayloadGhidra : public InjectPayload {
   string source;		///< Source description to associate with the payload
+  mutable InjectPcodeCache cache;	///< P-code already received from the client
 public:
   InjectPayloadGhidra(const string &src,const string &nm,int4 tp) : InjectPayload(nm,tp) { source = src; }	///< Constructor
   virtual void inject(InjectContext &context,PcodeEmit &emit) const;
   virtual void restoreXml(const Element *el) {}
+  virtual void clearCache(void) { cache.clear(); }
   virtual void printTemplate(ostream &s) const;
   virtual string getSource(void) const { return source; }
 };
@@ -33,6 +33,7 @@ public:
 class InjectPayloadSleigh : public InjectPayload {
   friend class PcodeInjectLibrarySleigh;
   ConstructTpl *tpl;
+  bool sharedtpl;		// True if \b tpl is owned by a SnippetCache
   string parsestring;
   string source;
 public:
@@ -68,6 +69,7 @@ class ExecutablePcodeSleigh : public ExecutablePcode {
 protected:
   string parsestring;
   ConstructTpl *tpl;
+  bool sharedtpl;		// True if \b tpl is owned by a SnippetCache
  public:
   ExecutablePcodeSleigh(Architecture *g,const string &src,const string &nm);
   virtual ~ExecutablePcodeSleigh(void);
@@ -88,8 +90,25 @@ public:
   virtual string getSource(void) const { return "dynamic"; }
 };
 
+/// \brief Compiled p-code snippets, shared by every Architecture using the same SLEIGH translator
+///
+/// The templates are keyed by the snippet text, together with everything else that changes how
+/// it compiles: the kind of payload, its operands, and the first free offset in the unique space.
+/// The cache owns the templates, and payloads built from them only borrow them, so the cache
+/// must live as long as the translator whose address spaces they refer to.
+class SnippetCache {
+  map<string,pair<ConstructTpl *,uintb> > snippets;	// Template and the next free unique offset, by key
+public:
+  ~SnippetCache(void) { clear(); }
+  void clear(void);
+  ConstructTpl *find(const string &key,uintb &uniqueend) const;
+  void insert(const string &key,ConstructTpl *tpl,uintb uniqueend);
+  static string buildKey(InjectPayload *payload,uintb uniquebase,const string &text);
+};
+
 class PcodeInjectLibrarySleigh : public PcodeInjectLibrary {
   const SleighBase *slgh;
+  SnippetCache *snippetcache;		// Cache of compiled snippets (may be null)
   vector<OpBehavior *> inst;
   InjectContextSleigh contextCache;
   int4 registerDynamicInject(InjectPayload *payload);
@@ -99,6 +118,7 @@ protected:
   virtual void registerInject(int4 injectid);
 public:
   PcodeInjectLibrarySleigh(Architecture *g,uintb tmpbase);
+  void setSnippetCache(SnippetCache *cache) { snippetcache = cache; }
   virtual void restoreDebug(const Element *el);
   virtual int4 manualCallFixup(const string &name,const string &snippetstring);
   virtual int4 manualCallOtherFixup(const string &name,const string &outname,const vector<string> &inname,
@@ -0,0 +1,97 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file insnindex.hh
+/// \brief A concurrent index of decoded instructions, shared by threads tracing control-flow
+#ifndef __CPUI_INSNINDEX__
+#define __CPUI_INSNINDEX__
+
+#include "translate.hh"
+
+#include <mutex>
+#include <atomic>
+
+namespace GhidraDec {
+
+/// \brief The control-flow summary of a single decoded machine instruction
+struct InstructionEntry {
+  enum {
+    fallthru = 1,		///< Execution can continue at the next instruction
+    branch = 2,			///< Instruction has a direct branch (conditional or not)
+    call = 4,			///< Instruction has a direct call
+    branchind = 8,		///< Instruction has an indirect branch
+    callind = 0x10,		///< Instruction has an indirect call
+    returns = 0x20,		///< Instruction returns from the function
+    baddata = 0x40,		///< Bytes could not be decoded as an instruction
+    unimplemented = 0x80	///< Instruction decoded but has no semantics
+  };
+  int4 length;			///< Number of bytes in the instruction (0 for bad data)
+  uint4 flags;			///< Properties of the instruction
+  vector<Address> branches;	///< Destinations of direct branches
+  vector<Address> calls;	///< Destinations of direct calls
+  InstructionEntry(void) { length = 0; flags = 0; }	///< Constructor
+  bool isFallthru(void) const { return ((flags & fallthru)!=0); }	///< Can execution fall through?
+  bool isBad(void) const { return ((flags & baddata)!=0); }		///< Did decoding fail?
+};
+
+/// \brief Sizes of the control-flow of a function, counted from the instructions in an index
+struct FlowMeasure {
+  int4 numinsn;			///< Number of instructions reached from the entry point
+  int4 numblocks;		///< Number of basic blocks among the instructions reached
+  int4 numindirect;		///< Number of indirect branches among the instructions reached
+  FlowMeasure(void) { numinsn = 0; numblocks = 0; numindirect = 0; }	///< Construct with zero counts
+};
+
+/// \brief Instructions of a LoadImage, decoded at most once and shared by all threads
+///
+/// The index maps the address of each instruction decoded so far to its length and the
+/// flow information needed to follow control-flow: whether it falls through, and the
+/// targets of its direct branches and calls.  The map is split into shards, each with its
+/// own lock, so threads tracing different functions rarely contend.  An instruction is
+/// decoded while its shard is locked, so it is never decoded twice, even when functions
+/// traced in parallel share code.
+///
+/// Tracing does not change the context database: any context changes made by the
+/// instructions themselves are ignored.
+class InstructionIndex {
+  /// \brief A group of entries sharing a lock
+  struct Shard {
+    std::mutex lock;				///< Guards \b entries
+    map<Address,InstructionEntry> entries;	///< Decoded instructions by address
+  };
+  static const int4 numshards = 64;	///< Number of independently locked groups
+  const Translate *trans;		///< Translator used to decode instructions
+  Shard shards[numshards];		///< The sharded map of instructions
+  std::atomic<uint8> numdecoded;	///< Number of instructions decoded
+  std::atomic<uint8> numreused;		///< Number of lookups that found an existing entry
+  Shard &getShard(const Address &addr) { return shards[(addr.getOffset() >> 2) % numshards]; }	///< Get the shard holding an address
+  void decode(const Address &addr,InstructionEntry &entry) const;	///< Decode the instruction at the given address
+  const InstructionEntry *find(const Address &addr);	///< Get the entry for an instruction if it has been decoded
+  void traceWorker(int4 index,const vector<Address> &entries,std::atomic<int4> &next,
+		   vector<vector<pair<Address,Address> > > &results,uint4 maxinsn);	///< Trace functions on one thread
+public:
+  InstructionIndex(const Translate *t);	///< Construct an empty index for the given translator
+  const InstructionEntry &obtain(const Address &addr);	///< Get the entry for an instruction, decoding it if necessary
+  void traceFunction(const Address &entry,vector<pair<Address,Address> > &calls,uint4 maxinsn);	///< Follow flow from an entry point
+  void traceAll(const vector<Address> &entries,int4 numthreads,
+		vector<vector<pair<Address,Address> > > &results,uint4 maxinsn);	///< Trace many functions in parallel
+  bool measureFunction(const Address &entry,FlowMeasure &res);	///< Count the flow of a function already traced
+  void clear(void);			///< Throw away every decoded instruction
+  uint8 getNumDecoded(void) const { return numdecoded; }	///< Get the number of instructions decoded
+  uint8 getNumReused(void) const { return numreused; }	///< Get the number of lookups answered from the index
+};
+
+}
+#endif
@@ -65,6 +65,7 @@ public:
   void set(const vector<PcodeOp *> &path,const vector<int4> &slot);
   void set(PcodeOp *op,Varnode *vn);
   void append(const PathMeld &op2);
+  void swap(PathMeld &op2);
   void clear(void);
   void meld(vector<PcodeOp *> &path,vector<int4> &slot);
   int4 numCommonVarnode(void) const { return commonVn.size(); }
@@ -88,6 +89,10 @@ class EmulateFunction : public EmulatePcodeOp {
   virtual void executeCallind(void);
   virtual void executeCallother(void);
   virtual void fallthruOp(void);
+  static uint4 findStart(const PathMeld &pathMeld,PcodeOp *&startop,Varnode *&startvn);
+  static bool canBatch(const PathMeld &pathMeld,uint4 start);
+  int4 getSlot(Varnode *vn,map<Varnode *,int4> &slotmap,vector<uintb> &slots,int4 count) const;
+  void batchLoad(PcodeOp *op,const uintb *in,uintb *out,int4 count,vector<LoadTable> &loads);
 public:
   EmulateFunction(Funcdata *f);
   void setLoadCollect(bool val) { collectloads = val; }
@@ -95,6 +100,8 @@ public:
   virtual uintb getVarnodeValue(Varnode *vn) const;
   virtual void setVarnodeValue(Varnode *vn,uintb val);
   uintb emulatePath(uintb val,const PathMeld &pathMeld,PcodeOp *startop,Varnode *startvn);
+  bool emulatePathBatch(const vector<uintb> &vals,const PathMeld &pathMeld,PcodeOp *startop,Varnode *startvn,
+			vector<uintb> &res);
   void collectLoadPoints(vector<LoadTable> &res) const;
 };
 
@@ -247,6 +254,7 @@ protected:
 public:
   JumpBasic(JumpTable *jt) : JumpModel(jt) { jrange = (JumpValuesRange *)0; }
   const PathMeld &getPathMeld(void) const { return pathMeld; }
+  PathMeld &getPathMeld(void) { return pathMeld; }
   const JumpValuesRange *getValueRange(void) const { return jrange; }
   virtual ~JumpBasic(void);
   virtual bool isOverride(void) const { return false; }
@@ -275,7 +283,7 @@ class JumpBasic2 : public JumpBasic {
   virtual bool foldInOneGuard(Funcdata *fd,GuardRecord &guard,JumpTable *jump);
 public:
   JumpBasic2(JumpTable *jt) : JumpBasic(jt) {}
-  void initializeStart(const PathMeld &pathMeld);
+  void initializeStart(PathMeld &pathMeld);
   virtual bool recoverModel(Funcdata *fd,PcodeOp *indop,uint4 matchsize,uint4 maxtablesize);
   virtual void findUnnormalized(uint4 maxaddsub,uint4 maxleftright,uint4 maxext);
   virtual JumpModel *clone(JumpTable *jt) const;
@@ -406,10 +414,47 @@ public:
   bool recoverLabels(Funcdata *fd);
   bool checkForMultistage(Funcdata *fd);
   void clear(void);
+  uint8 memoryEstimate(void) const;	///< Estimate the bytes of heap used by \b this jump-table
   void saveXml(ostream &s) const;
   void restoreXml(const Element *el);
 };  
 
+// Jump-tables recovered by earlier decompilations, keyed by function and BRANCHIND address.
+// When a function is decompiled again (after a rename or retype, say), or when flow is regenerated
+// after a restart, a cached table stands in for the partial-function recovery that would otherwise
+// be repeated for the same switch.  Each table remembers the bytes of the load image that its
+// recovery read (the table itself, any guard constants, and the BRANCHIND instruction), and it is
+// only reused while a hash of those bytes is unchanged.  If a file is attached, every stored table
+// is appended to it, and the tables in it are read back when it is attached in a later session.
+class JumpTableCache {
+  struct Entry {
+    JumpTable *table;		// The cached table
+    RangeList ranges;		// Load image bytes the recovery depended on
+    uint8 hash;			// Hash of the bytes in -ranges- when the table was recovered
+    Entry(void) { table = (JumpTable *)0; hash = 0; }
+  };
+  Architecture *glb;		// Architecture owning the load image
+  map<Address,map<Address,Entry> > cache;	// Function address -> (BRANCHIND address -> table)
+  string filename;		// File that stored tables are appended to (empty if not persisted)
+  int4 count;			// Total number of cached tables
+  bool hashEntry(const Entry &entry,uint8 &hash) const;
+  void insert(const Address &fnaddr,JumpTable *jt,const RangeList &ranges,uint8 hash);
+  void saveXmlEntry(ostream &s,const Address &fnaddr,const Entry &entry) const;
+  void restoreXmlEntry(const Element *el);
+public:
+  JumpTableCache(Architecture *g) { glb = g; count = 0; }
+  ~JumpTableCache(void) { clear(); }
+  const JumpTable *find(const Address &fnaddr,const Address &opaddr) const;
+  void store(const Address &fnaddr,const JumpTable *jt,const RangeList &reads);
+  void clearFunction(const Address &fnaddr);
+  void clear(void);
+  int4 size(void) const { return count; }
+  const string &getFile(void) const { return filename; }
+  void attachFile(const string &fname);
+  void saveXml(ostream &s) const;
+  void restoreXml(const Element *el);
+};
+
 }
 
 #endif
@@ -33,4 +33,30 @@ extern void startDecompilerLibrary(const char *sleighhome,const vector<string> &
 
 extern void shutdownDecompilerLibrary(void);
 
+namespace GhidraDec {
+/// \brief An independent decompiler instance for a program embedded in another application
+///
+/// A context owns its Architecture and everything built from it (symbols, types, actions,
+/// printer), so any number of contexts can be open at once, and separate contexts can be used
+/// concurrently from separate threads.  What they share is read-only after
+/// startDecompilerLibrary(): the registered capabilities, the list of known languages, and the
+/// operator tables of the printers.  SLEIGH translators and parsed specification files are
+/// shared through the SleighArchitecture cache, which gives a live context exclusive use of
+/// its translator.  A single context must not be used by more than one thread at a time.
+class DecompilerContext {
+  Architecture *glb;		///< The open program (null if none is open)
+  ostringstream errs;		///< Messages produced while opening and decompiling
+public:
+  DecompilerContext(void) { glb = (Architecture *)0; }	///< Construct with no program open
+  ~DecompilerContext(void) { close(); }			///< Destructor
+  void open(const string &filename,const string &target);	///< Load a program into \b this context
+  void close(void);						///< Free the open program
+  bool isOpen(void) const { return (glb != (Architecture *)0); }	///< Return \b true if a program is open
+  Architecture *getArchitecture(void) const { return glb; }	///< Get the Architecture of the open program
+  string decompile(const Address &addr);			///< Decompile the function at the given address
+  string getMessages(void) const { return errs.str(); }		///< Get the messages produced so far
+};
+
+}
+
 #endif
@@ -38,6 +38,7 @@ struct DataUnavailError : public LowlevelError {
 struct LoadImageFunc {
   Address address;	///< Start of function
   string name;		///< Name of function
+  bool operator<(const LoadImageFunc &op2) const { return (address < op2.address); }	///< Compare by address
 };
 
 /// \brief A record describing a section bytes in the executable
@@ -78,6 +79,8 @@ public:
   virtual ~LoadImage(void);	///< LoadImage destructor
   const string &getFileName(void) const; ///< Get the name of the LoadImage
   virtual void loadFill(uint1 *ptr,int4 size,const Address &addr)=0; ///< Get data from the LoadImage
+  virtual const uint1 *peek(int4 size,const Address &addr); ///< Get a direct pointer to data in the LoadImage
+  virtual bool isHole(int4 size,const Address &addr); ///< Return \b true if a range is known to hold no data
   virtual void openSymbols(void) const; ///< Prepare to read symbols
   virtual void closeSymbols(void) const; ///< Stop reading symbols
   virtual bool getNextSymbol(LoadImageFunc &record) const; ///< Get the next symbol record
@@ -110,6 +113,86 @@ public:
   virtual void adjustVma(long adjust);
 };
 
+/// \brief The bytes of a file, or of a range within a file, mapped read-only into memory
+///
+/// On platforms without \e mmap, the bytes are read into memory instead.
+class FileMapping {
+  const uint1 *base;		///< Start of the mapped bytes in memory
+  uintb size;			///< Number of bytes mapped
+  uintb skip;			///< Bytes mapped before \b base to start the mapping on a page boundary
+  bool mapped;			///< \b true if \b base is a mapping (rather than heap storage)
+  FileMapping(const FileMapping &op);			///< Mappings are not copied
+  FileMapping &operator=(const FileMapping &op);	///< Mappings are not copied
+public:
+  FileMapping(void) { base = (const uint1 *)0; size = 0; skip = 0; mapped = false; }	///< Construct an unopened mapping
+  ~FileMapping(void) { close(); }		///< Destructor
+  void open(const string &filename) { openRange(filename,0,~((uintb)0)); }	///< Map the whole of the given file into memory
+  void openRange(const string &filename,uintb offset,uintb length);	///< Map a range of the given file into memory
+  void close(void);				///< Release the mapping
+  bool isOpen(void) const { return (base != (const uint1 *)0); }	///< Return \b true if a file is mapped
+  const uint1 *getBase(void) const { return base; }	///< Get the start of the mapped bytes
+  uintb getSize(void) const { return size; }		///< Get the number of bytes mapped
+};
+
+/// \brief A raw binary loadimage that is memory mapped
+///
+/// Bytes and addresses correspond exactly as for RawLoadImage, but the file is mapped into
+/// memory once when it is opened, so loadFill() is a bounds check and a memcpy, and peek()
+/// returns pointers directly into the mapping.
+class LoadImageMmap : public LoadImage {
+  uintb vma;			///< Address of first byte in the file
+  FileMapping file;		///< The file's bytes in memory
+  AddrSpace *spaceid;		///< Address space that the file bytes are mapped to
+public:
+  LoadImageMmap(const string &f); ///< Constructor
+  void attachToSpace(AddrSpace *id) { spaceid = id; }	///< Attach the image to a particular space
+  void open(void);					///< Map the file into memory
+  virtual ~LoadImageMmap(void);				///< Destructor
+  virtual void loadFill(uint1 *ptr,int4 size,const Address &addr);
+  virtual const uint1 *peek(int4 size,const Address &addr);
+  virtual string getArchType(void) const;
+  virtual void adjustVma(long adjust);
+};
+
+/// \brief A raw binary loadimage made of separate regions of one file
+///
+/// Each region loads a range of the file at a range of addresses, and addresses outside every
+/// region are holes.  This suits sparse memory dumps, where only the populated ranges need
+/// to be present.  The regions are listed in a text \e region \e map, one per line as
+///   - fileoffset address size [readonly]
+///
+/// where numbers can be decimal or C-style hex or octal, addresses are byte offsets into the
+/// attached space, and lines starting with '#' are ignored.  A region is mapped into memory
+/// the first time one of its bytes is read, so memory is only used for the regions (and,
+/// with \e mmap, the pages) that are touched.  Holes are found by binary search and are
+/// reported by isHole() without an exception being thrown.
+class LoadImageRegions : public LoadImage {
+  /// \brief A range of the file loaded at a range of addresses
+  struct Region {
+    uintb address;		///< Address of the first byte of the region
+    uintb fileoffset;		///< Offset of the first byte of the region within the file
+    uintb size;			///< Number of bytes in the region
+    bool readonly;		///< \b true if the region is read-only
+    FileMapping *mapping;	///< Bytes of the region, once they have been mapped
+    bool operator<(const Region &op2) const { return (address < op2.address); }	///< Compare by address
+  };
+  vector<Region> regions;	///< The regions, sorted by address
+  AddrSpace *spaceid;		///< Address space that the regions are mapped to
+  vector<Region>::iterator findRegion(uintb off);	///< Find the first region that ends after an offset
+  const uint1 *getBytes(Region &reg);	///< Get the bytes of a region, mapping them if necessary
+public:
+  LoadImageRegions(const string &f);	///< Constructor
+  void attachToSpace(AddrSpace *id) { spaceid = id; }	///< Attach the image to a particular space
+  void open(const string &mapfile);	///< Read the region map
+  virtual ~LoadImageRegions(void);	///< Destructor
+  virtual void loadFill(uint1 *ptr,int4 size,const Address &addr);
+  virtual const uint1 *peek(int4 size,const Address &addr);
+  virtual bool isHole(int4 size,const Address &addr);
+  virtual void getReadonly(RangeList &list) const;
+  virtual string getArchType(void) const;
+  virtual void adjustVma(long adjust);
+};
+
 /// For the base class there is no relevant initialization except
 /// the name of the image.
 /// \param f is the name of the image
@@ -177,6 +260,28 @@ inline bool LoadImage::getNextSection(LoadImageSection &record) const {
   return false;
 }
 
+/// Some load images hold their bytes in memory in the same layout as the addresses they
+/// are loaded at.  For these, a pointer to the bytes can be returned directly, avoiding the
+/// copy done by loadFill().  A \e null pointer is returned if the whole range is not
+/// available this way, and the caller should fall back to loadFill(), which also reports
+/// any error.  A returned pointer remains valid for the life of the LoadImage.
+/// \param size is the number of bytes needed
+/// \param addr is the starting address of the bytes
+/// \return a pointer to the bytes, or null
+inline const uint1 *LoadImage::peek(int4 size,const Address &addr) {
+  return (const uint1 *)0;
+}
+
+/// Load images with large unmapped ranges can answer this cheaply, letting the caller treat
+/// the range as empty without calling loadFill() and catching the DataUnavailError.  A
+/// return value of \b false does not mean the range can be loaded.
+/// \param size is the number of bytes in the range
+/// \param addr is the starting address of the range
+/// \return \b true if no byte of the range is in the image
+inline bool LoadImage::isHole(int4 size,const Address &addr) {
+  return false;
+}
+
 /// This method should read out information about \e all
 /// address ranges within the load image that are known to be
 /// \b readonly.  This method is intended to be called only
@@ -36,6 +36,16 @@ struct ImportRecord {
 };
 
 class LoadImageBfd : public LoadImage {
+  struct SectionEntry {		// A section in the address index
+    uintb start;		// First offset of the section
+    uintb stop;			// Offset just past the end of the section
+    int4 order;			// Position of the section in the BFD list
+    asection *sec;		// The section
+    bool operator<(const SectionEntry &op2) const {
+      if (start != op2.start) return (start < op2.start);
+      return (order < op2.order); }
+  };
+
   static int4 bfdinit;		// Is the library (globally) initialized
   string target;		// File format (supported by BFD)
   bfd *thebfd;
@@ -48,6 +58,9 @@ class LoadImageBfd : public LoadImage {
   mutable long number_of_symbols;
   mutable long cursymbol;
   mutable asection *secinfoptr;
+  vector<SectionEntry> secindex;	// Sections sorted by starting offset
+  vector<uintb> secmaxstop;	// Largest end offset of any section up to each index
+  void buildSectionIndex(void);	// Sort the sections for findSection
   asection *findSection(uintb offset,uintb &ssize) const; // Find section containing given offset
   void advanceToNextSymbol(void) const;
 public:
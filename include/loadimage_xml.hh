@@ -21,19 +21,47 @@
 
 #include "loadimage.hh"
 
+namespace GhidraDec {
+
+/// \brief Decode \<bytechunk> tags while a \<binaryimage> is being parsed
+///
+/// Passing this to DocumentStorage::openDocument() or xml_tree() keeps the image data in
+/// the parsed tree as raw bytes instead of as hex text, which cuts the memory needed to
+/// load large XML images and save files roughly in half.
+class BinaryImagePacker : public ElementConsumer {
+public:
+  virtual bool consume(Element *el);
+};
+
 /// \brief Implementation of the LoadImage interface using underlying data stored in an XML format
 ///
 /// The image data is stored in an XML file in a \<binaryimage> file.
 /// The data is encoded in \<bytechunk> and potentially \<symbol> files.
+/// The content of a \<bytechunk> is hex text, or base64 text if it has the attribute
+/// \e encoding="base64".  Alternately a \<bytechunk> can be empty and refer to a range of a
+/// raw binary \e sidecar file with the attributes \e file, \e fileoffset and \e length.
+/// A relative \e file path is relative to the directory of the XML file.  Sidecar files
+/// are mapped into memory, and their chunks point directly into the mapping.
 class LoadImageXml : public LoadImage {
+  /// \brief The bytes of the image starting at one address
+  struct Chunk {
+    vector<uint1> storage;			///< Bytes decoded from the XML
+    const uint1 *mapdata;			///< Start of the bytes in a sidecar file, or null if they are in \b storage
+    uintb mapsize;				///< Number of bytes in the sidecar file
+    Chunk(void) { mapdata = (const uint1 *)0; mapsize = 0; }	///< Construct an empty chunk
+    const uint1 *data(void) const { return (mapdata != (const uint1 *)0) ? mapdata : storage.data(); }	///< Get the bytes
+    uintb size(void) const { return (mapdata != (const uint1 *)0) ? mapsize : storage.size(); }	///< Get the number of bytes
+  };
   const Element *rootel;			///< The root XML element
   string archtype;				///< The architecture string
   const AddrSpaceManager *manage;		///< Manager of addresses
   set<Address> readonlyset;			///< Starting address of read-only chunks
-  map<Address,vector<uint1> > chunk;		///< Chunks of image data, mapped by address
+  map<Address,Chunk> chunk;			///< Chunks of image data, mapped by address
+  map<string,FileMapping *> sidecar;		///< Sidecar files mapped so far, by path
   map<Address,string> addrtosymbol;		///< Symbols sorted by address
   mutable map<Address,string>::const_iterator cursymbol;	///< Current symbol being reported
   void pad(void);			///< Make sure every chunk is followed by at least 512 bytes of pad
+  void mapChunk(const Element *el,Chunk &chnk);	///< Point a chunk at its range of a sidecar file
 public:
   LoadImageXml(const string &f,const Element *el);	///< Constructor
   void open(const AddrSpaceManager *m);		///< Read XML tags into the containers
@@ -41,6 +69,7 @@ public:
   void saveXml(ostream &s) const;		///< Save the image back out to an XML stream
   virtual ~LoadImageXml(void) { clear(); }
   virtual void loadFill(uint1 *ptr,int4 size,const Address &addr);
+  virtual const uint1 *peek(int4 size,const Address &addr);
   virtual void openSymbols(void) const;
   virtual bool getNextSymbol(LoadImageFunc &record) const;
   virtual void getReadonly(RangeList &list) const;
@@ -48,4 +77,5 @@ public:
   virtual void adjustVma(long adjust);
 };
 
+}
 #endif
@@ -0,0 +1,260 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file mempool.hh
+/// \brief Recycled storage for the small objects the decompiler creates and destroys in bulk
+#ifndef __CPUI_MEMPOOL__
+#define __CPUI_MEMPOOL__
+
+#include "types.h"
+
+#include <cstddef>
+#include <new>
+#include <mutex>
+#include <atomic>
+
+namespace GhidraDec {
+
+/// \brief The source of the slabs that every ObjectPool carves its objects from
+///
+/// By default slabs come from the heap.  A batch running on many cores can instead have each
+/// thread carve its slabs out of large \e regions of its own, mapped directly from the operating
+/// system, optionally backed by huge pages:
+///   - \e region   plain anonymous mappings
+///   - \e transparent  mappings aligned to the huge page size and advised to the kernel as
+///                   candidates for transparent huge pages
+///   - \e hugetlb   mappings from the reserved huge page pool, falling back to \e transparent
+///                   once the pool is exhausted
+///
+/// A region is first touched by the thread that carves it, so under the default first-touch
+/// policy its pages are allocated on the NUMA node that thread is running on.  With the workers
+/// of a BatchDecompiler pinned to their CPUs, the Varnodes, PcodeOps and blocks of each worker
+/// stay in memory local to its socket, and huge pages cut the TLB misses of walking them.
+/// Like the slabs themselves, regions are never returned.  Platforms without \e mmap always
+/// use the heap.
+class SlabArena {
+public:
+  /// \brief Where slabs come from
+  enum backing {
+    heap = 0,			///< The global heap
+    region = 1,			///< Per-thread anonymous mappings
+    transparent = 2,		///< Per-thread mappings advised for transparent huge pages
+    hugetlb = 3			///< Per-thread mappings from the reserved huge page pool
+  };
+private:
+  static const size_t cacheline = 64;		///< Alignment of each slab
+  static const size_t regionsize = 2*1024*1024;	///< Size of a region, and of a huge page
+  /// \brief The unused part of the current region of a thread
+  struct Region {
+    uint1 *cur;			///< Next free byte
+    uint1 *end;			///< End of the region
+    Region(void) { cur = (uint1 *)0; end = (uint1 *)0; }	///< Construct with no region
+  };
+  static thread_local Region local;		///< Region of the current thread
+  static std::atomic<int4> mode;		///< The current backing
+  static std::atomic<uint8> numregions;		///< Number of regions mapped
+  static std::atomic<uint8> numhuge;		///< Number of regions mapped from the huge page pool
+  static uint1 *mapRegion(size_t size,int4 how);	///< Map a new region
+public:
+  static void setBacking(backing b) { mode.store(b,std::memory_order_relaxed); }	///< Set where new slabs come from
+  static backing getBacking(void) { return (backing)mode.load(std::memory_order_relaxed); }	///< Get where new slabs come from
+  static bool parseBacking(const char *nm,backing &res);	///< Look up a backing by name
+  static const char *getBackingName(backing b);		///< Get the name of a backing
+  static void *allocate(size_t size);		///< Allocate a cache-line aligned slab
+  static uint8 getNumRegions(void) { return numregions.load(std::memory_order_relaxed); }	///< Get the number of regions mapped
+  static uint8 getNumHuge(void) { return numhuge.load(std::memory_order_relaxed); }	///< Get the number of regions in the huge page pool
+};
+
+/// \brief A free-list allocator for objects of a single class
+///
+/// Storage is carved out of large slabs, and released objects are threaded onto a free list
+/// so that the next allocation of the same class reuses them without going to the heap.
+/// Once a program has decompiled a few functions, creating and destroying PcodeOp and Varnode
+/// objects costs a couple of pointer moves.  Each thread has its own free list, so no locking
+/// is needed in the common case.  When a thread exits, its free list is handed to a shared
+/// list that other threads refill from.  Slabs come from the SlabArena, are aligned to a cache
+/// line, and are never returned.
+///
+/// A class opts in by defining its own \b operator \b new and \b operator \b delete in
+/// terms of allocate() and release().
+template<typename T>
+class ObjectPool {
+  /// \brief A free chunk of storage, overlaid on the memory of a released object
+  struct Chunk {
+    Chunk *next;		///< Next free chunk
+  };
+  /// \brief The free list of a single thread
+  struct LocalList {
+    Chunk *head;		///< First free chunk
+    LocalList(void) { head = (Chunk *)0; }	///< Constructor
+    ~LocalList(void);		///< Hand any remaining chunks to the shared list
+  };
+  static const size_t slabcount = 256;	///< Number of objects allocated together
+  /// Size of each chunk: large enough for both T and Chunk, and a multiple of the alignment
+  static const size_t chunksize = ((sizeof(T) > sizeof(Chunk) ? sizeof(T) : sizeof(Chunk))
+				   + alignof(std::max_align_t) - 1) / alignof(std::max_align_t) * alignof(std::max_align_t);
+  static thread_local LocalList local;	///< Free list for the current thread
+  static std::mutex sharedlock;		///< Guards \b sharedhead
+  static Chunk *sharedhead;		///< Chunks released by threads that have exited
+  static void refill(void);		///< Restock the current thread's free list
+public:
+  /// \brief Allocate storage for one object
+  ///
+  /// \param size is the size requested by \b operator \b new
+  /// \return the storage
+  static void *allocate(size_t size) {
+    if (size != sizeof(T)) return ::operator new(size);	// A derived class, use the heap
+    if (local.head == (Chunk *)0)
+      refill();
+    Chunk *res = local.head;
+    local.head = res->next;
+    return res;
+  }
+  /// \brief Release storage obtained from allocate()
+  ///
+  /// \param ptr is the storage
+  /// \param size is the size given to \b operator \b delete
+  static void release(void *ptr,size_t size) {
+    if (ptr == (void *)0) return;
+    if (size != sizeof(T)) { ::operator delete(ptr); return; }
+    Chunk *chunk = (Chunk *)ptr;
+    chunk->next = local.head;
+    local.head = chunk;
+  }
+};
+
+/// \brief An STL allocator that draws single objects from an ObjectPool
+///
+/// Node based containers (std::set, std::map) allocate one node at a time, so every node
+/// is recycled through the ObjectPool for the node type. Requests for more than one
+/// object go to the heap.
+template<typename T>
+class PoolAllocator {
+public:
+  typedef T value_type;		///< The type of object allocated
+  PoolAllocator(void) {}	///< Constructor
+  template<typename U> PoolAllocator(const PoolAllocator<U> &op2) {}	///< Construct from an allocator for another type
+  /// \brief Allocate storage for \b n objects
+  T *allocate(size_t n) {
+    if (n == 1) return (T *)ObjectPool<T>::allocate(sizeof(T));
+    return (T *)::operator new(n * sizeof(T));
+  }
+  /// \brief Release storage obtained from allocate()
+  void deallocate(T *ptr,size_t n) {
+    if (n == 1) ObjectPool<T>::release(ptr,sizeof(T));
+    else ::operator delete(ptr);
+  }
+  template<typename U> bool operator==(const PoolAllocator<U> &op2) const { return true; }	///< All pool allocators are interchangeable
+  template<typename U> bool operator!=(const PoolAllocator<U> &op2) const { return false; }	///< All pool allocators are interchangeable
+};
+
+/// \brief A vector of trivially copyable elements, holding up to \b N of them inline
+///
+/// The first \b N elements live inside the object itself, so a container that stays small
+/// never touches the heap.  Growing past \b N moves the elements to heap storage, which is
+/// kept until the container is destroyed. Only the operations needed by PcodeOp are provided.
+template<typename T,int4 N>
+class SmallVector {
+  T *data;			///< Current storage (\b inlinedata or heap)
+  int4 count;			///< Number of elements
+  int4 cap;			///< Number of elements \b data can hold
+  T inlinedata[N];		///< Inline storage for small sizes
+  SmallVector(const SmallVector &op2);			///< Not implemented
+  SmallVector &operator=(const SmallVector &op2);	///< Not implemented
+  void grow(int4 num);		///< Make room for at least \b num elements
+public:
+  /// \brief Construct with the given number of value-initialized elements
+  explicit SmallVector(int4 sz=0) { data = inlinedata; count = 0; cap = N; resize(sz); }
+  ~SmallVector(void) { if (data != inlinedata) ::operator delete(data); }	///< Destructor
+  int4 size(void) const { return count; }		///< Get the number of elements
+  bool empty(void) const { return (count == 0); }	///< Return \b true if there are no elements
+  int4 capacity(void) const { return cap; }		///< Get the number of elements that fit without growing
+  bool isInline(void) const { return (data == inlinedata); }	///< Return \b true if no heap storage is in use
+  T &operator[](int4 i) { return data[i]; }		///< Get a reference to an element
+  const T &operator[](int4 i) const { return data[i]; }	///< Get a reference to an element
+  /// \brief Change the number of elements, value-initializing any new ones
+  void resize(int4 sz) {
+    if (sz > cap) grow(sz);
+    for(int4 i=count;i<sz;++i) data[i] = T();
+    count = sz; }
+  void push_back(const T &val) { if (count == cap) grow(count+1); data[count++] = val; }	///< Append an element
+  void pop_back(void) { count -= 1; }		///< Remove the last element
+};
+
+/// Capacity at least doubles, so a sequence of push_back() calls takes amortized constant time.
+/// \param num is the number of elements needed
+template<typename T,int4 N>
+void SmallVector<T,N>::grow(int4 num)
+
+{
+  int4 newcap = cap * 2;
+  if (newcap < num) newcap = num;
+  T *newdata = (T *)::operator new(newcap * sizeof(T));
+  for(int4 i=0;i<count;++i)
+    newdata[i] = data[i];
+  if (data != inlinedata)
+    ::operator delete(data);
+  data = newdata;
+  cap = newcap;
+}
+
+template<typename T>
+thread_local typename ObjectPool<T>::LocalList ObjectPool<T>::local;
+
+template<typename T>
+std::mutex ObjectPool<T>::sharedlock;
+
+template<typename T>
+typename ObjectPool<T>::Chunk *ObjectPool<T>::sharedhead = (typename ObjectPool<T>::Chunk *)0;
+
+template<typename T>
+ObjectPool<T>::LocalList::~LocalList(void)
+
+{
+  if (head == (Chunk *)0) return;
+  Chunk *tail = head;
+  while(tail->next != (Chunk *)0)
+    tail = tail->next;
+  std::lock_guard<std::mutex> lock(sharedlock);
+  tail->next = sharedhead;
+  sharedhead = head;
+  head = (Chunk *)0;
+}
+
+/// Take all chunks left behind by exited threads if there are any, otherwise carve up a new slab.
+template<typename T>
+void ObjectPool<T>::refill(void)
+
+{
+  {
+    std::lock_guard<std::mutex> lock(sharedlock);
+    if (sharedhead != (Chunk *)0) {
+      local.head = sharedhead;
+      sharedhead = (Chunk *)0;
+      return;
+    }
+  }
+  // The slab starts on a cache line, so objects whose size is a multiple of the line never straddle one
+  uint1 *slab = (uint1 *)SlabArena::allocate(chunksize * slabcount);
+  for(size_t i=0;i<slabcount;++i) {
+    Chunk *chunk = (Chunk *)(slab + i * chunksize);
+    chunk->next = local.head;
+    local.head = chunk;
+  }
+}
+
+} // namespace GhidraDec
+
+#endif
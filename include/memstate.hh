@@ -56,6 +56,7 @@ public:
   uintb getValue(uintb offset,int4 size) const; ///< Retrieve the value encoded in a (small) range of bytes
   void setChunk(uintb offset,int4 size,const uint1 *val); ///< Set values of an arbitrary sequence of bytes
   void getChunk(uintb offset,int4 size,uint1 *res) const; ///< Retrieve an arbitrary sequence of bytes
+  virtual MemoryBank *snapshot(void);	///< Create an independent copy of \b this bank
   static uintb constructValue(const uint1 *ptr,int4 size,bool bigendian); ///< Decode bytes to value
   static void deconstructValue(uint1 *ptr,uintb val,int4 size,bool bigendian); ///< Encode value to bytes
 };
@@ -100,6 +101,7 @@ protected:
   virtual void getPage(uintb addr,uint1 *res,int4 skip,int4 size) const; ///< Overridded getPage method
 public:
   MemoryImage(AddrSpace *spc,int4 ws,int4 ps,LoadImage *ld); ///< Constructor for a loadimage memorybank
+  virtual MemoryBank *snapshot(void);
 };
 
 /// \brief Memory bank that overlays some other memory bank, using a "copy on write" behavior.
@@ -108,17 +110,71 @@ public:
 /// a write. The underlying access routines are overridden to make optimal use
 /// of this page implementation.  The underlying memory bank can be a \b null pointer
 /// in which case, this memory bank behaves as if it were initially filled with zeros.
+///
+/// Pages are located through one of three kinds of table:
+///   - table_map is a binary tree keyed by page address
+///   - table_radix is a multi-level table indexed by successive bits of the page address
+///   - table_direct is a single array with an entry for every page in the space
+///
+/// A direct table is only used if the space is small enough, otherwise a radix table is used
+/// instead.  The last page looked up is remembered, so a run of accesses to the same page
+/// skips the table entirely.
+///
+/// Pages and table nodes are reference counted and can be shared with snapshots of the bank.
+/// Anything shared is copied just before it is written, so a snapshot costs O(1) with a radix or
+/// direct table (and a copy of the tree with \b table_map), and forks only pay for the pages
+/// they actually change.
 class MemoryPageOverlay : public MemoryBank {
+public:
+  /// \brief Kinds of table for locating pages
+  enum {
+    table_map = 0,		///< Binary tree keyed by page address
+    table_radix = 1,		///< Multi-level table indexed by the bits of the page address
+    table_direct = 2		///< Single array indexed by page number, for bounded spaces
+  };
+private:
+  static const int4 radixbits = 10;	///< Number of page address bits resolved at each level of a radix table
+  static const uintb directlimit = 0x40000;	///< Maximum number of pages for a direct table
+  /// \brief Reference counted storage that may be shared between snapshots
+  struct Shared {
+    int4 refs;			///< Number of tables referring to \b this
+  };
+  /// \brief A single page of bytes
+  struct Page : public Shared {
+    uint1 *data;		///< The bytes of the page
+  };
+  /// \brief A node of a radix table, or the array of a direct table
+  struct Node : public Shared {
+    vector<Shared *> slot;	///< Child nodes, or pages at the last level
+  };
   MemoryBank *underlie;		///< Underlying memory object
-  map<uintb,uint1 *> page;	///< Overlayed pages
+  int4 tabletype;		///< Kind of table locating the pages
+  int4 pageshift;		///< Number of bits in a page offset
+  int4 levels;			///< Number of levels in a radix table
+  int4 rootsize;		///< Number of entries in the root of the radix or direct table
+  map<uintb,Page *> page;	///< Overlayed pages, for \b table_map
+  Node *root;			///< Root of the radix or direct table (null until a page is created)
+  mutable bool lastvalid;	///< \b true if \b lastaddr and \b lastpage hold the last page looked up
+  mutable bool lastwritable;	///< \b true if the last page looked up is not shared
+  mutable uintb lastaddr;	///< Address of the last page looked up
+  mutable uint1 *lastpage;	///< The last page looked up (null if it doesn't exist)
+  Page *newPage(void) const;	///< Allocate an uninitialized page
+  Node *newNode(int4 size) const;	///< Allocate an empty table node
+  Node *copyNode(Node *node) const;	///< Replace a shared node with a private copy
+  static void releasePage(Page *pg);	///< Drop a reference to a page
+  static void releaseNode(Node *node,int4 depth);	///< Drop a reference to a node and its children
+  uint1 *findPage(uintb pageaddr) const;	///< Find the page at the given aligned address
+  uint1 *writePage(uintb pageaddr,bool &fresh);	///< Get a private copy of the page at the given aligned address
 protected:
   virtual void insert(uintb addr,uintb val); ///< Overridden aligned word insert
   virtual uintb find(uintb addr) const;	///< Overridden aligned word find
   virtual void getPage(uintb addr,uint1 *res,int4 skip,int4 size) const; ///< Overridden getPage
   virtual void setPage(uintb addr,const uint1 *val,int4 skip,int4 size); ///< Overridden setPage
 public:
-  MemoryPageOverlay(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul); ///< Constructor for page overlay
+  MemoryPageOverlay(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul,int4 tp=table_map); ///< Constructor for page overlay
   virtual ~MemoryPageOverlay(void);
+  int4 getTableType(void) const { return tabletype; }	///< Get the kind of table locating the pages
+  virtual MemoryBank *snapshot(void);
 };
 
 /// \brief A memory bank that implements reads and writes using a hash table.
@@ -137,9 +193,55 @@ protected:
   virtual uintb find(uintb addr) const;	///< Overridden aligned word find
 public:
   MemoryHashOverlay(AddrSpace *spc,int4 ws,int4 ps,int4 hashsize,MemoryBank *ul); ///< Constructor for hash overlay
+  virtual MemoryBank *snapshot(void);
+};
+
+/// \brief A memory bank holding a fixed range of a space as a single contiguous array
+///
+/// The bank covers offsets from 0 up to a fixed size, which is meant for a register space whose
+/// extent is known from the processor specification.  Every byte is held directly, so an access
+/// is a load or store at a fixed position in the array, with no table or hash lookup.  Bytes
+/// are initially zero.  Accessing an offset outside the range throws an exception.
+class MemoryArrayBank : public MemoryBank {
+  uintb size;			///< Number of bytes covered by the bank
+  uint1 *data;			///< The bytes of the bank
+protected:
+  virtual void insert(uintb addr,uintb val); ///< Overridden aligned word insert
+  virtual uintb find(uintb addr) const;	///< Overridden aligned word find
+  virtual void getPage(uintb addr,uint1 *res,int4 skip,int4 size) const; ///< Overridden getPage
+  virtual void setPage(uintb addr,const uint1 *val,int4 skip,int4 size); ///< Overridden setPage
+public:
+  MemoryArrayBank(AddrSpace *spc,int4 ws,int4 ps,uintb sz);	///< Constructor for an array bank
+  virtual ~MemoryArrayBank(void) { delete [] data; }
+  uintb getSize(void) const { return size; }			///< Get the number of bytes covered by the bank
+  uint1 *getPointer(uintb off,int4 sz);				///< Get a pointer to the bytes of a range
+  virtual MemoryBank *snapshot(void);
 };
 
 class Translate;		// Forward declaration
+class MemoryState;
+
+/// \brief A handle to a register that has been looked up in a MemoryState in advance
+///
+/// The handle is created by MemoryState::getRegisterHandle(), and holds the storage of the register
+/// along with the memory bank containing it.  If that bank is a MemoryArrayBank, the handle points
+/// directly at the register's bytes, and reading or writing it involves no lookup at all.
+/// A handle is only valid for the MemoryState it was created from, while the bank for the
+/// register's space stays the same.
+class RegisterHandle {
+  friend class MemoryState;
+  MemoryBank *bank;		///< Memory bank holding the register
+  uint1 *ptr;			///< Bytes of the register in a MemoryArrayBank, or null
+  uintb offset;			///< Offset of the register within its space
+  int4 size;			///< Number of bytes in the register
+  bool bigendian;		///< \b true if the register's bytes are in big endian order
+public:
+  RegisterHandle(void) { bank = (MemoryBank *)0; ptr = (uint1 *)0; offset = 0; size = 0; bigendian = false; }	///< Construct an unbound handle
+  bool isValid(void) const { return (bank != (MemoryBank *)0); }	///< Return \b true if \b this is bound to a register
+  bool isDirect(void) const { return (ptr != (uint1 *)0); }	///< Return \b true if the register is accessed directly
+  uintb getValue(void) const;		///< Get the value of the register
+  void setValue(uintb val);		///< Set the value of the register
+};
 
 /// \brief All storage/state for a pcode machine
 ///
@@ -149,17 +251,24 @@ class Translate;		// Forward declaration
 class MemoryState {
 protected:
   Translate *trans;		///< Architecture information about memory spaces
+  int4 pagetable;		///< Kind of page table for page overlays created by this state
   vector<MemoryBank *> memspace; ///< Memory banks associated with each address space
+  vector<MemoryBank *> owned;	///< Memory banks created by (and to be deleted with) this state
 public:
-  MemoryState(Translate *t);	///< A constructor for MemoryState
-  ~MemoryState(void) {}
+  MemoryState(Translate *t,int4 pt=MemoryPageOverlay::table_map);	///< A constructor for MemoryState
+  ~MemoryState(void);		///< Destructor
   Translate *getTranslate(void) const; ///< Get the Translate object
+  int4 getPageTable(void) const { return pagetable; }	///< Get the kind of page table for new page overlays
   void setMemoryBank(MemoryBank *bank);	///< Map a memory bank into the state
+  MemoryPageOverlay *createPageOverlay(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul);	///< Create and map a page overlay
+  MemoryArrayBank *createRegisterBank(AddrSpace *spc,int4 ws,int4 ps);	///< Create and map an array bank holding every register
+  MemoryState *snapshot(void);	///< Create a copy-on-write snapshot of \b this state
   MemoryBank *getMemoryBank(AddrSpace *spc) const; ///< Get a memory bank associated with a particular space
   void setValue(AddrSpace *spc,uintb off,int4 size,uintb cval); ///< Set a value on the memory state
   uintb getValue(AddrSpace *spc,uintb off,int4 size) const; ///< Retrieve a memory value from the memory state
   void setValue(const string &nm,uintb cval); ///< Set a value on a named register in the memory state
   uintb getValue(const string &nm) const; ///< Retrieve a value from a named register in the memory state
+  RegisterHandle getRegisterHandle(const string &nm) const;	///< Look up a named register for repeated access
   void setValue(const VarnodeData *vn,uintb cval); ///< Set value on a given \b varnode
   uintb getValue(const VarnodeData *vn) const; ///< Get a value from a \b varnode
   void getChunk(uint1 *res,AddrSpace *spc,uintb off,int4 size) const; ///< Get a chunk of data from memory state
@@ -169,10 +278,12 @@ public:
 /// The MemoryState needs a Translate object in order to be able to convert register names
 /// into varnodes
 /// \param t is the translator
-inline MemoryState::MemoryState(Translate *t)
+/// \param pt is the kind of page table used by page overlays created through createPageOverlay()
+inline MemoryState::MemoryState(Translate *t,int4 pt)
 
 {
   trans = t;
+  pagetable = pt;
 }
 
 /// Retrieve the actual pcode translator being used by this machine state
@@ -183,6 +294,29 @@ inline Translate *MemoryState::getTranslate(void) const
   return trans;
 }
 
+/// If the register is held in a MemoryArrayBank, its bytes are decoded directly,
+/// otherwise the read is forwarded to the memory bank.
+/// \return the value of the register
+inline uintb RegisterHandle::getValue(void) const
+
+{
+  if (ptr != (uint1 *)0)
+    return MemoryBank::constructValue(ptr,size,bigendian);
+  return bank->getValue(offset,size);
+}
+
+/// If the register is held in a MemoryArrayBank, its bytes are encoded directly,
+/// otherwise the write is forwarded to the memory bank.
+/// \param val is the value to write to the register
+inline void RegisterHandle::setValue(uintb val)
+
+{
+  if (ptr != (uint1 *)0)
+    MemoryBank::deconstructValue(ptr,val,size,bigendian);
+  else
+    bank->setValue(offset,size,val);
+}
+
 /// A convenience method for setting a value directly on a varnode rather than
 /// breaking out the components
 /// \param vn is a pointer to the varnode to be written
@@ -38,6 +38,9 @@ public:
   HighEdge(HighVariable *c,HighVariable *d) { a=c; b=d; } ///< Constructor
 };
 
+/// \brief A cache of intersection tests, whose nodes are recycled through an ObjectPool
+typedef map<HighEdge,bool,less<HighEdge>,PoolAllocator<pair<const HighEdge,bool> > > HighEdgeMap;
+
 /// \brief Helper class associating a Varnode with the block where it is defined
 ///
 /// This class explicitly stores a Varnode with the index of the BlockBasic that defines it.
@@ -81,7 +84,7 @@ class Funcdata;
 ///   - Merging Varnodes that hold the same data-type
 class Merge {
   Funcdata &data;		///< The function containing the Varnodes to be merged
-  map<HighEdge,bool> highedgemap; ///< A cache of intersection tests, sorted by HighVariable pair
+  HighEdgeMap highedgemap;	///< A cache of intersection tests, sorted by HighVariable pair
   bool updateHigh(HighVariable *a); ///< Make sure given HighVariable's Cover is up-to-date
   void purgeHigh(HighVariable *high); ///< Remove cached intersection tests for a given HighVariable
   bool blockIntersection(HighVariable *a,HighVariable *b,int4 blk);
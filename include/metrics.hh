@@ -0,0 +1,71 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file metrics.hh
+/// \brief Counts of the inner tests of the analysis, enabled at run-time
+#ifndef __CPUI_METRICS__
+#define __CPUI_METRICS__
+
+#include "types.h"
+
+#include <atomic>
+#include <ostream>
+
+namespace GhidraDec {
+
+/// \brief Counts of the inner tests made while decompiling a single function
+///
+/// Metrics are always compiled in.  When they are disabled, counting costs a single test of a
+/// static flag.  When enabled, each thread counts into its own running array.  A function's record
+/// notes the thread's counts as its analysis starts, with begin(), and keeps the difference when it
+/// finishes, with take() (see Funcdata::getMetrics()), so the analysis of a function nested inside
+/// another, as in jump-table recovery, is counted as part of the outer function too.  The counts of
+/// finished functions are also added to process-wide totals, which are reported alongside the
+/// Action statistics.
+class AnalysisMetrics {
+public:
+  /// \brief The kinds of test that are counted
+  enum kind {
+    cover_intersect = 0,	///< Intersections of one Cover with another (Cover::intersect)
+    merge_test = 1,		///< Intersection tests of two HighVariables (Merge::intersection)
+    cast_check = 2,		///< Checks of whether a cast is needed (CastStrategy::castStandard)
+    heritage_rename = 3,	///< Reads renamed to their reaching write during SSA construction
+    cast_memo_hit = 4,		///< Cast checks answered from the memo of earlier decisions (CastStrategyMemo)
+    kind_count = 5		///< Number of different kinds
+  };
+private:
+  uint8 counts[kind_count];			///< Counts for one function, indexed by kind
+  uint8 base[kind_count];			///< Counts of the thread when the analysis started
+  static bool enabled;				///< Set if tests are being counted
+  static thread_local uint8 current[kind_count];	///< Running counts of this thread
+  static std::atomic<uint8> totals[kind_count];	///< Counts summed over every finished function
+public:
+  AnalysisMetrics(void) { clear(); }				///< Construct an empty record
+  void clear(void) { for(int4 i=0;i<kind_count;++i) counts[i] = base[i] = 0; }	///< Set all counts to zero
+  uint8 get(kind k) const { return counts[k]; }			///< Get the count of the given kind
+  void begin(void);						///< Start counting for a new analysis on this thread
+  void take(bool addtotal);					///< Fill in \b this from the counts of the current thread
+  void print(std::ostream &s) const;				///< Print the counts, one kind per line
+  void saveXml(std::ostream &s) const;			///< Save the counts as a \<metrics> tag
+  static void count(kind k) { if (enabled) current[k] += 1; }	///< Count one test of the given kind
+  static void setEnabled(bool val) { enabled = val; }		///< Toggle counting
+  static bool isEnabled(void) { return enabled; }		///< Return \b true if tests are being counted
+  static void printTotalsCsv(std::ostream &s);			///< Print the process-wide totals as CSV records
+  static void resetTotals(void);				///< Set the process-wide totals to zero
+  static const char *getKindName(kind k);			///< Get the display name of the given kind
+};
+
+}
+#endif
@@ -40,6 +40,69 @@ public:
   virtual void restoreXml(const Element *el);
 };
 
+class PcodeOp;
+
+/// \brief Links of a PcodeOp within the op list of its basic block
+///
+/// Every PcodeOp is a node of this kind, and each PcodeOpList holds one as its sentinel, so
+/// an op is inserted into or removed from a basic block by relinking, without allocation.
+class PcodeOpLink {
+  friend class PcodeOpList;
+  friend class PcodeOpIter;
+  friend class PcodeOpConstIter;
+  PcodeOpLink *prev;		///< Previous node in the list (the sentinel before the first op)
+  PcodeOpLink *next;		///< Next node in the list (the sentinel after the last op)
+public:
+  PcodeOpLink(void) { prev = next = (PcodeOpLink *)0; }	///< Construct an unlinked node
+};
+
+/// \brief Bidirectional iterator over the ops of a PcodeOpList
+class PcodeOpIter {
+  friend class PcodeOpList;
+  friend class PcodeOpConstIter;
+  PcodeOpLink *node;		///< Current node
+public:
+  typedef std::bidirectional_iterator_tag iterator_category;	///< Iterator category
+  typedef PcodeOp *value_type;		///< Type of element
+  typedef ptrdiff_t difference_type;	///< Type of distance between iterators
+  typedef PcodeOp * const *pointer;	///< Pointer to element
+  typedef PcodeOp *reference;		///< Reference to element
+  PcodeOpIter(void) { node = (PcodeOpLink *)0; }	///< Construct a singular iterator
+  explicit PcodeOpIter(PcodeOpLink *n) { node = n; }	///< Construct an iterator at the given node
+  PcodeOp *operator*(void) const;	///< Get the op at the current position
+  PcodeOpIter &operator++(void) { node = node->next; return *this; }	///< Pre-increment
+  PcodeOpIter operator++(int) { PcodeOpIter tmp(*this); node = node->next; return tmp; }	///< Post-increment
+  PcodeOpIter &operator--(void) { node = node->prev; return *this; }	///< Pre-decrement
+  PcodeOpIter operator--(int) { PcodeOpIter tmp(*this); node = node->prev; return tmp; }	///< Post-decrement
+};
+
+/// \brief Bidirectional iterator over the ops of a const PcodeOpList
+class PcodeOpConstIter {
+  const PcodeOpLink *node;	///< Current node
+public:
+  typedef std::bidirectional_iterator_tag iterator_category;	///< Iterator category
+  typedef PcodeOp *value_type;		///< Type of element
+  typedef ptrdiff_t difference_type;	///< Type of distance between iterators
+  typedef PcodeOp * const *pointer;	///< Pointer to element
+  typedef PcodeOp *reference;		///< Reference to element
+  PcodeOpConstIter(void) { node = (const PcodeOpLink *)0; }	///< Construct a singular iterator
+  explicit PcodeOpConstIter(const PcodeOpLink *n) { node = n; }	///< Construct an iterator at the given node
+  PcodeOpConstIter(const PcodeOpIter &op2) { node = op2.node; }	///< Convert from a non-const iterator
+  PcodeOp *operator*(void) const;	///< Get the op at the current position
+  PcodeOpConstIter &operator++(void) { node = node->next; return *this; }	///< Pre-increment
+  PcodeOpConstIter operator++(int) { PcodeOpConstIter tmp(*this); node = node->next; return tmp; }	///< Post-increment
+  PcodeOpConstIter &operator--(void) { node = node->prev; return *this; }	///< Pre-decrement
+  PcodeOpConstIter operator--(int) { PcodeOpConstIter tmp(*this); node = node->prev; return tmp; }	///< Post-decrement
+  friend bool operator==(const PcodeOpConstIter &op1,const PcodeOpConstIter &op2);
+  friend bool operator!=(const PcodeOpConstIter &op1,const PcodeOpConstIter &op2);
+};
+
+/// Either iterator may be const or non-const
+inline bool operator==(const PcodeOpConstIter &op1,const PcodeOpConstIter &op2) { return (op1.node == op2.node); }
+
+/// Either iterator may be const or non-const
+inline bool operator!=(const PcodeOpConstIter &op1,const PcodeOpConstIter &op2) { return (op1.node != op2.node); }
+
 /// \brief Lowest level operation of the \b p-code language
 ///
 /// The philosophy here is to have only one version of any type of operation,
@@ -56,7 +119,7 @@ public:
 /// P-code can be either big or little endian, this is determined
 /// by the language being translated from
 
-class PcodeOp {
+class PcodeOp : public PcodeOpLink {
   friend class BlockBasic; // Just insert_before, insert_after, setOrder
   friend class Funcdata;
   friend class PcodeOpBank;
@@ -108,16 +171,17 @@ public:
     modified = 0x10		///< This op has been modified by the current action
   };
 private:
+  // The fields read by most rules (opcode, flags, output, and the first input) come first, so
+  // with the block links they fill the first cache line of the op (128 bytes in all on LP64)
   TypeOp *opcode;		///< Pointer to class providing behavioral details of the operation
   mutable uint4 flags;		///< Collection of boolean attributes on this op
   mutable uint4 addlflags;	///< Additional boolean attributes for this op
+  Varnode *output;		///< The one possible output Varnode of this op
+  SmallVector<Varnode *,3> inrefs;	///< The ordered list of input Varnodes for this op (inline up to 3)
   SeqNum start;	                ///< What instruction address is this attached to
   BlockBasic *parent;	        ///< Basic block in which this op is contained
-  list<PcodeOp *>::iterator basiciter;	///< Iterator within basic block
   list<PcodeOp *>::iterator insertiter;	///< Position in alive/dead list
   list<PcodeOp *>::iterator codeiter;	///< Position in opcode list
-  Varnode *output;		///< The one possible output Varnode of this op
-  std::vector<Varnode *> inrefs;	///< The ordered list of input Varnodes for this op
 
   // Only used by Funcdata
   void setOutput(Varnode *vn) { output = vn; } ///< Set the output Varnode of this op
@@ -133,11 +197,12 @@ private:
   void insertInput(int4 slot);	///< Make room for a new input Varnode at a specific position
   void setOrder(uintm ord) { start.setOrder(ord); } ///< Order this op within the ops for a single instruction
   void setParent(BlockBasic *p) { parent = p; }	///< Set the parent basic block of this op
-  void setBasicIter(list<PcodeOp *>::iterator iter) { basiciter = iter; } ///< Store the iterator into this op's basic block
 
 public:
   PcodeOp(int4 s,const SeqNum &sq); ///< Construct an unattached PcodeOp
   ~PcodeOp(void) {}		///< Destructor
+  static void *operator new(size_t size) { return ObjectPool<PcodeOp>::allocate(size); }	///< Allocate from the PcodeOp pool
+  static void operator delete(void *ptr,size_t size) { ObjectPool<PcodeOp>::release(ptr,size); }	///< Return storage to the PcodeOp pool
   int4 numInput(void) const { return inrefs.size(); } ///< Get the number of inputs to this op
   Varnode *getOut(void) { return output; } ///< Get the output Varnode of this op or \e null
   const Varnode *getOut(void) const { return (const Varnode *) output; } ///< Get the output Varnode of this op or \e null
@@ -149,7 +214,7 @@ public:
   uintm getTime(void) const { return start.getTime(); }	///< Get the time index indicating when this op was created
   const SeqNum &getSeqNum(void) const { return start; }	///< Get the sequence number associated with this op
   list<PcodeOp *>::iterator getInsertIter(void) const { return insertiter; } ///< Get position within alive/dead list
-  list<PcodeOp *>::iterator getBasicIter(void) const { return basiciter; } ///< Get position within basic block
+  PcodeOpIter getBasicIter(void) const { return PcodeOpIter((PcodeOpLink *)this); } ///< Get position within basic block
   /// \brief Get the slot number of the indicated input varnode
   int4 getSlot(const Varnode *vn) const { int4 i,n; n=inrefs.size(); for(i=0;i<n;++i) if (inrefs[i]==vn) break; return i; }
   /// \brief Get the evaluation type of this op
@@ -227,7 +292,63 @@ public:
 };
 
 /// A map from sequence number (SeqNum) to PcodeOp
-typedef map<SeqNum,PcodeOp *> PcodeOpTree;
+typedef map<SeqNum,PcodeOp *,less<SeqNum>,PoolAllocator<pair<const SeqNum,PcodeOp *> > > PcodeOpTree;
+
+/// \brief The ops in a single basic block, as an intrusive doubly-linked list
+///
+/// The list is threaded through the PcodeOpLink base of each PcodeOp, so an op can be in at
+/// most one PcodeOpList at a time.  The interface follows the subset of std::list used by
+/// BlockBasic; iterators remain valid until the op they point to is removed.
+class PcodeOpList {
+  PcodeOpLink head;		///< Sentinel node, before the first op and after the last
+  int4 count;			///< Number of ops in the list
+  PcodeOpList(const PcodeOpList &op2);			///< Not implemented
+  PcodeOpList &operator=(const PcodeOpList &op2);	///< Not implemented
+public:
+  typedef PcodeOpIter iterator;			///< Iterator over the ops
+  typedef PcodeOpConstIter const_iterator;	///< Iterator over the ops of a const list
+  PcodeOpList(void) { head.prev = head.next = &head; count = 0; }	///< Construct an empty list
+  iterator begin(void) { return iterator(head.next); }			///< Get iterator to the first op
+  iterator end(void) { return iterator(&head); }			///< Get iterator past the last op
+  const_iterator begin(void) const { return const_iterator(head.next); }	///< Get iterator to the first op
+  const_iterator end(void) const { return const_iterator(&head); }	///< Get iterator past the last op
+  bool empty(void) const { return (count == 0); }			///< Return \b true if there are no ops
+  int4 size(void) const { return count; }				///< Get the number of ops
+  PcodeOp *front(void) const { return (PcodeOp *)head.next; }		///< Get the first op
+  PcodeOp *back(void) const { return (PcodeOp *)head.prev; }		///< Get the last op
+  iterator insert(iterator pos,PcodeOp *op);	///< Insert an op before the given position
+  iterator erase(iterator pos);			///< Remove the op at the given position
+  void splice(iterator pos,PcodeOpList &op2,iterator first,iterator last);	///< Move a range of ops from another list
+};
+
+inline PcodeOp *PcodeOpIter::operator*(void) const { return (PcodeOp *)node; }
+
+inline PcodeOp *PcodeOpConstIter::operator*(void) const { return (PcodeOp *)node; }
+
+/// \param pos is the op to insert before (or end())
+/// \param op is the op to insert, which must not be in any list
+/// \return an iterator to the inserted op
+inline PcodeOpList::iterator PcodeOpList::insert(iterator pos,PcodeOp *op) {
+  PcodeOpLink *n = op;
+  n->next = pos.node;
+  n->prev = pos.node->prev;
+  n->prev->next = n;
+  pos.node->prev = n;
+  count += 1;
+  return iterator(n);
+}
+
+/// \param pos is the op to remove
+/// \return an iterator to the op after the removed one
+inline PcodeOpList::iterator PcodeOpList::erase(iterator pos) {
+  PcodeOpLink *n = pos.node;
+  PcodeOpLink *nxt = n->next;
+  n->prev->next = nxt;
+  nxt->prev = n->prev;
+  n->prev = n->next = (PcodeOpLink *)0;
+  count -= 1;
+  return iterator(nxt);
+}
 
 /// \brief Container class for PcodeOps associated with a single function
 ///
@@ -245,19 +366,29 @@ class PcodeOpBank {
   list<PcodeOp *> useroplist;		///< List of user-defined PcodeOps
   list<PcodeOp *> deadandgone;		///< List of retired PcodeOps
   uintm uniqid;				///< Counter for producing unique id's for each op
+  uint4 numreclaimed;			///< Number of retired PcodeOps returned to the pool
+  int4 reclaimmark;			///< Number of retired PcodeOps held after the last reclamation
   void addToCodeList(PcodeOp *op);	///< Add given PcodeOp to specific op-code list
   void removeFromCodeList(PcodeOp *op);	///< Remove given PcodeOp from specific op-code list
   void clearCodeLists(void);		///< Clear all op-code specific lists
 public:
   void clear(void);					///< Clear all PcodeOps from \b this container
-  PcodeOpBank(void) { uniqid = 0; }			///< Constructor
+  PcodeOpBank(void) { uniqid = 0; numreclaimed = 0; reclaimmark = 0; }	///< Constructor
   ~PcodeOpBank(void) { clear(); }			///< Destructor
   void setUniqId(uintm val) { uniqid = val; }		///< Set the unique id counter
   uintm getUniqId(void) const { return uniqid; }	///< Get the next unique id
+  uint8 memoryEstimate(void) const;			///< Estimate the bytes of heap used by \b this container
   PcodeOp *create(int4 inputs,const Address &pc);	///< Create a PcodeOp with at a given Address
   PcodeOp *create(int4 inputs,const SeqNum &sq);	///< Create a PcodeOp with a given sequence number
   void destroy(PcodeOp *op);				///< Destroy/retire the given PcodeOp
   void destroyDead(void);				///< Destroy/retire all PcodeOps in the \e dead list
+  int4 reclaimRetired(const vector<PcodeOp *> &keep);	///< Free retired PcodeOps that are not referenced
+  /// \brief Have enough PcodeOps been retired since the last reclamation to try another
+  bool needsReclaim(void) const { int4 num = deadandgone.size() - reclaimmark; return (num >= 1024 && num >= alivelist.size()); }
+  int4 numAlive(void) const { return alivelist.size(); }	///< Get the number of \e alive PcodeOps
+  int4 numDead(void) const { return deadlist.size(); }		///< Get the number of \e dead PcodeOps
+  int4 numRetired(void) const { return deadandgone.size(); }	///< Get the number of retired PcodeOps still held
+  uint4 numReclaimed(void) const { return numreclaimed; }	///< Get the number of retired PcodeOps freed
   void changeOpcode(PcodeOp *op,TypeOp *newopc);	///< Change the op-code for the given PcodeOp
   void markAlive(PcodeOp *op);				///< Mark the given PcodeOp as \e alive
   void markDead(PcodeOp *op);				///< Mark the given PcodeOp as \e dead
@@ -301,6 +432,7 @@ public:
 
 extern int4 functionalEqualityLevel(Varnode *vn1,Varnode *vn2,Varnode **res1,Varnode **res2);
 extern bool functionalEquality(Varnode *vn1,Varnode *vn2);
+extern uintm functionalEqualityHash(Varnode *vn);
 extern bool functionalDifference(Varnode *vn1,Varnode *vn2,int4 depth);
 
 }
@@ -151,6 +151,12 @@ public:
   virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
 };
 
+class OptionMaxLookahead : public ArchOption {
+public:
+  OptionMaxLookahead(void) { name = "maxlookahead"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
 class OptionIndentIncrement : public ArchOption {
 public:
   OptionIndentIncrement(void) { name = "indentincrement"; }	///< Constructor
@@ -205,6 +211,18 @@ public:
   virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
 };
 
+class OptionInstructionCache : public ArchOption {
+public:
+  OptionInstructionCache(void) { name = "instructioncache"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionDecodeProfile : public ArchOption {
+public:
+  OptionDecodeProfile(void) { name = "decodeprofile"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
 class OptionIgnoreUnimplemented : public ArchOption {
 public:
   OptionIgnoreUnimplemented(void) { name = "ignoreunimplemented"; }	///< Constructor
@@ -241,12 +259,108 @@ public:
   virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
 };
 
+class OptionIncremental : public ArchOption {
+public:
+  OptionIncremental(void) { name = "incremental"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionActionTiming : public ArchOption {
+public:
+  OptionActionTiming(void) { name = "actiontiming"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionMemoryStats : public ArchOption {
+public:
+  OptionMemoryStats(void) { name = "memorystats"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionMetrics : public ArchOption {
+public:
+  OptionMetrics(void) { name = "metrics"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionTracing : public ArchOption {
+public:
+  OptionTracing(void) { name = "tracing"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionWorkMarks : public ArchOption {
+public:
+  OptionWorkMarks(void) { name = "workmarks"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionDominators : public ArchOption {
+public:
+  OptionDominators(void) { name = "dominators"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionResultCache : public ArchOption {
+public:
+  OptionResultCache(void) { name = "resultcache"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
 class OptionJumpLoad : public ArchOption {
 public:
   OptionJumpLoad(void) { name = "jumpload"; }	///< Constructor
   virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
 };
 
+class OptionReleaseAnalysis : public ArchOption {
+public:
+  OptionReleaseAnalysis(void) { name = "releaseanalysis"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionBudget : public ArchOption {
+public:
+  OptionBudget(void) { name = "budget"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionPoolPartition : public ArchOption {
+public:
+  OptionPoolPartition(void) { name = "poolpartition"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionFlowBudget : public ArchOption {
+public:
+  OptionFlowBudget(void) { name = "flowbudget"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionHeritageThreads : public ArchOption {
+public:
+  OptionHeritageThreads(void) { name = "heritagethreads"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionProfileAction : public ArchOption {
+public:
+  OptionProfileAction(void) { name = "profileaction"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionSkipRule : public ArchOption {
+public:
+  OptionSkipRule(void) { name = "skiprule"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
+class OptionFlowSummary : public ArchOption {
+public:
+  OptionFlowSummary(void) { name = "flowsummary"; }	///< Constructor
+  virtual string apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const;
+};
+
 class OptionToggleRule : public ArchOption {
 public:
   OptionToggleRule(void) { name = "togglerule"; } ///< Constructor
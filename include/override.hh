@@ -74,6 +74,7 @@ public:
   void applyForceGoto(Funcdata &data) const;
   bool hasFlowOverride(void) const { return (!flowoverride.empty()); }	///< Are there any flow overrides
   uint4 getFlowOverride(const Address &addr) const;
+  void getFlowOverrides(const Address &start,const Address &stop,vector<pair<Address,uint4> > &res) const;
   void printRaw(ostream &s,Architecture *glb) const;
   void generateOverrideMessages(vector<string> &messagelist,Architecture *glb) const;
   void saveXml(ostream &s,Architecture *glb) const;
@@ -20,6 +20,7 @@
 #define __PARTMAP__
 
 #include <map>
+#include "flatindex.hh"
 
 namespace GhidraDec {
 
@@ -46,6 +47,11 @@ namespace GhidraDec {
 /// in the linear space. At each split point, the associated value object is split
 /// into two objects.  At any point the value object describing some part of the linear space
 /// can be changed.
+///
+/// Split points are kept in a std::map.  A map that is searched much more often than it is
+/// split (like the context and property maps, which are laid down when a program is loaded)
+/// is searched through a flatindex of its split points instead, which is built automatically
+/// and thrown away again when a split point is added or removed.
 template<typename _linetype,typename _valuetype>
 class partmap {
 public:
@@ -55,6 +61,8 @@ public:
 private:
   maptype database;						///< Map from linear split points to the value objects
   _valuetype defaultvalue;					///< The value object \e before the first split point
+  mutable flatindex<_linetype,iterator> flat;			///< Frozen search array over the split points
+  iterator upperBound(const _linetype &pnt) const;		///< Find the first split point after a point
 public:
   _valuetype &getValue(const _linetype &pnt);			///< Get the value object at a point
   const _valuetype &getValue(const _linetype &pnt) const;	///< Get the value object at a point
@@ -69,10 +77,37 @@ public:
   iterator end(void) { return database.end(); }				///< End of split points
   const_iterator begin(const _linetype &pnt) const { return database.lower_bound(pnt); }	///< Get first split point after given point
   iterator begin(const _linetype &pnt) { return database.lower_bound(pnt); }	///< Get first split point after given point
-  void clear(void) { database.clear(); }				///< Clear all split points
+  void clear(void) { flat.thaw(); database.clear(); }		///< Clear all split points
   bool empty(void) const { return database.empty(); }			///< Return \b true if there are no split points
 };
 
+/// This is the same as database.upper_bound(), but the search goes through the flatindex,
+/// building it first if the map has been searched often enough since it last changed.
+/// \param pnt is the given point in the linear space
+/// \return the first split point after the point, or the end of the map
+template<typename _linetype,typename _valuetype>
+  typename partmap<_linetype,_valuetype>::iterator partmap<_linetype,_valuetype>::
+  upperBound(const _linetype &pnt) const
+
+  {
+    maptype &db( const_cast<maptype &>(database) );
+    if (!flat.isFrozen()) {
+      if (!flat.probe(db.size()))
+	return db.upper_bound(pnt);
+      std::vector<_linetype> keys;
+      std::vector<iterator> pay;
+      keys.reserve(db.size());
+      pay.reserve(db.size()+1);
+      for(iterator iter=db.begin();iter!=db.end();++iter) {
+	keys.push_back((*iter).first);
+	pay.push_back(iter);
+      }
+      pay.push_back(db.end());
+      flat.freeze(keys,pay);
+    }
+    return flat.getPayload(flat.upperBound(pnt));
+  }
+
 /// Look up the first split point coming before the given point
 /// and return the value object it maps to. If there is no earlier split point
 /// return the default value.
@@ -85,7 +120,7 @@ template<typename _linetype,typename _valuetype>
   {
     iterator iter;
 
-    iter = database.upper_bound(pnt);
+    iter = upperBound(pnt);
     if (iter == database.begin())
       return defaultvalue;
     --iter;
@@ -104,7 +139,7 @@ template<typename _linetype,typename _valuetype>
   {
     const_iterator iter;
     
-    iter = database.upper_bound(pnt);
+    iter = upperBound(pnt);
     if (iter == database.begin())
       return defaultvalue;
     --iter;
@@ -126,10 +161,12 @@ template<typename _linetype,typename _valuetype>
       --iter;
       if ((*iter).first == pnt)	// point matches exactly
 	return (*iter).second;	// Return old ref
+      flat.thaw();
       _valuetype &newref( database[pnt] ); // Create new ref at point
       newref = (*iter).second;	// Copy of original partition value
       return newref;
     }
+    flat.thaw();
     _valuetype &newref( database[pnt] ); // Create new ref at point
     newref = defaultvalue;	// Copy of defaultvalue
     return newref;
@@ -152,6 +189,8 @@ template<typename _linetype,typename _valuetype>
     
     _valuetype &ref( (*beg).second );
     ++beg;
+    if (beg != end)
+      flat.thaw();
     database.erase(beg,end);
     return ref;
   }  
@@ -179,7 +218,7 @@ template<typename _linetype,typename _valuetype>
     }
     const_iterator iter,enditer;
     
-    enditer = database.upper_bound(pnt);
+    enditer = upperBound(pnt);
     if (enditer != database.begin()) {
       iter = enditer;
       --iter;
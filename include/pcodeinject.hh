@@ -72,6 +72,23 @@ public:
   virtual void saveXml(ostream &s) const=0;
 };
 
+/// \brief P-code produced by a payload, stored by the context it was produced for
+///
+/// A payload whose p-code is generated on demand (by a client, for instance) is expensive
+/// to inject. The same payload is frequently injected into the same context again: when
+/// analysis of a function restarts, when a function is decompiled more than once, or when a copy
+/// of a function is built to recover a jump-table.  This container records the p-code of each
+/// injection, keyed by a \e signature of the InjectContext, so that later injections with the
+/// same signature replay the recorded ops instead of generating them again.
+class InjectPcodeCache {
+  map<string,PcodeRun> runs;		///< Recorded p-code indexed by context signature
+public:
+  static string signature(const InjectContext &context);	///< Build the signature of an injection context
+  bool replay(const string &sig,PcodeEmit &emit);		///< Emit recorded p-code for the given signature
+  PcodeRun &record(const string &sig,const Address &addr);	///< Start recording p-code for the given signature
+  void clear(void) { runs.clear(); }				///< Throw away all recorded p-code
+};
+
 /// \brief An active container for a set of p-code operations that can be injected into data-flow
 ///
 /// This is an abstract base class. Derived classes manage details of how the p-code
@@ -116,6 +133,7 @@ public:
   virtual void inject(InjectContext &context,PcodeEmit &emit) const=0;
 
   virtual void restoreXml(const Element *el);		///< Restore \b this payload from an XML stream
+  virtual void clearCache(void) {}			///< Throw away any p-code saved from earlier injections
   virtual void printTemplate(ostream &s) const=0;	///< Print the p-code ops of the injection to a stream (for debugging)
   string getName(void) const { return name; }		///< Return the name of the injection
   int4 getType(void) const { return type; }		///< Return the type of injection (CALLFIXUP_TYPE, CALLOTHERFIXUP_TYPE, etc.)
@@ -204,6 +222,7 @@ public:
   string getCallOtherTarget(int4 injectid) const;		///< Get the callother-fixup name associated with an id
   string getCallMechanismName(int4 injectid) const;		///< Get the call mechanism name associated with an id
   int4 restoreXmlInject(const string &src,const string &nm,int4 tp,const Element *el);
+  void clearCache(void);					///< Throw away p-code saved by all payloads
 
   /// \brief A method for reading in p-code generated externally for use in debugging
   ///
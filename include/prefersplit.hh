@@ -41,6 +41,7 @@ class PreferSplitManager {
   };
   Funcdata *data;
   const vector<PreferSplitRecord> *records;
+  RangeList covered;		// Union of all record storage, for quickly rejecting varnodes no record applies to
   vector<PcodeOp *> tempsplits; // Copies of temporaries that need additional splitting
   void fillinInstance(SplitInstance *inst,bool bigendian,bool sethi,bool setlo);
   void createCopyOps(SplitInstance *ininst,SplitInstance *outinst,PcodeOp *op,bool istemp);
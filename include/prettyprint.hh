@@ -264,6 +264,86 @@ public:
   virtual bool emitsXml(void) const { return false; }
 };
 
+/// \brief A trivial emitter that collects syntax in a character buffer
+///
+/// This produces the same text as EmitNoXml, but tokens are appended to a growable buffer
+/// instead of going through the stream one at a time, and line breaks don't flush the stream.
+/// The buffer is written to the output stream with a single call by flush(), which the
+/// PrintLanguage calls at the end of every document, or when it grows past \b flushsize bytes.
+/// Clearing the emitter or changing its stream writes out any text still in the buffer, so
+/// the output is exactly what EmitNoXml would have produced.
+/// This is the back-end for bulk output of source code, where only the final text is needed.
+class EmitBuffer : public EmitNoXml {
+  enum { flushsize = 1 << 16 };		///< Buffer size at which text is written out early
+  string buffer;			///< Text not yet written to the stream
+  /// \brief Append characters to the buffer
+  void append(const char *str) {
+    buffer.append(str); if (buffer.size() >= flushsize) flush(); }
+public:
+  EmitBuffer(void) : EmitNoXml() {}	///< Constructor
+  virtual void tagLine(int4 indent) {
+    buffer += '\n'; buffer.append(indent,' '); if (buffer.size() >= flushsize) flush(); }
+  virtual void tagVariable(const char *ptr,syntax_highlight hl,
+			    const Varnode *vn,const PcodeOp *op) { append(ptr); }
+  virtual void tagOp(const char *ptr,syntax_highlight hl,const PcodeOp *op) { append(ptr); }
+  virtual void tagFuncName(const char *ptr,syntax_highlight hl,const Funcdata *fd,const PcodeOp *op) { append(ptr); }
+  virtual void tagType(const char *ptr,syntax_highlight hl,const Datatype *ct) { append(ptr); }
+  virtual void tagField(const char *ptr,syntax_highlight hl,const Datatype *ct,int4 off) { append(ptr); }
+  virtual void tagComment(const char *ptr,syntax_highlight hl,
+			   const AddrSpace *spc,uintb off) { append(ptr); }
+  virtual void tagLabel(const char *ptr,syntax_highlight hl,
+			 const AddrSpace *spc,uintb off) { append(ptr); }
+  virtual void print(const char *str,syntax_highlight hl=no_color) { append(str); }
+  virtual int4 openParen(char o,int4 id=0) {
+    buffer += o; parenlevel += 1; return id; }
+  virtual void closeParen(char c,int4 id) {
+    buffer += c; parenlevel -= 1; }
+  virtual void spaces(int4 num,int4 bump=0) { buffer.append(num,' '); }
+  virtual void clear(void) { flush(); EmitNoXml::clear(); }
+  virtual void setOutputStream(ostream *t) { flush(); s = t; }
+  virtual void flush(void);
+};
+
+/// \brief An emitter that marks up only the line structure of the source code
+///
+/// The output is a \<clang_document> with a \<function> (if one is being printed), like that
+/// of EmitXml, but the tokens on each line are collected into a single \<syntax> element, and
+/// the only other markup is the \<break> element between lines.  None of the references to
+/// variables, ops, and types, nor highlighting, are emitted, so a client gets the plain source
+/// code with its indenting but can't link tokens back to the syntax tree.  This is for clients
+/// that only render text, where the per-token markup would make up most of the document.
+class EmitLineXml : public EmitNoXml {
+  string line;				///< Text of the current line not yet written to the stream
+  void flushLine(void);			///< Write out the text of the current line as a \<syntax> element
+public:
+  EmitLineXml(void) : EmitNoXml() {}	///< Constructor
+  virtual int4 beginDocument(void);
+  virtual void endDocument(int4 id);
+  virtual int4 beginFunction(const Funcdata *fd);
+  virtual void endFunction(int4 id);
+  virtual void tagLine(int4 indent);
+  virtual void tagVariable(const char *ptr,syntax_highlight hl,
+			    const Varnode *vn,const PcodeOp *op) { line.append(ptr); }
+  virtual void tagOp(const char *ptr,syntax_highlight hl,const PcodeOp *op) { line.append(ptr); }
+  virtual void tagFuncName(const char *ptr,syntax_highlight hl,const Funcdata *fd,const PcodeOp *op) { line.append(ptr); }
+  virtual void tagType(const char *ptr,syntax_highlight hl,const Datatype *ct) { line.append(ptr); }
+  virtual void tagField(const char *ptr,syntax_highlight hl,const Datatype *ct,int4 off) { line.append(ptr); }
+  virtual void tagComment(const char *ptr,syntax_highlight hl,
+			   const AddrSpace *spc,uintb off) { line.append(ptr); }
+  virtual void tagLabel(const char *ptr,syntax_highlight hl,
+			 const AddrSpace *spc,uintb off) { line.append(ptr); }
+  virtual void print(const char *str,syntax_highlight hl=no_color) { line.append(str); }
+  virtual int4 openParen(char o,int4 id=0) {
+    line += o; parenlevel += 1; return id; }
+  virtual void closeParen(char c,int4 id) {
+    line += c; parenlevel -= 1; }
+  virtual void spaces(int4 num,int4 bump=0) { line.append(num,' '); }
+  virtual void clear(void) { line.clear(); EmitNoXml::clear(); }
+  virtual void setOutputStream(ostream *t) { flushLine(); s = t; }
+  virtual void flush(void) { flushLine(); }
+  virtual bool emitsXml(void) const { return true; }
+};
+
 /// \brief A token/command object in the pretty printing stream
 ///
 /// The pretty printing algorithm (see EmitPrettyPrint) works on the stream of
@@ -591,6 +671,9 @@ public:
   void setSize(int4 sz) { size = sz; }			///< Set the number of content characters
   printclass getClass(void) const { return delimtype; }	///< Get the print class of \b this
   tag_type getTag(void) const { return tagtype; }	///< Get \b this tag type
+  const string &getText(void) const { return tok; }	///< Get the characters of \b this token
+  void setText(const string &val) { tok = val; size = tok.size(); }	///< Replace the characters of a \e content token
+  const Symbol *getSymbol(void) const { return ptr_second.symbol; }	///< Get the Symbol of a variable declaration token
 #ifdef PRETTY_DEBUG
   int4 getCount(void) const { return count; }		///< Get the delimiter id
   void printDebug(ostream &s) const;			///< Print \b this token to stream for debugging
@@ -614,6 +697,7 @@ public:
   ~circularqueue(void);			///< Destructor
   void setMax(int4 sz);			///< Establish a new maximum queue size
   int4 getMax(void) const { return max; }	///< Get the maximum queue size
+  int4 size(void) const { return (right + 1 - left + max) % max; }	///< Get the number of objects in the queue
   void expand(int4 amount);		///< Expand the (maximum) size of the queue
   void clear(void) { left=1; right=0; }	///< Clear the queue
   bool empty(void) const { return (left == (right+1)%max); }	///< Is the queue empty
@@ -714,6 +798,9 @@ class EmitPrettyPrint : public EmitXml {
   string commentfill;		///< Used to fill comments if line breaks are forced
   circularqueue<int4> scanqueue; ///< References to current \e open and \e whitespace tokens
   circularqueue<TokenSplit> tokqueue;	///< The full stream of tokens
+  int4 maxlookahead;		///< Most tokens held before groups are forced to break (0 for no limit)
+  bool recording;		///< \b true if tokens are being copied to the recording
+  vector<TokenSplit> recorded;	///< Tokens recorded since the last call to startRecording()
   void expand(void);		///< Expand the stream buffer
   void checkstart(void);	///< Enforce whitespace for a \e start token
   void checkend(void);		///< Enforce whitespace for an \e end token
@@ -723,6 +810,7 @@ class EmitPrettyPrint : public EmitXml {
   void print(const TokenSplit &tok);	///< Output the given token to the low-level emitter
   void advanceleft(void);	///< Emit tokens that have been fully committed
   void scan(void);		///< Process a new token
+  void forceLookahead(void);	///< Force line breaks until the held tokens are within the lookahead
 public:
   EmitPrettyPrint(int4 mls);	///< Construct with an initial maximum line size
   virtual ~EmitPrettyPrint(void);
@@ -771,6 +859,16 @@ public:
   virtual void setCommentFill(const string &fill) { commentfill = fill; }
   virtual bool emitsXml(void) const { return lowlevel->emitsXml(); }
   void setXML(bool val);	///< Toggle whether the low-level emitter emits XML markup or not
+  void setBuffered(bool val);	///< Toggle whether the low-level emitter collects plain text in a buffer
+  void setLineXml(bool val);	///< Toggle whether XML markup is reduced to the line structure
+  void setMaxLookahead(int4 val);	///< Set the most tokens held while waiting for groups to close
+  int4 getMaxLookahead(void) const { return maxlookahead; }	///< Get the most tokens held (0 for no limit)
+  int4 getQueueCapacity(void) const { return tokqueue.getMax(); }	///< Get the number of tokens the queue has room for
+  void startRecording(void) { recorded.clear(); recording = true; }	///< Start copying tokens to the recording
+  void stopRecording(void) { recording = false; }	///< Stop copying tokens to the recording
+  void clearRecording(void) { recording = false; vector<TokenSplit>().swap(recorded); }	///< Throw away the recording
+  vector<TokenSplit> &getRecording(void) { return recorded; }	///< Get the recorded tokens
+  void replay(void);		///< Print the recorded tokens again
 };
 
 }
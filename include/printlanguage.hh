@@ -231,6 +231,15 @@ public:
       : name(nm) { type=t; highlight = hl; op = o; ptr_second.fd = f; }
   };
 private:
+  /// \brief A token of the retained stream that displays the name of a Symbol
+  struct RetainedName {
+    int4 index;				///< Index of the token within the recording
+    const Symbol *sym;			///< The Symbol being displayed
+    string text;			///< Characters of the token, ending with the name
+    string name;			///< Name of the Symbol when the token was emitted
+    Datatype *type;			///< Data-type of the Symbol when the token was emitted
+    uint4 format;			///< Display format of the Symbol when the token was emitted
+  };
   string name;				///< The name of the high-level language
   vector<uint4> modstack;		///< Printing modification stack
   vector<Scope *> scopestack;		///< The symbol scope stack
@@ -241,6 +250,11 @@ private:
   int4 line_commentindent;		///< Number of characters a comment line should be indented
   string commentstart;			///< Delimiter characters for the start of a comment
   string commentend;			///< Delimiter characters (if any) for the end of a comment
+  bool retaintokens;			///< \b true if the token stream of each function emitted should be kept
+  bool noting;				///< \b true if Symbol names are being noted for the current function
+  const Funcdata *retainfd;		///< Function whose token stream is kept (or null)
+  uint4 retainstamp;			///< Modification count of the function when its tokens were emitted
+  vector<RetainedName> retainnames;	///< Tokens of the kept stream that display Symbol names
 protected:
   Architecture *glb;			///< The Architecture owning the language emitter
   CastStrategy *castStrategy;		///< The strategy for emitting explicit \e case operations
@@ -268,6 +282,9 @@ protected:
 
   void emitOp(const ReversePolish &entry);				///< Send an operator token from the RPN to the emitter
   void emitAtom(const Atom &atom);					///< Send an variable token from the RPN to the emitter
+  void noteSymbolName(const Symbol *sym,const string &text);		///< Note a token that will display the name of a Symbol
+  void startRetainTokens(void);						///< Start keeping the tokens of a function being emitted
+  void finishRetainTokens(const Funcdata *fd);				///< Match noted Symbol names to the tokens that were kept
   static bool unicodeNeedsEscape(int4 codepoint);			///< Determine if the given codepoint needs to be escaped
   static void writeUtf8(ostream &s,int4 codepoint);			///< Write unicode character to stream in UTF8 encoding
   static int4 readUtf16(const uint1 *buf,bool bigend);			///< Read a 2-byte UTF16 element from a byte array
@@ -410,6 +427,7 @@ public:
   void setOutputStream(ostream *t) { emit->setOutputStream(t); }	///< Set the output stream to emit to
   void setScope(Scope *sc) { curscope = sc; }				///< Set the current Symbol scope
   void setMaxLineSize(int4 mls) { emit->setMaxLineSize(mls); }		///< Set the maximum number of characters per line
+  void setMaxLookahead(int4 val);					///< Set the most tokens held while waiting for groups to close
   void setIndentIncrement(int4 inc) { emit->setIndentIncrement(inc); }	///< Set the number of characters to indent per level of code nesting
   void setLineCommentIndent(int4 val);					///< Set the number of characters to indent comment lines
   void setCommentDelimeter(const string &start,const string &stop,
@@ -420,7 +438,12 @@ public:
   void setHeaderComment(uint4 val) { head_comment_type = val; }		///< Set the type of comments suitable for a function header
   bool emitsXml(void) const { return emit->emitsXml(); }		///< Does the low-level emitter, emit XML markup
   void setXML(bool val);						///< Set whether the low-level emitter, emits XML markup
+  void setBuffered(bool val);						///< Set whether the low-level emitter collects plain text in a buffer
+  void setLineXml(bool val);						///< Set whether XML markup is reduced to line structure
   void setFlat(bool val);						///< Set whether nesting code structure should be emitted
+  void setRetainTokens(bool val);					///< Set whether the token stream of each function emitted is kept
+  void dropRetainedTokens(void);					///< Throw away any kept token stream
+  bool redisplayFunction(const Funcdata *fd);				///< Emit a function again from its kept token stream
 
   virtual void adjustTypeOperators(void)=0;				///< Set basic data-type information for p-code operators
   virtual void clear(void);						///< Clear the RPN stack and the low-level emitter
@@ -42,6 +42,7 @@
 
 #include <set>
 #include <list>
+#include "flatindex.hh"
 
 namespace GhidraDec {
 template<typename _recordtype>
@@ -97,14 +98,21 @@ public:
   typedef PartIterator const_iterator;
 
 private:
+  typedef typename std::multiset<AddrRange>::const_iterator treeiter;
   std::multiset<AddrRange> tree;
   std::list<_recordtype> record;
+  // Once the tree has been searched often enough without changing, searches go
+  // through a frozen flat array of the last point of each partition instead
+  mutable flatindex<linetype,treeiter> flat;
 
   void zip(linetype i,typename std::multiset<AddrRange>::iterator iter);
   void unzip(linetype i,typename std::multiset<AddrRange>::iterator iter);
+  bool useFlat(void) const;
+  treeiter lowerBound(linetype point) const;
+  treeiter upperBound(linetype point) const;
 public:
   bool empty(void) const { return record.empty(); }
-  void clear(void) { tree.clear(); record.clear(); }
+  void clear(void) { flat.thaw(); tree.clear(); record.clear(); }
   typename std::list<_recordtype>::const_iterator begin_list(void) const { return record.begin(); }
   typename std::list<_recordtype>::const_iterator end_list(void) const { return record.end(); }
   typename std::list<_recordtype>::iterator begin_list(void) { return record.begin(); }
@@ -135,6 +143,46 @@ public:
   void erase(const_iterator iter) { erase( iter.getValueIter() ); }
 };
 
+template<typename _recordtype>
+bool rangemap<_recordtype>::useFlat(void) const
+
+{ // Decide whether searches should go through the flat index, building it if
+  // the tree has been searched as often as it has partitions since it last changed
+  if (flat.isFrozen()) return true;
+  if (!flat.probe(tree.size())) return false;
+  std::vector<linetype> keys;
+  std::vector<treeiter> pay;
+  keys.reserve(tree.size());
+  pay.reserve(tree.size()+1);
+  for(treeiter iter=tree.begin();iter!=tree.end();++iter) {
+    keys.push_back((*iter).last);
+    pay.push_back(iter);
+  }
+  pay.push_back(tree.end());
+  flat.freeze(keys,pay);
+  return true;
+}
+
+template<typename _recordtype>
+typename rangemap<_recordtype>::treeiter
+rangemap<_recordtype>::lowerBound(linetype point) const
+
+{ // First partition whose last point is at or after point
+  if (useFlat())
+    return flat.getPayload(flat.lowerBound(point));
+  return tree.lower_bound(AddrRange(point));
+}
+
+template<typename _recordtype>
+typename rangemap<_recordtype>::treeiter
+rangemap<_recordtype>::upperBound(linetype point) const
+
+{ // First partition whose last point is after point
+  if (useFlat())
+    return flat.getPayload(flat.upperBound(point));
+  return tree.upper_bound(AddrRange(point,subsorttype(true)));
+}
+
 template<typename _recordtype>
 void rangemap<_recordtype>::zip(linetype i,typename std::multiset<AddrRange>::iterator iter)
 
@@ -180,8 +228,23 @@ typename std::list<_recordtype>::iterator
 rangemap<_recordtype>::insert(const inittype &data,linetype a,linetype b)
 
 { // Insert a new record into the container at inclusive range [a,b]
-  linetype f=a;
+  flat.thaw();
   typename std::list<_recordtype>::iterator liter;
+  if (tree.empty() || (*tree.rbegin()).last < a) {
+    // Appending past every partition, as when inserting in address order: no search needed
+    record.push_back( _recordtype(a,b) );
+    record.back().initialize( data );
+    liter = record.end();
+    --liter;
+    AddrRange addrrange(b,(*liter).getSubsort());
+    addrrange.first = a;
+    addrrange.a = a;
+    addrrange.b = b;
+    addrrange.value = liter;
+    tree.insert(tree.end(),addrrange);
+    return liter;
+  }
+  linetype f=a;
   typename std::multiset<AddrRange>::iterator low = tree.lower_bound(AddrRange(f));
 
   if (low != tree.end()) {
@@ -238,6 +301,7 @@ template<typename _recordtype>
 void rangemap<_recordtype>::erase(typename std::list<_recordtype>::iterator v)
 
 {
+  flat.thaw();
   linetype a = (*v).getFirst();
   linetype b = (*v).getLast();
   bool leftsew = true;
@@ -287,16 +351,14 @@ std::pair<typename rangemap<_recordtype>::const_iterator,typename rangemap<_reco
 rangemap<_recordtype>::find(linetype point) const
 
 { // Get range of intervals which intersect point
-  AddrRange addrrange(point);
   typename std::multiset<AddrRange>::const_iterator iter1,iter2;
 
-  iter1 = tree.lower_bound(addrrange);
+  iter1 = lowerBound(point);
   // Check for no intersection
   if ((iter1==tree.end())||(point < (*iter1).first))
     return std::pair<PartIterator,PartIterator>(PartIterator(iter1),PartIterator(iter1));
 
-  AddrRange addrend((*iter1).last,subsorttype(true));
-  iter2 = tree.upper_bound(addrend);
+  iter2 = upperBound((*iter1).last);
     
   return std::pair<PartIterator,PartIterator>(PartIterator(iter1),PartIterator(iter2));
 }
@@ -306,9 +368,24 @@ std::pair<typename rangemap<_recordtype>::const_iterator,typename rangemap<_reco
 rangemap<_recordtype>::find(linetype point,const subsorttype &sub1,const subsorttype &sub2) const
 
 {
-  AddrRange addrrange(point,sub1);
   typename std::multiset<AddrRange>::const_iterator iter1,iter2;
 
+  if (useFlat()) {
+    // Partitions ending at the same point are sorted by subsort, so walk
+    // from the first partition ending at point to the subsort bounds
+    AddrRange addrrange(point,sub1);
+    iter1 = flat.getPayload(flat.lowerBound(point));
+    while((iter1!=tree.end())&&((*iter1).last==point)&&(*iter1 < addrrange))
+      ++iter1;
+    if ((iter1==tree.end())||(point < (*iter1).first))
+      return std::pair<PartIterator,PartIterator>(PartIterator(iter1),PartIterator(iter1));
+    AddrRange addrend((*iter1).last,sub2);
+    iter2 = flat.getPayload(flat.lowerBound((*iter1).last));
+    while((iter2!=tree.end())&&((*iter2).last==addrend.last)&&!(addrend < *iter2))
+      ++iter2;
+    return std::pair<PartIterator,PartIterator>(PartIterator(iter1),PartIterator(iter2));
+  }
+  AddrRange addrrange(point,sub1);
   iter1 = tree.lower_bound(addrrange);
   if ((iter1==tree.end())||(point < (*iter1).first))
     return std::pair<PartIterator,PartIterator>(PartIterator(iter1),PartIterator(iter1));
@@ -324,11 +401,10 @@ typename rangemap<_recordtype>::const_iterator
 rangemap<_recordtype>::find_lastbefore(linetype point) const
 
 {
-  AddrRange addrrange(point);
   typename std::multiset<AddrRange>::const_iterator iter;
   
   // First interval with last >= point
-  iter = tree.lower_bound(addrrange);
+  iter = lowerBound(point);
   if (iter==tree.begin())
     return tree.end();
   --iter;
@@ -340,10 +416,9 @@ typename rangemap<_recordtype>::const_iterator
 rangemap<_recordtype>::find_firstafter(linetype point) const
 
 {
-  AddrRange addrrange(point,subsorttype(true));
   typename std::multiset<AddrRange>::const_iterator iter;
 
-  iter = tree.upper_bound(addrrange);
+  iter = upperBound(point);
   while(iter != tree.end()) {
     if (point < (*iter).a)
       return iter;
@@ -357,11 +432,10 @@ typename rangemap<_recordtype>::const_iterator
 rangemap<_recordtype>::find_overlap(linetype point,linetype end) const
 
 {
-  AddrRange addrrange(point);
   typename std::multiset<AddrRange>::const_iterator iter;
 
   // First range where right boundary is equal to or past point
-  iter = tree.lower_bound(addrrange);
+  iter = lowerBound(point);
   if (iter==tree.end()) return iter;
   if (((*iter).first <= point)||((*iter).first<=end))
     return iter;
@@ -22,6 +22,8 @@
 
 namespace GhidraDec {
 
+class Funcdata;
+
 /// \brief A class for manipulating integer value ranges.
 ///
 /// The idea is to have a representation of common sets of
@@ -65,7 +67,10 @@ public:
   CircleRange(uintb mn,uintb mx,uintb m);	///< Construct given specific boundaries.
   CircleRange(bool val);			///< Construct a boolean range
   CircleRange(uintb val,int4 size);		///< Construct range with single value
+  void setFull(int4 size);			///< Set \b this to every value of the given size
   bool isEmpty(void) const { return isempty; }	///< Return \b true if \b this range is empty
+  bool isFull(void) const { return ((!isempty)&&(step==1)&&(left==right)); }	///< Return \b true if \b this contains all possible values
+  bool isSingle(void) const { return ((!isempty)&&(right==((left+step)&mask))); }	///< Return \b true if \b this contains a single value
   uintb getMin(void) const { return left; }	///< Get the left boundary of the range
   uintb getMax(void) const { return (right-step)&mask; }	///< Get the right-most integer contained in the range
   uintb getEnd(void) const { return right; }	///< Get the right boundary of the range
@@ -79,7 +84,44 @@ public:
   int4 circleUnion(const CircleRange &op2);	///< Union two ranges.
   void setStride(int4 newshift);		///< Set a new stride on \b this range.
   Varnode *pullBack(PcodeOp *op,Varnode **constMarkup,bool usenzmask);	///< Pull-back \b this range through given PcodeOp.
+  bool pushForwardUnary(OpCode opc,const CircleRange &in1,int4 inSize,int4 outSize);	///< Push-forward a range through a unary operation
+  bool pushForwardBinary(OpCode opc,const CircleRange &in1,const CircleRange &in2,int4 inSize,int4 outSize);	///< Push-forward ranges through a binary operation
   int4 translate2Op(OpCode &opc,uintb &c,int4 &cslot) const;	///< Translate range to a comparison op
+  void printRaw(ostream &s) const;		///< Write a text representation of \b this to stream
+};
+
+/// \brief Value ranges of every integer Varnode in a function
+///
+/// The ranges are calculated by a single forward pass over the data-flow graph, pushing the
+/// ranges of inputs through each PcodeOp (see CircleRange::pushForwardUnary() and
+/// CircleRange::pushForwardBinary()) until nothing changes.  Ops are revisited from a work-list only
+/// when the range of one of their inputs grows.  The ranges at a CPUI_MULTIEQUAL are the union
+/// of the ranges of its inputs, and to guarantee termination around loops, a CPUI_MULTIEQUAL whose
+/// range keeps growing is widened to all possible values.
+///
+/// The analysis is flow-insensitive: the range of a Varnode holds at every point it is read,
+/// so conditions guarding particular reads (as used by jump-table recovery) are not factored in.
+/// Results are kept until the function next changes (see Funcdata::getModificationCount()), so
+/// any number of queries between changes share one calculation.
+class ValueRangeCache {
+  /// \brief Calculation state of a single Varnode
+  struct Entry {
+    CircleRange range;		///< The current range
+    int4 updates;		///< Number of times the range has grown
+    Entry(void) { updates = 0; }	///< Constructor
+  };
+  static const int4 widenlimit = 3;	///< Number of times a CPUI_MULTIEQUAL can grow before it is widened
+  uint4 modcount;			///< Modification count of the function when \b ranges were calculated
+  bool valid;				///< \b true if \b ranges have been calculated
+  map<uint4,Entry> ranges;		///< Ranges indexed by Varnode creation index
+  static bool isTracked(const Varnode *vn);	///< Is a range calculated for the given Varnode
+  CircleRange inputRange(const Varnode *vn) const;	///< Get the current range of an input to an op
+  bool processOp(PcodeOp *op);		///< Recalculate the range of the output of one op
+  void calculate(Funcdata &fd);		///< Calculate the range of every Varnode in the function
+public:
+  ValueRangeCache(void) { modcount = 0; valid = false; }	///< Constructor
+  CircleRange getRange(Funcdata &fd,const Varnode *vn);	///< Get the range of values a Varnode can take
+  void clear(void) { ranges.clear(); valid = false; }	///< Throw away all calculated ranges
 };
 
 /// If two ranges are labeled [l , r) and  [op2.l, op2.r), the
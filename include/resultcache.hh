@@ -0,0 +1,182 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file resultcache.hh
+/// \brief A persistent cache of decompiler output, keyed by a hash of everything the output depends on
+#ifndef __CPUI_RESULTCACHE__
+#define __CPUI_RESULTCACHE__
+
+#include "funcdata.hh"
+
+#include <atomic>
+
+namespace GhidraDec {
+
+/// \brief A LoadImage wrapper that records every address range read through it
+///
+/// Constructing the recorder swaps it in as the Architecture's LoadImage, and destroying it
+/// puts the original back, so it can bracket a decompilation as a local variable.
+/// Every request is forwarded to the original image.
+class LoadImageRecorder : public LoadImage {
+  Architecture *glb;		///< The Architecture whose LoadImage is being wrapped
+  LoadImage *base;		///< The original LoadImage
+  RangeList reads;		///< Ranges of bytes read so far
+public:
+  LoadImageRecorder(Architecture *g);		///< Start recording reads for the given Architecture
+  virtual ~LoadImageRecorder(void);		///< Stop recording and restore the original LoadImage
+  const RangeList &getReads(void) const { return reads; }	///< Get the ranges of bytes read so far
+  virtual void loadFill(uint1 *ptr,int4 size,const Address &addr);
+  virtual const uint1 *peek(int4 size,const Address &addr);
+  virtual void openSymbols(void) const { base->openSymbols(); }
+  virtual void closeSymbols(void) const { base->closeSymbols(); }
+  virtual bool getNextSymbol(LoadImageFunc &record) const { return base->getNextSymbol(record); }
+  virtual void openSectionInfo(void) const { base->openSectionInfo(); }
+  virtual void closeSectionInfo(void) const { base->closeSectionInfo(); }
+  virtual bool getNextSection(LoadImageSection &sec) const { return base->getNextSection(sec); }
+  virtual void getReadonly(RangeList &list) const { base->getReadonly(list); }
+  virtual string getArchType(void) const { return base->getArchType(); }
+  virtual void adjustVma(long adjust) { base->adjustVma(adjust); }
+};
+
+/// \brief A stream buffer that passes output through to another stream while keeping a copy
+///
+/// Output written through it reaches the destination as it is produced, so a reader on the
+/// other end can start on it right away, and the copy collected along the way can be stored
+/// in the ResultCache once the output is complete.
+class OutputRecorder : public std::streambuf {
+  std::streambuf *dest;		///< The buffer of the destination stream
+  string copy;			///< Everything written so far
+protected:
+  virtual int_type overflow(int_type c);
+  virtual std::streamsize xsputn(const char *s,std::streamsize n);
+  virtual int sync(void) { return dest->pubsync(); }
+public:
+  OutputRecorder(ostream &s) { dest = s.rdbuf(); }	///< Construct given the destination stream
+  const string &getOutput(void) const { return copy; }	///< Get everything written so far
+};
+
+/// \brief Stored results in a memory mapped file that any number of processes can share
+///
+/// The file holds a header, a fixed array of hash buckets indexed by input key, and an
+/// append-only log of records.  Each record holds an input key, a full hash, the encoded address
+/// ranges the result depends on, and the output itself.  A writer reserves space in the log by
+/// atomically advancing its tail, fills in the record, and then publishes it by swapping it in
+/// as the head of its bucket's chain.  Readers walk a chain without taking any lock, and every
+/// record they can reach is complete, so a result stored by one process is visible to all the
+/// others as soon as its append returns.  Records are never removed; once the log is full, no
+/// more results are stored (until the file is deleted).
+class SharedResultStore {
+  /// \brief The start of the file
+  struct Header {
+    std::atomic<uint8> magic;		///< Identifies an initialized store (or one being initialized)
+    uint8 size;				///< Size of the file in bytes
+    uint8 numbuckets;			///< Number of hash buckets (a power of 2)
+    uint8 logstart;			///< Offset of the first record
+    std::atomic<uint8> tail;		///< Offset of the first free byte of the log
+  };
+  /// \brief A record in the log, followed by the encoded ranges and then the output
+  struct Record {
+    uint8 next;				///< Offset of the next record in the same bucket (0 for none)
+    uint8 key;				///< The input key
+    uint8 hash;				///< The full hash
+    uint4 rangesize;			///< Number of bytes of encoded ranges
+    uint4 outputsize;			///< Number of bytes of output
+  };
+  static const uint8 STORE_MAGIC;	///< Value of \b magic for an initialized store
+  static const uint8 STORE_BUSY;	///< Value of \b magic while a process initializes the store
+  string filename;			///< Path to the backing file
+  uint1 *base;				///< Start of the mapping
+  uint8 size;				///< Size of the mapping in bytes
+  Header *header;			///< The header at the start of the mapping
+  std::atomic<uint8> *buckets;		///< The bucket array, each holding the offset of its first record
+  const Record *getRecord(uint8 off) const { return (const Record *)(base + off); }	///< Get the record at an offset
+public:
+  SharedResultStore(const string &fname,uint8 sz);	///< Open (or create) the store in the given file
+  ~SharedResultStore(void);				///< Unmap the store
+  const string &getFileName(void) const { return filename; }	///< Get the path to the backing file
+  uint8 getUsed(void) const { return header->tail.load(); }	///< Get the number of bytes of the file in use
+  bool isFull(void) const { return (header->tail.load() >= size); }	///< Has the log run out of space
+  bool find(uint8 key,vector<uint8> &hashes,vector<string> &ranges) const;	///< Get the records for an input key
+  bool read(uint8 key,uint8 hash,string &output) const;	///< Get the output of a specific record
+  bool append(uint8 key,uint8 hash,const string &ranges,const string &output);	///< Add a record
+};
+
+/// \brief A cache of decompiler output for individual functions
+///
+/// Output is looked up in two steps.  The \e input \e key hashes everything known about a function
+/// before it is decompiled: its entry point, its prototype, its overrides, the context at its entry,
+/// the root Action and output language, and a \e configuration string from the caller.  Each input key has
+/// an index listing the results stored for it.  An index entry records the address ranges whose bytes
+/// the decompilation depended on (its code and any constant data it read) and the \e full \e hash,
+/// which adds the bytes in those ranges to the input key.  A result is reused only if re-hashing the
+/// ranges from the current LoadImage reproduces the full hash.
+///
+/// If a directory is given, each index is stored in a file \<input key>.idx and each result in a
+/// file \<full hash>.res within the directory, so results persist across sessions.  Otherwise
+/// results are kept in memory.  An in-memory cache can be given a limit on the bytes of output it
+/// holds, in which case the results stored longest ago are dropped to make room for new ones.
+/// Results can instead be kept in a SharedResultStore, where every decompiler process on the
+/// host that opens the same file sees them; its records are always read from the file, so
+/// entries added by other processes are found without any reload.
+class ResultCache {
+  /// \brief A single stored result for an input key
+  struct Entry {
+    uint8 hash;				///< The full hash of the inputs, including the bytes
+    RangeList ranges;			///< Ranges of bytes the result depends on
+  };
+  Architecture *glb;			///< The Architecture being decompiled
+  string directory;			///< Directory holding the cache files (empty for an in-memory cache)
+  SharedResultStore *shared;		///< Store shared with other processes (or null)
+  map<uint8,vector<Entry> > indices;	///< Index for each input key read or written so far
+  map<uint8,string> memresults;		///< Results for an in-memory cache
+  list<pair<uint8,uint8> > memorder;	///< (input key,full hash) of the in-memory results, oldest first
+  uint8 memused;			///< Bytes of output held by an in-memory cache
+  uint8 memlimit;			///< Most bytes of output an in-memory cache holds (0 for no limit)
+  int4 hits;				///< Number of successful lookups
+  int4 misses;				///< Number of failed lookups
+  static void hashBytes(uint8 &hash,const uint1 *ptr,int4 size);	///< Fold bytes into a hash
+  static void hashString(uint8 &hash,const string &str);		///< Fold a string into a hash
+  static string hexName(uint8 val);		///< Format a hash as a file name stem
+  string indexPath(uint8 key) const { return directory + '/' + hexName(key) + ".idx"; }	///< Path of an index file
+  string resultPath(uint8 hash) const { return directory + '/' + hexName(hash) + ".res"; }	///< Path of a result file
+  vector<Entry> &getIndex(uint8 key);		///< Get the index for an input key, reading it if necessary
+  bool hashRanges(uint8 key,const RangeList &ranges,uint8 &hash) const;	///< Fold the bytes in the given ranges into an input key
+  bool readResult(uint8 hash,string &output) const;	///< Read a stored result
+  static void encodeRanges(ostream &s,const RangeList &ranges);	///< Write ranges as text
+  bool decodeRanges(istream &s,RangeList &ranges) const;	///< Read ranges written by encodeRanges()
+  bool findShared(uint8 key,string &output);	///< Find a valid result in the shared store
+  bool find(uint8 key,string &output);		///< Find a valid stored result for an input key
+  void trimMemory(void);			///< Drop the oldest in-memory results until under the limit
+public:
+  ResultCache(Architecture *g,const string &dir);	///< Construct a cache for the given Architecture
+  ResultCache(Architecture *g,SharedResultStore *store);	///< Construct a cache backed by a shared store
+  ~ResultCache(void);				///< Destructor
+  const SharedResultStore *getShared(void) const { return shared; }	///< Get the shared store (or null)
+  const string &getDirectory(void) const { return directory; }	///< Get the directory holding the cache files
+  int4 getHits(void) const { return hits; }	///< Get the number of successful lookups
+  int4 getMisses(void) const { return misses; }	///< Get the number of failed lookups
+  uint8 getMemoryUsed(void) const { return memused; }	///< Get the bytes of output held in memory
+  void setMemoryLimit(uint8 limit) { memlimit = limit; trimMemory(); }	///< Set the most bytes of output held in memory
+  bool isFull(void) const;			///< Is the cache at its limit
+  static bool hashLoadImage(LoadImage *loader,const RangeList &ranges,uint8 &hash);	///< Fold the bytes in the given ranges into a hash
+  uint8 hashInputs(Funcdata *fd,const string &config) const;	///< Compute the input key for a function
+  bool lookup(uint8 key,string &output);	///< Look up a stored result for an input key
+  bool contains(uint8 key);			///< Check for a stored result without counting a lookup
+  void store(uint8 key,Funcdata *fd,const RangeList &reads,const string &output);	///< Store a result
+};
+
+} // namespace GhidraDec
+
+#endif
@@ -29,6 +29,8 @@
 
 namespace GhidraDec {
 
+class PcodeOpEdge;
+
 /// \brief Structure for sorting out pointer expression trees
 class AddTreeState {
 public:
@@ -61,6 +63,7 @@ public:
 class RuleCollectTerms : public Rule {
   static Varnode *getMultCoeff(Varnode *vn,uintb &coef);	///< Get the multiplicative coefficient
   static int4 doDistribute(Funcdata &data,PcodeOp *op);		///< Distribute coefficient within one term
+  static bool hasCollectable(const std::vector<PcodeOpEdge> &terms);	///< Check for terms that might be combined
 public:
   RuleCollectTerms(const std::string &g) : Rule(g, 0, "collect_terms") {}	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
@@ -82,7 +85,7 @@ public:
 };
 class RulePiece2Zext : public Rule {
 public:
-  RulePiece2Zext(const std::string &g) : Rule(g, 0, "piece2zext") {}	///< Constructor
+  RulePiece2Zext(const std::string &g) : Rule(g, 0, "piece2zext") { requireConstant(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RulePiece2Zext(getGroup());
@@ -112,7 +115,7 @@ public:
 };
 class RuleOrMask : public Rule {
 public:
-  RuleOrMask(const std::string &g) : Rule(g, 0, "ormask") {}	///< Constructor
+  RuleOrMask(const std::string &g) : Rule(g, 0, "ormask") { requireConstant(1); requireMaxOutputSize(sizeof(uintb)); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleOrMask(getGroup());
@@ -122,7 +125,7 @@ public:
 };
 class RuleAndMask : public Rule {
 public:
-  RuleAndMask(const std::string &g) : Rule(g, 0, "andmask") {}	///< Constructor
+  RuleAndMask(const std::string &g) : Rule(g, 0, "andmask") { requireMaxOutputSize(sizeof(uintb)); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleAndMask(getGroup());
@@ -132,7 +135,7 @@ public:
 };
 class RuleOrCollapse : public Rule {
 public:
-  RuleOrCollapse(const std::string &g) : Rule(g, 0, "orcollapse") {}	///< Constructor
+  RuleOrCollapse(const std::string &g) : Rule(g, 0, "orcollapse") { requireConstant(1); requireMaxOutputSize(sizeof(uintb)); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleOrCollapse(getGroup());
@@ -162,7 +165,7 @@ public:
 };
 class RuleShiftBitops : public Rule {
 public:
-  RuleShiftBitops(const std::string &g) : Rule(g, 0, "shiftbitops") {}	///< Constructor
+  RuleShiftBitops(const std::string &g) : Rule(g, 0, "shiftbitops") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleShiftBitops(getGroup());
@@ -203,7 +206,7 @@ public:
 };
 class RulePullsubMulti : public Rule {
 public:
-  RulePullsubMulti(const std::string &g) : Rule(g, 0, "pullsub_multi") {}	///< Constructor
+  RulePullsubMulti(const std::string &g) : Rule(g, 0, "pullsub_multi") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RulePullsubMulti(getGroup());
@@ -218,7 +221,7 @@ public:
 };
 class RulePullsubIndirect : public Rule {
 public:
-  RulePullsubIndirect(const std::string &g) : Rule(g, 0, "pullsub_indirect") {}	///< Constructor
+  RulePullsubIndirect(const std::string &g) : Rule(g, 0, "pullsub_indirect") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RulePullsubIndirect(getGroup());
@@ -249,7 +252,7 @@ public:
 };
 class RuleHighOrderAnd : public Rule {
 public:
-  RuleHighOrderAnd(const std::string &g) : Rule(g, 0, "highorderand") {}	///< Constructor
+  RuleHighOrderAnd(const std::string &g) : Rule(g, 0, "highorderand") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleHighOrderAnd(getGroup());
@@ -269,7 +272,7 @@ public:
 };
 class RuleLessOne : public Rule {
 public:
-  RuleLessOne(const std::string &g) : Rule(g, 0, "lessone") {}	///< Constructor
+  RuleLessOne(const std::string &g) : Rule(g, 0, "lessone") { requireConstant(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleLessOne(getGroup());
@@ -319,7 +322,7 @@ public:
 };  
 class RuleAndCompare : public Rule {
 public:
-  RuleAndCompare(const std::string &g) : Rule(g, 0, "andcompare") {}	///< Constructor
+  RuleAndCompare(const std::string &g) : Rule(g, 0, "andcompare") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleAndCompare(getGroup());
@@ -349,7 +352,7 @@ public:
 };
 class RuleConcatShift : public Rule {
 public:
-  RuleConcatShift(const std::string &g) : Rule(g, 0, "concatshift") {}	///< Constructor
+  RuleConcatShift(const std::string &g) : Rule(g, 0, "concatshift") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleConcatShift(getGroup());
@@ -359,7 +362,7 @@ public:
 };
 class RuleLeftRight : public Rule {
 public:
-  RuleLeftRight(const std::string &g) : Rule(g, 0, "leftright") {}	///< Constructor
+  RuleLeftRight(const std::string &g) : Rule(g, 0, "leftright") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleLeftRight(getGroup());
@@ -409,7 +412,7 @@ public:
 };
 class RuleTrivialArith : public Rule {
 public:
-  RuleTrivialArith(const std::string &g) : Rule(g, 0, "trivialarith") {}	///< Constructor
+  RuleTrivialArith(const std::string &g) : Rule(g, 0, "trivialarith") { setLocality(local_op); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleTrivialArith(getGroup());
@@ -419,7 +422,7 @@ public:
 };
 class RuleTrivialBool : public Rule {
 public:
-  RuleTrivialBool(const std::string &g) : Rule(g, 0, "trivialbool") {}	///< Constructor
+  RuleTrivialBool(const std::string &g) : Rule(g, 0, "trivialbool") { requireConstant(1); setLocality(local_op); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleTrivialBool(getGroup());
@@ -489,7 +492,7 @@ public:
 };
 class RuleLogic2Bool : public Rule {
 public:
-  RuleLogic2Bool(const std::string &g) : Rule(g, 0, "logic2bool") {}	///< Constructor
+  RuleLogic2Bool(const std::string &g) : Rule(g, 0, "logic2bool") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleLogic2Bool(getGroup());
@@ -529,7 +532,7 @@ public:
 };
 class RuleTrivialShift : public Rule {
 public:
-  RuleTrivialShift(const std::string &g) : Rule(g, 0, "trivialshift") {}	///< Constructor
+  RuleTrivialShift(const std::string &g) : Rule(g, 0, "trivialshift") { requireConstant(1); setLocality(local_op); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleTrivialShift(getGroup());
@@ -539,7 +542,7 @@ public:
 };
 class RuleIdentityEl : public Rule {
 public:
-  RuleIdentityEl(const std::string &g) : Rule(g, 0, "identityel") {}	///< Constructor
+  RuleIdentityEl(const std::string &g) : Rule(g, 0, "identityel") { requireConstant(1); setLocality(local_op); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleIdentityEl(getGroup());
@@ -569,7 +572,7 @@ public:
 };
 class RuleCollapseConstants : public Rule {
 public:
-  RuleCollapseConstants(const std::string &g) : Rule(g, 0, "collapseconstants") {}	///< Constructor
+  RuleCollapseConstants(const std::string &g) : Rule(g, 0, "collapseconstants") { setLocality(local_op); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleCollapseConstants(getGroup());
@@ -609,7 +612,7 @@ public:
 };
 class RuleCarryElim : public Rule {
 public:
-  RuleCarryElim(const std::string &g) : Rule(g, 0, "carryelim") {}	///< Constructor
+  RuleCarryElim(const std::string &g) : Rule(g, 0, "carryelim") { requireConstant(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleCarryElim(getGroup());
@@ -629,7 +632,7 @@ public:
 };
 class RuleXorCollapse : public Rule {
 public:
-  RuleXorCollapse(const std::string &g) : Rule(g, 0, "xorcollapse") {}	///< Constructor
+  RuleXorCollapse(const std::string &g) : Rule(g, 0, "xorcollapse") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleXorCollapse(getGroup());
@@ -744,7 +747,7 @@ public:
 };
 class RuleZextCommute : public Rule {
 public:
-  RuleZextCommute(const std::string &g) : Rule(g, 0, "zextcommute") {}	///< Constructor
+  RuleZextCommute(const std::string &g) : Rule(g, 0, "zextcommute") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleZextCommute(getGroup());
@@ -754,7 +757,7 @@ public:
 };
 class RuleZextShiftZext : public Rule {
 public:
-  RuleZextShiftZext(const std::string &g) : Rule(g, 0, "zextshiftzext") {}	///< Constructor
+  RuleZextShiftZext(const std::string &g) : Rule(g, 0, "zextshiftzext") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleZextShiftZext(getGroup());
@@ -764,7 +767,7 @@ public:
 };
 class RuleShiftAnd : public Rule {
 public:
-  RuleShiftAnd(const std::string &g) : Rule(g, 0, "shiftand") {}	///< Constructor
+  RuleShiftAnd(const std::string &g) : Rule(g, 0, "shiftand") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleShiftAnd(getGroup());
@@ -774,7 +777,7 @@ public:
 };
 class RuleConcatZero : public Rule {
 public:
-  RuleConcatZero(const std::string &g) : Rule(g, 0, "concatzero") {}	///< Constructor
+  RuleConcatZero(const std::string &g) : Rule(g, 0, "concatzero") { requireConstant(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleConcatZero(getGroup());
@@ -784,7 +787,7 @@ public:
 };
 class RuleConcatLeftShift : public Rule {
 public:
-  RuleConcatLeftShift(const std::string &g) : Rule(g, 0, "concatleftshift") {}	///< Constructor
+  RuleConcatLeftShift(const std::string &g) : Rule(g, 0, "concatleftshift") { requireWritten(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleConcatLeftShift(getGroup());
@@ -814,7 +817,7 @@ public:
 };
 class RuleShiftSub : public Rule {
 public:
-  RuleShiftSub(const std::string &g) : Rule(g, 0, "shiftsub") {}	///< Constructor
+  RuleShiftSub(const std::string &g) : Rule(g, 0, "shiftsub") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleShiftSub(getGroup());
@@ -935,7 +938,7 @@ public:
 };
 class RuleEqual2Constant : public Rule {
 public:
-  RuleEqual2Constant(const std::string &g) : Rule(g, 0, "equal2constant") {}	///< Constructor
+  RuleEqual2Constant(const std::string &g) : Rule(g, 0, "equal2constant") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleEqual2Constant(getGroup());
@@ -1011,7 +1014,7 @@ public:
 
 class RuleAddUnsigned : public Rule {
 public:
-  RuleAddUnsigned(const std::string &g) : Rule( g, 0, "addunsigned") {}	///< Constructor
+  RuleAddUnsigned(const std::string &g) : Rule( g, 0, "addunsigned") { requireConstant(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleAddUnsigned(getGroup());
@@ -1056,7 +1059,7 @@ public:
 
 class RuleSubNormal : public Rule {
 public:
-  RuleSubNormal(const std::string &g) : Rule( g, 0, "subnormal") {}	///< Constructor
+  RuleSubNormal(const std::string &g) : Rule( g, 0, "subnormal") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleSubNormal(getGroup());
@@ -1089,7 +1092,7 @@ public:
 
 class RuleDivTermAdd2 : public Rule {
 public:
-  RuleDivTermAdd2(const std::string &g) : Rule( g, 0, "divtermadd2") {}	///< Constructor
+  RuleDivTermAdd2(const std::string &g) : Rule( g, 0, "divtermadd2") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleDivTermAdd2(getGroup());
@@ -1113,7 +1116,7 @@ public:
 
 class RuleSignDiv2 : public Rule {
 public:
-  RuleSignDiv2(const std::string &g) : Rule( g, 0, "signdiv2") {}	///< Constructor
+  RuleSignDiv2(const std::string &g) : Rule( g, 0, "signdiv2") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleSignDiv2(getGroup());
@@ -1135,7 +1138,7 @@ public:
 
 class RuleSignNearMult : public Rule {
 public:
-  RuleSignNearMult(const std::string &g) : Rule( g, 0, "signnearmult") {}	///< Constructor
+  RuleSignNearMult(const std::string &g) : Rule( g, 0, "signnearmult") { requireConstant(1); requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleSignNearMult(getGroup());
@@ -1168,7 +1171,7 @@ public:
 
 class RuleSubvarAnd : public Rule {
 public:
-  RuleSubvarAnd(const std::string &g) : Rule( g, 0, "subvar_and") {}	///< Constructor
+  RuleSubvarAnd(const std::string &g) : Rule( g, 0, "subvar_and") { requireConstant(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleSubvarAnd(getGroup());
@@ -1218,7 +1221,7 @@ public:
 
 class RuleSubvarCompZero : public Rule {
 public:
-  RuleSubvarCompZero(const std::string &g) : Rule( g, 0, "subvar_compzero") {}	///< Constructor
+  RuleSubvarCompZero(const std::string &g) : Rule( g, 0, "subvar_compzero") { requireConstant(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleSubvarCompZero(getGroup());
@@ -1229,7 +1232,7 @@ public:
 
 class RuleSubvarShift : public Rule {
 public:
-  RuleSubvarShift(const std::string &g) : Rule( g, 0, "subvar_shift") {}	///< Constructor
+  RuleSubvarShift(const std::string &g) : Rule( g, 0, "subvar_shift") { requireConstant(1); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleSubvarShift(getGroup());
@@ -1252,7 +1255,7 @@ public:
 class RuleSubvarSext : public Rule {
   int4 isaggressive;			///< Is it guaranteed the root is a sub-variable needing to be trimmed
 public:
-  RuleSubvarSext(const std::string &g) : Rule( g, 0, "subvar_sext") { isaggressive = false; }	///< Constructor
+  RuleSubvarSext(const std::string &g) : Rule( g, 0, "subvar_sext") { isaggressive = false; setPrivateState(); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleSubvarSext(getGroup());
@@ -1275,7 +1278,7 @@ public:
 
 class RuleNegateNegate : public Rule {
 public:
-  RuleNegateNegate(const std::string &g) : Rule( g, 0, "negatenegate") {}	///< Constructor
+  RuleNegateNegate(const std::string &g) : Rule( g, 0, "negatenegate") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleNegateNegate(getGroup());
@@ -1314,7 +1317,7 @@ public:
 
 class RuleFloatCast : public Rule {
 public:
-  RuleFloatCast(const std::string &g) : Rule( g, 0, "floatcast") {}	///< Constructor
+  RuleFloatCast(const std::string &g) : Rule( g, 0, "floatcast") { requireWritten(0); }	///< Constructor
   virtual Rule *clone(const ActionGroupList &grouplist) const {
     if (!grouplist.contains(getGroup())) return (Rule *)0;
     return new RuleFloatCast(getGroup());
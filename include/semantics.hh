@@ -159,6 +159,8 @@ public:
   void restoreXml(const Element *el,const AddrSpaceManager *manage);
 };
 
+class CompiledConstructTpl;
+
 class ConstructTpl {
   friend class SleighCompile;
 protected:
@@ -166,15 +168,18 @@ protected:
   uint4 numlabels;		// Number of label templates
   vector<OpTpl *> vec;
   HandleTpl *result;
+  CompiledConstructTpl *compiled; // Flattened form for the builder (null if not compiled)
   void setOpvec(vector<OpTpl *> &opvec) { vec = opvec; }
   void setNumLabels(uint4 val) { numlabels = val; }
 public:
-  ConstructTpl(void) { delayslot=0; numlabels=0; result = (HandleTpl *)0; }
+  ConstructTpl(void) { delayslot=0; numlabels=0; result = (HandleTpl *)0; compiled = (CompiledConstructTpl *)0; }
   ~ConstructTpl(void);
   uint4 delaySlot(void) const { return delayslot; }
   uint4 numLabels(void) const { return numlabels; }
   const vector<OpTpl *> &getOpvec(void) const { return vec; }
   HandleTpl *getResult(void) const { return result; }
+  const CompiledConstructTpl *getCompiled(void) const { return compiled; }
+  void compile(AddrSpace *cspc,AddrSpace *uspc);
   bool addOp(OpTpl *ot);
   bool addOpList(const vector<OpTpl *> &oplist);
   void setResult(HandleTpl *t) { result = t; }
@@ -187,12 +192,67 @@ public:
   int4 restoreXml(const Element *el,const AddrSpaceManager *manage);
 };
 
+/// \brief A VarnodeTpl whose constant fields have been evaluated in advance
+///
+/// If the space, offset, and size are all constants, the final VarnodeData fields
+/// (with the offset masked or wrapped for its space) are stored directly, and only
+/// the unique offset of the instruction may still need to be added. Otherwise the
+/// original template is evaluated against the ParserWalker.
+struct CompiledVarnodeTpl {
+  enum {
+    fixed = 1,			///< Space, offset, and size are all stored directly
+    unique = 2,			///< Varnode is fixed in the unique space, the instruction's unique offset is added
+    maybe_dynamic = 4		///< Offset comes from a handle, so the varnode may need a LOAD or STORE
+  };
+  uint4 flags;			///< Properties of the varnode
+  uint4 size;			///< Size of a \e fixed varnode
+  AddrSpace *space;		///< Space of a \e fixed varnode
+  uintb offset;			///< Offset of a \e fixed varnode
+  const VarnodeTpl *tpl;	///< The original template
+};
+
+/// \brief An OpTpl flattened for the builder
+///
+/// Inputs and output refer to the varnode array of the CompiledConstructTpl.
+/// Directives (BUILD, DELAY_SLOT, LABELBUILD, CROSSBUILD) are kept as their opcode.
+struct CompiledOpTpl {
+  int4 opc;			///< OpCode or directive
+  int4 numinput;		///< Number of inputs
+  int4 firstinput;		///< Index of the first input varnode
+  int4 output;			///< Index of the output varnode, or -1
+  int4 arg;			///< Operand index of a BUILD, label index of a LABELBUILD
+  bool relative;		///< Set if the first input is relative to the label base
+  OpTpl *tpl;			///< The original op
+};
+
+/// \brief A ConstructTpl flattened into contiguous arrays, for fast instantiation
+///
+/// This is built once per template when a specification is loaded (see ConstructTpl::compile())
+/// and interpreted by SleighBuilder in a single loop. The exported handle of the
+/// template is also evaluated in advance, if it consists only of constants.
+class CompiledConstructTpl {
+  friend class ConstructTpl;
+  vector<CompiledOpTpl> ops;		///< The ops, in order
+  vector<CompiledVarnodeTpl> vars;	///< Inputs and outputs of all ops
+  uint4 numlabels;			///< Number of labels in the template
+  bool resultfixed;			///< Set if the exported handle is a constant
+  FixedHandle result;			///< The exported handle, if it is constant
+  void compileVarnode(const VarnodeTpl *vn,AddrSpace *cspc,AddrSpace *uspc);
+  void compileResult(const HandleTpl *hand);
+public:
+  const vector<CompiledOpTpl> &getOps(void) const { return ops; }	///< Get the flattened ops
+  const vector<CompiledVarnodeTpl> &getVars(void) const { return vars; }	///< Get the flattened varnodes
+  uint4 numLabels(void) const { return numlabels; }	///< Get the number of labels
+  bool isResultFixed(void) const { return resultfixed; }	///< Is the exported handle a constant
+  const FixedHandle &getResult(void) const { return result; }	///< Get the constant exported handle
+};
+
 class PcodeEmit;   // Forward declaration for emitter
 
 class PcodeBuilder { // SLEIGH specific pcode generator
+protected:
   uint4 labelbase;
   uint4 labelcount;
-protected:
   ParserWalker *walker;
   virtual void dump( OpTpl *op )=0;
 public:
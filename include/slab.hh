@@ -0,0 +1,46 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file slab.hh
+/// \brief A compact binary encoding of XML element trees, used for compiled SLEIGH files (.slab)
+///
+/// A \e .slab file holds exactly the same element tree as the corresponding \e .sla file, but
+/// stored as flat tables that refer to each other by index instead of as text.  Loading one
+/// requires no lexing, no entity decoding, and no grammar; the file is memory mapped and the
+/// Element tree is built directly from the tables.  The layout (all fields are little-endian uint4) is:
+///   - Header: magic \b SLAB, version, number of strings, elements, and attributes, string data size
+///   - String table: (offset,length) pairs into the string data
+///   - Element table: (name,content,first attribute,number of attributes,number of children,subtree size)
+///     records, in document (pre-)order
+///   - Attribute table: (name,value) string index pairs
+///   - String data: the raw bytes of every distinct string
+#ifndef __CPUI_SLAB__
+#define __CPUI_SLAB__
+
+#include "xml.hh"
+
+namespace GhidraDec {
+
+extern const std::string SLAB_EXTENSION;	///< File extension for binary compiled SLEIGH files
+
+extern void slab_write(std::ostream &s,const Element *el);	///< Encode an element tree in binary form
+extern Document *slab_tree(const uint1 *buf,uint4 size);	///< Decode a binary element tree from memory
+extern Document *slab_open(const std::string &filename);	///< Memory map a binary file and decode its tree
+extern bool slab_current(const std::string &slabfile,const std::string &xmlfile);	///< Is a binary file up to date
+extern bool slab_detect(const std::string &filename);		///< Does a file hold a binary element tree
+
+} // namespace GhidraDec
+
+#endif
@@ -18,6 +18,9 @@
 
 #include "sleighbase.hh"
 
+#include <atomic>
+#include <mutex>
+
 namespace GhidraDec {
 class LoadImage;
 
@@ -38,7 +41,7 @@ class PcodeCacher { // Cached chunk of pcode, prior to emitting
   VarnodeData *curpool;
   VarnodeData *endpool;
   vector<PcodeData> issued;
-  list<RelativeRecord> label_refs; // References to labels
+  vector<RelativeRecord> label_refs; // References to labels (storage is kept between instructions)
   vector<uintb> labels;		// Locations of labels
   VarnodeData *expandPool(uint4 size);
 public:
@@ -65,6 +68,46 @@ public:
   void clear(void);
   void resolveRelatives(void);
   void emit(const Address &addr,PcodeEmit *emt) const;
+  const vector<PcodeData> &getIssued(void) const { return issued; }	///< Get the p-code ops built so far
+};
+
+/// \brief A persistent cache of the p-code generated for individual instructions
+///
+/// Unlike DisassemblyCache, which only needs to cover the instructions involved in the current
+/// translation, entries here live until the cache fills up, so instructions shared by many
+/// functions are decoded only once.  Each entry remembers the context in effect at its address
+/// when it was decoded and is only used while that context is unchanged, so any change to the
+/// ContextDatabase at the address invalidates it.  The caller must not store instructions whose
+/// p-code depends on anything besides their own bytes and context (context commits, delay slots,
+/// crossbuilds).
+class InstructionCache {
+  /// \brief A single cached p-code op, referring to varnodes by index
+  struct CachedOp {
+    OpCode opc;			///< The op-code
+    int4 out;			///< Index of the output varnode (or -1 if there is no output)
+    int4 in;			///< Index of the first input varnode
+    int4 isize;			///< Number of input varnodes
+  };
+  /// \brief The translation of a single instruction
+  struct CachedInstruction {
+    vector<uintm> context;	///< Context at the instruction's address when it was decoded
+    int4 length;		///< Length of the instruction in bytes
+    vector<CachedOp> ops;	///< The p-code ops
+    vector<VarnodeData> varnodes;	///< Storage for all input and output varnodes
+  };
+  ContextCache *contextcache;	///< Source of context values
+  int4 contextsize;		///< Number of words in a context blob
+  uint4 maxsize;		///< Maximum number of instructions to hold before the cache is flushed
+  map<AddressKey,CachedInstruction> cache;	///< Cached instructions indexed by address
+  uintb hits;			///< Number of instructions served from the cache
+  uintb misses;			///< Number of instructions not found (or no longer valid) in the cache
+public:
+  InstructionCache(ContextCache *ccache,uint4 max);	///< Constructor
+  int4 emit(const Address &addr,PcodeEmit &emt);	///< Emit the cached p-code for an instruction, if valid
+  void store(const Address &addr,int4 length,const PcodeCacher &cacher);	///< Cache the p-code for an instruction
+  void clear(void) { cache.clear(); }			///< Remove all cached instructions
+  uintb getHits(void) const { return hits; }		///< Get the number of cache hits
+  uintb getMisses(void) const { return misses; }	///< Get the number of cache misses
 };
 
 class DisassemblyCache {
@@ -91,25 +134,91 @@ class SleighBuilder : public PcodeBuilder {
   uintb uniqueoffset;
   DisassemblyCache *discache;
   PcodeCacher *cache;
+  bool external;		///< Set if p-code from another instruction has been woven in
   void buildEmpty(Constructor *ct,int4 secnum);
+  void buildOperand(int4 index,int4 secnum);
   void generateLocation(const VarnodeTpl *vntpl,VarnodeData &vn);
+  void generateCompiled(const CompiledVarnodeTpl &cv,VarnodeData &vn);
   AddrSpace *generatePointer(const VarnodeTpl *vntpl,VarnodeData &vn);
+  void dynamicLoad(const VarnodeTpl *vn,VarnodeData *invar);
+  void dynamicStore(const VarnodeTpl *outvn,PcodeData *thisop);
+  void dumpCompiled(const CompiledOpTpl &op,const CompiledVarnodeTpl *vars);
   void setUniqueOffset(const Address &addr);
 public:
   SleighBuilder(ParserWalker *w,DisassemblyCache *dcache,PcodeCacher *pc,AddrSpace *cspc,AddrSpace *uspc,uint4 umask);
+  void buildCompiled(ConstructTpl *construct,int4 secnum);
   virtual void appendBuild(OpTpl *bld,int4 secnum);
   virtual void delaySlot(OpTpl *op);
   virtual void setLabel(OpTpl *op);
   virtual void appendCrossBuild(OpTpl *bld,int4 secnum);
+  bool hasExternal(void) const { return external; }	///< Has p-code from another instruction been woven in
+};
+
+/// \brief A text buffer for disassembly that keeps its storage from one instruction to the next
+///
+/// Printing an instruction to a fresh ostringstream allocates for the stream and its string every
+/// time.  This buffer is written through an ordinary ostream, and clear() empties the text without
+/// releasing its storage, so a listing of many instructions reuses the same memory.
+class ListingBuffer : public std::streambuf {
+  string text;				///< The text written since the last clear()
+protected:
+  virtual int_type overflow(int_type c);
+  virtual std::streamsize xsputn(const char *s,std::streamsize n);
+public:
+  ListingBuffer(void) { text.reserve(64); }	///< Constructor
+  void clear(void) { text.clear(); }		///< Empty the buffer, keeping its storage
+  const string &str(void) const { return text; }	///< Get the text written to the buffer
+};
+
+class Sleigh;
+
+/// \brief Mutable decoding state for one client of a Sleigh translator
+///
+/// The compiled specification (symbol table and decision trees) held by Sleigh is
+/// read-only after initialization.  Everything that changes while decoding an
+/// instruction lives here: the cache of context values, the window of ParserContext
+/// objects, and the p-code being built.  A Sleigh object owns one of these for general use,
+/// and each additional thread sharing the translator gets its own via Sleigh::attachThread().
+class SleighThreadState {
+  friend class Sleigh;
+  const Sleigh *owner;			///< The translator \b this state is attached to
+  ContextCache *cache;			///< Cache of context values for \b this thread
+  DisassemblyCache *discache;		///< Window of ParserContext objects for \b this thread
+  PcodeCacher pcode_cache;		///< Scratch space for p-code being built by \b this thread
+  InstructionCache *inscache;		///< Persistent p-code cache for \b this thread (may be null)
+  ListingBuffer mnembuffer;		///< Text of the mnemonic of the instruction being printed
+  ListingBuffer bodybuffer;		///< Text of the operands of the instruction being printed
+  ostream mnemstream;			///< Stream writing to \b mnembuffer
+  ostream bodystream;			///< Stream writing to \b bodybuffer
+  SleighThreadState *previous;		///< State that was attached to the thread before \b this
+  SleighThreadState(const Sleigh *trans,ContextDatabase *c_db);	///< Constructor
+  ~SleighThreadState(void);		///< Destructor
 };
 
 class Sleigh : public SleighBase {
   LoadImage *loader;
+  mutable std::mutex loadlock;		///< Serializes reads of the LoadImage by threads sharing the translator
   ContextDatabase *context_db;
-  ContextCache *cache;
-  mutable DisassemblyCache *discache;
-  mutable PcodeCacher pcode_cache;
+  SleighThreadState *mainstate;		///< State used by any thread that has not attached its own
+  uint4 parser_cachesize;		///< Number of ParserContext objects guaranteed not to be reused
+  uint4 parser_windowsize;		///< Size of the address window for the ParserContext hashtable
+  mutable uint4 inscache_size;		///< Maximum size of each persistent InstructionCache (0 = disabled)
+  mutable std::atomic<uintb> detached_hits;	///< InstructionCache hits from states that have been freed
+  mutable std::atomic<uintb> detached_misses;	///< InstructionCache misses from states that have been freed
+  mutable bool decodeprofiling;		///< Set if resolve() counts the Constructors it matches
+  mutable vector<int4> profileoffset;	///< Index of the first counter of each subtable, by symbol id (-1 if not a subtable)
+  mutable std::atomic<uint8> *profilecounts;	///< Match count of each Constructor (null until profiling is first enabled)
+  void countDecode(const Constructor *ct) const;	///< Count one match of the given Constructor
+  static thread_local SleighThreadState *threadstate;	///< State attached to the current thread (if any)
+  SleighThreadState *getState(void) const;	///< Get the decoding state for the calling thread
+  void buildDisassemblyCache(SleighThreadState *state) const;	///< Allocate the ParserContext window for a state
+  void buildInstructionCache(SleighThreadState *state) const;	///< Allocate (or free) the persistent p-code cache for a state
+  void releaseState(SleighThreadState *state) const;		///< Free a state, keeping its cache statistics
+  int4 translateInstruction(PcodeEmit &emit,const Address &baseaddr,bool &commits) const;	///< Translate one instruction, noting context changes
   void clearForDelete(void);
+  void compileTemplates(void);		///< Flatten the p-code templates of every Constructor
+  void emitAssembly(SleighThreadState *state,AssemblyEmit &emit,ParserContext *pos) const;	///< Print one decoded instruction
+  static bool scanFlow(const ConstructState *st,int4 &lastop,uint4 &flow);	///< Find flow properties from the templates of an instruction
 protected:
   ParserContext *obtainContext(const Address &addr,int4 state) const;
   void resolve(ParserContext &pos) const;
@@ -122,11 +231,38 @@ public:
   virtual void registerContext(const string &name,int4 sbit,int4 ebit);
   virtual void setContextDefault(const string &nm,uintm val);
   virtual void allowContextSet(bool val) const;
+  virtual void attachThread(void) const;
+  virtual void detachThread(void) const;
+  virtual void setInstructionCacheSize(int4 size) const;
+  virtual bool getInstructionCacheStats(uintb &hits,uintb &misses) const;
+  virtual bool setDecodeProfiling(bool val) const;
+  virtual bool saveDecodeProfile(ostream &s) const;
   virtual int4 instructionLength(const Address &baseaddr) const;
+  virtual int4 instructionFlow(const Address &baseaddr,uint4 &flow) const;
   virtual int4 oneInstruction(PcodeEmit &emit,const Address &baseaddr) const;
+  virtual int4 translateRun(PcodeRun &run,const Address &baseaddr,int4 maxbytes,int4 maxinsn) const;
   virtual int4 printAssembly(AssemblyEmit &emit,const Address &baseaddr) const;
+  virtual int4 printAssemblyRun(AssemblyEmit &emit,const Address &baseaddr,int4 maxbytes) const;
 };
 
+/// If the calling thread has attached its own state to \b this translator, return it.
+/// Otherwise return the translator's main state.
+/// \return the decoding state to use
+inline SleighThreadState *Sleigh::getState(void) const {
+  SleighThreadState *state = threadstate;
+  while(state != (SleighThreadState *)0) {
+    if (state->owner == this) return state;
+    state = state->previous;
+  }
+  return mainstate;
+}
+
+/// Counters are updated with relaxed atomics, so threads sharing the translator can all count.
+/// \param ct is the Constructor that was matched
+inline void Sleigh::countDecode(const Constructor *ct) const {
+  profilecounts[profileoffset[ct->getParent()->getId()] + ct->getId()].fetch_add(1,std::memory_order_relaxed);
+}
+
 /** \page sleigh SLEIGH
 
   \section sleightoc Table of Contents
@@ -22,6 +22,9 @@
 #include "filemanage.hh"
 #include "architecture.hh"
 #include "sleigh.hh"
+#include "inject_sleigh.hh"
+
+#include <mutex>
 
 namespace GhidraDec {
 /// \brief Contents of a \<compiler> tag in a .ldefs file
@@ -34,6 +37,7 @@ class CompilerTag {
 public:
   CompilerTag(void) {}	///< Constructor
   void restoreXml(const Element *el);	///< Restore the record from an XML stream
+  void saveXml(ostream &s) const;	///< Save the record as a \<compiler> tag
   const string &getName(void) const { return name; }	///< Get the human readable name of the spec
   const string &getSpec(void) const { return spec; }	///< Get the file-name
   const string &getId(void) const { return id; }	///< Get the string used as part of \e language \e id
@@ -63,6 +67,7 @@ class LanguageDescription {
 public:
   LanguageDescription(void) {}					///< Constructor
   void restoreXml(const Element *el);				///< Read the XML tag from stream
+  void saveXml(ostream &s) const;				///< Save the record as a \<language> tag
   const string &getProcessor(void) const { return processor; }	///< Get the name of the processor
   bool isBigEndian(void) const { return isbigendian; }		///< Return \b true if the processor is big-endian
   int4 getSize(void) const { return size; }			///< Get the size of the address bus
@@ -78,6 +83,62 @@ public:
   const TruncationTag &getTruncation(int4 i) const { return truncations[i]; }	///< Get the i-th truncation record
 };
 
+/// \brief A saved record of the SLEIGH directory scan and the .ldefs files it found
+///
+/// Scanning a Ghidra installation for language directories and parsing every .ldefs file
+/// touches much of the processor tree, which is slow on network file systems.  The index records
+/// the directories leading to each language directory, the language directories themselves, and
+/// the languages in each .ldefs file, with modification times.  At the next start, the index replaces the scan and the
+/// parsing if every recorded directory and file still has the same modification time.  Adding or
+/// removing an entry changes the modification time of the directory holding it.
+class SleighIndex {
+  /// \brief The .ldefs files of one language directory
+  struct LanguageDir {
+    time_t mtime;				///< Modification time of the directory
+    bool complete;				///< \b true if the .ldefs files have been recorded
+    vector<pair<string,time_t> > ldefs;		///< Each .ldefs file, with its modification time
+    vector<LanguageDescription> languages;	///< Languages from all the .ldefs files, in order
+    LanguageDir(void) { mtime = 0; complete = false; }	///< Constructor
+  };
+  string filename;				///< File holding the index (empty if there is no index)
+  string root;					///< Root path of the scan
+  vector<pair<string,time_t> > scanned;		///< Directories examined by the scan, with modification times
+  vector<string> dirorder;			///< Language directories, in search order
+  map<string,LanguageDir> languagedirs;		///< Language directories by path (ending in a separator)
+  bool dirty;					///< \b true if the index must be written out
+  bool restoreXml(const Element *el);		///< Restore the index from a \<sleighindex> tag
+  void saveXml(ostream &s) const;		///< Save the index as a \<sleighindex> tag
+  static bool isCurrent(const string &path,time_t mtime);	///< Does a file still have the given modification time
+public:
+  SleighIndex(void) { dirty = false; }	///< Constructor
+  void setFile(const string &nm) { filename = nm; }	///< Set the file holding the index
+  bool load(const string &rootpath);			///< Read the index and check the scan against the file system
+  const vector<string> &getLanguageDirs(void) const { return dirorder; }	///< Get the language directories found by the scan
+  void beginScan(const string &rootpath);		///< Start recording a new scan
+  void recordScanned(const string &dir);		///< Record a directory that the scan examined
+  void recordLanguageDir(const string &dir);		///< Record a language directory found by the scan
+  const vector<LanguageDescription> *findLanguages(const string &dir) const;	///< Get the recorded languages of a directory
+  bool isRecorded(const string &dir) const;		///< Is the given directory one found by the scan
+  void recordLanguages(const string &dir,const vector<string> &files,const vector<LanguageDescription> &langs);
+  void save(void);					///< Write out the index if it has changed
+};
+
+/// \brief An initialized SLEIGH translator, together with parsed specification files, for one language
+///
+/// Entries are held by SleighArchitecture in a process-wide cache, so that switching between
+/// languages does not require the .sla, .pspec, or .cspec files to be parsed again, or the
+/// p-code snippets they contain to be compiled again.  An entry is claimed by at most one live
+/// SleighArchitecture at a time; a second architecture for the same language gets its own entry.
+struct SleighCacheEntry {
+  string languageid;			///< The \e language \e id (without compiler) of the translator
+  Sleigh *sleigh;			///< The translator (null until it is first built)
+  map<string,Document *> specdocs;	///< Parsed .pspec and .cspec files, keyed by file name
+  SnippetCache snippets;		///< P-code snippets compiled for the translator
+  bool inuse;				///< Set while a SleighArchitecture holds \b this entry
+  SleighCacheEntry(const string &id) { languageid = id; sleigh = (Sleigh *)0; inuse = false; }	///< Constructor
+  void clear(void);			///< Free the translator and all parsed documents
+};
+
 /// \brief An Architecture that uses the decompiler's native SLEIGH translation engine
 ///
 /// Any Architecture derived from \b this knows how to natively read in:
@@ -87,15 +148,27 @@ public:
 ///
 /// Generally a \e language \e id (i.e. x86:LE:64:default) is provided, then this
 /// object is able to automatically load in configuration and construct the Translate object.
+///
+/// Translators are kept in a process-wide, least-recently-used cache keyed by \e language \e id
+/// (see setTranslatorCacheSize()). Each SleighArchitecture claims a cache entry for as long as
+/// it lives, and an unclaimed translator is reset and handed to the next SleighArchitecture using
+/// the same language.  The cache and the language list are guarded, so independent Architecture
+/// objects, for the same or different languages, can be built and used on separate threads.
 class SleighArchitecture : public Architecture {
-  static Sleigh *last_sleigh;				///< Last Translate object used by a SleighArchitecture
-  static int4 last_languageindex;			///< Index of the LanguageDescription associated with the last Translate object
+  static std::mutex cachelock;				///< Guard for the translator cache and the language list
+  static list<SleighCacheEntry> translatorcache;	///< Cached translators, most recently used first
+  static int4 translatorcachesize;			///< Maximum number of entries in the translator cache
   static vector<LanguageDescription> description;	///< List of languages we know about
+  static SleighIndex index;				///< Saved scan of the SLEIGH directories
   int4 languageindex;					///< Index (within LanguageDescription array) of the active language
   string filename;					///< Name of active load-image file
   string target;					///< The \e language \e id of the active load-image
+  SleighCacheEntry *cacheentry;				///< Cache entry claimed by \b this (or null)
   static void loadLanguageDescription(const string &specfile,ostream &errs);
-  bool isTranslateReused(void);				///< Test if last Translate object can be reused
+  static void trimTranslatorCache(int4 max);		///< Evict least recently used translators beyond a limit
+  SleighCacheEntry &obtainCacheEntry(void);		///< Claim the cache entry for the active language
+  void releaseCacheEntry(void);				///< Give up the claimed cache entry
+  const Element *openSpecFile(SleighCacheEntry &entry,const string &specfile);	///< Parse or recall a specification file
 protected:
   ostream *errorstream;					///< Error stream associated with \b this SleighArchitecture
   // buildLoader must be filled in by derived class
@@ -120,6 +193,9 @@ public:
   static string normalizeSize(const string &nm);		///< Try to recover a \e language \e id size field
   static string normalizeArchitecture(const string &nm);	///< Try to recover a \e language \e id string
   static void scanForSleighDirectories(const string &rootpath);
+  static void setIndexFile(const string &nm) { index.setFile(nm); }	///< Keep the scan of the SLEIGH directories in the given file
+  static void setTranslatorCacheSize(int4 max);			///< Set the maximum number of cached translators
+  static int4 getTranslatorCacheSize(void) { return translatorcachesize; }	///< Get the maximum number of cached translators
   static void shutdown(void);					///< Shutdown this SleighArchitecture and free all resources.
   static FileManage specpaths;					///< Known directories that contain .ldefs files.
 };
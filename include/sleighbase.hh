@@ -21,7 +21,18 @@
 #include "translate.hh"
 #include "slghsymbol.hh"
 
+#include <unordered_map>
+
 namespace GhidraDec {
+
+/// \brief Hash of a storage location, for looking up registers by their exact location
+struct VarnodeDataHash {
+  /// \brief Hash the space, offset, and size of the location
+  size_t operator()(const VarnodeData &vn) const {
+    return std::hash<uintb>()(vn.offset * 31 + vn.size) ^ ((size_t)vn.space->getIndex() << 24);
+  }
+};
+
 /// \brief Common core of classes that read or write SLEIGH specification files natively.
 ///
 /// This class represents what's in common across the SLEIGH infrastructure between:
@@ -30,6 +41,8 @@ namespace GhidraDec {
 class SleighBase : public Translate {
   vector<string> userop;		///< Names of user-define p-code ops for \b this Translate object
   map<VarnodeData,string> varnode_xref;	///< A map from Varnodes in the \e register space to register names
+  std::unordered_map<VarnodeData,const string *,VarnodeDataHash> register_exact;	///< Register names indexed by their exact location
+  std::unordered_map<string,const VarnodeData *> register_byname;	///< Register locations indexed by name
 protected:
   SubtableSymbol *root;		///< The root SLEIGH decoding symbol
   SymbolTable symtab;		///< The SLEIGH symbol table
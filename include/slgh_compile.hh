@@ -80,6 +80,10 @@ public:
 };
 
 class ConsistencyChecker {
+  enum {
+    pass_truncations = 0,	// Check/adjust the offset_plus templates
+    pass_optimize = 1		// Remove unnecessary temporaries
+  };
   struct OptimizeRecord {
     int4 writeop;
     int4 readop;
@@ -97,6 +101,8 @@ class ConsistencyChecker {
   int4 writenoread;
   bool printextwarning;
   bool printdeadwarning;
+  int4 numthreads;		// Number of threads used for the per-table passes
+  ostream *msgout;		// Stream receiving warnings and errors
   SubtableSymbol *root_symbol;
   vector<SubtableSymbol *> postorder;
   map<SubtableSymbol *,int4> sizemap; // Sizes associated with tables
@@ -113,6 +119,9 @@ class ConsistencyChecker {
   void dealWithUnnecessaryExt(OpTpl *op,Constructor *ct);
   void dealWithUnnecessaryTrunc(OpTpl *op,Constructor *ct);
   void setPostOrder(SubtableSymbol *root); // Establish table ordering
+  bool testTableTruncations(SubtableSymbol *sym,bool isbigendian);
+  void optimizeTable(SubtableSymbol *sym);
+  bool runPerTable(int4 pass,bool isbigendian);
 
   // Optimization routines
   static void examineVn(map<uintb,OptimizeRecord> &recs,const VarnodeTpl *vn,uint4 i,int4 inslot,int4 secnum);
@@ -126,6 +135,7 @@ class ConsistencyChecker {
   void optimize(Constructor *ct);
 public:
   ConsistencyChecker(SubtableSymbol *rt,bool unnecessary,bool warndead);
+  void setThreads(int4 val) { numthreads = val; }
   bool test(void);
   bool testTruncations(bool isbigendian);
   void optimizeAll(void);
@@ -198,9 +208,13 @@ private:
   bool lenientconflicterrors;	// True if we ignore most pattern conflict errors
   bool warnallnops;		// True if pcode NOPs generate individual warnings
   vector<string> noplist;	// List of individual NOP warnings
+  int4 numthreads;		// Number of threads used for decision trees and consistency checks
+  string profilefile;		// File holding decode counts to guide the decision trees (if not empty)
+  map<const Constructor *,uint8> profile;	// Decode count of each Constructor in the profile
   int4 errors;
   void predefinedSymbols(void);
   int4 calcContextVarLayout(int4 start,int4 sz,int4 numbits);
+  void loadDecodeProfile(void);
   void buildDecisionTrees(void);
   void buildPatterns(void);
   void checkConsistency(void);
@@ -226,6 +240,8 @@ public:
   void setEnforceLocalKeyWord(bool val) { pcode.setEnforceLocalKey(val); }
   void setLenientConflict(bool val) { lenientconflicterrors = val; }
   void setAllNopWarning(bool val) { warnallnops = val; }
+  void setThreads(int4 val) { numthreads = val; }
+  void setDecodeProfile(const string &nm) { profilefile = nm; }
   void process(void);
 
   // Lexer functions
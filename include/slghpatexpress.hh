@@ -55,14 +55,51 @@ public:
 };
 
 class PatternValue;
+class PatternExpression;
+
+struct PatternOp {		// One step of a compiled PatternExpression
+  enum {
+    push_constant,		// Push -val-
+    push_token,			// Push a field of the instruction bytes
+    push_context,		// Push a field of the context bytes
+    push_start,			// Push the address of the instruction
+    push_end,			// Push the address of the next instruction
+    push_tree,			// Push the value of -tree- as evaluated by getValue
+    op_plus, op_sub, op_mult, op_leftshift, op_rightshift, op_and, op_or, op_xor, op_div,
+    op_minus, op_not
+  };
+  int4 opcode;
+  bool bigendian;		// Byte order of the token
+  bool signbit;			// Sign extend (rather than zero extend) the field
+  int4 bytestart;		// First byte to read for the field
+  int4 numbytes;		// Number of bytes to read for the field
+  int4 shift;			// Amount to shift the bytes right to align the field
+  int4 extend;			// Amount to shift left and back right to extend the top bit of the field
+  intb val;			// Value of a constant
+  const PatternExpression *tree;	// Expression too complicated to compile
+  PatternOp(int4 opc) { opcode = opc; bigendian = false; signbit = false; bytestart = 0; numbytes = 0; shift = 0;
+    extend = 0; val = 0; tree = (const PatternExpression *)0; }
+};
+
+class PatternProgram {		// A PatternExpression compiled into a postfix program
+  static const int4 maxdepth = 16;	// Deepest evaluation stack a program can use
+  vector<PatternOp> code;
+  static intb readField(ParserWalker &walker,const PatternOp &op);
+public:
+  bool compile(const PatternExpression *exp);	// Compile an expression, returning false if it is too deep
+  intb evaluate(ParserWalker &walker) const;
+};
+
 class PatternExpression {
   int4 refcount;			// Number of objects referencing this
 				// for deletion
+  PatternProgram *program;		// Compiled form of this expression, if built
 protected:
-  virtual ~PatternExpression(void) {} // Only delete through release
+  virtual ~PatternExpression(void) { delete program; } // Only delete through release
 public:
-  PatternExpression(void) { refcount = 0; }
+  PatternExpression(void) { refcount = 0; program = (PatternProgram *)0; }
   virtual intb getValue(ParserWalker &walker) const=0;
+  virtual void compile(vector<PatternOp> &code) const;	// Append the postfix steps computing this value
   virtual TokenPattern genMinPattern(const vector<TokenPattern> &ops) const=0;
   virtual void listValues(vector<const PatternValue *> &list) const=0;
   virtual void getMinMax(vector<intb> &minlist,vector<intb> &maxlist) const=0;
@@ -73,6 +110,9 @@ public:
     int4 listpos = 0;
     return getSubValue(replace,listpos); }
   void layClaim(void) { refcount += 1; }
+  void buildProgram(void);		// Compile this expression for use by evaluate()
+  intb evaluate(ParserWalker &walker) const {	// Same as getValue, but using the compiled program if built
+    return (program != (PatternProgram *)0) ? program->evaluate(walker) : getValue(walker); }
   static void release(PatternExpression *p);
   static PatternExpression *restoreExpression(const Element *el,Translate *trans);
 };
@@ -99,6 +139,7 @@ public:
   TokenField(void) {}		// For use with restoreXml
   TokenField(Token *tk,bool s,int4 bstart,int4 bend);
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const;
   virtual TokenPattern genMinPattern(const vector<TokenPattern> &ops) const { return TokenPattern(tok); }
   virtual TokenPattern genPattern(intb val) const;
   virtual intb minValue(void) const { return 0; }
@@ -119,6 +160,7 @@ public:
   int4 getEndBit(void) const { return endbit; }
   bool getSignBit(void) const { return signbit; }
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const;
   virtual TokenPattern genMinPattern(const vector<TokenPattern> &ops) const { return TokenPattern(); }
   virtual TokenPattern genPattern(intb val) const;
   virtual intb minValue(void) const { return 0; }
@@ -133,6 +175,7 @@ public:
   ConstantValue(void) {}	// For use with restoreXml
   ConstantValue(intb v) { val = v; }
   virtual intb getValue(ParserWalker &walker) const { return val; }
+  virtual void compile(vector<PatternOp> &code) const { code.push_back(PatternOp(PatternOp::push_constant)); code.back().val = val; }
   virtual TokenPattern genMinPattern(const vector<TokenPattern> &ops) const { return TokenPattern(); }
   virtual TokenPattern genPattern(intb v) const { return TokenPattern(val==v); }
   virtual intb minValue(void) const { return val; }
@@ -146,6 +189,7 @@ public:
   StartInstructionValue(void) {}
   virtual intb getValue(ParserWalker &walker) const {
     return (intb)AddrSpace::byteToAddress(walker.getAddr().getOffset(),walker.getAddr().getSpace()->getWordSize()); }
+  virtual void compile(vector<PatternOp> &code) const { code.push_back(PatternOp(PatternOp::push_start)); }
   virtual TokenPattern genMinPattern(const vector<TokenPattern> &ops) const { return TokenPattern(); }
   virtual TokenPattern genPattern(intb val) const { return TokenPattern(); }
   virtual intb minValue(void) const { return (intb)0; }
@@ -159,6 +203,7 @@ public:
   EndInstructionValue(void) {}
   virtual intb getValue(ParserWalker &walker) const {
     return (intb)AddrSpace::byteToAddress(walker.getNaddr().getOffset(),walker.getNaddr().getSpace()->getWordSize()); }
+  virtual void compile(vector<PatternOp> &code) const { code.push_back(PatternOp(PatternOp::push_end)); }
   virtual TokenPattern genMinPattern(const vector<TokenPattern> &ops) const { return TokenPattern(); }
   virtual TokenPattern genPattern(intb val) const { return TokenPattern(); }
   virtual intb minValue(void) const { return (intb)0; }
@@ -192,6 +237,8 @@ class BinaryExpression : public PatternExpression {
   PatternExpression *left,*right;
 protected:
   virtual ~BinaryExpression(void);
+  void compileBinary(vector<PatternOp> &code,int4 opc) const {
+    left->compile(code); right->compile(code); code.push_back(PatternOp(opc)); }
 public:
   BinaryExpression(void) { left = (PatternExpression *)0; right = (PatternExpression *)0; } // For use with restoreXml
   BinaryExpression(PatternExpression *l,PatternExpression *r);
@@ -210,6 +257,8 @@ class UnaryExpression : public PatternExpression {
   PatternExpression *unary;
 protected:
   virtual ~UnaryExpression(void);
+  void compileUnary(vector<PatternOp> &code,int4 opc) const {
+    unary->compile(code); code.push_back(PatternOp(opc)); }
 public:
   UnaryExpression(void) { unary = (PatternExpression *)0; } // For use with restoreXml
   UnaryExpression(PatternExpression *u);
@@ -229,6 +278,7 @@ public:
   PlusExpression(void) {}	// For use by restoreXml
   PlusExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_plus); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -238,6 +288,7 @@ public:
   SubExpression(void) {}	// For use with restoreXml
   SubExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_sub); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -247,6 +298,7 @@ public:
   MultExpression(void) {}	// For use with restoreXml
   MultExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_mult); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -256,6 +308,7 @@ public:
   LeftShiftExpression(void) {}
   LeftShiftExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_leftshift); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -265,6 +318,7 @@ public:
   RightShiftExpression(void) {}
   RightShiftExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_rightshift); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -274,6 +328,7 @@ public:
   AndExpression(void) {}
   AndExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_and); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -283,6 +338,7 @@ public:
   OrExpression(void) {}
   OrExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_or); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -292,6 +348,7 @@ public:
   XorExpression(void) {}
   XorExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_xor); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -301,6 +358,7 @@ public:
   DivExpression(void) {}
   DivExpression(PatternExpression *l,PatternExpression *r) : BinaryExpression(l,r) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileBinary(code,PatternOp::op_div); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };
@@ -310,6 +368,7 @@ public:
   MinusExpression(void) {}
   MinusExpression(PatternExpression *u) : UnaryExpression(u) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileUnary(code,PatternOp::op_minus); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };  
@@ -319,6 +378,7 @@ public:
   NotExpression(void) {}
   NotExpression(PatternExpression *u) : UnaryExpression(u) {}
   virtual intb getValue(ParserWalker &walker) const;
+  virtual void compile(vector<PatternOp> &code) const { compileUnary(code,PatternOp::op_not); }
   virtual intb getSubValue(const vector<intb> &replace,int4 &listpos) const;
   virtual void saveXml(ostream &s) const;
 };  
@@ -45,6 +45,7 @@ public:
   bool alwaysFalse(void) const { return (nonzerosize==-1); }
   bool isInstructionMatch(ParserWalker &walker) const;
   bool isContextMatch(ParserWalker &walker) const;
+  void packWords(uintm *mask,uintm *val,int4 numwords) const;
   void saveXml(ostream &s) const;
   void restoreXml(const Element *el);
 };
@@ -76,6 +77,7 @@ public:
   uintm getMask(int4 startbit,int4 size,bool context) const;
   uintm getValue(int4 startbit,int4 size,bool context) const;
   int4 getLength(bool context) const;
+  void packWords(uintm *mask,uintm *val,int4 numwords,bool context) const;
   bool specializes(const DisjointPattern *op2) const;
   bool identical(const DisjointPattern *op2) const;
   bool resolvesIntersect(const DisjointPattern *op1,const DisjointPattern *op2) const;
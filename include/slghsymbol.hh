@@ -91,6 +91,7 @@ public:
   SleighSymbol *findSymbol(const string &nm,int4 skip) const { return findSymbolInternal(skipScope(skip),nm); }
   SleighSymbol *findGlobalSymbol(const string &nm) const { return findSymbolInternal(table[0],nm); }
   SleighSymbol *findSymbol(uintm id) const { return symbollist[id]; }
+  int4 numSymbols(void) const { return symbollist.size(); }
   void replaceSymbol(SleighSymbol *a,SleighSymbol *b);
   void saveXml(ostream &s) const;
   void restoreXml(const Element *el,SleighBase *trans);
@@ -525,7 +526,11 @@ public:
 class DecisionProperties {
   vector<string> identerrors;
   vector<string> conflicterrors;
+  const map<const Constructor *,uint8> *profile; // Decode counts of Constructors (null if none)
 public:
+  DecisionProperties(void) { profile = (const map<const Constructor *,uint8> *)0; }
+  void setProfile(const map<const Constructor *,uint8> *prof) { profile = prof; }
+  double getWeight(const Constructor *ct) const;
   void identicalPattern(Constructor *a,Constructor *b);
   void conflictingPattern(Constructor *a,Constructor *b);
   const vector<string> &getIdentErrors(void) const { return identerrors; }
@@ -539,8 +544,13 @@ class DecisionNode {
   bool contextdecision;		// True if this is decision based on context
   int4 startbit,bitsize;        // Bits in the stream on which to base the decision
   DecisionNode *parent;
-  void chooseOptimalField(void);
-  double getScore(int4 low,int4 size,bool context);
+  int4 instrwords;		// Instruction words in each packed pattern
+  int4 contextwords;		// Context words in each packed pattern
+  vector<uintm> packed;		// Instruction mask,value then context mask,value words for each pattern
+  vector<Constructor *> packedconstruct;	// Constructor for each packed pattern
+  void packPatterns(void);
+  void chooseOptimalField(const DecisionProperties &props);
+  double getScore(int4 low,int4 size,bool context,const DecisionProperties &props);
   int4 getNumFixed(int4 low,int4 size,bool context);
   int4 getMaximumLength(bool context);
   void consistentValues(vector<uint4> &bins,DisjointPattern *pat);
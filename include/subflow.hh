@@ -66,15 +66,21 @@ class SubvariableFlow {
     int4 slot;			// slot being affected or other parameter
   };
 
+  typedef map<Varnode *,ReplaceVarnode,less<Varnode *>,PoolAllocator<pair<Varnode * const,ReplaceVarnode> > > ReplaceVarnodeMap;
+  typedef list<ReplaceVarnode,PoolAllocator<ReplaceVarnode> > ReplaceVarnodeList;
+  typedef list<ReplaceOp,PoolAllocator<ReplaceOp> > ReplaceOpList;
+
   int4 flowsize;			// Size of the data-flow
   int4 bitsize;			// Number of bits in logical variable
   bool returnsTraversed;	// Have we tried to flow logical value across CPUI_RETURNs
   bool aggressive;		// Do we "know" initial seed point must be a sub variable
   bool sextrestrictions;	// Check for logical variables that are always sign extended into their container
   Funcdata *fd;
-  map<Varnode *,ReplaceVarnode> varmap;
-  list<ReplaceVarnode> newvarlist;
-  list<ReplaceOp> oplist;
+  Varnode *rootvn;		// Root of the trace (for recording failures)
+  uintb rootmask;		// Mask of the logical variable at the root
+  ReplaceVarnodeMap varmap;	// Nodes are drawn from an ObjectPool, so traces allocate nothing in the common case
+  ReplaceVarnodeList newvarlist;
+  ReplaceOpList oplist;
   list<PatchRecord> patchlist;	// Operations getting patched (but no flow thru)
   vector<ReplaceVarnode *> worklist;
   int4 pullcount;		// Number of instructions pulling out the logical value
@@ -105,6 +111,7 @@ class SubvariableFlow {
   bool useSameAddress(ReplaceVarnode *rvn);
   Varnode *getReplaceVarnode(ReplaceVarnode *rvn);
   bool processNextWork(void);
+  uint4 traceKind(void) const;
 public:
   SubvariableFlow(Funcdata *f,Varnode *root,uintb mask,bool aggr,bool sext);
   bool doTrace(void);
@@ -135,12 +142,15 @@ class SplitFlow {
   public:
     ReplaceOp(bool isLogic,PcodeOp *o,OpCode opc,int4 num);
   };
+  typedef map<Varnode *,ReplaceVarnode,less<Varnode *>,PoolAllocator<pair<Varnode * const,ReplaceVarnode> > > ReplaceVarnodeMap;
+  typedef list<ReplaceOp,PoolAllocator<ReplaceOp> > ReplaceOpList;
   int4 concatSize;		// Size of combined logicals
   int4 loSize;			// Size of logical piece in least sig part of combined
   int4 hiSize;			// Size of logical piece in most sig part of combined
   Funcdata *fd;
-  map<Varnode *,ReplaceVarnode> varmap;
-  list<ReplaceOp> oplist;
+  Varnode *rootvn;		// Root of the trace (for recording failures)
+  ReplaceVarnodeMap varmap;
+  ReplaceOpList oplist;
   vector<ReplaceVarnode *> worklist;
   void assignReplaceOp(bool isLogicalInput,PcodeOp *op,OpCode opc,int4 numParam,ReplaceVarnode *outrvn);
   void assignLogicalPieces(ReplaceVarnode *rvn);
@@ -203,12 +213,16 @@ class SubfloatFlow {
     PcodeOp *compop;
   };
 
+  typedef map<Varnode *,ReplaceVarnode,less<Varnode *>,PoolAllocator<pair<Varnode * const,ReplaceVarnode> > > ReplaceVarnodeMap;
+  typedef list<ReplaceVarnode,PoolAllocator<ReplaceVarnode> > ReplaceVarnodeList;
+  typedef list<ReplaceOp,PoolAllocator<ReplaceOp> > ReplaceOpList;
   int4 precision;		// Number of bytes of precision in the logical flow
   Funcdata *fd;
+  Varnode *rootvn;		// Root of the trace (for recording failures)
   const FloatFormat *format;
-  map<Varnode *,ReplaceVarnode> varmap;
-  list<ReplaceVarnode> newvarlist;
-  list<ReplaceOp> oplist;
+  ReplaceVarnodeMap varmap;
+  ReplaceVarnodeList newvarlist;
+  ReplaceOpList oplist;
   list<PulloutRecord> pulllist;
   list<CompareRecord> complist;
   vector<ReplaceVarnode *> worklist;
@@ -0,0 +1,107 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file tracespan.hh
+/// \brief Low-overhead begin/end spans of decompiler phases, exported as Chrome trace JSON
+#ifndef __CPUI_TRACESPAN__
+#define __CPUI_TRACESPAN__
+
+#include "types.h"
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <chrono>
+#include <ostream>
+
+namespace GhidraDec {
+
+/// \brief A single completed span recorded by one thread
+struct TraceEvent {
+  int4 id;			///< Index of the registered span kind (name and category)
+  int4 detail;			///< Index of a detail string in the thread's buffer, or -1
+  uint8 start;			///< Start time, in nanoseconds since the trace epoch
+  uint8 duration;		///< Duration in nanoseconds
+};
+
+/// \brief The events recorded by a single thread
+///
+/// Only the owning thread appends to the buffer.  The lock is uncontended except while the
+/// trace is being exported or cleared.
+class TraceBuffer {
+  friend class TraceLog;
+  int4 tid;				///< Thread number shown in the trace
+  std::mutex lock;			///< Guards \b events and \b details against export
+  std::vector<TraceEvent> events;	///< Completed spans, in order of completion
+  std::vector<std::string> details;	///< Detail strings attached to spans (function names)
+  uint4 dropped;			///< Number of spans dropped because the buffer was full
+  TraceBuffer(int4 t) { tid = t; dropped = 0; }	///< Constructor
+};
+
+/// \brief Process-wide collection of trace spans
+///
+/// Tracing is always compiled in.  When it is disabled, a TraceSpan costs a single test of a
+/// static flag.  When enabled, each thread records its spans into its own TraceBuffer, which
+/// holds at most \b maxevents events (later spans are dropped and counted).  Span kinds are
+/// registered once, by name and category, and referred to by index.
+///
+/// The collected spans are written as a Chrome trace (JSON Object Format with \e complete
+/// events), which can be loaded by chrome://tracing or Perfetto.
+class TraceLog {
+  static bool enabled;				///< Set if spans are currently being recorded
+  static std::mutex reglock;			///< Guards the registries and list of buffers
+  static std::vector<std::pair<std::string,std::string> > kinds;	///< Registered (name,category) pairs
+  static std::map<std::pair<std::string,std::string>,int4> kindindex;	///< Map from (name,category) to index
+  static std::vector<TraceBuffer *> buffers;	///< Buffers of every thread that has recorded
+  static std::chrono::steady_clock::time_point epoch;	///< Time that all event times are relative to
+  static thread_local TraceBuffer *current;	///< Buffer of the current thread (if any)
+  static TraceBuffer *getBuffer(void);		///< Get (creating if necessary) the current thread's buffer
+  static void writeString(std::ostream &s,const std::string &str);	///< Write a JSON string literal
+public:
+  static const uint4 maxevents;			///< Maximum number of events held per thread
+  static bool isEnabled(void) { return enabled; }	///< Return \b true if spans are being recorded
+  static void setEnabled(bool val);		///< Start or stop recording spans
+  static int4 registerKind(const std::string &nm,const std::string &cat);	///< Register a kind of span
+  static uint8 now(void) {			///< Get the current time relative to the epoch
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count(); }
+  static void record(int4 id,uint8 start,const std::string *detail);	///< Record a completed span
+  static void clear(void);			///< Throw away all recorded spans
+  static int4 numEvents(void);			///< Get the number of spans currently recorded
+  static uint4 numDropped(void);		///< Get the number of spans dropped because a buffer was full
+  static void saveChromeJson(std::ostream &s);	///< Write all recorded spans as a Chrome trace
+};
+
+/// \brief A scoped span: records the time between its construction and destruction
+///
+/// If tracing is disabled when the span is constructed, or the kind index is negative, nothing
+/// is recorded.  An optional detail string (typically the function name) is copied into the trace.
+class TraceSpan {
+  int4 id;			///< Kind of span being timed, or -1 if not recording
+  uint8 start;			///< Start time relative to the trace epoch
+  const std::string *detail;	///< Detail to attach to the span (or null)
+public:
+  /// \brief Start a span of the given kind
+  ///
+  /// \param i is the index of the span kind (from TraceLog::registerKind())
+  /// \param d is an optional detail string, which must outlive the span
+  TraceSpan(int4 i,const std::string *d=(const std::string *)0) {
+    if (TraceLog::isEnabled() && i >= 0) { id = i; detail = d; start = TraceLog::now(); }
+    else id = -1; }
+  ~TraceSpan(void) { if (id >= 0) TraceLog::record(id,start,detail); }	///< Finish the span
+};
+
+}
+#endif
@@ -67,6 +67,7 @@ class TruncationTag {
   uint4 size;		///< Size truncated addresses into the space
 public:
   void restoreXml(const Element *el);				///< Restore \b this from XML
+  void saveXml(ostream &s) const;				///< Save \b this as a \<truncate_space> tag
   const string &getName(void) const { return spaceName; }	///< Get name of address space being truncated
   uint4 getSize(void) const { return size; }			///< Size (of pointers) for new truncated space
 };
@@ -113,6 +114,53 @@ public:
   const uint1 *restorePackedOp(const Address &addr,const uint1 *ptr,const AddrSpaceManager *trans);
 };
 
+/// \brief The raw p-code for a straight-line run of machine instructions
+///
+/// This is filled in by Translate::translateRun(), which translates consecutive instructions
+/// and stops after the first one that can change control-flow.  The p-code is stored in flat
+/// arrays, with varnodes referred to by index, and any single instruction can be replayed
+/// later to a PcodeEmit object exactly as if Translate::oneInstruction() had been called on it.
+/// One PcodeRun can be reused for many runs, keeping its storage.
+class PcodeRun : public PcodeEmit {
+  /// \brief A single p-code op in the run
+  struct RunOp {
+    Address addr;		///< Address passed with the op
+    OpCode opc;			///< The op-code
+    int4 out;			///< Index of the output varnode, or -1 if there is no output
+    int4 in;			///< Index of the first input varnode
+    int4 isize;			///< Number of input varnodes
+  };
+  /// \brief A single machine instruction in the run
+  struct RunInstruction {
+    Address addr;		///< Address of the instruction
+    int4 length;		///< Number of bytes in the instruction
+    int4 firstop;		///< Index of the first op of the instruction
+    int4 numops;		///< Number of ops in the instruction
+  };
+  vector<RunInstruction> instructions;	///< Instructions in address order
+  vector<RunOp> ops;			///< Ops for all instructions
+  vector<VarnodeData> varnodes;		///< Storage for all varnodes
+  bool flowbreak;			///< Set if the last completed instruction can change control-flow
+  bool curflow;				///< Set if the instruction being recorded can change control-flow
+  Address curaddr;			///< Address of the instruction being recorded
+  int4 curop;				///< Number of ops before the instruction being recorded
+  int4 curvarnode;			///< Number of varnodes before the instruction being recorded
+public:
+  PcodeRun(void) { flowbreak = false; curflow = false; curop = 0; curvarnode = 0; }	///< Constructor
+  void clear(void);							///< Remove all instructions
+  void beginInstruction(const Address &addr);				///< Start recording a new instruction
+  void endInstruction(int4 length);					///< Finish recording the current instruction
+  void abortInstruction(void);						///< Discard a partially recorded instruction
+  bool endsFlow(void) const { return flowbreak; }			///< Did the last instruction contain a branch, call, or return
+  int4 numInstructions(void) const { return instructions.size(); }	///< Get the number of instructions in the run
+  const Address &getAddress(int4 i) const { return instructions[i].addr; }	///< Get the address of the i-th instruction
+  int4 getLength(int4 i) const { return instructions[i].length; }	///< Get the length of the i-th instruction
+  int4 numOps(int4 i) const { return instructions[i].numops; }		///< Get the number of ops in the i-th instruction
+  int4 findInstruction(const Address &addr) const;			///< Find the instruction at the given address
+  void emit(int4 i,PcodeEmit &emt);					///< Replay the p-code of the i-th instruction
+  virtual void dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize);
+};
+
 /// \brief Abstract class for emitting disassembly to an application
 ///
 /// Translation engines pass back the disassembly character data
@@ -222,8 +270,10 @@ class AddrSpaceManager {
   AddrSpace *stackspace;	///< Stack space associated with processor
   AddrSpace *uniqspace;		///< Temporary space associated with processor
   uintb joinallocate;		///< Next offset to be allocated in join space
-  set<JoinRecord *,JoinRecordCompare> splitset;	///< Different splits that have been defined in join space
+  vector<pair<uint4,JoinRecord *> > splithash;	///< Hash table of (hash,record) for every split defined in join space
   vector<JoinRecord *> splitlist; ///< JoinRecords indexed by join address
+  static uint4 hashJoin(const vector<VarnodeData> &pieces,uint4 size);	///< Hash the pieces and logical size of a split
+  void growSplitHash(void);	///< Double the number of slots in the split hash table
 protected:
   AddrSpace *restoreXmlSpace(const Element *el,const Translate *trans); ///< Add a space to the model based an on XML tag
   void restoreXmlSpaces(const Element *el,const Translate *trans); ///< Restore address spaces in the model from an XML tag
@@ -286,6 +336,14 @@ protected:
   void setBigEndian(bool val);	///< Set general endianness to \b big if val is \b true
   void setUniqueBase(uintm val); ///< Set the base offset for new temporary registers
 public:
+  /// \brief Basic flow properties of a machine instruction, as reported by instructionFlow()
+  enum {
+    flow_fallthru = 1,		///< Execution can continue with the next instruction
+    flow_jump = 2,		///< The instruction can branch to another instruction
+    flow_call = 4,		///< The instruction contains a call
+    flow_indirect = 8,		///< The instruction can branch or call through a computed address
+    flow_return = 16		///< The instruction can return
+  };
   Translate(void); 		///< Constructor for the translator
   void setDefaultFloatFormats(void); ///< If no explicit float formats, set up default formats
   bool isBigEndian(void) const; ///< Is the processor big endian?
@@ -331,6 +389,47 @@ public:
   /// \param val is \b true to allow context changes, \b false prevents changes
   virtual void allowContextSet(bool val) const {}
 
+  /// \brief Prepare the calling thread to share \b this translator
+  ///
+  /// Translators that keep mutable decoding state (caches of partially parsed
+  /// instructions, emitted p-code, etc.) can give each thread its own copy of that
+  /// state, so that multiple threads may translate instructions concurrently.
+  /// A thread calling this method must call detachThread() before it exits.
+  virtual void attachThread(void) const {}
+
+  /// \brief Release any decoding state created for the calling thread by attachThread()
+  virtual void detachThread(void) const {}
+
+  /// \brief Set the size of the persistent cache of translated instructions
+  ///
+  /// Translators that support it keep the p-code for previously translated instructions,
+  /// so that code shared by many functions is decoded only once. Entries are discarded
+  /// automatically if the context at their address changes.
+  /// \param size is the maximum number of instructions to cache (0 disables the cache)
+  virtual void setInstructionCacheSize(int4 size) const {}
+
+  /// \brief Get hit/miss counts for the persistent cache of translated instructions
+  ///
+  /// \param hits will hold the number of instructions served from the cache
+  /// \param misses will hold the number of instructions that had to be decoded
+  /// \return \b false if \b this translator does not have an instruction cache
+  virtual bool getInstructionCacheStats(uintb &hits,uintb &misses) const { return false; }
+
+  /// \brief Start or stop counting how often each part of the specification is decoded
+  ///
+  /// Translators built from a compiled specification can count every match of each of its
+  /// patterns. The counts, written by saveDecodeProfile(), can be given back to the compiler of
+  /// the specification, so that it builds decision trees favoring the most frequent instructions.
+  /// \param val is \b true to start counting, \b false to stop (the counts are kept)
+  /// \return \b false if \b this translator cannot count decodes
+  virtual bool setDecodeProfiling(bool val) const { return false; }
+
+  /// \brief Write the decode counts gathered since counting was first turned on
+  ///
+  /// \param s is the output stream
+  /// \return \b false if \b this translator cannot count decodes
+  virtual bool saveDecodeProfile(ostream &s) const { return false; }
+
   /// \brief Add a named register to the model for this processor
   ///
   /// \deprecated All registers used to be formally added to the
@@ -387,6 +486,19 @@ public:
   /// \return the number of bytes in the instruction
   virtual int4 instructionLength(const Address &baseaddr) const=0;
 
+  /// \brief Get the length and basic flow properties of a machine instruction
+  ///
+  /// This is for scanning code, where most instructions only need to be stepped over.
+  /// The properties are flow_fallthru, flow_jump, flow_call, flow_indirect, and flow_return.
+  /// An instruction falls through unless its last p-code op is a BRANCH, BRANCHIND, or RETURN,
+  /// or if a branch goes to the next instruction.  Branches within the p-code of the instruction,
+  /// and to the instruction itself, are not jumps.  Errors are thrown as for oneInstruction().
+  /// The default implementation translates the instruction and looks at its p-code.
+  /// \param baseaddr is the Address of the instruction
+  /// \param flow will hold the flow properties
+  /// \return the number of bytes in the instruction
+  virtual int4 instructionFlow(const Address &baseaddr,uint4 &flow) const;
+
   /// \brief Transform a single machine instruction into pcode
   ///
   /// This is the main interface to the pcode translation engine.
@@ -402,6 +514,24 @@ public:
   /// \return the number of bytes in the machine instruction
   virtual int4 oneInstruction(PcodeEmit &emit,const Address &baseaddr) const=0;
 
+  /// \brief Translate a straight-line run of machine instructions
+  ///
+  /// Consecutive instructions starting at the given address are translated into
+  /// the given PcodeRun (which is cleared first).  Translation stops after the first instruction
+  /// whose p-code contains a branch, call, or return, once the run covers the given number
+  /// of bytes, or after the maximum number of instructions.  The first instruction is always
+  /// translated.
+  /// If the first instruction cannot be translated, the UnimplError or BadDataError is thrown
+  /// as for oneInstruction().  An error in any later instruction simply ends the run before
+  /// it, so the error is reported when the caller translates that address on its own.
+  /// Translators can override this to share per-instruction setup across the whole run.
+  /// \param run will hold the translated instructions
+  /// \param baseaddr is the Address of the first machine instruction
+  /// \param maxbytes is the maximum number of bytes to translate
+  /// \param maxinsn is the maximum number of instructions to translate
+  /// \return the number of bytes translated
+  virtual int4 translateRun(PcodeRun &run,const Address &baseaddr,int4 maxbytes,int4 maxinsn) const;
+
   /// \brief Disassemble a single machine instruction
   ///
   /// This is the main interface to the disassembler for the
@@ -411,6 +541,19 @@ public:
   /// \param emit is the disassembly emitting object
   /// \param baseaddr is the address of the machine instruction to disassemble
   virtual int4 printAssembly(AssemblyEmit &emit,const Address &baseaddr) const=0;
+
+  /// \brief Disassemble a run of consecutive machine instructions
+  ///
+  /// Instructions starting at the given address are passed to the emitter one after another,
+  /// until the run covers the given number of bytes.  The first instruction is always printed.
+  /// As for translateRun(), an error in the first instruction is thrown, and an error in any
+  /// later instruction ends the run before it.  Translators can override this to share
+  /// per-instruction setup across the whole listing.
+  /// \param emit is the disassembly emitting object
+  /// \param baseaddr is the address of the first machine instruction
+  /// \param maxbytes is the number of bytes to disassemble
+  /// \return the number of bytes disassembled
+  virtual int4 printAssemblyRun(AssemblyEmit &emit,const Address &baseaddr,int4 maxbytes) const;
 };
 
 /// Return the size of addresses for the processor's official
@@ -522,6 +665,16 @@ inline AddrSpace *AddrSpaceManager::getSpace(int4 i) const {
   return baselist[i];
 }
 
+/// \param manage is the manager owning the address space of the key
+/// \return the Address the key was built from
+inline Address AddressKey::getAddress(const AddrSpaceManager *manage) const {
+  if (rank == 0)
+    return Address(Address::m_minimal);
+  if (rank == ~((uintb)0))
+    return Address(Address::m_maximal);
+  return Address(manage->getSpace((int4)(rank-1)),offset);
+}
+
 /// Although endianness is usually specified on the space, most languages set an endianness
 /// across the entire processor.  This routine sets the endianness to \b big if the -val-
 /// is passed in as \b true. Otherwise, the endianness is set to \b small.
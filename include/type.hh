@@ -86,8 +86,8 @@ protected:
   uint8 id;			///< A unique id for the type (or 0 if an id is not assigned)
   void restoreXmlBasic(const Element *el);	///< Recover basic data-type properties
   virtual void restoreXml(const Element *el,TypeFactory &typegrp);	///< Restore data-type from XML
-  static uint8 hashName(const string &nm);	///< Produce a data-type id by hashing the type name
 public:
+  static uint8 hashName(const string &nm);	///< Produce a data-type id by hashing the type name
   /// Construct the base data-type copying low-level properties of another
   Datatype(const Datatype &op) { size = op.size; name=op.name; metatype=op.metatype; flags=op.flags; id=op.id; }
   /// Construct the base data-type providing size and meta-type
@@ -109,11 +109,13 @@ public:
   const string &getName(void) const { return name; }		///< Get the type name
   virtual void printRaw(ostream &s) const;			///< Print a description of the type to stream
   virtual Datatype *getSubType(uintb off,uintb *newoff) const; ///< Recover component data-type one-level down
+  Datatype *getLeafType(uintb off,uintb *newoff);	///< Recover the innermost component data-type containing an offset
   virtual int4 numDepend(void) const { return 0; }	///< Return number of component sub-types
   virtual Datatype *getDepend(int4 index) const { return (Datatype *)0; }	///< Return the i-th component sub-type
   virtual void printNameBase(ostream &s) const { if (!name.empty()) s<<name[0]; } ///< Print name as short prefix
   virtual int4 compare(const Datatype &op,int4 level) const; ///< Compare for functional equivalence
   virtual int4 compareDependency(const Datatype &op) const; ///< Compare for storage in tree structure
+  virtual uint4 hashDependency(void) const;	///< Hash consistent with compareDependency()
   virtual Datatype *clone(void) const=0;	///< Clone the data-type
   virtual void saveXml(ostream &s) const;	///< Serialize the data-type to XML
   int4 typeOrder(const Datatype &op) const { if (this==&op) return 0; return compare(op,10); }	///< Order this with -op- datatype
@@ -153,6 +155,43 @@ typedef set<Datatype *,DatatypeCompare> DatatypeSet;
 /// A set of data-types sorted by name
 typedef set<Datatype *,DatatypeNameCompare> DatatypeNameSet;
 
+/// \brief A hash table of data-types, matched by their description
+///
+/// Data-types are hashed with Datatype::hashDependency() and matched with
+/// Datatype::compareDependency(), so this finds the same data-type a DatatypeSet would
+/// (for data-types without an id), in constant time on average.  The table uses open
+/// addressing with linear probing, and removes entries by shifting later ones back.
+class DatatypeHashSet {
+  vector<pair<uint4,Datatype *> > slot;	///< (hash,data-type) for each slot, with null data-type if empty
+  int4 count;				///< Number of data-types in the table
+  void grow(void);			///< Double the number of slots
+public:
+  DatatypeHashSet(void) { count = 0; }	///< Construct an empty table
+  Datatype *find(const Datatype &ct) const;	///< Find a data-type matching the given description
+  void insert(Datatype *ct);		///< Add a data-type (which must not match one already present)
+  void erase(Datatype *ct);		///< Remove a data-type (if present)
+  void clear(void) { slot.clear(); count = 0; }	///< Remove all data-types
+};
+
+/// \brief A hash table of data-types with an id, matched by id and name
+///
+/// This finds the same data-type a DatatypeNameSet would, given both the name and the id, without
+/// comparing names along a search path.  A name is compared only once the id matches.  The
+/// table uses open addressing with linear probing, like DatatypeHashSet.
+class DatatypeIdIndex {
+  vector<pair<uint4,Datatype *> > slot;	///< (hash,data-type) for each slot, with null data-type if empty
+  int4 count;				///< Number of data-types in the table
+  void grow(void);			///< Double the number of slots
+  static uint4 hashId(uint8 id) { return (uint4)((id ^ (id >> 32)) * 0x9e3779b1); }	///< Hash a type id
+public:
+  DatatypeIdIndex(void) { count = 0; }	///< Construct an empty table
+  Datatype *find(const string &nm,uint8 id) const;	///< Find the data-type with the given name and id
+  bool contains(uint8 id) const;	///< Is there a data-type with the given id, under any name
+  void insert(Datatype *ct);		///< Add a data-type
+  void erase(Datatype *ct);		///< Remove a data-type (if present)
+  void clear(void) { slot.clear(); count = 0; }	///< Remove all data-types
+};
+
 /// \brief Base class for the fundamental atomic types.
 ///
 /// Data-types with a name, size, and meta-type
@@ -238,6 +277,7 @@ public:
   virtual void printNameBase(ostream &s) const { s << 'p'; ptrto->printNameBase(s); }
   virtual int4 compare(const Datatype &op,int4 level) const; // For tree structure
   virtual int4 compareDependency(const Datatype &op) const; // For tree structure
+  virtual uint4 hashDependency(void) const;
   virtual Datatype *clone(void) const { return new TypePointer(*this); }
   virtual void saveXml(ostream &s) const;
 };
@@ -267,6 +307,7 @@ public:
   virtual void printNameBase(ostream &s) const { s << 'a'; arrayof->printNameBase(s); }
   virtual int4 compare(const Datatype &op,int4 level) const; // For tree structure
   virtual int4 compareDependency(const Datatype &op) const; // For tree structure
+  virtual uint4 hashDependency(void) const;
   virtual Datatype *clone(void) const { return new TypeArray(*this); }
   virtual void saveXml(ostream &s) const;
 };
@@ -300,6 +341,16 @@ public:
 
 /// \brief A composite Datatype object: A "structure" with component "fields"
 class TypeStruct : public Datatype {
+  /// \brief A byte range of the structure, with any nested structures flattened
+  struct FlatField {
+    int4 offset;			///< Offset of the range within \b this
+    int4 size;				///< Number of bytes in the range
+    int4 base;				///< Offset within \b this of the start of \b type
+    Datatype *type;			///< Innermost field that is not a structure, or the nested structure with a gap here
+  };
+  vector<FlatField> flat;		///< Every innermost field and nested gap, sorted by offset
+  bool flatok;				///< \b true if \b flat describes the fields
+  bool flattenFields(vector<FlatField> &res,int4 base,bool gaps) const;	///< Append the flattened fields of \b this
 protected:
   friend class TypeFactory;
   vector<TypeField> field;			///< The list of fields
@@ -308,11 +359,12 @@ protected:
   virtual void restoreXml(const Element *el,TypeFactory &typegrp);
 public:
   TypeStruct(const TypeStruct &op);	///< Construct from another TypeStruct
-  TypeStruct(const string &n) : Datatype(0,TYPE_STRUCT,n) {}	///< Construct empty TypeStruct from a name
+  TypeStruct(const string &n) : Datatype(0,TYPE_STRUCT,n) { flatok = false; }	///< Construct empty TypeStruct from a name
   vector<TypeField>::const_iterator beginField(void) const { return field.begin(); }	///< Beginning of fields
   vector<TypeField>::const_iterator endField(void) const { return field.end(); }	///< End of fields
   const TypeField *getField(int4 off,int4 sz,int4 *newoff) const;	///< Get field based on offset
   virtual Datatype *getSubType(uintb off,uintb *newoff) const;
+  Datatype *getFlatSubType(uintb off,uintb *newoff) const;	///< Get the innermost non-structure field containing an offset
   virtual int4 numDepend(void) const { return field.size(); }
   virtual Datatype *getDepend(int4 index) const { return field[index].type; }
   virtual int4 compare(const Datatype &op,int4 level) const; // For tree structure
@@ -385,6 +437,8 @@ class TypeFactory {
   type_metatype enumtype;	///< Default enumeration meta-type (when parsing C)
   DatatypeSet tree;		///< Datatypes within this factory (sorted by function)
   DatatypeNameSet nametree;	///< Cross-reference by name
+  DatatypeIdIndex idindex;	///< Cross-reference by id (the same data-types as \b nametree)
+  DatatypeHashSet hashtable;	///< Cross-reference by description, for data-types with no id
   Datatype *typecache[9][8];	///< Matrix of the most common atomic data-types
   Datatype *typecache10;	///< Specially cached 10-byte float type
   Datatype *typecache16;	///< Specially cached 16-byte float type
@@ -406,6 +460,7 @@ public:
   void setupSizes(void);	///< Derive some size information from Architecture
   void clear(void);		///< Clear out all types
   void clearNoncore(void);	///< Clear out non-core types
+  bool hasId(uint8 id) const;	///< Is there a data-type with the given id in \b this container
   virtual ~TypeFactory(void);	///< Destructor
   void setStructAlign(int4 al) { align = al; }		///< Set the default structure alignment
   int4 getStructAlign(void) const { return align; }	///< Get the default structure alignment
@@ -29,11 +29,21 @@ namespace GhidraDec {
 /// Requests for a specific data-type name and id are marshaled to the Ghidra client,
 /// which sends back a description of the data-type. The description is parsed and
 /// converted into a Datatype object and cached in this object.
+///
+/// A description refers to the other named data-types it is built from by name and id, and
+/// each of those would take another query.  So the client is first asked for the whole closure
+/// of the data-type in one reply. Definitions in the reply are parsed only when a reference
+/// to them is resolved, so exactly the same Datatype objects are built as with one query per
+/// data-type.  If the client doesn't answer closure queries, single queries are used instead.
 class TypeFactoryGhidra : public TypeFactory {
+  bool closurequery;			///< Set if the client is asked for the closure of a data-type
+  map<uint8,const Element *> pending;	///< Unparsed definitions from the current closure reply, by id
+  Datatype *findByQuery(const string &n,uint8 id);	///< Query the client for a single data-type
+  Datatype *findByClosure(const string &n,uint8 id);	///< Query the client for the closure of a data-type
 protected:
   virtual Datatype *findById(const string &n,uint8 id);
 public:
-  TypeFactoryGhidra(ArchitectureGhidra *g) : TypeFactory(g) {}	///< Constructor
+  TypeFactoryGhidra(ArchitectureGhidra *g) : TypeFactory(g) { closurequery = true; }	///< Constructor
   virtual ~TypeFactoryGhidra(void) {}
 };
 
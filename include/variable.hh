@@ -46,7 +46,8 @@ public:
   enum {
     flagsdirty = 1,		///< Boolean properties for the HighVariable are dirty
     typedirty = 2,		///< The data-type for the HighVariable is dirty
-    coverdirty = 4		///< The cover for the HighVariable is dirty
+    coverdirty = 4,		///< The cover for the HighVariable is dirty
+    covermembers = 8		///< Only blocks where member Varnode covers changed are dirty
   };
 private:
   friend class Merge;
@@ -56,14 +57,18 @@ private:
   mutable uint4 flags;			///< Boolean properties inherited from Varnode members
   mutable Datatype *type;		///< The data-type for this
   mutable Cover wholecover;		///< The ranges of code addresses covered by this HighVariable
+  mutable vector<int4> dirtyblocks;	///< Blocks of \b wholecover that need recalculating (if \e covermembers is set)
   mutable Symbol *symbol;		///< The Symbol \b this HighVariable is tied to
   mutable int4 symboloffset;		///< -1=perfect symbol match >=0, offset
   int4 instanceIndex(const Varnode *vn) const;	///< Find the index of a specific Varnode member
   void updateFlags(void) const;		///< (Re)derive boolean properties of \b this from the member Varnodes
   void updateCover(void) const;		///< (Re)derive the cover of \b this from the member Varnodes
+  void updateCoverBlocks(void) const;	///< Rederive the dirty blocks of the cover of \b this
   void updateType(void) const;		///< (Re)derive the data-type for \b this from the member Varnodes
 public:
   HighVariable(Varnode *vn);		///< Construct a HighVariable with a single member Varnode
+  static void *operator new(size_t size) { return ObjectPool<HighVariable>::allocate(size); }	///< Allocate from the HighVariable pool
+  static void operator delete(void *ptr,size_t size) { ObjectPool<HighVariable>::release(ptr,size); }	///< Return storage to the HighVariable pool
   Datatype *getType(void) const { updateType(); return type; }	///< Get the data-type
 
   /// \brief Set the Symbol associated with \b this HighVariable.
@@ -80,8 +85,13 @@ public:
   int4 getSymbolOffset(void) const { return symboloffset; }	///< Get the Symbol offset associated with \b this
   int4 numInstances(void) const { return inst.size(); }		///< Get the number of member Varnodes \b this has
   Varnode *getInstance(int4 i) const { return inst[i]; }	///< Get the i-th member Varnode
+  uint8 memoryEstimate(void) const;				///< Estimate the bytes of heap used by \b this HighVariable
   void flagsDirty(void) const { highflags |= HighVariable::flagsdirty; }	///< Mark the boolean properties as \e dirty
-  void coverDirty(void) const { highflags |= HighVariable::coverdirty; }	///< Mark the cover as \e dirty
+  void coverDirty(void) const { highflags |= HighVariable::coverdirty; highflags &= ~((uint4)HighVariable::covermembers); dirtyblocks.clear(); }	///< Mark the cover as \e dirty
+  /// \brief Mark the cover as \e dirty because the cover of a member Varnode is changing
+  void memberCoverDirty(void) const { if ((highflags&HighVariable::coverdirty)==0) highflags |= (HighVariable::coverdirty|HighVariable::covermembers); }
+  /// \brief Record the blocks of a member Varnode's cover, before or after it changes
+  void memberCoverChanged(const Cover &cov) const { if ((highflags&HighVariable::covermembers)!=0) cov.addBlocks(dirtyblocks); }
   void typeDirty(void) const { highflags |= HighVariable::typedirty; }		///< Mark the data-type as \e dirty
   void remove(Varnode *vn);					///< Remove a member Varnode from \b this
 
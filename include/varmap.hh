@@ -80,19 +80,43 @@ public:
   void gather(const Funcdata *f,AddrSpace *spc,bool defer);
   bool hasLocalAlias(Varnode *vn) const;
   void sortAlias(void) const;
-  const vector<AddBase> &getAddBase(void) const { return addbase; }
-  const vector<uintb> &getAlias(void) const { return alias; }
+  const vector<AddBase> &getAddBase(void) const { if (!calculated) gatherInternal(); return addbase; }
+  const vector<uintb> &getAlias(void) const { if (!calculated) gatherInternal(); return alias; }
+  AddrSpace *getSpace(void) const { return spaceid; }
   static void gatherAdditiveBase(Varnode *startvn,vector<AddBase> &addbase); // Gather result varnodes for all \e sums that \b startvn is involved in
   static uintb gatherOffset(Varnode *vn); // If \b vn is a sum result, return the constant portion of this sum
 };
 
+// Ranges from the varnodes of a stack frame, kept across restructurings.  The ranges stay
+// sorted, and only the varnodes whose data-type changed are re-sorted.  The ranges are rebuilt
+// if the frame gains or loses a varnode.
+class MapCache {
+public:
+  struct Entry {
+    MapRange range;
+    int4 index;			// Position of the varnode in the location order
+    Entry(const MapRange &r,int4 i) : range(r) { index = i; }
+  };
+private:
+  vector<uintb> offsets;	// Offset of each non-free varnode, in location order
+  vector<Datatype *> types;	// Type of each non-free varnode
+  vector<Entry> entries;	// Ranges in sorted order
+  static bool compareEntries(const Entry &a,const Entry &b);
+  static MapRange buildRange(AddrSpace *spc,uintb st,Datatype *ct);
+  void rebuild(AddrSpace *spc);
+  bool update(AddrSpace *spc,int4 i,Datatype *oldtype);
+public:
+  void gatherVarnodes(const Funcdata &fd,AddrSpace *spc,Datatype *dt);
+  const vector<Entry> &getEntries(void) const { return entries; }
+};
+
 class MapState {
   AddrSpace *spaceid;
   RangeList range;
   vector<MapRange *> maplist;
   vector<MapRange *>::iterator iter;
+  int4 numsorted;		// Number of initial ranges that are already sorted
   Datatype *default_type;
-  AliasChecker checker;
 public:
 #ifdef OPACTION_DEBUG
   mutable bool debugon;
@@ -104,12 +128,11 @@ public:
   ~MapState(void);
   void addRange(uintb st,Datatype *ct,uint4 fl,bool ay,int4 lo,int4 hi);
   void addRange(const EntryMap *rangemap);
+  void addRanges(const MapCache &cache);
   bool initialize(void);
-  void sortAlias(void) { checker.sortAlias(); }
-  const vector<uintb> &getAlias(void) { return checker.getAlias(); }
   void gatherVarnodes(const Funcdata &fd);
   void gatherHighs(const Funcdata &fd);
-  void gatherOpen(const Funcdata &fd);
+  void gatherOpen(const AliasChecker &checker);
   MapRange *next(void) { return *iter; }
   bool getNext(void) { ++iter; if (iter==maplist.end()) return false; return true; }
 };
@@ -122,6 +145,7 @@ class ScopeLocal : public ScopeInternal {
   bool overlapproblems;		// Cached problem flag
   uint4 qflags;
   map<AddressSorter,string> name_recommend;
+  MapCache mapcache;		// Ranges and aliases from the previous restructuring
   bool adjustFit(MapRange &a) const;
   void createEntry(const MapRange &a);
   bool rangeAbsorb(MapRange *a,MapRange *b);
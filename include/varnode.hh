@@ -20,6 +20,7 @@
 
 #include "pcoderaw.hh"
 #include "cover.hh"
+#include "mempool.hh"
 
 namespace GhidraDec {
 class HighVariable;
@@ -41,10 +42,13 @@ struct VarnodeCompareDefLoc {
 };
 
 /// A set of Varnodes sorted by location (then by definition)
-typedef set<Varnode *,VarnodeCompareLocDef> VarnodeLocSet;
+typedef set<Varnode *,VarnodeCompareLocDef,PoolAllocator<Varnode *> > VarnodeLocSet;
 
 /// A set of Varnodes sorted by definition (then location)
-typedef set<Varnode *,VarnodeCompareDefLoc> VarnodeDefSet;
+typedef set<Varnode *,VarnodeCompareDefLoc,PoolAllocator<Varnode *> > VarnodeDefSet;
+
+/// A list of the PcodeOps reading a Varnode (nodes are drawn from an ObjectPool)
+typedef list<PcodeOp *,PoolAllocator<PcodeOp *> > DescendList;
 
 /// \brief A low-level variable or contiguous set of bytes described by an Address and a size
 ///
@@ -119,6 +123,9 @@ public:
     stack_store = 0x80		///< Created by an explicit STORE
   };
 private:
+  // Fields are grouped by cache line (160 bytes in all on LP64).  The first line holds all the
+  // keys VarnodeBank sorts by, the second what the rules read and the links of the Varnode,
+  // and the last the fields only used by a few specific passes.
   mutable uint4 flags;		///< The collection of boolean attributes for this Varnode
   int4 size;			///< Size of the Varnode in bytes
   uint4 create_index;		///< A unique one-up index assigned to Varnode at its creation
@@ -128,17 +135,21 @@ private:
 
 				// Heritage fields
   PcodeOp *def;			///< The defining operation of this Varnode
+  SeqNum defseq;		///< Copy of the sequence number of \b def, the sort key within VarnodeBank
   HighVariable *high;		///< High-level variable of which this is an instantiation
-  SymbolEntry *mapentry;	///< cached SymbolEntry associated with Varnode
   Datatype *type;		///< Datatype associated with this varnode
+  uintb nzm;			///< Which bits do we know are zero
   VarnodeLocSet::iterator lociter;	///< Iterator into VarnodeBank sorted by location
-  VarnodeDefSet::iterator defiter;	///< Iterator into VarnodeBank sorted by definition
-  list<PcodeOp *> descend;		///< List of every op using this varnode as input
+  VarnodeDefSet::iterator defiter;	///< Iterator into VarnodeBank sorted by definition (unused for constants)
+  DescendList descend;			///< List of every op using this varnode as input
+
+  SymbolEntry *mapentry;	///< cached SymbolEntry associated with Varnode
   mutable Cover *cover;		///< Addresses covered by the def->use of this Varnode
   mutable Datatype *temptype;	///< For type propagate algorithm
   uintb consumed;		///< What parts of this varnode are used
-  uintb nzm;			///< Which bits do we know are zero
   friend class VarnodeBank;
+  friend struct VarnodeCompareLocDef;
+  friend struct VarnodeCompareDefLoc;
   friend class Merge;
   friend class Funcdata;
   void updateCover(void) const;	///< Internal function for update coverage information
@@ -172,8 +183,8 @@ public:
   Datatype *getTempType(void) const { return temptype; } ///< Get the temporary Datatype (used during type propagation)
   uint4 getCreateIndex(void) const { return create_index; } ///< Get the creation index
   Cover *getCover(void) const { updateCover(); return cover; } ///< Get Varnode coverage information
-  list<PcodeOp *>::const_iterator beginDescend(void) const { return descend.begin(); } ///< Get iterator to list of syntax tree descendants (reads)
-  list<PcodeOp *>::const_iterator endDescend(void) const { return descend.end(); } ///< Get the end iterator to list of descendants
+  DescendList::const_iterator beginDescend(void) const { return descend.begin(); } ///< Get iterator to list of syntax tree descendants (reads)
+  DescendList::const_iterator endDescend(void) const { return descend.end(); } ///< Get the end iterator to list of descendants
   uintb getConsume(void) const { return consumed; } ///< Get mask of consumed bits
   void setConsume(uintb val) { consumed = val; } ///< Set the mask of consumed bits (used by dead-code algorithm)
   bool isConsumeList(void) const { return ((addlflags&Varnode::lisconsume)!=0); } ///< Get marker used by dead-code algorithm
@@ -193,6 +204,8 @@ public:
   bool operator==(const Varnode &op2) const; ///< Equality operator
   bool operator!=(const Varnode &op2) const { return !operator==(op2); } ///< Inequality operator
   ~Varnode(void);		///< Destructor
+  static void *operator new(size_t size) { return ObjectPool<Varnode>::allocate(size); }	///< Allocate from the Varnode pool
+  static void operator delete(void *ptr,size_t size) { ObjectPool<Varnode>::release(ptr,size); }	///< Return storage to the Varnode pool
   bool intersects(const Varnode &op) const; ///< Return \b true if the storage locations intersect
   bool intersects(const Address &op2loc,int4 op2size) const; ///< Check intersection against an Address range
   int4 contains(const Varnode &op) const; ///< Return info about the containment of \e op in \b this
@@ -310,7 +323,9 @@ public:
 ///    - Sorting based on point of definition (\b def)
 /// The class maintains a \e last \e offset counter for allocation
 /// temporary Varnode objects in the \e unique space. Constants are created
-/// by passing a constant address to the create() method.
+/// by passing a constant address to the create() method.  Constants are always \e free,
+/// and are only held in the location based ordering, where they are the first space.
+/// They never appear in the definition based ordering.
 class VarnodeBank {
   AddrSpaceManager *manage;	///< Underlying address space manager
   AddrSpace *uniq_space;	///< Space to allocate unique varnodes from
@@ -326,6 +341,7 @@ public:
   void clear(void);						///< Clear out all Varnodes and reset counters
   ~VarnodeBank(void) { clear(); }				///< Destructor
   int4 numVarnodes(void) const { return loc_tree.size(); }	///< Get number of Varnodes \b this contains
+  uint8 memoryEstimate(void) const;				///< Estimate the bytes of heap used by \b this container
   Varnode *create(int4 s,const Address &m,Datatype *ct);	///< Create a \e free Varnode object
   Varnode *createDef(int4 s,const Address &m,Datatype *ct,PcodeOp *op);	///< Create a Varnode as the output of a PcodeOp
   Varnode *createUnique(int4 s,Datatype *ct);			///< Create a temporary varnode
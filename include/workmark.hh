@@ -0,0 +1,104 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+/// \file workmark.hh
+/// \brief Per-thread record of the work in progress, readable from a signal handler
+#ifndef __CPUI_WORKMARK__
+#define __CPUI_WORKMARK__
+
+#include "types.h"
+
+#include <string>
+#include <atomic>
+
+namespace GhidraDec {
+
+/// \brief What one thread is currently working on
+///
+/// Only the owning thread writes to the slot.  Each field is a single word, so a reader (the
+/// signal handler) sees each field either before or after an update, though the fields together
+/// may be momentarily inconsistent.  Names point at the name of an Action or Rule, which lives
+/// as long as the Architecture it belongs to.
+struct WorkSlot {
+  std::atomic<int4> ostid;		///< Operating system id of the thread, or 0 if the slot is unclaimed
+  volatile uintb funcaddr;		///< Entry offset of the function being decompiled
+  const char * volatile action;		///< Name of the innermost Action being performed (or null)
+  const char * volatile rule;		///< Name of the Rule being applied (or null)
+  volatile int4 pass;			///< Number of times the innermost Action has been applied in this perform
+};
+
+/// \brief Process-wide collection of WorkSlot records
+///
+/// When enabled, every Action::perform() and ActionPool::processOp() notes the function, Action,
+/// Rule and pass in the WorkSlot of the current thread.  This costs a few stores per Action and
+/// Rule, and a single test of a static flag when disabled.  Slots are claimed from a fixed array
+/// and are never released, so dump() needs no locks or allocation and can be called from a
+/// signal handler.  A handler for SIGUSR1 writes all slots, with the time (CLOCK_MONOTONIC) and
+/// operating system thread id, to an annotation file or to \e stderr.  Sending the signal
+/// periodically yields a record that samples from perf (run with \e -k \e mono) can be joined
+/// against by thread and time.
+class WorkMark {
+  static bool enabled;				///< Set if work is currently being noted
+  static std::atomic<int4> numslots;		///< Number of slots claimed
+  static thread_local WorkSlot *current;	///< Slot of the current thread (if any)
+  static int annotatefd;			///< File descriptor that dumps are written to
+  static WorkSlot *claimSlot(void);		///< Claim a slot for the current thread
+  static void signalHandler(int sig);		///< Dump all slots in response to a signal
+public:
+  enum {
+    maxslots = 256				///< Maximum number of threads that can be noted
+  };
+  static WorkSlot slots[maxslots];		///< The slot of each thread that has noted work
+  static bool isEnabled(void) { return enabled; }	///< Return \b true if work is being noted
+  static void setEnabled(bool val);		///< Start or stop noting work
+  static WorkSlot *getSlot(void) {		///< Get (claiming if necessary) the current thread's slot
+    if (current == (WorkSlot *)0) current = claimSlot();
+    return current; }
+  static bool setAnnotationFile(const std::string &file);	///< Direct dumps to a file
+  static void dump(int fd);			///< Write all slots to a file descriptor (signal-safe)
+};
+
+/// \brief A scoped note of the Action being performed on a function
+///
+/// The previous contents of the slot are restored when the note goes out of scope, so after a
+/// child Action returns, the slot again names its parent.  If noting is disabled when the
+/// note is constructed, nothing is recorded.
+class WorkNote {
+  WorkSlot *slot;		///< Slot of this thread, or null if not noting
+  uintb oldfunc;		///< Function replaced by the note
+  const char *oldaction;	///< Action replaced by the note
+  const char *oldrule;		///< Rule replaced by the note
+  int4 oldpass;			///< Pass replaced by the note
+public:
+  /// \brief Note the start of an Action
+  ///
+  /// \param func is the entry offset of the function
+  /// \param nm is the name of the Action, which must outlive the note
+  WorkNote(uintb func,const char *nm) {
+    if (!WorkMark::isEnabled()) { slot = (WorkSlot *)0; return; }
+    slot = WorkMark::getSlot();
+    if (slot == (WorkSlot *)0) return;
+    oldfunc = slot->funcaddr; oldaction = slot->action; oldrule = slot->rule; oldpass = slot->pass;
+    slot->funcaddr = func; slot->action = nm; slot->rule = (const char *)0; slot->pass = 0; }
+  ~WorkNote(void) {		///< Restore the previous note
+    if (slot == (WorkSlot *)0) return;
+    slot->funcaddr = oldfunc; slot->action = oldaction; slot->rule = oldrule; slot->pass = oldpass; }
+  void nextPass(void) { if (slot != (WorkSlot *)0) slot->pass = slot->pass + 1; }	///< Note another application of the Action
+  /// \brief Get the slot to note Rules in, or null if not noting
+  static WorkSlot *ruleSlot(void) { return WorkMark::isEnabled() ? WorkMark::getSlot() : (WorkSlot *)0; }
+};
+
+}
+#endif
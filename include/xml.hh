@@ -25,36 +25,38 @@
 
 namespace GhidraDec {
 
+// The name and attributes of one start tag.  The parser reuses a single object for every
+// tag, so the strings keep their storage from one tag to the next.
 class Attributes {
-  std::string *elementname;
+  std::string elementname;
   std::string bogus_uri;
   std::string prefix;
-  std::vector<std::string *> name;
-  std::vector<std::string *> value;
+  std::vector<std::string> name;
+  std::vector<std::string> value;
+  int4 count;			// Number of attributes of the current tag
 public:
-  Attributes(std::string *el) { elementname = el; }
-  ~Attributes(void) { 
-    for(uint4 i=0;i<name.size();++i) { delete name[i]; delete value[i]; }
-    delete elementname;
-  }
+  Attributes(void) { count = 0; }
   const std::string &getelemURI(void) const { return bogus_uri; }
-  const std::string &getelemName(void) const { return *elementname; }
-  void add_attribute(std::string *nm,std::string *vl) { name.push_back(nm); value.push_back(vl); }
+  const std::string &getelemName(void) const { return elementname; }
+  void clear(const char *nm,int4 len) { elementname.assign(nm,len); count = 0; }
+  void add_attribute(const char *nm,int4 len,const std::string &vl) {
+    if (count == name.size()) { name.emplace_back(); value.emplace_back(); }
+    name[count].assign(nm,len); value[count] = vl; count += 1; }
 				// The official SAX interface
-  int4 getLength(void) const { return name.size(); }
+  int4 getLength(void) const { return count; }
   const std::string &getURI(int4 index) const { return bogus_uri; }
-  const std::string &getLocalName(int4 index) const { return *name[index]; }
-  const std::string &getQName(int4 index) const { return *name[index]; }
+  const std::string &getLocalName(int4 index) const { return name[index]; }
+  const std::string &getQName(int4 index) const { return name[index]; }
   //  int4 getIndex(const std::string &uri,const std::string &localName) const;
   //  int4 getIndex(const std::string &qualifiedName) const;
   //  const std::string &getType(int4 index) const;
   //  const std::string &getType(const std::string &uri,const std::string &localName) const;
   //  const std::string &getType(const std::string &qualifiedName) const;
-  const std::string &getValue(int4 index) const { return *value[index]; }
+  const std::string &getValue(int4 index) const { return value[index]; }
   //const std::string &getValue(const std::string &uri,const std::string &localName) const;
   const std::string &getValue(const std::string &qualifiedName) const {
-    for(uint4 i=0;i<name.size();++i)
-      if (*name[i] == qualifiedName) return *value[i];
+    for(int4 i=0;i<count;++i)
+      if (name[i] == qualifiedName) return value[i];
     return bogus_uri;
   }
 };
@@ -85,6 +87,16 @@ public:
 class Element;
 typedef std::vector<Element *> List;
 
+// Hook for handling elements as soon as they have been parsed, rather than after the whole
+// document is in memory.  consume() is called on each element when its end tag is read, with all its
+// children in place.  The consumer may modify the element, and if it returns true the element
+// has been fully handled and is removed from the tree and freed immediately.
+class ElementConsumer {
+public:
+  virtual ~ElementConsumer(void) {}
+  virtual bool consume(Element *el)=0;
+};
+
 class Element {
   std::string name;
   std::string content;
@@ -96,11 +108,14 @@ protected:
 public:
   Element(Element *par) { parent = par; }
   ~Element(void);
+  Element *clone(Element *par) const;
   void setName(const std::string &nm) { name = nm; }
   void addContent(const char *str,int4 start,int4 length) { 
     //    for(int4 i=0;i<length;++i) content += str[start+i]; }
     content.append(str+start,length); }
+  void setContent(const std::string &str) { content = str; }
   void addChild(Element *child) { children.push_back(child); }
+  void deleteLastChild(void) { delete children.back(); children.pop_back(); }
   void addAttribute(const std::string &nm,const std::string &vl) {
     attr.push_back(nm); value.push_back(vl); }
   Element *getParent(void) const { return parent; }
@@ -122,9 +137,10 @@ public:
 class TreeHandler : public ContentHandler {
   Element *root;
   Element *cur;
+  ElementConsumer *consumer;
   std::string error;
 public:
-  TreeHandler(Element *rt) { root = rt; cur = root; }
+  TreeHandler(Element *rt,ElementConsumer *c=(ElementConsumer *)0) { root = rt; cur = root; consumer = c; }
   virtual ~TreeHandler(void) {}
   virtual void setDocumentLocator(Locator locator) {}
   virtual void startDocument(void) {}
@@ -151,8 +167,9 @@ class DocumentStorage {
   std::map<std::string,const Element *> tagmap;
 public:
   ~DocumentStorage(void);
-  Document *parseDocument(std::istream &s);
-  Document *openDocument(const std::string &filename);
+  Document *parseDocument(std::istream &s,ElementConsumer *consumer=(ElementConsumer *)0);
+  Document *openDocument(const std::string &filename,ElementConsumer *consumer=(ElementConsumer *)0);
+  Document *addDocument(Document *doc);
   void registerTag(const Element *el);
   const Element *getTag(const std::string &nm) const;
 };
@@ -163,39 +180,81 @@ struct XmlError {
 };
 
 extern int4 xml_parse(std::istream &i,ContentHandler *hand,int4 dbg=0);
-extern Document *xml_tree(std::istream &i);
+extern Document *xml_tree(std::istream &i,ElementConsumer *consumer=(ElementConsumer *)0);
 extern void xml_escape(std::ostream &s,const char *str);
+extern char *xml_format_dec(char *end,intb val);	// Format decimal digits ending just before end
+extern char *xml_format_hex(char *end,uintb val);	// Format hex digits ending just before end
+
+// A growable in-memory buffer for XML output.  A std::ostream constructed on it writes
+// straight into one contiguous block, which is handed to its destination in a single
+// write by flushTo(), or read back in place through a std::istream after startReading().
+class XmlBuffer : public std::streambuf {
+  std::vector<char> buf;
+  void grow(size_t need);
+protected:
+  virtual int_type overflow(int_type c);
+  virtual std::streamsize xsputn(const char *s,std::streamsize n);
+public:
+  XmlBuffer(size_t reserve=65536);
+  size_t size(void) const { return pptr() - pbase(); }
+  const char *data(void) const { return pbase(); }
+  void clear(void) { setp(buf.data(),buf.data()+buf.size()); setg(buf.data(),buf.data(),buf.data()); }
+  void startReading(void) { setg(pbase(),pbase(),pptr()); }
+  void flushTo(std::ostream &s);
+};
+
+// Some helper functions for producing XML.  These use unformatted writes, but leave the
+// stream in the same base they always have, as callers may rely on it.
+inline void a_v_start(std::ostream &s,const std::string &attr)
+
+{
+  s.put(' ');
+  s.write(attr.data(),attr.size());
+  s.write("=\"",2);
+}
 
-// Some helper functions for producing XML
 inline void a_v(std::ostream &s,const std::string &attr,const std::string &val)
 
 {
-  s << ' ' << attr << "=\"";
+  a_v_start(s,attr);
   xml_escape(s,val.c_str());
-  s << "\"";
+  s.put('"');
 }
 
 inline void a_v_i(std::ostream &s,const std::string &attr,intb val)
 
 {
-  s << ' ' << attr << "=\"" << std::dec << val << "\"";
+  char buf[24];
+  char *end = buf + sizeof(buf);
+  *--end = '"';
+  char *start = xml_format_dec(end,val);
+  a_v_start(s,attr);
+  s.setf(std::ios::dec,std::ios::basefield);
+  s.write(start,buf + sizeof(buf) - start);
 }
 
 inline void a_v_u(std::ostream &s,const std::string &attr,uintb val)
 
 {
-  s << ' ' << attr << "=\"0x" << std::hex << val << "\"";
+  char buf[24];
+  char *end = buf + sizeof(buf);
+  *--end = '"';
+  char *start = xml_format_hex(end,val);
+  *--start = 'x';
+  *--start = '0';
+  a_v_start(s,attr);
+  s.setf(std::ios::hex,std::ios::basefield);
+  s.write(start,buf + sizeof(buf) - start);
 }
 
 inline void a_v_b(std::ostream &s,const std::string &attr,bool val)
 
 {
-  s << ' ' << attr << "=\"";
+  a_v_start(s,attr);
   if (val)
-    s << "true";
+    s.write("true\"",5);
   else
-    s << "false";
-  s << "\"";
+    s.write("false\"",6);
 }
 
 inline bool xml_readbool(const std::string &attr)
@@ -17,11 +17,51 @@
 #include "funcdata.hh"
 
 #include "coreaction.hh"
+#include "tracespan.hh"
+#include "workmark.hh"
 
 #include <string>
 
 namespace GhidraDec {
 
+bool Action::timing_on = false;
+bool Action::memory_on = false;
+
+/// Once the analysis budget of a function runs out, Actions and Rules in these groups are
+/// skipped.  They only refine output that is already correct.
+const char *Action::expendable_groups[] = { "conditionalexe", "doubleload", "doubleprecis", "subvar",
+					    "floatprecision", "nodejoin", "" };
+
+/// \param g is the name of the group
+/// \return \b true if Actions and Rules in the group can be skipped
+bool Action::isExpendableGroup(const std::string &g)
+
+{
+  for(int4 i=0;expendable_groups[i][0] != '\0';++i) {
+    if (g == expendable_groups[i])
+      return true;
+  }
+  return false;
+}
+
+/// \param s is the output stream
+/// \param nanos is a time in nanoseconds
+static void printMillis(ostream &s,uint8 nanos)
+
+{
+  streamsize prec = s.precision();
+  s << " Time=" << fixed << setprecision(3) << (double)nanos / 1000000.0 << "ms";
+  s.unsetf(ios::floatfield);
+  s.precision(prec);
+}
+
+/// \param s is the output stream
+/// \param bytes is a memory size in bytes
+static void printKilobytes(ostream &s,uint8 bytes)
+
+{
+  s << " Peak=" << dec << (bytes + 1023) / 1024 << "KB";
+}
 
 /// Specify the name, group, and properties of the Action
 /// \param f is the collection of property flags
@@ -31,12 +71,17 @@ Action::Action(uint4 f,const std::string &nm,const std::string &g)
 
 {
   flags = f;
+  if (isExpendableGroup(g))
+    flags |= rule_expendable;
   status = status_start;
   breakpoint = 0;
   name = nm;
   basegroup = g;
   count_tests = 0;
   count_apply = 0;
+  count_time = 0;
+  count_mempeak = 0;
+  traceid = -1;
 }
 
 /// If enabled, issue a warning that this Action has been applied
@@ -91,12 +136,38 @@ bool Action::turnOffDebug(const std::string &nm)
 }
 #endif
 
-/// Print out the collected statistics for the Action to stream
+/// Print out the collected statistics for the Action to stream.
+/// The time is only printed if timing has been enabled, and the peak memory
+/// only if memory tracking has been enabled.
 /// \param s is the output stream
 void Action::printStatistics(std::ostream &s) const
 
 {
-  s << name << dec << " Tested=" << count_tests << " Applied=" << count_apply << endl;
+  s << name << dec << " Tested=" << count_tests << " Applied=" << count_apply;
+  if (timing_on || count_time != 0)
+    printMillis(s,count_time);
+  if (memory_on || count_mempeak != 0)
+    printKilobytes(s,count_mempeak);
+  s << endl;
+}
+
+/// Each record lists the kind (\e action or \e rule), the path of the Action or Rule
+/// from the root Action, the number of tests and applications, the time spent in
+/// nanoseconds, and the peak memory in bytes. Times for groups include the time spent in
+/// their members.
+/// \param s is the output stream
+/// \param path is the path of the parent of \b this Action (with a trailing '/' if not empty)
+void Action::printStatisticsCsv(ostream &s,const std::string &path) const
+
+{
+  s << "action," << path << name << ',' << dec << count_tests << ',' << count_apply << ',' << count_time << ',' << count_mempeak << endl;
+}
+
+/// \param s is the output stream
+void Action::printCsvHeader(ostream &s)
+
+{
+  s << "kind,name,tested,applied,nanoseconds,peakbytes" << endl;
 }
 
 /// \param data is the new function \b this Action may affect
@@ -113,6 +184,22 @@ void Action::resetStats(void)
 {
   count_tests = 0;
   count_apply = 0;
+  count_time = 0;
+  count_mempeak = 0;
+}
+
+/// Counts and times are summed, and the larger memory peak is kept.  Each thread applies
+/// its own copy of an Action, so the counters of a copy are only touched by one thread and
+/// need no synchronization; they are combined here, once the threads are done.
+/// \param op2 is a copy of \b this, cloned with the same grouplist
+void Action::mergeStatistics(const Action &op2)
+
+{
+  count_tests += op2.count_tests;
+  count_apply += op2.count_apply;
+  count_time += op2.count_time;
+  if (op2.count_mempeak > count_mempeak)
+    count_mempeak = op2.count_mempeak;
 }
 
 /// Check if there was an active \e action breakpoint on this Action
@@ -290,6 +377,8 @@ Rule *Action::getSubRule(const std::string &specify)
 /// called many times or none.  Generally the number of changes made by
 /// the action is returned, but if a breakpoint occurs -1 is returned.
 /// A successive call to perform() will "continue" from the break point.
+/// Any request made through the AnalysisInterrupt of the Architecture is acted on first,
+/// which throws AnalysisCancelled if the analysis has been cancelled.
 /// \param data is the function being acted on
 /// \return the number of changes or -1
 int4 Action::perform(Funcdata &data)
@@ -297,7 +386,15 @@ int4 Action::perform(Funcdata &data)
 {
   int4 res;
 
+  data.getArch()->checkInterrupt();
+  if (status == status_start && (flags & rule_expendable)!=0 && data.checkBudget())
+    return 0;			// Out of budget, skip optional work
+  if (traceid < 0 && TraceLog::isEnabled())
+    traceid = TraceLog::registerKind(name,"action");
+  TraceSpan span(traceid);
+  WorkNote note(data.getAddress().getOffset(),name.c_str());
   do {
+    note.nextPass();
     switch(status) {
     case status_start:
       count = 0;		// No changes made yet by this action
@@ -313,7 +410,13 @@ int4 Action::perform(Funcdata &data)
 #ifdef OPACTION_DEBUG
       data.debugActivate();
 #endif
-      res = apply(data);	// Start or continue action
+      if (timing_on) {
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	res = apply(data);	// Start or continue action
+	count_time += elapsedNanos(start);
+      }
+      else
+	res = apply(data);	// Start or continue action
 #ifdef OPACTION_DEBUG
       data.debugModPrint(getName());
 #endif
@@ -322,8 +425,14 @@ int4 Action::perform(Funcdata &data)
 	return res;
       }
       else if (lcount < count) { // Action has been applied
+	data.markModified();	// Not every change goes through the op methods
 	issueWarning(data.getArch());
 	count_apply += 1;
+	if (memory_on) {
+	  uint8 cur = data.recordMemory(name);
+	  if (cur > count_mempeak)
+	    count_mempeak = cur;
+	}
 	if (checkActionBreak()) {
 	  status = status_actionbreak;
 	  return -1;		// Indicate action breakpoint
@@ -413,6 +522,29 @@ void ActionGroup::resetStats(void)
     (*iter)->resetStats();
 }
 
+/// Sub-actions are matched up by position, stopping at the first one whose name differs.
+/// \param op2 is a copy of \b this, cloned with the same grouplist
+void ActionGroup::mergeStatistics(const Action &op2)
+
+{
+  Action::mergeStatistics(op2);
+  const ActionGroup *grp2 = dynamic_cast<const ActionGroup *>(&op2);
+  if (grp2 == (const ActionGroup *)0) return;
+  for(int4 i=0;i<list.size() && i<grp2->list.size();++i) {
+    if (list[i]->getName() != grp2->list[i]->getName()) break;
+    list[i]->mergeStatistics(*grp2->list[i]);
+  }
+}
+
+/// \param tested collects the names of Rules that were tried at least once
+/// \param applied collects the names of Rules that applied at least once
+void ActionGroup::collectRuleUsage(set<std::string> &tested,set<std::string> &applied) const
+
+{
+  for(int4 i=0;i<list.size();++i)
+    list[i]->collectRuleUsage(tested,applied);
+}
+
 int4 ActionGroup::print(ostream &s,int4 num,int4 depth) const
 
 {
@@ -500,6 +632,8 @@ int4 ActionGroup::apply(Funcdata &data)
     state = list.begin();	// Initialize the derived action
   for(;state!=list.end();++state) {
     res = (*state)->perform(data);
+    if (res>=0)
+      data.reclaimRetiredOps();	// Between Actions, free destroyed ops once they outnumber the live ones
     if (res>0) {		// A change was made
       count  += res;
       if (checkActionBreak()) {	// Check if this is an action breakpoint
@@ -535,6 +669,9 @@ void ActionRestartGroup::reset(Funcdata &data)
 
 {
   curstart = 0;
+  data.startBudget();
+  data.resetMemoryPeak();
+  data.getMetrics().begin();
   ActionGroup::reset(data);
 }
 
@@ -553,6 +690,10 @@ int4 ActionRestartGroup::apply(Funcdata &data)
     }
     if (data.isJumptableRecoveryOn()) // Don't restart within jumptable recovery
       return 0;
+    if (data.checkBudget()) {	// Out of budget, finish with the current analysis
+      curstart = -1;
+      return 0;
+    }
     curstart += 1;
     if (curstart > maxrestarts) {
       data.warningHeader("Exceeded maximum restarts with more pending");
@@ -604,6 +745,16 @@ void ActionGroup::printStatistics(ostream &s) const
     (*iter)->printStatistics(s);
 }
 
+void ActionGroup::printStatisticsCsv(ostream &s,const std::string &path) const
+
+{
+  Action::printStatisticsCsv(s,path);
+  std::string subpath = path + name + '/';
+  std::vector<Action *>::const_iterator iter;
+  for(iter = list.begin();iter!=list.end();++iter)
+    (*iter)->printStatisticsCsv(s,subpath);
+}
+
 /// \param g is the groupname to which \b this Rule belongs
 /// \param fl is the set of properties
 /// \param nm is the name of the Rule
@@ -611,11 +762,15 @@ Rule::Rule(const std::string &g,uint4 fl,const std::string &nm)
 
 {
   flags = fl;
+  if (Action::isExpendableGroup(g))
+    flags |= expendable;
   name = nm;
   breakpoint = 0;
   basegroup = g;
-  count_tests = 0;
-  count_apply = 0;
+  constslots = 0;
+  writtenslots = 0;
+  maxoutsize = 0;
+  locality = local_function;
 }
 
 /// This method is called whenever \b this Rule applies. If warnings have been
@@ -633,21 +788,15 @@ void Rule::issueWarning(Architecture *glb)
 }
 
 /// Any state that is specific to a particular function is cleared by this method.
-/// This method can be used to initialize a Rule based on a new function it will apply to
+/// This method can be used to initialize a Rule based on a new function it will apply to.
+/// A Rule shared by pools on different threads is reset by each of them, so
+/// the base method only writes to the Rule if a warning has actually been given.
 /// \param data is the \e new function about to be transformed
 void Rule::reset(Funcdata &data)
 
 {
-  flags &= ~warnings_given;	// Indicate that warning has not yet been given
-}
-
-/// Counts of when this Rule has been attempted/applied are reset to zero.
-/// Derived Rules may reset their own statistics.
-void Rule::resetStats(void)
-
-{
-  count_tests = 0;
-  count_apply = 0;
+  if ((flags & warnings_given)!=0)
+    flags &= ~warnings_given;	// Indicate that warning has not yet been given
 }
 
 #ifdef OPACTION_DEBUG
@@ -682,10 +831,25 @@ bool Rule::turnOffDebug(const std::string &nm)
 /// This method is intended for console mode debugging. Derived Rules may
 /// override this to display their own statistics.
 /// \param s is the output stream
-void Rule::printStatistics(ostream &s) const
+/// \param stats are the counts kept by the pool for \b this Rule
+void Rule::printStatistics(ostream &s,const RuleStatistics &stats) const
+
+{
+  s << name << dec << " Tested=" << stats.count_tests << " Applied=" << stats.count_apply;
+  if (Action::isTiming() || stats.count_time != 0)
+    printMillis(s,stats.count_time);
+  s << endl;
+}
+
+/// The record has the same form as those printed by Action::printStatisticsCsv().
+/// Rules do not measure memory, so their peak is always zero.
+/// \param s is the output stream
+/// \param path is the path of the ActionPool containing \b this Rule (with a trailing '/')
+/// \param stats are the counts kept by the pool for \b this Rule
+void Rule::printStatisticsCsv(ostream &s,const std::string &path,const RuleStatistics &stats) const
 
 {
-  s << name << dec << " Tested=" << count_tests << " Applied=" << count_apply << endl;
+  s << "rule," << path << name << ',' << dec << stats.count_tests << ',' << stats.count_apply << ',' << stats.count_time << ",0" << endl;
 }
 
 /// Populate the given array with all possible OpCodes this Rule might apply to.
@@ -713,29 +877,53 @@ bool Rule::checkActionBreak(void)
   return false;			// Breakpoint was not active
 }
 
-ActionPool::~ActionPool(void)
+/// The map is created on first use, so registrations made by static initializers in other
+/// translation units are safe.
+/// \return the map from Rule name to factory
+std::map<std::string,NativeRuleRegistry::Factory> &NativeRuleRegistry::getMap(void)
 
 {
-  std::vector<Rule *>::iterator iter;
+  static std::map<std::string,Factory> factories;
+  return factories;
+}
 
-  for(iter=allrules.begin();iter!=allrules.end();++iter)
-    delete *iter;
+/// \param nm is the name of the dynamic rule
+/// \param group is the group the Rule should belong to
+/// \return the new Rule or null if no native class was registered under the name
+Rule *NativeRuleRegistry::build(const std::string &nm,const std::string &group)
+
+{
+  std::map<std::string,Factory>::const_iterator iter = getMap().find(nm);
+  if (iter == getMap().end()) return (Rule *)0;
+  return (*(*iter).second)(group);
+}
+
+ActionPool::~ActionPool(void)
+
+{
+  for(int4 i=0;i<allrules.size();++i)
+    if (ownsrule[i])
+      delete allrules[i];
 }
 
 /// This method should only be invoked during construction of this ActionPool
 /// A single Rule is added to the pool. The Rule's OpCode is inspected by this method.
 /// \param rl is the Rule to add
-void ActionPool::addRule(Rule *rl)
+/// \param owned is \b true if \b this pool deletes the Rule, \b false if it is shared
+void ActionPool::addRule(Rule *rl,bool owned)
 
 {
   std::vector<uint4> oplist;
   std::vector<uint4>::iterator iter;
 
+  int4 index = allrules.size();
   allrules.push_back(rl);
+  rulestats.emplace_back();
+  ownsrule.push_back(owned);
 
   rl->getOpList(oplist);
   for(iter=oplist.begin();iter!=oplist.end();++iter)
-    perop[*iter].push_back(rl);	// Add rule to list for each op it registers for
+    perop[*iter].push_back(index);	// Add rule to list for each op it registers for
 }
 
 int4 ActionPool::print(ostream &s,int4 num,int4 depth) const
@@ -803,7 +991,8 @@ Rule *ActionPool::getSubRule(const std::string &specify)
 /// Action breakpoints are checked if the Rule successfully applies.
 /// 0 is returned for no breakpoint, -1 if a breakpoint occurs.
 /// If a breakpoint did occur, an additional call to processOp() will
-/// pick up where it left off before the breakpoint. The PcodeOp iterator is advanced.
+/// pick up where it left off before the breakpoint. The caller advances to the next PcodeOp
+/// only once 0 is returned.
 /// \param op is the current PcodeOp
 /// \param data is the function being transformed
 /// \return 0 if no breakpoint, -1 otherwise
@@ -814,27 +1003,42 @@ int4 ActionPool::processOp(PcodeOp *op,Funcdata &data)
   int4 res;
   uint4 opc;
 
-  if (op->isDead()) {
-    op_state++;
-    data.opDeadAndGone(op);
-    rule_index = 0;
-    return 0;
-  }
+  if (rule_index == 0)
+    data.getArch()->checkInterrupt();
+  WorkSlot *workslot = WorkNote::ruleSlot();
   opc = op->code();
   while(rule_index < perop[opc].size()) {
-    rl = perop[opc][rule_index++];
+    int4 index = perop[opc][rule_index++];
+    rl = allrules[index];
     if (rl->isDisabled()) continue;
+    if (rl->isExpendable() && data.isBudgetExhausted()) continue;
+    if (phase != phase_all && (rl->getLocality() == Rule::local_function) != (phase == phase_global))
+      continue;
+    if (!rl->checkFilter(op)) continue;		// Rule can't apply, skip the virtual call
 #ifdef OPACTION_DEBUG
     data.debugActivate();
 #endif
-    rl->count_tests += 1;
-    res = rl->applyOp(op,data);
+    RuleStatistics &stats(rulestats[index]);
+    stats.count_tests += 1;
+    if (workslot != (WorkSlot *)0)
+      workslot->rule = rl->getName().c_str();
+    if (timing_on) {
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      res = rl->applyOp(op,data);
+      stats.count_time += elapsedNanos(start);
+    }
+    else
+      res = rl->applyOp(op,data);
+    if (workslot != (WorkSlot *)0)
+      workslot->rule = (const char *)0;
 #ifdef OPACTION_DEBUG
     data.debugModPrint(rl->getName());
 #endif
     if (res>0) {
-      rl->count_apply += 1;
+      stats.count_apply += 1;
       count += res;
+      data.consumeBudget(res);
+      data.markModified();
       rl->issueWarning(data.getArch()); // Check if we need to issue a warning
       if (rl->checkActionBreak())
         return -1;
@@ -856,37 +1060,153 @@ int4 ActionPool::processOp(PcodeOp *op,Funcdata &data)
       rule_index = 0;	
     }
   }
-  op_state++;
   rule_index = 0;
 
   return 0;
 }
 
-int4 ActionPool::apply(Funcdata &data)
+/// Sort by sequence number, the order of the PcodeOpTree. A retired PcodeOp may share
+/// its sequence number with a live one, so ties are broken by address to keep duplicates together.
+/// \param a is the first PcodeOp to compare
+/// \param b is the second PcodeOp to compare
+/// \return \b true if \b a should be visited before \b b
+static bool compareWork(const PcodeOp *a,const PcodeOp *b)
 
 {
-  if (status != status_mid) {
-    op_state = data.beginOpAll();	// Initialize the derived action
-    rule_index = 0;
+  if (a->getSeqNum() < b->getSeqNum()) return true;
+  if (b->getSeqNum() < a->getSeqNum()) return false;
+  return (a < b);
+}
+
+/// If the pool repeats, collection of modified PcodeOps is started for the following pass.
+/// \param data is the function being transformed
+/// The PcodeOps are only partitioned if the function has at least Architecture::pool_partition
+/// of them.  The partitions are the basic blocks, which are laid out one after another in
+/// \b worklist.  PcodeOps created during the local phase are not in the list, but the pass
+/// that follows visits them, as they are modified.
+/// \param data is the function being transformed
+/// \return \b true if the pass should be done in phases
+bool ActionPool::beginPartitions(Funcdata &data)
+
+{
+  uint4 threshold = data.getArch()->pool_partition;
+  if (threshold == 0) return false;
+  const BlockGraph &graph(data.getBasicBlocks());
+  uint4 numops = 0;
+  for(int4 i=0;i<graph.getSize();++i)
+    numops += ((BlockBasic *)graph.getBlock(i))->sizeOp();
+  if (numops < threshold) return false;
+  worklist.clear();
+  worklist.reserve(numops);
+  for(int4 i=0;i<graph.getSize();++i) {
+    BlockBasic *bl = (BlockBasic *)graph.getBlock(i);
+    worklist.insert(worklist.end(),bl->beginOp(),bl->endOp());
   }
-  for(;op_state!=data.endOpAll();)
-	  if (0!=processOp((*op_state).second,data)) return -1;
+  work_index = 0;
+  return true;
+}
+
+void ActionPool::beginFullPass(Funcdata &data)
+
+{
+  fullpass = true;
+  passcount = count;
+  op_state = data.beginOpAll();
+  rule_index = 0;
+  phase = beginPartitions(data) ? phase_local : phase_all;
+  if ((flags & rule_repeatapply)!=0)
+    data.beginDirtyTracking();
+}
 
+/// The PcodeOps collected by the Funcdata during the previous pass are visited
+/// in sequence number order, as a full pass would visit them.
+/// \param data is the function being transformed
+void ActionPool::beginPartialPass(Funcdata &data)
+
+{
+  fullpass = false;
+  passcount = count;
+  phase = phase_all;
+  data.takeDirtyOps(worklist);
+  sort(worklist.begin(),worklist.end(),compareWork);
+  worklist.erase(unique(worklist.begin(),worklist.end()),worklist.end());
+  work_index = 0;
+  rule_index = 0;
+}
+
+int4 ActionPool::apply(Funcdata &data)
+
+{
+  if (status == status_repeat && data.checkBudget()) {
+    data.endDirtyTracking();	// Out of budget, don't repeat the pool
+    return 0;
+  }
+  if (status != status_mid) {	// Initialize the derived action
+    if (status == status_repeat && data.isDirtyTracking())
+      beginPartialPass(data);
+    else
+      beginFullPass(data);
+  }
+  if (!fullpass) {
+    for(;work_index<worklist.size();++work_index) {
+      PcodeOp *op = worklist[work_index];
+      if (op->isDead()) continue;	// Dead ops are retired by the next full pass
+      if (0!=processOp(op,data)) return -1;
+    }
+    if (count != passcount)
+      return 0;			// Repeat with the ops modified by this pass
+    beginFullPass(data);	// Nothing changed, confirm with a full pass
+  }
+  if (phase == phase_local) {
+    for(;work_index<worklist.size();++work_index) {
+      PcodeOp *op = worklist[work_index];
+      if (op->isDead()) continue;
+      if (0!=processOp(op,data)) return -1;
+    }
+    phase = phase_global;	// Now the Rules that reach across blocks, in sequence order
+    op_state = data.beginOpAll();
+  }
+  while(op_state!=data.endOpAll()) {
+    PcodeOp *op = (*op_state).second;
+    if (op->isDead()) {
+      op_state++;
+      data.opDeadAndGone(op);
+      continue;
+    }
+    if (0!=processOp(op,data)) return -1;
+    op_state++;
+  }
+  if (count == passcount || (flags & rule_repeatapply)==0)
+    data.endDirtyTracking();	// The pool will not repeat
   return 0;			// Indicate successful completion
 }
 
+/// If the grouplist asks for Rules to be shared, each Rule of \b this pool in the grouplist that
+/// has no private state is given to the clone as is, and only the others are cloned.  The clone
+/// must not outlive \b this, and the shared Rules must not be reconfigured while it is in use.
+/// \param grouplist is the list of groups being cloned
+/// \return the cloned pool or null if it would have no Rules
 Action *ActionPool::clone(const ActionGroupList &grouplist) const
 
 {
   ActionPool *res = (ActionPool *)0;
   std::vector<Rule *>::const_iterator iter;
   Rule *rl;
+  bool owned;
   for(iter=allrules.begin();iter!=allrules.end();++iter) {
-    rl = (*iter)->clone(grouplist);
+    if (grouplist.skips((*iter)->getName())) continue;
+    if (grouplist.isShareRules() && !(*iter)->hasPrivateState()) {
+      rl = grouplist.contains((*iter)->getGroup()) ? *iter : (Rule *)0;
+      owned = false;
+    }
+    else {
+      rl = (*iter)->clone(grouplist);
+      owned = true;
+    }
     if (rl != (Rule *)0) {
       if (res == (ActionPool *)0)
 	res = new ActionPool(flags,getName());
-      res->addRule(rl);
+      res->addRule(rl,owned);
     }
   }
   return res;
@@ -905,11 +1225,23 @@ void ActionPool::reset(Funcdata &data)
 void ActionPool::resetStats(void)
 
 {
-  std::vector<Rule *>::iterator iter;
-
   Action::resetStats();
-  for(iter=allrules.begin();iter!=allrules.end();++iter)
-    (*iter)->resetStats();
+  for(int4 i=0;i<rulestats.size();++i)
+    rulestats[i] = RuleStatistics();
+}
+
+/// Rules are matched up by position, stopping at the first one whose name differs.
+/// \param op2 is a copy of \b this, cloned with the same grouplist
+void ActionPool::mergeStatistics(const Action &op2)
+
+{
+  Action::mergeStatistics(op2);
+  const ActionPool *pool2 = dynamic_cast<const ActionPool *>(&op2);
+  if (pool2 == (const ActionPool *)0) return;
+  for(int4 i=0;i<allrules.size() && i<pool2->allrules.size();++i) {
+    if (allrules[i]->getName() != pool2->allrules[i]->getName()) break;
+    rulestats[i].merge(pool2->rulestats[i]);
+  }
 }
 
 #ifdef OPACTION_DEBUG
@@ -940,14 +1272,35 @@ bool ActionPool::turnOffDebug(const std::string &nm)
 }
 #endif
 
-void ActionPool::printStatistics(ostream &s) const
+/// \param tested collects the names of Rules that were tried at least once
+/// \param applied collects the names of Rules that applied at least once
+void ActionPool::collectRuleUsage(set<std::string> &tested,set<std::string> &applied) const
 
 {
-  std::vector<Rule *>::const_iterator iter;
+  for(int4 i=0;i<allrules.size();++i) {
+    const Rule *rl = allrules[i];
+    if (rulestats[i].count_tests != 0)
+      tested.insert(rl->getName());
+    if (rulestats[i].count_apply != 0)
+      applied.insert(rl->getName());
+  }
+}
+
+void ActionPool::printStatistics(ostream &s) const
 
+{
   Action::printStatistics(s);
-  for(iter=allrules.begin();iter!=allrules.end();++iter)
-    (*iter)->printStatistics(s);
+  for(int4 i=0;i<allrules.size();++i)
+    allrules[i]->printStatistics(s,rulestats[i]);
+}
+
+void ActionPool::printStatisticsCsv(ostream &s,const std::string &path) const
+
+{
+  Action::printStatisticsCsv(s,path);
+  std::string subpath = path + name + '/';
+  for(int4 i=0;i<allrules.size();++i)
+    allrules[i]->printStatisticsCsv(s,subpath,rulestats[i]);
 }
 
 const char ActionDatabase::universalname[] = "universal";
@@ -992,6 +1345,36 @@ Action *ActionDatabase::setCurrent(const std::string &actname)
   return currentact;
 }
 
+/// The copy is derived from the \e universal Action using the grouplist of the current \e root Action,
+/// so it performs the same transformations but shares no state with the original. This allows separate threads
+/// to each apply their own copy. The caller takes ownership of the returned Action.
+/// \param sharerules is \b true if the copy should share stateless Rules with the \e universal Action
+/// \return the new copy of the current \e root Action
+Action *ActionDatabase::cloneCurrent(bool sharerules) const
+
+{
+  if (currentact == (Action *)0)
+    throw LowlevelError("No current root action");
+  return cloneAction(currentactname,sharerules);
+}
+
+/// The copy is derived from the \e universal Action using the grouplist of the named \e root Action,
+/// which does not need to be the current one. The caller takes ownership of the returned Action.
+/// Sharing Rules makes the copy quicker to build, and several threads applying copies then use
+/// the same Rule objects.  Only Rules that keep no state of their own while applying are shared,
+/// and the counts of each copy are still its own (see RuleStatistics).
+/// \param actname is the name of the \e root Action
+/// \param sharerules is \b true if the copy should share stateless Rules with the \e universal Action
+/// \return the new copy of the \e root Action
+Action *ActionDatabase::cloneAction(const std::string &actname,bool sharerules) const
+
+{
+  if (!sharerules)
+    return getAction(universalname)->clone(getGroup(actname));
+  ActionGroupList grouplist(getGroup(actname));
+  grouplist.setShareRules(true);
+  return getAction(universalname)->clone(grouplist);
+}
 
 /// A particular group is either added or removed from the grouplist defining
 /// a particular \e root Action.  The \e root Action is then (re)derived from the universal
@@ -1067,6 +1450,49 @@ bool ActionDatabase::removeFromGroup(const std::string &grp, const std::string &
   return (curgrp.list.erase(basegrp) > 0);
 }
 
+/// The Rule is not cloned into the \e root Action, even though its group is in the grouplist.
+/// Do not use to redefine a \e root Action that has already been instantiated.
+/// \param grp is the name of the \e root Action
+/// \param rulename is the name of the Rule
+/// \return \b true if the Rule was not already left out
+bool ActionDatabase::skipRule(const std::string &grp,const std::string &rulename)
+
+{
+  ActionGroupList &curgrp( groupmap[ grp ] );
+  return curgrp.skiprules.insert( rulename ).second;
+}
+
+/// The statistics accumulated by the instantiated \e base root Action, over every function it
+/// has been applied to since its statistics were last reset, say which of its Rules were tried
+/// and never applied.  A new \e root Action is created with the same grouplist, leaving out those
+/// Rules.  Over a corpus of functions built by one compiler, this gives a pipeline that doesn't
+/// spend time testing Rules that never fire for that compiler.  A Rule that was never tried is kept,
+/// as nothing is known about it.  If the new \e root Action already exists, it is replaced.
+/// \param basename is the name of the \e root Action whose statistics are used
+/// \param newname is the name of the new \e root Action
+/// \param skipped will hold the names of the Rules left out
+/// \return the number of Rules left out
+int4 ActionDatabase::deriveProfile(const std::string &basename,const std::string &newname,vector<std::string> &skipped)
+
+{
+  Action *base = getAction(basename);
+  set<std::string> tested,applied;
+  base->collectRuleUsage(tested,applied);
+  ActionGroupList newgrp( getGroup(basename) );
+  set<std::string>::const_iterator iter;
+  for(iter=tested.begin();iter!=tested.end();++iter) {
+    if (applied.find(*iter) != applied.end()) continue;
+    if (newgrp.skiprules.insert(*iter).second)
+      skipped.push_back(*iter);
+  }
+  groupmap[newname] = newgrp;
+  Action *newact = getAction(universalname)->clone(newgrp);
+  registerAction(newname,newact);
+  if (newname == currentactname)
+    currentact = newact;
+  return skipped.size();
+}
+
 /// \param nm is the name of the \e root Action
 Action *ActionDatabase::getAction(const std::string &nm) const
 
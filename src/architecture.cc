@@ -16,6 +16,9 @@
 // Set up decompiler for specific architectures
 
 #include "coreaction.hh"
+#include "resultcache.hh"
+#include "flowsummary.hh"
+#include "insnindex.hh"
 #ifdef CPUI_RULECOMPILE
 #include "rulecompile.hh"
 #endif
@@ -103,6 +106,12 @@ Architecture::Architecture(void)
   pointer_lowerbound = 0x1000;
   funcptr_align = 0;
   flowoptions = 0;
+  budget_millis = 0;
+  budget_rules = 0;
+  pool_partition = 0;
+  heritage_threads = 1;
+  flow_op_budget = 0;
+  release_analysis = false;
   defaultfp = (ProtoModel *)0;
   defaultReturnAddr.space = (AddrSpace *)0;
   evalfp_current = (ProtoModel *)0;
@@ -118,6 +127,11 @@ Architecture::Architecture(void)
   print = PrintLanguageCapability::getDefault()->buildLanguage(this);
   printlist.push_back(print);
   options = new OptionDatabase(this);
+  jumpcache = (JumpTableCache *)0;
+  resultcache = (ResultCache *)0;
+  flowsummary = (FlowSummaryDb *)0;
+  insnindex = (InstructionIndex *)0;
+  interrupt = (AnalysisInterrupt *)0;
   loadersymbols_parsed = false;
 #ifdef CPUI_STATISTICS
   stats = new Statistics();
@@ -168,6 +182,14 @@ Architecture::~Architecture(void)
     delete cpool;
   if (context != (ContextDatabase *)0)
     delete context;
+  if (jumpcache != (JumpTableCache *)0)
+    delete jumpcache;
+  if (resultcache != (ResultCache *)0)
+    delete resultcache;
+  if (flowsummary != (FlowSummaryDb *)0)
+    delete flowsummary;
+  if (insnindex != (InstructionIndex *)0)
+    delete insnindex;
 }
 
 /// The Architecture maintains the set of prototype models that can
@@ -245,8 +267,89 @@ void Architecture::clearAnalysis(Funcdata *fd)
   commentdb->clearType(fd->getAddress(),Comment::warning|Comment::warningheader);
 }
 
+/// This is for functions that won't be decompiled again soon, such as in a batch run that
+/// keeps only the printed output.  Beyond clearAnalysis(), storage the function would reuse
+/// for its next decompile is freed.
+/// \param fd is the function
+void Architecture::releaseAnalysis(Funcdata *fd)
+
+{
+  clearAnalysis(fd);
+  fd->releaseStorage();
+}
+
+/// In incremental mode, results that only depend on the code of a function (currently the
+/// recovered jump-tables) are kept when the analysis of the function is cleared, and are reused
+/// when flow is regenerated after a restart or when the function is decompiled again.  A kept
+/// jump-table is only reused while the bytes its recovery read are unchanged.  If a file is given,
+/// jump-tables stored in it by an earlier session are loaded, and new ones are appended to it.
+/// Turning the mode off discards anything kept so far.
+/// \param val is \b true to turn incremental mode on
+/// \param file is the file to persist jump-tables in, or an empty string to keep them in memory
+void Architecture::setIncremental(bool val,const string &file)
+
+{
+  if (val) {
+    if (jumpcache == (JumpTableCache *)0)
+      jumpcache = new JumpTableCache(this);
+    if (!file.empty() && file != jumpcache->getFile())
+      jumpcache->attachFile(file);
+  }
+  else if (jumpcache != (JumpTableCache *)0) {
+    delete jumpcache;
+    jumpcache = (JumpTableCache *)0;
+  }
+}
+
+/// When the cache is on, the output for a function is stored after it is decompiled, and is
+/// reused the next time the same function is decompiled with the same inputs. Any existing cache
+/// is discarded first, so this can also be used to switch directories.
+/// \param val is \b true to turn caching on
+/// \param dir is the directory to store results in, or an empty string to keep them in memory
+void Architecture::setResultCache(bool val,const string &dir)
+
+{
+  if (resultcache != (ResultCache *)0) {
+    delete resultcache;
+    resultcache = (ResultCache *)0;
+  }
+  if (val)
+    resultcache = new ResultCache(this,dir);
+}
+
+/// The store is a file mapped into memory, and any number of decompiler processes can read and
+/// add results in it at the same time.  Any existing cache is discarded first.
+/// \param file is the file backing the store
+/// \param size is the size of the file, if it has to be created
+void Architecture::setSharedResultCache(const string &file,uint8 size)
+
+{
+  if (resultcache != (ResultCache *)0) {
+    delete resultcache;
+    resultcache = (ResultCache *)0;
+  }
+  SharedResultStore *store = new SharedResultStore(file,size);
+  resultcache = new ResultCache(this,store);
+}
+
+/// Any database already in use is discarded, without being saved.  Summaries in the file are read
+/// immediately, and call sites then take their prototypes from them (see FlowSummaryDb).
+/// \param file is the file holding the database, or an empty string to stop using one
+void Architecture::setFlowSummary(const string &file)
+
+{
+  if (flowsummary != (FlowSummaryDb *)0) {
+    delete flowsummary;
+    flowsummary = (FlowSummaryDb *)0;
+  }
+  if (file.size() != 0)
+    flowsummary = new FlowSummaryDb(this,file);
+}
+
 /// Symbols do not necessarily need to be available for the decompiler.
-/// This routine loads all the \e load \e image knows about into the symbol table
+/// This routine loads all the \e load \e image knows about into the symbol table.
+/// The symbols are collected first and inserted in address order, which keeps the cost of
+/// filling the global scope down when an image has a very large number of symbols.
 void Architecture::readLoaderSymbols(void)
 
 {
@@ -254,11 +357,30 @@ void Architecture::readLoaderSymbols(void)
   Scope *scope = symboltab->getGlobalScope();
   loader->openSymbols();
   loadersymbols_parsed = true;
+  vector<LoadImageFunc> records;
   LoadImageFunc record;
   while(loader->getNextSymbol(record)) {
-    scope->addFunction(record.address,record.name);
+    records.push_back(record);
   }
   loader->closeSymbols();
+  stable_sort(records.begin(),records.end());	// Insert in address order, keeping the loader's order otherwise
+  vector<Symbol *> syms;
+  vector<Address> addrs;
+  syms.reserve(records.size());
+  addrs.reserve(records.size());
+  for(int4 i=0;i<records.size();++i) {
+    const LoadImageFunc &rec(records[i]);
+    if (i > 0 && rec.address == records[i-1].address && rec.name == records[i-1].name)
+      continue;			// Same symbol listed twice (as in static and dynamic tables)
+    SymbolEntry *overlap = scope->queryContainer(rec.address,1,Address());
+    if (overlap != (SymbolEntry *)0)
+      printMessage("WARNING: Function "+rec.name+" overlaps object: "+overlap->getSymbol()->getName());
+    else if (!addrs.empty() && rec.address.overlap(0,addrs.back(),min_funcsymbol_size) >= 0)
+      printMessage("WARNING: Function "+rec.name+" overlaps object: "+syms.back()->getName());
+    syms.push_back(new FunctionSymbol(scope,rec.name,min_funcsymbol_size));
+    addrs.push_back(rec.address);
+  }
+  scope->addSymbolBatch(syms,addrs);	// Maps are appended in address order, without searching
 }
 
 /// For all registered p-code opcodes, return the corresponding OpBehavior object.
@@ -631,6 +753,11 @@ void Architecture::parseDynamicRule(const Element *el)
   if (groupname.size()==0)
     throw LowlevelError("Dynamic rule has no group");
   if (enabled == "false") return;
+  Rule *nativerule = NativeRuleRegistry::build(rulename,groupname);
+  if (nativerule != (Rule *)0) {	// A compiled version of the rule is linked in
+    extra_pool_rules.push_back(nativerule);
+    return;
+  }
 #ifdef CPUI_RULECOMPILE
   Rule *dynrule = RuleGeneric::build(rulename,groupname,el->getContent());
   extra_pool_rules.push_back(dynrule);
@@ -1151,6 +1278,49 @@ Address SegmentedResolver::resolve(uintb val,int4 sz,const Address &point)
 
 #ifdef CPUI_STATISTICS
 
+ShardedCounter::ShardedCounter(void)
+
+{
+  for(int4 i=0;i<numshards;++i) {
+    shards[i].count = 0;
+    shards[i].mark = 0;
+  }
+}
+
+/// Threads are dealt shards in the order they first use any counter, so up to
+/// \b numshards threads each get a shard to themselves.
+/// \return the index of the shard for the current thread
+int4 ShardedCounter::threadShard(void)
+
+{
+  static std::atomic<int4> nextshard(0);
+  static thread_local int4 shard = nextshard.fetch_add(1,std::memory_order_relaxed) % numshards;
+  return shard;
+}
+
+/// The shards are read one at a time, so the sum is exact only once all the threads adding to it are done.
+/// \return the total count
+uintb ShardedCounter::total(void) const
+
+{
+  uintb res = 0;
+  for(int4 i=0;i<numshards;++i)
+    res += shards[i].count.load(std::memory_order_relaxed);
+  return res;
+}
+
+/// If the current thread shares its shard with another thread, the result includes what the other thread added.
+/// \return the amount added to the current thread's shard since the last call
+uintb ShardedCounter::takeLocal(void)
+
+{
+  Shard &sh(shards[threadShard()]);
+  uintb cur = sh.count.load(std::memory_order_relaxed);
+  uintb res = cur - sh.mark;
+  sh.mark = cur;
+  return res;
+}
+
 Statistics::Statistics(void)
 
 {
@@ -1158,8 +1328,6 @@ Statistics::Statistics(void)
 //   numvar = 0;
 //   coversum = 0;
 //   coversumsq = 0;
-  castcount = 0;
-  lastcastcount = 0;
   castcountsq = 0;
 }
 
@@ -1192,14 +1360,13 @@ Statistics::~Statistics(void)
 //   }
 // }
 
-/// Calculate number of casts seen since last function, update variance
+/// Calculate number of casts the current thread has seen since its last function, update variance
 /// \param data is the function being analyzed
 void Statistics::process_cast(const Funcdata &data)
 
 {
-  uintb perfunc = castcount - lastcastcount;
-  lastcastcount = castcount;
-  castcountsq += perfunc*perfunc;
+  uintb perfunc = castcount.takeLocal();
+  castcountsq.fetch_add(perfunc*perfunc,std::memory_order_relaxed);
 }
 
 /// Gather various statistics for a single function and accumulate in global counts
@@ -1227,13 +1394,14 @@ void Statistics::printResults(std::ostream &s)
   //  s << "Average number of non-empty covers: " << average << endl;
   //  s << "Standard deviation: " << stddev << endl;
 
-  double average = ((double)castcount)/numfunc;
+  uintb totalcasts = castcount.total();
+  double average = ((double)totalcasts)/numfunc;
   double variance = ((double)castcountsq)/numfunc;
   variance -= average*average;
   double stddev = sqrt(variance);
 
   s << "Total functions = " << dec << numfunc << endl;
-  s << "Total casts = " << dec << castcount << endl;
+  s << "Total casts = " << dec << totalcasts << endl;
   s << "Average casts per function = " << average << endl;
   s << "        Standard deviation = " << stddev << endl;
 }
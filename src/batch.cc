@@ -0,0 +1,823 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "batch.hh"
+#include "printlanguage.hh"
+#include "tracespan.hh"
+
+#include <thread>
+#include <chrono>
+#include <cmath>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace GhidraDec {
+
+/// On platforms without thread affinity, the list is left empty.
+/// \param cpus will hold the CPUs the calling thread is allowed to run on
+static void getAllowedCpus(vector<int4> &cpus)
+
+{
+  cpus.clear();
+#ifdef __linux__
+  cpu_set_t mask;
+  if (sched_getaffinity(0,sizeof(mask),&mask) != 0) return;
+  for(int4 i=0;i<CPU_SETSIZE;++i) {
+    if (CPU_ISSET(i,&mask))
+      cpus.push_back(i);
+  }
+#endif
+}
+
+/// \param cpus is the list of CPUs the calling thread is to be allowed to run on
+static void setAllowedCpus(const vector<int4> &cpus)
+
+{
+#ifdef __linux__
+  if (cpus.empty()) return;
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  for(int4 i=0;i<cpus.size();++i)
+    CPU_SET(cpus[i],&mask);
+  sched_setaffinity(0,sizeof(mask),&mask);
+#endif
+}
+
+/// \param i is the index of the worker within its pool
+/// \param r is the cloned root Action (which \b this takes ownership of)
+BatchWorker::BatchWorker(int4 i,Action *r)
+
+{
+  index = i;
+  root = r;
+  numdecompiled = 0;
+  numfailed = 0;
+  seconds = 0.0;
+}
+
+BatchWorker::~BatchWorker(void)
+
+{
+  if (root != (Action *)0)
+    delete root;
+}
+
+/// \param g is the Architecture owning the functions
+/// \param cg is the call graph (with edges already built) to schedule over
+/// \param num is the number of worker threads to use
+BatchDecompiler::BatchDecompiler(Architecture *g,CallGraph *cg,int4 num)
+
+{
+  glb = g;
+  graph = cg;
+  numworkers = (num < 1) ? 1 : num;
+  logstream = (ostream *)0;
+  dependencies = true;
+  pinworkers = false;
+  numremaining = 0;
+}
+
+BatchDecompiler::~BatchDecompiler(void)
+
+{
+  clearWorkers();
+}
+
+void BatchDecompiler::clearWorkers(void)
+
+{
+  for(int4 i=0;i<workers.size();++i)
+    delete workers[i];
+  workers.clear();
+}
+
+/// The default is a clone of the current root Action.
+/// \return the new root Action, which the worker takes ownership of
+Action *BatchDecompiler::buildRoot(void) const
+
+{
+  return glb->allacts.cloneCurrent(true);	// Workers share the Rules that have no state
+}
+
+/// \param message is the message to emit
+void BatchDecompiler::log(const string &message)
+
+{
+  if (logstream == (ostream *)0) return;
+  std::lock_guard<std::mutex> lock(loglock);
+  *logstream << message << endl;
+}
+
+/// The sizes of the function's flow come from the instructions the Architecture's
+/// InstructionIndex holds after CallGraph::buildEdgesIndexed(), so nothing is decoded.  If the
+/// function hasn't been traced, its instructions are guessed from its size in bytes.
+/// \param item is the item to fill in
+/// \param node is the call graph node of the function
+void BatchDecompiler::measureItem(BatchItem &item,CallGraphNode *node) const
+
+{
+  if (glb->insnindex == (InstructionIndex *)0 || !glb->insnindex->measureFunction(item.fd->getAddress(),item.measure)) {
+    item.measure.numinsn = item.fd->getSize() / 4 + 1;
+    item.measure.numblocks = item.measure.numinsn / 8 + 1;
+    item.measure.numindirect = 0;
+  }
+  item.numcalls = node->numOutEdge();
+  item.cost = costmodel.insn * item.measure.numinsn + costmodel.block * item.measure.numblocks;
+  item.cost += costmodel.indirect * item.measure.numindirect + costmodel.call * item.numcalls;
+  item.seconds = 0.0;
+}
+
+/// The rank of an item is its own cost plus the largest rank among the callers waiting on it.
+/// Items are visited callers-first, in the reverse of an order in which they can be processed.
+/// Without dependencies, the rank is just the cost.
+void BatchDecompiler::rankItems(void)
+
+{
+  vector<int4> order;
+  vector<int4> pending(items.size());
+  for(int4 i=0;i<items.size();++i) {
+    pending[i] = items[i].pending;
+    if (pending[i] == 0)
+      order.push_back(i);
+  }
+  for(int4 i=0;i<order.size();++i) {
+    const vector<int4> &callers(items[order[i]].callers);
+    for(int4 j=0;j<callers.size();++j) {
+      pending[callers[j]] -= 1;
+      if (pending[callers[j]] == 0)
+	order.push_back(callers[j]);
+    }
+  }
+  for(int4 i=order.size()-1;i>=0;--i) {
+    BatchItem &item(items[order[i]]);
+    double maxcaller = 0.0;
+    for(int4 j=0;j<item.callers.size();++j) {
+      double rank = items[item.callers[j]].rank;
+      if (rank > maxcaller)
+	maxcaller = rank;
+    }
+    item.rank = item.cost + maxcaller;
+  }
+}
+
+/// Create an item for every node of the call graph that has code, ordered by the layer of the
+/// node in a CallGraphCsr, then by address, so that lower layers appear first.  For each item,
+/// predict its cost and count the callees that must be processed first.  A call between
+/// different strongly connected components is always a dependency.  Within a component, calls
+/// along the edges CallGraph snipped to break its cycles are not, so every item eventually
+/// becomes ready.
+void BatchDecompiler::buildSchedule(void)
+
+{
+  items.clear();
+  ready = priority_queue<pair<double,int4> >();
+  graph->initLeafWalk();		// Snip the cycles
+  CallGraphCsr csr;
+  csr.build(*graph);
+
+  vector<pair<int4,int4> > order;	// (layer,node) for every node with code
+  for(int4 i=0;i<csr.numNodes();++i) {
+    Funcdata *fd = csr.getNode(i)->getFuncdata();
+    if (fd != (Funcdata *)0 && !fd->hasNoCode())
+      order.push_back(pair<int4,int4>(csr.getLayer(i),i));
+  }
+  sort(order.begin(),order.end());
+  vector<int4> itemindex(csr.numNodes(),-1);
+  items.resize(order.size());
+  for(int4 k=0;k<order.size();++k) {
+    int4 i = order[k].second;
+    CallGraphNode *node = csr.getNode(i);
+    itemindex[i] = k;
+    items[k].fd = node->getFuncdata();
+    items[k].pending = 0;
+    items[k].layer = order[k].first;
+    measureItem(items[k],node);
+  }
+  for(int4 k=0;k<order.size();++k) {
+    if (!dependencies) break;
+    int4 i = order[k].second;
+    const CallGraphNode *caller = csr.getNode(i);
+    for(int4 e=csr.beginOut(i);e<csr.endOut(i);++e) {
+      int4 callee = itemindex[csr.getTarget(e)];
+      if (callee < 0) continue;			// Callee is not being processed
+      if (callee == k) continue;			// Direct recursion
+      if (csr.getComponent(i) == csr.getComponent(csr.getTarget(e)) &&
+	  caller->getOutEdge(e - csr.beginOut(i)).isCycle())
+	continue;
+      items[k].pending += 1;
+      items[callee].callers.push_back(k);
+    }
+  }
+  for(int4 i=0;i<items.size();++i)
+    items[i].rank = items[i].cost;
+  if (dependencies)
+    rankItems();
+  for(int4 i=0;i<items.size();++i) {
+    if (items[i].pending == 0)
+      ready.push(pair<double,int4>(items[i].rank,i));
+  }
+  numremaining = items.size();
+}
+
+/// \return the index of the claimed item, or -1 if there are no more items
+int4 BatchDecompiler::nextItem(void)
+
+{
+  std::unique_lock<std::mutex> lock(queuelock);
+  while(ready.empty() && numremaining > 0)
+    queuecond.wait(lock);
+  if (ready.empty()) return -1;
+  int4 res = ready.top().second;
+  ready.pop();
+  return res;
+}
+
+/// Any caller whose last pending callee was this item becomes ready.
+/// \param i is the index of the completed item
+void BatchDecompiler::completeItem(int4 i)
+
+{
+  std::lock_guard<std::mutex> lock(queuelock);
+  const vector<int4> &callers(items[i].callers);
+  for(int4 j=0;j<callers.size();++j) {
+    BatchItem &caller(items[callers[j]]);
+    caller.pending -= 1;
+    if (caller.pending == 0)
+      ready.push(pair<double,int4>(caller.rank,callers[j]));
+  }
+  numremaining -= 1;
+  queuecond.notify_all();
+}
+
+/// The default implementation decompiles the function with the worker's root Action, passes
+/// the result to finishFunction(), then releases the analysis. All of this is done holding the
+/// Architecture lock exclusively.  If the \b releaseanalysis option is on, storage the function keeps for
+/// its next decompile is freed too, so memory is bounded by the functions currently in progress.
+/// \param fd is the function to process
+/// \param worker is the worker thread doing the processing
+void BatchDecompiler::processFunction(Funcdata *fd,BatchWorker &worker)
+
+{
+  std::unique_lock<std::shared_mutex> lock(archlock);
+  static const int4 traceid = TraceLog::registerKind("decompile","function");
+  TraceSpan span(traceid,&fd->getName());
+  try {
+    glb->clearAnalysis(fd);
+    worker.root->reset(*fd);
+    worker.root->perform(*fd);
+    finishFunction(fd,worker);
+    worker.numdecompiled += 1;
+  }
+  catch(LowlevelError &err) {
+    worker.numfailed += 1;
+    log("Skipping " + fd->getName() + ": " + err.explain);
+  }
+  if (glb->release_analysis)
+    glb->releaseAnalysis(fd);
+  else
+    glb->clearAnalysis(fd);
+}
+
+/// Worker threads other than the calling thread attach their own decoding state to the
+/// translator, so instruction caches are never shared between workers.  If workers are
+/// pinned, the thread is first bound to its CPU, so the slabs it carves are local to it.
+/// \param worker is the state for this thread
+void BatchDecompiler::runWorker(BatchWorker *worker)
+
+{
+  if (pinworkers && !cpus.empty()) {
+    vector<int4> one;
+    one.push_back(cpus[worker->index % cpus.size()]);
+    setAllowedCpus(one);
+  }
+  if (worker->index != 0)
+    glb->translate->attachThread();
+  for(;;) {
+    int4 i = nextItem();
+    if (i < 0) break;
+    Funcdata *fd = items[i].fd;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    processFunction(fd,*worker);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    worker->seconds += elapsed.count();
+    items[i].seconds = elapsed.count();
+    ostringstream s;
+    s << "Decompiled " << fd->getName() << '(' << dec << fd->getSize() << ')';
+    s << " worker=" << worker->index;
+    s << " predicted=" << fixed << setprecision(0) << items[i].cost;
+    s << " time=" << elapsed.count() * 1000.0 << " ms";
+    log(s.str());
+    completeItem(i);
+  }
+  if (worker->index != 0)
+    glb->translate->detachThread();
+}
+
+/// The schedule is rebuilt from the call graph, a fresh pool of workers is created
+/// (each with its own root Action from buildRoot()), and the method returns once
+/// every function has been processed.  Deferred symbols are created first, so workers
+/// sharing the Architecture lock can query the symbol table without modifying it.
+/// If workers are pinned, the calling thread gets its own CPUs back once the run is done.
+void BatchDecompiler::run(void)
+
+{
+  clearWorkers();
+  glb->symboltab->restoreDeferred(glb->symboltab->getGlobalScope());
+  buildSchedule();
+  for(int4 i=0;i<numworkers;++i)
+    workers.push_back(new BatchWorker(i,buildRoot()));
+
+  if (pinworkers)
+    getAllowedCpus(cpus);
+  vector<std::thread> threads;
+  for(int4 i=1;i<workers.size();++i)
+    threads.emplace_back(&BatchDecompiler::runWorker,this,workers[i]);
+  runWorker(workers[0]);		// The calling thread acts as worker 0
+  for(int4 i=0;i<threads.size();++i)
+    threads[i].join();
+  if (pinworkers)
+    setAllowedCpus(cpus);
+}
+
+/// Each worker counts tests and applications in its own clone of the root Action, so the
+/// counters are never shared between threads.  This folds the counters of every clone from
+/// the last run() into the given Action, which should have been built from the same grouplist
+/// (as the current \e root Action is for the default buildRoot()).
+/// \param target is the Action accumulating the statistics
+void BatchDecompiler::mergeStatistics(Action *target) const
+
+{
+  for(int4 i=0;i<workers.size();++i)
+    target->mergeStatistics(*workers[i]->root);
+}
+
+/// \param s is the output stream
+void BatchDecompiler::printStatistics(ostream &s) const
+
+{
+  for(int4 i=0;i<workers.size();++i) {
+    const BatchWorker *worker = workers[i];
+    s << "worker " << dec << worker->index;
+    s << ": decompiled=" << worker->numdecompiled;
+    s << " failed=" << worker->numfailed;
+    s << " time=" << fixed << setprecision(0) << worker->seconds * 1000.0 << " ms" << endl;
+  }
+  // Fit seconds = scale * cost through the origin, and correlate predictions with times
+  double n = items.size();
+  double sc = 0.0,ss = 0.0,scc = 0.0,sss = 0.0,scs = 0.0;
+  for(int4 i=0;i<items.size();++i) {
+    double c = items[i].cost;
+    double t = items[i].seconds;
+    sc += c; ss += t; scc += c*c; sss += t*t; scs += c*t;
+  }
+  if (n < 2 || scc == 0.0) return;
+  double varc = n*scc - sc*sc;
+  double vars = n*sss - ss*ss;
+  s << "cost model: " << dec << items.size() << " functions";
+  s << " scale=" << scientific << setprecision(3) << scs / scc << " s/unit";
+  if (varc > 0.0 && vars > 0.0)
+    s << " correlation=" << fixed << setprecision(3) << (n*scs - sc*ss) / sqrt(varc * vars);
+  s << endl;
+}
+
+/// Each function of the last run() is printed as a CSV record with the counts the
+/// prediction is made from, the predicted cost, and the measured time in seconds:
+///   function,layer,instructions,blocks,indirect,calls,predicted,seconds
+/// \param s is the output stream
+void BatchDecompiler::printCostReport(ostream &s) const
+
+{
+  s << "function,layer,instructions,blocks,indirect,calls,predicted,seconds" << endl;
+  for(int4 i=0;i<items.size();++i) {
+    const BatchItem &item(items[i]);
+    s << item.fd->getName() << ',' << dec << item.layer << ',' << item.measure.numinsn << ',' << item.measure.numblocks;
+    s << ',' << item.measure.numindirect << ',' << item.numcalls;
+    s << ',' << fixed << setprecision(0) << item.cost << ',' << setprecision(6) << item.seconds << endl;
+  }
+}
+
+/// \return the sum of the processing time of every worker of the last run(), in seconds
+double BatchDecompiler::totalSeconds(void) const
+
+{
+  double res = 0.0;
+  for(int4 i=0;i<workers.size();++i)
+    res += workers[i]->seconds;
+  return res;
+}
+
+/// The function is printed with the PrintLanguage of the Architecture, redirected to a
+/// private string for the duration of the call.
+/// \param fd is the decompiled function
+/// \param worker is the worker that did the decompiling
+void BatchPrinter::finishFunction(Funcdata *fd,BatchWorker &worker)
+
+{
+  PrintLanguage *print = fd->getArch()->print;
+  ostream *saveout = print->getOutputStream();
+  ostringstream s;
+  print->setOutputStream(&s);
+  try {
+    print->docFunction(fd);
+  }
+  catch(LowlevelError &err) {
+    print->setOutputStream(saveout);
+    throw;
+  }
+  print->setOutputStream(saveout);
+  numprinted += 1;
+  if (writer != (OutputWriter *)0) {
+    string text = s.str();
+    writer->push(OutputWriter::fileName(fd),text);
+  }
+  else
+    chunks[fd->getAddress()] = s.str();
+}
+
+/// \param s is the stream to write to
+void BatchPrinter::write(ostream &s) const
+
+{
+  map<Address,string>::const_iterator iter;
+  for(iter=chunks.begin();iter!=chunks.end();++iter)
+    s << (*iter).second;
+}
+
+/// The text of each function is moved to the writer, so the printed functions are released.
+/// \param out is the writer to hand the functions to
+void BatchPrinter::write(OutputWriter &out)
+
+{
+  map<Address,string>::iterator iter;
+  for(iter=chunks.begin();iter!=chunks.end();++iter)
+    out.push("",(*iter).second);
+  chunks.clear();
+}
+
+/// \param maxq is the most functions that can wait to be written before push() blocks
+OutputWriter::OutputWriter(int4 maxq)
+
+{
+  maxqueue = maxq;
+  splitfiles = false;
+  done = false;
+  running = false;
+  numwritten = 0;
+  numbytes = 0;
+}
+
+/// Chunks are taken from the queue until it is empty and no more will be queued.
+/// The lock is dropped while each chunk is written.
+void OutputWriter::writeLoop(void)
+
+{
+  std::unique_lock<std::mutex> guard(lock);
+  for(;;) {
+    while(!done && queue.empty())
+      ready.wait(guard);
+    if (queue.empty()) break;
+    Chunk chunk;
+    chunk.name.swap(queue.front().name);
+    chunk.text.swap(queue.front().text);
+    queue.pop_front();
+    space.notify_one();
+    guard.unlock();
+    writeChunk(chunk);
+    guard.lock();
+  }
+  guard.unlock();
+  flushBuffer();
+}
+
+/// For a single file, the text is added to the buffer, which is written out once it holds
+/// at least \b buffersize bytes.  Text larger than the buffer is written directly.
+/// \param chunk is the chunk to write
+void OutputWriter::writeChunk(Chunk &chunk)
+
+{
+  numwritten += 1;
+  numbytes += chunk.text.size();
+  if (!error.empty()) return;		// Keep draining after a failure, but don't write
+  if (splitfiles) {
+    string filename = target + chunk.name;
+    std::ofstream s(filename.c_str(),std::ios::binary);
+    if (s)
+      s.write(chunk.text.data(),chunk.text.size());
+    if (!s)
+      error = "Could not write " + filename;
+    return;
+  }
+  if (buffer.size() + chunk.text.size() > buffersize)
+    flushBuffer();
+  if (chunk.text.size() >= buffersize) {
+    archive.write(chunk.text.data(),chunk.text.size());
+    if (!archive)
+      error = "Could not write " + target;
+  }
+  else
+    buffer.append(chunk.text);
+}
+
+void OutputWriter::flushBuffer(void)
+
+{
+  if (buffer.empty()) return;
+  if (error.empty()) {
+    archive.write(buffer.data(),buffer.size());
+    if (!archive)
+      error = "Could not write " + target;
+  }
+  buffer.clear();
+}
+
+/// Nothing more can be queued after this.  Anything still in the queue is written.
+void OutputWriter::stop(void)
+
+{
+  if (!running) return;
+  {
+    std::lock_guard<std::mutex> guard(lock);
+    done = true;
+  }
+  ready.notify_one();
+  writer.join();
+  running = false;
+  if (archive.is_open()) {
+    archive.close();
+    if (!archive && error.empty())
+      error = "Could not write " + target;
+  }
+}
+
+/// \param nm is the name of the single file, or the directory to hold a file for each function
+/// \param split is \b true if each function gets its own file in the directory
+void OutputWriter::open(const string &nm,bool split)
+
+{
+  if (running)
+    throw LowlevelError("Output writer is already open");
+  splitfiles = split;
+  target = nm;
+  if (splitfiles) {
+    if (!target.empty() && target[target.size()-1] != '/')
+      target += '/';
+  }
+  else {
+    archive.open(target.c_str(),std::ios::binary | std::ios::trunc);
+    if (!archive)
+      throw LowlevelError("Unable to open output file: " + target);
+    buffer.reserve(buffersize);
+  }
+  queue.clear();
+  done = false;
+  numwritten = 0;
+  numbytes = 0;
+  error.clear();
+  running = true;
+  writer = std::thread(&OutputWriter::writeLoop,this);
+}
+
+/// The text is moved into the queue, and \e text is left empty.  If the queue is full,
+/// this waits for the writer thread to take a chunk.
+/// \param name is the file name, within the directory, for per-function output
+/// \param text is the printed text of the function
+void OutputWriter::push(const string &name,string &text)
+
+{
+  std::unique_lock<std::mutex> guard(lock);
+  while(queue.size() >= maxqueue)
+    space.wait(guard);
+  queue.emplace_back();
+  queue.back().name = name;
+  queue.back().text.swap(text);
+  guard.unlock();
+  ready.notify_one();
+}
+
+/// The queue is drained and the writer thread stopped.  If any write failed, an exception
+/// describing the first failure is thrown.
+void OutputWriter::close(void)
+
+{
+  stop();
+  if (!error.empty()) {
+    string msg;
+    msg.swap(error);
+    throw LowlevelError(msg);
+  }
+}
+
+/// The name is built from the function name and entry address, with any character
+/// that is awkward in a file name replaced.
+/// \param fd is the function
+/// \return the file name
+string OutputWriter::fileName(const Funcdata *fd)
+
+{
+  ostringstream s;
+  s << fd->getName() << '_' << hex << fd->getAddress().getOffset() << ".c";
+  string res = s.str();
+  for(int4 i=0;i<res.size();++i) {
+    char c = res[i];
+    if (!isalnum((unsigned char)c) && c != '_' && c != '.' && c != '-')
+      res[i] = '_';
+  }
+  return res;
+}
+
+/// \param g is the Architecture owning the functions
+/// \param cg is the call graph (with edges already built) to schedule over
+/// \param num is the number of worker threads to use
+BatchPrototypes::BatchPrototypes(Architecture *g,CallGraph *cg,int4 num)
+  : BatchDecompiler(g,cg,num), rootname("protoonly")
+{
+  numlocked = 0;
+  numskipped = 0;
+}
+
+/// \return a clone of the root Action named by setRootName()
+Action *BatchPrototypes::buildRoot(void) const
+
+{
+  return getArch()->allacts.cloneAction(rootname,true);
+}
+
+/// A function whose input and output are both locked already has the prototype that would
+/// be recovered, so it isn't analyzed.
+/// \param fd is the function to process
+/// \param worker is the worker thread doing the processing
+void BatchPrototypes::processFunction(Funcdata *fd,BatchWorker &worker)
+
+{
+  {
+    std::shared_lock<std::shared_mutex> lock(getArchLock());	// Only reading, so other workers may too
+    const FuncProto &proto(fd->getFuncProto());
+    if (proto.isInputLocked() && proto.isOutputLocked()) {
+      numskipped += 1;
+      return;
+    }
+  }
+  BatchDecompiler::processFunction(fd,worker);
+}
+
+/// Locking the recovered parameters and return value keeps them when the analysis is cleared.
+/// \param fd is the analyzed function
+/// \param worker is the worker that did the analysis
+void BatchPrototypes::finishFunction(Funcdata *fd,BatchWorker &worker)
+
+{
+  FuncProto &proto(fd->getFuncProto());
+  proto.setInputLock(true);
+  proto.setOutputLock(true);
+  numlocked += 1;
+}
+
+/// \param addr is the entry point of the function
+/// \param proto is the prototype, which \b this takes ownership of
+void PrototypeExchange::insert(const Address &addr,FuncProto *proto)
+
+{
+  pair<map<Address,FuncProto *>::iterator,bool> res = protos.insert(pair<Address,FuncProto *>(addr,proto));
+  if (!res.second)
+    delete proto;		// The first prototype for a function is kept
+}
+
+/// The copy holds the parameters and return value, the model, and the properties that affect
+/// data-flow at call sites, in the same way as FlowSummaryDb::record().
+/// \param fd is the function
+/// \return \b true if the function had a locked prototype to copy
+bool PrototypeExchange::record(const Funcdata *fd)
+
+{
+  const FuncProto &fp(fd->getFuncProto());
+  if (!fp.isInputLocked() || !fp.isOutputLocked()) return false;
+  PrototypePieces pieces;
+  fp.getPieces(pieces);
+  FuncProto *proto = new FuncProto();
+  proto->setInternal(pieces.model,glb->types->getTypeVoid());
+  proto->setPieces(pieces);
+  proto->setExtraPop(fp.getExtraPop());
+  proto->setNoReturn(fp.isNoReturn());
+  proto->setInline(fp.isInline());
+  proto->copyEffects(fp);
+  insert(fd->getAddress(),proto);
+  return true;
+}
+
+/// \param graph is the call graph, whose nodes must have their functions attached
+/// \return the number of prototypes copied
+int4 PrototypeExchange::collect(CallGraph *graph)
+
+{
+  int4 count = 0;
+  map<Address,CallGraphNode>::iterator iter;
+  for(iter=graph->begin();iter!=graph->end();++iter) {
+    Funcdata *fd = (*iter).second.getFuncdata();
+    if (fd != (Funcdata *)0 && record(fd))
+      count += 1;
+  }
+  return count;
+}
+
+/// Each prototype replaces the prototype of the function in the global scope at the same
+/// address, and is locked so that call sites and later analysis keep it.  Addresses with no
+/// function are skipped.
+/// \return the number of functions whose prototype was set
+int4 PrototypeExchange::apply(void) const
+
+{
+  int4 count = 0;
+  Scope *scope = glb->symboltab->getGlobalScope();
+  map<Address,FuncProto *>::const_iterator iter;
+  for(iter=protos.begin();iter!=protos.end();++iter) {
+    Funcdata *fd = scope->queryFunction((*iter).first);
+    if (fd == (Funcdata *)0) continue;
+    const FuncProto *proto = (*iter).second;
+    PrototypePieces pieces;
+    proto->getPieces(pieces);
+    FuncProto &fp(fd->getFuncProto());
+    fp.setPieces(pieces);
+    fp.setExtraPop(proto->getExtraPop());
+    fp.setNoReturn(proto->isNoReturn());
+    fp.setInline(proto->isInline());
+    fp.copyEffects(*proto);
+    count += 1;
+  }
+  return count;
+}
+
+/// Each prototype is saved in a \<function> tag holding the address of the function.
+/// \param s is the output stream
+void PrototypeExchange::saveXml(ostream &s) const
+
+{
+  s << "<prototypes>\n";
+  map<Address,FuncProto *>::const_iterator iter;
+  for(iter=protos.begin();iter!=protos.end();++iter) {
+    s << "<function>\n";
+    (*iter).first.saveXml(s);
+    s << '\n';
+    (*iter).second->saveXml(s);
+    s << "</function>\n";
+  }
+  s << "</prototypes>\n";
+}
+
+/// Prototypes for functions that already have one in \b this are ignored.
+/// \param el is the \<prototypes> element
+void PrototypeExchange::restoreXml(const Element *el)
+
+{
+  const List &list(el->getChildren());
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter) {
+    const Element *subel = *iter;
+    const List &children(subel->getChildren());
+    if (subel->getName() != "function" || children.size() != 2)
+      throw LowlevelError("Bad <function> tag in prototypes");
+    Address addr = Address::restoreXml(children.front(),glb);
+    FuncProto *proto = new FuncProto();
+    proto->setInternal(glb->defaultfp,glb->types->getTypeVoid());
+    try {
+      proto->restoreXml(children.back(),glb);
+    }
+    catch(LowlevelError &err) {
+      delete proto;
+      throw;
+    }
+    insert(addr,proto);
+  }
+}
+
+void PrototypeExchange::clear(void)
+
+{
+  map<Address,FuncProto *>::iterator iter;
+  for(iter=protos.begin();iter!=protos.end();++iter)
+    delete (*iter).second;
+  protos.clear();
+}
+
+void BatchPrototypes::run(void)
+
+{
+  numlocked = 0;
+  numskipped = 0;
+  setDependencies(true);		// Locking callers first would defeat the purpose
+  BatchDecompiler::run();
+}
+
+} // namespace GhidraDec
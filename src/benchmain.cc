@@ -0,0 +1,176 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Benchmark driver: decompile every function of a corpus of images and report timings as CSV
+//
+//   decompiler-benchmark [-s specdir] [-r root] [-n reps] [-m] [-g nodes] [-p depth] [-x xmlfile] [-c corpusfile]
+//                        [-j threads,...] [-a slabs] [-P] image ...
+//
+//   -s  adds a directory containing .ldefs/.sla files (may be repeated)
+//   -r  names the root Action to decompile with (default "decompile")
+//   -n  sets the number of repetitions of each microbenchmark (default 10)
+//   -m  runs the microbenchmarks
+//   -g  structures a synthetic control-flow graph with about this many nodes (no image is needed)
+//   -p  pretty prints groups nested this deep, with and without a lookahead limit (no image is needed)
+//   -x  parses an XML file, such as a .sla, into a tree of elements (may be repeated, no image is needed)
+//   -c  names a file listing one image per line (lines starting with '#' are ignored)
+//   -j  also decompiles each image on a pool of this many threads, for each count in the list
+//   -a  sets where object slabs come from: heap, region, transparent or hugetlb (huge pages)
+//   -P  binds each batch worker thread to its own CPU
+
+#include <iostream>
+#include <cstdlib>
+
+#include "libdecomp.hh"
+#include "benchmark.hh"
+
+using namespace GhidraDec;
+
+static void usage(void)
+
+{
+  cerr << "usage: decompiler-benchmark [-s specdir] [-r root] [-n reps] [-m] [-g nodes] [-p depth] [-x xmlfile] [-c corpusfile]" << endl;
+  cerr << "                            [-j threads,...] [-a slabs] [-P] image ..." << endl;
+  exit(2);
+}
+
+int main(int argc,char **argv)
+
+{
+  vector<string> extrapaths;
+  vector<string> images;
+  vector<string> xmlfiles;
+  string rootname = "decompile";
+  int4 reps = 10;
+  bool micro = false;
+  int4 graphnodes = 0;
+  int4 printdepth = 0;
+  vector<int4> batchthreads;
+  bool pinworkers = false;
+  int4 i = 1;
+  while((i<argc)&&(argv[i][0]=='-')) {
+    char opt = argv[i][1];
+    if (opt == 'm' || opt == 'P') {
+      if (opt == 'm')
+	micro = true;
+      else
+	pinworkers = true;
+      i += 1;
+      continue;
+    }
+    if (i+1 >= argc) usage();
+    if (opt == 's')
+      extrapaths.push_back(argv[i+1]);
+    else if (opt == 'r')
+      rootname = argv[i+1];
+    else if (opt == 'n')
+      reps = atoi(argv[i+1]);
+    else if (opt == 'g')
+      graphnodes = atoi(argv[i+1]);
+    else if (opt == 'p')
+      printdepth = atoi(argv[i+1]);
+    else if (opt == 'x')
+      xmlfiles.push_back(argv[i+1]);
+    else if (opt == 'j') {
+      istringstream s(argv[i+1]);
+      int4 num;
+      while(s >> num) {
+	if (num <= 0) usage();
+	batchthreads.push_back(num);
+	if (s.peek() == ',')
+	  s.get();
+      }
+      if (batchthreads.empty()) usage();
+    }
+    else if (opt == 'a') {
+      SlabArena::backing backing;
+      if (!SlabArena::parseBacking(argv[i+1],backing))
+	usage();
+      SlabArena::setBacking(backing);
+    }
+    else if (opt == 'c') {
+      ifstream corpus(argv[i+1]);
+      if (!corpus) {
+	cerr << "Unable to open corpus file " << argv[i+1] << endl;
+	exit(1);
+      }
+      string line;
+      while(getline(corpus,line)) {
+	if (line.empty() || line[0] == '#') continue;
+	images.push_back(line);
+      }
+    }
+    else
+      usage();
+    i += 2;
+  }
+  for(;i<argc;++i)
+    images.push_back(argv[i]);
+  if ((images.empty() && graphnodes <= 0 && printdepth <= 0 && xmlfiles.empty()) || reps <= 0)
+    usage();
+
+  DecompilerBenchmark bench(cout,rootname,reps,micro);
+  bench.setBatch(batchthreads,pinworkers);
+  DecompilerBenchmark::printHeader(cout);
+  if (graphnodes > 0)
+    bench.runStructure(graphnodes);	// Needs no language, so it runs before the library is started
+  if (printdepth > 0)
+    bench.runPrettyPrint(printdepth);
+  for(int4 j=0;j<xmlfiles.size();++j) {
+    try {
+      bench.runXmlParse(xmlfiles[j]);
+    }
+    catch(LowlevelError &err) {
+      cerr << xmlfiles[j] << ": " << err.explain << endl;
+    }
+    catch(XmlError &err) {
+      cerr << xmlfiles[j] << ": " << err.explain << endl;
+    }
+  }
+  if (images.empty()) {
+    bench.finish();
+    return 0;
+  }
+
+  string ghidraroot = FileManage::discoverGhidraRoot(argv[0]);
+  if (ghidraroot.size() == 0) {
+    const char *sleighhomepath = getenv("SLEIGHHOME");
+    if (sleighhomepath != (const char *)0)
+      ghidraroot = sleighhomepath;
+    else if (extrapaths.empty()) {
+      cerr << "Could not discover root of Ghidra installation" << endl;
+      exit(1);
+    }
+  }
+  const char *indexpath = getenv("SLEIGHINDEX");
+  if (indexpath != (const char *)0)
+    SleighArchitecture::setIndexFile(indexpath);	// Reuse the last scan of the SLEIGH directories
+  startDecompilerLibrary(ghidraroot.c_str(),extrapaths);
+
+  int4 retval = 0;
+  for(int4 j=0;j<images.size();++j) {
+    try {
+      bench.runImage(images[j]);
+    }
+    catch(LowlevelError &err) {
+      cerr << images[j] << ": " << err.explain << endl;
+      retval = 1;
+    }
+  }
+  bench.finish();
+
+  shutdownDecompilerLibrary();
+  return retval;
+}
@@ -0,0 +1,675 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "benchmark.hh"
+#include "printlanguage.hh"
+#include "funcsummary.hh"
+#include "batch.hh"
+
+#include <cstdlib>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace GhidraDec {
+
+/// \brief A PcodeEmit that throws away everything it is given
+class PcodeEmitDiscard : public PcodeEmit {
+public:
+  virtual void dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize) {}
+};
+
+/// Names of the Actions whose time is reported as the \e merge microbenchmark
+static const char *merge_actions[] = { "assignhigh", "mergerequired", "markexplicit", "markimplied", "mergecopy",
+				       "markindirectonly", "mergeadjacent", "mergetype", "hideshadow", "copymarker",
+				       (const char *)0 };
+
+/// Names of the Actions whose time is reported as the \e heritage microbenchmark
+static const char *heritage_actions[] = { "heritage", (const char *)0 };
+
+/// Receives the results of the Cover microbenchmark, so the compiler cannot discard the loop
+static volatile int4 cover_sink;
+
+/// \brief Generator of random control-flow graphs, built from nested structured regions
+///
+/// Regions are sequences, if/then, if/else, while and do-while loops, and switches, nested to a
+/// limited depth, with an occasional extra edge back to an earlier node that the structurer has to
+/// turn into a goto.  The same seed always produces the same graph.
+class SyntheticGraph {
+  vector<int4> &edges;		///< (source,destination) pairs of the graph, flattened
+  uint4 state;			///< State of the random number generator
+  int4 count;			///< Number of nodes created so far
+  int4 limit;			///< Number of nodes after which regions stop growing
+  uint4 random(uint4 n) { state = state * 1103515245 + 12345; return (state >> 16) % n; }	///< Get a random number less than \b n
+  int4 node(void) { return count++; }		///< Create a node
+  void edge(int4 a,int4 b) { edges.push_back(a); edges.push_back(b); }	///< Create an edge
+  int4 region(int4 entry,int4 depth);
+public:
+  SyntheticGraph(vector<int4> &e,int4 n,uint4 seed) : edges(e) { state = seed; count = 0; limit = n; }	///< Constructor
+  int4 build(void);				///< Generate the graph
+};
+
+/// \param entry is the node the new region starts with
+/// \param depth is the nesting depth of the region
+/// \return the node the region exits through, which has no out edges yet
+int4 SyntheticGraph::region(int4 entry,int4 depth)
+
+{
+  if (depth > 6 || count >= limit) return entry;
+  int4 exit;
+  switch(random(8)) {
+  case 0:			// if/then
+    {
+      int4 body = node();
+      exit = node();
+      edge(entry,exit);
+      edge(entry,body);
+      edge(region(body,depth+1),exit);
+      break;
+    }
+  case 1:			// if/else
+    {
+      int4 body1 = node();
+      int4 body2 = node();
+      exit = node();
+      edge(entry,body2);
+      edge(entry,body1);
+      edge(region(body1,depth+1),exit);
+      edge(region(body2,depth+1),exit);
+      break;
+    }
+  case 2:			// while
+    {
+      int4 head = node();
+      int4 body = node();
+      exit = node();
+      edge(entry,head);
+      edge(head,exit);
+      edge(head,body);
+      edge(region(body,depth+1),head);
+      break;
+    }
+  case 3:			// do/while
+    {
+      int4 body = node();
+      edge(entry,body);
+      int4 tail = region(body,depth+1);
+      exit = node();
+      edge(tail,exit);
+      edge(tail,body);
+      break;
+    }
+  case 4:			// switch
+    {
+      int4 numcases = 3 + random(4);
+      exit = node();
+      for(int4 i=0;i<numcases;++i) {
+	int4 body = node();
+	edge(entry,body);
+	edge(region(body,depth+1),exit);
+      }
+      break;
+    }
+  case 5:			// conditional branch back to some earlier node
+    if (random(4) == 0 && entry > 0) {
+      exit = node();
+      edge(entry,exit);
+      edge(entry,random(entry));
+      break;
+    }
+    // fallthru
+  default:			// sequence
+    exit = node();
+    edge(entry,exit);
+    exit = region(exit,depth+1);
+    break;
+  }
+  return exit;
+}
+
+/// \return the number of nodes in the graph
+int4 SyntheticGraph::build(void)
+
+{
+  int4 cur = node();
+  while(count < limit)
+    cur = region(cur,0);
+  return count;
+}
+
+/// \param s is the stream that will receive the CSV records
+/// \param root is the name of the root Action to decompile with
+/// \param r is the number of repetitions of each microbenchmark
+/// \param m is \b true if microbenchmarks should be run
+DecompilerBenchmark::DecompilerBenchmark(ostream &s,const string &root,int4 r,bool m)
+  : out(s)
+{
+  rootname = root;
+  reps = r;
+  micro = m;
+  pinworkers = false;
+}
+
+/// \param kind is the kind of record
+/// \param image is the name of the image (empty for process-wide records)
+/// \param name is the name of the quantity
+/// \param value is the measured value
+void DecompilerBenchmark::record(const string &kind,const string &image,const string &name,double value)
+
+{
+  out << kind << ',' << image << ',' << name << ',' << setprecision(10) << value << endl;
+}
+
+/// \param s is the output stream
+void DecompilerBenchmark::printHeader(ostream &s)
+
+{
+  s << "kind,image,name,value" << endl;
+}
+
+/// Functions are collected in address order, recursing into child scopes.
+/// \param scope is the scope to search
+/// \param res will hold the functions found
+void DecompilerBenchmark::collectFunctions(Scope *scope,vector<Funcdata *> &res) const
+
+{
+  if (!scope->isGlobal()) return;
+  MapIterator miter = scope->begin();
+  MapIterator menditer = scope->end();
+  while(miter != menditer) {
+    FunctionSymbol *fsym = dynamic_cast<FunctionSymbol *>((*miter)->getSymbol());
+    ++miter;
+    if (fsym != (FunctionSymbol *)0)
+      res.push_back(fsym->getFunction());
+  }
+  ScopeMap::const_iterator iter;
+  for(iter=scope->childrenBegin();iter!=scope->childrenEnd();++iter)
+    collectFunctions((*iter).second,res);
+}
+
+/// Every instruction that produced p-code in the decompiled function is translated again, and
+/// decoded again for its length alone and for its length and flow.
+/// \param fd is the decompiled function
+/// \param times accumulates the elapsed time and count
+void DecompilerBenchmark::benchLift(Funcdata *fd,MicroTimes &times) const
+
+{
+  vector<Address> addrs;
+  PcodeOpTree::const_iterator iter;
+  for(iter=fd->beginOpAll();iter!=fd->endOpAll();++iter) {
+    PcodeOp *op = (*iter).second;
+    if (op->isInstructionStart())
+      addrs.push_back(op->getAddr());
+  }
+  const Translate *trans = fd->getArch()->translate;
+  PcodeEmitDiscard emit;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    for(int4 i=0;i<addrs.size();++i)
+      trans->oneInstruction(emit,addrs[i]);
+  }
+  times.liftnanos += Action::elapsedNanos(start);
+  times.liftcount += (uint8)reps * addrs.size();
+  start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    for(int4 i=0;i<addrs.size();++i)
+      trans->instructionLength(addrs[i]);
+  }
+  times.lengthnanos += Action::elapsedNanos(start);
+  uint4 flow;
+  start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    for(int4 i=0;i<addrs.size();++i)
+      trans->instructionFlow(addrs[i],flow);
+  }
+  times.flownanos += Action::elapsedNanos(start);
+}
+
+/// The Covers of up to 256 Varnodes are intersected pairwise.
+/// \param fd is the decompiled function
+/// \param times accumulates the elapsed time and count
+void DecompilerBenchmark::benchCover(Funcdata *fd,MicroTimes &times) const
+
+{
+  vector<const Cover *> covers;
+  VarnodeLocSet::const_iterator iter;
+  for(iter=fd->beginLoc();iter!=fd->endLoc();++iter) {
+    Varnode *vn = *iter;
+    if (!vn->hasCover()) continue;
+    const Cover *cov = vn->getCover();
+    if (cov == (const Cover *)0) continue;
+    covers.push_back(cov);
+    if (covers.size() >= 256) break;
+  }
+  int4 sum = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    for(int4 i=0;i<covers.size();++i)
+      for(int4 j=i+1;j<covers.size();++j)
+	sum += covers[i]->intersect(*covers[j]);
+  }
+  times.covernanos += Action::elapsedNanos(start);
+  uint8 n = covers.size();
+  if (n > 1)
+    times.covercount += (uint8)reps * (n * (n-1) / 2);
+  cover_sink = sum;
+}
+
+/// The function is emitted to a private string, through the emitter of the Architecture's PrintLanguage.
+/// \param fd is the decompiled function
+/// \param times accumulates the elapsed time and count
+void DecompilerBenchmark::benchPrint(Funcdata *fd,MicroTimes &times) const
+
+{
+  PrintLanguage *print = fd->getArch()->print;
+  ostream *saveout = print->getOutputStream();
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  try {
+    for(int4 r=0;r<reps;++r) {
+      ostringstream s;
+      print->setOutputStream(&s);
+      print->docFunction(fd);
+    }
+  }
+  catch(LowlevelError &err) {
+    print->setOutputStream(saveout);
+    return;			// Function could not be printed, leave it out of the count
+  }
+  print->setOutputStream(saveout);
+  times.printnanos += Action::elapsedNanos(start);
+  times.printcount += reps;
+}
+
+/// The summary is written to a private string.
+/// \param fd is the decompiled function
+/// \param times accumulates the elapsed time and count
+void DecompilerBenchmark::benchSummary(Funcdata *fd,MicroTimes &times) const
+
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    ostringstream s;
+    FunctionSummary summary(s);
+    summary.save(*fd);
+  }
+  times.summarynanos += Action::elapsedNanos(start);
+  times.summarycount += reps;
+}
+
+/// \param root is the root Action
+/// \param names is a null terminated list of Action names
+/// \return the total nanoseconds spent in the named Actions
+uint8 DecompilerBenchmark::sumActionTime(Action *root,const char **names)
+
+{
+  uint8 res = 0;
+  for(int4 i=0;names[i] != (const char *)0;++i) {
+    Action *act = root->getSubAction(names[i]);
+    if (act != (Action *)0)
+      res += act->getTime();
+  }
+  return res;
+}
+
+/// The Action statistics of the root are gathered as CSV (see Action::printStatisticsCsv()),
+/// and a \e phase record is written for every Action (Rules are skipped).
+/// \param root is the root Action
+/// \param image is the name of the image
+void DecompilerBenchmark::reportPhases(Action *root,const string &image)
+
+{
+  ostringstream s;
+  root->printStatisticsCsv(s,"");
+  istringstream is(s.str());
+  string line;
+  while(getline(is,line)) {
+    if (line.compare(0,7,"action,") != 0) continue;
+    vector<string> fields;
+    string::size_type pos = 0;
+    for(;;) {
+      string::size_type next = line.find(',',pos);
+      fields.push_back(line.substr(pos,next-pos));
+      if (next == string::npos) break;
+      pos = next + 1;
+    }
+    if (fields.size() < 5) continue;
+    record("phase",image,fields[1],(double)strtoull(fields[4].c_str(),(char **)0,10) / 1000000.0);
+  }
+}
+
+/// The image is loaded as in the \b load \b file console command, then each function with code
+/// is decompiled, measured, and its analysis released.  Action timing is turned on for the
+/// duration of the run.
+/// \param filename is the path to the image
+void DecompilerBenchmark::runImage(const string &filename)
+
+{
+  ArchitectureCapability *capa = ArchitectureCapability::findCapability(filename);
+  if (capa == (ArchitectureCapability *)0)
+    throw LowlevelError("Unable to recognize image file " + filename);
+  ostringstream errs;
+  Architecture *glb = capa->buildArchitecture(filename,"default",&errs);
+  DocumentStorage store;
+  try {
+    glb->init(store);
+  }
+  catch(LowlevelError &err) {
+    delete glb;
+    throw;
+  }
+  catch(XmlError &err) {
+    delete glb;
+    throw LowlevelError("Could not load " + filename + ": " + err.explain);
+  }
+  if (capa->getName() == "xml")
+    glb->readLoaderSymbols();
+
+  Action *root = glb->allacts.setCurrent(rootname);
+  bool savetiming = Action::isTiming();
+  Action::setTiming(true);
+  root->resetStats();
+
+  vector<Funcdata *> functions;
+  collectFunctions(glb->symboltab->getGlobalScope(),functions);
+  int4 numdecompiled = 0;
+  int4 numfailed = 0;
+  uint8 numops = 0;
+  uint8 nanos = 0;
+  MicroTimes times;
+  for(int4 i=0;i<functions.size();++i) {
+    Funcdata *fd = functions[i];
+    if (fd->hasNoCode()) continue;
+    try {
+      glb->clearAnalysis(fd);
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      root->reset(*fd);
+      int4 res = root->perform(*fd);
+      nanos += Action::elapsedNanos(start);
+      if (res < 0 || !fd->isProcComplete())
+	numfailed += 1;
+      else {
+	numdecompiled += 1;
+	list<PcodeOp *>::const_iterator iter;
+	for(iter=fd->beginOpAlive();iter!=fd->endOpAlive();++iter)
+	  numops += 1;
+	if (micro) {
+	  benchLift(fd,times);
+	  benchCover(fd,times);
+	  benchPrint(fd,times);
+	  benchSummary(fd,times);
+	}
+      }
+    }
+    catch(LowlevelError &err) {
+      numfailed += 1;
+    }
+    glb->clearAnalysis(fd);
+  }
+
+  double seconds = (double)nanos / 1000000000.0;
+  record("decompile",filename,"functions",numdecompiled);
+  record("decompile",filename,"failed",numfailed);
+  record("decompile",filename,"pcodeops",(double)numops);
+  record("decompile",filename,"seconds",seconds);
+  record("decompile",filename,"pcodeops_per_sec",(seconds > 0.0) ? (double)numops / seconds : 0.0);
+  reportPhases(root,filename);
+  if (micro) {
+    if (times.liftcount != 0) {
+      record("micro",filename,"oneInstruction_ns",(double)times.liftnanos / (double)times.liftcount);
+      record("micro",filename,"instructionLength_ns",(double)times.lengthnanos / (double)times.liftcount);
+      record("micro",filename,"instructionFlow_ns",(double)times.flownanos / (double)times.liftcount);
+    }
+    if (times.covercount != 0)
+      record("micro",filename,"coverIntersect_ns",(double)times.covernanos / (double)times.covercount);
+    if (times.printcount != 0)
+      record("micro",filename,"emitFunction_ns",(double)times.printnanos / (double)times.printcount);
+    if (times.summarycount != 0)
+      record("micro",filename,"summary_ns",(double)times.summarynanos / (double)times.summarycount);
+    if (numdecompiled != 0) {
+      record("micro",filename,"heritage_ns",(double)sumActionTime(root,heritage_actions) / numdecompiled);
+      record("micro",filename,"merge_ns",(double)sumActionTime(root,merge_actions) / numdecompiled);
+    }
+  }
+  Action::setTiming(savetiming);
+  if (!batchthreads.empty())
+    benchBatch(glb,filename);
+  delete glb;
+}
+
+/// The functions are scheduled over a call graph with no edges, so no function waits for its
+/// callees, and the times show how the decompiler itself scales over cores and sockets rather
+/// than the shape of the call graph.  Speedups are relative to the first thread count.
+/// \param glb is the loaded image
+/// \param image is the name of the image
+void DecompilerBenchmark::benchBatch(Architecture *glb,const string &image)
+
+{
+  CallGraph graph(glb);
+  graph.buildAllNodes();
+  double firstseconds = 0.0;
+  for(int4 i=0;i<batchthreads.size();++i) {
+    int4 num = batchthreads[i];
+    BatchDecompiler batch(glb,&graph,num);
+    batch.setDependencies(false);
+    batch.setPinWorkers(pinworkers);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    batch.run();
+    double seconds = (double)Action::elapsedNanos(start) / 1000000000.0;
+    if (i == 0)
+      firstseconds = seconds;
+    ostringstream prefix;
+    prefix << "threads_" << dec << num << '_';
+    record("batch",image,prefix.str() + "seconds",seconds);
+    record("batch",image,prefix.str() + "functions_per_sec",(seconds > 0.0) ? batch.numFunctions() / seconds : 0.0);
+    record("batch",image,prefix.str() + "speedup",(seconds > 0.0) ? firstseconds / seconds : 0.0);
+  }
+}
+
+/// A synthetic graph with about the given number of nodes is structured \b reps times each way.
+/// The XML path sends the graph as a \<block> tag, restores it, and saves the result as
+/// StructureGraph does.  The edge list path does the same through EdgeListStructure.
+/// \param numnodes is the number of nodes to generate
+void DecompilerBenchmark::runStructure(int4 numnodes)
+
+{
+  vector<int4> edges;
+  SyntheticGraph gen(edges,numnodes,0x5eed);
+  int4 count = gen.build();
+  ostringstream imagename;
+  imagename << "graph" << dec << count;
+  string image = imagename.str();
+
+  BlockGraph graph;
+  for(int4 i=0;i<count;++i)
+    graph.newBlock(i);
+  ostringstream edgestream;
+  edgestream << dec << count;
+  for(int4 i=0;i<edges.size();i+=2) {
+    graph.addEdge(graph.getBlock(edges[i]),graph.getBlock(edges[i+1]));
+    edgestream << ' ' << edges[i] << ' ' << edges[i+1];
+  }
+  ostringstream xmlstream;
+  graph.saveXml(xmlstream);
+  string xmlin = xmlstream.str();
+  string edgein = edgestream.str();
+
+  size_t xmlout = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    istringstream s(xmlin);
+    Document *doc = xml_tree(s);
+    BlockGraph ingraph;
+    ingraph.restoreXml(doc->getRoot(),(const AddrSpaceManager *)0);
+    delete doc;
+    BlockGraph resultgraph;
+    vector<FlowBlock *> rootlist;
+    resultgraph.buildCopy(ingraph);
+    resultgraph.structureLoops(rootlist);
+    resultgraph.calcForwardDominator(rootlist);
+    CollapseStructure collapse(resultgraph);
+    collapse.collapseAll();
+    resultgraph.orderBlocks();
+    ostringstream res;
+    resultgraph.saveXml(res);
+    xmlout = res.str().size();
+  }
+  double xmlseconds = Action::elapsedNanos(start) / (1.0e9 * reps);
+
+  size_t edgeout = 0;
+  EdgeListStructure structurer;
+  start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    istringstream s(edgein);
+    structurer.restore(s);
+    structurer.structure();
+    ostringstream res;
+    structurer.encode(res);
+    edgeout = res.str().size();
+    structurer.clear();
+  }
+  double edgeseconds = Action::elapsedNanos(start) / (1.0e9 * reps);
+
+  record("structure",image,"nodes",count);
+  record("structure",image,"edges",edges.size() / 2);
+  record("structure",image,"xml_seconds",xmlseconds);
+  record("structure",image,"edgelist_seconds",edgeseconds);
+  record("structure",image,"xml_bytes",xmlin.size() + xmlout);
+  record("structure",image,"edgelist_bytes",edgein.size() + edgeout);
+}
+
+/// \brief Emit a token stream that the pretty printer must hold in full without a lookahead limit
+///
+/// Groups are nested \b depth deep, each holding only a zero-width marker before the next
+/// level opens, so no line fills while they are open.  The innermost group is a long
+/// array-literal style run of \b depth numbers.
+/// \param emit is the pretty printer
+/// \param depth is the nesting depth and the length of the run
+static void emitNestedGroups(EmitPrettyPrint &emit,int4 depth)
+
+{
+  vector<int4> ids;
+  int4 docid = emit.beginDocument();
+  for(int4 i=0;i<depth;++i) {
+    ids.push_back(emit.openGroup());
+    emit.endBlock(emit.beginBlock((const FlowBlock *)0));
+  }
+  int4 arrayid = emit.openParen('{');
+  for(int4 i=0;i<depth;++i) {
+    emit.print("0x5eed");
+    emit.print(",");
+    emit.spaces(1);
+  }
+  emit.closeParen('}',arrayid);
+  for(int4 i=depth-1;i>=0;--i)
+    emit.closeGroup(ids[i]);
+  emit.endDocument(docid);
+  emit.flush();
+}
+
+/// The stream of emitNestedGroups() is printed \b reps times with the default unbounded
+/// queues, and then with a lookahead limit of 1000 tokens.  Output is discarded.
+/// \param depth is the nesting depth of the stream
+void DecompilerBenchmark::runPrettyPrint(int4 depth)
+
+{
+  ostringstream imagename;
+  imagename << "nest" << dec << depth;
+  string image = imagename.str();
+  ostream sink((streambuf *)0);		// Discards everything written to it
+
+  for(int4 limit=0;limit<=1000;limit+=1000) {
+    EmitPrettyPrint emit(100);
+    emit.setOutputStream(&sink);
+    emit.setMaxLookahead(limit);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for(int4 r=0;r<reps;++r)
+      emitNestedGroups(emit,depth);
+    double seconds = Action::elapsedNanos(start) / (1.0e9 * reps);
+    string prefix = (limit == 0) ? "unbounded_" : "streaming_";
+    record("prettyprint",image,prefix + "seconds",seconds);
+    record("prettyprint",image,prefix + "queue_tokens",emit.getQueueCapacity());
+  }
+}
+
+/// \param el is the root of a tree of elements
+/// \return the number of elements in the tree
+static int4 countElements(const Element *el)
+
+{
+  int4 count = 1;
+  const List &children( el->getChildren() );
+  for(List::const_iterator iter=children.begin();iter!=children.end();++iter)
+    count += countElements(*iter);
+  return count;
+}
+
+/// The file is read into memory once, and then parsed into a tree of elements \b reps times.
+/// \param filename is the path of the XML file
+void DecompilerBenchmark::runXmlParse(const string &filename)
+
+{
+  ifstream fs(filename.c_str());
+  if (!fs)
+    throw LowlevelError("Unable to open " + filename);
+  ostringstream contents;
+  contents << fs.rdbuf();
+  string xmlin = contents.str();
+
+  int4 count = 0;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  for(int4 r=0;r<reps;++r) {
+    istringstream s(xmlin);
+    Document *doc = xml_tree(s);
+    count = countElements(doc->getRoot());
+    delete doc;
+  }
+  double seconds = Action::elapsedNanos(start) / (1.0e9 * reps);
+  record("xmlparse",filename,"seconds",seconds);
+  record("xmlparse",filename,"megabytes_per_second",xmlin.size() / (seconds * 1.0e6));
+  record("xmlparse",filename,"elements",count);
+}
+
+void DecompilerBenchmark::finish(void)
+
+{
+  long rss = peakResidentKb();
+  if (rss >= 0)
+    record("process","","peak_rss_kb",(double)rss);
+  record("process","","sizeof_varnode",(double)sizeof(Varnode));	// Track the layout of the hot objects
+  record("process","","sizeof_pcodeop",(double)sizeof(PcodeOp));
+  record("process","","slab_regions",(double)SlabArena::getNumRegions());
+  record("process","","slab_hugetlb_regions",(double)SlabArena::getNumHuge());
+}
+
+/// \return the peak resident set size in kilobytes, or -1 if it is not available
+long DecompilerBenchmark::peakResidentKb(void)
+
+{
+#ifdef _WIN32
+  return -1;
+#else
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF,&usage) != 0)
+    return -1;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;	// Reported in bytes
+#else
+  return usage.ru_maxrss;		// Reported in kilobytes
+#endif
+#endif
+}
+
+}
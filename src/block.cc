@@ -706,6 +706,8 @@ FlowBlock *FlowBlock::findCommonBlock(FlowBlock *bl1,FlowBlock *bl2)
   return common;
 }
 
+BlockGraph::dominator_algorithm BlockGraph::domalgorithm = BlockGraph::dom_iterative;
+
 /// Add the given FlowBlock to the list and make \b this the parent
 /// Update \b index so that it has the minimum over all components
 /// \param bl is the given FlowBlock
@@ -1087,6 +1089,34 @@ void BlockGraph::markCopyBlock(FlowBlock *bl,uint4 fl)
   bl->getFrontLeaf()->flags |= fl;
 }
 
+/// The estimate counts each component FlowBlock, its edge lists and, for basic blocks, its
+/// list of PcodeOps.  Component graphs are counted recursively.
+/// \return the estimated number of bytes
+uint8 BlockGraph::memoryEstimate(void) const
+
+{
+  uint8 res = list.capacity() * sizeof(FlowBlock *);
+  for(int4 i=0;i<list.size();++i) {
+    const FlowBlock *bl = list[i];
+    res += (bl->sizeIn() + bl->sizeOut()) * sizeof(BlockEdge);
+    switch(bl->getType()) {
+    case FlowBlock::t_basic:
+      res += sizeof(BlockBasic) + ((const BlockBasic *)bl)->sizeOp() * 3 * sizeof(void *);
+      break;
+    case FlowBlock::t_copy:
+      res += sizeof(BlockCopy);
+      break;
+    case FlowBlock::t_plain:
+      res += sizeof(FlowBlock);
+      break;
+    default:
+      res += ((const BlockGraph *)bl)->memoryEstimate();
+      break;
+    }
+  }
+  return res + sizeof(BlockGraph);
+}
+
 void BlockGraph::clear(void)
 
 {
@@ -1489,6 +1519,18 @@ FlowBlock *BlockGraph::newBlock(void)
   return ret;
 }
 
+/// Add the new FlowBlock to \b this, as for a node of a graph that has its own numbering
+/// \param ind is the index to give the new block
+/// \return the new FlowBlock
+FlowBlock *BlockGraph::newBlock(int4 ind)
+
+{
+  FlowBlock *ret = new FlowBlock();
+  ret->index = ind;
+  addBlock(ret);
+  return ret;
+}
+
 /// Add the new BlockBasic to \b this
 /// \param fd is the function underlying the basic block
 /// \return the new BlockBasic
@@ -1759,45 +1801,22 @@ void BlockGraph::clearVisitCount(void)
     list[i]->visitcount = 0;
 }
 
-/// Calculate the immediate dominator for each FlowBlock node in \b this BlockGraph,
-/// for forward control-flow.
-/// The algorithm must be provided a list of entry points for the graph.
-/// We assume the blocks are in reverse post-order and this is reflected in the index field.
+/// \brief Iteratively compute immediate dominators
+///
 /// Using an algorithm by Cooper, Harvey, and Kennedy.
 /// Softw. Pract. Exper. 2001; 4: 1-10
-/// \param rootlist is the list of entry point FlowBlocks
-void BlockGraph::calcForwardDominator(const vector<FlowBlock *> &rootlist)
+/// The root must be the last block in the post-order list, and its immediate
+/// dominator must already be set to itself.
+/// \param postorder is the list of blocks in post-order
+/// \param numnodes is the number of blocks in the graph, minus one
+void BlockGraph::calcDominatorIterative(const vector<FlowBlock *> &postorder,int4 numnodes)
 
 {
-  vector<FlowBlock *> postorder;
-  FlowBlock *virtualroot;
   FlowBlock *b,*new_idom,*rho;
   bool changed;
   int4 i,j,finger1,finger2;
 
-  if (list.empty()) return;
-  int4 numnodes = list.size()-1;
-  postorder.resize(list.size());
-  for(i=0;i<list.size();++i) {
-    list[i]->immed_dom = (FlowBlock *)0; // Clear the dominator field
-    postorder[ numnodes-i ] = list[i]; // Construct a forward post order list
-  }
-  if (rootlist.size() > 1) {
-    virtualroot = createVirtualRoot(rootlist);
-    postorder.push_back(virtualroot);
-  }
-  else
-    virtualroot = (FlowBlock *)0;
-
-  b = postorder.back();		// The official start node
-  if (b->sizeIn() != 0) {	// Root node must have no in edges
-    if ((rootlist.size() != 1)||(rootlist[0] != b))
-      throw LowlevelError("Problems finding root node of graph");
-    virtualroot = createVirtualRoot(rootlist); // Create virtual root with no in edges
-    postorder.push_back(virtualroot);
-    b = virtualroot;
-  }
-  b->immed_dom = b;
+  b = postorder.back();
   for(i=0;i<b->sizeOut();++i)	// Fill in dom of nodes which start immediately
     b->getOut(i)->immed_dom = b;	// connects to (to deal with possible artificial edge)
   changed = true;
@@ -1834,6 +1853,141 @@ void BlockGraph::calcForwardDominator(const vector<FlowBlock *> &rootlist)
       }
     }
   }
+}
+
+/// \brief Compute immediate dominators using the Semi-NCA algorithm
+///
+/// Semi-dominators are computed as in Lengauer and Tarjan, "A Fast Algorithm for Finding
+/// Dominators in a Flowgraph", TOPLAS 1979, using path compression. Immediate dominators are
+/// then found as the nearest common ancestor of the semi-dominator and the spanning tree
+/// parent, following Georgiadis, Tarjan, and Werneck, "Finding Dominators in Practice", 2006.
+/// Unlike the iterative algorithm, the running time does not depend on how many passes are
+/// needed for the graph to settle, so it is preferred for large or deeply nested graphs.
+/// The root must be the last block in the post-order list, and its immediate dominator must
+/// already be set to itself. Blocks not reachable from the root are given no dominator.
+/// \param postorder is the list of blocks in post-order
+/// \param numnodes is the number of blocks in the graph, minus one
+void BlockGraph::calcDominatorSemiNCA(const vector<FlowBlock *> &postorder,int4 numnodes)
+
+{
+  int4 size = postorder.size();
+  FlowBlock *root = postorder.back();
+  vector<FlowBlock *> vertex;		// Blocks in depth-first pre-order
+  vector<int4> dfnum(size,-1);		// Pre-order number of each block (by position in postorder)
+  vector<int4> parent;			// Spanning tree parent, by pre-order number
+  vector<int4> semi,label,ancestor,idom;
+  vector<pair<FlowBlock *,int4> > stack;	// Block and next out edge to follow
+  vector<int4> path;
+
+  dfnum[size-1] = 0;
+  vertex.push_back(root);
+  parent.push_back(-1);
+  stack.push_back(pair<FlowBlock *,int4>(root,0));
+  while(!stack.empty()) {
+    FlowBlock *bl = stack.back().first;
+    int4 edge = stack.back().second;
+    if (edge >= bl->sizeOut()) {
+      stack.pop_back();
+      continue;
+    }
+    stack.back().second += 1;
+    FlowBlock *child = bl->getOut(edge);
+    int4 pos = (child == root) ? size-1 : numnodes-child->index;
+    if (dfnum[pos] != -1) continue;
+    dfnum[pos] = vertex.size();
+    parent.push_back(dfnum[(bl == root) ? size-1 : numnodes-bl->index]);
+    vertex.push_back(child);
+    stack.push_back(pair<FlowBlock *,int4>(child,0));
+  }
+  int4 num = vertex.size();
+  semi.resize(num);
+  label.resize(num);
+  ancestor.resize(num,-1);
+  idom.resize(num);
+  for(int4 i=0;i<num;++i) {
+    semi[i] = i;
+    label[i] = i;
+  }
+  for(int4 w=num-1;w>0;--w) {	// Semi-dominators, in reverse pre-order
+    FlowBlock *bl = vertex[w];
+    for(int4 j=0;j<bl->sizeIn();++j) {
+      FlowBlock *in = bl->getIn(j);
+      int4 pos = (in == root) ? size-1 : numnodes-in->index;
+      int4 v = dfnum[pos];
+      if (v < 0) continue;		// Unreachable predecessor
+      if (ancestor[v] != -1) {	// Evaluate v, compressing its path to the forest root
+	path.clear();
+	int4 cur = v;
+	while(ancestor[ancestor[cur]] != -1) {
+	  path.push_back(cur);
+	  cur = ancestor[cur];
+	}
+	for(int4 k=path.size()-1;k>=0;--k) {
+	  int4 c = path[k];
+	  int4 a = ancestor[c];
+	  if (semi[label[a]] < semi[label[c]])
+	    label[c] = label[a];
+	  ancestor[c] = ancestor[a];
+	}
+	v = label[v];
+      }
+      if (semi[v] < semi[w])
+	semi[w] = semi[v];
+    }
+    ancestor[w] = parent[w];	// Link w into the forest
+  }
+  idom[0] = 0;
+  for(int4 w=1;w<num;++w) {	// Nearest common ancestor of semi-dominator and parent, in pre-order
+    int4 d = parent[w];
+    while(d > semi[w])
+      d = idom[d];
+    idom[w] = d;
+  }
+  for(int4 w=1;w<num;++w)
+    vertex[w]->immed_dom = vertex[idom[w]];
+}
+
+/// Calculate the immediate dominator for each FlowBlock node in \b this BlockGraph,
+/// for forward control-flow.
+/// The algorithm must be provided a list of entry points for the graph.
+/// We assume the blocks are in reverse post-order and this is reflected in the index field.
+/// The algorithm is chosen with setDominatorAlgorithm(). Both produce the same tree.
+/// \param rootlist is the list of entry point FlowBlocks
+void BlockGraph::calcForwardDominator(const vector<FlowBlock *> &rootlist)
+
+{
+  vector<FlowBlock *> postorder;
+  FlowBlock *virtualroot;
+  FlowBlock *b;
+  int4 i;
+
+  if (list.empty()) return;
+  int4 numnodes = list.size()-1;
+  postorder.resize(list.size());
+  for(i=0;i<list.size();++i) {
+    list[i]->immed_dom = (FlowBlock *)0; // Clear the dominator field
+    postorder[ numnodes-i ] = list[i]; // Construct a forward post order list
+  }
+  if (rootlist.size() > 1) {
+    virtualroot = createVirtualRoot(rootlist);
+    postorder.push_back(virtualroot);
+  }
+  else
+    virtualroot = (FlowBlock *)0;
+
+  b = postorder.back();		// The official start node
+  if (b->sizeIn() != 0) {	// Root node must have no in edges
+    if ((rootlist.size() != 1)||(rootlist[0] != b))
+      throw LowlevelError("Problems finding root node of graph");
+    virtualroot = createVirtualRoot(rootlist); // Create virtual root with no in edges
+    postorder.push_back(virtualroot);
+    b = virtualroot;
+  }
+  b->immed_dom = b;
+  if (domalgorithm == dom_semi_nca)
+    calcDominatorSemiNCA(postorder,numnodes);
+  else
+    calcDominatorIterative(postorder,numnodes);
   if (virtualroot != (FlowBlock *)0) { // If there was a virtual root, excise it from the dominator tree
     for(i=0;i<list.size();++i)
       if (postorder[i]->immed_dom == virtualroot)
@@ -2070,15 +2224,14 @@ bool BlockGraph::isConsistent(void) const
 /// This method also assigns the ordering index for the PcodeOp, getSeqNum().getOrder()
 /// \param iter points at the PcodeOp to insert before
 /// \param inst is the PcodeOp to insert
-void BlockBasic::insert(list<PcodeOp *>::iterator iter,PcodeOp *inst)
+void BlockBasic::insert(PcodeOpList::iterator iter,PcodeOp *inst)
 
 {
   uintm ordbefore,ordafter;
-  list<PcodeOp *>::iterator newiter;
+  PcodeOpList::iterator newiter;
 
   inst->setParent( this );
   newiter = op.insert(iter,inst);
-  inst->setBasicIter(newiter);
   if (newiter == op.begin())
     ordbefore = 2;		// This is minimum possible order val
   else {
@@ -2108,7 +2261,7 @@ void BlockBasic::removeOp(PcodeOp *inst)
 
 {
   inst->setParent( (BlockBasic *)0 );
-  op.erase(inst->basiciter);
+  op.erase(inst->getBasicIter());
 }
 
 /// This relies slightly on \e normal semantics: when instructions \e fall-thru during execution,
@@ -2196,7 +2349,8 @@ void BlockBasic::flipInPlaceExecute(void)
 bool BlockBasic::isComplex(void) const
 
 {
-  list<PcodeOp *>::const_iterator iter,iter2;
+  DescendList::const_iterator iter2;
+  PcodeOpList::const_iterator iter;
   PcodeOp *inst,*d_op;
   Varnode *vn;
   int4 statement,maxref;
@@ -2352,7 +2506,7 @@ bool BlockBasic::unblockedMulti(int4 outslot) const
   const BlockBasic *blout = (const BlockBasic *)getOut(outslot);
   const FlowBlock *bl;
   PcodeOp *multiop,*othermulti;
-  list<PcodeOp *>::const_iterator iter;
+  PcodeOpList::const_iterator iter;
   Varnode *vnremove,*vnredund;
   
 				// First we build list of blocks which would have
@@ -2394,7 +2548,7 @@ bool BlockBasic::hasOnlyMarkers(void) const
 
 {
   // (and a branch)
-  list<PcodeOp *>::const_iterator iter;
+  PcodeOpList::const_iterator iter;
   const PcodeOp *bop;
 
   for(iter=op.begin();iter!=op.end();++iter) {
@@ -2446,7 +2600,7 @@ void BlockBasic::setInitialRange(const Address &beg,const Address &end)
 void BlockBasic::setOrder(void)
 
 {
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter;
   uintm count,step;
 
   step = ~((uintm)0);
@@ -2481,7 +2635,7 @@ void BlockBasic::printHeader(std::ostream &s) const
 void BlockBasic::printRaw(std::ostream &s) const
   
 {
-  list<PcodeOp *>::const_iterator iter;
+  PcodeOpList::const_iterator iter;
   PcodeOp *inst;
 
   printHeader(s);
@@ -173,7 +173,8 @@ void LoopBody::extend(vector<FlowBlock *> &body) const
 /// First build a set of trial exits, preferring from a \b tail, then from  \b head,
 /// then from the middle. If there is no containing loop, just return the first such exit we find.
 /// \param body is the list FlowBlock objects in the loop body, which we assume are marked.
-void LoopBody::findExit(const vector<FlowBlock *> &body)
+/// \param forest is the nesting of the loops, used to test membership in the containing loop if it is valid
+void LoopBody::findExit(const vector<FlowBlock *> &body,const LoopForest &forest)
 
 {
   vector<FlowBlock *> trialexit;
@@ -218,7 +219,16 @@ void LoopBody::findExit(const vector<FlowBlock *> &body)
     return;
 
   // If there is a containing loop, force exitblock to be in the containing loop
-  if (immed_container != (LoopBody *)0) {
+  if (immed_container != (LoopBody *)0 && forest.isValid()) {
+    for(int4 i=0;i<trialexit.size();++i) {
+      FlowBlock *bl = trialexit[i];
+      if (forest.contains(immed_container,bl)) {
+	exitblock = bl;
+	break;
+      }
+    }
+  }
+  else if (immed_container != (LoopBody *)0) {
     vector<FlowBlock *> extension;
     extendToContainer(*immed_container,extension);
     for(int4 i=0;i<trialexit.size();++i) {
@@ -351,6 +361,16 @@ void LoopBody::labelContainments(const vector<FlowBlock *> &body,const vector<Lo
   }
 }
 
+/// The \b depth and \b immed_container fields are taken from the forest, which must be valid,
+/// instead of being accumulated as each containing loop traces its body.
+/// \param forest is the nesting of all the loops
+void LoopBody::labelContainments(const LoopForest &forest)
+
+{
+  depth = forest.getDepth(head);
+  immed_container = forest.getContainer(head);
+}
+
 /// Add edges that exit from \b this loop body to the list of likely \e gotos,
 /// giving them the proper priority.
 /// \param likely will hold the exit edges in (reverse) priority order
@@ -1037,6 +1057,134 @@ void LoopBody::clearMarks(vector<FlowBlock *> &body)
     body[i]->clearMark();
 }
 
+/// Nodes are collapsed into the head of the loop they are added to, and the root of a node is the
+/// head of the outermost loop built so far that contains it.  The path is compressed along the way.
+/// \param rep is the node each node has been collapsed into, indexed by node
+/// \param i is the given node
+/// \return the root of the node
+int4 LoopForest::findRoot(vector<int4> &rep,int4 i)
+
+{
+  int4 root = i;
+  while(rep[root] != root)
+    root = rep[root];
+  while(rep[i] != root) {
+    int4 next = rep[i];
+    rep[i] = root;
+    i = next;
+  }
+  return root;
+}
+
+void LoopForest::clear(void)
+
+{
+  valid = false;
+  innermost.clear();
+  parent.clear();
+  depth.clear();
+  headloop.clear();
+}
+
+/// Loop heads are processed in reverse order of their index.  As the graph is in reverse post-order,
+/// a loop is processed before any loop containing it.  If the trace of a loop reaches the head of
+/// a loop that hasn't been processed yet, the loops don't nest, and the build fails.
+/// \param graph is the control-flow graph, with nodes in order of their index
+/// \param loopbody is the list of loops, one for each distinct head
+/// \return \b true if the forest was built
+bool LoopForest::build(const BlockGraph &graph,list<LoopBody> &loopbody)
+
+{
+  clear();
+  int4 size = graph.getSize();
+  for(int4 i=0;i<size;++i)
+    if (graph.getBlock(i)->getIndex() != i) return false;
+  innermost.resize(size,-1);
+  parent.resize(size,-1);
+  depth.resize(size,0);
+  headloop.resize(size,(LoopBody *)0);
+  vector<int4> heads;
+  list<LoopBody>::iterator iter;
+  for(iter=loopbody.begin();iter!=loopbody.end();++iter) {
+    int4 h = (*iter).getHead()->getIndex();
+    headloop[h] = &(*iter);
+    heads.push_back(h);
+  }
+  sort(heads.begin(),heads.end());
+
+  vector<int4> rep(size);
+  for(int4 i=0;i<size;++i)
+    rep[i] = i;
+  vector<int4> worklist;
+  for(int4 j=heads.size()-1;j>=0;--j) {
+    int4 h = heads[j];
+    innermost[h] = h;
+    worklist.clear();
+    const vector<FlowBlock *> &tails( headloop[h]->getTails() );
+    for(int4 k=0;k<tails.size();++k) {
+      int4 x = findRoot(rep,tails[k]->getIndex());
+      if (x == h) continue;
+      rep[x] = h;
+      worklist.push_back(x);
+    }
+    int4 pos = 0;
+    while(pos < worklist.size()) {
+      int4 x = worklist[pos++];
+      if (headloop[x] != (LoopBody *)0) {
+	if (x < h) {		// Reached the head of a loop that doesn't nest inside this one
+	  clear();
+	  return false;
+	}
+	parent[x] = h;
+      }
+      else
+	innermost[x] = h;
+      const FlowBlock *bl = graph.getBlock(x);
+      int4 sizein = bl->sizeIn();
+      for(int4 k=0;k<sizein;++k) {
+	if (bl->isGotoIn(k)) continue; // Don't trace back through irreducible edges
+	int4 y = findRoot(rep,bl->getIn(k)->getIndex());
+	if (y == h) continue;	// Already in the body
+	rep[y] = h;
+	worklist.push_back(y);
+      }
+    }
+  }
+  for(int4 j=0;j<heads.size();++j) {	// Containing loops come first
+    int4 h = heads[j];
+    if (parent[h] >= 0)
+      depth[h] = depth[parent[h]] + 1;
+  }
+  valid = true;
+  return true;
+}
+
+/// \param head is the head of the given loop
+/// \return the immediately containing loop or NULL
+LoopBody *LoopForest::getContainer(const FlowBlock *head) const
+
+{
+  int4 p = parent[head->getIndex()];
+  if (p < 0) return (LoopBody *)0;
+  return headloop[p];
+}
+
+/// The FlowBlock is in the loop if the loop is its innermost loop or contains its innermost loop.
+/// \param loop is the given loop
+/// \param bl is the given FlowBlock
+/// \return \b true if the FlowBlock is in the body of the loop
+bool LoopForest::contains(const LoopBody *loop,const FlowBlock *bl) const
+
+{
+  int4 i = bl->getIndex();
+  if (i < 0 || i >= innermost.size()) return false;
+  int4 h = loop->getHead()->getIndex();
+  int4 x = innermost[i];
+  while(x >= 0 && depth[x] > depth[h])
+    x = parent[x];
+  return (x == h);
+}
+
 /// \brief Mark FlowBlocks \b only reachable from a given root
 ///
 /// For a given root FlowBlock, find all the FlowBlocks that can only be reached from it,
@@ -1160,17 +1308,23 @@ void CollapseStructure::orderLoopBodies(void)
 	  ++iter;
       }
     }
-    for(iter=loopbody.begin();iter!=loopbody.end();++iter) {
-      vector<FlowBlock *> body;
-      (*iter).findBase(body);
-      (*iter).labelContainments(body,looporder);
-      LoopBody::clearMarks(body);
+    if (loopforest.build(graph,loopbody)) {
+      for(iter=loopbody.begin();iter!=loopbody.end();++iter)
+	(*iter).labelContainments(loopforest);
+    }
+    else {
+      for(iter=loopbody.begin();iter!=loopbody.end();++iter) {
+	vector<FlowBlock *> body;
+	(*iter).findBase(body);
+	(*iter).labelContainments(body,looporder);
+	LoopBody::clearMarks(body);
+      }
     }
     loopbody.sort(); // Sort based on nesting depth (deepest come first) (sorting is stable)
     for(iter=loopbody.begin();iter!=loopbody.end();++iter) {
       vector<FlowBlock *> body;
       (*iter).findBase(body);
-      (*iter).findExit(body);
+      (*iter).findExit(body,loopforest);
       (*iter).orderTails();
       (*iter).extend(body);
       (*iter).labelExitEdges(body);
@@ -1230,6 +1384,7 @@ bool CollapseStructure::updateLoopBody(void)
   }
   likelylistfull = true;
   likelyiter = likelygoto.begin();
+  likelytaken = 0;
   return true;
 }
 
@@ -1237,20 +1392,40 @@ bool CollapseStructure::updateLoopBody(void)
 /// trace of the current innermost loop.  Given ongoing collapsing, this
 /// may involve updating which loop is currently innermost and throwing
 /// out potential edges whose endpoints have already been collapsed.
-/// \return the FlowBlock whose outgoing edge was marked \e unstructured or NULL
+///
+/// Normally one edge is marked, and the graph is collapsed before the next is selected.  Once
+/// more than \b gotobatchstart edges have been needed from the same \e likely list, as happens
+/// for flattened or otherwise irreducible control-flow, the following edges from the list are
+/// marked in growing batches, so that each collapse pass over the graph is shared by several
+/// gotos.  Edges that the collapse would have made unnecessary are rare that deep into a list.
+/// \return the first FlowBlock whose outgoing edge was marked \e unstructured or NULL
 FlowBlock *CollapseStructure::selectGoto(void)
 
 {
   while(updateLoopBody()) {
+    FlowBlock *firstbl = (FlowBlock *)0;
+    int4 batch = 1;
+    if (likelytaken >= gotobatchstart) {
+      batch = likelytaken / gotobatchstart + 1;
+      if (batch > gotobatchmax)
+	batch = gotobatchmax;
+    }
     while(likelyiter != likelygoto.end()) {
       int4 outedge;
       FlowBlock *startbl = (*likelyiter).getCurrentEdge(outedge,&graph);
       ++likelyiter;
-      if (startbl != (FlowBlock *)0) {
-	startbl->setGotoBranch(outedge); // Mark the selected branch as goto
-	return startbl;
-      }
-    }
+      if (startbl == (FlowBlock *)0) continue;
+      if (firstbl != (FlowBlock *)0 && startbl->isGotoOut(outedge))
+	continue;		// Already marked earlier in this batch
+      startbl->setGotoBranch(outedge); // Mark the selected branch as goto
+      likelytaken += 1;
+      if (firstbl == (FlowBlock *)0)
+	firstbl = startbl;
+      batch -= 1;
+      if (batch == 0) break;
+    }
+    if (firstbl != (FlowBlock *)0)
+      return firstbl;
   }
   if (!clipExtraRoots())
     throw LowlevelError("Could not finish collapsing block structure");
@@ -1850,6 +2025,7 @@ CollapseStructure::CollapseStructure(BlockGraph &g)
   : graph(g)
 {
   dataflow_changecount = 0;
+  likelytaken = 0;
 }
 
 /// Collapse everything in the control-flow graph to isolated blocks with no inputs and outputs.
@@ -1884,6 +2060,123 @@ bool ConditionalJoin::MergePair::operator<(const MergePair &op2) const
   return (side2->getCreateIndex() < op2.side2->getCreateIndex());
 }
 
+/// Any previous graph is thrown away.
+/// \param numnodes is the number of nodes in the graph
+/// \param edges holds the (source,destination) node numbers of each edge, flattened
+void EdgeListStructure::build(int4 numnodes,const vector<int4> &edges)
+
+{
+  clear();
+  if (numnodes <= 0)
+    throw LowlevelError("Edge list has no nodes");
+  for(int4 i=0;i<numnodes;++i)
+    ingraph.newBlock(i);
+  for(int4 i=0;i+1<edges.size();i+=2) {
+    int4 src = edges[i];
+    int4 dst = edges[i+1];
+    if (src < 0 || src >= numnodes || dst < 0 || dst >= numnodes)
+      throw LowlevelError("Bad node in edge list");
+    ingraph.addEdge(ingraph.getBlock(src),ingraph.getBlock(dst));
+  }
+}
+
+/// \param s is the stream holding the node count and edges
+void EdgeListStructure::restore(istream &s)
+
+{
+  int4 numnodes = -1;
+  s >> ws >> numnodes;
+  if (s.fail())
+    throw LowlevelError("Bad edge list");
+  vector<int4> edges;
+  int4 val;
+  while(s >> val)
+    edges.push_back(val);
+  if (!s.eof() || (edges.size() & 1) != 0)
+    throw LowlevelError("Bad edge list");
+  build(numnodes,edges);
+}
+
+void EdgeListStructure::structure(void)
+
+{
+  vector<FlowBlock *> rootlist;
+
+  resultgraph.clear();
+  resultgraph.buildCopy(ingraph);
+  resultgraph.structureLoops(rootlist);
+  resultgraph.calcForwardDominator(rootlist);
+
+  CollapseStructure collapse(resultgraph);
+  collapse.collapseAll();
+  resultgraph.orderBlocks();
+}
+
+/// \param s is the output stream
+/// \param target is the target of the unstructured edge
+/// \param gototype is the type of the edge, or 0 if it has no type
+void EdgeListStructure::encodeTarget(ostream &s,const FlowBlock *target,uint4 gototype)
+
+{
+  const FlowBlock *leaf = target->getFrontLeaf();
+  s << " @" << leaf->subBlock(0)->getIndex() << ':' << target->calcDepth(leaf) << ':' << gototype;
+}
+
+/// \param s is the output stream
+/// \param bl is the block to encode, along with all its components
+void EdgeListStructure::encodeBlock(ostream &s,const FlowBlock *bl)
+
+{
+  FlowBlock::block_type bt = bl->getType();
+  if (bt == FlowBlock::t_copy) {
+    s << bl->subBlock(0)->getIndex();
+    return;
+  }
+  const BlockGraph *graph = (const BlockGraph *)bl;
+  s << '(';
+  switch(bt) {
+  case FlowBlock::t_if:
+    if (graph->getSize() == 1) {
+      const BlockIf *ifbl = (const BlockIf *)bl;
+      s << "ifgoto";
+      encodeTarget(s,ifbl->getGotoTarget(),ifbl->getGotoType());
+    }
+    else
+      s << ((graph->getSize() == 2) ? "properif" : "ifelse");
+    break;
+  case FlowBlock::t_condition:
+    s << "condition " << ((((const BlockCondition *)bl)->getOpcode() == CPUI_BOOL_AND) ? "and" : "or");
+    break;
+  case FlowBlock::t_goto:
+    s << "goto";
+    encodeTarget(s,((const BlockGoto *)bl)->getGotoTarget(),((const BlockGoto *)bl)->getGotoType());
+    break;
+  case FlowBlock::t_multigoto:
+    s << "multigoto";
+    for(int4 i=0;i<((const BlockMultiGoto *)bl)->numGotos();++i)
+      encodeTarget(s,((const BlockMultiGoto *)bl)->getGoto(i),0);
+    break;
+  default:
+    s << FlowBlock::typeToName(bt);
+    break;
+  }
+  for(int4 i=0;i<graph->getSize();++i) {
+    s << ' ';
+    encodeBlock(s,graph->getBlock(i));
+  }
+  s << ')';
+}
+
+/// \param s is the output stream
+void EdgeListStructure::encode(ostream &s) const
+
+{
+  for(int4 i=0;i<resultgraph.getSize();++i) {
+    encodeBlock(s,resultgraph.getBlock(i));
+    s << '\n';
+  }
+}
+
 /// Given two conditional blocks, determine if the corresponding conditional
 /// expressions are equivalent, up to Varnodes that need to be merged.
 /// Any Varnode pairs that need to be merged are put in the \b mergeneed map.
@@ -1933,7 +2226,7 @@ bool ConditionalJoin::findDups(void)
 void ConditionalJoin::checkExitBlock(BlockBasic *exit,int4 in1,int4 in2)
 
 {
-  list<PcodeOp *>::const_iterator iter,enditer;
+  PcodeOpList::const_iterator iter,enditer;
 
   iter = exit->beginOp();
   enditer = exit->endOp();
@@ -1960,7 +2253,7 @@ void ConditionalJoin::checkExitBlock(BlockBasic *exit,int4 in1,int4 in2)
 void ConditionalJoin::cutDownMultiequals(BlockBasic *exit,int4 in1,int4 in2)
 
 {
-  list<PcodeOp *>::const_iterator iter,enditer;
+  PcodeOpList::const_iterator iter,enditer;
 
   int4 lo,hi;
   if (in1 > in2) {
@@ -2221,7 +2514,7 @@ void ActionReturnSplit::gatherReturnGotos(FlowBlock *parent,vector<FlowBlock *>
 bool ActionReturnSplit::isSplittable(BlockBasic *b)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  PcodeOpList::const_iterator iter;
   PcodeOp *op;
 
   for(iter=b->beginOp();iter!=b->endOp();++iter) {
@@ -15,6 +15,7 @@
  */
 #include "callgraph.hh"
 #include "funcdata.hh"
+#include "insnindex.hh"
 
 namespace GhidraDec {
 void CallGraphEdge::saveXml(ostream &s) const
@@ -432,6 +433,275 @@ void CallGraph::buildEdges(Funcdata *fd)
   }
 }
 
+/// Build edges for every node with code, without decompiling.  The entry points are traced
+/// in parallel through the Architecture's InstructionIndex, which decodes each instruction at
+/// most once across all functions.  Edges follow direct calls only; the graph itself is
+/// updated by the calling thread after all tracing is complete.
+/// \param numthreads is the number of threads to trace with
+void CallGraph::buildEdgesIndexed(int4 numthreads)
+
+{
+  vector<CallGraphNode *> nodes;
+  vector<Address> entries;
+  map<Address,CallGraphNode>::iterator iter;
+  for(iter=graph.begin();iter!=graph.end();++iter) {
+    CallGraphNode *node = &(*iter).second;
+    if (node->fd == (Funcdata *)0 || node->fd->hasNoCode()) continue;
+    nodes.push_back(node);
+    entries.push_back(node->entryaddr);
+  }
+  if (glb->insnindex == (InstructionIndex *)0)
+    glb->insnindex = new InstructionIndex(glb->translate);
+
+  vector<vector<pair<Address,Address> > > results;
+  glb->insnindex->traceAll(entries,numthreads,results,~((uint4)0));
+  for(int4 i=0;i<nodes.size();++i) {
+    const vector<pair<Address,Address> > &calls( results[i] );
+    for(int4 j=0;j<calls.size();++j) {
+      const Address &addr( calls[j].second );
+      CallGraphNode *tonode = findNode(addr);
+      if (tonode == (CallGraphNode *)0) {
+	string name;
+	glb->nameFunction(addr,name);
+	tonode = addNode(addr,name);
+      }
+      addEdge(nodes[i],tonode,calls[j].first);
+    }
+  }
+}
+
+void CallGraph::partition(int4 numrounds,int4 numparts,vector<CallGraphPartition> &res)
+
+{ // Split the nodes with code into rounds by their height above the leaves, then split each
+  // round into at most -numparts- partitions, keeping connected nodes together
+  map<CallGraphNode *,int4> nodeindex;
+  vector<CallGraphNode *> nodes;
+  res.clear();
+  CallGraphNode *node = initLeafWalk();
+  while(node != (CallGraphNode *)0) {
+    Funcdata *fd = node->getFuncdata();
+    if (fd != (Funcdata *)0 && !fd->hasNoCode() && nodeindex.find(node) == nodeindex.end()) {
+      nodeindex[node] = nodes.size();
+      nodes.push_back(node);
+    }
+    node = nextLeaf(node);
+  }
+  if (nodes.empty()) return;
+  if (numrounds < 1) numrounds = 1;
+  if (numparts < 1) numparts = 1;
+
+  // Height is 0 for a leaf, and one more than the highest callee otherwise. Callees that
+  // aren't snipped by a cycle are visited first, as the edges left form a DAG.
+  vector<vector<int4> > callers(nodes.size());
+  vector<int4> pending(nodes.size(),0);
+  for(int4 i=0;i<nodes.size();++i) {
+    for(int4 j=0;j<nodes[i]->numOutEdge();++j) {
+      if (nodes[i]->getOutEdge(j).isCycle()) continue;
+      map<CallGraphNode *,int4>::const_iterator iter = nodeindex.find(nodes[i]->getOutNode(j));
+      if (iter == nodeindex.end() || (*iter).second == i) continue;
+      callers[(*iter).second].push_back(i);
+      pending[i] += 1;
+    }
+  }
+  vector<int4> height(nodes.size(),0);
+  vector<int4> order;
+  for(int4 i=0;i<nodes.size();++i)
+    if (pending[i] == 0) order.push_back(i);
+  for(int4 i=0;i<order.size();++i) {
+    const vector<int4> &up(callers[order[i]]);
+    for(int4 j=0;j<up.size();++j) {
+      if (height[up[j]] <= height[order[i]])
+	height[up[j]] = height[order[i]] + 1;
+      pending[up[j]] -= 1;
+      if (pending[up[j]] == 0)
+	order.push_back(up[j]);
+    }
+  }
+
+  // Whole heights are assigned to rounds, so rounds hold about the same number of nodes
+  int4 maxheight = 0;
+  for(int4 i=0;i<nodes.size();++i)
+    if (height[i] > maxheight) maxheight = height[i];
+  vector<int4> below(maxheight+2,0);	// Number of nodes lower than each height
+  for(int4 i=0;i<nodes.size();++i)
+    below[height[i]+1] += 1;
+  for(int4 h=1;h<below.size();++h)
+    below[h] += below[h-1];
+  vector<int4> round(nodes.size());
+  for(int4 i=0;i<nodes.size();++i)
+    round[i] = (int4)(((uint8)below[height[i]] * numrounds) / nodes.size());
+
+  // Union nodes joined by any edge within the same round
+  vector<int4> rep(nodes.size());
+  for(int4 i=0;i<nodes.size();++i)
+    rep[i] = i;
+  for(int4 i=0;i<nodes.size();++i) {
+    for(int4 j=0;j<nodes[i]->numOutEdge();++j) {
+      map<CallGraphNode *,int4>::const_iterator iter = nodeindex.find(nodes[i]->getOutNode(j));
+      if (iter == nodeindex.end() || round[(*iter).second] != round[i]) continue;
+      int4 a = i;
+      while(rep[a] != a) a = rep[a] = rep[rep[a]];
+      int4 b = (*iter).second;
+      while(rep[b] != b) b = rep[b] = rep[rep[b]];
+      if (a < b) rep[b] = a;
+      else rep[a] = b;
+    }
+  }
+  map<int4,vector<int4> > components;	// Members of each component, by representative
+  for(int4 i=0;i<nodes.size();++i) {
+    int4 a = i;
+    while(rep[a] != a) a = rep[a];
+    components[a].push_back(i);
+  }
+
+  // Within a round, the largest component goes to the partition with the fewest nodes
+  for(int4 r=0;r<numrounds;++r) {
+    vector<pair<int4,int4> > sizes;	// (-size,representative) so the largest sort first
+    map<int4,vector<int4> >::const_iterator citer;
+    for(citer=components.begin();citer!=components.end();++citer) {
+      if (round[(*citer).first] == r)
+	sizes.push_back(pair<int4,int4>(-(int4)(*citer).second.size(),(*citer).first));
+    }
+    if (sizes.empty()) continue;
+    sort(sizes.begin(),sizes.end());
+    int4 first = res.size();
+    int4 count = (sizes.size() < numparts) ? sizes.size() : numparts;
+    res.resize(first + count);
+    for(int4 k=0;k<sizes.size();++k) {
+      int4 best = first;
+      for(int4 p=first+1;p<res.size();++p)
+	if (res[p].nodes.size() < res[best].nodes.size()) best = p;
+      const vector<int4> &members(components[sizes[k].second]);
+      for(int4 m=0;m<members.size();++m)
+	res[best].nodes.push_back(nodes[members[m]]);
+    }
+    for(int4 p=first;p<res.size();++p) {
+      res[p].round = r;
+      vector<CallGraphNode *> &pnodes(res[p].nodes);
+      vector<pair<Address,CallGraphNode *> > byaddr;
+      for(int4 m=0;m<pnodes.size();++m)
+	byaddr.push_back(pair<Address,CallGraphNode *>(pnodes[m]->getAddr(),pnodes[m]));
+      sort(byaddr.begin(),byaddr.end());
+      for(int4 m=0;m<pnodes.size();++m)
+	pnodes[m] = byaddr[m].second;
+    }
+  }
+}
+
+void CallGraphCsr::build(CallGraph &graph)
+
+{ // Number the nodes, pack their out edges, then find components and layers
+  nodes.clear();
+  offset.clear();
+  targets.clear();
+  map<Address,CallGraphNode>::iterator iter;
+  for(iter=graph.begin();iter!=graph.end();++iter) {
+    CallGraphNode *node = &(*iter).second;
+    node->csrindex = nodes.size();
+    nodes.push_back(node);
+  }
+  int4 numedges = 0;
+  for(int4 i=0;i<nodes.size();++i)
+    numedges += nodes[i]->outedge.size();
+  offset.reserve(nodes.size()+1);
+  targets.reserve(numedges);
+  for(int4 i=0;i<nodes.size();++i) {
+    offset.push_back(targets.size());
+    const CallGraphNode *node = nodes[i];
+    for(int4 j=0;j<node->numOutEdge();++j)
+      targets.push_back(node->getOutNode(j)->csrindex);
+  }
+  offset.push_back(targets.size());
+  findComponents();
+  findLayers();
+}
+
+void CallGraphCsr::findComponents(void)
+
+{ // Tarjan's algorithm with an explicit stack of (node,next edge) frames.  A component is
+  // completed only after every component it can reach, so numbering is callees-first.
+  int4 num = nodes.size();
+  vector<int4> visit(num,-1);	// Order in which each node was first visited
+  vector<int4> low(num,0);	// Lowest visit order reachable through the search tree
+  vector<bool> onstack(num,false);
+  vector<int4> stack;		// Visited nodes not yet assigned to a component
+  vector<pair<int4,int4> > frames;
+  int4 counter = 0;
+  int4 numcomp = 0;
+  component.assign(num,-1);
+  for(int4 root=0;root<num;++root) {
+    if (visit[root] >= 0) continue;
+    visit[root] = low[root] = counter++;
+    stack.push_back(root);
+    onstack[root] = true;
+    frames.push_back(pair<int4,int4>(root,offset[root]));
+    while(!frames.empty()) {
+      int4 v = frames.back().first;
+      int4 e = frames.back().second;
+      if (e < offset[v+1]) {
+	frames.back().second += 1;
+	int4 w = targets[e];
+	if (visit[w] < 0) {
+	  visit[w] = low[w] = counter++;
+	  stack.push_back(w);
+	  onstack[w] = true;
+	  frames.push_back(pair<int4,int4>(w,offset[w]));
+	}
+	else if (onstack[w] && visit[w] < low[v])
+	  low[v] = visit[w];
+	continue;
+      }
+      frames.pop_back();
+      if (low[v] == visit[v]) {
+	int4 w;
+	do {
+	  w = stack.back();
+	  stack.pop_back();
+	  onstack[w] = false;
+	  component[w] = numcomp;
+	} while(w != v);
+	numcomp += 1;
+      }
+      if (!frames.empty()) {
+	int4 u = frames.back().first;
+	if (low[v] < low[u])
+	  low[u] = low[v];
+      }
+    }
+  }
+  layer.assign(numcomp,0);
+}
+
+void CallGraphCsr::findLayers(void)
+
+{ // Components are numbered callees-first, so visiting them in order sees every callee's layer
+  int4 num = nodes.size();
+  vector<int4> start(layer.size()+1,0);	// Group the nodes by component
+  for(int4 i=0;i<num;++i)
+    start[component[i]+1] += 1;
+  for(int4 c=1;c<start.size();++c)
+    start[c] += start[c-1];
+  vector<int4> members(num);
+  vector<int4> fill(start.begin(),start.end()-1);
+  for(int4 i=0;i<num;++i)
+    members[fill[component[i]]++] = i;
+  numlayers = 0;
+  for(int4 c=0;c<layer.size();++c) {
+    int4 lay = 0;
+    for(int4 m=start[c];m<start[c+1];++m) {
+      int4 v = members[m];
+      for(int4 e=offset[v];e<offset[v+1];++e) {
+	int4 wc = component[targets[e]];
+	if (wc != c && layer[wc] >= lay)
+	  lay = layer[wc] + 1;
+      }
+    }
+    layer[c] = lay;
+    if (lay >= numlayers)
+      numlayers = lay + 1;
+  }
+}
+
 void CallGraph::saveXml(ostream &s) const
 
 {
@@ -453,6 +723,24 @@ void CallGraph::saveXml(ostream &s) const
   s << "</callgraph>\n";
 }
 
+void CallGraph::saveXml(ostream &s,const vector<CallGraphNode *> &nodes) const
+
+{ // Save the subgraph made up of the given nodes and the edges between them
+  set<const CallGraphNode *> inset(nodes.begin(),nodes.end());
+
+  s << "<callgraph>\n";
+  for(int4 i=0;i<nodes.size();++i)
+    nodes[i]->saveXml(s);
+  for(int4 i=0;i<nodes.size();++i) {
+    const CallGraphNode *node = nodes[i];
+    for(uint4 j=0;j<node->inedge.size();++j) {
+      if (inset.find(node->inedge[j].from) != inset.end())
+	node->inedge[j].saveXml(s);
+    }
+  }
+  s << "</callgraph>\n";
+}
+
 void CallGraph::restoreXml(const Element *el)
 
 {
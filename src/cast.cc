@@ -15,6 +15,7 @@
  */
 #include "cast.hh"
 #include "op.hh"
+#include "metrics.hh"
 
 namespace GhidraDec {
 /// Sets the TypeFactory used to produce data-types for the arithmeticOutputStandard() method
@@ -26,6 +27,41 @@ void CastStrategy::setTypeFactory(TypeFactory *t)
   promoteSize = tlst->getSizeOfInt();
 }
 
+/// \param s is the strategy whose castStandard() decisions are remembered
+/// \param t is the TypeFactory
+void CastStrategyMemo::setStrategy(CastStrategy *s,TypeFactory *t)
+
+{
+  base = s;
+  setTypeFactory(t);
+  for(int4 i=0;i<numEntries;++i)
+    table[i].flags = 0;
+}
+
+/// A decision is looked up in the table, and only made by the underlying strategy if it is not there.
+/// Hits are counted as AnalysisMetrics::cast_memo_hit, and misses as the underlying test.
+/// \param reqtype is the data-type required by the operation
+/// \param curtype is the data-type of the value
+/// \param care_uint_int is \b true if a change in signedness should be cast
+/// \param care_ptr_uint is \b true if a change between pointer and unsigned integer should be cast
+/// \return the data-type to cast to, or NULL if no cast is needed
+Datatype *CastStrategyMemo::castStandard(Datatype *reqtype,Datatype *curtype,bool care_uint_int,bool care_ptr_uint) const
+
+{
+  uint4 flags = 4 | (care_uint_int ? 1 : 0) | (care_ptr_uint ? 2 : 0);
+  uintp hash = ((uintp)reqtype >> 3) * 31 + ((uintp)curtype >> 3) + flags;
+  Entry &entry(table[(hash ^ (hash >> 8)) & (numEntries-1)]);
+  if (entry.flags == flags && entry.reqtype == reqtype && entry.curtype == curtype) {
+    AnalysisMetrics::count(AnalysisMetrics::cast_memo_hit);
+    return entry.result;
+  }
+  entry.result = base->castStandard(reqtype,curtype,care_uint_int,care_ptr_uint);
+  entry.reqtype = reqtype;
+  entry.curtype = curtype;
+  entry.flags = flags;
+  return entry.result;
+}
+
 bool CastStrategyC::checkIntPromotionForCompare(const PcodeOp *op,int4 slot) const
 
 {
@@ -171,6 +207,7 @@ Datatype *CastStrategyC::castStandard(Datatype *reqtype,Datatype *curtype,
 				      bool care_uint_int,bool care_ptr_uint) const
 
 {				// Generic casting rules that apply for most ops
+  AnalysisMetrics::count(AnalysisMetrics::cast_check);
   if (curtype == reqtype) return (Datatype *)0; // Types are equal, no cast required
   Datatype *reqbase = reqtype;
   Datatype *curbase = curtype;
@@ -308,6 +345,7 @@ Datatype *CastStrategyJava::castStandard(Datatype *reqtype,Datatype *curtype,
 					 bool care_uint_int,bool care_ptr_uint) const
 
 {
+  AnalysisMetrics::count(AnalysisMetrics::cast_check);
   if (curtype == reqtype) return (Datatype *)0; // Types are equal, no cast required
   Datatype *reqbase = reqtype;
   Datatype *curbase = curtype;
@@ -18,6 +18,9 @@
 #include "codedata.hh"
 #include "loadimage_bfd.hh"
 
+#include <thread>
+#include <algorithm>
+
 namespace GhidraDec {
 // Constructing this registers the capability
 IfaceCodeDataCapability IfaceCodeDataCapability::ifaceCodeDataCapability;
@@ -362,9 +365,13 @@ void CodeDataAnalysis::disassembleRange(const Range &range)
   }
 }
 
-void CodeDataAnalysis::disassembleRangeList(const RangeList &rangelist)
+void CodeDataAnalysis::disassembleRangeList(const RangeList &rangelist,int4 numthreads)
 
 {
+  if (numthreads > 1) {
+    disassembleParallel(rangelist,numthreads);
+    return;
+  }
   set<Range>::const_iterator iter,enditer;
   iter = rangelist.begin();
   enditer = rangelist.end();
@@ -375,6 +382,242 @@ void CodeDataAnalysis::disassembleRangeList(const RangeList &rangelist)
   }
 }
 
+const SweptBlock *SweptChunk::find(uintb off) const
+
+{
+  int4 min = 0;
+  int4 max = blocks.size() - 1;
+  while(min <= max) {
+    int4 mid = (min + max) / 2;
+    if (blocks[mid].start == off)
+      return &blocks[mid];
+    if (blocks[mid].start < off)
+      min = mid + 1;
+    else
+      max = mid - 1;
+  }
+  return (const SweptBlock *)0;
+}
+
+Address CodeDataAnalysis::sweepBlock(DisassemblyEngine &engine,const Address &addr,SweptChunk &chunk)
+
+{ // Disassemble a block exactly as disassembleBlock would, returning the address after it.
+  // As long as no instruction reaches the chunk limit, nothing already committed can
+  // affect the block.  If one does, the block is dropped and an invalid address returned.
+  DisassemblyResult disresult;
+  SweptBlock block;
+  block.start = addr.getOffset();
+  block.firstunit = chunk.units.size();
+  block.firstref = chunk.refs.size();
+  Address curaddr = addr;
+  for(;;) {
+    engine.disassemble(curaddr,disresult);
+    if (!disresult.success) {	// Bad disassembly, the whole block becomes one notcode unit
+      chunk.units.resize(block.firstunit);
+      chunk.refs.erase(chunk.refs.begin() + block.firstref,chunk.refs.end());
+      chunk.units.push_back(CodeUnit());
+      chunk.units.back().flags = CodeUnit::notcode;
+      int4 wholesize = curaddr.getOffset() + 1 - addr.getOffset();
+      if (wholesize < 10)
+	wholesize = 1;
+      chunk.units.back().size = wholesize;
+      curaddr = addr + wholesize;
+      break;
+    }
+    Address nextaddr = curaddr + disresult.length;
+    if (nextaddr <= curaddr || chunk.limit <= nextaddr) {
+      chunk.units.resize(block.firstunit);
+      chunk.refs.erase(chunk.refs.begin() + block.firstref,chunk.refs.end());
+      return Address();
+    }
+    if ((disresult.flags & CodeUnit::jump)!=0)
+      chunk.refs.push_back(pair<AddrLink,uint4>(AddrLink(curaddr,disresult.jumpaddress),disresult.flags));
+    chunk.units.push_back(CodeUnit());
+    chunk.units.back().flags = disresult.flags;
+    chunk.units.back().size = disresult.length;
+    curaddr = nextaddr;
+    if ((disresult.flags & CodeUnit::fallthru)==0)
+      break;
+  }
+  block.numunits = chunk.units.size() - block.firstunit;
+  block.numrefs = chunk.refs.size() - block.firstref;
+  chunk.blocks.push_back(block);
+  return curaddr;
+}
+
+void CodeDataAnalysis::sweepWorker(vector<SweptChunk> &chunks,std::atomic<int4> &next)
+
+{ // Sweep chunks until there are none left.  Each worker has its own decoding state
+  // and disassembler, and instructions are not allowed to change context.
+  const Translate *trans = glb->translate;
+  trans->attachThread();
+  trans->allowContextSet(false);
+  DisassemblyEngine engine(disengine);
+  for(;;) {
+    int4 i = next.fetch_add(1);
+    if (i >= chunks.size()) break;
+    SweptChunk &chunk( chunks[i] );
+    Address addr = chunk.start;
+    while(addr < chunk.end) {
+      int4 numunits = chunk.units.size();
+      int4 numrefs = chunk.refs.size();
+      try {
+	addr = sweepBlock(engine,addr,chunk);
+      } catch(LowlevelError &err) {	// Leave it for the stitch to report
+	chunk.units.resize(numunits);
+	chunk.refs.erase(chunk.refs.begin() + numrefs,chunk.refs.end());
+	break;
+      }
+      if (addr.isInvalid()) break;
+    }
+  }
+  trans->detachThread();
+}
+
+Address CodeDataAnalysis::commitSweptBlock(const Address &addr,const SweptChunk &chunk,const SweptBlock &block,
+					   vector<pair<AddrLink,uint4> > &pending)
+{ // Commit code units of a block swept in advance, holding back its crossrefs
+  map<Address,CodeUnit>::iterator iter = codeunit.lower_bound(addr);
+  Address curaddr = addr;
+  for(int4 i=0;i<block.numunits;++i) {
+    const CodeUnit &cu( chunk.units[block.firstunit + i] );
+    iter = codeunit.insert(iter,pair<const Address,CodeUnit>(curaddr,cu));
+    (*iter).second = cu;
+    ++iter;
+    curaddr = curaddr + cu.size;
+  }
+  vector<pair<AddrLink,uint4> >::const_iterator refiter = chunk.refs.begin() + block.firstref;
+  pending.insert(pending.end(),refiter,refiter + block.numrefs);
+  return curaddr;
+}
+
+static void sortCrossRefPiece(vector<pair<AddrLink,uint4> > *refs,size_t begin,size_t end)
+
+{
+  sort(refs->begin() + begin,refs->begin() + end);
+}
+
+static void sortCrossRefs(vector<pair<AddrLink,uint4> > &refs,int4 numthreads)
+
+{ // Sort pieces of the list on separate threads, then merge them
+  int4 pieces = refs.size() / 0x4000 + 1;
+  if (pieces > numthreads)
+    pieces = numthreads;
+  vector<size_t> bounds(pieces + 1);
+  for(int4 i=0;i<=pieces;++i)
+    bounds[i] = refs.size() * i / pieces;
+  vector<std::thread> threads;
+  for(int4 i=1;i<pieces;++i)
+    threads.emplace_back(sortCrossRefPiece,&refs,bounds[i],bounds[i+1]);
+  sortCrossRefPiece(&refs,bounds[0],bounds[1]);
+  for(int4 i=0;i<threads.size();++i)
+    threads[i].join();
+  for(int4 width=1;width<pieces;width*=2) {
+    for(int4 i=0;i+width<pieces;i+=2*width) {
+      int4 last = (i + 2*width < pieces) ? i + 2*width : pieces;
+      inplace_merge(refs.begin() + bounds[i],refs.begin() + bounds[i+width],refs.begin() + bounds[last]);
+    }
+  }
+}
+
+static void insertCrossRefs(map<AddrLink,uint4> &crossref,const vector<pair<AddrLink,uint4> > &refs)
+
+{ // Insert sorted crossrefs, each right before the spot where the last one went
+  if (refs.empty()) return;
+  map<AddrLink,uint4>::iterator iter = crossref.lower_bound(refs[0].first);
+  for(int4 i=0;i<refs.size();++i) {
+    iter = crossref.insert(iter,refs[i]);
+    (*iter).second = refs[i].second;
+    ++iter;
+  }
+}
+
+void CodeDataAnalysis::commitCrossRefs(vector<pair<AddrLink,uint4> > &refs,int4 numthreads)
+
+{ // Build both crossref maps from a list of from/to links
+  sortCrossRefs(refs,numthreads);
+  insertCrossRefs(fromto_crossref,refs);
+  for(int4 i=0;i<refs.size();++i) {
+    AddrLink &link( refs[i].first );
+    link = AddrLink(link.b,link.a);
+  }
+  sortCrossRefs(refs,numthreads);
+  insertCrossRefs(tofrom_crossref,refs);
+}
+
+void CodeDataAnalysis::disassembleParallel(const RangeList &rangelist,int4 numthreads)
+
+{ // Every range is cut into chunks, which worker threads sweep speculatively, starting a
+  // block at the beginning of each chunk and then wherever the previous block ended.
+  // The true chain of blocks is then followed through each range on this thread.  At any
+  // address where a chunk's sweep started a block, the block is taken as is, otherwise it
+  // is disassembled here, so the result is the same as disassembling the ranges in order.
+  // Instructions are not allowed to change context on any thread.
+  vector<SweptChunk> chunks;
+  vector<int4> firstchunk;
+  set<Range>::const_iterator iter;
+  for(iter=rangelist.begin();iter!=rangelist.end();++iter) {
+    const Range &range( *iter );
+    firstchunk.push_back(chunks.size());
+    // Ranges are disassembled in order, and nothing gets committed at or beyond the
+    // end of the range being disassembled, so the first code unit in each range is known
+    Address limit = range.getLastAddr();
+    map<Address,CodeUnit>::const_iterator citer = codeunit.lower_bound(range.getFirstAddr());
+    if (citer != codeunit.end() && (*citer).first < limit)
+      limit = (*citer).first;
+    uintb off = range.getFirst();
+    for(;;) {
+      chunks.emplace_back();
+      SweptChunk &chunk( chunks.back() );
+      chunk.start = Address(range.getSpace(),off);
+      chunk.limit = limit;
+      if (range.getLast() - off < sweepsize) {
+	chunk.end = limit;
+	break;
+      }
+      chunk.end = Address(range.getSpace(),off + sweepsize);
+      if (limit < chunk.end)
+	chunk.end = limit;
+      off += sweepsize;
+    }
+  }
+  if (numthreads > chunks.size())
+    numthreads = chunks.size();
+  std::atomic<int4> next(0);
+  vector<std::thread> threads;
+  for(int4 i=1;i<numthreads;++i)
+    threads.emplace_back(&CodeDataAnalysis::sweepWorker,this,std::ref(chunks),std::ref(next));
+  sweepWorker(chunks,next);	// The calling thread acts as worker 0
+  for(int4 i=0;i<threads.size();++i)
+    threads[i].join();
+
+  const Translate *trans = glb->translate;
+  vector<pair<AddrLink,uint4> > pending;
+  trans->attachThread();
+  trans->allowContextSet(false);
+  try {
+    int4 rangeindex = 0;
+    for(iter=rangelist.begin();iter!=rangelist.end();++iter,++rangeindex) {
+      const Range &range( *iter );
+      Address addr = range.getFirstAddr();
+      Address lastaddr = range.getLastAddr();
+      while(addr <= lastaddr) {
+	const SweptChunk &chunk( chunks[firstchunk[rangeindex] + (addr.getOffset() - range.getFirst()) / sweepsize] );
+	const SweptBlock *block = chunk.find(addr.getOffset());
+	if (block != (const SweptBlock *)0)
+	  addr = commitSweptBlock(addr,chunk,*block,pending);
+	else
+	  addr = disassembleBlock(addr,lastaddr);
+      }
+    }
+  } catch(...) {
+    trans->detachThread();
+    throw;
+  }
+  trans->detachThread();
+  commitCrossRefs(pending,numthreads);
+}
+
 void CodeDataAnalysis::findNotCodeUnits(void)
 
 { // Mark any code units that have flow into "notcode" units as "notcode"
@@ -677,7 +920,7 @@ void CodeDataAnalysis::dumpTargetHits(ostream &s) const
   }
 }
 
-void CodeDataAnalysis::runModel(void)
+void CodeDataAnalysis::runModel(int4 numthreads)
 
 {
   LoadImage *loadimage = glb->loader;
@@ -703,7 +946,7 @@ void CodeDataAnalysis::runModel(void)
   CodeUnit &cu( codeunit[lastaddr] );
   cu.size = 100;
   cu.flags = CodeUnit::notcode;
-  disassembleRangeList(modelhits);
+  disassembleRangeList(modelhits,numthreads);
   findNotCodeUnits();
   markFallthruHits();
   markCrossHits();
@@ -755,8 +998,20 @@ void IfcCodeDataTarget::execute(istream &s)
 
 void IfcCodeDataRun::execute(istream &s)
 
-{
-  codedata->runModel();
+{ // Optionally give the number of threads, 0 means one per core
+  int4 numthreads = 1;
+  s >> ws;
+  if (!s.eof()) {
+    s >> dec >> numthreads;
+    if (numthreads < 0)
+      throw IfaceParseError("Bad number of threads");
+  }
+  if (numthreads == 0) {
+    numthreads = std::thread::hardware_concurrency();
+    if (numthreads <= 0)
+      numthreads = 1;
+  }
+  codedata->runModel(numthreads);
 }
 
 void IfcCodeDataDumpModelHits::execute(istream &s)
@@ -328,7 +328,7 @@ bool CommentSorter::findPosition(Subsort &subsort,Comment *comm,const Funcdata *
 /// \param displayUnplaced is \b true if unplaced comments should be displayed in the header
 void CommentSorter::setupFunctionList(uint4 tp,const Funcdata *fd,const CommentDatabase &db,bool displayUnplaced)
 {
-  commmap.clear();
+  commlist.clear();
   displayUnplacedComments = displayUnplaced;
   if (tp == 0) return;
   const Address &fad( fd->getAddress() );
@@ -341,11 +341,28 @@ void CommentSorter::setupFunctionList(uint4 tp,const Funcdata *fd,const CommentD
   while(iter != lastiter) {
     Comment *comm = *iter;
     if (findPosition(subsort, comm, fd)) {
-      commmap[ subsort ] = comm;
+      commlist.push_back(pair<Subsort,Comment *>(subsort,comm));
       subsort.pos += 1;		// Advance the uniqueness counter
     }
     ++iter;
   }
+  sort(commlist.begin(),commlist.end(),compareEntry);	// Keys are unique, so the order is fully determined
+}
+
+/// \param subsort is the given sorting key
+/// \return an iterator to the first comment whose key is not less than the given key
+CommentSorter::CommentList::const_iterator CommentSorter::lowerBound(const Subsort &subsort) const
+
+{
+  return lower_bound(commlist.begin(),commlist.end(),pair<Subsort,Comment *>(subsort,(Comment *)0),compareEntry);
+}
+
+/// \param subsort is the given sorting key
+/// \return an iterator to the first comment whose key is greater than the given key
+CommentSorter::CommentList::const_iterator CommentSorter::upperBound(const Subsort &subsort) const
+
+{
+  return upper_bound(commlist.begin(),commlist.end(),pair<Subsort,Comment *>(subsort,(Comment *)0),compareEntry);
 }
 
 /// This will generally get called with the root p-code op of a statement
@@ -364,7 +381,7 @@ void CommentSorter::setupOpList(const PcodeOp *op)
   subsort.index = op->getParent()->getIndex();
   subsort.order = (uint4)op->getSeqNum().getOrder();
   subsort.pos = 0xffffffff;
-  opstop = commmap.upper_bound(subsort);
+  opstop = upperBound(subsort);
 }
 
 /// Find iterators that bound everything in the basic block
@@ -377,10 +394,10 @@ void CommentSorter::setupBlockList(const FlowBlock *bl)
   subsort.index = bl->getIndex();
   subsort.order = 0;
   subsort.pos = 0;
-  start = commmap.lower_bound(subsort);
+  start = lowerBound(subsort);
   subsort.order = 0xffffffff;
   subsort.pos = 0xffffffff;
-  stop = commmap.upper_bound(subsort);
+  stop = upperBound(subsort);
 }
 
 /// Header comments are grouped together. Set up iterators.
@@ -392,8 +409,8 @@ void CommentSorter::setupHeader(uint4 headerType)
   subsort.index = -1;
   subsort.order = headerType;
   subsort.pos = 0;
-  start = commmap.lower_bound(subsort);
+  start = lowerBound(subsort);
   subsort.pos = 0xffffffff;
-  opstop = commmap.upper_bound(subsort);
+  opstop = upperBound(subsort);
 }
 }
@@ -528,7 +528,7 @@ void ConditionalExecution::predefineDirectMulti(PcodeOp *op)
 void ConditionalExecution::adjustDirectMulti(void)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  PcodeOpList::const_iterator iter;
   PcodeOp *op;
   iter = posta_block->beginOp();
   int4 inslot = iblock->getOutRevIndex(posta_outslot);
@@ -634,7 +634,7 @@ void ConditionalExecution::doReplacement(PcodeOp *op)
   if (directsplit)
     predefineDirectMulti(op);
   Varnode *vn = op->getOut();
-  list<PcodeOp *>::const_iterator iter = vn->beginDescend();
+  DescendList::const_iterator iter = vn->beginDescend();
   while(iter != vn->endDescend()) {
     PcodeOp *readop = *iter;
     int4 slot = readop->getSlot(vn);
@@ -692,7 +692,7 @@ void ConditionalExecution::fixReturnOp(void)
 bool ConditionalExecution::testRemovability(PcodeOp *op)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *readop;
   Varnode *vn;
 
@@ -747,7 +747,7 @@ bool ConditionalExecution::verify(void)
   postb_block = (BlockBasic *)iblock->getOut(1-posta_outslot);
 
   returnop.clear();
-  list<PcodeOp *>::const_iterator iter;
+  PcodeOpList::const_iterator iter;
   iter = iblock->endOp();
   if (iter != iblock->beginOp())
     --iter;			// Skip branch
@@ -772,7 +772,6 @@ bool ConditionalExecution::trial(BlockBasic *ib)
 
 {
   iblock = ib;
-  buildHeritageArray();
   if (!verify()) return false;
 
   PcodeOp *cbranch_copy;
@@ -824,7 +823,7 @@ bool ConditionalExecution::trial(BlockBasic *ib)
 void ConditionalExecution::execute(void)
 
 {
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter;
   PcodeOp *op;
 
   fixReturnOp();		// Patch any data-flow thru to CPUI_RETURN
@@ -864,16 +863,24 @@ int4 ActionConditionalExe::apply(Funcdata &data)
     return 0;
   ConditionalExecution condexe(&data);
   const BlockGraph &bblocks( data.getBasicBlocks() );
+  vector<int4> failhits;	// Value of -numhits- when each block last failed as an iblock
 
   do {
     changethisround = false;
     for(i=0;i<bblocks.getSize();++i) {
+      if ((i < failhits.size())&&(failhits[i] == numhits))
+	continue;		// Nothing has changed since this block failed
       BlockBasic *bb = (BlockBasic *)bblocks.getBlock(i);
       if (condexe.trial(bb)) {
 	condexe.execute();	// Adjust dataflow
 	numhits += 1;
 	changethisround = true;
       }
+      else {
+	if (failhits.size() <= i)
+	  failhits.resize(bblocks.getSize(),-1);
+	failhits[i] = numhits;
+      }
     }
   } while(changethisround);
   count += numhits;		// Number of changes
@@ -17,6 +17,8 @@
 #include <cstdlib>
 
 #include "libdecomp.hh"
+#include "loadimage_xml.hh"
+#include "slab.hh"
 
 class IfcLoadFile : public IfaceDecompCommand {
 public:
@@ -128,11 +130,32 @@ void IfcSave::execute(istream &s)
   if (savefile.size()==0)
     throw IfaceParseError("Missing savefile name");
 
-  fs.open( savefile.c_str() );
+  bool binary = (savefile.size() > SLAB_EXTENSION.size() &&
+		 savefile.compare(savefile.size()-SLAB_EXTENSION.size(),SLAB_EXTENSION.size(),SLAB_EXTENSION)==0);
+  if (binary)
+    fs.open( savefile.c_str(), ios::out | ios::binary );
+  else
+    fs.open( savefile.c_str() );
   if (!fs)
     throw IfaceExecutionError("Unable to open file: "+savefile);
 
-  dcp->conf->saveXml(fs);
+  if (binary) {			// Save the same tree in binary form, with image data as raw bytes
+    XmlBuffer xmlbuf;		// Read the XML back in place, rather than copying it out
+    ostream xmls(&xmlbuf);
+    dcp->conf->saveXml(xmls);
+    xmlbuf.startReading();
+    istream is(&xmlbuf);
+    BinaryImagePacker packer;
+    Document *doc = xml_tree(is,&packer);
+    slab_write(fs,doc->getRoot());
+    delete doc;
+  }
+  else {
+    XmlBuffer xmlbuf;
+    ostream xmls(&xmlbuf);
+    dcp->conf->saveXml(xmls);
+    xmlbuf.flushTo(fs);
+  }
   fs.close();
 }
 
@@ -144,7 +167,13 @@ void IfcRestore::execute(istream &s)
     throw IfaceParseError("Missing file name");
 
   DocumentStorage store;
-  Document *doc = store.openDocument(savefile);
+  Document *doc;
+  if (slab_detect(savefile))	// Binary save file
+    doc = store.addDocument(slab_open(savefile));
+  else {
+    BinaryImagePacker packer;	// Decode any image data as it is read
+    doc = store.openDocument(savefile,&packer);
+  }
   store.registerTag(doc->getRoot());
   dcp->clearArchitecture();	// Clear any old architecture
   ArchitectureCapability *capa = ArchitectureCapability::findCapability(doc);
@@ -192,6 +221,9 @@ int main(int argc,char **argv)
     else
       ghidraroot = sleighhomepath;
   }
+  const char *indexpath = getenv("SLEIGHINDEX");
+  if (indexpath != (const char *)0)
+    SleighArchitecture::setIndexFile(indexpath);	// Reuse the last scan of the SLEIGH directories
   startDecompilerLibrary(ghidraroot.c_str(),extrapaths);
 
   IfaceStatus *status;
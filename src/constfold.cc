@@ -0,0 +1,361 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "constfold.hh"
+#include "address.hh"
+
+#include <type_traits>
+
+namespace GhidraDec {
+
+// Each kernel class defines apply(), evaluating the operation on a first input of type T (which
+// has already been truncated to the input size) and a raw second input.  The result must fit in
+// a uintb but doesn't need to be masked to the output size.
+
+/// \brief Number of bits in the unsigned type \b T
+template<typename T>
+struct FoldBits {
+  static const int4 value = 8*sizeof(T);	///< The number of bits
+};
+
+/// \brief INT_COPY and INT_ZEXT
+struct FoldCopy {
+  static const bool unary = true;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return a; }
+};
+
+/// \brief INT_SEXT
+struct FoldSext {
+  static const bool unary = true;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    return (uintb)(intb)(typename std::make_signed<T>::type)a; }
+};
+
+/// \brief INT_EQUAL
+struct FoldEqual {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (a == (T)b) ? 1 : 0; }
+};
+
+/// \brief INT_NOTEQUAL
+struct FoldNotEqual {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (a != (T)b) ? 1 : 0; }
+};
+
+/// \brief INT_SLESS
+struct FoldSless {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    typedef typename std::make_signed<T>::type S;
+    return ((S)a < (S)(T)b) ? 1 : 0; }
+};
+
+/// \brief INT_SLESSEQUAL
+struct FoldSlessEqual {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    typedef typename std::make_signed<T>::type S;
+    return ((S)a <= (S)(T)b) ? 1 : 0; }
+};
+
+/// \brief INT_LESS
+struct FoldLess {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (a < (T)b) ? 1 : 0; }
+};
+
+/// \brief INT_LESSEQUAL
+struct FoldLessEqual {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (a <= (T)b) ? 1 : 0; }
+};
+
+/// \brief INT_ADD
+struct FoldAdd {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)((uintb)a + b); }
+};
+
+/// \brief INT_SUB
+struct FoldSub {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)((uintb)a - b); }
+};
+
+/// \brief INT_CARRY
+struct FoldCarry {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return ((T)((uintb)a + b) < a) ? 1 : 0; }
+};
+
+/// \brief INT_SCARRY
+struct FoldScarry {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    T bb = (T)b;
+    T r = (T)((uintb)a + bb);
+    return (T)((r ^ a) & ~(a ^ bb)) >> (FoldBits<T>::value - 1); }
+};
+
+/// \brief INT_SBORROW
+struct FoldSborrow {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    T bb = (T)b;
+    T r = (T)((uintb)a - bb);
+    return (T)((a ^ r) & (a ^ bb)) >> (FoldBits<T>::value - 1); }
+};
+
+/// \brief INT_2COMP
+struct Fold2Comp {
+  static const bool unary = true;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)((uintb)0 - a); }
+};
+
+/// \brief INT_NEGATE
+struct FoldNegate {
+  static const bool unary = true;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)~a; }
+};
+
+/// \brief INT_XOR and BOOL_XOR
+struct FoldXor {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)(a ^ (T)b); }
+};
+
+/// \brief INT_AND and BOOL_AND
+struct FoldAnd {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)(a & (T)b); }
+};
+
+/// \brief INT_OR and BOOL_OR
+struct FoldOr {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)(a | (T)b); }
+};
+
+/// \brief INT_LEFT
+struct FoldLeft {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    return (b >= (uintb)FoldBits<T>::value) ? 0 : (T)((uintb)a << b); }
+};
+
+/// \brief INT_RIGHT
+struct FoldRight {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    return (b >= (uintb)FoldBits<T>::value) ? 0 : (T)(a >> b); }
+};
+
+/// \brief INT_SRIGHT
+struct FoldSright {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    typedef typename std::make_signed<T>::type S;
+    if (b >= (uintb)FoldBits<T>::value)
+      b = FoldBits<T>::value - 1;	// Every bit becomes a copy of the sign bit
+    return (T)((S)a >> b); }
+};
+
+/// \brief INT_MULT
+struct FoldMult {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)((uintb)a * (uintb)(T)b); }
+};
+
+/// \brief INT_DIV
+struct FoldDiv {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    T d = (T)b;
+    if (d == 0)
+      throw EvaluationError("Divide by 0");
+    return (T)(a / d); }
+};
+
+/// \brief INT_SDIV
+struct FoldSdiv {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    typedef typename std::make_signed<T>::type S;
+    S d = (S)(T)b;
+    if (d == 0)
+      throw EvaluationError("Divide by 0");
+    if (d == -1)			// Avoid overflowing on the most negative value
+      return (T)((uintb)0 - a);
+    return (T)((S)a / d); }
+};
+
+/// \brief INT_REM
+struct FoldRem {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    T d = (T)b;
+    if (d == 0)
+      throw EvaluationError("Remainder by 0");
+    return (T)(a % d); }
+};
+
+/// \brief INT_SREM
+struct FoldSrem {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    typedef typename std::make_signed<T>::type S;
+    S d = (S)(T)b;
+    if (d == 0)
+      throw EvaluationError("Remainder by 0");
+    if (d == -1)
+      return 0;
+    return (T)((S)a % d); }
+};
+
+/// \brief BOOL_NEGATE
+struct FoldBoolNegate {
+  static const bool unary = true;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) { return (T)(a ^ 1); }
+};
+
+/// \brief PIECE, where \b T is the type of the most significant piece
+struct FoldPiece {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    int4 sa = (sizeout - (int4)sizeof(T)) * 8;
+    return (sa >= 8*(int4)sizeof(uintb)) ? b : (((uintb)a << sa) | b); }
+};
+
+/// \brief SUBPIECE
+struct FoldSubpiece {
+  static const bool unary = false;
+  template<typename T> static uintb apply(int4 sizeout,T a,uintb b) {
+    return (b >= sizeof(T)) ? 0 : ((uintb)a >> (b*8)); }
+};
+
+/// \brief Fold a single operation with the given kernel and input type
+template<typename K,typename T>
+static uintb foldSingle(int4 sizeout,uintb in1,uintb in2)
+
+{
+  return K::template apply<T>(sizeout,(T)in1,in2) & calc_mask(sizeout);
+}
+
+/// \brief Fold an operation across arrays of inputs with the given kernel and input type
+template<typename K,typename T>
+static void foldBatch(int4 sizeout,const uintb *in1,const uintb *in2,uintb *out,int4 count)
+
+{
+  uintb mask = calc_mask(sizeout);
+  if (K::unary) {
+    for(int4 i=0;i<count;++i)
+      out[i] = K::template apply<T>(sizeout,(T)in1[i],0) & mask;
+  }
+  else {
+    for(int4 i=0;i<count;++i)
+      out[i] = K::template apply<T>(sizeout,(T)in1[i],in2[i]) & mask;
+  }
+}
+
+/// \param opc is the opcode whose entries are filled in with the kernel \b K
+template<typename K>
+void ConstantFold::registerKernel(OpCode opc)
+
+{
+  Entry *row = table[opc];
+  row[0].single = foldSingle<K,uint1>;
+  row[0].batch = foldBatch<K,uint1>;
+  row[1].single = foldSingle<K,uint2>;
+  row[1].batch = foldBatch<K,uint2>;
+  row[2].single = foldSingle<K,uint4>;
+  row[2].batch = foldBatch<K,uint4>;
+  row[3].single = foldSingle<K,uintb>;
+  row[3].batch = foldBatch<K,uintb>;
+}
+
+ConstantFold::ConstantFold(void)
+
+{
+  for(int4 i=0;i<CPUI_MAX;++i) {
+    for(int4 j=0;j<4;++j) {
+      table[i][j].single = (Kernel)0;
+      table[i][j].batch = (BatchKernel)0;
+    }
+  }
+  registerKernel<FoldCopy>(CPUI_COPY);
+  registerKernel<FoldEqual>(CPUI_INT_EQUAL);
+  registerKernel<FoldNotEqual>(CPUI_INT_NOTEQUAL);
+  registerKernel<FoldSless>(CPUI_INT_SLESS);
+  registerKernel<FoldSlessEqual>(CPUI_INT_SLESSEQUAL);
+  registerKernel<FoldLess>(CPUI_INT_LESS);
+  registerKernel<FoldLessEqual>(CPUI_INT_LESSEQUAL);
+  registerKernel<FoldCopy>(CPUI_INT_ZEXT);
+  registerKernel<FoldSext>(CPUI_INT_SEXT);
+  registerKernel<FoldAdd>(CPUI_INT_ADD);
+  registerKernel<FoldSub>(CPUI_INT_SUB);
+  registerKernel<FoldCarry>(CPUI_INT_CARRY);
+  registerKernel<FoldScarry>(CPUI_INT_SCARRY);
+  registerKernel<FoldSborrow>(CPUI_INT_SBORROW);
+  registerKernel<Fold2Comp>(CPUI_INT_2COMP);
+  registerKernel<FoldNegate>(CPUI_INT_NEGATE);
+  registerKernel<FoldXor>(CPUI_INT_XOR);
+  registerKernel<FoldAnd>(CPUI_INT_AND);
+  registerKernel<FoldOr>(CPUI_INT_OR);
+  registerKernel<FoldLeft>(CPUI_INT_LEFT);
+  registerKernel<FoldRight>(CPUI_INT_RIGHT);
+  registerKernel<FoldSright>(CPUI_INT_SRIGHT);
+  registerKernel<FoldMult>(CPUI_INT_MULT);
+  registerKernel<FoldDiv>(CPUI_INT_DIV);
+  registerKernel<FoldSdiv>(CPUI_INT_SDIV);
+  registerKernel<FoldRem>(CPUI_INT_REM);
+  registerKernel<FoldSrem>(CPUI_INT_SREM);
+  registerKernel<FoldBoolNegate>(CPUI_BOOL_NEGATE);
+  registerKernel<FoldXor>(CPUI_BOOL_XOR);
+  registerKernel<FoldAnd>(CPUI_BOOL_AND);
+  registerKernel<FoldOr>(CPUI_BOOL_OR);
+  registerKernel<FoldPiece>(CPUI_PIECE);
+  registerKernel<FoldSubpiece>(CPUI_SUBPIECE);
+}
+
+/// The table is built the first time it is needed.
+/// \return the table of kernels
+const ConstantFold &ConstantFold::get(void)
+
+{
+  static const ConstantFold fold;
+  return fold;
+}
+
+/// Division and remainder by zero throw an EvaluationError part way through, leaving the
+/// remaining outputs unset.
+/// \param opc is the opcode
+/// \param sizeout is the size of each output in bytes
+/// \param sizein is the size of each (first) input in bytes
+/// \param in1 is the array of first inputs
+/// \param in2 is the array of second inputs (may be null for unary operations)
+/// \param out is the array that receives the outputs
+/// \param count is the number of elements in each array
+/// \return \b true if the operation was folded, \b false if the OpBehavior must be used instead
+bool ConstantFold::evaluateBatch(OpCode opc,int4 sizeout,int4 sizein,const uintb *in1,const uintb *in2,
+				 uintb *out,int4 count)
+{
+  BatchKernel kernel = getBatchKernel(opc,sizein);
+  if (kernel == (BatchKernel)0) return false;
+  (*kernel)(sizeout,in1,in2,out,count);
+  return true;
+}
+
+} // namespace GhidraDec
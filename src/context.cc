@@ -21,15 +21,18 @@ ParserContext::ParserContext(ContextCache *ccache)
 
 {
   parsestate = 0;
+  flowflags = -1;
   contcache = ccache;
   if (ccache != (ContextCache *)0) {
     contextsize = ccache->getDatabase()->getContextSize();
-    context = new uintm[ contextsize ];
+    localcontext = new uintm[ contextsize ];
   }
   else {
     contextsize = 0;
-    context = (uintm *)0;
+    localcontext = (uintm *)0;
   }
+  context = localcontext;
+  generation = 0;
 }
 
 void ParserContext::initialize(int4 maxstate,int4 maxparam,AddrSpace *spc)
@@ -116,6 +119,30 @@ uintm ParserContext::getContextBits(int4 startbit,int4 size) const
   return res;
 }
 
+void ParserContext::loadContext(void)
+
+{				// Point at the shared context blob for the current address
+  context = contcache->getContext(addr);
+  generation = contcache->getDatabase()->getGeneration();
+}
+
+void ParserContext::copyContext(void)
+
+{				// Switch from the shared context to a local copy that can be written,
+				// or that must outlive changes made to the database
+  if (context == localcontext) return;
+  for(int4 i=0;i<contextsize;++i)
+    localcontext[i] = context[i];
+  context = localcontext;
+}
+
+bool ParserContext::isContextStale(void) const
+
+{				// Has the context database changed since the shared blob was loaded
+  if (context == localcontext) return false;
+  return (generation != contcache->getDatabase()->getGeneration());
+}
+
 void ParserContext::addCommit(TripleSymbol *sym,int4 num,uintm mask,bool flow,ConstructState *point)
 
 {
@@ -134,6 +161,7 @@ void ParserContext::applyCommits(void)
 
 {
   if (contextcommit.empty()) return;
+  copyContext();		// Keep the context this instruction was decoded with
   ParserWalker walker(this);
   walker.baseState();
 
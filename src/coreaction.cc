@@ -251,7 +251,8 @@ void StackSolver::build(const Funcdata &data,AddrSpace *id,int4 spcbase)
 /// \brief Calculate stack-pointer change across \e undetermined sub-functions
 ///
 /// If there are sub-functions for which \e extra \e pop is not explicit,
-/// do full linear analysis to (attempt to) recover the values.
+/// do full linear analysis to (attempt to) recover the values.  Each value recovered for a
+/// direct call is recorded in the Architecture's ExtraPopMemo, for other calls to the same sub-function.
 /// \param data is the function to analyze
 /// \param stackspace is the space associated with the stack-pointer
 /// \param spcbase is the index (relative to the stackspace) of the stack-pointer
@@ -301,6 +302,8 @@ void ActionStackPtrFlow::analyzeExtraPop(Funcdata &data,AddrSpace *stackspace,in
 	  if (comp >= 0)
 	    soln2 = solver.getSolution(comp);
 	  fc->setEffectiveExtraPop(soln-soln2);
+	  if (!fc->getEntryAddress().isInvalid())
+	    data.getArch()->extrapopmemo.record(fc->getEntryAddress(),soln-soln2);
 	}
       }
     }
@@ -377,8 +380,8 @@ int4 ActionStackPtrFlow::repair(Funcdata &data,AddrSpace *id,Varnode *spcbasein,
 {
   int4 loadsize = loadop->getOut()->getSize();
   BlockBasic *curblock = loadop->getParent();
-  list<PcodeOp *>::iterator begiter = curblock->beginOp();
-  list<PcodeOp *>::iterator iter = loadop->getBasicIter();
+  PcodeOpList::iterator begiter = curblock->beginOp();
+  PcodeOpList::iterator iter = loadop->getBasicIter();
   for(;;) {
     if (iter == begiter) {
       if (curblock->sizeIn() != 1) return 0; // Can trace back to next basic block if only one path
@@ -616,7 +619,7 @@ bool ActionMultiCse::preferredOutput(Varnode *out1,Varnode *out2)
 
 {
   // Prefer the output that is used in a CPUI_RETURN
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   enditer = out1->endDescend();
   for(iter=out1->beginDescend();iter!=enditer;++iter) {
     PcodeOp *op = *iter;
@@ -643,45 +646,77 @@ bool ActionMultiCse::preferredOutput(Varnode *out1,Varnode *out2)
   return false;
 }
 
-/// Find any matching CPUI_MULTIEQUAL that occurs before \b target that has \b in as an input.
-/// Then test to see if the \b target and the recovered op are functionally equivalent.
-/// \param bl is the parent block
-/// \param target is the given target CPUI_MULTIEQUAL
-/// \param in is the specific input Varnode
-PcodeOp *ActionMultiCse::findMatch(BlockBasic *bl,PcodeOp *target,Varnode *in)
+/// Calculate a hash of the inputs of a CPUI_MULTIEQUAL, such that two ops whose inputs are
+/// pairwise functionally equal (see functionalEqualityHash()) have the same hash.
+/// Inputs written by a COPY are replaced with the input to the COPY first.
+/// \param op is the CPUI_MULTIEQUAL
+/// \return the hash
+uintm ActionMultiCse::hashInputs(PcodeOp *op)
 
 {
-  list<PcodeOp *>::iterator iter = bl->beginOp();
+  int4 numinput = op->numInput();
+  uintm hash = (uintm)numinput;
+  for(int4 i=0;i<numinput;++i) {
+    Varnode *vn = op->getIn(i);
+    if (vn->isWritten() && (vn->getDef()->code() == CPUI_COPY))
+      vn = vn->getDef()->getIn(0);		// Allow for differences in copy propagation
+    hash = (hash<<8) | (hash>>(sizeof(uintm)*8-8));
+    hash ^= functionalEqualityHash(vn);
+  }
+  return hash;
+}
 
-  for(;;) {
-    PcodeOp *op = *iter;
-    ++iter;
-    if (op == target)		// Caught up with target, nothing else before it
-      break;
-    int4 i,numinput;
-    numinput = op->numInput();
-    for(i=0;i<numinput;++i) {
-      Varnode *vn = op->getIn(i);
-      if (vn->isWritten() && (vn->getDef()->code() == CPUI_COPY))
-	vn = vn->getDef()->getIn(0);		// Allow for differences in copy propagation
-      if (vn == in) break;
-    }
-    if (i < numinput) {
+/// Test if the two CPUI_MULTIEQUAL ops are functionally equivalent, input by input.
+/// \param op is one CPUI_MULTIEQUAL
+/// \param target is the other CPUI_MULTIEQUAL
+/// \return \b true if the ops produce the same value
+bool ActionMultiCse::isMatch(PcodeOp *op,PcodeOp *target)
+
+{
+  int4 numinput = op->numInput();
+  if (numinput != target->numInput()) return false;
+  Varnode *buf1[2];
+  Varnode *buf2[2];
+  for(int4 j=0;j<numinput;++j) {
+    Varnode *in1 = op->getIn(j);
+    if (in1->isWritten() && (in1->getDef()->code() == CPUI_COPY))
+      in1 = in1->getDef()->getIn(0);	// Allow for differences in copy propagation
+    Varnode *in2 = target->getIn(j);
+    if (in2->isWritten() && (in2->getDef()->code() == CPUI_COPY))
+      in2 = in2->getDef()->getIn(0);
+    if (in1 == in2) continue;
+    if (0!=functionalEqualityLevel(in1,in2,buf1,buf2))
+      return false;
+  }
+  return true;
+}
+
+/// The candidates are earlier CPUI_MULTIEQUAL ops in the same block whose inputs hash the same
+/// as the target's.  The candidate must also share an input Varnode with the \b target: the
+/// inputs of \b target are tried in order, and for each, the earliest candidate that reads it and
+/// is functionally equivalent to \b target is returned.
+/// \param candidates are the earlier CPUI_MULTIEQUAL ops, in block order
+/// \param target is the given target CPUI_MULTIEQUAL
+/// \return the matching CPUI_MULTIEQUAL or null
+PcodeOp *ActionMultiCse::findMatch(const vector<PcodeOp *> &candidates,PcodeOp *target)
+
+{
+  int4 numinput = target->numInput();
+  for(int4 i=0;i<numinput;++i) {
+    Varnode *in = target->getIn(i);
+    if (in->isWritten() && (in->getDef()->code() == CPUI_COPY))
+      in = in->getDef()->getIn(0);
+    for(int4 k=0;k<candidates.size();++k) {
+      PcodeOp *op = candidates[k];
       int4 j;
-      Varnode *buf1[2];
-      Varnode *buf2[2];
-      for(j=0;j<numinput;++j) {
-	Varnode *in1 = op->getIn(j);
-	if (in1->isWritten() && (in1->getDef()->code() == CPUI_COPY))
-	  in1 = in1->getDef()->getIn(0);	// Allow for differences in copy propagation
-	Varnode *in2 = target->getIn(j);
-	if (in2->isWritten() && (in2->getDef()->code() == CPUI_COPY))
-	  in2 = in2->getDef()->getIn(0);
-	if (in1 == in2) continue;
-	if (0!=functionalEqualityLevel(in1,in2,buf1,buf2))
-	  break;
+      for(j=0;j<op->numInput();++j) {
+	Varnode *vn = op->getIn(j);
+	if (vn->isWritten() && (vn->getDef()->code() == CPUI_COPY))
+	  vn = vn->getDef()->getIn(0);
+	if (vn == in) break;
       }
-      if (j==numinput)		// We have found a redundancy
+      if (j == op->numInput()) continue;
+      if (isMatch(op,target))	// We have found a redundancy
 	return op;
     }
   }
@@ -690,49 +725,34 @@ PcodeOp *ActionMultiCse::findMatch(BlockBasic *bl,PcodeOp *target,Varnode *in)
 
 /// Search for pairs of CPUI_MULTIEQUAL ops in \b bl that share an input.
 /// If the pairs found are functionally equivalent, delete one of the two.
+/// Ops are grouped by a hash of their inputs, so each op is only compared against the
+/// earlier ops that could possibly match it.
 /// \param data is the function owning the block
 /// \param bl is the specific basic block
 /// return \b true if a CPUI_MULTIEQUAL was (successfully) deleted
 bool ActionMultiCse::processBlock(Funcdata &data,BlockBasic *bl)
 
 {
-  vector<Varnode *> vnlist;
+  map<uintm,vector<PcodeOp *> > table;	// CPUI_MULTIEQUALs seen so far, grouped by hash of their inputs
   PcodeOp *targetop = (PcodeOp *)0;
-  PcodeOp *pairop;
-  list<PcodeOp *>::iterator iter = bl->beginOp();
-  list<PcodeOp *>::iterator enditer = bl->endOp();
+  PcodeOp *pairop = (PcodeOp *)0;
+  PcodeOpList::iterator iter = bl->beginOp();
+  PcodeOpList::iterator enditer = bl->endOp();
   while(iter != enditer) {
     PcodeOp *op = *iter;
     ++iter;
     OpCode opc = op->code();
     if (opc == CPUI_COPY) continue;
     if (opc != CPUI_MULTIEQUAL) break;
-    int4 vnpos = vnlist.size();
-    int4 i;
-    int4 numinput = op->numInput();
-    for(i=0;i<numinput;++i) {
-      Varnode *vn = op->getIn(i);
-      if (vn->isWritten() && (vn->getDef()->code() == CPUI_COPY))	// Some copies may not propagate into MULTIEQUAL
-	vn = vn->getDef()->getIn(0);					// Allow for differences in copy propagation
-      vnlist.push_back(vn);
-      if (vn->isMark()) {		// If we've seen this varnode before
-	pairop = findMatch(bl,op,vn);
-	if (pairop != (PcodeOp *)0)
-	  break;
-      }
-    }
-    if (i<numinput) {
+    vector<PcodeOp *> &candidates( table[hashInputs(op)] );
+    pairop = findMatch(candidates,op);
+    if (pairop != (PcodeOp *)0) {
       targetop = op;
       break;
     }
-    for(i=vnpos;i<vnlist.size();++i)
-      vnlist[i]->setMark();		// Mark that we have seen this varnode
+    candidates.push_back(op);
   }
 
-  // Clear out any of the marks we put down
-  for(int4 i=0;i<vnlist.size();++i)
-    vnlist[i]->clearMark();
-
   if (targetop != (PcodeOp *)0) {
     Varnode *out1 = pairop->getOut();
     Varnode *out2 = targetop->getOut();
@@ -781,7 +801,7 @@ int4 ActionShadowVar::apply(Funcdata &data)
     // We cannot stop at first non-MULTIEQUAL because
     // other ops creep in because of multi_collapse
     startoffset = bl->getStart().getOffset();
-    list<PcodeOp *>::iterator iter = bl->beginOp();
+    PcodeOpList::iterator iter = bl->beginOp();
     while(iter != bl->endOp()) {
       op = *iter++;
       if (op->getAddr().getOffset() != startoffset) break;
@@ -886,6 +906,7 @@ SymbolEntry *ActionConstantPtr::isPointer(AddrSpace *spc,Varnode *vn,PcodeOp *op
   }
 
   if (rampoint.isInvalid()) return (SymbolEntry *)0;
+  if (!glb->symboltab->isPossiblyMapped(rampoint)) return (SymbolEntry *)0;	// Quick reject before searching scopes
     // Since we are looking for a global address
     // Assume it is address tied and use empty usepoint
   SymbolEntry *entry = data.getScopeLocal()->getParent()->queryContainer(rampoint,1,Address());
@@ -1072,7 +1093,7 @@ int4 ActionDirectWrite::apply(Funcdata &data)
 
 {
   VarnodeLocSet::const_iterator iter;
-  list<PcodeOp *>::const_iterator oiter;
+  DescendList::const_iterator oiter;
   Varnode *vn,*dvn;
   PcodeOp *op;
   vector<Varnode *> worklist;
@@ -1166,14 +1187,17 @@ int4 ActionExtraPopSetup::apply(Funcdata &data)
   
   for(int4 i=0;i<data.numCalls();++i) {
     fc = data.getCallSpecs(i);
-    if (fc->getExtraPop() == 0) continue; // Stack pointer is undisturbed
+    int4 extrapop = fc->getExtraPop();
+    if (extrapop == ProtoModel::extrapop_unknown && !fc->getEntryAddress().isInvalid())
+      data.getArch()->extrapopmemo.find(fc->getEntryAddress(),extrapop);	// Solved at an earlier call site
+    if (extrapop == 0) continue; // Stack pointer is undisturbed
     op = data.newOp(2,fc->getOp()->getAddr());
     data.newVarnodeOut(sb_size,sb_addr,op);
     data.opSetInput(op,data.newVarnode(sb_size,sb_addr),0);
-    if (fc->getExtraPop() != ProtoModel::extrapop_unknown) { // We know exactly how stack pointer is changed
-      fc->setEffectiveExtraPop(fc->getExtraPop());
+    if (extrapop != ProtoModel::extrapop_unknown) { // We know exactly how stack pointer is changed
+      fc->setEffectiveExtraPop(extrapop);
       data.opSetOpcode(op,CPUI_INT_ADD);
-      data.opSetInput(op,data.newConstant(sb_size,fc->getExtraPop()),1);
+      data.opSetInput(op,data.newConstant(sb_size,extrapop),1);
       data.opInsertAfter(op,fc->getOp());
     }
     else {			// We don't know exactly, so we create INDIRECT
@@ -1386,7 +1410,7 @@ int4 ActionParamDouble::apply(Funcdata &data)
       lovec.clear();
       hivec.clear();
       bool otherUse = false;		// Have we seen use other than splitting into hi and lo
-      list<PcodeOp *>::const_iterator iter,enditer;
+      DescendList::const_iterator iter,enditer;
       iter = vn->beginDescend();
       enditer = vn->endDescend();
       while(iter != enditer) {
@@ -1430,8 +1454,7 @@ int4 ActionActiveParam::apply(Funcdata &data)
 {
   int4 i;
   FuncCallSpecs *fc;
-  AliasChecker aliascheck;
-  aliascheck.gather(&data,data.getArch()->getStackSpace(),true);
+  const AliasChecker &aliascheck( data.getAliasChecker(data.getArch()->getStackSpace()) );
 
   for(i=0;i<data.numCalls();++i) {
     fc = data.getCallSpecs(i);
@@ -1659,7 +1682,7 @@ int4 ActionRestrictLocal::apply(Funcdata &data)
 
 {
   FuncCallSpecs *fc;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *op;
   Varnode *vn;
   int4 i;
@@ -1744,7 +1767,7 @@ bool ActionLikelyTrash::traceTrash(Varnode *vn,vector<PcodeOp *> &indlist)
 {
   vector<PcodeOp *> allroutes;	// Keep track of merging ops (with more than 1 input)
   vector<Varnode *> markedlist;	// All varnodes we have visited on paths from -vn-
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   Varnode *outvn;
   uintb val;
   uint4 traced = 0;
@@ -1908,6 +1931,7 @@ int4 ActionDefaultParams::apply(Funcdata &data)
   if (evalfp == (ProtoModel *)0) // If no special evaluation
     evalfp = data.getArch()->defaultfp;	// Use the default model
 
+  map<Funcdata *,FuncCallSpecs *> firstcall;	// First call site, with a copied prototype, for each sub-function
   size = data.numCalls();
   for(i=0;i<size;++i) {
     fc = data.getCallSpecs(i);
@@ -1915,9 +1939,16 @@ int4 ActionDefaultParams::apply(Funcdata &data)
       Funcdata *otherfunc = fc->getFuncdata();
       
       if (otherfunc != (Funcdata *)0) {
-	fc->copy(otherfunc->getFuncProto());
-	if ((!fc->isModelLocked())&&(!fc->hasMatchingModel(evalfp)))
-	  fc->setModel(evalfp);
+	map<Funcdata *,FuncCallSpecs *>::iterator iter = firstcall.find(otherfunc);
+	if (iter != firstcall.end()) {
+	  fc->copyShared(*(*iter).second);	// Same result as copying again, parameters stay shared until changed
+	}
+	else {
+	  fc->copy(otherfunc->getFuncProto());
+	  if ((!fc->isModelLocked())&&(!fc->hasMatchingModel(evalfp)))
+	    fc->setModel(evalfp);
+	  firstcall[otherfunc] = fc;
+	}
       }
       else
 	fc->setInternal(evalfp,data.getArch()->types->getTypeVoid());
@@ -2033,11 +2064,12 @@ int4 ActionSetCasts::castInput(PcodeOp *op,int4 slot,Funcdata &data,CastStrategy
 int4 ActionSetCasts::apply(Funcdata &data)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  PcodeOpList::const_iterator iter;
   PcodeOp *op;
 
   data.startCastPhase();
-  CastStrategy *castStrategy = data.getArch()->print->getCastStrategy();
+  memo.setStrategy(data.getArch()->print->getCastStrategy(),data.getArch()->types);
+  CastStrategy *castStrategy = &memo;
   // We follow data flow, doing basic blocks in dominance order
   // Doing operations in basic block order
   const BlockGraph &basicblocks( data.getBasicBlocks() );
@@ -2289,7 +2321,7 @@ int4 ActionNameVars::apply(Funcdata &data)
 int4 ActionMarkExplicit::baseExplicit(Varnode *vn,int4 maxref)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
 
   PcodeOp *def = vn->getDef();
   if (def == (PcodeOp *)0) return -1;
@@ -2472,7 +2504,7 @@ void ActionMarkExplicit::checkNewToConstructor(Funcdata &data,Varnode *vn)
 {  PcodeOp *op = vn->getDef();
   BlockBasic *bb = op->getParent();
   PcodeOp *firstuse = (PcodeOp *)0;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter) {
     PcodeOp *curop = *iter;
     if (curop->getParent() != bb) continue;
@@ -2771,6 +2803,7 @@ int4 ActionRedundBranch::apply(Funcdata &data)
   BlockBasic *bb;
   FlowBlock *bl;
 
+  data.beginBlockBatch();	// Recalculate structure once, after all the changes
   for(i=0;i<graph.getSize();++i) {
     bb = (BlockBasic *) graph.getBlock(i);
     if (bb->sizeOut() == 0) continue;
@@ -2797,6 +2830,7 @@ int4 ActionRedundBranch::apply(Funcdata &data)
     data.removeBranch(bb,1);	// Remove the branch instruction
     count += 1;
   }
+  data.endBlockBatch();
   return 0;			// Indicate full rule was applied
 }
 
@@ -2808,6 +2842,7 @@ int4 ActionDeterminedBranch::apply(Funcdata &data)
   BlockBasic *bb;
   PcodeOp *cbranch;
 
+  data.beginBlockBatch();	// Recalculate structure once, after all the changes
   for(i=0;i<graph.getSize();++i) {
     bb = (BlockBasic *) graph.getBlock(i);
     cbranch = bb->lastOp();
@@ -2819,6 +2854,7 @@ int4 ActionDeterminedBranch::apply(Funcdata &data)
     data.removeBranch(bb,num);
     count += 1;
   }
+  data.endBlockBatch();
   return 0;
 }
 
@@ -3036,7 +3072,7 @@ bool ActionDeadCode::neverConsumed(Varnode *vn,Funcdata &data)
 
 {
   if (vn->getSize() > sizeof(uintb)) return false; // Not enough precision to really tell
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *op;
   iter = vn->beginDescend();
   while(iter != vn->endDescend()) {
@@ -3065,11 +3101,23 @@ int4 ActionDeadCode::apply(Funcdata &data)
   PcodeOp *op;
   Varnode *vn;
   vector<Varnode *> worklist;
-  VarnodeLocSet::const_iterator viter,endviter;
+  vector<Varnode *> removelist;	// Written Varnodes in spaces where dead code can be removed
+  VarnodeLocSet::const_iterator viter;
   const AddrSpaceManager *manage = data.getArch();
   AddrSpace *spc;
 
-				// Clear consume flags
+				// Classify each address space once
+  vector<uint1> spacestate(manage->numSpaces(),space_ignore);
+  for(i=0;i<manage->numSpaces();++i) {
+    spc = manage->getSpace(i);
+    if (!spc->doesDeadcode()) continue;
+    if (data.deadRemovalAllowed(spc))
+      spacestate[i] = space_remove;
+    else
+      spacestate[i] = space_prelive;	// Mark consumed if we have NOT heritaged
+  }
+
+				// Clear consume flags, set pre-live registers, and collect removal candidates
   for(viter=data.beginLoc();viter!=data.endLoc();++viter) {
     vn = *viter;
     vn->clearConsumeList();
@@ -3077,18 +3125,16 @@ int4 ActionDeadCode::apply(Funcdata &data)
     vn->setConsume(0);
     if (vn->isAddrForce()&&(!vn->isDirectWrite()))
       vn->clearAddrForce();
-  }
-
-				// Set pre-live registers
-  for(i=0;i<manage->numSpaces();++i) {
-    spc = manage->getSpace(i);
-    if (!spc->doesDeadcode()) continue;
-    if (data.deadRemovalAllowed(spc)) continue; // Mark consumed if we have NOT heritaged
-    viter = data.beginLoc(spc);
-    endviter = data.endLoc(spc);
-    while(viter != endviter) {
-      vn = *viter++;
+    switch(spacestate[vn->getSpace()->getIndex()]) {
+    case space_prelive:
       pushConsumed(~((uintb)0),vn,worklist);
+      break;
+    case space_remove:
+      if (vn->isWritten())
+	removelist.push_back(vn);
+      break;
+    default:
+      break;
     }
   }
 
@@ -3124,39 +3170,39 @@ int4 ActionDeadCode::apply(Funcdata &data)
 //     } 
 //   }
 
-  for(i=0;i<manage->numSpaces();++i) {
-    spc = manage->getSpace(i);
-    if (!spc->doesDeadcode()) continue;
-    if (!data.deadRemovalAllowed(spc)) continue; // Don't eliminate if we haven't heritaged
-    viter = data.beginLoc(spc);
-    endviter = data.endLoc(spc);
-    int4 changecount = 0;
-    while(viter != endviter) {
-      vn = *viter++;		// Advance iterator BEFORE (possibly) deleting varnode
-      if (!vn->isWritten()) continue;
-      bool vacflag = vn->isConsumeVacuous();
-      vn->clearConsumeList();
-      vn->clearConsumeVacuous();
-      if (!vacflag) {		// Not even vacuously consumed
-	op = vn->getDef();
-	changecount += 1;
-	if (op->isCall())
-	  data.opUnsetOutput(op); // For calls just get rid of output
-	else
-	  data.opDestroy(op);	// Otherwise completely remove the op
-      }
-      else {
-	// Check for values that are never used, but bang around
-	// for a while
-	if (vn->getConsume()==0) {
-	  if (neverConsumed(vn,data))
-	    changecount += 1;
-	}
+  spc = (AddrSpace *)0;
+  int4 changecount = 0;
+  for(i=0;i<removelist.size();++i) {
+    vn = removelist[i];		// Varnodes later in the list are not deleted by removing earlier ones
+    if (vn->getSpace() != spc) {	// The list is sorted by space
+      if (changecount != 0)
+	data.seenDeadcode(spc);	// Record that we have seen dead code for this space
+      spc = vn->getSpace();
+      changecount = 0;
+    }
+    if (!vn->isWritten()) continue;
+    bool vacflag = vn->isConsumeVacuous();
+    vn->clearConsumeList();
+    vn->clearConsumeVacuous();
+    if (!vacflag) {		// Not even vacuously consumed
+      op = vn->getDef();
+      changecount += 1;
+      if (op->isCall())
+	data.opUnsetOutput(op); // For calls just get rid of output
+      else
+	data.opDestroy(op);	// Otherwise completely remove the op
+    }
+    else {
+      // Check for values that are never used, but bang around
+      // for a while
+      if (vn->getConsume()==0) {
+	if (neverConsumed(vn,data))
+	  changecount += 1;
       }
     }
-    if (changecount != 0)
-      data.seenDeadcode(spc);	// Record that we have seen dead code for this space
   }
+  if (changecount != 0)
+    data.seenDeadcode(spc);
 #ifdef OPACTION_DEBUG
   data.debugModPrint(getName()); // Print dead ops before freeing them
 #endif
@@ -3176,7 +3222,7 @@ int4 ActionDeadCode::apply(Funcdata &data)
 void ActionConditionalConst::propagateConstant(Varnode *varVn,Varnode *constVn,FlowBlock *constBlock,Funcdata &data)
 
 {
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = varVn->beginDescend();
   enditer = varVn->endDescend();
   FlowBlock *rootBlock = (FlowBlock *)0;
@@ -3804,25 +3850,68 @@ void ActionInferTypes::propagationDebug(Architecture *glb,Varnode *vn,const Data
 #endif
 
 /// Collect \e local data-type information on each Varnode inferred
-/// from the PcodeOps that read and write to it.
+/// from the PcodeOps that read and write to it.  The local data-types are compared
+/// against those recorded by the previous pass.  If the data-flow is unchanged and
+/// every Varnode has the same local data-type and properties, the temporary data-types
+/// still hold the results of the previous propagation and are left alone.  Otherwise
+/// every temporary data-type is reset to the local data-type.
 /// \param data is the function being analyzed
-void ActionInferTypes::buildLocaltypes(Funcdata &data)
+/// \return \b true if the results of the previous pass can be reused
+bool ActionInferTypes::buildLocaltypes(Funcdata &data)
 
 {
   Datatype *ct;
   Varnode *vn;
   VarnodeLocSet::const_iterator iter;
+  bool match = (data.getModificationCount() == lastmodcount);
+  int4 count = 0;			// Number of Varnodes matching the previous pass
 
+  if (!match)
+    lastpass.clear();
   for(iter=data.beginLoc();iter!=data.endLoc();++iter) {
     vn = *iter;
     if (vn->isAnnotation()) continue;
     if ((!vn->isWritten())&&(vn->hasNoDescend())) continue;
     ct = vn->getLocalType();
+    uint4 fl = vn->getFlags() & (Varnode::typelock | Varnode::spacebase);
+    if (match) {
+      if (count < lastpass.size()) {
+	const PassRecord &rec( lastpass[count] );
+	if (rec.vn == vn && rec.localtype == ct && rec.flags == fl && rec.temptype == vn->getTempType()) {
+	  count += 1;
+	  continue;
+	}
+      }
+      match = false;		// Reset the Varnodes that matched so far
+      for(int4 i=0;i<count;++i)
+	lastpass[i].vn->setTempType(lastpass[i].localtype);
+      lastpass.erase(lastpass.begin()+count,lastpass.end());
+    }
 #ifdef TYPEPROP_DEBUG
     propagationDebug(data.getArch(),vn,ct,(PcodeOp *)0,0,(Varnode *)0);
 #endif
     vn->setTempType(ct);
+    lastpass.push_back(PassRecord(vn,ct,fl));
+  }
+  if (match && count == lastpass.size())
+    return true;
+  if (match) {			// Some Varnodes from the previous pass are gone
+    for(int4 i=0;i<count;++i)
+      lastpass[i].vn->setTempType(lastpass[i].localtype);
+    lastpass.erase(lastpass.begin()+count,lastpass.end());
   }
+  return false;
+}
+
+/// The propagated data-type of every Varnode visited by buildLocaltypes() is saved,
+/// along with the current modification count of the function.
+/// \param data is the function being analyzed
+void ActionInferTypes::recordPass(Funcdata &data)
+
+{
+  for(int4 i=0;i<lastpass.size();++i)
+    lastpass[i].temptype = lastpass[i].vn->getTempType();
+  lastmodcount = data.getModificationCount();
 }
 
 /// For each Varnode copy the temporary data-type to the permament
@@ -4256,11 +4345,7 @@ void ActionInferTypes::propagateRef(Funcdata &data,Varnode *vn,const Address &ad
     if ((cursize!=lastsize)||(curoff!=lastoff)) {
       lastoff = curoff;
       lastsize = cursize;
-      Datatype *cur = ct;
-      do {
-	lastct = cur;
-	cur = cur->getSubType(curoff,&curoff);
-      } while(cur != (Datatype *)0);
+      lastct = ct->getLeafType(curoff,&curoff);
     }
     if (lastct->getSize() != cursize) continue;
     
@@ -4292,7 +4377,7 @@ void ActionInferTypes::propagateSpacebaseRef(Funcdata &data,Varnode *spcvn)
   spctype = ((TypePointer *)spctype)->getPtrTo();
   if (spctype->getMetatype() != TYPE_SPACEBASE) return;
   TypeSpacebase *sbtype = (TypeSpacebase *)spctype;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   Address addr;
 
   for(iter=spcvn->beginDescend();iter!=spcvn->endDescend();++iter) {
@@ -4347,17 +4432,19 @@ int4 ActionInferTypes::apply(Funcdata &data)
     }
     return 0;
   }
-  buildLocaltypes(data);	// Set up initial types (based on local info)
-  for(iter=data.beginLoc();iter!=data.endLoc();++iter) {
-    vn = *iter;
-    if (vn->isAnnotation()) continue;
-    if ((!vn->isWritten())&&(vn->hasNoDescend())) continue;
-    propagateOneType(typegrp,vn);
+  if (!buildLocaltypes(data)) {	// Set up initial types (based on local info)
+    for(iter=data.beginLoc();iter!=data.endLoc();++iter) {
+      vn = *iter;
+      if (vn->isAnnotation()) continue;
+      if ((!vn->isWritten())&&(vn->hasNoDescend())) continue;
+      propagateOneType(typegrp,vn);
+    }
+    AddrSpace *spcid = data.getScopeLocal()->getSpaceId();
+    Varnode *spcvn = data.findSpacebaseInput(spcid);
+    if (spcvn != (Varnode *)0)
+      propagateSpacebaseRef(data,spcvn);
+    recordPass(data);
   }
-  AddrSpace *spcid = data.getScopeLocal()->getSpaceId();
-  Varnode *spcvn = data.findSpacebaseInput(spcid);
-  if (spcvn != (Varnode *)0)
-    propagateSpacebaseRef(data,spcvn);
   if (writeBack(data)) {
     // count += 1;			// Do not consider this a data-flow change
     localcount += 1;
@@ -4425,7 +4512,7 @@ void TermOrder::sortTerms(void)
   sort(sorter.begin(),sorter.end(),additiveCompare);
 }
 
-/// Build the default \e root Actions: decompile, jumptable, normalize, paramid, register, firstpass
+/// Build the default \e root Actions: decompile, jumptable, normalize, paramid, protoonly, register, firstpass, draft
 /// \param allacts is the database that will hold the \e root Actions
 void build_defaultactions(ActionDatabase &allacts)
 
@@ -4458,11 +4545,23 @@ void build_defaultactions(ActionDatabase &allacts)
                              "conditionalexe", "" };
   allacts.setGroup("paramid",paramid);
 
+  const char *protoonly[] = { "base", "protorecovery", "protorecovery_b", "deindirect", "localrecovery",
+			      "deadcode", "stackptrflow", "stackvars", "fixateproto", "" };
+  allacts.setGroup("protoonly",protoonly);
+
   const char *regmemb[] = { "base", "analysis", "subvar", "" };
   allacts.setGroup("register",regmemb);
 
   const char *firstmem[] = { "base", "" };
   allacts.setGroup("firstpass",firstmem);
+
+  const char *draftmem[] = { "base", "protorecovery", "protorecovery_a", "localrecovery",
+			     "deadcode", "typerecovery", "stackptrflow",
+			     "blockrecovery", "stackvars", "deadcontrolflow", "switchnorm",
+			     "cleanup", "merge", "dynamic", "casts", "analysis",
+			     "fixateglobals", "fixateproto",
+			     "segment", "returnsplit", "nodejoin", "unreachable", "" };
+  allacts.setGroup("draft",draftmem);
 }
 
 /// Construct the \b universal Action that contains all possible components
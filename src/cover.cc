@@ -15,6 +15,7 @@
  */
 #include "cover.hh"
 #include "block.hh"
+#include "metrics.hh"
 
 namespace GhidraDec {
 /// PcodeOp objects and a CoverBlock start/stop boundaries have
@@ -211,6 +212,69 @@ void CoverBlock::print(ostream &s) const
     s << stop->getSeqNum();
 }
 
+/// The block bitsets are compared word by word, so Covers in disjoint parts of
+/// the function are distinguished without looking at any CoverBlock.
+/// \param op2 is the other Cover
+/// \return \b true if there is a block with an entry in both Covers
+bool Cover::shareBlock(const Cover &op2) const
+
+{
+  int4 max = blockmask.size();
+  if (op2.blockmask.size() < max)
+    max = op2.blockmask.size();
+  for(int4 i=0;i<max;++i) {
+    if ((blockmask[i] & op2.blockmask[i]) != 0)
+      return true;
+  }
+  return false;
+}
+
+/// \param i is the index of the block
+/// \return the CoverBlock or \b null if \b this has no entry for the block
+const CoverBlock *Cover::findBlock(int4 i) const
+
+{
+  if (!hasBlock(i)) return (const CoverBlock *)0;
+  int4 lo = 0;
+  int4 hi = cover.size() - 1;
+  while(lo < hi) {
+    int4 mid = (lo + hi) / 2;
+    if (cover[mid].first < i)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return &cover[lo].second;
+}
+
+/// If there is no entry for the block, an empty CoverBlock is inserted into the list.
+/// The returned reference is invalidated by any later insertion.
+/// \param i is the index of the block
+/// \return a reference to the (possibly new) CoverBlock
+CoverBlock &Cover::getBlock(int4 i)
+
+{
+  int4 lo = 0;
+  int4 hi = cover.size();
+  if (hi != 0 && cover[hi-1].first < i)
+    lo = hi;			// Blocks are usually added in increasing order
+  while(lo < hi) {
+    int4 mid = (lo + hi) / 2;
+    if (cover[mid].first < i)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  if (lo < cover.size() && cover[lo].first == i)
+    return cover[lo].second;
+  uint4 word = i >> 6;
+  if (word >= blockmask.size())
+    blockmask.resize(word + 1,0);
+  blockmask[word] |= ((uintb)1) << (i & 63);
+  vector<pair<int4,CoverBlock> >::iterator iter = cover.insert(cover.begin() + lo,pair<int4,CoverBlock>(i,CoverBlock()));
+  return (*iter).second;
+}
+
 /// Compare \b this with another Cover by comparing just
 /// the indices of the first blocks respectively that are partly covered.
 /// Return -1, 0, or 1 if \b this Cover's first block has a
@@ -222,7 +286,7 @@ int4 Cover::compareTo(const Cover &op2) const
 {
   int4 a,b;
 
-  map<int4,CoverBlock>::const_iterator iter;
+  const_iterator iter;
   iter = cover.begin();
   if (iter==cover.end())
     a = 1000000;
@@ -250,10 +314,10 @@ int4 Cover::compareTo(const Cover &op2) const
 const CoverBlock &Cover::getCoverBlock(int4 i) const
 
 {
-  map<int4,CoverBlock>::const_iterator iter = cover.find(i);
-  if (iter == cover.end())
+  const CoverBlock *block = findBlock(i);
+  if (block == (const CoverBlock *)0)
     return emptyblock;
-  return (*iter).second;
+  return *block;
 }
 
 /// Return
@@ -266,10 +330,12 @@ const CoverBlock &Cover::getCoverBlock(int4 i) const
 int4 Cover::intersect(const Cover &op2) const
 
 {
-  map<int4,CoverBlock>::const_iterator iter,iter2;
+  const_iterator iter,iter2;
   int4 res,newres;
 
+  AnalysisMetrics::count(AnalysisMetrics::cover_intersect);
   res = 0;
+  if (!shareBlock(op2)) return res;
   iter = cover.begin();
   iter2 = op2.cover.begin();
 
@@ -304,10 +370,11 @@ int4 Cover::intersect(const Cover &op2) const
 void Cover::intersectList(vector<int4> &listout,const Cover &op2,int4 level) const
 
 {
-  map<int4,CoverBlock>::const_iterator iter,iter2;
+  const_iterator iter,iter2;
   int4 val;
 
   listout.clear();
+  if (!shareBlock(op2)) return;
 
   iter = cover.begin();
   iter2 = op2.cover.begin();
@@ -341,17 +408,14 @@ void Cover::intersectList(vector<int4> &listout,const Cover &op2,int4 level) con
 int4 Cover::intersectByBlock(int4 blk,const Cover &op2) const
 
 {
-  map<int4,CoverBlock>::const_iterator iter;
-
-  iter = cover.find(blk);
-  if (iter == cover.end()) return 0;
-  
-  map<int4,CoverBlock>::const_iterator iter2;
+  AnalysisMetrics::count(AnalysisMetrics::cover_intersect);
+  const CoverBlock *block = findBlock(blk);
+  if (block == (const CoverBlock *)0) return 0;
 
-  iter2 = op2.cover.find(blk);
-  if (iter2 == op2.cover.end()) return 0;
+  const CoverBlock *block2 = op2.findBlock(blk);
+  if (block2 == (const CoverBlock *)0) return 0;
 
-  return (*iter).second.intersect((*iter2).second);
+  return block->intersect(*block2);
 }
 
 /// \brief Does \b this contain the given PcodeOp
@@ -362,13 +426,11 @@ int4 Cover::intersectByBlock(int4 blk,const Cover &op2) const
 bool Cover::contain(const PcodeOp *op,int4 max) const
 
 {
-  map<int4,CoverBlock>::const_iterator iter;
-
-  iter = cover.find(op->getParent()->getIndex());
-  if (iter == cover.end()) return false;
-  if ((*iter).second.contain(op)) {
+  const CoverBlock *block = findBlock(op->getParent()->getIndex());
+  if (block == (const CoverBlock *)0) return false;
+  if (block->contain(op)) {
     if (max==1) return true;
-    if (0==(*iter).second.boundary(op)) return true;
+    if (0==block->boundary(op)) return true;
   }
   return false;
 }
@@ -399,10 +461,10 @@ int4 Cover::containVarnodeDef(const Varnode *vn) const
   }
   else
     blk = op->getParent()->getIndex();
-  map<int4,CoverBlock>::const_iterator iter = cover.find(blk);
-  if (iter == cover.end()) return 0;
-  if ((*iter).second.contain(op)) {
-    int4 boundtype = (*iter).second.boundary(op);
+  const CoverBlock *block = findBlock(blk);
+  if (block == (const CoverBlock *)0) return 0;
+  if (block->contain(op)) {
+    int4 boundtype = block->boundary(op);
     if (boundtype == 0) return 1;
     if (boundtype == 2) return 2;
     return 3;
@@ -410,14 +472,80 @@ int4 Cover::containVarnodeDef(const Varnode *vn) const
   return 0;
 }
 
+/// The two sorted lists are merged in a single pass.
 /// \param op2 is the other Cover
 void Cover::merge(const Cover &op2)
 
 {
-  map<int4,CoverBlock>::const_iterator iter;
+  if (op2.cover.empty()) return;
+  if (cover.empty()) {
+    cover = op2.cover;
+    blockmask = op2.blockmask;
+    return;
+  }
+  vector<pair<int4,CoverBlock> > res;
+  res.reserve(cover.size() + op2.cover.size());
+  const_iterator iter = cover.begin();
+  const_iterator iter2 = op2.cover.begin();
+  while(iter != cover.end() || iter2 != op2.cover.end()) {
+    if (iter2 == op2.cover.end() || (iter != cover.end() && (*iter).first < (*iter2).first)) {
+      res.push_back(*iter);
+      ++iter;
+    }
+    else if (iter == cover.end() || (*iter2).first < (*iter).first) {
+      res.push_back(*iter2);
+      ++iter2;
+    }
+    else {
+      res.push_back(*iter);
+      res.back().second.merge((*iter2).second);
+      ++iter;
+      ++iter2;
+    }
+  }
+  cover.swap(res);
+  if (blockmask.size() < op2.blockmask.size())
+    blockmask.resize(op2.blockmask.size(),0);
+  for(int4 i=0;i<op2.blockmask.size();++i)
+    blockmask[i] |= op2.blockmask[i];
+}
+
+/// \param i is the index of the block
+void Cover::clearBlock(int4 i)
+
+{
+  if (!hasBlock(i)) return;
+  int4 lo = 0;
+  int4 hi = cover.size() - 1;
+  while(lo < hi) {
+    int4 mid = (lo + hi) / 2;
+    if (cover[mid].first < i)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  cover.erase(cover.begin() + lo);
+  blockmask[i >> 6] &= ~(((uintb)1) << (i & 63));
+}
+
+/// If \b op2 has an entry for the block, an entry is created in \b this (if necessary)
+/// and the two CoverBlocks are merged, exactly as merge() would do for that block.
+/// \param i is the index of the block
+/// \param op2 is the other Cover
+void Cover::mergeBlock(int4 i,const Cover &op2)
+
+{
+  const CoverBlock *block = op2.findBlock(i);
+  if (block == (const CoverBlock *)0) return;
+  getBlock(i).merge(*block);
+}
 
-  for(iter=op2.cover.begin();iter!=op2.cover.end();++iter)
-    cover[(*iter).first].merge((*iter).second);
+/// \param res will hold the block indices
+void Cover::addBlocks(vector<int4> &res) const
+
+{
+  for(const_iterator iter=cover.begin();iter!=cover.end();++iter)
+    res.push_back((*iter).first);
 }
 
 /// The cover is set to all p-code ops between the point where
@@ -426,7 +554,7 @@ void Cover::merge(const Cover &op2)
 void Cover::rebuild(const Varnode *vn)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
 
   addDefPoint(vn);
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter)
@@ -441,16 +569,16 @@ void Cover::addDefPoint(const Varnode *vn)
 {
   const PcodeOp *def;
 
-  cover.clear();
+  clear();
 
   def = vn->getDef();
   if (def != (const PcodeOp *)0) {
-    CoverBlock &block( cover[def->getParent()->getIndex() ] );
+    CoverBlock &block( getBlock(def->getParent()->getIndex()) );
     block.setBegin(def);	// Set the point topology
     block.setEnd(def);
   }
   else if (vn->isInput()) {
-    CoverBlock &block( cover[0] );
+    CoverBlock &block( getBlock(0) );
     block.setBegin( (const PcodeOp *)2 ); // Special mark for input
     block.setEnd( (const PcodeOp *)2 );
   }
@@ -465,7 +593,7 @@ void Cover::addRefRecurse(const FlowBlock *bl)
   int4 j;
   uintm ustart,ustop;
 
-  CoverBlock &block(cover[bl->getIndex()]);
+  CoverBlock &block(getBlock(bl->getIndex()));
   if (block.empty()) {
     block.setAll();		// No cover encountered, fill in entire block
     //    if (bl->InSize()==0)
@@ -508,7 +636,7 @@ void Cover::addRefPoint(const PcodeOp *ref,const Varnode *vn)
   uintm ustop;
 
   bl = ref->getParent();
-  CoverBlock &block(cover[bl->getIndex()]);
+  CoverBlock &block(getBlock(bl->getIndex()));
   if (block.empty()) {
     block.setEnd(ref);
   }
@@ -549,11 +677,18 @@ void Cover::addRefPoint(const PcodeOp *ref,const Varnode *vn)
       addRefRecurse(bl->getIn(j));
 }
 
+/// \return the estimated number of bytes
+uint8 Cover::memoryEstimate(void) const
+
+{
+  return sizeof(Cover) + cover.capacity() * sizeof(pair<int4,CoverBlock>) + blockmask.capacity() * sizeof(uintb);
+}
+
 /// \param s is the output stream
 void Cover::print(ostream &s) const
 
 {
-  map<int4,CoverBlock>::const_iterator iter;
+  const_iterator iter;
 
   for(iter=cover.begin();iter!=cover.end();++iter) {
     s << dec << (*iter).first << ": ";
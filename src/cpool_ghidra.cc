@@ -28,20 +28,56 @@ CPoolRecord *ConstantPoolGhidra::createRecord(const vector<uintb> &refs)
   throw LowlevelError("Cannot access constant pool with this method");
 }
 
+void ConstantPoolGhidra::clearPending(void) const
+
+{
+  map<vector<uintb>,Document *>::iterator iter;
+  for(iter=pending.begin();iter!=pending.end();++iter)
+    delete (*iter).second;
+  pending.clear();
+}
+
+/// \param refs is the reference
+/// \return \b true if no query needs to be sent for the reference
+bool ConstantPoolGhidra::isKnown(const vector<uintb> &refs) const
+
+{
+  if (cache.getRecord(refs) != (const CPoolRecord *)0) return true;
+  return (pending.find(refs) != pending.end());
+}
+
+/// \param refs is the reference the response is for
+/// \param doc is the response to a \e getCPoolRef query, which \b this takes ownership of
+void ConstantPoolGhidra::addPending(const vector<uintb> &refs,Document *doc)
+
+{
+  Document *&slot( pending[refs] );
+  if (slot != (Document *)0)
+    delete slot;
+  slot = doc;
+}
+
 const CPoolRecord *ConstantPoolGhidra::getRecord(const vector<uintb> &refs) const
 
 {
   const CPoolRecord *rec = cache.getRecord(refs);
   if (rec == (const CPoolRecord *)0) {
     Document *doc;
-    try {
-      doc = ghidra->getCPoolRef(refs);
-    }
-    catch(JavaError &err) {
-      throw LowlevelError("Error fetching constant pool record: " + err.explain);
+    map<vector<uintb>,Document *>::iterator iter = pending.find(refs);
+    if (iter != pending.end()) {	// Response was already fetched
+      doc = (*iter).second;
+      pending.erase(iter);
     }
-    catch(XmlError &err) {
-      throw LowlevelError("Error in constant pool record xml: "+err.explain);
+    else {
+      try {
+	doc = ghidra->getCPoolRef(refs);
+      }
+      catch(JavaError &err) {
+	throw LowlevelError("Error fetching constant pool record: " + err.explain);
+      }
+      catch(XmlError &err) {
+	throw LowlevelError("Error in constant pool record xml: "+err.explain);
+      }
     }
     if (doc == (Document *)0) {
       ostringstream s;
@@ -134,18 +134,14 @@ bool SymbolEntry::updateType(Varnode *vn) const
 Datatype *SymbolEntry::getSizedType(const Address &inaddr,int4 sz) const
 
 {
-  Datatype *last,*cur;
+  Datatype *last;
   uintb off;
 
   if (isDynamic())
     off = offset;
   else
     off = (inaddr.getOffset() - addr.getOffset()) + offset;
-  cur = symbol->getType();
-  do {
-    last = cur;
-    cur = cur->getSubType(off,&off);
-  } while(cur != (Datatype *)0);
+  last = symbol->getType()->getLeafType(off,&off);
   if (last->getSize() == sz)
     return last;
   //    else {
@@ -693,6 +689,7 @@ void Scope::attachScope(Scope *child)
     delete child;
     throw RecovError(s.str());
   }
+  childindex.insert(child);
 }
 
 /// The indicated child Scope is deleted
@@ -701,6 +698,7 @@ void Scope::detachScope(ScopeMap::iterator iter)
 
 {
   Scope *child = (*iter).second;
+  childindex.erase(child);
   children.erase(iter);
   delete child;
 }
@@ -1114,14 +1112,14 @@ LabSymbol *Scope::queryCodeLabel(const Address &addr) const
 Scope *Scope::resolveScope(const std::string &name) const
 
 {
-  ScopeKey key(name,0xffffffff);
-  ScopeMap::const_iterator iter = children.upper_bound(key);
-  if (iter == children.begin()) return (Scope *)0;	// All children are after -name-
-  --iter;
- Scope *scope = (*iter).second;
- if (scope->name == name)
-   return scope;
- return (Scope *)0;
+  vector<Scope *> matches;
+  childindex.find(name,matches);
+  Scope *scope = (Scope *)0;
+  for(int4 i=0;i<matches.size();++i) {	// Pick the scope with the biggest dedup id
+    if (scope == (Scope *)0 || matches[i]->dedupId > scope->dedupId)
+      scope = matches[i];
+  }
+  return scope;
 }
 
 /// Discover a sub-scope or containing Scope of \b this, that \e owns the given
@@ -1315,7 +1313,30 @@ Symbol *Scope::addMapSym(const Element *el)
 {
   const List &sublist( el->getChildren());
   List::const_iterator subiter = sublist.begin();
-  const Element *subel = *subiter;
+  const std::string &symname( (*subiter)->getName() );
+  Symbol *sym = restoreSymbolTag(*subiter);
+  addSymbolInternal(sym);	// This routine may throw, but it will delete sym in this case
+  ++subiter;
+  while(subiter != sublist.end()) {
+    SymbolEntry entry(sym);
+    subiter = entry.restoreXml(subiter,glb);
+    if (entry.isInvalid()) {
+      glb->printMessage("WARNING: Throwing out symbol with invalid mapping: "+symname);
+      removeSymbol(sym);
+      return (Symbol *)0;
+    }
+    addMap(entry);
+  }
+  return sym;
+}
+
+/// The Symbol is allocated according to the name of the tag and restored from it, but it is
+/// not yet added to \b this Scope.
+/// \param subel is the tag describing the Symbol
+/// \return the new Symbol
+Symbol *Scope::restoreSymbolTag(const Element *subel)
+
+{
   Symbol *sym;
   const std::string &symname( subel->getName() );
   if (symname == "symbol")
@@ -1340,19 +1361,86 @@ Symbol *Scope::addMapSym(const Element *el)
     delete sym;
     throw err;
   }
-  addSymbolInternal(sym);	// This routine may throw, but it will delete sym in this case
-  ++subiter;
-  while(subiter != sublist.end()) {
-    SymbolEntry entry(sym);
-    subiter = entry.restoreXml(subiter,glb);
-    if (entry.isInvalid()) {
-      glb->printMessage("WARNING: Throwing out symbol with invalid mapping: "+symname);
-      removeSymbol(sym);
-      return (Symbol *)0;
+  return sym;
+}
+
+/// Every tag must describe a single mapping.  Tags given in address order are inserted without
+/// searching the maps of \b this Scope (see addSymbolBatch()).  If any tag can't be restored,
+/// no Symbol is added and the error is thrown.
+/// \param els are the \<mapsym> tags
+void Scope::addMapSymBatch(const vector<const Element *> &els)
+
+{
+  vector<SymbolEntry> entries;
+  entries.reserve(els.size());
+  try {
+    for(int4 i=0;i<els.size();++i) {
+      const List &sublist( els[i]->getChildren());
+      List::const_iterator subiter = sublist.begin();
+      const std::string &symname( (*subiter)->getName() );
+      entries.push_back(SymbolEntry(restoreSymbolTag(*subiter)));
+      ++subiter;
+      if (subiter == sublist.end() || entries.back().restoreXml(subiter,glb) != sublist.end())
+	throw LowlevelError("Batched symbol must have exactly one mapping: "+symname);
+      if (entries.back().isInvalid())
+	throw LowlevelError("Symbol with invalid mapping: "+symname);
+    }
+  }
+  catch(LowlevelError &err) {
+    for(int4 i=0;i<entries.size();++i)
+      delete entries[i].symbol;
+    throw;
+  }
+  addSymbolEntries(entries);
+}
+
+/// The Symbols are put in the name map together, with addSymbolsInternal(), which is faster than
+/// adding them one at a time, and each is then mapped to its address with no limit on its use.
+/// If the addresses are in order, each mapping is appended to the map of its address space without
+/// a search, so a large set of symbols, like those read from a load image, is added in linear time.
+/// If the Symbols can't be added, those not added are deleted and the error is thrown.
+/// \param syms are the new Symbols
+/// \param addrs are the addresses of the Symbols, in the same order
+void Scope::addSymbolBatch(const vector<Symbol *> &syms,const vector<Address> &addrs)
+
+{
+  vector<SymbolEntry> entries;
+  entries.reserve(syms.size());
+  for(int4 i=0;i<syms.size();++i) {
+    entries.push_back(SymbolEntry(syms[i]));
+    entries.back().addr = addrs[i];
+  }
+  addSymbolEntries(entries);
+}
+
+/// \param entries are the mappings, one for each new Symbol
+void Scope::addSymbolEntries(const vector<SymbolEntry> &entries)
+
+{
+  vector<Symbol *> syms;
+  syms.reserve(entries.size());
+  for(int4 i=0;i<entries.size();++i)
+    syms.push_back(entries[i].symbol);
+  addSymbolsInternal(syms);	// Deletes the Symbols not added if it throws
+  for(int4 i=0;i<entries.size();++i)
+    addMap(entries[i]);
+}
+
+/// The Symbols are added one at a time with addSymbolInternal().
+/// \param syms are the preconstructed Symbols
+void Scope::addSymbolsInternal(const vector<Symbol *> &syms)
+
+{
+  for(int4 i=0;i<syms.size();++i) {
+    try {
+      addSymbolInternal(syms[i]);	// Deletes the Symbol if it throws
+    }
+    catch(LowlevelError &err) {
+      for(int4 j=i+1;j<syms.size();++j)
+	delete syms[j];
+      throw;
     }
-    addMap(entry);
   }
-  return sym;
 }
 
 /// \brief Create a function Symbol at the given address in \b this Scope
@@ -1478,22 +1566,80 @@ void ScopeInternal::addSymbolInternal(Symbol *sym)
     if (sym->getType()->getSize() < 1)
       throw LowlevelError(sym->getName() + " symbol created with zero size type");
     insertNameTree(sym);
-    if (sym->category >= 0) {
-      while(category.size() <= sym->category)
-	category.push_back(std::vector<Symbol *>());
-      std::vector<Symbol *> &list(category[sym->category]);
-      if (sym->category > 0)
-	sym->catindex = list.size();
-      while(list.size() <= sym->catindex)
-	list.push_back((Symbol *)0);
-      list[sym->catindex] = sym;
-    }
+    addCategory(sym);
   } catch(LowlevelError &err) {
     delete sym;			// Symbol must be deleted to avoid orphaning its memory
     throw err;
   }
 }
 
+/// Every Symbol is checked before any is added, so either all the Symbols are added or none are.
+/// If the name map is empty, it is built directly from the Symbols sorted by name, in linear time
+/// after the sort.  Symbols sharing a name are deduplicated in the order they are given.
+/// \param syms are the preconstructed Symbols
+void ScopeInternal::addSymbolsInternal(const vector<Symbol *> &syms)
+
+{
+  for(int4 i=0;i<syms.size();++i) {
+    Symbol *sym = syms[i];
+    string msg;
+    if (sym->getType() == (Datatype *)0)
+      msg = sym->getName() + " symbol created with no type";
+    else if (sym->getType()->getSize() < 1)
+      msg = sym->getName() + " symbol created with zero size type";
+    else
+      continue;
+    for(int4 j=0;j<syms.size();++j)
+      delete syms[j];		// Nothing has been added, so every Symbol must be deleted
+    throw LowlevelError(msg);
+  }
+  vector<Symbol *> sorted;
+  sorted.reserve(syms.size());
+  for(int4 i=0;i<syms.size();++i) {
+    Symbol *sym = syms[i];
+    if (sym->name.size() == 0) {
+      sym->name = buildUndefinedName();
+      insertNameTree(sym);	// So the next undefined name is different
+    }
+    else {
+      sym->nameDedup = 0;
+      sorted.push_back(sym);
+    }
+  }
+  if (nametree.empty()) {
+    stable_sort(sorted.begin(),sorted.end(),SymbolCompareName());
+    for(int4 i=0;i<sorted.size();++i) {
+      Symbol *sym = sorted[i];
+      if (i > 0 && sorted[i-1]->name == sym->name)
+	sym->nameDedup = sorted[i-1]->nameDedup + 1;
+      nametree.insert(nametree.end(),sym);	// Inserting at the end, with its hint, takes constant time
+      nameindex.insert(sym);
+    }
+  }
+  else {
+    for(int4 i=0;i<sorted.size();++i)
+      insertNameTree(sorted[i]);
+  }
+  for(int4 i=0;i<syms.size();++i)
+    addCategory(syms[i]);
+}
+
+/// If the Symbol has a category, it is put in the list for the category.
+/// \param sym is the Symbol
+void ScopeInternal::addCategory(Symbol *sym)
+
+{
+  if (sym->category < 0) return;
+  while(category.size() <= sym->category)
+    category.push_back(std::vector<Symbol *>());
+  std::vector<Symbol *> &list(category[sym->category]);
+  if (sym->category > 0)
+    sym->catindex = list.size();
+  while(list.size() <= sym->catindex)
+    list.push_back((Symbol *)0);
+  list[sym->catindex] = sym;
+}
+
 SymbolEntry *ScopeInternal::addMapInternal(Symbol *sym,uint4 exfl,const Address &addr,int4 off,int4 sz,
 					   const RangeList &uselim)
 {
@@ -1515,6 +1661,7 @@ SymbolEntry *ScopeInternal::addMapInternal(Symbol *sym,uint4 exfl,const Address
   }
     
   list<SymbolEntry>::iterator iter = rangemap->insert(initdata,addr.getOffset(),lastaddress.getOffset());
+  glb->symboltab->noteMapped(addr,sz);
   // Store reference to map in symbol
   sym->mapentry.push_back(iter);
   return &(*iter);
@@ -1533,6 +1680,7 @@ SymbolEntry *ScopeInternal::addDynamicMapInternal(Symbol *sym,uint4 exfl,uint8 h
 MapIterator ScopeInternal::begin(void) const
 
 {
+  createAllDeferred();
   // The symbols are ordered via their mapping address
   std::vector<EntryMap *>::const_iterator iter;
   iter = maptable.begin();
@@ -1594,11 +1742,14 @@ ScopeInternal::ScopeInternal(const std::string &nm,Architecture *g)
   int4 numspaces = g->numSpaces();
   for(int4 i=0;i<numspaces;++i)
     maptable.push_back((EntryMap *)0);
+  lazyremain = 0;
+  lazymaxsize = 1;
 }
 
 ScopeInternal::~ScopeInternal(void)
 
 {
+  releaseDeferred();
   std::vector<EntryMap *>::iterator iter1;
 
   for(iter1=maptable.begin();iter1!=maptable.end();++iter1)
@@ -1614,6 +1765,7 @@ ScopeInternal::~ScopeInternal(void)
 void ScopeInternal::clear(void)
 
 {
+  releaseDeferred();
   SymbolNameTree::iterator iter;
 
   iter = nametree.begin();
@@ -1678,6 +1830,7 @@ void ScopeInternal::clearCategory(int4 cat)
 void ScopeInternal::clearUnlocked(void)
 
 {
+  createAllDeferred();
   SymbolNameTree::iterator iter;
 
   iter = nametree.begin();
@@ -1697,6 +1850,31 @@ void ScopeInternal::clearUnlocked(void)
   }
 }
 
+/// The estimate counts each Symbol and its name, each SymbolEntry with its range tree node,
+/// and any deferred symbols still waiting to be created.
+/// \return the estimated number of bytes
+uint8 ScopeInternal::memoryEstimate(void) const
+
+{
+  uint8 res = 0;
+  SymbolNameTree::const_iterator iter;
+  for(iter=nametree.begin();iter!=nametree.end();++iter) {
+    const Symbol *sym = *iter;
+    res += sizeof(Symbol) + sym->getName().capacity() + 2 * 4 * sizeof(void *);	// Name tree and index
+    res += sym->mapentry.capacity() * sizeof(list<SymbolEntry>::iterator);
+  }
+  uint8 numentry = dynamicentry.size();
+  for(int4 i=0;i<maptable.size();++i) {
+    if (maptable[i] == (EntryMap *)0) continue;
+    list<SymbolEntry>::const_iterator eiter;
+    for(eiter=maptable[i]->begin_list();eiter!=maptable[i]->end_list();++eiter)
+      numentry += 1;
+  }
+  res += numentry * (sizeof(SymbolEntry) + 7 * sizeof(void *) + 3 * sizeof(uintb));	// List node and range tree node
+  res += lazylist.capacity() * sizeof(LazySymbol) + lazynames.size() * (4 * sizeof(void *) + sizeof(string));
+  return res;
+}
+
 void ScopeInternal::clearUnlockedCategory(int4 cat)
 
 {
@@ -1759,6 +1937,7 @@ void ScopeInternal::removeSymbol(Symbol *symbol)
       rangemap->erase( *iter );
     }
   }
+  nameindex.erase(symbol);
   nametree.erase(symbol);
   delete symbol;
 }
@@ -1766,6 +1945,7 @@ void ScopeInternal::removeSymbol(Symbol *symbol)
 void ScopeInternal::renameSymbol(Symbol *sym,const std::string &newname)
 
 {
+  nameindex.erase(sym);
   nametree.erase(sym);		// Erase under old name 
   std::string oldname = sym->name;
   sym->name = newname;
@@ -1828,6 +2008,7 @@ void ScopeInternal::setDisplayFormat(Symbol *sym,uint4 attr)
 SymbolEntry *ScopeInternal::findAddr(const Address &addr,const Address &usepoint) const
 
 {
+  createDeferredRange(addr,1);
   EntryMap *rangemap = maptable[ addr.getSpace()->getIndex() ];
   if (rangemap != (EntryMap *)0) {
     pair<EntryMap::const_iterator,EntryMap::const_iterator> res;
@@ -1855,6 +2036,7 @@ SymbolEntry *ScopeInternal::findContainer(const Address &addr,int4 size,
 						   const Address &usepoint) const
 {
   SymbolEntry *bestentry = (SymbolEntry *)0;
+  createDeferredRange(addr,size);
   EntryMap *rangemap = maptable[ addr.getSpace()->getIndex() ];
   if (rangemap != (EntryMap *)0) {
     pair<EntryMap::const_iterator,EntryMap::const_iterator> res;
@@ -1889,6 +2071,7 @@ SymbolEntry *ScopeInternal::findClosestFit(const Address &addr,int4 size,
 					   const Address &usepoint) const
 {
   SymbolEntry *bestentry = (SymbolEntry *)0;
+  createDeferredRange(addr,size);
   EntryMap *rangemap = maptable[ addr.getSpace()->getIndex() ];
   if (rangemap != (EntryMap *)0) {
     pair<EntryMap::const_iterator,EntryMap::const_iterator> res;
@@ -1973,6 +2156,7 @@ LabSymbol *ScopeInternal::findCodeLabel(const Address &addr) const
 
 {
   LabSymbol *sym = (LabSymbol *)0;
+  createDeferredRange(addr,1);
   EntryMap *rangemap = maptable[ addr.getSpace()->getIndex() ];
   if (rangemap != (EntryMap *)0) {
     pair<EntryMap::const_iterator,EntryMap::const_iterator> res;
@@ -1996,6 +2180,7 @@ LabSymbol *ScopeInternal::findCodeLabel(const Address &addr) const
 SymbolEntry *ScopeInternal::findOverlap(const Address &addr,int4 size) const
 
 {
+  createDeferredRange(addr,size);
   EntryMap *rangemap = maptable[ addr.getSpace()->getIndex() ];
   if (rangemap != (EntryMap *)0) {
     EntryMap::const_iterator iter;
@@ -2009,6 +2194,7 @@ SymbolEntry *ScopeInternal::findOverlap(const Address &addr,int4 size) const
 SymbolEntry *ScopeInternal::findBefore(const Address &addr) const
 
 {
+  createAllDeferred();
   EntryMap *rangemap = maptable[ addr.getSpace()->getIndex() ];
   if (rangemap != (EntryMap *)0) {
     EntryMap::const_iterator iter;
@@ -2022,6 +2208,7 @@ SymbolEntry *ScopeInternal::findBefore(const Address &addr) const
 SymbolEntry *ScopeInternal::findAfter(const Address &addr) const
 
 {
+  createAllDeferred();
   EntryMap *rangemap = maptable[ addr.getSpace()->getIndex() ];
   if (rangemap != (EntryMap *)0) {
     EntryMap::const_iterator iter;
@@ -2035,13 +2222,11 @@ SymbolEntry *ScopeInternal::findAfter(const Address &addr) const
 void ScopeInternal::findByName(const std::string &name,std::vector<Symbol *> &res) const
 
 {
-  SymbolNameTree::const_iterator iter = findFirstByName(name);
-  while(iter != nametree.end()) {
-    Symbol *sym = *iter;
-    if (sym->name != name) break;
-    res.push_back(sym);
-    ++iter;
-  }
+  createDeferredNames(name,name);
+  int4 start = res.size();
+  nameindex.find(name,res);
+  if (res.size() - start > 1)	// Duplicate names are returned in deduplication order
+    sort(res.begin() + start,res.end(),SymbolCompareName());
 }
 
 std::string ScopeInternal::buildVariableName(const Address &addr,
@@ -2117,13 +2302,15 @@ std::string ScopeInternal::buildVariableName(const Address &addr,
     if (ct != (Datatype *)0)
       ct->printNameBase(s);
     s << "Var" << dec << index++;
-    if (findFirstByName(s.str()) != nametree.end()) {	// If the name already exists
+    createDeferredNames(s.str(),s.str());
+    if (nameindex.findAny(s.str()) != (Symbol *)0) {	// If the name already exists
       for(int4 i=0;i<10;++i) {	// Try bumping up the index a few times before calling makeNameUnique
 	std::ostringstream s2;
 	if (ct != (Datatype *)0)
 	  ct->printNameBase(s2);
 	s2 << "Var" << dec << index++;
-	if (findFirstByName(s2.str()) == nametree.end()) {
+	createDeferredNames(s2.str(),s2.str());
+	if (nameindex.findAny(s2.str()) == (Symbol *)0) {
 	  return s2.str();
 	}
       }
@@ -2143,6 +2330,7 @@ std::string ScopeInternal::buildUndefinedName(void) const
   // characters are hex digits which make the name unique
   SymbolNameTree::const_iterator iter;
 
+  createDeferredNames("$$undef","$$undefz");
   Symbol testsym((Scope *)0,"$$undefz",(Datatype *)0);
 
   iter = nametree.lower_bound(&testsym);
@@ -2168,8 +2356,9 @@ std::string ScopeInternal::buildUndefinedName(void) const
 std::string ScopeInternal::makeNameUnique(const std::string &nm) const
 
 {
+  createDeferredNames(nm,nm + "_x99999");	// Any name this can produce or has to step over
+  if (nameindex.findAny(nm) == (Symbol *)0) return nm; // nm is already unique
   SymbolNameTree::const_iterator iter = findFirstByName(nm);
-  if (iter == nametree.end()) return nm; // nm is already unique
 
   Symbol boundsym((Scope *)0,nm+"_x99999",(Datatype *)0);
   boundsym.nameDedup = 0xffffffff;
@@ -2223,7 +2412,7 @@ std::string ScopeInternal::makeNameUnique(const std::string &nm) const
       s << 'x' << setw(5) << uniqid;
     resString = s.str();
   }
-  if (findFirstByName(resString) != nametree.end())
+  if (nameindex.findAny(resString) != (Symbol *)0)
     throw LowlevelError("Unable to uniquify name: "+resString);
   return resString;
 }
@@ -2258,6 +2447,7 @@ void ScopeInternal::restorePathXml(std::vector<std::string> &vec,const Element *
 void ScopeInternal::saveXml(std::ostream &s) const
 
 {
+  createAllDeferred();
   s << "<scope";
   a_v(s,"name",name);
   s << ">\n";
@@ -2343,6 +2533,7 @@ void ScopeInternal::insertNameTree(Symbol *sym)
     if (!nameres.second)
       throw LowlevelError("Could  not deduplicate symbol: "+sym->name);
   }
+  nameindex.insert(sym);
 }
 
 /// \brief Find an iterator pointing to the first Symbol in the ordering with a given name
@@ -2390,6 +2581,10 @@ void ScopeInternal::restoreXml(const Element *el)
     while(iter2 != symlist.end()) {
       subel = *iter2;
       if (subel->getName() == "mapsym") {
+	if (!rangeequalssymbols && deferMapSym(subel)) {
+	  ++iter2;
+	  continue;
+	}
 	Symbol *sym = addMapSym(*iter2);
 	if (rangeequalssymbols) {
 	  SymbolEntry *e = sym->getFirstWholeMap();
@@ -2403,12 +2598,209 @@ void ScopeInternal::restoreXml(const Element *el)
       ++iter2;
     }
   }
+  sortDeferred();
   categorySanity();
 }
 
+/// Only symbols of a global Scope that are plain data symbols or code labels, mapped to a single
+/// address without extra pieces, and whose size is known without building anything, are deferred.
+/// In particular, the data-type of a data symbol must be a reference to an existing data-type,
+/// or a data-type with no name, so deferring the Symbol can't also defer a data-type definition.
+/// \param el is the \<mapsym> tag
+/// \return \b true if the Symbol has been deferred, \b false if it must be created now
+bool ScopeInternal::deferMapSym(const Element *el)
+
+{
+  if (!isGlobal()) return false;
+  const List &sublist(el->getChildren());
+  if (sublist.size() != 3) return false;	// Symbol must have exactly one mapping
+  const Element *symel = sublist[0];
+  const Element *storeel = sublist[1];
+  if (storeel->getName() == "hash") return false;
+  int4 size;
+  for(int4 i=0;i<symel->getNumAttributes();++i) {
+    if (symel->getAttributeName(i) == "cat") return false;	// Symbols in a category are created now
+  }
+  const string &symname(symel->getName());
+  if (symname == "labelsym")
+    size = 1;
+  else if (symname == "symbol") {
+    const List &typelist(symel->getChildren());
+    if (typelist.empty()) return false;
+    const Element *typeel = typelist[0];
+    if (typeel->getName() == "typeref") {
+      Datatype *ct;
+      try {
+	ct = glb->types->restoreXmlType(typeel);	// Only looks up the existing data-type
+      }
+      catch(LowlevelError &err) {
+	return false;		// Let the normal restore report the error
+      }
+      size = ct->getSize();
+    }
+    else {
+      for(int4 i=0;i<typeel->getNumAttributes();++i) {
+	if (typeel->getAttributeName(i) == "name" && typeel->getAttributeValue(i).size() != 0)
+	  return false;		// Named data-type defined in place
+      }
+      istringstream s(typeel->getAttributeValue("size"));
+      s.unsetf(ios::dec | ios::hex | ios::oct);
+      size = 0;
+      s >> size;
+    }
+  }
+  else
+    return false;
+  if (size < 1) return false;
+  string nm;
+  for(int4 i=0;i<symel->getNumAttributes();++i) {
+    if (symel->getAttributeName(i) == "name")
+      nm = symel->getAttributeValue(i);
+  }
+  if (nm.size() == 0) return false;	// Undefined names must be built in order
+  Address addr = Address::restoreXml(storeel,glb);
+  if (addr.isInvalid() || addr.isJoin()) return false;
+  if (addr.getOffset() + (size-1) < addr.getOffset()) return false;	// Wraps around the space
+  lazylist.emplace_back();
+  LazySymbol &lazy(lazylist.back());
+  lazy.el = el->clone((Element *)0);
+  lazy.addr = addr;
+  lazy.size = size;
+  if (size > lazymaxsize)
+    lazymaxsize = size;
+  return true;
+}
+
+/// Sort the symbols deferred by restoreXml() and build the index by name.  Entries
+/// for symbols already created by earlier queries are dropped first.
+void ScopeInternal::sortDeferred(void)
+
+{
+  if (lazylist.empty()) return;
+  int4 j = 0;
+  for(int4 i=0;i<lazylist.size();++i) {
+    if (lazylist[i].el != (Element *)0)
+      lazylist[j++] = lazylist[i];
+  }
+  lazylist.resize(j);
+  stable_sort(lazylist.begin(),lazylist.end());
+  lazynames.clear();
+  for(int4 i=0;i<lazylist.size();++i)
+    lazynames.insert(pair<string,int4>(lazylist[i].el->getChildren()[0]->getAttributeValue("name"),i));
+  lazyremain = lazylist.size();
+}
+
+/// The Symbol is restored from its \<mapsym> tag.  If this fails, the Symbol is thrown out
+/// with a warning, as the query that needs it may have nothing to do with it.
+/// \param i is the index of the deferred symbol
+void ScopeInternal::createDeferred(int4 i) const
+
+{
+  LazySymbol &lazy(lazylist[i]);
+  if (lazy.el == (Element *)0) return;
+  Element *el = lazy.el;
+  lazy.el = (Element *)0;
+  lazyremain -= 1;
+  try {
+    const_cast<ScopeInternal *>(this)->addMapSym(el);
+  }
+  catch(LowlevelError &err) {
+    glb->printMessage("WARNING: Throwing out symbol: " + err.explain);
+  }
+  delete el;
+}
+
+/// Free the copies of any tags that have not been restored, and the index itself
+void ScopeInternal::releaseDeferred(void) const
+
+{
+  for(int4 i=0;i<lazylist.size();++i) {
+    if (lazylist[i].el != (Element *)0)
+      delete lazylist[i].el;
+  }
+  lazylist.clear();
+  lazynames.clear();
+  lazyremain = 0;
+}
+
+/// Create every deferred Symbol whose storage intersects the given range, so queries of the range
+/// see the same symbols they would have, had everything been restored at once.
+/// \param addr is the first address of the range
+/// \param size is the number of bytes in the range
+void ScopeInternal::createDeferredRange(const Address &addr,int4 size) const
+
+{
+  if (lazyremain == 0) return;
+  AddrSpace *spc = addr.getSpace();
+  uintb first = addr.getOffset();
+  uintb last = first + (size-1);
+  if (last < first)
+    last = spc->getHighest();
+  LazySymbol bound;
+  bound.addr = Address(spc,(first < (uintb)(lazymaxsize-1)) ? 0 : first - (lazymaxsize-1));
+  vector<LazySymbol>::iterator iter = lower_bound(lazylist.begin(),lazylist.end(),bound);
+  for(;iter!=lazylist.end();++iter) {
+    const LazySymbol &lazy(*iter);
+    if (lazy.addr.getSpace() != spc) break;
+    if (lazy.addr.getOffset() > last) break;
+    if (lazy.el == (Element *)0) continue;
+    if (lazy.addr.getOffset() + (lazy.size-1) < first) continue;
+    createDeferred(iter - lazylist.begin());
+  }
+  if (lazyremain == 0)
+    releaseDeferred();
+}
+
+/// \param lo is the first name in the range
+/// \param hi is the last name in the range
+void ScopeInternal::createDeferredNames(const string &lo,const string &hi) const
+
+{
+  if (lazyremain == 0) return;
+  multimap<string,int4>::const_iterator iter = lazynames.lower_bound(lo);
+  multimap<string,int4>::const_iterator enditer = lazynames.upper_bound(hi);
+  for(;iter!=enditer;++iter)
+    createDeferred((*iter).second);
+  if (lazyremain == 0)
+    releaseDeferred();
+}
+
+/// The symbols are restored together with addMapSymBatch(), in address order.  If any tag can't be
+/// restored, they are restored one at a time, throwing out those that fail, as with createDeferred().
+void ScopeInternal::createAllDeferred(void) const
+
+{
+  if (lazyremain == 0) return;
+  vector<const Element *> els;
+  els.reserve(lazyremain);
+  for(int4 i=0;i<lazylist.size();++i) {
+    if (lazylist[i].el == (Element *)0) continue;
+    els.push_back(lazylist[i].el);
+    lazylist[i].el = (Element *)0;
+  }
+  releaseDeferred();		// Nothing is deferred while the symbols are created
+  ScopeInternal *scope = const_cast<ScopeInternal *>(this);
+  try {
+    scope->addMapSymBatch(els);
+  }
+  catch(LowlevelError &err) {
+    for(int4 i=0;i<els.size();++i) {
+      try {
+	scope->addMapSym(els[i]);
+      }
+      catch(LowlevelError &err2) {
+	glb->printMessage("WARNING: Throwing out symbol: " + err2.explain);
+      }
+    }
+  }
+  for(int4 i=0;i<els.size();++i)
+    delete els[i];
+}
+
 void ScopeInternal::printEntries(std::ostream &s) const
 
 {
+  createAllDeferred();
   s << "Scope " << name << endl;
   for(int4 i=0;i<maptable.size();++i) {
     EntryMap *rangemap = maptable[i];
@@ -2486,6 +2878,22 @@ void Database::clearResolve(Scope *scope)
 
 /// This recursively performs clearResolve() on the Scope and any sub-scopes
 /// \param scope is the given Scope to clear
+/// A Scope may put off creating the Symbols it restores from XML until a query needs them.
+/// Queries that find no deferred Symbols don't modify the Scope, so once this has been called,
+/// and until the Scope is modified, any number of threads may query it at the same time.
+/// \param scope is the given Scope
+void Database::restoreDeferred(Scope *scope)
+
+{
+  scope->restoreDeferred();
+  ScopeMap::const_iterator iter = scope->children.begin();
+  ScopeMap::const_iterator enditer = scope->children.end();
+  while(iter != enditer) {
+    restoreDeferred((*iter).second);
+    ++iter;
+  }
+}
+
 void Database::clearResolveRecursive(Scope *scope)
 
 {
@@ -2535,11 +2943,43 @@ void Database::attachScope(Scope *newscope,Scope *parent)
     if (newscope->name.size() != 0)
       throw LowlevelError("Global scope does not have empty name");
     globalscope = newscope;
+    if (dynamic_cast<ScopeInternal *>(newscope) == (ScopeInternal *)0)
+      mappedpagesok = false;	// Mappings are not all noted, so the index of mapped pages can't be used
     return;
   }
+  if (dynamic_cast<ScopeInternal *>(newscope) == (ScopeInternal *)0)
+    mappedpagesok = false;
   parent->attachScope(newscope);
 }
 
+/// The pages covering the range are added to the index used by isPossiblyMapped().
+/// Pages are never removed from the index, even if the Symbol is.
+/// \param addr is the starting address of the storage
+/// \param size is the number of bytes in the storage
+void Database::noteMapped(const Address &addr,int4 size)
+
+{
+  const uintb mask = (((uintb)1) << mappedShift) - 1;
+  AddrSpace *spc = addr.getSpace();
+  uintb first = addr.getOffset() & ~mask;
+  uintb last = (addr.getOffset() + (size-1)) | mask;
+  if (last > spc->getHighest())
+    last = spc->getHighest();
+  mappedpages.insertRange(spc,first,last);
+}
+
+/// This is a quick test that may be made before querying Scopes for a Symbol containing an
+/// address.  If it returns \b false, no Scope holds a Symbol at the address.  If it returns
+/// \b true, a Symbol may or may not exist.
+/// \param addr is the given address
+/// \return \b true unless the address is known to have no Symbol mapped to it
+bool Database::isPossiblyMapped(const Address &addr) const
+
+{
+  if (!mappedpagesok) return true;
+  return mappedpages.inRange(addr,1);
+}
+
 /// \param scope is the given Scope
 void Database::deleteScope(Scope *scope)
 
@@ -2752,6 +3192,32 @@ void Database::setPropertyRange(uint4 flags,const Range &range)
   }
 }
 
+/// Properties within the range are set back to their values in the given map, typically a copy
+/// of the property map taken before any were changed.  Properties outside the range are unaffected.
+/// \param orig is the map holding the properties to restore
+/// \param range is the given memory range
+void Database::restorePropertyRange(const partmap<Address,uint4> &orig,const Range &range)
+
+{
+  Address addr1 = range.getFirstAddr();
+  Address addr2 = range.getLastAddrOpen(glb);
+  flagbase.split(addr1);
+  if (!addr2.isInvalid())
+    flagbase.split(addr2);
+  partmap<Address,uint4>::const_iterator oiter;
+  for(oiter=orig.begin(addr1);oiter!=orig.end();++oiter) {	// Carry over split points of the original
+    if (!addr2.isInvalid() && !((*oiter).first < addr2)) break;
+    flagbase.split((*oiter).first);
+  }
+  partmap<Address,uint4>::iterator aiter,biter;
+  aiter = flagbase.begin(addr1);
+  biter = addr2.isInvalid() ? flagbase.end() : flagbase.begin(addr2);
+  while(aiter != biter) {
+    (*aiter).second = orig.getValue((*aiter).first);
+    ++aiter;
+  }
+}
+
 /// This writes a single \<db> tag to the stream, which contains sub-tags
 /// for each Scope (which contain Symbol sub-tags in turn).
 /// \param s is the output stream
@@ -24,6 +24,8 @@ ScopeGhidra::ScopeGhidra(ArchitectureGhidra *g)
   ghidra = g;
   cache = new ScopeInternal("",g);
   cacheDirty = false;
+  numqueries = 0;
+  numavoided = 0;
 }
 
 ScopeGhidra::~ScopeGhidra(void)
@@ -232,15 +234,43 @@ Symbol *ScopeGhidra::removeQuery(const Address &addr) const
     return (Symbol *)0;
 
   // Have we queried this address before
-  if (holes.inRange(addr,1)) return (Symbol *)0;
+  if (holes.inRange(addr,1)) {
+    numavoided += 1;
+    return (Symbol *)0;
+  }
+  numqueries += 1;
   doc = ghidra->getMappedSymbolsXML(addr); // Query GHIDRA about this address
   if (doc != (Document *)0) {
     sym = dump2Cache(doc);	// Add it to the cache
     delete doc;
   }
+  else				// No response, don't ask again
+    holes.insertRange(addr.getSpace(),addr.getOffset(),addr.getOffset());
   return sym;
 }
 
+/// A query can be answered with a Symbol that is not actually mapped at the queried
+/// address (Ghidra returns the whole function for an address in its interior, for instance).
+/// Such addresses are recorded separately from the \b holes, as the Symbol is still a valid
+/// answer to findFunction() and findExternalRef(), but findAddr() and findContainer()
+/// don't need to send the query again.
+/// \param addr is the address to check
+/// \return \b true if a previous query showed there is no Symbol mapped at the address
+bool ScopeGhidra::isMiss(const Address &addr) const
+
+{
+  if (!misses.inRange(addr,1)) return false;
+  numavoided += 1;
+  return true;
+}
+
+/// \param addr is the queried address with no Symbol mapped to it
+void ScopeGhidra::recordMiss(const Address &addr) const
+
+{
+  misses.insertRange(addr.getSpace(),addr.getOffset(),addr.getOffset());
+}
+
 void ScopeGhidra::addRange(AddrSpace *spc,uintb first,uintb last)
 
 {
@@ -256,12 +286,139 @@ void ScopeGhidra::clear(void)
 {
   cache->clear();
   holes.clear();
+  misses.clear();
+  labelholes.clear();
   if (cacheDirty) {
     ghidra->symboltab->setProperties(flagbaseDefault); // Restore database properties to defaults
     cacheDirty = false;
   }
 }
 
+/// Symbols from the Ghidra client are cached in \b cache and in the \e namespace Scopes built
+/// below \b this.  Function Scopes are not included.
+/// \param scope is the Scope to search below
+/// \param res will hold the \e namespace Scopes
+void ScopeGhidra::collectScopes(const Scope *scope,vector<Scope *> &res) const
+
+{
+  ScopeMap::const_iterator iter;
+  for(iter=scope->childrenBegin();iter!=scope->childrenEnd();++iter) {
+    Scope *child = (*iter).second;
+    if (child->getFuncdata() != (Funcdata *)0) continue;
+    res.push_back(child);
+    collectScopes(child,res);
+  }
+}
+
+/// Any cached Symbol with storage overlapping the range is removed, along with its
+/// Funcdata if it is a function.  The storage of each removed Symbol is passed back,
+/// as anything recorded about it is now out of date too.
+/// \param rng is the memory range
+/// \param affected will hold the storage of each removed Symbol
+void ScopeGhidra::removeOverlap(const Range &rng,vector<Range> &affected)
+
+{
+  vector<Scope *> scopes;
+  scopes.push_back(cache);
+  collectScopes(this,scopes);
+  for(int4 i=0;i<scopes.size();++i) {
+    Scope *scope = scopes[i];
+    vector<Symbol *> dead;
+    MapIterator iter,enditer;
+    enditer = scope->end();
+    for(iter=scope->begin();iter!=enditer;++iter) {
+      const SymbolEntry *entry = *iter;
+      if (entry->getAddr().getSpace() != rng.getSpace()) continue;
+      if (entry->getLast() < rng.getFirst() || entry->getFirst() > rng.getLast()) continue;
+      if (find(dead.begin(),dead.end(),entry->getSymbol()) == dead.end())
+	dead.push_back(entry->getSymbol());
+    }
+    for(int4 j=0;j<dead.size();++j) {
+      Symbol *sym = dead[j];
+      for(int4 k=0;k<sym->numEntries();++k) {
+	SymbolEntry *entry = sym->getMapEntry(k);
+	if (entry->isDynamic()) continue;
+	affected.push_back(Range(entry->getAddr().getSpace(),entry->getFirst(),entry->getLast()));
+      }
+      scope->removeSymbol(sym);
+    }
+  }
+}
+
+/// Negative query records over the range are removed, so the range is queried again, and any
+/// boolean properties laid down by earlier responses revert to their defaults.
+/// \param rng is the memory range
+void ScopeGhidra::forgetRange(const Range &rng)
+
+{
+  holes.removeRange(rng.getSpace(),rng.getFirst(),rng.getLast());
+  misses.removeRange(rng.getSpace(),rng.getFirst(),rng.getLast());
+  labelholes.removeRange(rng.getSpace(),rng.getFirst(),rng.getLast());
+  if (cacheDirty)
+    ghidra->symboltab->restorePropertyRange(flagbaseDefault,rng);
+}
+
+/// Everything learned from the Ghidra client about the range is dropped: Symbols overlapping
+/// it, negative query records, and memory properties.  The rest of the cache is untouched.
+/// The analysis of cached functions may depend on the range, so resetFunctions() should be
+/// called once all changes have been invalidated.
+/// \param rng is the memory range that changed
+void ScopeGhidra::invalidateRange(const Range &rng)
+
+{
+  vector<Range> affected;
+  removeOverlap(rng,affected);
+  forgetRange(rng);
+  for(int4 i=0;i<affected.size();++i)
+    forgetRange(affected[i]);
+}
+
+/// A Symbol that was renamed, retyped or deleted by the client is found by its (old) name, in the
+/// global Scope and any \e namespace Scope, and everything cached about its storage is dropped.
+/// \param nm is the name of the Symbol
+void ScopeGhidra::invalidateSymbol(const string &nm)
+
+{
+  vector<Scope *> scopes;
+  scopes.push_back(cache);
+  collectScopes(this,scopes);
+  vector<Range> storage;
+  for(int4 i=0;i<scopes.size();++i) {
+    vector<Symbol *> symList;
+    scopes[i]->queryByName(nm,symList);
+    for(int4 j=0;j<symList.size();++j) {
+      Symbol *sym = symList[j];
+      if (sym->getScope() != scopes[i]) continue;	// queryByName may search parent Scopes
+      for(int4 k=0;k<sym->numEntries();++k) {
+	SymbolEntry *entry = sym->getMapEntry(k);
+	if (entry->isDynamic()) continue;
+	storage.push_back(Range(entry->getAddr().getSpace(),entry->getFirst(),entry->getLast()));
+      }
+    }
+  }
+  for(int4 i=0;i<storage.size();++i)
+    invalidateRange(storage[i]);
+}
+
+/// Output for a function that has already been decompiled is sent again without redoing the
+/// analysis, so after an invalidation each cached function is cleared, and decompiles again
+/// the next time it is requested.  Symbols locked by the client's responses are kept.
+void ScopeGhidra::resetFunctions(void)
+
+{
+  vector<Scope *> scopes;
+  scopes.push_back(cache);
+  collectScopes(this,scopes);
+  for(int4 i=0;i<scopes.size();++i) {
+    ScopeMap::const_iterator iter;
+    for(iter=scopes[i]->childrenBegin();iter!=scopes[i]->childrenEnd();++iter) {
+      Funcdata *fd = (*iter).second->getFuncdata();
+      if (fd != (Funcdata *)0 && fd->isProcStarted())
+	fd->clear();
+    }
+  }
+}
+
 SymbolEntry *ScopeGhidra::findAddr(const Address &addr,
 					    const Address &usepoint) const
 {
@@ -271,9 +428,14 @@ SymbolEntry *ScopeGhidra::findAddr(const Address &addr,
     entry = cache->findContainer(addr,1,Address());
     if (entry != (SymbolEntry *)0)
       return (SymbolEntry *)0;	// Address is already queried, but symbol doesn't start at our address
+    if (isMiss(addr))
+      return (SymbolEntry *)0;
     Symbol *sym = removeQuery(addr); // Query server
-    if (sym != (Symbol *)0)
+    if (sym != (Symbol *)0) {
       entry = sym->getMapEntry(addr);
+      if (entry == (SymbolEntry *)0)
+	recordMiss(addr);
+    }
     // entry may be null for certain queries, ghidra may return symbol of size <8 with
     // address equal to START of function, even though the query was for an address INTERNAL to the function
   }
@@ -288,9 +450,14 @@ SymbolEntry *ScopeGhidra::findContainer(const Address &addr,int4 size,
   SymbolEntry *entry;
   entry = cache->findClosestFit(addr,size,usepoint);
   if (entry == (SymbolEntry *)0) {
+    if (isMiss(addr))
+      return (SymbolEntry *)0;
     Symbol *sym = removeQuery(addr);
-    if (sym != (Symbol *)0)
+    if (sym != (Symbol *)0) {
       entry = sym->getMapEntry(addr);
+      if (entry == (SymbolEntry *)0)
+	recordMiss(addr);
+    }
     // entry may be null for certain queries, ghidra may return symbol of size <8 with
     // address equal to START of function, even though the query was for an address INTERNAL to the function
   }
@@ -348,9 +515,16 @@ LabSymbol *ScopeGhidra::findCodeLabel(const Address &addr) const
     SymbolEntry *entry;
     entry = cache->findAddr(addr,Address());
     if (entry == (SymbolEntry *)0) {
+      if (labelholes.inRange(addr,1)) {	// Already queried, and there was no label
+	numavoided += 1;
+	return sym;
+      }
+      numqueries += 1;
       string symname = ghidra->getCodeLabel(addr);	// Do the remote query
       if (!symname.empty())
 	sym = cache->addCodeLabel(addr,symname);
+      else
+	labelholes.insertRange(addr.getSpace(),addr.getOffset(),addr.getOffset());
     }
   }
   return sym;
@@ -373,6 +547,7 @@ Funcdata *ScopeGhidra::resolveExternalRefFunction(ExternRefSymbol *sym) const
     // getExternalRefXML interface to recover the external function
     Document *doc;
     SymbolEntry *entry = sym->getFirstWholeMap();
+    numqueries += 1;
     doc = ghidra->getExternalRefXML(entry->getAddr());
     if (doc != (Document *)0) {
       FunctionSymbol *sym;
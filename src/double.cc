@@ -93,7 +93,7 @@ bool SplitVarnode::inHandHi(Varnode *h)
     if (op->code() == CPUI_SUBPIECE) {
       Varnode *w = op->getIn(0);
       if (op->getIn(1)->getOffset() != (uintb)(w->getSize()-h->getSize())) return false;
-      list<PcodeOp *>::const_iterator iter,enditer;
+      DescendList::const_iterator iter,enditer;
       iter = w->beginDescend();
       enditer = w->endDescend();
       while(iter != enditer) {
@@ -125,7 +125,7 @@ bool SplitVarnode::inHandLo(Varnode *l)
     if (op->code() == CPUI_SUBPIECE) {
       Varnode *w = op->getIn(0);
       if (op->getIn(1)->getOffset() != 0) return false;
-      list<PcodeOp *>::const_iterator iter,enditer;
+      DescendList::const_iterator iter,enditer;
       iter = w->beginDescend();
       enditer = w->endDescend();
       while(iter != enditer) {
@@ -156,7 +156,7 @@ bool SplitVarnode::inHandLoNoHi(Varnode *l)
   if (op->getIn(1)->getOffset() != 0) return false;
   Varnode *w = op->getIn(0);
 
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = w->beginDescend();
   enditer = w->endDescend();
   while(iter != enditer) {
@@ -178,7 +178,7 @@ bool SplitVarnode::inHandLoNoHi(Varnode *l)
 bool SplitVarnode::inHandHiOut(Varnode *h)
 
 { // Return true (and initialize -this-) if -h- is combined with a -lo- into an existing whole
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = h->beginDescend();
   enditer = h->endDescend();
   Varnode *lo = (Varnode *)0;
@@ -204,7 +204,7 @@ bool SplitVarnode::inHandHiOut(Varnode *h)
 bool SplitVarnode::inHandLoOut(Varnode *l)
 
 { // Return true (and initialize -this-) if -l- is combined with a -hi- into an existing whole
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = l->beginDescend();
   enditer = l->endDescend();
   Varnode *hi = (Varnode *)0;
@@ -347,7 +347,7 @@ bool SplitVarnode::findWholeBuiltFromPieces(void)
   // AFTER we need it.  We assume hi and lo are defined in the same basic block (or both inputs)
   if (hi==(Varnode *)0) return false;
   if (lo==(Varnode *)0) return false;
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = lo->beginDescend();
   enditer = lo->endDescend();
   PcodeOp *res = (PcodeOp *)0;
@@ -699,7 +699,7 @@ void SplitVarnode::wholeList(Varnode *w,vector<SplitVarnode> &splitvec)
   basic.hi = (Varnode *)0;
   basic.lo = (Varnode *)0;
   basic.wholesize = w->getSize();
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
 
   iter = basic.whole->beginDescend();
   enditer = basic.whole->endDescend();
@@ -730,7 +730,7 @@ void SplitVarnode::findCopies(const SplitVarnode &in,vector<SplitVarnode> &split
 
 { // Find copies from -in- pieces into another logical pair
   if (!in.hasBothPieces()) return;
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
 
   iter = in.getLo()->beginDescend();
   enditer = in.getLo()->endDescend();
@@ -744,7 +744,7 @@ void SplitVarnode::findCopies(const SplitVarnode &in,vector<SplitVarnode> &split
       addr = addr - (in.getHi()->getSize());
     else
       addr = addr + locpy->getSize();
-    list<PcodeOp *>::const_iterator iter2,enditer2;
+    DescendList::const_iterator iter2,enditer2;
     iter2 = in.getHi()->beginDescend();
     enditer2 = in.getHi()->endDescend();
     while(iter2 != enditer2) {
@@ -786,7 +786,7 @@ bool SplitVarnode::otherwiseEmpty(PcodeOp *branchop)
   Varnode *vn = branchop->getIn(1);
   if (vn->isWritten())
     otherop = vn->getDef();
-  list<PcodeOp *>::const_iterator iter,enditer;
+  PcodeOpList::const_iterator iter,enditer;
   iter = bl->beginOp();
   enditer = bl->endOp();
   while(iter != enditer) {
@@ -886,7 +886,7 @@ int4 SplitVarnode::applyRuleIn(SplitVarnode &in,Funcdata &data)
     vn = (i==0) ? in.getHi() : in.getLo();
     if (vn == (Varnode *)0) continue;
     bool workishi = (i==0);
-    list<PcodeOp *>::const_iterator iter,enditer;
+    DescendList::const_iterator iter,enditer;
     iter = vn->beginDescend();
     enditer = vn->endDescend();
     while(iter != enditer) {
@@ -1250,7 +1250,7 @@ bool AddForm::verify(Varnode *h,Varnode *l,PcodeOp *op)
       }
       if (!checkForCarry(zextop)) continue; // Calculate lo2 and negconst
 
-      list<PcodeOp *>::const_iterator iter2,enditer2;
+      DescendList::const_iterator iter2,enditer2;
       iter2 = lo1->beginDescend();
       enditer2 = lo1->endDescend();
       while(iter2 != enditer2) {
@@ -1305,7 +1305,7 @@ bool AddForm::applyRule(SplitVarnode &i,PcodeOp *op,bool workishi,Funcdata &data
 bool SubForm::verify(Varnode *h,Varnode *l,PcodeOp *op)
 
 {
-  list<PcodeOp *>::const_iterator iter2,enditer2;
+  DescendList::const_iterator iter2,enditer2;
   hi1 = h;
   lo1 = l;
   slot1 = op->getSlot(hi1);
@@ -1422,7 +1422,7 @@ int4 LogicalForm::findHiMatch(void)
   if (!vn2->isConstant()) {
     SplitVarnode in2;
     if (in2.inHandLo(vn2)) {	// If we already know what the other double precision input looks like
-      list<PcodeOp *>::const_iterator iter,enditer;
+      DescendList::const_iterator iter,enditer;
       iter = in2.getHi()->beginDescend();
       enditer = in2.getHi()->endDescend();
       while(iter != enditer) {
@@ -1439,7 +1439,7 @@ int4 LogicalForm::findHiMatch(void)
     return -1;
   }
   else {
-    list<PcodeOp *>::const_iterator iter,enditer;
+    DescendList::const_iterator iter,enditer;
     iter = hi1->beginDescend();
     enditer = hi1->endDescend();
     int4 count = 0;
@@ -1532,9 +1532,9 @@ bool Equal1Form::applyRule(SplitVarnode &i,PcodeOp *hop,bool workishi,Funcdata &
   hi2 = hiop->getIn(1-hi1slot);
   notequalformhi = (hiop->code() == CPUI_INT_NOTEQUAL);
 
-  list<PcodeOp *>::const_iterator iter,enditer;
-  list<PcodeOp *>::const_iterator iter2,enditer2;
-  list<PcodeOp *>::const_iterator iter3,enditer3;
+  DescendList::const_iterator iter,enditer;
+  DescendList::const_iterator iter2,enditer2;
+  DescendList::const_iterator iter3,enditer3;
   iter = lo1->beginDescend();
   enditer = lo1->endDescend();
   while(iter != enditer) {
@@ -1626,7 +1626,7 @@ bool Equal2Form::fillOutFromOr(Funcdata &data)
 { // We have filled in either or <- xor <- hi1,  OR,  or <- hi1
   // Now try to fill in the rest of the form
   Varnode *outvn = orop->getOut();
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = outvn->beginDescend();
   enditer = outvn->endDescend();
   while(iter != enditer) {
@@ -1711,7 +1711,7 @@ bool Equal2Form::applyRule(SplitVarnode &i,PcodeOp *op,bool workishi,Funcdata &d
     xorhislot = hixor->getSlot(hi1);
     hi2 = hixor->getIn(1-xorhislot);
     Varnode *vn = op->getOut();
-    list<PcodeOp *>::const_iterator iter,enditer;
+    DescendList::const_iterator iter,enditer;
     iter = vn->beginDescend();
     enditer = vn->endDescend();
     while(iter != enditer) {
@@ -2378,7 +2378,7 @@ bool ShiftForm::verifyLeft(Varnode *h,Varnode *l,PcodeOp *loop)
   loshift = loop;
   reslo = loshift->getOut();
   
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = hi->beginDescend();
   enditer = hi->endDescend();
   while(iter != enditer) {
@@ -2386,7 +2386,7 @@ bool ShiftForm::verifyLeft(Varnode *h,Varnode *l,PcodeOp *loop)
     ++iter;
     if (hishift->code() != CPUI_INT_LEFT) continue;
     Varnode *outvn = hishift->getOut();
-    list<PcodeOp *>::const_iterator iter2,enditer2;
+    DescendList::const_iterator iter2,enditer2;
     iter2 = outvn->beginDescend();
     enditer2 = outvn->endDescend();
     while(iter2 != enditer2) {
@@ -2411,7 +2411,7 @@ bool ShiftForm::verifyRight(Varnode *h,Varnode *l,PcodeOp *hiop)
   hishift = hiop;
   reshi = hiop->getOut();
   
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = lo->beginDescend();
   enditer = lo->endDescend();
   while(iter != enditer) {
@@ -2419,7 +2419,7 @@ bool ShiftForm::verifyRight(Varnode *h,Varnode *l,PcodeOp *hiop)
     ++iter;
     if (loshift->code() != CPUI_INT_RIGHT) continue;
     Varnode *outvn = loshift->getOut();
-    list<PcodeOp *>::const_iterator iter2,enditer2;
+    DescendList::const_iterator iter2,enditer2;
     iter2 = outvn->beginDescend();
     enditer2 = outvn->endDescend();
     while(iter2 != enditer2) {
@@ -2651,7 +2651,7 @@ bool MultForm::verifyLo(void)
 bool MultForm::findResLo(void)
 
 { // Assuming we found -midtmp-, find potential reslo
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = midtmp->beginDescend();
   enditer = midtmp->endDescend();
   while(iter != enditer) {
@@ -2722,14 +2722,14 @@ bool MultForm::verify(Varnode *h,Varnode *l,PcodeOp *hop)
 {
   hi1 = h;
   lo1 = l;
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = hop->getOut()->beginDescend();
   enditer = hop->getOut()->endDescend();
   while(iter != enditer) {
     add1 = *iter;
     ++iter;
     if (add1->code() != CPUI_INT_ADD) continue;
-    list<PcodeOp *>::const_iterator iter2,enditer2;
+    DescendList::const_iterator iter2,enditer2;
     iter2 = add1->getOut()->beginDescend();
     enditer2 = add1->getOut()->endDescend();
     while(iter2 != enditer2) {
@@ -2775,7 +2775,7 @@ bool PhiForm::verify(Varnode *h,Varnode *l,PcodeOp *hphi)
   if (hiphi->getOut()->hasNoDescend()) return false;
   blbase = hiphi->getParent();
 
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = lobase->beginDescend();
   enditer = lobase->endDescend();
   while(iter != enditer) {
@@ -2826,7 +2826,7 @@ bool IndirectForm::verify(Varnode *h,Varnode *l,PcodeOp *ind)
   reshi = indhi->getOut();
   if (reshi->getSpace()->getType() == IPTR_INTERNAL) return false;		// Indirect must not be through a temporary
 
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = lo->beginDescend();
   enditer = lo->endDescend();
   while(iter != enditer) {
@@ -2859,10 +2859,25 @@ bool IndirectForm::applyRule(SplitVarnode &i,PcodeOp *ind,bool workishi,Funcdata
   return true;
 }
 
+/// Splits are identified by the creation index of their Varnodes, so the key stays
+/// meaningful even if a Varnode is freed and its memory reused.
+/// \param in is the split being tried
+/// \return the key identifying the split
+pair<uint4,uint8> RuleDoubleIn::failureKey(const SplitVarnode &in)
+
+{
+  uint4 w = (in.getWhole() == (Varnode *)0) ? 0xffffffff : in.getWhole()->getCreateIndex();
+  uint8 l = (in.getLo() == (Varnode *)0) ? 0xffffffff : in.getLo()->getCreateIndex();
+  uint8 h = (in.getHi() == (Varnode *)0) ? 0xffffffff : in.getHi()->getCreateIndex();
+  return pair<uint4,uint8>(w,(l<<32)|h);
+}
+
 void RuleDoubleIn::reset(Funcdata &data)
 
 {
   data.setDoublePrecisRecovery(true); // Mark that we are doing double precision recovery
+  failed.clear();
+  failmodcount = data.getModificationCount();
 }
 
 void RuleDoubleIn::getOpList(vector<uint4> &oplist) const
@@ -2881,11 +2896,18 @@ int4 RuleDoubleIn::applyOp(PcodeOp *op,Funcdata &data)
   vector<SplitVarnode> splitvec;
   SplitVarnode::wholeList(op->getIn(0),splitvec);
   if (splitvec.empty()) return 0;
+  if (failmodcount != data.getModificationCount()) {
+    failed.clear();		// Data-flow has changed, so every split is worth trying again
+    failmodcount = data.getModificationCount();
+  }
   for(int4 i=0;i<splitvec.size();++i) {
     SplitVarnode &in(splitvec[i]);
+    pair<uint4,uint8> key = failureKey(in);
+    if (failed.find(key) != failed.end()) continue;	// No form matched, and nothing has changed since
     int4 res = SplitVarnode::applyRuleIn(in,data);
     if (res != 0)
       return res;
+    failed.insert(key);
   }
   return 0;
 }
@@ -2903,8 +2925,8 @@ PcodeOp *RuleDoubleLoad::noWriteConflict(PcodeOp *op1,PcodeOp *op2,AddrSpace *sp
     op2 = op1;
     op1 = tmp;
   }
-  list<PcodeOp *>::iterator iter = op1->getBasicIter();
-  list<PcodeOp *>::iterator enditer = op2->getBasicIter();
+  PcodeOpList::iterator iter = op1->getBasicIter();
+  PcodeOpList::iterator enditer = op2->getBasicIter();
 
   ++iter;
   while(iter != enditer) {
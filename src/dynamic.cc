@@ -103,6 +103,43 @@ uint4 ToOpEdge::hash(uint4 reg) const
   return reg;
 }
 
+/// If the function has changed since the entries were calculated, all entries are thrown
+/// away first.
+/// \param mod is the current modification count of the function
+/// \param vn is the Varnode being hashed
+/// \param method is the hash method
+/// \param h will hold the hash if it was found
+/// \param addr will hold the associated address if the hash was found
+/// \return \b true if the hash was previously calculated
+bool DynamicHashCache::find(uint4 mod,const Varnode *vn,uint4 method,uint8 &h,Address &addr)
+
+{
+  if (mod != modcount) {
+    entries.clear();
+    modcount = mod;
+    return false;
+  }
+  map<pair<uint4,uint4>,Entry>::const_iterator iter;
+  iter = entries.find(pair<uint4,uint4>(vn->getCreateIndex(),method));
+  if (iter == entries.end()) return false;
+  h = (*iter).second.hash;
+  addr = (*iter).second.addr;
+  return true;
+}
+
+/// The entry is valid for the modification count passed to the last call to find().
+/// \param vn is the Varnode that was hashed
+/// \param method is the hash method
+/// \param h is the calculated hash
+/// \param addr is the associated address
+void DynamicHashCache::insert(const Varnode *vn,uint4 method,uint8 h,const Address &addr)
+
+{
+  Entry &entry( entries[pair<uint4,uint4>(vn->getCreateIndex(),method)] );
+  entry.hash = h;
+  entry.addr = addr;
+}
+
 /// When building the edge, certain p-code ops (CAST) are effectively ignored so that
 /// we get the same hash whether or not these ops are present.
 /// \param vn is the given Varnode
@@ -125,7 +162,7 @@ void DynamicHash::buildVnUp(const Varnode *vn)
 void DynamicHash::buildVnDown(const Varnode *vn)
   
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   uint4 insize = opedge.size();
   
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter) {
@@ -315,6 +352,22 @@ void DynamicHash::calcHash(const Varnode *root,uint4 method)
   addrresult = op->getSeqNum().getAddr();
 }
 
+/// This produces the same hash and address as calcHash(), but the result is looked up in
+/// the hash cache of the function first, and stored there if it has to be calculated.
+/// \param root is the given root Varnode
+/// \param method is the hashing method to use: 0, 1, 2, 3
+/// \param fd is the function containing the Varnode
+void DynamicHash::calcHashCached(const Varnode *root,uint4 method,Funcdata *fd)
+
+{
+  DynamicHashCache &cache( fd->getHashCache() );
+  if (cache.find(fd->getModificationCount(),root,method,hash,addrresult))
+    return;
+  clear();
+  calcHash(root,method);
+  cache.insert(root,method,hash,addrresult);
+}
+
 /// Collect the set of Varnodes at the same address as the given Varnode.
 /// Starting with method 0, increment the method and calculate hashes
 /// of the Varnodes until the given Varnode has a unique hash within the set.
@@ -342,8 +395,7 @@ void DynamicHash::uniqueHash(const Varnode *root,Funcdata *fd)
   uint4 maxduplicates = 8;
 
   for(method=0;method<4;++method) {
-    clear();
-    calcHash(root,method);
+    calcHashCached(root,method,fd);
     if (hash == 0) return;	// Can't get a good hash
     tmphash = hash;
     tmpaddr = addrresult;
@@ -352,8 +404,7 @@ void DynamicHash::uniqueHash(const Varnode *root,Funcdata *fd)
     gatherFirstLevelVars(vnlist,fd,tmpaddr,tmphash);
     for(uint4 i=0;i<vnlist.size();++i) {
       Varnode *tmpvn = vnlist[i];
-      clear();
-      calcHash(tmpvn,method);
+      calcHashCached(tmpvn,method,fd);
       if (hash == tmphash) {	// Hash collision
 	vnlist2.push_back(tmpvn);
 	if (vnlist2.size()>maxduplicates) break;
@@ -408,8 +459,7 @@ Varnode *DynamicHash::findVarnode(Funcdata *fd,const Address &addr,uint8 h)
   gatherFirstLevelVars(vnlist,fd,addr,h);
   for(uint4 i=0;i<vnlist.size();++i) {
     Varnode *tmpvn = vnlist[i];
-    clear();
-    calcHash(tmpvn,method);
+    calcHashCached(tmpvn,method,fd);
     if (hash == h)
       vnlist2.push_back(tmpvn);
   }
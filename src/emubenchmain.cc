@@ -0,0 +1,313 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Emulation benchmark driver: run a raw image under the emulator and report throughput as CSV
+//
+//   emulator-benchmark [-s specdir] [-a base] [-e entry] [-n maxinsn] [-b stopaddr] [-r reg=value] [-t trace] [-c] [-x] language image
+//
+//   -s  adds a directory containing .ldefs/.sla files (may be repeated)
+//   -a  sets the address the first byte of the image is loaded at (default 0)
+//   -e  sets the address execution starts at (default is the load address)
+//   -n  sets the maximum number of instructions to execute (default 1000000)
+//   -b  stops execution when it reaches the address (may be repeated)
+//   -r  sets a register before execution starts (may be repeated)
+//   -t  records every value written by EmulatePcodeCache to a binary trace (see emulator-trace-dump)
+//   -c  counts the control-flow edges taken in an AFL style coverage map (shared if __AFL_SHM_ID is set)
+//   -x  also times the block compiling emulator (EmulateBlockCache) over the same path
+//
+// The language is a language id, like "x86:LE:32:default".  Execution uses EmulatePcodeCache,
+// stepping one p-code op at a time so that every op can be counted by opcode.  It stops after
+// the maximum number of instructions, at a stop address, or when an op can't be emulated.
+// The block emulator, if requested, starts from the same state and runs for the same number
+// of p-code ops. Records are written as (kind,image,name,value):
+//   - run: instructions, p-code ops, seconds, instructions/sec and ops/sec
+//   - opcode: number of ops executed with each opcode
+//   - block: the same totals for EmulateBlockCache
+
+#include <iostream>
+#include <iomanip>
+#include <cstdlib>
+#include <chrono>
+
+#include "libdecomp.hh"
+#include "raw_arch.hh"
+#include "emulate.hh"
+#include "emulateblock.hh"
+#include "emulatetrace.hh"
+#include "emulatecover.hh"
+
+using namespace GhidraDec;
+
+static void usage(void)
+
+{
+  cerr << "usage: emulator-benchmark [-s specdir] [-a base] [-e entry] [-n maxinsn] [-b stopaddr] [-r reg=value] [-t trace] [-c] [-x] language image" << endl;
+  exit(2);
+}
+
+/// \brief Parse an integer given in decimal, or in hex with a leading \e 0x
+///
+/// \param str is the string to parse
+/// \return the value
+static uintb parseValue(const string &str)
+
+{
+  istringstream s(str);
+  s.unsetf(ios::dec | ios::hex | ios::oct);
+  uintb val = 0;
+  s >> val;
+  if (!s || !s.eof()) {
+    cerr << "Bad number: " << str << endl;
+    exit(2);
+  }
+  return val;
+}
+
+/// \brief Breakpoint that halts the emulator
+class StopCallBack : public BreakCallBack {
+public:
+  virtual bool addressCallback(const Address &addr) { emulate->setHalt(true); return true; }
+};
+
+/// \brief The memory of a machine being emulated
+///
+/// RAM reads through to the load image, and writes go to an overlay, so every machine starts
+/// from the same image.  Registers are held in a flat array covering the register space,
+/// and temporaries in a hash overlay.
+class MachineState {
+  MemoryImage loadmemory;		///< Bytes of the load image
+  MemoryPageOverlay ramstate;		///< Writes to RAM
+  MemoryHashOverlay tmpstate;		///< Temporary values
+public:
+  MemoryState memstate;			///< The memory state handed to the emulator
+  MachineState(Architecture *glb,const vector<pair<string,uintb> > &regs);	///< Constructor
+};
+
+/// \param glb is the architecture of the image
+/// \param regs are the (name,value) pairs of registers to initialize
+MachineState::MachineState(Architecture *glb,const vector<pair<string,uintb> > &regs)
+  : loadmemory(glb->getDefaultSpace(),8,4096,glb->loader),
+    ramstate(glb->getDefaultSpace(),8,4096,&loadmemory),
+    tmpstate(glb->getUniqueSpace(),8,4096,4096,(MemoryBank *)0),
+    memstate((Translate *)glb->translate)
+{
+  memstate.setMemoryBank(&ramstate);
+  memstate.createRegisterBank(glb->getSpaceByName("register"),8,4096);
+  memstate.setMemoryBank(&tmpstate);
+  for(int4 i=0;i<regs.size();++i)
+    memstate.setValue(regs[i].first,regs[i].second);
+}
+
+/// \param kind is the kind of record
+/// \param image is the name of the image
+/// \param name is the name of the quantity
+/// \param value is the measured value
+static void record(const string &kind,const string &image,const string &name,double value)
+
+{
+  cout << kind << ',' << image << ',' << name << ',' << setprecision(10) << value << endl;
+}
+
+int main(int argc,char **argv)
+
+{
+  vector<string> extrapaths;
+  vector<uintb> stops;
+  vector<pair<string,uintb> > regs;
+  uintb base = 0;
+  uintb entry = 0;
+  bool hasentry = false;
+  uint8 maxinsn = 1000000;
+  bool blockengine = false;
+  bool cover = false;
+  string tracefile;
+  int4 i = 1;
+  while((i<argc)&&(argv[i][0]=='-')) {
+    char opt = argv[i][1];
+    if (opt == 'x' || opt == 'c') {
+      if (opt == 'x')
+	blockengine = true;
+      else
+	cover = true;
+      i += 1;
+      continue;
+    }
+    if (i+1 >= argc) usage();
+    string val(argv[i+1]);
+    if (opt == 's')
+      extrapaths.push_back(val);
+    else if (opt == 'a')
+      base = parseValue(val);
+    else if (opt == 'e') {
+      entry = parseValue(val);
+      hasentry = true;
+    }
+    else if (opt == 'n')
+      maxinsn = parseValue(val);
+    else if (opt == 'b')
+      stops.push_back(parseValue(val));
+    else if (opt == 't')
+      tracefile = val;
+    else if (opt == 'r') {
+      string::size_type pos = val.find('=');
+      if (pos == string::npos) usage();
+      regs.push_back(pair<string,uintb>(val.substr(0,pos),parseValue(val.substr(pos+1))));
+    }
+    else
+      usage();
+    i += 2;
+  }
+  if (i+2 != argc || maxinsn == 0)
+    usage();
+  string language(argv[i]);
+  string image(argv[i+1]);
+  if (!hasentry)
+    entry = base;
+
+  string ghidraroot = FileManage::discoverGhidraRoot(argv[0]);
+  if (ghidraroot.size() == 0) {
+    const char *sleighhomepath = getenv("SLEIGHHOME");
+    if (sleighhomepath != (const char *)0)
+      ghidraroot = sleighhomepath;
+    else if (extrapaths.empty()) {
+      cerr << "Could not discover root of Ghidra installation" << endl;
+      exit(1);
+    }
+  }
+  const char *indexpath = getenv("SLEIGHINDEX");
+  if (indexpath != (const char *)0)
+    SleighArchitecture::setIndexFile(indexpath);	// Reuse the last scan of the SLEIGH directories
+  startDecompilerLibrary(ghidraroot.c_str(),extrapaths);
+
+  int4 retval = 0;
+  ostringstream errs;
+  RawBinaryArchitecture *glb = new RawBinaryArchitecture(image,language,&errs);
+  try {
+    DocumentStorage store;
+    glb->init(store);
+    if (base != 0)
+      glb->loader->adjustVma(base);
+
+    Translate *trans = (Translate *)glb->translate;	// The emulators take a non-const translator
+    AddrSpace *spc = glb->getDefaultSpace();
+    StopCallBack stopcallback;
+    BreakTableCallBack breaktable(trans);
+    for(int4 j=0;j<stops.size();++j)
+      breaktable.registerAddressCallback(Address(spc,stops[j]),&stopcallback);
+
+    cout << "kind,image,name,value" << endl;
+    vector<uint8> opcount(CPUI_MAX,0);
+    uint8 numinsn = 0;
+    uint8 numops = 0;
+    string stopreason = "limit";
+    double seconds;
+    {
+      MachineState machine(glb,regs);
+      EmulatePcodeCache emulator(trans,&machine.memstate,&breaktable);
+      breaktable.setEmulate(&emulator);
+      emulator.setHalt(false);
+      EmulateTrace trace;
+      if (!tracefile.empty()) {
+	trace.open(tracefile,trans);
+	emulator.setTrace(&trace);
+      }
+      EdgeCoverage coverage;
+      if (cover) {
+	coverage.attachFromEnvironment();
+	emulator.setCoverage(&coverage);
+      }
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      try {
+	emulator.setExecuteAddress(Address(spc,entry));
+	// Same as executeInstruction(), but counting each op before it executes
+	while(numinsn < maxinsn) {
+	  if (breaktable.doAddressBreak(emulator.getExecuteAddress())) {
+	    stopreason = "breakpoint";
+	    break;
+	  }
+	  numinsn += 1;
+	  do {
+	    if (emulator.getCurrentOpIndex() < emulator.numCurrentOps()) {
+	      opcount[emulator.getOpByIndex(emulator.getCurrentOpIndex())->getOpcode()] += 1;
+	      numops += 1;
+	    }
+	    emulator.executeCurrentOp();
+	  } while(!emulator.isInstructionStart());
+	}
+      }
+      catch(LowlevelError &err) {
+	cerr << image << ": " << err.explain << endl;
+	stopreason = "error";
+      }
+      trace.close();		// Include the flush in the timing
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+      seconds = std::chrono::duration<double>(end - start).count();
+      if (!tracefile.empty())
+	record("run",image,"trace_records",trace.getNumRecords());
+      if (cover)
+	record("run",image,"edges",coverage.countEdges());
+    }
+    record("run",image,"stop_" + stopreason,1);
+    record("run",image,"instructions",numinsn);
+    record("run",image,"ops",numops);
+    record("run",image,"seconds",seconds);
+    if (seconds > 0.0) {
+      record("run",image,"instructions_per_sec",numinsn / seconds);
+      record("run",image,"ops_per_sec",numops / seconds);
+    }
+    for(int4 j=0;j<opcount.size();++j) {
+      if (opcount[j] != 0)
+	record("opcode",image,get_opname((OpCode)j),opcount[j]);
+    }
+
+    if (blockengine && numops != 0) {
+      MachineState machine(glb,regs);
+      EmulateBlockCache emulator(trans,&machine.memstate,&breaktable);
+      breaktable.setEmulate(&emulator);
+      emulator.setAddressBreaks(!stops.empty());
+      emulator.setHalt(false);
+      uint8 blockops = 0;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      try {
+	emulator.setExecuteAddress(Address(spc,entry));
+	blockops = emulator.run(numops);
+      }
+      catch(LowlevelError &err) {
+	cerr << image << ": " << err.explain << endl;
+      }
+      std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+      seconds = std::chrono::duration<double>(end - start).count();
+      record("block",image,"ops",blockops);
+      record("block",image,"blocks",emulator.numBlocks());
+      record("block",image,"seconds",seconds);
+      if (seconds > 0.0) {
+	record("block",image,"instructions_per_sec",numinsn / seconds);
+	record("block",image,"ops_per_sec",blockops / seconds);
+      }
+    }
+  }
+  catch(LowlevelError &err) {
+    cerr << image << ": " << err.explain << endl;
+    retval = 1;
+  }
+  catch(XmlError &err) {
+    cerr << "Could not load " << image << ": " << err.explain << endl;
+    retval = 1;
+  }
+  delete glb;
+
+  shutdownDecompilerLibrary();
+  return retval;
+}
@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 #include "emulate.hh"
+#include "emulatetrace.hh"
+#include "emulatecover.hh"
 
 namespace GhidraDec {
 /// Any time the emulator is about to execute a user-defined pcode op with the given name,
@@ -30,6 +32,9 @@ void BreakTableCallBack::registerPcodeCallback(const string &name,BreakCallBack
   for(int4 i=0;i<userops.size();++i) {
     if (userops[i] == name) {
       pcodecallback[(uintb)i] = func;
+      if (pcodeslot.size() <= i)
+	pcodeslot.resize(i+1,(BreakCallBack *)0);
+      pcodeslot[i] = func;
       return;
     }
   }
@@ -46,6 +51,36 @@ void BreakTableCallBack::registerAddressCallback(const Address &addr,BreakCallBa
 {
   func->setEmulate(emulate);
   addresscallback[addr] = func;
+  uint4 hash = hashAddress(addr);
+  addressfilter[hash >> 27] |= ((uint4)1) << ((hash >> 22) & 31);
+  if (2 * addresscallback.size() > addressslot.size()) {
+    rebuildAddressSlots();
+    return;
+  }
+  uint4 mask = addressslot.size() - 1;
+  uint4 pos = hash & mask;
+  while(addressslot[pos].second != (BreakCallBack *)0 && addressslot[pos].first != addr)
+    pos = (pos + 1) & mask;
+  addressslot[pos] = pair<Address,BreakCallBack *>(addr,func);
+}
+
+/// The table is sized to keep it at most half full, so probe sequences stay short.
+void BreakTableCallBack::rebuildAddressSlots(void)
+
+{
+  uint4 size = 16;
+  while(size < 2 * addresscallback.size())
+    size *= 2;
+  addressslot.clear();
+  addressslot.resize(size,pair<Address,BreakCallBack *>(Address(),(BreakCallBack *)0));
+  uint4 mask = size - 1;
+  map<Address,BreakCallBack *>::const_iterator iter;
+  for(iter=addresscallback.begin();iter!=addresscallback.end();++iter) {
+    uint4 pos = hashAddress((*iter).first) & mask;
+    while(addressslot[pos].second != (BreakCallBack *)0)
+      pos = (pos + 1) & mask;
+    addressslot[pos] = *iter;
+  }
 }
 
 /// This routine invokes the setEmulate method on each breakpoint currently in the table
@@ -74,11 +109,10 @@ bool BreakTableCallBack::doPcodeOpBreak(PcodeOpRaw *curop)
 
 {
   uintb val = curop->getInput(0)->offset;
-  map<uintb,BreakCallBack *>::const_iterator iter;
-
-  iter = pcodecallback.find(val);
-  if (iter == pcodecallback.end()) return false;
-  return (*iter).second->pcodeCallback(curop);
+  if (val >= pcodeslot.size()) return false;
+  BreakCallBack *func = pcodeslot[val];
+  if (func == (BreakCallBack *)0) return false;
+  return func->pcodeCallback(curop);
 }
 
 /// This routine examines the address based container for any breakpoints associated with the
@@ -88,11 +122,14 @@ bool BreakTableCallBack::doPcodeOpBreak(PcodeOpRaw *curop)
 bool BreakTableCallBack::doAddressBreak(const Address &addr)
 
 {
-  map<Address,BreakCallBack *>::const_iterator iter;
-  
-  iter = addresscallback.find(addr);
-  if (iter == addresscallback.end()) return false;
-  return (*iter).second->addressCallback(addr);
+  uint4 hash = hashAddress(addr);
+  if (!testFilter(hash)) return false;	// Quick rejection, no breakpoint hashes near this address
+  uint4 mask = addressslot.size() - 1;
+  for(uint4 pos=hash&mask;addressslot[pos].second!=(BreakCallBack *)0;pos=(pos+1)&mask) {
+    if (addressslot[pos].first == addr)
+      return addressslot[pos].second->addressCallback(addr);
+  }
+  return false;
 }
 
 /// Provide the emitter with the containers that will hold the cached p-code ops and varnodes.
@@ -214,13 +251,27 @@ void Emulate::executeCurrentOp(void)
   }
 }
 
+/// \param spc is the address space written to
+/// \param off is the offset written to
+/// \param size is the number of bytes written
+/// \param val is the value written
+void EmulateMemory::traceWrite(AddrSpace *spc,uintb off,int4 size,uintb val)
+
+{
+  const SeqNum &seq(currentOp->getSeqNum());
+  trace->record(seq.getAddr(),seq.getTime(),spc,off,size,val);
+}
+
 void EmulateMemory::executeUnary(void)
 
 {
   uintb in1 = memstate->getValue(currentOp->getInput(0));
-  uintb out = currentBehave->evaluateUnary(currentOp->getOutput()->size,
+  const VarnodeData *outvn = currentOp->getOutput();
+  uintb out = currentBehave->evaluateUnary(outvn->size,
 					   currentOp->getInput(0)->size,in1);
-  memstate->setValue(currentOp->getOutput(),out);
+  memstate->setValue(outvn,out);
+  if (trace != (EmulateTrace *)0)
+    traceWrite(outvn->space,outvn->offset,outvn->size,out);
 }
 
 void EmulateMemory::executeBinary(void)
@@ -228,9 +279,12 @@ void EmulateMemory::executeBinary(void)
 {
   uintb in1 = memstate->getValue(currentOp->getInput(0));
   uintb in2 = memstate->getValue(currentOp->getInput(1));
-  uintb out = currentBehave->evaluateBinary(currentOp->getOutput()->size,
+  const VarnodeData *outvn = currentOp->getOutput();
+  uintb out = currentBehave->evaluateBinary(outvn->size,
 					    currentOp->getInput(0)->size,in1,in2);
-  memstate->setValue(currentOp->getOutput(),out);
+  memstate->setValue(outvn,out);
+  if (trace != (EmulateTrace *)0)
+    traceWrite(outvn->space,outvn->offset,outvn->size,out);
 }
 
 void EmulateMemory::executeLoad(void)
@@ -240,8 +294,11 @@ void EmulateMemory::executeLoad(void)
   AddrSpace *spc = Address::getSpaceFromConst(currentOp->getInput(0)->getAddr());
 
   off = AddrSpace::addressToByte(off,spc->getWordSize());
-  uintb res = memstate->getValue(spc,off,currentOp->getOutput()->size);
-  memstate->setValue(currentOp->getOutput(),res);
+  const VarnodeData *outvn = currentOp->getOutput();
+  uintb res = memstate->getValue(spc,off,outvn->size);
+  memstate->setValue(outvn,res);
+  if (trace != (EmulateTrace *)0)
+    traceWrite(outvn->space,outvn->offset,outvn->size,res);
 }
 
 void EmulateMemory::executeStore(void)
@@ -253,18 +310,25 @@ void EmulateMemory::executeStore(void)
 
   off = AddrSpace::addressToByte(off,spc->getWordSize());
   memstate->setValue(spc,off,currentOp->getInput(2)->size,val);
+  if (trace != (EmulateTrace *)0)
+    traceWrite(spc,off,currentOp->getInput(2)->size,val);
 }
 
 void EmulateMemory::executeBranch(void)
 
 {
-  setExecuteAddress(currentOp->getInput(0)->getAddr());
+  const Address &destaddr( currentOp->getInput(0)->getAddr() );
+  if (coverage != (EdgeCoverage *)0)
+    coverage->visit(destaddr.getOffset());
+  setExecuteAddress(destaddr);
 }
 
 bool EmulateMemory::executeCbranch(void)
 
 {
   uintb cond = memstate->getValue(currentOp->getInput(1));
+  if (cond == 0 && coverage != (EdgeCoverage *)0)
+    condfall = true;
   return (cond != 0);
 }
 
@@ -272,19 +336,26 @@ void EmulateMemory::executeBranchind(void)
 
 {
   uintb off = memstate->getValue(currentOp->getInput(0));
+  if (coverage != (EdgeCoverage *)0)
+    coverage->visit(off);
   setExecuteAddress(Address(currentOp->getAddr().getSpace(),off));
 }
 
 void EmulateMemory::executeCall(void)
 
 {
-  setExecuteAddress(currentOp->getInput(0)->getAddr());
+  const Address &destaddr( currentOp->getInput(0)->getAddr() );
+  if (coverage != (EdgeCoverage *)0)
+    coverage->visit(destaddr.getOffset());
+  setExecuteAddress(destaddr);
 }
 
 void EmulateMemory::executeCallind(void)
 
 {
   uintb off = memstate->getValue(currentOp->getInput(0));
+  if (coverage != (EdgeCoverage *)0)
+    coverage->visit(off);
   setExecuteAddress(Address(currentOp->getAddr().getSpace(),off));
 }
 
@@ -366,6 +437,7 @@ void EmulatePcodeCache::createInstruction(const Address &addr)
 
 {
   clearCache();
+  condfall = false;
   PcodeEmitCache emit(opcache,varcache,inst,0);
   instruction_length = trans->oneInstruction(emit,addr);
   current_op = 0;
@@ -394,6 +466,8 @@ void EmulatePcodeCache::fallthruOp(void)
   current_op += 1;
   if (current_op >= opcache.size()) {
     current_address = current_address + instruction_length;
+    if (condfall)		// Count the not-taken edge of a CBRANCH
+      coverage->visit(current_address.getOffset());
     createInstruction(current_address);
   }
   establishOp();
@@ -413,8 +487,11 @@ void EmulatePcodeCache::executeBranch(void)
     else if ((current_op < 0)||(current_op >= opcache.size()))
       throw LowlevelError("Bad intra-instruction branch");
   }
-  else
+  else {
+    if (coverage != (EdgeCoverage *)0)
+      coverage->visit(destaddr.getOffset());
     setExecuteAddress(destaddr);
+  }
 }
 
 /// Look for a breakpoint for the given user-defined op and invoke it.
@@ -0,0 +1,890 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "emulateblock.hh"
+
+#include <cstring>
+
+namespace GhidraDec {
+
+EmulateBlockCache::Block::~Block(void)
+
+{
+  for(int4 i=0;i<ops.size();++i)
+    delete ops[i];
+  for(int4 i=0;i<vars.size();++i)
+    delete vars[i];
+}
+
+/// \param t is the SLEIGH translator
+/// \param s is the MemoryState the emulator should manipulate
+/// \param b is the table of breakpoints the emulator should invoke
+EmulateBlockCache::EmulateBlockCache(Translate *t,MemoryState *s,BreakTable *b)
+  : EmulateMemory(s)
+{
+  trans = t;
+  OpBehavior::registerInstructions(inst,t);
+  breaktable = b;
+  breaktable->setEmulate(this);
+  uniqspace = trans->getUniqueSpace();
+  tempbigendian = (uniqspace != (AddrSpace *)0) ? uniqspace->isBigEndian() : false;
+  addressbreaks = true;
+  redirected = false;
+  pendinglink = (Block **)0;
+  runsdirty = false;
+  setupRegisterFile();
+}
+
+EmulateBlockCache::~EmulateBlockCache(void)
+
+{
+  clearCache();
+  for(int4 i=0;i<inst.size();++i) {
+    OpBehavior *t_op = inst[i];
+    if (t_op != (OpBehavior *)0)
+      delete t_op;
+  }
+}
+
+/// The register file covers the space holding the most registers, from offset 0 up to the end of
+/// the highest register in it.  If that would be unreasonably large, there is no register file and
+/// registers are accessed through the MemoryState like any other storage.
+void EmulateBlockCache::setupRegisterFile(void)
+
+{
+  map<VarnodeData,string> reglist;
+  map<AddrSpace *,int4> count;
+  map<AddrSpace *,uintb> extent;
+  trans->getAllRegisters(reglist);
+  map<VarnodeData,string>::const_iterator iter;
+  for(iter=reglist.begin();iter!=reglist.end();++iter) {
+    const VarnodeData &vn( (*iter).first );
+    count[vn.space] += 1;
+    uintb end = vn.offset + vn.size;
+    if (end > extent[vn.space])
+      extent[vn.space] = end;
+  }
+  regspace = (AddrSpace *)0;
+  int4 best = 0;
+  map<AddrSpace *,int4>::const_iterator citer;
+  for(citer=count.begin();citer!=count.end();++citer) {
+    if ((*citer).second > best) {
+      best = (*citer).second;
+      regspace = (*citer).first;
+    }
+  }
+  if (regspace == (AddrSpace *)0 || extent[regspace] > 0x100000) {
+    regspace = (AddrSpace *)0;
+    regbigendian = false;
+    return;
+  }
+  regbigendian = regspace->isBigEndian();
+  regfile.assign(extent[regspace],0);
+  regvalid.assign(extent[regspace],0);
+}
+
+/// Any bytes of the range not already held are read from the MemoryState.
+/// \param off is the starting offset of the range in the register space
+/// \param size is the number of bytes in the range
+void EmulateBlockCache::makeValid(uintb off,int4 size)
+
+{
+  for(int4 i=0;i<size;++i) {
+    if (regvalid[off+i] != 0) continue;
+    int4 j = i;
+    while(j < size && regvalid[off+j] == 0) {
+      regvalid[off+j] = 1;
+      j += 1;
+    }
+    memstate->getChunk(&regfile[off+i],regspace,off+i,j-i);
+    runsdirty = true;
+    i = j;
+  }
+}
+
+void EmulateBlockCache::buildRuns(void)
+
+{
+  validruns.clear();
+  int4 i = 0;
+  int4 sz = regvalid.size();
+  while(i < sz) {
+    if (regvalid[i] == 0) {
+      i += 1;
+      continue;
+    }
+    int4 j = i;
+    while(j < sz && regvalid[j] != 0)
+      j += 1;
+    validruns.push_back(pair<int4,int4>(i,j-i));
+    i = j;
+  }
+  runsdirty = false;
+}
+
+void EmulateBlockCache::loadRegisters(void)
+
+{
+  if (runsdirty) buildRuns();
+  for(int4 i=0;i<validruns.size();++i)
+    memstate->getChunk(&regfile[validruns[i].first],regspace,validruns[i].first,validruns[i].second);
+}
+
+void EmulateBlockCache::storeRegisters(void)
+
+{
+  if (runsdirty) buildRuns();
+  for(int4 i=0;i<validruns.size();++i)
+    memstate->setChunk(&regfile[validruns[i].first],regspace,validruns[i].first,validruns[i].second);
+}
+
+/// \param ptr points to the bytes of the value
+/// \param size is the number of bytes
+/// \param bigendian is \b true if the bytes are in big endian order
+/// \return the value
+uintb EmulateBlockCache::readBytes(const uint1 *ptr,int4 size,bool bigendian)
+
+{
+  if (size > (int4)sizeof(uintb)) {	// Keep only the least significant bytes
+    if (bigendian)
+      ptr += size - sizeof(uintb);
+    size = sizeof(uintb);
+  }
+  uintb res = 0;
+#if HOST_ENDIAN == 0
+  if (!bigendian) {
+    switch(size) {
+    case 1:
+      return *ptr;
+    case 2:
+      { uint2 v; memcpy(&v,ptr,2); return v; }
+    case 4:
+      { uint4 v; memcpy(&v,ptr,4); return v; }
+    case 8:
+      { uint8 v; memcpy(&v,ptr,8); return v; }
+    }
+  }
+#endif
+  if (bigendian) {
+    for(int4 i=0;i<size;++i)
+      res = (res << 8) | ptr[i];
+  }
+  else {
+    for(int4 i=size-1;i>=0;--i)
+      res = (res << 8) | ptr[i];
+  }
+  return res;
+}
+
+/// \param ptr points to the bytes to write
+/// \param size is the number of bytes
+/// \param bigendian is \b true if the bytes are in big endian order
+/// \param val is the value to write
+void EmulateBlockCache::writeBytes(uint1 *ptr,int4 size,bool bigendian,uintb val)
+
+{
+  if (size > (int4)sizeof(uintb)) {	// Zero extend into the extra bytes
+    int4 extra = size - sizeof(uintb);
+    if (bigendian) {
+      memset(ptr,0,extra);
+      ptr += extra;
+    }
+    else
+      memset(ptr + sizeof(uintb),0,extra);
+    size = sizeof(uintb);
+  }
+#if HOST_ENDIAN == 0
+  if (!bigendian) {
+    switch(size) {
+    case 1:
+      *ptr = (uint1)val;
+      return;
+    case 2:
+      { uint2 v = (uint2)val; memcpy(ptr,&v,2); return; }
+    case 4:
+      { uint4 v = (uint4)val; memcpy(ptr,&v,4); return; }
+    case 8:
+      { uint8 v = (uint8)val; memcpy(ptr,&v,8); return; }
+    }
+  }
+#endif
+  if (bigendian) {
+    for(int4 i=size-1;i>=0;--i) {
+      ptr[i] = (uint1)val;
+      val >>= 8;
+    }
+  }
+  else {
+    for(int4 i=0;i<size;++i) {
+      ptr[i] = (uint1)val;
+      val >>= 8;
+    }
+  }
+}
+
+/// \param op is the operand
+/// \return the value of the operand
+inline uintb EmulateBlockCache::getOperand(const Operand &op) const
+
+{
+  switch(op.kind) {
+  case operand_register:
+    return readBytes(&regfile[op.offset],op.size,regbigendian);
+  case operand_temp:
+    return readBytes(&tempfile[op.offset],op.size,tempbigendian);
+  case operand_constant:
+    return op.offset;
+  default:
+    break;
+  }
+  return memstate->getValue(op.space,op.offset,op.size);
+}
+
+/// \param op is the operand
+/// \param val is the value to write
+inline void EmulateBlockCache::setOperand(const Operand &op,uintb val)
+
+{
+  switch(op.kind) {
+  case operand_register:
+    writeBytes(&regfile[op.offset],op.size,regbigendian,val);
+    return;
+  case operand_temp:
+    writeBytes(&tempfile[op.offset],op.size,tempbigendian,val);
+    return;
+  default:
+    break;
+  }
+  memstate->setValue(op.space,op.offset,op.size,val);
+}
+
+/// \param spc is the space being loaded from
+/// \param off is the (word) offset being loaded from
+/// \param size is the number of bytes to load
+/// \return the loaded value
+uintb EmulateBlockCache::loadValue(AddrSpace *spc,uintb off,int4 size)
+
+{
+  off = AddrSpace::addressToByte(off,spc->getWordSize());
+  if (spc == regspace && off + size <= regfile.size() && off + size > off) {
+    makeValid(off,size);
+    return readBytes(&regfile[off],size,regbigendian);
+  }
+  return memstate->getValue(spc,off,size);
+}
+
+/// \param spc is the space being stored to
+/// \param off is the (word) offset being stored to
+/// \param size is the number of bytes to store
+/// \param val is the value to store
+void EmulateBlockCache::storeValue(AddrSpace *spc,uintb off,int4 size,uintb val)
+
+{
+  off = AddrSpace::addressToByte(off,spc->getWordSize());
+  if (spc == regspace && off + size <= regfile.size() && off + size > off) {
+    makeValid(off,size);
+    writeBytes(&regfile[off],size,regbigendian,val);
+    return;
+  }
+  memstate->setValue(spc,off,size,val);
+}
+
+/// \param vn is the raw varnode
+/// \param res will hold the compiled operand
+/// \param temps maps the temporaries of the block to the scratch file, as (offset,scratch offset) pairs
+void EmulateBlockCache::compileOperand(const VarnodeData *vn,Operand &res,const vector<pair<uintb,uintb> > &temps)
+
+{
+  res.size = vn->size;
+  res.space = vn->space;
+  res.offset = vn->offset;
+  if (vn->space->getType() == IPTR_CONSTANT)
+    res.kind = operand_constant;
+  else if (vn->space == uniqspace) {
+    vector<pair<uintb,uintb> >::const_iterator iter;
+    iter = upper_bound(temps.begin(),temps.end(),pair<uintb,uintb>(vn->offset,~((uintb)0)));
+    --iter;			// Interval holding the temporary
+    res.kind = operand_temp;
+    res.offset = (*iter).second + (vn->offset - (*iter).first);
+  }
+  else if (vn->space == regspace && vn->offset + vn->size <= regfile.size()) {
+    res.kind = operand_register;
+    makeValid(vn->offset,vn->size);
+  }
+  else
+    res.kind = operand_memory;
+}
+
+/// \param op is the raw p-code op
+/// \param res will hold the compiled operation
+/// \param temps maps the temporaries of the block to the scratch file
+void EmulateBlockCache::compileOp(PcodeOpRaw *op,Instr &res,const vector<pair<uintb,uintb> > &temps)
+
+{
+  res.raw = op;
+  res.behave = op->getBehavior();
+  res.target = -1;
+  res.link = (Block *)0;
+  res.fold = (ConstantFold::Kernel)0;
+  res.out.kind = operand_constant;
+  res.out.size = 0;
+  res.out.offset = 0;
+  res.out.space = (AddrSpace *)0;
+  if (op->getOutput() != (VarnodeData *)0)
+    compileOperand(op->getOutput(),res.out,temps);
+  int4 numin = op->numInput();
+  for(int4 i=0;i<3;++i) {
+    if (i < numin)
+      compileOperand(op->getInput(i),res.in[i],temps);
+    else {
+      res.in[i].kind = operand_constant;
+      res.in[i].size = 0;
+      res.in[i].offset = 0;
+      res.in[i].space = (AddrSpace *)0;
+    }
+  }
+  if (res.behave == (OpBehavior *)0) {
+    res.code = code_nop;
+    return;
+  }
+  switch(res.behave->getOpcode()) {
+  case CPUI_COPY:		res.code = code_copy; break;
+  case CPUI_LOAD:
+  case CPUI_STORE:
+    res.code = (res.behave->getOpcode() == CPUI_LOAD) ? code_load : code_store;
+    res.in[0].space = Address::getSpaceFromConst(op->getInput(0)->getAddr());
+    break;
+  case CPUI_BRANCH:
+  case CPUI_CALL:
+    res.code = code_branch;
+    res.dest = op->getInput(0)->getAddr();
+    break;
+  case CPUI_CBRANCH:
+    res.code = code_cbranch;
+    res.dest = op->getInput(0)->getAddr();
+    break;
+  case CPUI_BRANCHIND:
+  case CPUI_CALLIND:
+  case CPUI_RETURN:
+    res.code = code_branchind;
+    res.dest = op->getAddr();
+    break;
+  case CPUI_CALLOTHER:		res.code = code_callother; break;
+  case CPUI_INT_EQUAL:		res.code = code_equal; break;
+  case CPUI_INT_NOTEQUAL:	res.code = code_notequal; break;
+  case CPUI_INT_SLESS:		res.code = code_sless; break;
+  case CPUI_INT_SLESSEQUAL:	res.code = code_slessequal; break;
+  case CPUI_INT_LESS:		res.code = code_less; break;
+  case CPUI_INT_LESSEQUAL:	res.code = code_lessequal; break;
+  case CPUI_INT_ZEXT:		res.code = code_zext; break;
+  case CPUI_INT_SEXT:		res.code = code_sext; break;
+  case CPUI_INT_ADD:		res.code = code_add; break;
+  case CPUI_INT_SUB:		res.code = code_sub; break;
+  case CPUI_INT_CARRY:		res.code = code_carry; break;
+  case CPUI_INT_SCARRY:		res.code = code_scarry; break;
+  case CPUI_INT_SBORROW:	res.code = code_sborrow; break;
+  case CPUI_INT_2COMP:		res.code = code_2comp; break;
+  case CPUI_INT_NEGATE:		res.code = code_negate; break;
+  case CPUI_INT_XOR:
+  case CPUI_BOOL_XOR:		res.code = code_xor; break;
+  case CPUI_INT_AND:
+  case CPUI_BOOL_AND:		res.code = code_and; break;
+  case CPUI_INT_OR:
+  case CPUI_BOOL_OR:		res.code = code_or; break;
+  case CPUI_INT_LEFT:		res.code = code_left; break;
+  case CPUI_INT_RIGHT:		res.code = code_right; break;
+  case CPUI_INT_SRIGHT:		res.code = code_sright; break;
+  case CPUI_INT_MULT:		res.code = code_mult; break;
+  case CPUI_BOOL_NEGATE:	res.code = code_boolnegate; break;
+  case CPUI_PIECE:		res.code = code_piece; break;
+  case CPUI_SUBPIECE:		res.code = code_subpiece; break;
+  case CPUI_MULTIEQUAL:
+  case CPUI_INDIRECT:
+  case CPUI_SEGMENTOP:
+  case CPUI_CPOOLREF:
+  case CPUI_NEW:
+    res.code = code_unsupported;
+    break;
+  default:
+    if (res.behave->isSpecial())
+      res.code = code_unsupported;
+    else {
+      res.fold = ConstantFold::getKernel(res.behave->getOpcode(),res.in[0].size);
+      if (res.fold != (ConstantFold::Kernel)0)
+	res.code = code_fold;
+      else
+	res.code = res.behave->isUnary() ? code_unary : code_binary;
+    }
+    break;
+  }
+}
+
+/// Instructions are translated up to and including the first one whose p-code leaves the block
+/// (a branch, call, or return to somewhere other than within the instruction itself).  Temporaries
+/// are packed into the scratch file, and branches within an instruction are resolved to indices
+/// into the block.
+/// \param addr is the starting address of the block
+/// \return the compiled block
+EmulateBlockCache::Block *EmulateBlockCache::buildBlock(const Address &addr)
+
+{
+  Block *bl = new Block();
+  bl->start = addr;
+  bl->fallthrulink = (Block *)0;
+  vector<int4> instrstart;	// Index of the first raw op of each instruction
+  vector<Address> instraddr;	// Address of each instruction
+  Address cur = addr;
+  try {
+    for(int4 count=0;;) {
+      instrstart.push_back(bl->ops.size());
+      instraddr.push_back(cur);
+      PcodeEmitCache emit(bl->ops,bl->vars,inst,0);
+      int4 len = trans->oneInstruction(emit,cur);
+      bool leaves = false;
+      for(int4 i=instrstart.back();i<bl->ops.size();++i) {
+	OpCode opc = bl->ops[i]->getOpcode();
+	if (opc == CPUI_BRANCH || opc == CPUI_CBRANCH) {
+	  if (!bl->ops[i]->getInput(0)->getAddr().isConstant())
+	    leaves = true;
+	}
+	else if (opc == CPUI_BRANCHIND || opc == CPUI_CALL || opc == CPUI_CALLIND || opc == CPUI_RETURN)
+	  leaves = true;
+      }
+      cur = cur + len;
+      count += 1;
+      if (leaves || count >= maxblockinstr) break;
+    }
+  }
+  catch(LowlevelError &err) {
+    if (instrstart.size() == 1) {	// Can't decode even the first instruction
+      delete bl;
+      throw;
+    }
+    // Stop the block before the bad instruction, so the error is raised only if it is reached
+    for(int4 i=instrstart.back();i<bl->ops.size();++i)
+      delete bl->ops[i];
+    bl->ops.resize(instrstart.back());
+    cur = instraddr.back();
+    instrstart.pop_back();
+    instraddr.pop_back();
+  }
+  bl->fallthru = cur;
+  instrstart.push_back(bl->ops.size());
+
+  vector<pair<uintb,uintb> > ranges;	// (start,end) of each temporary
+  for(int4 i=0;i<bl->ops.size();++i) {
+    PcodeOpRaw *op = bl->ops[i];
+    if (op->getOutput() != (VarnodeData *)0 && op->getOutput()->space == uniqspace)
+      ranges.push_back(pair<uintb,uintb>(op->getOutput()->offset,op->getOutput()->offset + op->getOutput()->size));
+    for(int4 j=0;j<op->numInput();++j) {
+      const VarnodeData *vn = op->getInput(j);
+      if (vn->space == uniqspace)
+	ranges.push_back(pair<uintb,uintb>(vn->offset,vn->offset + vn->size));
+    }
+  }
+  sort(ranges.begin(),ranges.end());
+  vector<pair<uintb,uintb> > temps;	// (start,scratch offset) of each group of overlapping temporaries
+  uintb base = 0;
+  for(int4 i=0;i<ranges.size();) {
+    uintb start = ranges[i].first;
+    uintb end = ranges[i].second;
+    for(++i;i<ranges.size() && ranges[i].first < end;++i) {
+      if (ranges[i].second > end)
+	end = ranges[i].second;
+    }
+    temps.push_back(pair<uintb,uintb>(start,base));
+    base += end - start;
+  }
+  if (base > tempfile.size())
+    tempfile.resize(base,0);
+
+  for(int4 j=0;j+1<instrstart.size();++j) {
+    int4 first = instrstart[j];
+    int4 numops = instrstart[j+1] - first;
+    if (addressbreaks) {
+      bl->code.emplace_back();
+      Instr &brk( bl->code.back() );
+      brk.code = code_addrbreak;
+      brk.behave = (OpBehavior *)0;
+      brk.raw = (PcodeOpRaw *)0;
+      brk.link = (Block *)0;
+      brk.target = -1;
+      brk.dest = instraddr[j];
+    }
+    int4 codebase = bl->code.size();
+    for(int4 k=0;k<numops;++k) {
+      bl->code.emplace_back();
+      Instr &ins( bl->code.back() );
+      compileOp(bl->ops[first+k],ins,temps);
+      if ((ins.code == code_branch || ins.code == code_cbranch) && ins.dest.isConstant()) {
+	int4 dest = k + (int4)(uintm)ins.dest.getOffset();	// Relative to the current op
+	if (dest < 0 || dest > numops)
+	  throw LowlevelError("Bad intra-instruction branch");
+	ins.code = (ins.code == code_branch) ? code_relbranch : code_relcbranch;
+	ins.target = codebase + dest;	// The end of the instruction is the start of the next
+      }
+    }
+  }
+  return bl;
+}
+
+/// \param addr is the starting address of the block
+/// \return the compiled block
+EmulateBlockCache::Block *EmulateBlockCache::findBlock(const Address &addr)
+
+{
+  map<AddressKey,Block *>::const_iterator iter = blocks.find(AddressKey(addr));
+  if (iter != blocks.end())
+    return (*iter).second;
+  Block *bl = buildBlock(addr);
+  blocks[AddressKey(addr)] = bl;
+  return bl;
+}
+
+/// Register values are written back to the MemoryState for the breakpoint, along with any
+/// temporaries among the operands (if the MemoryState has a bank for temporaries), and then read
+/// back again afterward.
+/// \param ins is the compiled CALLOTHER
+/// \return \b true if the breakpoint changed the execution address
+bool EmulateBlockCache::callOther(const Instr &ins)
+
+{
+  PcodeOpRaw *op = ins.raw;
+  bool temps = (uniqspace != (AddrSpace *)0 && memstate->getMemoryBank(uniqspace) != (MemoryBank *)0);
+  storeRegisters();
+  if (temps) {
+    for(int4 i=0;i<op->numInput() && i<3;++i) {
+      if (ins.in[i].kind == operand_temp)
+	memstate->setValue(op->getInput(i),getOperand(ins.in[i]));
+    }
+  }
+  redirected = false;
+  if (!breaktable->doPcodeOpBreak(op))
+    throw LowlevelError("Userop not hooked");
+  loadRegisters();
+  if (temps && op->getOutput() != (VarnodeData *)0 && ins.out.kind == operand_temp)
+    setOperand(ins.out,memstate->getValue(op->getOutput()));
+  return redirected;
+}
+
+/// \param addr is the address of the instruction about to execute
+/// \return \b true if a breakpoint replaced the instruction or changed the execution address
+bool EmulateBlockCache::addressBreak(const Address &addr)
+
+{
+  current_address = addr;
+  redirected = false;
+  storeRegisters();
+  bool res = breaktable->doAddressBreak(addr);
+  loadRegisters();
+  return res || redirected;
+}
+
+/// \param bl is the block
+/// \return the block to execute next, or null if it must be looked up at \b current_address
+EmulateBlockCache::Block *EmulateBlockCache::executeBlock(Block *bl)
+
+{
+  const Instr *ip = bl->code.data();
+  const Instr *end = ip + bl->code.size();
+  const Instr *exitop = (const Instr *)0;
+  uintb in1,in2,mask;
+
+  if (ip == end) goto fallthru;
+  try {
+#if defined(__GNUC__)
+    static const void *dispatch[code_max] = {
+      &&lab_nop, &&lab_copy, &&lab_load, &&lab_store, &&lab_branch, &&lab_cbranch, &&lab_relbranch,
+      &&lab_relcbranch, &&lab_branchind, &&lab_callother, &&lab_addrbreak, &&lab_equal, &&lab_notequal,
+      &&lab_sless, &&lab_slessequal, &&lab_less, &&lab_lessequal, &&lab_zext, &&lab_sext, &&lab_add,
+      &&lab_sub, &&lab_carry, &&lab_scarry, &&lab_sborrow, &&lab_2comp, &&lab_negate, &&lab_xor,
+      &&lab_and, &&lab_or, &&lab_left, &&lab_right, &&lab_sright, &&lab_mult, &&lab_boolnegate,
+      &&lab_piece, &&lab_subpiece, &&lab_fold, &&lab_unary, &&lab_binary, &&lab_unsupported
+    };
+#define EMU_CASE(c) lab_##c:
+#define EMU_NEXT { ++ip; if (ip == end) goto fallthru; goto *dispatch[ip->code]; }
+#define EMU_JUMP(i) { ip = bl->code.data() + (i); if (ip == end) goto fallthru; goto *dispatch[ip->code]; }
+    goto *dispatch[ip->code];
+#else
+#define EMU_CASE(c) case code_##c:
+#define EMU_NEXT { ++ip; if (ip == end) goto fallthru; continue; }
+#define EMU_JUMP(i) { ip = bl->code.data() + (i); if (ip == end) goto fallthru; continue; }
+    for(;;) {
+      switch(ip->code) {
+#endif
+    EMU_CASE(nop)
+      EMU_NEXT
+    EMU_CASE(copy)
+      setOperand(ip->out,getOperand(ip->in[0]));
+      EMU_NEXT
+    EMU_CASE(load)
+      setOperand(ip->out,loadValue(ip->in[0].space,getOperand(ip->in[1]),ip->out.size));
+      EMU_NEXT
+    EMU_CASE(store)
+      storeValue(ip->in[0].space,getOperand(ip->in[1]),ip->in[2].size,getOperand(ip->in[2]));
+      EMU_NEXT
+    EMU_CASE(branch)
+      exitop = ip;
+      goto direct;
+    EMU_CASE(cbranch)
+      if (getOperand(ip->in[1]) != 0) {
+	exitop = ip;
+	goto direct;
+      }
+      EMU_NEXT
+    EMU_CASE(relbranch)
+      EMU_JUMP(ip->target)
+    EMU_CASE(relcbranch)
+      if (getOperand(ip->in[1]) != 0)
+	EMU_JUMP(ip->target)
+      EMU_NEXT
+    EMU_CASE(branchind)
+      current_address = Address(ip->dest.getSpace(),getOperand(ip->in[0]));
+      return (Block *)0;
+    EMU_CASE(callother)
+      if (callOther(*ip))
+	return (Block *)0;
+      EMU_NEXT
+    EMU_CASE(addrbreak)
+      if (addressBreak(ip->dest))
+	return (Block *)0;
+      EMU_NEXT
+    EMU_CASE(equal)
+      setOperand(ip->out,(getOperand(ip->in[0]) == getOperand(ip->in[1])) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(notequal)
+      setOperand(ip->out,(getOperand(ip->in[0]) != getOperand(ip->in[1])) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(sless)
+      in1 = getOperand(ip->in[0]);
+      in2 = getOperand(ip->in[1]);
+      mask = ((uintb)0x80) << (8*(ip->in[0].size-1));
+      if ((in1 & mask) != (in2 & mask))
+	setOperand(ip->out,((in1 & mask) != 0) ? 1 : 0);
+      else
+	setOperand(ip->out,(in1 < in2) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(slessequal)
+      in1 = getOperand(ip->in[0]);
+      in2 = getOperand(ip->in[1]);
+      mask = ((uintb)0x80) << (8*(ip->in[0].size-1));
+      if ((in1 & mask) != (in2 & mask))
+	setOperand(ip->out,((in1 & mask) != 0) ? 1 : 0);
+      else
+	setOperand(ip->out,(in1 <= in2) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(less)
+      setOperand(ip->out,(getOperand(ip->in[0]) < getOperand(ip->in[1])) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(lessequal)
+      setOperand(ip->out,(getOperand(ip->in[0]) <= getOperand(ip->in[1])) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(zext)
+      setOperand(ip->out,getOperand(ip->in[0]));
+      EMU_NEXT
+    EMU_CASE(sext)
+      setOperand(ip->out,sign_extend(getOperand(ip->in[0]),ip->in[0].size,ip->out.size));
+      EMU_NEXT
+    EMU_CASE(add)
+      setOperand(ip->out,getOperand(ip->in[0]) + getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(sub)
+      setOperand(ip->out,getOperand(ip->in[0]) - getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(carry)
+      in1 = getOperand(ip->in[0]);
+      in2 = getOperand(ip->in[1]);
+      setOperand(ip->out,(in1 > ((in1 + in2) & calc_mask(ip->in[0].size))) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(scarry)
+      in1 = getOperand(ip->in[0]);
+      in2 = getOperand(ip->in[1]);
+      mask = ((uintb)1) << (ip->in[0].size*8-1);
+      setOperand(ip->out,((((in1 + in2) ^ in1) & ~(in1 ^ in2) & mask) != 0) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(sborrow)
+      in1 = getOperand(ip->in[0]);
+      in2 = getOperand(ip->in[1]);
+      mask = ((uintb)1) << (ip->in[0].size*8-1);
+      setOperand(ip->out,((((in1 - in2) ^ in1) & (in1 ^ in2) & mask) != 0) ? 1 : 0);
+      EMU_NEXT
+    EMU_CASE(2comp)
+      setOperand(ip->out,uintb_negate(getOperand(ip->in[0])-1,ip->in[0].size));
+      EMU_NEXT
+    EMU_CASE(negate)
+      setOperand(ip->out,uintb_negate(getOperand(ip->in[0]),ip->in[0].size));
+      EMU_NEXT
+    EMU_CASE(xor)
+      setOperand(ip->out,getOperand(ip->in[0]) ^ getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(and)
+      setOperand(ip->out,getOperand(ip->in[0]) & getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(or)
+      setOperand(ip->out,getOperand(ip->in[0]) | getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(left)
+      setOperand(ip->out,getOperand(ip->in[0]) << getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(right)
+      setOperand(ip->out,(getOperand(ip->in[0]) & calc_mask(ip->out.size)) >> getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(sright)
+      setOperand(ip->out,ip->behave->evaluateBinary(ip->out.size,ip->in[0].size,getOperand(ip->in[0]),getOperand(ip->in[1])));
+      EMU_NEXT
+    EMU_CASE(mult)
+      setOperand(ip->out,getOperand(ip->in[0]) * getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(boolnegate)
+      setOperand(ip->out,getOperand(ip->in[0]) ^ 1);
+      EMU_NEXT
+    EMU_CASE(piece)
+      setOperand(ip->out,(getOperand(ip->in[0]) << ((ip->out.size-ip->in[0].size)*8)) | getOperand(ip->in[1]));
+      EMU_NEXT
+    EMU_CASE(subpiece)
+      setOperand(ip->out,getOperand(ip->in[0]) >> (getOperand(ip->in[1])*8));
+      EMU_NEXT
+    EMU_CASE(fold)
+      setOperand(ip->out,(*ip->fold)(ip->out.size,getOperand(ip->in[0]),
+				      ip->behave->isUnary() ? 0 : getOperand(ip->in[1])));
+      EMU_NEXT
+    EMU_CASE(unary)
+      setOperand(ip->out,ip->behave->evaluateUnary(ip->out.size,ip->in[0].size,getOperand(ip->in[0])));
+      EMU_NEXT
+    EMU_CASE(binary)
+      setOperand(ip->out,ip->behave->evaluateBinary(ip->out.size,ip->in[0].size,getOperand(ip->in[0]),getOperand(ip->in[1])));
+      EMU_NEXT
+    EMU_CASE(unsupported)
+      currentOp = ip->raw;	// Let the base class report the problem
+      currentBehave = ip->behave;
+      switch(ip->behave->getOpcode()) {
+      case CPUI_MULTIEQUAL:
+	executeMultiequal();
+	break;
+      case CPUI_INDIRECT:
+	executeIndirect();
+	break;
+      case CPUI_SEGMENTOP:
+	executeSegmentOp();
+	break;
+      case CPUI_CPOOLREF:
+	executeCpoolRef();
+	break;
+      case CPUI_NEW:
+	executeNew();
+	break;
+      default:
+	break;
+      }
+      throw LowlevelError("Bad special op");
+#if !defined(__GNUC__)
+      }
+    }
+#endif
+#undef EMU_CASE
+#undef EMU_NEXT
+#undef EMU_JUMP
+  }
+  catch(LowlevelError &err) {
+    if (ip->raw != (PcodeOpRaw *)0)
+      current_address = ip->raw->getAddr();	// Report the instruction that failed
+    else
+      current_address = ip->dest;		// Failed in an address breakpoint
+    throw;
+  }
+ direct:
+  current_address = exitop->dest;
+  if (exitop->link == (Block *)0)
+    pendinglink = &((Instr *)exitop)->link;
+  return exitop->link;
+ fallthru:
+  current_address = bl->fallthru;
+  if (bl->fallthrulink == (Block *)0)
+    pendinglink = &bl->fallthrulink;
+  return bl->fallthrulink;
+}
+
+/// Execution starts at the current execution address and continues, one block at a time, until
+/// the emulator is halted by a breakpoint or at least the given number of p-code operations have
+/// executed.  The register file is brought up to date from the MemoryState first, and written back
+/// before returning, even if an exception is thrown.
+/// \param maxops is the number of p-code operations after which to stop
+/// \return the number of p-code operations (including compiled breakpoint checks) executed
+uint8 EmulateBlockCache::run(uint8 maxops)
+
+{
+  uint8 count = 0;
+  emu_halted = false;
+  try {
+    loadRegisters();
+    Block *bl = (Block *)0;
+    while(!emu_halted && count < maxops) {
+      if (bl == (Block *)0) {	// Look up the next block, and link it to its predecessor if possible
+	bl = findBlock(current_address);
+	if (pendinglink != (Block **)0)
+	  *pendinglink = bl;
+      }
+      pendinglink = (Block **)0;
+      count += bl->code.size();
+      redirected = false;
+      bl = executeBlock(bl);
+    }
+  }
+  catch(LowlevelError &err) {
+    pendinglink = (Block **)0;
+    storeRegisters();
+    throw;
+  }
+  pendinglink = (Block **)0;
+  storeRegisters();
+  return count;
+}
+
+void EmulateBlockCache::fallthruOp(void)
+
+{
+  throw LowlevelError("EmulateBlockCache executes whole blocks, use run()");
+}
+
+void EmulateBlockCache::clearCache(void)
+
+{
+  map<AddressKey,Block *>::iterator iter;
+  for(iter=blocks.begin();iter!=blocks.end();++iter)
+    delete (*iter).second;
+  blocks.clear();
+}
+
+/// Changing the setting discards all compiled blocks.
+/// \param val is \b true if address breakpoints should be checked
+void EmulateBlockCache::setAddressBreaks(bool val)
+
+{
+  if (val == addressbreaks) return;
+  addressbreaks = val;
+  clearCache();
+}
+
+/// If called from a breakpoint during run(), execution continues at the new address once the
+/// breakpoint returns.
+/// \param addr is the address of the next instruction to execute
+void EmulateBlockCache::setExecuteAddress(const Address &addr)
+
+{
+  current_address = addr;
+  redirected = true;
+}
+
+} // namespace GhidraDec
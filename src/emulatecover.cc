@@ -0,0 +1,107 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "emulatecover.hh"
+
+#include <cstdlib>
+#include <cstring>
+
+#ifndef _WIN32
+extern "C" {
+#include <sys/types.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+}
+#endif
+
+namespace GhidraDec {
+
+/// \param bits is the number of bits in a location (the map has 2^bits counters)
+EdgeCoverage::EdgeCoverage(int4 bits)
+  : local((size_t)1 << bits,0)
+{
+  if (bits < 1 || bits > 28)
+    throw LowlevelError("Bad size for edge coverage map");
+  map = local.data();
+  mask = (1 << bits) - 1;
+  prevloc = 0;
+  shared = (void *)0;
+}
+
+void EdgeCoverage::detach(void)
+
+{
+  if (shared == (void *)0) return;
+#ifndef _WIN32
+  shmdt(shared);
+#endif
+  shared = (void *)0;
+  map = local.data();
+}
+
+/// The segment must be at least as big as the map.  Its contents are left as they are, as the
+/// fuzzer is responsible for clearing them between runs.
+/// \param shmid is the identifier of the segment
+void EdgeCoverage::attachShared(int4 shmid)
+
+{
+#ifdef _WIN32
+  throw LowlevelError("Shared memory coverage maps are not supported on this platform");
+#else
+  struct shmid_ds info;
+  if (shmctl(shmid,IPC_STAT,&info) != 0)
+    throw LowlevelError("Unable to query shared memory for edge coverage");
+  if (info.shm_segsz < getSize())
+    throw LowlevelError("Shared memory is too small for the edge coverage map");
+  void *ptr = shmat(shmid,(const void *)0,0);
+  if (ptr == (void *)-1)
+    throw LowlevelError("Unable to attach shared memory for edge coverage");
+  detach();
+  shared = ptr;
+  map = (uint1 *)ptr;
+  prevloc = 0;
+#endif
+}
+
+/// \return \b true if the environment names a segment, which is now attached
+bool EdgeCoverage::attachFromEnvironment(void)
+
+{
+  const char *id = getenv("__AFL_SHM_ID");
+  if (id == (const char *)0)
+    return false;
+  attachShared(atoi(id));
+  return true;
+}
+
+void EdgeCoverage::clear(void)
+
+{
+  memset(map,0,getSize());
+  prevloc = 0;
+}
+
+/// \return the number of distinct (hashed) edges that have been taken
+uint4 EdgeCoverage::countEdges(void) const
+
+{
+  uint4 count = 0;
+  for(uint4 i=0;i<=mask;++i)
+    if (map[i] != 0)
+      count += 1;
+  return count;
+}
+
+}
@@ -0,0 +1,777 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "emulatelanes.hh"
+
+namespace GhidraDec {
+
+EmulateLanes::Instruction::~Instruction(void)
+
+{
+  for(int4 i=0;i<ops.size();++i)
+    delete ops[i];
+  for(int4 i=0;i<vars.size();++i)
+    delete vars[i];
+}
+
+/// Every lane starts out halted, without a MemoryState.  Each lane must be given a MemoryState
+/// and an execution address before it runs.
+/// \param t is the SLEIGH translator
+/// \param n is the number of lanes
+EmulateLanes::EmulateLanes(Translate *t,int4 n)
+
+{
+  if (n <= 0)
+    throw LowlevelError("EmulateLanes needs at least one lane");
+  trans = t;
+  numlanes = n;
+  OpBehavior::registerInstructions(inst,t);
+  memstate.assign(n,(MemoryState *)0);
+  pc.resize(n);
+  status.assign(n,lane_halted);
+  faultmsg.resize(n);
+  opindex.assign(n,0);
+  for(int4 i=0;i<3;++i)
+    column[i].assign(n,0);
+  result.assign(n,0);
+  uniqspace = trans->getUniqueSpace();
+  tempbigendian = (uniqspace != (AddrSpace *)0) ? uniqspace->isBigEndian() : false;
+  tempsize = 0;
+  setupRegisterFile();
+}
+
+EmulateLanes::~EmulateLanes(void)
+
+{
+  clearCache();
+  for(int4 i=0;i<inst.size();++i) {
+    OpBehavior *t_op = inst[i];
+    if (t_op != (OpBehavior *)0)
+      delete t_op;
+  }
+}
+
+/// The register file covers the space holding the most registers, from offset 0 up to the end of
+/// the highest register in it, for every lane.  If that would be unreasonably large, there is no
+/// register file and registers are accessed through the MemoryState like any other storage.
+void EmulateLanes::setupRegisterFile(void)
+
+{
+  map<VarnodeData,string> reglist;
+  map<AddrSpace *,int4> count;
+  map<AddrSpace *,uintb> extent;
+  trans->getAllRegisters(reglist);
+  map<VarnodeData,string>::const_iterator iter;
+  for(iter=reglist.begin();iter!=reglist.end();++iter) {
+    const VarnodeData &vn( (*iter).first );
+    count[vn.space] += 1;
+    uintb end = vn.offset + vn.size;
+    if (end > extent[vn.space])
+      extent[vn.space] = end;
+  }
+  regspace = (AddrSpace *)0;
+  int4 best = 0;
+  map<AddrSpace *,int4>::const_iterator citer;
+  for(citer=count.begin();citer!=count.end();++citer) {
+    if ((*citer).second > best) {
+      best = (*citer).second;
+      regspace = (*citer).first;
+    }
+  }
+  regsize = 0;
+  if (regspace == (AddrSpace *)0 || extent[regspace] > 0x100000 ||
+      extent[regspace] * numlanes > 0x10000000) {
+    regspace = (AddrSpace *)0;
+    regbigendian = false;
+    return;
+  }
+  regbigendian = regspace->isBigEndian();
+  regsize = extent[regspace];
+  regfile.assign((uintb)regsize * numlanes,0);
+  regvalid.assign(regsize,0);
+}
+
+/// \param lane is the lane
+/// \param off is the starting offset of the bytes in the register space
+/// \param size is the number of bytes
+/// \param store is \b true to write the bytes to the MemoryState, \b false to read them from it
+void EmulateLanes::transferRegisters(int4 lane,uintb off,int4 size,bool store)
+
+{
+  vector<uint1> buf(size);
+  uint1 *ptr = &regfile[off * numlanes + lane];
+  if (store) {
+    for(int4 i=0;i<size;++i)
+      buf[i] = ptr[(uintb)i * numlanes];
+    memstate[lane]->setChunk(buf.data(),regspace,off,size);
+  }
+  else {
+    memstate[lane]->getChunk(buf.data(),regspace,off,size);
+    for(int4 i=0;i<size;++i)
+      ptr[(uintb)i * numlanes] = buf[i];
+  }
+}
+
+/// Any bytes of the range not already held are read from the MemoryState of every lane.
+/// \param off is the starting offset of the range in the register space
+/// \param size is the number of bytes in the range
+void EmulateLanes::makeValid(uintb off,int4 size)
+
+{
+  for(int4 i=0;i<size;++i) {
+    if (regvalid[off+i] != 0) continue;
+    int4 j = i;
+    while(j < size && regvalid[off+j] == 0) {
+      regvalid[off+j] = 1;
+      j += 1;
+    }
+    for(int4 lane=0;lane<numlanes;++lane)
+      transferRegisters(lane,off+i,j-i,false);
+    i = j;
+  }
+}
+
+void EmulateLanes::loadRegisters(void)
+
+{
+  for(int4 i=0;i<regsize;++i) {
+    if (regvalid[i] == 0) continue;
+    int4 j = i;
+    while(j < regsize && regvalid[j] != 0)
+      j += 1;
+    for(int4 lane=0;lane<numlanes;++lane)
+      transferRegisters(lane,i,j-i,false);
+    i = j;
+  }
+}
+
+void EmulateLanes::storeRegisters(void)
+
+{
+  for(int4 i=0;i<regsize;++i) {
+    if (regvalid[i] == 0) continue;
+    int4 j = i;
+    while(j < regsize && regvalid[j] != 0)
+      j += 1;
+    for(int4 lane=0;lane<numlanes;++lane)
+      transferRegisters(lane,i,j-i,true);
+    i = j;
+  }
+}
+
+/// \param vn is the raw varnode
+/// \param res will hold the compiled operand
+/// \param temps maps the temporaries of the instruction to the scratch file, as (offset,scratch offset) pairs
+void EmulateLanes::compileOperand(const VarnodeData *vn,Operand &res,const vector<pair<uintb,uintb> > &temps)
+
+{
+  res.size = vn->size;
+  res.space = vn->space;
+  res.offset = vn->offset;
+  if (vn->space->getType() == IPTR_CONSTANT)
+    res.kind = operand_constant;
+  else if (vn->space == uniqspace) {
+    vector<pair<uintb,uintb> >::const_iterator iter;
+    iter = upper_bound(temps.begin(),temps.end(),pair<uintb,uintb>(vn->offset,~((uintb)0)));
+    --iter;			// Interval holding the temporary
+    res.kind = operand_temp;
+    res.offset = (*iter).second + (vn->offset - (*iter).first);
+  }
+  else if (vn->space == regspace && vn->offset + vn->size <= regsize) {
+    res.kind = operand_register;
+    makeValid(vn->offset,vn->size);
+  }
+  else
+    res.kind = operand_memory;
+}
+
+/// \param op is the raw p-code op
+/// \param res will hold the compiled operation
+/// \param temps maps the temporaries of the instruction to the scratch file
+void EmulateLanes::compileOp(PcodeOpRaw *op,Op &res,const vector<pair<uintb,uintb> > &temps)
+
+{
+  res.opc = op->getOpcode();
+  res.behave = op->getBehavior();
+  res.numin = op->numInput();
+  res.target = -1;
+  res.out.kind = operand_constant;
+  res.out.size = 0;
+  res.out.offset = 0;
+  res.out.space = (AddrSpace *)0;
+  if (op->getOutput() != (VarnodeData *)0)
+    compileOperand(op->getOutput(),res.out,temps);
+  for(int4 i=0;i<3;++i) {
+    if (i < res.numin)
+      compileOperand(op->getInput(i),res.in[i],temps);
+    else {
+      res.in[i].kind = operand_constant;
+      res.in[i].size = 0;
+      res.in[i].offset = 0;
+      res.in[i].space = (AddrSpace *)0;
+    }
+  }
+  if (res.opc == CPUI_LOAD || res.opc == CPUI_STORE)
+    res.in[0].space = Address::getSpaceFromConst(op->getInput(0)->getAddr());
+  else if (res.opc == CPUI_BRANCH || res.opc == CPUI_CBRANCH || res.opc == CPUI_CALL)
+    res.dest = op->getInput(0)->getAddr();
+  res.batch = (ConstantFold::BatchKernel)0;
+  if (res.behave != (OpBehavior *)0 && !res.behave->isSpecial())
+    res.batch = ConstantFold::getBatchKernel(res.opc,res.in[0].size);
+}
+
+/// Temporaries are packed into the scratch file, and branches within the instruction are
+/// resolved to indices of its ops.
+/// \param addr is the address of the instruction
+/// \return the compiled instruction
+EmulateLanes::Instruction *EmulateLanes::buildInstruction(const Address &addr)
+
+{
+  Instruction *ins = new Instruction();
+  try {
+    PcodeEmitCache emit(ins->ops,ins->vars,inst,0);
+    int4 len = trans->oneInstruction(emit,addr);
+    ins->fallthru = addr + len;
+
+    vector<pair<uintb,uintb> > ranges;	// (start,end) of each temporary
+    for(int4 i=0;i<ins->ops.size();++i) {
+      PcodeOpRaw *op = ins->ops[i];
+      if (op->getOutput() != (VarnodeData *)0 && op->getOutput()->space == uniqspace)
+	ranges.push_back(pair<uintb,uintb>(op->getOutput()->offset,op->getOutput()->offset + op->getOutput()->size));
+      for(int4 j=0;j<op->numInput();++j) {
+	const VarnodeData *vn = op->getInput(j);
+	if (vn->space == uniqspace)
+	  ranges.push_back(pair<uintb,uintb>(vn->offset,vn->offset + vn->size));
+      }
+    }
+    sort(ranges.begin(),ranges.end());
+    vector<pair<uintb,uintb> > temps;	// (start,scratch offset) of each group of overlapping temporaries
+    uintb base = 0;
+    for(int4 i=0;i<ranges.size();) {
+      uintb start = ranges[i].first;
+      uintb end = ranges[i].second;
+      for(++i;i<ranges.size() && ranges[i].first < end;++i) {
+	if (ranges[i].second > end)
+	  end = ranges[i].second;
+      }
+      temps.push_back(pair<uintb,uintb>(start,base));
+      base += end - start;
+    }
+    if (base > tempsize) {
+      tempsize = base;
+      tempfile.resize((uintb)tempsize * numlanes,0);
+    }
+
+    int4 numops = ins->ops.size();
+    ins->code.resize(numops);
+    for(int4 k=0;k<numops;++k) {
+      Op &op( ins->code[k] );
+      compileOp(ins->ops[k],op,temps);
+      if ((op.opc == CPUI_BRANCH || op.opc == CPUI_CBRANCH) && op.dest.isConstant()) {
+	int4 dest = k + (int4)(uintm)op.dest.getOffset();	// Relative to the current op
+	if (dest < 0 || dest > numops)
+	  throw LowlevelError("Bad intra-instruction branch");
+	op.target = dest;	// The end of the instruction is its fall-thru
+      }
+    }
+  }
+  catch(LowlevelError &err) {
+    delete ins;
+    throw;
+  }
+  return ins;
+}
+
+/// \param addr is the address of the instruction
+/// \return the compiled instruction
+EmulateLanes::Instruction *EmulateLanes::findInstruction(const Address &addr)
+
+{
+  map<AddressKey,Instruction *>::const_iterator iter = cache.find(AddressKey(addr));
+  if (iter != cache.end())
+    return (*iter).second;
+  Instruction *ins = buildInstruction(addr);
+  cache[AddressKey(addr)] = ins;
+  return ins;
+}
+
+/// Values wider than a \b uintb keep only their least significant bytes.
+/// \param file is the register or scratch file
+/// \param off is the offset of the value within the file
+/// \param size is the number of bytes in the value
+/// \param bigendian is \b true if the bytes are in big endian order
+/// \param lanes is the list of lanes to read, in increasing order
+/// \param count is the number of lanes in the list
+/// \param vals will hold the value for each lane in the list
+void EmulateLanes::readFile(const vector<uint1> &file,uintb off,int4 size,bool bigendian,
+			    const int4 *lanes,int4 count,uintb *vals) const
+
+{
+  for(int4 i=0;i<count;++i)
+    vals[i] = 0;
+  int4 top = (size > (int4)sizeof(uintb)) ? (int4)sizeof(uintb) : size;
+  for(int4 sig=top-1;sig>=0;--sig) {	// From the most significant byte kept
+    const uint1 *row = &file[(off + (bigendian ? size-1-sig : sig)) * numlanes];
+    if (count == numlanes) {		// Every lane, so the row is read in order
+      for(int4 i=0;i<count;++i)
+	vals[i] = (vals[i] << 8) | row[i];
+    }
+    else {
+      for(int4 i=0;i<count;++i)
+	vals[i] = (vals[i] << 8) | row[lanes[i]];
+    }
+  }
+}
+
+/// Values are zero extended into bytes beyond the size of a \b uintb.
+/// \param file is the register or scratch file
+/// \param off is the offset of the value within the file
+/// \param size is the number of bytes in the value
+/// \param bigendian is \b true if the bytes are in big endian order
+/// \param lanes is the list of lanes to write, in increasing order
+/// \param count is the number of lanes in the list
+/// \param vals is the value for each lane in the list
+void EmulateLanes::writeFile(vector<uint1> &file,uintb off,int4 size,bool bigendian,
+			     const int4 *lanes,int4 count,const uintb *vals)
+
+{
+  for(int4 sig=0;sig<size;++sig) {
+    uint1 *row = &file[(off + (bigendian ? size-1-sig : sig)) * numlanes];
+    if (sig >= (int4)sizeof(uintb)) {
+      for(int4 i=0;i<count;++i)
+	row[lanes[i]] = 0;
+    }
+    else if (count == numlanes) {
+      for(int4 i=0;i<count;++i)
+	row[i] = (uint1)(vals[i] >> (sig*8));
+    }
+    else {
+      for(int4 i=0;i<count;++i)
+	row[lanes[i]] = (uint1)(vals[i] >> (sig*8));
+    }
+  }
+}
+
+/// A lane whose MemoryState can't supply the value is stopped with a fault.
+/// \param op is the operand
+/// \param lanes is the list of lanes, in increasing order
+/// \param count is the number of lanes in the list
+/// \param vals will hold the value of the operand for each lane in the list
+void EmulateLanes::readOperand(const Operand &op,const int4 *lanes,int4 count,uintb *vals)
+
+{
+  switch(op.kind) {
+  case operand_register:
+    readFile(regfile,op.offset,op.size,regbigendian,lanes,count,vals);
+    return;
+  case operand_temp:
+    readFile(tempfile,op.offset,op.size,tempbigendian,lanes,count,vals);
+    return;
+  case operand_constant:
+    for(int4 i=0;i<count;++i)
+      vals[i] = op.offset;
+    return;
+  default:
+    break;
+  }
+  for(int4 i=0;i<count;++i) {
+    vals[i] = 0;
+    try {
+      vals[i] = memstate[lanes[i]]->getValue(op.space,op.offset,op.size);
+    }
+    catch(LowlevelError &err) {
+      fault(lanes[i],err.explain);
+    }
+  }
+}
+
+/// Lanes that have faulted are not written to memory, and a lane whose MemoryState can't take
+/// the value is stopped with a fault.
+/// \param op is the operand
+/// \param lanes is the list of lanes, in increasing order
+/// \param count is the number of lanes in the list
+/// \param vals is the value to write for each lane in the list
+void EmulateLanes::writeOperand(const Operand &op,const int4 *lanes,int4 count,const uintb *vals)
+
+{
+  switch(op.kind) {
+  case operand_register:
+    writeFile(regfile,op.offset,op.size,regbigendian,lanes,count,vals);
+    return;
+  case operand_temp:
+    writeFile(tempfile,op.offset,op.size,tempbigendian,lanes,count,vals);
+    return;
+  case operand_constant:
+    return;
+  default:
+    break;
+  }
+  for(int4 i=0;i<count;++i) {
+    if (status[lanes[i]] != lane_running) continue;
+    try {
+      memstate[lanes[i]]->setValue(op.space,op.offset,op.size,vals[i]);
+    }
+    catch(LowlevelError &err) {
+      fault(lanes[i],err.explain);
+    }
+  }
+}
+
+/// The first fault of a lane is the one that is kept.
+/// \param lane is the lane
+/// \param msg is the reason it stopped
+void EmulateLanes::fault(int4 lane,const string &msg)
+
+{
+  opindex[lane] = -1;
+  if (status[lane] == lane_fault) return;
+  status[lane] = lane_fault;
+  faultmsg[lane] = msg;
+}
+
+/// \param op is the LOAD
+/// \param lanes is the list of lanes executing it
+/// \param count is the number of lanes in the list
+void EmulateLanes::executeLoad(const Op &op,const int4 *lanes,int4 count)
+
+{
+  uintb *off = column[1].data();
+  uintb *res = result.data();
+  readOperand(op.in[1],lanes,count,off);
+  AddrSpace *spc = op.in[0].space;
+  int4 size = op.out.size;
+  for(int4 i=0;i<count;++i) {
+    int4 lane = lanes[i];
+    res[i] = 0;
+    if (status[lane] != lane_running) continue;
+    uintb byteoff = AddrSpace::addressToByte(off[i],spc->getWordSize());
+    if (spc == regspace && byteoff + size <= regsize && byteoff + size > byteoff) {
+      makeValid(byteoff,size);
+      readFile(regfile,byteoff,size,regbigendian,lanes+i,1,res+i);
+      continue;
+    }
+    try {
+      res[i] = memstate[lane]->getValue(spc,byteoff,size);
+    }
+    catch(LowlevelError &err) {
+      fault(lane,err.explain);
+    }
+  }
+  writeOperand(op.out,lanes,count,res);
+}
+
+/// \param op is the STORE
+/// \param lanes is the list of lanes executing it
+/// \param count is the number of lanes in the list
+void EmulateLanes::executeStore(const Op &op,const int4 *lanes,int4 count)
+
+{
+  uintb *off = column[1].data();
+  uintb *val = column[2].data();
+  readOperand(op.in[1],lanes,count,off);
+  readOperand(op.in[2],lanes,count,val);
+  AddrSpace *spc = op.in[0].space;
+  int4 size = op.in[2].size;
+  for(int4 i=0;i<count;++i) {
+    int4 lane = lanes[i];
+    if (status[lane] != lane_running) continue;
+    uintb byteoff = AddrSpace::addressToByte(off[i],spc->getWordSize());
+    if (spc == regspace && byteoff + size <= regsize && byteoff + size > byteoff) {
+      makeValid(byteoff,size);
+      writeFile(regfile,byteoff,size,regbigendian,lanes+i,1,val+i);
+      continue;
+    }
+    try {
+      memstate[lane]->setValue(spc,byteoff,size,val[i]);
+    }
+    catch(LowlevelError &err) {
+      fault(lane,err.explain);
+    }
+  }
+}
+
+/// The array kernel for the operation is used if there is one.  If it fails, or there is none,
+/// the OpBehavior evaluates the operation one lane at a time, so a failure only stops
+/// the lane it happens in.
+/// \param op is the operation
+/// \param lanes is the list of lanes executing it
+/// \param count is the number of lanes in the list
+void EmulateLanes::executeArithmetic(const Op &op,const int4 *lanes,int4 count)
+
+{
+  uintb *in1 = column[0].data();
+  uintb *in2 = column[1].data();
+  uintb *res = result.data();
+  bool unary = op.behave->isUnary();
+  readOperand(op.in[0],lanes,count,in1);
+  if (!unary)
+    readOperand(op.in[1],lanes,count,in2);
+  if (op.batch != (ConstantFold::BatchKernel)0) {
+    try {
+      (*op.batch)(op.out.size,in1,unary ? (const uintb *)0 : in2,res,count);
+      writeOperand(op.out,lanes,count,res);
+      return;
+    }
+    catch(LowlevelError &err) {
+      // Fall back to finding the lanes that failed
+    }
+  }
+  for(int4 i=0;i<count;++i) {
+    res[i] = 0;
+    if (status[lanes[i]] != lane_running) continue;
+    try {
+      if (unary)
+	res[i] = op.behave->evaluateUnary(op.out.size,op.in[0].size,in1[i]);
+      else
+	res[i] = op.behave->evaluateBinary(op.out.size,op.in[0].size,in1[i],in2[i]);
+    }
+    catch(LowlevelError &err) {
+      fault(lanes[i],err.explain);
+    }
+  }
+  writeOperand(op.out,lanes,count,res);
+}
+
+/// Each lane is left with the index of the next op it executes in \b opindex, which is the number
+/// of ops if it falls through to the next instruction, and -1 if it branched out of the instruction
+/// (its execution address is set) or faulted.
+/// \param op is the operation
+/// \param index is the index of the op within its instruction
+/// \param group is the list of lanes executing it, in increasing order
+/// \param addr is the address of the instruction
+void EmulateLanes::executeOp(const Op &op,int4 index,const vector<int4> &group,const Address &addr)
+
+{
+  const int4 *lanes = group.data();
+  int4 count = group.size();
+  switch(op.opc) {
+  case CPUI_COPY:
+    readOperand(op.in[0],lanes,count,column[0].data());
+    writeOperand(op.out,lanes,count,column[0].data());
+    break;
+  case CPUI_LOAD:
+    executeLoad(op,lanes,count);
+    break;
+  case CPUI_STORE:
+    executeStore(op,lanes,count);
+    break;
+  case CPUI_BRANCH:
+  case CPUI_CALL:
+    for(int4 i=0;i<count;++i) {
+      int4 lane = lanes[i];
+      if (op.target >= 0)
+	opindex[lane] = op.target;
+      else {
+	pc[lane] = op.dest;
+	opindex[lane] = -1;
+      }
+    }
+    return;
+  case CPUI_CBRANCH:
+    readOperand(op.in[1],lanes,count,column[1].data());
+    for(int4 i=0;i<count;++i) {
+      int4 lane = lanes[i];
+      if (status[lane] != lane_running) continue;
+      if (column[1][i] == 0)
+	opindex[lane] = index + 1;
+      else if (op.target >= 0)
+	opindex[lane] = op.target;
+      else {
+	pc[lane] = op.dest;
+	opindex[lane] = -1;
+      }
+    }
+    return;
+  case CPUI_BRANCHIND:
+  case CPUI_CALLIND:
+  case CPUI_RETURN:
+    readOperand(op.in[0],lanes,count,column[0].data());
+    for(int4 i=0;i<count;++i) {
+      int4 lane = lanes[i];
+      if (status[lane] != lane_running) continue;
+      pc[lane] = Address(addr.getSpace(),column[0][i]);
+      opindex[lane] = -1;
+    }
+    return;
+  case CPUI_CALLOTHER:
+    for(int4 i=0;i<count;++i)
+      fault(lanes[i],"Userop can't be executed by EmulateLanes");
+    return;
+  case CPUI_MULTIEQUAL:
+  case CPUI_INDIRECT:
+  case CPUI_SEGMENTOP:
+  case CPUI_CPOOLREF:
+  case CPUI_NEW:
+    for(int4 i=0;i<count;++i)
+      fault(lanes[i],"Cannot emulate " + string(get_opname(op.opc)));
+    return;
+  default:
+    if (op.behave == (OpBehavior *)0 || op.behave->isSpecial()) {
+      for(int4 i=0;i<count;++i)
+	fault(lanes[i],"Cannot emulate " + string(get_opname(op.opc)));
+      return;
+    }
+    executeArithmetic(op,lanes,count);
+    break;
+  }
+  for(int4 i=0;i<count;++i) {
+    if (status[lanes[i]] == lane_running)
+      opindex[lanes[i]] = index + 1;
+  }
+}
+
+/// Starting with its first op, each op is executed for the lanes that have reached it,
+/// always picking the lowest op any lane is waiting at, until every lane has left the instruction.
+/// \param addr is the address of the instruction
+/// \param group is the list of lanes at the address, in increasing order
+void EmulateLanes::executeInstruction(const Address &addr,const vector<int4> &group)
+
+{
+  Instruction *ins;
+  try {
+    ins = findInstruction(addr);
+  }
+  catch(LowlevelError &err) {
+    for(int4 i=0;i<group.size();++i)
+      fault(group[i],err.explain);
+    return;
+  }
+  int4 numops = ins->code.size();
+  vector<int4> live(group);
+  vector<int4> sub;
+  for(int4 i=0;i<live.size();++i)
+    opindex[live[i]] = 0;
+  while(!live.empty()) {
+    int4 cur = opindex[live[0]];
+    bool together = true;		// Are all lanes at the same op
+    for(int4 i=1;i<live.size();++i) {
+      int4 idx = opindex[live[i]];
+      if (idx != cur) {
+	together = false;
+	if (idx < cur)
+	  cur = idx;
+      }
+    }
+    if (cur < numops) {
+      if (together)
+	executeOp(ins->code[cur],cur,live,addr);
+      else {
+	sub.clear();
+	for(int4 i=0;i<live.size();++i) {
+	  if (opindex[live[i]] == cur)
+	    sub.push_back(live[i]);
+	}
+	executeOp(ins->code[cur],cur,sub,addr);
+      }
+    }
+    int4 j = 0;
+    for(int4 i=0;i<live.size();++i) {
+      int4 lane = live[i];
+      int4 idx = opindex[lane];
+      if (idx < 0) continue;		// Branched out or faulted
+      if (idx >= numops) {		// Fell through
+	pc[lane] = ins->fallthru;
+	continue;
+      }
+      live[j++] = lane;
+    }
+    live.resize(j);
+  }
+}
+
+/// \param lane is the lane
+/// \param mem is the MemoryState holding its machine state
+void EmulateLanes::setMemoryState(int4 lane,MemoryState *mem)
+
+{
+  memstate[lane] = mem;
+}
+
+/// The lane becomes ready to run, even if it had halted or faulted.
+/// \param lane is the lane
+/// \param addr is the address of the next instruction it executes
+void EmulateLanes::setExecuteAddress(int4 lane,const Address &addr)
+
+{
+  pc[lane] = addr;
+  status[lane] = lane_running;
+  faultmsg[lane].clear();
+}
+
+/// Every lane becomes ready to run, even if it had halted or faulted.
+/// \param addr is the address of the next instruction they execute
+void EmulateLanes::setExecuteAddress(const Address &addr)
+
+{
+  for(int4 lane=0;lane<numlanes;++lane)
+    setExecuteAddress(lane,addr);
+}
+
+void EmulateLanes::clearCache(void)
+
+{
+  map<AddressKey,Instruction *>::iterator iter;
+  for(iter=cache.begin();iter!=cache.end();++iter)
+    delete (*iter).second;
+  cache.clear();
+}
+
+/// Each step executes the instruction at the lowest address of any running lane, for every
+/// running lane at that address.  This continues until no lane is running, or until the lanes
+/// together have executed at least the given number of instructions.
+/// \param maxinstr is the number of instructions to stop after, counting every lane
+/// \return the number of instructions executed, counting every lane
+uint8 EmulateLanes::run(uint8 maxinstr)
+
+{
+  for(int4 lane=0;lane<numlanes;++lane) {
+    if (memstate[lane] == (MemoryState *)0)
+      throw LowlevelError("EmulateLanes lane has no MemoryState");
+  }
+  loadRegisters();
+  uint8 count = 0;
+  vector<int4> group;
+  try {
+    while(count < maxinstr) {
+      int4 first = -1;
+      for(int4 lane=0;lane<numlanes;++lane) {
+	if (status[lane] != lane_running) continue;
+	if (!haltaddr.empty() && haltaddr.find(pc[lane]) != haltaddr.end()) {
+	  status[lane] = lane_halted;
+	  continue;
+	}
+	if (first < 0 || pc[lane] < pc[first])
+	  first = lane;
+      }
+      if (first < 0) break;
+      Address addr = pc[first];
+      group.clear();
+      for(int4 lane=first;lane<numlanes;++lane) {
+	if (status[lane] == lane_running && pc[lane] == addr)
+	  group.push_back(lane);
+      }
+      executeInstruction(addr,group);
+      count += group.size();
+    }
+  }
+  catch(LowlevelError &err) {
+    storeRegisters();
+    throw;
+  }
+  storeRegisters();
+  return count;
+}
+
+} // namespace GhidraDec
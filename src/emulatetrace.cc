@@ -0,0 +1,316 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "emulatetrace.hh"
+
+#include <chrono>
+
+namespace GhidraDec {
+
+/// Bytes at the start of every trace file
+static const char traceMagic[4] = { 'E', 'M', 'T', 'R' };
+static const uint1 traceVersion = 1;
+
+/// Bits of the tag byte starting each record
+enum {
+  tag_addr = 1,			///< Delta of the instruction address follows
+  tag_codespace = 2,		///< Index of the code space follows
+  tag_space = 4,		///< Index of the written space follows
+  tag_size = 8,			///< Size of the write follows
+  tag_opshift = 4,		///< Shift of the op index held in the tag
+  tag_opescape = 15		///< Op index in the tag meaning the index follows as a varint
+};
+
+/// \param val is a signed delta held in an unsigned value
+/// \return the zig-zag encoding, which is small if the delta is near 0
+static inline uintb zigzagEncode(uintb val)
+
+{
+  return (val << 1) ^ (uintb)(((intb)val) >> (8*sizeof(uintb)-1));
+}
+
+/// \param val is a zig-zag encoded delta
+/// \return the delta
+static inline uintb zigzagDecode(uintb val)
+
+{
+  return (val >> 1) ^ (~(val & 1) + 1);
+}
+
+EmulateTrace::EmulateTrace(void)
+  : head(0), tail(0), done(false)
+{
+  for(int4 i=0;i<numchunks;++i)
+    chunkfill[i] = 0;
+  cur = (uint1 *)0;
+  curend = (uint1 *)0;
+  numrecords = 0;
+}
+
+/// \param ptr is where to write the encoding
+/// \param val is the value to encode
+/// \return the position after the encoding
+uint1 *EmulateTrace::writeVarint(uint1 *ptr,uintb val)
+
+{
+  while(val >= 0x80) {
+    *ptr++ = (uint1)(val | 0x80);
+    val >>= 7;
+  }
+  *ptr++ = (uint1)val;
+  return ptr;
+}
+
+/// The chunk at the head of the ring must already be free.
+void EmulateTrace::startChunk(void)
+
+{
+  vector<uint1> &buf(chunk[head.load(std::memory_order_relaxed) % numchunks]);
+  cur = buf.data();
+  curend = cur + (chunksize - maxrecord);
+}
+
+/// The emulating thread only waits here if the writer has fallen a whole ring behind.
+void EmulateTrace::pushChunk(void)
+
+{
+  uint4 h = head.load(std::memory_order_relaxed);
+  vector<uint1> &buf(chunk[h % numchunks]);
+  chunkfill[h % numchunks] = cur - buf.data();
+  head.store(h+1,std::memory_order_release);
+  while(h + 1 - tail.load(std::memory_order_acquire) >= numchunks)
+    std::this_thread::yield();
+  startChunk();
+}
+
+/// Chunks are written out in order as they are handed over.  The thread exits once
+/// done is set and every chunk has been written.
+void EmulateTrace::writeLoop(void)
+
+{
+  for(;;) {
+    uint4 t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+      if (done.load(std::memory_order_acquire) && t == head.load(std::memory_order_acquire))
+	break;
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+      continue;
+    }
+    file.write((const char *)chunk[t % numchunks].data(),chunkfill[t % numchunks]);
+    tail.store(t+1,std::memory_order_release);
+  }
+  file.flush();
+}
+
+/// The header naming each address space is written, and the writer thread is started.
+/// \param filename is the path of the trace file to create
+/// \param manage holds the address spaces that writes can be made to
+void EmulateTrace::open(const string &filename,const AddrSpaceManager *manage)
+
+{
+  close();
+  int4 num = manage->numSpaces();
+  if (num > 255)
+    throw LowlevelError("Too many address spaces to trace");
+  file.open(filename.c_str(),std::ios::out | std::ios::binary | std::ios::trunc);
+  if (!file)
+    throw LowlevelError("Unable to open trace file: " + filename);
+  file.write(traceMagic,4);
+  file.put((char)traceVersion);
+  file.put((char)num);
+  for(int4 i=0;i<num;++i) {
+    AddrSpace *spc = manage->getSpace(i);
+    string nm;
+    if (spc != (AddrSpace *)0)
+      nm = spc->getName();
+    file.put((char)nm.size());
+    file.write(nm.data(),nm.size());
+  }
+  for(int4 i=0;i<numchunks;++i)
+    chunk[i].resize(chunksize);
+  head.store(0,std::memory_order_relaxed);
+  tail.store(0,std::memory_order_relaxed);
+  done.store(false,std::memory_order_relaxed);
+  numrecords = 0;
+  lastcodespace = (AddrSpace *)0;
+  lastaddr = 0;
+  lastspace = (AddrSpace *)0;
+  lastoffset = 0;
+  lastsize = 0;
+  startChunk();
+  writer = std::thread(&EmulateTrace::writeLoop,this);
+}
+
+/// Any records in the current chunk are handed to the writer thread, which is then joined.
+void EmulateTrace::close(void)
+
+{
+  if (!file.is_open()) return;
+  uint4 h = head.load(std::memory_order_relaxed);
+  if (cur != chunk[h % numchunks].data()) {
+    chunkfill[h % numchunks] = cur - chunk[h % numchunks].data();
+    head.store(h+1,std::memory_order_release);
+  }
+  done.store(true,std::memory_order_release);
+  writer.join();
+  file.close();
+  for(int4 i=0;i<numchunks;++i)
+    vector<uint1>().swap(chunk[i]);
+  cur = (uint1 *)0;
+  curend = (uint1 *)0;
+}
+
+/// \param addr is the address of the instruction making the write
+/// \param opindex is the index of the p-code op making the write, within its instruction
+/// \param spc is the address space written to
+/// \param off is the offset written to
+/// \param size is the number of bytes written
+/// \param val is the value written
+void EmulateTrace::record(const Address &addr,int4 opindex,AddrSpace *spc,uintb off,int4 size,uintb val)
+
+{
+  uint1 *tag = cur++;
+  uint1 tagval = 0;
+  AddrSpace *codespace = addr.getSpace();
+  uintb codeoff = addr.getOffset();
+  if (codespace != lastcodespace) {
+    tagval |= tag_codespace;
+    *cur++ = (uint1)codespace->getIndex();
+    lastcodespace = codespace;
+    lastaddr = 0;
+  }
+  if (codeoff != lastaddr) {
+    tagval |= tag_addr;
+    cur = writeVarint(cur,zigzagEncode(codeoff - lastaddr));
+    lastaddr = codeoff;
+  }
+  if (spc != lastspace) {
+    tagval |= tag_space;
+    *cur++ = (uint1)spc->getIndex();
+    lastspace = spc;
+  }
+  if (size != lastsize) {
+    tagval |= tag_size;
+    *cur++ = (uint1)size;
+    lastsize = size;
+  }
+  if (opindex < tag_opescape)
+    tagval |= opindex << tag_opshift;
+  else {
+    tagval |= tag_opescape << tag_opshift;
+    cur = writeVarint(cur,opindex);
+  }
+  *tag = tagval;
+  cur = writeVarint(cur,zigzagEncode(off - lastoffset));
+  lastoffset = off;
+  cur = writeVarint(cur,val);
+  numrecords += 1;
+  if (cur > curend)
+    pushChunk();
+}
+
+/// The header, holding the name of each address space, is read.
+/// \param st is the stream holding the trace
+EmulateTraceReader::EmulateTraceReader(std::istream &st)
+  : s(st)
+{
+  char magic[4];
+  s.read(magic,4);
+  if (!s || magic[0] != traceMagic[0] || magic[1] != traceMagic[1] || magic[2] != traceMagic[2] ||
+      magic[3] != traceMagic[3])
+    throw LowlevelError("Not an emulator trace");
+  if (readByte() != traceVersion)
+    throw LowlevelError("Unsupported emulator trace version");
+  int4 num = readByte();
+  spacename.resize(num);
+  for(int4 i=0;i<num;++i) {
+    int4 len = readByte();
+    spacename[i].resize(len);
+    if (len != 0)
+      s.read(&spacename[i][0],len);
+  }
+  last.codespace = -1;
+  last.addr = 0;
+  last.opindex = 0;
+  last.space = -1;
+  last.offset = 0;
+  last.size = 0;
+  last.value = 0;
+}
+
+/// \return the next byte of the trace
+uint1 EmulateTraceReader::readByte(void)
+
+{
+  int c = s.get();
+  if (c == EOF)
+    throw LowlevelError("Emulator trace is truncated");
+  return (uint1)c;
+}
+
+/// \return the decoded value
+uintb EmulateTraceReader::readVarint(void)
+
+{
+  uintb res = 0;
+  int4 shift = 0;
+  uint1 b;
+  do {
+    b = readByte();
+    res |= ((uintb)(b & 0x7f)) << shift;
+    shift += 7;
+  } while((b & 0x80) != 0);
+  return res;
+}
+
+/// \return the index of the address space read from the trace
+int4 EmulateTraceReader::readSpace(void)
+
+{
+  int4 index = readByte();
+  if (index >= spacename.size() || spacename[index].empty())
+    throw LowlevelError("Emulator trace refers to an unknown address space");
+  return index;
+}
+
+/// \param rec will hold the record
+/// \return \b false if the end of the trace has been reached
+bool EmulateTraceReader::next(EmulateTraceRecord &rec)
+
+{
+  int c = s.get();
+  if (c == EOF)
+    return false;
+  uint1 tag = (uint1)c;
+  if ((tag & tag_codespace) != 0) {
+    last.codespace = readSpace();
+    last.addr = 0;
+  }
+  if ((tag & tag_addr) != 0)
+    last.addr += zigzagDecode(readVarint());
+  if ((tag & tag_space) != 0)
+    last.space = readSpace();
+  if ((tag & tag_size) != 0)
+    last.size = readByte();
+  last.opindex = tag >> tag_opshift;
+  if (last.opindex == tag_opescape)
+    last.opindex = readVarint();
+  last.offset += zigzagDecode(readVarint());
+  last.value = readVarint();
+  rec = last;
+  return true;
+}
+
+}
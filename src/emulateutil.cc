@@ -15,6 +15,7 @@
  */
 #include "architecture.hh"
 #include "emulateutil.hh"
+#include "constfold.hh"
 
 namespace GhidraDec {
 /// \param g is the Architecture providing the LoadImage
@@ -47,8 +48,11 @@ void EmulatePcodeOp::executeUnary(void)
 
 {
   uintb in1 = getVarnodeValue(currentOp->getIn(0));
-  uintb out = currentBehave->evaluateUnary(currentOp->getOut()->getSize(),
-					   currentOp->getIn(0)->getSize(),in1);
+  uintb out;
+  if (!ConstantFold::evaluate(currentBehave->getOpcode(),currentOp->getOut()->getSize(),
+			      currentOp->getIn(0)->getSize(),in1,0,out))
+    out = currentBehave->evaluateUnary(currentOp->getOut()->getSize(),
+				       currentOp->getIn(0)->getSize(),in1);
   setVarnodeValue(currentOp->getOut(), out);
 }
 
@@ -57,8 +61,11 @@ void EmulatePcodeOp::executeBinary(void)
 {
   uintb in1 = getVarnodeValue(currentOp->getIn(0));
   uintb in2 = getVarnodeValue(currentOp->getIn(1));
-  uintb out = currentBehave->evaluateBinary(currentOp->getOut()->getSize(),
-					    currentOp->getIn(0)->getSize(),in1,in2);
+  uintb out;
+  if (!ConstantFold::evaluate(currentBehave->getOpcode(),currentOp->getOut()->getSize(),
+			      currentOp->getIn(0)->getSize(),in1,in2,out))
+    out = currentBehave->evaluateBinary(currentOp->getOut()->getSize(),
+					currentOp->getIn(0)->getSize(),in1,in2);
   setVarnodeValue(currentOp->getOut(), out);
 }
 
@@ -167,8 +174,11 @@ void EmulateSnippet::executeUnary(void)
 
 {
   uintb in1 = getVarnodeValue(currentOp->getInput(0));
-  uintb out = currentBehave->evaluateUnary(currentOp->getOutput()->size,
-					   currentOp->getInput(0)->size,in1);
+  uintb out;
+  if (!ConstantFold::evaluate(currentBehave->getOpcode(),currentOp->getOutput()->size,
+			      currentOp->getInput(0)->size,in1,0,out))
+    out = currentBehave->evaluateUnary(currentOp->getOutput()->size,
+				       currentOp->getInput(0)->size,in1);
   setVarnodeValue(currentOp->getOutput()->offset, out);
 }
 
@@ -177,8 +187,11 @@ void EmulateSnippet::executeBinary(void)
 {
   uintb in1 = getVarnodeValue(currentOp->getInput(0));
   uintb in2 = getVarnodeValue(currentOp->getInput(1));
-  uintb out = currentBehave->evaluateBinary(currentOp->getOutput()->size,
-					    currentOp->getInput(0)->size,in1,in2);
+  uintb out;
+  if (!ConstantFold::evaluate(currentBehave->getOpcode(),currentOp->getOutput()->size,
+			      currentOp->getInput(0)->size,in1,in2,out))
+    out = currentBehave->evaluateBinary(currentOp->getOutput()->size,
+					currentOp->getInput(0)->size,in1,in2);
   setVarnodeValue(currentOp->getOutput()->offset, out);
 }
 
@@ -0,0 +1,61 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Emulation trace reader: print the records of a trace written by EmulateTrace as text
+//
+//   emulator-trace-dump trace
+//
+// Each write is printed on its own line as
+//   codespace:address opindex space:offset:size value
+// with addresses, offsets and values in hex, so two traces can be compared with diff.
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+#include "emulatetrace.hh"
+
+using namespace GhidraDec;
+
+int main(int argc,char **argv)
+
+{
+  if (argc != 2) {
+    cerr << "usage: emulator-trace-dump trace" << endl;
+    exit(2);
+  }
+  ifstream s(argv[1],ios::in | ios::binary);
+  if (!s) {
+    cerr << "Could not open " << argv[1] << endl;
+    exit(1);
+  }
+  uintb count = 0;
+  try {
+    EmulateTraceReader reader(s);
+    EmulateTraceRecord rec;
+    cout << hex;
+    while(reader.next(rec)) {
+      cout << reader.getSpaceName(rec.codespace) << ":0x" << rec.addr << ' ' << dec << rec.opindex << ' ';
+      cout << reader.getSpaceName(rec.space) << ":0x" << hex << rec.offset << ':' << dec << rec.size;
+      cout << " 0x" << hex << rec.value << '\n';
+      count += 1;
+    }
+  }
+  catch(LowlevelError &err) {
+    cerr << argv[1] << ": " << err.explain << " after " << dec << count << " records" << endl;
+    return 1;
+  }
+  return 0;
+}
@@ -18,6 +18,8 @@
 
 #ifdef _WINDOWS
 #include <windows.h>
+#include <sys/types.h>
+#include <sys/stat.h>
 
 #else
 // POSIX functions for searching directories
@@ -121,6 +123,30 @@ bool FileManage::isDirectory(const string &path)
 
 #endif
 
+#ifdef _WINDOWS
+bool FileManage::getModificationTime(const string &path,time_t &res)
+
+{
+  struct _stat buf;
+  if (_stat(path.c_str(),&buf) < 0)
+    return false;
+  res = buf.st_mtime;
+  return true;
+}
+
+#else
+bool FileManage::getModificationTime(const string &path,time_t &res)
+
+{
+  struct stat buf;
+  if (stat(path.c_str(),&buf) < 0)
+    return false;
+  res = buf.st_mtime;
+  return true;
+}
+
+#endif
+
 #ifdef _WINDOWS
 void FileManage::matchListDir(vector<string> &res,const string &match,bool isSuffix,const string &dirname,bool allowdot)
 
@@ -17,6 +17,8 @@
 #include "float.hh"
 #include <sstream>
 #include <cmath>
+#include <cstring>
+#include <limits>
 #include "address.hh"
 
 namespace GhidraDec {
@@ -73,6 +75,26 @@ FloatFormat::FloatFormat(int4 sz)
     jbitimplied = true;
   }
   maxexponent = (1<<exp_size)-1;
+  setHostMatch();
+}
+
+/// The host must use IEEE 754 \b float and \b double types, and the fields of \b this
+/// must be laid out exactly as binary32 or binary64.
+void FloatFormat::setHostMatch(void)
+
+{
+  hostmatch = host_none;
+  if (!numeric_limits<float>::is_iec559 || !numeric_limits<double>::is_iec559) return;
+  if (size == 4) {
+    if (signbit_pos == 31 && exp_pos == 23 && exp_size == 8 && frac_pos == 0 && frac_size == 23 &&
+	bias == 127 && jbitimplied)
+      hostmatch = host_binary32;
+  }
+  else if (size == 8) {
+    if (signbit_pos == 63 && exp_pos == 52 && exp_size == 11 && frac_pos == 0 && frac_size == 52 &&
+	bias == 1023 && jbitimplied)
+      hostmatch = host_binary64;
+  }
 }
 
 /// \param sign is set to \b true if the value should be negative
@@ -229,12 +251,83 @@ uintb FloatFormat::getNaNEncoding(bool sgn) const
   return setSign(res,sgn);
 }
 
+/// The encoding is reinterpreted as a host value.  NaNs are replaced with the host's
+/// quiet NaN, as in the general conversion.
+/// \param encoding is the encoding value
+/// \param type points to the floating-point class, which is passed back
+/// \return the equivalent double value
+double FloatFormat::getHostFloatNative(uintb encoding,floatclass *type) const
+
+{
+  int4 exp = extractExponentCode(encoding);
+  bool fraczero = (extractFractionalCode(encoding) == 0);
+  if (exp == maxexponent) {
+    if (!fraczero) {
+      *type = nan;
+      return extractSign(encoding) ? -NAN : +NAN;
+    }
+    *type = infinity;
+  }
+  else if (exp == 0)
+    *type = fraczero ? zero : denormalized;
+  else
+    *type = normalized;
+  if (hostmatch == host_binary32) {
+    uint4 bits = (uint4)encoding;
+    float res;
+    memcpy(&res,&bits,sizeof(res));
+    return res;
+  }
+  uint8 bits = encoding;
+  double res;
+  memcpy(&res,&bits,sizeof(res));
+  return res;
+}
+
+/// The fields are taken straight from the bits of the host value.  To match the general
+/// conversion, binary32 fractions are truncated rather than rounded, values too small for
+/// the exponent become zero, and NaNs become the default quiet NaN.
+/// \param host is the double value to convert
+/// \return the equivalent encoded value
+uintb FloatFormat::getEncodingNative(double host) const
+
+{
+  uint8 bits;
+  memcpy(&bits,&host,sizeof(bits));
+  bool sgn = ((bits >> 63) != 0);
+  int4 hostexp = (int4)((bits >> 52) & 0x7ff);
+  uint8 frac = bits & 0xfffffffffffffULL;
+  if (hostexp == 0x7ff)
+    return (frac != 0) ? getNaNEncoding(sgn) : getInfinityEncoding(sgn);
+  if (hostmatch == host_binary64) {
+    if ((hostexp == 0) && ((frac >> 51) == 0))	// Below the smallest value the general path keeps
+      return getZeroEncoding(sgn);
+    return bits;
+  }
+  if (hostexp == 0)		// Zero, or a host denormal far below the binary32 range
+    return getZeroEncoding(sgn);
+  int4 exp = hostexp - 1023 + bias;
+  if (exp < 0)			// Exponent is too small to represent
+    return getZeroEncoding(sgn);
+  if (exp > maxexponent)	// Exponent is too big to represent
+    return getInfinityEncoding(sgn);
+  uintb res;
+  if (exp == 0)
+    res = (frac >> 30) | (((uintb)1) << 22);	// Keep the integer bit
+  else
+    res = frac >> 29;
+  res = setExponentCode(res,(uintb)exp);
+  return setSign(res,sgn);
+}
+
 /// \param encoding is the encoding value
 /// \param type points to the floating-point class, which is passed back
 /// \return the equivalent double value
 double FloatFormat::getHostFloat(uintb encoding,floatclass *type) const
 
 {
+  if (hostmatch != host_none)
+    return getHostFloatNative(encoding,type);
   bool sgn = extractSign(encoding);
   uintb frac = extractFractionalCode(encoding);
   int4 exp = extractExponentCode(encoding);
@@ -279,6 +372,8 @@ double FloatFormat::getHostFloat(uintb encoding,floatclass *type) const
 uintb FloatFormat::getEncoding(double host) const
 
 {
+  if (hostmatch != host_none)
+    return getEncodingNative(host);
   floatclass type;
   bool sgn;
   uintb signif;
@@ -615,5 +710,6 @@ void FloatFormat::restoreXml(const Element *el)
   }
   jbitimplied = xml_readbool(el->getAttributeValue("jbitimplied"));
   maxexponent = (1<<exp_size)-1;
+  setHostMatch();
 }
 }
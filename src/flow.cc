@@ -14,6 +14,8 @@
  * limitations under the License.
  */
 #include "flow.hh"
+#include "tracespan.hh"
+#include "flowsummary.hh"
 
 namespace GhidraDec {
 /// Prepare for tracing flow for a new function.
@@ -37,7 +39,10 @@ FlowInfo::FlowInfo(Funcdata &d,PcodeOpBank &o,BlockGraph &b,vector<FuncCallSpecs
   inline_recursion = (set<Address> *)0;
   insn_count = 0;
   insn_max = ~((uint4)0);
-  flowoverride_present = data.getOverride().hasFlowOverride();
+  op_max = ~((uint4)0);
+  runnext = 0;
+  data.getOverride().getFlowOverrides(baddr,eaddr,flowoverlist);
+  flowoverride_present = !flowoverlist.empty();
 }
 
 /// Prepare a new flow cloned from an existing flow.
@@ -71,7 +76,11 @@ FlowInfo::FlowInfo(Funcdata &d,PcodeOpBank &o,BlockGraph &b,vector<FuncCallSpecs
     inline_recursion = (set<Address> *)0;
   insn_count = op2->insn_count;
   insn_max = op2->insn_max;
-  flowoverride_present = data.getOverride().hasFlowOverride();
+  op_max = op2->op_max;
+  regioncuts = op2->regioncuts;
+  runnext = 0;
+  data.getOverride().getFlowOverrides(baddr,eaddr,flowoverlist);
+  flowoverride_present = !flowoverlist.empty();
 }
 
 void FlowInfo::clearProperties(void)
@@ -81,6 +90,28 @@ void FlowInfo::clearProperties(void)
   insn_count = 0;
 }
 
+/// The overrides were fetched from the function's Override container, in one pass, when
+/// \b this flow was set up.
+/// \param addr is the address of the instruction
+/// \return the override type, or Override::NONE
+uint4 FlowInfo::findFlowOverride(const Address &addr) const
+
+{
+  int4 min = 0;
+  int4 max = flowoverlist.size() - 1;
+  while(min <= max) {
+    int4 mid = (min + max) / 2;
+    const Address &midaddr( flowoverlist[mid].first );
+    if (midaddr == addr)
+      return flowoverlist[mid].second;
+    if (midaddr < addr)
+      min = mid + 1;
+    else
+      max = mid - 1;
+  }
+  return Override::NONE;
+}
+
 /// For efficiency, this method assumes the given op can actually fall-thru.
 /// \param op is the given PcodeOp
 /// \return the PcodeOp that fall-thru flow would reach (or NULL if there is no possible p-code op)
@@ -96,13 +127,13 @@ PcodeOp *FlowInfo::fallthruOp(PcodeOp *op) const
       return retop;		// Then this is the fall thru
   }
   // Find address of instruction containing this op
-  map<Address,VisitStat>::const_iterator miter;
-  miter = visited.upper_bound(op->getAddr());
+  map<AddressKey,VisitStat>::const_iterator miter;
+  miter = visited.upper_bound(AddressKey(op->getAddr()));
   if (miter == visited.begin()) return (PcodeOp *)0;
   --miter;
-  if ((*miter).first + (*miter).second.size <= op->getAddr())
+  if ((*miter).first.getAddress(glb) + (*miter).second.size <= op->getAddr())
     return (PcodeOp *)0;
-  return target( (*miter).first + (*miter).second.size);
+  return target( (*miter).first.getAddress(glb) + (*miter).second.size);
 }
 
 /// The first p-code op associated with the machine instruction at the
@@ -114,9 +145,9 @@ PcodeOp *FlowInfo::fallthruOp(PcodeOp *op) const
 PcodeOp *FlowInfo::target(const Address &addr) const
 
 {
-  map<Address,VisitStat>::const_iterator iter;
+  map<AddressKey,VisitStat>::const_iterator iter;
 
-  iter = visited.find(addr);
+  iter = visited.find(AddressKey(addr));
   while(iter != visited.end()) {
     const SeqNum &seq( (*iter).second.seqnum );
     if (!seq.getAddr().isInvalid()) {
@@ -126,7 +157,7 @@ PcodeOp *FlowInfo::target(const Address &addr) const
       break;
     }
     // Visit fall thru address in case of no-op
-    iter = visited.find( (*iter).first + (*iter).second.size );
+    iter = visited.find(AddressKey((*iter).first.getAddress(glb) + (*iter).second.size));
   }
   ostringstream errmsg;
   errmsg << "Could not find op at target address: (";
@@ -160,11 +191,11 @@ PcodeOp *FlowInfo::findRelTarget(PcodeOp *op,Address &res) const
   retop = obank.findOp(seqnum1); // We go back one sequence number
   if (retop != (PcodeOp *)0) {
     // If the PcodeOp exists here then branch was indeed to next instruction
-    map<Address,VisitStat>::const_iterator miter;
-    miter = visited.upper_bound(retop->getAddr());
+    map<AddressKey,VisitStat>::const_iterator miter;
+    miter = visited.upper_bound(AddressKey(retop->getAddr()));
     if (miter != visited.begin()) {
       --miter;
-      res = (*miter).first + (*miter).second.size;
+      res = (*miter).first.getAddress(glb) + (*miter).second.size;
       if (op->getAddr() < res)
 	return (PcodeOp *)0;	// Indicate that res has the fallthru address
     }
@@ -390,6 +421,9 @@ bool FlowInfo::processInstruction(const Address &curaddr,bool &startbasic)
       }
     }
   }
+  // Once the p-code budget is spent, flow into any new instruction becomes the boundary of
+  // a separate region, which is left opaque here and can be decompiled on its own
+  bool cutregion = (insn_count < insn_max && obank.numDead() >= op_max);
   insn_count += 1;
 
   if (obank.empty())
@@ -400,49 +434,57 @@ bool FlowInfo::processInstruction(const Address &curaddr,bool &startbasic)
     --oiter;
   }
   if (flowoverride_present)
-    flowoverride = data.getOverride().getFlowOverride(curaddr);
+    flowoverride = findFlowOverride(curaddr);
   else
     flowoverride = Override::NONE;
 
-  try {
-    step = glb->translate->oneInstruction(emitter,curaddr); // Generate ops for instruction
+  if (cutregion) {
+    step = 1;
+    artificialHalt(curaddr,PcodeOp::badinstruction);
+    regioncuts.push_back(curaddr);
+    data.warning("P-code budget reached -- Region boundary here",curaddr);
   }
-  catch(UnimplError &err) {	// Instruction is unimplemented
-    if ((flags & ignore_unimplemented)!=0) {
-      step = err.instruction_length;
-      if (!hasUnimplemented()) {
-	flags |= unimplemented_present;
-	data.warningHeader("Control flow ignored unimplemented instructions");
-      }
+  else {
+    try {
+      step = translateInstruction(curaddr); // Generate ops for instruction
     }
-    else if ((flags & error_unimplemented)!=0)
-      throw err;		// rethrow
-    else {
-      // Add infinite loop instruction
-      step = 1;			// Pretend size 1
-      artificialHalt(curaddr,PcodeOp::unimplemented);
-      data.warning("Unimplemented instruction - Truncating control flow here",curaddr);
-      if (!hasUnimplemented()) {
-	flags |= unimplemented_present;
-	data.warningHeader("Control flow encountered unimplemented instructions");
+    catch(UnimplError &err) {	// Instruction is unimplemented
+      if ((flags & ignore_unimplemented)!=0) {
+	step = err.instruction_length;
+	if (!hasUnimplemented()) {
+	  flags |= unimplemented_present;
+	  data.warningHeader("Control flow ignored unimplemented instructions");
+	}
+      }
+      else if ((flags & error_unimplemented)!=0)
+	throw err;		// rethrow
+      else {
+	// Add infinite loop instruction
+	step = 1;			// Pretend size 1
+	artificialHalt(curaddr,PcodeOp::unimplemented);
+	data.warning("Unimplemented instruction - Truncating control flow here",curaddr);
+	if (!hasUnimplemented()) {
+	  flags |= unimplemented_present;
+	  data.warningHeader("Control flow encountered unimplemented instructions");
+	}
       }
     }
-  }
-  catch(BadDataError &err) {
-    if ((flags & error_unimplemented)!=0)
-      throw err;		// rethrow
-    else {
-      // Add infinite loop instruction
-      step = 1;			// Pretend size 1
-      artificialHalt(curaddr,PcodeOp::badinstruction);
-      data.warning("Bad instruction - Truncating control flow here",curaddr);
-      if (!hasBadData()) {
-	flags |= baddata_present;
-	data.warningHeader("Control flow encountered bad instruction data");
+    catch(BadDataError &err) {
+      if ((flags & error_unimplemented)!=0)
+	throw err;		// rethrow
+      else {
+	// Add infinite loop instruction
+	step = 1;			// Pretend size 1
+	artificialHalt(curaddr,PcodeOp::badinstruction);
+	data.warning("Bad instruction - Truncating control flow here",curaddr);
+	if (!hasBadData()) {
+	  flags |= baddata_present;
+	  data.warningHeader("Control flow encountered bad instruction data");
+	}
       }
     }
   }
-  VisitStat &stat(visited[curaddr]); // Mark that we visited this instruction
+  VisitStat &stat(visited[AddressKey(curaddr)]); // Mark that we visited this instruction
   stat.size = step;		// Record size of instruction
 
   if (curaddr < minaddr)	// Update minimum and maximum address
@@ -458,6 +500,7 @@ bool FlowInfo::processInstruction(const Address &curaddr,bool &startbasic)
   if (oiter != obank.endDead()) {
     stat.seqnum = (*oiter)->getSeqNum();
     data.opSetFlag(*oiter,PcodeOp::startmark); // Mark the first op in the instruction
+    linkUniques(oiter);
     if (flowoverride != Override::NONE)
       data.overrideFlow(curaddr,flowoverride);
     xrefControlFlow(oiter,startbasic,isfallthru,(FuncCallSpecs *)0);
@@ -468,6 +511,86 @@ bool FlowInfo::processInstruction(const Address &curaddr,bool &startbasic)
   return isfallthru;
 }
 
+/// \brief Link each read of a temporary to the write of the same temporary earlier in the instruction
+///
+/// SLEIGH temporaries in the \e unique space are almost always written and then read within
+/// a single instruction.  If the instruction's p-code is straight-line, a read whose storage
+/// exactly matches the latest write is given the written Varnode directly, which is what
+/// heritage would do, and the free Varnode is deleted.  Heritage then finds no free read in
+/// the range and skips it without placing phi-nodes or renaming.  If the instruction has an
+/// internal (relative) branch, its p-code is not straight-line and it is left to heritage, as
+/// are reads that only partially overlap a write.
+/// \param oiter points to the first op of the instruction in the \e dead list
+void FlowInfo::linkUniques(list<PcodeOp *>::const_iterator oiter)
+
+{
+  list<PcodeOp *>::const_iterator iter;
+
+  for(iter=oiter;iter!=obank.endDead();++iter) {
+    PcodeOp *op = *iter;
+    if (op->code() == CPUI_BRANCH || op->code() == CPUI_CBRANCH) {
+      if (op->getIn(0)->isConstant()) return;		// Relative branch within the instruction
+    }
+  }
+  uniquewrites.clear();
+  for(iter=oiter;iter!=obank.endDead();++iter) {
+    PcodeOp *op = *iter;
+    for(int4 slot=0;slot<op->numInput();++slot) {
+      Varnode *vn = op->getIn(slot);
+      if (vn->getSpace()->getType() != IPTR_INTERNAL || !vn->isFree()) continue;
+      for(int4 i=uniquewrites.size()-1;i>=0;--i) {
+	Varnode *outvn = uniquewrites[i];
+	if (outvn->getOffset() == vn->getOffset() && outvn->getSize() == vn->getSize() && outvn->getSpace() == vn->getSpace()) {
+	  data.opSetInput(op,outvn,slot);
+	  if (vn->hasNoDescend())
+	    data.deleteVarnode(vn);
+	  break;
+	}
+      }
+    }
+    Varnode *outvn = op->getOut();
+    if (outvn == (Varnode *)0 || outvn->getSpace()->getType() != IPTR_INTERNAL) continue;
+    int4 j = 0;
+    for(int4 i=0;i<uniquewrites.size();++i) {	// Remove any earlier write overlapped by this one
+      Varnode *prevvn = uniquewrites[i];
+      if (prevvn->getSpace() == outvn->getSpace() && prevvn->getOffset() < outvn->getOffset() + outvn->getSize() &&
+	  outvn->getOffset() < prevvn->getOffset() + prevvn->getSize())
+	continue;
+      uniquewrites[j++] = prevvn;
+    }
+    uniquewrites.resize(j);
+    uniquewrites.push_back(outvn);
+  }
+}
+
+/// If the instruction is the next one in the current PcodeRun, its p-code is replayed
+/// from there.  Otherwise a new run is translated, starting at the instruction and extending
+/// no further than the current fall-thru bound.  Errors for the instruction itself are
+/// thrown exactly as Translate::oneInstruction() would.
+/// \param curaddr is the address of the instruction
+/// \return the length of the instruction in bytes
+int4 FlowInfo::translateInstruction(const Address &curaddr)
+
+{
+  if (runnext < run.numInstructions() && run.getAddress(runnext) == curaddr) {
+    run.emit(runnext,emitter);
+    return run.getLength(runnext++);
+  }
+  uintb maxbytes = 1;
+  if (curaddr < runbound)
+    maxbytes = runbound.getOffset() - curaddr.getOffset();
+  if (maxbytes > 256)
+    maxbytes = 256;
+  uint4 maxinsn = insn_max - insn_count + 1;	// insn_count already includes this instruction
+  if (maxinsn > 64 || maxinsn == 0)
+    maxinsn = 64;
+  runnext = 0;
+  glb->translate->translateRun(run,curaddr,(int4)maxbytes,(int4)maxinsn);
+  run.emit(0,emitter);
+  runnext = 1;
+  return run.getLength(0);
+}
+
 /// From the address at the top of the \b addrlist stack
 /// Figure out how far we could follow fall-thru instructions
 /// before hitting something we've already seen
@@ -476,24 +599,24 @@ bool FlowInfo::processInstruction(const Address &curaddr,bool &startbasic)
 bool FlowInfo::setFallthruBound(Address &bound)
 
 {
-  map<Address,VisitStat>::const_iterator iter;
+  map<AddressKey,VisitStat>::const_iterator iter;
   const Address &addr( addrlist.back() );
 
-  iter = visited.upper_bound(addr); // First range greater than addr
+  iter = visited.upper_bound(AddressKey(addr)); // First range greater than addr
   if (iter!=visited.begin()) {
     --iter;			// Last range less than or equal to us
-    if (addr == (*iter).first) { // If we have already visited this address
+    if (addr == (*iter).first.getAddress(glb)) { // If we have already visited this address
       addrlist.pop_back();	// Throw it away
       PcodeOp *op = target(addr); // But make sure the address
       data.opSetFlag(op,PcodeOp::startbasic); // starts a basic block
       return false;
     }
-    if (addr < (*iter).first + (*iter).second.size)
+    if (addr < (*iter).first.getAddress(glb) + (*iter).second.size)
       reinterpreted(addr);
     ++iter;
   }
   if (iter!=visited.end())	// Whats the maximum distance we can go
-    bound = (*iter).first;
+    bound = (*iter).first.getAddress(glb);
   else
     bound = eaddr;
   return true;
@@ -535,6 +658,9 @@ void FlowInfo::fallthru(void)
   Address bound;
 
   if (!setFallthruBound(bound)) return;
+  run.clear();			// Context may have changed since the last sequence was translated
+  runnext = 0;
+  runbound = bound;
 
   Address curaddr;
   bool startbasic = true;
@@ -562,6 +688,7 @@ void FlowInfo::fallthru(void)
 	break;
       }
       if (!setFallthruBound(bound)) return; // Reset bound
+      runbound = bound;
     }
   }
 }
@@ -593,12 +720,12 @@ PcodeOp *FlowInfo::artificialHalt(const Address &addr,uint4 flag)
 void FlowInfo::reinterpreted(const Address &addr)
 
 {
-  map<Address,VisitStat>::const_iterator iter;
+  map<AddressKey,VisitStat>::const_iterator iter;
 
-  iter = visited.upper_bound(addr);
+  iter = visited.upper_bound(AddressKey(addr));
   if (iter==visited.begin()) return; // Should never happen
   --iter;
-  const Address &addr2( (*iter).first );
+  Address addr2( (*iter).first.getAddress(glb) );
   ostringstream s;
 
   s << "Instruction at (" << addr.getSpace()->getName() << ',';
@@ -639,12 +766,20 @@ bool FlowInfo::checkForFlowModification(FuncCallSpecs &fspecs)
 
 /// If there is an explicit target address for the given call site,
 /// attempt to look up the function and adjust information in the FuncCallSpecs call site object.
+/// If the prototype is not overridden and the function doesn't have a locked prototype of its own,
+/// a summary matching the bytes of the function is applied, if there is one (see FlowSummaryDb).
 /// \param fspecs is the call site object
 void FlowInfo::queryCall(FuncCallSpecs &fspecs)
 
 {
   if (!fspecs.getEntryAddress().isInvalid()) { // If this is a direct call
     Funcdata *otherfunc = data.getScopeLocal()->getParent()->queryFunction( fspecs.getEntryAddress() );
+    if (glb->flowsummary != (FlowSummaryDb *)0 && !fspecs.hasModel() &&
+	(otherfunc == (Funcdata *)0 || !otherfunc->getFuncProto().isInputLocked())) {
+      const FuncProto *summary = glb->flowsummary->lookup(fspecs.getEntryAddress());
+      if (summary != (const FuncProto *)0)
+	fspecs.copy(*summary);	// Applied like a prototype override
+    }
     if (otherfunc != (Funcdata *)0) {
       fspecs.setFuncdata(otherfunc); // Associate the symbol with the callsite
       if (!fspecs.hasModel()) {	// If the prototype was not overridden
@@ -747,10 +882,16 @@ bool FlowInfo::isInArray(vector<PcodeOp *> &array,PcodeOp *op)
   return false;
 }
 
+/// Pending jump-tables are recovered together, from a single partial function, whenever
+/// there is more than one (see Funcdata::recoverJumpTables()).  A table that can't be recovered
+/// as part of a set is tried again by itself, once the flow from the rest of the set is in.
 void FlowInfo::generateOps(void)
 
 {
+  static const int4 traceid = TraceLog::registerKind("generateOps","flow");
+  TraceSpan span(traceid,&data.getName());
   vector<PcodeOp *> notreached;	// indirect ops that are not reachable
+  vector<PcodeOp *> single;	// indirect ops to retry by themselves
   int4 notreachcnt = 0;
   clearProperties();
   addrlist.push_back(data.getAddress());
@@ -758,28 +899,49 @@ void FlowInfo::generateOps(void)
     fallthru();
   do {
     bool collapsed_jumptable = false;
-    while(!tablelist.empty()) {	// For each jumptable found
-      PcodeOp *op = tablelist.back();
-      tablelist.pop_back();
-      int4 failuremode;
-      JumpTable *jt = data.recoverJumpTable(op,this,failuremode); // Recover it
-      if (jt == (JumpTable *)0) { // Could not recover jumptable
-	if ((failuremode == 3) && (!tablelist.empty()) && (!isInArray(notreached,op))) {
-	   // If the indirect op was not reachable with current flow AND there is more flow to generate,
-	  //     AND we haven't tried to recover this table before
-	  notreached.push_back(op); // Save this op so we can try to recovery table again later
-	}
-	else if (!isFlowForInline())	// Unless this flow is being inlined for something else
-	  truncateIndirectJump(op,failuremode); // Treat the indirect jump as a call
+    while(!tablelist.empty() || !single.empty()) {	// For each jumptable found
+      vector<PcodeOp *> ops;
+      if (!single.empty()) {
+	ops.push_back(single.back());
+	single.pop_back();
+      }
+      else if (tablelist.size() > 1) {
+	ops.assign(tablelist.rbegin(),tablelist.rend());	// In the order they would be popped
+	tablelist.clear();
       }
       else {
-	int4 num = jt->numEntries();
-	for(int4 i=0;i<num;++i)
-	  newAddress(op,jt->getAddressByIndex(i));
-	if (jt->isPossibleMultistage())
-	  collapsed_jumptable = true;
-	while(!addrlist.empty())	// Try to fill in as much more as possible
-	  fallthru();
+	ops.push_back(tablelist.back());
+	tablelist.pop_back();
+      }
+      vector<JumpTable *> jts;
+      vector<int4> failuremodes;
+      data.recoverJumpTables(ops,this,jts,failuremodes); // Recover them
+      for(int4 k=0;k<ops.size();++k) {
+	PcodeOp *op = ops[k];
+	JumpTable *jt = jts[k];
+	int4 failuremode = failuremodes[k];
+	if (jt == (JumpTable *)0 && ops.size() > 1) {
+	  single.push_back(op);	// Try again by itself, with the flow from the rest of the set
+	  continue;
+	}
+	if (jt == (JumpTable *)0) { // Could not recover jumptable
+	  if ((failuremode == 3) && (!tablelist.empty() || !single.empty()) && (!isInArray(notreached,op))) {
+	     // If the indirect op was not reachable with current flow AND there is more flow to generate,
+	    //     AND we haven't tried to recover this table before
+	    notreached.push_back(op); // Save this op so we can try to recovery table again later
+	  }
+	  else if (!isFlowForInline())	// Unless this flow is being inlined for something else
+	    truncateIndirectJump(op,failuremode); // Treat the indirect jump as a call
+	}
+	else {
+	  int4 num = jt->numEntries();
+	  for(int4 i=0;i<num;++i)
+	    newAddress(op,jt->getAddressByIndex(i));
+	  if (jt->isPossibleMultistage())
+	    collapsed_jumptable = true;
+	  while(!addrlist.empty())	// Try to fill in as much more as possible
+	    fallthru();
+	}
       }
     }
     
@@ -799,8 +961,7 @@ void FlowInfo::generateBlocks(void)
 
 {
   fillinBranchStubs();
-  collectEdges();
-  splitBasic();		// Split ops up into basic blocks
+  splitBasic();		// Split ops up into basic blocks, collecting edges as we go
   connectBasic();		// Generate edges between basic blocks
   if (bblocks.getSize()!=0) {
     FlowBlock *startblock = bblocks.getBlock(0);
@@ -875,90 +1036,75 @@ void FlowInfo::fillinBranchStubs(void)
 
 /// An edge is held as matching PcodeOp entries in \b block_edge1 and \b block_edge2.
 /// Edges are generated for fall-thru to a p-code op marked as the start of a basic block
-/// or for an explicit branch.
-void FlowInfo::collectEdges(void)
+/// or for an explicit branch.  The op must still be in the \e dead list.
+/// \param op is the p-code op whose outgoing edges are collected
+/// \param nextstart is \b true if the op following \b op starts a basic block
+void FlowInfo::collectEdges(PcodeOp *op,bool nextstart)
 
 {
-  list<PcodeOp *>::const_iterator iter,iterend,iter1,iter2;
-  PcodeOp *op,*targ_op;
+  PcodeOp *targ_op;
   JumpTable *jt;
-  bool nextstart;
-  int4 i,num;
-
-  if (bblocks.getSize() != 0)
-    throw RecovError("Basic blocks already calculated\n");
+  int4 i,num,first;
 
-  iter = obank.beginDead();
-  iterend = obank.endDead();
-  while(iter!=iterend) {
-    op = *iter++;
-    if (iter==iterend)
-      nextstart = true;
-    else
-      nextstart = (*iter)->isBlockStart();
-    switch(op->code()) {
-    case CPUI_BRANCH:
-      targ_op = branchTarget(op);
-      block_edge1.push_back(op);
-      //      block_edge2.push_back(op->Input(0)->getAddr().Iop());
-      block_edge2.push_back(targ_op);
-      break;
-    case CPUI_BRANCHIND:
-      jt = data.findJumpTable(op);
-      if (jt == (JumpTable *)0) break;
+  switch(op->code()) {
+  case CPUI_BRANCH:
+    targ_op = branchTarget(op);
+    block_edge1.push_back(op);
+    block_edge2.push_back(targ_op);
+    break;
+  case CPUI_BRANCHIND:
+    jt = data.findJumpTable(op);
+    if (jt == (JumpTable *)0) break;
 				// If we are in this routine and there is no table
 				// Then we must be doing partial flow analysis
 				// so assume there are no branches out
-      num = jt->numEntries();
-      for(i=0;i<num;++i) {
-	targ_op = target(jt->getAddressByIndex(i));
-	if (targ_op->isMark()) continue; // Already a link between these blocks
-	targ_op->setMark();
-	block_edge1.push_back(op);
-	block_edge2.push_back(targ_op);
-      }
-      iter1 = block_edge1.end(); // Clean up our marks
-      iter2 = block_edge2.end();
-      while(iter1 != block_edge1.begin()) {
-	--iter1;
-	--iter2;
-	if ((*iter1)==op)
-	  (*iter2)->clearMark();
-	else
-	  break;
-      }
-      break;
-    case CPUI_RETURN:
-      break;
-    case CPUI_CBRANCH:
-      targ_op = fallthruOp(op); // Put in fallthru edge
+    first = block_edge2.size();
+    num = jt->numEntries();
+    for(i=0;i<num;++i) {
+      targ_op = target(jt->getAddressByIndex(i));
+      if (targ_op->isMark()) continue; // Already a link between these blocks
+      targ_op->setMark();
       block_edge1.push_back(op);
       block_edge2.push_back(targ_op);
-      targ_op = branchTarget(op);
+    }
+    for(i=first;i<block_edge2.size();++i) // Clean up our marks
+      block_edge2[i]->clearMark();
+    break;
+  case CPUI_RETURN:
+    break;
+  case CPUI_CBRANCH:
+    targ_op = fallthruOp(op); // Put in fallthru edge
+    block_edge1.push_back(op);
+    block_edge2.push_back(targ_op);
+    targ_op = branchTarget(op);
+    block_edge1.push_back(op);
+    block_edge2.push_back(targ_op);
+    break;
+  default:
+    if (nextstart) {		// Put in fallthru edge if new basic block
+      targ_op = fallthruOp(op);
       block_edge1.push_back(op);
       block_edge2.push_back(targ_op);
-      break;
-    default:
-      if (nextstart) {		// Put in fallthru edge if new basic block
-	targ_op = fallthruOp(op);
-	block_edge1.push_back(op);
-	block_edge2.push_back(targ_op);
-      }
-      break;
     }
+    break;
   }
 }
 
 /// PcodeOp objects are moved out of the PcodeOpBank \e dead list into their
 /// assigned PcodeBlockBasic.  Initial address ranges of instructions are recorded in the block.
 /// PcodeBlockBasic objects are created based on p-code ops that have been
-/// previously marked as \e start of basic block.
+/// previously marked as \e start of basic block.  The edges out of each op are collected
+/// in the same pass, just before the op is moved.
 void FlowInfo::splitBasic(void)
 
 {
   PcodeOp *op;
   BlockBasic *cur;
   list<PcodeOp *>::const_iterator iter,iterend;
+  bool nextstart;
+
+  if (bblocks.getSize() != 0)
+    throw RecovError("Basic blocks already calculated\n");
 
   iter = obank.beginDead();
   iterend = obank.endDead();
@@ -967,11 +1113,14 @@ void FlowInfo::splitBasic(void)
   if (!op->isBlockStart())
     throw LowlevelError("First op not marked as entry point");
   cur = bblocks.newBlockBasic(&data);
-  data.opInsert(op,cur,cur->endOp());
   bblocks.setStartBlock(cur);
   Address start = op->getAddr();
   Address stop = start;
-  while(iter != iterend) {
+  for(;;) {
+    nextstart = (iter == iterend) ? true : (*iter)->isBlockStart();
+    collectEdges(op,nextstart);
+    data.opInsert(op,cur,cur->endOp());
+    if (iter == iterend) break;
     op = *iter++;
     if (op->isBlockStart()) {
       data.setBasicBlockRange(cur, start, stop);
@@ -984,7 +1133,6 @@ void FlowInfo::splitBasic(void)
       if (stop < nextAddr)
 	stop = nextAddr;
     }
-    data.opInsert(op,cur,cur->endOp());
   }
   data.setBasicBlockRange(cur, start, stop);
 }
@@ -994,19 +1142,10 @@ void FlowInfo::splitBasic(void)
 void FlowInfo::connectBasic(void)
 
 {
-  PcodeOp *op,*targ_op;
-  BlockBasic *bs,*targ_bs;
-  list<PcodeOp *>::const_iterator iter,iter2;
-
-  iter = block_edge1.begin();
-  iter2 = block_edge2.begin();
-  while(iter != block_edge1.end()) {
-    op = *iter++;
-    targ_op = *iter2++;
-    bs = op->getParent();
-    targ_bs = targ_op->getParent();
-    bblocks.addEdge(bs,targ_bs);
-  }
+  for(int4 i=0;i<block_edge1.size();++i)
+    bblocks.addEdge(block_edge1[i]->getParent(),block_edge2[i]->getParent());
+  block_edge1.clear();
+  block_edge2.clear();
 }
 
 /// When preparing p-code for an in-lined function, the generation process needs
@@ -1179,7 +1318,7 @@ void FlowInfo::doInjection(InjectPayload *payload,InjectContext &icontext,PcodeO
 
   obank.moveSequenceDead(firstop,lastop,op); // Move the injection to right after the call
 
-  map<Address,VisitStat>::iterator viter = visited.find(op->getAddr());
+  map<AddressKey,VisitStat>::iterator viter = visited.find(AddressKey(op->getAddr()));
   if (viter != visited.end()) {				// Check if -op- is a possible branch target
     if ((*viter).second.seqnum == op->getSeqNum())	// (if injection op is the first op for its address)
       (*viter).second.seqnum = firstop->getSeqNum();	//    change the seqnum to the first injected op
@@ -1342,13 +1481,13 @@ void FlowInfo::checkContainedCall(void)
     if (op->code() != CPUI_CALL) continue;
 
     const Address &addr( fc->getEntryAddress() );
-    map<Address,VisitStat>::const_iterator miter;
-    miter = visited.upper_bound(addr);
+    map<AddressKey,VisitStat>::const_iterator miter;
+    miter = visited.upper_bound(AddressKey(addr));
     if (miter == visited.begin()) continue;
     --miter;
-    if ((*miter).first + (*miter).second.size <= addr)
+    if ((*miter).first.getAddress(glb) + (*miter).second.size <= addr)
       continue;
-    if ((*miter).first == addr) {
+    if ((*miter).first.getAddress(glb) == addr) {
       ostringstream s;
       s << "Possible PIC construction at ";
       op->getAddr().printRaw(s);
@@ -0,0 +1,294 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "flowsummary.hh"
+
+#include <fstream>
+#include <iomanip>
+#include <cstring>
+
+namespace GhidraDec {
+
+/// \param g is the Architecture using the database
+/// \param fname is the file holding the database, which is created by save() if it doesn't exist
+FlowSummaryDb::FlowSummaryDb(Architecture *g,const string &fname)
+
+{
+  glb = g;
+  filename = fname;
+  numsummaries = 0;
+  ifstream s(filename.c_str());
+  if (!s) return;
+  Document *doc = xml_tree(s);
+  try {
+    restoreXml(doc->getRoot());
+  }
+  catch(...) {
+    delete doc;
+    throw;
+  }
+  delete doc;
+}
+
+FlowSummaryDb::~FlowSummaryDb(void)
+
+{
+  map<string,vector<Summary *> >::iterator iter;
+  for(iter=index.begin();iter!=index.end();++iter) {
+    vector<Summary *> &list((*iter).second);
+    for(int4 i=0;i<list.size();++i) {
+      delete list[i]->proto;
+      delete list[i];
+    }
+  }
+  for(int4 i=0;i<shortsummaries.size();++i) {
+    delete shortsummaries[i]->proto;
+    delete shortsummaries[i];
+  }
+}
+
+/// \param bytes are the bytes of the signature
+/// \return the summary, or null if there is none
+FlowSummaryDb::Summary *FlowSummaryDb::find(const string &bytes) const
+
+{
+  const vector<Summary *> *list;
+  if (bytes.size() < prefixsize)
+    list = &shortsummaries;
+  else {
+    map<string,vector<Summary *> >::const_iterator iter = index.find(bytes.substr(0,prefixsize));
+    if (iter == index.end()) return (Summary *)0;
+    list = &(*iter).second;
+  }
+  for(int4 i=0;i<list->size();++i) {
+    if ((*list)[i]->bytes == bytes)
+      return (*list)[i];
+  }
+  return (Summary *)0;
+}
+
+/// A summary matches if its bytes are a prefix of the given bytes.  If more than one matches,
+/// the longest (most specific) one is returned.
+/// \param buf holds the bytes at a function's entry point
+/// \param size is the number of bytes available
+/// \return the matching summary, or null if there is none
+FlowSummaryDb::Summary *FlowSummaryDb::match(const uint1 *buf,int4 size) const
+
+{
+  Summary *res = (Summary *)0;
+  if (size >= prefixsize) {
+    map<string,vector<Summary *> >::const_iterator iter = index.find(string((const char *)buf,prefixsize));
+    if (iter != index.end()) {
+      const vector<Summary *> &list((*iter).second);
+      for(int4 i=0;i<list.size();++i) {
+	const string &bytes(list[i]->bytes);
+	if (bytes.size() > size) continue;
+	if (res != (Summary *)0 && bytes.size() <= res->bytes.size()) continue;
+	if (memcmp(bytes.data(),buf,bytes.size()) == 0)
+	  res = list[i];
+      }
+    }
+  }
+  if (res != (Summary *)0) return res;
+  for(int4 i=0;i<shortsummaries.size();++i) {
+    const string &bytes(shortsummaries[i]->bytes);
+    if (bytes.size() > size) continue;
+    if (res != (Summary *)0 && bytes.size() <= res->bytes.size()) continue;
+    if (memcmp(bytes.data(),buf,bytes.size()) == 0)
+      res = shortsummaries[i];
+  }
+  return res;
+}
+
+/// \param sum is the new summary, which \b this takes ownership of
+void FlowSummaryDb::insert(Summary *sum)
+
+{
+  if (sum->bytes.size() < prefixsize)
+    shortsummaries.push_back(sum);
+  else
+    index[sum->bytes.substr(0,prefixsize)].push_back(sum);
+  numsummaries += 1;
+}
+
+/// The signature covers the instructions that follow on from the entry point within the basic
+/// blocks of the function, so a thunk's signature is just its jump, and it is cut off at
+/// \b maxsignature bytes.
+/// \param fd is the decompiled function
+/// \return the number of bytes, or 0 if no code could be found at the entry point
+int4 FlowSummaryDb::signatureLength(const Funcdata *fd) const
+
+{
+  RangeList code;
+  const BlockGraph &graph(fd->getBasicBlocks());
+  for(int4 i=0;i<graph.getSize();++i)
+    code.merge(((const BlockBasic *)graph.getBlock(i))->getCover());
+  Address addr = fd->getAddress();
+  int4 len = 0;
+  try {
+    while(len < maxsignature && code.inRange(addr,1)) {
+      int4 insnlen = glb->translate->instructionLength(addr);
+      if (insnlen <= 0) break;
+      len += insnlen;
+      addr = addr + insnlen;
+    }
+  }
+  catch(LowlevelError &err) {	// Stop at anything that can't be decoded
+  }
+  return (len > maxsignature) ? maxsignature : len;
+}
+
+/// \param el is the \<flowsummaries> element
+void FlowSummaryDb::restoreXml(const Element *el)
+
+{
+  const List &list(el->getChildren());
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter) {
+    const Element *subel = *iter;
+    if (subel->getName() != "summary") continue;
+    const string &hexbytes(subel->getAttributeValue("bytes"));
+    string bytes;
+    for(int4 i=0;i+1<hexbytes.size();i+=2) {
+      int4 val;
+      istringstream s(hexbytes.substr(i,2));
+      s >> hex >> val;
+      if (!s)
+	throw LowlevelError("Bad bytes in flow summary: " + hexbytes);
+      bytes += (char)val;
+    }
+    if (bytes.empty() || subel->getChildren().empty())
+      throw LowlevelError("Empty flow summary");
+    Summary *sum = new Summary;
+    sum->bytes = bytes;
+    sum->proto = new FuncProto();
+    sum->proto->setInternal(glb->defaultfp,glb->types->getTypeVoid());
+    try {
+      sum->proto->restoreXml(subel->getChildren().front(),glb);
+    }
+    catch(LowlevelError &err) {
+      delete sum->proto;
+      delete sum;
+      throw;
+    }
+    Summary *old = find(bytes);
+    if (old != (Summary *)0) {	// Later summaries replace earlier ones
+      delete old->proto;
+      old->proto = sum->proto;
+      delete sum;
+    }
+    else
+      insert(sum);
+  }
+}
+
+/// The bytes at the address are read from the LoadImage.  The summary whose whole signature
+/// matches the most bytes is returned.
+/// \param addr is the entry point of the function
+/// \return the prototype of the function, or null if it has no summary
+const FuncProto *FlowSummaryDb::lookup(const Address &addr) const
+
+{
+  if (numsummaries == 0) return (const FuncProto *)0;
+  uint1 buf[maxsignature];
+  int4 size = maxsignature;
+  try {
+    glb->loader->loadFill(buf,size,addr);
+  }
+  catch(DataUnavailError &err) {	// The full window may run off the end of the image
+    size = 0;
+  }
+  if (size == 0) {
+    // Fall back to the shortest window that still holds a whole prefix
+    size = prefixsize;
+    try {
+      glb->loader->loadFill(buf,size,addr);
+    }
+    catch(DataUnavailError &err) {
+      return (const FuncProto *)0;
+    }
+  }
+  Summary *sum = match(buf,size);
+  if (sum == (Summary *)0) return (const FuncProto *)0;
+  return sum->proto;
+}
+
+/// Only functions whose input and output are both locked, so that their prototype is known
+/// rather than recovered, are recorded.  An existing summary with the same bytes is replaced.
+/// \param fd is the decompiled function
+/// \return \b true if a summary was recorded
+bool FlowSummaryDb::record(const Funcdata *fd)
+
+{
+  const FuncProto &fp(fd->getFuncProto());
+  if (!fp.isInputLocked() || !fp.isOutputLocked()) return false;
+  int4 len = signatureLength(fd);
+  if (len == 0) return false;
+  uint1 buf[maxsignature];
+  try {
+    glb->loader->loadFill(buf,len,fd->getAddress());
+  }
+  catch(DataUnavailError &err) {
+    return false;
+  }
+  PrototypePieces pieces;
+  fp.getPieces(pieces);
+  FuncProto *proto = new FuncProto();
+  proto->setInternal(pieces.model,glb->types->getTypeVoid());
+  proto->setPieces(pieces);
+  proto->setExtraPop(fp.getExtraPop());
+  proto->setNoReturn(fp.isNoReturn());
+  proto->setInline(fp.isInline());
+  proto->copyEffects(fp);
+
+  string bytes((const char *)buf,len);
+  Summary *old = find(bytes);
+  if (old != (Summary *)0) {
+    delete old->proto;
+    old->proto = proto;
+    return true;
+  }
+  Summary *sum = new Summary;
+  sum->bytes = bytes;
+  sum->proto = proto;
+  insert(sum);
+  return true;
+}
+
+void FlowSummaryDb::save(void) const
+
+{
+  ofstream s(filename.c_str(),ios::out | ios::trunc);
+  if (!s)
+    throw LowlevelError("Unable to write flow summaries to " + filename);
+  vector<const Summary *> all;
+  map<string,vector<Summary *> >::const_iterator iter;
+  for(iter=index.begin();iter!=index.end();++iter)
+    all.insert(all.end(),(*iter).second.begin(),(*iter).second.end());
+  all.insert(all.end(),shortsummaries.begin(),shortsummaries.end());
+  s << "<flowsummaries>\n";
+  for(int4 i=0;i<all.size();++i) {
+    s << "<summary bytes=\"";
+    const string &bytes(all[i]->bytes);
+    for(int4 j=0;j<bytes.size();++j)
+      s << hex << setfill('0') << setw(2) << (int4)(uint1)bytes[j];
+    s << dec << "\">\n";
+    all[i]->proto->saveXml(s);
+    s << "</summary>\n";
+  }
+  s << "</flowsummaries>\n";
+}
+
+} // namespace GhidraDec
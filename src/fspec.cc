@@ -26,6 +26,29 @@ void ParamEntry::resolveJoin(void)
     joinrec = (JoinRecord *)0;
 }
 
+/// The JoinRecords for the last two logical sizes requested are kept, so the join space
+/// doesn't need to be searched for the sizes a model asks for over and over.
+/// \param sz is the logical size of the value, which must be smaller than the entry
+/// \return the address of the logical value in the \e join space
+Address ParamEntry::getFloatExtensionAddr(int4 sz) const
+
+{
+  for(int4 i=0;i<2;++i) {
+    if (floatextjoin[i] != (JoinRecord *)0 && floatextsize[i] == sz)
+      return floatextjoin[i]->getUnified().getAddr();
+  }
+  vector<VarnodeData> pieces(1);
+  pieces[0].space = spaceid;
+  pieces[0].offset = addressbase;
+  pieces[0].size = size;
+  JoinRecord *rec = spaceid->getManager()->findAddJoin(pieces,sz);
+  floatextsize[1] = floatextsize[0];	// Keep the most recent record first
+  floatextjoin[1] = floatextjoin[0];
+  floatextsize[0] = sz;
+  floatextjoin[0] = rec;
+  return rec->getUnified().getAddr();
+}
+
 /// \brief Construct entry from components
 ///
 /// \param t is the data-type class (TYPE_UNKNOWN or TYPE_FLOAT)
@@ -54,6 +77,7 @@ ParamEntry::ParamEntry(type_metatype t,int4 grp,int4 grpsize,const Address &loc,
     numslots = 1;
   if (!normalstack)
     flags |= reverse_stack;
+  floatextjoin[0] = floatextjoin[1] = (JoinRecord *)0;
   resolveJoin();
 }
 
@@ -249,11 +273,8 @@ Address ParamEntry::getAddrBySlot(int4 &slotnum,int4 sz) const
     if (sz > size) return res;	// Check on maximum size
     res = Address(spaceid,addressbase);	// Get base address of the slot
     spaceused = size;
-    if (((flags & smallsize_floatext)!=0)&&(sz != size)) { // Do we have an implied floating-point extension
-      AddrSpaceManager *manager = spaceid->getManager();
-      res = manager->constructFloatExtensionAddress(res,size,sz);
-      return res;
-    }
+    if (((flags & smallsize_floatext)!=0)&&(sz != size)) // Do we have an implied floating-point extension
+      return getFloatExtensionAddr(sz);
   }
   else {
     int4 slotsused = sz / alignment; // How many slots does a -sz- byte object need
@@ -1534,6 +1555,140 @@ void EffectRecord::restoreXml(uint4 grouptype,const Element *el,const AddrSpaceM
   address.restoreXml(el,manage);
 }
 
+/// Each data-type contributes its meta-type and size, which are all that the resource
+/// lists look at when assigning storage.
+/// \param typelist is the list of data-types from the function prototype
+/// \param ignoreOutputError is \b true if problems assigning the output parameter are ignored
+/// \param key will hold the packed description
+void ParamMemo::buildStorageKey(const vector<Datatype *> &typelist,bool ignoreOutputError,Key &key)
+
+{
+  key.clear();
+  key.push_back(ignoreOutputError ? 1 : 0);
+  for(int4 i=0;i<typelist.size();++i) {
+    Datatype *ct = typelist[i];
+    key.push_back((((uintb)ct->getMetatype()) << 32) | (uint4)ct->getSize());
+  }
+}
+
+/// Each trial contributes its storage, slot, properties, and any model entry already
+/// associated with it.
+/// \param active is the set of trials before mapping
+/// \param key will hold the packed description
+void ParamMemo::buildTrialKey(const ParamActive *active,Key &key)
+
+{
+  key.clear();
+  key.push_back(active->recoversubcall ? 1 : 0);
+  for(int4 i=0;i<active->trial.size();++i) {
+    const ParamTrial &paramtrial(active->trial[i]);
+    key.push_back((uintb)(uintp)paramtrial.addr.getSpace());
+    key.push_back(paramtrial.addr.getOffset());
+    key.push_back((((uintb)(uint4)paramtrial.size) << 32) | (uint4)paramtrial.slot);
+    key.push_back((((uintb)paramtrial.flags) << 32) | (uint4)paramtrial.offset);
+    key.push_back((uintb)(uintp)paramtrial.entry);
+  }
+}
+
+/// If the question has been answered before, the storage is rebuilt for the given data-types,
+/// creating any pointer data-type that the model substituted for a parameter.
+/// \param key is the packed description of the prototype
+/// \param typelist is the list of data-types from the function prototype
+/// \param typefactory is the factory used to create pointer data-types
+/// \param res will hold the storage locations for each parameter
+/// \return \b true if the answer was found
+bool ParamMemo::findStorage(const Key &key,const vector<Datatype *> &typelist,TypeFactory &typefactory,
+			    vector<ParameterPieces> &res) const
+
+{
+  map<Key,vector<Piece> >::const_iterator iter = storage.find(key);
+  if (iter == storage.end()) return false;
+  const vector<Piece> &piecelist((*iter).second);
+  res.resize(piecelist.size());
+  for(int4 i=0;i<piecelist.size();++i) {
+    const Piece &piece(piecelist[i]);
+    res[i].addr = piece.addr;
+    res[i].flags = piece.flags;
+    if (piece.source == source_void)
+      res[i].type = typefactory.getTypeVoid();
+    else if (piece.ptrsize != 0)
+      res[i].type = typefactory.getTypePointerAbsolute(piece.ptrsize,typelist[piece.source],piece.ptrwordsize);
+    else
+      res[i].type = typelist[piece.source];
+  }
+  return true;
+}
+
+/// Each data-type in the answer is recorded as an index into the prototype, possibly wrapped
+/// in a pointer.  An answer containing any other data-type is not remembered.
+/// \param key is the packed description of the prototype
+/// \param typelist is the list of data-types from the function prototype
+/// \param res is the storage assigned to each parameter
+void ParamMemo::recordStorage(const Key &key,const vector<Datatype *> &typelist,const vector<ParameterPieces> &res)
+
+{
+  vector<Piece> piecelist(res.size());
+  for(int4 i=0;i<res.size();++i) {
+    Piece &piece(piecelist[i]);
+    Datatype *ct = res[i].type;
+    piece.addr = res[i].addr;
+    piece.flags = res[i].flags;
+    piece.ptrsize = 0;
+    piece.ptrwordsize = 1;
+    piece.source = source_void;
+    Datatype *base = ct;
+    if (find(typelist.begin(),typelist.end(),ct) == typelist.end()) {
+      if (ct->getMetatype() == TYPE_PTR) {
+	piece.ptrsize = ct->getSize();
+	piece.ptrwordsize = ((TypePointer *)ct)->getWordSize();
+	base = ((TypePointer *)ct)->getPtrTo();
+      }
+      else if (ct->getMetatype() != TYPE_VOID)
+	return;			// Not built from the prototype, don't remember
+    }
+    vector<Datatype *>::const_iterator iter = find(typelist.begin(),typelist.end(),base);
+    if (iter != typelist.end())
+      piece.source = iter - typelist.begin();
+    else if (piece.ptrsize != 0)
+      return;			// Pointer to something outside the prototype, don't remember
+  }
+  if (storage.size() >= maxentries)
+    storage.clear();
+  storage[key] = piecelist;
+}
+
+/// If the question has been answered before, the trials are replaced with the mapped trials,
+/// and slots are used up for any trials the mapping added.
+/// \param isinput is \b true for an input mapping, \b false for an output mapping
+/// \param key is the packed description of the trials
+/// \param active is the set of trials to map
+/// \return \b true if the answer was found
+bool ParamMemo::findTrials(bool isinput,const Key &key,ParamActive *active) const
+
+{
+  const map<Key,TrialMap> &table(isinput ? inputmap : outputmap);
+  map<Key,TrialMap>::const_iterator iter = table.find(key);
+  if (iter == table.end()) return false;
+  active->trial = (*iter).second.trial;
+  active->slotbase += (*iter).second.numregistered;
+  return true;
+}
+
+/// \param isinput is \b true for an input mapping, \b false for an output mapping
+/// \param key is the packed description of the trials before mapping
+/// \param active is the set of trials after mapping
+/// \param oldnum is the number of trials before mapping
+void ParamMemo::recordTrials(bool isinput,const Key &key,const ParamActive *active,int4 oldnum)
+
+{
+  map<Key,TrialMap> &table(isinput ? inputmap : outputmap);
+  if (table.size() >= maxentries)
+    table.clear();
+  TrialMap &trialmap(table[key]);
+  trialmap.trial = active->trial;
+  trialmap.numregistered = active->trial.size() - oldnum;
+}
+
 void ProtoModel::defaultLocalRange(void)
 
 {
@@ -1685,6 +1840,13 @@ ProtoModel::~ProtoModel(void)
 void ProtoModel::assignParameterStorage(const vector<Datatype *> &typelist,vector<ParameterPieces> &res,bool ignoreOutputError)
 
 {
+  bool memoize = res.empty();	// Only a complete answer can be remembered
+  ParamMemo::Key key;
+  if (memoize) {
+    ParamMemo::buildStorageKey(typelist,ignoreOutputError,key);
+    if (memo.findStorage(key,typelist,*glb->types,res))
+      return;
+  }
   if (ignoreOutputError) {
     try {
       output->assignMap(typelist,false,*glb->types,res);
@@ -1701,6 +1863,34 @@ void ProtoModel::assignParameterStorage(const vector<Datatype *> &typelist,vecto
     output->assignMap(typelist,false,*glb->types,res);
   }
   input->assignMap(typelist,true,*glb->types,res);
+  if (memoize)
+    memo.recordStorage(key,typelist,res);
+}
+
+/// Trials are sorted and marked as \e used or not.
+/// \param active is the collection of Varnode input trials
+void ProtoModel::deriveInputMap(ParamActive *active) const
+
+{
+  ParamMemo::Key key;
+  ParamMemo::buildTrialKey(active,key);
+  if (memo.findTrials(true,key,active)) return;
+  int4 oldnum = active->getNumTrials();
+  input->fillinMap(active);
+  memo.recordTrials(true,key,active,oldnum);
+}
+
+/// One trial (at most) is marked \e used and moved to the front of the list
+/// \param active is the collection of output trials
+void ProtoModel::deriveOutputMap(ParamActive *active) const
+
+{
+  ParamMemo::Key key;
+  ParamMemo::buildTrialKey(active,key);
+  if (memo.findTrials(false,key,active)) return;
+  int4 oldnum = active->getNumTrials();
+  output->fillinMap(active);
+  memo.recordTrials(false,key,active,oldnum);
 }
 
 /// \brief Look up an effect from the given EffectRecord list
@@ -1713,6 +1903,24 @@ void ProtoModel::assignParameterStorage(const vector<Datatype *> &typelist,vecto
 /// \return the EffectRecord type
 uint4 ProtoModel::lookupEffect(const vector<EffectRecord> &efflist,const Address &addr,int4 size)
 
+{
+  int4 hint = -1;
+  return lookupEffect(efflist,addr,size,hint);
+}
+
+/// \brief Look up an effect from the given EffectRecord list, starting from a previous position
+///
+/// When a sequence of memory ranges is looked up in increasing order, the list is swept once
+/// from front to back instead of being searched for each range.  The position of the record
+/// following the range is passed back in \b hint, to be passed in with the next range.
+/// If a range comes before the previous one, or \b hint is negative, the list is searched.
+/// \param efflist is the list of EffectRecords which must be sorted
+/// \param addr is the starting address of the given memory range
+/// \param size is the number of bytes in the memory range
+/// \param hint is the position from the previous lookup and is updated
+/// \return the EffectRecord type
+uint4 ProtoModel::lookupEffect(const vector<EffectRecord> &efflist,const Address &addr,int4 size,int4 &hint)
+
 {
   // Unique is always local to function
   if (addr.getSpace()->getType()==IPTR_INTERNAL) return EffectRecord::unaffected;
@@ -1721,7 +1929,14 @@ uint4 ProtoModel::lookupEffect(const vector<EffectRecord> &efflist,const Address
 
   vector<EffectRecord>::const_iterator iter;
 
-  iter = upper_bound(efflist.begin(),efflist.end(),cur);
+  if (hint < 0 || (hint > 0 && cur < efflist[hint-1]))
+    iter = upper_bound(efflist.begin(),efflist.end(),cur);
+  else {
+    iter = efflist.begin() + hint;
+    while(iter != efflist.end() && !(cur < *iter))
+      ++iter;
+  }
+  hint = iter - efflist.begin();
   // First element greater than cur  (address must be greater)
   // go back one more, and we get first el less or equal to cur
   if (iter==efflist.begin()) return EffectRecord::unknown_effect; // Can't go back one
@@ -1805,6 +2020,7 @@ void ProtoModel::restoreXml(const Element *el)
     throw LowlevelError("Missing prototype attributes");
 
   buildParamList(strategystring); // Allocate input and output ParamLists
+  memo.clear();
   const List &list(el->getChildren());
   List::const_iterator iter;
   for(iter=list.begin();iter!=list.end();++iter) {
@@ -2035,6 +2251,7 @@ void ProtoModelMerged::intersectLikelyTrash(const vector<VarnodeData> &trashlist
 void ProtoModelMerged::foldIn(ProtoModel *model)
 
 {
+  memo.clear();			// The input resource list is about to change
   if (model->glb != glb) throw LowlevelError("Mismatched architecture");
   if ((model->input->getType() != ParamList::p_standard)&&
       (model->input->getType() != ParamList::p_register))
@@ -2747,7 +2964,7 @@ void FuncProto::paramShift(int4 paramshift)
   vector<ParameterPieces> pieces;
   model->assignParameterStorage(typelist,pieces,false);
 
-  delete store;
+  releaseStore();
 
   // This routine always converts -this- to have a ProtoStoreInternal
   store = new ProtoStoreInternal(typefactory->getTypeVoid());
@@ -2798,17 +3015,56 @@ void FuncProto::copy(const FuncProto &op2)
   model = op2.model;
   extrapop = op2.extrapop;
   flags = op2.flags;
-  if (store != (ProtoStore *)0)
-    delete store;
+  releaseStore();
   if (op2.store != (ProtoStore *)0)
     store = op2.store->clone();
-  else
-    store = (ProtoStore *)0;
   effectlist = op2.effectlist;
   likelytrash = op2.likelytrash;
   injectid = op2.injectid;
 }
 
+/// This is the same as copy(), except that the parameter storage of the other prototype is
+/// shared rather than cloned.  The first change to the parameters of either prototype gives
+/// that prototype its own clone (see uniqueStore()).  Both prototypes must be used from the
+/// same thread.
+/// \param op2 is the other function prototype to copy into \b this
+void FuncProto::copyShared(const FuncProto &op2)
+
+{
+  model = op2.model;
+  extrapop = op2.extrapop;
+  flags = op2.flags;
+  releaseStore();
+  store = op2.store;
+  if (store != (ProtoStore *)0)
+    store->refcount += 1;
+  effectlist = op2.effectlist;
+  likelytrash = op2.likelytrash;
+  injectid = op2.injectid;
+}
+
+/// If the parameter storage is shared with another prototype, drop the reference to it,
+/// otherwise free it.
+void FuncProto::releaseStore(void)
+
+{
+  if (store == (ProtoStore *)0) return;
+  store->refcount -= 1;
+  if (store->refcount == 0)
+    delete store;
+  store = (ProtoStore *)0;
+}
+
+/// This must be called before any change to the parameters.  If the parameter storage is shared
+/// with another prototype, \b this gets its own clone of it first.
+void FuncProto::uniqueStore(void)
+
+{
+  if (store == (ProtoStore *)0 || store->refcount == 1) return;
+  store->refcount -= 1;
+  store = store->clone();
+}
+
 void FuncProto::copyFlowEffects(const FuncProto &op2)
 
 {
@@ -2912,8 +3168,7 @@ void FuncProto::setInternal(ProtoModel *m,Datatype *vt)
 FuncProto::~FuncProto(void)
 
 {
-  if (store != (ProtoStore *)0)
-    delete store;
+  releaseStore();
 }
 
 bool FuncProto::isInputLocked(void) const
@@ -2936,6 +3191,7 @@ void FuncProto::setInputLock(bool val)
 {
   if (val)
     flags |= modellock;		// Locking input locks the model
+  uniqueStore();
   int4 num = numParams();
   if (num == 0) {
     flags = val ? (flags|voidinputlock) : (flags& ~((uint4)voidinputlock));
@@ -2957,6 +3213,7 @@ void FuncProto::setOutputLock(bool val)
 {
   if (val)
     flags |= modellock;		// Locking output locks the model
+  uniqueStore();
   store->getOutput()->setTypeLock(val);
 }
 
@@ -2992,6 +3249,7 @@ void FuncProto::clearUnlockedInput(void)
 
 {
   if (isInputLocked()) return;
+  uniqueStore();
   store->clearAllInputs();
 }
 
@@ -3001,17 +3259,22 @@ void FuncProto::clearUnlockedOutput(void)
   ProtoParameter *outparam = getOutput();
   if (outparam->isTypeLocked()) {
     if (outparam->isSizeTypeLocked()) {
-      if (model != (ProtoModel *)0)
-	outparam->resetSizeLockType(getArch()->types);
+      if (model != (ProtoModel *)0) {
+	uniqueStore();
+	getOutput()->resetSizeLockType(getArch()->types);
+      }
     }
   }
-  else
+  else {
+    uniqueStore();
     store->clearOutput();
+  }
 }
 
 void FuncProto::clearInput(void)
 
 {
+  uniqueStore();
   store->clearAllInputs();
   flags &= ~((uint4)voidinputlock); // If a void was locked in clear it
 }
@@ -3035,6 +3298,7 @@ void FuncProto::updateInputTypes(const vector<Varnode *> &triallist,ParamActive
 
 {
   if (isInputLocked()) return;	// Input is locked, do no updating
+  uniqueStore();
   store->clearAllInputs();
   int4 count = 0;
   int4 numtrials = activeinput->getNumTrials();
@@ -3069,6 +3333,7 @@ void FuncProto::updateInputNoTypes(const vector<Varnode *> &triallist,ParamActiv
 				   TypeFactory *factory)
 {
   if (isInputLocked()) return;	// Input is locked, do no updating
+  uniqueStore();
   store->clearAllInputs();
   int4 count = 0;
   int4 numtrials = activeinput->getNumTrials();
@@ -3103,20 +3368,24 @@ void FuncProto::updateOutputTypes(const vector<Varnode *> &triallist)
   ProtoParameter *outparm = getOutput();
   if (!outparm->isTypeLocked()) {
     if (triallist.empty()) {
+      uniqueStore();
       store->clearOutput();
       return;
     }
   }
   else if (outparm->isSizeTypeLocked()) {
     if (triallist.empty()) return;
-    if ((triallist[0]->getAddr() == outparm->getAddress())&&(triallist[0]->getSize() == outparm->getSize()))
-      outparm->overrideSizeLockType(triallist[0]->getHigh()->getType());
+    if ((triallist[0]->getAddr() == outparm->getAddress())&&(triallist[0]->getSize() == outparm->getSize())) {
+      uniqueStore();
+      getOutput()->overrideSizeLockType(triallist[0]->getHigh()->getType());
+    }
     return;
   }
   else
     return;			// Locked
 
   if (triallist.empty()) return;
+  uniqueStore();
   // If we reach here, output is not locked, not sizelocked, and there is a valid trial
   ParameterPieces pieces;
   pieces.addr = triallist[0]->getAddr();
@@ -3137,6 +3406,7 @@ void FuncProto::updateOutputNoTypes(const vector<Varnode *> &triallist,TypeFacto
 
 {
   if (isOutputLocked()) return;
+  uniqueStore();
   if (triallist.empty()) {
     store->clearOutput();
     return;
@@ -3162,6 +3432,7 @@ void FuncProto::updateAllTypes(const vector<std::string> &namelist,const vector<
 
 {
   setModel(model);		// This resets extrapop
+  uniqueStore();
   store->clearAllInputs();
   store->clearOutput();
   flags &= ~((uint4)voidinputlock);
@@ -3205,6 +3476,23 @@ uint4 FuncProto::hasEffect(const Address &addr,int4 size) const
   return ProtoModel::lookupEffect(effectlist,addr,size);
 }
 
+/// \brief Calculate the effect \b this has on a given storage location, starting from a previous position
+///
+/// Locations looked up in increasing order, with the same \b hint, sweep the EffectRecord
+/// list once.  See ProtoModel::lookupEffect().
+/// \param addr is the starting address of the storage location
+/// \param size is the number of bytes in the storage
+/// \param hint is the position in the EffectRecord list from the previous lookup and is updated
+/// \return the type of side-effect: EffectRecord::unaffected, EffectRecord::killedbycall, etc.
+uint4 FuncProto::hasEffect(const Address &addr,int4 size,int4 &hint) const
+
+{
+  if (effectlist.empty())
+    return model->hasEffect(addr,size,hint);
+
+  return ProtoModel::lookupEffect(effectlist,addr,size,hint);
+}
+
 vector<EffectRecord>::const_iterator FuncProto::effectBegin(void) const
 
 {
@@ -3521,6 +3809,7 @@ void FuncProto::restoreXml(const Element *el,Architecture *glb)
   // Model must be set first
   if (store == (ProtoStore *)0)
     throw LowlevelError("Prototype storage must be set before restoring FuncProto");
+  uniqueStore();
   ProtoModel *mod = (ProtoModel *)0;
   bool seenextrapop = false;
   bool seenunknownmod = false;
@@ -4324,7 +4613,7 @@ void FuncCallSpecs::insertPcode(Funcdata &data)
   InjectPayload *payload = data.getArch()->pcodeinjectlib->getPayload(injectid);
 
   // do the insertion right after the callpoint
-  list<PcodeOp *>::iterator iter = op->getBasicIter();
+  PcodeOpList::iterator iter = op->getBasicIter();
   ++iter;
   data.doLiveInject(payload,op->getAddr(),op->getParent(),iter);
 }
@@ -4384,7 +4673,7 @@ void FuncCallSpecs::finalInputCheck(void)
 /// the write and the call.
 /// \param data is the calling function
 /// \param aliascheck holds local aliasing information about the function
-void FuncCallSpecs::checkInputTrialUse(Funcdata &data,AliasChecker &aliascheck)
+void FuncCallSpecs::checkInputTrialUse(Funcdata &data,const AliasChecker &aliascheck)
 
 {
   if (op->isDead())
@@ -4693,6 +4982,26 @@ uint4 FuncCallSpecs::hasEffectTranslate(const Address &addr,int4 size) const
   return hasEffect(Address(spc,newoff),size);
 }
 
+/// \brief Calculate type of side-effect for a given storage location (with caller translation), from a previous position
+///
+/// As hasEffectTranslate(), but the EffectRecord list is swept from the position in \b hint.
+/// Stack locations keep their order under translation, except where the translation wraps,
+/// in which case the list is searched.
+/// \param addr is the starting address of the storage location
+/// \param size is the number of bytes in the storage
+/// \param hint is the position in the EffectRecord list from the previous lookup and is updated
+/// \return the effect type
+uint4 FuncCallSpecs::hasEffectTranslate(const Address &addr,int4 size,int4 &hint) const
+
+{
+  AddrSpace *spc = addr.getSpace();
+  if (spc->getType() != IPTR_SPACEBASE)
+    return hasEffect(addr,size,hint);
+  if (stackoffset == offset_unknown) return EffectRecord::unknown_effect;
+  uintb newoff = spc->wrapOffset(addr.getOffset()-stackoffset);	// Translate to callee's spacebase point of view
+  return hasEffect(Address(spc,newoff),size,hint);
+}
+
 /// \brief Calculate the number of times an individual sub-function is called.
 ///
 /// Provided a list of all call sites for a calling function, tally the number of calls
@@ -4723,4 +5032,45 @@ void FuncCallSpecs::countMatchingCalls(const vector<FuncCallSpecs *> &qlst)
   for(;lastChange<i;++lastChange)
     copyList[lastChange]->matchCallCount = num;
 }
+
+/// If a value is found, it counts as a reuse.
+/// \param addr is the entry address of the sub-function
+/// \param extrapop passes back the recorded \e extrapop
+/// \return \b true if a value was recorded for the sub-function
+bool ExtraPopMemo::find(const Address &addr,int4 &extrapop)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  map<Address,int4>::const_iterator iter = values.find(addr);
+  if (iter == values.end()) return false;
+  extrapop = (*iter).second;
+  numreused += 1;
+  return true;
+}
+
+/// The first value recorded for a sub-function is kept.
+/// \param addr is the entry address of the sub-function
+/// \param extrapop is the \e extrapop recovered at one of its call sites
+void ExtraPopMemo::record(const Address &addr,int4 extrapop)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  values.insert(pair<Address,int4>(addr,extrapop));
+}
+
+void ExtraPopMemo::clear(void)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  values.clear();
+  numreused = 0;
+}
+
+int4 ExtraPopMemo::size(void) const
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  return values.size();
+}
+
 }
@@ -33,6 +33,11 @@ Funcdata::Funcdata(const string &nm,Scope *scope,const Address &addr,int4 sz)
 {				// Initialize high-level properties of
 				// function by giving address and size
   flags = 0;
+  modcount = 0;
+  aliasmodcount = 0;
+  aliasvalid = false;
+  budget_used = 0;
+  blockbatch = 0;
   clean_up_index = 0;
   high_level_index = 0;
   cast_phase_index = 0;
@@ -66,7 +71,8 @@ void Funcdata::clear(void)
 
 {				// Clear everything associated with decompilation (analysis)
 
-  flags &= ~(highlevel_on|blocks_generated|processing_started|typerecovery_on|restart_pending);
+  flags &= ~(highlevel_on|blocks_generated|processing_started|typerecovery_on|restart_pending|structure_pending);
+  blockbatch = 0;
   clean_up_index = 0;
   high_level_index = 0;
   cast_phase_index = 0;
@@ -81,6 +87,14 @@ void Funcdata::clear(void)
   vbank.clear();
   clearCallSpecs();
   clearJumpTables();
+  regioncuts.clear();
+  endDirtyTracking();
+  modcount += 1;
+  hashcache.clear();
+  tracefail.clear();
+  ancestorcache.clear();
+  rangecache.clear();
+  aliasvalid = false;
   // Do not clear overrides
   heritage.clear();
 #ifdef OPACTION_DEBUG
@@ -88,6 +102,19 @@ void Funcdata::clear(void)
 #endif
 }
 
+/// Containers emptied by clear() keep their capacity, so a function that is decompiled again
+/// doesn't have to grow them again.  This releases that capacity, so an idle function holds
+/// no more memory than it did before its analysis started.  The objects of the analysis itself
+/// (PcodeOps, Varnodes, basic blocks) were already returned to their per-thread ObjectPool by clear().
+void Funcdata::releaseStorage(void)
+
+{
+  vector<FuncCallSpecs *>().swap(qlst);
+  vector<PcodeOp *>().swap(dirtyops);
+  vector<Address>().swap(regioncuts);
+  heritage.releaseStorage();
+}
+
 /// The comment is added to the global database, indexed via its placement address and
 /// the entry address of the function. The emitter will attempt to place the comment
 /// before the source expression that maps most closely to the address.
@@ -140,17 +167,140 @@ void Funcdata::startProcessing(void)
   sortCallSpecs();		// Must come after structure reset
   heritage.buildInfoList();
   localoverride.applyDeadCodeDelay(*this);
+  glb->prefetchFunction(*this);
 }
 
 void Funcdata::stopProcessing(void)
 
 {
   flags |= processing_complete;
+  if (AnalysisMetrics::isEnabled())
+    metrics.take(!isJumptableRecoveryOn());	// Partial functions are already counted by their owner
 #ifdef CPUI_STATISTICS
   glb->stats->process(*this);
 #endif
 }
 
+/// The limits are taken from the Architecture: \b budget_millis of wall-clock time starting now,
+/// and \b budget_rules Rule applications.  The budget covers any restarts of the analysis.
+void Funcdata::startBudget(void)
+
+{
+  flags &= ~((uint4)(budget_on|budget_exhausted));
+  budget_used = 0;
+  if (glb->budget_millis == 0 && glb->budget_rules == 0) return;
+  flags |= budget_on;
+  budget_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(glb->budget_millis);
+}
+
+/// The first time the budget is found to have run out, a warning is added to the function header.
+/// After that, Actions and Rules belonging to \e expendable groups are skipped, and the analysis
+/// is no longer restarted.
+/// \return \b true if the budget has run out
+bool Funcdata::checkBudget(void)
+
+{
+  if ((flags & budget_on)==0) return false;
+  if ((flags & budget_exhausted)!=0) return true;
+  if (glb->budget_rules != 0 && budget_used >= glb->budget_rules)
+    flags |= budget_exhausted;
+  else if (glb->budget_millis != 0 && std::chrono::steady_clock::now() >= budget_deadline)
+    flags |= budget_exhausted;
+  else
+    return false;
+  warningHeader("Analysis budget exhausted: optional simplifications were skipped");
+  return true;
+}
+
+/// \return the sum of the bytes attributed to every owner
+uint8 MemoryUsage::total(void) const
+
+{
+  uint8 res = 0;
+  for(int4 i=0;i<owner_count;++i)
+    res += bytes[i];
+  return res;
+}
+
+/// \param o is the owner
+/// \return the name used when printing and saving usage
+const char *MemoryUsage::getOwnerName(owner o)
+
+{
+  static const char *names[] = { "pcodeops", "varnodes", "highvariables", "blocks", "heritage",
+				 "localscope", "jumptables" };
+  return names[o];
+}
+
+/// \param s is the output stream
+void MemoryUsage::print(ostream &s) const
+
+{
+  for(int4 i=0;i<owner_count;++i)
+    s << setw(14) << left << getOwnerName((owner)i) << right << dec << bytes[i] << endl;
+  s << setw(14) << left << "total" << right << dec << total() << endl;
+}
+
+/// Each owner is saved as an attribute holding its estimated byte count, along with a \e total attribute.
+/// \param s is the output stream
+void MemoryUsage::saveXml(ostream &s) const
+
+{
+  s << "<memoryusage";
+  for(int4 i=0;i<owner_count;++i)
+    a_v_u(s,getOwnerName((owner)i),bytes[i]);
+  a_v_u(s,"total",total());
+  s << "/>\n";
+}
+
+/// Memory is attributed to PcodeOps, Varnodes, HighVariables (together with every Cover),
+/// basic and structured blocks, the Heritage state, the local Scope, and jump-tables.  The
+/// walk is linear in the size of the function.
+/// \param res will hold the estimated usage
+void Funcdata::measureMemory(MemoryUsage &res) const
+
+{
+  res.clear();
+  res.add(MemoryUsage::pcodeops,obank.memoryEstimate());
+  res.add(MemoryUsage::varnodes,vbank.memoryEstimate());
+  uint8 highbytes = 0;
+  VarnodeLocSet::const_iterator iter;
+  for(iter=vbank.beginLoc();iter!=vbank.endLoc();++iter) {
+    const Varnode *vn = *iter;
+    if (vn->cover != (Cover *)0)
+      highbytes += vn->cover->memoryEstimate();
+    HighVariable *high = vn->high;
+    if (high != (HighVariable *)0 && high->getInstance(0) == vn)
+      highbytes += high->memoryEstimate();	// Count each HighVariable once, at its first member
+  }
+  res.add(MemoryUsage::highvariables,highbytes);
+  res.add(MemoryUsage::blocks,bblocks.memoryEstimate() + sblocks.memoryEstimate());
+  res.add(MemoryUsage::heritage,heritage.memoryEstimate());
+  if (localmap != (ScopeLocal *)0)
+    res.add(MemoryUsage::localscope,localmap->memoryEstimate());
+  uint8 jtbytes = 0;
+  for(int4 i=0;i<jumpvec.size();++i)
+    jtbytes += jumpvec[i]->memoryEstimate();
+  res.add(MemoryUsage::jumptables,jtbytes);
+}
+
+/// The current usage is measured, and if it is the largest seen since the last reset,
+/// it replaces the peak, which is then attributed to the given Action.
+/// \param actname is the name of the Action that just applied
+/// \return the total estimated bytes currently in use
+uint8 Funcdata::recordMemory(const std::string &actname)
+
+{
+  MemoryUsage cur;
+  measureMemory(cur);
+  uint8 tot = cur.total();
+  if (tot > mempeak.total()) {
+    mempeak = cur;
+    mempeak_action = actname;
+  }
+  return tot;
+}
+
 bool Funcdata::startTypeRecovery(void)
 
 {
@@ -477,9 +627,19 @@ void Funcdata::printVarnodeTree(ostream &s) const
 
 {
   VarnodeDefSet::const_iterator iter,enditer;
+  VarnodeLocSet::const_iterator citer,cenditer;
   Varnode *vn;
 
   iter = vbank.beginDef();
+  enditer = vbank.beginDef(0);
+  while(iter != enditer) {
+    vn = *iter++;
+    vn->printInfo(s);
+  }
+  AddrSpace *cspc = glb->getConstantSpace();	// Constants are only in the location tree
+  cenditer = vbank.endLoc(cspc);
+  for(citer=vbank.beginLoc(cspc);citer!=cenditer;++citer)
+    (*citer)->printInfo(s);
   enditer = vbank.endDef();
   while(iter != enditer) {
     vn = *iter++;
@@ -627,7 +787,7 @@ void Funcdata::saveXmlTree(ostream &s) const
   }
   s << "</varnodes>\n";
   
-  list<PcodeOp *>::iterator oiter,endoiter;
+  PcodeOpList::iterator oiter,endoiter;
   PcodeOp *op;
   BlockBasic *bs;
   for(int4 i=0;i<bblocks.getSize();++i) {
@@ -769,7 +929,7 @@ void Funcdata::restoreXml(const Element *el)
 /// \param addr is the address at the point of injection
 /// \param bl is the given basic block holding the new ops
 /// \param iter indicates the point of insertion
-void Funcdata::doLiveInject(InjectPayload *payload,const Address &addr,BlockBasic *bl,list<PcodeOp *>::iterator iter)
+void Funcdata::doLiveInject(InjectPayload *payload,const Address &addr,BlockBasic *bl,PcodeOpList::iterator iter)
 
 {
   PcodeEmitFd emitter;
@@ -831,6 +991,90 @@ void PcodeEmitFd::dump(const Address &addr,OpCode opc,VarnodeData *outvar,Varnod
   }
 }
 
+/// If the function has changed since the failures were recorded, they are all thrown away first.
+/// \param mod is the current modification count of the function
+/// \param kind is the kind of trace
+/// \param vn is the root Varnode of the trace
+/// \param mask is the mask or size parameter of the trace
+/// \return \b true if the same trace failed without any intervening change
+bool TraceFailureCache::hasFailed(uint4 mod,uint4 kind,const Varnode *vn,uintb mask)
+
+{
+  if (mod != modcount) {
+    failed.clear();
+    modcount = mod;
+    return false;
+  }
+  uint8 key = (((uint8)kind) << 32) | vn->getCreateIndex();
+  return (failed.find(pair<uint8,uintb>(key,mask)) != failed.end());
+}
+
+/// \param mod is the current modification count of the function
+/// \param kind is the kind of trace
+/// \param vn is the root Varnode of the trace
+/// \param mask is the mask or size parameter of the trace
+void TraceFailureCache::insert(uint4 mod,uint4 kind,const Varnode *vn,uintb mask)
+
+{
+  if (mod != modcount) {
+    failed.clear();
+    modcount = mod;
+  }
+  uint8 key = (((uint8)kind) << 32) | vn->getCreateIndex();
+  failed.insert(pair<uint8,uintb>(key,mask));
+}
+
+/// \param mod is the current modification count of the function
+/// \param vn is the Varnode the traversal starts from
+/// \param props are the properties of the trial that influence the traversal
+/// \return the recorded verdict or null
+const AncestorVerdictCache::Verdict *AncestorVerdictCache::find(uint4 mod,const Varnode *vn,uint4 props)
+
+{
+  if (mod != modcount) {
+    verdicts.clear();
+    modcount = mod;
+    return (const Verdict *)0;
+  }
+  uint8 key = (((uint8)props) << 32) | vn->getCreateIndex();
+  map<uint8,Verdict>::const_iterator iter = verdicts.find(key);
+  if (iter == verdicts.end())
+    return (const Verdict *)0;
+  return &(*iter).second;
+}
+
+/// \param mod is the current modification count of the function
+/// \param vn is the Varnode the traversal starts from
+/// \param props are the properties of the trial that influence the traversal
+/// \return the record to fill in
+AncestorVerdictCache::Verdict &AncestorVerdictCache::insert(uint4 mod,const Varnode *vn,uint4 props)
+
+{
+  if (mod != modcount) {
+    verdicts.clear();
+    modcount = mod;
+  }
+  uint8 key = (((uint8)props) << 32) | vn->getCreateIndex();
+  return verdicts[key];
+}
+
+/// The search for sums involving the stack pointer is shared by ActionActiveParam and the
+/// local variable map, and it is kept until the data-flow of the function changes.  Any change
+/// to the stack pointer's expressions goes through the \e op methods, which bump the modification
+/// count.  The search itself is deferred until the aliases are first queried.
+/// \param spc is the stack space
+/// \return the aliasing information for the stack space
+const AliasChecker &Funcdata::getAliasChecker(AddrSpace *spc)
+
+{
+  if ((!aliasvalid)||(aliasmodcount != modcount)||(aliascheck.getSpace() != spc)) {
+    aliascheck.gather(this,spc,true);
+    aliasmodcount = modcount;
+    aliasvalid = true;
+  }
+  return aliascheck;
+}
+
 #ifdef OPACTION_DEBUG
 
 /// The current state of the op is recorded for later comparison after
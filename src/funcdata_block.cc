@@ -15,6 +15,7 @@
  */
 #include "funcdata.hh"
 #include "flow.hh"
+#include "resultcache.hh"
 
 namespace GhidraDec {
 // Funcdata members pertaining directly to blocks
@@ -86,8 +87,8 @@ void Funcdata::pushMultiequals(BlockBasic *bb)
   BlockBasic *outblock;
   PcodeOp *origop,*replaceop;
   Varnode *origvn,*replacevn;
-  list<PcodeOp *>::iterator iter;
-  list<PcodeOp *>::const_iterator citer;
+  PcodeOpList::iterator iter;
+  DescendList::const_iterator citer;
 
   if (bb->sizeOut()==0) return;
   if (bb->sizeOut()>1)
@@ -143,7 +144,7 @@ void Funcdata::pushMultiequals(BlockBasic *bb)
     // Replace obsolete origvn with replacevn
     int4 i;
     int4 outblock_ind = bb->getOutRevIndex(0);
-    list<PcodeOp *>::iterator titer = origvn->descend.begin();
+    DescendList::iterator titer = origvn->descend.begin();
     while(titer != origvn->descend.end()) {
       PcodeOp *op = *titer++;
       i = op->getSlot(origvn);
@@ -182,7 +183,7 @@ void Funcdata::branchRemoveInternal(BlockBasic *bb,int4 num)
 
 {
   BlockBasic *bbout;
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter;
   PcodeOp *op;
   int4 blocknum;
   
@@ -219,7 +220,7 @@ void Funcdata::removeBranch(BlockBasic *bb,int4 num)
 bool Funcdata::descendantsOutside(Varnode *vn)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
 
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter)
     if (!(*iter)->getParent()->isDead()) return true;
@@ -243,7 +244,7 @@ void Funcdata::blockRemoveInternal(BlockBasic *bb,bool unreachable)
   BlockBasic *bbout;
   Varnode *deadvn;
   PcodeOp *op,*deadop;
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter;
   int4 i,j,blocknum;
   bool desc_warning;
 
@@ -461,41 +462,50 @@ JumpTable *Funcdata::installJumpTable(const Address &addr)
   return newjt;
 }
 
-/// \brief Recover a jump-table for a given BRANCHIND using existing flow information
+/// \brief Recover jump-tables for a set of BRANCHINDs using existing flow information
 ///
 /// A partial function (copy) is built using the flow info. Simplification is performed on the
-/// partial function (using the "jumptable" strategy), then destination addresses of the
-/// branch are recovered by examining the simplified data-flow. The jump-table object
-/// is populated with the recovered addresses.  An integer value is returned:
+/// partial function (using the "jumptable" strategy), then destination addresses of each
+/// branch are recovered by examining the simplified data-flow. Every branch is analyzed on the
+/// same partial function, so the cost of building and simplifying it is paid once for the set.
+/// Each jump-table object is populated with the recovered addresses, and an integer code is
+/// returned for each:
 ///   - 0 = success
 ///   - 1 = normal could-not-recover failure
 ///   - 2 = \b likely \b thunk failure
 ///   - 3 = no legal flows to the BRANCHIND failure
 ///
-/// \param jt is the jump-table object to populate
-/// \param op is the BRANCHIND p-code op to analyze
+/// A failure in a set of more than one branch might not happen with the flow recovered
+/// from the others, so the caller is expected to try it again by itself, and the failure is
+/// only reported as a warning for a single branch.
+/// \param jt is the list of jump-table objects to populate
+/// \param op is the corresponding list of BRANCHIND p-code ops to analyze
 /// \param flow is the existing flow information
-/// \return the success/failure code
-int4 Funcdata::stageJumpTable(JumpTable *jt,PcodeOp *op,FlowInfo *flow)
-
+/// \param failuremode will hold the success/failure code for each jump-table
+void Funcdata::stageJumpTables(const vector<JumpTable *> &jt,const vector<PcodeOp *> &op,FlowInfo *flow,
+			       vector<int4> &failuremode)
 {
-  PcodeOp *partop = (PcodeOp *)0;
   string oldactname;
+  bool report = (op.size() == 1);
 
   ostringstream s1;
   s1 << name << "@@jump@";
-  op->getAddr().printRaw(s1);
+  op[0]->getAddr().printRaw(s1);
 
   Funcdata partial(s1.str(),localmap->getParent(),baseaddr);
   partial.flags |= jumptablerecovery_on; // Mark that this Funcdata object is dedicated to jumptable recovery
   partial.truncatedFlow(this,flow);
 
-  partop = partial.findOp(op->getSeqNum());
-
-  if ((partop==(PcodeOp *)0) ||
-      (partop->code() != CPUI_BRANCHIND)||
-      (partop->getAddr() != op->getAddr()))
-    throw LowlevelError("Error recovering jumptable: Bad partial clone");
+  vector<PcodeOp *> partop;
+  for(int4 i=0;i<op.size();++i) {
+    PcodeOp *cur = partial.findOp(op[i]->getSeqNum());
+    if ((cur==(PcodeOp *)0) ||
+	(cur->code() != CPUI_BRANCHIND)||
+	(cur->getAddr() != op[i]->getAddr()))
+      throw LowlevelError("Error recovering jumptable: Bad partial clone");
+    partop.push_back(cur);
+  }
+  failuremode.assign(op.size(),0);
 
   oldactname = glb->allacts.getCurrentName(); // Save off old action
   glb->allacts.setCurrent("jumptable");
@@ -511,29 +521,47 @@ int4 Funcdata::stageJumpTable(JumpTable *jt,PcodeOp *op,FlowInfo *flow)
     }
 #endif
     glb->allacts.setCurrent(oldactname); // Restore old action
-    if (partop->isDead())	// Indirectop we were trying to recover was eliminated as dead code (unreachable)
-      return 0;			// Return jumptable as 
-    jt->setLoadCollect(flow->doesJumpRecord());
-    jt->setIndirectOp(partop);
-    if (jt->getStage()>0)
-      jt->recoverMultistage(&partial);
-    else
-      jt->recoverAddresses(&partial); // Analyze partial to recover jumptable addresses
   }
   catch(JumptableNotReachableError &err) {
     glb->allacts.setCurrent(oldactname);
-    return 3;
+    failuremode.assign(op.size(),3);
+    return;
   }
   catch(JumptableThunkError &err) {
     glb->allacts.setCurrent(oldactname);
-    return 2;
+    failuremode.assign(op.size(),2);
+    return;
   }
   catch(LowlevelError &err) {
     glb->allacts.setCurrent(oldactname);
-    warning(err.explain,op->getAddr());
-    return 1;
+    if (report)
+      warning(err.explain,op[0]->getAddr());
+    failuremode.assign(op.size(),1);
+    return;
+  }
+  for(int4 i=0;i<op.size();++i) {
+    if (partop[i]->isDead())	// Indirectop we were trying to recover was eliminated as dead code (unreachable)
+      continue;			// Leave the jumptable empty
+    try {
+      jt[i]->setLoadCollect(flow->doesJumpRecord());
+      jt[i]->setIndirectOp(partop[i]);
+      if (jt[i]->getStage()>0)
+	jt[i]->recoverMultistage(&partial);
+      else
+	jt[i]->recoverAddresses(&partial); // Analyze partial to recover jumptable addresses
+    }
+    catch(JumptableNotReachableError &err) {
+      failuremode[i] = 3;
+    }
+    catch(JumptableThunkError &err) {
+      failuremode[i] = 2;
+    }
+    catch(LowlevelError &err) {
+      if (report)
+	warning(err.explain,op[i]->getAddr());
+      failuremode[i] = 1;
+    }
   }
-  return 0;
 }
 
 /// \brief Recover destinations for a BRANCHIND by analyzing nearby data and control-flow
@@ -550,34 +578,98 @@ int4 Funcdata::stageJumpTable(JumpTable *jt,PcodeOp *op,FlowInfo *flow)
 JumpTable *Funcdata::recoverJumpTable(PcodeOp *op,FlowInfo *flow,int4 &failuremode)
 
 {
-  JumpTable *jt;
+  vector<PcodeOp *> ops(1,op);
+  vector<JumpTable *> res;
+  vector<int4> modes;
+  recoverJumpTables(ops,flow,res,modes);
+  failuremode = modes[0];
+  return res[0];
+}
 
-  failuremode = 0;
-  jt = linkJumpTable(op);		// Search for pre-existing jumptable
-  if (jt != (JumpTable *)0) {
-    if (!jt->isOverride()) {
-      if (jt->getStage() != 1)
-	return jt;		// Previously calculated jumptable (NOT an override and NOT incomplete)
+/// \brief Recover destinations for a set of BRANCHINDs at once
+///
+/// This works like recoverJumpTable() for each BRANCHIND, but every table that is not already
+/// known is recovered from a single partial function (see stageJumpTables()).
+/// \param ops is the list of BRANCHIND PcodeOps
+/// \param flow is current flow information for \b this function
+/// \param res will hold the recovered JumpTable, or NULL, for each BRANCHIND
+/// \param failuremode will hold the success/failure code (0=success) for each BRANCHIND
+void Funcdata::recoverJumpTables(const vector<PcodeOp *> &ops,FlowInfo *flow,vector<JumpTable *> &res,
+				 vector<int4> &failuremode)
+{
+  res.assign(ops.size(),(JumpTable *)0);
+  failuremode.assign(ops.size(),0);
+  vector<JumpTable *> stagejt;		// Tables to recover from the partial function
+  vector<PcodeOp *> stageop;
+  vector<int4> stageindex;		// Position of each staged table in -ops-
+  list<JumpTable> trials;		// Tables that are new, made permanent if recovered
+  JumpTableCache *cache = ((flags & jumptablerecovery_on)==0) ? glb->jumpcache : (JumpTableCache *)0;
+
+  for(int4 i=0;i<ops.size();++i) {
+    PcodeOp *op = ops[i];
+    JumpTable *jt = linkJumpTable(op);		// Search for pre-existing jumptable
+    if (jt != (JumpTable *)0) {
+      if (!jt->isOverride()) {
+	if (jt->getStage() != 1) {
+	  res[i] = jt;		// Previously calculated jumptable (NOT an override and NOT incomplete)
+	  continue;
+	}
+      }
+      stagejt.push_back(jt);	// Recover based on override information
+      stageop.push_back(op);
+      stageindex.push_back(i);
+      continue;
+    }
+    if ((flags & jumptablerecovery_dont)!=0)
+      continue;			// Explicitly told not to recover jumptables
+    if (cache != (JumpTableCache *)0) {
+      const JumpTable *prevjt = cache->find(baseaddr,op->getAddr());
+      if (prevjt != (const JumpTable *)0) {	// Recovered by an earlier decompilation
+	jt = new JumpTable(prevjt);
+	jumpvec.push_back(jt);
+	jt->setIndirectOp(op);
+	res[i] = jt;
+	continue;
+      }
+    }
+    trials.emplace_back(glb);
+    stagejt.push_back(&trials.back());
+    stageop.push_back(op);
+    stageindex.push_back(i);
+  }
+  if (stagejt.empty()) return;
+
+  vector<int4> modes;
+  RangeList reads;
+  if (cache != (JumpTableCache *)0 && !trials.empty()) {
+    LoadImageRecorder recorder(glb);	// Record the bytes the recovery depends on
+    stageJumpTables(stagejt,stageop,flow,modes);
+    reads = recorder.getReads();
+  }
+  else
+    stageJumpTables(stagejt,stageop,flow,modes);
+
+  list<JumpTable>::iterator titer = trials.begin();
+  for(int4 k=0;k<stagejt.size();++k) {
+    int4 i = stageindex[k];
+    PcodeOp *op = ops[i];
+    failuremode[i] = modes[k];
+    bool istrial = (titer != trials.end() && stagejt[k] == &(*titer));
+    if (istrial)
+      ++titer;
+    if (modes[k] != 0) continue;
+    JumpTable *jt = stagejt[k];
+    if (istrial) {
+      if (cache != (JumpTableCache *)0 && jt->getStage() != 1)
+	cache->store(baseaddr,jt,reads);
+      //  if (trialjt.is_twostage())
+      //    warning("Jumptable maybe incomplete. Second-stage recovery not implemented",trialjt.Opaddress());
+      jt = new JumpTable(jt); // Make the jumptable permanent
+      jumpvec.push_back(jt);
     }
-    failuremode = stageJumpTable(jt,op,flow); // Recover based on override information
-    if (failuremode != 0)
-      return (JumpTable *)0;
-    jt->setIndirectOp(op);	// Relink table back to original op
-    return jt;
-  }
-
-  if ((flags & jumptablerecovery_dont)!=0)
-    return (JumpTable *)0;	// Explicitly told not to recover jumptables
-  JumpTable trialjt(glb);
-  failuremode = stageJumpTable(&trialjt,op,flow);
-  if (failuremode != 0)
-    return (JumpTable *)0;
-  //  if (trialjt.is_twostage())
-  //    warning("Jumptable maybe incomplete. Second-stage recovery not implemented",trialjt.Opaddress());
-  jt = new JumpTable(&trialjt); // Make the jumptable permanent
-  jumpvec.push_back(jt);
-  jt->setIndirectOp(op);		// Relink table back to original op
-  return jt;
+    jt->setIndirectOp(op);		// Relink table back to original op
+    res[i] = jt;
+  }
 }
 
 /// For each jump-table, for each address, the corresponding basic block index is computed.
@@ -608,13 +700,18 @@ void Funcdata::installSwitchDefaults(void)
 
 /// For the current control-flow graph, (re)calculate the loop structure and dominance.
 /// This can be called multiple times as changes are made to control-flow.
-/// The structured hierarchy is also reset.
+/// The structured hierarchy is also reset.  Inside a block batch, the recalculation is put
+/// off until endBlockBatch().
 void Funcdata::structureReset(void)
 
 {
   vector<JumpTable *>::iterator iter;
   vector<FlowBlock *> rootlist;
 
+  if (blockbatch > 0) {
+    flags |= structure_pending;
+    return;
+  }
   flags &= ~blocks_unreachable;	// Clear any old blocks flag
   bblocks.structureLoops(rootlist);
   bblocks.calcForwardDominator(rootlist);
@@ -638,6 +735,21 @@ void Funcdata::structureReset(void)
   heritage.forceRestructure();
 }
 
+/// An Action that removes many branches or blocks in one pass brackets the changes with
+/// beginBlockBatch() and this method.  The loop structure, dominators, and dead jump-table
+/// check are then recomputed once, here, instead of after each change.  Between the two calls
+/// the block indices, dominators, and loop information are stale, so the changes made must
+/// not depend on them.  Batches can be nested, and only the outermost one recomputes.
+void Funcdata::endBlockBatch(void)
+
+{
+  blockbatch -= 1;
+  if (blockbatch > 0) return;
+  if ((flags & structure_pending) == 0) return;
+  flags &= ~((uint4)structure_pending);
+  structureReset();
+}
+
 /// \brief Force a specific control-flow edge to be marked as \e unstructured
 ///
 /// The edge is specified by a source and destination Address (of the branch).
@@ -798,7 +910,7 @@ void Funcdata::nodeSplitRawDuplicate(BlockBasic *b,BlockBasic *bprime)
 
 {
   PcodeOp *b_op,*prime_op;
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter;
 
   for(iter=b->beginOp();iter!=b->endOp();++iter) {
     b_op = *iter;
@@ -822,7 +934,7 @@ void Funcdata::nodeSplitRawDuplicate(BlockBasic *b,BlockBasic *bprime)
 void Funcdata::nodeSplitInputPatch(BlockBasic *b,BlockBasic *bprime,int4 inedge)
 
 {
-  list<PcodeOp *>::iterator biter,piter;
+  PcodeOpList::iterator biter,piter;
   PcodeOp *bop,*pop;
   Varnode *bvn,*pvn;
   map<PcodeOp *,PcodeOp *> btop; // Map from b to bprime
@@ -982,7 +1094,7 @@ void Funcdata::spliceBlockBasic(BlockBasic *bl)
     if (firstop->code() == CPUI_MULTIEQUAL)
       throw LowlevelError("Splicing block with MULTIEQUAL");
     firstop->clearFlag(PcodeOp::startbasic);
-    list<PcodeOp *>::iterator iter;
+    PcodeOpList::iterator iter;
     // Move ops into -bl-
     for(iter=outbl->beginOp();iter!=outbl->endOp();++iter) {
       PcodeOp *op = *iter;
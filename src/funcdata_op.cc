@@ -28,6 +28,9 @@ void Funcdata::opSetOpcode(PcodeOp *op,OpCode opc)
   if (opactdbg_active)
     debugModCheck(op);
 #endif
+  markDirty(op);
+  if (op->getOut() != (Varnode *)0)
+    markDirtyDescend(op->getOut());
   obank.changeOpcode(op, glb->inst[opc] );
 }
 
@@ -59,6 +62,8 @@ void Funcdata::opUnsetOutput(PcodeOp *op)
   if (opactdbg_active)
     debugModCheck(op);
 #endif
+  markDirty(op);
+  markDirtyDescend(vn);
   op->setOutput((Varnode *)0); // This must come before make_free
   vbank.makeFree(vn);
   vn->clearCover();
@@ -83,6 +88,8 @@ void Funcdata::opSetOutput(PcodeOp *op,Varnode *vn)
   vn = vbank.setDef(vn,op);
   setVarnodeProperties(vn);
   op->setOutput(vn);
+  markDirty(op);
+  markDirtyDescend(vn);
 }
 
 /// The input Varnode is unlinked from the op.
@@ -93,6 +100,9 @@ void Funcdata::opUnsetInput(PcodeOp *op,int4 slot)
 {
   Varnode *vn = op->getIn(slot);
 
+  markDirty(op);
+  if (vn->getDef() != (PcodeOp *)0)
+    markDirty(vn->getDef());	// The defining op has lost a read
   vn->eraseDescend(op);
   op->clearInput(slot);		// Must be called AFTER descend_erase
 }
@@ -121,6 +131,9 @@ void Funcdata::opSetInput(PcodeOp *op,Varnode *vn,int4 slot)
 
   vn->addDescend(op);		// Add this op to list of vn's descendants
   op->setInput(vn,slot);	// op must be up to date AFTER calling descend_add
+  markDirty(op);
+  if (vn->getDef() != (PcodeOp *)0)
+    markDirty(vn->getDef());	// The defining op has gained a read
 }
 
 /// This is convenience method that is more efficient than call opSetInput() twice.
@@ -134,6 +147,7 @@ void Funcdata::opSwapInput(PcodeOp *op,int4 slot1,int4 slot2)
   if (opactdbg_active)
     debugModCheck(op);
 #endif
+  markDirty(op);
   Varnode *tmp = op->getIn(slot1);
   op->setInput(op->getIn(slot2),slot1);
   op->setInput(tmp,slot2);
@@ -146,7 +160,7 @@ void Funcdata::opSwapInput(PcodeOp *op,int4 slot1,int4 slot2)
 /// \param op is the given PcodeOp
 /// \param bl is the basic block being inserted into
 /// \param iter indicates exactly where the op is inserted
-void Funcdata::opInsert(PcodeOp *op,BlockBasic *bl,list<PcodeOp *>::iterator iter)
+void Funcdata::opInsert(PcodeOp *op,BlockBasic *bl,PcodeOpList::iterator iter)
 
 {
 #ifdef OPACTION_DEBUG
@@ -155,6 +169,7 @@ void Funcdata::opInsert(PcodeOp *op,BlockBasic *bl,list<PcodeOp *>::iterator ite
 #endif
   obank.markAlive(op);
   bl->insert(iter,op);
+  markDirty(op);
 }
 
 /// The op is taken out of its basic block and put into the dead list. If the removal
@@ -271,6 +286,7 @@ void Funcdata::opRemoveInput(PcodeOp *op,int4 slot)
 #endif
   opUnsetInput(op,slot);
   op->removeInput(slot);
+  markDirty(op);
 }
 
 /// The given Varnode is set into the given operand slot. Any existing input Varnodes
@@ -290,6 +306,59 @@ void Funcdata::opInsertInput(PcodeOp *op,Varnode *vn,int4 slot)
   opSetInput(op,vn,slot);
 }
 
+/// Only the reads at the time of the call are collected.
+/// \param vn is the Varnode whose value or definition has changed
+void Funcdata::markDirtyDescend(Varnode *vn)
+
+{
+  if ((flags & dirty_tracking)==0) return;
+  DescendList::const_iterator iter;
+  for(iter=vn->beginDescend();iter!=vn->endDescend();++iter)
+    dirtyops.push_back(*iter);
+}
+
+/// Every PcodeOp modified by one of the \e op methods since the last call is passed back,
+/// along with the PcodeOps immediately around each modification: the op defining an input
+/// that was added or removed, and the ops reading an output that was changed.  The list
+/// can contain duplicates and PcodeOps that are now \e dead.  The collection is emptied.
+/// \param res will hold the collected PcodeOps
+void Funcdata::takeDirtyOps(vector<PcodeOp *> &res)
+
+{
+  res.clear();
+  res.swap(dirtyops);
+}
+
+/// Destroyed PcodeOps are normally kept, retired, until the function is cleared, because
+/// pointers to them may remain.  Once more PcodeOps have been retired since the last
+/// reclamation than are alive, those that nothing can still refer to are freed.  PcodeOps referenced by an \e iop annotation (as on
+/// an INDIRECT) or by a call site are kept.  Nothing is freed while modified PcodeOps
+/// are being collected, or if the function has a jump-table, whose model may hold the PcodeOps
+/// along the path to its switch variable.  This is meant to be called between Actions.
+void Funcdata::reclaimRetiredOps(void)
+
+{
+  if (!obank.needsReclaim()) return;
+  if (isDirtyTracking() || !jumpvec.empty()) return;
+  vector<PcodeOp *> keep;
+  list<PcodeOp *>::const_iterator iter;
+  for(int4 pass=0;pass<2;++pass) {
+    list<PcodeOp *>::const_iterator enditer = (pass == 0) ? obank.endAlive() : obank.endDead();
+    for(iter=(pass == 0) ? obank.beginAlive() : obank.beginDead();iter!=enditer;++iter) {
+      PcodeOp *op = *iter;
+      for(int4 i=0;i<op->numInput();++i) {
+	Varnode *vn = op->getIn(i);
+	if (vn != (Varnode *)0 && vn->getSpace()->getType() == IPTR_IOP)
+	  keep.push_back(PcodeOp::getOpFromConst(vn->getAddr()));
+      }
+    }
+  }
+  for(int4 i=0;i<qlst.size();++i)
+    keep.push_back(qlst[i]->getOp());
+  sort(keep.begin(),keep.end());
+  obank.reclaimRetired(keep);
+}
+
 /// \param inputs is the number of operands the new op will have
 /// \param pc is the Address associated with the new op
 /// \return the new PcodeOp
@@ -319,7 +388,7 @@ PcodeOp *Funcdata::newOp(int4 inputs,const SeqNum &sq)
 void Funcdata::opInsertBefore(PcodeOp *op,PcodeOp *follow)
 
 {
-  list<PcodeOp *>::iterator iter = follow->getBasicIter();
+  PcodeOpList::iterator iter = follow->getBasicIter();
   BlockBasic *parent = follow->getParent();
 
   if (op->code() != CPUI_INDIRECT) {
@@ -354,7 +423,7 @@ void Funcdata::opInsertAfter(PcodeOp *op,PcodeOp *prev)
 	prev = PcodeOp::getOpFromConst(invn->getAddr()); // Store or call
     }
   }
-  list<PcodeOp *>::iterator iter = prev->getBasicIter();
+  PcodeOpList::iterator iter = prev->getBasicIter();
   BlockBasic *parent = prev->getParent();
 
   iter++;
@@ -384,7 +453,7 @@ void Funcdata::opInsertAfter(PcodeOp *op,PcodeOp *prev)
 void Funcdata::opInsertBegin(PcodeOp *op,BlockBasic *bl)
 
 {
-  list<PcodeOp *>::iterator iter = bl->beginOp();
+  PcodeOpList::iterator iter = bl->beginOp();
   
   if (op->code()!=CPUI_MULTIEQUAL) {
     while(iter != bl->endOp()) {
@@ -406,7 +475,7 @@ void Funcdata::opInsertBegin(PcodeOp *op,BlockBasic *bl)
 void Funcdata::opInsertEnd(PcodeOp *op,BlockBasic *bl)
 
 {
-  list<PcodeOp *>::iterator iter = bl->endOp();
+  PcodeOpList::iterator iter = bl->endOp();
 
   if (iter != bl->beginOp()) {
     --iter;
@@ -704,6 +773,10 @@ void Funcdata::truncateIndirect(PcodeOp *indop)
 /// Follow flow from the entry point generating PcodeOps for each instruction encountered.
 /// The caller can provide a bounding range that constrains where control can flow to
 /// and can also provide a maximum number of instructions that will be followed.
+/// If the Architecture sets a p-code budget, flow stops generating new instructions once
+/// the raw p-code reaches it.  Each instruction still reached is cut off with an artificial
+/// halt and recorded as the entry of a separate region (see getRegionCuts()), which a caller
+/// can decompile as a function of its own, so memory stays bounded by the budget.
 /// \param baddr is the beginning of the constraining range
 /// \param eaddr is the end of the constraining range
 /// \param insn_max is the maximum number of instructions to follow
@@ -723,8 +796,17 @@ void Funcdata::followFlow(const Address &baddr,const Address &eaddr,uint4 insn_m
   flow.setFlags(fl);
   if (insn_max != 0)
     flow.setMaximumInstructions(insn_max);
+  if (glb->flow_op_budget != 0)
+    flow.setMaximumOps(glb->flow_op_budget);
   flow.generateOps();
   size = flow.getSize();
+  regioncuts = flow.getRegionCuts();
+  if (!regioncuts.empty()) {
+    ostringstream s;
+    s << "Function exceeds the p-code budget: " << dec << regioncuts.size() << " regions cut from flow, first at ";
+    regioncuts[0].printRaw(s);
+    warningHeader(s.str());
+  }
   // Cannot keep track of function sizes in general because of non-contiguous functions
   //  glb->symboltab->update_size(name,size);
 
@@ -1125,7 +1207,7 @@ void opFlipInPlaceExecute(Funcdata &data,vector<PcodeOp *> &fliplist)
 PcodeOp *earliestUseInBlock(Varnode *vn,BlockBasic *bl)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *res = (PcodeOp *)0;
 
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter) {
@@ -1153,7 +1235,7 @@ PcodeOp *earliestUseInBlock(Varnode *vn,BlockBasic *bl)
 PcodeOp *cseFindInBlock(PcodeOp *op,Varnode *vn,BlockBasic *bl,PcodeOp *earliest)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter) {
     PcodeOp *res = *iter;
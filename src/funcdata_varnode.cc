@@ -268,7 +268,7 @@ Varnode *Funcdata::cloneVarnode(const Varnode *vn)
 void Funcdata::destroyVarnode(Varnode *vn)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
 
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter) {
     PcodeOp *op = *iter;
@@ -422,7 +422,7 @@ bool Funcdata::descend2Undef(Varnode *vn)
   PcodeOp *op,*copyop;
   BlockBasic *inbl;
   Varnode *badconst;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   int4 i,size;
   bool res;
 
@@ -537,12 +537,16 @@ bool Funcdata::fillinReadOnly(Varnode *vn)
   }
 
   uintb res;
-  uint1 bytes[32];
-  try {
-    glb->loader->loadFill(bytes,vn->getSize(),vn->getAddr());
-  } catch(DataUnavailError &err) { // Could not get value from LoadImage
-    vn->clearFlags(Varnode::readonly); // Treat as writeable
-    return true;
+  uint1 buffer[32];
+  const uint1 *bytes = glb->loader->peek(vn->getSize(),vn->getAddr());
+  if (bytes == (const uint1 *)0) {
+    try {
+      glb->loader->loadFill(buffer,vn->getSize(),vn->getAddr());
+    } catch(DataUnavailError &err) { // Could not get value from LoadImage
+      vn->clearFlags(Varnode::readonly); // Treat as writeable
+      return true;
+    }
+    bytes = buffer;
   }
   
   if (vn->getSpace()->isBigEndian()) { // Big endian
@@ -561,7 +565,7 @@ bool Funcdata::fillinReadOnly(Varnode *vn)
   }
 				// Replace all references to vn
   bool changemade = false;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *op;
   int4 i;
   Datatype *locktype = vn->isTypeLock() ? vn->getType() : (Datatype *)0;
@@ -651,7 +655,7 @@ bool Funcdata::checkIndirectUse(Varnode *vn)
   bool result = true;
   while((i<vlist.size())&&result) {
     vn = vlist[i++];
-    list<PcodeOp *>::const_iterator iter;
+    DescendList::const_iterator iter;
     for(iter=vn->beginDescend();iter!=vn->endDescend();++iter) {
       PcodeOp *op = *iter;
       OpCode opc = op->code();
@@ -789,8 +793,9 @@ void Funcdata::calcNZMask(void)
     uintb nzmask = op->getNZMaskLocal(false);
     if (nzmask != vn->nzm) {
       vn->nzm = nzmask;
-      for(oiter=vn->beginDescend();oiter!=vn->endDescend();++oiter)
-	opstack.push_back(*oiter);
+      DescendList::const_iterator iter;
+      for(iter=vn->beginDescend();iter!=vn->endDescend();++iter)
+	opstack.push_back(*iter);
     }
   }
 }
@@ -823,11 +828,7 @@ bool Funcdata::updateFlags(const ScopeLocal *lm,bool typesyes)
       if (entry->getSize() >= vnexemplar->getSize()) {
 	if (typesyes) {
 	  uintb off = (vnexemplar->getOffset() - entry->getAddr().getOffset()) + entry->getOffset();
-	  Datatype *cur = entry->getSymbol()->getType();
-	  do {
-	    ct = cur;
-	    cur = cur->getSubType(off,&off);
-	  } while(cur != (Datatype *)0);
+	  ct = entry->getSymbol()->getType()->getLeafType(off,&off);
 	  if ((ct->getSize() != vnexemplar->getSize())||(ct->getMetatype() == TYPE_UNKNOWN))
 	    ct = (Datatype *)0;
 	}
@@ -1025,7 +1026,7 @@ bool Funcdata::attemptDynamicMapping(SymbolEntry *entry,DynamicHash &dhash)
 void Funcdata::totalReplace(Varnode *vn,Varnode *newvn)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *op;
   int4 i;
 
@@ -1047,7 +1048,7 @@ void Funcdata::totalReplace(Varnode *vn,Varnode *newvn)
 void Funcdata::totalReplaceConstant(Varnode *vn,uintb val)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *op;
   PcodeOp *copyop = (PcodeOp *)0;
   Varnode *newrep;
@@ -1094,7 +1095,7 @@ void Funcdata::splitUses(Varnode *vn)
   PcodeOp *op = vn->getDef();
   Varnode *newvn;
   PcodeOp *newop,*useop;
-  list<PcodeOp *>::iterator iter;
+  DescendList::iterator iter;
   int4 slot;
 
   iter = vn->descend.begin();
@@ -1232,7 +1233,7 @@ bool Funcdata::onlyOpUse(const Varnode *invn,const PcodeOp *opmatch,const ParamT
 
 {
   vector<const Varnode *> varlist;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   const Varnode *vn,*subvn;
   const PcodeOp *op;
   int4 i;
@@ -1397,6 +1398,32 @@ bool AncestorRealistic::checkConditionalExe(State &state)
   return true;
 }
 
+/// A traversal that starts at a Varnode with no MULTIEQUAL on the path so far explores exactly
+/// the same nodes as the earlier standalone traversal from that Varnode, provided none of them have
+/// been visited yet.  In this case, the visited Varnodes are marked and the side effects on the
+/// trial are repeated, as if the traversal had been performed.
+/// \param verdict is the outcome of the earlier traversal
+/// \return \b true if the verdict applies to the current traversal
+bool AncestorRealistic::replayVerdict(const AncestorVerdictCache::Verdict &verdict)
+
+{
+  for(int4 i=0;i<verdict.visited.size();++i)
+    if (verdict.visited[i]->isMark()) return false;
+  for(int4 i=0;i<verdict.visited.size();++i) {
+    markedVn.push_back(verdict.visited[i]);
+    verdict.visited[i]->setMark();
+  }
+  if (verdict.indcreateformed) {
+    trial->setIndCreateFormed();
+    sawIndCreate = true;
+  }
+  if (verdict.condexeeffect) {
+    trial->setCondExeEffect();
+    sawCondExe = true;
+  }
+  return true;
+}
+
 /// Analyze a new node that has just entered, during the depth-first traversal
 /// \param state is the current node on the path, with associated state information
 /// \return the command indicating the next traversal step: push (enter_node), or pop (pop_success, pop_fail, pop_solid...)
@@ -1415,12 +1442,18 @@ int4 AncestorRealistic::enterNode(State &state)
     }
     return pop_success;		// Probably a normal parameter, not active movement, but valid
   }
+  if (multiDepth == 0) {
+    const AncestorVerdictCache::Verdict *verdict = cache->find(modcount,state.vn,cacheprops);
+    if ((verdict != (const AncestorVerdictCache::Verdict *)0) && replayVerdict(*verdict))
+      return verdict->command;
+  }
   mark(state.vn);		// Mark that the varnode has now been visited
   PcodeOp *op = state.vn->getDef();
   switch(op->code()) {
   case CPUI_INDIRECT:
     if (op->isIndirectCreation()) {	// Backtracking is stopped by a call
       trial->setIndCreateFormed();
+      sawIndCreate = true;
       if (op->getIn(0)->isIndirectZero())	// True only if not a possible output
 	return pop_failkill;		// Truncate this path, indicating killedbycall
       return pop_success;		// otherwise it could be valid
@@ -1487,8 +1520,10 @@ int4 AncestorRealistic::uponPop(State &state,int4 pop_command)
 	  if (allowFailingPath) {
 	    if (!checkConditionalExe(state))		// that can NOT be attributed to conditional execution
 	      pop_command = pop_fail;			// in which case we fail despite having solid movement
-	    else
+	    else {
 	      trial->setCondExeEffect();			// Slate this trial for additional testing
+	      sawCondExe = true;
+	    }
 	  }
 	  else
 	    pop_command = pop_fail;
@@ -1526,6 +1561,12 @@ bool AncestorRealistic::execute(PcodeOp *op,int4 slot,ParamTrial *t,bool allowFa
   markedVn.clear();		// Make sure to clear out any old data
   stateStack.clear();
   multiDepth = 0;
+  Funcdata *fd = op->getParent()->getFuncdata();
+  cache = &fd->getAncestorCache();
+  modcount = fd->getModificationCount();
+  cacheprops = (trial->isKilledByCall() ? 1 : 0) | (allowFailingPath ? 2 : 0);
+  sawIndCreate = false;
+  sawCondExe = false;
   // If the parameter itself is an input, we don't consider this realistic, we expect to see active
   // movement into the parameter. There are some cases where this doesn't happen, but they are rare and
   // failure here doesn't necessarily mean further analysis won't still declare this a parameter
@@ -1533,6 +1574,8 @@ bool AncestorRealistic::execute(PcodeOp *op,int4 slot,ParamTrial *t,bool allowFa
     if (!trial->hasCondExeEffect())	// Make sure we are not retesting
       return false;
   }
+  Varnode *rootvn = op->getIn(slot);
+  bool record = (rootvn->isWritten() && (cache->find(modcount,rootvn,cacheprops) == (const AncestorVerdictCache::Verdict *)0));
   // Run the depth first traversal
   int4 command = enter_node;
   stateStack.push_back(State(op,slot));		// Start by entering the initial node
@@ -1549,6 +1592,13 @@ bool AncestorRealistic::execute(PcodeOp *op,int4 slot,ParamTrial *t,bool allowFa
       break;
     }
   }
+  if (record) {			// Remember the verdict for later traversals through the same Varnode
+    AncestorVerdictCache::Verdict &verdict( cache->insert(modcount,rootvn,cacheprops) );
+    verdict.command = command;
+    verdict.indcreateformed = sawIndCreate;
+    verdict.condexeeffect = sawCondExe;
+    verdict.visited = markedVn;
+  }
   for(int4 i=0;i<markedVn.size();++i)		// Clean up marks we left along the way
     markedVn[i]->clearMark();
   if ((command != pop_success)&&(command != pop_solid))
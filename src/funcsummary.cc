@@ -0,0 +1,200 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "funcsummary.hh"
+
+namespace GhidraDec {
+
+/// \param str is the string to write
+void FunctionSummary::writeString(const string &str)
+
+{
+  static const char hexdigit[] = "0123456789abcdef";
+  s << '\"';
+  for(int4 i=0;i<str.size();++i) {
+    char c = str[i];
+    if (c == '\"' || c == '\\')
+      s << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      s << "\\u00" << hexdigit[(c >> 4) & 0xf] << hexdigit[c & 0xf];
+    else
+      s << c;
+  }
+  s << '\"';
+}
+
+/// \param addr is the address, which may be invalid
+void FunctionSummary::writeAddress(const Address &addr)
+
+{
+  if (addr.isInvalid()) {
+    s << "null";
+    return;
+  }
+  s << "{\"space\":";
+  writeString(addr.getSpace()->getName());
+  s << ",\"offset\":\"0x" << hex << addr.getOffset() << dec << "\"}";
+}
+
+/// Pointers and arrays are built up from the name of the data-type they are made of,
+/// as the printer would declare them.  Types with no name fall back on their size.
+/// \param ct is the data-type
+/// \return the name
+string FunctionSummary::typeName(const Datatype *ct)
+
+{
+  if (ct == (const Datatype *)0)
+    return "void";
+  if (ct->getName().size() != 0)
+    return ct->getName();
+  ostringstream res;
+  if (ct->getMetatype() == TYPE_PTR)
+    res << typeName(((const TypePointer *)ct)->getPtrTo()) << " *";
+  else if (ct->getMetatype() == TYPE_ARRAY)
+    res << typeName(((const TypeArray *)ct)->getBase()) << '[' << dec << ((const TypeArray *)ct)->numElements() << ']';
+  else
+    res << "undefined" << dec << ct->getSize();
+  return res.str();
+}
+
+/// \param ct is the data-type
+void FunctionSummary::writeType(const Datatype *ct)
+
+{
+  writeString(typeName(ct));
+}
+
+/// \param proto is the prototype of the function
+void FunctionSummary::writePrototype(const FuncProto &proto)
+
+{
+  s << "\"prototype\":{\"model\":";
+  writeString(proto.getModelName());
+  s << ",\"output\":";
+  writeType(proto.getOutputType());
+  s << ",\"params\":[";
+  for(int4 i=0;i<proto.numParams();++i) {
+    ProtoParameter *param = proto.getParam(i);
+    if (i != 0) s << ',';
+    s << "{\"name\":";
+    writeString(param->getName());
+    s << ",\"type\":";
+    writeType(param->getType());
+    s << ",\"storage\":";
+    writeAddress(param->getAddress());
+    s << '}';
+  }
+  s << "],\"varargs\":" << (proto.isDotdotdot() ? "true" : "false") << '}';
+}
+
+/// \param entry is a mapping of the symbol to write
+/// \param seen is the set of symbols already written, which is updated
+void FunctionSummary::writeLocal(const SymbolEntry *entry,set<const Symbol *> &seen)
+
+{
+  const Symbol *sym = entry->getSymbol();
+  if (sym->getCategory() == 0) return;	// A parameter
+  if (!seen.insert(sym).second) return;
+  if (seen.size() != 1) s << ',';
+  s << "{\"name\":";
+  writeString(sym->getName());
+  s << ",\"type\":";
+  writeType(sym->getType());
+  s << ",\"storage\":";
+  writeAddress(entry->getAddr());
+  s << '}';
+}
+
+/// Parameters are part of the prototype, so they are left out.  A symbol mapped more than
+/// once is only listed for its first mapping.
+/// \param scope is the local scope of the function
+void FunctionSummary::writeLocals(const ScopeLocal *scope)
+
+{
+  s << "\"locals\":[";
+  set<const Symbol *> seen;
+  MapIterator iter = scope->begin();
+  MapIterator enditer = scope->end();
+  for(;iter!=enditer;++iter)
+    writeLocal(*iter,seen);
+  list<SymbolEntry>::const_iterator diter;
+  for(diter=scope->beginDynamic();diter!=scope->endDynamic();++diter)
+    writeLocal(&(*diter),seen);
+  s << ']';
+}
+
+/// \param fd is the function
+void FunctionSummary::writeCalls(const Funcdata &fd)
+
+{
+  s << "\"calls\":[";
+  for(int4 i=0;i<fd.numCalls();++i) {
+    const FuncCallSpecs *fc = fd.getCallSpecs(i);
+    if (i != 0) s << ',';
+    s << "{\"address\":";
+    writeAddress(fc->getOp()->getAddr());
+    s << ",\"target\":";
+    writeAddress(fc->getEntryAddress());
+    s << ",\"name\":";
+    if (fc->getName().size() != 0)
+      writeString(fc->getName());
+    else
+      s << "null";
+    s << ",\"indirect\":" << (fc->getOp()->code() == CPUI_CALLIND ? "true" : "false") << '}';
+  }
+  s << ']';
+}
+
+/// \param fd is the function
+void FunctionSummary::writeJumpTables(const Funcdata &fd)
+
+{
+  s << "\"jumptables\":[";
+  for(int4 i=0;i<fd.numJumpTables();++i) {
+    const JumpTable *jt = fd.getJumpTable(i);
+    if (i != 0) s << ',';
+    s << "{\"address\":";
+    writeAddress(jt->getOpAddress());
+    s << ",\"targets\":[";
+    for(int4 j=0;j<jt->numEntries();++j) {
+      if (j != 0) s << ',';
+      writeAddress(jt->getAddressByIndex(j));
+    }
+    s << "]}";
+  }
+  s << ']';
+}
+
+/// The summary is written on a single line, followed by a newline.
+/// \param fd is the (decompiled) function
+void FunctionSummary::save(const Funcdata &fd)
+
+{
+  s << "{\"name\":";
+  writeString(fd.getName());
+  s << ",\"entry\":";
+  writeAddress(fd.getAddress());
+  s << ',';
+  writePrototype(fd.getFuncProto());
+  s << ',';
+  writeLocals(fd.getScopeLocal());
+  s << ',';
+  writeCalls(fd);
+  s << ',';
+  writeJumpTables(fd);
+  s << "}\n";
+}
+
+}
@@ -20,9 +20,101 @@
 #include "typegrp_ghidra.hh"
 #include "comment_ghidra.hh"
 #include "cpool_ghidra.hh"
+#include "funcdata.hh"
 #include "inject_ghidra.hh"
+#include "slab.hh"
 
 namespace GhidraDec {
+
+bool ArchitectureGhidra::exitonclose = true;
+
+std::mutex SpecDocumentCache::lock;
+map<string,SpecDocumentCache::Entry> SpecDocumentCache::docs;
+uint8 SpecDocumentCache::usecount = 0;
+int4 SpecDocumentCache::maxunused = 16;
+
+/// The caller must hold the lock.
+void SpecDocumentCache::evictUnused(void)
+
+{
+  for(;;) {
+    int4 unused = 0;
+    map<string,Entry>::iterator oldest = docs.end();
+    map<string,Entry>::iterator iter;
+    for(iter=docs.begin();iter!=docs.end();++iter) {
+      if ((*iter).second.refcount != 0) continue;
+      unused += 1;
+      if (oldest == docs.end() || (*iter).second.lastuse < (*oldest).second.lastuse)
+	oldest = iter;
+    }
+    if (unused <= maxunused) return;
+    delete (*oldest).second.doc;
+    docs.erase(oldest);
+  }
+}
+
+/// If the text has been parsed before, the existing document is returned. Otherwise the text is
+/// parsed and the document is cached.  Either way the caller holds a reference and must
+/// release() it.  Parsing is done with the lock held, so concurrent registrations of the same
+/// specification parse it once.
+/// \param xml is the text of the specification
+/// \return the parsed document
+const Document *SpecDocumentCache::acquire(const string &xml)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  map<string,Entry>::iterator iter = docs.find(xml);
+  if (iter == docs.end()) {
+    istringstream s(xml);
+    Entry entry;
+    entry.doc = xml_tree(s);		// Throws on a parse error, leaving the cache unchanged
+    entry.refcount = 0;
+    iter = docs.insert(pair<string,Entry>(xml,entry)).first;
+  }
+  (*iter).second.refcount += 1;
+  (*iter).second.lastuse = ++usecount;
+  return (*iter).second.doc;
+}
+
+/// \param doc is a document previously returned by acquire()
+void SpecDocumentCache::release(const Document *doc)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  map<string,Entry>::iterator iter;
+  for(iter=docs.begin();iter!=docs.end();++iter) {
+    if ((*iter).second.doc != doc) continue;
+    (*iter).second.refcount -= 1;
+    (*iter).second.lastuse = ++usecount;
+    break;
+  }
+  evictUnused();
+}
+
+/// \param val is the maximum number of documents, without any holder, to keep
+void SpecDocumentCache::setMaxUnused(int4 val)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  maxunused = (val < 0) ? 0 : val;
+  evictUnused();
+}
+
+void SpecDocumentCache::clear(void)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  map<string,Entry>::iterator iter = docs.begin();
+  while(iter != docs.end()) {
+    if ((*iter).second.refcount == 0) {
+      delete (*iter).second.doc;
+      docs.erase(iter++);
+    }
+    else
+      ++iter;
+  }
+}
+
 /// Catch the signal so the OS doesn't pop up a dialog
 /// \param sig is the OS signal (should always be SIGSEGV)
 void ArchitectureGhidra::segvHandler(int4 sig)
@@ -45,6 +137,11 @@ void ArchitectureGhidra::segvHandler(int4 sig)
 ///   - Exception               open=a close=b
 ///   - Byte stream             open=c close=d
 ///   - String stream           open=e close=f
+///   - Binary record           open=12 close=13
+///
+/// A binary record is a 4-byte little-endian length followed by exactly that many raw bytes,
+/// so its contents are never scanned for markers. The client only sends binary records once
+/// they have been negotiated by the \e registerProgram command (see setBinaryProtocol()).
 ///
 /// The protocol is as follows:
 ///   - ghidra sends a command
@@ -78,6 +175,8 @@ int4 ArchitectureGhidra::readToAnyBurst(istream &s)
       c = s.get();
       return c;
     }
+    if ((c<0)&&!exitonclose)	// A server outlives its clients, so just abandon this one
+      throw JavaError("alignment","Client closed the connection");
 #ifndef CPUI_DEBUG 
 	//  when under debug mode, it is possible to be a debugger attaching,
 	//  hold it in that case
@@ -95,10 +194,21 @@ int4 ArchitectureGhidra::readToAnyBurst(istream &s)
 void ArchitectureGhidra::readStringStream(istream &s,string &res)
 
 {
-  int4 c;
-
   int4 type = readToAnyBurst(s);
   if (type != 14) throw JavaError("alignment","Expecting string");
+  readStringContents(s,res);
+}
+
+/// Characters are read up to the next protocol marker and placed into a string.
+/// The opening marker of the string must already have been consumed. The closing
+/// marker is consumed and must indicate the end of a string or an exception is thrown.
+/// \param s is the input stream from the client
+/// \param res will hold the string
+void ArchitectureGhidra::readStringContents(istream &s,string &res)
+
+{
+  int4 c;
+
   c = s.get();
   while(c > 0) {
     res += (char)c;
@@ -131,6 +241,11 @@ Document *ArchitectureGhidra::readXMLStream(istream &s)
       throw JavaError("alignment","Expecting XML string end");
     return doc;
   }
+  if (type==18) {		// Element tree in binary (.slab) form
+    vector<uint1> buf;
+    readBinaryContents(s,buf);
+    return slab_tree(buf.data(),buf.size());
+  }
   if ((type&1)==1)
     return (Document *)0;
   throw JavaError("alignment","Expecting string or end of query response");
@@ -168,6 +283,26 @@ uint1 *ArchitectureGhidra::readPackedStream(istream &s)
   throw JavaError("alignment","Expecting string or end of query response");
 }
 
+/// The opening marker of the record must already have been consumed. The length of
+/// the record is read, then its bytes, then the closing marker.
+/// \param s is the input stream from the client
+/// \param res will hold the bytes of the record
+void ArchitectureGhidra::readBinaryContents(istream &s,vector<uint1> &res)
+
+{
+  uint1 lenbuf[4];
+  s.read((char *)lenbuf,4);
+  uint4 size = ((uint4)lenbuf[0]) | (((uint4)lenbuf[1]) << 8) | (((uint4)lenbuf[2]) << 16) | (((uint4)lenbuf[3]) << 24);
+  res.resize(size);
+  if (size != 0)
+    s.read((char *)res.data(),size);
+  if (!s)
+    exit(1);			// Pipe closed, our parent process is probably dead
+  int4 type = readToAnyBurst(s);
+  if (type != 19)
+    throw JavaError("alignment","Expecting binary record end");
+}
+
 /// Write out a string with correct protocol markers
 /// \param s is the output stream to the client
 /// \param msg is the string to send
@@ -252,24 +387,18 @@ void ArchitectureGhidra::passJavaException(ostream &s,const string &tp,const str
   s.write("\000\000\001\013",4);
 }
 
+/// Spec files are passed as XML strings from GHIDRA. Each is parsed through the
+/// SpecDocumentCache, so programs with the same specification share one parse.
+/// The documents are held, not owned by the DocumentStorage, until \b this is destroyed.
 void ArchitectureGhidra::buildSpecFile(DocumentStorage &store)
 
-{ // Spec files are passed as XML strings from GHIDRA
-  istringstream pstream(pspecxml); // Convert string to stream
-  Document *doc = store.parseDocument(pstream); // parse stream
-  store.registerTag(doc->getRoot());
-  
-  istringstream cstream(cspecxml);
-  doc = store.parseDocument(cstream);
-  store.registerTag(doc->getRoot());
-  
-  istringstream tstream(tspecxml);
-  doc = store.parseDocument(tstream);
-  store.registerTag(doc->getRoot());
-
-  istringstream corestream(corespecxml);
-  doc = store.parseDocument(corestream);
-  store.registerTag(doc->getRoot());
+{
+  const string *spec[4] = { &pspecxml, &cspecxml, &tspecxml, &corespecxml };
+  for(int4 i=0;i<4;++i) {
+    const Document *doc = SpecDocumentCache::acquire(*spec[i]);
+    specdocs.push_back(doc);
+    store.registerTag(doc->getRoot());
+  }
 
   pspecxml = "";		// Strings aren't used again free memory
   cspecxml = "";
@@ -460,6 +589,17 @@ string ArchitectureGhidra::getUserOpName(int4 index)
 /// \return an array of the packed data
 uint1 *ArchitectureGhidra::getPcodePacked(const Address &addr)
 
+{
+  writePcodeQuery(addr);
+  sout.flush();
+
+  return readPackedAll(sin);
+}
+
+/// The query is sent but the response is not read, so other queries can be sent first.
+/// \param addr is the address of the instruction
+void ArchitectureGhidra::writePcodeQuery(const Address &addr)
+
 {
   sout.write("\000\000\001\004",4);
   writeStringStream(sout,"getPacked");
@@ -467,9 +607,35 @@ uint1 *ArchitectureGhidra::getPcodePacked(const Address &addr)
   addr.saveXml(sout);
   sout.write("\000\000\001\017",4);
   sout.write("\000\000\001\005",4);
+}
+
+/// A query for every address is sent before any answer is read, so the whole list costs a
+/// single round trip to the client.  The answers are in the same packed format as for
+/// getPcodePacked().  An address the client could not produce p-code for, or that caused an
+/// error, gets a null answer, so the caller can query it on its own to see the error.
+/// \param addrs is the list of instruction addresses
+/// \param res will hold the packed p-code for each address, which the caller must free
+void ArchitectureGhidra::getPcodePackedBatch(const vector<Address> &addrs,vector<uint1 *> &res)
+
+{
+  res.assign(addrs.size(),(uint1 *)0);
+  for(int4 i=0;i<addrs.size();++i)
+    writePcodeQuery(addrs[i]);
   sout.flush();
 
-  return readPackedAll(sin);
+  for(int4 i=0;i<addrs.size();++i) {
+    try {
+      res[i] = readPackedAll(sin);
+    }
+    catch(JavaError &err) {
+      if (err.type == "alignment") {
+	for(int4 j=0;j<i;++j)
+	  delete [] res[j];
+	res.clear();
+	throw;
+      }
+    }
+  }
 }
 
 /// The Ghidra client will return a \<symbol> tag, \<function> tag, or some
@@ -556,14 +722,32 @@ Document *ArchitectureGhidra::getType(const string &name,uint8 id)
   return readXMLAll(sin);
 }
 
-/// Ask Ghidra client for all comments associated with one function.
-/// The caller must provide the sub-set of properties (Comment::comment_type) for
-/// the query to match.  The client will return a \<commentdb> tag with
-/// a \<comment> tag child for each comment found.
+/// Ask the Ghidra client for a data-type together with the description of every data-type
+/// it refers to, directly or through other data-types. The client returns a \<typelist> tag, with
+/// a child describing each data-type in the closure.  A client that doesn't know the query
+/// answers with an exception.
+/// \param name is the name of the data-type
+/// \param id is a unique id associated with the data-type, pass 0 if only querying by name
+/// \return the XML description of the data-types or NULL
+Document *ArchitectureGhidra::getTypeClosure(const string &name,uint8 id)
+
+{
+  sout.write("\000\000\001\004",4);
+  writeStringStream(sout,"getTypeClosure");
+  writeStringStream(sout,name);
+  sout.write("\000\000\001\016",4); // Beginning of string header
+  sout << dec << (int8)id;	// Pass as a signed integer
+  sout.write("\000\000\001\017",4);
+  sout.write("\000\000\001\005",4);
+  sout.flush();
+
+  return readXMLAll(sin);
+}
+
+/// The query is sent but the response is not read, so other queries can be sent first.
 /// \param fad is the address of the function to query
 /// \param flags specifies the properties the query will match (must be non-zero)
-/// \return an XML document describing each comment
-Document *ArchitectureGhidra::getComments(const Address &fad,uint4 flags)
+void ArchitectureGhidra::writeCommentsQuery(const Address &fad,uint4 flags)
 
 {
   sout.write("\000\000\001\004",4);
@@ -575,18 +759,36 @@ Document *ArchitectureGhidra::getComments(const Address &fad,uint4 flags)
   sout << dec << flags;
   sout.write("\000\000\001\017",4);
   sout.write("\000\000\001\005",4);
+}
+
+/// Ask Ghidra client for all comments associated with one function.
+/// The caller must provide the sub-set of properties (Comment::comment_type) for
+/// the query to match.  The client will return a \<commentdb> tag with
+/// a \<comment> tag child for each comment found.  If the same query was already
+/// answered by prefetchFunction(), that answer is returned instead.
+/// \param fad is the address of the function to query
+/// \param flags specifies the properties the query will match (must be non-zero)
+/// \return an XML document describing each comment
+Document *ArchitectureGhidra::getComments(const Address &fad,uint4 flags)
+
+{
+  if (prefetchcomments != (Document *)0) {
+    Document *doc = prefetchcomments;
+    prefetchcomments = (Document *)0;
+    if (prefetchcommentaddr == fad && prefetchcommentflags == flags)
+      return doc;
+    delete doc;
+  }
+  writeCommentsQuery(fad,flags);
   sout.flush();
 
   return readXMLAll(sin);
 }
 
-/// The Ghidra client is queried for a range of bytes, which are returned
-/// in the given array. This method throws a DataUnavailError if the provided
-/// address doesn't make sense.
-/// \param buf is the preallocated array in which to store the bytes
+/// The query is sent but the response is not read, so other queries can be sent first.
 /// \param size is the number of bytes requested
 /// \param inaddr is the address in the LoadImage from which to grab bytes
-void ArchitectureGhidra::getBytes(uint1 *buf,int4 size,const Address &inaddr)
+void ArchitectureGhidra::writeBytesQuery(int4 size,const Address &inaddr)
 
 {
   sout.write("\000\000\001\004",4);
@@ -595,8 +797,16 @@ void ArchitectureGhidra::getBytes(uint1 *buf,int4 size,const Address &inaddr)
   inaddr.saveXml(sout,size);
   sout.write("\000\000\001\017",4);
   sout.write("\000\000\001\005",4);
-  sout.flush();
+}
+
+/// Read the client's answer to a query sent by writeBytesQuery(). This method throws
+/// a DataUnavailError if the client has no bytes at the address.
+/// \param buf is the preallocated array in which to store the bytes
+/// \param size is the number of bytes requested
+/// \param inaddr is the address in the LoadImage from which to grab bytes
+void ArchitectureGhidra::readBytesResponse(uint1 *buf,int4 size,const Address &inaddr)
 
+{
   readToResponse(sin);
   int4 type = readToAnyBurst(sin);
   if (type == 12) {
@@ -607,6 +817,15 @@ void ArchitectureGhidra::getBytes(uint1 *buf,int4 size,const Address &inaddr)
     }
     delete [] dblbuf;
   }
+  else if (type == 18) {	// Raw bytes
+    vector<uint1> res;
+    readBinaryContents(sin,res);
+    if (res.size() != size)
+      throw JavaError("alignment","Binary record does not match requested byte count");
+    memcpy(buf,res.data(),size);
+    readResponseEnd(sin);
+    return;
+  }
   else if ((type&1)==1) {
     ostringstream errmsg;
     errmsg << "GHIDRA has no data in the loadimage at " << inaddr.getShortcut();
@@ -621,6 +840,217 @@ void ArchitectureGhidra::getBytes(uint1 *buf,int4 size,const Address &inaddr)
   readResponseEnd(sin);
 }
 
+/// The Ghidra client is queried for a range of bytes, which are returned
+/// in the given array. This method throws a DataUnavailError if the provided
+/// address doesn't make sense.
+/// \param buf is the preallocated array in which to store the bytes
+/// \param size is the number of bytes requested
+/// \param inaddr is the address in the LoadImage from which to grab bytes
+void ArchitectureGhidra::fetchBytes(uint1 *buf,int4 size,const Address &inaddr)
+
+{
+  writeBytesQuery(size,inaddr);
+  sout.flush();
+  readBytesResponse(buf,size,inaddr);
+}
+
+/// If the page has not been seen before, the whole page is requested from the client in one query.
+/// A page that the client cannot supply in full (or that runs off the end of its space) is
+/// remembered as unavailable, so requests within it go to the client directly.
+/// \param pageaddr is the (page aligned) address of the page
+/// \return the bytes of the page, or null if the page is not available as a whole
+const vector<uint1> *ArchitectureGhidra::obtainBytePage(const Address &pageaddr)
+
+{
+  map<Address,vector<uint1> >::const_iterator iter = bytecache.find(pageaddr);
+  if (iter == bytecache.end()) {
+    if (bytecache.size() >= bytecachemax)
+      bytecache.clear();
+    vector<uint1> page;
+    if (pageaddr.getOffset() + (bytepagesize - 1) <= pageaddr.getSpace()->getHighest()) {
+      page.resize(bytepagesize);
+      try {
+	fetchBytes(page.data(),bytepagesize,pageaddr);
+      }
+      catch(DataUnavailError &err) {
+	page.clear();
+      }
+    }
+    iter = bytecache.insert(pair<Address,vector<uint1> >(pageaddr,page)).first;
+  }
+  if ((*iter).second.empty())
+    return (const vector<uint1> *)0;
+  return &(*iter).second;
+}
+
+/// Every cached page overlapping the range is dropped, along with anything prefetched.
+/// \param rng is the memory range whose bytes may have changed
+void ArchitectureGhidra::invalidateBytes(const Range &rng)
+
+{
+  uintb mask = ~((uintb)(bytepagesize - 1));
+  map<Address,vector<uint1> >::iterator iter = bytecache.lower_bound(Address(rng.getSpace(),rng.getFirst() & mask));
+  while(iter != bytecache.end()) {
+    const Address &pageaddr( (*iter).first );
+    if (pageaddr.getSpace() != rng.getSpace() || pageaddr.getOffset() > rng.getLast()) break;
+    bytecache.erase(iter++);
+  }
+  clearPrefetch();
+}
+
+void ArchitectureGhidra::clearPrefetch(void)
+
+{
+  if (prefetchcomments != (Document *)0)
+    delete prefetchcomments;
+  prefetchcomments = (Document *)0;
+}
+
+/// Each query to the client is a round trip, and the decompiler otherwise asks for the bytes
+/// and comments of a function one query at a time, as it needs them.  Once the basic blocks are
+/// known, the byte pages covered by the blocks that are not already cached, the comments for
+/// the function, and the constant pool record of every CPOOLREF, are all requested together, and
+/// the answers are read back in order.  The answers are kept where obtainBytePage(), getComments(),
+/// and ConstantPoolGhidra will find them, so the analysis sees exactly what it would have seen
+/// without the prefetch.  Nothing is sent unless at least
+/// two queries can be combined.
+/// \param fd is the function whose control-flow is now known
+void ArchitectureGhidra::prefetchFunction(const Funcdata &fd)
+
+{
+  vector<Address> pages;
+  if (prefetchbytes) {
+    uintb mask = ~((uintb)(bytepagesize - 1));
+    const BlockGraph &graph( fd.getBasicBlocks() );
+    for(int4 i=0;i<graph.getSize();++i) {
+      const RangeList &cover( ((const BlockBasic *)graph.getBlock(i))->getCover() );
+      set<Range>::const_iterator iter;
+      for(iter=cover.begin();iter!=cover.end();++iter) {
+	AddrSpace *spc = (*iter).getSpace();
+	if (spc->getWordSize() != 1) continue;
+	uintb last = (*iter).getLast() & mask;
+	for(uintb pageoff = (*iter).getFirst() & mask;;pageoff += bytepagesize) {
+	  if (pageoff + (bytepagesize - 1) <= spc->getHighest()) {
+	    Address pageaddr(spc,pageoff);
+	    if (bytecache.find(pageaddr) == bytecache.end() &&
+		find(pages.begin(),pages.end(),pageaddr) == pages.end())
+	      pages.push_back(pageaddr);
+	  }
+	  if (pageoff == last || pages.size() >= prefetchmax) break;
+	}
+	if (pages.size() >= prefetchmax) break;
+      }
+      if (pages.size() >= prefetchmax) break;
+    }
+    if (bytecache.size() + pages.size() > bytecachemax)
+      pages.clear();		// Don't let the prefetch flush the cache
+  }
+  uint4 commentflags = 0;
+  CommentDatabaseGhidra *ghidradb = dynamic_cast<CommentDatabaseGhidra *>(commentdb);
+  if (ghidradb != (CommentDatabaseGhidra *)0 && !ghidradb->isCacheFilled() && prefetchcomments == (Document *)0) {
+    commentflags = print->getHeaderComment();
+    commentflags |= print->getInstructionComment();
+  }
+  vector<vector<uintb> > cpoolrefs;
+  ConstantPoolGhidra *ghidrapool = dynamic_cast<ConstantPoolGhidra *>(cpool);
+  if (ghidrapool != (ConstantPoolGhidra *)0) {
+    list<PcodeOp *>::const_iterator iter;
+    for(iter=fd.beginOp(CPUI_CPOOLREF);iter!=fd.endOp(CPUI_CPOOLREF);++iter) {
+      PcodeOp *op = *iter;
+      if (op->numInput() < 2) continue;
+      vector<uintb> refs;
+      for(int4 i=1;i<op->numInput();++i)
+	refs.push_back(op->getIn(i)->getOffset());
+      if (ghidrapool->isKnown(refs)) continue;
+      if (find(cpoolrefs.begin(),cpoolrefs.end(),refs) != cpoolrefs.end()) continue;
+      cpoolrefs.push_back(refs);
+    }
+  }
+  int4 numqueries = pages.size() + (commentflags != 0 ? 1 : 0) + cpoolrefs.size();
+  if (numqueries < 2) return;
+
+  for(int4 i=0;i<pages.size();++i)
+    writeBytesQuery(bytepagesize,pages[i]);
+  if (commentflags != 0)
+    writeCommentsQuery(fd.getAddress(),commentflags);
+  for(int4 i=0;i<cpoolrefs.size();++i)
+    writeCPoolRefQuery(cpoolrefs[i]);
+  sout.flush();
+
+  for(int4 i=0;i<pages.size();++i) {
+    vector<uint1> page(bytepagesize);
+    try {
+      readBytesResponse(page.data(),bytepagesize,pages[i]);
+    }
+    catch(DataUnavailError &err) {
+      page.clear();
+    }
+    catch(JavaError &err) {
+      if (err.type == "alignment") throw;
+      continue;			// Leave the page to be queried again when it is needed
+    }
+    bytecache[pages[i]] = page;
+  }
+  if (commentflags != 0) {
+    try {
+      prefetchcomments = readXMLAll(sin);
+      prefetchcommentaddr = fd.getAddress();
+      prefetchcommentflags = commentflags;
+    }
+    catch(JavaError &err) {
+      if (err.type == "alignment") throw;	// Otherwise the comments are queried again when needed
+    }
+  }
+  for(int4 i=0;i<cpoolrefs.size();++i) {
+    Document *doc;
+    try {
+      doc = readXMLAll(sin);
+    }
+    catch(JavaError &err) {
+      if (err.type == "alignment") throw;
+      continue;			// The record is queried again when needed, reporting the error then
+    }
+    if (doc != (Document *)0)
+      ghidrapool->addPending(cpoolrefs[i],doc);
+  }
+}
+
+/// Requests are answered from a cache of aligned pages, so a run of small requests for nearby
+/// bytes costs a single query to the client.  Requests that can't be answered from whole pages
+/// are passed to the client as is.  This method throws a DataUnavailError if the provided
+/// address doesn't make sense. The cache is cleared by clearByteCache().
+/// \param buf is the preallocated array in which to store the bytes
+/// \param size is the number of bytes requested
+/// \param inaddr is the address in the LoadImage from which to grab bytes
+void ArchitectureGhidra::getBytes(uint1 *buf,int4 size,const Address &inaddr)
+
+{
+  AddrSpace *spc = inaddr.getSpace();
+  uintb off = inaddr.getOffset();
+  uintb endoff = off + (size - 1);
+  if (size <= 0 || size > bytepagesize || spc->getWordSize() != 1 || endoff < off || endoff > spc->getHighest()) {
+    fetchBytes(buf,size,inaddr);
+    return;
+  }
+  uintb mask = ~((uintb)(bytepagesize - 1));
+  uintb lastpage = endoff & mask;
+  int4 copied = 0;
+  for(uintb pageoff = off & mask;;pageoff += bytepagesize) {
+    const vector<uint1> *page = obtainBytePage(Address(spc,pageoff));
+    if (page == (const vector<uint1> *)0) {
+      fetchBytes(buf,size,inaddr);
+      return;
+    }
+    uintb start = (pageoff < off) ? off - pageoff : 0;
+    int4 len = bytepagesize - start;
+    if (len > size - copied)
+      len = size - copied;
+    memcpy(buf + copied,page->data() + start,len);
+    copied += len;
+    if (pageoff == lastpage) break;
+  }
+}
+
 /// \brief Retrieve p-code to inject for a specific context
 ///
 /// The particular injection is named and is of one of the types:
@@ -658,13 +1088,9 @@ Document *ArchitectureGhidra::getPcodeInject(const string &name,int4 type,const
   return readXMLAll(sin);
 }
 
-/// The Ghidra client is provided a sequence of 1 or more integer values
-/// extracted from a CPOOLREF op. It returns an XML document describing
-/// the constant pool record referenced by the integer(s) or will throw
-/// an exception if record isn't properly referenced.
+/// The query is sent but the response is not read, so other queries can be sent first.
 /// \param refs is an array of 1 or more integer values referencing a constant pool record
-/// \return a description of the record as a \<cpoolrec> XML document.
-Document *ArchitectureGhidra::getCPoolRef(const vector<uintb> &refs)
+void ArchitectureGhidra::writeCPoolRefQuery(const vector<uintb> &refs)
 
 {
   sout.write("\000\000\001\004",4);
@@ -676,6 +1102,18 @@ Document *ArchitectureGhidra::getCPoolRef(const vector<uintb> &refs)
   }
   sout.write("\000\000\001\017",4);
   sout.write("\000\000\001\005",4);
+}
+
+/// The Ghidra client is provided a sequence of 1 or more integer values
+/// extracted from a CPOOLREF op. It returns an XML document describing
+/// the constant pool record referenced by the integer(s) or will throw
+/// an exception if record isn't properly referenced.
+/// \param refs is an array of 1 or more integer values referencing a constant pool record
+/// \return a description of the record as a \<cpoolrec> XML document.
+Document *ArchitectureGhidra::getCPoolRef(const vector<uintb> &refs)
+
+{
+  writeCPoolRefQuery(refs);
   sout.flush();
 
   return readXMLAll(sin);
@@ -713,6 +1151,14 @@ void ArchitectureGhidra::printMessage(const string &message) const
 /// \param corespec is a list of core data-types presented as a \<coretypes> XML tag
 /// \param i is the input stream from the Ghidra client
 /// \param o is the output stream to the Ghidra client
+ArchitectureGhidra::~ArchitectureGhidra(void)
+
+{
+  clearPrefetch();
+  for(int4 i=0;i<specdocs.size();++i)
+    SpecDocumentCache::release(specdocs[i]);
+}
+
 ArchitectureGhidra::ArchitectureGhidra(const string &pspec,const string &cspec,const string &tspec,
 				       const string &corespec,istream &i,ostream &o)
   : Architecture(), sin(i), sout(o)
@@ -727,5 +1173,12 @@ ArchitectureGhidra::ArchitectureGhidra(const string &pspec,const string &cspec,c
   sendsyntaxtree = true;	// Default to sending everything
   sendCcode = true;
   sendParamMeasures = false;
+  sendsummary = false;
+  sendlinemarkup = false;
+  senddraft = false;
+  binaryprotocol = false;
+  prefetchbytes = true;
+  prefetchcomments = (Document *)0;
+  prefetchcommentflags = 0;
 }
 }
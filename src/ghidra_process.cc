@@ -15,9 +15,20 @@
  */
 #include "ghidra_process.hh"
 #include "flow.hh"
-#include "blockaction.hh"
+#include "resultcache.hh"
+#include "database_ghidra.hh"
+#include "tracespan.hh"
+#include "ghidra_translate.hh"
+#include "ghidra_server.hh"
+#include "funcsummary.hh"
 
 #include <vector>
+#include <mutex>
+#include <thread>
+#include <fstream>
+#include <chrono>
+#include <cerrno>
+#include <unistd.h>
 
 namespace GhidraDec {
 
@@ -67,6 +78,37 @@ void turn_off_debugging(Funcdata *fd)
 #endif
 
 std::vector<ArchitectureGhidra *> archlist; // List of architectures currently running
+static std::vector<istream *> archclient;	// Input stream of the client that registered each architecture
+static std::mutex archlistlock;			// Guards archlist and archclient, which sessions share
+
+/// \brief Look up a registered architecture by id, on behalf of a client
+///
+/// A client can only reach the programs it registered itself, so sessions of a
+/// multi-client server stay isolated from each other.
+/// \param id is the id of the program
+/// \param client is the input stream of the client
+/// \return the architecture, or null if there is none for the client
+static ArchitectureGhidra *lookupArch(int4 id,istream &client)
+
+{
+  std::lock_guard<std::mutex> lock(archlistlock);
+  if ((id<0)||(id>=archlist.size())) return (ArchitectureGhidra *)0;
+  if (archclient[id] != &client) return (ArchitectureGhidra *)0;
+  return archlist[id];
+}
+
+/// \brief Attach, or detach, the requests that the analysis of a program acts on
+///
+/// This is done holding the same lock as CancelDecompile, so the interrupt can't be
+/// detached, or the program deleted, while it is being cancelled.
+/// \param glb is the program
+/// \param interrupt is the interrupt to attach, or null to detach
+static void setArchInterrupt(ArchitectureGhidra *glb,AnalysisInterrupt *interrupt)
+
+{
+  std::lock_guard<std::mutex> lock(archlistlock);
+  glb->interrupt = interrupt;
+}
 
 std::map<std::string,GhidraCommand *> GhidraCapability::commandmap; // List of commands we can receive from Ghidra proper
 
@@ -87,8 +129,7 @@ void GhidraCommand::loadParameters(void)
   type = ArchitectureGhidra::readToAnyBurst(sin);
   if (type != 15)
     throw JavaError("alignment","Expecting arch id end");
-  if ((id>=0)&&(id<archlist.size()))
-    ghidra = archlist[id];
+  ghidra = lookupArch(id,sin);
 
   if (ghidra == (ArchitectureGhidra *)0)
     throw JavaError("decompiler","No architecture registered with decompiler");
@@ -119,12 +160,15 @@ int4 GhidraCommand::doit(void)
 
 {
   status = 0;
+  commandend = false;
   sout.write("\000\000\001\006",4); // Command response header
   try {
     loadParameters();
-    int4 type = ArchitectureGhidra::readToAnyBurst(sin);
-    if (type != 3)
-      throw JavaError("alignment","Missing end of command");
+    if (!commandend) {
+      int4 type = ArchitectureGhidra::readToAnyBurst(sin);
+      if (type != 3)
+	throw JavaError("alignment","Missing end of command");
+    }
     rawAction();
   }
   catch(XmlError &err) {
@@ -163,6 +207,22 @@ void RegisterProgram::loadParameters(void)
   ArchitectureGhidra::readStringStream(sin,cspec);
   ArchitectureGhidra::readStringStream(sin,tspec);
   ArchitectureGhidra::readStringStream(sin,corespec);
+  protocol.clear();
+  binary = false;
+  int4 type = ArchitectureGhidra::readToAnyBurst(sin);
+  if (type == 3) {		// No protocol options
+    commandend = true;
+    return;
+  }
+  if (type != 14)
+    throw JavaError("alignment","Expecting protocol options");
+  ArchitectureGhidra::readStringContents(sin,protocol);
+  istringstream s(protocol);
+  string option;
+  while(s >> option) {
+    if (option == "binary")
+      binary = true;
+  }
 }
 
 
@@ -171,21 +231,24 @@ void RegisterProgram::rawAction(void)
 {
   int4 i;
   int4 open = -1;
-  for(i=0;i<archlist.size();++i) {
-    ghidra = archlist[i];
-    if (ghidra == (ArchitectureGhidra *)0) {
-      open = i;			// Found open slot
-    }
-  }
   ghidra = new ArchitectureGhidra(pspec,cspec,tspec,corespec,sin,sout);
+  ghidra->setBinaryProtocol(binary);
 
   DocumentStorage store;	// temp storage of initialization xml docs
   ghidra->init(store);
+  std::lock_guard<std::mutex> lock(archlistlock);
+  for(i=0;i<archlist.size();++i) {
+    if (archlist[i] == (ArchitectureGhidra *)0) {
+      open = i;			// Found open slot
+    }
+  }
   if (open == -1) {
     open = archlist.size();
     archlist.push_back((ArchitectureGhidra *)0);
+    archclient.push_back((istream *)0);
   }
   archlist[open] = ghidra;
+  archclient[open] = &sin;
   archid = open;
 }
 
@@ -195,6 +258,12 @@ void RegisterProgram::sendResult(void)
   sout.write("\000\000\001\016",4);
   sout << dec << archid;
   sout.write("\000\000\001\017",4);
+  if (!protocol.empty()) {	// Only a client that asked for options expects an answer
+    sout.write("\000\000\001\016",4);
+    if (binary)
+      sout << "binary";
+    sout.write("\000\000\001\017",4);
+  }
   GhidraCommand::sendResult();
 }
 
@@ -209,8 +278,7 @@ void DeregisterProgram::loadParameters(void)
   type = ArchitectureGhidra::readToAnyBurst(sin);
   if (type!=15)
     throw JavaError("alignment","Expecting deregister id end");
-  if ((inid>=0)&&(inid<archlist.size()))
-    ghidra = archlist[inid];
+  ghidra = lookupArch(inid,sin);
 
   if (ghidra == (ArchitectureGhidra *)0)
     throw JavaError("decompiler","No architecture registered with decompiler");
@@ -226,7 +294,11 @@ void DeregisterProgram::rawAction(void)
 #endif
   if (ghidra != (ArchitectureGhidra *)0) {
     res = 1;
-    archlist[inid] = (ArchitectureGhidra *)0;
+    {
+      std::lock_guard<std::mutex> lock(archlistlock);
+      archlist[inid] = (ArchitectureGhidra *)0;
+      archclient[inid] = (istream *)0;
+    }
     delete ghidra;
     ghidra = (ArchitectureGhidra *)0;
     status = 1;
@@ -244,15 +316,25 @@ void DeregisterProgram::sendResult(void)
   GhidraCommand::sendResult();
 }
 
-void FlushNative::rawAction(void)
+/// \param glb is the program
+void FlushNative::flush(ArchitectureGhidra *glb)
 
 {
-  Scope *globscope = ghidra->symboltab->getGlobalScope();
+  Scope *globscope = glb->symboltab->getGlobalScope();
   globscope->clear();		// Clear symbols first as this may delete scopes
-  ghidra->symboltab->deleteSubScopes(globscope); // Flush cached function and globals database
-  ghidra->types->clearNoncore(); // Reset type information
-  ghidra->commentdb->clear();	// Clear any comments
-  ghidra->cpool->clear();
+  glb->symboltab->deleteSubScopes(globscope); // Flush cached function and globals database
+  glb->types->clearNoncore(); // Reset type information
+  glb->commentdb->clear();	// Clear any comments
+  glb->pcodeinjectlib->clearCache();	// Injection p-code may have changed
+  glb->cpool->clear();
+  glb->clearByteCache();	// Program bytes may have changed
+  ((const GhidraTranslate *)glb->translate)->clearPcodeCache();	// So may the instructions
+}
+
+void FlushNative::rawAction(void)
+
+{
+  flush(ghidra);
   res = 0;
 }
 
@@ -265,6 +347,81 @@ void FlushNative::sendResult(void)
   GhidraCommand::sendResult();
 }
 
+void InvalidateNative::loadParameters(void)
+
+{
+  GhidraCommand::loadParameters();
+  ranges.clear();
+  symbols.clear();
+  types.clear();
+  cpoolchanged = false;
+  Document *doc = ArchitectureGhidra::readXMLStream(sin);
+  const Element *root = doc->getRoot();
+  if (root->getName() != "invalidate") {
+    delete doc;
+    throw LowlevelError("Expecting <invalidate> tag");
+  }
+  const List &list(root->getChildren());
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter) {
+    const Element *el = *iter;
+    if (el->getName() == "range") {
+      ranges.emplace_back();
+      ranges.back().restoreXml(el,ghidra);
+    }
+    else if (el->getName() == "symbol")
+      symbols.push_back(el->getAttributeValue("name"));
+    else if (el->getName() == "type") {
+      istringstream s(el->getAttributeValue("id"));
+      s.unsetf(std::ios::dec | std::ios::hex | std::ios::oct);
+      uint8 id = 0;
+      s >> id;
+      types.push_back(id);
+    }
+    else if (el->getName() == "cpool")
+      cpoolchanged = true;
+  }
+  delete doc;
+}
+
+void InvalidateNative::rawAction(void)
+
+{
+  for(int4 i=0;i<types.size();++i) {
+    if (ghidra->types->hasId(types[i])) {
+      FlushNative::flush(ghidra);	// Too much may refer to the data-type, start over
+      res = 1;
+      return;
+    }
+  }
+  ScopeGhidra *scope = dynamic_cast<ScopeGhidra *>(ghidra->symboltab->getGlobalScope());
+  if (scope == (ScopeGhidra *)0)
+    throw LowlevelError("Global scope is not backed by the client");
+  for(int4 i=0;i<symbols.size();++i)
+    scope->invalidateSymbol(symbols[i]);
+  for(int4 i=0;i<ranges.size();++i) {
+    scope->invalidateRange(ranges[i]);
+    ghidra->invalidateBytes(ranges[i]);
+    ((const GhidraTranslate *)ghidra->translate)->invalidatePcode(ranges[i]);
+  }
+  if (cpoolchanged)
+    ghidra->cpool->clear();
+  if (!ranges.empty() || !symbols.empty())
+    ghidra->commentdb->clear();	// Only one function's comments are cached, refetched in one query
+  if (!ranges.empty() || !symbols.empty() || cpoolchanged)
+    scope->resetFunctions();
+  res = 0;
+}
+
+void InvalidateNative::sendResult(void)
+
+{
+  sout.write("\000\000\001\016",4);
+  sout << dec << res;
+  sout.write("\000\000\001\017",4);
+  GhidraCommand::sendResult();
+}
+
 void DecompileAt::loadParameters(void)
 
 {
@@ -289,19 +446,248 @@ void DecompileAt::rawAction(void)
     s << addr.getSpace()->getName() << " may not be a global space in the spec file.";
     throw LowlevelError(s.str());
   }
+  ResultCache *cache = fd->isProcStarted() ? (ResultCache *)0 : ghidra->resultcache;
+  if (cache == (ResultCache *)0) {
+    if (ghidra->getSendDraft() && !fd->isProcStarted())
+      sendDraft(fd);
+    decompile(fd);
+    sout.write("\000\000\001\016",4);
+				// Write output XML directly to outstream
+    saveResult(fd,sout);
+    sout.write("\000\000\001\017",4);
+    return;
+  }
+
+  uint8 key = cache->hashInputs(fd,cacheConfig());
+  string output;
+  if (!cache->lookup(key,output)) {
+    LoadImageRecorder recorder(ghidra);	// Recording the draft's reads too, as the full pass may not repeat them
+    if (ghidra->getSendDraft())
+      sendDraft(fd);
+    decompile(fd);
+    sout.write("\000\000\001\016",4);
+    string copy;
+    saveCaptured(fd,sout,copy);	// Stream the result as it is produced, keeping a copy for the cache
+    sout.write("\000\000\001\017",4);
+    if (fd->isProcComplete())
+      cache->store(key,fd,recorder.getReads(),copy);
+    return;
+  }
+  sout.write("\000\000\001\016",4);
+  sout << output;
+  sout.write("\000\000\001\017",4);
+}
+
+/// The results are passed through to the stream as they are produced.
+/// \param fd is the decompiled function
+/// \param s is the stream to write the results to
+/// \param copy will hold a copy of everything written
+void DecompileAt::saveCaptured(Funcdata *fd,ostream &s,string &copy)
+
+{
+  OutputRecorder tee(s);
+  ostream out(&tee);
+  ostream *oldstream = ghidra->print->getOutputStream();
+  ghidra->print->setOutputStream(&out);
+  try {
+    saveResult(fd,out);
+  }
+  catch(LowlevelError &err) {
+    ghidra->print->setOutputStream(oldstream);
+    throw;
+  }
+  ghidra->print->setOutputStream(oldstream);
+  out.flush();
+  copy = tee.getOutput();
+}
+
+/// The function is decompiled with the \e draft root Action, which has no conditional execution,
+/// double precision or sub-variable flow simplification and doesn't resolve indirect calls, so
+/// it rarely restarts.  The results are written out and flushed, so the client can show them
+/// while the full analysis runs.  The analysis is then cleared, so the full pass starts over,
+/// although the symbols and bytes fetched from the client for the draft are not fetched again.
+/// \param fd is the function, which must not have analysis yet
+void DecompileAt::sendDraft(Funcdata *fd)
+
+{
+  decompile(fd,ghidra->allacts.getRoot("draft"));
+  sout.write("\000\000\001\016",4);
+  saveResult(fd,sout);
+  sout.write("\000\000\001\017",4);
+  sout.flush();
+  ghidra->clearAnalysis(fd);
+}
+
+/// This is folded into the ResultCache key, so results saved with different options aren't mixed.
+/// \return the options as a string
+string DecompileAt::cacheConfig(void) const
+
+{
+  ostringstream config;
+  config << ghidra->getSendParamMeasures() << ghidra->getSendSyntaxTree() << ghidra->getSendCCode() << ghidra->getSendSummary() << ghidra->getSendLineMarkup();
+  return config.str();
+}
+
+/// \param fd is the function to decompile
+/// \param root is the \e root Action to apply, or null for the current one
+void DecompileAt::decompile(Funcdata *fd,Action *root)
+
+{
+  static const int4 traceid = TraceLog::registerKind("decompile","function");
+  TraceSpan span(traceid,&fd->getName());
   if (!fd->isProcStarted()) {
 #ifdef OPACTION_DEBUG
     turn_on_debugging(fd);
 #endif
-    ghidra->allacts.getCurrent()->reset( *fd );
-    ghidra->allacts.getCurrent()->perform( *fd );
+    if (interrupt != (AnalysisInterrupt *)0) {
+      interrupt->clearCancel();
+      setArchInterrupt(ghidra,interrupt);
+    }
+    try {
+      if (root == (Action *)0)
+	root = ghidra->allacts.getCurrent();
+      root->reset( *fd );
+      root->perform( *fd );
+    }
+    catch(AnalysisCancelled &err) {
+      setArchInterrupt(ghidra,(AnalysisInterrupt *)0);
+      ghidra->clearAnalysis(fd);	// So the next request starts over
+      throw;
+    }
+    catch(...) {
+      setArchInterrupt(ghidra,(AnalysisInterrupt *)0);
+      throw;
+    }
+    setArchInterrupt(ghidra,(AnalysisInterrupt *)0);
 #ifdef OPACTION_DEBUG
     turn_off_debugging(fd);
 #endif
   }
+}
+
+/// The callee is skipped if it already has analysis, or a result in the cache.  A callee whose
+/// analysis fails with a recoverable error is skipped too.
+/// \param fd is the callee
+/// \return \b true if results were stored for the callee
+bool PrefetchCallees::prefetch(Funcdata *fd)
+
+{
+  ResultCache *cache = ghidra->resultcache;
+  if (fd->isProcStarted()) return false;
+  uint8 key = cache->hashInputs(fd,cacheConfig());
+  if (cache->contains(key)) return false;
+  bool stored = false;
+  try {
+    LoadImageRecorder recorder(ghidra);
+    decompile(fd);
+    if (fd->isProcComplete()) {
+      ostringstream sink;
+      string copy;
+      saveCaptured(fd,sink,copy);
+      cache->store(key,fd,recorder.getReads(),copy);
+      stored = true;
+    }
+  }
+  catch(RecovError &err) {
+    ghidra->clearAnalysis(fd);
+    return false;
+  }
+  catch(AnalysisCancelled &err) {
+    throw;			// Already cleared by decompile()
+  }
+  catch(...) {
+    ghidra->clearAnalysis(fd);
+    throw;
+  }
+  ghidra->clearAnalysis(fd);
+  return stored;
+}
+
+void PrefetchCallees::rawAction(void)
+
+{
+  res = 0;
+  if (ghidra->resultcache == (ResultCache *)0) return;
+  Scope *globscope = ghidra->symboltab->getGlobalScope();
+  Funcdata *fd = globscope->queryFunction(addr);
+  if (fd == (Funcdata *)0) return;
+  bool cleanup = false;
+  if (!fd->isProcStarted()) {
+    decompile(fd);
+    cleanup = true;
+  }
+  vector<Address> callees;
+  for(int4 i=0;i<fd->numCalls();++i) {
+    const Address &entry(fd->getCallSpecs(i)->getEntryAddress());
+    if (!entry.isInvalid())
+      callees.push_back(entry);
+  }
+  if (cleanup)
+    ghidra->clearAnalysis(fd);
+  try {
+    for(int4 i=0;i<callees.size();++i) {
+      if (ghidra->resultcache->isFull()) break;
+      if (interrupt != (AnalysisInterrupt *)0 && interrupt->isCancelled()) break;
+      Funcdata *callee = globscope->queryFunction(callees[i]);
+      if (callee == (Funcdata *)0 || callee == fd) continue;
+      if (prefetch(callee))
+	res += 1;
+    }
+  }
+  catch(AnalysisCancelled &err) {
+    // Stop with what has been stored so far
+  }
+}
 
+void PrefetchCallees::sendResult(void)
+
+{
   sout.write("\000\000\001\016",4);
-				// Write output XML directly to outstream
+  sout << dec << res;
+  sout.write("\000\000\001\017",4);
+  GhidraCommand::sendResult();
+}
+
+void CancelDecompile::loadParameters(void)
+
+{
+  inid = -1;
+  int4 type = ArchitectureGhidra::readToAnyBurst(sin);
+  if (type!=14)
+    throw JavaError("alignment","Expecting cancel id start");
+  sin >> dec >> inid;
+  type = ArchitectureGhidra::readToAnyBurst(sin);
+  if (type!=15)
+    throw JavaError("alignment","Expecting cancel id end");
+}
+
+void CancelDecompile::rawAction(void)
+
+{
+  res = 0;
+  std::lock_guard<std::mutex> lock(archlistlock);
+  if ((inid<0)||(inid>=archlist.size())) return;
+  ArchitectureGhidra *glb = archlist[inid];
+  if (glb == (ArchitectureGhidra *)0 || glb->interrupt == (AnalysisInterrupt *)0) return;
+  glb->interrupt->cancel();
+  res = 1;
+}
+
+void CancelDecompile::sendResult(void)
+
+{
+  sout.write("\000\000\001\016",4);
+  sout << dec << res;
+  sout.write("\000\000\001\017",4);
+}
+
+/// Nothing is written unless the decompilation completed. C code is emitted through
+/// the PrintLanguage, which must be writing to the same stream.
+/// \param fd is the decompiled function
+/// \param s is the stream to write the results to
+void DecompileAt::saveResult(Funcdata *fd,ostream &s)
+
+{
   if (fd->isProcComplete()) {
     //bool v1 = ghidra->getSendParamMeasures();
     //sout << "value: " << ghidra->getSendParamMeasures() << "\n";
@@ -309,26 +695,33 @@ void DecompileAt::rawAction(void)
     //sout << "value: " << (ghidra->allacts.getCurrentName() == "paramid") << "\n";
     //bool v3 = v1 && v2;
 
-    sout << "<doc>\n";
+    s << "<doc>\n";
     //sout << (v1?"1":"0") << "(" << (int4)v1 << ")\n" << (v2?"1":"0") << "\n" << (v3?"1":"0") << "\n";
 
     if (ghidra->getSendParamMeasures() && (ghidra->allacts.getCurrentName() == "paramid")) {
       ParamIDAnalysis pidanalysis( fd, true ); // Only send back final prototype
-      pidanalysis.saveXml( sout, true );
+      pidanalysis.saveXml( s, true );
+    }
+    else if (ghidra->getSendSummary()) {
+      ostringstream json;
+      FunctionSummary summary(json);
+      summary.save(*fd);
+      s << "<summary>";
+      xml_escape(s,json.str().c_str());
+      s << "</summary>\n";
     }
     else {
       if (ghidra->getSendParamMeasures()) {
 	ParamIDAnalysis pidanalysis( fd, false );
-	pidanalysis.saveXml( sout, true );
+	pidanalysis.saveXml( s, true );
       }
-      fd->saveXml(sout,ghidra->getSendSyntaxTree());
+      fd->saveXml(s,ghidra->getSendSyntaxTree());
       if (ghidra->getSendCCode()&&
 	  (ghidra->allacts.getCurrentName() == "decompile"))
         ghidra->print->docFunction(fd);
     }
-    sout << "</doc>\n";
+    s << "</doc>\n";
   }
-  sout.write("\000\000\001\017",4);
 }
 
 void StructureGraph::loadParameters(void)
@@ -360,6 +753,33 @@ void StructureGraph::rawAction(void)
   sout.write("\000\000\001\017",4);
 }
 
+void StructureEdges::loadParameters(void)
+
+{
+  GhidraCommand::loadParameters();
+  string edges;
+  ArchitectureGhidra::readStringStream(sin,edges);
+  istringstream s(edges);
+  structurer.restore(s);
+}
+
+void StructureEdges::rawAction(void)
+
+{
+  structurer.structure();
+  ostringstream s;
+  structurer.encode(s);
+  result = s.str();
+  structurer.clear();
+}
+
+void StructureEdges::sendResult(void)
+
+{
+  ArchitectureGhidra::writeStringStream(sout,result);
+  GhidraCommand::sendResult();
+}
+
 void SetAction::loadParameters(void)
 
 {
@@ -386,6 +806,18 @@ void SetAction::rawAction(void)
       ghidra->setSendCCode(true);
     else if (printstring == "noc")
       ghidra->setSendCCode(false);
+    else if (printstring == "summary")
+      ghidra->setSendSummary(true);
+    else if (printstring == "nosummary")
+      ghidra->setSendSummary(false);
+    else if (printstring == "linemarkup")
+      ghidra->setSendLineMarkup(true);
+    else if (printstring == "nolinemarkup")
+      ghidra->setSendLineMarkup(false);
+    else if (printstring == "draft")
+      ghidra->setSendDraft(true);
+    else if (printstring == "nodraft")
+      ghidra->setSendDraft(false);
     else if (printstring == "parammeasures")
       ghidra->setSendParamMeasures(true);
     else if (printstring == "noparammeasures")
@@ -394,6 +826,10 @@ void SetAction::rawAction(void)
       ghidra->flowoptions |= FlowInfo::record_jumploads;
     else if (printstring == "nojumpload")
       ghidra->flowoptions &= ~((uint4)FlowInfo::record_jumploads);
+    else if (printstring == "prefetch")
+      ghidra->setPrefetchBytes(true);
+    else if (printstring == "noprefetch")
+      ghidra->setPrefetchBytes(false);
     else
       throw LowlevelError("Unknown print action: "+printstring);
   }
@@ -410,12 +846,53 @@ void SetAction::sendResult(void)
   GhidraCommand::sendResult();
 }
 
+void GetActionStats::loadParameters(void)
+
+{
+  GhidraCommand::loadParameters();
+  resetstring.clear();
+  ArchitectureGhidra::readStringStream(sin,resetstring);
+}
+
+void GetActionStats::rawAction(void)
+
+{
+  Action *root = ghidra->allacts.getCurrent();
+  if (root == (Action *)0)
+    throw LowlevelError("No root action set");
+  ostringstream s;
+  Action::printCsvHeader(s);
+  root->printStatisticsCsv(s,"");
+  if (AnalysisMetrics::isEnabled())
+    AnalysisMetrics::printTotalsCsv(s);
+  stats = s.str();
+  if (resetstring == "reset") {
+    root->resetStats();
+    AnalysisMetrics::resetTotals();
+  }
+}
+
+void GetActionStats::sendResult(void)
+
+{
+  ArchitectureGhidra::writeStringStream(sout,stats);
+  GhidraCommand::sendResult();
+}
+
 SetOptions::SetOptions(void) : GhidraCommand()
 
 {
   doc = (Document *)0;
 }
 
+/// \param i is the input stream from the client
+/// \param o is the output stream to the client
+SetOptions::SetOptions(istream &i,ostream &o) : GhidraCommand(i,o)
+
+{
+  doc = (Document *)0;
+}
+
 SetOptions::~SetOptions(void)
 
 {
@@ -464,6 +941,21 @@ void SetOptions::sendResult(void)
 /// \return the result code of the command
 int4 GhidraCapability::readCommand(istream &sin,ostream &out)
 
+{
+  GhidraCommand *command = findCommand(commandmap,sin,out);
+  if (command == (GhidraCommand *)0)
+    return 0;
+  return command->doit();
+}
+
+/// The name of the command is read from the client and looked up in the given map.
+/// If there is no such command, an error response is sent back to the client.
+/// \param cmds is the map of commands to search
+/// \param sin is the input stream from the client
+/// \param out is the output stream to the client
+/// \return the matching command, or null if the name was not recognized
+GhidraCommand *GhidraCapability::findCommand(const map<string,GhidraCommand *> &cmds,istream &sin,ostream &out)
+
 {
   std::string function;
   int4 type;
@@ -473,17 +965,116 @@ int4 GhidraCapability::readCommand(istream &sin,ostream &out)
   } while(type != 2);
   ArchitectureGhidra::readStringStream(sin,function);
   std::map<std::string,GhidraCommand *>::const_iterator iter;
-  iter = commandmap.find(function);
-  if (iter == commandmap.end()) {
+  iter = cmds.find(function);
+  if (iter == cmds.end()) {
     out.write("\000\000\001\006",4); // Command response header
     out.write("\000\000\001\020",4);
     out << "Bad command: " << function;
     out.write("\000\000\001\021",4);
     out.write("\000\000\001\007",4); // Command response closer
     out.flush();
-    return 0;
+    return (GhidraCommand *)0;
+  }
+  return (*iter).second;
+}
+
+/// Each client of a multi-client server needs its own command objects, which hold the
+/// streams to the client and the state of a command in progress.
+/// \param res will hold the new commands, by name
+/// \param sin is the input stream from the new client
+/// \param sout is the output stream to the new client
+void GhidraCapability::cloneCommands(map<string,GhidraCommand *> &res,istream &sin,ostream &sout)
+
+{
+  std::map<std::string,GhidraCommand *>::const_iterator iter;
+  for(iter=commandmap.begin();iter!=commandmap.end();++iter)
+    res[(*iter).first] = (*iter).second->clone(sin,sout);
+}
+
+/// \return the next character, or EOF if the descriptor is closed
+CaptureBuffer::int_type CaptureBuffer::underflow(void)
+
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  ssize_t res;
+  do {
+    res = read(fd,inbuf,bufsize);
+  } while(res < 0 && errno == EINTR);
+  if (res <= 0)
+    return traits_type::eof();
+  capture.write(inbuf,res);
+  capture.flush();
+  setg(inbuf,inbuf,inbuf+res);
+  return traits_type::to_int_type(*gptr());
+}
+
+/// This is used when a client goes away without deregistering its programs.
+/// \param sin is the input stream of the client
+void GhidraCapability::releasePrograms(istream &sin)
+
+{
+  vector<ArchitectureGhidra *> dead;
+  {
+    std::lock_guard<std::mutex> lock(archlistlock);
+    for(int4 i=0;i<archlist.size();++i) {
+      if (archclient[i] != &sin) continue;
+      dead.push_back(archlist[i]);
+      archlist[i] = (ArchitectureGhidra *)0;
+      archclient[i] = (istream *)0;
+    }
+  }
+  for(int4 i=0;i<dead.size();++i)
+    delete dead[i];
+}
+
+/// Each command is run with fresh command objects that read from the capture, and anything they
+/// send back is discarded.  The replay ends at the end of the capture, or when a command asks to
+/// terminate.  If the decompiler is configured differently from the recorded session, its queries
+/// may no longer line up with the recorded replies, and the rest of the replay is meaningless.
+/// Records are written to the report as (kind,name,count,millis): a \e command record for each
+/// command, with its position in the capture as the count, then a \e total record for each name.
+/// \param sin is the captured input of a session
+/// \param report is the stream to write the records to
+void GhidraCapability::replay(istream &sin,ostream &report)
+
+{
+  ostream discard((std::streambuf *)0);
+  map<string,GhidraCommand *> cmds;
+  cloneCommands(cmds,sin,discard);
+  map<GhidraCommand *,string> names;
+  map<string,GhidraCommand *>::iterator iter;
+  for(iter=cmds.begin();iter!=cmds.end();++iter)
+    names[(*iter).second] = (*iter).first;
+  map<string,pair<int4,double> > totals;
+  ArchitectureGhidra::setExitOnClose(false);
+  report << "kind,name,count,millis" << endl;
+  int4 status = 0;
+  int4 seq = 0;
+  try {
+    while(status == 0) {
+      GhidraCommand *command = findCommand(cmds,sin,discard);
+      if (command == (GhidraCommand *)0) continue;
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      status = command->doit();
+      std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      const string &nm(names[command]);
+      report << "command," << nm << ',' << dec << seq << ',' << elapsed.count() << endl;
+      pair<int4,double> &tot(totals[nm]);
+      tot.first += 1;
+      tot.second += elapsed.count();
+      seq += 1;
+    }
   }
-  return (*iter).second->doit();
+  catch(JavaError &err) {
+    // End of the capture
+  }
+  map<string,pair<int4,double> >::const_iterator titer;
+  for(titer=totals.begin();titer!=totals.end();++titer)
+    report << "total," << (*titer).first << ',' << dec << (*titer).second.first << ',' << (*titer).second.second << endl;
+  releasePrograms(sin);
+  for(iter=cmds.begin();iter!=cmds.end();++iter)
+    delete (*iter).second;
 }
 
 void GhidraCapability::shutDown(void)
@@ -500,23 +1091,157 @@ void GhidraDecompCapability::initialize(void)
   commandmap["registerProgram"] = new RegisterProgram();
   commandmap["deregisterProgram"] = new DeregisterProgram();
   commandmap["flushNative"] = new FlushNative();
+  commandmap["invalidateNative"] = new InvalidateNative();
   commandmap["decompileAt"] = new DecompileAt();
+  commandmap["cancelDecompile"] = new CancelDecompile();
+  commandmap["prefetchCallees"] = new PrefetchCallees();
   commandmap["structureGraph"] = new StructureGraph();
+  commandmap["structureEdges"] = new StructureEdges();
   commandmap["setAction"] = new SetAction();
   commandmap["setOptions"] = new SetOptions();
+  commandmap["getActionStats"] = new GetActionStats();
 }
 
 } // GhidraDec
 
+// With no arguments, a single client is served over stdin and stdout.  Otherwise the
+// process becomes a server for many clients, or replays a captured session:
+//
+//   decompile [-j workers] [-y millis] [-b workers] [-f] [-w specfile] -u socketpath
+//   decompile [-j workers] [-y millis] [-b workers] [-f] [-w specfile] -p port
+//   decompile -c capturefile
+//   decompile -r capturefile
+//
+//   -j   is the number of commands allowed to run at once (default is the number of cores)
+//   -y   lets a long decompilation yield its worker to waiting commands after running this long
+//   -b   is the number of commands of the background class allowed to run at once
+//   -u   listens on a Unix domain socket
+//   -p   listens on a TCP port of the loopback interface
+//   -f   forks a process to serve each connection, sharing what the server has loaded
+//   -w   parses a specification document up front and keeps it for every client (may be repeated)
+//   -c   serves stdin and stdout, recording everything the client sends to the file
+//   -r   runs the commands recorded in the file, without a client, and prints their times as CSV
+//
+// As Ghidra starts the decompiler without arguments, a session can also be recorded by setting
+// DECOMPILE_CAPTURE to a directory, which gets a file decompile.<pid>.cap per process.
+
 int main(int argc,char **argv)
 
 {
   signal(SIGSEGV, &GhidraDec::ArchitectureGhidra::segvHandler);  // Exit on SEGV errors
   GhidraDec::CapabilityPoint::initializeAll();
+  std::string capturepath;
+  std::string replaypath;
+  std::string socketpath;
+  GhidraDec::int4 workers = std::thread::hardware_concurrency();
+  GhidraDec::int4 port = -1;
+  GhidraDec::int4 slice = 0;
+  GhidraDec::int4 backgroundlimit = -1;
+  bool forking = false;
+  vector<std::string> warmfiles;
+  for(GhidraDec::int4 i=1;i<argc;++i) {
+    std::string arg(argv[i]);
+    if (arg == "-f") {
+      forking = true;
+      continue;
+    }
+    if (i+1 >= argc) {
+      cerr << "Missing value for " << arg << endl;
+      return 2;
+    }
+    if (arg == "-j")
+      workers = atoi(argv[++i]);
+    else if (arg == "-u")
+      socketpath = argv[++i];
+    else if (arg == "-p")
+      port = atoi(argv[++i]);
+    else if (arg == "-y")
+      slice = atoi(argv[++i]);
+    else if (arg == "-b")
+      backgroundlimit = atoi(argv[++i]);
+    else if (arg == "-c")
+      capturepath = argv[++i];
+    else if (arg == "-r")
+      replaypath = argv[++i];
+    else if (arg == "-w")
+      warmfiles.push_back(argv[++i]);
+    else {
+      cerr << "usage: " << argv[0] << " [-j workers] [-y millis] [-b workers] [-f] [-w specfile] (-u socketpath | -p port)" << endl;
+      cerr << "       " << argv[0] << " (-c capturefile | -r capturefile)" << endl;
+      return 2;
+    }
+  }
+  if (!replaypath.empty()) {
+    ifstream s(replaypath.c_str(),ios::in | ios::binary);
+    if (!s) {
+      cerr << "Unable to open " << replaypath << endl;
+      return 1;
+    }
+    GhidraDec::GhidraCapability::replay(s,cout);
+    GhidraDec::GhidraCapability::shutDown();
+    return 0;
+  }
+  if (!socketpath.empty() || port >= 0) {
+    try {
+      for(GhidraDec::int4 i=0;i<warmfiles.size();++i) {
+	ifstream s(warmfiles[i].c_str(),ios::in | ios::binary);
+	if (!s)
+	  throw LowlevelError("Unable to open " + warmfiles[i]);
+	ostringstream text;
+	text << s.rdbuf();
+	GhidraDec::SpecDocumentCache::acquire(text.str());	// Held for the life of the server
+      }
+      GhidraDec::GhidraServer server(workers,slice);
+      if (backgroundlimit > 0)
+	server.setClassLimit(GhidraDec::GhidraServer::background,backgroundlimit);
+      server.setForking(forking);
+      if (!socketpath.empty())
+	server.listenUnix(socketpath);
+      else
+	server.listenTcp(port);
+      server.run();
+    }
+    catch(LowlevelError &err) {
+      cerr << err.explain << endl;
+      return 1;
+    }
+    catch(GhidraDec::XmlError &err) {
+      cerr << "Bad specification document: " << err.explain << endl;
+      return 1;
+    }
+    return 0;
+  }
+  if (argc > 1 && capturepath.empty()) {
+    cerr << "No socket path or port given" << endl;
+    return 2;
+  }
+  if (capturepath.empty()) {
+    const char *capturedir = getenv("DECOMPILE_CAPTURE");
+    if (capturedir != (const char *)0) {
+      ostringstream s;
+      s << capturedir << "/decompile." << getpid() << ".cap";
+      capturepath = s.str();
+    }
+  }
+  ofstream capture;
+  GhidraDec::CaptureBuffer *capturebuf = (GhidraDec::CaptureBuffer *)0;
+  std::streambuf *stdinbuf = cin.rdbuf();
+  if (!capturepath.empty()) {
+    capture.open(capturepath.c_str(),ios::out | ios::binary | ios::trunc);
+    if (capture) {
+      capturebuf = new GhidraDec::CaptureBuffer(0,capture);
+      cin.rdbuf(capturebuf);		// Every command object reads the client through cin
+    }
+    else
+      cerr << "Unable to open capture file " << capturepath << endl;
+  }
   GhidraDec::int4 status = 0;
   while(status == 0) {
     status = GhidraDec::GhidraCapability::readCommand(cin,cout);
   }
   GhidraDec::GhidraCapability::shutDown();
+  if (capturebuf != (GhidraDec::CaptureBuffer *)0) {
+    cin.rdbuf(stdinbuf);
+    delete capturebuf;
+  }
 }
-
@@ -0,0 +1,514 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "ghidra_server.hh"
+
+#include <thread>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+namespace GhidraDec {
+
+/// \param s is the connected socket, which \b this takes ownership of
+SocketBuffer::SocketBuffer(int s)
+
+{
+  fd = s;
+  setg(inbuf,inbuf,inbuf);
+  setp(outbuf,outbuf+bufsize);
+}
+
+SocketBuffer::~SocketBuffer(void)
+
+{
+  sync();
+  close(fd);
+}
+
+/// \param ptr points to the bytes to send
+/// \param size is the number of bytes
+/// \return \b true if everything was sent
+bool SocketBuffer::sendAll(const char *ptr,size_t size)
+
+{
+  while(size > 0) {
+    ssize_t res = send(fd,ptr,size,MSG_NOSIGNAL);
+    if (res < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    ptr += res;
+    size -= res;
+  }
+  return true;
+}
+
+/// \return the next character, or EOF if the client closed the connection
+SocketBuffer::int_type SocketBuffer::underflow(void)
+
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  if (sync() != 0)		// The client may be waiting on output before it sends more
+    return traits_type::eof();
+  ssize_t res;
+  do {
+    res = recv(fd,inbuf,bufsize,0);
+  } while(res < 0 && errno == EINTR);
+  if (res <= 0)
+    return traits_type::eof();
+  setg(inbuf,inbuf,inbuf+res);
+  return traits_type::to_int_type(*gptr());
+}
+
+/// \param c is the character that didn't fit in the buffer
+/// \return the character, or EOF if the buffer could not be sent
+SocketBuffer::int_type SocketBuffer::overflow(int_type c)
+
+{
+  if (sync() != 0)
+    return traits_type::eof();
+  if (!traits_type::eq_int_type(c,traits_type::eof())) {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+/// \return 0 on success, or -1 if the client has gone away
+int SocketBuffer::sync(void)
+
+{
+  size_t size = pptr() - pbase();
+  setp(outbuf,outbuf+bufsize);
+  if (size == 0) return 0;
+  return sendAll(outbuf,size) ? 0 : -1;
+}
+
+/// \param s is the server that accepted the connection
+/// \param fd is the connected socket, which the session takes ownership of
+GhidraSession::GhidraSession(GhidraServer *s,int fd)
+  : buffer(fd), sin(&buffer), sout(&buffer), interrupt(s)
+
+{
+  server = s;
+  GhidraCapability::cloneCommands(commands,sin,sout);
+  commands["setRequestClass"] = new SetRequestClass(sin,sout,&interrupt);
+  commands["getRequestStats"] = new GetRequestStats(sin,sout,s);
+  map<string,GhidraCommand *>::iterator iter;
+  for(iter=commands.begin();iter!=commands.end();++iter)
+    (*iter).second->setInterrupt(&interrupt);
+}
+
+GhidraSession::~GhidraSession(void)
+
+{
+  GhidraCapability::releasePrograms(sin);
+  map<string,GhidraCommand *>::iterator iter;
+  for(iter=commands.begin();iter!=commands.end();++iter)
+    delete (*iter).second;
+}
+
+/// Commands are read and executed until one issues the \e terminate meta-command (as
+/// \e deregisterProgram does) or the client closes the connection.  The latency of each
+/// command, including any time spent waiting for a worker, is counted under its class.
+void GhidraSession::run(void)
+
+{
+  int4 status = 0;
+  try {
+    while(status == 0) {
+      GhidraCommand *command = GhidraCapability::findCommand(commands,sin,sout);
+      if (command == (GhidraCommand *)0) continue;
+      int4 cl = command->isBackground() ? GhidraServer::background : interrupt.getRequestClass();
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+      server->acquireWorker(&interrupt,cl);
+      try {
+	status = command->doit();
+      }
+      catch(...) {
+	server->releaseWorker(&interrupt);
+	throw;
+      }
+      server->releaseWorker(&interrupt);
+      std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - start;
+      server->recordLatency(cl,elapsed.count());
+    }
+  }
+  catch(LowlevelError &err) {
+    // The client closed the connection, or the protocol could not be recovered
+  }
+}
+
+/// \param s is the server
+SessionInterrupt::SessionInterrupt(GhidraServer *s)
+
+{
+  server = s;
+  requestclass = GhidraServer::interactive;
+  heldclass = GhidraServer::interactive;
+}
+
+/// Until the slice has passed, a yield is put off to the next check, so a long command is
+/// not forced to give up its worker on every request that arrives.
+void SessionInterrupt::yield(void)
+
+{
+  std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+  if (now - slicestart < std::chrono::milliseconds(server->getSliceMillis())) return;
+  clearYield();
+  int4 cl = heldclass;
+  server->releaseWorker(this);
+  server->acquireWorker(this,cl);
+}
+
+void SetRequestClass::loadParameters(void)
+
+{
+  classname.clear();
+  ArchitectureGhidra::readStringStream(sin,classname);
+}
+
+void SetRequestClass::rawAction(void)
+
+{
+  int4 cl = GhidraServer::findClass(classname);
+  res = 0;
+  if (cl < 0) return;
+  session->setRequestClass(cl);
+  res = 1;
+}
+
+void SetRequestClass::sendResult(void)
+
+{
+  sout.write("\000\000\001\016",4);
+  sout << dec << res;
+  sout.write("\000\000\001\017",4);
+}
+
+void GetRequestStats::loadParameters(void)
+
+{
+  resetstring.clear();
+  ArchitectureGhidra::readStringStream(sin,resetstring);
+}
+
+void GetRequestStats::rawAction(void)
+
+{
+  ostringstream s;
+  server->printLatencyCsv(s,resetstring == "reset");
+  stats = s.str();
+}
+
+void GetRequestStats::sendResult(void)
+
+{
+  ArchitectureGhidra::writeStringStream(sout,stats);
+}
+
+/// \param workers is the maximum number of commands allowed to run at once
+/// \param slice is the minimum number of milliseconds a command runs before yielding, or 0 to never yield
+GhidraServer::GhidraServer(int4 workers,int4 slice)
+
+{
+  listenfd = -1;
+  maxworkers = (workers < 1) ? 1 : workers;
+  slicemillis = (slice < 0) ? 0 : slice;
+  busy = 0;
+  forking = false;
+  for(int4 i=0;i<num_classes;++i) {
+    classlimit[i] = maxworkers;
+    classbusy[i] = 0;
+    waiting[i] = 0;
+    nextticket[i] = 0;
+    serving[i] = 0;
+    for(int4 j=0;j<num_buckets;++j)
+      latency[i][j] = 0;
+  }
+}
+
+GhidraServer::~GhidraServer(void)
+
+{
+  if (listenfd >= 0)
+    close(listenfd);
+}
+
+/// Clients that go away without deregistering their programs must not take the
+/// process down, so closed streams are reported as errors, and SIGPIPE is ignored.
+/// \param fd is the bound socket
+/// \param unixsocket is \b true for a Unix domain socket
+void GhidraServer::startListening(int fd,bool unixsocket)
+
+{
+  if (listen(fd,16) < 0) {
+    close(fd);
+    throw LowlevelError(string("Unable to listen on socket: ") + strerror(errno));
+  }
+  listenfd = fd;
+  ArchitectureGhidra::setExitOnClose(false);
+  signal(SIGPIPE,SIG_IGN);
+  if (forking)
+    signal(SIGCHLD,SIG_IGN);	// Children are reaped automatically
+}
+
+/// Any existing file at the path is removed first.
+/// \param path is the file system path of the socket
+void GhidraServer::listenUnix(const string &path)
+
+{
+  struct sockaddr_un addr;
+  if (path.size() >= sizeof(addr.sun_path))
+    throw LowlevelError("Socket path is too long: " + path);
+  int fd = socket(AF_UNIX,SOCK_STREAM,0);
+  if (fd < 0)
+    throw LowlevelError(string("Unable to create socket: ") + strerror(errno));
+  memset(&addr,0,sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strncpy(addr.sun_path,path.c_str(),sizeof(addr.sun_path)-1);
+  unlink(path.c_str());
+  if (bind(fd,(struct sockaddr *)&addr,sizeof(addr)) < 0) {
+    close(fd);
+    throw LowlevelError("Unable to bind socket " + path + ": " + strerror(errno));
+  }
+  startListening(fd,true);
+}
+
+/// Only the loopback interface is bound, as the protocol has no authentication.
+/// \param port is the TCP port number
+void GhidraServer::listenTcp(int4 port)
+
+{
+  int fd = socket(AF_INET,SOCK_STREAM,0);
+  if (fd < 0)
+    throw LowlevelError(string("Unable to create socket: ") + strerror(errno));
+  int on = 1;
+  setsockopt(fd,SOL_SOCKET,SO_REUSEADDR,&on,sizeof(on));
+  struct sockaddr_in addr;
+  memset(&addr,0,sizeof(addr));
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd,(struct sockaddr *)&addr,sizeof(addr)) < 0) {
+    close(fd);
+    throw LowlevelError(string("Unable to bind TCP port: ") + strerror(errno));
+  }
+  startListening(fd,false);
+}
+
+/// \param srv is the server
+/// \param fd is the connected socket
+void GhidraServer::runSession(GhidraServer *srv,int fd)
+
+{
+  GhidraSession session(srv,fd);
+  session.run();
+}
+
+/// The child serves the connection on its only thread and exits when the client is done.
+/// The server never runs a session itself, so it has no other threads when it forks.
+/// \param fd is the connected socket
+void GhidraServer::forkSession(int fd)
+
+{
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(listenfd);
+    listenfd = -1;
+    runSession(this,fd);
+    _exit(0);
+  }
+  close(fd);			// The child has its own copy, or the fork failed and the client is dropped
+}
+
+/// This does not return unless accepting a connection fails.
+void GhidraServer::run(void)
+
+{
+  if (listenfd < 0)
+    throw LowlevelError("Server is not listening");
+  for(;;) {
+    int fd = accept(listenfd,(struct sockaddr *)0,(socklen_t *)0);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) continue;
+      throw LowlevelError(string("Unable to accept connection: ") + strerror(errno));
+    }
+    if (forking)
+      forkSession(fd);
+    else
+      std::thread(runSession,this,fd).detach();
+  }
+}
+
+/// The limit is clipped to between 1 and the number of workers.
+/// \param cl is the request class
+/// \param limit is the maximum number of commands of the class running at once
+void GhidraServer::setClassLimit(int4 cl,int4 limit)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  if (limit < 1) limit = 1;
+  if (limit > maxworkers) limit = maxworkers;
+  classlimit[cl] = limit;
+}
+
+/// A turn can start if it is next in its class, a worker is free, the class is under its limit,
+/// and no more urgent class has a command waiting that could start instead.
+/// \param cl is the request class
+/// \param ticket is the turn within the class
+/// \return \b true if the turn can take a worker
+bool GhidraServer::canStart(int4 cl,uint8 ticket) const
+
+{
+  if (ticket != serving[cl] || busy >= maxworkers || classbusy[cl] >= classlimit[cl])
+    return false;
+  for(int4 i=0;i<cl;++i) {
+    if (waiting[i] > 0 && classbusy[i] < classlimit[i])
+      return false;
+  }
+  return true;
+}
+
+/// The command that has held its worker the longest, among those of the same or a less urgent
+/// class, is asked to yield.  If the class is at its limit, only a command of the class itself
+/// can make room.
+/// \param cl is the class of the command that is waiting
+void GhidraServer::requestYield(int4 cl)
+
+{
+  bool atlimit = (classbusy[cl] >= classlimit[cl]);
+  SessionInterrupt *oldest = (SessionInterrupt *)0;
+  for(int4 i=0;i<running.size();++i) {
+    SessionInterrupt *cur = running[i];
+    if (atlimit ? (cur->heldclass != cl) : (cur->heldclass < cl)) continue;
+    if (oldest == (SessionInterrupt *)0 || cur->slicestart < oldest->slicestart)
+      oldest = cur;
+  }
+  if (oldest != (SessionInterrupt *)0)
+    oldest->requestYield();
+}
+
+/// Within a class, workers are handed out in the order they were asked for.  If the command
+/// can't start right away and yielding is on, a running command is asked to make way for it.
+/// \param intr is the interrupt of the session asking
+/// \param cl is the request class of the command
+void GhidraServer::acquireWorker(SessionInterrupt *intr,int4 cl)
+
+{
+  std::unique_lock<std::mutex> guard(lock);
+  uint8 ticket = nextticket[cl]++;
+  waiting[cl] += 1;
+  if (!canStart(cl,ticket) && slicemillis > 0)
+    requestYield(cl);
+  while(!canStart(cl,ticket))
+    idle.wait(guard);
+  waiting[cl] -= 1;
+  serving[cl] += 1;
+  busy += 1;
+  classbusy[cl] += 1;
+  intr->heldclass = cl;
+  intr->slicestart = std::chrono::steady_clock::now();
+  running.push_back(intr);
+  idle.notify_all();		// The next turn may also find a free worker
+}
+
+/// \param intr is the interrupt of the session giving the worker back
+void GhidraServer::releaseWorker(SessionInterrupt *intr)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  busy -= 1;
+  classbusy[intr->heldclass] -= 1;
+  for(int4 i=0;i<running.size();++i) {
+    if (running[i] == intr) {
+      running[i] = running.back();
+      running.pop_back();
+      break;
+    }
+  }
+  idle.notify_all();
+}
+
+/// Bucket \e i counts commands that took less than 2^i milliseconds, and at least half that.
+/// The last bucket counts everything slower.
+/// \param cl is the request class
+/// \param millis is the time from the command's arrival to its completion
+void GhidraServer::recordLatency(int4 cl,double millis)
+
+{
+  int4 bucket = 0;
+  double bound = 1.0;
+  while(bucket < num_buckets-1 && millis >= bound) {
+    bucket += 1;
+    bound *= 2.0;
+  }
+  std::lock_guard<std::mutex> guard(lock);
+  latency[cl][bucket] += 1;
+}
+
+/// Records are written as (latency,class,bound,count), one for each non-empty bucket, where
+/// \e bound is the bucket's upper limit in milliseconds, or \e inf for the last bucket.
+/// \param s is the output stream
+/// \param reset is \b true to clear the histograms after printing them
+void GhidraServer::printLatencyCsv(ostream &s,bool reset)
+
+{
+  std::lock_guard<std::mutex> guard(lock);
+  s << "kind,class,bound_ms,count" << endl;
+  for(int4 i=0;i<num_classes;++i) {
+    for(int4 j=0;j<num_buckets;++j) {
+      if (latency[i][j] == 0) continue;
+      s << "latency," << getClassName(i) << ',';
+      if (j == num_buckets-1)
+	s << "inf";
+      else
+	s << dec << ((uint8)1 << j);
+      s << ',' << dec << latency[i][j] << endl;
+      if (reset)
+	latency[i][j] = 0;
+    }
+  }
+}
+
+/// \param cl is the request class
+/// \return the name used by SetRequestClass and in reports
+const char *GhidraServer::getClassName(int4 cl)
+
+{
+  static const char *names[] = { "interactive", "background" };
+  return names[cl];
+}
+
+/// \param nm is the name of the class
+/// \return the request class, or -1 if the name is not recognized
+int4 GhidraServer::findClass(const string &nm)
+
+{
+  for(int4 i=0;i<num_classes;++i) {
+    if (nm == getClassName(i))
+      return i;
+  }
+  return -1;
+}
+
+}
@@ -99,10 +99,75 @@ void GhidraTranslate::getUserOpNames(vector<string> &res) const
   }
 }
 
-int4 GhidraTranslate::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
+void GhidraTranslate::CacheEmit::dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize)
+
+{
+  inst.ops.emplace_back();
+  CachedOp &op(inst.ops.back());
+  op.opc = opc;
+  op.start = inst.vars.size();
+  op.numin = isize;
+  op.hasout = (outvar != (VarnodeData *)0);
+  if (op.hasout)
+    inst.vars.push_back(*outvar);
+  for(int4 i=0;i<isize;++i)
+    inst.vars.push_back(vars[i]);
+}
+
+/// The cache is dropped if the context database has changed since it was filled.
+void GhidraTranslate::checkContext(void) const
 
 {
-  int4 offset;
+  if (glb->context != (ContextDatabase *)0 && glb->context->getGeneration() != contextgeneration) {
+    clearPcodeCache();
+    contextgeneration = glb->context->getGeneration();
+  }
+}
+
+/// \brief Decode the client's reply for one instruction and add it to the cache
+///
+/// \param baseaddr is the address of the instruction
+/// \param doc is the packed p-code from the client, which is freed
+/// \return the cached instruction
+const GhidraTranslate::CachedInstruction &GhidraTranslate::storeInstruction(const Address &baseaddr,uint1 *doc) const
+
+{
+  CachedInstruction inst;
+  uintb val;
+  const uint1 *ptr = PcodeEmit::unpackOffset(doc+1,val);
+  inst.length = (int4)val;
+  inst.unimpl = (*doc == PcodeEmit::unimpl_tag);
+  if (!inst.unimpl) {
+    int4 spcindex = (int4)(*ptr++ - 0x20);
+    AddrSpace *spc = getSpace(spcindex);
+    uintb instoffset;
+    ptr = PcodeEmit::unpackOffset(ptr,instoffset);
+    inst.pc = Address(spc,instoffset);
+    CacheEmit emit(inst);
+    while(*ptr == PcodeEmit::op_tag)
+      ptr = emit.restorePackedOp(inst.pc,ptr,this);
+  }
+  delete [] doc;
+  if (inst.length > maxcachedlength)
+    maxcachedlength = inst.length;
+  CachedInstruction &res(pcodecache[baseaddr]);
+  res = std::move(inst);
+  return res;
+}
+
+/// The p-code for the instruction is requested from the client the first time it is seen, and
+/// the decoded ops are kept, so flow that is followed again after a restart doesn't repeat the
+/// query.
+/// \param baseaddr is the address of the instruction
+/// \return the decoded p-code
+const GhidraTranslate::CachedInstruction &GhidraTranslate::fetchInstruction(const Address &baseaddr) const
+
+{
+  checkContext();
+  map<Address,CachedInstruction>::const_iterator iter = pcodecache.find(baseaddr);
+  if (iter != pcodecache.end())
+    return (*iter).second;
+
   uint1 *doc;
   try {
     doc = glb->getPcodePacked(baseaddr);	// Request p-code for one instruction
@@ -119,29 +184,133 @@ int4 GhidraTranslate::oneInstruction(PcodeEmit &emit,const Address &baseaddr) co
     baseaddr.printRaw(s);
     throw BadDataError(s.str());
   }
+  return storeInstruction(baseaddr,doc);
+}
 
-  uintb val;
-  const uint1 *ptr = PcodeEmit::unpackOffset(doc+1,val);
-  offset = (int4)val;
+/// \brief Replay the p-code of a cached instruction
+///
+/// \param emit is the emitter receiving the p-code
+/// \param baseaddr is the address of the instruction
+/// \param inst is the cached instruction
+/// \return the length of the instruction in bytes
+int4 GhidraTranslate::emitInstruction(PcodeEmit &emit,const Address &baseaddr,const CachedInstruction &inst)
 
-  if (*doc == PcodeEmit::unimpl_tag) {
+{
+  if (inst.unimpl) {
     ostringstream s;
     s << "Instruction not implemented in pcode:\n ";
     baseaddr.printRaw(s);
-    delete [] doc;
-    throw UnimplError(s.str(),offset);
-  }
-
-  int4 spcindex = (int4)(*ptr++ - 0x20);
-  AddrSpace *spc = getSpace(spcindex);
-  uintb instoffset;
-  ptr = PcodeEmit::unpackOffset(ptr,instoffset);
-  Address pc(spc,instoffset);
-  
-  while(*ptr == PcodeEmit::op_tag)
-    ptr = emit.restorePackedOp(pc,ptr,this);
-  delete [] doc;
-  return offset;
+    throw UnimplError(s.str(),inst.length);
+  }
+  VarnodeData vars[30];
+  for(int4 i=0;i<inst.ops.size();++i) {
+    const CachedOp &op(inst.ops[i]);
+    const VarnodeData *ptr = inst.vars.data() + op.start;
+    VarnodeData *outvar = (VarnodeData *)0;
+    VarnodeData out;
+    if (op.hasout) {
+      out = *ptr++;
+      outvar = &out;
+    }
+    for(int4 j=0;j<op.numin;++j)	// The emitter is allowed to modify the varnodes it is handed
+      vars[j] = ptr[j];
+    emit.dump(inst.pc,op.opc,outvar,vars,op.numin);
+  }
+  return inst.length;
+}
+
+int4 GhidraTranslate::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
+
+{
+  return emitInstruction(emit,baseaddr,fetchInstruction(baseaddr));
+}
+
+/// Addresses whose p-code is already cached are skipped, and the rest are requested from the
+/// client together, in a single round trip.  Nothing is sent unless at least two
+/// instructions are missing.  Addresses the client can't produce p-code for are left out of
+/// the cache, so the error is reported if the address is ever translated.
+/// \param addrs is the list of instruction addresses
+void GhidraTranslate::prefetchInstructions(const vector<Address> &addrs) const
+
+{
+  checkContext();
+  vector<Address> missing;
+  for(int4 i=0;i<addrs.size();++i) {
+    if (pcodecache.find(addrs[i]) == pcodecache.end())
+      missing.push_back(addrs[i]);
+  }
+  if (missing.size() < 2) return;
+  vector<uint1 *> docs;
+  glb->getPcodePackedBatch(missing,docs);
+  for(int4 i=0;i<missing.size();++i) {
+    if (docs[i] != (uint1 *)0)
+      storeInstruction(missing[i],docs[i]);
+  }
+}
+
+/// If the processor's instructions are all the length of its alignment, the address of every
+/// instruction in the run is known in advance.  In that case the whole run is requested from the
+/// client in one batch, before any of it is translated. Otherwise, and beyond what was
+/// fetched, the run only extends over instructions that are already cached, so the client is
+/// never asked for more instructions than the flow actually reaches.
+int4 GhidraTranslate::translateRun(PcodeRun &run,const Address &baseaddr,int4 maxbytes,int4 maxinsn) const
+
+{
+  int4 align = getAlignment();
+  if (align > 1 && maxinsn > 1 && maxbytes > align) {
+    int4 count = maxbytes / align;
+    if (count > maxinsn) count = maxinsn;
+    if (count > maxbatch) count = maxbatch;
+    vector<Address> addrs;
+    for(int4 i=0;i<count;++i)
+      addrs.push_back(baseaddr + i * align);
+    prefetchInstructions(addrs);
+  }
+  run.clear();
+  run.beginInstruction(baseaddr);
+  int4 total = oneInstruction(run,baseaddr);
+  run.endInstruction(total);
+  Address curaddr = baseaddr + total;
+  while(!run.endsFlow() && total < maxbytes && run.numInstructions() < maxinsn) {
+    map<Address,CachedInstruction>::const_iterator iter = pcodecache.find(curaddr);
+    if (iter == pcodecache.end()) break;
+    const CachedInstruction &inst((*iter).second);
+    if (inst.unimpl || inst.length <= 0) break;
+    run.beginInstruction(curaddr);
+    emitInstruction(run,curaddr,inst);
+    run.endInstruction(inst.length);
+    total += inst.length;
+    curaddr = curaddr + inst.length;
+  }
+  return total;
+}
+
+void GhidraTranslate::clearPcodeCache(void) const
+
+{
+  pcodecache.clear();
+  maxcachedlength = 0;
+}
+
+/// Any instruction that has one of its bytes in the range is removed from the cache.
+/// \param rng is the memory range whose bytes may have changed
+void GhidraTranslate::invalidatePcode(const Range &rng) const
+
+{
+  AddrSpace *spc = rng.getSpace();
+  uintb first = rng.getFirst();
+  uintb back = (maxcachedlength > 0) ? maxcachedlength - 1 : 0;
+  first = (first > back) ? first - back : 0;
+  map<Address,CachedInstruction>::iterator iter = pcodecache.lower_bound(Address(spc,first));
+  while(iter != pcodecache.end()) {
+    const Address &addr( (*iter).first );
+    if (addr.getSpace() != spc || addr.getOffset() > rng.getLast()) break;
+    uintb lastbyte = addr.getOffset() + ((*iter).second.length > 0 ? (*iter).second.length - 1 : 0);
+    if (lastbyte >= rng.getFirst())
+      pcodecache.erase(iter++);
+    else
+      ++iter;
+  }
 }
 
 /// The Ghidra client passes descriptions of address spaces and other
@@ -113,6 +113,7 @@ void ContextDatabase::setVariableDefault(const string &nm,uintm val)
 {
   ContextBitRange &var( getVariable(nm) );
   var.setValue(getDefaultValue(),val);
+  touch();
 }
 
 /// This will return the default value used for addresses that have not been overlaid with other values.
@@ -141,6 +142,7 @@ void ContextDatabase::setVariable(const string &nm,const Address &addr,
   getRegionToChangePoint(contvec,addr,num,mask);
   for(uint4 i=0;i<contvec.size();++i)
     bitrange.setValue(contvec[i],value);
+  touch();
 }
 
 /// If a value has not been explicit set for an address range containing the given address,
@@ -178,6 +180,7 @@ void ContextDatabase::setContextChangePoint(const Address &addr,int4 num,uintm m
     val |= value;
     newcontext[ num ] = val;
   }
+  touch();
 }
 
 /// \brief Set a context variable value over a given range of addresses
@@ -196,6 +199,7 @@ void ContextDatabase::setContextRegion(const Address &addr1,const Address &addr2
   getRegionForSet(vec,addr1,addr2,num,mask);
   for(uint4 i=0;i<vec.size();++i)
     vec[i][num] = (vec[i][num] & ~mask) | value;
+  touch();
 }
 
 /// \brief Set a context variable by name over a given range of addresses
@@ -217,6 +221,7 @@ void ContextDatabase::setVariableRegion(const string &nm,
   getRegionForSet(vec,begad,endad,bitrange.getWord(),bitrange.getMask() << bitrange.getShift());
   for(int4 i=0;i<vec.size();++i)
     bitrange.setValue(vec[i],value);
+  touch();
 }
 
 /// \brief Get the value of a tracked register at a specific address
@@ -377,6 +382,7 @@ void ContextInternal::restoreContext(const Element *el,const Address &addr1,cons
       var.setValue(vec[i],val);
     ++iter;
   }
+  touch();
 }
 
 void ContextInternal::registerVariable(const string &nm,int4 sbit,int4 ebit)
@@ -394,6 +400,7 @@ void ContextInternal::registerVariable(const string &nm,int4 sbit,int4 ebit)
     database.defaultValue().reset(size);
   }
   variables[nm] = bitrange;
+  touch();
 }
 
 ContextBitRange &ContextInternal::getVariable(const string &nm)
@@ -573,29 +580,66 @@ ContextCache::ContextCache(ContextDatabase *db)
 
 {
   database = db;
-  curspace = (AddrSpace *)0;	// Mark cache as invalid
   allowset = true;
+  invalidate();
 }
 
-/// Check if the address is in the current valid range. If it is, return the cached
-/// blob.  Otherwise, make a call to the database and cache a new block and valid range.
+void ContextCache::invalidate(void) const
+
+{
+  generation = database->getGeneration();
+  for(int4 i=0;i<numentries;++i)
+    entry[i].space = (AddrSpace *)0;	// Mark entry as unused
+}
+
+/// Check if the address is in the valid range of a cached blob. If it is, return that
+/// blob.  Otherwise, make a call to the database and cache the new blob and valid range,
+/// replacing the least recently used one.  The blob belongs to the database and is only
+/// guaranteed to hold the values for the address until the generation of the database changes.
+/// \param addr is the given address
+/// \return the context blob
+const uintm *ContextCache::getContext(const Address &addr) const
+
+{
+  if (generation != database->getGeneration())
+    invalidate();		// Context has changed since the blobs were retrieved
+  AddrSpace *spc = addr.getSpace();
+  uintb off = addr.getOffset();
+  int4 i;
+  for(i=0;i<numentries;++i) {
+    const Entry &cur(entry[i]);
+    if (cur.space == spc && cur.first <= off && off <= cur.last) break;
+  }
+  Entry hit;
+  if (i < numentries)
+    hit = entry[i];
+  else {
+    i = numentries - 1;
+    hit.space = spc;
+    hit.context = database->getContext(addr,hit.first,hit.last);
+  }
+  for(;i>0;--i)			// Move the blob to the front
+    entry[i] = entry[i-1];
+  entry[0] = hit;
+  return hit.context;
+}
+
+/// The blob for the address is copied out of the database, so it stays valid across
+/// later changes to context.
 /// \param addr is the given address
 /// \param buf is where the blob should be stored
 void ContextCache::getContext(const Address &addr,uintm *buf) const
 
 {
-  if ((addr.getSpace()!=curspace)||(first>addr.getOffset())||(last<addr.getOffset())) {
-    curspace = addr.getSpace();
-    context = database->getContext(addr,first,last);
-  }
-  for(int4 i=0;i<database->getContextSize();++i) 
-    buf[i] = context[i];
+  const uintm *context = getContext(addr);
+  for(int4 j=0;j<database->getContextSize();++j)
+    buf[j] = context[j];
 }
 
 /// \brief Change the value of a context variable at the given address with no bound
 ///
 /// The context value is set starting at the given address and \e paints memory up
-/// to the next explicit change point.
+/// to the next explicit change point.  Cached blobs are dropped by the change of generation.
 /// \param addr is the given starting address
 /// \param num is the word index of the context variable
 /// \param mask is the mask delimiting the context variable
@@ -605,14 +649,13 @@ void ContextCache::setContext(const Address &addr,int4 num,uintm mask,uintm valu
 {
   if (!allowset) return;
   database->setContextChangePoint(addr,num,mask,value);
-  if ((addr.getSpace()==curspace)&&(first<=addr.getOffset())&&(last>=addr.getOffset()))
-    curspace = (AddrSpace *)0;	// Invalidate cache
 }
 
 /// \brief Change the value of a context variable across an explicit address range
 ///
 /// The context value is \e painted across the range. The context variable is marked as
-/// explicitly changing at the starting address of the range.
+/// explicitly changing at the starting address of the range. Cached blobs are dropped by
+/// the change of generation.
 /// \param addr1 is the starting address of the given range
 /// \param addr2 is the ending address of the given range
 /// \param num is the word index of the context variable
@@ -623,12 +666,6 @@ void ContextCache::setContext(const Address &addr1,const Address &addr2,int4 num
 {
   if (!allowset) return;
   database->setContextRegion(addr1,addr2,num,mask,value);
-  if ((addr1.getSpace()==curspace)&&(first<=addr1.getOffset())&&(last>=addr1.getOffset()))
-    curspace = (AddrSpace *)0;	// Invalidate cache
-  if ((first<=addr2.getOffset())&&(last>=addr2.getOffset()))
-    curspace = (AddrSpace *)0;	// Invalidate cache
-  if ((first>=addr1.getOffset())&&(first<=addr2.getOffset()))
-    curspace = (AddrSpace *)0;	// Invalidate cache
 }
 
 }
@@ -16,6 +16,9 @@
 #include "heritage.hh"
 #include "funcdata.hh"
 #include "prefersplit.hh"
+#include "tracespan.hh"
+
+#include <thread>
 
 namespace GhidraDec {
 /// Update disjoint cover making sure (addr,size) is contained in a single element
@@ -139,6 +142,7 @@ Heritage::Heritage(Funcdata *data)
   fd = data;
   pass = 0;
   maxdepth = -1;
+  rangestamp = 0;
 }
 
 void Heritage::clearInfoList(void)
@@ -234,7 +238,7 @@ Varnode *Heritage::normalizeReadSize(Varnode *vn,const Address &addr,int4 size)
   Varnode *vn1,*vn2;
   PcodeOp *op,*newop;
 
-  list<PcodeOp *>::const_iterator oiter = vn->beginDescend();
+  DescendList::const_iterator oiter = vn->beginDescend();
   op = *oiter++;
   if (oiter != vn->endDescend())
     throw LowlevelError("Free varnode with multiple reads");
@@ -363,7 +367,7 @@ Varnode *Heritage::concatPieces(const vector<Varnode *> &vnlist,PcodeOp *inserto
   bool isbigendian = preexist->getAddr().isBigEndian();
   Address opaddress;
   BlockBasic *bl;
-  list<PcodeOp *>::iterator insertiter;
+  PcodeOpList::iterator insertiter;
 
   if (insertop == (PcodeOp *)0) { // Insert at the beginning
     bl = (BlockBasic *)fd->getBasicBlocks().getStartBlock();
@@ -420,7 +424,7 @@ void Heritage::splitPieces(const vector<Varnode *> &vnlist,PcodeOp *insertop,
   uintb baseoff;
   bool isbigendian;
   BlockBasic *bl;
-  list<PcodeOp *>::iterator insertiter;
+  PcodeOpList::iterator insertiter;
 
   isbigendian = addr.isBigEndian();
   if (isbigendian)
@@ -513,9 +517,15 @@ void Heritage::guard(const Address &addr,int4 size,vector<Varnode *> &read,vecto
     flags = 0;
     // Query for generic properties of address (use empty usepoint)
     fd->getScopeLocal()->queryProperties(addr,size,Address(),flags);
-    guardCalls(flags,addr,size,write);
+    bool unread = read.empty() && inputvars.empty() && ((flags & (Varnode::addrtied|Varnode::persist))==0);
+    if (unread) {
+      ParamActive *active = fd->getActiveOutput();
+      if (active != (ParamActive *)0 && fd->getFuncProto().possibleOutputParam(addr,size))
+	unread = false;		// RETURN ops will read the range
+    }
+    guardCalls(flags,addr,size,write,unread);
     guardReturns(flags,addr,size,write);
-    if (fd->getArch()->highPtrPossible(addr,size)) {
+    if (fd->getArch()->highPtrPossible(addr,size) && !unread) {
       guardStores(addr,size,write);
       //      guardLoads(flags,addr,size,write);
     }
@@ -528,11 +538,17 @@ void Heritage::guard(const Address &addr,int4 size,vector<Varnode *> &read,vecto
 /// across each call site in the function.  If an effect is unknown, an
 /// INDIRECT op is added, prepopulating data-flow through the call.
 /// Any new INDIRECT causes a new Varnode to be added to the \b write list.
+///
+/// If nothing reads the range, an INDIRECT for an \e unknown effect would be dead
+/// as soon as it was created, so none is built. If a later pass introduces a read,
+/// the range is guarded again, because none of its writes is an INDIRECT yet. This only
+/// holds if no INDIRECT at all is built for the range, so any other kind of guard cancels it.
 /// \param flags are any boolean properties associated with the address range
 /// \param addr is the first address of given range
 /// \param size is the number of bytes in the range
 /// \param write is the list of written Varnodes in the range (may be updated)
-void Heritage::guardCalls(uint4 flags,const Address &addr,int4 size,vector<Varnode *> &write)
+/// \param unread is \b true if nothing reads the range (cleared if a call input trial is added)
+void Heritage::guardCalls(uint4 flags,const Address &addr,int4 size,vector<Varnode *> &write,bool &unread)
 
 {
   FuncCallSpecs *fc;
@@ -540,13 +556,17 @@ void Heritage::guardCalls(uint4 flags,const Address &addr,int4 size,vector<Varno
   uint4 effecttype;
 
   bool holdind = ((flags&Varnode::addrtied)!=0);
+  if (effecthint.size() < fd->numCalls())
+    effecthint.resize(fd->numCalls(),0);
+  vector<uint4> effects(fd->numCalls(),EffectRecord::unaffected);
+  vector<bool> outputs(fd->numCalls(),false);
   for(int4 i=0;i<fd->numCalls();++i) {
     fc = fd->getCallSpecs(i);
     if (fc->getOp()->isAssignment()) {
       Varnode *vn = fc->getOp()->getOut();
       if ((vn->getAddr()==addr)&&(vn->getSize()==size)) continue;
     }
-    effecttype = fc->hasEffectTranslate(addr,size);
+    effecttype = fc->hasEffectTranslate(addr,size,effecthint[i]);
     bool possibleoutput = false;
     if (fc->isOutputActive()) {
       ParamActive *active = fc->getActiveOutput();
@@ -583,10 +603,22 @@ void Heritage::guardCalls(uint4 flags,const Address &addr,int4 size,vector<Varno
 	  Varnode *vn = fd->newVarnode(size,addr);
 	  vn->setActiveHeritage();
 	  fd->opInsertInput(op,vn,op->numInput());
+	  unread = false;	// The new trial reads the range at this call
 	}
       }
     }
+    effects[i] = effecttype;
+    outputs[i] = possibleoutput;
+    if (effecttype == EffectRecord::killedbycall || effecttype == EffectRecord::return_address)
+      unread = false;		// Any INDIRECT marks the range as guarded, so guard it completely
+  }
+  for(int4 i=0;i<fd->numCalls();++i) {
+    fc = fd->getCallSpecs(i);
+    effecttype = effects[i];
+    bool possibleoutput = outputs[i];
     // We do not guard the call if the effect is "unaffected" or "reload"
+    if (effecttype == EffectRecord::unknown_effect && unread)
+      continue;			// Any INDIRECT would be dead code
     if ((effecttype == EffectRecord::unknown_effect)||(effecttype == EffectRecord::return_address)) {
       indop = fd->newIndirectOp(fc->getOp(),addr,size);
       indop->getIn(0)->setActiveHeritage();
@@ -1314,6 +1346,11 @@ void Heritage::buildADT(void)
   augment.resize(size);
   flags.clear();
   flags.resize(size,0);
+  markstamp.clear();
+  markstamp.resize(size,0);
+  mergestamp.clear();
+  mergestamp.resize(size,0);
+  rangestamp = 0;
 
   bblocks.buildDomTree(domchild);
 #ifdef DFSVERIFY_DEBUG
@@ -1366,6 +1403,51 @@ void Heritage::buildADT(void)
       k = z[k];
     }
   }
+  buildFrontier();
+}
+
+/// For every join point (a block with more than one incoming edge), walk up the dominator
+/// tree from each predecessor until reaching the immediate dominator of the join point.
+/// Every block passed is given the join point in its frontier.
+/// Assume the dominator tree is already built.
+void Heritage::buildFrontier(void)
+
+{
+  const BlockGraph &bblocks(fd->getBasicBlocks());
+  int4 size = bblocks.getSize();
+
+  frontier.clear();
+  frontier.resize(size);
+  for(int4 i=0;i<size;++i) {
+    FlowBlock *bl = bblocks.getBlock(i);
+    if (bl->sizeIn() < 2) continue;
+    FlowBlock *idom = bl->getImmedDom();
+    for(int4 j=0;j<bl->sizeIn();++j) {
+      FlowBlock *runner = bl->getIn(j);
+      while(runner != idom && runner != (FlowBlock *)0) {
+	vector<int4> &df(frontier[runner->getIndex()]);
+	if (df.empty() || df.back() != i)	// Predecessors are visited together, so duplicates are adjacent
+	  df.push_back(i);
+	runner = runner->getImmedDom();
+      }
+    }
+  }
+}
+
+/// Marks left on blocks by the previous address range are invalidated all at once,
+/// without visiting any block, so the cost of placing phi-nodes for a range depends
+/// only on the blocks it touches. The stamps are only cleared explicitly if the counter wraps.
+void Heritage::nextRangeStamp(void)
+
+{
+  rangestamp += 1;
+  if (rangestamp == 0) {	// Counter wrapped, old stamps could alias
+    for(int4 i=0;i<markstamp.size();++i) {
+      markstamp[i] = 0;
+      mergestamp[i] = 0;
+    }
+    rangestamp = 1;
+  }
 }
 
 /// \brief The heart of the phi-node placement algorithm
@@ -1390,12 +1472,12 @@ void Heritage::visitIncr(FlowBlock *qnode,FlowBlock *vnode)
     v = *iter;
     if (v->getImmedDom()->getIndex() < j) { // If idom(v) is strict ancestor of qnode
       k = v->getIndex();
-      if ((flags[k]&merged_node)==0) {
+      if (mergestamp[k] != rangestamp) {
 	merge.push_back(v);
-	flags[k] |= merged_node;
+	mergestamp[k] = rangestamp;
       }
-      if ((flags[k]&mark_node)==0) { // If v is not marked
-	flags[k] |= mark_node;	// then mark it
+      if (markstamp[k] != rangestamp) { // If v is not marked
+	markstamp[k] = rangestamp;	// then mark it
 	pq.insert(v,depth[k]); // insert it into the queue
       }
     }
@@ -1405,7 +1487,7 @@ void Heritage::visitIncr(FlowBlock *qnode,FlowBlock *vnode)
   if ((flags[i]&boundary_node)==0) { // If vnode is not a boundary node
     for(j=0;j<domchild[i].size();++j) {
       child = domchild[i][j];
-      if ((flags[child->getIndex()]&mark_node)==0)	// If the child is not marked
+      if (markstamp[child->getIndex()] != rangestamp)	// If the child is not marked
 	visitIncr(qnode,child);
     }
   }
@@ -1414,58 +1496,202 @@ void Heritage::visitIncr(FlowBlock *qnode,FlowBlock *vnode)
 /// \brief Calculate blocks that should contain MULTIEQUALs for one address range
 ///
 /// This is the main entry point for the phi-node placement algorithm. It is
-/// provided the normalized list of written Varnodes in this range.
+/// provided the blocks containing the normalized list of written Varnodes in this range.
 /// All refinement and guarding must already be performed for the Varnodes, and
 /// the dominance tree and its augmentation must already be computed.
 /// After this executes, the \b merge array holds blocks that should contain
 /// a MULTIEQUAL.
-/// \param write is the list of written Varnodes
-void Heritage::calcMultiequals(const vector<Varnode *> &write)
+/// \param writeblocks holds the indices of blocks containing a write
+void Heritage::calcMultiequals(const vector<int4> &writeblocks)
 
 {
   pq.reset(maxdepth);
   merge.clear();
+  nextRangeStamp();
 
   int4 i,j;
   FlowBlock *bl;
 				// Place write blocks into the pq
-  for(i=0;i<write.size();++i) {
-    bl = write[i]->getDef()->getParent(); // Get block where this write occurs
-    j = bl->getIndex();
-    if ((flags[j]&mark_node)!=0) continue; // Already put in
+  for(i=0;i<writeblocks.size();++i) {
+    j = writeblocks[i];
+    bl = fd->getBasicBlocks().getBlock(j); // Get block where this write occurs
+    if (markstamp[j] == rangestamp) continue; // Already put in
     pq.insert(bl,depth[j]);	// Insert input node into priority queue
-    flags[j] |= mark_node;	// mark input node
+    markstamp[j] = rangestamp;	// mark input node
   }
-  if ((flags[0]&mark_node)==0) { // Make sure start node is in input
+  if (markstamp[0] != rangestamp) { // Make sure start node is in input
     pq.insert(fd->getBasicBlocks().getBlock(0),depth[0]);
-    flags[0] |= mark_node;
+    markstamp[0] = rangestamp;
   }
 
   while(!pq.empty()) {
     bl = pq.extract();		// Extract the next block
     visitIncr(bl,bl);
   }
-  for(i=0;i<flags.size();++i)
-    flags[i] &= ~(mark_node|merged_node); // Clear marks from nodes
 }
 
-/// \brief The heart of the renaming algorithm.
+/// \brief Calculate blocks that should contain MULTIEQUALs for many address ranges at once
+///
+/// The iterated dominance frontier is computed for up to 64 ranges together, with one bit
+/// per range in each block's sets, so a single traversal of the frontier edges serves
+/// every range in the batch. As with calcMultiequals(), the start block counts as a
+/// write for every range.
+/// \param writeblocks holds, for each range, the indices of blocks containing a write
+/// \param first is the index of the first range in the batch
+/// \param count is the number of ranges in the batch (at most 64)
+/// \param mergesets will hold, for each range in the batch, the blocks in block order
+void Heritage::calcMultiequalsBatch(const vector<vector<int4> > &writeblocks,int4 first,int4 count,
+				    vector<vector<FlowBlock *> > &mergesets) const
+
+{
+  const BlockGraph &bblocks(fd->getBasicBlocks());
+  int4 size = bblocks.getSize();
+  vector<uintb> seen(size,0);		// Ranges that have a write or MULTIEQUAL in the block
+  vector<uintb> phi(size,0);		// Ranges that need a MULTIEQUAL in the block
+  vector<uintb> pending(size,0);	// Ranges still to be pushed to the block's frontier
+  vector<int4> worklist;
+  uintb allbits = (count == 64) ? ~((uintb)0) : ((((uintb)1) << count) - 1);
+
+  for(int4 r=0;r<count;++r) {
+    uintb bit = ((uintb)1) << r;
+    const vector<int4> &blocks(writeblocks[first + r]);
+    for(int4 i=0;i<blocks.size();++i)
+      seen[blocks[i]] |= bit;
+  }
+  seen[0] = allbits;			// The start block defines every range
+  for(int4 i=0;i<size;++i) {
+    if (seen[i] == 0) continue;
+    pending[i] = seen[i];
+    worklist.push_back(i);
+  }
+  while(!worklist.empty()) {
+    int4 cur = worklist.back();
+    worklist.pop_back();
+    uintb bits = pending[cur];
+    pending[cur] = 0;
+    const vector<int4> &df(frontier[cur]);
+    for(int4 i=0;i<df.size();++i) {
+      int4 d = df[i];
+      phi[d] |= bits;
+      uintb newbits = bits & ~seen[d];	// A MULTIEQUAL is a new write for these ranges
+      if (newbits == 0) continue;
+      seen[d] |= newbits;
+      if (pending[d] == 0)
+	worklist.push_back(d);
+      pending[d] |= newbits;
+    }
+  }
+  mergesets.clear();
+  mergesets.resize(count);
+  for(int4 i=0;i<size;++i) {
+    uintb bits = phi[i];
+    for(int4 r=0;bits!=0;++r,bits>>=1) {
+      if ((bits & 1) != 0)
+	mergesets[r].push_back(bblocks.getBlock(i));
+    }
+  }
+}
+
+/// \param addr is the starting address of the range
+/// \param size is the number of bytes in the range
+/// \param blocks are the basic blocks that need a MULTIEQUAL for the range
+void Heritage::insertMultiequals(const Address &addr,int4 size,const vector<FlowBlock *> &blocks)
+
+{
+  for(int4 i=0;i<blocks.size();++i) {
+    BlockBasic *bl = (BlockBasic *) blocks[i];
+    PcodeOp *multiop = fd->newOp(bl->sizeIn(),bl->getStart());
+    Varnode *vnout = fd->newVarnodeOut(size,addr,multiop);
+    vnout->setActiveHeritage();
+    fd->opSetOpcode(multiop,CPUI_MULTIEQUAL); // Create each MULTIEQUAL
+    for(int4 j=0;j<bl->sizeIn();++j) {
+      Varnode *vnin = fd->newVarnode(size,addr);
+      fd->opSetInput(multiop,vnin,j);
+    }
+    fd->opInsertBegin(multiop,bl);	// Insert at beginning of block
+  }
+}
+
+/// Each distinct address of a Varnode in the given ranges gets the next stack index.
+/// \param fd is the function being heritaged
+/// \param disjoint holds the address ranges being heritaged
+void VariableStack::build(const Funcdata *fd,LocationMap &disjoint)
+
+{
+  varindex.assign(fd->getVarnodeCreateIndex(),-1);
+  LocationMap::iterator iter;
+  for(iter=disjoint.begin();iter!=disjoint.end();++iter) {
+    const Address &addr((*iter).first);
+    uintb size = (*iter).second.size;
+    VarnodeLocSet::const_iterator viter = fd->beginLoc(addr);
+    VarnodeLocSet::const_iterator enditer = fd->endLoc();
+    Address curaddr;
+    int4 index = -1;
+    while(viter != enditer) {
+      Varnode *vn = *viter;
+      ++viter;
+      if (vn->getSpace() != addr.getSpace() || vn->getOffset() - addr.getOffset() >= size)
+	break;
+      if (index < 0 || vn->getAddr() != curaddr) {
+	curaddr = vn->getAddr();
+	index = stack.size();
+	stack.emplace_back();
+	addrindex[AddressKey(curaddr)] = index;
+      }
+      varindex[vn->getCreateIndex()] = index;
+    }
+  }
+}
+
+/// \param vn is the given Varnode
+/// \return the index of the stack for the Varnode's address
+int4 VariableStack::assignIndex(const Varnode *vn)
+
+{
+  map<AddressKey,int4>::iterator iter = addrindex.find(AddressKey(vn->getAddr()));
+  int4 index;
+  if (iter != addrindex.end())
+    index = (*iter).second;
+  else {
+    index = stack.size();
+    stack.emplace_back();
+    addrindex[AddressKey(vn->getAddr())] = index;
+  }
+  if (vn->getCreateIndex() < varindex.size())
+    varindex[vn->getCreateIndex()] = index;
+  return index;
+}
+
+/// \param vn is the given Varnode
+/// \return the index of the stack holding the active writes for the Varnode's address
+int4 VariableStack::getIndex(const Varnode *vn)
+
+{
+  uint4 ci = vn->getCreateIndex();
+  if (ci < varindex.size() && varindex[ci] >= 0)
+    return varindex[ci];
+  return assignIndex(vn);
+}
+
+/// \brief The heart of the renaming algorithm, applied to a single block
 ///
-/// From the given block, recursively walk the dominance tree. At each
-/// block, visit the PcodeOps in execution order looking for Varnodes that
+/// Visit the PcodeOps of the block in execution order looking for Varnodes that
 /// need to be renamed.  As write Varnodes are encountered, a set of stack
 /// containers, differentiated by the Varnode's address, are updated so the
 /// so the current \e active Varnode is always ready for any \e free Varnode that
 /// is encountered. In this was all \e free Varnodes are replaced with the
 /// appropriate write Varnode or are promoted to a formal \e input Varnode.
+/// The MULTIEQUAL inputs of the successor blocks are filled in last. The stack index
+/// of every write made in the block is added to the write list, so the writes can be
+/// popped when the walk of the dominance tree leaves the block (see rename()).
 /// \param bl is the current basic block in the dominance tree walk
 /// \param varstack is the system of stacks, organized by address
-void Heritage::renameRecurse(BlockBasic *bl,VariableStack &varstack)
+/// \param writelist accumulates the stack index of each write pushed
+void Heritage::renameBlock(BlockBasic *bl,VariableStack &varstack,vector<int4> &writelist)
 
 {
-  vector<Varnode *> writelist;	// List varnodes that are written in this block
   BlockBasic *subbl;
-  list<PcodeOp *>::iterator oiter,suboiter;
+  PcodeOpList::iterator oiter,suboiter;
   PcodeOp *op,*multiop;
   Varnode *vnout,*vnin,*vnnew;
   int4 i,slot;
@@ -1479,7 +1705,7 @@ void Heritage::renameRecurse(BlockBasic *bl,VariableStack &varstack)
 	if (vnin->isHeritageKnown()) continue; // not free
 	if (!vnin->isActiveHeritage()) continue; // Not being heritaged this round
 	vnin->clearActiveHeritage();
-	vector<Varnode *> &stack( varstack[ vnin->getAddr() ] );
+	vector<Varnode *> &stack( varstack.getStack(varstack.getIndex(vnin)) );
 	if (stack.empty()) {
 	  vnnew = fd->newVarnode(vnin->getSize(),vnin->getAddr());
 	  vnnew = fd->setInputVarnode(vnnew);
@@ -1499,6 +1725,7 @@ void Heritage::renameRecurse(BlockBasic *bl,VariableStack &varstack)
 	      vnnew = stack[stack.size()-2];
 	  }
 	}
+	AnalysisMetrics::count(AnalysisMetrics::heritage_rename);
 	fd->opSetInput(op,vnnew,slot);
 	if (vnin->hasNoDescend())
 	  fd->deleteVarnode(vnin);
@@ -1509,8 +1736,9 @@ void Heritage::renameRecurse(BlockBasic *bl,VariableStack &varstack)
     if (vnout == (Varnode *)0) continue;
     if (!vnout->isActiveHeritage()) continue; // Not a normalized write
     vnout->clearActiveHeritage();
-    varstack[ vnout->getAddr() ].push_back(vnout); // Push write onto stack
-    writelist.push_back(vnout);
+    int4 index = varstack.getIndex(vnout);
+    varstack.getStack(index).push_back(vnout); // Push write onto stack
+    writelist.push_back(index);
   }
   for(i=0;i<bl->sizeOut();++i) {
     subbl = (BlockBasic *)bl->getOut(i);
@@ -1520,7 +1748,7 @@ void Heritage::renameRecurse(BlockBasic *bl,VariableStack &varstack)
       if (multiop->code()!=CPUI_MULTIEQUAL) break; // For each MULTIEQUAL
       vnin = multiop->getIn(slot);
       if (!vnin->isHeritageKnown()) {
-	vector<Varnode *> &stack( varstack[ vnin->getAddr() ] );
+	vector<Varnode *> &stack( varstack.getStack(varstack.getIndex(vnin)) );
 	if (stack.empty()) {
 	  vnnew = fd->newVarnode(vnin->getSize(),vnin->getAddr());
 	  vnnew = fd->setInputVarnode(vnnew);
@@ -1528,20 +1756,12 @@ void Heritage::renameRecurse(BlockBasic *bl,VariableStack &varstack)
 	}
 	else
 	  vnnew = stack.back();
+	AnalysisMetrics::count(AnalysisMetrics::heritage_rename);
 	fd->opSetInput(multiop,vnnew,slot);
 	if (vnin->hasNoDescend())
 	  fd->deleteVarnode(vnin);
       }
     }
-  }
-				// Now we recurse to subtrees
-  i = bl->getIndex();
-  for(slot=0;slot<domchild[i].size();++slot)
-    renameRecurse((BlockBasic *)domchild[i][slot],varstack);
-				// Now we pop this blocks writes of the stack
-  for(i=0;i<writelist.size();++i) {
-    vnout = writelist[i];
-    varstack[vnout->getAddr()].pop_back();
   }
 }
 
@@ -1568,19 +1788,48 @@ void Heritage::bumpDeadcodeDelay(Varnode *vn)
 
 /// \brief Perform the renaming algorithm for the current set of address ranges
 ///
-/// Phi-node placement must already have happened.
+/// Phi-node placement must already have happened.  The dominance tree is walked depth first
+/// with an explicit stack, renaming each block as it is entered (see renameBlock()), and
+/// popping the block's writes from the variable stacks as it is left.
 void Heritage::rename(void)
 
 {
   VariableStack varstack;
-  renameRecurse((BlockBasic *)fd->getBasicBlocks().getBlock(0),varstack);
+  varstack.build(fd,disjoint);
+  vector<int4> writelist;		// Stack index of every write in the blocks on the walk
+  vector<pair<FlowBlock *,int4> > path;	// Blocks being walked, with the next child to visit
+  vector<int4> writemark;		// Size of the write list when each block was entered
+  FlowBlock *bl = fd->getBasicBlocks().getBlock(0);
+  renameBlock((BlockBasic *)bl,varstack,writelist);
+  path.push_back(pair<FlowBlock *,int4>(bl,0));
+  writemark.push_back(0);
+  while(!path.empty()) {
+    const vector<FlowBlock *> &children( domchild[path.back().first->getIndex()] );
+    int4 slot = path.back().second;
+    if (slot < children.size()) {
+      path.back().second = slot + 1;
+      bl = children[slot];
+      writemark.push_back(writelist.size());
+      renameBlock((BlockBasic *)bl,varstack,writelist);
+      path.push_back(pair<FlowBlock *,int4>(bl,0));
+      continue;
+    }
+    for(int4 i=writelist.size();i>writemark.back();--i)
+      varstack.getStack(writelist[i-1]).pop_back();	// Pop the block's writes off the stacks
+    writelist.resize(writemark.back());
+    writemark.pop_back();
+    path.pop_back();
+  }
   disjoint.clear();
 }
 
 /// \brief Perform phi-node placement for the current set of address ranges
 ///
 /// Main entry point for performing the phi-node placement algorithm.
-/// Assume \b disjoint is filled with all the free Varnodes to be heritaged
+/// Assume \b disjoint is filled with all the free Varnodes to be heritaged.
+/// Every range is first collected, refined, and guarded. If more than one range
+/// remains, MULTIEQUAL placement is computed for all of them together in batches
+/// (see calcMultiequalsBatch()), otherwise the single range is placed directly.
 void Heritage::placeMultiequals(void)
 
 {
@@ -1588,11 +1837,12 @@ void Heritage::placeMultiequals(void)
   vector<Varnode *> readvars;
   vector<Varnode *> writevars;
   vector<Varnode *> inputvars;
-  PcodeOp *multiop;
-  Varnode *vnin;
-  BlockBasic *bl;
+  vector<Address> rangeaddr;		// Ranges needing placement
+  vector<int4> rangesize;
+  vector<vector<int4> > writeblocks;	// Blocks with a write, for each range
   int4 max;
 
+  effecthint.assign(fd->numCalls(),0);	// Ranges are guarded in address order, so each call's effects are swept once
   for(iter=disjoint.begin();iter!=disjoint.end();++iter) { 
     Address addr = (*iter).first;
     int4 size = (*iter).second.size;
@@ -1615,23 +1865,73 @@ void Heritage::placeMultiequals(void)
     guardInput(addr,size,inputvars);
     guard(addr,size,readvars,writevars,inputvars);
     if (readvars.empty()&&writevars.empty()) continue;
-    calcMultiequals(writevars); // Calculate where MULTIEQUALs go
-    for(int4 i=0;i<merge.size();++i) {
-      bl = (BlockBasic *) merge[i];
-      multiop = fd->newOp(bl->sizeIn(),bl->getStart());
-      Varnode *vnout = fd->newVarnodeOut(size,addr,multiop);
-      vnout->setActiveHeritage();
-      fd->opSetOpcode(multiop,CPUI_MULTIEQUAL); // Create each MULTIEQUAL
-      for(int4 j=0;j<bl->sizeIn();++j) {
-	vnin = fd->newVarnode(size,addr);
-	fd->opSetInput(multiop,vnin,j);
+    rangeaddr.push_back(addr);
+    rangesize.push_back(size);
+    writeblocks.emplace_back();
+    for(int4 i=0;i<writevars.size();++i)
+      writeblocks.back().push_back(writevars[i]->getDef()->getParent()->getIndex());
+  }
+  if (rangeaddr.size() == 1) {
+    calcMultiequals(writeblocks[0]); // Calculate where MULTIEQUALs go
+    insertMultiequals(rangeaddr[0],rangesize[0],merge);
+  }
+  else {
+    int4 numbatches = (rangeaddr.size() + 63) / 64;
+    int4 numthreads = fd->getArch()->heritage_threads;
+    if (numthreads > numbatches)
+      numthreads = numbatches;
+    if (numthreads > 1) {
+      // Batches only read the dominance frontier, so they are computed on a thread team.
+      // MULTIEQUALs are still inserted into the function by this thread, in range order.
+      vector<vector<vector<FlowBlock *> > > batchsets(numbatches);
+      std::atomic<int4> next(0);
+      vector<std::thread> threads;
+      for(int4 i=1;i<numthreads;++i)
+	threads.emplace_back(&Heritage::multiequalWorker,this,std::cref(writeblocks),std::ref(batchsets),std::ref(next));
+      multiequalWorker(writeblocks,batchsets,next);	// The calling thread acts as worker 0
+      for(int4 i=0;i<threads.size();++i)
+	threads[i].join();
+      for(int4 b=0;b<numbatches;++b) {
+	const vector<vector<FlowBlock *> > &mergesets( batchsets[b] );
+	for(int4 r=0;r<mergesets.size();++r)
+	  insertMultiequals(rangeaddr[b*64+r],rangesize[b*64+r],mergesets[r]);
+      }
+    }
+    else {
+      vector<vector<FlowBlock *> > mergesets;
+      for(int4 first=0;first<rangeaddr.size();first+=64) {
+	int4 count = rangeaddr.size() - first;
+	if (count > 64)
+	  count = 64;
+	calcMultiequalsBatch(writeblocks,first,count,mergesets);
+	for(int4 r=0;r<count;++r)
+	  insertMultiequals(rangeaddr[first+r],rangesize[first+r],mergesets[r]);
       }
-      fd->opInsertBegin(multiop,bl);	// Insert at beginning of block
     }
   }
   merge.clear();
 }
 
+/// Batches of 64 ranges are claimed from a shared counter until none are left, and the
+/// blocks needing a MULTIEQUAL are computed for each one.  Nothing in the function is changed.
+/// \param writeblocks holds, for each range, the indices of blocks containing a write
+/// \param batchsets will hold, for each batch, the blocks needing a MULTIEQUAL for each of its ranges
+/// \param next is the index of the next batch to claim
+void Heritage::multiequalWorker(const vector<vector<int4> > &writeblocks,
+				vector<vector<vector<FlowBlock *> > > &batchsets,std::atomic<int4> &next) const
+
+{
+  for(;;) {
+    int4 b = next.fetch_add(1);
+    if (b >= batchsets.size()) break;
+    int4 first = b * 64;
+    int4 count = writeblocks.size() - first;
+    if (count > 64)
+      count = 64;
+    calcMultiequalsBatch(writeblocks,first,count,batchsets[b]);
+  }
+}
+
 /// This is called once to initialize \b this class in preparation for doing the
 /// heritage passes.  An information structure is allocated and mapped to each
 /// address space.
@@ -1661,6 +1961,8 @@ void Heritage::heritage(void)
   Varnode *warnvn = (Varnode *)0;
   const AddrSpaceManager *manage = fd->getArch();
   PreferSplitManager splitmanage;
+  static const int4 traceid = TraceLog::registerKind("heritage","heritage");
+  TraceSpan span(traceid);
 
   if (maxdepth == -1)		// Has a restructure been forced
     buildADT();
@@ -1823,6 +2125,25 @@ bool Heritage::deadRemovalAllowedSeen(AddrSpace *spc)
   return res;
 }
 
+/// The estimate counts the maps of heritaged ranges and the per-block arrays used for
+/// dominator and phi-node calculations.
+/// \return the estimated number of bytes
+uint8 Heritage::memoryEstimate(void) const
+
+{
+  uint8 res = (disjoint.size() + globaldisjoint.size()) * (4 * sizeof(void *) + sizeof(Address) + sizeof(SizePass));
+  for(int4 i=0;i<domchild.size();++i)
+    res += sizeof(vector<FlowBlock *>) + domchild[i].capacity() * sizeof(FlowBlock *);
+  for(int4 i=0;i<augment.size();++i)
+    res += sizeof(vector<FlowBlock *>) + augment[i].capacity() * sizeof(FlowBlock *);
+  for(int4 i=0;i<frontier.size();++i)
+    res += sizeof(vector<int4>) + frontier[i].capacity() * sizeof(int4);
+  res += (flags.capacity() + markstamp.capacity() + mergestamp.capacity()) * sizeof(uint4);
+  res += depth.capacity() * sizeof(int4) + merge.capacity() * sizeof(FlowBlock *);
+  res += infolist.capacity() * sizeof(HeritageInfo);
+  return res;
+}
+
 /// Reset all analysis as if no heritage passes have yet taken place for the function.
 /// This does not directly affect Varnodes and PcodeOps in the underlying Funcdata.
 void Heritage::clear(void)
@@ -1833,10 +2154,29 @@ void Heritage::clear(void)
   domchild.clear();
   augment.clear();
   flags.clear();
+  markstamp.clear();
+  mergestamp.clear();
   depth.clear();
   merge.clear();
   clearInfoList();
   maxdepth = -1;
   pass = 0;
 }
+
+/// The arrays indexed by block are emptied without keeping their capacity, which clear()
+/// holds on to for the next pass over a function of similar size.
+void Heritage::releaseStorage(void)
+
+{
+  clear();
+  vector<vector<FlowBlock *> >().swap(domchild);
+  vector<vector<FlowBlock *> >().swap(augment);
+  vector<vector<int4> >().swap(frontier);
+  vector<uint4>().swap(flags);
+  vector<uint4>().swap(markstamp);
+  vector<uint4>().swap(mergestamp);
+  vector<int4>().swap(depth);
+  vector<FlowBlock *>().swap(merge);
+  pq.release();
+}
 }
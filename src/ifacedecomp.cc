@@ -17,8 +17,14 @@
 extern "C" {
 #include <time.h>
 }
+#include <thread>
+#include <chrono>
 #include "pcodeparse.hh"
 #include "blockaction.hh"
+#include "resultcache.hh"
+#include "insnindex.hh"
+#include "funcsummary.hh"
+#include "flowsummary.hh"
 
 namespace GhidraDec {
 // Constructing this registers the capability
@@ -60,6 +66,7 @@ void IfaceDecompCapability::registerCommands(IfaceStatus *status)
   status->registerCom(new IfcMaplabel(),"std::map","label");
   status->registerCom(new IfcPrintdisasm(),"disassemble");
   status->registerCom(new IfcDecompile(),"decompile");
+  status->registerCom(new IfcDecompileBatch(),"decompile","batch");
   status->registerCom(new IfcDump(),"dump");
   status->registerCom(new IfcDumpbinary(),"binary");
   status->registerCom(new IfcForcegoto(),"force","goto");
@@ -79,6 +86,8 @@ void IfaceDecompCapability::registerCommands(IfaceStatus *status)
   status->registerCom(new IfcPrintLanguage(),"print","language");
   status->registerCom(new IfcPrintCStruct(),"print","C");
   status->registerCom(new IfcPrintCFlat(),"print","C","flat");
+  status->registerCom(new IfcPrintSummary(),"print","summary");
+  status->registerCom(new IfcRecordSummary(),"record","summary");
   status->registerCom(new IfcPrintCGlobals(),"print","C","globals");
   status->registerCom(new IfcPrintCTypes(),"print","C","types");
   status->registerCom(new IfcPrintCXml(),"print","C","xml");
@@ -94,9 +103,11 @@ void IfaceDecompCapability::registerCommands(IfaceStatus *status)
   status->registerCom(new IfcListprototypes(),"list","prototypes");
   status->registerCom(new IfcSetcontextrange(),"set","context");
   status->registerCom(new IfcSettrackedrange(),"set","track");
+  status->registerCom(new IfcSetbatch(),"set","batch");
   status->registerCom(new IfcBreakstart(),"break","start");
   status->registerCom(new IfcBreakaction(),"break","action");
   status->registerCom(new IfcPrintSpaces(),"print","spaces");
+  status->registerCom(new IfcPrintInstructionCache(),"print","instructioncache");
   status->registerCom(new IfcPrintHigh(),"print","high");
   status->registerCom(new IfcParamIDAnalysis(),"paramid","analysis");
   status->registerCom(new IfcPrintTree(),"print","tree","varnode");
@@ -104,11 +115,14 @@ void IfaceDecompCapability::registerCommands(IfaceStatus *status)
   status->registerCom(new IfcPrintLocalrange(),"print","localrange");
   status->registerCom(new IfcPrintMap(),"print","std::map");
   status->registerCom(new IfcPrintVarnode(),"print","varnode");
+  status->registerCom(new IfcPrintRange(),"print","range");
   status->registerCom(new IfcPrintCover(),"print","cover","high");
   status->registerCom(new IfcVarnodeCover(),"print","cover","varnode");
   status->registerCom(new IfcVarnodehighCover(),"print","cover","varnodehigh");
   status->registerCom(new IfcPrintExtrapop(),"print","extrapop");
   status->registerCom(new IfcPrintActionstats(),"print","actionstats");
+  status->registerCom(new IfcPrintMemory(),"print","memory");
+  status->registerCom(new IfcPrintMetrics(),"print","metrics");
   status->registerCom(new IfcResetActionstats(),"reset","actionstats");
   status->registerCom(new IfcCountPcode(),"count","pcode");
   status->registerCom(new IfcTypeVarnode(),"type","varnode");
@@ -118,18 +132,24 @@ void IfaceDecompCapability::registerCommands(IfaceStatus *status)
   status->registerCom(new IfcRemove(),"remove");
   status->registerCom(new IfcLockPrototype(),"prototype","lock");
   status->registerCom(new IfcUnlockPrototype(),"prototype","unlock");
+  status->registerCom(new IfcPropagatePrototypes(),"prototype","propagate");
+  status->registerCom(new IfcSavePrototypes(),"prototype","save");
+  status->registerCom(new IfcLoadPrototypes(),"prototype","load");
   status->registerCom(new IfcCommentInstr(),"comment","instruction");
   status->registerCom(new IfcDuplicateHash(),"duplicate","hash");
   status->registerCom(new IfcCallGraphBuild(),"callgraph","build");
   status->registerCom(new IfcCallGraphBuildQuick(),"callgraph","build","quick");
+  status->registerCom(new IfcCallGraphBuildIndex(),"callgraph","build","index");
   status->registerCom(new IfcCallGraphDump(),"callgraph","dump");
   status->registerCom(new IfcCallGraphLoad(),"callgraph","load");
+  status->registerCom(new IfcCallGraphPartition(),"callgraph","partition");
   status->registerCom(new IfcCallGraphList(),"callgraph","list");
   status->registerCom(new IfcCallFixup(),"fixup","call");
   status->registerCom(new IfcCallOtherFixup(),"fixup","callother");
   status->registerCom(new IfcVolatile(),"volatile");
   status->registerCom(new IfcPreferSplit(),"prefersplit");
   status->registerCom(new IfcStructureBlocks(),"structure","blocks");
+  status->registerCom(new IfcStructureDominators(),"structure","dominators");
 #ifdef CPUI_RULECOMPILE
   status->registerCom(new IfcParseRule(),"parse","rule");
   status->registerCom(new IfcExperimentalRules(),"experimental","rules");
@@ -209,6 +229,7 @@ IfaceDecompData::IfaceDecompData(void)
   conf = (Architecture *)0;
   fd = (Funcdata *)0;
   cgraph = (CallGraph *)0;
+  batchpin = false;
 #ifdef OPACTION_DEBUG
   jumptabledebug = false;
 #endif
@@ -556,7 +577,7 @@ void IfcPrintdisasm::execute(istream &s)
   IfaceAssemblyEmit assem(status->fileoptr,10);
   while(size > 0) {
     int4 sz;
-    sz = glb->translate->printAssembly(assem,addr);
+    sz = glb->translate->printAssemblyRun(assem,addr,size);
     addr = addr + sz;
     size -= sz;
   }
@@ -614,9 +635,40 @@ void IfcDecompile::execute(istream &s)
     dcp->conf->clearAnalysis(dcp->fd);
   }
     
-  *status->optr << "Decompiling " << dcp->fd->getName() << endl;
-  dcp->conf->allacts.getCurrent()->reset(*dcp->fd);
-  res = dcp->conf->allacts.getCurrent()->perform( *dcp->fd );
+  ResultCache *cache = dcp->conf->resultcache;
+  string output;
+  if (cache != (ResultCache *)0) {	// With a result cache, the C code is printed immediately
+    uint8 key = cache->hashInputs(dcp->fd,"console");
+    if (cache->lookup(key,output)) {
+      *status->optr << "Decompilation of " << dcp->fd->getName() << " restored from cache" << endl;
+      *status->optr << output;
+      return;
+    }
+    *status->optr << "Decompiling " << dcp->fd->getName() << endl;
+    LoadImageRecorder recorder(dcp->conf);
+    dcp->conf->allacts.getCurrent()->reset(*dcp->fd);
+    res = dcp->conf->allacts.getCurrent()->perform( *dcp->fd );
+    if (res >= 0 && dcp->fd->isProcComplete()) {
+      ostringstream s;
+      ostream *oldstream = dcp->conf->print->getOutputStream();
+      dcp->conf->print->setOutputStream(&s);
+      try {
+	dcp->conf->print->docFunction(dcp->fd);
+      }
+      catch(LowlevelError &err) {
+	dcp->conf->print->setOutputStream(oldstream);
+	throw;
+      }
+      dcp->conf->print->setOutputStream(oldstream);
+      output = s.str();
+      cache->store(key,dcp->fd,recorder.getReads(),output);
+    }
+  }
+  else {
+    *status->optr << "Decompiling " << dcp->fd->getName() << endl;
+    dcp->conf->allacts.getCurrent()->reset(*dcp->fd);
+    res = dcp->conf->allacts.getCurrent()->perform( *dcp->fd );
+  }
   if (res<0) {
     *status->optr << "Break at ";
     dcp->conf->allacts.getCurrent()->printState(*status->optr);
@@ -627,6 +679,96 @@ void IfcDecompile::execute(istream &s)
       *status->optr << " (no change)";
   }
   *status->optr << endl;
+  *status->optr << output;
+}
+
+/// \brief Batch decompiler that prints C for each function as it completes
+class BatchPrintC : public BatchDecompiler {
+protected:
+  virtual void finishFunction(Funcdata *fd,BatchWorker &worker) {
+    fd->getArch()->print->docFunction(fd);
+  }
+public:
+  BatchPrintC(Architecture *g,CallGraph *cg,int4 num) : BatchDecompiler(g,cg,num) {}
+};
+
+void IfcDecompileBatch::execute(istream &s)
+
+{				// Decompile every function in the callgraph, leaves first, on multiple threads
+  int4 numthreads = 0;
+  string name;
+
+  if (dcp->conf == (Architecture *)0)
+    throw IfaceExecutionError("No load image");
+  if (dcp->cgraph == (CallGraph *)0)
+    throw IfaceExecutionError("Callgraph has not been built");
+  s >> ws;
+  if (!s.eof()) {
+    s >> dec >> numthreads;
+    if (numthreads <= 0)
+      throw IfaceParseError("Bad number of threads");
+    s >> ws >> name;
+  }
+  if (numthreads == 0) {
+    numthreads = std::thread::hardware_concurrency();
+    if (numthreads <= 0)
+      numthreads = 1;
+  }
+
+  ofstream os;
+  BatchDecompiler *batch;
+  if (name.size() != 0) {
+    os.open(name.c_str());
+    if (!os)
+      throw IfaceExecutionError("Unable to open file: "+name);
+    dcp->conf->print->setOutputStream(&os);
+    batch = new BatchPrintC(dcp->conf,dcp->cgraph,numthreads);
+  }
+  else
+    batch = new BatchDecompiler(dcp->conf,dcp->cgraph,numthreads);
+  dcp->fd = (Funcdata *)0;	// Analysis of the current function will be cleared
+  batch->setLogStream(status->optr);
+  batch->setPinWorkers(dcp->batchpin);
+  try {
+    batch->run();
+  }
+  catch(LowlevelError &err) {
+    delete batch;
+    throw;
+  }
+  *status->optr << "Batch decompiled " << dec << batch->numFunctions() << " functions using ";
+  *status->optr << numthreads << " threads" << endl;
+  batch->printStatistics(*status->optr);
+  batch->mergeStatistics(dcp->conf->allacts.getCurrent());	// So that "print actionstats" covers every worker
+  delete batch;
+  if (name.size() != 0) {
+    dcp->conf->print->setOutputStream(status->fileoptr);
+    os.close();
+  }
+}
+
+void IfcSetbatch::execute(istream &s)
+
+{				// Set how the worker threads of the batch commands use memory
+  string word;
+  s >> ws;
+  if (s.eof()) {
+    *status->optr << "slabs=" << SlabArena::getBackingName(SlabArena::getBacking());
+    *status->optr << (dcp->batchpin ? " pin" : " nopin") << endl;
+    return;
+  }
+  while(!s.eof()) {
+    s >> word >> ws;
+    SlabArena::backing backing;
+    if (word == "pin")
+      dcp->batchpin = true;
+    else if (word == "nopin")
+      dcp->batchpin = false;
+    else if (SlabArena::parseBacking(word.c_str(),backing))
+      SlabArena::setBacking(backing);
+    else
+      throw IfaceParseError("Expecting pin, nopin, heap, region, transparent, or hugetlb");
+  }
 }
 
 void IfcPrintCFlat::execute(istream &s)
@@ -642,6 +784,31 @@ void IfcPrintCFlat::execute(istream &s)
   dcp->conf->print->setFlat(false);
 }
 
+void IfcPrintSummary::execute(istream &s)
+
+{				// Print recovered facts about the function as JSON
+				// The printer is not involved
+  if (dcp->fd == (Funcdata *)0)
+    throw IfaceExecutionError("No function selected");
+
+  FunctionSummary summary(*status->fileoptr);
+  summary.save(*dcp->fd);
+}
+
+void IfcRecordSummary::execute(istream &s)
+
+{				// Add the current function to the flow summary database
+  if (dcp->fd == (Funcdata *)0)
+    throw IfaceExecutionError("No function selected");
+  if (dcp->conf->flowsummary == (FlowSummaryDb *)0)
+    throw IfaceExecutionError("No flow summary database in use");
+
+  if (dcp->conf->flowsummary->record(dcp->fd))
+    *status->optr << "Recorded summary of " << dcp->fd->getName() << endl;
+  else
+    *status->optr << "Prototype of " << dcp->fd->getName() << " is not locked, no summary recorded" << endl;
+}
+
 void IfcPrintCGlobals::execute(istream &s)
 
 {				// Print all global variable declarations we know
@@ -683,8 +850,11 @@ void IfcPrintCStruct::execute(istream &s)
   if (dcp->fd == (Funcdata *)0)
     throw IfaceExecutionError("No function selected");
 
-  dcp->conf->print->setOutputStream(status->fileoptr);
-  dcp->conf->print->docFunction(dcp->fd);
+  PrintLanguage *print = dcp->conf->print;
+  print->setOutputStream(status->fileoptr);
+  print->setRetainTokens(true);	// Renames can be redisplayed without printing again
+  if (!print->redisplayFunction(dcp->fd))
+    print->docFunction(dcp->fd);
 }
 
 void IfcPrintLanguage::execute(istream &s)
@@ -885,6 +1055,23 @@ void IfcPrintBlocktree::execute(istream &s)
   dcp->fd->printBlockTree(*status->fileoptr);
 }
 
+void IfcPrintInstructionCache::execute(istream &s)
+
+{
+  if (dcp->conf == (Architecture *)0)
+    throw IfaceExecutionError("No load image present");
+
+  uintb hits,misses;
+  if (!dcp->conf->translate->getInstructionCacheStats(hits,misses)) {
+    *status->optr << "Translator does not support an instruction cache" << endl;
+    return;
+  }
+  *status->fileoptr << "Instruction cache hits=" << dec << hits << " misses=" << misses;
+  if (hits + misses != 0)
+    *status->fileoptr << " hitrate=" << fixed << setprecision(1) << (100.0 * hits) / (hits + misses) << '%';
+  *status->fileoptr << endl;
+}
+
 void IfcPrintSpaces::execute(istream &s)
 
 {
@@ -1103,6 +1290,19 @@ void IfcPrintVarnode::execute(istream &s)
     vn->getHigh()->printInfo(*status->optr);
 }
   
+void IfcPrintRange::execute(istream &s)
+
+{				// Print the range of values a varnode can hold
+  Varnode *vn;
+
+  vn = iface_read_varnode(dcp,s);
+  CircleRange range = dcp->fd->getValueRange(vn);
+  vn->printRaw(*status->optr);
+  *status->optr << " : ";
+  range.printRaw(*status->optr);
+  *status->optr << endl;
+}
+
 void IfcPrintCover::execute(istream &s)
 
 {				// Print4 coverage information about a high
@@ -1168,6 +1368,9 @@ void IfcPrintExtrapop::execute(istream &s)
 	*status->optr << "unknown" << endl;
       else
 	*status->optr << dec << expop << endl;
+      const ExtraPopMemo &memo(dcp->conf->extrapopmemo);
+      *status->optr << "Recovered extra pop for " << dec << memo.size() << " functions, reused at ";
+      *status->optr << memo.getNumReused() << " call sites" << endl;
     }
   }
   else {
@@ -1317,6 +1520,7 @@ void IfcForceHex::execute(istream &s)
   Symbol *sym = vn->getHigh()->getSymbol();
   if (sym == (Symbol *)0)
     throw IfaceExecutionError("Unable to create symbol");
+  dcp->conf->print->dropRetainedTokens();	// The constant must be printed again
   sym->getScope()->setDisplayFormat(sym,Symbol::force_hex);
   sym->getScope()->setAttribute(sym,Varnode::typelock);
   *status->optr << "Successfully forced hex display" << endl;
@@ -1338,6 +1542,7 @@ void IfcForceDec::execute(istream &s)
   Symbol *sym = vn->getHigh()->getSymbol();
   if (sym == (Symbol *)0)
     throw IfaceExecutionError("Unable to create symbol");
+  dcp->conf->print->dropRetainedTokens();
   sym->getScope()->setDisplayFormat(sym,Symbol::force_dec);
   sym->getScope()->setAttribute(sym,Varnode::typelock);
   *status->optr << "Successfully forced dec display" << endl;
@@ -1744,6 +1949,100 @@ void IfcUnlockPrototype::execute(istream &s)
   dcp->fd->getFuncProto().setOutputLock(false);
 }
 
+void IfcPropagatePrototypes::execute(istream &s)
+
+{				// Recover and lock prototypes over the callgraph, callees first, on multiple threads
+  int4 numthreads = 0;
+  string rootname;
+
+  if (dcp->conf == (Architecture *)0)
+    throw IfaceExecutionError("No load image");
+  if (dcp->cgraph == (CallGraph *)0)
+    throw IfaceExecutionError("Callgraph has not been built");
+  s >> ws;
+  if (!s.eof()) {
+    s >> dec >> numthreads;
+    if (numthreads <= 0)
+      throw IfaceParseError("Bad number of threads");
+    s >> ws >> rootname;
+  }
+  if (numthreads == 0) {
+    numthreads = std::thread::hardware_concurrency();
+    if (numthreads <= 0)
+      numthreads = 1;
+  }
+
+  BatchPrototypes batch(dcp->conf,dcp->cgraph,numthreads);
+  batch.setPinWorkers(dcp->batchpin);
+  if (rootname.size() != 0) {
+    dcp->conf->allacts.getGroup(rootname);	// Throws if there is no such root Action
+    batch.setRootName(rootname);
+  }
+  dcp->fd = (Funcdata *)0;	// Analysis of the current function will be cleared
+  batch.setLogStream(status->optr);
+  batch.run();
+  *status->optr << "Locked " << dec << batch.numLocked() << " prototypes, ";
+  *status->optr << batch.numSkipped() << " already locked, using " << numthreads << " threads" << endl;
+  int4 numanalyzed = batch.numFunctions() - batch.numSkipped();
+  if (numanalyzed > 0) {
+    double permillis = batch.totalSeconds() * 1000.0 / numanalyzed;
+    *status->optr << "Average time " << fixed << setprecision(3) << permillis << " ms per function" << endl;
+  }
+  batch.printStatistics(*status->optr);
+}
+
+void IfcSavePrototypes::execute(istream &s)
+
+{				// Save the locked prototypes of the functions in the callgraph
+  if (dcp->conf == (Architecture *)0)
+    throw IfaceExecutionError("No load image");
+  if (dcp->cgraph == (CallGraph *)0)
+    throw IfaceExecutionError("Callgraph has not been built");
+
+  string name;
+  s >> ws >> name;
+  if (name.size() == 0)
+    throw IfaceParseError("Need file name to write prototypes to");
+
+  ofstream os;
+  os.open(name.c_str());
+  if (!os)
+    throw IfaceExecutionError("Unable to open file "+name);
+
+  PrototypeExchange exchange(dcp->conf);
+  int4 count = exchange.collect(dcp->cgraph);
+  exchange.saveXml(os);
+  os.close();
+  *status->optr << "Saved " << dec << count << " prototypes to " << name << endl;
+}
+
+void IfcLoadPrototypes::execute(istream &s)
+
+{				// Lock the prototypes saved in one or more files, earlier files taking precedence
+  if (dcp->conf == (Architecture *)0)
+    throw IfaceExecutionError("No load image");
+
+  PrototypeExchange exchange(dcp->conf);
+  int4 numfiles = 0;
+  s >> ws;
+  while(!s.eof()) {
+    string name;
+    s >> name >> ws;
+    ifstream is(name.c_str());
+    if (!is)
+      throw IfaceExecutionError("Unable to open prototype file "+name);
+    DocumentStorage store;
+    Document *doc = store.parseDocument(is);
+    exchange.restoreXml(doc->getRoot());
+    numfiles += 1;
+  }
+  if (numfiles == 0)
+    throw IfaceParseError("Need name of file to read prototypes from");
+  dcp->fd = (Funcdata *)0;	// Analysis of the current function may depend on the old prototypes
+  int4 count = exchange.apply();
+  *status->optr << "Locked " << dec << count << " of " << exchange.size() << " prototypes" << endl;
+}
+
 void IfcPrintLocalrange::execute(istream &s)
 
 {
@@ -1784,19 +2083,77 @@ void IfcPrintMap::execute(istream &s)
 void IfcProduceC::execute(istream &s)
 
 {				// Produce C output of every known function
+  // A name ending in '/' is a directory, which gets a separate file for each function
   string name;
+  int4 numthreads = 0;
   
   s >> ws >> name;
   if (name.size()==0)
     throw IfaceParseError("Need file name to write to");
+  s >> ws;
+  if (!s.eof()) {
+    s >> dec >> numthreads;
+    if (numthreads <= 0)
+      throw IfaceParseError("Bad number of threads");
+  }
+  if (dcp->conf == (Architecture *)0)
+    throw IfaceExecutionError("No architecture loaded");
   
-  ofstream os;
-  os.open(name.c_str());
-  dcp->conf->print->setOutputStream(&os);
+  OutputWriter out(64);
+  try {
+    out.open(name,name[name.size()-1] == '/');
+  } catch(LowlevelError &err) {
+    throw IfaceExecutionError(err.explain);
+  }
+  writer = &out;
+  bool buffered = !dcp->conf->print->emitsXml();
+  if (buffered)
+    dcp->conf->print->setBuffered(true);	// Only the text is needed, collect it in a buffer
 
-  iterateFunctionsAddrOrder();
+  try {
+    if (numthreads == 0)
+      iterateFunctionsAddrOrder();
+    else
+      produceParallel(numthreads);
+  } catch(...) {
+    writer = (OutputWriter *)0;
+    if (buffered)
+      dcp->conf->print->setBuffered(false);
+    throw;
+  }
 
-  os.close();
+  writer = (OutputWriter *)0;
+  if (buffered)
+    dcp->conf->print->setBuffered(false);
+  try {
+    out.close();
+  } catch(LowlevelError &err) {
+    throw IfaceExecutionError(err.explain);
+  }
+}
+
+/// Every function is decompiled and printed by a BatchPrinter, on a pool of worker threads.
+/// Printed functions are handed to the writer in address order once they are all done, or,
+/// with a file per function, as soon as each is printed.
+/// The functions are scheduled over a call graph with no edges, so, as with the serial
+/// form of the command, no function waits for its callees.
+/// \param numthreads is the number of worker threads to use
+void IfcProduceC::produceParallel(int4 numthreads)
+
+{
+  CallGraph graph(dcp->conf);
+  graph.buildAllNodes();
+  dcp->fd = (Funcdata *)0;	// Analysis of the current function will be cleared
+  BatchPrinter batch(dcp->conf,&graph,numthreads);
+  batch.setLogStream(status->optr);
+  batch.setPinWorkers(dcp->batchpin);
+  if (writer->isSplit())
+    batch.setWriter(writer);
+  batch.run();
+  batch.write(*writer);
+  batch.mergeStatistics(dcp->conf->allacts.getCurrent());
+  *status->optr << "Printed " << dec << batch.numPrinted() << " functions using ";
+  *status->optr << numthreads << " threads" << endl;
 }
 
 void IfcProduceC::iterationCallback(Funcdata *fd)
@@ -1809,6 +2166,8 @@ void IfcProduceC::iterationCallback(Funcdata *fd)
     *status->optr << "No code for " << fd->getName() << endl;
     return;
   }
+  PrintLanguage *print = dcp->conf->print;
+  ostream *saveout = print->getOutputStream();
   try {
     dcp->conf->clearAnalysis(fd); // Clear any old analysis
     dcp->conf->allacts.getCurrent()->reset(*fd);
@@ -1821,9 +2180,15 @@ void IfcProduceC::iterationCallback(Funcdata *fd)
     duration = ((float)(end_time-start_time))/CLOCKS_PER_SEC;
     duration *= 1000.0;
     *status->optr << " time=" << fixed << setprecision(0) << duration << " ms" << endl;
-    dcp->conf->print->docFunction(fd);
+    ostringstream text;
+    print->setOutputStream(&text);	// Print to a private buffer the writer thread takes over
+    print->docFunction(fd);
+    print->setOutputStream(saveout);
+    string res = text.str();
+    writer->push(OutputWriter::fileName(fd),res);
   }
   catch(LowlevelError &err) {
+    print->setOutputStream(saveout);
     *status->optr << "Skipping " << fd->getName() << ": " << err.explain << endl;
   }
   dcp->conf->clearAnalysis(fd);
@@ -2154,6 +2519,37 @@ void IfcCallGraphBuildQuick::execute(istream &s)
   *status->optr << "Successfully built callgraph" << endl;
 }
 
+void IfcCallGraphBuildIndex::execute(istream &s)
+
+{ // Build call graph from existing function starts, tracing flow on multiple threads
+  int4 numthreads = 0;
+
+  if (dcp->conf == (Architecture *)0)
+    throw IfaceExecutionError("No load image");
+  s >> ws;
+  if (!s.eof()) {
+    s >> dec >> numthreads;
+    if (numthreads <= 0)
+      throw IfaceParseError("Bad number of threads");
+  }
+  if (numthreads == 0) {
+    numthreads = std::thread::hardware_concurrency();
+    if (numthreads <= 0)
+      numthreads = 1;
+  }
+  if (dcp->cgraph != (CallGraph *)0)
+    delete dcp->cgraph;
+
+  dcp->cgraph = new CallGraph(dcp->conf);
+
+  dcp->cgraph->buildAllNodes();	// Build a node in the graph for existing symbols
+  dcp->cgraph->buildEdgesIndexed(numthreads);
+  InstructionIndex *index = dcp->conf->insnindex;
+  *status->optr << "Instructions decoded: " << dec << index->getNumDecoded();
+  *status->optr << " reused: " << index->getNumReused() << endl;
+  *status->optr << "Successfully built callgraph" << endl;
+}
+
 void IfcCallGraphDump::execute(istream &s)
 
 {
@@ -2217,6 +2613,37 @@ void IfcCallGraphLoad::execute(istream &s)
   *status->optr << "Successfully associated functions with callgraph nodes" << endl;
 }
 
+void IfcCallGraphPartition::execute(istream &s)
+
+{				// Split the callgraph into rounds of partitions, each saved to its own file
+  if (dcp->cgraph == (CallGraph *)0)
+    throw IfaceExecutionError("No callgraph has been built");
+
+  int4 numrounds = -1;
+  int4 numparts = -1;
+  string prefix;
+  s >> ws >> dec >> numrounds >> ws >> numparts >> ws >> prefix;
+  if (numrounds <= 0 || numparts <= 0)
+    throw IfaceParseError("Need number of rounds and partitions per round");
+  if (prefix.size() == 0)
+    throw IfaceParseError("Need prefix of the files to write partitions to");
+
+  vector<CallGraphPartition> parts;
+  dcp->cgraph->partition(numrounds,numparts,parts);
+  for(int4 i=0;i<parts.size();++i) {
+    ostringstream name;
+    name << prefix << '.' << dec << i << ".xml";
+    ofstream os;
+    os.open(name.str().c_str());
+    if (!os)
+      throw IfaceExecutionError("Unable to open file "+name.str());
+    dcp->cgraph->saveXml(os,parts[i].nodes);
+    os.close();
+    *status->optr << name.str() << ": round " << parts[i].round << ", " << parts[i].nodes.size() << " functions" << endl;
+  }
+  *status->optr << "Saved " << dec << parts.size() << " partitions" << endl;
+}
+
 void IfcCallGraphList::execute(istream &s)
 
 { // List all functions in leaf-first order
@@ -2326,6 +2753,7 @@ void IfcPreferSplit::execute(istream &s)
   rec.storage.offset = addr.getOffset();
   rec.storage.size = size;
   rec.splitoffset = split;
+  PreferSplitManager::initialize(dcp->conf->splitrecords); // Keep records sorted for findRecord
 
   *status->optr << "Successfully added split record" << endl;
 }
@@ -2380,6 +2808,69 @@ void IfcStructureBlocks::execute(istream &s)
   }
 }
 
+void IfcStructureDominators::execute(istream &s)
+
+{ // Time each dominator algorithm on a synthesized control-flow graph
+  int4 numblocks = 10000;
+  uint4 seed = 1;
+  s >> ws;
+  if (!s.eof())
+    s >> dec >> numblocks;
+  s >> ws;
+  if (!s.eof())
+    s >> dec >> seed;
+  if (numblocks < 2)
+    throw IfaceParseError("Need at least 2 blocks");
+
+  BlockGraph graph;
+  vector<FlowBlock *> blocks;
+  for(int4 i=0;i<numblocks;++i)
+    blocks.push_back(graph.newBlock());
+  int4 numedges = 0;
+  for(int4 i=0;i<numblocks-1;++i) {	// A chain through every block, plus random branches
+    graph.addEdge(blocks[i],blocks[i+1]);
+    numedges += 1;
+    seed = seed * 1103515245 + 12345;
+    uint4 r = (seed >> 16) & 0x7fff;
+    if ((r & 3) == 0) continue;
+    int4 target;
+    if ((r & 3) == 1 && i > 0)		// Back edge, making a loop
+      target = i - 1 - (r >> 2) % (i < 64 ? i : 64);
+    else				// Forward branch
+      target = i + 2 + (r >> 2) % 64;
+    if (target >= numblocks || target == i+1) continue;
+    graph.addEdge(blocks[i],blocks[target]);
+    numedges += 1;
+  }
+  vector<FlowBlock *> rootlist;
+  graph.structureLoops(rootlist);
+
+  BlockGraph::dominator_algorithm saved = BlockGraph::getDominatorAlgorithm();
+  vector<FlowBlock *> iterdom;
+  double times[2];
+  for(int4 alg=0;alg<2;++alg) {
+    BlockGraph::setDominatorAlgorithm(alg == 0 ? BlockGraph::dom_iterative : BlockGraph::dom_semi_nca);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    graph.calcForwardDominator(rootlist);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    times[alg] = elapsed.count();
+    if (alg == 0) {
+      for(int4 i=0;i<graph.getSize();++i)
+	iterdom.push_back(graph.getBlock(i)->getImmedDom());
+    }
+  }
+  BlockGraph::setDominatorAlgorithm(saved);
+  int4 mismatch = 0;
+  for(int4 i=0;i<graph.getSize();++i)
+    if (graph.getBlock(i)->getImmedDom() != iterdom[i])
+      mismatch += 1;
+  *status->optr << dec << numblocks << " blocks, " << numedges << " edges" << endl;
+  *status->optr << "iterative: " << fixed << setprecision(3) << times[0] * 1000.0 << " ms" << endl;
+  *status->optr << "seminca: " << fixed << setprecision(3) << times[1] * 1000.0 << " ms" << endl;
+  if (mismatch != 0)
+    *status->optr << "Dominators differ on " << dec << mismatch << " blocks" << endl;
+}
+
 #ifdef CPUI_RULECOMPILE
 void IfcParseRule::execute(istream &s)
 
@@ -2441,7 +2932,53 @@ void IfcPrintActionstats::execute(istream &s)
   if (dcp->conf->allacts.getCurrent() == (Action *)0)
     throw IfaceExecutionError("No action set");
 
-  dcp->conf->allacts.getCurrent()->printStatistics(*status->fileoptr);
+  string format;
+  s >> ws >> format;
+  if (format == "csv") {
+    Action::printCsvHeader(*status->fileoptr);
+    dcp->conf->allacts.getCurrent()->printStatisticsCsv(*status->fileoptr,"");
+    if (AnalysisMetrics::isEnabled())
+      AnalysisMetrics::printTotalsCsv(*status->fileoptr);
+  }
+  else if (format.empty())
+    dcp->conf->allacts.getCurrent()->printStatistics(*status->fileoptr);
+  else
+    throw IfaceParseError("Unknown statistics format: " + format);
+}
+
+/// Print the estimated memory currently held by the analysis of the current function, broken
+/// down by owner.  If memory tracking is enabled (the \b memorystats option), the peak usage of the
+/// last decompilation and the Action after which it was measured are printed as well.  With the
+/// \b xml argument, the usage is printed as \<memoryusage> tags instead.
+void IfcPrintMemory::execute(istream &s)
+
+{
+  if (dcp->fd == (Funcdata *)0)
+    throw IfaceExecutionError("No function selected");
+
+  string format;
+  s >> ws >> format;
+  if (!format.empty() && format != "xml")
+    throw IfaceParseError("Unknown memory format: " + format);
+  MemoryUsage cur;
+  dcp->fd->measureMemory(cur);
+  const MemoryUsage &peak( dcp->fd->getMemoryPeak() );
+  if (format == "xml") {
+    cur.saveXml(*status->fileoptr);
+    if (peak.total() != 0)
+      peak.saveXml(*status->fileoptr);
+    return;
+  }
+  *status->fileoptr << "Current memory for " << dcp->fd->getName() << endl;
+  cur.print(*status->fileoptr);
+  *status->fileoptr << "pcodeops alive=" << dec << dcp->fd->numOpsAlive() << " dead=" << dcp->fd->numOpsDead();
+  *status->fileoptr << " retired=" << dcp->fd->numOpsRetired() << " reclaimed=" << dcp->fd->numOpsReclaimed() << endl;
+  if (peak.total() != 0) {
+    *status->fileoptr << "Peak memory after action " << dcp->fd->getMemoryPeakAction() << endl;
+    peak.print(*status->fileoptr);
+  }
+  else if (!Action::isMemoryTracking())
+    *status->fileoptr << "Peak memory is not tracked (see option memorystats)" << endl;
 }
 
 void IfcResetActionstats::execute(istream &s)
@@ -2453,6 +2990,30 @@ void IfcResetActionstats::execute(istream &s)
     throw IfaceExecutionError("No action set");
 
   dcp->conf->allacts.getCurrent()->resetStats();
+  AnalysisMetrics::resetTotals();
+}
+
+/// Print the number of Cover intersections, merge tests, cast checks, and heritage renames
+/// made by the last decompilation of the current function.  Counting must be enabled
+/// (the \b metrics option).  With the \b xml argument, the counts are printed as a \<metrics> tag.
+void IfcPrintMetrics::execute(istream &s)
+
+{
+  if (dcp->fd == (Funcdata *)0)
+    throw IfaceExecutionError("No function selected");
+
+  string format;
+  s >> ws >> format;
+  if (!format.empty() && format != "xml")
+    throw IfaceParseError("Unknown metrics format: " + format);
+  if (!AnalysisMetrics::isEnabled())
+    *status->fileoptr << "Metrics are not counted (see option metrics)" << endl;
+  else if (format == "xml")
+    dcp->fd->getMetrics().saveXml(*status->fileoptr);
+  else {
+    *status->fileoptr << "Metrics for " << dcp->fd->getName() << endl;
+    dcp->fd->getMetrics().print(*status->fileoptr);
+  }
 }
 
 void IfcCountPcode::execute(istream &s)
@@ -2592,7 +3153,7 @@ static IfaceStatus *status_callback;
 
 static void jump_callback(Funcdata &orig,Funcdata &fd)
 
-{ // Replaces reset/perform in Funcdata::stageJumpTable
+{ // Replaces reset/perform in Funcdata::stageJumpTables
   IfaceDecompData *newdcp = dcp_callback;
   IfaceStatus *newstatus = status_callback;
   jumpstack.push_back(newdcp->fd);
@@ -48,6 +48,8 @@ void InjectContextGhidra::saveXml(ostream &s) const
 void InjectPayloadGhidra::inject(InjectContext &con,PcodeEmit &emit) const
 
 {
+  string sig = InjectPcodeCache::signature(con);
+  if (cache.replay(sig,emit)) return;		// Already received p-code for this context
   Document *doc;
   ArchitectureGhidra *ghidra = (ArchitectureGhidra *)con.glb;
   try {
@@ -65,9 +67,12 @@ void InjectPayloadGhidra::inject(InjectContext &con,PcodeEmit &emit) const
   const Element *el = doc->getRoot();
   const List &list(el->getChildren());
   List::const_iterator iter;
+  PcodeRun &run( cache.record(sig,con.baseaddr) );
   for(iter=list.begin();iter!=list.end();++iter)
-    emit.restoreXmlOp(*iter,ghidra->translate);
+    run.restoreXmlOp(*iter,ghidra->translate);
   delete doc;
+  run.endInstruction(0);
+  cache.replay(sig,emit);
 }
 
 void InjectPayloadGhidra::printTemplate(ostream &s) const
@@ -28,7 +28,7 @@ InjectContextSleigh::~InjectContextSleigh(void)
 InjectPayloadSleigh::~InjectPayloadSleigh(void)
 
 {
-  if (tpl != (ConstructTpl *)0)
+  if (tpl != (ConstructTpl *)0 && !sharedtpl)
     delete tpl;
 }
 
@@ -37,6 +37,7 @@ InjectPayloadSleigh::InjectPayloadSleigh(const string &src,const string &nm,int4
 {
   source = src;
   tpl = (ConstructTpl *)0;
+  sharedtpl = false;
   paramshift = 0;
 }
 
@@ -181,12 +182,13 @@ ExecutablePcodeSleigh::ExecutablePcodeSleigh(Architecture *g,const string &src,c
   : ExecutablePcode(g,src,nm)
 {
   tpl = (ConstructTpl *)0;
+  sharedtpl = false;
 }
 
 ExecutablePcodeSleigh::~ExecutablePcodeSleigh(void)
 
 {
-  if (tpl != (ConstructTpl *)0)
+  if (tpl != (ConstructTpl *)0 && !sharedtpl)
     delete tpl;
 }
 
@@ -279,10 +281,61 @@ void InjectPayloadDynamic::inject(InjectContext &context,PcodeEmit &emit) const
     emit.restoreXmlOp(*iter,glb->translate);
 }
 
+void SnippetCache::clear(void)
+
+{
+  map<string,pair<ConstructTpl *,uintb> >::iterator iter;
+  for(iter=snippets.begin();iter!=snippets.end();++iter)
+    delete (*iter).second.first;
+  snippets.clear();
+}
+
+/// \param key is the key built for the snippet
+/// \param uniqueend is set to the next free unique offset after the snippet, if it is found
+/// \return the compiled template, or null if the snippet has not been cached
+ConstructTpl *SnippetCache::find(const string &key,uintb &uniqueend) const
+
+{
+  map<string,pair<ConstructTpl *,uintb> >::const_iterator iter = snippets.find(key);
+  if (iter == snippets.end())
+    return (ConstructTpl *)0;
+  uniqueend = (*iter).second.second;
+  return (*iter).second.first;
+}
+
+/// The cache takes ownership of the template.
+/// \param key is the key built for the snippet
+/// \param tpl is the compiled template
+/// \param uniqueend is the next free unique offset after the snippet
+void SnippetCache::insert(const string &key,ConstructTpl *tpl,uintb uniqueend)
+
+{
+  snippets[key] = pair<ConstructTpl *,uintb>(tpl,uniqueend);
+}
+
+/// \param payload is the payload being compiled, whose operands are part of the key
+/// \param uniquebase is the first free offset in the unique space, before compiling
+/// \param text is the snippet
+/// \return the key
+string SnippetCache::buildKey(InjectPayload *payload,uintb uniquebase,const string &text)
+
+{
+  ostringstream s;
+  s << dec << payload->getType() << ':' << hex << uniquebase << dec;
+  for(int4 i=0;i<payload->sizeInput();++i)
+    s << ':' << payload->getInput(i).getName() << '=' << payload->getInput(i).getIndex();
+  s << ';';
+  for(int4 i=0;i<payload->sizeOutput();++i)
+    s << ':' << payload->getOutput(i).getName() << '=' << payload->getOutput(i).getIndex();
+  s << '\n' << text;
+  return s.str();
+}
+
 PcodeInjectLibrarySleigh::PcodeInjectLibrarySleigh(Architecture *g,uintb tmpbase)
   : PcodeInjectLibrary(g,tmpbase)
 {
   slgh = (const SleighBase *)g->translate;
+  snippetcache = (SnippetCache *)0;
   contextCache.glb = g;
 }
 
@@ -308,6 +361,28 @@ void PcodeInjectLibrarySleigh::parseInject(InjectPayload *payload)
     contextCache.pos = new ParserContext((ContextCache *)0);
     contextCache.pos->initialize(8,8,slgh->getConstantSpace());
   }
+  bool executable = (payload->getType() == InjectPayload::EXECUTABLEPCODE_TYPE);
+  string &parsestring(executable ? ((ExecutablePcodeSleigh *)payload)->parsestring : ((InjectPayloadSleigh *)payload)->parsestring);
+  uintb uniquebase = executable ? 0x2000 : tempbase;
+  string key;
+  if (snippetcache != (SnippetCache *)0) {	// Same snippet compiled for an earlier Architecture
+    key = SnippetCache::buildKey(payload,uniquebase,parsestring);
+    uintb uniqueend;
+    ConstructTpl *cached = snippetcache->find(key,uniqueend);
+    if (cached != (ConstructTpl *)0) {
+      if (executable) {
+	((ExecutablePcodeSleigh *)payload)->tpl = cached;
+	((ExecutablePcodeSleigh *)payload)->sharedtpl = true;
+      }
+      else {
+	tempbase = uniqueend;
+	((InjectPayloadSleigh *)payload)->tpl = cached;
+	((InjectPayloadSleigh *)payload)->sharedtpl = true;
+      }
+      parsestring = "";
+      return;
+    }
+  }
   PcodeSnippet compiler(slgh);
 //  compiler.clear();			// Not necessary unless we reuse
   for(int4 i=0;i<payload->sizeInput();++i) {
@@ -326,6 +401,10 @@ void PcodeInjectLibrarySleigh::parseInject(InjectPayload *payload)
       throw LowlevelError(payload->getSource() + ": Unable to compile pcode: "+compiler.getErrorMessage());
     sleighpayload->tpl = compiler.releaseResult();
     sleighpayload->parsestring = "";		// No longer need the memory
+    if (snippetcache != (SnippetCache *)0) {
+      snippetcache->insert(key,sleighpayload->tpl,0);
+      sleighpayload->sharedtpl = true;
+    }
   }
   else {
     compiler.setUniqueBase(tempbase);
@@ -336,6 +415,10 @@ void PcodeInjectLibrarySleigh::parseInject(InjectPayload *payload)
     tempbase = compiler.getUniqueBase();
     sleighpayload->tpl = compiler.releaseResult();
     sleighpayload->parsestring = "";		// No longer need the memory
+    if (snippetcache != (SnippetCache *)0) {
+      snippetcache->insert(key,sleighpayload->tpl,tempbase);
+      sleighpayload->sharedtpl = true;
+    }
   }
 }
 
@@ -0,0 +1,274 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "insnindex.hh"
+
+#include <thread>
+
+namespace GhidraDec {
+
+/// \brief A PcodeEmit that records the flow properties of the single instruction it is given
+class FlowSummaryEmit : public PcodeEmit {
+  InstructionEntry &entry;	///< Entry being filled in
+  OpCode lastop;		///< Last p-code op emitted
+  bool lastconst;		///< Set if the last op was a BRANCH to a relative (constant) destination
+public:
+  FlowSummaryEmit(InstructionEntry &e) : entry(e) { lastop = CPUI_COPY; lastconst = false; }	///< Constructor
+  virtual void dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize);
+  bool endsFlow(void) const;	///< Does the instruction end its flow (no fall-through)?
+};
+
+void FlowSummaryEmit::dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize)
+
+{
+  lastop = opc;
+  lastconst = false;
+  switch(opc) {
+  case CPUI_BRANCH:
+  case CPUI_CBRANCH:
+    if (vars[0].space->getType() == IPTR_CONSTANT) {
+      lastconst = true;		// Branch within the p-code of the instruction
+      break;
+    }
+    entry.flags |= InstructionEntry::branch;
+    entry.branches.push_back(Address(vars[0].space,vars[0].offset));
+    break;
+  case CPUI_BRANCHIND:
+    entry.flags |= InstructionEntry::branchind;
+    break;
+  case CPUI_CALL:
+    entry.flags |= InstructionEntry::call;
+    entry.calls.push_back(Address(vars[0].space,vars[0].offset));
+    break;
+  case CPUI_CALLIND:
+    entry.flags |= InstructionEntry::callind;
+    break;
+  case CPUI_RETURN:
+    entry.flags |= InstructionEntry::returns;
+    break;
+  default:
+    break;
+  }
+}
+
+/// An instruction ends its flow if its last p-code op is an unconditional branch out of the
+/// instruction, an indirect branch, or a return.
+/// \return \b true if execution cannot fall through to the next instruction
+bool FlowSummaryEmit::endsFlow(void) const
+
+{
+  if (lastop == CPUI_BRANCH) return !lastconst;
+  return (lastop == CPUI_BRANCHIND || lastop == CPUI_RETURN);
+}
+
+/// \param t is the translator that will decode instructions
+InstructionIndex::InstructionIndex(const Translate *t)
+  : numdecoded(0), numreused(0)
+{
+  trans = t;
+}
+
+/// Decoding errors are recorded in the entry rather than thrown.
+/// \param addr is the address of the instruction
+/// \param entry will hold the flow summary of the instruction
+void InstructionIndex::decode(const Address &addr,InstructionEntry &entry) const
+
+{
+  FlowSummaryEmit emit(entry);
+  try {
+    entry.length = trans->oneInstruction(emit,addr);
+    if (!emit.endsFlow())
+      entry.flags |= InstructionEntry::fallthru;
+  }
+  catch(UnimplError &err) {
+    entry.branches.clear();
+    entry.calls.clear();
+    entry.length = err.instruction_length;
+    entry.flags = InstructionEntry::unimplemented | InstructionEntry::fallthru;
+  }
+  catch(LowlevelError &err) {	// Includes BadDataError and DataUnavailError
+    entry.branches.clear();
+    entry.calls.clear();
+    entry.length = 0;
+    entry.flags = InstructionEntry::baddata;
+  }
+}
+
+/// If the instruction has not been seen before, it is decoded and added to the index.
+/// Entries are never modified once added, so the returned reference remains valid until clear().
+/// \param addr is the address of the instruction
+/// \return the flow summary of the instruction
+const InstructionEntry &InstructionIndex::obtain(const Address &addr)
+
+{
+  Shard &shard( getShard(addr) );
+  std::lock_guard<std::mutex> guard(shard.lock);
+  map<Address,InstructionEntry>::iterator iter = shard.entries.find(addr);
+  if (iter != shard.entries.end()) {
+    numreused.fetch_add(1,std::memory_order_relaxed);
+    return (*iter).second;
+  }
+  InstructionEntry &entry( shard.entries[addr] );
+  decode(addr,entry);
+  numdecoded.fetch_add(1,std::memory_order_relaxed);
+  return entry;
+}
+
+/// \param addr is the address of the instruction
+/// \return the flow summary of the instruction, or null if it is not in the index
+const InstructionEntry *InstructionIndex::find(const Address &addr)
+
+{
+  Shard &shard( getShard(addr) );
+  std::lock_guard<std::mutex> guard(shard.lock);
+  map<Address,InstructionEntry>::const_iterator iter = shard.entries.find(addr);
+  if (iter == shard.entries.end())
+    return (const InstructionEntry *)0;
+  return &(*iter).second;
+}
+
+/// Flow is followed as in traceFunction(), but only through instructions that are already
+/// in the index, so nothing is decoded.  A basic block starts at the entry point, at the
+/// destination of each direct branch, and after each instruction that both branches and
+/// falls through.
+/// \param entry is the entry point of the function
+/// \param res will hold the counts
+/// \return \b true if the entry point is in the index
+bool InstructionIndex::measureFunction(const Address &entry,FlowMeasure &res)
+
+{
+  res = FlowMeasure();
+  if (find(entry) == (const InstructionEntry *)0)
+    return false;
+  set<Address> visited;
+  set<Address> starts;
+  vector<Address> work;
+  starts.insert(entry);
+  work.push_back(entry);
+  while(!work.empty()) {
+    Address addr = work.back();
+    work.pop_back();
+    while(visited.insert(addr).second) {
+      const InstructionEntry *insn = find(addr);
+      if (insn == (const InstructionEntry *)0 || insn->isBad()) {
+	visited.erase(addr);		// Not counted as an instruction, or as the start of a block
+	break;
+      }
+      res.numinsn += 1;
+      if ((insn->flags & InstructionEntry::branchind)!=0)
+	res.numindirect += 1;
+      for(int4 i=0;i<insn->branches.size();++i) {
+	starts.insert(insn->branches[i]);
+	work.push_back(insn->branches[i]);
+      }
+      if (!insn->isFallthru() || insn->length <= 0) break;
+      addr = addr + insn->length;
+      if (!insn->branches.empty())
+	starts.insert(addr);
+    }
+  }
+  set<Address>::const_iterator iter;
+  for(iter=starts.begin();iter!=starts.end();++iter) {
+    if (visited.find(*iter) != visited.end())
+      res.numblocks += 1;
+  }
+  return true;
+}
+
+/// Instructions are followed from the entry point along fall-through and direct branches,
+/// stopping at bad data.  Each direct call is reported as a pair (call site, destination).
+/// \param entry is the entry point of the function
+/// \param calls will hold the direct calls made by the function
+/// \param maxinsn is the maximum number of instructions to follow
+void InstructionIndex::traceFunction(const Address &entry,vector<pair<Address,Address> > &calls,uint4 maxinsn)
+
+{
+  set<Address> visited;
+  vector<Address> work;
+  uint4 count = 0;
+  work.push_back(entry);
+  while(!work.empty()) {
+    Address addr = work.back();
+    work.pop_back();
+    while(visited.insert(addr).second) {
+      if (count >= maxinsn) return;
+      count += 1;
+      const InstructionEntry &insn( obtain(addr) );
+      if (insn.isBad()) break;
+      for(int4 i=0;i<insn.calls.size();++i)
+	calls.push_back(pair<Address,Address>(addr,insn.calls[i]));
+      for(int4 i=0;i<insn.branches.size();++i)
+	work.push_back(insn.branches[i]);
+      if (!insn.isFallthru() || insn.length <= 0) break;
+      addr = addr + insn.length;
+    }
+  }
+}
+
+/// Every worker, including the calling thread, attaches its own decoding state to the
+/// translator and disables context changes on it for the duration.
+/// \param index is the index of the worker
+/// \param entries is the list of all function entry points to trace
+/// \param next is the index of the next entry point to trace
+/// \param results holds the calls made by each function
+/// \param maxinsn is the maximum number of instructions to follow per function
+void InstructionIndex::traceWorker(int4 index,const vector<Address> &entries,std::atomic<int4> &next,
+				   vector<vector<pair<Address,Address> > > &results,uint4 maxinsn)
+{
+  trans->attachThread();
+  trans->allowContextSet(false);
+  for(;;) {
+    int4 i = next.fetch_add(1);
+    if (i >= entries.size()) break;
+    traceFunction(entries[i],results[i],maxinsn);
+  }
+  trans->detachThread();
+}
+
+/// Entry points are handed out to the workers one at a time, and instructions shared between
+/// functions are decoded once, by whichever worker reaches them first.
+/// \param entries is the list of entry points of the functions to trace
+/// \param numthreads is the number of threads to use
+/// \param results will hold the calls made by each function, in the same order as \b entries
+/// \param maxinsn is the maximum number of instructions to follow per function
+void InstructionIndex::traceAll(const vector<Address> &entries,int4 numthreads,
+				vector<vector<pair<Address,Address> > > &results,uint4 maxinsn)
+{
+  results.clear();
+  results.resize(entries.size());
+  if (numthreads < 1) numthreads = 1;
+  if (numthreads > entries.size()) numthreads = entries.size();
+  std::atomic<int4> next(0);
+  vector<std::thread> threads;
+  for(int4 i=1;i<numthreads;++i)
+    threads.emplace_back(&InstructionIndex::traceWorker,this,i,std::cref(entries),std::ref(next),
+			 std::ref(results),maxinsn);
+  traceWorker(0,entries,next,results,maxinsn);	// The calling thread acts as worker 0
+  for(int4 i=0;i<threads.size();++i)
+    threads[i].join();
+}
+
+void InstructionIndex::clear(void)
+
+{
+  for(int4 i=0;i<numshards;++i) {
+    std::lock_guard<std::mutex> guard(shards[i].lock);
+    shards[i].entries.clear();
+  }
+  numdecoded = 0;
+  numreused = 0;
+}
+
+}
@@ -16,6 +16,11 @@
 #include "jumptable.hh"
 #include "emulate.hh"
 #include "flow.hh"
+#include "resultcache.hh"
+#include "constfold.hh"
+
+#include <fstream>
+#include <cstring>
 namespace GhidraDec {
 
 void LoadTable::saveXml(std::ostream &s) const
@@ -162,9 +167,9 @@ void EmulateFunction::fallthruOp(void)
   // Otherwise do nothing: outer loop is controlling execution flow
 }
 
-uintb EmulateFunction::emulatePath(uintb val,const PathMeld &pathMeld,
-				   PcodeOp *startop,Varnode *startvn)
-{
+uint4 EmulateFunction::findStart(const PathMeld &pathMeld,PcodeOp *&startop,Varnode *&startvn)
+
+{ // Find the index of the first op of the path to execute, adjusting -startop- and -startvn-
   uint4 i;
   for(i=0;i<pathMeld.numOps();++i)
     if (pathMeld.getOp(i) == startop) break;
@@ -183,6 +188,13 @@ uintb EmulateFunction::emulatePath(uintb val,const PathMeld &pathMeld,
   }
   if (i==pathMeld.numOps())
     throw LowlevelError("Bad jumptable emulation");
+  return i;
+}
+
+uintb EmulateFunction::emulatePath(uintb val,const PathMeld &pathMeld,
+				   PcodeOp *startop,Varnode *startvn)
+{
+  uint4 i = findStart(pathMeld,startop,startvn);
   if (!startvn->isConstant())
     setVarnodeValue(startvn,val);
   while(i>0) {
@@ -202,6 +214,187 @@ uintb EmulateFunction::emulatePath(uintb val,const PathMeld &pathMeld,
   return getVarnodeValue(invn);
 }
 
+bool EmulateFunction::canBatch(const PathMeld &pathMeld,uint4 start)
+
+{ // Can every op from -start- down be executed by emulatePathBatch, with the same effect as emulatePath
+  for(uint4 i=start;i>0;--i) {
+    PcodeOp *op = pathMeld.getOp(i);
+    OpBehavior *behave = op->getOpcode()->getBehavior();
+    if (behave == (OpBehavior *)0) continue;	// A no-op
+    switch(op->code()) {
+    case CPUI_LOAD:
+    case CPUI_COPY:
+    case CPUI_INDIRECT:
+      break;
+    case CPUI_CALL:
+    case CPUI_CALLIND:
+    case CPUI_CALLOTHER:
+    case CPUI_STORE:
+      if (op->getOut() != (Varnode *)0) return false;	// Its output would be left unset
+      break;
+    default:
+      if (behave->isSpecial()) return false;	// Branches, MULTIEQUAL, and anything else with its own handling
+      if (op->numInput() > 2 || op->getOut() == (Varnode *)0) return false;
+      break;
+    }
+  }
+  return true;
+}
+
+int4 EmulateFunction::getSlot(Varnode *vn,map<Varnode *,int4> &slotmap,vector<uintb> &slots,int4 count) const
+
+{ // Get the slot holding the values of -vn-, making one if it hasn't been seen.
+  // A new slot holds the same value for every run, as emulatePath would see it
+  map<Varnode *,int4>::const_iterator iter = slotmap.find(vn);
+  if (iter != slotmap.end())
+    return (*iter).second;
+  uintb val = getVarnodeValue(vn);
+  int4 slot = slots.size() / count;
+  slots.resize(slots.size() + count,val);
+  slotmap[vn] = slot;
+  return slot;
+}
+
+void EmulateFunction::batchLoad(PcodeOp *op,const uintb *in,uintb *out,int4 count,vector<LoadTable> &loads)
+
+{ // Execute a LOAD for every run.  If the addresses are close together, the bytes are read
+  // with a single loadFill, otherwise (or if that fails) one value at a time
+  AddrSpace *spc = Address::getSpaceFromConst(op->getIn(0)->getAddr());
+  int4 sz = op->getOut()->getSize();
+  vector<uintb> addr(count);
+  uintb lo = ~((uintb)0);
+  uintb hi = 0;
+  for(int4 k=0;k<count;++k) {
+    addr[k] = AddrSpace::addressToByte(in[k],spc->getWordSize());
+    if (addr[k] < lo) lo = addr[k];
+    if (addr[k] > hi) hi = addr[k];
+  }
+  bool done = false;
+  if (hi - lo <= 0x10000 && hi + sizeof(uintb) > hi && hi + sizeof(uintb) - 1 <= spc->getHighest()) {
+    vector<uint1> buf(hi - lo + sizeof(uintb));
+    try {
+      glb->loader->loadFill(buf.data(),buf.size(),Address(spc,lo));
+      done = true;
+    }
+    catch(DataUnavailError &err) {
+      // Some byte in between can't be read, so read the values separately
+    }
+    if (done) {
+      bool swap = ((HOST_ENDIAN==1) != spc->isBigEndian());
+      for(int4 k=0;k<count;++k) {	// Same as getLoadImageValue
+	uintb res;
+	memcpy(&res,buf.data() + (addr[k]-lo),sizeof(uintb));
+	if (swap)
+	  res = byte_swap(res,sizeof(uintb));
+	if (spc->isBigEndian() && (sz < sizeof(uintb)))
+	  res >>= (sizeof(uintb)-sz)*8;
+	else
+	  res &= calc_mask(sz);
+	out[k] = res;
+      }
+    }
+  }
+  if (!done) {
+    for(int4 k=0;k<count;++k)
+      out[k] = getLoadImageValue(spc,addr[k],sz);
+  }
+  if (collectloads) {
+    for(int4 k=0;k<count;++k)
+      loads.push_back(LoadTable(Address(spc,addr[k]),sz));
+  }
+}
+
+bool EmulateFunction::emulatePathBatch(const vector<uintb> &vals,const PathMeld &pathMeld,
+				       PcodeOp *startop,Varnode *startvn,vector<uintb> &res)
+{ // Emulate the path once for each starting value, as emulatePath does, but executing each op
+  // across all the values at once.  The values of each Varnode are kept in a flat array of slots,
+  // one slot of -count- values per Varnode, so no map is looked up per op and value.  Integer ops
+  // use the batch kernels of ConstantFold.  Returns false, without doing anything, if the path
+  // has ops that can only be emulated one value at a time
+  res.clear();
+  int4 count = vals.size();
+  if (count == 0) return true;
+  uint4 i = findStart(pathMeld,startop,startvn);
+  if (startvn->isConstant() || !canBatch(pathMeld,i))
+    return false;
+  map<Varnode *,int4> slotmap;
+  vector<uintb> slots(vals);		// Slot 0 holds the starting values
+  slotmap[startvn] = 0;
+  vector<LoadTable> loads;		// Loads of each op, for every run
+  vector<int4> loadstart;		// Where the loads of each LOAD op start in -loads-
+  vector<uintb> tmp;
+  while(i>0) {
+    PcodeOp *curop = pathMeld.getOp(i);
+    --i;
+    OpBehavior *behave = curop->getOpcode()->getBehavior();
+    Varnode *outvn = curop->getOut();
+    if (behave == (OpBehavior *)0 || outvn == (Varnode *)0) continue;
+    try {
+      int4 in1 = getSlot(curop->getIn(curop->code() == CPUI_LOAD ? 1 : 0),slotmap,slots,count);
+      int4 in2 = -1;
+      if (curop->code() != CPUI_LOAD && curop->numInput() > 1)
+	in2 = getSlot(curop->getIn(1),slotmap,slots,count);
+      tmp.resize(count);
+      const uintb *a = slots.data() + in1 * count;
+      const uintb *b = (in2 < 0) ? (const uintb *)0 : slots.data() + in2 * count;
+      switch(curop->code()) {
+      case CPUI_COPY:
+      case CPUI_INDIRECT:
+	for(int4 k=0;k<count;++k)
+	  tmp[k] = a[k];
+	break;
+      case CPUI_LOAD:
+	loadstart.push_back(loads.size());
+	batchLoad(curop,a,tmp.data(),count,loads);
+	break;
+      default:
+      {
+	int4 sizeout = outvn->getSize();
+	int4 sizein = curop->getIn(0)->getSize();
+	ConstantFold::BatchKernel kernel = ConstantFold::getBatchKernel(curop->code(),sizein);
+	if (kernel != (ConstantFold::BatchKernel)0)
+	  (*kernel)(sizeout,a,b,tmp.data(),count);
+	else if (behave->isUnary()) {
+	  for(int4 k=0;k<count;++k)
+	    tmp[k] = behave->evaluateUnary(sizeout,sizein,a[k]);
+	}
+	else {
+	  for(int4 k=0;k<count;++k)
+	    tmp[k] = behave->evaluateBinary(sizeout,sizein,a[k],b[k]);
+	}
+	break;
+      }
+      }
+    }
+    catch(DataUnavailError &err) {
+      ostringstream msg;
+      msg << "Could not emulate address calculation at " << curop->getAddr();
+      throw LowlevelError(msg.str());
+    }
+    map<Varnode *,int4>::const_iterator iter = slotmap.find(outvn);
+    int4 out;
+    if (iter != slotmap.end())
+      out = (*iter).second;
+    else {
+      out = slots.size() / count;
+      slotmap[outvn] = out;
+      slots.resize(slots.size() + count);
+    }
+    for(int4 k=0;k<count;++k)
+      slots[out * count + k] = tmp[k];
+  }
+  Varnode *invn = pathMeld.getOp(0)->getIn(0);
+  int4 fin = getSlot(invn,slotmap,slots,count);
+  res.assign(slots.begin() + fin * count,slots.begin() + (fin+1) * count);
+  if (collectloads) {		// Record the loads in the order emulatePath would have
+    for(int4 k=0;k<count;++k) {
+      for(int4 j=0;j<loadstart.size();++j)
+	loadpoints.push_back(loads[loadstart[j] + k]);
+    }
+  }
+  return true;
+}
+
 void EmulateFunction::collectLoadPoints(std::vector<LoadTable> &res) const
 
 {
@@ -665,20 +858,22 @@ void PathMeld::internalIntersect(std::vector<int4> &parentMap)
 { // Calculate intersection of new path (marked vn's) with old path (commonVn)
   // Put intersection back into commonVn
   // Calculate parentMap : from old commonVn index to new commonVn index
-  std::vector<Varnode *> newVn;
+  // The intersection is compacted in place, as it is never longer than the old path
   int4 lastIntersect = -1;
+  int4 numIntersect = 0;
+  parentMap.reserve(commonVn.size());
   for(int4 i=0;i<commonVn.size();++i) {
     Varnode *vn = commonVn[i];
     if (vn->isMark()) {		// Look for previously marked varnode, so we know it is in both lists
-      lastIntersect = newVn.size();
+      lastIntersect = numIntersect;
       parentMap.push_back(lastIntersect);
-      newVn.push_back(vn);
+      commonVn[numIntersect++] = vn;
       vn->clearMark();
     }
     else
       parentMap.push_back(-1);
   }
-  commonVn = newVn;
+  commonVn.resize(numIntersect);
   lastIntersect = -1;
   for(int4 i=parentMap.size()-1;i>=0;--i) {
     int4 val = parentMap[i];
@@ -709,6 +904,8 @@ int4 PathMeld::meldOps(const std::vector<PcodeOp *> &path,int4 cutOff,const std:
 
   // Do a merge sort, keeping ops in execution order
   std::vector<RootedOp> newMeld;
+  if (cutOff > 0)
+    newMeld.reserve(opMeld.size() + cutOff);
   int4 curRoot = -1;
   int4 meldPos = 0;				// Ops moved from old opMeld into newMeld
   const BlockBasic *lastBlock = (const BlockBasic *)0;
@@ -731,7 +928,7 @@ int4 PathMeld::meldOps(const std::vector<PcodeOp *> &path,int4 cutOff,const std:
 	  int4 res = opMeld[meldPos].rootVn;		// Force truncatePath at (and above) this op
 
 	  // Found a new cut point
-	  opMeld = newMeld;				// Take what we've melded so far
+	  opMeld.swap(newMeld);				// Take what we've melded so far
 	  return res;					// return the new cutpoint
 	}
       }
@@ -754,7 +951,7 @@ int4 PathMeld::meldOps(const std::vector<PcodeOp *> &path,int4 cutOff,const std:
     }
     lastBlock = op->getParent();
   }
-  opMeld = newMeld;
+  opMeld.swap(newMeld);
   return -1;
 }
 
@@ -780,6 +977,8 @@ void PathMeld::set(const PathMeld &op2)
 void PathMeld::set(const std::vector<PcodeOp *> &path,const std::vector<int4> &slot)
 
 {
+  opMeld.reserve(opMeld.size() + path.size());
+  commonVn.reserve(commonVn.size() + path.size());
   for(int4 i=0;i<path.size();++i) {
     PcodeOp *op = path[i];
     Varnode *vn = op->getIn(slot[i]);
@@ -805,6 +1004,13 @@ void PathMeld::append(const PathMeld &op2)
     opMeld[i].rootVn += op2.commonVn.size();
 }
 
+void PathMeld::swap(PathMeld &op2)
+
+{
+  commonVn.swap(op2.commonVn);
+  opMeld.swap(op2.opMeld);
+}
+
 void PathMeld::clear(void)
 
 {
@@ -865,6 +1071,7 @@ void JumpBasic::analyzeGuards(BlockBasic *bl,int4 pathout)
   bool usenzmask = (jumptable->getStage() == 0);
 
   selectguards.clear();
+  selectguards.reserve(maxbranch * (maxpullback + 1));
   BlockBasic *prevbl;
   Varnode *vn;
 
@@ -1100,7 +1307,7 @@ bool JumpBasic::recoverModel(Funcdata *fd,PcodeOp *indop,uint4 matchsize,uint4 m
 void JumpBasic::buildAddresses(Funcdata *fd,PcodeOp *indop,std::vector<Address> &addresstable,std::vector<LoadTable> *loadpoints) const
 
 {
-  uintb val,addr;
+  uintb addr;
   addresstable.clear();		// Clear out any partial recoveries
 				// Build the emulation engine
   EmulateFunction emul(fd);
@@ -1108,14 +1315,21 @@ void JumpBasic::buildAddresses(Funcdata *fd,PcodeOp *indop,std::vector<Address>
     emul.setLoadCollect(true);
 
   AddrSpace *spc = indop->getAddr().getSpace();
+  vector<uintb> vals,results;
   bool notdone = jrange->initializeForReading();
   while(notdone) {
-    val = jrange->getValue();
-    addr = emul.emulatePath(val,pathMeld,jrange->getStartOp(),jrange->getStartVarnode());
-    addr = AddrSpace::addressToByte(addr,spc->getWordSize());
-    addresstable.push_back(Address(spc,addr));
+    vals.push_back(jrange->getValue());
     notdone = jrange->next();
   }
+  if (!emul.emulatePathBatch(vals,pathMeld,jrange->getStartOp(),jrange->getStartVarnode(),results)) {
+    results.clear();		// Emulate one value at a time
+    for(int4 i=0;i<vals.size();++i)
+      results.push_back(emul.emulatePath(vals[i],pathMeld,jrange->getStartOp(),jrange->getStartVarnode()));
+  }
+  for(int4 i=0;i<results.size();++i) {
+    addr = AddrSpace::addressToByte(results[i],spc->getWordSize());
+    addresstable.push_back(Address(spc,addr));
+  }
   if (loadpoints != (std::vector<LoadTable> *)0)
     emul.collectLoadPoints(*loadpoints);
 }
@@ -1312,15 +1526,17 @@ bool JumpBasic2::foldInOneGuard(Funcdata *fd,GuardRecord &guard,JumpTable *jump)
   return true;
 }
 
-void JumpBasic2::initializeStart(const PathMeld &pathMeld)
+void JumpBasic2::initializeStart(PathMeld &pathMeld)
 
 { // Initialize with the point at which model 1 failed
+  // The paths are taken over from -pathMeld-, which is left empty
   if (pathMeld.empty()) {
     extravn = (Varnode *)0;
     return;
   }
   extravn = pathMeld.getVarnode(pathMeld.numCommonVarnode()-1);
-  origPathMeld.set(pathMeld);
+  origPathMeld.clear();
+  origPathMeld.swap(pathMeld);
 }
 
 bool JumpBasic2::recoverModel(Funcdata *fd,PcodeOp *indop,uint4 matchsize,uint4 maxtablesize)
@@ -1444,7 +1660,7 @@ void JumpBasicOverride::setAddresses(const std::vector<Address> &adtable)
 int4 JumpBasicOverride::findStartOp(Varnode *vn)
 
 { // Return the op (within determop) that takes -vn- as input, otherwise return null
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = vn->beginDescend();
   enditer = vn->endDescend();
   for(;iter!=enditer;++iter)
@@ -1816,7 +2032,7 @@ void JumpAssisted::foldInNormalization(Funcdata *fd,PcodeOp *indop)
 {
   // Replace all outputs of jumpassist op with switchvn (including BRANCHIND)
   Varnode *outvn = assistOp->getOut();
-  list<PcodeOp *>::const_iterator iter = outvn->beginDescend();
+  DescendList::const_iterator iter = outvn->beginDescend();
   while(iter != outvn->endDescend()) {
     PcodeOp *op = *iter;
     ++iter;
@@ -2228,6 +2444,17 @@ bool JumpTable::recoverLabels(Funcdata *fd)
   return multistagerestart;
 }
 
+/// The estimate counts the recovered addresses, block indices, labels, and load points.
+/// \return the estimated number of bytes
+uint8 JumpTable::memoryEstimate(void) const
+
+{
+  uint8 res = sizeof(JumpTable);
+  res += addresstable.capacity() * sizeof(Address) + blocktable.capacity() * sizeof(uint4);
+  res += label.capacity() * sizeof(uintb) + loadpoints.capacity() * sizeof(LoadTable);
+  return res;
+}
+
 void JumpTable::clear(void)
 
 { // Right now this is only getting called, when the jumptable is an override in order to clear out derived data
@@ -2340,4 +2567,192 @@ bool JumpTable::checkForMultistage(Funcdata *fd)
   }
   return false;
 }
+bool JumpTableCache::hashEntry(const Entry &entry,uint8 &hash) const
+
+{ // Hash the bytes a cached table depends on, return -false- if they can't all be read
+  hash = 0;
+  return ResultCache::hashLoadImage(glb->loader,entry.ranges,hash);
+}
+
+void JumpTableCache::insert(const Address &fnaddr,JumpTable *jt,const RangeList &ranges,uint8 hash)
+
+{ // Take ownership of a table, replacing any previous table for the same switch
+  Entry &slot( cache[fnaddr][jt->getOpAddress()] );
+  if (slot.table != (JumpTable *)0)
+    delete slot.table;
+  else
+    count += 1;
+  slot.table = jt;
+  slot.ranges = ranges;
+  slot.hash = hash;
+}
+
+const JumpTable *JumpTableCache::find(const Address &fnaddr,const Address &opaddr) const
+
+{ // Find a previously recovered table whose bytes are unchanged, or return null
+  map<Address,map<Address,Entry> >::const_iterator iter = cache.find(fnaddr);
+  if (iter == cache.end()) return (const JumpTable *)0;
+  map<Address,Entry>::const_iterator jiter = (*iter).second.find(opaddr);
+  if (jiter == (*iter).second.end()) return (const JumpTable *)0;
+  const Entry &entry( (*jiter).second );
+  uint8 hash;
+  if (!hashEntry(entry,hash) || hash != entry.hash)
+    return (const JumpTable *)0;	// Program bytes have changed since recovery
+  return entry.table;
+}
+
+void JumpTableCache::store(const Address &fnaddr,const JumpTable *jt,const RangeList &reads)
+
+{ // Keep a copy of a freshly recovered table, given the load image ranges read to recover it
+  Entry entry;
+  entry.ranges = reads;
+  try {
+    int4 len = glb->translate->instructionLength(jt->getOpAddress());
+    if (len > 0) {
+      const Address &addr( jt->getOpAddress() );
+      entry.ranges.insertRange(addr.getSpace(),addr.getOffset(),addr.getOffset() + (len - 1));
+    }
+  }
+  catch(LowlevelError &err) {
+    return;			// Can't identify the instruction bytes, don't cache
+  }
+  if (!hashEntry(entry,entry.hash)) return;
+  entry.table = new JumpTable(jt);
+  insert(fnaddr,entry.table,entry.ranges,entry.hash);
+  if (filename.empty() || !jt->isRecovered()) return;
+  ofstream s(filename.c_str(),ios::out | ios::app);
+  if (!s) return;		// File is not writable, just keep the table in memory
+  saveXmlEntry(s,fnaddr,cache[fnaddr][jt->getOpAddress()]);
+}
+
+void JumpTableCache::clearFunction(const Address &fnaddr)
+
+{
+  map<Address,map<Address,Entry> >::iterator iter = cache.find(fnaddr);
+  if (iter == cache.end()) return;
+  map<Address,Entry>::iterator jiter;
+  for(jiter=(*iter).second.begin();jiter!=(*iter).second.end();++jiter) {
+    delete (*jiter).second.table;
+    count -= 1;
+  }
+  cache.erase(iter);
+}
+
+void JumpTableCache::clear(void)
+
+{
+  map<Address,map<Address,Entry> >::iterator iter;
+  map<Address,Entry>::iterator jiter;
+  for(iter=cache.begin();iter!=cache.end();++iter) {
+    for(jiter=(*iter).second.begin();jiter!=(*iter).second.end();++jiter)
+      delete (*jiter).second.table;
+  }
+  cache.clear();
+  count = 0;
+}
+
+void JumpTableCache::saveXmlEntry(ostream &s,const Address &fnaddr,const Entry &entry) const
+
+{
+  s << "<cachedtable";
+  a_v_u(s,"hash",entry.hash);
+  s << ">\n";
+  fnaddr.saveXml(s);
+  s << '\n';
+  entry.ranges.saveXml(s);
+  entry.table->saveXml(s);
+  s << "</cachedtable>\n";
+}
+
+void JumpTableCache::restoreXmlEntry(const Element *el)
+
+{
+  uint8 hash;
+  istringstream s(el->getAttributeValue("hash"));
+  s.unsetf(std::ios::dec | std::ios::hex | std::ios::oct);
+  s >> hash;
+  const List &list( el->getChildren() );
+  List::const_iterator iter = list.begin();
+  if (iter == list.end())
+    throw LowlevelError("Bad cached jumptable");
+  Address fnaddr = Address::restoreXml(*iter,glb);
+  ++iter;
+  if (iter == list.end())
+    throw LowlevelError("Bad cached jumptable");
+  RangeList ranges;
+  ranges.restoreXml(*iter,glb);
+  ++iter;
+  if (iter == list.end())
+    throw LowlevelError("Bad cached jumptable");
+  JumpTable *jt = new JumpTable(glb);
+  try {
+    jt->restoreXml(*iter);
+  }
+  catch(LowlevelError &err) {
+    delete jt;
+    throw;
+  }
+  insert(fnaddr,jt,ranges,hash);
+}
+
+void JumpTableCache::saveXml(ostream &s) const
+
+{
+  map<Address,map<Address,Entry> >::const_iterator iter;
+  map<Address,Entry>::const_iterator jiter;
+  s << "<jumptablecache>\n";
+  for(iter=cache.begin();iter!=cache.end();++iter) {
+    for(jiter=(*iter).second.begin();jiter!=(*iter).second.end();++jiter) {
+      if ((*jiter).second.table->isRecovered())
+	saveXmlEntry(s,(*iter).first,(*jiter).second);
+    }
+  }
+  s << "</jumptablecache>\n";
+}
+
+void JumpTableCache::restoreXml(const Element *el)
+
+{ // Later entries for the same switch replace earlier ones
+  const List &list( el->getChildren() );
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter)
+    restoreXmlEntry(*iter);
+}
+
+void JumpTableCache::attachFile(const string &fname)
+
+{ // Read any tables persisted in the file, then append newly stored tables to it
+  filename = fname;
+  ifstream s(filename.c_str());
+  if (!s) return;		// No tables stored yet
+  ostringstream body;
+  body << "<jumptablecache>" << s.rdbuf() << "</jumptablecache>";
+  istringstream wrapped(body.str());
+  Document *doc = (Document *)0;
+  bool damaged = false;
+  try {
+    doc = xml_tree(wrapped);
+    restoreXml(doc->getRoot());
+  }
+  catch(XmlError &err) {
+    damaged = true;
+  }
+  catch(LowlevelError &err) {
+    damaged = true;
+  }
+  if (doc != (Document *)0)
+    delete doc;
+  if (!damaged) return;
+  s.close();			// Rewrite the file with just the tables that could be read
+  ofstream out(filename.c_str(),ios::out | ios::trunc);
+  map<Address,map<Address,Entry> >::const_iterator iter;
+  map<Address,Entry>::const_iterator jiter;
+  for(iter=cache.begin();iter!=cache.end();++iter) {
+    for(jiter=(*iter).second.begin();jiter!=(*iter).second.end();++jiter) {
+      if ((*jiter).second.table->isRecovered())
+	saveXmlEntry(out,(*iter).first,(*jiter).second);
+    }
+  }
+}
+
 }
@@ -54,4 +54,83 @@ void shutdownDecompilerLibrary(void)
 {
 }
 
+/// The format of the file is recognized by the registered ArchitectureCapability objects, as for
+/// the \b load \b file console command.  Any program already open in \b this is closed first.
+/// \param filename is the path to the executable image
+/// \param target is the \e language \e id to use, or "default" to let the loader decide
+void DecompilerContext::open(const string &filename,const string &target)
+
+{
+  close();
+  ArchitectureCapability *capa = ArchitectureCapability::findCapability(filename);
+  if (capa == (ArchitectureCapability *)0)
+    throw LowlevelError("Unable to recognize image file " + filename);
+  Architecture *arch = capa->buildArchitecture(filename,target,&errs);
+  DocumentStorage store;
+  try {
+    arch->init(store);
+  }
+  catch(LowlevelError &err) {
+    delete arch;
+    throw;
+  }
+  catch(XmlError &err) {
+    delete arch;
+    throw LowlevelError("Could not load " + filename + ": " + err.explain);
+  }
+  if (capa->getName() == "xml")
+    arch->readLoaderSymbols();
+  glb = arch;
+}
+
+void DecompilerContext::close(void)
+
+{
+  if (glb == (Architecture *)0) return;
+  delete glb;
+  glb = (Architecture *)0;
+}
+
+/// The function is decompiled with the current root Action of the Architecture and printed
+/// with its current PrintLanguage.  The analysis is released afterward, so the memory held by
+/// a long-lived context does not grow with the number of functions decompiled.
+/// \param addr is the entry point of the function
+/// \return the source code of the function
+string DecompilerContext::decompile(const Address &addr)
+
+{
+  if (glb == (Architecture *)0)
+    throw LowlevelError("No program is open");
+  Funcdata *fd = glb->symboltab->getGlobalScope()->queryFunction(addr);
+  if (fd == (Funcdata *)0)
+    throw LowlevelError("No function at the given address");
+  if (fd->hasNoCode())
+    throw LowlevelError("No code for function " + fd->getName());
+  Action *root = glb->allacts.getCurrent();
+  ostringstream s;
+  glb->clearAnalysis(fd);
+  try {
+    root->reset(*fd);
+    root->perform(*fd);
+    if (!fd->isProcComplete())
+      throw LowlevelError("Decompilation of " + fd->getName() + " did not complete");
+    ostream *saveout = glb->print->getOutputStream();
+    glb->print->setOutputStream(&s);
+    try {
+      glb->print->docFunction(fd);
+    }
+    catch(LowlevelError &err) {
+      glb->print->setOutputStream(saveout);
+      throw;
+    }
+    glb->print->setOutputStream(saveout);
+  }
+  catch(LowlevelError &err) {
+    glb->clearAnalysis(fd);
+    throw;
+  }
+  glb->clearAnalysis(fd);
+  return s.str();
+}
+
 }
@@ -18,6 +18,13 @@
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace GhidraDec {
 
@@ -118,4 +125,325 @@ void RawLoadImage::loadFill(uint1 *ptr,int4 size,const Address &addr)
 
 }
 
+/// The range is mapped read-only, and is cut short at the end of the file.  An empty range
+/// is allowed and maps no bytes.
+/// \param filename is the path of the file
+/// \param offset is the offset of the first byte of the range within the file
+/// \param length is the number of bytes in the range
+void FileMapping::openRange(const string &filename,uintb offset,uintb length)
+
+{
+  if (base != (const uint1 *)0) throw LowlevelError("file is already mapped");
+  mapped = false;
+  skip = 0;
+#ifdef _WINDOWS
+  std::ifstream s(filename.c_str(),std::ios::in | std::ios::binary);
+  if (!s)
+    throw LowlevelError("Unable to open raw image file: "+filename);
+  s.seekg(0,std::ios::end);
+  uintb filesize = s.tellg();
+  if (offset > filesize)
+    throw LowlevelError("Range starts past the end of raw image file: "+filename);
+  size = (length > filesize - offset) ? filesize - offset : length;
+  s.seekg(offset,std::ios::beg);
+  uint1 *buf = new uint1[size == 0 ? 1 : size];
+  s.read((char *)buf,size);
+  base = buf;
+#else
+  int fd = ::open(filename.c_str(),O_RDONLY);
+  if (fd < 0)
+    throw LowlevelError("Unable to open raw image file: "+filename);
+  struct stat st;
+  if (fstat(fd,&st) != 0) {
+    ::close(fd);
+    throw LowlevelError("Unable to get size of raw image file: "+filename);
+  }
+  uintb filesize = st.st_size;
+  if (offset > filesize) {
+    ::close(fd);
+    throw LowlevelError("Range starts past the end of raw image file: "+filename);
+  }
+  size = (length > filesize - offset) ? filesize - offset : length;
+  if (size == 0) {
+    ::close(fd);
+    base = new uint1[1];	// Nothing to map, but mark the file as open
+    return;
+  }
+  skip = offset % sysconf(_SC_PAGESIZE);	// Mappings must start on a page boundary
+  void *map = mmap((void *)0,size + skip,PROT_READ,MAP_PRIVATE,fd,offset - skip);
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    size = 0;
+    skip = 0;
+    throw LowlevelError("Unable to map raw image file: "+filename);
+  }
+  base = (const uint1 *)map + skip;
+  mapped = true;
+#endif
+}
+
+void FileMapping::close(void)
+
+{
+  if (base == (const uint1 *)0) return;
+#ifndef _WINDOWS
+  if (mapped)
+    munmap((void *)(base - skip),size + skip);
+  else
+#endif
+    delete [] base;
+  base = (const uint1 *)0;
+  size = 0;
+  skip = 0;
+  mapped = false;
+}
+
+LoadImageMmap::LoadImageMmap(const std::string &f) : LoadImage(f)
+
+{
+  vma = 0;
+  spaceid = (AddrSpace *)0;
+}
+
+LoadImageMmap::~LoadImageMmap(void)
+
+{
+}
+
+void LoadImageMmap::open(void)
+
+{
+  if (file.isOpen()) throw LowlevelError("loadimage is already open");
+  file.open(filename);
+}
+
+std::string LoadImageMmap::getArchType(void) const
+
+{
+  return "unknown";
+}
+
+void LoadImageMmap::adjustVma(long adjust)
+
+{
+  if (spaceid != (AddrSpace *)0)
+    adjust = AddrSpace::addressToByte(adjust,spaceid->getWordSize());
+  vma += adjust;
+}
+
+/// Bytes past the end of the file read as zero, provided the first byte is within the file.
+void LoadImageMmap::loadFill(uint1 *ptr,int4 size,const Address &addr)
+
+{
+  if (size <= 0) return;
+  uintb filesize = file.getSize();
+  uintb curaddr = addr.getOffset() - vma;	// Get relative offset of first byte
+  if (curaddr >= filesize) {
+    ostringstream errmsg;
+    errmsg << "Unable to load " << dec << size << " bytes at " << addr.getShortcut();
+    addr.printRaw(errmsg);
+    throw DataUnavailError(errmsg.str());
+  }
+  uintb readsize = size;
+  if (readsize > filesize - curaddr)
+    readsize = filesize - curaddr;
+  memcpy(ptr,file.getBase() + curaddr,readsize);
+  if (readsize < size)
+    memset(ptr + readsize,0,size - readsize);	// Fill out the rest of the buffer with 0
+}
+
+const uint1 *LoadImageMmap::peek(int4 size,const Address &addr)
+
+{
+  uintb filesize = file.getSize();
+  uintb curaddr = addr.getOffset() - vma;
+  if (curaddr >= filesize || size > filesize - curaddr)
+    return (const uint1 *)0;
+  return file.getBase() + curaddr;
+}
+
+LoadImageRegions::LoadImageRegions(const std::string &f) : LoadImage(f)
+
+{
+  spaceid = (AddrSpace *)0;
+}
+
+LoadImageRegions::~LoadImageRegions(void)
+
+{
+  for(int4 i=0;i<regions.size();++i)
+    delete regions[i].mapping;
+}
+
+/// Each region is checked against the size of the file, and regions may not overlap.
+/// \param mapfile is the path of the region map
+void LoadImageRegions::open(const string &mapfile)
+
+{
+  if (!regions.empty()) throw LowlevelError("loadimage is already open");
+  std::ifstream image(filename.c_str(),std::ios::in | std::ios::binary);
+  if (!image)
+    throw LowlevelError("Unable to open raw image file: "+filename);
+  image.seekg(0,std::ios::end);
+  uintb filesize = image.tellg();
+  std::ifstream s(mapfile.c_str());
+  if (!s)
+    throw LowlevelError("Unable to open region map: "+mapfile);
+  string line;
+  int4 lineno = 0;
+  while(getline(s,line)) {
+    lineno += 1;
+    istringstream ls(line);
+    ls.unsetf(std::ios::dec | std::ios::hex | std::ios::oct);
+    ls >> ws;
+    if (ls.eof() || ls.peek() == '#') continue;
+    Region reg;
+    ls >> reg.fileoffset >> reg.address >> reg.size;
+    if (ls.fail()) {
+      ostringstream errmsg;
+      errmsg << mapfile << ':' << dec << lineno << ": expected fileoffset address size";
+      throw LowlevelError(errmsg.str());
+    }
+    string flag;
+    ls >> flag;
+    reg.readonly = (flag == "readonly");
+    if (!reg.readonly && !flag.empty()) {
+      ostringstream errmsg;
+      errmsg << mapfile << ':' << dec << lineno << ": unknown region flag " << flag;
+      throw LowlevelError(errmsg.str());
+    }
+    if (reg.fileoffset > filesize || reg.size > filesize - reg.fileoffset) {
+      ostringstream errmsg;
+      errmsg << mapfile << ':' << dec << lineno << ": region runs past the end of " << filename;
+      throw LowlevelError(errmsg.str());
+    }
+    if (reg.size == 0) continue;
+    reg.mapping = (FileMapping *)0;
+    regions.push_back(reg);
+  }
+  sort(regions.begin(),regions.end());
+  for(int4 i=1;i<regions.size();++i) {
+    if (regions[i].address - regions[i-1].address < regions[i-1].size) {
+      regions.clear();
+      throw LowlevelError("Overlapping regions in region map: "+mapfile);
+    }
+  }
+}
+
+/// \param off is the offset to search for
+/// \return the region containing \b off, or the first region after \b off, or the end of the list
+vector<LoadImageRegions::Region>::iterator LoadImageRegions::findRegion(uintb off)
+
+{
+  Region key;
+  key.address = off;
+  vector<Region>::iterator iter = upper_bound(regions.begin(),regions.end(),key);
+  if (iter != regions.begin()) {
+    --iter;			// Last region starting at or before off
+    if (off - (*iter).address >= (*iter).size)
+      ++iter;			// It ends before off
+  }
+  return iter;
+}
+
+/// \param reg is the region
+/// \return the start of the bytes of the region in memory
+const uint1 *LoadImageRegions::getBytes(Region &reg)
+
+{
+  if (reg.mapping == (FileMapping *)0) {
+    FileMapping *mapping = new FileMapping();
+    try {
+      mapping->openRange(filename,reg.fileoffset,reg.size);
+    } catch(LowlevelError &err) {
+      delete mapping;
+      throw;
+    }
+    reg.mapping = mapping;
+  }
+  return reg.mapping->getBase();
+}
+
+/// Bytes in a hole read as zero, provided the first byte is within a region.
+void LoadImageRegions::loadFill(uint1 *ptr,int4 size,const Address &addr)
+
+{
+  if (size <= 0) return;
+  uintb off = addr.getOffset();
+  vector<Region>::iterator iter = findRegion(off);
+  if (iter == regions.end() || (*iter).address > off) {
+    ostringstream errmsg;
+    errmsg << "Unable to load " << dec << size << " bytes at " << addr.getShortcut();
+    addr.printRaw(errmsg);
+    throw DataUnavailError(errmsg.str());
+  }
+  while(size > 0) {
+    uintb cnt;
+    if (iter == regions.end() || (*iter).address > off) {	// Within a hole
+      cnt = (iter == regions.end()) ? size : (*iter).address - off;
+      if (cnt > size)
+	cnt = size;
+      memset(ptr,0,cnt);
+    }
+    else {
+      uintb over = off - (*iter).address;
+      cnt = (*iter).size - over;
+      if (cnt > size)
+	cnt = size;
+      memcpy(ptr,getBytes(*iter) + over,cnt);
+      ++iter;
+    }
+    ptr += cnt;
+    size -= cnt;
+    off += cnt;
+  }
+}
+
+const uint1 *LoadImageRegions::peek(int4 size,const Address &addr)
+
+{
+  uintb off = addr.getOffset();
+  vector<Region>::iterator iter = findRegion(off);
+  if (iter == regions.end() || (*iter).address > off) return (const uint1 *)0;
+  uintb over = off - (*iter).address;
+  if (size > (*iter).size - over) return (const uint1 *)0;
+  return getBytes(*iter) + over;
+}
+
+bool LoadImageRegions::isHole(int4 size,const Address &addr)
+
+{
+  uintb off = addr.getOffset();
+  vector<Region>::iterator iter = findRegion(off);
+  if (iter == regions.end()) return true;
+  return ((*iter).address - off >= size && (*iter).address > off);
+}
+
+void LoadImageRegions::getReadonly(RangeList &list) const
+
+{
+  if (spaceid == (AddrSpace *)0) return;
+  for(int4 i=0;i<regions.size();++i) {
+    const Region &reg(regions[i]);
+    if (reg.readonly)
+      list.insertRange(spaceid,reg.address,reg.address + reg.size - 1);
+  }
+}
+
+std::string LoadImageRegions::getArchType(void) const
+
+{
+  return "unknown";
+}
+
+/// The adjustment is added to the address of every region.
+void LoadImageRegions::adjustVma(long adjust)
+
+{
+  if (spaceid != (AddrSpace *)0)
+    adjust = AddrSpace::addressToByte(adjust,spaceid->getWordSize());
+  for(int4 i=0;i<regions.size();++i)
+    regions[i].address += adjust;
+}
+
 }
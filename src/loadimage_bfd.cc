@@ -70,6 +70,7 @@ void LoadImageBfd::adjustVma(long adjust)
     s->vma += adjust;
     s->lma += adjust;
   }
+  buildSectionIndex();
 }
 
 void LoadImageBfd::open(void)
@@ -88,6 +89,7 @@ void LoadImageBfd::open(void)
     errmsg += " : not in recognized object file format";
     throw LowlevelError(errmsg);
   }
+  buildSectionIndex();
 }
 
 void LoadImageBfd::close(void)
@@ -97,29 +99,60 @@ void LoadImageBfd::close(void)
   thebfd = (bfd *)0;
 }
 
-asection *LoadImageBfd::findSection(uintb offset,uintb &secsize) const
+void LoadImageBfd::buildSectionIndex(void)
 
-{ // Return section containing offset, or closest greater section
+{
   asection *p;
-  uintb start,stop;
+  int4 order = 0;
 
+  secindex.clear();
   for(p = thebfd->sections; p != (asection *)NULL; p = p->next) {
-    start = p->vma;
-    secsize = (p->size!=0) ? p->size : p->rawsize;
-    stop = start + secsize;
-    if ((offset>=start)&&(offset<stop))
-      return p;
+    SectionEntry entry;
+    entry.start = p->vma;
+    entry.stop = entry.start + ((p->size!=0) ? p->size : p->rawsize);
+    entry.order = order++;
+    entry.sec = p;
+    secindex.push_back(entry);
   }
-  asection *champ = (asection *)0;
-  for(p = thebfd->sections; p != (asection *)NULL; p = p->next) {
-    if (p->vma > offset) {
-      if (champ == (asection *)0)
-	champ = p;
-      else if (p->vma < champ->vma)
-	champ = p;
+  sort(secindex.begin(),secindex.end());
+  secmaxstop.resize(secindex.size());
+  uintb maxstop = 0;
+  for(int4 i=0;i<secindex.size();++i) {
+    if (secindex[i].stop > maxstop)
+      maxstop = secindex[i].stop;
+    secmaxstop[i] = maxstop;
+  }
+}
+
+asection *LoadImageBfd::findSection(uintb offset,uintb &secsize) const
+
+{ // Return section containing offset, or closest greater section
+  // If sections overlap, the one earliest in the BFD list wins
+  int4 lo = 0;
+  int4 hi = secindex.size();
+  while(lo < hi) {		// Find first section starting after offset
+    int4 mid = (lo + hi) / 2;
+    if (secindex[mid].start <= offset)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  const SectionEntry *champ = (const SectionEntry *)0;
+  for(int4 i=lo-1;i>=0;--i) {
+    if (secmaxstop[i] <= offset) break; // No earlier section reaches offset
+    const SectionEntry &entry( secindex[i] );
+    if (offset < entry.stop) {
+      if (champ == (const SectionEntry *)0 || entry.order < champ->order)
+	champ = &entry;
     }
   }
-  return champ;
+  if (champ == (const SectionEntry *)0) {
+    if (lo == secindex.size())
+      return (asection *)0;
+    champ = &secindex[lo];
+  }
+  secsize = champ->stop - champ->start;
+  return champ->sec;
 }
 
 void LoadImageBfd::loadFill(uint1 *ptr,int4 size,const Address &addr)
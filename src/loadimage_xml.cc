@@ -15,6 +15,7 @@
  */
 #include "loadimage_xml.hh"
 #include "translate.hh"
+#include "filemanage.hh"
 
 namespace GhidraDec {
 /// \param f is the (path to the) underlying XML file
@@ -38,16 +39,17 @@ void LoadImageXml::saveXml(ostream &s) const
 {
   s << "<binaryimage arch=\"" << archtype << "\">\n";
 
-  map<Address,vector<uint1> >::const_iterator iter1;
+  map<Address,Chunk>::const_iterator iter1;
   for(iter1=chunk.begin();iter1!=chunk.end();++iter1) {
-    const vector<uint1> &vec((*iter1).second);
-    if (vec.size() == 0) continue;
+    const Chunk &chnk((*iter1).second);
+    if (chnk.size() == 0) continue;
+    const uint1 *vec = chnk.data();
     s << " <bytechunk";
     (*iter1).first.getSpace()->saveXmlAttributes(s,(*iter1).first.getOffset());
     if (readonlyset.find((*iter1).first) != readonlyset.end())
       s << " readonly=\"true\"";
     s << ">\n  " << setfill('0');
-    for(int4 i=0;i<vec.size();++i) {
+    for(uintb i=0;i<chnk.size();++i) {
       s << hex << setw(2) << (int4)vec[i];
       if (i%20 == 19)
 	s << "\n  ";
@@ -64,6 +66,156 @@ void LoadImageXml::saveXml(ostream &s) const
   s << "</binaryimage>\n";
 }
 
+/// The content of a \<bytechunk> tag is pairs of hex digits, possibly separated by whitespace.
+/// \param content is the content of the tag
+/// \param vec will hold the decoded bytes
+static void decodeByteChunk(const string &content,vector<uint1> &vec)
+
+{
+  istringstream is(content);
+  int4 val;
+  char c1,c2;
+  is >> ws;
+  c1 = is.get();
+  c2 = is.get();
+  while((c1>0)&&(c2>0)) {
+    if (c1 <= '9')
+      c1 = c1 - '0';
+    else if (c1 <= 'F')
+      c1 = c1 + 10 - 'A';
+    else
+      c1 = c1 + 10 - 'a';
+    if (c2 <= '9')
+      c2 = c2 - '0';
+    else if (c2 <= 'F')
+      c2 = c2 + 10 - 'A';
+    else
+      c2 = c2 + 10 - 'a';
+    val = c1*16 + c2;
+    vec.push_back((uint1)val);
+    is >> ws;
+    c1 = is.get();
+    c2 = is.get();
+  }
+}
+
+/// The content of a \<bytechunk> with \e encoding="base64" is base64 text, possibly broken by whitespace.
+/// Decoding stops at the first padding character.
+/// \param content is the content of the tag
+/// \param vec will hold the decoded bytes
+static void decodeBase64Chunk(const string &content,vector<uint1> &vec)
+
+{
+  vec.reserve(content.size() / 4 * 3);
+  uint4 acc = 0;
+  int4 bits = 0;
+  for(string::const_iterator iter=content.begin();iter!=content.end();++iter) {
+    char c = *iter;
+    uint4 val;
+    if (c >= 'A' && c <= 'Z') val = c - 'A';
+    else if (c >= 'a' && c <= 'z') val = c - 'a' + 26;
+    else if (c >= '0' && c <= '9') val = c - '0' + 52;
+    else if (c == '+') val = 62;
+    else if (c == '/') val = 63;
+    else if (c == '=') break;
+    else if (c == ' ' || c == '\n' || c == '\r' || c == '\t') continue;
+    else
+      throw LowlevelError("Bad character in base64 bytechunk");
+    acc = (acc << 6) | val;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      vec.push_back((uint1)(acc >> bits));
+    }
+  }
+}
+
+/// \param el is the \<bytechunk> element
+/// \return \b true if the content of the element is base64 rather than hex
+static bool isBase64Chunk(const Element *el)
+
+{
+  for(int4 i=0;i<el->getNumAttributes();++i) {
+    if (el->getAttributeName(i) == "encoding") {
+      const string &enc( el->getAttributeValue(i) );
+      if (enc == "base64") return true;
+      if (enc != "hex")
+	throw LowlevelError("Unknown bytechunk encoding: " + enc);
+    }
+  }
+  return false;
+}
+
+/// Each \<bytechunk> directly inside a \<binaryimage> has its hex content replaced with the
+/// raw bytes as soon as it is parsed, and is marked with a \e packed attribute that
+/// LoadImageXml::open() recognizes.  At most one chunk is held as text at any time.
+/// \param el is the element that has just been parsed
+/// \return \b false, as the element stays in the tree
+bool BinaryImagePacker::consume(Element *el)
+
+{
+  if (el->getName() != "bytechunk") return false;
+  const Element *par = el->getParent();
+  if (par == (const Element *)0 || par->getName() != "binaryimage") return false;
+  for(int4 i=0;i<el->getNumAttributes();++i) {
+    if (el->getAttributeName(i) == "packed") return false;	// Already packed
+    if (el->getAttributeName(i) == "file") return false;	// Bytes are in a sidecar file
+  }
+  vector<uint1> vec;
+  if (isBase64Chunk(el))
+    decodeBase64Chunk(el->getContent(),vec);
+  else
+    decodeByteChunk(el->getContent(),vec);
+  el->setContent(string(vec.begin(),vec.end()));
+  el->addAttribute("packed","true");
+  return false;
+}
+
+/// The sidecar file is mapped the first time any chunk refers to it.  The range defaults to
+/// the whole file, or the rest of the file after \e fileoffset.
+/// \param el is the \<bytechunk> element with a \e file attribute
+/// \param chnk is the chunk to point at the range
+void LoadImageXml::mapChunk(const Element *el,Chunk &chnk)
+
+{
+  string name = el->getAttributeValue("file");
+  if (!FileManage::isAbsolutePath(name)) {
+    string dir,base;
+    FileManage::splitPath(filename,dir,base);
+    name = dir + name;
+  }
+  FileMapping *&mapping( sidecar[name] );
+  if (mapping == (FileMapping *)0) {
+    mapping = new FileMapping();
+    mapping->open(name);
+  }
+  uintb fileoffset = 0;
+  uintb length = 0;
+  bool haslength = false;
+  for(int4 i=0;i<el->getNumAttributes();++i) {
+    const string &attrname( el->getAttributeName(i) );
+    if (attrname != "fileoffset" && attrname != "length") continue;
+    istringstream s(el->getAttributeValue(i));
+    s.unsetf(ios::dec | ios::hex | ios::oct);
+    if (attrname == "fileoffset")
+      s >> fileoffset;
+    else {
+      s >> length;
+      haslength = true;
+    }
+  }
+  uintb filesize = mapping->getSize();
+  if (fileoffset > filesize)
+    throw LowlevelError("bytechunk starts past the end of " + name);
+  if (!haslength)
+    length = filesize - fileoffset;
+  else if (length > filesize - fileoffset)
+    throw LowlevelError("bytechunk runs past the end of " + name);
+  chnk.storage.clear();
+  chnk.mapdata = mapping->getBase() + fileoffset;
+  chnk.mapsize = length;
+}
+
 /// \param m is for looking up address space
 void LoadImageXml::open(const AddrSpaceManager *m)
 
@@ -92,39 +244,31 @@ void LoadImageXml::open(const AddrSpaceManager *m)
       if (base == (AddrSpace *)0)
 	throw LowlevelError("Unknown space name: "+subel->getAttributeValue("space"));
       Address addr(base,base->restoreXmlAttributes(subel,sz));
-      map<Address,vector<uint1> >::iterator chnkiter;
-      vector<uint1> &vec( chunk[addr] );
+      Chunk &chnk( chunk[addr] );
+      vector<uint1> &vec( chnk.storage );
       vec.clear();
+      chnk.mapdata = (const uint1 *)0;
+      bool packed = false;
+      bool hasfile = false;
       for(int4 i=0;i<subel->getNumAttributes();++i) {
-	if (subel->getAttributeName(i) == "readonly")
+	if (subel->getAttributeName(i) == "readonly") {
 	  if (xml_readbool(subel->getAttributeValue(i)))
 	    readonlyset.insert(addr);
+	}
+	else if (subel->getAttributeName(i) == "packed")
+	  packed = xml_readbool(subel->getAttributeValue(i));
+	else if (subel->getAttributeName(i) == "file")
+	  hasfile = true;
       }
-      istringstream is(subel->getContent());
-      int4 val;
-      char c1,c2;
-      is >> ws;
-      c1 = is.get();
-      c2 = is.get();
-      while((c1>0)&&(c2>0)) {
-	if (c1 <= '9')
-	  c1 = c1 - '0';
-	else if (c1 <= 'F')
-	  c1 = c1 + 10 - 'A';
-	else
-	  c1 = c1 + 10 - 'a';
-	if (c2 <= '9')
-	  c2 = c2 - '0';
-	else if (c2 <= 'F')
-	  c2 = c2 + 10 - 'A';
-	else
-	  c2 = c2 + 10 - 'a';
-	val = c1*16 + c2;
-	vec.push_back((uint1)val);
-	is >> ws;
-	c1 = is.get();
-	c2 = is.get();
-      }
+      const string &content(subel->getContent());
+      if (hasfile)
+	mapChunk(subel,chnk);
+      else if (packed)		// Already decoded by BinaryImagePacker
+	vec.assign(content.begin(),content.end());
+      else if (isBase64Chunk(subel))
+	decodeBase64Chunk(content,vec);
+      else
+	decodeByteChunk(content,vec);
     }
     else
       throw LowlevelError("Unknown LoadImageXml tag: "+subel->getName());
@@ -139,12 +283,16 @@ void LoadImageXml::clear(void)
   manage = (const AddrSpaceManager *)0;
   chunk.clear();
   addrtosymbol.clear();
+  map<string,FileMapping *>::iterator iter;
+  for(iter=sidecar.begin();iter!=sidecar.end();++iter)
+    delete (*iter).second;
+  sidecar.clear();
 }
 
 void LoadImageXml::pad(void)
 
 {
-  map<Address,vector<uint1> >::iterator iter,lastiter;
+  map<Address,Chunk>::iterator iter,lastiter;
 
   // Search for completely redundant chunks
   if (chunk.empty()) return;
@@ -184,7 +332,7 @@ void LoadImageXml::pad(void)
       if ((uintb)maxsize > room)
 	maxsize = (int4)room;
     }
-    vector<uint1> &vec( chunk[endaddr] );
+    vector<uint1> &vec( chunk[endaddr].storage );
     for(int4 i=0;i<maxsize;++i)
       vec.push_back(0);
   }
@@ -193,7 +341,7 @@ void LoadImageXml::pad(void)
 void LoadImageXml::loadFill(uint1 *ptr,int4 size,const Address &addr)
 
 {
-  map<Address,vector<uint1> >::const_iterator iter;
+  map<Address,Chunk>::const_iterator iter;
   Address curaddr;
   bool emptyhit = false;
   
@@ -202,22 +350,20 @@ void LoadImageXml::loadFill(uint1 *ptr,int4 size,const Address &addr)
   if (iter != chunk.begin())
     --iter;			// Last one less or equal
   while((size>0)&&(iter!=chunk.end())) {
-    const vector<uint1> &chnk((*iter).second);
-    int4 chnksize = chnk.size();
-    int4 over = curaddr.overlap(0,(*iter).first,chnksize);
-    if (over!=-1) {
-      if (chnksize-over > size)
-	chnksize = over+size;
-      for(int4 i=over;i<chnksize;++i)
-	*ptr++ = chnk[i];
-      size -= (chnksize-over);
-      curaddr = curaddr + (chnksize-over);
-      ++iter;
-    }
-    else {
+    const Chunk &chnk((*iter).second);
+    const Address &start((*iter).first);
+    uintb over = curaddr.getOffset() - start.getOffset();
+    if ((curaddr.getSpace() != start.getSpace())||(curaddr.getOffset() < start.getOffset())||(over >= chnk.size())) {
       emptyhit = true;
       break;
     }
+    uintb avail = chnk.size() - over;
+    int4 cnt = (avail > (uintb)size) ? size : (int4)avail;
+    memcpy(ptr,chnk.data() + over,cnt);
+    ptr += cnt;
+    size -= cnt;
+    curaddr = curaddr + cnt;
+    ++iter;
   }
   if ((size>0)||emptyhit) {
     ostringstream errmsg;
@@ -228,6 +374,23 @@ void LoadImageXml::loadFill(uint1 *ptr,int4 size,const Address &addr)
   }
 }
 
+/// A pointer is returned only if the whole range lies within one chunk.
+const uint1 *LoadImageXml::peek(int4 size,const Address &addr)
+
+{
+  map<Address,Chunk>::const_iterator iter = chunk.upper_bound(addr);
+  if (iter == chunk.begin())
+    return (const uint1 *)0;
+  --iter;			// Last one less or equal
+  const Address &start((*iter).first);
+  const Chunk &chnk((*iter).second);
+  if (addr.getSpace() != start.getSpace()) return (const uint1 *)0;
+  uintb over = addr.getOffset() - start.getOffset();
+  if (over >= chnk.size() || (uintb)size > chnk.size() - over)
+    return (const uint1 *)0;
+  return chnk.data() + over;
+}
+
 void LoadImageXml::openSymbols(void) const
 
 {
@@ -247,12 +410,12 @@ bool LoadImageXml::getNextSymbol(LoadImageFunc &record) const
 void LoadImageXml::getReadonly(RangeList &list) const
 
 {
-  map<Address,vector<uint1> >::const_iterator iter;
+  map<Address,Chunk>::const_iterator iter;
 
   // List all the readonly chunks
   for(iter=chunk.begin();iter!=chunk.end();++iter) {
     if (readonlyset.find((*iter).first) != readonlyset.end()) {
-      const vector<uint1> &chnk((*iter).second);
+      const Chunk &chnk((*iter).second);
       uintb start = (*iter).first.getOffset();
       uintb stop = start + chnk.size() - 1;
       list.insertRange((*iter).first.getSpace(),start,stop);
@@ -263,19 +426,21 @@ void LoadImageXml::getReadonly(RangeList &list) const
 void LoadImageXml::adjustVma(long adjust)
 
 {
-  map<Address,vector<uint1> >::iterator iter1;
+  map<Address,Chunk>::iterator iter1;
   map<Address,string>::iterator iter2;
 
-  map<Address,vector<uint1> > newchunk;
+  map<Address,Chunk> newchunk;
   map<Address,string> newsymbol;
 
   for(iter1=chunk.begin();iter1!=chunk.end();++iter1) {
     AddrSpace *spc = (*iter1).first.getSpace();
     int4 off = AddrSpace::addressToByte(adjust,spc->getWordSize());
     Address newaddr = (*iter1).first + off;
-    newchunk[newaddr] = (*iter1).second;
+    newchunk[newaddr].storage.swap((*iter1).second.storage);
+    newchunk[newaddr].mapdata = (*iter1).second.mapdata;
+    newchunk[newaddr].mapsize = (*iter1).second.mapsize;
   }
-  chunk = newchunk;
+  chunk.swap(newchunk);
   for(iter2=addrtosymbol.begin();iter2!=addrtosymbol.end();++iter2) {
     AddrSpace *spc = (*iter2).first.getSpace();
     int4 off = AddrSpace::addressToByte(adjust,spc->getWordSize());
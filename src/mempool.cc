@@ -0,0 +1,124 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "mempool.hh"
+
+#include <cstring>
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#endif
+
+namespace GhidraDec {
+
+thread_local SlabArena::Region SlabArena::local;
+std::atomic<int4> SlabArena::mode(SlabArena::heap);
+std::atomic<uint8> SlabArena::numregions(0);
+std::atomic<uint8> SlabArena::numhuge(0);
+
+static const char *backingNames[] = { "heap", "region", "transparent", "hugetlb" };
+
+/// \param nm is the name of the backing
+/// \param res is set to the backing with that name
+/// \return \b false if there is no backing with that name
+bool SlabArena::parseBacking(const char *nm,backing &res)
+
+{
+  for(int4 i=0;i<4;++i) {
+    if (strcmp(nm,backingNames[i]) == 0) {
+      res = (backing)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+/// \param b is the backing
+/// \return the name used by parseBacking()
+const char *SlabArena::getBackingName(backing b)
+
+{
+  return backingNames[b];
+}
+
+/// The region is aligned to the huge page size.  If it can't be mapped at all, a null pointer
+/// is returned.
+/// \param size is the number of bytes to map, a multiple of the region size
+/// \param how is the backing of the region
+/// \return the start of the region, or null
+uint1 *SlabArena::mapRegion(size_t size,int4 how)
+
+{
+#ifdef _WINDOWS
+  return (uint1 *)0;
+#else
+#ifdef MAP_HUGETLB
+  if (how == hugetlb) {
+    void *map = mmap((void *)0,size,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB,-1,0);
+    if (map != MAP_FAILED) {
+      numregions.fetch_add(1,std::memory_order_relaxed);
+      numhuge.fetch_add(1,std::memory_order_relaxed);
+      return (uint1 *)map;
+    }
+    how = transparent;		// The pool is exhausted or not configured
+  }
+#endif
+  // Over-map by one region, then trim, so the region starts on a huge page boundary
+  void *map = mmap((void *)0,size + regionsize,PROT_READ|PROT_WRITE,MAP_PRIVATE|MAP_ANONYMOUS,-1,0);
+  if (map == MAP_FAILED)
+    return (uint1 *)0;
+  uintp raw = (uintp)map;
+  uintp start = (raw + regionsize - 1) & ~((uintp)(regionsize - 1));
+  if (start != raw)
+    munmap(map,start - raw);
+  if (start + size != raw + size + regionsize)
+    munmap((void *)(start + size),raw + regionsize - start);
+#ifdef MADV_HUGEPAGE
+  if (how == transparent)
+    madvise((void *)start,size,MADV_HUGEPAGE);
+#endif
+  numregions.fetch_add(1,std::memory_order_relaxed);
+  return (uint1 *)start;
+#endif
+}
+
+/// With the \e heap backing the slab is taken from the global heap.  Otherwise it is carved
+/// from the current region of the calling thread, mapping a new region when it runs out.
+/// \param size is the number of bytes needed
+/// \return the slab, starting on a cache line
+void *SlabArena::allocate(size_t size)
+
+{
+  size = (size + cacheline - 1) & ~(cacheline - 1);
+  int4 how = mode.load(std::memory_order_relaxed);
+  if (how != heap) {
+    if ((size_t)(local.end - local.cur) < size) {
+      size_t mapsize = (size + regionsize - 1) & ~(regionsize - 1);
+      uint1 *start = mapRegion(mapsize,how);
+      if (start != (uint1 *)0) {
+	local.cur = start;
+	local.end = start + mapsize;
+      }
+    }
+    if ((size_t)(local.end - local.cur) >= size) {
+      void *res = local.cur;
+      local.cur += size;
+      return res;
+    }
+  }
+  uintp raw = (uintp)::operator new(size + cacheline - 1);
+  return (void *)((raw + cacheline - 1) & ~((uintp)(cacheline - 1)));
+}
+
+} // namespace GhidraDec
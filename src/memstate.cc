@@ -357,6 +357,16 @@ void MemoryBank::getChunk(uintb offset,int4 size,uint1 *res) const
   }
 }
 
+/// The copy starts with the same contents as \b this bank, and afterward the two banks can be
+/// written independently.  Derived classes that support MemoryState::snapshot() override this; by
+/// default an exception is thrown.
+/// \return the new memory bank
+MemoryBank *MemoryBank::snapshot(void)
+
+{
+  throw LowlevelError("Memory bank for space " + space->getName() + " does not support snapshots");
+}
+
 /// Find an aligned word from the bank.  First an attempt is made to fetch the data from the
 /// LoadImage.  If this fails, the value is returned as 0.
 /// \param addr is the address of the word to fetch
@@ -366,6 +376,8 @@ uintb MemoryImage::find(uintb addr) const
 { // Assume that -addr- is word aligned
   uintb res = 0;		// Make sure all bytes start as 0, as load may not fill all bytes
   AddrSpace *spc = getSpace();
+  if (loader->isHole(getWordSize(),Address(spc,addr)))
+    return 0;
   try {
     uint1 *ptr = (uint1 *)&res;
     ptr += (HOST_ENDIAN==1) ? (sizeof(uintb) - getWordSize()) : 0;
@@ -380,13 +392,17 @@ uintb MemoryImage::find(uintb addr) const
 }
 
 /// Retrieve an aligned page from the bank.  First an attempt is made to retrieve the
-/// page from the LoadImage, which may do its own zero filling.  If the attempt fails, the
-/// page is entirely filled in with zeros.
+/// page from the LoadImage, which may do its own zero filling.  If the page is a known hole
+/// in the LoadImage, or the attempt fails, the page is entirely filled in with zeros.
 void MemoryImage::getPage(uintb addr,uint1 *res,int4 skip,int4 size) const
 
 {  // Assume that -addr- is page aligned
   AddrSpace *spc = getSpace();
 
+  if (loader->isHole(size,Address(spc,addr+skip))) {
+    memset(res,0,size);
+    return;
+  }
   try {
     loader->loadFill(res,size,Address(spc,addr+skip));
   }
@@ -409,6 +425,14 @@ MemoryImage::MemoryImage(AddrSpace *spc,int4 ws,int4 ps,LoadImage *ld)
   loader = ld;
 }
 
+/// The bank can't be written, so the snapshot just reads from the same LoadImage.
+/// \return the new memory bank
+MemoryBank *MemoryImage::snapshot(void)
+
+{
+  return new MemoryImage(getSpace(),getWordSize(),getPageSize(),loader);
+}
+
 /// This derived method looks for a previously cached page of the underlying memory bank.
 /// If the cached page does not exist, it creates it and fills in its initial value by
 /// retrieving the page from the underlying bank.  The new value is then written into
@@ -419,16 +443,9 @@ void MemoryPageOverlay::insert(uintb addr,uintb val)
 
 {
   uintb pageaddr = addr & ~((uintb)(getPageSize()-1));
-  map<uintb,uint1 *>::iterator iter;
-
-  uint1 *pageptr;
-
-  iter = page.find(pageaddr);
-  if (iter != page.end())
-    pageptr = (*iter).second;
-  else {
-    pageptr = new uint1[getPageSize()];
-    page[pageaddr] = pageptr;
+  bool fresh;
+  uint1 *pageptr = writePage(pageaddr,fresh);
+  if (fresh) {
     if (underlie == (MemoryBank *)0) {
       for(int4 i=0;i<getPageSize();++i)
 	pageptr[i] = 0;
@@ -450,17 +467,13 @@ uintb MemoryPageOverlay::find(uintb addr) const
 
 {
   uintb pageaddr = addr & ~((uintb)(getPageSize()-1));
-  map<uintb,uint1 *>::const_iterator iter;
-
-  iter = page.find(pageaddr);
-  if (iter == page.end()) {
+  const uint1 *pageptr = findPage(pageaddr);
+  if (pageptr == (const uint1 *)0) {
     if (underlie == (MemoryBank *)0)
       return (uintb)0;
     return underlie->find(addr);
   }
 
-  const uint1 *pageptr = (*iter).second;
-
   uintb pageoffset = addr & ((uintb)(getPageSize()-1));
   return constructValue(pageptr+pageoffset,getWordSize(),getSpace()->isBigEndian());
 }
@@ -475,10 +488,8 @@ uintb MemoryPageOverlay::find(uintb addr) const
 void MemoryPageOverlay::getPage(uintb addr,uint1 *res,int4 skip,int4 size) const
 
 {
-  map<uintb,uint1 *>::const_iterator iter;
-
-  iter = page.find(addr);
-  if (iter == page.end()) {
+  const uint1 *pageptr = findPage(addr);
+  if (pageptr == (const uint1 *)0) {
     if (underlie == (MemoryBank *)0) {
       for(int4 i=0;i<size;++i)
 	res[i] = 0;
@@ -487,7 +498,6 @@ void MemoryPageOverlay::getPage(uintb addr,uint1 *res,int4 skip,int4 size) const
     underlie->getPage(addr,res,skip,size);
     return;
   }
-  const uint1 *pageptr = (*iter).second;
   memcpy(res,pageptr+skip,size);
 }
 
@@ -501,13 +511,9 @@ void MemoryPageOverlay::getPage(uintb addr,uint1 *res,int4 skip,int4 size) const
 void MemoryPageOverlay::setPage(uintb addr,const uint1 *val,int4 skip,int4 size)
 
 {
-  map<uintb,uint1 *>::iterator iter;
-  uint1 *pageptr;
-
-  iter = page.find(addr);
-  if (iter == page.end()) {
-    pageptr = new uint1[getPageSize()];
-    page[addr] = pageptr;
+  bool fresh;
+  uint1 *pageptr = writePage(addr,fresh);
+  if (fresh) {
     if (size != getPageSize()) {
       if (underlie == (MemoryBank *)0) {
 	for(int4 i=0;i<getPageSize();++i)
@@ -517,8 +523,6 @@ void MemoryPageOverlay::setPage(uintb addr,const uint1 *val,int4 skip,int4 size)
 	underlie->getPage(addr,pageptr,0,getPageSize());
     }
   }
-  else
-    pageptr = (*iter).second;
 
   memcpy(pageptr+skip,val,size);
 }
@@ -529,19 +533,236 @@ void MemoryPageOverlay::setPage(uintb addr,const uint1 *val,int4 skip,int4 size)
 /// \param ws is the number of bytes in the preferred wordsize (must be power of 2)
 /// \param ps is the number of bytes in a page (must be power of 2)
 /// \param ul is the underlying MemoryBank
-MemoryPageOverlay::MemoryPageOverlay(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul)
+/// \param tp is the kind of table to use for locating pages
+MemoryPageOverlay::MemoryPageOverlay(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul,int4 tp)
   : MemoryBank(spc,ws,ps)
 {
   underlie = ul;
+  root = (Node *)0;
+  lastvalid = false;
+  lastwritable = false;
+  lastaddr = 0;
+  lastpage = (uint1 *)0;
+  pageshift = 0;
+  while((1 << pageshift) < ps)
+    pageshift += 1;
+  uintb highest = AddrSpace::addressToByte(spc->getHighest(),spc->getWordSize());
+  uintb numpages = (highest >> pageshift) + 1;	// Wraps to 0 if every offset is a page
+  if (tp == table_direct && (numpages == 0 || numpages > directlimit))
+    tp = table_radix;
+  tabletype = tp;
+  rootsize = (tp == table_direct) ? (int4)numpages : (1<<radixbits);
+  int4 bits = 0;			// Number of bits in a page number
+  while(bits < 8*sizeof(uintb) - pageshift && (highest >> (pageshift + bits)) != 0)
+    bits += 1;
+  levels = (bits + radixbits - 1) / radixbits;
+  if (levels == 0)
+    levels = 1;
 }
 
 MemoryPageOverlay::~MemoryPageOverlay(void)
 
 {
-  map<uintb,uint1 *>::iterator iter;
+  map<uintb,Page *>::iterator iter;
+
+  for(iter=page.begin();iter!=page.end();++iter)
+    releasePage((*iter).second);
+  if (root != (Node *)0)
+    releaseNode(root,(tabletype == table_direct) ? 1 : levels);
+}
+
+/// \return the new page, with a single reference
+MemoryPageOverlay::Page *MemoryPageOverlay::newPage(void) const
+
+{
+  Page *pg = new Page;
+  pg->refs = 1;
+  pg->data = new uint1[getPageSize()];
+  return pg;
+}
+
+/// \param size is the number of slots in the node
+/// \return the new node, with a single reference
+MemoryPageOverlay::Node *MemoryPageOverlay::newNode(int4 size) const
+
+{
+  Node *node = new Node;
+  node->refs = 1;
+  node->slot.resize(size,(Shared *)0);
+  return node;
+}
+
+/// The copy refers to the same children, and the original loses one reference.
+/// \param node is the shared node
+/// \return the copy, with a single reference
+MemoryPageOverlay::Node *MemoryPageOverlay::copyNode(Node *node) const
+
+{
+  Node *res = new Node;
+  res->refs = 1;
+  res->slot = node->slot;
+  for(int4 i=0;i<res->slot.size();++i) {
+    if (res->slot[i] != (Shared *)0)
+      res->slot[i]->refs += 1;
+  }
+  node->refs -= 1;
+  return res;
+}
+
+/// \param pg is the page, which is freed if this was its last reference
+void MemoryPageOverlay::releasePage(Page *pg)
+
+{
+  pg->refs -= 1;
+  if (pg->refs > 0) return;
+  delete [] pg->data;
+  delete pg;
+}
+
+/// \param node is the node, which is freed (along with any children it held the last reference to)
+/// \param depth is the number of levels from \b node down to the pages (1 if its slots are pages)
+void MemoryPageOverlay::releaseNode(Node *node,int4 depth)
+
+{
+  node->refs -= 1;
+  if (node->refs > 0) return;
+  for(int4 i=0;i<node->slot.size();++i) {
+    Shared *child = node->slot[i];
+    if (child == (Shared *)0) continue;
+    if (depth > 1)
+      releaseNode((Node *)child,depth-1);
+    else
+      releasePage((Page *)child);
+  }
+  delete node;
+}
+
+/// \param pageaddr is the aligned address of the page
+/// \return the bytes of the page, or \b null if it hasn't been created
+uint1 *MemoryPageOverlay::findPage(uintb pageaddr) const
 
+{
+  if (lastvalid && lastaddr == pageaddr)
+    return lastpage;
+  Page *res = (Page *)0;
+  if (tabletype == table_map) {
+    map<uintb,Page *>::const_iterator iter = page.find(pageaddr);
+    if (iter != page.end())
+      res = (*iter).second;
+  }
+  else if (root != (Node *)0) {
+    uintb pagenum = pageaddr >> pageshift;
+    if (tabletype == table_direct)
+      res = (Page *)root->slot[pagenum];
+    else {
+      const Node *node = root;
+      for(int4 i=levels-1;i>0 && node != (const Node *)0;--i)
+	node = (const Node *)node->slot[(pagenum >> (i*radixbits)) & ((1<<radixbits)-1)];
+      if (node != (const Node *)0)
+	res = (Page *)node->slot[pagenum & ((1<<radixbits)-1)];
+    }
+  }
+  lastvalid = true;
+  lastwritable = false;
+  lastaddr = pageaddr;
+  lastpage = (res != (Page *)0) ? res->data : (uint1 *)0;
+  return lastpage;
+}
+
+/// Any node or page on the way to the page that is shared with a snapshot is copied first.
+/// A page that doesn't exist yet is created, but its contents are left for the caller to fill in.
+/// \param pageaddr is the aligned address of the page
+/// \param fresh is set to \b true if the page was created, \b false if it already existed
+/// \return the bytes of the page
+uint1 *MemoryPageOverlay::writePage(uintb pageaddr,bool &fresh)
+
+{
+  fresh = false;
+  if (lastvalid && lastwritable && lastaddr == pageaddr)
+    return lastpage;
+  Page *pg;
+  if (tabletype == table_map) {
+    Page *&ref( page[pageaddr] );
+    if (ref == (Page *)0) {
+      ref = newPage();
+      fresh = true;
+    }
+    else if (ref->refs > 1) {
+      Page *cp = newPage();
+      memcpy(cp->data,ref->data,getPageSize());
+      releasePage(ref);
+      ref = cp;
+    }
+    pg = ref;
+  }
+  else {
+    uintb pagenum = pageaddr >> pageshift;
+    if (root == (Node *)0)
+      root = newNode(rootsize);
+    else if (root->refs > 1)
+      root = copyNode(root);
+    Node *node = root;
+    if (tabletype == table_radix) {
+      for(int4 i=levels-1;i>0;--i) {
+	Shared *&child( node->slot[(pagenum >> (i*radixbits)) & ((1<<radixbits)-1)] );
+	if (child == (Shared *)0)
+	  child = newNode(1<<radixbits);
+	else if (child->refs > 1)
+	  child = copyNode((Node *)child);
+	node = (Node *)child;
+      }
+      pagenum &= (1<<radixbits)-1;
+    }
+    Shared *&ref( node->slot[pagenum] );
+    if (ref == (Shared *)0) {
+      ref = newPage();
+      fresh = true;
+    }
+    else if (ref->refs > 1) {
+      Page *cp = newPage();
+      memcpy(cp->data,((Page *)ref)->data,getPageSize());
+      releasePage((Page *)ref);
+      ref = cp;
+    }
+    pg = (Page *)ref;
+  }
+  lastvalid = true;
+  lastwritable = true;
+  lastaddr = pageaddr;
+  lastpage = pg->data;
+  return lastpage;
+}
+
+/// The snapshot shares every page and table node with \b this bank, and both banks copy anything
+/// shared before writing to it.  The underlying bank is shared as well and must not be modified
+/// while either bank is in use.
+/// \return the new page overlay
+MemoryBank *MemoryPageOverlay::snapshot(void)
+
+{
+  MemoryPageOverlay *res = new MemoryPageOverlay(getSpace(),getWordSize(),getPageSize(),underlie,tabletype);
+  res->page = page;
+  map<uintb,Page *>::iterator iter;
   for(iter=page.begin();iter!=page.end();++iter)
-    delete [] (*iter).second;
+    (*iter).second->refs += 1;
+  if (root != (Node *)0) {
+    res->root = root;
+    root->refs += 1;
+  }
+  lastwritable = false;		// Now shared, so the next write must copy
+  return res;
+}
+
+/// The hashtable is copied in full, so this bank is best suited to small spaces such as registers
+/// and temporaries.  The underlying bank is shared, and must not be modified while either bank is in use.
+/// \return the new memory bank
+MemoryBank *MemoryHashOverlay::snapshot(void)
+
+{
+  MemoryHashOverlay *res = new MemoryHashOverlay(getSpace(),getWordSize(),getPageSize(),0,underlie);
+  res->address = address;
+  res->value = value;
+  return res;
 }
 
 /// Write the value into the hashtable, using \b addr as a key.
@@ -612,6 +833,89 @@ MemoryHashOverlay::MemoryHashOverlay(AddrSpace *spc,int4 ws,int4 ps,int4 hashsiz
   }
 }
 
+/// The bytes covering the given range are allocated and set to zero.  The size is rounded up
+/// to a whole number of words.
+/// \param spc is the address space associated with the memory bank
+/// \param ws is the number of bytes in the preferred wordsize (must be power of 2)
+/// \param ps is the number of bytes in a page (must be power of 2)
+/// \param sz is the number of bytes covered by the bank, starting at offset 0
+MemoryArrayBank::MemoryArrayBank(AddrSpace *spc,int4 ws,int4 ps,uintb sz)
+  : MemoryBank(spc,ws,ps)
+{
+  size = (sz + ws - 1) & ~((uintb)(ws-1));
+  if (size == 0)
+    size = ws;
+  data = new uint1[size];
+  memset(data,0,size);
+}
+
+/// \param off is the offset of the first byte of the range
+/// \param sz is the number of bytes in the range
+/// \return a pointer to the first byte of the range in the array
+uint1 *MemoryArrayBank::getPointer(uintb off,int4 sz)
+
+{
+  if (off >= size || size - off < sz) {
+    ostringstream s;
+    s << "Access outside of array memory bank: " << getSpace()->getName() << " offset 0x" << hex << off;
+    throw LowlevelError(s.str());
+  }
+  return data + off;
+}
+
+/// \param addr is the aligned address of the word to be written
+/// \param val is the value to be written at that word
+void MemoryArrayBank::insert(uintb addr,uintb val)
+
+{
+  deconstructValue(getPointer(addr,getWordSize()),val,getWordSize(),getSpace()->isBigEndian());
+}
+
+/// \param addr is the aligned offset of the word
+/// \return the retrieved value
+uintb MemoryArrayBank::find(uintb addr) const
+
+{
+  return constructValue(((MemoryArrayBank *)this)->getPointer(addr,getWordSize()),getWordSize(),getSpace()->isBigEndian());
+}
+
+/// \param addr is the aligned offset of the page
+/// \param res is a pointer to where the retrieved bytes should be stored
+/// \param skip is the offset into the page at which to start reading
+/// \param sz is the number of bytes to read
+void MemoryArrayBank::getPage(uintb addr,uint1 *res,int4 skip,int4 sz) const
+
+{
+  memcpy(res,((MemoryArrayBank *)this)->getPointer(addr+skip,sz),sz);
+}
+
+/// \param addr is the aligned offset of the page
+/// \param val is a pointer to the bytes to be written
+/// \param skip is the offset into the page at which to start writing
+/// \param sz is the number of bytes to write
+void MemoryArrayBank::setPage(uintb addr,const uint1 *val,int4 skip,int4 sz)
+
+{
+  memcpy(getPointer(addr+skip,sz),val,sz);
+}
+
+/// The array is copied in full.
+/// \return the new memory bank
+MemoryBank *MemoryArrayBank::snapshot(void)
+
+{
+  MemoryArrayBank *res = new MemoryArrayBank(getSpace(),getWordSize(),getPageSize(),size);
+  memcpy(res->data,data,size);
+  return res;
+}
+
+MemoryState::~MemoryState(void)
+
+{
+  for(int4 i=0;i<owned.size();++i)
+    delete owned[i];
+}
+
 /// MemoryBanks associated with specific address spaces must be registers with this MemoryState
 /// via this method.  Each address space that will be used during emulation must be registered
 /// separately.  The MemoryState object does \e not assume responsibility for freeing the MemoryBank
@@ -628,6 +932,71 @@ void MemoryState::setMemoryBank(MemoryBank *bank)
   memspace[index] = bank;
 }
 
+/// The new bank uses the kind of page table this MemoryState was constructed with, is registered for
+/// its address space, and is freed along with this MemoryState.
+/// \param spc is the address space associated with the memory bank
+/// \param ws is the number of bytes in the preferred wordsize (must be power of 2)
+/// \param ps is the number of bytes in a page (must be power of 2)
+/// \param ul is the underlying MemoryBank (may be null)
+/// \return the new page overlay
+MemoryPageOverlay *MemoryState::createPageOverlay(AddrSpace *spc,int4 ws,int4 ps,MemoryBank *ul)
+
+{
+  MemoryPageOverlay *bank = new MemoryPageOverlay(spc,ws,ps,ul,pagetable);
+  owned.push_back(bank);
+  setMemoryBank(bank);
+  return bank;
+}
+
+/// The bank is sized to cover every register in the given space known to the Translate object,
+/// so that RegisterHandle objects for them point directly into the array.  It is registered
+/// for the space, and is freed along with this MemoryState.
+/// \param spc is the register space
+/// \param ws is the number of bytes in the preferred wordsize (must be power of 2)
+/// \param ps is the number of bytes in a page (must be power of 2)
+/// \return the new array bank
+MemoryArrayBank *MemoryState::createRegisterBank(AddrSpace *spc,int4 ws,int4 ps)
+
+{
+  map<VarnodeData,string> reglist;
+  trans->getAllRegisters(reglist);
+  uintb sz = 0;
+  map<VarnodeData,string>::const_iterator iter;
+  for(iter=reglist.begin();iter!=reglist.end();++iter) {
+    const VarnodeData &vdata((*iter).first);
+    if (vdata.space != spc) continue;
+    if (vdata.offset + vdata.size > sz)
+      sz = vdata.offset + vdata.size;
+  }
+  MemoryArrayBank *bank = new MemoryArrayBank(spc,ws,ps,sz);
+  owned.push_back(bank);
+  setMemoryBank(bank);
+  return bank;
+}
+
+/// Every memory bank registered with \b this state is replaced in the new state by its
+/// MemoryBank::snapshot().  The new state owns these banks.  Page overlays share their pages with
+/// \b this state until one side writes to them, so a snapshot is cheap to take, and emulation can
+/// continue from the same point along different paths, with one state each.
+/// \return the new state
+MemoryState *MemoryState::snapshot(void)
+
+{
+  MemoryState *res = new MemoryState(trans,pagetable);
+  try {
+    for(int4 i=0;i<memspace.size();++i) {
+      if (memspace[i] == (MemoryBank *)0) continue;
+      MemoryBank *bank = memspace[i]->snapshot();
+      res->owned.push_back(bank);
+      res->setMemoryBank(bank);
+    }
+  } catch(LowlevelError &err) {
+    delete res;
+    throw;
+  }
+  return res;
+}
+
 /// Any MemoryBank that has been registered with this MemoryState can be retrieved via this
 /// method if the MemoryBank's associated address space is known.
 /// \param spc is the address space of the desired MemoryBank
@@ -700,6 +1069,29 @@ uintb MemoryState::getValue(const string &nm) const
   return getValue(vdata.space,vdata.offset,vdata.size);
 }
 
+/// The storage of the register is looked up once, along with the memory bank holding it, so that
+/// hot registers (like the program counter and stack pointer) can be read and written through
+/// the handle with no name or bank lookup.  If the bank is a MemoryArrayBank, the handle points
+/// directly at the register's bytes.
+/// \param nm is the name of the register
+/// \return the handle to the register
+RegisterHandle MemoryState::getRegisterHandle(const string &nm) const
+
+{
+  const VarnodeData &vdata( trans->getRegister(nm) );
+  RegisterHandle res;
+  res.bank = getMemoryBank(vdata.space);
+  if (res.bank == (MemoryBank *)0)
+    throw LowlevelError("Register in unmapped memory space: "+nm);
+  res.offset = vdata.offset;
+  res.size = vdata.size;
+  res.bigendian = vdata.space->isBigEndian();
+  MemoryArrayBank *array = dynamic_cast<MemoryArrayBank *>(res.bank);
+  if (array != (MemoryArrayBank *)0)
+    res.ptr = array->getPointer(vdata.offset,vdata.size);
+  return res;
+}
+
 /// This is the main interface for reading a range of bytes from the MemorySate.
 /// The MemoryBank associated with the address space of the query is looked up
 /// and the request is forwarded to the getChunk method on the MemoryBank. If there
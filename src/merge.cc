@@ -15,6 +15,7 @@
  */
 #include "merge.hh"
 #include "funcdata.hh"
+#include "tracespan.hh"
 
 namespace GhidraDec {
 /// This instance assumes the identity of the given Varnode and the defining index is
@@ -252,8 +253,10 @@ void Merge::mergeRangeMust(VarnodeLocSet::const_iterator startiter,VarnodeLocSet
 void Merge::mergeOpcode(OpCode opc)
 
 {
+  static const int4 traceid = TraceLog::registerKind("mergeOpcode","merge");
+  TraceSpan span(traceid);
   BlockBasic *bl;
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter;
   PcodeOp *op;
   Varnode *vn1,*vn2;
   const BlockGraph &bblocks(data.getBasicBlocks());
@@ -285,6 +288,8 @@ void Merge::mergeOpcode(OpCode opc)
 void Merge::mergeByDatatype(VarnodeLocSet::const_iterator startiter,VarnodeLocSet::const_iterator enditer)
 
 {
+  static const int4 traceid = TraceLog::registerKind("mergeByDatatype","merge");
+  TraceSpan span(traceid);
   vector<HighVariable *> highvec;
   list<HighVariable *> highlist;
 
@@ -390,8 +395,8 @@ void Merge::eliminateIntersect(Varnode *vn,const vector<BlockVarnode> &blocksort
 
 {
   list<PcodeOp *> markedop;
-  list<PcodeOp *>::const_iterator oiter;
-  map<int4,CoverBlock>::const_iterator iter,enditer;
+  DescendList::const_iterator oiter;
+  Cover::const_iterator iter,enditer;
   Varnode *vn2;
   int4 boundtype;
   bool insertop;
@@ -495,6 +500,8 @@ void Merge::unifyAddress(VarnodeLocSet::const_iterator startiter,VarnodeLocSet::
 void Merge::mergeAddrTied(void)
 
 {
+  static const int4 traceid = TraceLog::registerKind("mergeAddrTied","merge");
+  TraceSpan span(traceid);
   bool addrtied;
   VarnodeLocSet::const_iterator startiter,enditer,iter;
   for(startiter=data.beginLoc();startiter!=data.endLoc();) {
@@ -668,7 +675,7 @@ bool Merge::collectCorrectable(const vector<Varnode *> &vlist,list<PcodeOp *> &o
 {
   int4 blk = op->getParent()->getIndex();
   vector<Varnode *>::const_iterator viter;
-  list<PcodeOp *>::const_iterator oiter;
+  DescendList::const_iterator oiter;
   Varnode *vn;
   PcodeOp *edgeop;
   int4 slot,bound;
@@ -786,6 +793,8 @@ void Merge::mergeIndirect(PcodeOp *indop)
 void Merge::mergeMarker(void)
 
 {
+  static const int4 traceid = TraceLog::registerKind("mergeMarker","merge");
+  TraceSpan span(traceid);
   PcodeOp *op;
   list<PcodeOp *>::const_iterator iter;
   for(iter=data.beginOpAlive();iter!=data.endOpAlive();++iter) {
@@ -806,6 +815,8 @@ void Merge::mergeMarker(void)
 void Merge::mergeAdjacent(void)
 
 {
+  static const int4 traceid = TraceLog::registerKind("mergeAdjacent","merge");
+  TraceSpan span(traceid);
   list<PcodeOp *>::const_iterator oiter;
   PcodeOp *op;
   int4 i;
@@ -920,9 +931,9 @@ bool Merge::merge(HighVariable *high1,HighVariable *high2,bool isspeculative)
 				// Translate any tests for high2 into tests for high1
   vector<HighVariable *> yesinter;		// Highs that high2 intersects
   vector<HighVariable *> nointer;		// Highs that high2 does not intersect
-  map<HighEdge,bool>::iterator iterfirst = highedgemap.lower_bound( HighEdge(high2,(HighVariable *)0) );
-  map<HighEdge,bool>::iterator iterlast = highedgemap.lower_bound( HighEdge(high2,(HighVariable *)~((uintp)0)) );
-  map<HighEdge,bool>::iterator iter;
+  HighEdgeMap::iterator iterfirst = highedgemap.lower_bound( HighEdge(high2,(HighVariable *)0) );
+  HighEdgeMap::iterator iterlast = highedgemap.lower_bound( HighEdge(high2,(HighVariable *)~((uintp)0)) );
+  HighEdgeMap::iterator iter;
 
   for(iter=iterfirst;iter!=iterlast;++iter) {
     HighVariable *b = (*iter).first.b; 
@@ -993,12 +1004,12 @@ bool Merge::updateHigh(HighVariable *a)
 void Merge::purgeHigh(HighVariable *high)
 
 {
-  map<HighEdge,bool>::iterator iterfirst = highedgemap.lower_bound( HighEdge(high,(HighVariable *)0) );
-  map<HighEdge,bool>::iterator iterlast = highedgemap.lower_bound( HighEdge(high,(HighVariable *)~((uintp)0)) );
+  HighEdgeMap::iterator iterfirst = highedgemap.lower_bound( HighEdge(high,(HighVariable *)0) );
+  HighEdgeMap::iterator iterlast = highedgemap.lower_bound( HighEdge(high,(HighVariable *)~((uintp)0)) );
 
   if (iterfirst == iterlast) return;
   --iterlast;			// Move back 1 to prevent deleting under the iterator
-  map<HighEdge,bool>::iterator iter;
+  HighEdgeMap::iterator iter;
   for(iter=iterfirst;iter!=iterlast;++iter)
     highedgemap.erase( HighEdge( (*iter).first.b, (*iter).first.a) );
   highedgemap.erase( HighEdge( (*iter).first.b, (*iter).first.a) );
@@ -1011,7 +1022,9 @@ void Merge::purgeHigh(HighVariable *high)
 ///
 /// If the Covers of the two variables intersect, this routine returns \b true. To avoid
 /// expensive computation on the Cover objects themselves, the test result associated with
-/// the pair of HighVariables is cached.
+/// the pair of HighVariables is cached.  Pairs whose Covers do not overlap on any block are
+/// rejected by the Cover bitsets more cheaply than the cache could be consulted, so
+/// no entry is made for them, and the cache holds only pairs that genuinely had to be tested.
 /// \param a is the first HighVariable
 /// \param b is the second HighVariable
 /// \return \b true if the variables intersect
@@ -1019,10 +1032,11 @@ bool Merge::intersection(HighVariable *a,HighVariable *b)
   
 {
   if (a==b) return false;
+  AnalysisMetrics::count(AnalysisMetrics::merge_test);
   bool ares = updateHigh(a);
   bool bres = updateHigh(b);
   if (ares && bres) {		// If neither high was dirty
-    map<HighEdge,bool>::iterator iter = highedgemap.find( HighEdge(a,b) );
+    HighEdgeMap::iterator iter = highedgemap.find( HighEdge(a,b) );
     if (iter != highedgemap.end()) // If previous test is present
       return (*iter).second;	// Use it
   }
@@ -1031,6 +1045,7 @@ bool Merge::intersection(HighVariable *a,HighVariable *b)
   int4 blk;
   vector<int4> blockisect;
   a->wholecover.intersectList(blockisect,b->wholecover,2);
+  if (blockisect.empty()) return false;
   for(blk=0;blk<blockisect.size();++blk) {
     if (blockIntersection(a,b,blockisect[blk])) {
       res = true;
@@ -0,0 +1,94 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "metrics.hh"
+#include "xml.hh"
+
+#include <iomanip>
+
+namespace GhidraDec {
+
+bool AnalysisMetrics::enabled = false;
+thread_local uint8 AnalysisMetrics::current[AnalysisMetrics::kind_count];
+std::atomic<uint8> AnalysisMetrics::totals[AnalysisMetrics::kind_count];
+
+/// The counts of \b this are set to zero, and the running counts of this thread are noted.
+void AnalysisMetrics::begin(void)
+
+{
+  for(int4 i=0;i<kind_count;++i) {
+    counts[i] = 0;
+    base[i] = current[i];
+  }
+}
+
+/// The counts made on this thread since the last call to begin() replace the counts in \b this.
+/// \param addtotal is \b true if the counts should also be added to the process-wide totals
+void AnalysisMetrics::take(bool addtotal)
+
+{
+  for(int4 i=0;i<kind_count;++i) {
+    counts[i] = current[i] - base[i];
+    if (addtotal && counts[i] != 0)
+      totals[i].fetch_add(counts[i],std::memory_order_relaxed);
+  }
+}
+
+/// \param k is the kind of test
+/// \return the name used when printing and saving counts
+const char *AnalysisMetrics::getKindName(kind k)
+
+{
+  static const char *names[] = { "cover_intersect", "merge_test", "cast_check", "heritage_rename", "cast_memo_hit" };
+  return names[k];
+}
+
+/// \param s is the output stream
+void AnalysisMetrics::print(std::ostream &s) const
+
+{
+  for(int4 i=0;i<kind_count;++i)
+    s << std::setw(16) << std::left << getKindName((kind)i) << std::right << std::dec << counts[i] << std::endl;
+}
+
+/// Each kind is saved as an attribute holding its count.
+/// \param s is the output stream
+void AnalysisMetrics::saveXml(std::ostream &s) const
+
+{
+  s << "<metrics";
+  for(int4 i=0;i<kind_count;++i)
+    a_v_u(s,getKindName((kind)i),counts[i]);
+  s << "/>\n";
+}
+
+/// The records have the same columns as Action::printStatisticsCsv(), with the count of
+/// each kind in the \e tested column and zero in the others.
+/// \param s is the output stream
+void AnalysisMetrics::printTotalsCsv(std::ostream &s)
+
+{
+  for(int4 i=0;i<kind_count;++i)
+    s << "metric," << getKindName((kind)i) << ',' << std::dec << totals[i].load(std::memory_order_relaxed) << ",0,0,0" << std::endl;
+}
+
+void AnalysisMetrics::resetTotals(void)
+
+{
+  for(int4 i=0;i<kind_count;++i)
+    totals[i].store(0,std::memory_order_relaxed);
+}
+
+}
@@ -15,6 +15,7 @@
  */
 #include "op.hh"
 #include "funcdata.hh"
+#include "constfold.hh"
 
 namespace GhidraDec {
 /// Constructor for the \b iop space.
@@ -69,7 +70,7 @@ void IopSpace::restoreXml(const Element *el)
 /// but all are set initially to null.
 /// \param s indicates the number of input slots reserved
 /// \param sq is the sequence number to associate with the new PcodeOp
-PcodeOp::PcodeOp(int4 s,const SeqNum &sq) : start(sq),inrefs(s)
+PcodeOp::PcodeOp(int4 s,const SeqNum &sq) : inrefs(s),start(sq)
 
 {
   flags = 0;			// Start out life as dead
@@ -189,17 +190,44 @@ void PcodeOp::insertInput(int4 slot)
   inrefs[slot] = (Varnode *)0;
 }
   
+/// The ops in the range are unlinked from \b op2 and relinked before the given position,
+/// keeping their order.  Iterators to the moved ops remain valid.
+/// \param pos is the position in \b this list to move the ops before
+/// \param op2 is the list the ops are taken from (which may be \b this)
+/// \param first is the first op to move
+/// \param last is the position after the last op to move
+void PcodeOpList::splice(iterator pos,PcodeOpList &op2,iterator first,iterator last)
+
+{
+  if (first == last) return;
+  if (&op2 != this) {
+    int4 num = 0;
+    for(PcodeOpLink *n=first.node;n!=last.node;n=n->next)
+      num += 1;
+    op2.count -= num;
+    count += num;
+  }
+  PcodeOpLink *firstnode = first.node;
+  PcodeOpLink *lastnode = last.node->prev;
+  firstnode->prev->next = last.node;	// Unlink the range
+  last.node->prev = firstnode->prev;
+  firstnode->prev = pos.node->prev;	// Link it in before pos
+  lastnode->next = pos.node;
+  pos.node->prev->next = firstnode;
+  pos.node->prev = lastnode;
+}
+
 // Find the next op in sequence from this op.  This is usually in the same basic block, but this
 // routine will follow flow into successive blocks during its search, so long as there is only one path
 // \return the next PcodeOp or \e null
 PcodeOp *PcodeOp::nextOp(void) const
 
 {
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter;
   BlockBasic *p;
 
   p = parent;			// Current parent
-  iter = basiciter;		// Current iterator
+  iter = getBasicIter();	// Current iterator
 
   iter ++;
   while(iter == p->endOp()) {
@@ -216,10 +244,9 @@ PcodeOp *PcodeOp::nextOp(void) const
 PcodeOp *PcodeOp::previousOp(void) const
 
 {
-  list<PcodeOp *>::iterator iter;
+  PcodeOpList::iterator iter = getBasicIter();
 
-  if (basiciter == parent->beginOp()) return (PcodeOp *) 0;
-  iter = basiciter;
+  if (iter == parent->beginOp()) return (PcodeOp *) 0;
   iter--;
   return *iter;
 }
@@ -233,8 +260,16 @@ PcodeOp *PcodeOp::target(void) const
 
 {
   PcodeOp *retop;
-  list<PcodeOp *>::iterator iter;
-  iter = isDead() ? insertiter : basiciter;
+  if (isDead()) {
+    list<PcodeOp *>::iterator iter = insertiter;
+    retop = *iter;
+    while((retop->flags&PcodeOp::startmark)==0) {
+      --iter;
+      retop = *iter;
+    }
+    return retop;
+  }
+  PcodeOpList::iterator iter = getBasicIter();
   retop = *iter;
   while((retop->flags&PcodeOp::startmark)==0) {
     --iter;
@@ -310,18 +345,24 @@ uintb PcodeOp::collapse(bool &markedInput) const {
   const Varnode *vn0;
   const Varnode *vn1;
 
+  uintb res;
   vn0 = getIn(0);
   if (vn0->getSymbolEntry() != (SymbolEntry *)0) {
     markedInput = true;
   }
   switch(getEvalType()) {
   case PcodeOp::unary:
+    if (ConstantFold::evaluate(opcode->getOpcode(),output->getSize(),vn0->getSize(),vn0->getOffset(),0,res))
+      return res;
     return opcode->evaluateUnary(output->getSize(),vn0->getSize(),vn0->getOffset());
   case PcodeOp::binary:
     vn1 = getIn(1);
     if (vn1->getSymbolEntry() != (SymbolEntry *)0) {
       markedInput = true;
     }
+    if (ConstantFold::evaluate(opcode->getOpcode(),output->getSize(),vn0->getSize(),
+			       vn0->getOffset(),vn1->getOffset(),res))
+      return res;
     return opcode->evaluateBinary(output->getSize(),vn0->getSize(),
 				  vn0->getOffset(),vn1->getOffset());
   default: 
@@ -683,6 +724,33 @@ void PcodeOpBank::destroyDead(void)
   }
 }
 
+/// Retired PcodeOps that are fully unlinked, with no input or output, are deleted, returning their
+/// memory to the pool, unless they are in the given list of PcodeOps that may still be referenced.
+/// \param keep is the sorted list of PcodeOps that must stay allocated
+/// \return the number of PcodeOps freed
+int4 PcodeOpBank::reclaimRetired(const vector<PcodeOp *> &keep)
+
+{
+  int4 res = 0;
+  list<PcodeOp *>::iterator iter = deadandgone.begin();
+  while(iter != deadandgone.end()) {
+    PcodeOp *op = *iter;
+    bool linked = (op->getOut() != (Varnode *)0);
+    for(int4 i=0;i<op->numInput() && !linked;++i)
+      linked = (op->getIn(i) != (Varnode *)0);
+    if (linked || binary_search(keep.begin(),keep.end(),op)) {
+      ++iter;
+      continue;
+    }
+    iter = deadandgone.erase(iter);
+    delete op;
+    res += 1;
+  }
+  numreclaimed += res;
+  reclaimmark = deadandgone.size();
+  return res;
+}
+
 /// The given PcodeOp is removed from all internal lists and added to a final
 /// \e deadandgone list. The memory is not reclaimed until the whole container is
 /// destroyed, in case pointer references still exist.  These will all still
@@ -714,25 +782,25 @@ void PcodeOpBank::changeOpcode(PcodeOp *op,TypeOp *newopc)
 }
 
 /// The PcodeOp is moved out of the \e dead list into the \e alive list.  The
-/// PcodeOp::isDead() method will now return \b false.
+/// PcodeOp::isDead() method will now return \b false.  The list node is spliced across,
+/// so no memory is allocated or freed.
 /// \param op is the given PcodeOp to mark
 void PcodeOpBank::markAlive(PcodeOp *op)
 
 {
-  deadlist.erase(op->insertiter);
+  alivelist.splice(alivelist.end(),deadlist,op->insertiter);
   op->clearFlag(PcodeOp::dead);
-  op->insertiter = alivelist.insert(alivelist.end(),op);
 }
 
 /// The PcodeOp is moved out of the \e alive list into the \e dead list. The
-/// PcodeOp::isDead() method will now return \b true.
+/// PcodeOp::isDead() method will now return \b true.  The list node is spliced across,
+/// so no memory is allocated or freed.
 /// \param op is the given PcodeOp to mark
 void PcodeOpBank::markDead(PcodeOp *op)
 
 {
-  alivelist.erase(op->insertiter);
+  deadlist.splice(deadlist.end(),alivelist,op->insertiter);
   op->setFlag(PcodeOp::dead);
-  op->insertiter = deadlist.insert(deadlist.end(),op);
 }
 
 /// The op is moved to right after a specified op in the \e dead list.
@@ -871,6 +939,28 @@ list<PcodeOp *>::const_iterator PcodeOpBank::end(OpCode opc) const
   return alivelist.end();
 }
 
+/// The estimate counts each PcodeOp object (including retired ones), its input list, its node
+/// in the sequence number tree, and its entries in the alive, dead, and op-code specific lists.
+/// \return the estimated number of bytes
+uint8 PcodeOpBank::memoryEstimate(void) const
+
+{
+  uint8 res = 0;
+  PcodeOpTree::const_iterator iter;
+
+  for(iter=optree.begin();iter!=optree.end();++iter) {
+    const PcodeOp *op = (*iter).second;
+    res += sizeof(PcodeOp);
+    if (!op->inrefs.isInline())
+      res += op->inrefs.capacity() * sizeof(Varnode *);
+    res += 4 * sizeof(void *) + sizeof(SeqNum) + sizeof(PcodeOp *);	// Sequence tree node
+  }
+  uint8 listentries = optree.size() + storelist.size() + returnlist.size() + useroplist.size();
+  res += listentries * 3 * sizeof(void *);
+  res += deadandgone.size() * (sizeof(PcodeOp) + 3 * sizeof(void *));
+  return res;
+}
+
 void PcodeOpBank::clear(void)
 
 {
@@ -888,6 +978,8 @@ void PcodeOpBank::clear(void)
   clearCodeLists();
   deadandgone.clear();
   uniqid = 0;
+  numreclaimed = 0;
+  reclaimmark = 0;
 }
 
 static int4 functionalEqualityLevel0(Varnode *vn1,Varnode *vn2)
@@ -1013,6 +1105,47 @@ bool functionalEquality(Varnode *vn1,Varnode *vn2)
   return (functionalEqualityLevel(vn1,vn2,buf1,buf2)==0);
 }
 
+/// \brief Hash a single Varnode the way functionalEqualityLevel0() compares it
+///
+/// \param vn is the Varnode
+/// \return the value of a constant, or an identifier for any other Varnode
+static uintm functionalEqualityHash0(Varnode *vn)
+
+{
+  if (vn->isConstant())
+    return (uintm)vn->getOffset();
+  return ((uintm)vn->getCreateIndex() << 1) ^ 0x5bd1e995;	// Keep identifiers apart from small constants
+}
+
+/// \brief Hash a Varnode so that functionally equal Varnodes collide
+///
+/// Any two Varnodes for which functionalEqualityLevel() returns 0 have the same hash:
+/// constants hash their value, and a Varnode written by a simple operation hashes the op-code
+/// and its inputs, combined symmetrically if the operation is commutative.  Different
+/// Varnodes may still share a hash, so a match must be confirmed by functionalEqualityLevel().
+/// \param vn is the Varnode to hash
+/// \return the hash
+uintm functionalEqualityHash(Varnode *vn)
+
+{
+  if (!vn->isWritten()) return functionalEqualityHash0(vn);
+  PcodeOp *op = vn->getDef();
+  int4 num = op->numInput();
+  if (op->isMarker() || op->isCall()) return functionalEqualityHash0(vn);
+  if (num >= 3) {
+    if (op->code() != CPUI_PTRADD) return functionalEqualityHash0(vn);
+    num = 2;
+  }
+  uintm hash = (uintm)op->code() * 0x9e3779b1;
+  if (num == 0) return hash;
+  uintm h0 = functionalEqualityHash0(op->getIn(0));
+  if (num == 1) return hash ^ h0;
+  uintm h1 = functionalEqualityHash0(op->getIn(1));
+  if (op->isCommutative())
+    return hash ^ (h0 + h1);
+  return hash ^ (h0 + ((h1 << 7) | (h1 >> (sizeof(uintm)*8-7))));
+}
+
 /// \brief Return true if vn1 and vn2 are verifiably different values
 ///
 /// This is actually a rather speculative test
@@ -17,6 +17,10 @@
 #include "funcdata.hh"
 #include "flow.hh"
 #include "printc.hh"
+#include "tracespan.hh"
+#include "workmark.hh"
+#include "flowsummary.hh"
+#include "resultcache.hh"
 
 namespace GhidraDec {
 /// If the parameter is "on" return \b true, if "off" return \b false.
@@ -68,6 +72,7 @@ OptionDatabase::OptionDatabase(Architecture *g)
   registerOption(new OptionConventionPrinting());
   registerOption(new OptionNoCastPrinting());
   registerOption(new OptionMaxLineWidth());
+  registerOption(new OptionMaxLookahead());
   registerOption(new OptionIndentIncrement());
   registerOption(new OptionCommentIndent());
   registerOption(new OptionCommentStyle());
@@ -76,9 +81,27 @@ OptionDatabase::OptionDatabase(Architecture *g)
   registerOption(new OptionIntegerFormat());
   registerOption(new OptionCurrentAction());
   registerOption(new OptionAllowContextSet());
+  registerOption(new OptionInstructionCache());
+  registerOption(new OptionDecodeProfile());
   registerOption(new OptionSetAction());
   registerOption(new OptionSetLanguage());
   registerOption(new OptionJumpLoad());
+  registerOption(new OptionIncremental());
+  registerOption(new OptionResultCache());
+  registerOption(new OptionActionTiming());
+  registerOption(new OptionMemoryStats());
+  registerOption(new OptionMetrics());
+  registerOption(new OptionTracing());
+  registerOption(new OptionWorkMarks());
+  registerOption(new OptionDominators());
+  registerOption(new OptionBudget());
+  registerOption(new OptionPoolPartition());
+  registerOption(new OptionHeritageThreads());
+  registerOption(new OptionFlowBudget());
+  registerOption(new OptionProfileAction());
+  registerOption(new OptionSkipRule());
+  registerOption(new OptionFlowSummary());
+  registerOption(new OptionReleaseAnalysis());
   registerOption(new OptionToggleRule());
 }
 
@@ -104,6 +127,8 @@ string OptionDatabase::set(const string &nm,const string &p1,const string &p2,co
   if (iter == optionmap.end())
     throw ParseError("Unknown option: "+nm);
   ArchOption *opt = (*iter).second;
+  if (glb->print != (PrintLanguage *)0)
+    glb->print->dropRetainedTokens();	// Any option may change how the function is emitted
   return opt->apply(glb,p1,p2,p3);
 }
 
@@ -413,6 +438,27 @@ string OptionMaxLineWidth::apply(Architecture *glb,const string &p1,const string
   return "Maximum line width set to "+p1;
 }
 
+/// \class OptionMaxLookahead
+/// \brief Bound the number of tokens the pretty printer holds while waiting for groups to close
+///
+/// The first parameter is the integer number of tokens, which must be at least the maximum
+/// line width, or 0 to hold tokens without limit.  With a limit, groups that grow past it
+/// are broken across lines and emitted as they go.
+string OptionMaxLookahead::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  istringstream s(p1);
+  s.unsetf(ios::dec | ios::hex | ios::oct);
+  int4 val = -1;
+  s >> val;
+  if (val==-1)
+    throw ParseError("Must specify integer lookahead");
+  glb->print->setMaxLookahead(val);
+  if (val == 0)
+    return "Pretty printer lookahead is unbounded";
+  return "Maximum pretty printer lookahead set to "+p1;
+}
+
 /// \class OptionIndentIncrement
 /// \brief Set the number of characters to indent per nested scope.
 ///
@@ -581,6 +627,59 @@ string OptionAllowContextSet::apply(Architecture *glb,const string &p1,const str
   return res;
 }
 
+/// \class OptionInstructionCache
+/// \brief Set the size of the translator's persistent cache of decoded instructions
+///
+/// The first parameter is the maximum number of instructions whose p-code is kept
+/// across functions.  A value of 0 disables the cache.
+string OptionInstructionCache::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  istringstream s(p1);
+  s.unsetf(ios::dec | ios::hex | ios::oct);
+  int4 val = -1;
+  s >> val;
+  if (val < 0)
+    throw ParseError("Must specify non-negative integer cache size");
+  glb->translate->setInstructionCacheSize(val);
+  if (val == 0)
+    return "Instruction cache disabled";
+  return "Instruction cache size set to "+p1;
+}
+
+/// \class OptionDecodeProfile
+/// \brief Count how often each constructor of the processor specification is decoded
+///
+/// The first parameter is one of:
+///   - "on"    to start counting
+///   - "off"   to stop counting, keeping the counts so far
+///   - "save"  to write the counts to the file named by the second parameter
+///
+/// The saved profile can be passed to the SLEIGH compiler (\b -p option), which then builds
+/// decision trees that resolve the most frequently decoded instructions in the fewest steps.
+string OptionDecodeProfile::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1 == "save") {
+    if (p2.size() == 0)
+      throw ParseError("Missing file name for decode profile");
+    ofstream s(p2.c_str());
+    if (!s)
+      throw ParseError("Unable to open decode profile file: " + p2);
+    bool res = glb->translate->saveDecodeProfile(s);
+    s.close();
+    if (!res)
+      throw RecovError("Translator does not support decode profiles");
+    return "Decode profile written to " + p2;
+  }
+  bool val = onOrOff(p1);
+  if (!glb->translate->setDecodeProfiling(val))
+    throw RecovError("Translator does not support decode profiles");
+  if (val)
+    return "Decode profiling enabled";
+  return "Decode profiling disabled";
+}
+
 /// \class OptionIgnoreUnimplemented
 /// \brief Toggle whether unimplemented instructions are treated as a \e no-operation
 ///
@@ -736,6 +835,394 @@ string OptionJumpLoad::apply(Architecture *glb,const string &p1,const string &p2
   return res;
 }
 
+/// \class OptionIncremental
+/// \brief Toggle whether analysis is reused when a function is decompiled again
+///
+/// If the first parameter is "on", jump-tables recovered for a function are kept and reused
+/// after a restart and the next time the same function is decompiled, rather than being
+/// recovered from scratch.  A table is only reused while the bytes its recovery read are
+/// unchanged.  The optional second parameter names a file that tables are saved to, so they
+/// are also reused by later sessions.
+string OptionIncremental::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  bool val = onOrOff(p1);
+  glb->setIncremental(val,p2);
+  if (val) {
+    if (p2.size() != 0)
+      return "Incremental re-decompilation enabled, saving jump-tables to "+p2;
+    return "Incremental re-decompilation enabled";
+  }
+  return "Incremental re-decompilation disabled";
+}
+
+/// \class OptionActionTiming
+/// \brief Toggle whether the time spent in each Action and Rule is accumulated
+///
+/// If the first parameter is "on", every Action and Rule accumulates the wall-clock time
+/// it spends, which is reported along with its other statistics.  The setting applies to all
+/// Actions in the process.
+string OptionActionTiming::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  bool val = onOrOff(p1);
+  Action::setTiming(val);
+  if (val)
+    return "Action timing enabled";
+  return "Action timing disabled";
+}
+
+/// \class OptionMemoryStats
+/// \brief Toggle whether Actions measure the memory used by the function they transform
+///
+/// If the first parameter is "on", every Action that makes a change estimates the memory held by
+/// the function's analysis structures afterward.  The largest value seen by each Action is reported
+/// with its other statistics, and each function remembers its own peak (see Funcdata::recordMemory()).
+/// The setting applies to all Actions in the process.
+string OptionMemoryStats::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  bool val = onOrOff(p1);
+  Action::setMemoryTracking(val);
+  if (val)
+    return "Memory statistics enabled";
+  return "Memory statistics disabled";
+}
+
+/// \class OptionMetrics
+/// \brief Toggle counting of the inner tests of the analysis
+///
+/// If the first parameter is "on", Cover intersections, HighVariable merge tests, cast checks,
+/// and heritage renames are counted for each function (see AnalysisMetrics).  The setting
+/// applies to all functions in the process.
+string OptionMetrics::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  bool val = onOrOff(p1);
+  AnalysisMetrics::setEnabled(val);
+  if (val)
+    return "Analysis metrics enabled";
+  return "Analysis metrics disabled";
+}
+
+/// \class OptionTracing
+/// \brief Control the recording of trace spans for decompiler phases
+///
+/// The first parameter is one of:
+///   - "on"    to start recording spans (see TraceLog)
+///   - "off"   to stop recording, keeping the spans recorded so far
+///   - "clear" to throw away the recorded spans
+///   - "save"  to write the recorded spans to the file named by the second parameter, as a
+///             Chrome trace that can be loaded by chrome://tracing or Perfetto
+///
+/// The setting applies to all functions and threads in the process.
+string OptionTracing::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1 == "save") {
+    if (p2.size() == 0)
+      throw ParseError("Missing file name for trace");
+    ofstream s(p2.c_str());
+    if (!s)
+      throw ParseError("Unable to open trace file: " + p2);
+    int4 num = TraceLog::numEvents();
+    TraceLog::saveChromeJson(s);
+    s.close();
+    ostringstream res;
+    res << dec << num << " trace spans written to " << p2;
+    uint4 dropped = TraceLog::numDropped();
+    if (dropped != 0)
+      res << " (" << dropped << " dropped)";
+    return res.str();
+  }
+  if (p1 == "clear") {
+    TraceLog::clear();
+    return "Trace cleared";
+  }
+  bool val = onOrOff(p1);
+  TraceLog::setEnabled(val);
+  if (val)
+    return "Tracing enabled";
+  return "Tracing disabled";
+}
+
+/// \class OptionWorkMarks
+/// \brief Toggle noting of the function, Action and Rule each thread is working on
+///
+/// If the first parameter is "on", each thread notes its current work (see WorkMark), and a
+/// SIGUSR1 sent to the process writes a line per thread, so profiler samples can be attributed
+/// to the function and Action that caused them.  The optional second parameter names a file that
+/// the lines are appended to, instead of \e stderr.  The setting applies to all threads in the
+/// process.
+string OptionWorkMarks::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  bool val = onOrOff(p1);
+  if (val && p2.size() != 0) {
+    if (!WorkMark::setAnnotationFile(p2))
+      throw ParseError("Unable to open annotation file: " + p2);
+  }
+  WorkMark::setEnabled(val);
+  if (!val)
+    return "Work marks disabled";
+  if (p2.size() != 0)
+    return "Work marks enabled, dumped to " + p2;
+  return "Work marks enabled";
+}
+
+/// \class OptionDominators
+/// \brief Select the algorithm used to compute dominator trees
+///
+/// The first parameter is "iterative" for the iterative data-flow algorithm (the default), or
+/// "seminca" for the Semi-NCA algorithm, which scales better on very large control-flow graphs.
+/// The setting applies to all functions in the process.
+string OptionDominators::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1 == "iterative")
+    BlockGraph::setDominatorAlgorithm(BlockGraph::dom_iterative);
+  else if (p1 == "seminca")
+    BlockGraph::setDominatorAlgorithm(BlockGraph::dom_semi_nca);
+  else
+    throw ParseError("Unknown dominator algorithm: " + p1);
+  return "Dominators computed with " + p1 + " algorithm";
+}
+
+/// \class OptionResultCache
+/// \brief Toggle caching of decompiler output across decompilations
+///
+/// If the first parameter is "off", caching is turned off.  If it is "on" (or empty), output is
+/// cached in memory.  Any other value is taken as a directory to store cached output in, so that it
+/// persists across sessions.  Cached output is only reused if the function and the bytes it
+/// depends on are unchanged.  For a cache in memory, the optional second parameter limits the
+/// number of bytes of output held, dropping the oldest results first.  If it is "shared", the
+/// second parameter names a file holding a store that several processes reuse results through at
+/// once, and the optional third parameter is the size of the file if it has to be created.
+string OptionResultCache::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1 == "off") {
+    glb->setResultCache(false,"");
+    return "Result cache disabled";
+  }
+  if (p1.size() == 0 || p1 == "on") {
+    glb->setResultCache(true,"");
+    if (p2.size() == 0)
+      return "Result cache enabled in memory";
+    istringstream s(p2);
+    s.unsetf(ios::dec | ios::hex | ios::oct);
+    uint8 limit = 0;
+    s >> limit;
+    if (!s || limit == 0)
+      throw ParseError("Bad result cache limit: " + p2);
+    glb->resultcache->setMemoryLimit(limit);
+    return "Result cache enabled in memory, up to " + p2 + " bytes";
+  }
+  if (p1 == "shared") {
+    if (p2.size() == 0)
+      throw ParseError("Missing file for shared result cache");
+    uint8 size = 256 * 1024 * 1024;
+    if (p3.size() != 0) {
+      istringstream s(p3);
+      s.unsetf(ios::dec | ios::hex | ios::oct);
+      size = 0;
+      s >> size;
+      if (!s || size == 0)
+	throw ParseError("Bad shared result cache size: " + p3);
+    }
+    glb->setSharedResultCache(p2,size);
+    return "Result cache shared through " + p2;
+  }
+  glb->setResultCache(true,p1);
+  return "Result cache enabled in " + p1;
+}
+
+/// \class OptionReleaseAnalysis
+/// \brief Toggle whether batch decompiles free all storage of a function once it is done
+///
+/// If the first parameter is "on", a BatchDecompiler releases the containers each function keeps
+/// for its next decompile, after the function is finished.  The PcodeOps, Varnodes and blocks go
+/// back to per-thread pools either way, so resident memory stays near what the workers have in progress.
+string OptionReleaseAnalysis::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  bool val = onOrOff(p1);
+  glb->release_analysis = val;
+  if (val)
+    return "Analysis storage released after batch decompiles";
+  return "Analysis storage kept after batch decompiles";
+}
+
+/// \class OptionBudget
+/// \brief Limit the analysis effort spent on a single function
+///
+/// The first parameter is the number of milliseconds of analysis allowed per function, and the
+/// optional second parameter is the number of Rule applications allowed.  Zero means no limit.
+/// Once either runs out, optional simplifications are skipped, the analysis is not restarted,
+/// and the function is emitted with a warning.
+string OptionBudget::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1.size() == 0)
+    throw ParseError("Must specify milliseconds per function");
+  uint4 millis = 0;
+  uint4 rules = 0;
+  istringstream s1(p1);
+  s1.unsetf(ios::dec | ios::hex | ios::oct);
+  s1 >> millis;
+  if (!s1)
+    throw ParseError("Bad milliseconds: " + p1);
+  if (p2.size() != 0) {
+    istringstream s2(p2);
+    s2.unsetf(ios::dec | ios::hex | ios::oct);
+    s2 >> rules;
+    if (!s2)
+      throw ParseError("Bad number of rule applications: " + p2);
+  }
+  glb->budget_millis = millis;
+  glb->budget_rules = rules;
+  if (millis == 0 && rules == 0)
+    return "Analysis budget disabled";
+  return "Analysis budget set";
+}
+
+/// \class OptionPoolPartition
+/// \brief Partition the ActionPool passes of large functions by basic block (experimental)
+///
+/// The parameter is the smallest number of PcodeOps a function must have for its full passes
+/// to be split into a block-local and a global phase (see ActionPool).  Zero turns this off.
+string OptionPoolPartition::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1.size() == 0)
+    throw ParseError("Must specify number of ops");
+  uint4 numops = 0;
+  istringstream s1(p1);
+  s1.unsetf(ios::dec | ios::hex | ios::oct);
+  s1 >> numops;
+  if (!s1)
+    throw ParseError("Bad number of ops: " + p1);
+  glb->pool_partition = numops;
+  if (numops == 0)
+    return "Pool partitioning disabled";
+  return "Pool partitioning set";
+}
+
+/// \class OptionFlowBudget
+/// \brief Bound the raw p-code a single function may generate during flow following
+///
+/// The parameter is the number of raw p-code ops.  Once a function's flow has generated that
+/// many, every further instruction reached is cut off as the entry of a separate region, left
+/// opaque in this function and listed in its warning header, so that huge functions are
+/// decompiled region by region with bounded memory.  Zero turns this off.
+string OptionFlowBudget::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1.size() == 0)
+    throw ParseError("Must specify number of ops");
+  uint4 numops = 0;
+  istringstream s1(p1);
+  s1.unsetf(ios::dec | ios::hex | ios::oct);
+  s1 >> numops;
+  if (!s1)
+    throw ParseError("Bad number of ops: " + p1);
+  glb->flow_op_budget = numops;
+  if (numops == 0)
+    return "Flow budget disabled";
+  return "Flow budget set";
+}
+
+/// \class OptionHeritageThreads
+/// \brief Set the number of threads placing MULTIEQUALs during heritage
+///
+/// The parameter is the number of threads, including the one decompiling, that compute the
+/// phi-node placement of a heritage pass, for functions with more than 64 address ranges to
+/// place.  Ops are still inserted by the decompiling thread.  Zero or one turns this off.
+string OptionHeritageThreads::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1.size() == 0)
+    throw ParseError("Must specify number of threads");
+  uint4 numthreads = 0;
+  istringstream s1(p1);
+  s1.unsetf(ios::dec | ios::hex | ios::oct);
+  s1 >> numthreads;
+  if (!s1)
+    throw ParseError("Bad number of threads: " + p1);
+  if (numthreads == 0)
+    numthreads = 1;
+  glb->heritage_threads = numthreads;
+  if (numthreads == 1)
+    return "Heritage threads disabled";
+  return "Heritage threads set";
+}
+
+/// \class OptionProfileAction
+/// \brief Derive a root Action that leaves out the Rules that never applied
+///
+/// The first parameter is the root Action whose statistics are used, typically the current
+/// one after decompiling a corpus, and the second is the name of the new root Action.  The new
+/// root Action is made current, and the Rules left out are listed, so that the same root can be
+/// set up later with \e setaction and \e skiprule.  See ActionDatabase::deriveProfile().
+string OptionProfileAction::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1.size() == 0 || p2.size() == 0)
+    throw ParseError("Must specify the profiled action and the name of the new action");
+  vector<string> skipped;
+  glb->allacts.deriveProfile(p1,p2,skipped);
+  glb->allacts.setCurrent(p2);
+  ostringstream s;
+  s << "Created " << p2 << " from " << p1 << " without " << dec << skipped.size() << " idle rules";
+  for(int4 i=0;i<skipped.size();++i)
+    s << (i==0 ? ": " : " ") << skipped[i];
+  return s.str();
+}
+
+/// \class OptionSkipRule
+/// \brief Leave a Rule out of a root Action
+///
+/// The first parameter is the root Action, which must not have been used yet, and the second
+/// is the name of the Rule.
+string OptionSkipRule::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1.size() == 0 || p2.size() == 0)
+    throw ParseError("Must specify the action and the rule");
+  glb->allacts.getGroup(p1);	// Make sure the root Action exists
+  if (!glb->allacts.skipRule(p1,p2))
+    return "Rule " + p2 + " was already left out of " + p1;
+  return "Rule " + p2 + " left out of " + p1;
+}
+
+/// \class OptionFlowSummary
+/// \brief Use a database of function summaries for call sites
+///
+/// The first parameter is the file holding the database (see FlowSummaryDb), "off" to stop
+/// using it, or "save" to write the summaries recorded so far back to the file.
+string OptionFlowSummary::apply(Architecture *glb,const string &p1,const string &p2,const string &p3) const
+
+{
+  if (p1.size() == 0)
+    throw ParseError("Must specify a file, off, or save");
+  if (p1 == "off") {
+    glb->setFlowSummary("");
+    return "Flow summaries disabled";
+  }
+  if (p1 == "save") {
+    if (glb->flowsummary == (FlowSummaryDb *)0)
+      throw ParseError("No flow summary database in use");
+    glb->flowsummary->save();
+    ostringstream s;
+    s << "Saved " << dec << glb->flowsummary->numSummaries() << " flow summaries to " << glb->flowsummary->getFileName();
+    return s.str();
+  }
+  glb->setFlowSummary(p1);
+  ostringstream s;
+  s << "Using " << dec << glb->flowsummary->numSummaries() << " flow summaries from " << p1;
+  return s.str();
+}
+
 /// \class OptionToggleRule
 /// \brief Toggle whether a specific Rule is applied in the current Action
 ///
@@ -230,6 +230,23 @@ uint4 Override::getFlowOverride(const Address &addr) const
   return (*iter).second;
 }
 
+/// \brief Fetch every flow override in a range of addresses
+///
+/// The overrides are passed back sorted by address, so the caller can search the array
+/// or walk it with a cursor instead of querying the map for each instruction.
+/// \param start is the first address in the range
+/// \param stop is the last address in the range
+/// \param res will hold (address,override type) pairs
+void Override::getFlowOverrides(const Address &start,const Address &stop,vector<pair<Address,uint4> > &res) const
+
+{
+  res.clear();
+  map<Address,uint4>::const_iterator iter = flowoverride.lower_bound(start);
+  map<Address,uint4>::const_iterator enditer = flowoverride.upper_bound(stop);
+  for(;iter!=enditer;++iter)
+    res.push_back(*iter);
+}
+
 /// \brief Dump a description of the overrides to stream
 ///
 /// Give a description of each override, one per line, that is suitable for debug
@@ -37,7 +37,7 @@ void ParamMeasure::walkforward( WalkState &state, PcodeOp *ignoreop, Varnode *vn
     state.depth -= 1;
     return;
   }
-  list<PcodeOp *>::const_iterator iter = vn->beginDescend();
+  DescendList::const_iterator iter = vn->beginDescend();
   while( rank != state.terminalrank && iter != vn->endDescend() ) {
     PcodeOp *op = *iter;
     if( op != ignoreop ) {
@@ -97,6 +97,46 @@ void InjectPayload::restoreXml(const Element *el)
 }
 
 /// \param g is the Architecture owning \b snippet
+/// The signature is the XML form of the context (see InjectContext::saveXml()), which holds
+/// everything that determines the p-code of an injection.
+/// \param context is the injection context
+/// \return the signature string
+string InjectPcodeCache::signature(const InjectContext &context)
+
+{
+  ostringstream s;
+  context.saveXml(s);
+  return s.str();
+}
+
+/// \param sig is the signature of the injection context
+/// \param emit is the emitter that receives the p-code
+/// \return \b true if p-code was recorded for the signature and has been emitted
+bool InjectPcodeCache::replay(const string &sig,PcodeEmit &emit)
+
+{
+  map<string,PcodeRun>::iterator iter = runs.find(sig);
+  if (iter == runs.end()) return false;
+  if ((*iter).second.numInstructions() == 0) return false;	// Recording never completed
+  (*iter).second.emit(0,emit);
+  return true;
+}
+
+/// The caller passes the p-code of the injection to the returned PcodeRun and then calls
+/// PcodeRun::endInstruction(). If the injection fails before then, the entry is ignored by
+/// replay() and is restarted by the next call to record() with the same signature.
+/// \param sig is the signature of the injection context
+/// \param addr is the address of the injection
+/// \return the PcodeRun that records the p-code
+PcodeRun &InjectPcodeCache::record(const string &sig,const Address &addr)
+
+{
+  PcodeRun &run( runs[sig] );
+  run.clear();
+  run.beginInstruction(addr);
+  return run;
+}
+
 /// \param src is a string describing the \e source of the snippet
 /// \param nm is the formal name of the snippet
 ExecutablePcode::ExecutablePcode(Architecture *g,const string &src,const string &nm)
@@ -179,6 +219,14 @@ PcodeInjectLibrary::~PcodeInjectLibrary(void)
     delete *iter;
 }
 
+/// This must be called whenever the source generating p-code for payloads may have changed.
+void PcodeInjectLibrary::clearCache(void)
+
+{
+  for(int4 i=0;i<injection.size();++i)
+    injection[i]->clearCache();
+}
+
 /// \brief Map a \e call-fixup name to a payload id
 ///
 /// \param fixupName is the formal name of the call-fixup
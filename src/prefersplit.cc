@@ -467,7 +467,7 @@ bool PreferSplitManager::testTemporary(SplitInstance *inst)
   default:
     return false;
   }
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = inst->vn->beginDescend();
   enditer = inst->vn->endDescend();
   while(iter != enditer) {
@@ -530,11 +530,18 @@ void PreferSplitManager::init(Funcdata *fd,const vector<PreferSplitRecord> *rec)
 {
   data = fd;
   records = rec;
+  covered.clear();
+  for(int4 i=0;i<records->size();++i) {
+    const VarnodeData &storage( (*records)[i].storage );
+    covered.insertRange(storage.space,storage.offset,storage.offset + (storage.size-1));
+  }
 }
 
 const PreferSplitRecord *PreferSplitManager::findRecord(Varnode *vn) const
 
 { // Find the split record that applies to -vn-, otherwise return null
+  if (!covered.inRange(vn->getAddr(),vn->getSize()))
+    return (PreferSplitRecord *)0; // Most varnodes overlap no record at all
   PreferSplitRecord templ;
   templ.storage.space = vn->getSpace();
   templ.storage.size = vn->getSize();
@@ -577,7 +584,7 @@ void PreferSplitManager::splitAdditional(void)
 	  defops.push_back(defop);
       }
     }
-    list<PcodeOp *>::const_iterator iter,enditer;
+    DescendList::const_iterator iter,enditer;
     iter = op->getOut()->beginDescend();
     enditer = op->getOut()->endDescend();
     while(iter != enditer) {
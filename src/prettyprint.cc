@@ -345,6 +345,61 @@ void EmitXml::spaces(int4 num,int4 bump)
   }
 }
 
+void EmitLineXml::flushLine(void)
+
+{
+  if (line.empty()) return;
+  *s << "<syntax>";
+  xml_escape(*s,line.c_str());
+  *s << "</syntax>";
+  line.clear();
+}
+
+int4 EmitLineXml::beginDocument(void)
+
+{
+  *s << "<clang_document>";
+  return 0;
+}
+
+void EmitLineXml::endDocument(int4 id)
+
+{
+  flushLine();
+  *s << "</clang_document>";
+}
+
+int4 EmitLineXml::beginFunction(const Funcdata *fd)
+
+{
+  flushLine();
+  *s << "<function>";
+  return 0;
+}
+
+void EmitLineXml::endFunction(int4 id)
+
+{
+  flushLine();
+  *s << "</function>";
+}
+
+void EmitLineXml::tagLine(int4 indent)
+
+{
+  flushLine();
+  *s << "<break indent=\"0x" << hex << indent << "\"/>";
+}
+
+/// Write any text collected in the buffer to the output stream and empty the buffer.
+void EmitBuffer::flush(void)
+
+{
+  if (buffer.empty() || s == (ostream *)0) return;
+  s->write(buffer.data(),buffer.size());
+  buffer.clear();
+}
+
 int4 TokenSplit::countbase = 0;
 
 /// Emit markup or content corresponding to \b this token on a low-level emitter.
@@ -546,6 +601,8 @@ EmitPrettyPrint::EmitPrettyPrint(int4 mls)
   spaceremain = maxlinesize;
   needbreak = false;
   commentmode = false;
+  maxlookahead = 0;
+  recording = false;
 }
 
 EmitPrettyPrint::~EmitPrettyPrint(void)
@@ -734,6 +791,8 @@ void EmitPrettyPrint::scan(void)
     expand();			// Expand it
   // Delay creating reference until after the possible expansion
   TokenSplit &tok( tokqueue.top() );
+  if (recording)
+    recorded.push_back(tok);	// Copy before the size is adjusted
   switch(tok.getClass()) {
   case TokenSplit::begin_comment:
   case TokenSplit::begin:
@@ -788,6 +847,26 @@ void EmitPrettyPrint::scan(void)
       }
     }
   }
+  if (maxlookahead != 0 && tokqueue.size() > maxlookahead)
+    forceLookahead();
+}
+
+/// In streaming mode, once more than \b maxlookahead tokens are waiting, the oldest open
+/// groups and whitespace are broken as if the line had overflowed, and the tokens that
+/// become committed are emitted.  This bounds the queues for any shape of input, at the cost
+/// of line breaks in groups that might have fit.
+void EmitPrettyPrint::forceLookahead(void)
+
+{
+  while(tokqueue.size() > maxlookahead) {
+    if (scanqueue.empty()) {	// Nothing is waiting on a group
+      advanceleft();
+      break;
+    }
+    TokenSplit &ref( tokqueue.ref( scanqueue.popbottom() ) );
+    ref.setSize(999999);
+    advanceleft();
+  }
 }
 
 /// Make sure there is whitespace after the last content token, inserting a zero-sized
@@ -1188,6 +1267,20 @@ void EmitPrettyPrint::flush(void)
   lowlevel->flush();
 }
 
+/// Each recorded token is queued and scanned exactly as when it was first emitted, so
+/// only line breaking is redone.  Tokens whose text has been changed with TokenSplit::setText()
+/// are laid out with their new size.  The whitespace checks made by the emitting methods
+/// are not repeated, as the tokens they inserted are part of the recording.
+void EmitPrettyPrint::replay(void)
+
+{
+  for(int4 i=0;i<recorded.size();++i) {
+    tokqueue.push() = recorded[i];
+    scan();
+  }
+  flush();
+}
+
 /// This method toggles the low-level emitter between EmitXml and EmitNoXml depending
 /// on whether XML markup is desired.
 /// \param val is \b true if XML markup is desired
@@ -1203,12 +1296,61 @@ void EmitPrettyPrint::setXML(bool val)
   lowlevel->setOutputStream(t);
 }
 
+/// This method toggles the low-level emitter between EmitNoXml and EmitBuffer
+/// depending on whether the text should be collected in a buffer.  Either way, no
+/// XML markup is emitted.  Text already in the buffer is written out first.
+/// \param val is \b true if the text should be buffered
+void EmitPrettyPrint::setBuffered(bool val)
+
+{
+  lowlevel->flush();
+  ostream *t = lowlevel->getOutputStream();
+  delete lowlevel;
+  if (val)
+    lowlevel = new EmitBuffer;
+  else
+    lowlevel = new EmitNoXml;
+  lowlevel->setOutputStream(t);
+}
+
+/// This method toggles the low-level emitter between EmitLineXml and the full markup of
+/// EmitXml.  Either way, the output is XML.
+/// \param val is \b true if only the line structure should be marked up
+void EmitPrettyPrint::setLineXml(bool val)
+
+{
+  lowlevel->flush();
+  ostream *t = lowlevel->getOutputStream();
+  delete lowlevel;
+  if (val)
+    lowlevel = new EmitLineXml;
+  else
+    lowlevel = new EmitXml;
+  lowlevel->setOutputStream(t);
+}
+
+/// By default tokens are held for as long as it takes a printing group to close or a line
+/// to fill, so very large zero-width groups or deep nesting can hold unbounded numbers of
+/// tokens.  With a limit, the pretty printer streams: memory is bounded, and every token is
+/// processed in constant amortized time regardless of the shape of the expression. The
+/// limit must allow at least a full line of tokens.
+/// \param val is the most tokens to hold, or 0 for no limit
+void EmitPrettyPrint::setMaxLookahead(int4 val)
+
+{
+  if ((val != 0)&&((val<maxlinesize)||(val>10000000)))
+    throw LowlevelError("Bad maximum lookahead");
+  maxlookahead = val;
+}
+
 void EmitPrettyPrint::setMaxLineSize(int4 val)
 
 {
   if ((val<20)||(val>10000))
     throw LowlevelError("Bad maximum line size");
   maxlinesize = val;
+  if ((maxlookahead != 0)&&(maxlookahead < val))
+    maxlookahead = val;
   scanqueue.setMax(3*val);
   tokqueue.setMax(3*val);
   spaceremain = maxlinesize;
@@ -15,6 +15,7 @@
  */
 #include "printc.hh"
 #include "funcdata.hh"
+#include "tracespan.hh"
 
 namespace GhidraDec {
 // Operator tokens for expressions
@@ -1002,16 +1003,49 @@ void PrintC::push_integer(uintb val,int4 sz,bool sign,
     displayFormat = (PrintLanguage::mostNaturalBase(val)==16) ? Symbol::force_hex : Symbol::force_dec;
   }
 
+  if (displayFormat == Symbol::force_hex || displayFormat == Symbol::force_dec || displayFormat == Symbol::force_oct) {
+    // The common formats are written straight into a local buffer, short enough that the
+    // token string doesn't need the heap either
+    char buf[32];
+    char *end = buf + sizeof(buf);
+    char *ptr = end;
+    if (force_unsigned_token)
+      *--ptr = 'U';
+    if (displayFormat == Symbol::force_hex) {
+      do {
+	*--ptr = "0123456789abcdef"[val & 15];
+	val >>= 4;
+      } while(val != 0);
+      *--ptr = 'x';
+      *--ptr = '0';
+    }
+    else if (displayFormat == Symbol::force_dec) {
+      do {
+	*--ptr = (char)('0' + val % 10);
+	val /= 10;
+      } while(val != 0);
+    }
+    else {
+      do {
+	*--ptr = (char)('0' + (val & 7));
+	val >>= 3;
+      } while(val != 0);
+      *--ptr = '0';
+    }
+    if (print_negsign)
+      *--ptr = '-';
+    std::string tok(ptr,end-ptr);
+    if (vn==(const Varnode *)0)
+      pushAtom(Atom(tok,syntax,EmitXml::const_color,op));
+    else
+      pushAtom(Atom(tok,vartoken,EmitXml::const_color,op,vn));
+    return;
+  }
+
   std::ostringstream t;
   if (print_negsign)
     t << '-';
-  if (displayFormat == Symbol::force_hex)
-    t << hex << "0x" << val;
-  else if (displayFormat == Symbol::force_dec)
-    t << dec << val;
-  else if (displayFormat == Symbol::force_oct)
-    t << oct << '0' << val;
-  else if (displayFormat == Symbol::force_char) {
+  if (displayFormat == Symbol::force_char) {
     int4 internalSize = 4;
     if (val < 256)
       internalSize = 1;
@@ -1550,6 +1584,7 @@ void PrintC::pushSymbol(const Symbol *sym,const Varnode *vn,const PcodeOp *op)
   else
     tokenColor = EmitXml::var_color;
   // FIXME: resolve scopes
+  noteSymbolName(sym,sym->getName());
   pushAtom(Atom(sym->getName(),vartoken,tokenColor,op,vn));
 }
 
@@ -1663,6 +1698,7 @@ void PrintC::pushMismatchSymbol(const Symbol *sym,int4 off,int4 sz,
   // We prepend an underscore to indicate a close
   // but not quite match
     std::string name = '_'+sym->getName();
+    noteSymbolName(sym,name);
     pushAtom(Atom(name,vartoken,EmitXml::var_color,op,vn));
   }
   else
@@ -2187,6 +2223,8 @@ void PrintC::docSingleGlobal(const Symbol *sym)
 void PrintC::docFunction(const Funcdata *fd)
 
 {
+  static const int4 traceid = TraceLog::registerKind("docFunction","print");
+  TraceSpan span(traceid,&fd->getName());
   uint4 modsave = mods;
   if (!fd->isProcStarted())
     throw RecovError("Function not decompiled");
@@ -2194,6 +2232,7 @@ void PrintC::docFunction(const Funcdata *fd)
     throw RecovError("Function not fully decompiled. No structure present.");
   try {
     commsorter.setupFunctionList(instr_comment_type|head_comment_type,fd,*fd->getArch()->commentdb,option_unplaced);
+    startRetainTokens();
     int4 id1 = emit->beginFunction(fd);
     emitCommentFuncHeader(fd);
     emit->tagLine();
@@ -2213,6 +2252,7 @@ void PrintC::docFunction(const Funcdata *fd)
     emit->tagLine();
     emit->endFunction(id1);
     emit->flush();
+    finishRetainTokens(fd);
 #ifdef CPUI_DEBUG
     if ((mods != modsave)||(!isModStackEmpty()))
       throw RecovError("Printing modification stack has not been purged");
@@ -2240,7 +2280,7 @@ void PrintC::emitBlockBasic(const BlockBasic *bb)
   }
   else {
     separator = false;
-    list<PcodeOp *>::const_iterator iter;
+    PcodeOpList::const_iterator iter;
     for(iter=bb->beginOp();iter!=bb->endOp();++iter) {
       inst = *iter;
       if (inst->notPrinted()) continue;
@@ -2655,6 +2695,7 @@ void PrintC::emitLabel(const FlowBlock *bl)
       const Scope *scope = ((const BlockBasic *)bb)->getFuncdata()->getScopeLocal();
       Symbol *sym = scope->queryCodeLabel(addr);
       if (sym != (Symbol *)0) {
+	noteSymbolName(sym,sym->getName());
 	emit->tagLabel(sym->getName().c_str(),EmitXml::no_color,spc,off);
 	return;
       }
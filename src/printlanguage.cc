@@ -116,6 +116,10 @@ PrintLanguage::PrintLanguage(Architecture *g,const string &nm)
   mods = 0;
   pending = 0;
   line_commentindent = 20;
+  retaintokens = false;
+  noting = false;
+  retainfd = (const Funcdata *)0;
+  retainstamp = 0;
   instr_comment_type = Comment::user2 | Comment::warning;
   head_comment_type = Comment::header | Comment::warningheader;
 }
@@ -740,6 +744,33 @@ void PrintLanguage::setXML(bool val)
   ((EmitPrettyPrint *)emit)->setXML(val);
 }
 
+/// Tell the emitter whether plain text output should be collected in a buffer
+/// and written to the stream at the end of each document, instead of token by token.
+/// \param val is \b true to buffer the output
+void PrintLanguage::setBuffered(bool val)
+
+{
+  ((EmitPrettyPrint *)emit)->setBuffered(val);
+}
+
+/// With a limit, the emitter streams, breaking groups that grow past it, so that its memory
+/// is bounded however large an expression is.
+/// \param val is the most tokens to hold, or 0 for no limit
+void PrintLanguage::setMaxLookahead(int4 val)
+
+{
+  ((EmitPrettyPrint *)emit)->setMaxLookahead(val);
+}
+
+/// Tell the XML emitter whether to mark up every token, or only the breaks between lines
+/// with the text of each line in a single element.
+/// \param val is \b true for line markup only
+void PrintLanguage::setLineXml(bool val)
+
+{
+  ((EmitPrettyPrint *)emit)->setLineXml(val);
+}
+
 /// Emitting formal code structuring can be turned off, causing all control-flow
 /// to be represented as \e goto statements and \e labels.
 /// \param val is \b true if no code structuring should be emitted
@@ -750,6 +781,118 @@ void PrintLanguage::setFlat(bool val)
     mods |= flat;
   else
     mods &= ~flat;
+  dropRetainedTokens();		// Kept tokens have the old structure
+}
+
+/// If the token stream is kept, redisplayFunction() can emit the last function again after
+/// Symbols have been renamed, without traversing its syntax tree.
+/// \param val is \b true if the token stream of each function emitted should be kept
+void PrintLanguage::setRetainTokens(bool val)
+
+{
+  retaintokens = val;
+  if (!val)
+    dropRetainedTokens();
+}
+
+void PrintLanguage::dropRetainedTokens(void)
+
+{
+  ((EmitPrettyPrint *)emit)->clearRecording();
+  noting = false;
+  retainfd = (const Funcdata *)0;
+  retainnames.clear();
+}
+
+/// The token will be matched up with the Symbol once the function has been emitted, so
+/// that it can be patched if the Symbol is renamed.
+/// \param sym is the Symbol whose name the token displays
+/// \param text is the characters of the token, which must end with the name
+void PrintLanguage::noteSymbolName(const Symbol *sym,const string &text)
+
+{
+  if (!noting) return;
+  retainnames.emplace_back();
+  RetainedName &rn(retainnames.back());
+  rn.index = -1;
+  rn.sym = sym;
+  rn.text = text;
+  rn.name = sym->getName();
+  rn.type = sym->getType();
+  rn.format = sym->getDisplayFormat();
+}
+
+/// Any previously kept stream is thrown away.  This does nothing unless setRetainTokens()
+/// has been turned on.
+void PrintLanguage::startRetainTokens(void)
+
+{
+  dropRetainedTokens();
+  if (!retaintokens) return;
+  ((EmitPrettyPrint *)emit)->startRecording();
+  noting = true;
+}
+
+/// Each noted Symbol name is matched, in order, with the next variable or label token
+/// having the same characters.  If any name is left unmatched, some token could not be
+/// patched after a rename, so the stream is not kept.
+/// \param fd is the function that was emitted
+void PrintLanguage::finishRetainTokens(const Funcdata *fd)
+
+{
+  if (!noting) return;
+  EmitPrettyPrint *pretty = (EmitPrettyPrint *)emit;
+  pretty->stopRecording();
+  noting = false;
+  const vector<TokenSplit> &rec(pretty->getRecording());
+  int4 j = 0;
+  for(int4 i=0;i<rec.size();++i) {
+    if (j == retainnames.size()) break;
+    TokenSplit::tag_type tag = rec[i].getTag();
+    if (tag != TokenSplit::vari_t && tag != TokenSplit::label_t) continue;
+    if (rec[i].getText() != retainnames[j].text) continue;
+    retainnames[j].index = i;
+    j += 1;
+  }
+  if (j != retainnames.size()) {
+    dropRetainedTokens();
+    return;
+  }
+  retainfd = fd;
+  retainstamp = fd->getModificationCount();
+}
+
+/// If the kept token stream belongs to the given function, and the function has not been
+/// modified since, the names displayed for renamed Symbols are patched and the stream is
+/// sent through line breaking again.  The action pipeline and the syntax tree traversal
+/// are skipped.  If any displayed Symbol has changed its data-type or display format, the
+/// stream is thrown away as the function needs to be emitted in full.
+/// \param fd is the function to emit
+/// \return \b true if the function was emitted from the kept stream
+bool PrintLanguage::redisplayFunction(const Funcdata *fd)
+
+{
+  if (retainfd == (const Funcdata *)0 || retainfd != fd || retainstamp != fd->getModificationCount())
+    return false;
+  for(int4 i=0;i<retainnames.size();++i) {
+    const RetainedName &rn(retainnames[i]);
+    if (rn.sym->getType() != rn.type || rn.sym->getDisplayFormat() != rn.format) {
+      dropRetainedTokens();
+      return false;
+    }
+  }
+  EmitPrettyPrint *pretty = (EmitPrettyPrint *)emit;
+  vector<TokenSplit> &rec(pretty->getRecording());
+  for(int4 i=0;i<retainnames.size();++i) {
+    RetainedName &rn(retainnames[i]);
+    const string &newname(rn.sym->getName());
+    if (newname == rn.name) continue;
+    rn.text = rn.text.substr(0,rn.text.size()-rn.name.size()) + newname;
+    rn.name = newname;
+    rec[rn.index].setText(rn.text);
+  }
+  pretty->replay();
+  return true;
 }
 
 void PrintLanguage::clear(void)
@@ -768,6 +911,7 @@ void PrintLanguage::clear(void)
   pending = 0;
 
   nodepend.clear();
+  dropRetainedTokens();
 }
 
 /// This determines how integers are displayed by default. Possible
@@ -788,6 +932,7 @@ void PrintLanguage::setIntegerFormat(const string &nm)
     throw LowlevelError("Unknown integer format option: "+nm);
   mods &= ~((uint4)(force_hex|force_dec)); // Turn off any pre-existing force
   mods |= mod;			// Set any new force
+  dropRetainedTokens();
 }
 
 /// Count '0' and '9' digits base 10. Count '0' and 'f' digits base 16.
@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 #include "rangeutil.hh"
+#include "funcdata.hh"
 
 namespace GhidraDec {
 const char CircleRange::arrange[] = "gcgbegdagggggggeggggcgbggggggggcdfgggggggegdggggbgggfggggcgbegda";
@@ -163,6 +164,19 @@ CircleRange::CircleRange(uintb val,int4 size)
   isempty = false;
 }
 
+/// The stride is set to 1.
+/// \param size is the size of the values in bytes
+void CircleRange::setFull(int4 size)
+
+{
+  mask = calc_mask(size);
+  shift = 0;
+  step = 1;
+  left = 0;
+  right = 0;
+  isempty = false;
+}
+
 /// \return the number of integers contained in this range
 uintb CircleRange::getSize(void) const
 
@@ -798,6 +812,333 @@ Varnode *CircleRange::pullBack(PcodeOp *op,Varnode **constMarkup,bool usenzmask)
   return res;
 }
 
+/// \brief Get the smallest and largest unsigned values in a range
+///
+/// This fails if the range wraps around from the largest value to zero, in which case the
+/// bounds would cover everything.
+/// \param range is the given range, which must not be empty
+/// \param mn will hold the smallest value
+/// \param mx will hold the largest value
+/// \return \b true if the range does not wrap
+static bool unsignedBounds(const CircleRange &range,uintb &mn,uintb &mx)
+
+{
+  if (range.getMin() == range.getEnd()) {	// Everything (at the stride)
+    mn = 0;
+    mx = range.getMask();
+    return true;
+  }
+  if ((range.getMin() < range.getEnd())||(range.getEnd() == 0)) {
+    mn = range.getMin();
+    mx = range.getMax();
+    return true;
+  }
+  return false;
+}
+
+/// Set \b this to the range of values produced by the given operation, when its input
+/// takes values in the given range.  If the result cannot be represented (or the operation is
+/// not understood), \b false is returned and \b this is left in an undefined state.
+/// \param opc is the OpCode of the operation
+/// \param in1 is the range of the input
+/// \param inSize is the size of the input in bytes
+/// \param outSize is the size of the output in bytes
+/// \return \b true if \b this was successfully set
+bool CircleRange::pushForwardUnary(OpCode opc,const CircleRange &in1,int4 inSize,int4 outSize)
+
+{
+  if (in1.isempty) {
+    isempty = true;
+    return true;
+  }
+  uintb outmask = calc_mask(outSize);
+  switch(opc) {
+  case CPUI_COPY:
+    *this = in1;
+    return true;
+  case CPUI_INT_ZEXT:
+    {
+      uintb inmask = calc_mask(inSize);
+      uintb mn,mx;
+      if (!unsignedBounds(in1,mn,mx)) {	// Wrapping range covers both ends of the smaller space
+	mn = 0;
+	mx = in1.mask;
+      }
+      mask = outmask & (outmask << in1.shift);	// Preserve the stride
+      step = in1.step;
+      shift = in1.shift;
+      left = mn;
+      right = (mx + step) & mask;
+      isempty = false;
+      return (mx <= inmask);
+    }
+  case CPUI_INT_SEXT:
+    {
+      uintb inmask = calc_mask(inSize);
+      uintb signmin = inmask ^ (inmask >> 1);
+      uintb mn,mx;
+      if (in1.left == in1.right) {	// Everything at the stride
+	mn = signmin;
+	mx = (inmask >> 1) & in1.mask;
+      }
+      else {
+	mn = in1.left;
+	mx = in1.getMax();
+	if (((mn - signmin)&inmask) > ((mx - signmin)&inmask))
+	  return false;		// Range crosses from positive to negative values
+      }
+      mask = outmask & (outmask << in1.shift);
+      step = in1.step;
+      shift = in1.shift;
+      left = sign_extend(mn,inSize,outSize);
+      right = (sign_extend(mx,inSize,outSize) + step) & mask;
+      isempty = false;
+      return true;
+    }
+  case CPUI_INT_2COMP:
+    *this = in1;
+    if (left != right) {
+      uintb val = (~left + 1 + step) & mask;
+      left = (~right + 1 + step) & mask;
+      right = val;
+    }
+    return true;
+  case CPUI_INT_NEGATE:
+    if (in1.step != 1) return false;	// Flipping the low bits breaks the stride
+    *this = in1;
+    if (left != right) {
+      uintb val = (~left + 1) & mask;
+      left = (~right + 1) & mask;
+      right = val;
+    }
+    return true;
+  case CPUI_BOOL_NEGATE:
+    if (in1.isSingle())
+      *this = CircleRange((uintb)(in1.left == 0 ? 1 : 0),outSize);
+    else
+      *this = CircleRange(0,1,outmask);
+    return true;
+  default:
+    break;
+  }
+  return false;
+}
+
+/// Set \b this to the range of values produced by the given operation, when its inputs
+/// take values in the given ranges.  If the result cannot be represented (or the operation is
+/// not understood), \b false is returned and \b this is left in an undefined state.
+/// \param opc is the OpCode of the operation
+/// \param in1 is the range of the first input
+/// \param in2 is the range of the second input
+/// \param inSize is the size of the first input in bytes
+/// \param outSize is the size of the output in bytes
+/// \return \b true if \b this was successfully set
+bool CircleRange::pushForwardBinary(OpCode opc,const CircleRange &in1,const CircleRange &in2,int4 inSize,int4 outSize)
+
+{
+  if (in1.isempty || in2.isempty) {
+    isempty = true;
+    return true;
+  }
+  uintb outmask = calc_mask(outSize);
+  uintb mn1,mx1,mn2,mx2;
+  switch(opc) {
+  case CPUI_INT_SUB:
+    {
+      CircleRange neg;
+      neg.pushForwardUnary(CPUI_INT_2COMP,in2,inSize,outSize);
+      return pushForwardBinary(CPUI_INT_ADD,in1,neg,inSize,outSize);
+    }
+  case CPUI_INT_ADD:
+    {
+      if ((in1.left == in1.right)||(in2.left == in2.right)) return false;
+      uintb width1 = (in1.getMax() - in1.left) & in1.mask;
+      uintb width2 = (in2.getMax() - in2.left) & in2.mask;
+      if (width1 >= outmask - width2) return false;	// Sum can take every value
+      mask = in1.mask | in2.mask;	// The smaller of the two strides
+      calcStepShift();
+      left = (in1.left + in2.left) & mask;
+      right = (left + width1 + width2 + step) & mask;
+      isempty = false;
+      return true;
+    }
+  case CPUI_INT_MULT:
+  case CPUI_INT_LEFT:
+    {
+      const CircleRange *vals = &in1;
+      const CircleRange *con = &in2;
+      if (opc == CPUI_INT_MULT && !in2.isSingle() && in1.isSingle()) {
+	vals = &in2;
+	con = &in1;
+      }
+      if (!con->isSingle()) return false;
+      uintb c = con->left;
+      if (opc == CPUI_INT_LEFT) {
+	if (c >= 8*outSize) {
+	  *this = CircleRange((uintb)0,outSize);
+	  return true;
+	}
+	c = ((uintb)1) << c;
+      }
+      if (c == 0) {
+	*this = CircleRange((uintb)0,outSize);
+	return true;
+      }
+      if (!unsignedBounds(*vals,mn1,mx1)) return false;
+      if (mx1 > outmask / c) return false;	// Product may overflow
+      mask = outmask;
+      if ((c & (c-1)) == 0)
+	mask &= vals->mask * c;		// Multiplying by a power of 2 multiplies the stride
+      calcStepShift();
+      left = mn1 * c;
+      right = (mx1 * c + step) & mask;
+      isempty = false;
+      return true;
+    }
+  case CPUI_INT_RIGHT:
+    {
+      if (!in2.isSingle()) return false;
+      uintb sa = in2.left;
+      if (sa >= 8*inSize) {
+	*this = CircleRange((uintb)0,outSize);
+	return true;
+      }
+      if (!unsignedBounds(in1,mn1,mx1)) {
+	mn1 = 0;
+	mx1 = in1.mask;
+      }
+      mask = outmask;
+      step = 1;
+      shift = 0;
+      left = mn1 >> sa;
+      right = ((mx1 >> sa) + 1) & mask;
+      isempty = false;
+      return true;
+    }
+  case CPUI_INT_AND:
+    {
+      const CircleRange *vals = &in1;
+      const CircleRange *con = &in2;
+      if (!in2.isSingle() && in1.isSingle()) {
+	vals = &in2;
+	con = &in1;
+      }
+      if (!con->isSingle()) return false;
+      uintb c = con->left;
+      if (!setNZMask(c,outSize)) {	// Result has no bits outside the constant
+	mask = outmask;
+	step = 1;
+	shift = 0;
+	left = 0;
+	right = (c + 1) & mask;
+	isempty = false;
+      }
+      if (unsignedBounds(*vals,mn1,mx1) && (mx1 < c) && (vals->step == 1)) {
+	left = 0;			// Result is also no bigger than the other input
+	right = mx1 + 1;
+	mask = outmask;
+	step = 1;
+	shift = 0;
+      }
+      return true;
+    }
+  case CPUI_INT_DIV:
+    {
+      if (!in2.isSingle() || in2.left == 0) return false;
+      if (!unsignedBounds(in1,mn1,mx1)) {
+	mn1 = 0;
+	mx1 = in1.mask;
+      }
+      mask = outmask;
+      step = 1;
+      shift = 0;
+      left = mn1 / in2.left;
+      right = (mx1 / in2.left + 1) & mask;
+      isempty = false;
+      return true;
+    }
+  case CPUI_INT_REM:
+    {
+      if (!in2.isSingle() || in2.left == 0) return false;
+      uintb mx = in2.left - 1;
+      if (unsignedBounds(in1,mn1,mx1) && mx1 < mx)
+	mx = mx1;
+      mask = outmask;
+      step = 1;
+      shift = 0;
+      left = 0;
+      right = (mx + 1) & mask;
+      isempty = false;
+      return true;
+    }
+  case CPUI_SUBPIECE:
+    {
+      if (!in2.isSingle()) return false;
+      uintb sa = in2.left * 8;
+      if (sa >= 8*sizeof(uintb)) return false;
+      if (unsignedBounds(in1,mn1,mx1) && (in1.left != in1.right) && ((mx1 >> sa) <= outmask)) {
+	mask = (sa == 0) ? (outmask & in1.mask) : outmask;
+	calcStepShift();
+	left = (mn1 >> sa) & mask;
+	right = ((mx1 >> sa) + step) & mask;
+	isempty = false;
+	return true;
+      }
+      if (sa != 0) return false;
+      mask = outmask & in1.mask;	// Truncating preserves the low bits, and so the stride
+      if (mask == 0) return false;
+      calcStepShift();
+      left = 0;
+      right = 0;
+      isempty = false;
+      return true;
+    }
+  case CPUI_INT_EQUAL:
+  case CPUI_INT_NOTEQUAL:
+    {
+      bool res;
+      if (in1.isSingle() && in2.isSingle())
+	res = (in1.left == in2.left);
+      else {
+	CircleRange tmp(in1);
+	if (tmp.intersect(in2) != 0 || !tmp.isEmpty()) {
+	  *this = CircleRange(0,1,outmask);	// Either result is possible
+	  return true;
+	}
+	res = false;			// Ranges are disjoint
+      }
+      if (opc == CPUI_INT_NOTEQUAL)
+	res = !res;
+      *this = CircleRange((uintb)(res ? 1 : 0),outSize);
+      return true;
+    }
+  case CPUI_INT_LESS:
+  case CPUI_INT_LESSEQUAL:
+    {
+      if (!unsignedBounds(in1,mn1,mx1) || !unsignedBounds(in2,mn2,mx2)) return false;
+      bool alwaystrue,alwaysfalse;
+      if (opc == CPUI_INT_LESS) {
+	alwaystrue = (mx1 < mn2);
+	alwaysfalse = (mn1 >= mx2);
+      }
+      else {
+	alwaystrue = (mx1 <= mn2);
+	alwaysfalse = (mn1 > mx2);
+      }
+      if (alwaystrue)
+	*this = CircleRange((uintb)1,outSize);
+      else if (alwaysfalse)
+	*this = CircleRange((uintb)0,outSize);
+      else
+	*this = CircleRange(0,1,outmask);
+      return true;
+    }
+  default:
+    break;
+  }
+  return false;
+}
+
 /// Recover parameters for a comparison PcodeOp, that returns true for
 /// input values exactly in \b this range.
 /// Return:
@@ -853,4 +1194,163 @@ int4 CircleRange::translate2Op(OpCode &opc,uintb &c,int4 &cslot) const
   }
   return 2;			// Cannot represent
 }
+
+/// \param s is the stream to write to
+void CircleRange::printRaw(ostream &s) const
+
+{
+  if (isempty) {
+    s << "(empty)";
+    return;
+  }
+  if (left == right) {
+    s << "(full)";
+  }
+  else
+    s << '[' << hex << "0x" << left << ",0x" << right << ')';
+  if (step != 1)
+    s << " step=" << dec << step;
+}
+
+/// Only integer-sized Varnodes that are not annotations have a calculated range.
+/// \param vn is the given Varnode
+/// \return \b true if the Varnode is tracked
+bool ValueRangeCache::isTracked(const Varnode *vn)
+
+{
+  if (vn->isAnnotation()) return false;
+  return (vn->getSize() <= sizeof(uintb));
+}
+
+/// Constants are their own value.  A Varnode that is written but has no range yet
+/// is assumed to produce nothing (optimistically), and any other Varnode can take any value.
+/// \param vn is the input Varnode, which must be tracked
+/// \return the current range for the Varnode
+CircleRange ValueRangeCache::inputRange(const Varnode *vn) const
+
+{
+  if (vn->isConstant())
+    return CircleRange(vn->getOffset(),vn->getSize());
+  map<uint4,Entry>::const_iterator iter = ranges.find(vn->getCreateIndex());
+  if (iter != ranges.end())
+    return (*iter).second.range;
+  CircleRange res;
+  if (!vn->isWritten())
+    res.setFull(vn->getSize());
+  return res;
+}
+
+/// The ranges of the inputs are pushed through the op, and the result is merged into
+/// the current range of the output, so that ranges only ever grow.
+/// \param op is the PcodeOp
+/// \return \b true if the range of the output changed
+bool ValueRangeCache::processOp(PcodeOp *op)
+
+{
+  Varnode *outvn = op->getOut();
+  int4 outSize = outvn->getSize();
+  CircleRange res;
+  bool success = false;
+  if (op->code() == CPUI_MULTIEQUAL) {
+    success = true;
+    for(int4 i=0;i<op->numInput();++i) {
+      if (res.circleUnion(inputRange(op->getIn(i))) != 0) {
+	success = false;
+	break;
+      }
+    }
+  }
+  else if (op->numInput() == 1) {
+    Varnode *in0 = op->getIn(0);
+    if (isTracked(in0))
+      success = res.pushForwardUnary(op->code(),inputRange(in0),in0->getSize(),outSize);
+  }
+  else if (op->numInput() == 2) {
+    Varnode *in0 = op->getIn(0);
+    Varnode *in1 = op->getIn(1);
+    if (isTracked(in0) && isTracked(in1))
+      success = res.pushForwardBinary(op->code(),inputRange(in0),inputRange(in1),in0->getSize(),outSize);
+  }
+  if (!success) {
+    if (op->isBoolOutput())
+      res = CircleRange(0,1,calc_mask(outSize));
+    else
+      res.setFull(outSize);
+  }
+  Entry &entry( ranges[outvn->getCreateIndex()] );
+  if (entry.range.isEmpty()) {
+    if (res.isEmpty()) return false;
+  }
+  else {
+    if (entry.range.contains(res)) return false;
+    if (res.circleUnion(entry.range) != 0)
+      res.setFull(outSize);
+  }
+  entry.updates += 1;
+  if (entry.updates > widenlimit)
+    res.setFull(outSize);	// Widen a range that keeps growing
+  entry.range = res;
+  return true;
+}
+
+/// Every op with a tracked output is processed once, and then again whenever the range of
+/// one of its inputs grows.
+/// \param fd is the function
+void ValueRangeCache::calculate(Funcdata &fd)
+
+{
+  vector<PcodeOp *> worklist;
+  list<PcodeOp *>::const_iterator iter;
+
+  ranges.clear();
+  for(iter=fd.beginOpAlive();iter!=fd.endOpAlive();++iter) {
+    PcodeOp *op = *iter;
+    Varnode *outvn = op->getOut();
+    if (outvn == (Varnode *)0 || !isTracked(outvn)) continue;
+    op->setMark();
+    worklist.push_back(op);
+  }
+  reverse(worklist.begin(),worklist.end());	// Start with ops in their original order
+  while(!worklist.empty()) {
+    PcodeOp *op = worklist.back();
+    worklist.pop_back();
+    op->clearMark();
+    if (!processOp(op)) continue;
+    Varnode *outvn = op->getOut();
+    DescendList::const_iterator diter;
+    for(diter=outvn->beginDescend();diter!=outvn->endDescend();++diter) {
+      PcodeOp *readop = *diter;
+      if (readop->isMark()) continue;
+      Varnode *readout = readop->getOut();
+      if (readout == (Varnode *)0 || !isTracked(readout)) continue;
+      readop->setMark();
+      worklist.push_back(readop);
+    }
+  }
+}
+
+/// If the function has changed since the ranges were last calculated, they are all
+/// recalculated first.
+/// \param fd is the function containing the Varnode
+/// \param vn is the Varnode
+/// \return the range of values the Varnode can hold
+CircleRange ValueRangeCache::getRange(Funcdata &fd,const Varnode *vn)
+
+{
+  CircleRange res;
+  if (!isTracked(vn)) {
+    res.setFull(sizeof(uintb));
+    return res;
+  }
+  if ((!valid) || (modcount != fd.getModificationCount())) {
+    calculate(fd);
+    modcount = fd.getModificationCount();
+    valid = true;
+  }
+  res = inputRange(vn);
+  if (res.isEmpty())		// The value is never produced
+    res.setFull(vn->getSize());
+  return res;
+}
+
 }
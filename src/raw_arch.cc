@@ -49,17 +49,27 @@ bool RawBinaryArchitectureCapability::isXmlMatch(Document *doc) const
   return (doc->getRoot()->getName() == "raw_savefile");
 }
 
+/// If a region map named after the image, with the extension \e .regions, is present, the
+/// image is loaded as a LoadImageRegions.  Otherwise the whole file is mapped at a single base.
 void RawBinaryArchitecture::buildLoader(DocumentStorage &store)
 
 {
-  RawLoadImage *ldr;
-
   collectSpecFiles(*errorstream);
-  ldr = new RawLoadImage(getFilename());
-  ldr->open();
+  string mapfile = getFilename() + ".regions";
+  ifstream s(mapfile.c_str());
+  if (s) {
+    s.close();
+    LoadImageRegions *ldr = new LoadImageRegions(getFilename());
+    loader = ldr;
+    ldr->open(mapfile);
+  }
+  else {
+    LoadImageMmap *ldr = new LoadImageMmap(getFilename());
+    loader = ldr;
+    ldr->open();
+  }
   if (adjustvma != 0)
-    ldr->adjustVma(adjustvma);
-  loader = ldr;
+    loader->adjustVma(adjustvma);
 }
 
 void RawBinaryArchitecture::resolveArchitecture(void)
@@ -72,7 +82,11 @@ void RawBinaryArchitecture::resolveArchitecture(void)
 void RawBinaryArchitecture::postSpecFile(void)
 
 {
-  ((RawLoadImage *)loader)->attachToSpace(getDefaultSpace());	 // Attach default space to loader
+  LoadImageRegions *regionldr = dynamic_cast<LoadImageRegions *>(loader);
+  if (regionldr != (LoadImageRegions *)0)
+    regionldr->attachToSpace(getDefaultSpace());	// Attach default space to loader
+  else
+    ((LoadImageMmap *)loader)->attachToSpace(getDefaultSpace());
 }
 
 RawBinaryArchitecture::RawBinaryArchitecture(const string &fname,const string &targ,ostream *estream)
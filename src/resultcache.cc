@@ -0,0 +1,622 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "resultcache.hh"
+
+#include <fstream>
+#include <thread>
+#include <cstring>
+#ifndef _WINDOWS
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace GhidraDec {
+
+static const uint8 FNV_OFFSET = 0xcbf29ce484222325ULL;		// 64-bit FNV-1a offset basis
+static const uint8 FNV_PRIME = 0x100000001b3ULL;		// 64-bit FNV-1a prime
+
+const uint8 SharedResultStore::STORE_MAGIC = 0x3130535245434544ULL;	// "DECRES01" in little-endian byte order
+const uint8 SharedResultStore::STORE_BUSY = 1;
+
+static_assert(std::atomic<uint8>::is_always_lock_free,"Shared result store needs lock-free 64-bit atomics");
+
+/// \param g is the Architecture whose LoadImage should be wrapped
+LoadImageRecorder::LoadImageRecorder(Architecture *g)
+  : LoadImage(g->loader->getFileName())
+{
+  glb = g;
+  base = glb->loader;
+  glb->loader = this;
+}
+
+LoadImageRecorder::~LoadImageRecorder(void)
+
+{
+  glb->loader = base;
+}
+
+void LoadImageRecorder::loadFill(uint1 *ptr,int4 size,const Address &addr)
+
+{
+  base->loadFill(ptr,size,addr);
+  if (size > 0)
+    reads.insertRange(addr.getSpace(),addr.getOffset(),addr.getOffset() + (size - 1));
+}
+
+const uint1 *LoadImageRecorder::peek(int4 size,const Address &addr)
+
+{
+  const uint1 *res = base->peek(size,addr);
+  if (res != (const uint1 *)0 && size > 0)
+    reads.insertRange(addr.getSpace(),addr.getOffset(),addr.getOffset() + (size - 1));
+  return res;
+}
+
+/// \param c is the character being written
+/// \return the character, or EOF if the destination failed
+OutputRecorder::int_type OutputRecorder::overflow(int_type c)
+
+{
+  if (traits_type::eq_int_type(c,traits_type::eof()))
+    return traits_type::not_eof(c);
+  copy += traits_type::to_char_type(c);
+  return dest->sputc(traits_type::to_char_type(c));
+}
+
+/// \param s is the characters being written
+/// \param n is the number of characters
+/// \return the number of characters the destination accepted
+std::streamsize OutputRecorder::xsputn(const char *s,std::streamsize n)
+
+{
+  copy.append(s,n);
+  return dest->sputn(s,n);
+}
+
+/// The file is created if it doesn't exist, and sized (sparsely) to the given number of bytes.
+/// An existing store is used at the size it was created with.  If several processes open a new
+/// file at once, exactly one of them lays out the header and the others wait for it.
+/// \param fname is the path to the backing file
+/// \param sz is the size of the file to create
+SharedResultStore::SharedResultStore(const string &fname,uint8 sz)
+
+{
+  filename = fname;
+  base = (uint1 *)0;
+  size = 0;
+#ifdef _WINDOWS
+  throw LowlevelError("Shared result store is not supported on this platform");
+#else
+  uint8 numbuckets = 1 << 16;
+  uint8 logstart = (sizeof(Header) + 63) & ~((uint8)63);
+  logstart += numbuckets * sizeof(std::atomic<uint8>);
+  if (sz < logstart * 2)
+    throw LowlevelError("Shared result store is too small");
+  int fd = open(fname.c_str(),O_RDWR | O_CREAT,0666);
+  if (fd < 0)
+    throw LowlevelError("Unable to open shared result store " + fname);
+  struct stat st;
+  if (fstat(fd,&st) != 0) {
+    close(fd);
+    throw LowlevelError("Unable to open shared result store " + fname);
+  }
+  if (st.st_size == 0) {
+    if (ftruncate(fd,sz) != 0) {	// Concurrent creators all set the same size
+      close(fd);
+      throw LowlevelError("Unable to size shared result store " + fname);
+    }
+    size = sz;
+  }
+  else
+    size = st.st_size;
+  if (size < logstart * 2) {
+    close(fd);
+    throw LowlevelError("Not a shared result store: " + fname);
+  }
+  void *map = mmap((void *)0,size,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+  close(fd);
+  if (map == MAP_FAILED)
+    throw LowlevelError("Unable to map shared result store " + fname);
+  base = (uint1 *)map;
+  header = (Header *)base;
+  buckets = (std::atomic<uint8> *)(base + ((sizeof(Header) + 63) & ~((uint8)63)));
+  uint8 state = 0;
+  if (header->magic.compare_exchange_strong(state,STORE_BUSY)) {	// The file is new and we lay it out
+    header->size = size;
+    header->numbuckets = numbuckets;
+    header->logstart = logstart;
+    header->tail.store(logstart);
+    header->magic.store(STORE_MAGIC,std::memory_order_release);
+    return;
+  }
+  while(state == STORE_BUSY) {		// Another process is laying the file out
+    std::this_thread::yield();
+    state = header->magic.load(std::memory_order_acquire);
+  }
+  if (state != STORE_MAGIC || header->size != size || header->numbuckets != numbuckets || header->logstart != logstart) {
+    munmap(base,size);
+    throw LowlevelError("Not a shared result store: " + fname);
+  }
+#endif
+}
+
+SharedResultStore::~SharedResultStore(void)
+
+{
+#ifndef _WINDOWS
+  if (base != (uint1 *)0)
+    munmap(base,size);
+#endif
+}
+
+/// Records are returned newest first.
+/// \param key is the input key
+/// \param hashes will hold the full hash of each record for the key
+/// \param ranges will hold the encoded ranges of each record for the key
+/// \return \b true if there is at least one record
+bool SharedResultStore::find(uint8 key,vector<uint8> &hashes,vector<string> &ranges) const
+
+{
+  uint8 off = buckets[key & (header->numbuckets - 1)].load(std::memory_order_acquire);
+  while(off != 0) {
+    const Record *rec = getRecord(off);
+    if (rec->key == key) {
+      hashes.push_back(rec->hash);
+      ranges.push_back(string((const char *)(rec + 1),rec->rangesize));
+    }
+    off = rec->next;
+  }
+  return !hashes.empty();
+}
+
+/// \param key is the input key of the record
+/// \param hash is the full hash of the record
+/// \param output will hold the output of the record
+/// \return \b true if the record was found
+bool SharedResultStore::read(uint8 key,uint8 hash,string &output) const
+
+{
+  uint8 off = buckets[key & (header->numbuckets - 1)].load(std::memory_order_acquire);
+  while(off != 0) {
+    const Record *rec = getRecord(off);
+    if (rec->key == key && rec->hash == hash) {
+      output.assign((const char *)(rec + 1) + rec->rangesize,rec->outputsize);
+      return true;
+    }
+    off = rec->next;
+  }
+  return false;
+}
+
+/// Space is reserved at the tail of the log, the record is copied in, and it is then linked
+/// in at the head of its bucket.  A record already present for the same key and full hash is
+/// not added again.
+/// \param key is the input key of the record
+/// \param hash is the full hash of the record
+/// \param ranges are the encoded ranges the result depends on
+/// \param output is the result
+/// \return \b true if the record was added
+bool SharedResultStore::append(uint8 key,uint8 hash,const string &ranges,const string &output)
+
+{
+  string existing;
+  if (read(key,hash,existing)) return false;
+  if (ranges.size() > 0xffffffff || output.size() > 0xffffffff) return false;
+  uint8 total = (sizeof(Record) + ranges.size() + output.size() + 7) & ~((uint8)7);
+  if (isFull() || total > size) return false;
+  uint8 off = header->tail.fetch_add(total);
+  if (off + total > size) return false;		// Out of room, the tail stays past the end
+  Record *rec = (Record *)(base + off);
+  rec->key = key;
+  rec->hash = hash;
+  rec->rangesize = ranges.size();
+  rec->outputsize = output.size();
+  memcpy((uint1 *)(rec + 1),ranges.data(),ranges.size());
+  memcpy((uint1 *)(rec + 1) + ranges.size(),output.data(),output.size());
+  std::atomic<uint8> &head(buckets[key & (header->numbuckets - 1)]);
+  uint8 next = head.load(std::memory_order_relaxed);
+  do {
+    rec->next = next;
+  } while(!head.compare_exchange_weak(next,off,std::memory_order_release,std::memory_order_relaxed));
+  return true;
+}
+
+/// \param hash is the hash being accumulated
+/// \param ptr points to the bytes to fold in
+/// \param size is the number of bytes
+void ResultCache::hashBytes(uint8 &hash,const uint1 *ptr,int4 size)
+
+{
+  for(int4 i=0;i<size;++i) {
+    hash ^= ptr[i];
+    hash *= FNV_PRIME;
+  }
+}
+
+/// The length is folded in first, so that adjacent strings can't run together.
+/// \param hash is the hash being accumulated
+/// \param str is the string to fold in
+void ResultCache::hashString(uint8 &hash,const string &str)
+
+{
+  uint1 len[4];
+  len[0] = str.size() & 0xff;
+  len[1] = (str.size() >> 8) & 0xff;
+  len[2] = (str.size() >> 16) & 0xff;
+  len[3] = (str.size() >> 24) & 0xff;
+  hashBytes(hash,len,4);
+  hashBytes(hash,(const uint1 *)str.data(),str.size());
+}
+
+/// \param val is the hash value
+/// \return the value as 16 hexadecimal digits
+string ResultCache::hexName(uint8 val)
+
+{
+  ostringstream s;
+  s << hex << setfill('0') << setw(16) << val;
+  return s.str();
+}
+
+/// \param g is the Architecture being decompiled
+/// \param dir is the directory holding the cache files, or an empty string to keep results in memory
+ResultCache::ResultCache(Architecture *g,const string &dir)
+
+{
+  glb = g;
+  directory = dir;
+  while(directory.size() > 1 && directory[directory.size()-1] == '/')
+    directory.erase(directory.size()-1);
+  shared = (SharedResultStore *)0;
+  hits = 0;
+  misses = 0;
+  memused = 0;
+  memlimit = 0;
+}
+
+/// \param g is the Architecture being decompiled
+/// \param store is the shared store, which \b this takes ownership of
+ResultCache::ResultCache(Architecture *g,SharedResultStore *store)
+
+{
+  glb = g;
+  shared = store;
+  hits = 0;
+  misses = 0;
+  memused = 0;
+  memlimit = 0;
+}
+
+ResultCache::~ResultCache(void)
+
+{
+  if (shared != (SharedResultStore *)0)
+    delete shared;
+}
+
+bool ResultCache::isFull(void) const
+
+{
+  if (shared != (SharedResultStore *)0)
+    return shared->isFull();
+  return (memlimit != 0 && memused >= memlimit);
+}
+
+/// The architecture id, the name of the current root Action, and the output language are
+/// always part of the key. The key must be computed before the function is decompiled, as
+/// decompilation changes the prototype of the function.
+/// \param fd is the function about to be decompiled
+/// \param config describes any other options of the caller that affect the output
+/// \return the input key
+uint8 ResultCache::hashInputs(Funcdata *fd,const string &config) const
+
+{
+  uint8 hash = FNV_OFFSET;
+  hashString(hash,glb->archid);
+  hashString(hash,glb->allacts.getCurrentName());
+  hashString(hash,glb->print->getName());
+  hashString(hash,config);
+  const Address &entry(fd->getAddress());
+  ostringstream s;
+  s << entry.getSpace()->getName() << ':' << hex << entry.getOffset() << ':' << dec << fd->getSize();
+  hashString(hash,s.str());
+  ostringstream proto;
+  fd->getFuncProto().saveXml(proto);
+  hashString(hash,proto.str());
+  ostringstream over;
+  fd->getOverride().saveXml(over,glb);
+  hashString(hash,over.str());
+  try {
+    const uintm *context = glb->context->getContext(entry);
+    hashBytes(hash,(const uint1 *)context,glb->context->getContextSize() * sizeof(uintm));
+  }
+  catch(LowlevelError &err) {
+    // The context database may not be able to report the whole context (e.g. ContextGhidra)
+  }
+  return hash;
+}
+
+/// \param key is the input key
+/// \param ranges are the ranges of bytes to fold in
+/// \param hash will hold the full hash
+/// \return \b true if all the bytes could be read
+bool ResultCache::hashRanges(uint8 key,const RangeList &ranges,uint8 &hash) const
+
+{
+  hash = key;
+  return hashLoadImage(glb->loader,ranges,hash);
+}
+
+/// The name of the space of each range is folded in along with its bytes.
+/// \param loader is the LoadImage to read the bytes from
+/// \param ranges are the ranges of bytes to fold in
+/// \param hash is the hash being accumulated
+/// \return \b true if all the bytes could be read
+bool ResultCache::hashLoadImage(LoadImage *loader,const RangeList &ranges,uint8 &hash)
+
+{
+  vector<uint1> buf;
+  set<Range>::const_iterator iter;
+  try {
+    for(iter=ranges.begin();iter!=ranges.end();++iter) {
+      uintb first = (*iter).getFirst();
+      uintb last = (*iter).getLast();
+      hashString(hash,(*iter).getSpace()->getName());
+      for(;;) {
+	uintb len = last - first;
+	int4 size = (len >= 4095) ? 4096 : (int4)(len + 1);
+	buf.resize(size);
+	loader->loadFill(buf.data(),size,Address((*iter).getSpace(),first));
+	hashBytes(hash,buf.data(),size);
+	if (len < 4096) break;
+	first += size;
+      }
+    }
+  }
+  catch(DataUnavailError &err) {
+    return false;
+  }
+  return true;
+}
+
+/// Each line of an index file holds one entry: the full hash followed by the number of ranges
+/// and, for each range, the name of its space and its first and last offsets.  Malformed lines
+/// are ignored.
+/// \param key is the input key
+/// \return the (possibly empty) list of entries for the key
+vector<ResultCache::Entry> &ResultCache::getIndex(uint8 key)
+
+{
+  map<uint8,vector<Entry> >::iterator iter = indices.find(key);
+  if (iter != indices.end())
+    return (*iter).second;
+  vector<Entry> &index(indices[key]);
+  if (directory.empty())
+    return index;
+  ifstream s(indexPath(key).c_str());
+  string line;
+  while(getline(s,line)) {
+    istringstream ls(line);
+    Entry entry;
+    ls >> hex >> entry.hash;
+    if (!ls) continue;
+    if (decodeRanges(ls,entry.ranges))
+      index.push_back(entry);
+  }
+  return index;
+}
+
+/// The number of ranges is written, then the name of the space and the first and last offsets
+/// of each range, all separated by spaces.
+/// \param s is the stream to write to
+/// \param ranges are the ranges to write
+void ResultCache::encodeRanges(ostream &s,const RangeList &ranges)
+
+{
+  s << dec << ranges.numRanges();
+  set<Range>::const_iterator iter;
+  for(iter=ranges.begin();iter!=ranges.end();++iter)
+    s << ' ' << (*iter).getSpace()->getName() << ' ' << hex << (*iter).getFirst() << ' ' << (*iter).getLast();
+}
+
+/// \param s is the stream to read from
+/// \param ranges will hold the ranges read
+/// \return \b false if the text is malformed or names an unknown space
+bool ResultCache::decodeRanges(istream &s,RangeList &ranges) const
+
+{
+  int4 num = -1;
+  s >> dec >> num;
+  if (!s || num < 0) return false;
+  for(int4 i=0;i<num;++i) {
+    string spcname;
+    uintb first,last;
+    s >> spcname >> hex >> first >> last;
+    AddrSpace *spc = glb->getSpaceByName(spcname);
+    if (!s || spc == (AddrSpace *)0 || first > last)
+      return false;
+    ranges.insertRange(spc,first,last);
+  }
+  return true;
+}
+
+/// Every record for the key, including any added by other processes since the last lookup,
+/// is checked against the current bytes of the program.
+/// \param key is the input key
+/// \param output will hold the stored result if there is one
+/// \return \b true if a result was found
+bool ResultCache::findShared(uint8 key,string &output)
+
+{
+  vector<uint8> hashes;
+  vector<string> encoded;
+  if (!shared->find(key,hashes,encoded)) return false;
+  for(int4 i=0;i<hashes.size();++i) {
+    istringstream s(encoded[i]);
+    RangeList ranges;
+    if (!decodeRanges(s,ranges)) continue;
+    uint8 hash;
+    if (!hashRanges(key,ranges,hash)) continue;
+    if (hash != hashes[i]) continue;
+    if (shared->read(key,hash,output))
+      return true;
+  }
+  return false;
+}
+
+/// \param hash is the full hash of the result
+/// \param output will hold the result
+/// \return \b true if the result was found
+bool ResultCache::readResult(uint8 hash,string &output) const
+
+{
+  if (directory.empty()) {
+    map<uint8,string>::const_iterator iter = memresults.find(hash);
+    if (iter == memresults.end()) return false;
+    output = (*iter).second;
+    return true;
+  }
+  ifstream s(resultPath(hash).c_str(),ios::in | ios::binary);
+  if (!s) return false;
+  ostringstream buf;
+  buf << s.rdbuf();
+  output = buf.str();
+  return true;
+}
+
+/// Every entry stored for the key is checked against the current bytes of the program,
+/// and the first one whose full hash still matches provides the result.
+/// \param key is the input key returned by hashInputs()
+/// \param output will hold the stored result if there is one
+/// \return \b true if a result was found
+bool ResultCache::find(uint8 key,string &output)
+
+{
+  if (shared != (SharedResultStore *)0)
+    return findShared(key,output);
+  vector<Entry> &index(getIndex(key));
+  for(int4 i=0;i<index.size();++i) {
+    uint8 hash;
+    if (!hashRanges(key,index[i].ranges,hash)) continue;
+    if (hash != index[i].hash) continue;
+    if (readResult(hash,output))
+      return true;
+  }
+  return false;
+}
+
+/// The most recently stored result is always kept, even if it alone is over the limit.
+void ResultCache::trimMemory(void)
+
+{
+  if (memlimit == 0) return;
+  while(memused > memlimit && memorder.size() > 1) {
+    uint8 key = memorder.front().first;
+    uint8 hash = memorder.front().second;
+    memorder.pop_front();
+    map<uint8,string>::iterator iter = memresults.find(hash);
+    if (iter != memresults.end()) {
+      memused -= (*iter).second.size();
+      memresults.erase(iter);
+    }
+    vector<Entry> &index(indices[key]);
+    for(int4 i=0;i<index.size();++i) {
+      if (index[i].hash == hash) {
+	index.erase(index.begin() + i);
+	break;
+      }
+    }
+  }
+}
+
+/// \param key is the input key returned by hashInputs()
+/// \param output will hold the stored result if there is one
+/// \return \b true if a result was found
+bool ResultCache::lookup(uint8 key,string &output)
+
+{
+  if (find(key,output)) {
+    hits += 1;
+    return true;
+  }
+  misses += 1;
+  return false;
+}
+
+/// The hit and miss counts are not changed, so checking before doing work
+/// on speculation doesn't distort them.
+/// \param key is the input key returned by hashInputs()
+/// \return \b true if a valid result is stored for the key
+bool ResultCache::contains(uint8 key)
+
+{
+  string output;
+  return find(key,output);
+}
+
+/// The result is taken to depend on the original address ranges of every basic block in the
+/// function, plus any other bytes read from the LoadImage while it was produced.
+/// \param key is the input key returned by hashInputs() before the function was decompiled
+/// \param fd is the decompiled function
+/// \param reads are the ranges read from the LoadImage during decompilation
+/// \param output is the result to store
+void ResultCache::store(uint8 key,Funcdata *fd,const RangeList &reads,const string &output)
+
+{
+  Entry entry;
+  entry.ranges = reads;
+  const BlockGraph &graph(fd->getBasicBlocks());
+  for(int4 i=0;i<graph.getSize();++i) {
+    const RangeList &cover(((const BlockBasic *)graph.getBlock(i))->getCover());
+    set<Range>::const_iterator iter;
+    for(iter=cover.begin();iter!=cover.end();++iter)
+      entry.ranges.insertRange((*iter).getSpace(),(*iter).getFirst(),(*iter).getLast());
+  }
+  if (!hashRanges(key,entry.ranges,entry.hash)) return;
+  if (shared != (SharedResultStore *)0) {
+    ostringstream s;
+    encodeRanges(s,entry.ranges);
+    shared->append(key,entry.hash,s.str(),output);
+    return;
+  }
+  vector<Entry> &index(getIndex(key));
+  for(int4 i=0;i<index.size();++i) {
+    if (index[i].hash == entry.hash) return;	// Already stored
+  }
+  if (directory.empty()) {
+    memresults[entry.hash] = output;
+    index.push_back(entry);
+    memused += output.size();
+    memorder.push_back(pair<uint8,uint8>(key,entry.hash));
+    trimMemory();
+    return;
+  }
+  ofstream res(resultPath(entry.hash).c_str(),ios::out | ios::binary | ios::trunc);
+  if (!res) return;			// Cache directory is not writable, just don't cache
+  res.write(output.data(),output.size());
+  res.close();
+  ofstream idx(indexPath(key).c_str(),ios::out | ios::app);
+  if (!idx) return;
+  idx << hex << entry.hash << ' ';
+  encodeRanges(idx,entry.ranges);
+  idx << endl;
+  index.push_back(entry);
+}
+
+} // namespace GhidraDec
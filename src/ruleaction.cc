@@ -96,6 +96,42 @@ Varnode *RuleCollectTerms::getMultCoeff(Varnode *vn,uintb &coef)
   return testop->getIn(0);
 }
 
+/// \brief Check if any of the given terms might be combined
+///
+/// This is a linear pass over the unsorted terms:  the underlying Varnode of each non-constant term is
+/// marked, so a second term with the same Varnode is found immediately, and constants without a
+/// multiplier are counted.  If it returns \b false, sorting the terms can't find anything to combine.
+/// If it returns \b true, the terms still need to be sorted to choose the combination.
+/// \param terms is the list of terms collected from the sum
+/// \return \b true if there are two like terms, or two non-zero constants
+bool RuleCollectTerms::hasCollectable(const vector<PcodeOpEdge> &terms)
+
+{
+  vector<Varnode *> marked;
+  int4 nonzerocount = 0;
+  bool res = false;
+  for(int4 i=0;i<terms.size();++i) {
+    const PcodeOpEdge &term( terms[i] );
+    Varnode *vn = term.getVarnode();
+    if (vn->isConstant()) {
+      if (term.getMultiplier() == (PcodeOp *)0 && vn->getOffset() != 0)
+	nonzerocount += 1;
+      continue;
+    }
+    uintb coef;
+    vn = getMultCoeff(vn,coef);
+    if (vn->isMark()) {
+      res = true;
+      break;
+    }
+    vn->setMark();
+    marked.push_back(vn);
+  }
+  for(int4 i=0;i<marked.size();++i)
+    marked[i]->clearMark();
+  return (res || nonzerocount > 1);
+}
+
 /// If a term has a multiplicative coefficient, but the underlying term is still additive,
 /// in some situations we may need to distribute the coefficient before simplifying further.
 /// The given PcodeOp is a INT_MULT where the second input is a constant. We also
@@ -164,6 +200,7 @@ int4 RuleCollectTerms::applyOp(PcodeOp *op,Funcdata &data)
   
   TermOrder termorder(op);
   termorder.collect();		// Collect additive terms in the expression
+  if (!hasCollectable(termorder.getTerms())) return 0;	// Don't sort if there is nothing to combine
   termorder.sortTerms();	// Sort them based on termorder
   Varnode *vn1,*vn2;
   uintb coef1,coef2;
@@ -239,7 +276,7 @@ int4 RuleSelectCse::applyOp(PcodeOp *op,Funcdata &data)
 
 {
   Varnode *vn = op->getIn(0);
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   OpCode opc = op->code();
   PcodeOp *otherop;
   uintm hash;
@@ -476,7 +513,7 @@ int4 RuleNegateIdentity::applyOp(PcodeOp *op,Funcdata &data)
 {
   Varnode *vn = op->getIn(0);
   Varnode *outVn = op->getOut();
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   for(iter=outVn->beginDescend();iter!=outVn->endDescend();++iter) {
     PcodeOp *logicOp = *iter;
     OpCode opc = logicOp->code();
@@ -670,7 +707,7 @@ int4 RuleTermOrder::applyOp(PcodeOp *op,Funcdata &data)
 void RulePullsubMulti::minMaxUse(Varnode *vn,int4 &maxByte,int4 &minByte)
 
 {
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   enditer = vn->endDescend();
 
   int4 inSize = vn->getSize();
@@ -706,7 +743,7 @@ void RulePullsubMulti::minMaxUse(Varnode *vn,int4 &maxByte,int4 &minByte)
 void RulePullsubMulti::replaceDescendants(Varnode *origVn,Varnode *newVn,int4 maxByte,int4 minByte,Funcdata &data)
 
 {
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = origVn->beginDescend();
   enditer = origVn->endDescend();
   while(iter != enditer) {
@@ -834,7 +871,7 @@ Varnode *RulePullsubMulti::buildSubpiece(Varnode *basevn,uint4 outsize,uint4 shi
 Varnode *RulePullsubMulti::findSubpiece(Varnode *basevn,uint4 outsize,uint4 shift)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *prevop;
 
   for(iter=basevn->beginDescend();iter!=basevn->endDescend();++iter) {
@@ -986,7 +1023,7 @@ int4 RulePullsubIndirect::applyOp(PcodeOp *op,Funcdata &data)
 PcodeOp *RulePushMulti::findSubstitute(Varnode *in1,Varnode *in2,BlockBasic *bb,PcodeOp *earliest)
 
 {
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = in1->beginDescend();
   enditer = in1->endDescend();
   while(iter != enditer) {
@@ -2956,7 +2993,7 @@ int4 RuleSborrow::applyOp(PcodeOp *op,Funcdata &data)
 {
   Varnode *svn = op->getOut();
   Varnode *cvn,*avn,*bvn;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *compop,*signop,*addop;
   int4 zside;
 
@@ -3115,7 +3152,7 @@ int4 RuleShift2Mult::applyOp(PcodeOp *op,Funcdata &data)
 
 {
   int4 flag;
-  list<PcodeOp *>::const_iterator desc;
+  DescendList::const_iterator desc;
   Varnode *vn,*constvn;
   PcodeOp *arithop;
   OpCode opc;
@@ -4918,7 +4955,7 @@ int4 RuleBoolNegate::applyOp(PcodeOp *op,Funcdata &data)
   if (!vn->isWritten()) return 0;
   flip_op = vn->getDef();
 
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
 
 				// ALL descendants must be negates
   for(iter=vn->beginDescend();iter!=vn->endDescend();++iter)
@@ -5202,7 +5239,7 @@ int4 RuleEqual2Zero::applyOp(PcodeOp *op,Funcdata &data)
     if ((!vn->isConstant())||(vn->getOffset() != 0))
       return 0;
   }
-  for(list<PcodeOp *>::const_iterator iter=addvn->beginDescend();iter!=addvn->endDescend();++iter) {
+  for(DescendList::const_iterator iter=addvn->beginDescend();iter!=addvn->endDescend();++iter) {
     // make sure the sum is only used in comparisons
     PcodeOp *boolop = *iter;
     if (!boolop->isBoolOutput()) return 0;
@@ -5289,7 +5326,7 @@ int4 RuleEqual2Constant::applyOp(PcodeOp *op,Funcdata &data)
 
   // Make sure the transformed form of a is only used
   // in comparisons of similar form
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   for(iter=lhs->beginDescend();iter!=lhs->endDescend();++iter) {
     PcodeOp *dop = *iter;
     if (dop == op) continue;
@@ -5584,7 +5621,7 @@ int4 RulePtrArith::applyOp(PcodeOp *op,Funcdata &data)
 
   vn = op->getOut();
   ptrbase = op->getIn(i);
-  list<PcodeOp *>::const_iterator iter=vn->beginDescend();
+  DescendList::const_iterator iter=vn->beginDescend();
   OpCode opc;
   if (iter == vn->endDescend()) return 0; // Don't bother if no descendants
   lowerop = *iter++;
@@ -6063,7 +6100,7 @@ int4 RulePtrsubCharConstant::applyOp(PcodeOp *op,Funcdata &data)
   if (!isstring) return 0;
 
   // If we reach here, the PTRSUB should be converted to a (COPY of a) pointer constant.
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = outvn->beginDescend();
   enditer = outvn->endDescend();
   bool removeCopy = true;
@@ -6202,7 +6239,7 @@ int4 RuleDivTermAdd::applyOp(PcodeOp *op,Funcdata &data)
   }
   Varnode *x = extop->getIn(0);
 
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   for(iter=op->getOut()->beginDescend();iter!=op->getOut()->endDescend();++iter) {
     PcodeOp *addop = *iter;
     if (addop->code() != CPUI_INT_ADD) continue;
@@ -6306,7 +6343,7 @@ int4 RuleDivTermAdd2::applyOp(PcodeOp *op,Funcdata &data)
   if (zextop->code() != CPUI_INT_ZEXT) return 0;
   if (zextop->getIn(0) != x) return 0;
 
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   for(iter=op->getOut()->beginDescend();iter!=op->getOut()->endDescend();++iter) {
     PcodeOp *addop = *iter;
     if (addop->code() != CPUI_INT_ADD) continue;
@@ -6678,7 +6715,7 @@ int4 RuleModOpt::applyOp(PcodeOp *op,Funcdata &data)
 {
   PcodeOp *multop,*addop;
   Varnode *div,*x,*outvn,*outvn2,*div2;
-  list<PcodeOp *>::const_iterator iter1,iter2;
+  DescendList::const_iterator iter1,iter2;
 
   x = op->getIn(0);
   div = op->getIn(1);
@@ -6970,7 +7007,7 @@ bool RulePtrFlow::propagateFlowToDef(Varnode *vn)
 bool RulePtrFlow::propagateFlowToReads(Varnode *vn)
 
 {
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   bool madeChange = false;
   if (!vn->isPtrFlow()) {
     vn->setPtrFlow();
@@ -15,9 +15,9 @@
  */
 #ifdef CPUI_RULECOMPILE
 #include "rulecompile.hh"
-#include "ruleparse.hh"
 
 namespace GhidraDec {
+#include "ruleparse.hh"		// The parser (and its token values) live in the GhidraDec namespace
 RuleCompile *rulecompile;
 extern int4 ruleparsedebug;
 extern int4 ruleparseparse(void);
@@ -762,7 +762,7 @@ RHSConstant *RuleCompile::dotIdentifier(int4 id,string *str)
 void RuleCompile::run(istream &s,bool debug)
 
 {
-#ifdef YYDEBUG
+#if YYDEBUG
   ruleparsedebug = debug ? 1 : 0;
 #endif
 
@@ -851,6 +851,7 @@ RuleGeneric::RuleGeneric(const string &g,const string &nm,const vector<OpCode> &
   starterops = sops;
   opinit = opi;
   constraint = c;
+  setPrivateState();		// The UnifyState is filled in while applying
 }
 
 void RuleGeneric::getOpList(vector<uint4> &oplist) const
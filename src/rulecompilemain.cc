@@ -0,0 +1,202 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+// Offline rule compiler: translate dynamic rules into native Rule classes
+//
+//   rulecompile [-o outfile] rulefile.xml
+//
+//   -o  names the generated C++ file (default is standard out)
+//
+// The input is an <experimental_rules> document, the same file the decompiler reads for
+// dynamic rules.  Each enabled <rule> becomes a Rule subclass whose applyOp() performs the
+// constraint checks directly, and which registers itself with NativeRuleRegistry under the
+// name of the rule.  Linking the generated file into a decompiler makes the <rule> tags of
+// the same file pick up the native classes instead of interpreting the constraints.
+
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+
+#include "rulecompile.hh"
+
+using namespace GhidraDec;
+
+static void usage(void)
+
+{
+  cerr << "usage: rulecompile [-o outfile] rulefile.xml" << endl;
+  exit(2);
+}
+
+/// \brief Turn a string into a valid C++ identifier fragment
+///
+/// \param nm is the string
+/// \return the string with any character not valid in an identifier replaced by '_'
+static string sanitizeName(const string &nm)
+
+{
+  string res;
+  for(int4 i=0;i<nm.size();++i) {
+    char c = nm[i];
+    if (isalnum(c) || c == '_')
+      res += c;
+    else if (c == '#')
+      res += "cn_";		// Named constants in the rule language start with '#'
+    else
+      res += '_';
+  }
+  return res;
+}
+
+/// \brief Write the C++ source for a single rule
+///
+/// \param s is the stream to write to
+/// \param rulename is the name of the dynamic rule
+/// \param content is the body of the rule in the rule language
+/// \return \b true if the rule compiled successfully
+static bool compileRule(ostream &s,const string &rulename,const string &content)
+
+{
+  RuleCompile compiler;
+  compiler.setErrorStream(cerr);
+  istringstream is(content);
+  compiler.run(is,false);
+  if (compiler.numErrors() != 0) {
+    cerr << "Unable to parse dynamic rule: " << rulename << endl;
+    return false;
+  }
+  vector<OpCode> opcodelist;
+  int4 opinit = compiler.postProcessRule(opcodelist);
+
+  map<string,int4> names;
+  map<string,int4>::const_iterator iter;
+  for(iter=compiler.getNameMap().begin();iter!=compiler.getNameMap().end();++iter)
+    names[sanitizeName((*iter).first)] = (*iter).second;
+
+  string classname = "NativeRule_" + sanitizeName(rulename);
+  UnifyCPrinter printer;
+  printer.initializeRuleAction(compiler.getRule(),opinit,opcodelist);
+  printer.setClassName(classname);
+  printer.addNames(names);
+
+  s << "class " << classname << " : public Rule {" << endl;
+  s << "public:" << endl;
+  s << "  " << classname << "(const string &g) : Rule(g,0,\"" << rulename << "\") {}" << endl;
+  s << "  virtual Rule *clone(const ActionGroupList &grouplist) const {" << endl;
+  s << "    if (!grouplist.contains(getGroup())) return (Rule *)0;" << endl;
+  s << "    return new " << classname << "(getGroup());" << endl;
+  s << "  }" << endl;
+  s << "  virtual void getOpList(vector<uint4> &oplist) const;" << endl;
+  s << "  virtual int4 applyOp(PcodeOp *op,Funcdata &data);" << endl;
+  s << "};" << endl;
+  s << endl;
+  printer.print(s);
+  s << endl;
+  s << "static Rule *build_" << classname << "(const string &g) { return new " << classname << "(g); }" << endl;
+  s << "static NativeRuleRegistry register_" << classname << "(\"" << rulename << "\",build_" << classname << ");" << endl;
+  s << endl;
+  return true;
+}
+
+/// \brief Write the C++ source for every enabled rule in an \<experimental_rules> element
+///
+/// \param s is the stream to write to
+/// \param root is the \<experimental_rules> element
+/// \return the number of rules that failed to compile
+static int4 compileRules(ostream &s,const Element *root)
+
+{
+  int4 errors = 0;
+  s << "// Generated by rulecompile, do not edit" << endl;
+  s << "#include \"funcdata.hh\"" << endl;
+  s << "#include \"ruleaction.hh\"" << endl;
+  s << endl;
+  s << "namespace GhidraDec {" << endl;
+  s << endl;
+  const List &list( root->getChildren() );
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter) {
+    const Element *el = *iter;
+    if (el->getName() != "rule") continue;
+    string rulename,enabled;
+    for(int4 i=0;i<el->getNumAttributes();++i) {
+      if (el->getAttributeName(i) == "name")
+	rulename = el->getAttributeValue(i);
+      else if (el->getAttributeName(i) == "enable")
+	enabled = el->getAttributeValue(i);
+    }
+    if (enabled == "false") continue;
+    if (rulename.size() == 0) {
+      cerr << "Dynamic rule has no name" << endl;
+      errors += 1;
+      continue;
+    }
+    try {
+      if (!compileRule(s,rulename,el->getContent()))
+	errors += 1;
+    }
+    catch(LowlevelError &err) {
+      cerr << rulename << ": " << err.explain << endl;
+      errors += 1;
+    }
+  }
+  s << "}" << endl;
+  return errors;
+}
+
+int main(int argc,char **argv)
+
+{
+  string outname;
+  int4 i = 1;
+  while((i<argc)&&(argv[i][0]=='-')) {
+    if (argv[i][1] != 'o' || i+1 >= argc) usage();
+    outname = argv[i+1];
+    i += 2;
+  }
+  if (i+1 != argc) usage();
+
+  DocumentStorage store;
+  const Element *root;
+  try {
+    root = store.openDocument(argv[i])->getRoot();
+  }
+  catch(XmlError &err) {
+    cerr << err.explain << endl;
+    exit(1);
+  }
+  if (root->getName() != "experimental_rules") {
+    cerr << "Wrong tag type for experimental rules: " << root->getName() << endl;
+    exit(1);
+  }
+
+  ostringstream s;
+  int4 errors = compileRules(s,root);
+  if (errors != 0) {
+    cerr << dec << errors << " rule(s) failed to compile" << endl;
+    exit(1);
+  }
+  if (outname.empty())
+    cout << s.str();
+  else {
+    ofstream fs(outname.c_str());
+    if (!fs) {
+      cerr << "Unable to open file: " << outname << endl;
+      exit(1);
+    }
+    fs << s.str();
+  }
+  return 0;
+}
@@ -743,6 +743,45 @@ ConstructTpl::~ConstructTpl(void)
     delete *oiter;
   if (result != (HandleTpl *)0)
     delete result;
+  if (compiled != (CompiledConstructTpl *)0)
+    delete compiled;
+}
+
+/// Any previous compiled form is replaced.  The template must not be modified afterward.
+/// \param cspc is the constant space
+/// \param uspc is the unique space
+void ConstructTpl::compile(AddrSpace *cspc,AddrSpace *uspc)
+
+{
+  if (compiled != (CompiledConstructTpl *)0)
+    delete compiled;
+  compiled = new CompiledConstructTpl();
+  compiled->numlabels = numlabels;
+  compiled->ops.reserve(vec.size());
+  for(int4 i=0;i<vec.size();++i) {
+    OpTpl *op = vec[i];
+    CompiledOpTpl cop;
+    cop.opc = op->getOpcode();
+    cop.numinput = op->numInput();
+    cop.firstinput = compiled->vars.size();
+    cop.output = -1;
+    cop.arg = 0;
+    cop.relative = false;
+    cop.tpl = op;
+    if (cop.opc == BUILD || cop.opc == LABELBUILD)
+      cop.arg = op->getIn(0)->getOffset().getReal();
+    else if (cop.opc != DELAY_SLOT && cop.opc != CROSSBUILD) {
+      for(int4 j=0;j<cop.numinput;++j)
+	compiled->compileVarnode(op->getIn(j),cspc,uspc);
+      cop.relative = (cop.numinput > 0) && op->getIn(0)->isRelative();
+      if (op->getOut() != (VarnodeTpl *)0) {
+	cop.output = compiled->vars.size();
+	compiled->compileVarnode(op->getOut(),cspc,uspc);
+      }
+    }
+    compiled->ops.push_back(cop);
+  }
+  compiled->compileResult(result);
 }
 
 bool ConstructTpl::addOp(OpTpl *ot)
@@ -919,6 +958,65 @@ int4 ConstructTpl::restoreXml(const Element *el,const AddrSpaceManager *manage)
   return sectionid;
 }
 
+/// The varnode is \e fixed if its space is an id, and its offset and size are plain constants.
+/// The offset is then masked (constant space) or wrapped (other spaces) just as
+/// SleighBuilder would do for each instruction.
+/// \param vn is the template to compile
+/// \param cspc is the constant space
+/// \param uspc is the unique space
+void CompiledConstructTpl::compileVarnode(const VarnodeTpl *vn,AddrSpace *cspc,AddrSpace *uspc)
+
+{
+  CompiledVarnodeTpl cv;
+  cv.flags = 0;
+  cv.size = 0;
+  cv.space = (AddrSpace *)0;
+  cv.offset = 0;
+  cv.tpl = vn;
+  const ConstTpl &spc(vn->getSpace());
+  const ConstTpl &off(vn->getOffset());
+  const ConstTpl &sz(vn->getSize());
+  if (off.getType() == ConstTpl::handle)
+    cv.flags |= CompiledVarnodeTpl::maybe_dynamic;
+  else if (spc.getType() == ConstTpl::spaceid && sz.getType() == ConstTpl::real &&
+	   (off.getType() == ConstTpl::real || off.getType() == ConstTpl::j_relative)) {
+    cv.flags |= CompiledVarnodeTpl::fixed;
+    cv.space = spc.getSpace();
+    cv.size = sz.getReal();
+    if (cv.space == cspc)
+      cv.offset = off.getReal() & calc_mask(cv.size);
+    else if (cv.space == uspc) {
+      cv.offset = off.getReal();
+      cv.flags |= CompiledVarnodeTpl::unique;
+    }
+    else
+      cv.offset = cv.space->wrapOffset(off.getReal());
+  }
+  vars.push_back(cv);
+}
+
+/// The handle is constant if it is not a pointer, and its space, size, and offset
+/// are all plain constants, as in HandleTpl::fix().
+/// \param hand is the exported handle of the template (may be null)
+void CompiledConstructTpl::compileResult(const HandleTpl *hand)
+
+{
+  resultfixed = false;
+  if (hand == (const HandleTpl *)0) return;
+  if (hand->getPtrSpace().getType() != ConstTpl::real) return;
+  if (hand->getSpace().getType() != ConstTpl::spaceid) return;
+  if (hand->getSize().getType() != ConstTpl::real) return;
+  if (hand->getPtrOffset().getType() != ConstTpl::real) return;
+  resultfixed = true;
+  result.space = hand->getSpace().getSpace();
+  result.size = hand->getSize().getReal();
+  result.offset_space = (AddrSpace *)0;
+  result.offset_offset = result.space->wrapOffset(hand->getPtrOffset().getReal());
+  result.offset_size = 0;
+  result.temp_space = (AddrSpace *)0;
+  result.temp_offset = 0;
+}
+
 void PcodeBuilder::build(ConstructTpl *construct,int4 secnum)
 
 {
@@ -0,0 +1,302 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "slab.hh"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifndef _WINDOWS
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace GhidraDec {
+
+const std::string SLAB_EXTENSION = ".slab";
+
+static const uint4 SLAB_MAGIC = 0x42414c53;	// "SLAB" in little-endian byte order
+static const uint4 SLAB_VERSION = 1;
+static const uint4 SLAB_HEADER_FIELDS = 6;	// Number of uint4 fields in the header
+static const uint4 SLAB_ELEMENT_FIELDS = 6;	// Number of uint4 fields in an element record
+static const uint4 SLAB_ATTRIB_FIELDS = 2;	// Number of uint4 fields in an attribute record
+
+/// \brief Tables collected while encoding an element tree
+struct SlabEncoder {
+  std::map<std::string,uint4> stringmap;	///< Index of each distinct string
+  std::vector<const std::string *> strings;	///< Distinct strings in index order
+  std::vector<uint4> elements;			///< Element records
+  std::vector<uint4> attribs;			///< Attribute records
+  uint4 datasize;				///< Total bytes of string data
+  SlabEncoder(void) { datasize = 0; }
+  uint4 internString(const std::string &str);	///< Get the index of a string, adding it if necessary
+  void encodeElement(const Element *el);	///< Append records for an element and its subtree
+};
+
+/// \param str is the string to look up
+/// \return the index of the string in the table
+uint4 SlabEncoder::internString(const std::string &str)
+
+{
+  std::map<std::string,uint4>::iterator iter = stringmap.find(str);
+  if (iter != stringmap.end())
+    return (*iter).second;
+  uint4 index = strings.size();
+  iter = stringmap.insert(std::pair<std::string,uint4>(str,index)).first;
+  strings.push_back(&(*iter).first);
+  datasize += str.size();
+  return index;
+}
+
+/// Records are appended in document order. The subtree size of the element (including itself)
+/// is filled in after all its descendants have been appended.
+/// \param el is the element to encode
+void SlabEncoder::encodeElement(const Element *el)
+
+{
+  uint4 slot = elements.size();
+  elements.push_back(internString(el->getName()));
+  elements.push_back(internString(el->getContent()));
+  elements.push_back(attribs.size() / SLAB_ATTRIB_FIELDS);
+  elements.push_back(el->getNumAttributes());
+  elements.push_back(el->getChildren().size());
+  elements.push_back(0);
+  for(int4 i=0;i<el->getNumAttributes();++i) {
+    attribs.push_back(internString(el->getAttributeName(i)));
+    attribs.push_back(internString(el->getAttributeValue(i)));
+  }
+  const List &list(el->getChildren());
+  for(List::const_iterator iter=list.begin();iter!=list.end();++iter)
+    encodeElement(*iter);
+  elements[slot + 5] = (elements.size() - slot) / SLAB_ELEMENT_FIELDS;
+}
+
+/// \param s is the stream to write to
+/// \param val is the value to write in little-endian byte order
+static void slab_put(std::ostream &s,uint4 val)
+
+{
+  char buf[4];
+  buf[0] = (char)(val & 0xff);
+  buf[1] = (char)((val >> 8) & 0xff);
+  buf[2] = (char)((val >> 16) & 0xff);
+  buf[3] = (char)((val >> 24) & 0xff);
+  s.write(buf,4);
+}
+
+/// \param ptr points to 4 bytes in little-endian byte order
+/// \return the decoded value
+static inline uint4 slab_get(const uint1 *ptr)
+
+{
+  return ((uint4)ptr[0]) | (((uint4)ptr[1]) << 8) | (((uint4)ptr[2]) << 16) | (((uint4)ptr[3]) << 24);
+}
+
+/// The tree rooted at the given element is written in \e .slab form. The stream must
+/// have been opened in binary mode.
+/// \param s is the output stream
+/// \param el is the root element of the tree to encode
+void slab_write(std::ostream &s,const Element *el)
+
+{
+  SlabEncoder encoder;
+  encoder.encodeElement(el);
+
+  uint4 numelements = encoder.elements.size() / SLAB_ELEMENT_FIELDS;
+  uint4 numattribs = encoder.attribs.size() / SLAB_ATTRIB_FIELDS;
+  slab_put(s,SLAB_MAGIC);
+  slab_put(s,SLAB_VERSION);
+  slab_put(s,encoder.strings.size());
+  slab_put(s,numelements);
+  slab_put(s,numattribs);
+  slab_put(s,encoder.datasize);
+  uint4 offset = 0;
+  for(int4 i=0;i<encoder.strings.size();++i) {
+    uint4 len = encoder.strings[i]->size();
+    slab_put(s,offset);
+    slab_put(s,len);
+    offset += len;
+  }
+  for(int4 i=0;i<encoder.elements.size();++i)
+    slab_put(s,encoder.elements[i]);
+  for(int4 i=0;i<encoder.attribs.size();++i)
+    slab_put(s,encoder.attribs[i]);
+  for(int4 i=0;i<encoder.strings.size();++i)
+    s.write(encoder.strings[i]->data(),encoder.strings[i]->size());
+}
+
+/// The tables are checked for consistency as they are read, and any problem is reported
+/// as an XmlError, just as a malformed \e .sla file would be.
+/// \param buf is the start of the encoded data
+/// \param size is the number of bytes of encoded data
+/// \return the decoded Document
+Document *slab_tree(const uint1 *buf,uint4 size)
+
+{
+  if (size < SLAB_HEADER_FIELDS * 4 || slab_get(buf) != SLAB_MAGIC)
+    throw XmlError("Not a binary SLEIGH file");
+  if (slab_get(buf + 4) != SLAB_VERSION)
+    throw XmlError("Unsupported binary SLEIGH file version");
+  uint4 numstrings = slab_get(buf + 8);
+  uint4 numelements = slab_get(buf + 12);
+  uint4 numattribs = slab_get(buf + 16);
+  uint4 datasize = slab_get(buf + 20);
+  uint8 total = SLAB_HEADER_FIELDS * 4;
+  total += (uint8)numstrings * 8 + (uint8)numelements * SLAB_ELEMENT_FIELDS * 4;
+  total += (uint8)numattribs * SLAB_ATTRIB_FIELDS * 4 + datasize;
+  if (total != size || numelements == 0)
+    throw XmlError("Corrupt binary SLEIGH file");
+  const uint1 *stringtable = buf + SLAB_HEADER_FIELDS * 4;
+  const uint1 *elementtable = stringtable + numstrings * 8;
+  const uint1 *attribtable = elementtable + numelements * SLAB_ELEMENT_FIELDS * 4;
+  const char *data = (const char *)(attribtable + numattribs * SLAB_ATTRIB_FIELDS * 4);
+
+  std::vector<std::string> strings;
+  strings.reserve(numstrings);
+  for(uint4 i=0;i<numstrings;++i) {
+    uint4 off = slab_get(stringtable + i * 8);
+    uint4 len = slab_get(stringtable + i * 8 + 4);
+    if ((uint8)off + len > datasize)
+      throw XmlError("Corrupt binary SLEIGH file");
+    strings.emplace_back(data + off,len);
+  }
+
+  Document *doc = new Document();
+  std::vector<Element *> parentstack;
+  std::vector<uint4> remaining;		// Children still to be read for each element on the stack
+  parentstack.push_back(doc);
+  remaining.push_back(1);		// The document holds a single root element
+  try {
+    for(uint4 i=0;i<numelements;++i) {
+      while(remaining.back() == 0) {
+	parentstack.pop_back();
+	remaining.pop_back();
+	if (parentstack.empty())
+	  throw XmlError("Corrupt binary SLEIGH file");
+      }
+      const uint1 *rec = elementtable + i * SLAB_ELEMENT_FIELDS * 4;
+      uint4 name = slab_get(rec);
+      uint4 content = slab_get(rec + 4);
+      uint4 firstattrib = slab_get(rec + 8);
+      uint4 numattrib = slab_get(rec + 12);
+      uint4 numchild = slab_get(rec + 16);
+      if (name >= numstrings || content >= numstrings || (uint8)firstattrib + numattrib > numattribs)
+	throw XmlError("Corrupt binary SLEIGH file");
+      Element *el = new Element(parentstack.back());
+      parentstack.back()->addChild(el);
+      remaining.back() -= 1;
+      el->setName(strings[name]);
+      const std::string &contentstr(strings[content]);
+      if (!contentstr.empty())
+	el->addContent(contentstr.data(),0,contentstr.size());
+      for(uint4 j=0;j<numattrib;++j) {
+	const uint1 *arec = attribtable + (firstattrib + j) * SLAB_ATTRIB_FIELDS * 4;
+	uint4 aname = slab_get(arec);
+	uint4 avalue = slab_get(arec + 4);
+	if (aname >= numstrings || avalue >= numstrings)
+	  throw XmlError("Corrupt binary SLEIGH file");
+	el->addAttribute(strings[aname],strings[avalue]);
+      }
+      parentstack.push_back(el);
+      remaining.push_back(numchild);
+    }
+    for(int4 i=0;i<remaining.size();++i) {
+      if (remaining[i] != 0)
+	throw XmlError("Corrupt binary SLEIGH file");
+    }
+  }
+  catch(XmlError &err) {
+    delete doc;
+    throw;
+  }
+  return doc;
+}
+
+/// The file is memory mapped (where supported) so its contents are decoded without
+/// being copied, and the mapping is released before returning.
+/// \param filename is the path to the \e .slab file
+/// \return the decoded Document
+Document *slab_open(const std::string &filename)
+
+{
+#ifdef _WINDOWS
+  std::ifstream s(filename.c_str(),std::ios::in | std::ios::binary);
+  if (!s)
+    throw XmlError("Unable to open binary SLEIGH file "+filename);
+  std::vector<char> buf((std::istreambuf_iterator<char>(s)),std::istreambuf_iterator<char>());
+  s.close();
+  return slab_tree((const uint1 *)buf.data(),buf.size());
+#else
+  int fd = open(filename.c_str(),O_RDONLY);
+  if (fd < 0)
+    throw XmlError("Unable to open binary SLEIGH file "+filename);
+  struct stat st;
+  if (fstat(fd,&st) != 0 || st.st_size == 0 || (uint8)st.st_size > 0xffffffff) {
+    close(fd);
+    throw XmlError("Bad size for binary SLEIGH file "+filename);
+  }
+  uint4 size = st.st_size;
+  void *map = mmap((void *)0,size,PROT_READ,MAP_PRIVATE,fd,0);
+  close(fd);
+  if (map == MAP_FAILED)
+    throw XmlError("Unable to map binary SLEIGH file "+filename);
+  Document *doc;
+  try {
+    doc = slab_tree((const uint1 *)map,size);
+  }
+  catch(XmlError &err) {
+    munmap(map,size);
+    throw XmlError(err.explain + ": " + filename);
+  }
+  munmap(map,size);
+  return doc;
+#endif
+}
+
+/// Only the magic number at the start of the file is checked.
+/// \param filename is the path to the file
+/// \return \b true if the file can be opened and starts with the \e .slab magic number
+bool slab_detect(const std::string &filename)
+
+{
+  std::ifstream s(filename.c_str(),std::ios::in | std::ios::binary);
+  if (!s)
+    return false;
+  uint1 buf[4];
+  s.read((char *)buf,4);
+  if (s.gcount() != 4)
+    return false;
+  return (slab_get(buf) == SLAB_MAGIC);
+}
+
+/// A binary file is considered current if it exists and was modified no earlier than
+/// the XML file it was compiled alongside. If the XML file does not exist, any existing
+/// binary file is current.
+/// \param slabfile is the path to the binary file
+/// \param xmlfile is the path to the corresponding XML file (may be empty)
+/// \return \b true if the binary file can be used in place of the XML file
+bool slab_current(const std::string &slabfile,const std::string &xmlfile)
+
+{
+  struct stat slabstat;
+  struct stat xmlstat;
+  if (slabfile.empty() || stat(slabfile.c_str(),&slabstat) != 0)
+    return false;
+  if (xmlfile.empty() || stat(xmlfile.c_str(),&xmlstat) != 0)
+    return true;
+  return (slabstat.st_mtime >= xmlstat.st_mtime);
+}
+
+} // namespace GhidraDec
@@ -63,7 +63,7 @@ VarnodeData *PcodeCacher::expandPool(uint4 size)
       issued[i].invar = invar;
     }
   }
-  list<RelativeRecord>::iterator iter;
+  vector<RelativeRecord>::iterator iter;
   for(iter=label_refs.begin();iter!=label_refs.end();++iter) {
     VarnodeData *ref = (*iter).dataptr;
     (*iter).dataptr = newpool + (ref - poolstart);
@@ -107,7 +107,7 @@ void PcodeCacher::resolveRelatives(void)
 { // Assuming all the PcodeData has been generated for an
   // instruction, go resolve any relative offsets and back
   // patch their value(s) into the PcodeData
-  list<RelativeRecord>::const_iterator iter;
+  vector<RelativeRecord>::const_iterator iter;
   for(iter=label_refs.begin();iter!=label_refs.end();++iter) {
     VarnodeData *ptr = (*iter).dataptr;
     uint4 id = ptr->offset;
@@ -159,32 +159,60 @@ AddrSpace *SleighBuilder::generatePointer(const VarnodeTpl *vntpl,VarnodeData &v
   return hand.space;
 }
 
+/// The location given by the template is really temporary storage: fill it in and
+/// emit a LOAD into it through the pointer described by the template's handle.
+/// \param vn is the dynamic input template
+/// \param invar is the input varnode to fill in
+void SleighBuilder::dynamicLoad(const VarnodeTpl *vn,VarnodeData *invar)
+
+{
+  generateLocation(vn,*invar); // Input of -op- is really temporary storage
+  PcodeData *load_op = cache->allocateInstruction();
+  load_op->opc = CPUI_LOAD;
+  load_op->outvar = invar;
+  load_op->isize = 2;
+  VarnodeData *loadvars = load_op->invar = cache->allocateVarnodes(2);
+  AddrSpace *spc = generatePointer(vn,loadvars[1]);
+  loadvars[0].space = const_space;
+  loadvars[0].offset = (uintb)(uintp)spc;
+  loadvars[0].size = sizeof(spc);
+}
+
+/// The output of \b thisop is set to temporary storage, and a STORE from it through
+/// the pointer described by the template's handle is emitted after \b thisop.
+/// \param outvn is the dynamic output template
+/// \param thisop is the op being built
+void SleighBuilder::dynamicStore(const VarnodeTpl *outvn,PcodeData *thisop)
+
+{
+  VarnodeData *storevars = cache->allocateVarnodes(3);
+  generateLocation(outvn,storevars[2]); // Output of -op- is really temporary storage
+  thisop->outvar = storevars+2;
+  PcodeData *store_op = cache->allocateInstruction();
+  store_op->opc = CPUI_STORE;
+  store_op->isize = 3;
+  // store_op->outvar = (VarnodeData *)0;
+  store_op->invar = storevars;
+  AddrSpace *spc = generatePointer(outvn,storevars[1]); // pointer
+  storevars[0].space = const_space;
+  storevars[0].offset = (uintb)(uintp)spc; // space in which to store
+  storevars[0].size = sizeof(spc);
+}
+
 void SleighBuilder::dump(OpTpl *op)
 
 {				// Dump on op through low-level dump interface
 				// filling in dynamic loads and stores if necessary
   PcodeData *thisop;
   VarnodeData *invars;
-  VarnodeData *loadvars;
-  VarnodeData *storevars;
   VarnodeTpl *vn,*outvn;
   int4 isize = op->numInput();
 				// First build all the inputs
   invars = cache->allocateVarnodes(isize);
   for(int4 i=0;i<isize;++i) {
     vn = op->getIn(i);
-    if (vn->isDynamic(*walker)) {
-      generateLocation(vn,invars[i]); // Input of -op- is really temporary storage
-      PcodeData *load_op = cache->allocateInstruction();
-      load_op->opc = CPUI_LOAD;
-      load_op->outvar = invars + i;
-      load_op->isize = 2;
-      loadvars = load_op->invar = cache->allocateVarnodes(2);
-      AddrSpace *spc = generatePointer(vn,loadvars[1]);
-      loadvars[0].space = const_space;
-      loadvars[0].offset = (uintb)(uintp)spc;
-      loadvars[0].size = sizeof(spc);
-    }
+    if (vn->isDynamic(*walker))
+      dynamicLoad(vn,invars + i);
     else
       generateLocation(vn,invars[i]);
   }
@@ -198,20 +226,8 @@ void SleighBuilder::dump(OpTpl *op)
   thisop->isize = isize;
   outvn = op->getOut();
   if (outvn != (VarnodeTpl *)0) {
-    if (outvn->isDynamic(*walker)) {
-      storevars = cache->allocateVarnodes(3);
-      generateLocation(outvn,storevars[2]); // Output of -op- is really temporary storage
-      thisop->outvar = storevars+2;
-      PcodeData *store_op = cache->allocateInstruction();
-      store_op->opc = CPUI_STORE;
-      store_op->isize = 3;
-      // store_op->outvar = (VarnodeData *)0;
-      store_op->invar = storevars;
-      AddrSpace *spc = generatePointer(outvn,storevars[1]); // pointer
-      storevars[0].space = const_space;
-      storevars[0].offset = (uintb)(uintp)spc; // space in which to store
-      storevars[0].size = sizeof(spc);
-    }
+    if (outvn->isDynamic(*walker))
+      dynamicStore(outvn,thisop);
     else {
       thisop->outvar = cache->allocateVarnodes(1);
       generateLocation(outvn,*thisop->outvar);
@@ -219,6 +235,102 @@ void SleighBuilder::dump(OpTpl *op)
   }
 }
 
+/// \param cv is the compiled template
+/// \param vn will hold the concrete varnode
+void SleighBuilder::generateCompiled(const CompiledVarnodeTpl &cv,VarnodeData &vn)
+
+{
+  if ((cv.flags & CompiledVarnodeTpl::fixed)==0) {
+    generateLocation(cv.tpl,vn);
+    return;
+  }
+  vn.space = cv.space;
+  vn.size = cv.size;
+  vn.offset = cv.offset;
+  if ((cv.flags & CompiledVarnodeTpl::unique)!=0)
+    vn.offset |= uniqueoffset;
+}
+
+/// This is dump() for a flattened op: the dynamic check is only made for varnodes
+/// whose offset comes from a handle, and constant varnodes are copied directly.
+/// \param op is the flattened op
+/// \param vars is the varnode array of its CompiledConstructTpl
+void SleighBuilder::dumpCompiled(const CompiledOpTpl &op,const CompiledVarnodeTpl *vars)
+
+{
+  int4 isize = op.numinput;
+  const CompiledVarnodeTpl *in = vars + op.firstinput;
+  VarnodeData *invars = cache->allocateVarnodes(isize);
+  for(int4 i=0;i<isize;++i) {
+    const CompiledVarnodeTpl &cv( in[i] );
+    if (((cv.flags & CompiledVarnodeTpl::maybe_dynamic)!=0) && cv.tpl->isDynamic(*walker))
+      dynamicLoad(cv.tpl,invars + i);
+    else
+      generateCompiled(cv,invars[i]);
+  }
+  if (op.relative) {
+    invars->offset += labelbase;
+    cache->addLabelRef(invars);
+  }
+  PcodeData *thisop = cache->allocateInstruction();
+  thisop->opc = (OpCode)op.opc;
+  thisop->invar = invars;
+  thisop->isize = isize;
+  if (op.output >= 0) {
+    const CompiledVarnodeTpl &cv( vars[op.output] );
+    if (((cv.flags & CompiledVarnodeTpl::maybe_dynamic)!=0) && cv.tpl->isDynamic(*walker))
+      dynamicStore(cv.tpl,thisop);
+    else {
+      thisop->outvar = cache->allocateVarnodes(1);
+      generateCompiled(cv,*thisop->outvar);
+    }
+  }
+}
+
+/// Templates that have been flattened (see ConstructTpl::compile()) are walked in a single loop,
+/// with directives handled directly rather than through the virtual methods of PcodeBuilder.
+/// Other templates (such as those of p-code injections) go through PcodeBuilder::build().
+/// \param construct is the template to build
+/// \param secnum is the named section being built, or -1 for the main section
+void SleighBuilder::buildCompiled(ConstructTpl *construct,int4 secnum)
+
+{
+  if (construct == (ConstructTpl *)0)
+    throw UnimplError("",0);	// Pcode is not implemented for this constructor
+  const CompiledConstructTpl *comp = construct->getCompiled();
+  if (comp == (const CompiledConstructTpl *)0) {
+    build(construct,secnum);
+    return;
+  }
+  uint4 oldbase = labelbase;	// Recursively store old labelbase
+  labelbase = labelcount;	// Set the newbase
+  labelcount += comp->numLabels();	// Add labels from this template
+
+  const vector<CompiledOpTpl> &ops( comp->getOps() );
+  const CompiledVarnodeTpl *vars = comp->getVars().data();
+  for(int4 i=0;i<ops.size();++i) {
+    const CompiledOpTpl &op( ops[i] );
+    switch(op.opc) {
+    case BUILD:
+      buildOperand(op.arg,secnum);
+      break;
+    case DELAY_SLOT:
+      SleighBuilder::delaySlot(op.tpl);
+      break;
+    case LABELBUILD:
+      cache->addLabel(op.arg + labelbase);
+      break;
+    case CROSSBUILD:
+      SleighBuilder::appendCrossBuild(op.tpl,secnum);
+      break;
+    default:
+      dumpCompiled(op,vars);
+      break;
+    }
+  }
+  labelbase = oldbase;		// Restore old labelbase
+}
+
 void SleighBuilder::buildEmpty(Constructor *ct,int4 secnum)
 
 { // Build a named p-code section of a constructor that contains only implied BUILD directives
@@ -234,7 +346,7 @@ void SleighBuilder::buildEmpty(Constructor *ct,int4 secnum)
     if (construct == (ConstructTpl *)0)
       buildEmpty(walker->getConstructor(),secnum);
     else
-      build(construct,secnum);
+      buildCompiled(construct,secnum);
     walker->popOperand();
   }
 }
@@ -256,12 +368,21 @@ SleighBuilder::SleighBuilder(ParserWalker *w,DisassemblyCache *dcache,PcodeCache
   uniq_space = uspc;
   uniquemask = umask;
   uniqueoffset = (walker->getAddr().getOffset() & uniquemask)<<4;
+  external = false;
 }
 
 void SleighBuilder::appendBuild(OpTpl *bld,int4 secnum)
 
 {				// Append pcode for a particular build statement
   int4 index = bld->getIn(0)->getOffset().getReal(); // Recover operand index from build statement
+  buildOperand(index,secnum);
+}
+
+/// \param index is the operand of the current Constructor to build
+/// \param secnum is the named section being built, or -1 for the main section
+void SleighBuilder::buildOperand(int4 index,int4 secnum)
+
+{
 				// Check if operand is a subtable
   SubtableSymbol *sym = (SubtableSymbol *)walker->getConstructor()->getOperand(index)->getDefiningSymbol();
   if ((sym==(SubtableSymbol *)0)||(sym->getType() != SleighSymbol::subtable_symbol)) return;
@@ -273,11 +394,11 @@ void SleighBuilder::appendBuild(OpTpl *bld,int4 secnum)
     if (construct == (ConstructTpl *)0)
       buildEmpty(ct,secnum);
     else
-      build(construct,secnum);
+      buildCompiled(construct,secnum);
   }
   else {
     ConstructTpl *construct = ct->getTempl();
-    build(construct,-1);
+    buildCompiled(construct,-1);
   }
   walker->popOperand();
 }
@@ -293,6 +414,7 @@ void SleighBuilder::delaySlot(OpTpl *op)
   int4 fallOffset = tmp->getLength();
   int4 delaySlotByteCnt = tmp->getParserContext()->getDelaySlot();
   int4 bytecount = 0;
+  external = true;
   do {
     Address newaddr = baseaddr + fallOffset;
     setUniqueOffset(newaddr);
@@ -304,7 +426,7 @@ void SleighBuilder::delaySlot(OpTpl *op)
     ParserWalker newwalker( pos );
     walker = &newwalker;
     walker->baseState();
-    build(walker->getConstructor()->getTempl(),-1); // Build the whole delay slot
+    buildCompiled(walker->getConstructor()->getTempl(),-1); // Build the whole delay slot
     fallOffset += len;
     bytecount += len;
   } while(bytecount < delaySlotByteCnt);
@@ -332,6 +454,7 @@ void SleighBuilder::appendCrossBuild(OpTpl *bld,int4 secnum)
 
   ParserWalker *tmp = walker;
   uintb olduniqueoffset = uniqueoffset;
+  external = true;
 
   Address newaddr(spc,addr);
   setUniqueOffset(newaddr);
@@ -348,7 +471,7 @@ void SleighBuilder::appendCrossBuild(OpTpl *bld,int4 secnum)
   if (construct == (ConstructTpl *)0)
     buildEmpty(ct,secnum);
   else
-    build(construct,secnum);
+    buildCompiled(construct,secnum);
   walker = tmp;
   uniqueoffset = olduniqueoffset;
 }
@@ -412,22 +535,155 @@ ParserContext *DisassemblyCache::getParserContext(const Address &addr)
   return res;
 }
 
+/// \param ccache is the source of context values for cached instructions
+/// \param max is the maximum number of instructions to cache
+InstructionCache::InstructionCache(ContextCache *ccache,uint4 max)
+
+{
+  contextcache = ccache;
+  contextsize = ccache->getDatabase()->getContextSize();
+  maxsize = max;
+  hits = 0;
+  misses = 0;
+}
+
+/// If an entry exists for the address and the current context there matches the
+/// context it was decoded with, its p-code is passed to the emitter.  A stale entry is removed.
+/// \param addr is the address of the instruction
+/// \param emt is the emitter to receive the p-code
+/// \return the length of the instruction in bytes, or -1 if there is no valid entry
+int4 InstructionCache::emit(const Address &addr,PcodeEmit &emt)
+
+{
+  map<AddressKey,CachedInstruction>::iterator iter = cache.find(AddressKey(addr));
+  if (iter == cache.end()) {
+    misses += 1;
+    return -1;
+  }
+  CachedInstruction &entry((*iter).second);
+  const uintm *curcontext = contextcache->getContext(addr);
+  for(int4 i=0;i<contextsize;++i) {
+    if (curcontext[i] != entry.context[i]) {
+      cache.erase(iter);		// Context has changed since the instruction was decoded
+      misses += 1;
+      return -1;
+    }
+  }
+  hits += 1;
+  vector<CachedOp>::const_iterator oiter;
+  for(oiter=entry.ops.begin();oiter!=entry.ops.end();++oiter) {
+    const CachedOp &op(*oiter);
+    VarnodeData *outvar = (op.out < 0) ? (VarnodeData *)0 : &entry.varnodes[op.out];
+    VarnodeData *invar = (op.isize == 0) ? (VarnodeData *)0 : &entry.varnodes[op.in];
+    emt.dump(addr,op.opc,outvar,invar,op.isize);
+  }
+  return entry.length;
+}
+
+/// The p-code currently held by the PcodeCacher (with relative labels already resolved)
+/// is copied into a new entry, along with the current context at the address.  If the
+/// cache is full, it is flushed first.
+/// \param addr is the address of the instruction
+/// \param length is the length of the instruction in bytes
+/// \param cacher holds the p-code built for the instruction
+void InstructionCache::store(const Address &addr,int4 length,const PcodeCacher &cacher)
+
+{
+  if (cache.size() >= maxsize)
+    cache.clear();
+  CachedInstruction &entry(cache[AddressKey(addr)]);
+  entry.length = length;
+  entry.context.resize(contextsize + 1);
+  contextcache->getContext(addr,entry.context.data());
+  entry.ops.clear();
+  entry.varnodes.clear();
+  const vector<PcodeData> &issued(cacher.getIssued());
+  entry.ops.resize(issued.size());
+  for(int4 i=0;i<issued.size();++i) {
+    const PcodeData &data(issued[i]);
+    CachedOp &op(entry.ops[i]);
+    op.opc = data.opc;
+    op.out = -1;
+    if (data.outvar != (VarnodeData *)0) {
+      op.out = entry.varnodes.size();
+      entry.varnodes.push_back(*data.outvar);
+    }
+    op.in = entry.varnodes.size();
+    op.isize = data.isize;
+    for(int4 j=0;j<data.isize;++j)
+      entry.varnodes.push_back(data.invar[j]);
+  }
+}
+
+/// \param trans is the translator the state will be used with
+/// \param c_db is the context database backing the context cache
+/// \param c is the character to append
+/// \return the character
+ListingBuffer::int_type ListingBuffer::overflow(int_type c)
+
+{
+  if (c != traits_type::eof())
+    text += (char)c;
+  return traits_type::not_eof(c);
+}
+
+/// \param s is the characters to append
+/// \param n is the number of characters
+/// \return the number of characters appended
+std::streamsize ListingBuffer::xsputn(const char *s,std::streamsize n)
+
+{
+  text.append(s,n);
+  return n;
+}
+
+SleighThreadState::SleighThreadState(const Sleigh *trans,ContextDatabase *c_db)
+  : mnemstream(&mnembuffer), bodystream(&bodybuffer)
+{
+  owner = trans;
+  cache = new ContextCache(c_db);
+  discache = (DisassemblyCache *)0;
+  inscache = (InstructionCache *)0;
+  previous = (SleighThreadState *)0;
+}
+
+SleighThreadState::~SleighThreadState(void)
+
+{
+  if (discache != (DisassemblyCache *)0)
+    delete discache;
+  if (inscache != (InstructionCache *)0)
+    delete inscache;
+  delete cache;
+}
+
+thread_local SleighThreadState *Sleigh::threadstate = (SleighThreadState *)0;
+
 Sleigh::Sleigh(LoadImage *ld,ContextDatabase *c_db)
   : SleighBase()
 
 {
   loader = ld;
   context_db = c_db;
-  cache = new ContextCache(c_db);
-  discache = (DisassemblyCache *)0;
+  mainstate = new SleighThreadState(this,c_db);
+  parser_cachesize = 2;
+  parser_windowsize = 32;
+  inscache_size = 0;
+  detached_hits = 0;
+  detached_misses = 0;
+  decodeprofiling = false;
+  profilecounts = (std::atomic<uint8> *)0;
 }
 
 void Sleigh::clearForDelete(void)
 
 {
-  delete cache;
-  if (discache != (DisassemblyCache *)0)
-    delete discache;
+  releaseState(mainstate);
+  if (profilecounts != (std::atomic<uint8> *)0)
+    delete [] profilecounts;
+  profilecounts = (std::atomic<uint8> *)0;
+  profileoffset.clear();
+  decodeprofiling = false;
 }
 
 Sleigh::~Sleigh(void)
@@ -441,11 +697,47 @@ void Sleigh::reset(LoadImage *ld,ContextDatabase *c_db)
 { // Completely clear everything except the base and reconstruct
   // with a new loader and context
   clearForDelete();
-  pcode_cache.clear();
   loader = ld;
   context_db = c_db;
-  cache = new ContextCache(c_db);
-  discache = (DisassemblyCache *)0;
+  mainstate = new SleighThreadState(this,c_db);
+  inscache_size = 0;
+  detached_hits = 0;
+  detached_misses = 0;
+}
+
+/// \param state is the decoding state that needs a ParserContext window
+void Sleigh::buildDisassemblyCache(SleighThreadState *state) const
+
+{
+  if (state->discache != (DisassemblyCache *)0)
+    delete state->discache;
+  state->discache = new DisassemblyCache(state->cache,getConstantSpace(),parser_cachesize,parser_windowsize);
+}
+
+/// \param state is the decoding state to update to the current cache size
+void Sleigh::buildInstructionCache(SleighThreadState *state) const
+
+{
+  if (state->inscache != (InstructionCache *)0) {
+    detached_hits += state->inscache->getHits();
+    detached_misses += state->inscache->getMisses();
+    delete state->inscache;
+    state->inscache = (InstructionCache *)0;
+  }
+  if (inscache_size != 0)
+    state->inscache = new InstructionCache(state->cache,inscache_size);
+}
+
+/// Statistics from the state's InstructionCache are folded into the translator's totals.
+/// \param state is the decoding state to free
+void Sleigh::releaseState(SleighThreadState *state) const
+
+{
+  if (state->inscache != (InstructionCache *)0) {
+    detached_hits += state->inscache->getHits();
+    detached_misses += state->inscache->getMisses();
+  }
+  delete state;
 }
 
 void Sleigh::initialize(DocumentStorage &store)
@@ -456,24 +748,86 @@ void Sleigh::initialize(DocumentStorage &store)
     if (el == (const Element *)0)
       throw LowlevelError("Could not find sleigh tag");
     restoreXml(el);
+    compileTemplates();
   }
   else
     reregisterContext();
-  uint4 parser_cachesize = 2;
-  uint4 parser_windowsize = 32;
+  parser_cachesize = 2;
+  parser_windowsize = 32;
   if ((maxdelayslotbytes > 1)||(unique_allocatemask != 0)) {
     parser_cachesize = 8;
     parser_windowsize = 256;
   }
-  discache = new DisassemblyCache(cache,getConstantSpace(),parser_cachesize,parser_windowsize);
+  buildDisassemblyCache(mainstate);
+  buildInstructionCache(mainstate);
+}
+
+/// Every p-code section of every Constructor is flattened (see ConstructTpl::compile()),
+/// so that SleighBuilder can instantiate it without re-examining each template field.
+void Sleigh::compileTemplates(void)
+
+{
+  AddrSpace *cspc = getConstantSpace();
+  AddrSpace *uspc = getUniqueSpace();
+  for(int4 i=0;i<symtab.numSymbols();++i) {
+    SubtableSymbol *sym = dynamic_cast<SubtableSymbol *>(symtab.findSymbol(i));
+    if (sym == (SubtableSymbol *)0) continue;
+    for(int4 j=0;j<sym->getNumConstructors();++j) {
+      Constructor *ct = sym->getConstructor(j);
+      if (ct->getTempl() != (ConstructTpl *)0)
+	ct->getTempl()->compile(cspc,uspc);
+      for(int4 k=0;k<ct->getNumSections();++k) {
+	ConstructTpl *tpl = ct->getNamedTempl(k);
+	if (tpl != (ConstructTpl *)0)
+	  tpl->compile(cspc,uspc);
+      }
+    }
+  }
+}
+
+/// The compiled specification is shared, but the calling thread gets its own
+/// context cache, ParserContext window, and p-code scratch space, which are used by
+/// all subsequent calls to oneInstruction(), printAssembly(), and instructionLength()
+/// made from this thread.  Changes to the underlying ContextDatabase and reads from
+/// the LoadImage are \e not synchronized and must be serialized by the caller.
+void Sleigh::attachThread(void) const
+
+{
+  if (!isInitialized())
+    throw LowlevelError("Cannot attach thread to uninitialized translator");
+  SleighThreadState *state = new SleighThreadState(this,context_db);
+  buildDisassemblyCache(state);
+  buildInstructionCache(state);
+  state->cache->allowSet(mainstate->cache->isAllowSet());
+  state->previous = threadstate;
+  threadstate = state;
+}
+
+/// The most recently attached state for \b this translator is removed from the
+/// calling thread and freed.
+void Sleigh::detachThread(void) const
+
+{
+  SleighThreadState **ptr = &threadstate;
+  while(*ptr != (SleighThreadState *)0) {
+    SleighThreadState *state = *ptr;
+    if (state->owner == this) {
+      *ptr = state->previous;
+      releaseState(state);
+      return;
+    }
+    ptr = &state->previous;
+  }
 }
 
 ParserContext *Sleigh::obtainContext(const Address &addr,int4 state) const
 
 { // Obtain a ParserContext for the instruction at the given -addr-.  This may be cached.
   // Make sure parsing has proceeded to at least the given -state.
-  ParserContext *pos = discache->getParserContext(addr);
+  ParserContext *pos = getState()->discache->getParserContext(addr);
   int4 curstate = pos->getParserState();
+  if (curstate != ParserContext::uninitialized && pos->isContextStale())
+    curstate = ParserContext::uninitialized;	// Context changed since instruction was decoded
   if (curstate >= state)
     return pos;
   if (curstate == ParserContext::uninitialized) {
@@ -490,7 +844,10 @@ void Sleigh::resolve(ParserContext &pos) const
 
 {				// Resolve ALL the constructors involved in the
 				// instruction at this address
-  loader->loadFill(pos.getBuffer(),16,pos.getAddr());
+  {
+    std::lock_guard<std::mutex> guard(loadlock);
+    loader->loadFill(pos.getBuffer(),16,pos.getAddr());
+  }
   ParserWalkerChange walker(&pos);
   pos.deallocateState(walker);	// Clear the previous resolve and initialize the walker
   Constructor *ct,*subct;
@@ -502,6 +859,8 @@ void Sleigh::resolve(ParserContext &pos) const
   pos.clearCommits();		// Clear any old context commits
   pos.loadContext();		// Get context for current address
   ct = root->resolve(walker);	// Base constructor
+  if (decodeprofiling)
+    countDecode(ct);
   walker.setConstructor(ct);
   ct->applyContext(walker);
   while(walker.isState()) {
@@ -517,6 +876,8 @@ void Sleigh::resolve(ParserContext &pos) const
       if (tsym != (TripleSymbol *)0) {
 	subct = tsym->resolve(walker);
 	if (subct != (Constructor *)0) {
+	  if (decodeprofiling)
+	    countDecode(subct);
 	  walker.setConstructor(subct);
 	  subct->applyContext(walker);
 	  break;
@@ -536,6 +897,7 @@ void Sleigh::resolve(ParserContext &pos) const
     }
   }
   pos.setNaddr(pos.getAddr()+pos.getLength());	// Update Naddr to pointer after instruction
+  pos.setFlowFlags(-1);
   pos.setParserState(ParserContext::disassembly);
 }
 
@@ -564,7 +926,7 @@ void Sleigh::resolveHandles(ParserContext &pos) const
       }
       else {			// Must be an expression
 	PatternExpression *patexp = sym->getDefiningExpression();
-	intb res = patexp->getValue(walker);
+	intb res = patexp->evaluate(walker);
 	FixedHandle &hand(walker.getParentHandle());
 	hand.space = pos.getConstSpace(); // Result of expression is a constant
 	hand.offset_space = (AddrSpace *)0;
@@ -577,8 +939,11 @@ void Sleigh::resolveHandles(ParserContext &pos) const
     if (oper >= numoper) {	// Finished processing constructor
       ConstructTpl *templ = ct->getTempl();
       if (templ != (ConstructTpl *)0) {
+	const CompiledConstructTpl *comp = templ->getCompiled();
 	HandleTpl *res = templ->getResult();
-	if (res != (HandleTpl *)0)	// Pop up handle to containing operand
+	if ((comp != (const CompiledConstructTpl *)0)&&comp->isResultFixed())
+	  walker.getParentHandle() = comp->getResult();	// Constant export, evaluated at load
+	else if (res != (HandleTpl *)0)	// Pop up handle to containing operand
 	  res->fix(walker.getParentHandle(),walker);
 	// If we need an indicator that the constructor exports nothing try
         // else
@@ -597,29 +962,165 @@ int4 Sleigh::instructionLength(const Address &baseaddr) const
   return pos->getLength();
 }
 
-int4 Sleigh::printAssembly(AssemblyEmit &emit,const Address &baseaddr) const
+/// The ops of each template are visited in the order SleighBuilder would emit them, descending into an
+/// operand at its BUILD directive, so \b lastop ends up as the last op of the instruction.  Branch targets
+/// are judged from their templates alone: \e inst_next makes the instruction fall through,
+/// \e inst_start is ignored, and any other target, including one taken from an operand, is a jump.
+/// Templates with delay slots, cross-builds, or labels can't be judged this way, nor can an
+/// unimplemented Constructor.
+/// \param st is the state of the resolved Constructor to scan
+/// \param lastop holds the last op visited so far
+/// \param flow accumulates the flow properties (other than falling through the last op)
+/// \return \b false if the instruction must be translated to find its flow
+bool Sleigh::scanFlow(const ConstructState *st,int4 &lastop,uint4 &flow)
 
 {
-  int4 sz;
+  ConstructTpl *templ = st->ct->getTempl();
+  if (templ == (ConstructTpl *)0) return false;
+  const CompiledConstructTpl *comp = templ->getCompiled();
+  if (comp == (const CompiledConstructTpl *)0) return false;
+  if (comp->numLabels() != 0) return false;
+  const vector<CompiledOpTpl> &ops( comp->getOps() );
+  const vector<CompiledVarnodeTpl> &vars( comp->getVars() );
+  for(int4 i=0;i<ops.size();++i) {
+    const CompiledOpTpl &op( ops[i] );
+    switch(op.opc) {
+    case BUILD:
+      {
+	const ConstructState *sub = st->resolve[op.arg];
+	if (sub->ct != (Constructor *)0 && !scanFlow(sub,lastop,flow))
+	  return false;
+      }
+      continue;
+    case DELAY_SLOT:
+    case CROSSBUILD:
+    case LABELBUILD:
+    case MACROBUILD:
+      return false;
+    case CPUI_BRANCH:
+    case CPUI_CBRANCH:
+      {
+	if (op.relative) return false;
+	ConstTpl::const_type tp = vars[op.firstinput].tpl->getOffset().getType();
+	if (tp == ConstTpl::j_next)
+	  flow |= flow_fallthru;
+	else if (tp != ConstTpl::j_start)
+	  flow |= flow_jump;
+      }
+      break;
+    case CPUI_BRANCHIND:
+      flow |= flow_indirect;
+      break;
+    case CPUI_CALL:
+      flow |= flow_call;
+      break;
+    case CPUI_CALLIND:
+      flow |= (flow_call | flow_indirect);
+      break;
+    case CPUI_RETURN:
+      flow |= flow_return;
+      break;
+    default:
+      break;
+    }
+    lastop = op.opc;
+  }
+  return true;
+}
 
-  ParserContext *pos = obtainContext(baseaddr,ParserContext::disassembly);
+/// The mnemonic and operands are printed into the listing buffers of the thread's state, which
+/// keep their storage between instructions.  The format of the streams is reset first, so
+/// each instruction prints as if to a fresh stream.
+/// \param state is the decoding state of the calling thread
+/// \param emit is the disassembly emitter
+/// \param pos is the instruction, resolved to at least the \e disassembly state
+void Sleigh::emitAssembly(SleighThreadState *state,AssemblyEmit &emit,ParserContext *pos) const
+
+{
   ParserWalker walker(pos);
   walker.baseState();
   
   Constructor *ct = walker.getConstructor();
-  ostringstream mons;
-  ct->printMnemonic(mons,walker);
-  ostringstream body;
-  ct->printBody(body,walker);
-  emit.dump(baseaddr,mons.str(),body.str());
-  sz = pos->getLength();
-  return sz;
+  state->mnembuffer.clear();
+  state->mnemstream.flags(ios::dec | ios::skipws);
+  state->mnemstream.fill(' ');
+  ct->printMnemonic(state->mnemstream,walker);
+  state->bodybuffer.clear();
+  state->bodystream.flags(ios::dec | ios::skipws);
+  state->bodystream.fill(' ');
+  ct->printBody(state->bodystream,walker);
+  emit.dump(pos->getAddr(),state->mnembuffer.str(),state->bodybuffer.str());
 }
 
-int4 Sleigh::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
+/// The instruction is only resolved to the \e disassembly state, and its flow is found from the
+/// templates of its Constructors (see scanFlow()), without building any p-code.  If the templates
+/// can't be judged, the instruction is translated instead.  The result is kept with the ParserContext,
+/// so asking again about a recently decoded address costs only the lookup.
+int4 Sleigh::instructionFlow(const Address &baseaddr,uint4 &flow) const
+
+{
+  ParserContext *pos = obtainContext(baseaddr,ParserContext::disassembly);
+  int4 flags = pos->getFlowFlags();
+  if (flags < 0) {
+    int4 lastop = CPUI_COPY;
+    uint4 fl = 0;
+    if (scanFlow(pos->getBaseState(),lastop,fl)) {
+      if (lastop != CPUI_BRANCH && lastop != CPUI_BRANCHIND && lastop != CPUI_RETURN)
+	fl |= flow_fallthru;
+    }
+    else {
+      Translate::instructionFlow(baseaddr,fl);
+      pos = obtainContext(baseaddr,ParserContext::disassembly);	// Translation may have reused the ParserContext
+    }
+    flags = fl;
+    pos->setFlowFlags(flags);
+  }
+  flow = flags;
+  return pos->getLength();
+}
+
+int4 Sleigh::printAssembly(AssemblyEmit &emit,const Address &baseaddr) const
+
+{
+  ParserContext *pos = obtainContext(baseaddr,ParserContext::disassembly);
+  emitAssembly(getState(),emit,pos);
+  return pos->getLength();
+}
+
+/// The instructions are only resolved to the \e disassembly state, so no operand handles are built,
+/// and the decoding state and listing buffers are looked up once for the whole run.
+int4 Sleigh::printAssemblyRun(AssemblyEmit &emit,const Address &baseaddr,int4 maxbytes) const
+
+{
+  SleighThreadState *state = getState();
+  int4 total = 0;
+  Address curaddr(baseaddr);
+  do {
+    ParserContext *pos;
+    try {
+      pos = obtainContext(curaddr,ParserContext::disassembly);
+    }
+    catch(LowlevelError &err) {
+      if (total == 0) throw;
+      break;
+    }
+    emitAssembly(state,emit,pos);
+    int4 length = pos->getLength();
+    total += length;
+    curaddr = curaddr + length;
+  } while(total < maxbytes);
+  return total;
+}
+
+/// \param emit is the p-code emitter
+/// \param baseaddr is the address of the machine instruction
+/// \param commits is set to \b true if the instruction changed the context of other addresses
+/// \return the length of the instruction in bytes
+int4 Sleigh::translateInstruction(PcodeEmit &emit,const Address &baseaddr,bool &commits) const
 
 {
   int4 fallOffset;
+  commits = false;
   if (alignment != 1) {
     if ((baseaddr.getOffset() % alignment)!=0) {
       ostringstream s;
@@ -628,7 +1129,15 @@ int4 Sleigh::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
     }
   }
   
+  SleighThreadState *state = getState();
+  if (state->inscache != (InstructionCache *)0) {
+    fallOffset = state->inscache->emit(baseaddr,emit);
+    if (fallOffset >= 0)
+      return fallOffset;
+  }
   ParserContext *pos = obtainContext(baseaddr,ParserContext::pcode);
+  commits = pos->hasCommits();
+  bool cacheable = !commits;
   pos->applyCommits();
   fallOffset = pos->getLength();
   
@@ -637,21 +1146,29 @@ int4 Sleigh::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
     do {
     // Do not pass pos->getNaddr() to obtainContext, as pos may have been previously cached and had naddr adjusted
       ParserContext *delaypos = obtainContext(pos->getAddr() + fallOffset,ParserContext::pcode);
+      if (delaypos->hasCommits()) {
+	commits = true;
+	pos->copyContext();	// Delay slot commits must not change the context pos is built with
+      }
       delaypos->applyCommits();
       int4 len = delaypos->getLength();
       fallOffset += len;
       bytecount += len;
     } while(bytecount < pos->getDelaySlot());
     pos->setNaddr(pos->getAddr()+fallOffset);
+    cacheable = false;
   }
   ParserWalker walker(pos);
   walker.baseState();
+  PcodeCacher &pcode_cache(state->pcode_cache);
   pcode_cache.clear();
-  SleighBuilder builder(&walker,discache,&pcode_cache,getConstantSpace(),getUniqueSpace(),unique_allocatemask);
+  SleighBuilder builder(&walker,state->discache,&pcode_cache,getConstantSpace(),getUniqueSpace(),unique_allocatemask);
   try {
-    builder.build(walker.getConstructor()->getTempl(),-1);
+    builder.buildCompiled(walker.getConstructor()->getTempl(),-1);
     pcode_cache.resolveRelatives();
     pcode_cache.emit(baseaddr,&emit);
+    if (cacheable && state->inscache != (InstructionCache *)0 && !builder.hasExternal())
+      state->inscache->store(baseaddr,fallOffset,pcode_cache);
   } catch(UnimplError &err) {
     ostringstream s;
     s << "Instruction not implemented in pcode:\n ";
@@ -670,6 +1187,43 @@ int4 Sleigh::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
   return fallOffset;
 }
 
+int4 Sleigh::oneInstruction(PcodeEmit &emit,const Address &baseaddr) const
+
+{
+  bool commits;
+  return translateInstruction(emit,baseaddr,commits);
+}
+
+/// Instructions are translated until one changes control-flow or sets context for other
+/// addresses, as an instruction after it may decode differently once the new context is in place.
+/// Only an error on the first instruction is reported; any later error just ends the run, so
+/// the caller sees it when translating that address directly.
+int4 Sleigh::translateRun(PcodeRun &run,const Address &baseaddr,int4 maxbytes,int4 maxinsn) const
+
+{
+  run.clear();
+  int4 total = 0;
+  Address curaddr(baseaddr);
+  while(run.numInstructions() < maxinsn) {
+    int4 length;
+    bool commits;
+    run.beginInstruction(curaddr);
+    try {
+      length = translateInstruction(run,curaddr,commits);
+    }
+    catch(LowlevelError &err) {
+      run.abortInstruction();
+      if (run.numInstructions() == 0) throw;
+      break;
+    }
+    run.endInstruction(length);
+    total += length;
+    if (commits || run.endsFlow() || total >= maxbytes) break;
+    curaddr = curaddr + length;
+  }
+  return total;
+}
+
 void Sleigh::registerContext(const string &name,int4 sbit,int4 ebit)
 
 {  // Inform translator of existence of context variable
@@ -685,6 +1239,89 @@ void Sleigh::setContextDefault(const string &name,uintm val)
 void Sleigh::allowContextSet(bool val) const
 
 {
-  cache->allowSet(val);
+  getState()->cache->allowSet(val);
+}
+
+/// The new size applies to the calling thread's state immediately (discarding anything
+/// it has cached) and to every thread state attached afterward.
+/// \param size is the maximum number of instructions per cache (0 disables caching)
+void Sleigh::setInstructionCacheSize(int4 size) const
+
+{
+  inscache_size = (size < 0) ? 0 : size;
+  if (isInitialized())
+    buildInstructionCache(getState());
+}
+
+/// Counts include the calling thread's cache and any caches that have already been freed.
+/// \param hits will hold the number of instructions served from a cache
+/// \param misses will hold the number of lookups that required decoding
+/// \return \b true
+bool Sleigh::getInstructionCacheStats(uintb &hits,uintb &misses) const
+
+{
+  hits = detached_hits;
+  misses = detached_misses;
+  const InstructionCache *inscache = getState()->inscache;
+  if (inscache != (const InstructionCache *)0) {
+    hits += inscache->getHits();
+    misses += inscache->getMisses();
+  }
+  return true;
+}
+
+/// The first time profiling is enabled, a counter is allocated for every Constructor of every
+/// subtable, all starting at zero.  Counts accumulate across later calls.  Only instructions
+/// that are actually parsed are counted: those served from the disassembly window or the
+/// instruction cache are not decoded again, and so are not counted again.
+/// \param val is \b true to start counting, \b false to stop
+/// \return \b true
+bool Sleigh::setDecodeProfiling(bool val) const
+
+{
+  if (val && profilecounts == (std::atomic<uint8> *)0) {
+    int4 total = 0;
+    profileoffset.assign(symtab.numSymbols(),-1);
+    for(int4 i=0;i<symtab.numSymbols();++i) {
+      SubtableSymbol *sym = dynamic_cast<SubtableSymbol *>(symtab.findSymbol(i));
+      if (sym == (SubtableSymbol *)0) continue;
+      profileoffset[i] = total;
+      total += sym->getNumConstructors();
+    }
+    profilecounts = new std::atomic<uint8>[total];
+    for(int4 i=0;i<total;++i)
+      profilecounts[i] = 0;
+  }
+  decodeprofiling = val;
+  return true;
+}
+
+/// The profile is an XML \<decodeprofile> tag containing a \<constructor> tag for every
+/// Constructor that was matched at least once, giving the name of its subtable, its index within
+/// the subtable, the line of the specification where it starts, and its count.  This is the
+/// format read by the \b -p option of the SLEIGH compiler.
+/// \param s is the output stream
+/// \return \b true
+bool Sleigh::saveDecodeProfile(ostream &s) const
+
+{
+  s << "<decodeprofile>\n";
+  for(int4 i=0;i<profileoffset.size();++i) {
+    if (profileoffset[i] < 0) continue;
+    SubtableSymbol *sym = (SubtableSymbol *)symtab.findSymbol(i);
+    for(int4 j=0;j<sym->getNumConstructors();++j) {
+      uint8 count = profilecounts[profileoffset[i] + j];
+      if (count == 0) continue;
+      Constructor *ct = sym->getConstructor(j);
+      s << "<constructor";
+      a_v(s,"table",sym->getName());
+      a_v_i(s,"id",j);
+      a_v_i(s,"line",ct->getLineno());
+      a_v_u(s,"count",count);
+      s << "/>\n";
+    }
+  }
+  s << "</decodeprofile>\n";
+  return true;
 }
 }
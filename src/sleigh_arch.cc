@@ -15,14 +15,33 @@
  */
 #include "sleigh_arch.hh"
 #include "inject_sleigh.hh"
+#include "slab.hh"
+
+#include <cstdio>
 
 namespace GhidraDec {
-Sleigh *SleighArchitecture::last_sleigh = (Sleigh *)0;
-int4 SleighArchitecture::last_languageindex;
+std::mutex SleighArchitecture::cachelock;
+list<SleighCacheEntry> SleighArchitecture::translatorcache;
+int4 SleighArchitecture::translatorcachesize = 4;
 vector<LanguageDescription> SleighArchitecture::description;
+SleighIndex SleighArchitecture::index;
 
 FileManage SleighArchitecture::specpaths; // Global specfile manager
 
+void SleighCacheEntry::clear(void)
+
+{
+  snippets.clear();		// Templates refer to the spaces of the translator
+  if (sleigh != (Sleigh *)0) {
+    delete sleigh;
+    sleigh = (Sleigh *)0;
+  }
+  map<string,Document *>::iterator iter;
+  for(iter=specdocs.begin();iter!=specdocs.end();++iter)
+    delete (*iter).second;
+  specdocs.clear();
+}
+
 /// Read file attributes from an XML \<compiler> tag
 /// \param el is the XML element
 void CompilerTag::restoreXml(const Element *el)
@@ -33,6 +52,17 @@ void CompilerTag::restoreXml(const Element *el)
   id = el->getAttributeValue("id");
 }
 
+/// \param s is the output stream
+void CompilerTag::saveXml(ostream &s) const
+
+{
+  s << "<compiler";
+  a_v(s,"name",name);
+  a_v(s,"spec",spec);
+  a_v(s,"id",id);
+  s << "/>\n";
+}
+
 /// Parse an ldefs \<language> tag
 /// \param el is the XML element
 void LanguageDescription::restoreXml(const Element *el)
@@ -70,6 +100,275 @@ void LanguageDescription::restoreXml(const Element *el)
   }
 }
 
+/// The tag has the same form as in a .ldefs file, so it can be read back by restoreXml().
+/// \param s is the output stream
+void LanguageDescription::saveXml(ostream &s) const
+
+{
+  s << "<language";
+  a_v(s,"processor",processor);
+  a_v(s,"endian",isbigendian ? "big" : "little");
+  a_v_i(s,"size",size);
+  a_v(s,"variant",variant);
+  a_v(s,"version",version);
+  a_v(s,"slafile",slafile);
+  a_v(s,"processorspec",processorspec);
+  a_v(s,"id",id);
+  if (deprecated)
+    a_v_b(s,"deprecated",true);
+  s << ">\n";
+  s << "<description>";
+  xml_escape(s,description.c_str());
+  s << "</description>\n";
+  for(int4 i=0;i<compilers.size();++i)
+    compilers[i].saveXml(s);
+  for(int4 i=0;i<truncations.size();++i)
+    truncations[i].saveXml(s);
+  s << "</language>\n";
+}
+
+/// \param path is the file or directory
+/// \param mtime is the recorded modification time
+/// \return \b true if the path exists and still has the same modification time
+bool SleighIndex::isCurrent(const string &path,time_t mtime)
+
+{
+  time_t cur;
+  if (!FileManage::getModificationTime(path,cur))
+    return false;
+  return (cur == mtime);
+}
+
+/// \param el is the root \<sleighindex> element
+/// \return \b true if the index was read completely
+bool SleighIndex::restoreXml(const Element *el)
+
+{
+  if (el->getName() != "sleighindex") return false;
+  root = el->getAttributeValue("root");
+  const List &list(el->getChildren());
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter) {
+    const Element *subel = *iter;
+    istringstream s(subel->getAttributeValue("mtime"));
+    intb mtime = 0;
+    s >> mtime;
+    const string &path( subel->getAttributeValue("path") );
+    if (subel->getName() == "scanned")
+      scanned.push_back(pair<string,time_t>(path,(time_t)mtime));
+    else if (subel->getName() == "languagedir") {
+      dirorder.push_back(path);
+      LanguageDir &dir( languagedirs[path] );
+      dir.mtime = (time_t)mtime;
+      dir.complete = xml_readbool(subel->getAttributeValue("complete"));
+      const List &sublist(subel->getChildren());
+      List::const_iterator subiter;
+      for(subiter=sublist.begin();subiter!=sublist.end();++subiter) {
+	const Element *langel = *subiter;
+	if (langel->getName() == "ldefs") {
+	  istringstream s2(langel->getAttributeValue("mtime"));
+	  intb filetime = 0;
+	  s2 >> filetime;
+	  dir.ldefs.push_back(pair<string,time_t>(langel->getAttributeValue("path"),(time_t)filetime));
+	}
+	else if (langel->getName() == "language") {
+	  dir.languages.push_back(LanguageDescription());
+	  dir.languages.back().restoreXml(langel);
+	}
+      }
+    }
+    else
+      return false;
+  }
+  return true;
+}
+
+/// \param s is the output stream
+void SleighIndex::saveXml(ostream &s) const
+
+{
+  s << "<sleighindex";
+  a_v(s,"root",root);
+  s << ">\n";
+  for(int4 i=0;i<scanned.size();++i) {
+    s << "<scanned";
+    a_v(s,"path",scanned[i].first);
+    a_v_i(s,"mtime",scanned[i].second);
+    s << "/>\n";
+  }
+  for(int4 i=0;i<dirorder.size();++i) {
+    const LanguageDir &dir( (*languagedirs.find(dirorder[i])).second );
+    s << "<languagedir";
+    a_v(s,"path",dirorder[i]);
+    a_v_i(s,"mtime",dir.mtime);
+    a_v_b(s,"complete",dir.complete);
+    s << ">\n";
+    for(int4 j=0;j<dir.ldefs.size();++j) {
+      s << "<ldefs";
+      a_v(s,"path",dir.ldefs[j].first);
+      a_v_i(s,"mtime",dir.ldefs[j].second);
+      s << "/>\n";
+    }
+    for(int4 j=0;j<dir.languages.size();++j)
+      dir.languages[j].saveXml(s);
+    s << "</languagedir>\n";
+  }
+  s << "</sleighindex>\n";
+}
+
+/// The index is only used if it was made by a scan of the same root path, and every directory
+/// the scan examined still has the same modification time.  A language directory whose .ldefs
+/// files changed keeps its place in the search order, but its languages are read again.
+/// \param rootpath is the root path about to be scanned
+/// \return \b true if the recorded scan can be used in place of a new one
+bool SleighIndex::load(const string &rootpath)
+
+{
+  if (filename.empty()) return false;
+  beginScan(rootpath);
+  ifstream s(filename.c_str());
+  if (!s) return false;
+  Document *doc;
+  try {
+    doc = xml_tree(s);
+  }
+  catch(XmlError &err) {
+    return false;
+  }
+  bool res = false;
+  try {
+    res = restoreXml(doc->getRoot());
+  }
+  catch(LowlevelError &err) {
+    res = false;
+  }
+  delete doc;
+  if (res && (root == rootpath)) {
+    for(int4 i=0;i<scanned.size();++i) {
+      if (!isCurrent(scanned[i].first,scanned[i].second)) {
+	res = false;
+	break;
+      }
+    }
+  }
+  else
+    res = false;
+  if (!res) {
+    beginScan(rootpath);
+    return false;
+  }
+  map<string,LanguageDir>::iterator iter;
+  for(iter=languagedirs.begin();iter!=languagedirs.end();++iter) {
+    LanguageDir &dir( (*iter).second );
+    if (!dir.complete) continue;
+    bool current = isCurrent((*iter).first,dir.mtime);
+    for(int4 i=0;current && i<dir.ldefs.size();++i)
+      current = isCurrent(dir.ldefs[i].first,dir.ldefs[i].second);
+    if (!current) {
+      dir.complete = false;	// Read this directory again
+      dir.ldefs.clear();
+      dir.languages.clear();
+    }
+  }
+  dirty = false;
+  return true;
+}
+
+/// Everything recorded is thrown away.
+/// \param rootpath is the root path being scanned
+void SleighIndex::beginScan(const string &rootpath)
+
+{
+  root = rootpath;
+  scanned.clear();
+  dirorder.clear();
+  languagedirs.clear();
+  dirty = !filename.empty();
+}
+
+/// \param dir is the directory
+void SleighIndex::recordScanned(const string &dir)
+
+{
+  if (filename.empty()) return;
+  time_t mtime;
+  if (!FileManage::getModificationTime(dir,mtime)) return;
+  scanned.push_back(pair<string,time_t>(dir,mtime));
+}
+
+/// \param dir is the directory, as it appears in the search path
+void SleighIndex::recordLanguageDir(const string &dir)
+
+{
+  if (filename.empty()) return;
+  if (languagedirs.find(dir) != languagedirs.end()) return;
+  dirorder.push_back(dir);
+  languagedirs[dir];
+}
+
+/// \param dir is a directory in the search path
+/// \return the languages from the .ldefs files in the directory, or null if they aren't recorded
+const vector<LanguageDescription> *SleighIndex::findLanguages(const string &dir) const
+
+{
+  map<string,LanguageDir>::const_iterator iter = languagedirs.find(dir);
+  if (iter == languagedirs.end()) return (const vector<LanguageDescription> *)0;
+  if (!(*iter).second.complete) return (const vector<LanguageDescription> *)0;
+  return &(*iter).second.languages;
+}
+
+/// \param dir is a directory in the search path
+/// \return \b true if the directory was found by the scan, and so belongs in the index
+bool SleighIndex::isRecorded(const string &dir) const
+
+{
+  if (filename.empty()) return false;
+  return (languagedirs.find(dir) != languagedirs.end());
+}
+
+/// \param dir is the language directory, as it appears in the search path
+/// \param files are the .ldefs files in the directory
+/// \param langs are the languages read from the files, in order
+void SleighIndex::recordLanguages(const string &dir,const vector<string> &files,const vector<LanguageDescription> &langs)
+
+{
+  map<string,LanguageDir>::iterator iter = languagedirs.find(dir);
+  if (iter == languagedirs.end()) return;
+  LanguageDir &rec( (*iter).second );
+  rec.ldefs.clear();
+  if (!FileManage::getModificationTime(dir,rec.mtime)) return;
+  for(int4 i=0;i<files.size();++i) {
+    time_t mtime;
+    if (!FileManage::getModificationTime(files[i],mtime)) return;
+    rec.ldefs.push_back(pair<string,time_t>(files[i],mtime));
+  }
+  rec.languages = langs;
+  rec.complete = true;
+  dirty = true;
+}
+
+/// The index is written to a temporary file that is renamed over the old one, so a process
+/// reading the index at the same time never sees a partial file.  Failure to write is ignored.
+void SleighIndex::save(void)
+
+{
+  if (!dirty || filename.empty()) return;
+  dirty = false;
+  string tmpname = filename + ".tmp";
+  {
+    ofstream s(tmpname.c_str());
+    if (!s) return;
+    saveXml(s);
+    s.close();
+    if (!s) {
+      remove(tmpname.c_str());
+      return;
+    }
+  }
+  if (rename(tmpname.c_str(),filename.c_str()) != 0)
+    remove(tmpname.c_str());
+}
+
 /// Pick out the CompilerTag associated with the desired \e compiler \e id string
 /// \param nm is the desired id string
 /// \return a reference to the matching CompilerTag
@@ -124,6 +423,7 @@ SleighArchitecture::~SleighArchitecture(void)
 
 {
   translate = (const Translate *)0;
+  releaseCacheEntry();
 }
 
 string SleighArchitecture::getDescription(void) const
@@ -132,32 +432,94 @@ string SleighArchitecture::getDescription(void) const
   return description[languageindex].getDescription();
 }
 
-/// If the current \b languageindex matches the \b last_languageindex,
-/// try to reuse the previous Sleigh object, so we don't reload
-/// the .sla file.
-/// \return \b true if it can be reused
-bool SleighArchitecture::isTranslateReused(void)
+/// Unclaimed entries are freed, starting with the least recently used, until no more than the
+/// given number remain.  Entries claimed by a live SleighArchitecture are never freed, so the
+/// cache can temporarily hold more than the limit.  The caller must hold the lock.
+/// \param max is the number of entries to keep
+void SleighArchitecture::trimTranslatorCache(int4 max)
 
 {
-  if (last_sleigh == (Sleigh *)0) return false;
-  if (last_languageindex == languageindex) return true;
-  delete last_sleigh;		// It doesn't match so free old Translate
-  last_sleigh = (Sleigh *)0;
-  return false;
+  list<SleighCacheEntry>::iterator iter = translatorcache.end();
+  while(translatorcache.size() > max && iter != translatorcache.begin()) {
+    --iter;
+    if ((*iter).inuse) continue;
+    (*iter).clear();
+    iter = translatorcache.erase(iter);
+  }
 }
 
-Translate *SleighArchitecture::buildTranslator(DocumentStorage &store)
+/// The first call looks for an unclaimed entry with the \e language \e id of the current
+/// \b languageindex and moves it to the front of the cache, or creates a new (empty) entry
+/// if there is none, evicting the least recently used unclaimed entry if the cache is full.
+/// The entry is then claimed by \b this until releaseCacheEntry(), and later calls return it
+/// directly.  List nodes do not move when the list is spliced, so the reference stays valid.
+/// \return the cache entry for the active language
+SleighCacheEntry &SleighArchitecture::obtainCacheEntry(void)
 
-{				// Build a sleigh translator
-  if (isTranslateReused()) {
-    last_sleigh->reset(loader,context);
-    return last_sleigh;
+{
+  if (cacheentry != (SleighCacheEntry *)0)
+    return *cacheentry;
+  std::lock_guard<std::mutex> guard(cachelock);
+  const string &id(description[languageindex].getId());
+  list<SleighCacheEntry>::iterator iter;
+  for(iter=translatorcache.begin();iter!=translatorcache.end();++iter) {
+    if ((*iter).languageid == id && !(*iter).inuse) {
+      if (iter != translatorcache.begin())
+	translatorcache.splice(translatorcache.begin(),translatorcache,iter);
+      break;
+    }
   }
-  else {
-    last_sleigh = new Sleigh(loader,context);
-    last_languageindex = languageindex;
-    return last_sleigh;
+  if (iter == translatorcache.end()) {
+    trimTranslatorCache(translatorcachesize - 1);
+    translatorcache.push_front(SleighCacheEntry(id));
   }
+  cacheentry = &translatorcache.front();
+  cacheentry->inuse = true;
+  return *cacheentry;
+}
+
+/// The entry, along with its translator, stays in the cache for the next SleighArchitecture
+/// using the same language.  Any entries over the limit that were kept only because they were
+/// claimed are freed now.
+void SleighArchitecture::releaseCacheEntry(void)
+
+{
+  if (cacheentry == (SleighCacheEntry *)0) return;
+  std::lock_guard<std::mutex> guard(cachelock);
+  cacheentry->inuse = false;
+  cacheentry = (SleighCacheEntry *)0;
+  trimTranslatorCache(translatorcachesize);
+}
+
+/// The parsed document is owned by the cache entry, so the file is only read the first
+/// time it is requested for the language.
+/// \param entry is the cache entry for the active language
+/// \param specfile is the path to the .pspec or .cspec file
+/// \return the root element of the parsed file
+const Element *SleighArchitecture::openSpecFile(SleighCacheEntry &entry,const string &specfile)
+
+{
+  map<string,Document *>::const_iterator iter = entry.specdocs.find(specfile);
+  if (iter != entry.specdocs.end())
+    return (*iter).second->getRoot();
+  ifstream s(specfile.c_str());
+  if (!s)
+    throw XmlError("Unable to open xml document "+specfile);
+  Document *doc = xml_tree(s);
+  s.close();
+  entry.specdocs[specfile] = doc;
+  return doc->getRoot();
+}
+
+Translate *SleighArchitecture::buildTranslator(DocumentStorage &store)
+
+{				// Build a sleigh translator
+  SleighCacheEntry &entry(obtainCacheEntry());
+  if (entry.sleigh != (Sleigh *)0)
+    entry.sleigh->reset(loader,context);
+  else
+    entry.sleigh = new Sleigh(loader,context);
+  return entry.sleigh;
 }
 
 PcodeInjectLibrary *SleighArchitecture::buildPcodeInjectLibrary(void)
@@ -165,7 +527,9 @@ PcodeInjectLibrary *SleighArchitecture::buildPcodeInjectLibrary(void)
 { // Build the pcode injector based on sleigh
   PcodeInjectLibrary *res;
 
-  res = new PcodeInjectLibrarySleigh(this,translate->getUniqueBase());
+  PcodeInjectLibrarySleigh *sleighres = new PcodeInjectLibrarySleigh(this,translate->getUniqueBase());
+  sleighres->setSnippetCache(&obtainCacheEntry().snippets);
+  res = sleighres;
   return res;
 }
 
@@ -203,7 +567,8 @@ void SleighArchitecture::resolveArchitecture(void)
 void SleighArchitecture::buildSpecFile(DocumentStorage &store)
 
 { // Given a specific language, make sure relevant spec files are loaded
-  bool language_reuse = isTranslateReused();
+  SleighCacheEntry &entry(obtainCacheEntry());
+  bool language_reuse = (entry.sleigh != (Sleigh *)0 && entry.sleigh->isInitialized());
   const LanguageDescription &language(description[languageindex]);
   string compiler = archid.substr(archid.rfind(':')+1);
   const CompilerTag &compilertag( language.getCompiler(compiler));
@@ -211,15 +576,19 @@ void SleighArchitecture::buildSpecFile(DocumentStorage &store)
   string processorfile;
   string compilerfile;
   string slafile;
+  string slabfile;
   
   specpaths.findFile(processorfile,language.getProcessorSpec());
   specpaths.findFile(compilerfile,compilertag.getSpec());
-  if (!language_reuse)
+  if (!language_reuse) {
     specpaths.findFile(slafile,language.getSlaFile());
+    specpaths.findFile(slabfile,language.getSlaFile() + 'b');	// Binary form, "x.sla" -> "x.slab"
+    if (!slab_current(slabfile,slafile))
+      slabfile.clear();
+  }
   
   try {
-    Document *doc = store.openDocument(processorfile);
-    store.registerTag(doc->getRoot());
+    store.registerTag(openSpecFile(entry,processorfile));
   }
   catch(XmlError &err) {
     ostringstream serr;
@@ -235,8 +604,7 @@ void SleighArchitecture::buildSpecFile(DocumentStorage &store)
   }
   
   try {
-    Document *doc = store.openDocument(compilerfile);
-    store.registerTag(doc->getRoot());
+    store.registerTag(openSpecFile(entry,compilerfile));
   }
   catch(XmlError &err) {
     ostringstream serr;
@@ -251,6 +619,17 @@ void SleighArchitecture::buildSpecFile(DocumentStorage &store)
     throw SleighError(serr.str());
   }
 
+  if (!language_reuse && !slabfile.empty()) {
+    try {
+      Document *doc = store.addDocument(slab_open(slabfile));
+      store.registerTag(doc->getRoot());
+      return;
+    }
+    catch(XmlError &err) {	// Fall back to the XML form
+      printMessage("WARNING: Unable to use binary SLEIGH file: " + err.explain);
+    }
+  }
+
   if (!language_reuse) {
     try {
       Document *doc = store.openDocument(slafile);
@@ -293,6 +672,7 @@ SleighArchitecture::SleighArchitecture(const string &fname,const string &targ,os
   filename = fname;
   target = targ;
   errorstream = estream;
+  cacheentry = (SleighCacheEntry *)0;
 }
 
 /// This is run once when spinning up the decompiler.
@@ -302,13 +682,27 @@ SleighArchitecture::SleighArchitecture(const string &fname,const string &targ,os
 void SleighArchitecture::collectSpecFiles(ostream &errs)
 
 {
+  std::lock_guard<std::mutex> guard(cachelock);
   if (!description.empty()) return; // Have we already collected before
 
-  vector<string> testspecs;
-  vector<string>::iterator iter;
-  specpaths.matchList(testspecs,".ldefs",true);
-  for(iter=testspecs.begin();iter!=testspecs.end();++iter)
-    loadLanguageDescription(*iter,errs);
+  const vector<string> &paths( specpaths.getPaths() );
+  for(int4 i=0;i<paths.size();++i) {
+    const vector<LanguageDescription> *cached = index.findLanguages(paths[i]);
+    if (cached != (const vector<LanguageDescription> *)0) {
+      description.insert(description.end(),cached->begin(),cached->end());
+      continue;
+    }
+    vector<string> testspecs;
+    FileManage::matchListDir(testspecs,".ldefs",true,paths[i],false);
+    int4 start = description.size();
+    for(int4 j=0;j<testspecs.size();++j)
+      loadLanguageDescription(testspecs[j],errs);
+    if (index.isRecorded(paths[i])) {
+      vector<LanguageDescription> langs(description.begin()+start,description.end());
+      index.recordLanguages(paths[i],testspecs,langs);
+    }
+  }
+  index.save();
 }
 
 /// \param s is the XML output stream
@@ -419,55 +813,87 @@ string SleighArchitecture::normalizeArchitecture(const string &nm)
 ///
 /// This assumes a standard "Ghidra/Processors/*/data/languages" layout.  It
 /// scans for all matching directories and prepares for reading .ldefs files.
+/// If an index file is set (see setIndexFile()) and still matches the file system,
+/// the directories recorded in it are used instead of scanning.
 /// \param rootpath is the root path of the Ghidra installation
 void SleighArchitecture::scanForSleighDirectories(const string &rootpath)
 
 {
+  if (index.load(rootpath)) {
+    const vector<string> &dirs( index.getLanguageDirs() );
+    for(uint4 i=0;i<dirs.size();++i)
+      specpaths.addDir2Path(dirs[i]);
+    return;
+  }
+
   vector<string> ghidradir;
   vector<string> procdir;
   vector<string> procdir2;
   vector<string> languagesubdirs;
 
+  index.recordScanned(rootpath);
   FileManage::scanDirectoryRecursive(ghidradir,"Ghidra",rootpath,2);
   for(uint4 i=0;i<ghidradir.size();++i) {
+    index.recordScanned(ghidradir[i]);
     FileManage::scanDirectoryRecursive(procdir,"Processors",ghidradir[i],1); // Look for Processors structure
     FileManage::scanDirectoryRecursive(procdir,"contrib",ghidradir[i],1);
   }
   if (procdir.size()!=0) {
-    for(uint4 i=0;i<procdir.size();++i)
+    for(uint4 i=0;i<procdir.size();++i) {
+      index.recordScanned(procdir[i]);
       FileManage::directoryList(procdir2,procdir[i]);
+    }
 
     vector<string> datadirs;
-    for(uint4 i=0;i<procdir2.size();++i)
+    for(uint4 i=0;i<procdir2.size();++i) {
+      index.recordScanned(procdir2[i]);
       FileManage::scanDirectoryRecursive(datadirs,"data",procdir2[i],1);
+    }
     
     vector<string> languagedirs;
-    for(uint4 i=0;i<datadirs.size();++i)
+    for(uint4 i=0;i<datadirs.size();++i) {
+      index.recordScanned(datadirs[i]);
       FileManage::scanDirectoryRecursive(languagedirs,"languages",datadirs[i],1);
+    }
     
     for(uint4 i=0;i<languagedirs.size();++i)
       languagesubdirs.push_back( languagedirs[i] );
 
     // In the old version we have to go down one more level to get to the ldefs
-    for(uint4 i=0;i<languagedirs.size();++i)
+    for(uint4 i=0;i<languagedirs.size();++i) {
+      index.recordScanned(languagedirs[i]);
       FileManage::directoryList(languagesubdirs,languagedirs[i]);
+    }
   }
   // If we haven't matched this directory structure, just use the rootpath as the directory containing
   // the ldef
   if (languagesubdirs.size() == 0)
     languagesubdirs.push_back( rootpath );
 
-  for(uint4 i=0;i<languagesubdirs.size();++i)
+  for(uint4 i=0;i<languagesubdirs.size();++i) {
     specpaths.addDir2Path(languagesubdirs[i]);
+    index.recordLanguageDir(specpaths.getPaths().back());
+  }
+}
+
+/// If the cache currently holds more translators than the new limit, the least
+/// recently used ones are freed immediately.
+/// \param max is the maximum number of languages to keep translators for (at least 1)
+void SleighArchitecture::setTranslatorCacheSize(int4 max)
+
+{
+  if (max < 1)
+    throw LowlevelError("Translator cache must hold at least one entry");
+  std::lock_guard<std::mutex> guard(cachelock);
+  translatorcachesize = max;
+  trimTranslatorCache(max);
 }
 
 void SleighArchitecture::shutdown(void)
 
 {
-  if (last_sleigh != (Sleigh *)0) {
-    delete last_sleigh;
-    last_sleigh = (Sleigh *)0;
-  }
+  std::lock_guard<std::mutex> guard(cachelock);
+  trimTranslatorCache(0);
   // description.clear();  // static vector is destroyed by the normal exit handler
 }
 }
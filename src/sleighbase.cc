@@ -26,7 +26,8 @@ SleighBase::SleighBase(void)
 }
 
 /// Assuming the symbol table is populated, iterate through the table collecting
-/// registers (for the map), user-op names, and context fields.
+/// registers (for the map), user-op names, and context fields.  The hashed indices of
+/// the registers, by exact location and by name, are built from the map.
 void SleighBase::buildXrefs(void)
 
 {
@@ -63,6 +64,15 @@ void SleighBase::buildXrefs(void)
   }
   if (errors > 0)
     throw SleighError(s.str());
+  register_exact.clear();
+  register_byname.clear();
+  register_exact.reserve(varnode_xref.size());
+  register_byname.reserve(varnode_xref.size());
+  map<VarnodeData,string>::const_iterator xiter;
+  for(xiter=varnode_xref.begin();xiter!=varnode_xref.end();++xiter) {
+    register_exact[(*xiter).first] = &(*xiter).second;
+    register_byname[(*xiter).second] = &(*xiter).first;
+  }
 }
 
 /// If \b this SleighBase is being reused with a new program, the context
@@ -95,6 +105,9 @@ void SleighBase::addRegister(const string &nm,AddrSpace *base,uintb offset,int4
 const VarnodeData &SleighBase::getRegister(const string &nm) const
 
 {
+  std::unordered_map<string,const VarnodeData *>::const_iterator hiter = register_byname.find(nm);
+  if (hiter != register_byname.end())
+    return *(*hiter).second;
   VarnodeSymbol *sym = (VarnodeSymbol *)findSymbol(nm);
   if (sym == (VarnodeSymbol *)0)
     throw SleighError("Unknown register name: "+nm);
@@ -103,6 +116,8 @@ const VarnodeData &SleighBase::getRegister(const string &nm) const
   return sym->getFixedVarnode();
 }
 
+/// A register at exactly the given location is found in the hashed index.  Otherwise the
+/// map is searched for the register containing the location.
 string SleighBase::getRegisterName(AddrSpace *base,uintb off,int4 size) const
 
 {
@@ -110,6 +125,9 @@ string SleighBase::getRegisterName(AddrSpace *base,uintb off,int4 size) const
   sym.space = base;
   sym.offset = off;
   sym.size = size;
+  std::unordered_map<VarnodeData,const string *,VarnodeDataHash>::const_iterator hiter = register_exact.find(sym);
+  if (hiter != register_exact.end())
+    return *(*hiter).second;
   map<VarnodeData,string>::const_iterator iter = varnode_xref.upper_bound(sym); // First point greater than offset
   if (iter == varnode_xref.begin()) return "";
   iter--;
@@ -15,7 +15,13 @@
  */
 #include "slgh_compile.hh"
 #include "filemanage.hh"
+#include "slab.hh"
 #include <csignal>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <exception>
 
 namespace GhidraDec {
 SleighCompile *slgh;		// Global pointer to sleigh object for use with parser
@@ -184,6 +190,50 @@ SubtableSymbol *WithBlock::getCurrentSubtable(const list<WithBlock> &stack)
   return (SubtableSymbol *)0;
 }
 
+/// \brief Run a set of independent tasks on a pool of threads
+///
+/// Task indices are handed out in increasing order, and the calling thread acts as worker 0.
+/// An exception thrown by a task is caught, and all remaining tasks still run. The exception of
+/// the lowest numbered failing task is handed back, so the caller can report everything up to
+/// that task before rethrowing it, as a sequential run would have.
+/// \param numworkers is the number of threads to use
+/// \param numtasks is the number of tasks
+/// \param fn is called with the worker index and the task index, for every task
+/// \param err will hold the exception of the first failing task (if any)
+/// \return the index of the first failing task, or \b numtasks if none failed
+static int4 parallelTasks(int4 numworkers,int4 numtasks,const std::function<void(int4,int4)> &fn,
+			  std::exception_ptr &err)
+
+{
+  vector<std::exception_ptr> errs(numtasks);
+  std::atomic<int4> next(0);
+  auto work = [&](int4 worker) {
+    for(;;) {
+      int4 task = next.fetch_add(1);
+      if (task >= numtasks) break;
+      try {
+	fn(worker,task);
+      }
+      catch(...) {
+	errs[task] = std::current_exception();
+      }
+    }
+  };
+  vector<std::thread> threads;
+  for(int4 i=1;i<numworkers;++i)
+    threads.emplace_back(work,i);
+  work(0);
+  for(int4 i=0;i<threads.size();++i)
+    threads[i].join();
+  for(int4 i=0;i<numtasks;++i) {
+    if (errs[i]) {
+      err = errs[i];
+      return i;
+    }
+  }
+  return numtasks;
+}
+
 ConsistencyChecker::ConsistencyChecker(SubtableSymbol *rt,bool un,bool warndead)
 
 {
@@ -193,6 +243,8 @@ ConsistencyChecker::ConsistencyChecker(SubtableSymbol *rt,bool un,bool warndead)
   writenoread = 0;
   printextwarning = un;
   printdeadwarning = warndead;
+  numthreads = 1;
+  msgout = &cerr;
 }
 
 int4 ConsistencyChecker::recoverSize(const ConstTpl &sizeconst,Constructor *ct)
@@ -232,9 +284,9 @@ void ConsistencyChecker::dealWithUnnecessaryExt(OpTpl *op,Constructor *ct)
 { // Deal with detected extension (SEXT or ZEXT) where the
   // input size is the same as the output size
   if (printextwarning) {
-    cerr << "Unnecessary ";
-    printOpName(cerr,op);
-    cerr << " in constructor starting at line " << dec << ct->getLineno() << endl;
+    *msgout << "Unnecessary ";
+    printOpName(*msgout,op);
+    *msgout << " in constructor starting at line " << dec << ct->getLineno() << endl;
   }
   op->setOpcode(CPUI_COPY);	// Equivalent to copy
   unnecessarypcode += 1;
@@ -244,9 +296,9 @@ void ConsistencyChecker::dealWithUnnecessaryTrunc(OpTpl *op,Constructor *ct)
 
 {
   if (printextwarning) {
-    cerr << "Unnecessary ";
-    printOpName(cerr,op);
-    cerr << " in constructor starting at line " << dec << ct->getLineno() << endl;
+    *msgout << "Unnecessary ";
+    printOpName(*msgout,op);
+    *msgout << " in constructor starting at line " << dec << ct->getLineno() << endl;
   }
   op->setOpcode(CPUI_COPY);	// Equivalent to copy
   op->removeInput(1);
@@ -261,7 +313,7 @@ bool ConsistencyChecker::checkOpMisuse(OpTpl *op,Constructor *ct)
     {
       VarnodeTpl *vn = op->getIn(1);
       if (vn->getSpace().isConstSpace() && vn->getOffset().isZero()) {
-	cerr << "Unsigned comparison with zero is always false in constructor starting at line " << dec << ct->getLineno() << endl;
+	*msgout << "Unsigned comparison with zero is always false in constructor starting at line " << dec << ct->getLineno() << endl;
       }
     }
     break;
@@ -772,21 +824,21 @@ void ConsistencyChecker::printOpError(OpTpl *op,Constructor *ct,int4 err1,int4 e
     op2 = getOperandSymbol(err2,op,ct);
   else
     op2 = (OperandSymbol *)0;
-  cerr << "Size restriction error in table \"" << sym->getName() << "\"" << endl;
-  cerr << "  in constructor starting at line " << dec << ct->getLineno() << endl;
+  *msgout << "Size restriction error in table \"" << sym->getName() << "\"" << endl;
+  *msgout << "  in constructor starting at line " << dec << ct->getLineno() << endl;
   if ((op1 != (OperandSymbol *)0)&&(op2 != (OperandSymbol *)0)) {
-    cerr << "  Problem with \"" << op1->getName();
-    cerr << "\" and \"" << op2->getName() << "\"";
+    *msgout << "  Problem with \"" << op1->getName();
+    *msgout << "\" and \"" << op2->getName() << "\"";
   }
   else if (op1 != (OperandSymbol *)0)
-    cerr << "  Problem with \"" << op1->getName() << "\"";
+    *msgout << "  Problem with \"" << op1->getName() << "\"";
   else if (op2 != (OperandSymbol *)0)
-    cerr << "  Problem with \"" << op2->getName() << "\"";
+    *msgout << "  Problem with \"" << op2->getName() << "\"";
   else
-    cerr << "  Problem";
-  cerr << " in ";
-  printOpName(cerr,op);
-  cerr << " operator" << endl << "  " << msg << endl;
+    *msgout << "  Problem";
+  *msgout << " in ";
+  printOpName(*msgout,op);
+  *msgout << " operator" << endl << "  " << msg << endl;
 }
 
 bool ConsistencyChecker::checkConstructorSection(Constructor *ct,ConstructTpl *cttpl)
@@ -879,8 +931,8 @@ bool ConsistencyChecker::checkSubtable(SubtableSymbol *sym)
     HandleTpl *exportres = ct->getTempl()->getResult();
     if (exportres != (HandleTpl *)0) {
       if (seenemptyexport && (!seennonemptyexport)) {
-	cerr << "Table " << sym->getName() << " exports inconsistently" << endl;
-	cerr << "Constructor starting at line " << dec << ct->getLineno() << " is first inconsistency" << endl;
+	*msgout << "Table " << sym->getName() << " exports inconsistently" << endl;
+	*msgout << "Constructor starting at line " << dec << ct->getLineno() << " is first inconsistency" << endl;
 	testresult = false;
       }
       seennonemptyexport = true;
@@ -888,15 +940,15 @@ bool ConsistencyChecker::checkSubtable(SubtableSymbol *sym)
       if (tablesize == 0)
 	tablesize = exsize;
       if ((exsize!=0)&&(exsize != tablesize)) {
-	cerr << "Table " << sym->getName() << " has inconsistent export size." << endl;
-	cerr << "Constructor starting at line " << dec << ct->getLineno() << " is first conflict" << endl;
+	*msgout << "Table " << sym->getName() << " has inconsistent export size." << endl;
+	*msgout << "Constructor starting at line " << dec << ct->getLineno() << " is first conflict" << endl;
 	testresult = false;
       }
     }
     else {
       if (seennonemptyexport && (!seenemptyexport)) {
-	cerr << "Table " << sym->getName() << " exports inconsistently" << endl;
-	cerr << "Constructor starting at line " << dec << ct->getLineno() << " is first inconsistency" << endl;
+	*msgout << "Table " << sym->getName() << " exports inconsistently" << endl;
+	*msgout << "Constructor starting at line " << dec << ct->getLineno() << " is first inconsistency" << endl;
 	testresult = false;
       }
       seenemptyexport = true;
@@ -904,7 +956,7 @@ bool ConsistencyChecker::checkSubtable(SubtableSymbol *sym)
   }
   if (seennonemptyexport) {
     if (tablesize == 0)
-      cerr << "Warning: Table " << sym->getName() << " exports size 0" << endl;
+      *msgout << "Warning: Table " << sym->getName() << " exports size 0" << endl;
     sizemap[sym] = tablesize;	// Remember recovered size
   }
   else
@@ -1213,11 +1265,11 @@ void ConsistencyChecker::checkUnusedTemps(Constructor *ct,const map<uintb,Optimi
     const OptimizeRecord &currec( (*iter).second );
     if (currec.readcount == 0) {
       if (printdeadwarning)
-	cerr << "Warning: temporary is written but not read in constructor starting at line " << dec << ct->getLineno() << endl;
+	*msgout << "Warning: temporary is written but not read in constructor starting at line " << dec << ct->getLineno() << endl;
       writenoread += 1;
     }
     else if (currec.writecount == 0) {
-      cerr << "Error: temporary is read but not written in constructor starting at line " << dec << ct->getLineno() << endl;
+      *msgout << "Error: temporary is read but not written in constructor starting at line " << dec << ct->getLineno() << endl;
       readnowrite += 1;
     }
     ++iter;
@@ -1257,47 +1309,108 @@ bool ConsistencyChecker::test(void)
   return testresult;
 }
 
-bool ConsistencyChecker::testTruncations(bool isbigendian)
+bool ConsistencyChecker::testTableTruncations(SubtableSymbol *sym,bool isbigendian)
 
 {
-  // Now that the sizemap is calculated, we can check/adjust the offset_plus templates
   bool testresult = true;
-  for(int4 i=0;i<postorder.size();++i) {
-    SubtableSymbol *sym = postorder[i];
-    int4 numconstruct = sym->getNumConstructors();
-    Constructor *ct;
-    for(int4 j=0;j<numconstruct;++j) {
-      ct = sym->getConstructor(j);
-
-      int4 numsections = ct->getNumSections();
-      for(int4 k=-1;k<numsections;++k) {
-	ConstructTpl *tpl;
-	if (k < 0)
-	  tpl = ct->getTempl();
-	else
-	  tpl = ct->getNamedTempl(k);
-	if (tpl == (ConstructTpl *)0)
-	  continue;
-	if (!checkSectionTruncations(ct,tpl,isbigendian))
+  int4 numconstruct = sym->getNumConstructors();
+  Constructor *ct;
+  for(int4 j=0;j<numconstruct;++j) {
+    ct = sym->getConstructor(j);
+
+    int4 numsections = ct->getNumSections();
+    for(int4 k=-1;k<numsections;++k) {
+      ConstructTpl *tpl;
+      if (k < 0)
+	tpl = ct->getTempl();
+      else
+	tpl = ct->getNamedTempl(k);
+      if (tpl == (ConstructTpl *)0)
+	continue;
+      if (!checkSectionTruncations(ct,tpl,isbigendian))
+	testresult = false;
+    }
+  }
+  return testresult;
+}
+
+void ConsistencyChecker::optimizeTable(SubtableSymbol *sym)
+
+{
+  int4 numconstruct = sym->getNumConstructors();
+  Constructor *ct;
+  for(int4 i=0;i<numconstruct;++i) {
+    ct = sym->getConstructor(i);
+    optimize(ct);
+  }
+}
+
+// Apply one of the per-table passes to every table in postorder. Tables only touch
+// their own constructors and read the (by now fixed) sizemap, so they can be handed
+// to separate threads. Each thread gets its own copy of the checker, whose counters
+// are summed afterward, and each table's messages are buffered and printed in
+// table order, so the output is identical to a single threaded run.
+bool ConsistencyChecker::runPerTable(int4 pass,bool isbigendian)
+
+{
+  int4 numtasks = postorder.size();
+  int4 numworkers = (numthreads < numtasks) ? numthreads : numtasks;
+  bool testresult = true;
+  if (numworkers <= 1) {
+    for(int4 i=0;i<numtasks;++i) {
+      if (pass == pass_truncations) {
+	if (!testTableTruncations(postorder[i],isbigendian))
 	  testresult = false;
       }
-    }
+      else
+	optimizeTable(postorder[i]);
+    }
+    return testresult;
+  }
+  vector<ConsistencyChecker> workers(numworkers,*this);
+  for(int4 i=0;i<numworkers;++i) {
+    workers[i].unnecessarypcode = 0;
+    workers[i].readnowrite = 0;
+    workers[i].writenoread = 0;
+  }
+  vector<ostringstream> msgs(numtasks);
+  vector<char> results(numtasks,1);
+  std::exception_ptr err;
+  int4 failed = parallelTasks(numworkers,numtasks,[&](int4 worker,int4 task) {
+      ConsistencyChecker &checker( workers[worker] );
+      checker.msgout = &msgs[task];
+      if (pass == pass_truncations)
+	results[task] = checker.testTableTruncations(postorder[task],isbigendian) ? 1 : 0;
+      else
+	checker.optimizeTable(postorder[task]);
+    },err);
+  int4 last = (failed < numtasks) ? failed + 1 : numtasks;
+  for(int4 i=0;i<last;++i) {
+    *msgout << msgs[i].str();
+    if (results[i] == 0)
+      testresult = false;
   }
+  for(int4 i=0;i<numworkers;++i) {
+    unnecessarypcode += workers[i].unnecessarypcode;
+    readnowrite += workers[i].readnowrite;
+    writenoread += workers[i].writenoread;
+  }
+  if (err)
+    std::rethrow_exception(err);
   return testresult;
 }
 
+bool ConsistencyChecker::testTruncations(bool isbigendian)
+
+{
+  // Now that the sizemap is calculated, we can check/adjust the offset_plus templates
+  return runPerTable(pass_truncations,isbigendian);
+}
+
 void ConsistencyChecker::optimizeAll(void)
 
 {
-  for(int4 i=0;i<postorder.size();++i) {
-    SubtableSymbol *sym = postorder[i];
-    int4 numconstruct = sym->getNumConstructors();
-    Constructor *ct;
-    for(int4 i=0;i<numconstruct;++i) {
-      ct = sym->getConstructor(i);
-      optimize(ct);
-    }
-  }
+  runPerTable(pass_optimize,false);
 }
 
 bool FieldContext::operator<(const FieldContext &op2) const
@@ -1465,6 +1578,7 @@ SleighCompile::SleighCompile(void)
   warndeadtemps = false;
   lenientconflicterrors = true;
   warnallnops = false;
+  numthreads = 1;
   root = (SubtableSymbol *)0;
 }
 
@@ -1550,26 +1664,104 @@ int4 SleighCompile::calcContextVarLayout(int4 start,int4 sz,int4 numbits)
   return numbits;
 }
 
-void SleighCompile::buildDecisionTrees(void)
-
-{
-  DecisionProperties props;
-  root->buildDecisionTree(props);
+void SleighCompile::loadDecodeProfile(void)
 
+{ // Read the decode counts, as written by Sleigh::saveDecodeProfile(), and attach
+  // them to the matching Constructors. Entries are matched by table name and index
+  // within the table, so a profile gathered from an older version of the spec still
+  // applies to the tables that have not changed. Unmatched entries are only counted,
+  // as a stale profile can make the decision trees slower but never wrong.
+  if (profilefile.empty()) return;
+  ifstream s(profilefile.c_str());
+  if (!s) {
+    reportError("Unable to open decode profile: " + profilefile,false);
+    return;
+  }
+  Document *doc;
+  try {
+    doc = xml_tree(s);
+  }
+  catch(XmlError &err) {
+    reportError("Unable to parse decode profile " + profilefile + ": " + err.explain,false);
+    return;
+  }
+  map<string,SubtableSymbol *> tablemap;
+  tablemap[root->getName()] = root;
   for(int4 i=0;i<tables.size();++i)
-    tables[i]->buildDecisionTree(props);
+    tablemap[tables[i]->getName()] = tables[i];
+  int4 unmatched = 0;
+  const List &list(doc->getRoot()->getChildren());
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter) {
+    const Element *el = *iter;
+    if (el->getName() != "constructor") continue;
+    map<string,SubtableSymbol *>::const_iterator titer = tablemap.find(el->getAttributeValue("table"));
+    int4 id = -1;
+    uint8 count = 0;
+    {
+      istringstream s1(el->getAttributeValue("id"));
+      s1.unsetf(ios::dec | ios::hex | ios::oct);
+      s1 >> id;
+    }
+    {
+      istringstream s2(el->getAttributeValue("count"));
+      s2.unsetf(ios::dec | ios::hex | ios::oct);
+      s2 >> count;
+    }
+    if ((titer == tablemap.end())||(id < 0)||(id >= (*titer).second->getNumConstructors())) {
+      unmatched += 1;
+      continue;
+    }
+    profile[(*titer).second->getConstructor(id)] += count;
+  }
+  delete doc;
+  if (unmatched > 0) {
+    ostringstream msg;
+    msg << dec << unmatched << " decode profile entries do not match the specification";
+    reportWarning(msg.str(),false);
+  }
+}
 
-  const vector<string> &ierrors( props.getIdentErrors() );
-  for(int4 i=0;i<ierrors.size();++i) {
-    errors += 1;
-    cerr << ierrors[i];
+void SleighCompile::buildDecisionTrees(void)
+
+{
+  // Each table's decision tree only involves its own constructors, so the tables are
+  // split on separate threads. Errors are collected per table and reported in the
+  // same order as a single threaded build.
+  vector<SubtableSymbol *> alltables;
+  alltables.push_back(root);
+  alltables.insert(alltables.end(),tables.begin(),tables.end());
+  int4 numtasks = alltables.size();
+  int4 numworkers = (numthreads < numtasks) ? numthreads : numtasks;
+  if (numworkers < 1)
+    numworkers = 1;
+  vector<DecisionProperties> props(numtasks);
+  if (!profile.empty()) {
+    for(int4 i=0;i<numtasks;++i)
+      props[i].setProfile(&profile);
+  }
+  std::exception_ptr err;
+  parallelTasks(numworkers,numtasks,[&](int4 worker,int4 task) {
+      alltables[task]->buildDecisionTree(props[task]);
+    },err);
+  if (err)
+    std::rethrow_exception(err);
+
+  for(int4 j=0;j<numtasks;++j) {
+    const vector<string> &ierrors( props[j].getIdentErrors() );
+    for(int4 i=0;i<ierrors.size();++i) {
+      errors += 1;
+      cerr << ierrors[i];
+    }
   }
 
   if (!lenientconflicterrors) {
-    const vector<string> &cerrors( props.getConflictErrors() );
-    for(int4 i=0;i<cerrors.size();++i) {
-      errors += 1;
-      cerr << cerrors[i];
+    for(int4 j=0;j<numtasks;++j) {
+      const vector<string> &cerrors( props[j].getConflictErrors() );
+      for(int4 i=0;i<cerrors.size();++i) {
+	errors += 1;
+	cerr << cerrors[i];
+      }
     }
   }
 }
@@ -1595,6 +1787,7 @@ void SleighCompile::checkConsistency(void)
 
 {
   ConsistencyChecker checker(root,warnunnecessarypcode,warndeadtemps);
+  checker.setThreads(numthreads);
 
   if (!checker.test()) {
     errors += 1;
@@ -1704,6 +1897,8 @@ void SleighCompile::process(void)
   if (errors>0) return;
   buildPatterns();
   if (errors>0) return;
+  loadDecodeProfile();
+  if (errors>0) return;
   buildDecisionTrees();
   if (errors>0) return;
   try {
@@ -2585,7 +2780,39 @@ void SleighCompile::recordNop(void)
   noplist.push_back(s.str());
 }
 
-static int4 run_compilation(const char *filein,const char *fileout,SleighCompile &compiler)
+/// If requested, a binary copy of the specification is written alongside the XML form,
+/// with the extension ".slab" in place of ".sla".  It is built by re-reading the XML file that
+/// was written, so the two forms always hold the same tree.
+static void write_binary(const char *fileout)
+
+{
+  string binfile(fileout);
+  string::size_type pos = binfile.rfind(".sla");
+  if (pos != string::npos && pos + 4 == binfile.size())
+    binfile.erase(pos);
+  binfile += SLAB_EXTENSION;
+  ifstream xmls(fileout);
+  if (!xmls)
+    throw SleighError("Unable to re-open output for binary file: " + string(fileout));
+  Document *doc;
+  try {
+    doc = xml_tree(xmls);
+  }
+  catch(XmlError &err) {
+    throw SleighError("Unable to re-read output for binary file: " + err.explain);
+  }
+  xmls.close();
+  ofstream s(binfile.c_str(),ios::out | ios::binary);
+  if (!s) {
+    delete doc;
+    throw SleighError("Unable to open binary output file: " + binfile);
+  }
+  slab_write(s,doc->getRoot());
+  s.close();
+  delete doc;
+}
+
+static int4 run_compilation(const char *filein,const char *fileout,SleighCompile &compiler,bool binary)
 
 {
   compiler.parseFromNewFile(filein);
@@ -2602,14 +2829,19 @@ static int4 run_compilation(const char *filein,const char *fileout,SleighCompile
     if (parseres==0)
       compiler.process();	// Do all the post-processing
     if ((parseres==0)&&(compiler.numErrors()==0)) { // If no errors
-      ofstream s(fileout);
+      vector<char> outbuf(1 << 20);	// Large buffer, so the xml streams out in big writes
+      ofstream s;
+      s.rdbuf()->pubsetbuf(outbuf.data(),outbuf.size());
+      s.open(fileout);
       if (!s) {
 	ostringstream errs;
 	errs << "Unable to open output file: " << fileout;
 	throw SleighError(errs.str());
       }
-      compiler.saveXml(s);	// Dump output xml
+      compiler.saveXml(s);	// Stream output xml directly to the file
       s.close();
+      if (binary)
+	write_binary(fileout);
     }
     else {
       cerr << "No output produced" <<endl;
@@ -2623,7 +2855,7 @@ static int4 run_compilation(const char *filein,const char *fileout,SleighCompile
   return 0;
 }
 
-static int4 run_xml(const char *filein,SleighCompile &compiler)
+static int4 run_xml(const char *filein,SleighCompile &compiler,bool binary)
 
 {
   ifstream s(filein);
@@ -2674,7 +2906,7 @@ static int4 run_xml(const char *filein,SleighCompile &compiler)
     cerr << "Output sla file was not specified in " << filein << endl;
     exit(1);
   }
-  return run_compilation(specfilein.c_str(),specfileout.c_str(),compiler);
+  return run_compilation(specfilein.c_str(),specfileout.c_str(),compiler,binary);
 }
 
 static void findSlaSpecs(vector<string> &res, const string &dir, const string &suffix)
@@ -2692,7 +2924,8 @@ static void findSlaSpecs(vector<string> &res, const string &dir, const string &s
 }
 
 static void initCompiler(SleighCompile &compiler, map<string,string> &defines, bool enableUnnecessaryPcodeWarning, bool disableLenientConflict,
-			 bool enableAllNopWarning,bool enableDeadTempWarning,bool enforceLocalKeyWord)
+			 bool enableAllNopWarning,bool enableDeadTempWarning,bool enforceLocalKeyWord,int4 numThreads,
+			 const string &profileFile)
 
 {
   map<string,string>::iterator iter = defines.begin();
@@ -2714,6 +2947,8 @@ static void initCompiler(SleighCompile &compiler, map<string,string> &defines, b
   if (enforceLocalKeyWord) {
 	  compiler.setEnforceLocalKeyWord(true);
   }
+  compiler.setThreads(numThreads);
+  compiler.setDecodeProfile(profileFile);
 }
 
 static void segvHandler(int sig) {
@@ -2740,6 +2975,9 @@ int main(int argc,char **argv)
     cerr << "   -n              print warnings for all NOP constructors" << endl;
     cerr << "   -t              print warnings for dead temporaries" << endl;
     cerr << "   -e              enforce use of 'local' keyword for temporaries" << endl;
+    cerr << "   -b              also write a binary .slab file next to each .sla file" << endl;
+    cerr << "   -pFILE          build decision trees favoring the decode counts in FILE" << endl;
+    cerr << "   -jN             use N threads for decision trees and consistency checks (0 = all cores)" << endl;
     cerr << "   -DNAME=VALUE    defines a preprocessor macro NAME with value VALUE" << endl;
     exit(2);
   }
@@ -2754,6 +2992,9 @@ int main(int argc,char **argv)
   bool enforceLocalKeyWord = false;
   
   bool compileAll = false;
+  bool emitBinary = false;
+  int4 numThreads = 0;
+  string profileFile;
   
   int4 i;
   for(i=1;i<argc;++i) {
@@ -2781,6 +3022,12 @@ int main(int argc,char **argv)
       enableDeadTempWarning = true;
     else if (argv[1][1] == 'e')
       enforceLocalKeyWord = true;
+    else if (argv[i][1] == 'b')
+      emitBinary = true;
+    else if (argv[i][1] == 'j')
+      numThreads = atoi(argv[i]+2);
+    else if (argv[i][1] == 'p')
+      profileFile = argv[i]+2;
 #ifdef YYDEBUG
     else if (argv[i][1] == 'x')
       yydebug = 1;		// Debug option
@@ -2791,6 +3038,12 @@ int main(int argc,char **argv)
     }
   }
   
+  if (numThreads <= 0) {
+    numThreads = std::thread::hardware_concurrency();
+    if (numThreads <= 0)
+      numThreads = 1;
+  }
+
   if (compileAll) {
     
     if (i< argc-1) {
@@ -2812,8 +3065,8 @@ int main(int argc,char **argv)
       sla.replace(slaspec.length() - slaspecExtLen, slaspecExtLen, SLAEXT);
       SleighCompile compiler;
       initCompiler(compiler, defines, enableUnnecessaryPcodeWarning, 
-		   disableLenientConflict, enableAllNopWarning, enableDeadTempWarning, enforceLocalKeyWord);
-      retval = run_compilation(slaspec.c_str(),sla.c_str(),compiler);
+		   disableLenientConflict, enableAllNopWarning, enableDeadTempWarning, enforceLocalKeyWord, numThreads, profileFile);
+      retval = run_compilation(slaspec.c_str(),sla.c_str(),compiler,emitBinary);
       if (retval != 0) {
 	return retval; // stop on first error
       }
@@ -2845,7 +3098,7 @@ int main(int argc,char **argv)
     
     SleighCompile compiler;
     initCompiler(compiler, defines, enableUnnecessaryPcodeWarning, 
-		 disableLenientConflict, enableAllNopWarning, enableDeadTempWarning, enforceLocalKeyWord);
+		 disableLenientConflict, enableAllNopWarning, enableDeadTempWarning, enforceLocalKeyWord, numThreads, profileFile);
     
     if (i < argc - 1) {
       string fileoutExamine(argv[i+1]);
@@ -2853,15 +3106,15 @@ int main(int argc,char **argv)
       if (extOutPos == string::npos) { // No Extension Given...
 	fileoutExamine.append(SLAEXT);
       }
-      retval = run_compilation(fileinExamine.c_str(),fileoutExamine.c_str(),compiler);
+      retval = run_compilation(fileinExamine.c_str(),fileoutExamine.c_str(),compiler,emitBinary);
     }else{
       //First determine whether or not to use Run_XML...
       if (autoExtInSet) { //Assumed format of at least "sleigh file" -> "sleigh file.slaspec file.sla"
 	string fileoutSTR = fileinPreExt;
 	fileoutSTR.append(SLAEXT);
-	retval = run_compilation(fileinExamine.c_str(),fileoutSTR.c_str(),compiler);
+	retval = run_compilation(fileinExamine.c_str(),fileoutSTR.c_str(),compiler,emitBinary);
       }else{
-	retval = run_xml(fileinExamine.c_str(),compiler);
+	retval = run_xml(fileinExamine.c_str(),compiler,emitBinary);
       }
       
     }
@@ -415,6 +415,24 @@ int4 TokenPattern::getMinimumLength(void) const
   return length;
 }
 
+void PatternExpression::compile(vector<PatternOp> &code) const
+
+{				// By default, just evaluate the whole subtree through getValue
+  code.push_back(PatternOp(PatternOp::push_tree));
+  code.back().tree = this;
+}
+
+void PatternExpression::buildProgram(void)
+
+{				// Compile the tree into a program once, keeping the tree if it can't be
+  if (program != (PatternProgram *)0) return;
+  PatternProgram *prog = new PatternProgram();
+  if (prog->compile(this))
+    program = prog;
+  else
+    delete prog;
+}
+
 void PatternExpression::release(PatternExpression *p)
 
 {
@@ -519,6 +537,122 @@ static intb getContextBytes(ParserWalker &walker,int4 bytestart,int4 byteend)
   return res;
 }
 
+bool PatternProgram::compile(const PatternExpression *exp)
+
+{
+  code.clear();
+  exp->compile(code);
+  int4 depth = 0;
+  for(int4 i=0;i<code.size();++i) {
+    int4 opc = code[i].opcode;
+    if (opc <= PatternOp::push_tree) {
+      depth += 1;
+      if (depth > maxdepth) {
+	code.clear();
+	return false;
+      }
+    }
+    else if (opc < PatternOp::op_minus)
+      depth -= 1;		// Binary operators pop two and push one
+  }
+  return true;
+}
+
+intb PatternProgram::readField(ParserWalker &walker,const PatternOp &op)
+
+{				// Read a token or context field, with the byte offsets and shifts already worked out
+  intb res;
+  if (op.numbytes <= sizeof(uintm)) {
+    if (op.opcode == PatternOp::push_token) {
+      res = (intb)walker.getInstructionBytes(op.bytestart,op.numbytes);
+      if (!op.bigendian && op.numbytes > 1)
+	byte_swap(res,op.numbytes);
+    }
+    else
+      res = (intb)walker.getContextBytes(op.bytestart,op.numbytes);
+  }
+  else if (op.opcode == PatternOp::push_token)
+    res = getInstructionBytes(walker,op.bytestart,op.bytestart+op.numbytes-1,op.bigendian);
+  else
+    res = getContextBytes(walker,op.bytestart,op.bytestart+op.numbytes-1);
+  res >>= op.shift;
+  if (op.signbit)
+    return ((intb)((uintb)res << op.extend)) >> op.extend;
+  return (intb)(((uintb)res << op.extend) >> op.extend);
+}
+
+intb PatternProgram::evaluate(ParserWalker &walker) const
+
+{
+  intb stack[maxdepth];
+  int4 top = 0;
+  vector<PatternOp>::const_iterator iter;
+  for(iter=code.begin();iter!=code.end();++iter) {
+    const PatternOp &op(*iter);
+    switch(op.opcode) {
+    case PatternOp::push_constant:
+      stack[top++] = op.val;
+      break;
+    case PatternOp::push_token:
+    case PatternOp::push_context:
+      stack[top++] = readField(walker,op);
+      break;
+    case PatternOp::push_start:
+      stack[top++] = (intb)AddrSpace::byteToAddress(walker.getAddr().getOffset(),walker.getAddr().getSpace()->getWordSize());
+      break;
+    case PatternOp::push_end:
+      stack[top++] = (intb)AddrSpace::byteToAddress(walker.getNaddr().getOffset(),walker.getNaddr().getSpace()->getWordSize());
+      break;
+    case PatternOp::push_tree:
+      stack[top++] = op.tree->getValue(walker);
+      break;
+    case PatternOp::op_plus:
+      top -= 1;
+      stack[top-1] = stack[top-1] + stack[top];
+      break;
+    case PatternOp::op_sub:
+      top -= 1;
+      stack[top-1] = stack[top-1] - stack[top];
+      break;
+    case PatternOp::op_mult:
+      top -= 1;
+      stack[top-1] = stack[top-1] * stack[top];
+      break;
+    case PatternOp::op_leftshift:
+      top -= 1;
+      stack[top-1] = stack[top-1] << stack[top];
+      break;
+    case PatternOp::op_rightshift:
+      top -= 1;
+      stack[top-1] = stack[top-1] >> stack[top];
+      break;
+    case PatternOp::op_and:
+      top -= 1;
+      stack[top-1] = stack[top-1] & stack[top];
+      break;
+    case PatternOp::op_or:
+      top -= 1;
+      stack[top-1] = stack[top-1] | stack[top];
+      break;
+    case PatternOp::op_xor:
+      top -= 1;
+      stack[top-1] = stack[top-1] ^ stack[top];
+      break;
+    case PatternOp::op_div:
+      top -= 1;
+      stack[top-1] = stack[top-1] / stack[top];
+      break;
+    case PatternOp::op_minus:
+      stack[top-1] = -stack[top-1];
+      break;
+    case PatternOp::op_not:
+      stack[top-1] = ~stack[top-1];
+      break;
+    }
+  }
+  return stack[0];
+}
+
 TokenField::TokenField(Token *tk,bool s,int4 bstart,int4 bend)
 
 {
@@ -551,6 +685,24 @@ intb TokenField::getValue(ParserWalker &walker) const
   return res;
 }
 
+void TokenField::compile(vector<PatternOp> &code) const
+
+{
+  int4 extend = 8*sizeof(intb) - 1 - (bitend-bitstart);
+  if (extend < 0) {
+    PatternExpression::compile(code);
+    return;
+  }
+  code.push_back(PatternOp(PatternOp::push_token));
+  PatternOp &op(code.back());
+  op.bigendian = bigendian;
+  op.signbit = signbit;
+  op.bytestart = bytestart;
+  op.numbytes = byteend-bytestart+1;
+  op.shift = shift;
+  op.extend = extend;
+}
+
 TokenPattern TokenField::genPattern(intb val) const
 
 {				// Generate corresponding pattern if the
@@ -635,6 +787,24 @@ intb ContextField::getValue(ParserWalker &walker) const
   return res;
 }
 
+void ContextField::compile(vector<PatternOp> &code) const
+
+{
+  int4 extend = 8*sizeof(intb) - 1 - (endbit-startbit);
+  if (extend < 0) {
+    PatternExpression::compile(code);
+    return;
+  }
+  code.push_back(PatternOp(PatternOp::push_context));
+  PatternOp &op(code.back());
+  op.bigendian = true;
+  op.signbit = signbit;
+  op.bytestart = startbyte;
+  op.numbytes = endbyte-startbyte+1;
+  op.shift = shift;
+  op.extend = extend;
+}
+
 TokenPattern ContextField::genPattern(intb val) const
 
 {
@@ -745,7 +915,7 @@ intb OperandValue::getValue(ParserWalker &walker) const
   ConstructState tempstate;
   ParserWalker newwalker(walker.getParserContext());
   newwalker.setOutOfBandState(ct,index,&tempstate,walker);
-  intb res = patexp->getValue(newwalker);
+  intb res = patexp->evaluate(newwalker);
   return res;
 }
 
@@ -43,6 +43,20 @@ int4 DisjointPattern::getLength(bool context) const
   return 0;
 }
 
+void DisjointPattern::packWords(uintm *mask,uintm *val,int4 numwords,bool context) const
+
+{				// Write mask/value as words aligned to the start of the stream
+  PatternBlock *block = getBlock(context);
+  if (block != (PatternBlock *)0)
+    block->packWords(mask,val,numwords);
+  else {
+    for(int4 i=0;i<numwords;++i) {
+      mask[i] = 0;
+      val[i] = 0;
+    }
+  }
+}
+
 bool DisjointPattern::specializes(const DisjointPattern *op2) const
 
 {				// Return true, if everywhere this's mask is non-zero
@@ -484,6 +498,26 @@ bool PatternBlock::isContextMatch(ParserWalker &walker) const
   return true;
 }
 
+void PatternBlock::packWords(uintm *mask,uintm *val,int4 numwords) const
+
+{ // Write the mask and value as -numwords- words starting at byte 0 of the stream (rather
+  // than at -offset-), so that word i can be compared directly with bytes 4i through 4i+3
+  for(int4 i=0;i<numwords;++i) {
+    mask[i] = 0;
+    val[i] = 0;
+  }
+  for(int4 i=0;i<nonzerosize;++i) {
+    int4 dest = offset + i;
+    if (dest >= numwords*sizeof(uintm)) break;
+    int4 srcshift = 8*(sizeof(uintm)-1-(i%sizeof(uintm)));
+    int4 destshift = 8*(sizeof(uintm)-1-(dest%sizeof(uintm)));
+    uintm mbyte = (maskvec[i/sizeof(uintm)] >> srcshift) & 0xff;
+    uintm vbyte = (valvec[i/sizeof(uintm)] >> srcshift) & 0xff;
+    mask[dest/sizeof(uintm)] |= mbyte << destshift;
+    val[dest/sizeof(uintm)] |= vbyte << destshift;
+  }
+}
+
 void PatternBlock::saveXml(std::ostream &s) const
 
 {
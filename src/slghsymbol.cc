@@ -490,14 +490,14 @@ void ValueSymbol::getFixedHandle(FixedHandle &hand,ParserWalker &walker) const
 {
   hand.space = walker.getConstSpace();
   hand.offset_space = (AddrSpace *)0;
-  hand.offset_offset = (uintb) patval->getValue(walker);
+  hand.offset_offset = (uintb) patval->evaluate(walker);
   hand.size = 0;		// Cannot provide size
 }
 
 void ValueSymbol::print(std::ostream &s,ParserWalker &walker) const
 
 {
-  intb val = patval->getValue(walker);
+  intb val = patval->evaluate(walker);
   if (val >= 0)
     s << "0x" << hex << val;
   else
@@ -530,6 +530,7 @@ void ValueSymbol::restoreXml(const Element *el,SleighBase *trans)
   iter = list.begin();
   patval = (PatternValue *) PatternExpression::restoreExpression(*iter,trans);
   patval->layClaim();
+  patval->buildProgram();
 }
 
 void ValueMapSymbol::checkTableFill(void)
@@ -548,7 +549,7 @@ Constructor *ValueMapSymbol::resolve(ParserWalker &walker)
 
 {
   if (!tableisfilled) {
-    intb ind = patval->getValue(walker);
+    intb ind = patval->evaluate(walker);
     if ((ind >= valuetable.size())||(ind<0)||(valuetable[ind] == 0xBADBEEF)) {
       ostringstream s;
       s << walker.getAddr().getShortcut();
@@ -563,7 +564,7 @@ Constructor *ValueMapSymbol::resolve(ParserWalker &walker)
 void ValueMapSymbol::getFixedHandle(FixedHandle &hand,ParserWalker &walker) const
 
 {
-  uint4 ind = (uint4) patval->getValue(walker);
+  uint4 ind = (uint4) patval->evaluate(walker);
   // The resolve routine has checked that -ind- must be a valid index
   hand.space = walker.getConstSpace();
   hand.offset_space = (AddrSpace *)0; // Not a dynamic value
@@ -574,7 +575,7 @@ void ValueMapSymbol::getFixedHandle(FixedHandle &hand,ParserWalker &walker) cons
 void ValueMapSymbol::print(std::ostream &s,ParserWalker &walker) const
 
 {
-  uint4 ind = (uint4)patval->getValue(walker);
+  uint4 ind = (uint4)patval->evaluate(walker);
   // ind is already checked to be in range by the resolve routine
   intb val = valuetable[ind];
   if (val >= 0)
@@ -611,6 +612,7 @@ void ValueMapSymbol::restoreXml(const Element *el,SleighBase *trans)
   iter = list.begin();
   patval = (PatternValue *) PatternExpression::restoreExpression(*iter,trans);
   patval->layClaim();
+  patval->buildProgram();
   ++iter;
   while(iter != list.end()) {
     istringstream s((*iter)->getAttributeValue("val"));
@@ -641,7 +643,7 @@ Constructor *NameSymbol::resolve(ParserWalker &walker)
 
 {
   if (!tableisfilled) {
-    intb ind = patval->getValue(walker);
+    intb ind = patval->evaluate(walker);
     if ((ind >= nametable.size())||(ind<0)||((nametable[ind].size()==1)&&(nametable[ind][0]=='\t'))) {
       ostringstream s;
       s << walker.getAddr().getShortcut();
@@ -656,7 +658,7 @@ Constructor *NameSymbol::resolve(ParserWalker &walker)
 void NameSymbol::print(std::ostream &s,ParserWalker &walker) const
 
 {
-  uint4 ind = (uint4)patval->getValue(walker);
+  uint4 ind = (uint4)patval->evaluate(walker);
   // ind is already checked to be in range by the resolve routine
   s << nametable[ind];
 }
@@ -693,6 +695,7 @@ void NameSymbol::restoreXml(const Element *el,SleighBase *trans)
   iter = list.begin();
   patval = (PatternValue *) PatternExpression::restoreExpression(*iter,trans);
   patval->layClaim();
+  patval->buildProgram();
   ++iter;
   while(iter != list.end()) {
     const Element *subel = *iter;
@@ -853,7 +856,7 @@ Constructor *VarnodeListSymbol::resolve(ParserWalker &walker)
 
 {
   if (!tableisfilled) {
-    intb ind = patval->getValue(walker);
+    intb ind = patval->evaluate(walker);
     if ((ind<0)||(ind>=varnode_table.size())||(varnode_table[ind]==(VarnodeSymbol *)0)) {
       ostringstream s;
       s << walker.getAddr().getShortcut();
@@ -868,7 +871,7 @@ Constructor *VarnodeListSymbol::resolve(ParserWalker &walker)
 void VarnodeListSymbol::getFixedHandle(FixedHandle &hand,ParserWalker &walker) const
 
 {
-  uint4 ind = (uint4) patval->getValue(walker);
+  uint4 ind = (uint4) patval->evaluate(walker);
   // The resolve routine has checked that -ind- must be a valid index
   const VarnodeData &fix( varnode_table[ind]->getFixedVarnode() );
   hand.space = fix.space;
@@ -891,7 +894,7 @@ int4 VarnodeListSymbol::getSize(void) const
 void VarnodeListSymbol::print(std::ostream &s,ParserWalker &walker) const
 
 {
-  uint4 ind = (uint4)patval->getValue(walker);
+  uint4 ind = (uint4)patval->evaluate(walker);
   if (ind >= varnode_table.size())
     throw SleighError("Value out of range for varnode table");
   s << varnode_table[ind]->getName();
@@ -929,6 +932,7 @@ void VarnodeListSymbol::restoreXml(const Element *el,SleighBase *trans)
   iter = list.begin();
   patval = (PatternValue *) PatternExpression::restoreExpression(*iter,trans);
   patval->layClaim();
+  patval->buildProgram();
   ++iter;
   while(iter!=list.end()) {
     const Element *subel = *iter;
@@ -1026,7 +1030,7 @@ void OperandSymbol::print(std::ostream &s,ParserWalker &walker) const
       triple->print(s,walker);
   }
   else {
-    intb val = defexp->getValue(walker);
+    intb val = defexp->evaluate(walker);
     if (val >= 0)
       s << "0x" << hex << val;
     else
@@ -1110,6 +1114,7 @@ void OperandSymbol::restoreXml(const Element *el,SleighBase *trans)
   if (iter != list.end()) {
     defexp = PatternExpression::restoreExpression(*iter,trans);
     defexp->layClaim();
+    defexp->buildProgram();
   }
 }
 
@@ -1968,6 +1973,19 @@ TokenPattern *SubtableSymbol::buildPattern(std::ostream &s)
   return pattern;
 }
 
+double DecisionProperties::getWeight(const Constructor *ct) const
+
+{ // Weight of a pattern when scoring a field. Without a profile every pattern counts
+  // the same. With one, a pattern counts as many times as its Constructor was decoded,
+  // plus one, so Constructors that never showed up are still distinguished.
+  if (profile == (const map<const Constructor *,uint8> *)0)
+    return 1.0;
+  map<const Constructor *,uint8>::const_iterator iter = profile->find(ct);
+  if (iter == profile->end())
+    return 1.0;
+  return 1.0 + (double)(*iter).second;
+}
+
 void DecisionProperties::identicalPattern(Constructor *a,Constructor *b)
 
 { // Note that -a- and -b- have identical patterns
@@ -2008,6 +2026,8 @@ DecisionNode::DecisionNode(DecisionNode *p)
   startbit = 0;
   bitsize = 0;
   contextdecision = false;
+  instrwords = 0;
+  contextwords = 0;
 }
 
 DecisionNode::~DecisionNode(void)
@@ -2060,9 +2080,10 @@ int4 DecisionNode::getNumFixed(int4 low,int4 size,bool context)
   return count;
 }
 
-double DecisionNode::getScore(int4 low,int4 size,bool context)
+double DecisionNode::getScore(int4 low,int4 size,bool context,const DecisionProperties &props)
 
-{
+{ // Entropy (in bits) of the field's value across the patterns that fully specify it,
+  // each pattern weighted by how often its Constructor is decoded (see DecisionProperties)
   int4 numBins = 1 << size;		// size is between 1 and 8
   int4 i;
   uintm val,mask;
@@ -2070,27 +2091,32 @@ double DecisionNode::getScore(int4 low,int4 size,bool context)
   m = m-1;
 
   int4 total = 0;
+  double totalweight = 0.0;
   vector<int4> count(numBins,0);
+  vector<double> weight(numBins,0.0);
 
   for(i=0;i<list.size();++i) {
     mask = list[i].first->getMask(low,size,context);
     if ((mask&m)!=m) continue;	// Skip if field not fully specified
     val = list[i].first->getValue(low,size,context);
+    double w = props.getWeight(list[i].second);
     total += 1;
+    totalweight += w;
     count[val] += 1;
+    weight[val] += w;
   }
   if (total <= 0) return -1.0;
   double sc = 0.0;
   for(i=0;i<numBins;++i) {
     if (count[i] <= 0) continue;
     if (count[i] >= list.size()) return -1.0;
-    double p = ((double)count[i])/total;
+    double p = weight[i]/totalweight;
     sc -= p * log(p);
   }
   return ( sc / log(2.0) );
 }
 
-void DecisionNode::chooseOptimalField(void)
+void DecisionNode::chooseOptimalField(const DecisionProperties &props)
 
 {
   double score = 0.0;
@@ -2108,7 +2134,7 @@ void DecisionNode::chooseOptimalField(void)
     for(sbit=0;sbit<maxlength;++sbit) {
       numfixed = getNumFixed(sbit,1,context); // How may patterns specify this bit
       if (numfixed < maxfixed) continue; // Skip this bit, if we don't have maximum specification
-      sc = getScore(sbit,1,context);
+      sc = getScore(sbit,1,context,props);
 
  // if we got more patterns this time than previously, and a positive score, reset
  // the high score (we prefer this bit, because it has a higher numfixed, regardless
@@ -2138,7 +2164,7 @@ void DecisionNode::chooseOptimalField(void)
     for(size=2;size <= 8;++size) {
       for(sbit=0;sbit<maxlength-size+1;++sbit) {
 	if (getNumFixed(sbit,size,context) < maxfixed) continue; // Consider only maximal fields
-	sc = getScore(sbit,size,context);
+	sc = getScore(sbit,size,context,props);
 	if (sc > score) {
 	  score = sc;
 	  startbit = sbit;
@@ -2179,7 +2205,7 @@ void DecisionNode::split(DecisionProperties &props)
     return;
   }
 
-  chooseOptimalField();
+  chooseOptimalField(props);
   if (bitsize == 0) {
     orderPatterns(props);
     return;
@@ -2294,14 +2320,70 @@ void DecisionNode::orderPatterns(DecisionProperties &props)
   }
 }
 
+void DecisionNode::packPatterns(void)
+
+{ // Flatten the patterns of a terminal node into arrays of mask/value words aligned to the
+  // start of the instruction and context, so resolve() can check all of them against the
+  // same few words without calling back into the pattern objects
+  instrwords = 0;
+  contextwords = 0;
+  packed.clear();
+  packedconstruct.clear();
+  if (bitsize != 0) return;
+  for(int4 i=0;i<list.size();++i) {
+    const DisjointPattern *pat = list[i].first;
+    int4 iwords = (pat->getLength(false) + sizeof(uintm) - 1) / sizeof(uintm);
+    int4 cwords = (pat->getLength(true) + sizeof(uintm) - 1) / sizeof(uintm);
+    if (iwords > instrwords) instrwords = iwords;
+    if (cwords > contextwords) contextwords = cwords;
+  }
+  if (instrwords * sizeof(uintm) > 16 || contextwords > 8) { // Too long, resolve() uses the patterns directly
+    instrwords = 0;
+    contextwords = 0;
+    return;
+  }
+  int4 stride = 2*(instrwords + contextwords);
+  for(int4 i=0;i<list.size();++i) {
+    const DisjointPattern *pat = list[i].first;
+    if (pat->alwaysFalse()) continue;	// Can never match, so leave it out
+    packed.resize(packed.size() + stride);
+    uintm *ptr = &packed[packed.size() - stride];
+    pat->packWords(ptr,ptr+instrwords,instrwords,false);
+    pat->packWords(ptr+2*instrwords,ptr+2*instrwords+contextwords,contextwords,true);
+    packedconstruct.push_back(list[i].second);
+  }
+}
+
 Constructor *DecisionNode::resolve(ParserWalker &walker) const
 
 {
   if (bitsize == 0) {		// The node is terminal
-    vector<pair<DisjointPattern *,Constructor *> >::const_iterator iter;
-    for(iter=list.begin();iter!=list.end();++iter)
-      if ((*iter).first->isMatch(walker))
-	return (*iter).second;
+    // Use the packed patterns, as long as every word read stays in the 16-byte instruction buffer
+    if ((!packedconstruct.empty())&&(walker.getOffset(-1) + instrwords*sizeof(uintm) <= 16)) {
+      uintm data[12];
+      for(int4 i=0;i<instrwords;++i)
+	data[i] = walker.getInstructionBytes(i*sizeof(uintm),sizeof(uintm));
+      for(int4 i=0;i<contextwords;++i)
+	data[instrwords+i] = walker.getContextBytes(i*sizeof(uintm),sizeof(uintm));
+      const uintm *ptr = packed.data();
+      for(int4 i=0;i<packedconstruct.size();++i) {
+	uintm diff = 0;		// Accumulate mismatched bits without branching
+	for(int4 j=0;j<instrwords;++j)
+	  diff |= (ptr[j] & data[j]) ^ ptr[instrwords+j];
+	ptr += 2*instrwords;
+	for(int4 j=0;j<contextwords;++j)
+	  diff |= (ptr[j] & data[instrwords+j]) ^ ptr[contextwords+j];
+	ptr += 2*contextwords;
+	if (diff == 0)
+	  return packedconstruct[i];
+      }
+    }
+    else {
+      vector<pair<DisjointPattern *,Constructor *> >::const_iterator iter;
+      for(iter=list.begin();iter!=list.end();++iter)
+	if ((*iter).first->isMatch(walker))
+	  return (*iter).second;
+    }
     ostringstream s;
     s << walker.getAddr().getShortcut();
     walker.getAddr().printRaw(s);
@@ -2383,6 +2465,7 @@ void DecisionNode::restoreXml(const Element *el,DecisionNode *par,SubtableSymbol
     }
     ++iter;
   }
+  packPatterns();
 }
 
 static void calc_maskword(int4 sbit,int4 ebit,int4 &num,int4 &shift,uintm &mask)
@@ -2410,7 +2493,7 @@ ContextOp::ContextOp(int4 startbit,int4 endbit,PatternExpression *pe)
 void ContextOp::apply(ParserWalkerChange &walker) const
 
 {
-  uintm val = patexp->getValue(walker); // Get our value based on context
+  uintm val = patexp->evaluate(walker); // Get our value based on context
   val <<= shift;
   walker.getParserContext()->setContextWord(num,val,mask);
 }
@@ -2467,6 +2550,7 @@ void ContextOp::restoreXml(const Element *el,SleighBase *trans)
   iter = list.begin();
   patexp = (PatternValue *)PatternExpression::restoreExpression(*iter,trans);
   patexp->layClaim();
+  patexp->buildProgram();
 }
 
 ContextChange *ContextOp::clone(void) const
@@ -45,7 +45,7 @@ SubvariableFlow::ReplaceVarnode *SubvariableFlow::setReplacement(Varnode *vn,uin
 { // Mark 
   ReplaceVarnode *res;
   if (vn->isMark()) {		// Already seen before
-    map<Varnode *,ReplaceVarnode>::iterator iter;
+    ReplaceVarnodeMap::iterator iter;
     iter = varmap.find(vn);
     res = &(*iter).second;
     inworklist = false;
@@ -266,7 +266,7 @@ bool SubvariableFlow::traceForward(ReplaceVarnode *rvn)
   int4 dcount = 0;
   int4 hcount = 0;
 
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = rvn->vn->beginDescend();
   enditer = rvn->vn->endDescend();
   while(iter != enditer) {
@@ -694,7 +694,7 @@ bool SubvariableFlow::traceForwardSext(ReplaceVarnode *rvn)
   int4 dcount = 0;
   int4 hcount = 0;
 
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = rvn->vn->beginDescend();
   enditer = rvn->vn->endDescend();
   while(iter != enditer) {
@@ -1061,9 +1061,24 @@ SubvariableFlow::SubvariableFlow(Funcdata *f,Varnode *root,uintb mask,bool aggr,
     fd = (Funcdata *)0;
     return;
   }
+  rootvn = root;
+  rootmask = mask;
+  if (fd->hasTraceFailed(traceKind(),rootvn,rootmask)) {
+    fd = (Funcdata *)0;		// Same trace failed and nothing has changed since
+    return;
+  }
   createLink((ReplaceOp *)0,mask,0,root);
 }
 
+/// \brief Get the kind of trace being performed, for recording failures
+uint4 SubvariableFlow::traceKind(void) const
+
+{
+  if (sextrestrictions) return TraceFailureCache::subvariable_sext;
+  if (aggressive) return TraceFailureCache::subvariable_aggressive;
+  return TraceFailureCache::subvariable;
+}
+
 bool SubvariableFlow::doTrace(void)
 
 { // Process worklist until its done
@@ -1080,19 +1095,22 @@ bool SubvariableFlow::doTrace(void)
   }
 
   // Clear marks
-  map<Varnode *,ReplaceVarnode>::iterator iter;
+  ReplaceVarnodeMap::iterator iter;
   for(iter=varmap.begin();iter!=varmap.end();++iter)
     (*iter).first->clearMark();
 
-  if (!retval) return false;
-  if (pullcount == 0) return false;
+  if ((!retval)||(pullcount == 0)) {
+    if (fd != (Funcdata *)0)
+      fd->markTraceFailed(traceKind(),rootvn,rootmask);
+    return false;
+  }
   return true;
 }
 
 void SubvariableFlow::doReplacement(void)
 
 { // Create the actual replacement data-flow with -fd-
-  list<ReplaceOp>::iterator iter;
+  ReplaceOpList::iterator iter;
 
   // Define all the outputs first
   for(iter=oplist.begin();iter!=oplist.end();++iter) {
@@ -1342,7 +1360,7 @@ SplitFlow::ReplaceVarnode *SplitFlow::setReplacement(Varnode *vn,bool &inworklis
   // Return null if this won't work
   ReplaceVarnode *res;
   if (vn->isMark()) {		// Already seen before
-    map<Varnode *,ReplaceVarnode>::iterator iter;
+    ReplaceVarnodeMap::iterator iter;
     iter = varmap.find(vn);
     res = &(*iter).second;
     inworklist = false;
@@ -1407,7 +1425,7 @@ bool SplitFlow::traceForward(ReplaceVarnode *rvn)
   Varnode *outvn,*tmpvn;
   uintb val;
 
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = rvn->vn->beginDescend();
   enditer = rvn->vn->endDescend();
   while(iter != enditer) {
@@ -1537,6 +1555,9 @@ SplitFlow::SplitFlow(Funcdata *f,Varnode *root,int4 lowSize)
   concatSize = root->getSize();
   loSize = lowSize;
   hiSize = concatSize - loSize;
+  rootvn = root;
+  if (fd->hasTraceFailed(TraceFailureCache::split,rootvn,loSize))
+    return;			// Leave worklist empty, so doTrace() fails immediately
   bool inworklist;
   ReplaceVarnode *rvn = setReplacement(root,inworklist);
   if (rvn == (ReplaceVarnode *)0)
@@ -1550,7 +1571,7 @@ void SplitFlow::doReplacement(void)
 {
   ReplaceVarnode *rvn1;
 
-  list<ReplaceOp>::iterator iter;
+  ReplaceOpList::iterator iter;
   for(iter=oplist.begin();iter!=oplist.end();++iter) {
     buildReplaceOutputs(&(*iter));		// Build the raw replacement ops for anything needing an output
   }
@@ -1631,11 +1652,15 @@ bool SplitFlow::doTrace(void)
   }
 
   // Clear marks
-  map<Varnode *,ReplaceVarnode>::iterator iter;
+  ReplaceVarnodeMap::iterator iter;
   for(iter=varmap.begin();iter!=varmap.end();++iter)
     (*iter).first->clearMark();
 
-  if (!retval) return false;
+  if (!retval) {
+    if (fd != (Funcdata *)0)
+      fd->markTraceFailed(TraceFailureCache::split,rootvn,loSize);
+    return false;
+  }
   return true;
 }
 
@@ -1646,7 +1671,7 @@ SubfloatFlow::ReplaceVarnode *SubfloatFlow::setReplacement(Varnode *vn,bool &inw
   // Return NULL if the vn is not suitable for replacement
   ReplaceVarnode *res;
   if (vn->isMark()) {		// Already seen before
-    map<Varnode *,ReplaceVarnode>::iterator iter;
+    ReplaceVarnodeMap::iterator iter;
     iter = varmap.find(vn);
     res = &(*iter).second;
     inworklist = false;
@@ -1694,7 +1719,7 @@ SubfloatFlow::ReplaceVarnode *SubfloatFlow::setReplacementNoFlow(Varnode *vn)
   // and there will be no further logical flow through -vn-
   ReplaceVarnode *res;
   if (vn->isMark()) {		// Already seen before
-    map<Varnode *,ReplaceVarnode>::iterator iter;
+    ReplaceVarnodeMap::iterator iter;
     iter = varmap.find(vn);
     res = &(*iter).second;
     return res;
@@ -1758,7 +1783,7 @@ bool SubfloatFlow::traceForward(ReplaceVarnode *rvn)
   int4 dcount = 0;
   int4 hcount = 0;
 
-  list<PcodeOp *>::const_iterator iter,enditer;
+  DescendList::const_iterator iter,enditer;
   iter = rvn->vn->beginDescend();
   enditer = rvn->vn->endDescend();
   while(iter != enditer) {
@@ -2014,6 +2039,12 @@ SubfloatFlow::SubfloatFlow(Funcdata *f,Varnode *root,int4 prec)
   fd = f;
   precision = prec;
   format = fd->getArch()->translate->getFloatFormat(precision);
+  rootvn = root;
+  if (format == (const FloatFormat *)0) return;
+  if (fd->hasTraceFailed(TraceFailureCache::subfloat,rootvn,precision)) {
+    fd = (Funcdata *)0;		// Same trace failed and nothing has changed since
+    return;
+  }
   createLink((ReplaceOp *)0,0,root);
 }
 
@@ -2033,19 +2064,22 @@ bool SubfloatFlow::doTrace(void)
   }
 
   // Clear marks
-  map<Varnode *,ReplaceVarnode>::iterator iter;
+  ReplaceVarnodeMap::iterator iter;
   for(iter=varmap.begin();iter!=varmap.end();++iter)
     (*iter).first->clearMark();
 
-  if (!retval) return false;
-  if (pulllist.empty()&&complist.empty()) return false;
+  if ((!retval)||(pulllist.empty()&&complist.empty())) {
+    if ((fd != (Funcdata *)0)&&(format != (const FloatFormat *)0))
+      fd->markTraceFailed(TraceFailureCache::subfloat,rootvn,precision);
+    return false;
+  }
   return true;
 }
 
 void SubfloatFlow::doReplacement(void)
 
 { // Create the actual replacement data-flow with -fd-
-  list<ReplaceOp>::iterator iter;
+  ReplaceOpList::iterator iter;
 
   // Define all the outputs first
   for(iter=oplist.begin();iter!=oplist.end();++iter) {
@@ -0,0 +1,194 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "tracespan.hh"
+
+#include <iomanip>
+
+namespace GhidraDec {
+
+bool TraceLog::enabled = false;
+std::mutex TraceLog::reglock;
+std::vector<std::pair<std::string,std::string> > TraceLog::kinds;
+std::map<std::pair<std::string,std::string>,int4> TraceLog::kindindex;
+std::vector<TraceBuffer *> TraceLog::buffers;
+std::chrono::steady_clock::time_point TraceLog::epoch = std::chrono::steady_clock::now();
+thread_local TraceBuffer *TraceLog::current = (TraceBuffer *)0;
+const uint4 TraceLog::maxevents = 1 << 22;
+
+/// Buffers are never deleted, so a thread can keep its pointer for its whole lifetime.
+/// Threads are numbered in the order they first record a span, starting at 1.
+/// \return the buffer belonging to the current thread
+TraceBuffer *TraceLog::getBuffer(void)
+
+{
+  if (current == (TraceBuffer *)0) {
+    std::lock_guard<std::mutex> guard(reglock);
+    current = new TraceBuffer(buffers.size() + 1);
+    buffers.push_back(current);
+  }
+  return current;
+}
+
+/// \param val is \b true to start recording, \b false to stop
+void TraceLog::setEnabled(bool val)
+
+{
+  enabled = val;
+}
+
+/// The same name and category always produce the same index, so clones of an Action
+/// share a single kind.
+/// \param nm is the name of the span
+/// \param cat is the category of the span (shown by the trace viewer)
+/// \return the index of the span kind
+int4 TraceLog::registerKind(const std::string &nm,const std::string &cat)
+
+{
+  std::lock_guard<std::mutex> guard(reglock);
+  std::pair<std::string,std::string> key(nm,cat);
+  std::map<std::pair<std::string,std::string>,int4>::const_iterator iter = kindindex.find(key);
+  if (iter != kindindex.end())
+    return (*iter).second;
+  int4 res = kinds.size();
+  kinds.push_back(key);
+  kindindex[key] = res;
+  return res;
+}
+
+/// \param id is the index of the span kind
+/// \param start is the time the span started (from now())
+/// \param detail is an optional detail to attach to the span (or null)
+void TraceLog::record(int4 id,uint8 start,const std::string *detail)
+
+{
+  TraceBuffer *buf = getBuffer();
+  TraceEvent ev;
+  ev.id = id;
+  ev.start = start;
+  ev.duration = now() - start;
+  std::lock_guard<std::mutex> guard(buf->lock);
+  if (buf->events.size() >= maxevents) {
+    buf->dropped += 1;
+    return;
+  }
+  if (detail != (const std::string *)0) {
+    ev.detail = buf->details.size();
+    buf->details.push_back(*detail);
+  }
+  else
+    ev.detail = -1;
+  buf->events.push_back(ev);
+}
+
+/// Span kinds remain registered, and the buffers remain allocated for their threads.
+void TraceLog::clear(void)
+
+{
+  std::lock_guard<std::mutex> guard(reglock);
+  for(int4 i=0;i<buffers.size();++i) {
+    std::lock_guard<std::mutex> bufguard(buffers[i]->lock);
+    buffers[i]->events.clear();
+    buffers[i]->details.clear();
+    buffers[i]->dropped = 0;
+  }
+}
+
+/// \return the number of spans recorded, across all threads
+int4 TraceLog::numEvents(void)
+
+{
+  std::lock_guard<std::mutex> guard(reglock);
+  int4 res = 0;
+  for(int4 i=0;i<buffers.size();++i) {
+    std::lock_guard<std::mutex> bufguard(buffers[i]->lock);
+    res += buffers[i]->events.size();
+  }
+  return res;
+}
+
+/// \return the number of spans dropped, across all threads
+uint4 TraceLog::numDropped(void)
+
+{
+  std::lock_guard<std::mutex> guard(reglock);
+  uint4 res = 0;
+  for(int4 i=0;i<buffers.size();++i) {
+    std::lock_guard<std::mutex> bufguard(buffers[i]->lock);
+    res += buffers[i]->dropped;
+  }
+  return res;
+}
+
+/// \param s is the output stream
+/// \param str is the string to write, which is quoted and escaped
+void TraceLog::writeString(std::ostream &s,const std::string &str)
+
+{
+  s << '\"';
+  for(int4 i=0;i<str.size();++i) {
+    char c = str[i];
+    if (c == '\"' || c == '\\')
+      s << '\\' << c;
+    else if ((unsigned char)c < 0x20)
+      s << "\\u" << std::hex << std::setw(4) << std::setfill('0') << (int4)c << std::setfill(' ') << std::dec;
+    else
+      s << c;
+  }
+  s << '\"';
+}
+
+/// Each span is written as a \e complete event (phase "X") with its start time and duration in
+/// microseconds.  Spans with a detail carry it as the \e function argument. Each thread's name is
+/// given by a metadata event.
+/// \param s is the output stream
+void TraceLog::saveChromeJson(std::ostream &s)
+
+{
+  std::lock_guard<std::mutex> guard(reglock);
+  std::ios_base::fmtflags fl = s.flags();
+  std::streamsize prec = s.precision();
+  s << std::fixed << std::setprecision(3);
+  s << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  bool first = true;
+  for(int4 i=0;i<buffers.size();++i) {
+    TraceBuffer *buf = buffers[i];
+    std::lock_guard<std::mutex> bufguard(buf->lock);
+    if (!first) s << ',';
+    first = false;
+    s << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << std::dec << buf->tid;
+    s << ",\"args\":{\"name\":\"decompiler " << buf->tid << "\"}}";
+    for(int4 j=0;j<buf->events.size();++j) {
+      const TraceEvent &ev( buf->events[j] );
+      s << ",\n{\"name\":";
+      writeString(s,kinds[ev.id].first);
+      s << ",\"cat\":";
+      writeString(s,kinds[ev.id].second);
+      s << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << std::dec << buf->tid;
+      s << ",\"ts\":" << (double)ev.start / 1000.0 << ",\"dur\":" << (double)ev.duration / 1000.0;
+      if (ev.detail >= 0) {
+	s << ",\"args\":{\"function\":";
+	writeString(s,buf->details[ev.detail]);
+	s << '}';
+      }
+      s << '}';
+    }
+  }
+  s << "\n]}\n";
+  s.flags(fl);
+  s.precision(prec);
+}
+
+}
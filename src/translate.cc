@@ -27,6 +27,16 @@ void TruncationTag::restoreXml(const Element *el)
   s >> size;
 }
 
+/// \param s is the output stream
+void TruncationTag::saveXml(ostream &s) const
+
+{
+  s << "<truncate_space";
+  a_v(s,"space",spaceName);
+  a_v_i(s,"size",size);
+  s << "/>\n";
+}
+
 /// Construct a virtual space.  This is usually used for the stack
 /// space, but multiple such spaces are allowed.
 /// \param m is the manager for this \b program \b specific address space
@@ -511,14 +521,15 @@ JoinRecord *AddrSpaceManager::findAddJoin(const std::vector<VarnodeData> &pieces
       throw LowlevelError("Cannot create a zero size join");
   }
 
-  JoinRecord testnode;
-
-  testnode.pieces = pieces;
-  testnode.unified.size = totalsize;
-  std::set<JoinRecord *,JoinRecordCompare>::const_iterator iter;
-  iter = splitset.find(&testnode);
-  if (iter != splitset.end())		// If already in the std::set
-    return *iter;
+  uint4 hash = hashJoin(pieces,totalsize);
+  uint4 mask = splithash.size() - 1;
+  if (!splithash.empty()) {
+    for(uint4 pos=hash&mask;splithash[pos].second!=(JoinRecord *)0;pos=(pos+1)&mask) {
+      JoinRecord *rec = splithash[pos].second;
+      if (splithash[pos].first == hash && rec->unified.size == totalsize && rec->pieces == pieces)
+	return rec;		// Already defined
+    }
+  }
 
   JoinRecord *newjoin = new JoinRecord();
   newjoin->pieces = pieces;
@@ -529,9 +540,54 @@ JoinRecord *AddrSpaceManager::findAddJoin(const std::vector<VarnodeData> &pieces
   newjoin->unified.offset = joinallocate;
   joinallocate += roundsize;
   newjoin->unified.size = totalsize;
-  splitset.insert(newjoin);
   splitlist.push_back(newjoin);
-  return splitlist.back();
+  if (2 * splitlist.size() > splithash.size())
+    growSplitHash();		// Rehashes every record, including the new one
+  else {
+    uint4 pos = hash & mask;
+    while(splithash[pos].second != (JoinRecord *)0)
+      pos = (pos + 1) & mask;
+    splithash[pos] = pair<uint4,JoinRecord *>(hash,newjoin);
+  }
+  return newjoin;
+}
+
+/// Every piece and the logical size contribute, so records that differ only in their
+/// logical size (float extensions of the same register) get different hashes.
+/// \param pieces is the list of pieces, most significant first
+/// \param size is the logical size of the joined value
+/// \return the hash
+uint4 AddrSpaceManager::hashJoin(const vector<VarnodeData> &pieces,uint4 size)
+
+{
+  uint4 hash = size;
+  for(int4 i=0;i<pieces.size();++i) {
+    const VarnodeData &vdata(pieces[i]);
+    hash = hash * 0x9e3779b1 + (uint4)vdata.space->getIndex();
+    hash = hash * 0x9e3779b1 + (uint4)(vdata.offset ^ (vdata.offset >> 32));
+    hash = hash * 0x9e3779b1 + vdata.size;
+  }
+  return hash ^ (hash >> 16);
+}
+
+/// The table is kept at most half full.  Records are taken from  splitlist.
+void AddrSpaceManager::growSplitHash(void)
+
+{
+  uint4 size = splithash.empty() ? 16 : splithash.size() * 2;
+  while(size < 2 * splitlist.size())
+    size *= 2;
+  splithash.clear();
+  splithash.resize(size,pair<uint4,JoinRecord *>(0,(JoinRecord *)0));
+  uint4 mask = size - 1;
+  for(int4 i=0;i<splitlist.size();++i) {
+    JoinRecord *rec = splitlist[i];
+    uint4 hash = hashJoin(rec->pieces,rec->unified.size);
+    uint4 pos = hash & mask;
+    while(splithash[pos].second != (JoinRecord *)0)
+      pos = (pos + 1) & mask;
+    splithash[pos] = pair<uint4,JoinRecord *>(hash,rec);
+  }
 }
 
 /// Given a specific \e offset into the \e join address space, recover the JoinRecord that
@@ -738,6 +794,202 @@ void PcodeEmit::restoreXmlOp(const Element *el,const AddrSpaceManager *manage)
   dump(pc,(OpCode)opcode,outptr,invar,isize);
 }
 
+void PcodeRun::clear(void)
+
+{
+  instructions.clear();
+  ops.clear();
+  varnodes.clear();
+  flowbreak = false;
+  curflow = false;
+  curop = 0;
+  curvarnode = 0;
+}
+
+/// Ops passed to dump() after this call belong to the new instruction.
+/// \param addr is the address of the instruction
+void PcodeRun::beginInstruction(const Address &addr)
+
+{
+  curaddr = addr;
+  curop = ops.size();
+  curvarnode = varnodes.size();
+  curflow = false;
+}
+
+/// \param length is the number of bytes in the instruction
+void PcodeRun::endInstruction(int4 length)
+
+{
+  instructions.emplace_back();
+  RunInstruction &insn(instructions.back());
+  insn.addr = curaddr;
+  insn.length = length;
+  insn.firstop = curop;
+  insn.numops = ops.size() - curop;
+  flowbreak = curflow;
+}
+
+/// Any ops passed to dump() since the last beginInstruction() are removed.
+void PcodeRun::abortInstruction(void)
+
+{
+  ops.resize(curop);
+  varnodes.resize(curvarnode);
+  curflow = false;
+}
+
+/// \param addr is the address to search for
+/// \return the index of the instruction starting at the address, or -1 if there isn't one
+int4 PcodeRun::findInstruction(const Address &addr) const
+
+{
+  for(int4 i=0;i<instructions.size();++i) {
+    if (instructions[i].addr == addr)
+      return i;
+  }
+  return -1;
+}
+
+/// The ops are passed to the given emitter in the order they were originally produced.
+/// \param i is the index of the instruction
+/// \param emt is the emitter to receive the p-code
+void PcodeRun::emit(int4 i,PcodeEmit &emt)
+
+{
+  const RunInstruction &insn(instructions[i]);
+  for(int4 j=0;j<insn.numops;++j) {
+    const RunOp &op(ops[insn.firstop + j]);
+    VarnodeData *outvar = (op.out < 0) ? (VarnodeData *)0 : &varnodes[op.out];
+    VarnodeData *invar = (op.isize == 0) ? (VarnodeData *)0 : &varnodes[op.in];
+    emt.dump(op.addr,op.opc,outvar,invar,op.isize);
+  }
+}
+
+void PcodeRun::dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize)
+
+{
+  ops.emplace_back();
+  RunOp &op(ops.back());
+  op.addr = addr;
+  op.opc = opc;
+  op.out = -1;
+  if (outvar != (VarnodeData *)0) {
+    op.out = varnodes.size();
+    varnodes.push_back(*outvar);
+  }
+  op.in = varnodes.size();
+  op.isize = isize;
+  for(int4 i=0;i<isize;++i)
+    varnodes.push_back(vars[i]);
+  switch(opc) {
+  case CPUI_BRANCH:
+  case CPUI_CBRANCH:
+  case CPUI_BRANCHIND:
+  case CPUI_CALL:
+  case CPUI_CALLIND:
+  case CPUI_RETURN:
+    curflow = true;
+    break;
+  default:
+    break;
+  }
+}
+
+/// The default implementation translates only the first instruction, as a translator
+/// that cannot tell when an instruction changes the context of the instructions after it
+/// cannot safely translate ahead.
+/// \param run will hold the translated instructions
+/// \param baseaddr is the Address of the first machine instruction
+/// \param maxbytes is the maximum number of bytes to translate
+/// \param maxinsn is the maximum number of instructions to translate
+/// \return the number of bytes translated
+int4 Translate::translateRun(PcodeRun &run,const Address &baseaddr,int4 maxbytes,int4 maxinsn) const
+
+{
+  run.clear();
+  run.beginInstruction(baseaddr);
+  int4 length = oneInstruction(run,baseaddr);
+  run.endInstruction(length);
+  return length;
+}
+
+/// \brief A PcodeEmit that notes the branches of an instruction, for Translate::instructionFlow()
+class PcodeEmitFlow : public PcodeEmit {
+public:
+  OpCode lastop;		///< The last op emitted
+  uint4 flow;			///< Flow properties, not counting the targets of branches
+  vector<Address> targets;	///< Targets of BRANCH and CBRANCH ops
+  PcodeEmitFlow(void) { lastop = CPUI_COPY; flow = 0; }	///< Constructor
+  virtual void dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize);
+};
+
+void PcodeEmitFlow::dump(const Address &addr,OpCode opc,VarnodeData *outvar,VarnodeData *vars,int4 isize)
+
+{
+  lastop = opc;
+  switch(opc) {
+  case CPUI_BRANCH:
+  case CPUI_CBRANCH:
+    if (vars[0].space->getType() != IPTR_CONSTANT)	// Relative branches stay within the instruction
+      targets.push_back(Address(vars[0].space,vars[0].offset));
+    break;
+  case CPUI_BRANCHIND:
+    flow |= Translate::flow_indirect;
+    break;
+  case CPUI_CALL:
+    flow |= Translate::flow_call;
+    break;
+  case CPUI_CALLIND:
+    flow |= (Translate::flow_call | Translate::flow_indirect);
+    break;
+  case CPUI_RETURN:
+    flow |= Translate::flow_return;
+    break;
+  default:
+    break;
+  }
+}
+
+int4 Translate::instructionFlow(const Address &baseaddr,uint4 &flow) const
+
+{
+  PcodeEmitFlow emit;
+  int4 length = oneInstruction(emit,baseaddr);
+  flow = emit.flow;
+  if (emit.lastop != CPUI_BRANCH && emit.lastop != CPUI_BRANCHIND && emit.lastop != CPUI_RETURN)
+    flow |= flow_fallthru;
+  Address next = baseaddr + length;
+  for(int4 i=0;i<emit.targets.size();++i) {
+    if (emit.targets[i] == next)
+      flow |= flow_fallthru;
+    else if (emit.targets[i] != baseaddr)
+      flow |= flow_jump;
+  }
+  return length;
+}
+
+/// The default implementation calls printAssembly() for each instruction.
+int4 Translate::printAssemblyRun(AssemblyEmit &emit,const Address &baseaddr,int4 maxbytes) const
+
+{
+  int4 total = 0;
+  Address curaddr(baseaddr);
+  do {
+    int4 length;
+    try {
+      length = printAssembly(emit,curaddr);
+    }
+    catch(LowlevelError &err) {
+      if (total == 0) throw;
+      break;
+    }
+    total += length;
+    curaddr = curaddr + length;
+  } while(total < maxbytes);
+  return total;
+}
+
 /// A Helper function for PcodeEmit::restorePackedOp that reads an unsigned offset from a packed stream
 /// \param ptr is a pointer into a packed byte stream
 /// \param off is where the offset read from the stream is stored
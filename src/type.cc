@@ -92,6 +92,28 @@ Datatype *Datatype::getSubType(uintb off,uintb *newoff) const
   return (Datatype *)0;
 }
 
+/// This is the same as calling getSubType() repeatedly until there is no component, but
+/// nested structures are resolved with a single search of the flattened fields of the
+/// outermost TypeStruct, rather than a search per level.
+/// \param off is the offset into \b this data-type
+/// \param newoff is a pointer to the passed-back offset, relative to the returned data-type
+/// \return the innermost data-type containing the offset, which may be \b this
+Datatype *Datatype::getLeafType(uintb off,uintb *newoff)
+
+{
+  Datatype *last;
+  Datatype *cur = this;
+  do {
+    last = cur;
+    if (cur->metatype == TYPE_STRUCT)
+      cur = ((TypeStruct *)cur)->getFlatSubType(off,&off);
+    else
+      cur = cur->getSubType(off,&off);
+  } while(cur != (Datatype *)0);
+  *newoff = off;
+  return last;
+}
+
 /// Compare \b this with another data-type.
 /// 0 (equality) means the data-types are functionally equivalent (even if names differ)
 /// Smaller types come earlier. More specific types come earlier.
@@ -125,6 +147,16 @@ int4 Datatype::compareDependency(const Datatype &op) const
   return 0;
 }
 
+/// Data-types that compare as equal with compareDependency() must produce the same hash.
+/// The base hash only covers the size and meta-type, which every override of compareDependency()
+/// distinguishes first.
+/// \return the hash value
+uint4 Datatype::hashDependency(void) const
+
+{
+  return (uint4)size * 0x9e3779b1 + (uint4)metatype;
+}
+
 /// Convert a type \b meta-type into the string name of the meta-type
 /// \param metatype is the encoded type meta-type
 /// \param res will hold the resulting string
@@ -418,6 +450,14 @@ int4 TypePointer::compareDependency(const Datatype &op) const
   return (ptrto < tp->ptrto) ? -1 : 1; // Compare the absolute pointers
 }
 
+uint4 TypePointer::hashDependency(void) const
+
+{
+  uintp addr = (uintp)ptrto;
+  uint4 res = Datatype::hashDependency() ^ (uint4)(addr >> 3) ^ (uint4)((uint8)addr >> 35);
+  return res * 0x85ebca6b + wordsize;
+}
+
 void TypePointer::saveXml(std::ostream &s) const
 
 {
@@ -480,6 +520,14 @@ int4 TypeArray::compareDependency(const Datatype &op) const
   return (arrayof < ta->arrayof) ? -1 : 1;
 }
 
+uint4 TypeArray::hashDependency(void) const
+
+{
+  uintp addr = (uintp)arrayof;
+  uint4 res = Datatype::hashDependency() ^ (uint4)(addr >> 3) ^ (uint4)((uint8)addr >> 35);
+  return res * 0xc2b2ae35;
+}
+
 Datatype *TypeArray::getSubType(uintb off,uintb *newoff) const
 
 {				// Go down exactly one level, to type of element
@@ -714,6 +762,7 @@ void TypeEnum::restoreXml(const Element *el,TypeFactory &typegrp)
 TypeStruct::TypeStruct(const TypeStruct &op)
   : Datatype(op)
 {
+  flatok = false;
   setFields(op.field);
   size = op.size;		// setFields might have changed the size
 }
@@ -734,6 +783,48 @@ void TypeStruct::setFields(const vector<TypeField> &fd)
     if (end > size)
       size = end;
   }
+  flat.clear();
+  flatok = flattenFields(flat,0,false);
+  if (!flatok)
+    flat.clear();
+}
+
+/// Fields that are not themselves structures are appended as they are, and nested structures
+/// are flattened recursively.  Within a nested structure, any bytes not covered by its fields
+/// are appended as a range whose type is the nested structure, as that is where a descent
+/// through getSubType() stops.  The flattening fails if fields overlap or a nested structure
+/// is not defined yet, as the table could then disagree with getSubType().
+/// \param res is the list to append to
+/// \param base is the offset of \b this within the outermost structure
+/// \param gaps is \b true if bytes not covered by a field should be appended
+/// \return \b true if the fields could be flattened
+bool TypeStruct::flattenFields(vector<FlatField> &res,int4 base,bool gaps) const
+
+{
+  int4 pos = 0;				// First byte not yet covered
+  for(int4 i=0;i<field.size();++i) {
+    const TypeField &curfield( field[i] );
+    int4 sz = curfield.type->getSize();
+    if (sz == 0) {
+      if (curfield.type->getMetatype() == TYPE_STRUCT)
+	return false;			// Structure may be defined later
+      continue;
+    }
+    if (curfield.offset < pos)
+      return false;			// Overlapping fields
+    if (gaps && curfield.offset > pos)
+      res.push_back({base + pos,curfield.offset - pos,base,(Datatype *)this});
+    if (curfield.type->getMetatype() == TYPE_STRUCT) {
+      if (!((const TypeStruct *)curfield.type)->flattenFields(res,base + curfield.offset,true))
+	return false;
+    }
+    else
+      res.push_back({base + curfield.offset,sz,base + curfield.offset,curfield.type});
+    pos = curfield.offset + sz;
+  }
+  if (gaps && size > pos)
+    res.push_back({base + pos,size - pos,base,(Datatype *)this});
+  return true;
 }
 
 /// Find the proper subfield given an offset. Return the index of that field
@@ -794,6 +885,36 @@ Datatype *TypeStruct::getSubType(uintb off,uintb *newoff) const
   return curfield.type;
 }
 
+/// This descends through every level of nested structure in one search.  The result is
+/// the same as calling getSubType() until the component is not a structure, or until
+/// the offset falls in a gap of a structure, in which case that structure is returned.
+/// \param off is the offset into \b this
+/// \param newoff is a pointer to the offset to pass back, relative to the returned data-type
+/// \return the component data-type or NULL if the offset is not in a field
+Datatype *TypeStruct::getFlatSubType(uintb off,uintb *newoff) const
+
+{
+  if (!flatok)
+    return getSubType(off,newoff);
+  int4 min = 0;
+  int4 max = flat.size()-1;
+  while(min <= max) {
+    int4 mid = (min + max)/2;
+    const FlatField &cur( flat[mid] );
+    if ((uintb)cur.offset > off)
+      max = mid - 1;
+    else {
+      if ((uintb)(cur.offset + cur.size) > off) {
+	*newoff = off - cur.base;
+	return cur.type;
+      }
+      min = mid + 1;
+    }
+  }
+  *newoff = off;
+  return (Datatype *)0;
+}
+
 int4 TypeStruct::compare(const Datatype &op,int4 level) const
 {
   if (size != op.getSize()) return (op.getSize()-size);
@@ -1192,6 +1313,164 @@ void TypeSpacebase::restoreXml(const Element *el,TypeFactory &typegrp)
   localframe = Address::restoreXml(list.front(),typegrp.getArch());
 }
 
+void DatatypeHashSet::grow(void)
+
+{
+  vector<pair<uint4,Datatype *> > old;
+  old.swap(slot);
+  slot.resize(old.empty() ? 64 : old.size() * 2,pair<uint4,Datatype *>(0,(Datatype *)0));
+  uint4 mask = slot.size() - 1;
+  for(int4 i=0;i<old.size();++i) {
+    if (old[i].second == (Datatype *)0) continue;
+    uint4 pos = old[i].first & mask;
+    while(slot[pos].second != (Datatype *)0)
+      pos = (pos + 1) & mask;
+    slot[pos] = old[i];
+  }
+}
+
+/// \param ct is the description of the data-type to find
+/// \return the matching data-type, or null if there isn't one
+Datatype *DatatypeHashSet::find(const Datatype &ct) const
+
+{
+  if (count == 0) return (Datatype *)0;
+  uint4 hash = ct.hashDependency();
+  uint4 mask = slot.size() - 1;
+  for(uint4 pos=hash&mask;slot[pos].second!=(Datatype *)0;pos=(pos+1)&mask) {
+    if (slot[pos].first == hash && slot[pos].second->compareDependency(ct) == 0)
+      return slot[pos].second;
+  }
+  return (Datatype *)0;
+}
+
+/// \param ct is the data-type to add
+void DatatypeHashSet::insert(Datatype *ct)
+
+{
+  if (2 * (count + 1) > slot.size())
+    grow();
+  uint4 hash = ct->hashDependency();
+  uint4 mask = slot.size() - 1;
+  uint4 pos = hash & mask;
+  while(slot[pos].second != (Datatype *)0)
+    pos = (pos + 1) & mask;
+  slot[pos] = pair<uint4,Datatype *>(hash,ct);
+  count += 1;
+}
+
+/// The data-type must not have changed since it was inserted.
+/// \param ct is the data-type to remove
+void DatatypeHashSet::erase(Datatype *ct)
+
+{
+  if (count == 0) return;
+  uint4 mask = slot.size() - 1;
+  uint4 pos = ct->hashDependency() & mask;
+  while(slot[pos].second != ct) {
+    if (slot[pos].second == (Datatype *)0) return;	// Not present
+    pos = (pos + 1) & mask;
+  }
+  count -= 1;
+  // Shift back any later entries that can't be found across the hole
+  uint4 hole = pos;
+  for(pos=(pos+1)&mask;slot[pos].second!=(Datatype *)0;pos=(pos+1)&mask) {
+    uint4 home = slot[pos].first & mask;
+    bool reachable = (hole <= pos) ? (home > hole && home <= pos) : (home > hole || home <= pos);
+    if (reachable) continue;	// Entry is still found from its home slot
+    slot[hole] = slot[pos];
+    hole = pos;
+  }
+  slot[hole] = pair<uint4,Datatype *>(0,(Datatype *)0);
+}
+
+void DatatypeIdIndex::grow(void)
+
+{
+  vector<pair<uint4,Datatype *> > old;
+  old.swap(slot);
+  slot.resize(old.empty() ? 64 : old.size() * 2,pair<uint4,Datatype *>(0,(Datatype *)0));
+  uint4 mask = slot.size() - 1;
+  for(int4 i=0;i<old.size();++i) {
+    if (old[i].second == (Datatype *)0) continue;
+    uint4 pos = old[i].first & mask;
+    while(slot[pos].second != (Datatype *)0)
+      pos = (pos + 1) & mask;
+    slot[pos] = old[i];
+  }
+}
+
+/// \param nm is the name of the data-type
+/// \param id is the id of the data-type
+/// \return the matching data-type, or null if there isn't one
+Datatype *DatatypeIdIndex::find(const string &nm,uint8 id) const
+
+{
+  if (count == 0) return (Datatype *)0;
+  uint4 hash = hashId(id);
+  uint4 mask = slot.size() - 1;
+  for(uint4 pos=hash&mask;slot[pos].second!=(Datatype *)0;pos=(pos+1)&mask) {
+    Datatype *ct = slot[pos].second;
+    if (slot[pos].first == hash && ct->getId() == id && ct->getName() == nm)
+      return ct;
+  }
+  return (Datatype *)0;
+}
+
+/// \param id is the id of the data-type
+/// \return \b true if some data-type in the table has the id
+bool DatatypeIdIndex::contains(uint8 id) const
+
+{
+  if (count == 0) return false;
+  uint4 hash = hashId(id);
+  uint4 mask = slot.size() - 1;
+  for(uint4 pos=hash&mask;slot[pos].second!=(Datatype *)0;pos=(pos+1)&mask) {
+    if (slot[pos].first == hash && slot[pos].second->getId() == id)
+      return true;
+  }
+  return false;
+}
+
+/// \param ct is the data-type to add
+void DatatypeIdIndex::insert(Datatype *ct)
+
+{
+  if (2 * (count + 1) > slot.size())
+    grow();
+  uint4 hash = hashId(ct->getId());
+  uint4 mask = slot.size() - 1;
+  uint4 pos = hash & mask;
+  while(slot[pos].second != (Datatype *)0)
+    pos = (pos + 1) & mask;
+  slot[pos] = pair<uint4,Datatype *>(hash,ct);
+  count += 1;
+}
+
+/// The id of the data-type must not have changed since it was inserted.
+/// \param ct is the data-type to remove
+void DatatypeIdIndex::erase(Datatype *ct)
+
+{
+  if (count == 0) return;
+  uint4 mask = slot.size() - 1;
+  uint4 pos = hashId(ct->getId()) & mask;
+  while(slot[pos].second != ct) {
+    if (slot[pos].second == (Datatype *)0) return;	// Not present
+    pos = (pos + 1) & mask;
+  }
+  count -= 1;
+  // Shift back any later entries that can't be found across the hole
+  uint4 hole = pos;
+  for(pos=(pos+1)&mask;slot[pos].second!=(Datatype *)0;pos=(pos+1)&mask) {
+    uint4 home = slot[pos].first & mask;
+    bool reachable = (hole <= pos) ? (home > hole && home <= pos) : (home > hole || home <= pos);
+    if (reachable) continue;	// Entry is still found from its home slot
+    slot[hole] = slot[pos];
+    hole = pos;
+  }
+  slot[hole] = pair<uint4,Datatype *>(0,(Datatype *)0);
+}
 
 /// Initialize an empty container
 /// \param g is the owning Architecture
@@ -1325,9 +1604,20 @@ void TypeFactory::clear(void)
     delete *iter;
   tree.clear();
   nametree.clear();
+  idindex.clear();
+  hashtable.clear();
   clearCache();
 }
 
+/// The data-type is searched for under any name, as the name may have changed since it was cached.
+/// \param id is the type id of the data-type
+/// \return \b true if a data-type with the id is present
+bool TypeFactory::hasId(uint8 id) const
+
+{
+  return idindex.contains(id);
+}
+
 /// Delete anything that isn't a core type
 void TypeFactory::clearNoncore(void)
 
@@ -1343,6 +1633,9 @@ void TypeFactory::clearNoncore(void)
       continue;
     }
     nametree.erase(ct);
+    idindex.erase(ct);
+    if (ct->id == 0)
+      hashtable.erase(ct);
     tree.erase(iter++);
     delete ct;
   }
@@ -1363,18 +1656,14 @@ Datatype *TypeFactory::findByIdLocal(const string &n,uint8 id) const
 {				// Get type of given name
   DatatypeNameSet::const_iterator iter;
 
+  if (id != 0)			// Search for an exact type
+    return idindex.find(n,id);
+				// Allow for the fact that the name may not be unique
   TypeBase ct(1,TYPE_UNKNOWN,n);
-  if (id != 0) {		// Search for an exact type
-    ct.id = id;
-    iter = nametree.find((Datatype *)&ct);
-    if (iter == nametree.end()) return (Datatype *)0; // Didn't find it
-  }
-  else {			// Allow for the fact that the name may not be unique
-    ct.id = 0;
-    iter = nametree.lower_bound((Datatype *)&ct);
-    if (iter == nametree.end()) return (Datatype *)0; // Didn't find it
-    if ((*iter)->getName() != n) return (Datatype *)0; // Found at least one datatype with this name
-  }
+  ct.id = 0;
+  iter = nametree.lower_bound((Datatype *)&ct);
+  if (iter == nametree.end()) return (Datatype *)0; // Didn't find it
+  if ((*iter)->getName() != n) return (Datatype *)0; // Found at least one datatype with this name
   return *iter;
 }
 
@@ -1405,6 +1694,8 @@ Datatype *TypeFactory::findByName(const string &n)
 Datatype *TypeFactory::findNoName(Datatype &ct)
 
 {
+  if (ct.id == 0)		// Types without an id are all in the hash table
+    return hashtable.find(ct);
   DatatypeSet::const_iterator iter;
   Datatype *res = (Datatype *)0;
   iter = tree.find(&ct);
@@ -1448,8 +1739,12 @@ Datatype *TypeFactory::findAdd(Datatype &ct)
     (*insres.first)->printRaw(s);
     throw LowlevelError(s.str());
   }
-  if (newtype->id!=0)
-    nametree.insert(newtype);
+  if (newtype->id!=0) {
+    if (nametree.insert(newtype).second)
+      idindex.insert(newtype);
+  }
+  else
+    hashtable.insert(newtype);
   return newtype;
 }
   
@@ -1460,15 +1755,20 @@ Datatype *TypeFactory::findAdd(Datatype &ct)
 Datatype *TypeFactory::setName(Datatype *ct,const string &n)
 
 {
-  if (ct->id != 0)
+  if (ct->id != 0) {
     nametree.erase( ct );	// Erase any name reference
+    idindex.erase( ct );
+  }
+  else
+    hashtable.erase( ct );
   tree.erase(ct);		// Remove new type completely from trees
   ct->name = n;			// Change the name
   if (ct->id == 0)
     ct->id = Datatype::hashName(n);
 				// Insert type with new name
   tree.insert(ct);
-  nametree.insert( ct );	// Re-insert name reference
+  if (nametree.insert( ct ).second)	// Re-insert name reference
+    idindex.insert( ct );
   return ct;
 }
 
@@ -1522,6 +1822,8 @@ bool TypeFactory::setFields(vector<TypeField> &fd,TypeStruct *ot,int4 fixedsize)
   // We could check field overlapping here
 
   tree.erase(ot);
+  if (ot->id == 0)
+    hashtable.erase(ot);
   ot->setFields(fd);
   if (fixedsize > 0) {		// If the caller is trying to force a size
     if (fixedsize > ot->size)	// If the forced size is bigger than the size required for fields
@@ -1530,6 +1832,8 @@ bool TypeFactory::setFields(vector<TypeField> &fd,TypeStruct *ot,int4 fixedsize)
       throw LowlevelError("Trying to force too small a size on "+ot->getName());
   }
   tree.insert(ot);
+  if (ot->id == 0)
+    hashtable.insert(ot);
   return true;
 }
 
@@ -1576,8 +1880,12 @@ bool TypeFactory::setEnumValues(const vector<string> &namelist,
   }
 
   tree.erase(te);
+  if (te->id == 0)
+    hashtable.erase(te);
   te->setNameMap(nmap);
   tree.insert(te);
+  if (te->id == 0)
+    hashtable.insert(te);
   return true;
 }
 
@@ -1625,6 +1933,7 @@ TypeVoid *TypeFactory::getTypeVoid(void)
   ct = (TypeVoid *)tv.clone();
   tree.insert(ct);
   nametree.insert(ct);
+  idindex.insert(ct);
   typecache[0][TYPE_VOID-TYPE_FLOAT] = ct; // Cache this particular type ourselves
   return ct;
 }
@@ -1865,6 +2174,9 @@ void TypeFactory::destroyType(Datatype *ct)
   if (ct->isCoreType())
     throw LowlevelError("Cannot destroy core type");
   nametree.erase(ct);
+  idindex.erase(ct);
+  if (ct->id == 0)
+    hashtable.erase(ct);
   tree.erase(ct);
   delete ct;
 }
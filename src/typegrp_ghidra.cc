@@ -18,12 +18,12 @@
 
 namespace GhidraDec {
 
-Datatype *TypeFactoryGhidra::findById(const string &n,uint8 id)
+/// \param n is the name of the data-type
+/// \param id is the id of the data-type
+/// \return the new Datatype object, or null if the client doesn't know the data-type
+Datatype *TypeFactoryGhidra::findByQuery(const string &n,uint8 id)
 
 {
-  Datatype *ct = TypeFactory::findById(n,id); // Try internal find
-  if (ct != (Datatype *)0) return ct;
-
   Document *doc;
   try {
     doc = ((ArchitectureGhidra *)glb)->getType(n,id); // See if ghidra knows about type
@@ -32,8 +32,82 @@ Datatype *TypeFactoryGhidra::findById(const string &n,uint8 id)
     throw LowlevelError("XML error: "+err.explain);
   }
   if (doc == (Document *)0) return (Datatype *)0;
-  ct = restoreXmlType(doc->getRoot()); // Parse ghidra's type
+  Datatype *ct = restoreXmlType(doc->getRoot()); // Parse ghidra's type
   delete doc;
   return ct;
 }
+
+/// The definitions in the reply are keyed by id (or the hash of the name, as with a \<typeref>),
+/// and findById() takes them from there until the requested data-type is fully parsed.
+/// Definitions that weren't needed are thrown away.  If the client doesn't answer the query,
+/// closure queries are turned off and a single query is sent instead.
+/// \param n is the name of the data-type
+/// \param id is the id of the data-type
+/// \return the new Datatype object, or null if the client doesn't know the data-type
+Datatype *TypeFactoryGhidra::findByClosure(const string &n,uint8 id)
+
+{
+  Document *doc;
+  try {
+    doc = ((ArchitectureGhidra *)glb)->getTypeClosure(n,id);
+  }
+  catch(XmlError &err) {
+    throw LowlevelError("XML error: "+err.explain);
+  }
+  catch(JavaError &err) {
+    if (err.type == "alignment") throw;
+    closurequery = false;	// The client doesn't know the query
+    return findByQuery(n,id);
+  }
+  if (doc == (Document *)0) return (Datatype *)0;
+  const List &list(doc->getRoot()->getChildren());
+  List::const_iterator iter;
+  for(iter=list.begin();iter!=list.end();++iter) {
+    const Element *el = *iter;
+    uint8 elid = 0;
+    for(int4 i=0;i<el->getNumAttributes();++i) {
+      if (el->getAttributeName(i) == "id") {
+	istringstream s(el->getAttributeValue(i));
+	s.unsetf(std::ios::dec | std::ios::hex | std::ios::oct);
+	s >> elid;
+      }
+    }
+    if (elid == 0)
+      elid = Datatype::hashName(el->getAttributeValue("name"));
+    pending[elid] = el;
+  }
+  Datatype *ct = (Datatype *)0;
+  try {
+    ct = TypeFactory::findById(n,id);	// The definition may have already been given locally
+    if (ct == (Datatype *)0)
+      ct = findById(n,id);
+  }
+  catch(...) {
+    pending.clear();
+    delete doc;
+    throw;
+  }
+  pending.clear();
+  delete doc;
+  return ct;
+}
+
+Datatype *TypeFactoryGhidra::findById(const string &n,uint8 id)
+
+{
+  Datatype *ct = TypeFactory::findById(n,id); // Try internal find
+  if (ct != (Datatype *)0) return ct;
+
+  if (!pending.empty()) {	// In the middle of a closure reply
+    map<uint8,const Element *>::iterator iter = pending.find(id);
+    if (iter == pending.end())
+      return findByQuery(n,id);	// Not part of the closure after all
+    const Element *el = (*iter).second;
+    pending.erase(iter);
+    return restoreXmlType(el);
+  }
+  if (closurequery)
+    return findByClosure(n,id);
+  return findByQuery(n,id);
+}
 }
@@ -702,9 +702,9 @@ void ConstraintParamConstVal::print(ostream &s,UnifyCPrinter &printstate) const
   s << "if (!" << printstate.getName(opindex) << "->getIn(" << dec << slot << ")->isConstant())" << endl;
   printstate.printAbort(s);
   printstate.printIndent(s);
-  s << "if (" << printstate.getName(opindex) << "->getIn(" << dec << slot << ")->getOffset() != 0x";
+  s << "if (" << printstate.getName(opindex) << "->getIn(" << dec << slot << ")->getOffset() != (0x";
   s << hex << val << " & calc_mask(" << printstate.getName(opindex) << "->getIn(" << dec;
-  s << slot << ")->getSize()))" << endl;
+  s << slot << ")->getSize())))" << endl;
   printstate.printAbort(s);
 }
 
@@ -859,7 +859,7 @@ void ConstraintDescend::print(ostream &s,UnifyCPrinter &printstate) const
 
 {
   printstate.printIndent(s);
-  s << "list<PcodeOp *>::const_iterator iter" << dec << printstate.getDepth() << ",enditer" << printstate.getDepth() << ';' << endl;
+  s << "DescendList::const_iterator iter" << dec << printstate.getDepth() << ",enditer" << printstate.getDepth() << ';' << endl;
   printstate.printIndent(s);
   s << "iter" << printstate.getDepth() << " = " << printstate.getName(varindex) << "->beginDescend();" << endl;
   printstate.printIndent(s);
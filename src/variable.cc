@@ -40,7 +40,12 @@ void HighVariable::updateCover(void) const
 
 {
   if ((highflags & HighVariable::coverdirty)==0) return; // Cover info is upto date
-  highflags &= ~HighVariable::coverdirty;
+  if (((highflags & HighVariable::covermembers)!=0)&&inst[0]->hasCover()) {
+    updateCoverBlocks();
+    return;
+  }
+  highflags &= ~(HighVariable::coverdirty|HighVariable::covermembers);
+  dirtyblocks.clear();
 
   wholecover.clear();
   if (!inst[0]->hasCover()) return;
@@ -48,6 +53,29 @@ void HighVariable::updateCover(void) const
     wholecover.merge(*inst[i]->getCover());
 }
 
+/// The cover is dirty only because member Varnode covers changed, so only the blocks covered
+/// by a member either before or after its change are recalculated.  Each such block is
+/// merged from the member covers in order, just as a full rebuild would produce it.
+void HighVariable::updateCoverBlocks(void) const
+
+{
+  for(int4 i=0;i<inst.size();++i)
+    inst[i]->getCover();	// Bring member covers up to date, recording the blocks that change
+  highflags &= ~(HighVariable::coverdirty|HighVariable::covermembers);
+  sort(dirtyblocks.begin(),dirtyblocks.end());
+  vector<int4>::iterator enditer = unique(dirtyblocks.begin(),dirtyblocks.end());
+  for(vector<int4>::iterator iter=dirtyblocks.begin();iter!=enditer;++iter) {
+    int4 blk = *iter;
+    wholecover.clearBlock(blk);
+    for(int4 i=0;i<inst.size();++i) {
+      const Cover *cov = inst[i]->getCover();
+      if (cov != (const Cover *)0)
+	wholecover.mergeBlock(blk,*cov);
+    }
+  }
+  dirtyblocks.clear();
+}
+
 /// Only update if flags are marked as \e dirty.
 /// Generally if any member Varnode possesses the property, \b this HighVariable should
 /// inherit it.  The Varnode::typelock field is not set here, but in updateType().
@@ -182,6 +210,14 @@ Varnode *HighVariable::getNameRepresentative(void) const
   return rep;
 }
 
+/// The estimate counts the object, its list of member Varnodes, and its cover.
+/// \return the estimated number of bytes
+uint8 HighVariable::memoryEstimate(void) const
+
+{
+  return sizeof(HighVariable) + inst.capacity() * sizeof(Varnode *) + wholecover.memoryEstimate() - sizeof(Cover);
+}
+
 /// Search for the given Varnode and cut it out of the list, marking all properties as \e dirty.
 /// \param vn is the given Varnode member to remove
 void HighVariable::remove(Varnode *vn)
@@ -193,7 +229,8 @@ void HighVariable::remove(Varnode *vn)
   for(;iter!=inst.end();++iter) {
     if (*iter == vn) {
       inst.erase(iter);
-      highflags |= (HighVariable::flagsdirty|HighVariable::coverdirty|HighVariable::typedirty);
+      highflags |= (HighVariable::flagsdirty|HighVariable::typedirty);
+      coverDirty();
       return;
     }
   }
@@ -239,7 +276,7 @@ void HighVariable::merge(HighVariable *tv2,bool isspeculative)
   if (((highflags&HighVariable::coverdirty)==0)&&((tv2->highflags&HighVariable::coverdirty)==0))
     wholecover.merge(tv2->wholecover);
   else
-    highflags |= HighVariable::coverdirty;
+    coverDirty();
 
   delete tv2;
 }
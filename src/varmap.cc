@@ -265,7 +265,15 @@ static bool compare_ranges(const MapRange *a,const MapRange *b)
   type_metatype bmeta = b->type->getMetatype();
   if (ameta != bmeta)
     return (ameta < bmeta);		// Order more specific types first
-  return true;
+  return false;			// Ties keep the order they were gathered in
+}
+
+static intb signed_start(AddrSpace *spc,uintb st)
+
+{				// Byte offset of -st- as a signed value
+  intb sst = (intb)AddrSpace::byteToAddress(st,spc->getWordSize());
+  sign_extend(sst,spc->getAddrSize()*8-1);
+  return (intb)AddrSpace::addressToByte(sst,spc->getWordSize());
 }
 
 void AliasChecker::deriveBoundaries(const FuncProto &proto)
@@ -365,7 +373,7 @@ void AliasChecker::gatherAdditiveBase(Varnode *startvn,vector<AddBase> &addbase)
 {
   vector<AddBase> vnqueue;		// varnodes involved in addition with original vn
   Varnode *vn,*subvn,*indexvn,*othervn;
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *op;
   bool nonadduse;
   int4 i=0;
@@ -460,10 +468,96 @@ uintb AliasChecker::gatherOffset(Varnode *vn)
   return retval & calc_mask(vn->getSize());
 }
 
+bool MapCache::compareEntries(const Entry &a,const Entry &b)
+
+{
+  if (compare_ranges(&a.range,&b.range)) return true;
+  if (compare_ranges(&b.range,&a.range)) return false;
+  return (a.index < b.index);
+}
+
+MapRange MapCache::buildRange(AddrSpace *spc,uintb st,Datatype *ct)
+
+{
+  return MapRange(st,ct->getSize(),signed_start(spc,st),ct,0,false,0,-1);
+}
+
+void MapCache::rebuild(AddrSpace *spc)
+
+{
+  entries.clear();
+  entries.reserve(offsets.size());
+  for(int4 i=0;i<offsets.size();++i)
+    entries.push_back(Entry(buildRange(spc,offsets[i],types[i]),i));
+  sort(entries.begin(),entries.end(),compareEntries);
+}
+
+bool MapCache::update(AddrSpace *spc,int4 i,Datatype *oldtype)
+
+{				// Move the range of the -i-th varnode to its new sorted position
+  Entry key(buildRange(spc,offsets[i],oldtype),i);
+  vector<Entry>::iterator iter = lower_bound(entries.begin(),entries.end(),key,compareEntries);
+  if ((iter == entries.end())||((*iter).index != i))
+    return false;
+  entries.erase(iter);
+  Entry entry(buildRange(spc,offsets[i],types[i]),i);
+  iter = lower_bound(entries.begin(),entries.end(),entry,compareEntries);
+  entries.insert(iter,entry);
+  return true;
+}
+
+void MapCache::gatherVarnodes(const Funcdata &fd,AddrSpace *spc,Datatype *dt)
+
+{				// Bring the ranges up to date with the varnodes in -spc-
+  vector<pair<int4,Datatype *> > changed;
+  bool match = true;
+  int4 i = 0;
+  VarnodeLocSet::const_iterator iter = fd.beginLoc(spc);
+  VarnodeLocSet::const_iterator iterend = fd.endLoc(spc);
+  for(;iter!=iterend;++iter) {
+    Varnode *vn = *iter;
+    if (vn->isFree()) continue;
+    Datatype *ct = vn->getType();
+    if ((ct == (Datatype *)0)||(ct->getSize()==0)) // Must have a real type
+      ct = dt;
+    if (match) {
+      if ((i < offsets.size())&&(offsets[i] == vn->getOffset())) {
+	if (types[i] != ct) {
+	  changed.push_back(pair<int4,Datatype *>(i,types[i]));
+	  types[i] = ct;
+	}
+	i += 1;
+	continue;
+      }
+      match = false;
+      offsets.resize(i);
+      types.resize(i);
+    }
+    offsets.push_back(vn->getOffset());
+    types.push_back(ct);
+  }
+  if (match && (i != offsets.size())) {
+    match = false;
+    offsets.resize(i);
+    types.resize(i);
+  }
+  if (match && (changed.size() * 8 <= offsets.size())) {
+    for(i=0;i<changed.size();++i) {
+      if (!update(spc,changed[i].first,changed[i].second)) {
+	match = false;
+	break;
+      }
+    }
+    if (match) return;
+  }
+  rebuild(spc);
+}
+
 MapState::MapState(AddrSpace *spc,const RangeList &rn,
 		     const RangeList &pm,Datatype *dt) : range(rn)
 {
   spaceid = spc;
+  numsorted = 0;
   default_type = dt;
   set<Range>::const_iterator iter;
   for(iter=pm.begin();iter!=pm.end();++iter) {
@@ -493,9 +587,7 @@ void MapState::addRange(uintb st,Datatype *ct,uint4 fl,bool ay,int4 lo,int4 hi)
   int4 sz = ct->getSize();
   if (!range.inRange(Address(spaceid,st),sz))
     return;
-  intb sst = (intb)AddrSpace::byteToAddress(st,spaceid->getWordSize());
-  sign_extend(sst,spaceid->getAddrSize()*8-1);
-  sst = (intb)AddrSpace::addressToByte(sst,spaceid->getWordSize());
+  intb sst = signed_start(spaceid,st);
   MapRange *range = new MapRange(st,sz,sst,ct,fl,ay,lo,hi);
   maplist.push_back(range);
 #ifdef OPACTION_DEBUG
@@ -526,6 +618,26 @@ void MapState::addRange(const EntryMap *rangemap)
   }
 }
 
+void MapState::addRanges(const MapCache &cache)
+
+{				// Add the cached (already sorted) varnode ranges
+  const vector<MapCache::Entry> &entries( cache.getEntries() );
+  for(int4 i=0;i<entries.size();++i) {
+    const MapRange &a( entries[i].range );
+    if (!range.inRange(Address(spaceid,a.start),a.size))
+      continue;
+    maplist.push_back(new MapRange(a));
+  }
+  numsorted = maplist.size();
+#ifdef OPACTION_DEBUG
+  if (debugon) {
+    ostringstream s;
+    s << "Add " << dec << numsorted << " cached ranges" << endl;
+    glb->printDebug(s.str());
+  }
+#endif
+}
+
 bool MapState::initialize(void)
 
 {
@@ -534,14 +646,14 @@ bool MapState::initialize(void)
   if (lastrange == (Range *)0) return false;
   if (maplist.empty()) return false;
   uintb high = spaceid->wrapOffset(lastrange->getLast()+1);
-  intb sst = (intb)AddrSpace::byteToAddress(high,spaceid->getWordSize());
-  sign_extend(sst,spaceid->getAddrSize()*8-1);
-  sst = (intb)AddrSpace::addressToByte(sst,spaceid->getWordSize());
+  intb sst = signed_start(spaceid,high);
   // Add extra range to bound any final open entry
   MapRange *range = new MapRange(high,1,sst,default_type,0,false,0,-2);
   maplist.push_back(range);
 
-  stable_sort(maplist.begin(),maplist.end(),compare_ranges);
+  // Only the ranges added after the cached ones need sorting
+  stable_sort(maplist.begin()+numsorted,maplist.end(),compare_ranges);
+  inplace_merge(maplist.begin(),maplist.begin()+numsorted,maplist.end(),compare_ranges);
   iter = maplist.begin();
   return true;
 }
@@ -592,12 +704,10 @@ void MapState::gatherHighs(const Funcdata &fd)
     varvec[i]->clearMark();
 }
 
-void MapState::gatherOpen(const Funcdata &fd)
+void MapState::gatherOpen(const AliasChecker &checker)
 
 {				// Gather open-ended ranges. These correspond
 				// to the use of ptrs to local variables
-  checker.gather(&fd,spaceid,false);
-
   const vector<AliasChecker::AddBase> &addbase( checker.getAddBase() );
   const vector<uintb> &alias( checker.getAlias() );
   uintb offset;
@@ -637,8 +747,11 @@ void ScopeLocal::restructureVarnode(bool aliasyes)
   if (debugon)
     state.turnOnDebug(glb);
 #endif
-  state.gatherVarnodes(*fd); // Gather stack type information from varnodes
-  state.gatherOpen(*fd);
+  // Gather stack type information from varnodes
+  mapcache.gatherVarnodes(*fd,spaceid,glb->types->getBase(1,TYPE_UNKNOWN));
+  state.addRanges(mapcache);
+  const AliasChecker &checker( fd->getAliasChecker(spaceid) );
+  state.gatherOpen(checker);
   state.addRange(maptable[spaceid->getIndex()]);
   restructure(state,false);
 
@@ -648,9 +761,11 @@ void ScopeLocal::restructureVarnode(bool aliasyes)
   clearUnlockedCategory(0);
   fakeInputSymbols();
 
-  state.sortAlias();
-  if (aliasyes)
-    markUnaliased(state.getAlias());
+  if (aliasyes) {
+    vector<uintb> alias( checker.getAlias() ); // Sort a copy, the checker is shared
+    sort(alias.begin(),alias.end());
+    markUnaliased(alias);
+  }
 }
 
 void ScopeLocal::restructureHigh(void)
@@ -665,7 +780,7 @@ void ScopeLocal::restructureHigh(void)
     state.turnOnDebug(glb);
 #endif
   state.gatherHighs(*fd); // Gather stack type information from highs
-  state.gatherOpen(*fd);
+  state.gatherOpen(fd->getAliasChecker(spaceid));
   state.addRange(maptable[spaceid->getIndex()]);
   restructure(state,true);
 
@@ -35,8 +35,8 @@ inline bool VarnodeCompareLocDef::operator()(const Varnode *a,const Varnode *b)
   f2 = b->getFlags()&(Varnode::input|Varnode::written);
   if (f1!=f2) return ((f1-1)<(f2-1)); // -1 forces free varnodes to come last
   if (f1==Varnode::written) {
-    if (a->getDef()->getSeqNum() != b->getDef()->getSeqNum())
-      return (a->getDef()->getSeqNum() < b->getDef()->getSeqNum());
+    if (a->defseq != b->defseq)
+      return (a->defseq < b->defseq);
   }
   else if (f1 == 0)		// both are free
     //    return (a < b);		// compare pointers
@@ -60,8 +60,8 @@ inline bool VarnodeCompareDefLoc::operator()(const Varnode *a,const Varnode *b)
   if (f1!=f2) return ((f1-1)<(f2-1));
 				// NOTE: The -1 forces free varnodes to come last
   if (f1==Varnode::written) {
-    if (a->getDef()->getSeqNum() != b->getDef()->getSeqNum())
-      return (a->getDef()->getSeqNum() < b->getDef()->getSeqNum());
+    if (a->defseq != b->defseq)
+      return (a->defseq < b->defseq);
   }
   if (a->getAddr() != b->getAddr()) return (a->getAddr() < b->getAddr());
   if (a->getSize() != b->getSize()) return (a->getSize() < b->getSize());
@@ -208,9 +208,18 @@ void Varnode::updateCover(void) const
 
 {
   if ((flags & Varnode::coverdirty)!=0) {
-    if (hasCover()&&(cover!=(Cover *)0))
+    if (hasCover()&&(cover!=(Cover *)0)) {
+      if (high != (HighVariable *)0)
+	high->memberCoverChanged(*cover);	// Blocks the old cover touched
       cover->rebuild(this);
-    clearFlags(Varnode::coverdirty);
+      if (high != (HighVariable *)0)
+	high->memberCoverChanged(*cover);	// Blocks the new cover touches
+    }
+    flags &= ~Varnode::coverdirty;
+    if (high != (HighVariable *)0) {
+      high->flagsDirty();
+      high->memberCoverDirty();
+    }
   }
 }
 
@@ -221,6 +230,8 @@ void Varnode::clearCover(void) const
   if (cover != (Cover *)0) {
     delete cover;
     cover = (Cover *)0;
+    if (high != (HighVariable *)0)
+      high->coverDirty();	// Blocks of the deleted cover are no longer known
   }
 }
 
@@ -233,6 +244,8 @@ void Varnode::calcCover(void) const
       delete cover;
     cover = new Cover;
     setFlags(Varnode::coverdirty);
+    if (high != (HighVariable *)0)
+      high->coverDirty();	// The old cover is gone, so the whole cover of the HighVariable must be rebuilt
   }
 }
 
@@ -290,7 +303,7 @@ void Varnode::printInfo(ostream &s) const
 void Varnode::eraseDescend(PcodeOp *op)
 
 {
-  list<PcodeOp *>::iterator iter;
+  DescendList::iterator iter;
 
   iter = descend.begin();
   while (*iter != op)		// Find this op in list of vn's descendants
@@ -330,7 +343,7 @@ void Varnode::setFlags(uint4 fl) const
   if (high != (HighVariable *)0) {
     high->flagsDirty();
     if ((fl&Varnode::coverdirty)!=0)
-      high->coverDirty();
+      high->memberCoverDirty();
   }
 }
 
@@ -343,7 +356,7 @@ void Varnode::clearFlags(uint4 fl) const
   if (high != (HighVariable *)0) {
     high->flagsDirty();
     if ((fl&Varnode::coverdirty)!=0)
-      high->coverDirty();
+      high->memberCoverDirty();
   }
 }
 
@@ -357,8 +370,10 @@ void Varnode::setDef(PcodeOp *op)
     setFlags(Varnode::coverdirty);
     clearFlags(Varnode::written);
   }
-  else
+  else {
+    defseq = op->getSeqNum();
     setFlags(Varnode::coverdirty|Varnode::written);
+  }
 }
 
 /// Change the Datatype and lock state associated with this Varnode if various conditions are met
@@ -523,7 +538,7 @@ PcodeOp *Varnode::loneDescend(void) const
 
   if (descend.empty()) return (PcodeOp *)0; // No descendants
 
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
 
   iter = descend.begin();
   op = *iter++;			// First descendant
@@ -690,7 +705,7 @@ Datatype *Varnode::getLocalType(void) const
   if (def != (PcodeOp *)0)
     ct = def->outputTypeLocal();
 
-  list<PcodeOp *>::const_iterator iter;
+  DescendList::const_iterator iter;
   PcodeOp *op;
   int4 i;
   for(iter=descend.begin();iter!=descend.end();++iter) {
@@ -801,6 +816,25 @@ VarnodeBank::VarnodeBank(AddrSpaceManager *m,AddrSpace *uspace,uintm ubase)
   create_index = 0;
 }
 
+/// The estimate counts each Varnode object, its node in the location tree and (except for
+/// constants) in the definition tree, and its list of descendants.  The Cover of a Varnode is counted with the HighVariable.
+/// \return the estimated number of bytes
+uint8 VarnodeBank::memoryEstimate(void) const
+
+{
+  uint8 res = 0;
+  VarnodeLocSet::const_iterator iter;
+
+  for(iter=loc_tree.begin();iter!=loc_tree.end();++iter) {
+    const Varnode *vn = *iter;
+    res += sizeof(Varnode) + 4 * sizeof(void *);		// Object plus a node in the location tree
+    if (!vn->isConstant())
+      res += 4 * sizeof(void *);				// Node in the definition tree
+    res += vn->descend.size() * 3 * sizeof(void *);		// List node for each descendant
+  }
+  return res;
+}
+
 void VarnodeBank::clear(void)
 
 {
@@ -817,6 +851,7 @@ void VarnodeBank::clear(void)
 
 /// The Varnode is created and inserted into the maps as \e free: not
 /// defined as the output of a p-code op or the input to a function.
+/// Constants are only inserted into the location map.
 /// \param s is the size of the Varnode in bytes
 /// \param m is the starting address
 /// \param ct is the data-type of the new varnode (must not be NULL)
@@ -828,7 +863,10 @@ Varnode *VarnodeBank::create(int4 s,const Address &m,Datatype *ct)
   
   vn->create_index = create_index++;
   vn->lociter = loc_tree.insert(vn).first; // Frees can always be inserted without duplication
-  vn->defiter = def_tree.insert(vn).first;
+  if (vn->isConstant())
+    vn->defiter = def_tree.end();
+  else
+    vn->defiter = def_tree.insert(vn).first;
   return vn;
 }
 
@@ -854,7 +892,8 @@ void VarnodeBank::destroy(Varnode *vn)
     throw LowlevelError("Deleting integrated varnode");
 
   loc_tree.erase(vn->lociter);
-  def_tree.erase(vn->defiter);
+  if (!vn->isConstant())
+    def_tree.erase(vn->defiter);
   delete vn;
 }
 
@@ -890,6 +929,7 @@ Varnode *VarnodeBank::xref(Varnode *vn)
 void VarnodeBank::makeFree(Varnode *vn)
 
 {
+  if (vn->isConstant()) return;		// Constants are always free
   loc_tree.erase(vn->lociter);
   def_tree.erase(vn->defiter);
 
@@ -906,7 +946,7 @@ void VarnodeBank::makeFree(Varnode *vn)
 void VarnodeBank::replace(Varnode *oldvn,Varnode *newvn)
 
 {
-  list<PcodeOp *>::iterator iter,tmpiter;
+  DescendList::iterator iter,tmpiter;
   PcodeOp *op;
   int4 i;
 
@@ -1207,11 +1247,10 @@ VarnodeLocSet::const_iterator VarnodeBank::beginLoc(int4 s,const Address &addr,
   }
   if (fl == Varnode::written) {
     SeqNum sq(Address::m_minimal); // Minimal sequence number
-    PcodeOp searchop(0,sq);
     searchvn.size = s;
     searchvn.loc = addr;
     searchvn.flags = Varnode::written;
-    searchvn.def = &searchop;
+    searchvn.defseq = sq;
     iter = loc_tree.lower_bound(&searchvn);
     searchvn.size = 0;
     searchvn.flags = Varnode::input;
@@ -1219,11 +1258,10 @@ VarnodeLocSet::const_iterator VarnodeBank::beginLoc(int4 s,const Address &addr,
   }
 
   SeqNum sq(Address::m_maximal); // Maximal sequence number
-  PcodeOp searchop(0,sq);
   searchvn.size = s;
   searchvn.loc = addr;
   searchvn.flags = Varnode::written;
-  searchvn.def = &searchop;
+  searchvn.defseq = sq;
   iter = loc_tree.upper_bound(&searchvn);
   searchvn.size = 0;
   searchvn.flags = Varnode::input;
@@ -1251,8 +1289,7 @@ VarnodeLocSet::const_iterator VarnodeBank::endLoc(int4 s,const Address &addr,
     searchvn.size = s;
     searchvn.flags = Varnode::written;
     SeqNum sq(Address::m_maximal); // Maximal sequence number
-    PcodeOp searchop(0,sq);
-    searchvn.def = &searchop;
+    searchvn.defseq = sq;
     iter = loc_tree.upper_bound(&searchvn);
     searchvn.size = 0;
     searchvn.flags = Varnode::input;
@@ -1292,8 +1329,7 @@ VarnodeLocSet::const_iterator VarnodeBank::beginLoc(int4 s,const Address &addr,
   if (uniq==~((uintm)0))	// If don't care about uniq
     uniq = 0;			// find earliest
   SeqNum sq(pc,uniq);
-  PcodeOp searchop(0,sq);
-  searchvn.def = &searchop;
+  searchvn.defseq = sq;
   iter = loc_tree.lower_bound(&searchvn);
 
   searchvn.size = 0;
@@ -1321,8 +1357,7 @@ VarnodeLocSet::const_iterator VarnodeBank::endLoc(int4 s,const Address &addr,
   //  if (uniq==~((uintm)0))
   //    uniq = 0;
   SeqNum sq(pc,uniq);
-  PcodeOp searchop(0,sq);
-  searchvn.def = &searchop;
+  searchvn.defseq = sq;
   iter = loc_tree.upper_bound(&searchvn);
 
   searchvn.size = 0;
@@ -1350,8 +1385,7 @@ VarnodeDefSet::const_iterator VarnodeBank::beginDef(uint4 fl) const
     searchvn.loc = Address(Address::m_minimal); // Lowest possible location
     searchvn.flags = Varnode::written;
     SeqNum sq(Address::m_minimal); // Lowest possible seqnum
-    PcodeOp searchop(0,sq);
-    searchvn.def = &searchop;
+    searchvn.defseq = sq;
     iter = def_tree.lower_bound(&searchvn);
     searchvn.flags = Varnode::input; // Reset flags
     return iter;
@@ -1361,8 +1395,7 @@ VarnodeDefSet::const_iterator VarnodeBank::beginDef(uint4 fl) const
   searchvn.loc = Address(Address::m_maximal); // Maximal possible location
   searchvn.flags = Varnode::written;
   SeqNum sq(Address::m_maximal); // Maximal seqnum
-  PcodeOp searchop(0,sq);
-  searchvn.def = &searchop;
+  searchvn.defseq = sq;
   iter = def_tree.upper_bound(&searchvn);
   searchvn.flags = Varnode::input; // Reset flags
   return iter;
@@ -1386,8 +1419,7 @@ VarnodeDefSet::const_iterator VarnodeBank::endDef(uint4 fl) const
     searchvn.loc = Address(Address::m_minimal); // Lowest possible location
     searchvn.flags = Varnode::written;
     SeqNum sq(Address::m_minimal); // Lowest possible seqnum
-    PcodeOp searchop(0,sq);
-    searchvn.def = &searchop;
+    searchvn.defseq = sq;
     iter = def_tree.lower_bound(&searchvn);
     searchvn.flags = Varnode::input; // Reset flags
     return iter;
@@ -1396,8 +1428,7 @@ VarnodeDefSet::const_iterator VarnodeBank::endDef(uint4 fl) const
     searchvn.loc = Address(Address::m_maximal); // Maximal possible location
     searchvn.flags = Varnode::written;
     SeqNum sq(Address::m_maximal); // Maximal seqnum
-    PcodeOp searchop(0,sq);
-    searchvn.def = &searchop;
+    searchvn.defseq = sq;
     iter = def_tree.upper_bound(&searchvn);
     searchvn.flags = Varnode::input; // Reset flags
     return iter;
@@ -1488,11 +1519,11 @@ void VarnodeBank::verifyIntegrity(void) const
   if (loc_tree.empty()) return;
   iter = loc_tree.begin();
   lastvn = *iter++;
-  if (def_tree.end() == def_tree.find(lastvn))
+  if (!lastvn->isConstant() && def_tree.end() == def_tree.find(lastvn))
     throw LowlevelError("Varbank first loc missing in def");
   for(;iter!=loc_tree.end();++iter) {
     vn = *iter;
-    if (def_tree.end() == def_tree.find(vn))
+    if (!vn->isConstant() && def_tree.end() == def_tree.find(vn))
       throw LowlevelError("Varbank loc missing in def");
     if (*vn < *lastvn)
       throw LowlevelError("Varbank locdef integrity test failed");
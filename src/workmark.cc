@@ -0,0 +1,190 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "workmark.hh"
+
+#ifndef _WINDOWS
+#include <csignal>
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace GhidraDec {
+
+bool WorkMark::enabled = false;
+std::atomic<int4> WorkMark::numslots(0);
+thread_local WorkSlot *WorkMark::current = (WorkSlot *)0;
+int WorkMark::annotatefd = 2;
+WorkSlot WorkMark::slots[WorkMark::maxslots];
+
+/// \brief Append a string to a fixed buffer, truncating if it doesn't fit
+///
+/// \param buf is the buffer
+/// \param pos is the current end of the buffer, which is advanced
+/// \param max is the size of the buffer
+/// \param str is the null-terminated string to append (or null)
+static void workAppend(char *buf,int4 &pos,int4 max,const char *str)
+
+{
+  if (str == (const char *)0)
+    str = "-";
+  while(*str != '\0' && pos < max)
+    buf[pos++] = *str++;
+}
+
+/// \brief Append a number to a fixed buffer, in decimal or hexadecimal
+///
+/// \param buf is the buffer
+/// \param pos is the current end of the buffer, which is advanced
+/// \param max is the size of the buffer
+/// \param val is the number to append
+/// \param base is 10 or 16
+static void workAppend(char *buf,int4 &pos,int4 max,uint8 val,uint4 base)
+
+{
+  char digits[24];
+  int4 num = 0;
+  do {
+    uint4 d = val % base;
+    digits[num++] = (d < 10) ? ('0' + d) : ('a' + d - 10);
+    val /= base;
+  } while(val != 0);
+  while(num > 0 && pos < max)
+    buf[pos++] = digits[--num];
+}
+
+/// Slots are handed out in order and never returned, so there is no need for a lock.  Once all
+/// slots are taken, further threads go unnoted.
+/// \return the claimed slot, or null if there are none left
+WorkSlot *WorkMark::claimSlot(void)
+
+{
+  int4 index = numslots.fetch_add(1);
+  if (index >= maxslots) {
+    numslots.store(maxslots);
+    return (WorkSlot *)0;
+  }
+  WorkSlot *slot = slots + index;
+  slot->funcaddr = 0;
+  slot->action = (const char *)0;
+  slot->rule = (const char *)0;
+  slot->pass = 0;
+  int4 tid = index + 1;
+#if !defined(_WINDOWS) && defined(__linux__)
+  tid = syscall(SYS_gettid);
+#endif
+  slot->ostid.store(tid,std::memory_order_release);
+  return slot;
+}
+
+/// \param sig is the signal being handled
+void WorkMark::signalHandler(int sig)
+
+{
+  dump(annotatefd);
+}
+
+/// The first time noting is enabled, a handler is installed for SIGUSR1 that calls dump().
+/// When disabled, the slots keep their last contents.
+/// \param val is \b true to start noting, \b false to stop
+void WorkMark::setEnabled(bool val)
+
+{
+#ifndef _WINDOWS
+  static bool installed = false;
+  if (val && !installed) {
+    struct sigaction act;
+    act.sa_handler = &WorkMark::signalHandler;
+    sigemptyset(&act.sa_mask);
+    act.sa_flags = SA_RESTART;
+    sigaction(SIGUSR1,&act,(struct sigaction *)0);
+    installed = true;
+  }
+#endif
+  enabled = val;
+}
+
+/// The file is appended to, so a series of dumps builds up a record over time.  An empty name
+/// directs dumps back to \e stderr.
+/// \param file is the name of the file
+/// \return \b false if the file could not be opened
+bool WorkMark::setAnnotationFile(const std::string &file)
+
+{
+#ifdef _WINDOWS
+  return false;
+#else
+  int fd = 2;
+  if (file.size() != 0) {
+    fd = open(file.c_str(),O_WRONLY | O_CREAT | O_APPEND,0666);
+    if (fd < 0) return false;
+  }
+  int old = annotatefd;
+  annotatefd = fd;
+  if (old != 2)
+    close(old);
+  return true;
+#endif
+}
+
+/// One line is written per claimed slot, as
+///
+///   \<time> \<tid> \<function> \<action> \<rule> \<pass>
+///
+/// where time is in nanoseconds of CLOCK_MONOTONIC, tid is the operating system thread id, the
+/// function entry offset is in hexadecimal, and a missing action or rule is written as "-".
+/// A line is only written with write(2), and nothing is allocated, so this is safe to call from
+/// a signal handler.
+/// \param fd is the file descriptor to write to
+void WorkMark::dump(int fd)
+
+{
+#ifndef _WINDOWS
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC,&ts);
+  uint8 time = (uint8)ts.tv_sec * 1000000000 + ts.tv_nsec;
+  int4 num = numslots.load();
+  if (num > maxslots)
+    num = maxslots;
+  char buf[512];
+  for(int4 i=0;i<num;++i) {
+    const WorkSlot &slot(slots[i]);
+    int4 tid = slot.ostid.load(std::memory_order_acquire);
+    if (tid == 0) continue;		// Slot is still being claimed
+    int4 pos = 0;
+    int4 max = sizeof(buf) - 1;
+    workAppend(buf,pos,max,time,10);
+    workAppend(buf,pos,max," ");
+    workAppend(buf,pos,max,(uint8)tid,10);
+    workAppend(buf,pos,max," 0x");
+    workAppend(buf,pos,max,(uint8)slot.funcaddr,16);
+    workAppend(buf,pos,max," ");
+    workAppend(buf,pos,max,slot.action);
+    workAppend(buf,pos,max," ");
+    workAppend(buf,pos,max,slot.rule);
+    workAppend(buf,pos,max," ");
+    workAppend(buf,pos,max,(uint8)slot.pass,10);
+    buf[pos++] = '\n';
+    ssize_t res = write(fd,buf,pos);
+    (void)res;
+  }
+#endif
+}
+
+}
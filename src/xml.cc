@@ -0,0 +1,627 @@
+/* ###
+ * IP: GHIDRA
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "xml.hh"
+// The whole document is read into memory before it is parsed, up to the end of the stream
+// or the first NUL character, so the stream is left just past the NUL as before.  Runs of
+// plain characters are found with the library routines strcspn() and strstr(), which
+// scan many bytes at a time, and markup is parsed in place from the buffer.
+//
+// CharData        looks for '<' '&' or "]]>"
+// AttValue        looks for the end quote, '<' or '&'
+// CData           looks for "]]>"
+// Comment         looks for "--"
+
+#include <iostream>
+#include <string>
+#include <map>
+#include <cstring>
+
+namespace GhidraDec {
+
+class XmlParser {
+  const char *cur;		// Next character to parse
+  ContentHandler *handler;	// Receives the document as it is parsed
+  Attributes atts;		// Start tag being parsed, reused for every tag
+  std::vector<std::string> open;	// Names of the elements whose end tag has not been seen
+  int4 depth;			// Number of entries of open in use
+  std::string value;		// Attribute value being built, reused for every value
+  static bool isWhite(char c) { return (c==' ')||(c=='\n')||(c=='\r')||(c=='\t'); }
+  static bool isLetter(char c) { return (((c>=0x41)&&(c<=0x5a))||((c>=0x61)&&(c<=0x7a))); }
+  static bool isInitialNameChar(char c) { return isLetter(c)||(c=='_')||(c==':'); }
+  static bool isNameChar(char c) { return isInitialNameChar(c)||((c>='0')&&(c<='9'))||(c=='.')||(c=='-'); }
+  static bool isText(const char *start,const char *stop);
+  bool startsWith(const char *str) const { return (strncmp(cur,str,strlen(str))==0); }
+  bool fail(const char *msg);
+  void skipWhite(void) { while(isWhite(*cur)) ++cur; }
+  int4 scanName(void);
+  void emitText(const char *start,size_t len);
+  bool parseReference(int4 &val);
+  bool parseEq(void);
+  bool parseAttValue(void);
+  bool parseXmlDecl(void);
+  bool parseComment(void);
+  bool parseCData(void);
+  bool parseMisc(bool prolog);
+  bool parseStartTag(void);
+  bool parseEndTag(void);
+  bool parseElement(void);
+public:
+  XmlParser(const char *doc,ContentHandler *hand) { cur = doc; handler = hand; depth = 0; }
+  int4 parse(void);
+};
+
+bool XmlParser::isText(const char *start,const char *stop)
+
+{ // Check that a range holds no control characters other than tab, newline and return
+  for(;start!=stop;++start) {
+    uint1 c = (uint1)*start;
+    if (c < 0x20 && c != 0x9 && c != 0xa && c != 0xd)
+      return false;
+  }
+  return true;
+}
+
+bool XmlParser::fail(const char *msg)
+
+{
+  handler->setError(msg);
+  return false;
+}
+
+int4 XmlParser::scanName(void)
+
+{ // Return the length of the Name starting at cur, or 0 if there is none
+  if (!isInitialNameChar(*cur)) return 0;
+  const char *ptr = cur + 1;
+  while(isNameChar(*ptr)) ++ptr;
+  return ptr - cur;
+}
+
+void XmlParser::emitText(const char *start,size_t len)
+
+{ // Pass on character data, as ignorable if it is all white space
+  size_t i;
+  for(i=0;i<len;++i)
+    if (!isWhite(start[i])) break;
+  if (i==len)
+    handler->ignorableWhitespace(start,0,len);
+  else
+    handler->characters(start,0,len);
+}
+
+bool XmlParser::parseReference(int4 &val)
+
+{ // Parse an entity or character reference, starting at the '&'
+  cur += 1;
+  if (*cur == '#') {
+    cur += 1;
+    uint4 acc = 0;
+    const char *start;
+    if (*cur == 'x') {
+      cur += 1;
+      start = cur;
+      for(;;++cur) {
+	char c = *cur;
+	if ((c>='0')&&(c<='9')) acc = acc*16 + (c-'0');
+	else if ((c>='A')&&(c<='F')) acc = acc*16 + 10 + (c-'A');
+	else if ((c>='a')&&(c<='f')) acc = acc*16 + 10 + (c-'a');
+	else break;
+      }
+    }
+    else {
+      start = cur;
+      for(;(*cur>='0')&&(*cur<='9');++cur)
+	acc = acc*10 + (*cur-'0');
+    }
+    if (cur == start || *cur != ';')
+      return fail("syntax error");
+    cur += 1;
+    val = (int4)acc;
+    return true;
+  }
+  int4 len = scanName();
+  if (len == 0 || cur[len] != ';')
+    return fail("syntax error");
+  std::string ref(cur,len);
+  cur += len + 1;
+  if (ref == "lt") val = '<';
+  else if (ref == "amp") val = '&';
+  else if (ref == "gt") val = '>';
+  else if (ref == "quot") val = '"';
+  else if (ref == "apos") val = '\'';
+  else val = -1;
+  return true;
+}
+
+bool XmlParser::parseEq(void)
+
+{
+  skipWhite();
+  if (*cur != '=')
+    return fail("syntax error");
+  cur += 1;
+  skipWhite();
+  return true;
+}
+
+bool XmlParser::parseAttValue(void)
+
+{ // Parse a quoted value into value, expanding references
+  char quote = *cur;
+  if (quote != '"' && quote != '\'')
+    return fail("syntax error");
+  cur += 1;
+  const char *stops = (quote == '"') ? "\"<&" : "'<&";
+  value.clear();
+  for(;;) {
+    size_t run = strcspn(cur,stops);
+    value.append(cur,run);
+    cur += run;
+    if (*cur == quote) break;
+    if (*cur != '&')
+      return fail("syntax error");
+    int4 val;
+    if (!parseReference(val))
+      return false;
+    value += (char)val;
+  }
+  cur += 1;
+  return true;
+}
+
+bool XmlParser::parseXmlDecl(void)
+
+{ // Parse the declaration, starting just after "<?xml"
+  if (!isWhite(*cur))
+    return fail("syntax error");
+  skipWhite();
+  if (!startsWith("version"))
+    return fail("syntax error");
+  cur += 7;
+  if (!parseEq() || !parseAttValue())
+    return false;
+  handler->setVersion(value);
+  const char *ws = cur;
+  skipWhite();
+  if (cur != ws && startsWith("encoding")) {
+    cur += 8;
+    if (!parseEq() || !parseAttValue())
+      return false;
+    handler->setEncoding(value);
+    skipWhite();
+  }
+  if (!startsWith("?>"))
+    return fail("syntax error");
+  cur += 2;
+  return true;
+}
+
+bool XmlParser::parseComment(void)
+
+{ // Parse a comment, starting just after "<!--"
+  const char *stop = strstr(cur,"--");
+  if (stop == (const char *)0 || stop[2] != '>' || !isText(cur,stop))
+    return fail("syntax error");
+  cur = stop + 3;
+  return true;
+}
+
+bool XmlParser::parseCData(void)
+
+{ // Parse a CDATA section, starting just after "<![CDATA["
+  const char *stop = strstr(cur,"]]>");
+  if (stop == (const char *)0 || !isText(cur,stop))
+    return fail("syntax error");
+  emitText(cur,stop-cur);
+  cur = stop + 3;
+  return true;
+}
+
+bool XmlParser::parseMisc(bool prolog)
+
+{ // Skip white space and comments between the top-level markup
+  for(;;) {
+    skipWhite();
+    if (startsWith("<!--")) {
+      cur += 4;
+      if (!parseComment())
+	return false;
+    }
+    else if (startsWith("<?"))
+      return fail("Processing instructions are not supported");
+    else if (prolog && startsWith("<!DOCTYPE"))
+      return fail("DTD's not supported");
+    else
+      return true;
+  }
+}
+
+bool XmlParser::parseStartTag(void)
+
+{ // Parse a start tag or empty element tag, starting at the '<'
+  cur += 1;
+  int4 len = scanName();
+  atts.clear(cur,len);
+  cur += len;
+  for(;;) {
+    const char *ws = cur;
+    skipWhite();
+    len = scanName();
+    if (len == 0) break;
+    if (cur == ws)		// Attributes must be separated by white space
+      return fail("syntax error");
+    const char *nm = cur;
+    cur += len;
+    if (!parseEq() || !parseAttValue())
+      return false;
+    atts.add_attribute(nm,len,value);
+  }
+  const std::string &elname( atts.getelemName() );
+  if (*cur == '>') {
+    cur += 1;
+    handler->startElement(atts.getelemURI(),elname,elname,atts);
+    if (depth == open.size())
+      open.push_back(elname);
+    else
+      open[depth] = elname;
+    depth += 1;
+    return true;
+  }
+  if (cur[0] == '/' && cur[1] == '>') {
+    cur += 2;
+    handler->startElement(atts.getelemURI(),elname,elname,atts);
+    handler->endElement(atts.getelemURI(),elname,elname);
+    return true;
+  }
+  return fail("syntax error");
+}
+
+bool XmlParser::parseEndTag(void)
+
+{ // Parse an end tag, starting at the "</"
+  cur += 2;
+  int4 len = scanName();
+  if (len == 0)
+    return fail("syntax error");
+  cur += len;
+  skipWhite();
+  if (*cur != '>')
+    return fail("syntax error");
+  cur += 1;
+  depth -= 1;
+  handler->endElement(atts.getelemURI(),open[depth],open[depth]);
+  return true;
+}
+
+bool XmlParser::parseElement(void)
+
+{ // Parse an element and all its content, starting at the '<' of its start tag
+  if (!parseStartTag())
+    return false;
+  while(depth > 0) {
+    const char *ptr = cur;
+    for(;;) {
+      ptr += strcspn(ptr,"<&]");
+      if (*ptr != ']' || (ptr[1] == ']' && ptr[2] == '>')) break;
+      ptr += 1;			// A ']' that doesn't start "]]>" is character data
+    }
+    size_t run = ptr - cur;
+    if (run != 0) {
+      emitText(cur,run);
+      cur += run;
+    }
+    if (*cur == '<') {
+      if (isInitialNameChar(cur[1])) {
+	if (!parseStartTag())
+	  return false;
+      }
+      else if (cur[1] == '/') {
+	if (!parseEndTag())
+	  return false;
+      }
+      else if (startsWith("<!--")) {
+	cur += 4;
+	if (!parseComment())
+	  return false;
+      }
+      else if (startsWith("<![CDATA[")) {
+	cur += 9;
+	if (!parseCData())
+	  return false;
+      }
+      else if (cur[1] == '?')
+	return fail("Processing instructions are not supported");
+      else
+	return fail("syntax error");
+    }
+    else if (*cur == '&') {
+      int4 val;
+      if (!parseReference(val))
+	return false;
+      char c = (char)val;
+      emitText(&c,1);
+    }
+    else			// End of document or "]]>"
+      return fail("syntax error");
+  }
+  return true;
+}
+
+int4 XmlParser::parse(void)
+
+{
+  handler->startDocument();
+  if (startsWith("<?xml")) {
+    cur += 5;
+    if (!parseXmlDecl())
+      return 1;
+  }
+  if (!parseMisc(true))
+    return 1;
+  if (cur[0] != '<' || !isInitialNameChar(cur[1])) {
+    fail("syntax error");
+    return 1;
+  }
+  if (!parseElement())
+    return 1;
+  if (!parseMisc(false))
+    return 1;
+  if (*cur != '\0') {
+    fail("syntax error");
+    return 1;
+  }
+  handler->endDocument();
+  return 0;
+}
+
+int4 xml_parse(std::istream &i,ContentHandler *hand,int4 dbg)
+
+{
+  std::string doc;
+  std::getline(i,doc,'\0');	// Everything up to the end of the stream or a NUL
+  XmlParser parser(doc.c_str(),hand);
+  return parser.parse();
+}
+
+void TreeHandler::startElement(const std::string &namespaceURI,const std::string &localName,
+			       const std::string &qualifiedName,const Attributes &atts)
+{
+  Element *newel = new Element(cur);
+  cur->addChild(newel);
+  cur = newel;
+  newel->setName(localName);
+  for(int4 i=0;i<atts.getLength();++i)
+    newel->addAttribute(atts.getLocalName(i),atts.getValue(i));
+}
+
+void TreeHandler::endElement(const std::string &namespaceURI,const std::string &localName,
+			     const std::string &qualifiedName)
+{
+  Element *el = cur;
+  cur = cur->getParent();
+  if (consumer != (ElementConsumer *)0 && consumer->consume(el))
+    cur->deleteLastChild();	// Element has been handled, free it now
+}
+
+void TreeHandler::characters(const char *text,int4 start,int4 length)
+
+{
+  cur->addContent(text,start,length);
+}
+
+Element::~Element(void)
+
+{
+  List::iterator iter;
+  
+  for(iter=children.begin();iter!=children.end();++iter)
+    delete *iter;
+}
+
+// Make a deep copy of this element and all its children, which is owned by the caller
+// (or by the new parent).  The copy no longer depends on the document it came from.
+Element *Element::clone(Element *par) const
+
+{
+  Element *res = new Element(par);
+  res->name = name;
+  res->content = content;
+  res->attr = attr;
+  res->value = value;
+  res->children.reserve(children.size());
+  for(List::const_iterator iter=children.begin();iter!=children.end();++iter)
+    res->children.push_back((*iter)->clone(res));
+  return res;
+}
+
+const std::string &Element::getAttributeValue(const std::string &nm) const
+
+{
+  for(uint4 i=0;i<attr.size();++i)
+    if (attr[i] == nm)
+      return value[i];
+  throw XmlError("Unknown attribute: "+nm);
+}
+
+DocumentStorage::~DocumentStorage(void)
+
+{
+  for(int4 i=0;i<doclist.size();++i) {
+    if (doclist[i] != (Document *)0)
+      delete doclist[i];
+  }
+}
+
+Document *DocumentStorage::parseDocument(std::istream &s,ElementConsumer *consumer)
+
+{
+  doclist.push_back((Document *)0);
+  doclist.back() = xml_tree(s,consumer);
+  return doclist.back();
+}
+
+Document *DocumentStorage::openDocument(const std::string &filename,ElementConsumer *consumer)
+
+{ // Open and parse an XML file, return Document object
+  std::ifstream s(filename.c_str());
+  if (!s)
+    throw XmlError("Unable to open xml document "+filename);
+  Document *res = parseDocument(s,consumer);
+  s.close();
+  return res;
+}
+
+Document *DocumentStorage::addDocument(Document *doc)
+
+{ // Take ownership of a Document built by some other means
+  doclist.push_back(doc);
+  return doc;
+}
+
+void DocumentStorage::registerTag(const Element *el)
+
+{ // Register a tag under its name
+  tagmap[el->getName()] = el;
+}
+
+const Element *DocumentStorage::getTag(const std::string &nm) const
+
+{ // Retrieve a registered tag by name
+  std::map<std::string,const Element *>::const_iterator iter;
+
+  iter = tagmap.find(nm);
+  if (iter != tagmap.end())
+    return (*iter).second;
+  return (const Element *)0;
+}
+
+Document *xml_tree(std::istream &i,ElementConsumer *consumer)
+
+{
+  Document *doc = new Document();
+  TreeHandler handle(doc,consumer);
+  if (0!=xml_parse(i,&handle)) {
+    delete doc;
+    throw XmlError(handle.getError());
+  }
+  return doc;
+}
+
+void xml_escape(std::ostream &s,const char *str)
+
+{				// Escape xml tag indicators
+  for(;;) {
+    size_t run = strcspn(str,"<>&\"'");	// Library scan for the next character needing escape
+    if (run != 0) {
+      s.write(str,run);
+      str += run;
+    }
+    switch(*str) {
+    case '\0':
+      return;
+    case '<':
+      s.write("&lt;",4);
+      break;
+    case '>':
+      s.write("&gt;",4);
+      break;
+    case '&':
+      s.write("&amp;",5);
+      break;
+    case '"':
+      s.write("&quot;",6);
+      break;
+    default:
+      s.write("&apos;",6);
+      break;
+    }
+    str++;
+  }
+}
+
+char *xml_format_dec(char *end,intb val)
+
+{ // Write decimal digits backward from end, returning the first character
+  uintb uval = (val < 0) ? ~((uintb)val) + 1 : (uintb)val;
+  do {
+    *--end = '0' + (char)(uval % 10);
+    uval /= 10;
+  } while(uval != 0);
+  if (val < 0)
+    *--end = '-';
+  return end;
+}
+
+char *xml_format_hex(char *end,uintb val)
+
+{ // Write lowercase hex digits backward from end, returning the first character
+  static const char digits[] = "0123456789abcdef";
+  do {
+    *--end = digits[val & 15];
+    val >>= 4;
+  } while(val != 0);
+  return end;
+}
+
+XmlBuffer::XmlBuffer(size_t reserve)
+  : buf(reserve == 0 ? 1 : reserve)
+{
+  clear();
+}
+
+void XmlBuffer::grow(size_t need)
+
+{ // Make room for need more bytes past the current position, keeping what is written
+  size_t used = size();
+  size_t cap = buf.size();
+  while(cap - used < need)
+    cap *= 2;
+  std::vector<char> newbuf(cap);
+  memcpy(newbuf.data(),buf.data(),used);
+  buf.swap(newbuf);
+  setp(buf.data(),buf.data()+buf.size());
+  pbump((int)used);
+  setg(buf.data(),buf.data(),buf.data());
+}
+
+XmlBuffer::int_type XmlBuffer::overflow(int_type c)
+
+{
+  if (traits_type::eq_int_type(c,traits_type::eof()))
+    return traits_type::not_eof(c);
+  grow(1);
+  *pptr() = traits_type::to_char_type(c);
+  pbump(1);
+  return c;
+}
+
+std::streamsize XmlBuffer::xsputn(const char *s,std::streamsize n)
+
+{
+  if (epptr() - pptr() < n)
+    grow(n);
+  memcpy(pptr(),s,n);
+  pbump((int)n);
+  return n;
+}
+
+void XmlBuffer::flushTo(std::ostream &s)
+
+{ // Write everything collected to the stream in one piece and start over
+  s.write(pbase(),size());
+  clear();
+}
+}
@@ -60,7 +60,8 @@ void XmlArchitecture::buildLoader(DocumentStorage &store)
   collectSpecFiles(*errorstream);
   const Element *el = store.getTag("binaryimage");
   if (el == (const Element *)0) {
-    Document *doc = store.openDocument(getFilename());
+    BinaryImagePacker packer;
+    Document *doc = store.openDocument(getFilename(),&packer);
     store.registerTag(doc->getRoot());
     el = store.getTag("binaryimage");
   }